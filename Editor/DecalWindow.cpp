@@ -37,10 +37,9 @@ void DecalWindow::Create(EditorComponent* editor)
 	decalNameField.SetPos(XMFLOAT2(10, y+=step));
 	decalNameField.SetSize(XMFLOAT2(300, hei));
 	decalNameField.OnInputAccepted([=](wiEventArgs args) {
-		NameComponent* name = wiScene::GetScene().names.GetComponent(entity);
-		if (name != nullptr)
+		if (wiScene::GetScene().names.Contains(entity))
 		{
-			*name = args.sValue;
+			wiScene::GetScene().Entity_SetName(entity, args.sValue);
 
 			editor->RefreshSceneGraphView();
 		}
@@ -6,6 +6,7 @@
 #include "Translator.h"
 
 #include <sstream>
+#include <iomanip>
 #include <cassert>
 #include <cmath>
 #include <filesystem>
@@ -175,11 +176,13 @@ void EditorComponent::ChangeRenderPath(RENDERPATH path)
 	case EditorComponent::RENDERPATH_DEFAULT:
 		renderPath = std::make_unique<RenderPath3D>();
 		pathTraceTargetSlider.SetVisible(false);
+		pathTraceSAHCheckBox.SetVisible(false);
 		pathTraceStatisticsLabel.SetVisible(false);
 		break;
 	case EditorComponent::RENDERPATH_PATHTRACING:
 		renderPath = std::make_unique<RenderPath3D_PathTracing>();
 		pathTraceTargetSlider.SetVisible(true);
+		pathTraceSAHCheckBox.SetVisible(true);
 		pathTraceStatisticsLabel.SetVisible(true);
 		break;
 	default:
@@ -412,8 +415,11 @@ void EditorComponent::ResizeLayout()
 	pathTraceTargetSlider.SetSize(XMFLOAT2(200, 20));
 	pathTraceTargetSlider.SetPos(XMFLOAT2(screenW - 240, 100));
 
-	pathTraceStatisticsLabel.SetSize(XMFLOAT2(240, 60));
-	pathTraceStatisticsLabel.SetPos(XMFLOAT2(screenW - 240, 125));
+	pathTraceSAHCheckBox.SetSize(XMFLOAT2(20, 20));
+	pathTraceSAHCheckBox.SetPos(XMFLOAT2(screenW - 40, 125));
+
+	pathTraceStatisticsLabel.SetSize(XMFLOAT2(240, 100));
+	pathTraceStatisticsLabel.SetPos(XMFLOAT2(screenW - 240, 150));
 
 	sceneGraphView.SetSize(XMFLOAT2(260, 300));
 	sceneGraphView.SetPos(XMFLOAT2(0, screenH - sceneGraphView.scale_local.y));
@@ -701,7 +707,7 @@ void EditorComponent::Load()
 					filename += ".wiscene";
 				}
 				wiArchive archive(filename, false);
-				if (archive.IsOpen())
+				if (archive.IsOpen() && archive.SetWriteStreaming())
 				{
 					Scene& scene = wiScene::GetScene();
 
@@ -976,6 +982,18 @@ void EditorComponent::Load()
 	pathTraceTargetSlider.SetTooltip("The path tracing will perform this many samples per pixel.");
 	GetGUI().AddWidget(&pathTraceTargetSlider);
 
+	pathTraceSAHCheckBox.Create("High quality BVH (SAH): ");
+	pathTraceSAHCheckBox.SetTooltip("The scene BVH is rebuilt with the surface area heuristic in the background, which is slow to build but faster to trace.\nUse it for static scenes, it has no effect with hardware raytracing.");
+	pathTraceSAHCheckBox.OnClick([this](wiEventArgs args) {
+		wiScene::GetScene().BVH.SetBuilder(args.bValue ? wiGPUBVH::BUILDER_SAH : wiGPUBVH::BUILDER_LBVH);
+		RenderPath3D_PathTracing* pathtracer = dynamic_cast<RenderPath3D_PathTracing*>(renderPath.get());
+		if (pathtracer != nullptr)
+		{
+			pathtracer->resetProgress();
+		}
+	});
+	GetGUI().AddWidget(&pathTraceSAHCheckBox);
+
 	pathTraceStatisticsLabel.Create("Path tracing statistics");
 	GetGUI().AddWidget(&pathTraceStatisticsLabel);
 
@@ -1743,6 +1761,7 @@ void EditorComponent::Update(float dt)
 
 	emitterWnd.UpdateData();
 	hairWnd.UpdateData();
+	objectWnd.Update();
 
 	// Follow camera proxy:
 	if (cameraWnd.followCheckBox.IsEnabled() && cameraWnd.followCheckBox.GetCheck())
@@ -1763,9 +1782,31 @@ void EditorComponent::Update(float dt)
 	{
 		pathtracer->setTargetSampleCount((int)pathTraceTargetSlider.GetValue());
 
+		const wiGPUBVH& bvh = wiScene::GetScene().BVH;
+		pathTraceSAHCheckBox.SetCheck(bvh.GetBuilder() == wiGPUBVH::BUILDER_SAH);
+
 		std::stringstream ss;
 		ss << "Sample count: " << pathtracer->getCurrentSampleCount() << std::endl;
 		ss << "Trace progress: " << int(pathtracer->getProgress() * 100) << "%" << std::endl;
+		if (!pathtracer->isFinished())
+		{
+			ss << "Traced tiles: " << pathtracer->getTracedTileCount() << " / " << pathtracer->getTileCount() << std::endl;
+		}
+		if (!pathtracer->isFinished() && pathtracer->getPathsPerSecond() > 0)
+		{
+			ss << "Paths per second: " << std::fixed << std::setprecision(2) << pathtracer->getPathsPerSecond() / 1000000.0f << "M" << std::defaultfloat << std::endl;
+		}
+		if (bvh.GetBuilder() == wiGPUBVH::BUILDER_SAH)
+		{
+			if (bvh.IsUpdatePending())
+			{
+				ss << "SAH BVH: building..." << std::endl;
+			}
+			else if (bvh.GetSAHStatistics().primitiveCount > 0)
+			{
+				ss << "SAH BVH cost: " << std::fixed << std::setprecision(1) << bvh.GetSAHStatistics().cost << " (LBVH: " << bvh.GetSAHStatistics().lbvhCost << ")" << std::defaultfloat << std::endl;
+			}
+		}
 		if (pathtracer->isDenoiserAvailable())
 		{
 			if (pathtracer->getDenoiserProgress() > 0)
@@ -2453,6 +2494,25 @@ wiArchive& EditorComponent::AdvanceHistory()
 		history.pop_back();
 	}
 
+	// The finished operations don't grow any more, so the memory that was allocated ahead can be freed:
+	size_t memory = 0;
+	for (auto& x : history)
+	{
+		x.ShrinkToFit();
+		memory += x.GetMemoryUsage();
+	}
+	size_t dropped = 0;
+	while (dropped < history.size() && memory > historyMemoryBudget)
+	{
+		memory -= history[dropped].GetMemoryUsage();
+		dropped++;
+	}
+	if (dropped > 0)
+	{
+		history.erase(history.begin(), history.begin() + dropped);
+		historyPos -= (int)dropped;
+	}
+
 	history.emplace_back();
 	history.back().SetReadModeAndResetPos(false);
 
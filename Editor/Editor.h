@@ -109,6 +109,7 @@ public:
 	void RefreshSceneGraphView();
 
 	wiSlider pathTraceTargetSlider;
+	wiCheckBox pathTraceSAHCheckBox;
 	wiLabel pathTraceStatisticsLabel;
 
 	std::unique_ptr<RenderPath3D> renderPath;
@@ -160,6 +161,7 @@ public:
 
 	std::vector<wiArchive> history;
 	int historyPos = -1;
+	size_t historyMemoryBudget = 256ull << 20; // the oldest operations are dropped when the history uses more memory than this
 	enum HistoryOperationType
 	{
 		HISTORYOP_TRANSLATOR,
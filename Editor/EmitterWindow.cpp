@@ -10,7 +10,7 @@ using namespace wiScene;
 void EmitterWindow::Create(EditorComponent* editor)
 {
 	wiWindow::Create("Emitter Window");
-	SetSize(XMFLOAT2(680, 700));
+	SetSize(XMFLOAT2(680, 800));
 
 	float x = 200;
 	float y = 5;
@@ -22,10 +22,9 @@ void EmitterWindow::Create(EditorComponent* editor)
 	emitterNameField.SetPos(XMFLOAT2(x, y += step));
 	emitterNameField.SetSize(XMFLOAT2(300, itemheight));
 	emitterNameField.OnInputAccepted([=](wiEventArgs args) {
-		NameComponent* name = wiScene::GetScene().names.GetComponent(entity);
-		if (name != nullptr)
+		if (wiScene::GetScene().names.Contains(entity))
 		{
-			*name = args.sValue;
+			wiScene::GetScene().Entity_SetName(entity, args.sValue);
 
 			editor->RefreshSceneGraphView();
 		}
@@ -640,6 +639,76 @@ void EmitterWindow::Create(EditorComponent* editor)
 	sph_e_Slider.SetTooltip("Set the SPH parameter: viscosity constant");
 	AddWidget(&sph_e_Slider);
 
+	lodStartSlider.Create(0, 500, 0, 500, "LOD Start Distance: ");
+	lodStartSlider.SetSize(XMFLOAT2(360, itemheight));
+	lodStartSlider.SetPos(XMFLOAT2(x, y += step * 2));
+	lodStartSlider.OnSlide([&](wiEventArgs args) {
+		auto emitter = GetEmitter();
+		if (emitter != nullptr)
+		{
+			emitter->lod_distance_start = args.fValue;
+		}
+	});
+	lodStartSlider.SetEnabled(false);
+	lodStartSlider.SetTooltip("The emission and the particle limit start to be reduced from this camera distance");
+	AddWidget(&lodStartSlider);
+
+	lodEndSlider.Create(0, 500, 0, 500, "LOD End Distance: ");
+	lodEndSlider.SetSize(XMFLOAT2(360, itemheight));
+	lodEndSlider.SetPos(XMFLOAT2(x, y += step));
+	lodEndSlider.OnSlide([&](wiEventArgs args) {
+		auto emitter = GetEmitter();
+		if (emitter != nullptr)
+		{
+			emitter->lod_distance_end = args.fValue;
+		}
+	});
+	lodEndSlider.SetEnabled(false);
+	lodEndSlider.SetTooltip("The emission and the particle limit are reduced to the LOD min factor from this camera distance. If it is not greater than the start distance, LOD is disabled");
+	AddWidget(&lodEndSlider);
+
+	lodFactorSlider.Create(0, 1, 0.25f, 100, "LOD Min Factor: ");
+	lodFactorSlider.SetSize(XMFLOAT2(360, itemheight));
+	lodFactorSlider.SetPos(XMFLOAT2(x, y += step));
+	lodFactorSlider.OnSlide([&](wiEventArgs args) {
+		auto emitter = GetEmitter();
+		if (emitter != nullptr)
+		{
+			emitter->lod_factor_min = args.fValue;
+		}
+	});
+	lodFactorSlider.SetEnabled(false);
+	lodFactorSlider.SetTooltip("The emission and the particle limit are multiplied by this at the LOD end distance");
+	AddWidget(&lodFactorSlider);
+
+	offscreenFramesSlider.Create(0, 300, 60, 300, "Offscreen Frames: ");
+	offscreenFramesSlider.SetSize(XMFLOAT2(360, itemheight));
+	offscreenFramesSlider.SetPos(XMFLOAT2(x, y += step));
+	offscreenFramesSlider.OnSlide([&](wiEventArgs args) {
+		auto emitter = GetEmitter();
+		if (emitter != nullptr)
+		{
+			emitter->offscreen_frames = (uint32_t)args.iValue;
+		}
+	});
+	offscreenFramesSlider.SetEnabled(false);
+	offscreenFramesSlider.SetTooltip("The emitter is throttled after it was off screen for this many frames. 0: throttling is disabled");
+	AddWidget(&offscreenFramesSlider);
+
+	offscreenIntervalSlider.Create(0, 60, 0, 60, "Offscreen Interval: ");
+	offscreenIntervalSlider.SetSize(XMFLOAT2(360, itemheight));
+	offscreenIntervalSlider.SetPos(XMFLOAT2(x, y += step));
+	offscreenIntervalSlider.OnSlide([&](wiEventArgs args) {
+		auto emitter = GetEmitter();
+		if (emitter != nullptr)
+		{
+			emitter->offscreen_interval = (uint32_t)args.iValue;
+		}
+	});
+	offscreenIntervalSlider.SetEnabled(false);
+	offscreenIntervalSlider.SetTooltip("A throttled emitter is simulated in every this many frames. 0: not simulated until it is visible again");
+	AddWidget(&offscreenIntervalSlider);
+
 
 
 
@@ -702,6 +771,12 @@ void EmitterWindow::SetEntity(Entity entity)
 		sph_p0_Slider.SetValue(emitter->SPH_p0);
 		sph_e_Slider.SetValue(emitter->SPH_e);
 
+		lodStartSlider.SetValue(emitter->lod_distance_start);
+		lodEndSlider.SetValue(emitter->lod_distance_end);
+		lodFactorSlider.SetValue(emitter->lod_factor_min);
+		offscreenFramesSlider.SetValue((float)emitter->offscreen_frames);
+		offscreenIntervalSlider.SetValue((float)emitter->offscreen_interval);
+
 		debugCheckBox.SetCheck(emitter->IsDebug());
 	}
 	else
@@ -765,6 +840,8 @@ void EmitterWindow::UpdateData()
 	ss << "Alive Particle Count = " << data.aliveCount << std::endl;
 	ss << "Dead Particle Count = " << data.deadCount << std::endl;
 	ss << "GPU Emit count = " << data.realEmitCount << std::endl;
+	ss << "LOD factor = " << emitter->GetLODFactor() << std::endl;
+	ss << "Simulation steps = " << emitter->GetSimulationSteps() << std::endl;
 
 	infoLabel.SetText(ss.str());
 
@@ -56,6 +56,12 @@ public:
 	wiSlider sph_p0_Slider;
 	wiSlider sph_e_Slider;
 
+	wiSlider lodStartSlider;
+	wiSlider lodEndSlider;
+	wiSlider lodFactorSlider;
+	wiSlider offscreenFramesSlider;
+	wiSlider offscreenIntervalSlider;
+
 	wiTextInputField frameRateInput;
 	wiTextInputField framesXInput;
 	wiTextInputField framesYInput;
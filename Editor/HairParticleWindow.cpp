@@ -8,7 +8,7 @@ using namespace wiScene;
 void HairParticleWindow::Create(EditorComponent* editor)
 {
 	wiWindow::Create("Hair Particle System Window");
-	SetSize(XMFLOAT2(600, 260));
+	SetSize(XMFLOAT2(600, 280));
 
 	float x = 160;
 	float y = 10;
@@ -150,6 +150,20 @@ void HairParticleWindow::Create(EditorComponent* editor)
 	viewDistanceSlider.SetTooltip("Set view distance. After this, particles will be faded out.");
 	AddWidget(&viewDistanceSlider);
 
+	densityFalloffSlider.Create(0, 1, 0.5f, 100, "Density falloff: ");
+	densityFalloffSlider.SetSize(XMFLOAT2(360, hei));
+	densityFalloffSlider.SetPos(XMFLOAT2(x, y += step));
+	densityFalloffSlider.OnSlide([&](wiEventArgs args) {
+		auto hair = GetHair();
+		if (hair != nullptr)
+		{
+			hair->densityFalloff = args.fValue;
+		}
+		});
+	densityFalloffSlider.SetEnabled(false);
+	densityFalloffSlider.SetTooltip("Set the fraction of the view distance where the strands start to be thinned out. At the view distance, none of them are left.");
+	AddWidget(&densityFalloffSlider);
+
 	framesXInput.Create("");
 	framesXInput.SetPos(XMFLOAT2(x, y += step));
 	framesXInput.SetSize(XMFLOAT2(40, hei));
@@ -236,6 +250,7 @@ void HairParticleWindow::SetEntity(Entity entity)
 		segmentcountSlider.SetValue((float)hair->segmentCount);
 		randomSeedSlider.SetValue((float)hair->randomSeed);
 		viewDistanceSlider.SetValue(hair->viewDistance);
+		densityFalloffSlider.SetValue(hair->densityFalloff);
 		framesXInput.SetValue((int)hair->framesX);
 		framesYInput.SetValue((int)hair->framesY);
 		frameCountInput.SetValue((int)hair->frameCount);
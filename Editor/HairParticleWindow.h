@@ -26,6 +26,7 @@ public:
 	wiSlider segmentcountSlider;
 	wiSlider randomSeedSlider;
 	wiSlider viewDistanceSlider;
+	wiSlider densityFalloffSlider;
 	wiTextInputField framesXInput;
 	wiTextInputField framesYInput;
 	wiTextInputField frameCountInput;
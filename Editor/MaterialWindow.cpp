@@ -438,10 +438,9 @@ void MaterialWindow::Create(EditorComponent* editor)
 	materialNameField.SetPos(XMFLOAT2(10, y += step));
 	materialNameField.SetSize(XMFLOAT2(300, hei));
 	materialNameField.OnInputAccepted([=](wiEventArgs args) {
-		NameComponent* name = wiScene::GetScene().names.GetComponent(entity);
-		if (name != nullptr)
+		if (wiScene::GetScene().names.Contains(entity))
 		{
-			*name = args.sValue;
+			wiScene::GetScene().Entity_SetName(entity, args.sValue);
 
 			editor->RefreshSceneGraphView();
 		}
@@ -1,6 +1,7 @@
 #include "stdafx.h"
 #include "MeshWindow.h"
 #include "Editor.h"
+#include "ModelImporter.h"
 
 #include "Utility/stb_image.h"
 
@@ -77,7 +78,7 @@ struct TerraGen : public wiWindow
 void MeshWindow::Create(EditorComponent* editor)
 {
 	wiWindow::Create("Mesh Window");
-	SetSize(XMFLOAT2(580, 540));
+	SetSize(XMFLOAT2(580, 600));
 
 	float x = 150;
 	float y = 0;
@@ -121,6 +122,8 @@ void MeshWindow::Create(EditorComponent* editor)
 				softbody.friction = frictionSlider.GetValue();
 				softbody.restitution = restitutionSlider.GetValue();
 				softbody.mass = massSlider.GetValue();
+				softbody.SetGPUSimulation(gpuClothCheckBox.GetCheck());
+				softbody.colliderRadius = colliderRadiusSlider.GetValue();
 			}
 		}
 		else
@@ -173,6 +176,32 @@ void MeshWindow::Create(EditorComponent* editor)
 		});
 	AddWidget(&restitutionSlider);
 
+	gpuClothCheckBox.Create("GPU cloth: ");
+	gpuClothCheckBox.SetTooltip("Simulate the soft body on the GPU instead of the physics engine. It is much cheaper, but it only collides with the capsules around the bones of its armature.");
+	gpuClothCheckBox.SetSize(XMFLOAT2(hei, hei));
+	gpuClothCheckBox.SetPos(XMFLOAT2(x, y += step));
+	gpuClothCheckBox.OnClick([&](wiEventArgs args) {
+		SoftBodyPhysicsComponent* physicscomponent = wiScene::GetScene().softbodies.GetComponent(entity);
+		if (physicscomponent != nullptr)
+		{
+			physicscomponent->SetGPUSimulation(args.bValue);
+		}
+	});
+	AddWidget(&gpuClothCheckBox);
+
+	colliderRadiusSlider.Create(0, 0.5f, 0.1f, 100000, "Collider radius: ");
+	colliderRadiusSlider.SetTooltip("Set the radius of the capsules between the bones that the GPU cloth collides with (0: no collisions).");
+	colliderRadiusSlider.SetSize(XMFLOAT2(100, hei));
+	colliderRadiusSlider.SetPos(XMFLOAT2(x, y += step));
+	colliderRadiusSlider.OnSlide([&](wiEventArgs args) {
+		SoftBodyPhysicsComponent* physicscomponent = wiScene::GetScene().softbodies.GetComponent(entity);
+		if (physicscomponent != nullptr)
+		{
+			physicscomponent->colliderRadius = args.fValue;
+		}
+	});
+	AddWidget(&colliderRadiusSlider);
+
 	impostorCreateButton.Create("Create Impostor");
 	impostorCreateButton.SetTooltip("Create an impostor image of the mesh. The mesh will be replaced by this image when far away, to render faster.");
 	impostorCreateButton.SetSize(XMFLOAT2(240, hei));
@@ -327,6 +356,16 @@ void MeshWindow::Create(EditorComponent* editor)
 		});
 	AddWidget(&optimizeButton);
 
+	hlodButton.Create("Generate HLODs");
+	hlodButton.SetTooltip("Merge the static objects of the whole scene into simplified proxy objects per grid cell (hierarchical LOD).\nThe proxy of a cell is drawn instead of its objects beyond the swap distance. Objects that are already in a cell are skipped.");
+	hlodButton.SetSize(XMFLOAT2(240, hei));
+	hlodButton.SetPos(XMFLOAT2(x - 50, y += step));
+	hlodButton.OnClick([&](wiEventArgs args) {
+		const uint32_t count = GenerateHLODs(wiScene::GetScene());
+		wiBackLog::post(("Generated HLOD cells: " + std::to_string(count)).c_str());
+	});
+	AddWidget(&hlodButton);
+
 	x = 150;
 	y = 190;
 
@@ -627,6 +666,7 @@ void MeshWindow::SetEntity(Entity entity)
 		if (mesh->vertexBuffer_TAN.IsValid()) ss << "tangent; ";
 		if (mesh->streamoutBuffer_POS.IsValid()) ss << "streamout_position; ";
 		if (mesh->streamoutBuffer_TAN.IsValid()) ss << "streamout_tangents; ";
+		if (mesh->IsCooked()) ss << std::endl << std::endl << "The vertex attributes are cooked into the GPU formats, editing will restore them in that precision.";
 		if (mesh->IsTerrain()) ss << std::endl << std::endl << "Terrain will use 4 blend materials and blend by vertex colors, the default one is always the subset material and uses RED vertex color channel mask, the other 3 are selectable below.";
 		meshInfoLabel.SetText(ss.str());
 
@@ -678,6 +718,8 @@ void MeshWindow::SetEntity(Entity entity)
 			massSlider.SetValue(physicscomponent->mass);
 			frictionSlider.SetValue(physicscomponent->friction);
 			restitutionSlider.SetValue(physicscomponent->restitution);
+			gpuClothCheckBox.SetCheck(physicscomponent->IsGPUSimulation());
+			colliderRadiusSlider.SetValue(physicscomponent->colliderRadius);
 		}
 
 		uint8_t selected = morphTargetCombo.GetSelected();
@@ -17,6 +17,8 @@ public:
 	wiSlider massSlider;
 	wiSlider frictionSlider;
 	wiSlider restitutionSlider;
+	wiCheckBox gpuClothCheckBox;
+	wiSlider colliderRadiusSlider;
 	wiButton impostorCreateButton;
 	wiSlider impostorDistanceSlider;
 	wiSlider tessellationFactorSlider;
@@ -27,6 +29,7 @@ public:
 	wiButton recenterButton;
 	wiButton recenterToBottomButton;
 	wiButton optimizeButton;
+	wiButton hlodButton;
 
 	wiCheckBox terrainCheckBox;
 	wiComboBox terrainMat1Combo;
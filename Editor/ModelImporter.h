@@ -4,8 +4,24 @@
 namespace wiScene
 {
 	struct Scene;
+	struct MeshComponent;
 }
 
 void ImportModel_OBJ(const std::string& fileName, wiScene::Scene& scene);
 void ImportModel_GLTF(const std::string& fileName, wiScene::Scene& scene);
 
+// Merges the duplicate vertices, then reorders the indices of every subset for the vertex cache and overdraw, and the vertices for the vertex fetch
+//	All vertex streams (also the morph targets) are remapped together. Call it before GenerateMeshLODs() and GenerateMeshlets()
+void OptimizeMesh(wiScene::MeshComponent& mesh);
+
+// Appends up to lodCount simplified LOD levels as subsets of a single subset mesh (with halved triangle counts)
+//	The simplification error is stored in MeshSubset::lod_error, the scene uses it to select the levels by their projected error
+void GenerateMeshLODs(wiScene::MeshComponent& mesh, uint32_t lodCount = 3);
+// Splits the first subset of a static mesh into meshlets for the GPU meshlet culling, the subset indices are reordered cluster by cluster
+void GenerateMeshlets(wiScene::MeshComponent& mesh);
+
+// Merges the static objects of every cell of a cellSize grid into a simplified proxy object with ratio of the triangles, and creates a HierarchicalLODComponent for it
+//	The proxy keeps the materials of the objects as subsets (a material is one draw call), the objects that are already in a cell are skipped
+//	Returns the number of created cells
+uint32_t GenerateHLODs(wiScene::Scene& scene, float cellSize = 64.0f, float swapDistance = 200.0f, float ratio = 0.1f);
+
@@ -106,20 +106,20 @@ namespace tinygltf
 			image->uri = ss.str();
 		}
 
-		auto resource = wiResourceManager::Load(
+		// The images are decoded on background threads while the import continues, the materials refer to them by name
+		//	The texture of the resource is replaced when it finished loading, so the size of the image is not known here
+		auto resource = wiResourceManager::LoadAsync(
 			image->uri,
 			wiResourceManager::IMPORT_RETAIN_FILEDATA,
 			(const uint8_t*)bytes,
 			(size_t)size
-		);
+		).resource;
 
 		if (resource == nullptr)
 		{
 			return false;
 		}
 
-		image->width = resource->texture.desc.Width;
-		image->height = resource->texture.desc.Height;
 		image->component = 4;
 
 		wiResourceManager::ResourceSerializer* seri = (wiResourceManager::ResourceSerializer*)userdata;
@@ -674,10 +674,17 @@ void ImportModel_GLTF(const std::string& fileName, Scene& scene)
 	}
 
 	// Create meshes:
-	for (auto& x : state.gltfModel.meshes)
+	//	The entities are created first, then the meshes are converted in parallel, together with their tangents, bounds, LODs and meshlets
+	std::vector<Entity> meshEntities(state.gltfModel.meshes.size());
+	for (size_t i = 0; i < meshEntities.size(); ++i)
 	{
-		Entity meshEntity = scene.Entity_CreateMesh(x.name);
-		MeshComponent& mesh = *scene.meshes.GetComponent(meshEntity);
+		meshEntities[i] = scene.Entity_CreateMesh(state.gltfModel.meshes[i].name);
+	}
+	std::vector<std::vector<Entity>> vertexColorMaterials(meshEntities.size()); // the materials are shared by the meshes, so they are modified after the jobs
+	wiJobSystem::context ctx;
+	wiJobSystem::Dispatch(ctx, (uint32_t)meshEntities.size(), 1, [&](wiJobArgs args) {
+		const tinygltf::Mesh& x = state.gltfModel.meshes[args.jobIndex];
+		MeshComponent& mesh = *scene.meshes.GetComponent(meshEntities[args.jobIndex]);
 
 		mesh.targets.resize(x.weights.size());
 		for (size_t i = 0; i < mesh.targets.size(); i++)
@@ -704,7 +711,6 @@ void ImportModel_GLTF(const std::string& fileName, Scene& scene)
 			mesh.subsets.back().indexCount = (uint32_t)indexCount;
 
 			mesh.subsets.back().materialID = scene.materials.GetEntity(std::max(0, prim.material));
-			MaterialComponent* material = scene.materials.GetComponent(mesh.subsets.back().materialID);
 
 			uint32_t vertexOffset = (uint32_t)mesh.vertex_positions.size();
 
@@ -874,10 +880,7 @@ void ImportModel_GLTF(const std::string& fileName, Scene& scene)
 				}
 				else if (!attr_name.compare("COLOR_0"))
 				{
-					if(material != nullptr)
-					{
-						material->SetUseVertexColors(true);
-					}
+					vertexColorMaterials[args.jobIndex].push_back(mesh.subsets.back().materialID);
 					mesh.vertex_colors.resize(vertexOffset + vertexCount);
 					assert(stride == 16);
 					for (size_t i = 0; i < vertexCount; ++i)
@@ -929,7 +932,22 @@ void ImportModel_GLTF(const std::string& fileName, Scene& scene)
 
 		}
 
+		OptimizeMesh(mesh);
+		GenerateMeshLODs(mesh);
+		GenerateMeshlets(mesh);
 		mesh.CreateRenderData();
+	});
+	wiJobSystem::Wait(ctx);
+	for (auto& materials : vertexColorMaterials)
+	{
+		for (Entity materialEntity : materials)
+		{
+			MaterialComponent* material = scene.materials.GetComponent(materialEntity);
+			if (material != nullptr)
+			{
+				material->SetUseVertexColors(true);
+			}
+		}
 	}
 
 	// Create armatures:
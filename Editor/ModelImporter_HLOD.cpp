@@ -0,0 +1,190 @@
+#include "stdafx.h"
+#include "wiScene.h"
+#include "ModelImporter.h"
+
+#include "meshoptimizer/meshoptimizer.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace wiScene;
+using namespace wiECS;
+
+static bool IsHLODCandidate(const ObjectComponent& object, const MeshComponent* mesh)
+{
+	return mesh != nullptr &&
+		object.IsRenderable() &&
+		!object.IsDynamic() &&
+		!object.IsImpostorPlacement() &&
+		!mesh->IsSkinned() &&
+		mesh->targets.empty() &&
+		!mesh->vertex_positions.empty() &&
+		!mesh->indices.empty();
+}
+
+uint32_t GenerateHLODs(Scene& scene, float cellSize, float swapDistance, float ratio)
+{
+	// The objects that are already in a cell (or are proxies) are left out, so the generation can be repeated for newly placed objects:
+	std::unordered_set<Entity> used;
+	for (size_t i = 0; i < scene.hlods.GetCount(); ++i)
+	{
+		const HierarchicalLODComponent& hlod = scene.hlods[i];
+		used.insert(hlod.proxyID);
+		used.insert(hlod.children.begin(), hlod.children.end());
+	}
+
+	// The objects are binned into the cells of a uniform grid by the center of their bounds:
+	std::unordered_map<uint64_t, std::vector<size_t>> cells;
+	std::vector<uint64_t> cell_order; // the cells are created in a deterministic order
+	for (size_t i = 0; i < scene.objects.GetCount(); ++i)
+	{
+		const Entity entity = scene.objects.GetEntity(i);
+		const ObjectComponent& object = scene.objects[i];
+		if (used.count(entity) > 0 || !IsHLODCandidate(object, scene.meshes.GetComponent(object.meshID)) || !scene.transforms.Contains(entity))
+		{
+			continue;
+		}
+		const XMFLOAT3 center = scene.aabb_objects[i].getCenter();
+		const uint64_t x = uint64_t(int64_t(std::floor(center.x / cellSize)) & 0x1FFFFF);
+		const uint64_t y = uint64_t(int64_t(std::floor(center.y / cellSize)) & 0x1FFFFF);
+		const uint64_t z = uint64_t(int64_t(std::floor(center.z / cellSize)) & 0x1FFFFF);
+		const uint64_t key = (x << 42) | (y << 21) | z;
+		auto& cell = cells[key];
+		if (cell.empty())
+		{
+			cell_order.push_back(key);
+		}
+		cell.push_back(i);
+	}
+
+	uint32_t generated = 0;
+	for (uint64_t key : cell_order)
+	{
+		const std::vector<size_t>& cell = cells[key];
+		if (cell.size() < 2)
+		{
+			continue; // a single object doesn't save draw calls, its own mesh LODs are better for it
+		}
+
+		// The meshes are merged in world space, the triangles of the same material are gathered into one subset:
+		MeshComponent merged;
+		std::vector<Entity> materials;
+		std::vector<std::vector<uint32_t>> material_indices;
+		bool normals = true;
+		std::vector<Entity> children;
+		children.reserve(cell.size());
+		for (size_t i : cell)
+		{
+			const Entity entity = scene.objects.GetEntity(i);
+			const ObjectComponent& object = scene.objects[i];
+			const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
+			const XMMATRIX W = XMLoadFloat4x4(&scene.transforms.GetComponent(entity)->world);
+			const uint32_t vertexOffset = (uint32_t)merged.vertex_positions.size();
+			const size_t vertex_count = mesh.vertex_positions.size();
+			children.push_back(entity);
+
+			// Cooked meshes only have their positions on the CPU, the normals of the proxy are computed then:
+			normals = normals && mesh.vertex_normals.size() == vertex_count;
+			for (size_t j = 0; j < vertex_count; ++j)
+			{
+				XMFLOAT3 position;
+				XMStoreFloat3(&position, XMVector3Transform(XMLoadFloat3(&mesh.vertex_positions[j]), W));
+				merged.vertex_positions.push_back(position);
+				XMFLOAT3 normal = XMFLOAT3(0, 1, 0);
+				if (normals)
+				{
+					XMStoreFloat3(&normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&mesh.vertex_normals[j]), W)));
+				}
+				merged.vertex_normals.push_back(normal);
+				merged.vertex_uvset_0.push_back(mesh.vertex_uvset_0.size() == vertex_count ? mesh.vertex_uvset_0[j] : XMFLOAT2(0, 0));
+			}
+
+			// The subsets of a mesh with LOD levels are the levels, only the first one is merged:
+			const size_t subset_count = mesh.lodlevels > 0 ? std::min((size_t)1, mesh.subsets.size()) : mesh.subsets.size();
+			for (size_t s = 0; s < subset_count; ++s)
+			{
+				const MeshComponent::MeshSubset& subset = mesh.subsets[s];
+				if (uint64_t(subset.indexOffset) + uint64_t(subset.indexCount) > mesh.indices.size())
+				{
+					continue;
+				}
+				size_t material = std::find(materials.begin(), materials.end(), subset.materialID) - materials.begin();
+				if (material == materials.size())
+				{
+					materials.push_back(subset.materialID);
+					material_indices.emplace_back();
+				}
+				for (uint32_t j = 0; j < subset.indexCount; ++j)
+				{
+					material_indices[material].push_back(vertexOffset + mesh.indices[subset.indexOffset + j]);
+				}
+			}
+		}
+		if (materials.empty())
+		{
+			continue;
+		}
+
+		// Every material is simplified separately, the borders between them are not welded, which is not visible at the swap distance:
+		const float* positions = &merged.vertex_positions[0].x;
+		const size_t vertex_count = merged.vertex_positions.size();
+		std::vector<uint32_t> simplified;
+		for (size_t m = 0; m < materials.size(); ++m)
+		{
+			const std::vector<uint32_t>& source = material_indices[m];
+			simplified.resize(source.size());
+			const size_t target_index_count = std::max((size_t)3, size_t(source.size() * ratio) / 3 * 3);
+			float error = 0;
+			size_t index_count = meshopt_simplify(simplified.data(), source.data(), source.size(), positions, vertex_count, sizeof(XMFLOAT3), target_index_count, 0.05f, &error);
+			if (index_count > target_index_count)
+			{
+				// The topology limits simplify(), the sloppy version reaches the target by also merging the unconnected parts:
+				index_count = meshopt_simplifySloppy(simplified.data(), source.data(), source.size(), positions, vertex_count, sizeof(XMFLOAT3), target_index_count, FLT_MAX, &error);
+			}
+			if (index_count == 0)
+			{
+				continue;
+			}
+
+			MeshComponent::MeshSubset subset;
+			subset.materialID = materials[m];
+			subset.indexOffset = (uint32_t)merged.indices.size();
+			subset.indexCount = (uint32_t)index_count;
+			merged.indices.insert(merged.indices.end(), simplified.begin(), simplified.begin() + index_count);
+			merged.subsets.push_back(subset);
+		}
+		if (merged.subsets.empty())
+		{
+			continue;
+		}
+
+		// The vertices that the simplification removed are dropped by the vertex fetch remapping:
+		OptimizeMesh(merged);
+
+		const std::string name = "HLOD_" + std::to_string(generated);
+		const Entity meshEntity = scene.Entity_CreateMesh(name + "_mesh");
+		MeshComponent& mesh = *scene.meshes.GetComponent(meshEntity);
+		mesh = std::move(merged);
+		if (normals)
+		{
+			mesh.CreateRenderData();
+		}
+		else
+		{
+			mesh.ComputeNormals(MeshComponent::COMPUTE_NORMALS_SMOOTH_FAST);
+		}
+
+		const Entity proxyEntity = scene.Entity_CreateObject(name + "_proxy");
+		scene.objects.GetComponent(proxyEntity)->meshID = meshEntity;
+
+		const Entity cellEntity = CreateEntity();
+		scene.names.Create(cellEntity) = name;
+		HierarchicalLODComponent& hlod = scene.hlods.Create(cellEntity);
+		hlod.swapDistance = swapDistance;
+		hlod.proxyID = proxyEntity;
+		hlod.children = std::move(children);
+
+		generated++;
+	}
+	return generated;
+}
@@ -0,0 +1,55 @@
+#include "stdafx.h"
+#include "wiScene.h"
+#include "ModelImporter.h"
+
+#include "meshoptimizer/meshoptimizer.h"
+
+using namespace wiScene;
+
+void GenerateMeshLODs(MeshComponent& mesh, uint32_t lodCount)
+{
+	// The subsets are used as LOD levels, so only meshes with a single subset and without authored levels can get them:
+	if (mesh.subsets.size() != 1 || mesh.lodlevels > 0 || mesh.vertex_positions.empty())
+	{
+		return;
+	}
+
+	const MeshComponent::MeshSubset base = mesh.subsets[0];
+	const float* positions = &mesh.vertex_positions[0].x;
+	const size_t vertex_count = mesh.vertex_positions.size();
+	const float scale = meshopt_simplifyScale(positions, vertex_count, sizeof(XMFLOAT3));
+
+	const std::vector<uint32_t> source(mesh.indices.begin() + base.indexOffset, mesh.indices.begin() + base.indexOffset + base.indexCount);
+	std::vector<uint32_t> lod(source.size());
+	size_t prev_count = source.size();
+	float prev_error = 0;
+
+	// Every level is simplified from the full detail mesh to half of the previous triangle count, so the errors are measured against the original:
+	for (uint32_t level = 1; level <= lodCount; ++level)
+	{
+		const size_t target_index_count = (prev_count / 2) / 3 * 3;
+		if (target_index_count < 3 * 16)
+		{
+			break;
+		}
+
+		float error = 0;
+		const size_t index_count = meshopt_simplify(lod.data(), source.data(), source.size(), positions, vertex_count, sizeof(XMFLOAT3), target_index_count, 0.1f, &error);
+		if (index_count == 0 || index_count > prev_count * 9 / 10)
+		{
+			break; // the mesh can't be simplified further without too much error
+		}
+		meshopt_optimizeVertexCache(lod.data(), lod.data(), index_count, vertex_count);
+
+		MeshComponent::MeshSubset subset = base;
+		subset.indexOffset = (uint32_t)mesh.indices.size();
+		subset.indexCount = (uint32_t)index_count;
+		subset.lod_error = std::max(prev_error, error * scale);
+		mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.begin() + index_count);
+		mesh.subsets.push_back(subset);
+		mesh.lodlevels = level;
+
+		prev_count = index_count;
+		prev_error = subset.lod_error;
+	}
+}
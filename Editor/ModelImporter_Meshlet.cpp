@@ -0,0 +1,68 @@
+#include "stdafx.h"
+#include "wiScene.h"
+#include "ModelImporter.h"
+
+#include "meshoptimizer/meshoptimizer.h"
+
+using namespace wiScene;
+
+void GenerateMeshlets(MeshComponent& mesh)
+{
+	mesh.meshlets.clear();
+
+	// Only static meshes are culled per cluster, and only the first subset (the most detailed LOD level) gets the meshlets:
+	if (mesh.subsets.empty() || mesh.IsSkinned() || !mesh.vertex_boneindices.empty() || !mesh.targets.empty() || mesh.vertex_positions.empty())
+	{
+		return;
+	}
+
+	const size_t max_vertices = 64;
+	const size_t max_triangles = 124;
+	MeshComponent::MeshSubset& subset = mesh.subsets[0];
+	if (subset.indexCount < max_triangles * 3 * 4)
+	{
+		return; // not enough clusters to be worth culling them one by one
+	}
+
+	const uint32_t* indices = mesh.indices.data() + subset.indexOffset;
+	const float* positions = &mesh.vertex_positions[0].x;
+	const size_t vertex_count = mesh.vertex_positions.size();
+
+	const size_t max_meshlets = meshopt_buildMeshletsBound(subset.indexCount, max_vertices, max_triangles);
+	std::vector<meshopt_Meshlet> meshlets(max_meshlets);
+	std::vector<unsigned int> meshlet_vertices(max_meshlets * max_vertices);
+	std::vector<unsigned char> meshlet_triangles(max_meshlets * max_triangles * 3);
+	const size_t meshlet_count = meshopt_buildMeshlets(meshlets.data(), meshlet_vertices.data(), meshlet_triangles.data(), indices, subset.indexCount, positions, vertex_count, sizeof(XMFLOAT3), max_vertices, max_triangles, 0.25f);
+
+	// The triangles of the subset are reordered cluster by cluster, so every meshlet is a contiguous index range:
+	std::vector<uint32_t> ordered;
+	ordered.reserve(subset.indexCount);
+	mesh.meshlets.reserve(meshlet_count);
+	for (size_t i = 0; i < meshlet_count; ++i)
+	{
+		const meshopt_Meshlet& m = meshlets[i];
+		const meshopt_Bounds bounds = meshopt_computeMeshletBounds(&meshlet_vertices[m.vertex_offset], &meshlet_triangles[m.triangle_offset], m.triangle_count, positions, vertex_count, sizeof(XMFLOAT3));
+
+		ShaderMeshlet meshlet = {};
+		meshlet.center = XMFLOAT3(bounds.center[0], bounds.center[1], bounds.center[2]);
+		meshlet.radius = bounds.radius;
+		meshlet.cone_axis = XMFLOAT3(bounds.cone_axis[0], bounds.cone_axis[1], bounds.cone_axis[2]);
+		meshlet.cone_cutoff = bounds.cone_cutoff;
+		meshlet.indexOffset = subset.indexOffset + (uint32_t)ordered.size();
+		meshlet.indexCount = m.triangle_count * 3;
+		mesh.meshlets.push_back(meshlet);
+
+		for (uint32_t j = 0; j < m.triangle_count * 3; ++j)
+		{
+			ordered.push_back(meshlet_vertices[m.vertex_offset + meshlet_triangles[m.triangle_offset + j]]);
+		}
+	}
+
+	if (ordered.size() != subset.indexCount)
+	{
+		// Some triangles were not assigned to clusters, the mesh is kept as it was
+		mesh.meshlets.clear();
+		return;
+	}
+	std::copy(ordered.begin(), ordered.end(), mesh.indices.begin() + subset.indexOffset);
+}
@@ -247,6 +247,9 @@ void ImportModel_OBJ(const std::string& fileName, Scene& scene)
 					mesh.subsets.back().indexCount++;
 				}
 			}
+			OptimizeMesh(mesh);
+			GenerateMeshLODs(mesh);
+			GenerateMeshlets(mesh);
 			mesh.CreateRenderData();
 		}
 
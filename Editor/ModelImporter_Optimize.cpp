@@ -0,0 +1,119 @@
+#include "stdafx.h"
+#include "wiScene.h"
+#include "ModelImporter.h"
+
+#include "meshoptimizer/meshoptimizer.h"
+
+using namespace wiScene;
+
+template<typename T>
+static bool IsStreamValid(const std::vector<T>& stream, size_t vertex_count)
+{
+	return stream.empty() || stream.size() == vertex_count;
+}
+template<typename T>
+static void AddStream(std::vector<meshopt_Stream>& streams, const std::vector<T>& stream)
+{
+	if (!stream.empty())
+	{
+		streams.push_back({ stream.data(), sizeof(T), sizeof(T) });
+	}
+}
+template<typename T>
+static void RemapStream(std::vector<T>& stream, const std::vector<uint32_t>& remap, size_t vertex_count)
+{
+	if (!stream.empty())
+	{
+		std::vector<T> remapped(vertex_count);
+		meshopt_remapVertexBuffer(remapped.data(), stream.data(), stream.size(), sizeof(T), remap.data());
+		stream = std::move(remapped);
+	}
+}
+static void RemapStreams(MeshComponent& mesh, const std::vector<uint32_t>& remap, size_t vertex_count)
+{
+	RemapStream(mesh.vertex_positions, remap, vertex_count);
+	RemapStream(mesh.vertex_normals, remap, vertex_count);
+	RemapStream(mesh.vertex_tangents, remap, vertex_count);
+	RemapStream(mesh.vertex_uvset_0, remap, vertex_count);
+	RemapStream(mesh.vertex_uvset_1, remap, vertex_count);
+	RemapStream(mesh.vertex_boneindices, remap, vertex_count);
+	RemapStream(mesh.vertex_boneweights, remap, vertex_count);
+	RemapStream(mesh.vertex_atlas, remap, vertex_count);
+	RemapStream(mesh.vertex_colors, remap, vertex_count);
+	RemapStream(mesh.vertex_windweights, remap, vertex_count);
+	for (auto& target : mesh.targets)
+	{
+		RemapStream(target.vertex_positions, remap, vertex_count);
+		RemapStream(target.vertex_normals, remap, vertex_count);
+	}
+}
+
+void OptimizeMesh(MeshComponent& mesh)
+{
+	const size_t vertex_count = mesh.vertex_positions.size();
+	if (vertex_count == 0 || mesh.indices.empty() || mesh.lodlevels > 0 || !mesh.meshlets.empty())
+	{
+		return;
+	}
+
+	// The streams are remapped together, so a mesh with an incomplete stream (eg. an attribute that only some primitives had) is left as it is:
+	bool valid =
+		IsStreamValid(mesh.vertex_normals, vertex_count) &&
+		IsStreamValid(mesh.vertex_tangents, vertex_count) &&
+		IsStreamValid(mesh.vertex_uvset_0, vertex_count) &&
+		IsStreamValid(mesh.vertex_uvset_1, vertex_count) &&
+		IsStreamValid(mesh.vertex_boneindices, vertex_count) &&
+		IsStreamValid(mesh.vertex_boneweights, vertex_count) &&
+		IsStreamValid(mesh.vertex_atlas, vertex_count) &&
+		IsStreamValid(mesh.vertex_colors, vertex_count) &&
+		IsStreamValid(mesh.vertex_windweights, vertex_count);
+	for (auto& target : mesh.targets)
+	{
+		valid = valid && IsStreamValid(target.vertex_positions, vertex_count) && IsStreamValid(target.vertex_normals, vertex_count);
+	}
+	for (auto& subset : mesh.subsets)
+	{
+		valid = valid && uint64_t(subset.indexOffset) + uint64_t(subset.indexCount) <= mesh.indices.size();
+	}
+	if (!valid)
+	{
+		return;
+	}
+
+	// Vertex deduplication: every attribute (also of the morph targets) must match for the vertices to be merged
+	std::vector<meshopt_Stream> streams;
+	AddStream(streams, mesh.vertex_positions);
+	AddStream(streams, mesh.vertex_normals);
+	AddStream(streams, mesh.vertex_tangents);
+	AddStream(streams, mesh.vertex_uvset_0);
+	AddStream(streams, mesh.vertex_uvset_1);
+	AddStream(streams, mesh.vertex_boneindices);
+	AddStream(streams, mesh.vertex_boneweights);
+	AddStream(streams, mesh.vertex_atlas);
+	AddStream(streams, mesh.vertex_colors);
+	AddStream(streams, mesh.vertex_windweights);
+	for (auto& target : mesh.targets)
+	{
+		AddStream(streams, target.vertex_positions);
+		AddStream(streams, target.vertex_normals);
+	}
+
+	std::vector<uint32_t> remap(vertex_count);
+	const size_t unique_count = meshopt_generateVertexRemapMulti(remap.data(), mesh.indices.data(), mesh.indices.size(), vertex_count, streams.data(), streams.size());
+	meshopt_remapIndexBuffer(mesh.indices.data(), mesh.indices.data(), mesh.indices.size(), remap.data());
+	RemapStreams(mesh, remap, unique_count);
+
+	// The subsets are optimized one by one, because they are drawn separately:
+	const float* positions = &mesh.vertex_positions[0].x;
+	for (auto& subset : mesh.subsets)
+	{
+		uint32_t* indices = mesh.indices.data() + subset.indexOffset;
+		meshopt_optimizeVertexCache(indices, indices, subset.indexCount, unique_count);
+		meshopt_optimizeOverdraw(indices, indices, subset.indexCount, positions, unique_count, sizeof(XMFLOAT3), 1.05f);
+	}
+
+	// The vertices are reordered in the order of their first use, the vertices that are not referenced any more are removed:
+	const size_t fetch_count = meshopt_optimizeVertexFetchRemap(remap.data(), mesh.indices.data(), mesh.indices.size(), unique_count);
+	meshopt_remapIndexBuffer(mesh.indices.data(), mesh.indices.data(), mesh.indices.size(), remap.data());
+	RemapStreams(mesh, remap, fetch_count);
+}
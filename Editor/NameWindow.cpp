@@ -22,12 +22,7 @@ void NameWindow::Create(EditorComponent* editor)
 	nameInput.SetPos(XMFLOAT2(x, y += step));
 	nameInput.SetSize(XMFLOAT2(siz, hei));
 	nameInput.OnInputAccepted([=](wiEventArgs args) {
-		NameComponent* name = wiScene::GetScene().names.GetComponent(entity);
-		if (name == nullptr)
-		{
-			name = &wiScene::GetScene().names.Create(entity);
-		}
-		name->name = args.sValue;
+		wiScene::GetScene().Entity_SetName(entity, args.sValue);
 
 		editor->RefreshSceneGraphView();
 	});
@@ -8,6 +8,7 @@
 #include <sstream>
 #include <unordered_set>
 #include <unordered_map>
+#include <atomic>
 
 using namespace wiECS;
 using namespace wiScene;
@@ -62,38 +63,62 @@ static void RasterizeTriangle(uint8_t *dest, int destWidth, const int *t0, const
 	}
 }
 
-struct Atlas_Dim
+struct ObjectWindow::AtlasJob
 {
+	Entity meshID = INVALID_ENTITY;
+	uint32_t resolution = 0;
+	size_t vertexCount = 0; // the mesh is only updated if it has the same vertex count when the job finishes
+
+	// Copy of the mesh data, so that the mesh can be used by the scene while the job is running:
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT3> normals;
+	std::vector<XMFLOAT2> uvs;
+	std::vector<uint32_t> indices;
+
+	bool success = false;
+	std::string error;
 	uint32_t width = 0;
 	uint32_t height = 0;
+	std::vector<uint32_t> atlasIndices;
+	std::vector<uint32_t> xrefs; // the source vertex of every atlas vertex
+	std::vector<XMFLOAT2> atlas;
+	std::atomic<uint32_t> progress{ 0 }; // percent
 };
-static Atlas_Dim GenerateMeshAtlas(MeshComponent& meshcomponent, uint32_t resolution)
-{
-	Atlas_Dim dim;
 
+static bool AtlasProgressCallback(xatlas::ProgressCategory::Enum category, int progress, void* userData)
+{
+	// The categories follow each other, each of them is an equal part of the whole progress:
+	std::atomic<uint32_t>& value = *(std::atomic<uint32_t>*)userData;
+	value.store(uint32_t(category * 100 + progress) / (xatlas::ProgressCategory::BuildOutputMeshes + 1));
+	return true;
+}
+static void GenerateMeshAtlas(ObjectWindow::AtlasJob& job)
+{
 	xatlas::Atlas* atlas = xatlas::Create();
+	xatlas::SetProgressCallback(atlas, AtlasProgressCallback, &job.progress);
 
 	// Prepare mesh to be processed by xatlas:
 	{
 		xatlas::MeshDecl mesh;
-		mesh.vertexCount = (int)meshcomponent.vertex_positions.size();
-		mesh.vertexPositionData = meshcomponent.vertex_positions.data();
+		mesh.vertexCount = (int)job.positions.size();
+		mesh.vertexPositionData = job.positions.data();
 		mesh.vertexPositionStride = sizeof(float) * 3;
-		if (!meshcomponent.vertex_normals.empty()) {
-			mesh.vertexNormalData = meshcomponent.vertex_normals.data();
+		if (!job.normals.empty()) {
+			mesh.vertexNormalData = job.normals.data();
 			mesh.vertexNormalStride = sizeof(float) * 3;
 		}
-		if (!meshcomponent.vertex_uvset_0.empty()) {
-			mesh.vertexUvData = meshcomponent.vertex_uvset_0.data();
+		if (!job.uvs.empty()) {
+			mesh.vertexUvData = job.uvs.data();
 			mesh.vertexUvStride = sizeof(float) * 2;
 		}
-		mesh.indexCount = (int)meshcomponent.indices.size();
-		mesh.indexData = meshcomponent.indices.data();
+		mesh.indexCount = (int)job.indices.size();
+		mesh.indexData = job.indices.data();
 		mesh.indexFormat = xatlas::IndexFormat::UInt32;
 		xatlas::AddMeshError::Enum error = xatlas::AddMesh(atlas, mesh);
 		if (error != xatlas::AddMeshError::Success) {
-			wiHelper::messageBox(xatlas::StringForEnum(error), "Adding mesh to xatlas failed!");
-			return dim;
+			job.error = xatlas::StringForEnum(error);
+			xatlas::Destroy(atlas);
+			return;
 		}
 	}
 
@@ -103,158 +128,76 @@ static Atlas_Dim GenerateMeshAtlas(MeshComponent& meshcomponent, uint32_t resolu
 		xatlas::ParameterizeOptions parametrizeoptions;
 		xatlas::PackOptions packoptions;
 
-		packoptions.resolution = resolution;
+		packoptions.resolution = job.resolution;
 		packoptions.blockAlign = true;
 
 		xatlas::Generate(atlas, chartoptions, parametrizeoptions, packoptions);
-		dim.width = atlas->width;
-		dim.height = atlas->height;
+		job.width = atlas->width;
+		job.height = atlas->height;
 
-		xatlas::Mesh& mesh = atlas->meshes[0];
+		const xatlas::Mesh& mesh = atlas->meshes[0];
 
-		// Note: we must recreate all vertex buffers, because the index buffer will be different (the atlas could have removed shared vertices)
-		meshcomponent.indices.clear();
-		meshcomponent.indices.resize(mesh.indexCount);
-		std::vector<XMFLOAT3> positions(mesh.vertexCount);
-		std::vector<XMFLOAT2> atlas(mesh.vertexCount);
-		std::vector<XMFLOAT3> normals;
-		std::vector<XMFLOAT4> tangents;
-		std::vector<XMFLOAT2> uvset_0;
-		std::vector<XMFLOAT2> uvset_1;
-		std::vector<uint32_t> colors;
-		std::vector<XMUINT4> boneindices;
-		std::vector<XMFLOAT4> boneweights;
-		if (!meshcomponent.vertex_normals.empty())
-		{
-			normals.resize(mesh.vertexCount);
-		}
-		if (!meshcomponent.vertex_tangents.empty())
-		{
-			tangents.resize(mesh.vertexCount);
-		}
-		if (!meshcomponent.vertex_uvset_0.empty())
-		{
-			uvset_0.resize(mesh.vertexCount);
-		}
-		if (!meshcomponent.vertex_uvset_1.empty())
-		{
-			uvset_1.resize(mesh.vertexCount);
-		}
-		if (!meshcomponent.vertex_colors.empty())
-		{
-			colors.resize(mesh.vertexCount);
-		}
-		if (!meshcomponent.vertex_boneindices.empty())
+		// Note: the atlas can split vertices along the chart seams, so every vertex stream will be remapped with xref
+		job.atlasIndices.assign(mesh.indexArray, mesh.indexArray + mesh.indexCount);
+		job.xrefs.resize(mesh.vertexCount);
+		job.atlas.resize(mesh.vertexCount);
+		for (uint32_t j = 0; j < mesh.vertexCount; ++j)
 		{
-			boneindices.resize(mesh.vertexCount);
-		}
-		if (!meshcomponent.vertex_boneweights.empty())
-		{
-			boneweights.resize(mesh.vertexCount);
+			const xatlas::Vertex& v = mesh.vertexArray[j];
+			job.xrefs[j] = v.xref;
+			job.atlas[j].x = v.uv[0] / float(job.width);
+			job.atlas[j].y = v.uv[1] / float(job.height);
 		}
+	}
 
-		for (uint32_t j = 0; j < mesh.indexCount; ++j)
-		{
-			const uint32_t ind = mesh.indexArray[j];
-			const xatlas::Vertex &v = mesh.vertexArray[ind];
-			meshcomponent.indices[j] = ind;
-			atlas[ind].x = v.uv[0] / float(dim.width);
-			atlas[ind].y = v.uv[1] / float(dim.height);
-			positions[ind] = meshcomponent.vertex_positions[v.xref];
-			if (!normals.empty())
-			{
-				normals[ind] = meshcomponent.vertex_normals[v.xref];
-			}
-			if (!tangents.empty())
-			{
-				tangents[ind] = meshcomponent.vertex_tangents[v.xref];
-			}
-			if (!uvset_0.empty())
-			{
-				uvset_0[ind] = meshcomponent.vertex_uvset_0[v.xref];
-			}
-			if (!uvset_1.empty())
-			{
-				uvset_1[ind] = meshcomponent.vertex_uvset_1[v.xref];
-			}
-			if (!colors.empty())
-			{
-				colors[ind] = meshcomponent.vertex_colors[v.xref];
-			}
-			if (!boneindices.empty())
-			{
-				boneindices[ind] = meshcomponent.vertex_boneindices[v.xref];
-			}
-			if (!boneweights.empty())
-			{
-				boneweights[ind] = meshcomponent.vertex_boneweights[v.xref];
-			}
-		}
+	xatlas::Destroy(atlas);
 
-		meshcomponent.vertex_positions = positions;
-		meshcomponent.vertex_atlas = atlas;
-		if (!normals.empty())
-		{
-			meshcomponent.vertex_normals = normals;
-		}
-		if (!tangents.empty())
-		{
-			meshcomponent.vertex_tangents = tangents;
-		}
-		if (!uvset_0.empty())
-		{
-			meshcomponent.vertex_uvset_0 = uvset_0;
-		}
-		if (!uvset_1.empty())
-		{
-			meshcomponent.vertex_uvset_1 = uvset_1;
-		}
-		if (!colors.empty())
-		{
-			meshcomponent.vertex_colors = colors;
-		}
-		if (!boneindices.empty())
-		{
-			meshcomponent.vertex_boneindices = boneindices;
-		}
-		if (!boneweights.empty())
+	job.success = true;
+	job.progress.store(100);
+
+	// Free the copy of the input:
+	job.positions.clear();
+	job.positions.shrink_to_fit();
+	job.normals.clear();
+	job.normals.shrink_to_fit();
+	job.uvs.clear();
+	job.uvs.shrink_to_fit();
+	job.indices.clear();
+	job.indices.shrink_to_fit();
+}
+
+template<typename T>
+static void RemapAtlasStream(std::vector<T>& stream, const std::vector<uint32_t>& xrefs)
+{
+	if (!stream.empty())
+	{
+		std::vector<T> remapped(xrefs.size());
+		for (size_t i = 0; i < xrefs.size(); ++i)
 		{
-			meshcomponent.vertex_boneweights = boneweights;
+			remapped[i] = stream[xrefs[i]];
 		}
-		meshcomponent.CreateRenderData();
-
+		stream = std::move(remapped);
 	}
-
-	//// DEBUG
-	//{
-	//	const uint32_t width = objectcomponent.lightmapWidth;
-	//	const uint32_t height = objectcomponent.lightmapHeight;
-	//	objectcomponent.lightmapTextureData.resize(width * height * 4);
-	//	const xatlas::OutputMesh *mesh = xatlas::GetOutputMeshes(atlas)[0];
-	//	// Rasterize mesh triangles.
-	//	const uint8_t white[] = { 255, 255, 255 };
-	//	for (uint32_t j = 0; j < mesh->indexCount; j += 3) {
-	//		int verts[3][2];
-	//		uint8_t color[4];
-	//		for (int k = 0; k < 3; k++) {
-	//			const xatlas::OutputVertex &v = mesh->vertexArray[mesh->indexArray[j + k]];
-	//			verts[k][0] = int(v.uv[0]);
-	//			verts[k][1] = int(v.uv[1]);
-	//			color[k] = rand() % 255;
-	//		}
-	//		color[3] = 255;
-	//		if (!verts[0][0] && !verts[0][1] && !verts[1][0] && !verts[1][1] && !verts[2][0] && !verts[2][1])
-	//			continue; // Skip triangles that weren't atlased.
-	//		RasterizeTriangle(objectcomponent.lightmapTextureData.data(), width, verts[0], verts[1], verts[2], color);
-	//		RasterizeLine(objectcomponent.lightmapTextureData.data(), width, verts[0], verts[1], white);
-	//		RasterizeLine(objectcomponent.lightmapTextureData.data(), width, verts[1], verts[2], white);
-	//		RasterizeLine(objectcomponent.lightmapTextureData.data(), width, verts[2], verts[0], white);
-	//	}
-	//}
-
-	xatlas::Destroy(atlas);
-
-	return dim;
+}
+static void ApplyMeshAtlas(MeshComponent& mesh, const ObjectWindow::AtlasJob& job)
+{
+	RemapAtlasStream(mesh.vertex_positions, job.xrefs);
+	RemapAtlasStream(mesh.vertex_normals, job.xrefs);
+	RemapAtlasStream(mesh.vertex_tangents, job.xrefs);
+	RemapAtlasStream(mesh.vertex_uvset_0, job.xrefs);
+	RemapAtlasStream(mesh.vertex_uvset_1, job.xrefs);
+	RemapAtlasStream(mesh.vertex_colors, job.xrefs);
+	RemapAtlasStream(mesh.vertex_boneindices, job.xrefs);
+	RemapAtlasStream(mesh.vertex_boneweights, job.xrefs);
+	RemapAtlasStream(mesh.vertex_windweights, job.xrefs);
+	for (auto& target : mesh.targets)
+	{
+		RemapAtlasStream(target.vertex_positions, job.xrefs);
+		RemapAtlasStream(target.vertex_normals, job.xrefs);
+	}
+	mesh.indices = job.atlasIndices;
+	mesh.vertex_atlas = job.atlas;
+	mesh.CreateRenderData();
 }
 
 
@@ -651,8 +594,14 @@ void ObjectWindow::Create(EditorComponent* editor)
 		};
 		UV_GEN_TYPE gen_type = (UV_GEN_TYPE)lightmapSourceUVSetComboBox.GetSelected();
 
-		std::unordered_set<ObjectComponent*> gen_objects;
-		std::unordered_map<MeshComponent*, Atlas_Dim> gen_meshes;
+		if (!atlasJobs.empty())
+		{
+			wiBackLog::post("Lightmap atlas generation is already in progress");
+			return;
+		}
+
+		std::unordered_set<Entity> gen_objects;
+		std::unordered_set<Entity> gen_meshes;
 
 		for (auto& x : this->editor->translator.selected)
 		{
@@ -663,18 +612,40 @@ void ObjectWindow::Create(EditorComponent* editor)
 
 				if (meshcomponent != nullptr)
 				{
-					gen_objects.insert(objectcomponent);
-					gen_meshes[meshcomponent] = Atlas_Dim();
+					gen_objects.insert(x.entity);
+					gen_meshes.insert(objectcomponent->meshID);
 				}
 			}
 
 		}
 
-		wiJobSystem::context ctx;
+		if (gen_type == UV_GEN_GENERATE_ATLAS)
+		{
+			// Every mesh is an independent job, the results are applied by Update() when all of them finished:
+			for (Entity meshID : gen_meshes)
+			{
+				const MeshComponent& mesh = *scene.meshes.GetComponent(meshID);
+				auto job = std::make_shared<AtlasJob>();
+				job->meshID = meshID;
+				job->resolution = (uint32_t)lightmapResolutionSlider.GetValue();
+				job->vertexCount = mesh.vertex_positions.size();
+				job->positions = mesh.vertex_positions;
+				job->normals = mesh.vertex_normals;
+				job->uvs = mesh.vertex_uvset_0;
+				job->indices = mesh.indices;
+				atlasJobs.push_back(job);
+
+				wiJobSystem::Execute(atlasJobContext, [job](wiJobArgs args) {
+					GenerateMeshAtlas(*job);
+				});
+			}
+			atlasObjects.assign(gen_objects.begin(), gen_objects.end());
+			return;
+		}
 
-		for (auto& it : gen_meshes)
+		for (Entity meshID : gen_meshes)
 		{
-			MeshComponent& mesh = *it.first;
+			MeshComponent& mesh = *scene.meshes.GetComponent(meshID);
 			if (gen_type == UV_GEN_COPY_UVSET_0)
 			{
 				mesh.vertex_atlas = mesh.vertex_uvset_0;
@@ -685,29 +656,14 @@ void ObjectWindow::Create(EditorComponent* editor)
 				mesh.vertex_atlas = mesh.vertex_uvset_1;
 				mesh.CreateRenderData();
 			}
-			else if (gen_type == UV_GEN_GENERATE_ATLAS)
-			{
-				wiJobSystem::Execute(ctx, [&](wiJobArgs args) {
-					it.second = GenerateMeshAtlas(mesh, (uint32_t)lightmapResolutionSlider.GetValue());
-				});
-			}
 		}
-		wiJobSystem::Wait(ctx);
 
-		for (auto& x : gen_objects)
+		for (Entity entity : gen_objects)
 		{
-			x->ClearLightmap();
-			MeshComponent* meshcomponent = scene.meshes.GetComponent(x->meshID);
-			if (gen_type == UV_GEN_GENERATE_ATLAS)
-			{
-				x->lightmapWidth = gen_meshes.at(meshcomponent).width;
-				x->lightmapHeight = gen_meshes.at(meshcomponent).height;
-			}
-			else
-			{
-				x->lightmapWidth = x->lightmapHeight = (uint32_t)lightmapResolutionSlider.GetValue();
-			}
-			x->SetLightmapRenderRequest(true);
+			ObjectComponent& object = *scene.objects.GetComponent(entity);
+			object.ClearLightmap();
+			object.lightmapWidth = object.lightmapHeight = (uint32_t)lightmapResolutionSlider.GetValue();
+			object.SetLightmapRenderRequest(true);
 		}
 
 		scene.SetAccelerationStructureUpdateRequested(true);
@@ -756,6 +712,19 @@ void ObjectWindow::Create(EditorComponent* editor)
 	});
 	AddWidget(&clearLightmapButton);
 
+	bakeChangedLightmapsButton.Create("Bake Changed Lightmaps");
+	bakeChangedLightmapsButton.SetTooltip("Start baking the lightmaps again for every object in the scene that moved or whose mesh changed since its lightmap was baked.\nChanges of the surroundings are not detected.");
+	bakeChangedLightmapsButton.SetPos(XMFLOAT2(x, y += step));
+	bakeChangedLightmapsButton.SetSize(XMFLOAT2(140, hei));
+	bakeChangedLightmapsButton.OnClick([&](wiEventArgs args) {
+
+		Scene& scene = wiScene::GetScene();
+		uint32_t count = scene.RequestLightmapBake(true);
+		wiBackLog::post(("Lightmap bake started for " + std::to_string(count) + " changed objects").c_str());
+
+	});
+	AddWidget(&bakeChangedLightmapsButton);
+
 	y = 10;
 
 	colorComboBox.Create("Color picker mode: ");
@@ -799,6 +768,69 @@ void ObjectWindow::Create(EditorComponent* editor)
 }
 
 
+void ObjectWindow::Update()
+{
+	if (atlasJobs.empty())
+	{
+		return;
+	}
+
+	if (wiJobSystem::IsBusy(atlasJobContext))
+	{
+		uint32_t progress = 0;
+		for (auto& job : atlasJobs)
+		{
+			progress += job->progress.load();
+		}
+		progress /= (uint32_t)atlasJobs.size();
+		generateLightmapButton.SetText("Generating UV: " + std::to_string(progress) + "%");
+		return;
+	}
+
+	Scene& scene = wiScene::GetScene();
+
+	std::unordered_map<Entity, const AtlasJob*> results;
+	for (auto& job : atlasJobs)
+	{
+		if (!job->success)
+		{
+			wiBackLog::post(("Adding mesh to xatlas failed: " + job->error).c_str());
+			continue;
+		}
+		MeshComponent* mesh = scene.meshes.GetComponent(job->meshID);
+		if (mesh == nullptr || mesh->vertex_positions.size() != job->vertexCount)
+		{
+			continue; // the mesh was removed or changed while the atlas was generated
+		}
+		ApplyMeshAtlas(*mesh, *job);
+		results[job->meshID] = job.get();
+	}
+
+	for (Entity entity : atlasObjects)
+	{
+		ObjectComponent* object = scene.objects.GetComponent(entity);
+		if (object == nullptr)
+		{
+			continue;
+		}
+		auto it = results.find(object->meshID);
+		if (it == results.end())
+		{
+			continue;
+		}
+		object->ClearLightmap();
+		object->lightmapWidth = it->second->width;
+		object->lightmapHeight = it->second->height;
+		object->SetLightmapRenderRequest(true);
+	}
+
+	scene.SetAccelerationStructureUpdateRequested(true);
+
+	atlasJobs.clear();
+	atlasObjects.clear();
+	generateLightmapButton.SetText("Generate Lightmap");
+}
+
 void ObjectWindow::SetEntity(Entity entity)
 {
 	if (this->entity == entity)
@@ -11,6 +11,14 @@ public:
 	EditorComponent* editor;
 	wiECS::Entity entity;
 	void SetEntity(wiECS::Entity entity);
+	// Applies the results of the lightmap atlas generation when its jobs are finished
+	void Update();
+
+	// The lightmap atlas of every mesh is generated by a background job while the editor keeps running
+	struct AtlasJob;
+	std::vector<std::shared_ptr<AtlasJob>> atlasJobs;
+	std::vector<wiECS::Entity> atlasObjects; // the lightmaps of these objects are rendered when the atlases are ready
+	wiJobSystem::context atlasJobContext;
 
 	wiLabel nameLabel;
 	wiCheckBox renderableCheckBox;
@@ -39,5 +47,6 @@ public:
 	wiButton generateLightmapButton;
 	wiButton stopLightmapGenButton;
 	wiButton clearLightmapButton;
+	wiButton bakeChangedLightmapsButton;
 };
 
@@ -904,6 +904,88 @@ void PaintToolWindow::SetEntity(wiECS::Entity value, int subsetindex)
 	}
 }
 
+template<typename T>
+void SnapshotHistory(std::vector<uint8_t>& snapshot, const std::vector<T>& data)
+{
+	snapshot.resize(sizeof(T) * data.size());
+	if (!snapshot.empty())
+	{
+		memcpy(snapshot.data(), data.data(), snapshot.size());
+	}
+}
+// Writes the ranges of elements that differ from the snapshot, with their values before and after the stroke
+template<typename T>
+void WriteHistoryDelta(wiArchive& archive, const std::vector<uint8_t>& snapshot, const std::vector<T>& data)
+{
+	const T* undo_data = (const T*)snapshot.data();
+	const size_t undo_count = snapshot.size() / sizeof(T);
+	const size_t redo_count = data.size();
+	const size_t common_count = std::min(undo_count, redo_count);
+
+	// Changes that are closer than this are stored in the same range, so that the range headers don't outweigh the data:
+	static constexpr size_t merge_distance = 8;
+	std::vector<std::pair<size_t, size_t>> ranges; // offset, count
+	for (size_t i = 0; i < common_count; ++i)
+	{
+		if (memcmp(&undo_data[i], &data[i], sizeof(T)) != 0)
+		{
+			if (!ranges.empty() && i - (ranges.back().first + ranges.back().second) <= merge_distance)
+			{
+				ranges.back().second = i + 1 - ranges.back().first;
+			}
+			else
+			{
+				ranges.emplace_back(i, 1);
+			}
+		}
+	}
+
+	archive << (uint64_t)undo_count;
+	archive << (uint64_t)redo_count;
+	archive << (uint64_t)ranges.size();
+	for (auto& range : ranges)
+	{
+		archive << (uint64_t)range.first;
+		archive << (uint64_t)range.second;
+		archive.WriteData((const uint8_t*)(undo_data + range.first), sizeof(T) * range.second);
+		archive.WriteData((const uint8_t*)(data.data() + range.first), sizeof(T) * range.second);
+	}
+
+	// The elements that only exist before or after the stroke are stored entirely:
+	archive.WriteData((const uint8_t*)(undo_data + common_count), sizeof(T) * (undo_count - common_count));
+	archive.WriteData((const uint8_t*)(data.data() + common_count), sizeof(T) * (redo_count - common_count));
+}
+template<typename T>
+void ApplyHistoryDelta(wiArchive& archive, std::vector<T>& data, bool undo)
+{
+	uint64_t undo_count;
+	archive >> undo_count;
+	uint64_t redo_count;
+	archive >> redo_count;
+	uint64_t range_count;
+	archive >> range_count;
+	const size_t common_count = (size_t)std::min(undo_count, redo_count);
+
+	data.resize(undo ? (size_t)undo_count : (size_t)redo_count);
+	for (uint64_t i = 0; i < range_count; ++i)
+	{
+		uint64_t offset;
+		archive >> offset;
+		uint64_t count;
+		archive >> count;
+		const uint8_t* undo_data = archive.ReadData(sizeof(T) * count);
+		const uint8_t* redo_data = archive.ReadData(sizeof(T) * count);
+		memcpy(data.data() + offset, undo ? undo_data : redo_data, sizeof(T) * count);
+	}
+
+	const uint8_t* undo_tail = archive.ReadData(sizeof(T) * (undo_count - common_count));
+	const uint8_t* redo_tail = archive.ReadData(sizeof(T) * (redo_count - common_count));
+	if (data.size() > common_count)
+	{
+		memcpy(data.data() + common_count, undo ? undo_tail : redo_tail, sizeof(T) * (data.size() - common_count));
+	}
+}
+
 void PaintToolWindow::RecordHistory(bool start, CommandList cmd)
 {
 	if (start)
@@ -993,7 +1075,14 @@ void PaintToolWindow::RecordHistory(bool start, CommandList cmd)
 		if (mesh == nullptr)
 			break;
 
-		archive << mesh->vertex_colors;
+		if (start)
+		{
+			SnapshotHistory(history_snapshots[0], mesh->vertex_colors);
+		}
+		else
+		{
+			WriteHistoryDelta(archive, history_snapshots[0], mesh->vertex_colors);
+		}
 	}
 	break;
 	case PaintToolWindow::MODE_WIND:
@@ -1006,7 +1095,14 @@ void PaintToolWindow::RecordHistory(bool start, CommandList cmd)
 		if (mesh == nullptr)
 			break;
 
-		archive << mesh->vertex_windweights;
+		if (start)
+		{
+			SnapshotHistory(history_snapshots[0], mesh->vertex_windweights);
+		}
+		else
+		{
+			WriteHistoryDelta(archive, history_snapshots[0], mesh->vertex_windweights);
+		}
 	}
 	break;
 	case PaintToolWindow::MODE_SCULPTING_ADD:
@@ -1020,8 +1116,16 @@ void PaintToolWindow::RecordHistory(bool start, CommandList cmd)
 		if (mesh == nullptr)
 			break;
 
-		archive << mesh->vertex_positions;
-		archive << mesh->vertex_normals;
+		if (start)
+		{
+			SnapshotHistory(history_snapshots[0], mesh->vertex_positions);
+			SnapshotHistory(history_snapshots[1], mesh->vertex_normals);
+		}
+		else
+		{
+			WriteHistoryDelta(archive, history_snapshots[0], mesh->vertex_positions);
+			WriteHistoryDelta(archive, history_snapshots[1], mesh->vertex_normals);
+		}
 	}
 	break;
 	case PaintToolWindow::MODE_SOFTBODY_PINNING:
@@ -1035,7 +1139,14 @@ void PaintToolWindow::RecordHistory(bool start, CommandList cmd)
 		if (softbody == nullptr)
 			break;
 
-		archive << softbody->weights;
+		if (start)
+		{
+			SnapshotHistory(history_snapshots[0], softbody->weights);
+		}
+		else
+		{
+			WriteHistoryDelta(archive, history_snapshots[0], softbody->weights);
+		}
 	}
 	break;
 	case PaintToolWindow::MODE_HAIRPARTICLE_ADD_TRIANGLE:
@@ -1046,13 +1157,29 @@ void PaintToolWindow::RecordHistory(bool start, CommandList cmd)
 		if (hair == nullptr)
 			break;
 
-		archive << hair->vertex_lengths;
+		if (start)
+		{
+			SnapshotHistory(history_snapshots[0], hair->vertex_lengths);
+		}
+		else
+		{
+			WriteHistoryDelta(archive, history_snapshots[0], hair->vertex_lengths);
+		}
 	}
 	break;
 	default:
 		assert(0);
 		break;
 	}
+
+	if (!start)
+	{
+		for (auto& x : history_snapshots)
+		{
+			x.clear();
+			x.shrink_to_fit();
+		}
+	}
 }
 void PaintToolWindow::ConsumeHistoryOperation(wiArchive& archive, bool undo)
 {
@@ -1113,19 +1240,7 @@ void PaintToolWindow::ConsumeHistoryOperation(wiArchive& archive, bool undo)
 		if (mesh == nullptr)
 			break;
 
-		MeshComponent undo_mesh;
-		archive >> undo_mesh.vertex_colors;
-		MeshComponent redo_mesh;
-		archive >> redo_mesh.vertex_colors;
-
-		if (undo)
-		{
-			mesh->vertex_colors = undo_mesh.vertex_colors;
-		}
-		else
-		{
-			mesh->vertex_colors = redo_mesh.vertex_colors;
-		}
+		ApplyHistoryDelta(archive, mesh->vertex_colors, undo);
 
 		mesh->CreateRenderData();
 	}
@@ -1140,19 +1255,7 @@ void PaintToolWindow::ConsumeHistoryOperation(wiArchive& archive, bool undo)
 		if (mesh == nullptr)
 			break;
 
-		MeshComponent undo_mesh;
-		archive >> undo_mesh.vertex_windweights;
-		MeshComponent redo_mesh;
-		archive >> redo_mesh.vertex_windweights;
-
-		if (undo)
-		{
-			mesh->vertex_windweights = undo_mesh.vertex_windweights;
-		}
-		else
-		{
-			mesh->vertex_windweights = redo_mesh.vertex_windweights;
-		}
+		ApplyHistoryDelta(archive, mesh->vertex_windweights, undo);
 
 		mesh->CreateRenderData();
 	}
@@ -1168,23 +1271,8 @@ void PaintToolWindow::ConsumeHistoryOperation(wiArchive& archive, bool undo)
 		if (mesh == nullptr)
 			break;
 
-		MeshComponent undo_mesh;
-		archive >> undo_mesh.vertex_positions;
-		archive >> undo_mesh.vertex_normals;
-		MeshComponent redo_mesh;
-		archive >> redo_mesh.vertex_positions;
-		archive >> redo_mesh.vertex_normals;
-
-		if (undo)
-		{
-			mesh->vertex_positions = undo_mesh.vertex_positions;
-			mesh->vertex_normals = undo_mesh.vertex_normals;
-		}
-		else
-		{
-			mesh->vertex_positions = redo_mesh.vertex_positions;
-			mesh->vertex_normals = redo_mesh.vertex_normals;
-		}
+		ApplyHistoryDelta(archive, mesh->vertex_positions, undo);
+		ApplyHistoryDelta(archive, mesh->vertex_normals, undo);
 
 		mesh->CreateRenderData();
 	}
@@ -1200,19 +1288,7 @@ void PaintToolWindow::ConsumeHistoryOperation(wiArchive& archive, bool undo)
 		if (softbody == nullptr)
 			break;
 
-		SoftBodyPhysicsComponent undo_softbody;
-		archive >> undo_softbody.weights;
-		SoftBodyPhysicsComponent redo_softbody;
-		archive >> redo_softbody.weights;
-
-		if (undo)
-		{
-			softbody->weights = undo_softbody.weights;
-		}
-		else
-		{
-			softbody->weights = redo_softbody.weights;
-		}
+		ApplyHistoryDelta(archive, softbody->weights, undo);
 
 		softbody->_flags |= SoftBodyPhysicsComponent::FORCE_RESET;
 	}
@@ -1225,19 +1301,7 @@ void PaintToolWindow::ConsumeHistoryOperation(wiArchive& archive, bool undo)
 		if (hair == nullptr)
 			break;
 
-		wiHairParticle undo_hair;
-		archive >> undo_hair.vertex_lengths;
-		wiHairParticle redo_hair;
-		archive >> redo_hair.vertex_lengths;
-
-		if (undo)
-		{
-			hair->vertex_lengths = undo_hair.vertex_lengths;
-		}
-		else
-		{
-			hair->vertex_lengths = redo_hair.vertex_lengths;
-		}
+		ApplyHistoryDelta(archive, hair->vertex_lengths, undo);
 
 		hair->_flags |= wiHairParticle::REBUILD_BUFFERS;
 	}
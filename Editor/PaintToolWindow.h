@@ -11,6 +11,7 @@ class PaintToolWindow : public wiWindow
 	bool history_needs_recording_end = false;
 	size_t history_textureIndex = 0;
 	std::vector<wiGraphics::Texture> history_textures; // we'd like to keep history textures in GPU memory to avoid GPU readback
+	std::vector<uint8_t> history_snapshots[2]; // the painted vertex data at the start of the stroke, the history only stores the ranges that changed
 	wiGraphics::Texture GetEditTextureSlot(const wiScene::MaterialComponent& material, int* uvset = nullptr);
 	void ReplaceEditTextureSlot(wiScene::MaterialComponent& material, const wiGraphics::Texture& texture);
 public:
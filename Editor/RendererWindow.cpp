@@ -207,6 +207,16 @@ void RendererWindow::Create(EditorComponent* editor)
 	AddWidget(&tessellationCheckBox);
 	tessellationCheckBox.SetEnabled(wiRenderer::GetDevice()->CheckCapability(wiGraphics::GRAPHICSDEVICE_CAPABILITY_TESSELLATION));
 
+	overdrawCheckBox.Create("Overdraw Heatmap: ");
+	overdrawCheckBox.SetTooltip("Toggle visualization of the rasterized layers of every pixel, without depth testing (red is 8 or more layers)");
+	overdrawCheckBox.SetPos(XMFLOAT2(x, y += step));
+	overdrawCheckBox.SetSize(XMFLOAT2(itemheight, itemheight));
+	overdrawCheckBox.OnClick([](wiEventArgs args) {
+		wiRenderer::SetDebugOverdraw(args.bValue);
+	});
+	overdrawCheckBox.SetCheck(wiRenderer::GetDebugOverdraw());
+	AddWidget(&overdrawCheckBox);
+
 	speedMultiplierSlider.Create(0, 4, 1, 100000, "Speed: ");
 	speedMultiplierSlider.SetTooltip("Adjust the global speed (time multiplier)");
 	speedMultiplierSlider.SetSize(XMFLOAT2(100, itemheight));
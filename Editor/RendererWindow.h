@@ -47,6 +47,7 @@ public:
 	wiCheckBox advancedLightCullingCheckBox;
 	wiCheckBox debugLightCullingCheckBox;
 	wiCheckBox tessellationCheckBox;
+	wiCheckBox overdrawCheckBox;
 	wiCheckBox envProbesCheckBox;
 	wiCheckBox gridHelperCheckBox;
 	wiCheckBox cameraVisCheckBox;
@@ -92,12 +92,7 @@ void SoundWindow::Create(EditorComponent* editor)
 	nameField.SetPos(XMFLOAT2(x, y += step));
 	nameField.SetSize(XMFLOAT2(300, hei));
 	nameField.OnInputAccepted([=](wiEventArgs args) {
-		NameComponent* name = wiScene::GetScene().names.GetComponent(entity);
-		if (name == nullptr)
-		{
-			name = &wiScene::GetScene().names.Create(entity);
-		}
-		*name = args.sValue;
+		wiScene::GetScene().Entity_SetName(entity, args.sValue);
 
 		editor->RefreshSceneGraphView();
 	});
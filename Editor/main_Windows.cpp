@@ -249,7 +249,9 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 			wiBackLog::post("[Shader check] Started...");
 			if (wiShaderCompiler::CheckRegisteredShadersOutdated())
 			{
-				wiBackLog::post("[Shader check] Changes detected, initiating reload...");
+				wiBackLog::post("[Shader check] Changes detected, compiling...");
+				const uint32_t compiled = wiRenderer::CompileOutdatedShaders();
+				wiBackLog::post(("[Shader check] " + std::to_string(compiled) + " shaders compiled, initiating reload...").c_str());
 				wiEvent::Subscribe_Once(SYSTEM_EVENT_THREAD_SAFE_POINT, [](uint64_t userdata) {
 					wiRenderer::ReloadShaders();
 				});
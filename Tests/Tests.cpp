@@ -5,6 +5,9 @@
 #include <sstream>
 #include <fstream>
 #include <thread>
+#include <algorithm>
+#include <cmath>
+#include <random>
 
 using namespace wiECS;
 using namespace wiScene;
@@ -13,6 +16,14 @@ void Tests::Initialize()
 {
     MainComponent::Initialize();
 
+	if (BenchmarkRenderer::IsRequested())
+	{
+		benchmark.init(canvas);
+		benchmark.Load();
+		ActivatePath(&benchmark);
+		return;
+	}
+
 	infoDisplay.active = true;
 	infoDisplay.watermark = true;
 	infoDisplay.fpsinfo = true;
@@ -120,6 +131,8 @@ void TestsRenderer::Load()
 	testSelector.AddItem("Controller Test");
 	testSelector.AddItem("Inverse Kinematics");
 	testSelector.AddItem("65k Instances");
+	testSelector.AddItem("Core Benchmarks");
+	testSelector.AddItem("GPU Sort Benchmark");
 	testSelector.SetMaxVisibleItemCount(10);
 	testSelector.OnSelect([=](wiEventArgs args) {
 
@@ -293,6 +306,14 @@ void TestsRenderer::Load()
 		}
 		break;
 
+		case 19:
+			RunCoreBenchmarkTest();
+			break;
+
+		case 20:
+			RunGPUSortBenchmarkTest();
+			break;
+
 		default:
 			assert(0);
 			break;
@@ -366,6 +387,9 @@ void TestsRenderer::Update(float dt)
 		}
 	}
 	break;
+	case 20:
+		UpdateGPUSortBenchmark();
+		break;
 	}
 
     RenderPath3D::Update(dt);
@@ -903,3 +927,676 @@ void TestsRenderer::RunNetworkTest()
 	font.params.size = 24;
 	AddFont(&font);
 }
+
+bool BenchmarkRenderer::IsRequested()
+{
+	return !wiStartupArguments::GetArgumentValue("benchmark").empty() || wiStartupArguments::HasArgument("core_benchmark");
+}
+void BenchmarkRenderer::Load()
+{
+	scenefile = wiStartupArguments::GetArgumentValue("benchmark");
+	core = scenefile.empty();
+	std::string value = wiStartupArguments::GetArgumentValue("benchmark_warmup");
+	if (!value.empty())
+	{
+		warmupFrames = (uint32_t)std::max(0, std::atoi(value.c_str()));
+	}
+	value = wiStartupArguments::GetArgumentValue("benchmark_frames");
+	if (!value.empty())
+	{
+		measuredFrames = (uint32_t)std::max(1, std::atoi(value.c_str()));
+	}
+	value = wiStartupArguments::GetArgumentValue("benchmark_output");
+	if (!value.empty())
+	{
+		outputfile = value;
+	}
+	value = wiStartupArguments::GetArgumentValue("benchmark_budget");
+	if (!value.empty())
+	{
+		budget = (float)std::atof(value.c_str());
+	}
+
+	// Measure the rendering as fast as it can go:
+	wiEvent::SetVSync(false);
+	wiProfiler::SetEnabled(true);
+	wiProfiler::SetPassTimingEnabled(true);
+
+	frameTimes.reserve(measuredFrames);
+	gpuFrameTimes.reserve(measuredFrames);
+
+	RenderPath3D::Load();
+}
+void BenchmarkRenderer::Update(float dt)
+{
+	if (core && !finished)
+	{
+		std::vector<CoreBenchmarkResult> results;
+		RunCoreBenchmarks(results);
+		finished = true;
+		if (!WriteCoreResults(results))
+		{
+			wiBackLog::post(("[Benchmark] failed to write " + outputfile).c_str());
+			exitCode = BENCHMARK_WRITE_FAILED;
+		}
+		RenderPath3D::Update(dt);
+		return;
+	}
+	if (frame == 0 && !finished)
+	{
+		// The scene is loaded in the first update, when the engine initialization is surely finished:
+		wiScene::LoadModel(scenefile);
+		if (wiScene::GetScene().objects.GetCount() == 0)
+		{
+			wiBackLog::post(("[Benchmark] no objects were loaded from " + scenefile).c_str());
+			finished = true;
+			exitCode = BENCHMARK_LOAD_FAILED;
+		}
+	}
+	if (finished)
+	{
+		RenderPath3D::Update(dt);
+		return;
+	}
+
+	// The bounds are known after the first scene update:
+	if (frame > 0)
+	{
+		UpdateCamera();
+	}
+
+	RenderPath3D::Update(dt);
+
+	if (frame == 0)
+	{
+		bounds = wiScene::GetScene().bounds;
+	}
+	else if (frame > warmupFrames)
+	{
+		Measure(dt);
+	}
+	frame++;
+
+	if (frame > warmupFrames + measuredFrames)
+	{
+		finished = true;
+		if (!WriteResults())
+		{
+			wiBackLog::post(("[Benchmark] failed to write " + outputfile).c_str());
+			exitCode = BENCHMARK_WRITE_FAILED;
+		}
+	}
+}
+void BenchmarkRenderer::UpdateCamera()
+{
+	// One orbit around the scene during the measured frames, the warmup frames are rendered from the starting point:
+	const float t = frame <= warmupFrames ? 0 : float(frame - warmupFrames) / float(measuredFrames);
+	const float angle = t * XM_2PI;
+	const XMFLOAT3 center = bounds.getCenter();
+	const XMFLOAT3 halfwidth = bounds.getHalfWidth();
+	const float radius = std::max(1.0f, XMVectorGetX(XMVector3Length(XMLoadFloat3(&halfwidth))) * 1.5f);
+
+	XMVECTOR C = XMLoadFloat3(&center);
+	XMVECTOR E = C + XMVectorSet(std::sin(angle) * radius, radius * 0.3f, -std::cos(angle) * radius, 0);
+
+	CameraComponent& camera = wiScene::GetCamera();
+	XMStoreFloat3(&camera.Eye, E);
+	XMStoreFloat3(&camera.At, XMVector3Normalize(C - E));
+	camera.Up = XMFLOAT3(0, 1, 0);
+	camera.UpdateCamera();
+}
+void BenchmarkRenderer::Measure(float dt)
+{
+	frameTimes.push_back(dt * 1000.0f);
+	gpuFrameTimes.push_back(wiProfiler::GetGPUFrameTime());
+
+	wiProfiler::GetCPURangeTimes(passTimes);
+	for (auto& x : passTimes)
+	{
+		cpuRanges[x.name].push_back(x.time);
+	}
+	wiProfiler::GetPassTimes(passTimes);
+	for (auto& x : passTimes)
+	{
+		gpuPasses[x.name].push_back(x.time);
+	}
+}
+
+namespace
+{
+	float Percentile(const std::vector<float>& sorted, float percent)
+	{
+		if (sorted.empty())
+			return 0;
+		const size_t rank = (size_t)std::ceil(percent / 100.0f * sorted.size());
+		return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+	}
+	void WriteJSONString(std::ofstream& file, const std::string& value)
+	{
+		file << '"';
+		for (char c : value)
+		{
+			if (c == '"' || c == '\\')
+			{
+				file << '\\';
+			}
+			file << c;
+		}
+		file << '"';
+	}
+	void WriteSamples(std::ofstream& file, std::vector<float> samples)
+	{
+		std::sort(samples.begin(), samples.end());
+		double sum = 0;
+		for (float x : samples)
+		{
+			sum += x;
+		}
+		file << "{ \"samples\": " << samples.size();
+		file << ", \"avg\": " << (samples.empty() ? 0 : sum / samples.size());
+		file << ", \"p50\": " << Percentile(samples, 50);
+		file << ", \"p90\": " << Percentile(samples, 90);
+		file << ", \"p95\": " << Percentile(samples, 95);
+		file << ", \"p99\": " << Percentile(samples, 99);
+		file << ", \"max\": " << (samples.empty() ? 0 : samples.back());
+		file << " }";
+	}
+	void WriteSampleMap(std::ofstream& file, const std::unordered_map<std::string, std::vector<float>>& samples)
+	{
+		// sorted by name, so that the files of different runs can be compared line by line:
+		std::vector<const std::pair<const std::string, std::vector<float>>*> sorted;
+		for (auto& x : samples)
+		{
+			sorted.push_back(&x);
+		}
+		std::sort(sorted.begin(), sorted.end(), [](auto a, auto b) { return a->first < b->first; });
+
+		file << "{";
+		for (size_t i = 0; i < sorted.size(); ++i)
+		{
+			file << (i > 0 ? "," : "") << std::endl << "\t\t";
+			WriteJSONString(file, sorted[i]->first);
+			file << ": ";
+			WriteSamples(file, sorted[i]->second);
+		}
+		file << std::endl << "\t}";
+	}
+}
+bool BenchmarkRenderer::WriteResults()
+{
+	std::vector<float> sorted = frameTimes;
+	std::sort(sorted.begin(), sorted.end());
+	float frame_p95 = Percentile(sorted, 95);
+	sorted = gpuFrameTimes;
+	std::sort(sorted.begin(), sorted.end());
+	frame_p95 = std::max(frame_p95, Percentile(sorted, 95));
+	const bool over_budget = budget > 0 && frame_p95 > budget;
+
+	std::ofstream file(outputfile);
+	if (!file.is_open())
+		return false;
+
+	file << "{" << std::endl;
+	file << "\t\"scene\": ";
+	WriteJSONString(file, scenefile);
+	file << "," << std::endl;
+	file << "\t\"warmup_frames\": " << warmupFrames << "," << std::endl;
+	file << "\t\"measured_frames\": " << measuredFrames << "," << std::endl;
+	file << "\t\"budget\": " << budget << "," << std::endl;
+	file << "\t\"result\": \"" << (over_budget ? "over_budget" : "success") << "\"," << std::endl;
+	file << "\t\"frame_cpu\": ";
+	WriteSamples(file, frameTimes);
+	file << "," << std::endl;
+	file << "\t\"frame_gpu\": ";
+	WriteSamples(file, gpuFrameTimes);
+	file << "," << std::endl;
+	file << "\t\"cpu_ranges\": ";
+	WriteSampleMap(file, cpuRanges);
+	file << "," << std::endl;
+	file << "\t\"gpu_passes\": ";
+	WriteSampleMap(file, gpuPasses);
+	file << std::endl << "}" << std::endl;
+	if (file.fail())
+		return false;
+	file.close();
+
+	std::stringstream ss;
+	ss << "[Benchmark] frame time p95: " << frame_p95 << " ms, results written to " << outputfile;
+	wiBackLog::post(ss.str().c_str());
+
+	if (over_budget)
+	{
+		exitCode = BENCHMARK_OVER_BUDGET;
+	}
+	return true;
+}
+bool BenchmarkRenderer::WriteCoreResults(const std::vector<CoreBenchmarkResult>& results) const
+{
+	std::ofstream file(outputfile);
+	if (!file.is_open())
+		return false;
+
+	file << "{" << std::endl;
+	file << "\t\"job_system_threads\": " << wiJobSystem::GetThreadCount() << "," << std::endl;
+	file << "\t\"core_benchmarks\": [";
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const CoreBenchmarkResult& result = results[i];
+		file << (i > 0 ? "," : "") << std::endl << "\t\t{ \"name\": ";
+		WriteJSONString(file, result.name);
+		file << ", \"milliseconds\": " << result.time;
+		file << ", \"count\": " << result.count;
+		file << ", \"unit\": ";
+		WriteJSONString(file, result.unit);
+		file << ", \"per_second\": " << (result.time > 0 ? result.count / result.time * 1000.0 : 0);
+		file << " }";
+	}
+	file << std::endl << "\t]" << std::endl << "}" << std::endl;
+	if (file.fail())
+		return false;
+
+	wiBackLog::post(("[Benchmark] core benchmark results written to " + outputfile).c_str());
+	return true;
+}
+
+volatile float benchmark_sink = 0;
+void RunCoreBenchmarks(std::vector<CoreBenchmarkResult>& results)
+{
+	results.clear();
+	wiTimer timer;
+	std::mt19937 rng(7);
+	auto add = [&](const std::string& name, double time, double count, const char* unit) {
+		CoreBenchmarkResult& result = results.emplace_back();
+		result.name = name;
+		result.time = time;
+		result.count = count;
+		result.unit = unit;
+	};
+	float sink = 0; // results of the measured loops are accumulated, so they are not optimized away
+
+	// Job system: Dispatch() with different group sizes for tiny jobs, and the overhead of a dispatch that has nothing to do
+	//	The thread count is fixed when the job system is initialized, so it is reported instead of varied
+	{
+		const uint32_t itemCount = 1000000;
+		const std::string threads = std::to_string(wiJobSystem::GetThreadCount()) + " threads";
+		std::vector<float> data(itemCount);
+		wiJobSystem::context ctx;
+		for (uint32_t groupSize : { 1u, 64u, 1024u, 16384u })
+		{
+			timer.record();
+			wiJobSystem::Dispatch(ctx, itemCount, groupSize, [&](wiJobArgs args) {
+				data[args.jobIndex] = std::sqrt(float(args.jobIndex));
+			});
+			wiJobSystem::Wait(ctx);
+			add("wiJobSystem::Dispatch: 1M jobs, group size " + std::to_string(groupSize) + ", " + threads, timer.elapsed(), itemCount, "jobs");
+		}
+		sink += data.back();
+
+		const uint32_t dispatchCount = 1000;
+		timer.record();
+		for (uint32_t i = 0; i < dispatchCount; ++i)
+		{
+			wiJobSystem::Dispatch(ctx, wiJobSystem::GetThreadCount(), 1, [](wiJobArgs args) {});
+			wiJobSystem::Wait(ctx);
+		}
+		add("wiJobSystem::Dispatch + Wait: empty job per thread, " + threads, timer.elapsed(), dispatchCount, "dispatches");
+	}
+
+	// Component manager: creation, lookup in random order and removal
+	for (size_t count : { 10000, 100000, 1000000 })
+	{
+		const std::string size = " (" + std::to_string(count) + " entities)";
+		wiECS::ComponentManager<TransformComponent> manager;
+		std::vector<Entity> entities(count);
+		for (auto& entity : entities)
+		{
+			entity = CreateEntity();
+		}
+
+		timer.record();
+		for (Entity entity : entities)
+		{
+			manager.Create(entity);
+		}
+		add("ComponentManager::Create" + size, timer.elapsed(), (double)count, "components");
+
+		std::shuffle(entities.begin(), entities.end(), rng);
+		timer.record();
+		for (Entity entity : entities)
+		{
+			sink += manager.GetComponent(entity)->scale_local.x;
+		}
+		add("ComponentManager::GetComponent" + size, timer.elapsed(), (double)count, "components");
+
+		timer.record();
+		for (Entity entity : entities)
+		{
+			manager.Remove(entity);
+		}
+		add("ComponentManager::Remove" + size, timer.elapsed(), (double)count, "components");
+	}
+
+	// Scene name lookup, and that the renames are found right away (without a Scene::Update() in between)
+	{
+		const uint32_t count = 100000;
+		Scene scene;
+		std::vector<Entity> entities(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			entities[i] = CreateEntity();
+			scene.names.Create(entities[i]) = "entity_" + std::to_string(i);
+		}
+		scene.Entity_FindByName("entity_0"); // builds the index
+
+		timer.record();
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			sink += (float)scene.Entity_FindByName("entity_" + std::to_string(rng() % count));
+		}
+		add("Scene::Entity_FindByName (100000 names)", timer.elapsed(), (double)count, "queries");
+
+		// Renamed by Entity_SetName(), and directly with the change reported (like the scripts do):
+		scene.Entity_SetName(entities[1], "renamed_1");
+		*scene.names.GetComponent(entities[2]) = "renamed_2";
+		scene.names.MarkChanged(entities[2]);
+		const bool renames_found =
+			scene.Entity_FindByName("renamed_1") == entities[1] && scene.Entity_FindByName("entity_1") == INVALID_ENTITY &&
+			scene.Entity_FindByName("renamed_2") == entities[2] && scene.Entity_FindByName("entity_2") == INVALID_ENTITY;
+		assert(renames_found);
+		if (!renames_found)
+		{
+			wiBackLog::post("[Tests] Scene::Entity_FindByName() didn't find a renamed entity!");
+		}
+	}
+
+	// Archive: serialization of a scene with a big mesh
+	{
+		std::uniform_real_distribution<float> position(-100, 100);
+		Scene scene;
+		Entity meshEntity = scene.Entity_CreateMesh("benchmark_mesh");
+		MeshComponent& mesh = *scene.meshes.GetComponent(meshEntity);
+		const uint32_t vertexCount = 1 << 20;
+		mesh.vertex_positions.resize(vertexCount);
+		mesh.vertex_normals.resize(vertexCount, XMFLOAT3(0, 1, 0));
+		mesh.vertex_uvset_0.resize(vertexCount);
+		mesh.indices.resize(vertexCount * 3);
+		for (uint32_t i = 0; i < vertexCount; ++i)
+		{
+			mesh.vertex_positions[i] = XMFLOAT3(position(rng), position(rng), position(rng));
+			mesh.vertex_uvset_0[i] = XMFLOAT2(position(rng), position(rng));
+		}
+		for (size_t i = 0; i < mesh.indices.size(); ++i)
+		{
+			mesh.indices[i] = uint32_t(i * 7919) % vertexCount;
+		}
+		MeshComponent::MeshSubset& subset = mesh.subsets.emplace_back();
+		subset.indexCount = (uint32_t)mesh.indices.size();
+
+		wiArchive archive;
+		timer.record();
+		scene.Serialize(archive);
+		const double megabytes = archive.GetSize() / 1024.0 / 1024.0;
+		add("wiArchive write: scene with a 1M vertex mesh", timer.elapsed(), megabytes, "MB");
+
+		archive.SetReadModeAndResetPos(true);
+		Scene loaded;
+		timer.record();
+		loaded.Serialize(archive);
+		add("wiArchive read: scene with a 1M vertex mesh (including the render data creation)", timer.elapsed(), megabytes, "MB");
+	}
+
+	// Intersection tests against a grid of random boxes
+	{
+		std::uniform_real_distribution<float> position(-100, 100);
+		std::uniform_real_distribution<float> halfwidth(0.1f, 2.0f);
+		const size_t boxCount = 1000000;
+		std::vector<AABB> boxes(boxCount);
+		AABB_SOA boxes_soa;
+		boxes_soa.resize(boxCount);
+		for (size_t i = 0; i < boxCount; ++i)
+		{
+			boxes[i].createFromHalfWidth(XMFLOAT3(position(rng), position(rng), position(rng)), XMFLOAT3(halfwidth(rng), halfwidth(rng), halfwidth(rng)));
+			boxes_soa.set(i, boxes[i]);
+		}
+
+		Frustum frustum;
+		frustum.Create(
+			XMMatrixLookToLH(XMVectorSet(0, 0, -110, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)) *
+			XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 1000, 0.1f) // reverse zbuffer, like the cameras
+		);
+
+		uint32_t visible = 0;
+		timer.record();
+		for (const AABB& box : boxes)
+		{
+			visible += frustum.CheckBoxFast(box) ? 1 : 0;
+		}
+		add("Frustum::CheckBoxFast", timer.elapsed(), (double)boxCount, "boxes");
+
+		timer.record();
+		for (const AABB& box : boxes)
+		{
+			visible += frustum.CheckBox(box) != Frustum::BOX_FRUSTUM_OUTSIDE ? 1 : 0;
+		}
+		add("Frustum::CheckBox", timer.elapsed(), (double)boxCount, "boxes");
+
+		std::vector<uint32_t> mask((boxCount + 31) / 32);
+		timer.record();
+		frustum.CheckBoxesMask(boxes_soa, 0, boxCount, mask.data());
+		add("Frustum::CheckBoxesMask", timer.elapsed(), (double)boxCount, "boxes");
+		visible += mask[0];
+
+		timer.record();
+		for (size_t i = 1; i < boxCount; ++i)
+		{
+			visible += boxes[i].intersects(boxes[i - 1]) != AABB::OUTSIDE ? 1 : 0;
+		}
+		add("AABB::intersects(AABB)", timer.elapsed(), double(boxCount - 1), "tests");
+
+		const RAY ray(XMFLOAT3(-150, 1, -150), XMFLOAT3(0.7071f, 0, 0.7071f));
+		timer.record();
+		for (const AABB& box : boxes)
+		{
+			visible += box.intersects(ray) ? 1 : 0;
+		}
+		add("AABB::intersects(RAY)", timer.elapsed(), (double)boxCount, "tests");
+
+		sink += (float)visible;
+	}
+
+	// Rectangle packing, like the atlases of the renderer
+	{
+		std::uniform_int_distribution<int> side(4, 64);
+		const int rectCount = 10000;
+		std::vector<wiRectPacker::rect_xywh> rects(rectCount);
+		std::vector<wiRectPacker::rect_xywh*> pointers(rectCount);
+		for (int i = 0; i < rectCount; ++i)
+		{
+			rects[i] = wiRectPacker::rect_xywh(0, 0, side(rng), side(rng));
+			pointers[i] = &rects[i];
+		}
+		std::vector<wiRectPacker::rect_xywh> sizes = rects;
+
+		std::vector<wiRectPacker::bin> bins;
+		timer.record();
+		wiRectPacker::pack(pointers.data(), rectCount, 4096, bins);
+		add("wiRectPacker::pack (10000 rectangles)", timer.elapsed(), rectCount, "rectangles");
+
+		wiRectPacker::free_rects atlas;
+		atlas.reset(4096, 4096);
+		timer.record();
+		for (auto& rect : sizes)
+		{
+			atlas.insert(rect);
+		}
+		add("wiRectPacker::free_rects::insert (10000 rectangles)", timer.elapsed(), rectCount, "rectangles");
+	}
+
+	// Scene update with many objects of a shared mesh
+	for (uint32_t count : { 1000u, 10000u, 100000u })
+	{
+		Scene scene;
+		Entity materialEntity = scene.Entity_CreateMaterial("benchmark_material");
+		Entity meshEntity = scene.Entity_CreateMesh("benchmark_mesh");
+		MeshComponent& mesh = *scene.meshes.GetComponent(meshEntity);
+		mesh.vertex_positions = { XMFLOAT3(-1, 0, 0), XMFLOAT3(1, 0, 0), XMFLOAT3(0, 1, 0) };
+		mesh.vertex_normals = { XMFLOAT3(0, 0, -1), XMFLOAT3(0, 0, -1), XMFLOAT3(0, 0, -1) };
+		mesh.vertex_uvset_0 = { XMFLOAT2(0, 1), XMFLOAT2(1, 1), XMFLOAT2(0.5f, 0) };
+		mesh.indices = { 0, 1, 2 };
+		MeshComponent::MeshSubset& subset = mesh.subsets.emplace_back();
+		subset.materialID = materialEntity;
+		subset.indexCount = 3;
+		mesh.CreateRenderData();
+
+		std::uniform_real_distribution<float> position(-100, 100);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			Entity entity = scene.Entity_CreateObject("");
+			scene.objects.GetComponent(entity)->meshID = meshEntity;
+			scene.transforms.GetComponent(entity)->Translate(XMFLOAT3(position(rng), position(rng), position(rng)));
+		}
+		scene.Update(0); // the first update creates the GPU resources of the scene
+
+		const int updateCount = 10;
+		timer.record();
+		for (int i = 0; i < updateCount; ++i)
+		{
+			scene.Update(1.0f / 60.0f);
+		}
+		add("Scene::Update (" + std::to_string(count) + " objects)", timer.elapsed() / updateCount, count, "objects");
+	}
+
+	benchmark_sink = sink;
+}
+// The datasets of the GPU sort benchmark: random floats, which are sorted by both algorithms every frame
+struct GPUSortBenchmarkData
+{
+	uint32_t count = 0;
+	wiGraphics::GPUBuffer comparison;
+	wiGraphics::GPUBuffer counter;
+	wiGraphics::GPUBuffer indices_initial;
+	wiGraphics::GPUBuffer indices;
+	std::string name_radix;
+	std::string name_bitonic;
+};
+static std::vector<GPUSortBenchmarkData> gpusort_benchmark;
+static wiSpriteFont gpusort_benchmark_font;
+
+void TestsRenderer::RunGPUSortBenchmarkTest()
+{
+	using namespace wiGraphics;
+	GraphicsDevice* device = wiRenderer::GetDevice();
+	wiProfiler::SetPassTimingEnabled(true);
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> distribution(0, 1000);
+
+	gpusort_benchmark.clear();
+	for (uint32_t count : { 16384, 65536, 262144, 1048576 })
+	{
+		gpusort_benchmark.emplace_back();
+		GPUSortBenchmarkData& data = gpusort_benchmark.back();
+		data.count = count;
+		data.name_radix = "Radix sort (" + std::to_string(count) + ")";
+		data.name_bitonic = "Bitonic sort (" + std::to_string(count) + ")";
+
+		std::vector<float> values(count);
+		std::vector<uint32_t> indices(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			values[i] = distribution(rng);
+			indices[i] = i;
+		}
+
+		GPUBufferDesc desc;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = sizeof(float);
+		desc.ByteWidth = desc.StructureByteStride * count;
+		SubresourceData initdata;
+		initdata.pSysMem = values.data();
+		device->CreateBuffer(&desc, &initdata, &data.comparison);
+		initdata.pSysMem = indices.data();
+		device->CreateBuffer(&desc, &initdata, &data.indices_initial);
+		device->CreateBuffer(&desc, nullptr, &data.indices);
+
+		desc.BindFlags = BIND_SHADER_RESOURCE;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		desc.StructureByteStride = 0;
+		desc.ByteWidth = sizeof(uint32_t);
+		initdata.pSysMem = &count;
+		device->CreateBuffer(&desc, &initdata, &data.counter);
+	}
+
+	gpusort_benchmark_font = wiSpriteFont("");
+	gpusort_benchmark_font.params.posX = GetLogicalWidth() / 2;
+	gpusort_benchmark_font.params.posY = GetLogicalHeight() / 2;
+	gpusort_benchmark_font.params.h_align = WIFALIGN_CENTER;
+	gpusort_benchmark_font.params.v_align = WIFALIGN_CENTER;
+	gpusort_benchmark_font.params.size = 16;
+	this->AddFont(&gpusort_benchmark_font);
+}
+void TestsRenderer::UpdateGPUSortBenchmark()
+{
+	using namespace wiGraphics;
+	GraphicsDevice* device = wiRenderer::GetDevice();
+
+	// Both sorts start from the same unsorted indices every frame, the copies are not measured:
+	CommandList cmd = device->BeginCommandList();
+	auto reset = [&](GPUSortBenchmarkData& data) {
+		GPUBarrier barriers[] = {
+			GPUBarrier::Buffer(&data.indices, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_COPY_DST),
+		};
+		device->Barrier(barriers, arraysize(barriers), cmd);
+		device->CopyResource(&data.indices, &data.indices_initial, cmd);
+		std::swap(barriers[0].buffer.state_before, barriers[0].buffer.state_after);
+		device->Barrier(barriers, arraysize(barriers), cmd);
+	};
+	for (auto& data : gpusort_benchmark)
+	{
+		reset(data);
+		wiProfiler::pass_id pass = wiProfiler::BeginPassGPU(data.name_radix.c_str(), cmd);
+		wiGPUSortLib::SortRadix(data.count, data.comparison, data.counter, 0, data.indices, cmd);
+		wiProfiler::EndPassGPU(pass);
+
+		reset(data);
+		pass = wiProfiler::BeginPassGPU(data.name_bitonic.c_str(), cmd);
+		wiGPUSortLib::SortBitonic(data.count, data.comparison, data.counter, 0, data.indices, cmd);
+		wiProfiler::EndPassGPU(pass);
+	}
+
+	std::stringstream ss("");
+	ss.precision(3);
+	ss << "GPU sort benchmark, wiGPUSortLib radix and bitonic sorts of random floats:" << std::endl;
+	ss << "You can find out more in Tests.cpp, UpdateGPUSortBenchmark() function." << std::endl << std::endl;
+	for (auto& data : gpusort_benchmark)
+	{
+		ss << data.name_radix << ": " << std::fixed << wiProfiler::GetPassTime(data.name_radix.c_str()) << " ms, ";
+		ss << data.name_bitonic << ": " << std::fixed << wiProfiler::GetPassTime(data.name_bitonic.c_str()) << " ms" << std::endl;
+	}
+	gpusort_benchmark_font.SetText(ss.str());
+}
+void TestsRenderer::RunCoreBenchmarkTest()
+{
+	std::vector<CoreBenchmarkResult> results;
+	RunCoreBenchmarks(results);
+
+	std::stringstream ss("");
+	ss.precision(3);
+	ss << "Core benchmarks, with " << wiJobSystem::GetThreadCount() << " job system threads:" << std::endl;
+	ss << "You can find out more in Tests.cpp, RunCoreBenchmarks() function." << std::endl << std::endl;
+	for (auto& x : results)
+	{
+		ss << x.name << ": " << std::fixed << x.time << " ms (" << (x.time > 0 ? x.count / x.time * 1000.0 : 0) << " " << x.unit << "/s)" << std::endl;
+	}
+
+	static wiSpriteFont font;
+	font = wiSpriteFont(ss.str());
+	font.params.posX = GetLogicalWidth() / 2;
+	font.params.posY = GetLogicalHeight() / 2;
+	font.params.h_align = WIFALIGN_CENTER;
+	font.params.v_align = WIFALIGN_CENTER;
+	font.params.size = 16;
+	this->AddFont(&font);
+}
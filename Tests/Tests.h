@@ -1,6 +1,8 @@
 #pragma once
 #include "WickedEngine.h"
 
+#include <unordered_map>
+
 
 class TestsRenderer : public RenderPath3D
 {
@@ -16,12 +18,78 @@ public:
 	void RunFontTest();
 	void RunSpriteTest();
 	void RunNetworkTest();
+	void RunCoreBenchmarkTest();
+	void RunGPUSortBenchmarkTest();
+	void UpdateGPUSortBenchmark();
+};
+
+// Microbenchmarks of the engine core: job system, component managers, archive, intersection tests, rectangle packing and scene update
+//	The results are deterministic in their inputs (fixed random seed), so runs of different builds can be compared
+struct CoreBenchmarkResult
+{
+	std::string name;
+	double time = 0; // milliseconds
+	double count = 0; // count of processed items
+	const char* unit = ""; // what the items are
+};
+void RunCoreBenchmarks(std::vector<CoreBenchmarkResult>& results);
+
+// Automated benchmark, started by the benchmark=<file.wiscene> startup argument instead of the interactive tests
+//	The camera flies a fixed orbit around the scene, and after the warmup frames the CPU ranges and GPU passes of every frame are measured
+//	The percentiles are written into a JSON file, then the application exits with the result
+//	Optional arguments: benchmark_warmup=<frames> benchmark_frames=<frames> benchmark_output=<file.json> benchmark_budget=<milliseconds>
+//	The core_benchmark startup argument runs RunCoreBenchmarks() instead of a scene, and writes its results into the benchmark_output file
+class BenchmarkRenderer : public RenderPath3D
+{
+	std::string scenefile;
+	bool core = false;
+	std::string outputfile = "benchmark.json";
+	uint32_t warmupFrames = 100;
+	uint32_t measuredFrames = 500;
+	float budget = 0; // if the 95th percentile of the frame time exceeds it, the benchmark fails
+
+	uint32_t frame = 0;
+	AABB bounds;
+	std::vector<float> frameTimes;
+	std::vector<float> gpuFrameTimes;
+	std::unordered_map<std::string, std::vector<float>> cpuRanges;
+	std::unordered_map<std::string, std::vector<float>> gpuPasses;
+	std::vector<wiProfiler::PassTime> passTimes;
+
+	bool finished = false;
+	int exitCode = 0;
+
+	void UpdateCamera();
+	void Measure(float dt);
+	bool WriteResults();
+	bool WriteCoreResults(const std::vector<CoreBenchmarkResult>& results) const;
+public:
+	enum RESULT
+	{
+		BENCHMARK_SUCCESS = 0,
+		BENCHMARK_LOAD_FAILED = 1,
+		BENCHMARK_WRITE_FAILED = 2,
+		BENCHMARK_OVER_BUDGET = 3,
+	};
+
+	static bool IsRequested();
+
+	void Load() override;
+	void Update(float dt) override;
+
+	bool IsFinished() const { return finished; }
+	int GetExitCode() const { return exitCode; }
 };
 
 class Tests : public MainComponent
 {
 	TestsRenderer renderer;
+	BenchmarkRenderer benchmark;
 public:
 	void Initialize() override;
+
+	// The benchmark mode has finished and the application should exit with GetExitCode()
+	bool IsFinished() const { return activePath == &benchmark && benchmark.IsFinished(); }
+	int GetExitCode() const { return benchmark.GetExitCode(); }
 };
 
@@ -15,6 +15,10 @@ int sdl_loop(Tests &tests)
         SDL_PumpEvents();
         tests.Run();
 
+        if (tests.IsFinished()) {
+            return tests.GetExitCode();
+        }
+
 //        int ret = SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
         int ret = SDL_PollEvent(&event);
 
@@ -58,6 +58,10 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 
 			tests.Run();
 
+			if (tests.IsFinished())
+			{
+				return tests.GetExitCode();
+			}
 		}
 	}
 
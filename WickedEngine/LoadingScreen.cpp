@@ -1,5 +1,6 @@
 #include "LoadingScreen.h"
 #include "MainComponent.h"
+#include "wiLua.h"
 
 #include <thread>
 
@@ -34,6 +35,15 @@ void LoadingScreen::onFinished(std::function<void()> finishFunction)
 
 void LoadingScreen::Start()
 {
+	// Loading must not compete with the work of the frames that are rendered meanwhile:
+	ctx.priority = wiJobSystem::Priority::Background;
+#ifndef GGREDUCED
+	if (collectLuaGarbage)
+	{
+		// Before the tasks start, because they can run scripts too:
+		wiLua::CollectGarbage();
+	}
+#endif
 	for (auto& x : tasks)
 	{
 		wiJobSystem::Execute(ctx, x);
@@ -15,6 +15,8 @@ private:
 	std::vector<std::function<void(wiJobArgs)>> tasks;
 	std::function<void()> finish;
 public:
+	//Run a full Lua garbage collection when the loading starts, while the loading screen hides the hitch
+	bool collectLuaGarbage = true;
 
 	//Add a loading task which should be executed
 	//use std::bind( YourFunctionPointer )
@@ -1,5 +1,6 @@
 #include "MainComponent.h"
 #include "RenderPath.h"
+#include "RenderPath3D.h"
 #include "wiRenderer.h"
 #include "wiHelper.h"
 #include "wiTimer.h"
@@ -10,11 +11,13 @@
 #include "wiEnums.h"
 #include "wiTextureHelper.h"
 #include "wiProfiler.h"
+#include "wiCounters.h"
 #include "wiInitializer.h"
 #include "wiStartupArguments.h"
 #include "wiFont.h"
 #include "wiImage.h"
 #include "wiEvent.h"
+#include "wiAudio.h"
 
 #include "wiGraphicsDevice_DX11.h"
 #include "wiGraphicsDevice_DX12.h"
@@ -24,6 +27,7 @@
 
 #include <sstream>
 #include <algorithm>
+#include <cmath>
 
 #ifdef GGREDUCED
 #ifdef OPTICK_ENABLE
@@ -84,6 +88,10 @@ void MainComponent::Run()
 		// we do this elsewhere now
 		#else
 		// Until engine is not loaded, present initialization screen...
+		if (headless)
+		{
+			return;
+		}
 		CommandList cmd = wiRenderer::GetDevice()->BeginCommandList();
 		wiRenderer::GetDevice()->RenderPassBegin(&swapChain, cmd);
 		wiImage::SetCanvas(canvas, cmd);
@@ -128,9 +136,20 @@ void MainComponent::Run()
 	}
 #endif
 
+	if (latency_mode)
+	{
+		auto range = wiProfiler::BeginRangeCPU("Frame Latency Wait");
+		wiRenderer::GetDevice()->WaitForFrameLatency(&swapChain, latency_frames_in_flight);
+		wiProfiler::EndRange(range);
+	}
+
 	wiProfiler::BeginFrame();
 
 	deltaTime = float(std::max(0.0, timer.elapsed() / 1000.0));
+	{
+		static const wiCounters::counter_id counter_frame_time = wiCounters::Register("Frame.Time", wiCounters::TYPE_HISTOGRAM);
+		wiCounters::Sample(counter_frame_time, deltaTime * 1000.0);
+	}
 #ifdef GGREDUCED
 	//LB: if leave app, timer.elapsed() is going to be huge on returning, causing weird animation issues
 	// so cap this to a maximum so it reduces the glitch the user sees (without causing anything over 30fps to misbehave)
@@ -139,6 +158,9 @@ void MainComponent::Run()
 #endif
 	timer.record();
 
+	bool input_sampled = false;
+	wiTimer frame_input = input_timer; // in the default mode the input of this frame was sampled at the end of the previous frame
+
 #ifdef GGREDUCED
 	//PE: We need to run always, as we can have many windows running at the same time.
 	if (1)
@@ -153,12 +175,61 @@ void MainComponent::Run()
 
 		const float dt = framerate_lock ? (1.0f / targetFrameRate) : deltaTime;
 
+		if (latency_mode && !headless)
+		{
+			// Sample the input as late as possible, so that this frame uses the newest input:
+			wiInput::Update(window);
+			input_timer.record();
+			frame_input = input_timer;
+			input_sampled = true;
+		}
+
 		fadeManager.Update(dt);
 
-		if (GetActivePath() != nullptr)
+		if (GetActivePath() != nullptr || !offscreenPaths.empty())
 		{
-			GetActivePath()->init(canvas);
-			GetActivePath()->PreUpdate();
+			if (GetActivePath() != nullptr)
+			{
+				GetActivePath()->init(canvas);
+				GetActivePath()->PreUpdate();
+			}
+			for (auto& x : offscreenPaths)
+			{
+				x->path->init(x->canvas);
+				x->path->PreUpdate();
+			}
+
+			// Fixed timestep simulation, the offscreen paths are stepped the same way as the active path:
+			RenderPath::SimulationStep simulation;
+			if (simulation_rate > 0)
+			{
+				simulation.fixed = true;
+				simulation.dt = 1.0f / simulation_rate;
+				simulation_accumulator += dt;
+				while (simulation_accumulator >= simulation.dt && simulation.steps < simulation_max_steps)
+				{
+					simulation_accumulator -= simulation.dt;
+					simulation.steps++;
+				}
+				if (simulation_accumulator >= simulation.dt)
+				{
+					// the simulation can't catch up, the time that it is behind is dropped instead of accumulating:
+					simulation_accumulator = std::fmod(simulation_accumulator, simulation.dt);
+				}
+				simulation.alpha = simulation_accumulator / simulation.dt;
+			}
+			else
+			{
+				simulation_accumulator = 0;
+			}
+			if (GetActivePath() != nullptr)
+			{
+				GetActivePath()->simulation = simulation;
+			}
+			for (auto& x : offscreenPaths)
+			{
+				x->path->simulation = simulation;
+			}
 		}
 
 		// Fixed time update:
@@ -198,7 +269,12 @@ void MainComponent::Run()
 		deltaTimeAccumulator = 0;
 	}
 
-	wiInput::Update(window);
+	if (!input_sampled && !headless)
+	{
+		// The input is sampled for the next frame:
+		wiInput::Update(window);
+		input_timer.record();
+	}
 
 	#ifdef GGREDUCED
 	if (is_completely_loaded == false)
@@ -208,17 +284,22 @@ void MainComponent::Run()
 	else
 	{
 	#endif
+	ComposeOffscreenPaths();
+
 	CommandList cmd = wiRenderer::GetDevice()->BeginCommandList();
-	wiRenderer::GetDevice()->RenderPassBegin(&swapChain, cmd);
 	{
-		wiImage::SetCanvas(canvas, cmd);
-		wiFont::SetCanvas(canvas, cmd);
-		Viewport viewport;
-		viewport.Width = (float)swapChain.desc.width;
-		viewport.Height = (float)swapChain.desc.height;
-		wiRenderer::GetDevice()->BindViewports(1, &viewport, cmd);
-		Compose(cmd);
-		wiRenderer::GetDevice()->RenderPassEnd(cmd);
+		if (!headless)
+		{
+			wiRenderer::GetDevice()->RenderPassBegin(&swapChain, cmd);
+			wiImage::SetCanvas(canvas, cmd);
+			wiFont::SetCanvas(canvas, cmd);
+			Viewport viewport;
+			viewport.Width = (float)swapChain.desc.width;
+			viewport.Height = (float)swapChain.desc.height;
+			wiRenderer::GetDevice()->BindViewports(1, &viewport, cmd);
+			Compose(cmd);
+			wiRenderer::GetDevice()->RenderPassEnd(cmd);
+		}
 		wiProfiler::EndFrame(cmd);
 
 #ifdef GGREDUCED
@@ -227,6 +308,10 @@ void MainComponent::Run()
 #endif
 #endif
 		wiRenderer::GetDevice()->SubmitCommandLists();
+
+		static const wiCounters::counter_id counter_input_latency = wiCounters::Register("Frame.InputLatency", wiCounters::TYPE_HISTOGRAM);
+		input_latency = float(frame_input.elapsed());
+		wiCounters::Sample(counter_input_latency, input_latency);
 	}
 	#ifdef GGREDUCED
 	}
@@ -246,6 +331,12 @@ void MainComponent::Update(float dt)
 		GetActivePath()->Update(dt);
 		GetActivePath()->PostUpdate();
 	}
+	for (auto& x : offscreenPaths)
+	{
+		x->path->Update(dt);
+		x->path->PostUpdate();
+	}
+	wiAudio::Update(dt);
 	wiProfiler::EndRange(range1);
 }
 
@@ -260,6 +351,10 @@ void MainComponent::FixedUpdate()
 	{
 		GetActivePath()->FixedUpdate();
 	}
+	for (auto& x : offscreenPaths)
+	{
+		x->path->FixedUpdate();
+	}
 }
 
 void MainComponent::Render( int mode )
@@ -274,6 +369,10 @@ void MainComponent::Render( int mode )
 	{
 		GetActivePath()->Render( mode );
 	}
+	for (auto& x : offscreenPaths)
+	{
+		x->path->Render( mode );
+	}
 
 	wiProfiler::EndRange(range); // Render
 }
@@ -367,6 +466,7 @@ void MainComponent::Compose(CommandList cmd)
 
 			ss.precision(2);
 			ss << std::fixed << 1.0f / displaydeltatime << " FPS" << std::endl;
+			ss << "Input latency: " << input_latency << " ms" << (latency_mode ? " (latency mode)" : "") << std::endl;
 		}
 		if (infoDisplay.heap_allocation_counter)
 		{
@@ -398,10 +498,8 @@ void MainComponent::Compose(CommandList cmd)
 	wiProfiler::EndRange(range); // Compose
 }
 
-void MainComponent::SetWindow(wiPlatform::window_type window, bool fullscreen)
+void MainComponent::CreateDevice(wiPlatform::window_type window)
 {
-	this->window = window;
-
 	// User can also create a graphics device if custom logic is desired, but they must do before this function!
 	if (wiRenderer::GetDevice() == nullptr)
 	{
@@ -467,7 +565,17 @@ void MainComponent::SetWindow(wiPlatform::window_type window, bool fullscreen)
 			wiRenderer::SetDevice(std::make_shared<GraphicsDevice_DX11>(debugdevice));
 #endif
 		}
+
+		// The pipelines that the driver compiled in earlier sessions are reused (the file is only accepted by the same adapter and driver):
+		wiRenderer::GetDevice()->LoadPipelineCache(wiRenderer::GetShaderPath() + "pipelinecache.bin");
 	}
+}
+
+void MainComponent::SetWindow(wiPlatform::window_type window, bool fullscreen)
+{
+	this->window = window;
+
+	CreateDevice(window);
 
 	canvas.init(window);
 
@@ -488,3 +596,149 @@ void MainComponent::SetWindow(wiPlatform::window_type window, bool fullscreen)
 	});
 }
 
+
+void MainComponent::SetHeadless(uint32_t width, uint32_t height, float dpi)
+{
+	headless = true;
+	window = {};
+
+	// The device doesn't need the window when no swapchain is created for it:
+	CreateDevice(window);
+
+	canvas.init(width, height, dpi);
+}
+
+void MainComponent::AddOffscreenPath(RenderPath* path, uint32_t width, uint32_t height)
+{
+	assert(path != nullptr);
+	auto it = std::find_if(offscreenPaths.begin(), offscreenPaths.end(), [path](const std::unique_ptr<OffscreenPath>& x) { return x->path == path; });
+	const bool added = it == offscreenPaths.end();
+	if (added)
+	{
+		offscreenPaths.push_back(std::make_unique<OffscreenPath>());
+		it = offscreenPaths.end() - 1;
+		(*it)->path = path;
+	}
+	OffscreenPath& x = **it;
+	x.canvas.init(width, height);
+
+	if (!x.target.IsValid() || x.target.GetDesc().Width != width || x.target.GetDesc().Height != height)
+	{
+		GraphicsDevice* device = wiRenderer::GetDevice();
+
+		TextureDesc desc;
+		desc.BindFlags = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE;
+		desc.Format = FORMAT_R8G8B8A8_UNORM;
+		desc.Width = width;
+		desc.Height = height;
+		device->CreateTexture(&desc, nullptr, &x.target);
+		device->SetName(&x.target, "OffscreenPath");
+
+		RenderPassDesc renderpassdesc;
+		renderpassdesc.attachments.push_back(RenderPassAttachment::RenderTarget(&x.target, RenderPassAttachment::LOADOP_CLEAR));
+		device->CreateRenderPass(&renderpassdesc, &x.renderpass);
+	}
+
+	path->init(x.canvas);
+	if (added)
+	{
+		path->Start();
+	}
+}
+
+void MainComponent::RemoveOffscreenPath(RenderPath* path)
+{
+	auto it = std::find_if(offscreenPaths.begin(), offscreenPaths.end(), [path](const std::unique_ptr<OffscreenPath>& x) { return x->path == path; });
+	if (it == offscreenPaths.end())
+	{
+		return;
+	}
+
+	// The readbacks that were not started yet are reported as failed:
+	for (auto& request : (*it)->readbacks)
+	{
+		std::vector<uint8_t> filedata;
+		request.callback(filedata);
+	}
+
+	// The device destroys the GPU resources with a delay, so the readback copies in flight still read a valid target:
+	path->Stop();
+	offscreenPaths.erase(it);
+}
+
+const Texture* MainComponent::GetOffscreenPathResult(const RenderPath* path) const
+{
+	for (auto& x : offscreenPaths)
+	{
+		if (x->path == path)
+		{
+			return &x->target;
+		}
+	}
+	return nullptr;
+}
+
+void MainComponent::ReadbackOffscreenPath(RenderPath* path, const std::string& fileExtension, std::function<void(std::vector<uint8_t>& filedata)> callback)
+{
+	assert(callback);
+	for (auto& x : offscreenPaths)
+	{
+		if (x->path == path)
+		{
+			x->readbacks.push_back({ fileExtension, callback });
+			return;
+		}
+	}
+	std::vector<uint8_t> filedata;
+	callback(filedata);
+}
+
+void MainComponent::ComposeOffscreenPaths()
+{
+	if (offscreenPaths.empty())
+	{
+		return;
+	}
+
+	auto range = wiProfiler::BeginRangeCPU("Compose Offscreen");
+
+	GraphicsDevice* device = wiRenderer::GetDevice();
+	CommandList cmd = device->BeginCommandList();
+	for (auto& x : offscreenPaths)
+	{
+		device->RenderPassBegin(&x->renderpass, cmd);
+		wiImage::SetCanvas(x->canvas, cmd);
+		wiFont::SetCanvas(x->canvas, cmd);
+		Viewport viewport;
+		viewport.Width = (float)x->canvas.GetPhysicalWidth();
+		viewport.Height = (float)x->canvas.GetPhysicalHeight();
+		device->BindViewports(1, &viewport, cmd);
+#ifdef GGREDUCED
+		// The 2D composition of the application also draws its editor overlays, so only the 3D result is composed:
+		const RenderPath3D* path3D = dynamic_cast<const RenderPath3D*>(x->path);
+		if (path3D != nullptr)
+		{
+			path3D->ComposeSimple(cmd);
+		}
+		else
+		{
+			x->path->Compose(cmd);
+		}
+#else
+		x->path->Compose(cmd);
+#endif
+		device->RenderPassEnd(cmd);
+	}
+
+	// The readback copies are recorded into later command lists than the compose, and the encoding runs on background jobs:
+	for (auto& x : offscreenPaths)
+	{
+		for (auto& request : x->readbacks)
+		{
+			wiHelper::saveTextureToMemoryFileAsync(x->target, request.fileExtension, request.callback);
+		}
+		x->readbacks.clear();
+	}
+
+	wiProfiler::EndRange(range); // Compose Offscreen
+}
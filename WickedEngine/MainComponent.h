@@ -8,6 +8,11 @@
 #include "wiEvent.h"
 #include "wiCanvas.h"
 
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
 class RenderPath;
 
 class MainComponent
@@ -30,6 +35,36 @@ protected:
 	float deltatimes[20] = {};
 	int fps_avg_counter = 0;
 
+	float simulation_rate = 0;
+	uint32_t simulation_max_steps = 4;
+	float simulation_accumulator = 0;
+
+	bool latency_mode = false;
+	uint32_t latency_frames_in_flight = 1;
+	wiTimer input_timer; // recorded when the input is sampled
+	float input_latency = 0;
+
+	bool headless = false;
+
+	struct OffscreenPath
+	{
+		RenderPath* path = nullptr;
+		wiCanvas canvas;
+		wiGraphics::Texture target;
+		wiGraphics::RenderPass renderpass;
+		struct ReadbackRequest
+		{
+			std::string fileExtension;
+			std::function<void(std::vector<uint8_t>& filedata)> callback;
+		};
+		std::vector<ReadbackRequest> readbacks; // they are started after the next compose
+	};
+	std::vector<std::unique_ptr<OffscreenPath>> offscreenPaths; // the render passes point to the targets, so they are not moved
+	// Composes the offscreen paths into their render targets and starts the requested readbacks
+	void ComposeOffscreenPaths();
+
+	void CreateDevice(wiPlatform::window_type window);
+
 public:
 	virtual ~MainComponent() = default;
 
@@ -59,6 +94,20 @@ public:
 	//	disabled	: the FixedUpdate() loop will run every frame only once.
 	void	setFrameSkip(bool enabled) { frameskip = enabled; }
 	void	setFrameRateLock(bool enabled) { framerate_lock = enabled; }
+	// Set the frequency of the scene simulation (default = 0)
+	//	0			: the scene is updated once per frame with the frame's delta time
+	//	above 0		: the scene simulation runs with fixed steps at this frequency, and the transforms are interpolated between the last two steps for rendering (see RenderPath::simulation and Scene::UpdateFixed())
+	//	maxSteps	: at most this many steps are simulated in a frame to catch up, the remaining time is dropped
+	void	setSimulationRate(float hz, uint32_t maxSteps = 4) { simulation_rate = hz; simulation_max_steps = maxSteps > 0 ? maxSteps : 1; simulation_accumulator = 0; }
+	float	getSimulationRate() const { return simulation_rate; }
+	// Set the latency mode (default = disabled)
+	//	enabled		: the CPU waits for the GPU and the swapchain before starting a frame (GraphicsDevice::WaitForFrameLatency), and the input is sampled right before the update
+	//	disabled	: the CPU can run up to GraphicsDevice::GetBufferCount() frames ahead, and the input is sampled after the frame for the next one
+	//	maxFramesInFlight: the count of frames that the GPU can still be working on when the CPU starts a new one, 1 gives the lowest latency
+	void	setLatencyMode(bool enabled, uint32_t maxFramesInFlight = 1) { latency_mode = enabled; latency_frames_in_flight = maxFramesInFlight; }
+	bool	isLatencyMode() const { return latency_mode; }
+	// Returns the milliseconds from sampling the input to presenting the frame that used it (the display scanout is not included)
+	float	getInputLatency() const { return input_latency; }
 
 	// This is where the critical initializations happen (before any rendering or anything else)
 	virtual void Initialize();
@@ -76,6 +125,24 @@ public:
 
 	// You need to call this before calling Run() or Initialize() if you want to render
 	void SetWindow(wiPlatform::window_type, bool fullscreen = false);
+	// Call this instead of SetWindow() to render without a window (eg. a service that renders previews)
+	//	The graphics device is created without a swapchain and the input is not read, the canvas has the given size
+	//	Compose() is not called, the results are taken from the offscreen paths
+	void SetHeadless(uint32_t width, uint32_t height, float dpi = 96);
+	bool IsHeadless() const { return headless; }
+
+	// Offscreen paths are updated, rendered and composed every frame after the active path, into their own render target of the given size
+	//	Each of them can have its own scene and camera (eg. RenderPath3D::scene and RenderPath3D::camera), and they share the graphics device, the shaders and the resource manager
+	//	They are rendered one after the other, so that the per-frame state of wiRenderer is not shared between them
+	//	Adding a path again changes its size
+	void AddOffscreenPath(RenderPath* path, uint32_t width, uint32_t height);
+	void RemoveOffscreenPath(RenderPath* path);
+	// Returns the render target that the offscreen path is composed into, nullptr if the path is not an offscreen path
+	const wiGraphics::Texture* GetOffscreenPathResult(const RenderPath* path) const;
+	// Reads back the next composed frame of the offscreen path and encodes it into the file format of the extension (eg. "png", "jpg")
+	//	Nothing waits for the GPU: the texture is read back asynchronously and encoded by a background job, which calls the callback with the file data (empty if it failed)
+	//	Any count of readbacks can be in flight, so a new frame can be requested every frame
+	void ReadbackOffscreenPath(RenderPath* path, const std::string& fileExtension, std::function<void(std::vector<uint8_t>& filedata)> callback);
 
 
 	struct InfoDisplayer
@@ -84,7 +151,7 @@ public:
 		bool active = false;
 		// display engine version number
 		bool watermark = true;
-		// display framerate
+		// display framerate and input latency
 		bool fpsinfo = false;
 		// display resolution info
 		bool resolution = false;
@@ -4,6 +4,9 @@
 #include "RenderPath2D_BindLua.h"
 #include "LoadingScreen_BindLua.h"
 #include "wiProfiler.h"
+#include "wiMemoryTracker.h"
+#include "wiCounters.h"
+#include "wiBackLog.h"
 
 const char MainComponent_BindLua::className[] = "MainComponent";
 
@@ -17,6 +20,9 @@ Luna<MainComponent_BindLua>::FunctionType MainComponent_BindLua::methods[] = {
 	lunamethod(MainComponent_BindLua, SetWatermarkDisplay),
 	lunamethod(MainComponent_BindLua, SetFPSDisplay),
 	lunamethod(MainComponent_BindLua, SetResolutionDisplay),
+	lunamethod(MainComponent_BindLua, SetSimulationRate),
+	lunamethod(MainComponent_BindLua, SetLatencyMode),
+	lunamethod(MainComponent_BindLua, GetInputLatency),
 	lunamethod(MainComponent_BindLua, GetCanvas),
 	{ NULL, NULL }
 };
@@ -256,6 +262,58 @@ int MainComponent_BindLua::SetResolutionDisplay(lua_State *L)
 		wiLua::SError(L, "SetResolutionDisplay(bool active) not enough arguments!");
 	return 0;
 }
+int MainComponent_BindLua::SetSimulationRate(lua_State *L)
+{
+	if (component == nullptr)
+	{
+		wiLua::SError(L, "SetSimulationRate() component is empty!");
+		return 0;
+	}
+	int argc = wiLua::SGetArgCount(L);
+	if (argc > 0)
+	{
+		uint32_t maxSteps = 4;
+		if (argc > 1)
+		{
+			maxSteps = (uint32_t)wiLua::SGetInt(L, 2);
+		}
+		component->setSimulationRate(wiLua::SGetFloat(L, 1), maxSteps);
+	}
+	else
+		wiLua::SError(L, "SetSimulationRate(float hz, opt int maxSteps) not enough arguments!");
+	return 0;
+}
+int MainComponent_BindLua::SetLatencyMode(lua_State *L)
+{
+	if (component == nullptr)
+	{
+		wiLua::SError(L, "SetLatencyMode() component is empty!");
+		return 0;
+	}
+	int argc = wiLua::SGetArgCount(L);
+	if (argc > 0)
+	{
+		uint32_t maxFramesInFlight = 1;
+		if (argc > 1)
+		{
+			maxFramesInFlight = (uint32_t)wiLua::SGetInt(L, 2);
+		}
+		component->setLatencyMode(wiLua::SGetBool(L, 1), maxFramesInFlight);
+	}
+	else
+		wiLua::SError(L, "SetLatencyMode(bool enabled, opt int maxFramesInFlight) not enough arguments!");
+	return 0;
+}
+int MainComponent_BindLua::GetInputLatency(lua_State *L)
+{
+	if (component == nullptr)
+	{
+		wiLua::SError(L, "GetInputLatency() component is empty!");
+		return 0;
+	}
+	wiLua::SSetFloat(L, component->getInputLatency());
+	return 1;
+}
 
 int MainComponent_BindLua::GetCanvas(lua_State* L)
 {
@@ -282,6 +340,116 @@ int SetProfilerEnabled(lua_State* L)
 	return 0;
 }
 
+int SetProfilerPipelineStatistics(lua_State* L)
+{
+	int argc = wiLua::SGetArgCount(L);
+	if (argc > 0)
+	{
+		wiProfiler::SetPipelineStatisticsEnabled(wiLua::SGetBool(L, 1));
+	}
+	else
+		wiLua::SError(L, "SetProfilerPipelineStatistics(bool enabled) not enough arguments!");
+
+	return 0;
+}
+
+int CaptureProfilerFrames(lua_State* L)
+{
+	int argc = wiLua::SGetArgCount(L);
+	if (argc > 1)
+	{
+		wiProfiler::BeginCapture((uint32_t)wiLua::SGetInt(L, 1), wiLua::SGetString(L, 2));
+	}
+	else
+		wiLua::SError(L, "CaptureProfilerFrames(int frameCount, string fileName) not enough arguments!");
+
+	return 0;
+}
+
+int SetProfilerSpikeDetection(lua_State* L)
+{
+	int argc = wiLua::SGetArgCount(L);
+	if (argc > 0)
+	{
+		wiProfiler::SpikeDetection desc;
+		if (argc > 1)
+		{
+			desc.threshold = wiLua::SGetFloat(L, 2);
+		}
+		if (argc > 2)
+		{
+			desc.directory = wiLua::SGetString(L, 3);
+		}
+		wiProfiler::SetSpikeDetectionEnabled(wiLua::SGetBool(L, 1), desc);
+	}
+	else
+		wiLua::SError(L, "SetProfilerSpikeDetection(bool enabled, opt float threshold, opt string directory) not enough arguments!");
+
+	return 0;
+}
+
+int PrintMemoryStatistics(lua_State* L)
+{
+	wiBackLog::post(wiMemoryTracker::GetReport().c_str());
+	return 0;
+}
+
+int GetCounter(lua_State* L)
+{
+	int argc = wiLua::SGetArgCount(L);
+	if (argc > 0)
+	{
+		wiCounters::Value value;
+		wiCounters::Get(wiLua::SGetString(L, 1), value);
+		wiLua::SSetDouble(L, value.value);
+		return 1;
+	}
+	else
+		wiLua::SError(L, "GetCounter(string name) not enough arguments!");
+
+	return 0;
+}
+
+int GetCounterStatistics(lua_State* L)
+{
+	int argc = wiLua::SGetArgCount(L);
+	if (argc > 0)
+	{
+		wiCounters::Value value;
+		wiCounters::Get(wiLua::SGetString(L, 1), value);
+		wiLua::SSetDouble(L, value.avg);
+		wiLua::SSetDouble(L, value.p50);
+		wiLua::SSetDouble(L, value.p95);
+		wiLua::SSetDouble(L, value.max);
+		wiLua::SSetInt(L, (int)value.count);
+		return 5;
+	}
+	else
+		wiLua::SError(L, "GetCounterStatistics(string name) not enough arguments!");
+
+	return 0;
+}
+
+int SetCounter(lua_State* L)
+{
+	int argc = wiLua::SGetArgCount(L);
+	if (argc > 1)
+	{
+		wiCounters::Set(wiCounters::Register(wiLua::SGetString(L, 1)), wiLua::SGetDouble(L, 2));
+	}
+	else
+		wiLua::SError(L, "SetCounter(string name, float value) not enough arguments!");
+
+	return 0;
+}
+
+int PrintCounters(lua_State* L)
+{
+	int argc = wiLua::SGetArgCount(L);
+	wiBackLog::post(wiCounters::GetReport(argc > 0 ? wiLua::SGetString(L, 1) : "").c_str());
+	return 0;
+}
+
 void MainComponent_BindLua::Bind()
 {
 	static bool initialized = false;
@@ -291,6 +459,14 @@ void MainComponent_BindLua::Bind()
 		Luna<MainComponent_BindLua>::Register(wiLua::GetLuaState()); 
 		
 		wiLua::RegisterFunc("SetProfilerEnabled", SetProfilerEnabled);
+		wiLua::RegisterFunc("SetProfilerPipelineStatistics", SetProfilerPipelineStatistics);
+		wiLua::RegisterFunc("CaptureProfilerFrames", CaptureProfilerFrames);
+		wiLua::RegisterFunc("SetProfilerSpikeDetection", SetProfilerSpikeDetection);
+		wiLua::RegisterFunc("PrintMemoryStatistics", PrintMemoryStatistics);
+		wiLua::RegisterFunc("GetCounter", GetCounter);
+		wiLua::RegisterFunc("GetCounterStatistics", GetCounterStatistics);
+		wiLua::RegisterFunc("SetCounter", SetCounter);
+		wiLua::RegisterFunc("PrintCounters", PrintCounters);
 	}
 }
 
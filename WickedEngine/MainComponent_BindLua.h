@@ -45,6 +45,9 @@ public:
 	int SetWatermarkDisplay(lua_State *L);
 	int SetFPSDisplay(lua_State *L);
 	int SetResolutionDisplay(lua_State *L);
+	int SetSimulationRate(lua_State *L);
+	int SetLatencyMode(lua_State *L);
+	int GetInputLatency(lua_State *L);
 
 	int GetCanvas(lua_State* L);
 
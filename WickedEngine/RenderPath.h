@@ -11,6 +11,16 @@ private:
 public:
 	virtual ~RenderPath() = default;
 
+	// Fixed timestep simulation of the current frame, it is set by MainComponent before Update() (see MainComponent::setSimulationRate())
+	struct SimulationStep
+	{
+		bool fixed = false; // if false, the simulation advances by the variable dt of Update()
+		uint32_t steps = 0; // count of fixed steps to simulate in this frame, can be 0
+		float dt = 0; // duration of a fixed step in seconds
+		float alpha = 1; // interpolation between the last two steps for rendering, in [0, 1]
+	};
+	SimulationStep simulation;
+
 	// load resources in background (for example behind loading screen)
 	virtual void Load() {}
 	// called when RenderPath gets activated
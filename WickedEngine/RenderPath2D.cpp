@@ -3,6 +3,8 @@
 #include "wiSprite.h"
 #include "wiSpriteFont.h"
 #include "wiRenderer.h"
+#include "wiUIRenderer.h"
+#include "wiJobSystem.h"
 
 #ifdef GGREDUCED
 //PE: We do not use any text/sprite/gui function in wicked so:
@@ -134,6 +136,24 @@ void RenderPath2D::Update(float dt)
 		ResizeLayout();
 	}
 
+	if (wiUIRenderer::HasDrawData() &&
+		(!rtUI.IsValid() || rtUI.GetDesc().Width != GetPhysicalWidth() || rtUI.GetDesc().Height != GetPhysicalHeight()))
+	{
+		GraphicsDevice* device = wiRenderer::GetDevice();
+
+		TextureDesc desc;
+		desc.BindFlags = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE;
+		desc.Format = FORMAT_R8G8B8A8_UNORM;
+		desc.Width = GetPhysicalWidth();
+		desc.Height = GetPhysicalHeight();
+		device->CreateTexture(&desc, nullptr, &rtUI);
+		device->SetName(&rtUI, "rtUI");
+
+		RenderPassDesc renderpassdesc;
+		renderpassdesc.attachments.push_back(RenderPassAttachment::RenderTarget(&rtUI, RenderPassAttachment::LOADOP_CLEAR));
+		device->CreateRenderPass(&renderpassdesc, &renderpass_ui);
+	}
+
 	GetGUI().Update(*this, dt);
 
 	for (auto& x : layers)
@@ -203,11 +223,29 @@ void RenderPath2D::Render( int mode ) const
 
 	wiRenderer::ProcessDeferredMipGenRequests(cmd);
 
+	// The UI is recorded on a worker thread, while this thread records the 2D layers (and the 3D rendering jobs are running):
+	wiJobSystem::context ctx;
+	ui_recorded = rtUI.IsValid() && wiUIRenderer::HasDrawData();
+	if (ui_recorded)
+	{
+		CommandList cmd_ui = device->BeginCommandList();
+		wiJobSystem::Execute(ctx, [this, device, cmd_ui](wiJobArgs args) {
+			device->RenderPassBegin(&renderpass_ui, cmd_ui);
+			wiUIRenderer::Draw(cmd_ui);
+			device->RenderPassEnd(cmd_ui);
+		});
+	}
+
 	if (GetGUIBlurredBackground() != nullptr)
 	{
 		wiImage::SetBackground(*GetGUIBlurredBackground(), cmd);
 	}
 
+#ifndef DISABLERTFINAL
+	// The retained GUI layer has its own render pass, it's composited with the GUI rendering:
+	GetGUI().RenderLayer(*this, cmd);
+#endif
+
 	// Special care for internal resolution, because stencil buffer is of internal resolution, 
 	//	so we might need to render stencil sprites to separate render target that matches internal resolution!
 #ifndef DISABLERTFINAL
@@ -221,6 +259,7 @@ void RenderPath2D::Render( int mode ) const
 		device->BindViewports(1, &vp, cmd);
 
 		wiRenderer::GetDevice()->EventBegin("STENCIL Sprite Layers", cmd);
+		wiImage::BeginBatch(cmd);
 		for (auto& x : layers)
 		{
 			for (auto& y : x.items)
@@ -233,6 +272,7 @@ void RenderPath2D::Render( int mode ) const
 				}
 			}
 		}
+		wiImage::EndBatch(cmd);
 		wiRenderer::GetDevice()->EventEnd(cmd);
 
 		device->RenderPassEnd(cmd);
@@ -267,6 +307,7 @@ void RenderPath2D::Render( int mode ) const
 		else
 		{
 			wiRenderer::GetDevice()->EventBegin("STENCIL Sprite Layers", cmd);
+			wiImage::BeginBatch(cmd);
 			for (auto& x : layers)
 			{
 				for (auto& y : x.items)
@@ -279,10 +320,14 @@ void RenderPath2D::Render( int mode ) const
 					}
 				}
 			}
+			wiImage::EndBatch(cmd);
 			wiRenderer::GetDevice()->EventEnd(cmd);
 		}
 	}
 
+	// Sprites, fonts and the GUI are batched, the fonts and widgets flush the batch when they need to
+	wiImage::BeginBatch(cmd);
+
 	wiRenderer::GetDevice()->EventBegin("Sprite Layers", cmd);
 	for (auto& x : layers)
 	{
@@ -310,9 +355,13 @@ void RenderPath2D::Render( int mode ) const
 
 	GetGUI().Render(*this, cmd);
 
+	wiImage::EndBatch(cmd);
+
 	device->RenderPassEnd(cmd);
 #endif
 
+	wiJobSystem::Wait(ctx);
+
 	RenderPath::Render( mode );
 }
 void RenderPath2D::Compose(CommandList cmd) const
@@ -343,18 +392,41 @@ void RenderPath2D::Compose(CommandList cmd) const
 		GGTerrain::GGTerrain_Draw_Overlay(cmd);
 	}
 
-	// hook back to main app to allow it to render IMGUI IDE
-	GraphicsDevice* device = wiRenderer::GetDevice();
-	ImGuiHook_RenderCall((void*)device->GetDeviceContext(cmd));
+	if (ui_recorded)
+	{
+		ComposeUI(cmd);
+	}
+	else
+	{
+		// hook back to main app to allow it to render IMGUI IDE
+		GraphicsDevice* device = wiRenderer::GetDevice();
+		device->ExecuteNativeCommands(cmd, [](void* context) { ImGuiHook_RenderCall(context); });
+	}
 
 	if (!g_bNoTerrainRender)
 	{
 		GGTerrain::GGTerrain_Draw_Debug(cmd);
 	}
+#else
+	ComposeUI(cmd);
 #endif
 
 	RenderPath::Compose(cmd);
 }
+void RenderPath2D::ComposeUI(CommandList cmd) const
+{
+	if (!ui_recorded)
+	{
+		return;
+	}
+
+	// The UI target contains premultiplied colors:
+	wiImageParams fx;
+	fx.enableFullScreen();
+	fx.blendFlag = BLENDMODE_PREMULTIPLIED;
+
+	wiImage::Draw(&rtUI, fx, cmd);
+}
 
 
 void RenderPath2D::AddSprite(wiSprite* sprite, const std::string& layer)
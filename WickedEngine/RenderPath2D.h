@@ -39,6 +39,14 @@ private:
 	wiGraphics::RenderPass renderpass_stenciled;
 	wiGraphics::RenderPass renderpass_final;
 
+	// wiUIRenderer draw data is recorded into this on a worker thread, it's created when there is UI draw data
+	wiGraphics::Texture rtUI;
+	wiGraphics::RenderPass renderpass_ui;
+	mutable bool ui_recorded = false;
+
+	// Composite the UI that was recorded by Render()
+	void ComposeUI(wiGraphics::CommandList cmd) const;
+
 	wiGUI GUI;
 
 	XMUINT2 current_buffersize{};
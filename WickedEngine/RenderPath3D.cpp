@@ -5,6 +5,7 @@
 #include "wiTextureHelper.h"
 #include "shaders/ResourceMapping.h"
 #include "wiProfiler.h"
+#include "wiCounters.h"
 
 #ifdef GGREDUCED
 #define DELAYEDSHADOWS
@@ -84,6 +85,14 @@ namespace GPUParticles
 }
 #endif
 
+// A camera cut is a jump that the temporal history of the clouds can't be reprojected from: a move of more than 50 meters or a turn of more than 45 degrees in one frame
+static bool IsCloudCameraCut(const wiScene::CameraComponent& camera, const wiScene::CameraComponent& camera_previous)
+{
+	const float distance = wiMath::Distance(camera.Eye, camera_previous.Eye);
+	const float turn = XMVectorGetX(XMVector3Dot(XMVector3Normalize(XMLoadFloat3(&camera.At)), XMVector3Normalize(XMLoadFloat3(&camera_previous.At))));
+	return distance > 50.0f || turn < 0.7071f;
+}
+
 void RenderPath3D::ResizeBuffers()
 {
 	GraphicsDevice* device = wiRenderer::GetDevice();
@@ -91,6 +100,7 @@ void RenderPath3D::ResizeBuffers()
 	XMUINT2 internalResolution;
 	internalResolution.x = GetWidth3D();
 	internalResolution.y = GetHeight3D();
+	const XMUINT2 postprocessResolution = GetPostprocessResolution();
 
 	camera->CreatePerspective((float)internalResolution.x, (float)internalResolution.y, camera->zNearP, camera->zFarP);
 	
@@ -255,34 +265,54 @@ void RenderPath3D::ResizeBuffers()
 			device->SetName(&rtSun_resolved, "rtSun_resolved");
 		}
 	}
-#ifndef REMOVE_TEMPORAL_AA
+#ifdef REMOVE_TEMPORAL_AA
+	if (!IsTemporalUpscaling())
+	{
+		rtTemporalAA[0] = {};
+		rtTemporalAA[1] = {};
+	}
+	else
+#endif
+	if (rtTemporalAA[0].desc.Width != postprocessResolution.x || rtTemporalAA[0].desc.Height != postprocessResolution.y)
 	{
+		// The history is only recreated when its size changes, so a dynamic resolution change under temporal upscaling doesn't reset it:
 		TextureDesc desc;
 		desc.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
 		desc.Format = FORMAT_R11G11B10_FLOAT;
-		desc.Width = internalResolution.x;
-		desc.Height = internalResolution.y;
+		desc.Width = postprocessResolution.x;
+		desc.Height = postprocessResolution.y;
 		device->CreateTexture(&desc, nullptr, &rtTemporalAA[0]);
 		device->SetName(&rtTemporalAA[0], "rtTemporalAA[0]");
 		device->CreateTexture(&desc, nullptr, &rtTemporalAA[1]);
 		device->SetName(&rtTemporalAA[1], "rtTemporalAA[1]");
 	}
-#endif
 	{
 		TextureDesc desc;
 		desc.BindFlags = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
 		desc.Format = FORMAT_R11G11B10_FLOAT;
-		desc.Width = internalResolution.x;
-		desc.Height = internalResolution.y;
+		desc.Width = postprocessResolution.x;
+		desc.Height = postprocessResolution.y;
 		device->CreateTexture(&desc, nullptr, &rtPostprocess_HDR);
 		device->SetName(&rtPostprocess_HDR, "rtPostprocess_HDR");
+
+		if (IsTemporalUpscaling())
+		{
+			desc.Width = internalResolution.x;
+			desc.Height = internalResolution.y;
+			device->CreateTexture(&desc, nullptr, &rtPostprocess_HDR_reduced);
+			device->SetName(&rtPostprocess_HDR_reduced, "rtPostprocess_HDR_reduced");
+		}
+		else
+		{
+			rtPostprocess_HDR_reduced = {};
+		}
 	}
 	{
 		TextureDesc desc;
 		desc.BindFlags = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
 		desc.Format = FORMAT_R10G10B10A2_UNORM;
-		desc.Width = internalResolution.x;
-		desc.Height = internalResolution.y;
+		desc.Width = postprocessResolution.x;
+		desc.Height = postprocessResolution.y;
 		device->CreateTexture(&desc, nullptr, &rtPostprocess_LDR[0]);
 		device->SetName(&rtPostprocess_LDR[0], "rtPostprocess_LDR[0]");
 		device->CreateTexture(&desc, nullptr, &rtPostprocess_LDR[1]);
@@ -315,6 +345,9 @@ void RenderPath3D::ResizeBuffers()
 
 		device->CreateTexture(&desc, nullptr, &rtShadingRate);
 		device->SetName(&rtShadingRate, "rtShadingRate");
+
+		device->CreateTexture(&desc, nullptr, &rtShadingRate_transparent);
+		device->SetName(&rtShadingRate_transparent, "rtShadingRate_transparent");
 	}
 
 	// Depth buffers:
@@ -430,6 +463,26 @@ void RenderPath3D::ResizeBuffers()
 		}
 
 		device->CreateRenderPass(&desc, &renderpass_main);
+
+		// Continues the main pass in an other command list, it is only used without MSAA, so it doesn't resolve:
+		desc.attachments.clear();
+		desc.attachments.push_back(RenderPassAttachment::RenderTarget(&rtGbuffer[GBUFFER_COLOR], RenderPassAttachment::LOADOP_LOAD));
+		desc.attachments.push_back(RenderPassAttachment::RenderTarget(&rtGbuffer[GBUFFER_NORMAL_ROUGHNESS], RenderPassAttachment::LOADOP_LOAD));
+		desc.attachments.push_back(
+			RenderPassAttachment::DepthStencil(
+				&depthBuffer_Main,
+				RenderPassAttachment::LOADOP_LOAD,
+				RenderPassAttachment::STOREOP_STORE,
+				IMAGE_LAYOUT_DEPTHSTENCIL_READONLY,
+				IMAGE_LAYOUT_DEPTHSTENCIL_READONLY,
+				IMAGE_LAYOUT_DEPTHSTENCIL_READONLY
+			)
+		);
+		if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_VARIABLE_RATE_SHADING_TIER2))
+		{
+			desc.attachments.push_back(RenderPassAttachment::ShadingRateSource(&rtShadingRate, IMAGE_LAYOUT_UNORDERED_ACCESS, IMAGE_LAYOUT_UNORDERED_ACCESS));
+		}
+		device->CreateRenderPass(&desc, &renderpass_main_load);
 	}
 	{
 		RenderPassDesc desc;
@@ -448,6 +501,10 @@ void RenderPath3D::ResizeBuffers()
 		{
 			desc.attachments.push_back(RenderPassAttachment::Resolve(&rtGbuffer_resolved[GBUFFER_COLOR]));
 		}
+		if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_VARIABLE_RATE_SHADING_TIER2))
+		{
+			desc.attachments.push_back(RenderPassAttachment::ShadingRateSource(&rtShadingRate_transparent, IMAGE_LAYOUT_UNORDERED_ACCESS, IMAGE_LAYOUT_UNORDERED_ACCESS));
+		}
 		device->CreateRenderPass(&desc, &renderpass_transparent);
 	}
 	{
@@ -573,17 +630,32 @@ void RenderPath3D::ResizeBuffers()
 		device->CreateTexture(&desc, nullptr, &debugUAV);
 		device->SetName(&debugUAV, "debugUAV");
 	}
+	{
+		TextureDesc desc;
+		desc.BindFlags = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE;
+		desc.Format = FORMAT_R16_FLOAT;
+		desc.Width = internalResolution.x;
+		desc.Height = internalResolution.y;
+		device->CreateTexture(&desc, nullptr, &rtOverdraw);
+		device->SetName(&rtOverdraw, "rtOverdraw");
+
+		RenderPassDesc renderpassdesc;
+		renderpassdesc.attachments.push_back(RenderPassAttachment::RenderTarget(&rtOverdraw, RenderPassAttachment::LOADOP_CLEAR));
+		device->CreateRenderPass(&renderpassdesc, &renderpass_overdraw);
+	}
 	wiRenderer::CreateTiledLightResources(tiledLightResources, internalResolution);
 	wiRenderer::CreateTiledLightResources(tiledLightResources_planarReflection, internalResolution);
 	wiRenderer::CreateLuminanceResources(luminanceResources, internalResolution);
 	wiRenderer::CreateScreenSpaceShadowResources(screenspaceshadowResources, internalResolution);
 	wiRenderer::CreateDepthOfFieldResources(depthoffieldResources, internalResolution);
 	wiRenderer::CreateMotionBlurResources(motionblurResources, internalResolution);
-	wiRenderer::CreateVolumetricCloudResources(volumetriccloudResources[0], internalResolution);
-	wiRenderer::CreateVolumetricCloudResources(volumetriccloudResources[1], internalResolution);
-	wiRenderer::CreateVolumetricCloudResources(volumetriccloudResources_reflection[0], XMUINT2(depthBuffer_Reflection.desc.Width, depthBuffer_Reflection.desc.Height));
-	wiRenderer::CreateVolumetricCloudResources(volumetriccloudResources_reflection[1], XMUINT2(depthBuffer_Reflection.desc.Width, depthBuffer_Reflection.desc.Height));
-	wiRenderer::CreateBloomResources(bloomResources, internalResolution);
+	CreateVolumetricCloudResources();
+	wiRenderer::CreateBloomResources(bloomResources, postprocessResolution);
+
+	if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
+	{
+		wiRenderer::CreateRTDenoiserResources(rtdenoiserResources, internalResolution);
+	}
 
 #ifndef REMOVE_RAY_TRACED_SHADOW
 	if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
@@ -624,6 +696,101 @@ void RenderPath3D::SetFSRScale( float scale )
 	height3D = origHeight3D / fsrUpScale;
 }
 
+void RenderPath3D::SetTemporalUpscalingEnabled(bool value)
+{
+	if (temporalUpscalingEnabled == value) return;
+
+	temporalUpscalingEnabled = value;
+	if (rtPostprocess_HDR.IsValid())
+		ResizeBuffers();
+}
+
+bool RenderPath3D::IsTemporalUpscaling() const
+{
+#ifdef GGREDUCED
+	return temporalUpscalingEnabled && GetFSRScale() != 1.0f;
+#else
+	return false;
+#endif
+}
+
+XMUINT2 RenderPath3D::GetPostprocessResolution() const
+{
+#ifdef GGREDUCED
+	if (IsTemporalUpscaling())
+	{
+		return XMUINT2(uint32_t(GetWidth3D() * GetFSRScale()), uint32_t(GetHeight3D() * GetFSRScale()));
+	}
+#endif
+	return XMUINT2((uint32_t)GetWidth3D(), (uint32_t)GetHeight3D());
+}
+
+void RenderPath3D::UpdateDynamicResolution()
+{
+	if (!dynamicResolution.enabled)
+	{
+		dynamicResolutionFrames = 0;
+		dynamicResolutionTime = 0;
+		return;
+	}
+	const float gpuFrameTime = wiProfiler::GetGPUFrameTime();
+	if (gpuFrameTime <= 0)
+	{
+		return;
+	}
+	dynamicResolutionTime += gpuFrameTime;
+	dynamicResolutionFrames++;
+	if (dynamicResolutionFrames < std::max(1u, dynamicResolution.interval))
+	{
+		return;
+	}
+	const float averageFrameTime = dynamicResolutionTime / dynamicResolutionFrames;
+	dynamicResolutionFrames = 0;
+	dynamicResolutionTime = 0;
+
+	// Variable rate shading is cheaper to switch than the resolution, it is the first to be enabled and the last to be disabled:
+	if (dynamicResolution.variableRateShading && wiRenderer::GetDevice()->CheckCapability(GRAPHICSDEVICE_CAPABILITY_VARIABLE_RATE_SHADING_TIER2))
+	{
+		if (averageFrameTime > dynamicResolution.targetFrameTime && !wiRenderer::GetVariableRateShadingClassification())
+		{
+			wiRenderer::SetVariableRateShadingClassification(true);
+			dynamicResolutionVRS = true;
+			return;
+		}
+		if (dynamicResolutionVRS && averageFrameTime < dynamicResolution.targetFrameTime * 0.7f && GetDynamicResolutionScale() >= dynamicResolution.maxScale)
+		{
+			wiRenderer::SetVariableRateShadingClassification(false);
+			dynamicResolutionVRS = false;
+			return;
+		}
+	}
+
+	// The GPU time is predicted to follow the pixel count, the scale only goes up if the prediction still leaves some headroom:
+	const float scale = GetDynamicResolutionScale();
+	float newScale = scale;
+	if (averageFrameTime > dynamicResolution.targetFrameTime)
+	{
+		newScale = scale - dynamicResolution.step;
+	}
+	else
+	{
+		const float upScale = scale + dynamicResolution.step;
+		const float predicted = averageFrameTime * (upScale * upScale) / (scale * scale);
+		if (predicted < dynamicResolution.targetFrameTime * 0.9f)
+		{
+			newScale = upScale;
+		}
+	}
+	newScale = wiMath::Clamp(newScale, dynamicResolution.minScale, dynamicResolution.maxScale);
+	if (std::abs(newScale - scale) < 0.001f)
+	{
+		return;
+	}
+
+	SetFSRScale(1.0f / newScale);
+	ResizeBuffers();
+}
+
 void RenderPath3D::PreUpdate()
 {
 	camera_previous = *camera;
@@ -653,12 +820,29 @@ void RenderPath3D::Update(float dt)
 	{
 		ResizeBuffers();
 	}
+#ifdef GGREDUCED
+	UpdateDynamicResolution();
+#endif
+	if ((tiledLightResources.tileCount.z > 1) != wiRenderer::GetClusteredLightCulling())
+	{
+		// Switching between tiled and clustered entity culling:
+		const XMUINT2 internalResolution = XMUINT2((uint32_t)GetWidth3D(), (uint32_t)GetHeight3D());
+		wiRenderer::CreateTiledLightResources(tiledLightResources, internalResolution);
+		wiRenderer::CreateTiledLightResources(tiledLightResources_planarReflection, internalResolution);
+	}
 
 	RenderPath2D::Update(dt);
 
 	if (getSceneUpdateEnabled())
 	{
-		scene->Update(dt * wiRenderer::GetGameSpeed());
+		if (simulation.fixed)
+		{
+			scene->UpdateFixed(simulation.dt * wiRenderer::GetGameSpeed(), simulation.steps, simulation.alpha);
+		}
+		else
+		{
+			scene->Update(dt * wiRenderer::GetGameSpeed());
+		}
 		if (wiRenderer::GetRaytracedShadowsEnabled() ||
 			getAO() == AO_RTAO ||
 			getRaytracedReflectionEnabled())
@@ -667,6 +851,52 @@ void RenderPath3D::Update(float dt)
 		}
 	}
 
+	// The shaders of the enabled features are created in the background, so they are usually ready when they are first used:
+	if (wiRenderer::GetVoxelRadianceEnabled())
+	{
+		wiRenderer::PrefetchShaders(SHADERGROUP_VOXELGI);
+	}
+	if (getSSREnabled())
+	{
+		wiRenderer::PrefetchShaders(SHADERGROUP_SSR);
+	}
+	if (getLightShaftsEnabled())
+	{
+		wiRenderer::PrefetchShaders(SHADERGROUP_LIGHTSHAFTS);
+	}
+	if (getDepthOfFieldEnabled())
+	{
+		wiRenderer::PrefetchShaders(SHADERGROUP_DEPTHOFFIELD);
+	}
+	if (getMotionBlurEnabled())
+	{
+		wiRenderer::PrefetchShaders(SHADERGROUP_MOTIONBLUR);
+	}
+	if (getBloomEnabled())
+	{
+		wiRenderer::PrefetchShaders(SHADERGROUP_BLOOM);
+	}
+	if (scene->weather.IsVolumetricClouds())
+	{
+		wiRenderer::PrefetchShaders(SHADERGROUP_VOLUMETRICCLOUDS);
+	}
+	if (getChromaticAberrationEnabled())
+	{
+		wiRenderer::PrefetchShaders(SHADERGROUP_CHROMATIC_ABERRATION);
+	}
+	if (getFSREnabled())
+	{
+		wiRenderer::PrefetchShaders(SHADERGROUP_FSR);
+	}
+	if (wiRenderer::GetRaytracedShadowsEnabled())
+	{
+		wiRenderer::PrefetchShaders(SHADERGROUP_RTSHADOW);
+	}
+	if (getAO() == AO_RTAO)
+	{
+		wiRenderer::PrefetchShaders(SHADERGROUP_RTAO);
+	}
+
 	// Frustum culling for main camera:
 #ifdef GGREDUCED
 #ifdef OPTICK_ENABLE
@@ -679,6 +909,15 @@ void RenderPath3D::Update(float dt)
 	visibility_main.flags = wiRenderer::Visibility::ALLOW_EVERYTHING;
 	wiRenderer::UpdateVisibility(visibility_main, maxApparentSize); 
 
+	{
+		static const wiCounters::counter_id counter_visible_objects = wiCounters::Register("Renderer.VisibleObjects");
+		static const wiCounters::counter_id counter_visible_lights = wiCounters::Register("Renderer.VisibleLights");
+		static const wiCounters::counter_id counter_culled_lights = wiCounters::Register("Renderer.CulledLights");
+		wiCounters::Set(counter_visible_objects, (double)visibility_main.visibleObjects.size());
+		wiCounters::Set(counter_visible_lights, (double)visibility_main.visibleLights.size());
+		wiCounters::Set(counter_culled_lights, (double)(scene->lights.GetCount() - visibility_main.visibleLights.size()));
+	}
+
 	if (visibility_main.planar_reflection_visible && getReflectionsEnabled())
 	{
 		// Frustum culling for planar reflections:
@@ -715,7 +954,7 @@ void RenderPath3D::Update(float dt)
 		dt
 	);
 
-	if (wiRenderer::GetTemporalAAEnabled())
+	if (wiRenderer::GetTemporalAAEnabled() || IsTemporalUpscaling())
 	{
 		const XMFLOAT4& halton = wiMath::GetHaltonSequence(wiRenderer::GetDevice()->GetFrameCount() % 256);
 		camera->jitter.x = (halton.x * 2 - 1) / (float)internalResolution.x;
@@ -796,19 +1035,32 @@ void RenderPath3D::Render(int mode) const
 		});
 #endif
 
+	CommandList cmd_accelerationstructures = INVALID_COMMANDLIST;
 	if (scene->IsAccelerationStructureUpdateRequested())
 	{
 		// Acceleration structures:
 		//	async compute parallel with depth prepass
-		cmd = device->BeginCommandList(QUEUE_COMPUTE);
+		cmd = device->BeginCommandList(getAsyncComputeEnabled(ASYNC_COMPUTE_ACCELERATION_STRUCTURES) ? QUEUE_COMPUTE : QUEUE_GRAPHICS);
 		device->WaitCommandList(cmd, cmd_prepareframe);
+		cmd_accelerationstructures = cmd;
 		wiJobSystem::Execute(ctx, [this, cmd](wiJobArgs args) {
 
-			wiRenderer::UpdateRaytracingAccelerationStructures(*scene, cmd);
+			wiRenderer::UpdateRaytracingAccelerationStructures(*scene, cmd, camera);
 
 			});
 	}
 
+	// Particle and ocean simulation:
+	//	(async compute, parallel to "depth prepass" and "shadow maps",
+	//	must finish before "main scene opaque color pass")
+	cmd = device->BeginCommandList(getAsyncComputeEnabled(ASYNC_COMPUTE_SIMULATION) ? QUEUE_COMPUTE : QUEUE_GRAPHICS);
+	device->WaitCommandList(cmd, cmd_prepareframe);
+	CommandList cmd_simulation = cmd;
+	wiJobSystem::Execute(ctx, [this, cmd](wiJobArgs args) {
+		wiRenderer::GetDevice()->BindResource(CS, &depthBuffer_Copy1, TEXSLOT_DEPTH, cmd);
+		wiRenderer::UpdateRenderDataAsync(visibility_main, cmd);
+		});
+
 	static const uint32_t drawscene_flags =
 		wiRenderer::DRAWSCENE_OPAQUE |
 		wiRenderer::DRAWSCENE_HAIRPARTICLE |
@@ -834,6 +1086,15 @@ void RenderPath3D::Render(int mode) const
 			cmd
 		);
 
+#ifdef GGREDUCED
+		// The trees are culled once for all the views of the frame, before the first pass that draws them:
+		if (!g_bNoTerrainRender)
+		{
+			wiRenderer::PrepareTreeCulling(visibility_main, &camera_reflection, cmd);
+		}
+#endif
+
+		auto pass = wiProfiler::BeginPassGPU("Prepass", cmd);
 		device->RenderPassBegin(&renderpass_depthprepass, cmd);
 
 		device->EventBegin("Opaque Z-prepass", cmd);
@@ -876,6 +1137,7 @@ void RenderPath3D::Render(int mode) const
 		}
 
 		device->RenderPassEnd(cmd);
+		wiProfiler::EndPassGPU(pass);
 
 #ifdef GGREDUCED
 		if (!g_bNoTerrainRender)
@@ -888,8 +1150,12 @@ void RenderPath3D::Render(int mode) const
 	// Main camera compute effects:
 	//	(async compute, parallel to "shadow maps" and "update textures",
 	//	must finish before "main scene opaque color pass")
-	cmd = device->BeginCommandList(QUEUE_COMPUTE);
+	cmd = device->BeginCommandList(getAsyncComputeEnabled(ASYNC_COMPUTE_EFFECTS) ? QUEUE_COMPUTE : QUEUE_GRAPHICS);
 	device->WaitCommandList(cmd, cmd_maincamera_prepass);
+	if (cmd_accelerationstructures != INVALID_COMMANDLIST)
+	{
+		device->WaitCommandList(cmd, cmd_accelerationstructures); // ray traced effects, when the two are on different queues
+	}
 	CommandList cmd_maincamera_compute_effects = cmd;
 	wiJobSystem::Execute(ctx, [this, cmd, previousCamera, cloudIndex](wiJobArgs args) {
 
@@ -902,6 +1168,11 @@ void RenderPath3D::Render(int mode) const
 			cmd
 		);
 
+		auto pass = wiProfiler::BeginPassGPU("Compute Effects", cmd);
+
+		// The lower mips of the depth pyramid are transitioned while the top mip is created:
+		wiRenderer::Postprocess_DepthPyramid_Prepare(depthBuffer_Copy, rtLinearDepth, cmd);
+
 		// Create the top mip of depth pyramid from main depth buffer:
 		if (getMSAASampleCount() > 1)
 		{
@@ -912,18 +1183,29 @@ void RenderPath3D::Render(int mode) const
 			wiRenderer::CopyTexture2D(depthBuffer_Copy, 0, 0, 0, depthBuffer_Main, 0, cmd);
 		}
 
-		wiRenderer::Postprocess_DepthPyramid(depthBuffer_Copy, rtLinearDepth, cmd);
+		wiRenderer::Postprocess_DepthPyramid(depthBuffer_Copy, rtLinearDepth, cmd, true);
+
+		if (getOcclusionCullingEnabled())
+		{
+			wiRenderer::OcclusionCulling_HiZReadback(*camera, rtLinearDepth, cmd);
+		}
 
 		RenderAO(cmd);
 
 		if (wiRenderer::GetVariableRateShadingClassification() && device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_VARIABLE_RATE_SHADING_TIER2))
 		{
+			// The scene copy still contains the previous frame at this point:
+			const bool dof = getDepthOfFieldEnabled() && camera->aperture_size > 0 && getDepthOfFieldStrength() > 0;
 			wiRenderer::ComputeShadingRateClassification(
 				GetGbuffer_Read(),
 				rtLinearDepth,
 				rtShadingRate,
+				rtShadingRate_transparent,
 				debugUAV,
-				cmd
+				*camera,
+				cmd,
+				&rtSceneCopy,
+				dof ? getDepthOfFieldStrength() : 0
 			);
 		}
 
@@ -960,7 +1242,8 @@ void RenderPath3D::Render(int mode) const
 				wiRenderer::Postprocess_VolumetricClouds(
 					volumetriccloudResources[cloudIndex],
 					depthBuffer_Copy,
-					cmd
+					cmd,
+					IsCloudCameraCut(cameraClouds, cameraCloudsPrev)
 				);
 
 				wiRenderer::UpdateCameraCB(
@@ -1003,6 +1286,7 @@ void RenderPath3D::Render(int mode) const
 		{
 			wiRenderer::Postprocess_RTShadow(
 				rtshadowResources,
+				rtdenoiserResources,
 				*scene,
 				depthBuffer_Copy,
 				rtLinearDepth,
@@ -1015,6 +1299,7 @@ void RenderPath3D::Render(int mode) const
 		}
 #endif
 
+		wiProfiler::EndPassGPU(pass);
 			});
 
 	// Shadow maps:
@@ -1026,7 +1311,9 @@ void RenderPath3D::Render(int mode) const
 	{
 		cmd = device->BeginCommandList();
 		wiJobSystem::Execute(ctx, [this, cmd](wiJobArgs args) {
+			auto pass = wiProfiler::BeginPassGPU("Shadows", cmd);
 			wiRenderer::DrawShadowmaps(visibility_main, cmd);
+			wiProfiler::EndPassGPU(pass);
 			});
 	}
 
@@ -1121,7 +1408,8 @@ void RenderPath3D::Render(int mode) const
 					wiRenderer::Postprocess_VolumetricClouds(
 						volumetriccloudResources_reflection[cloudIndex],
 						depthBuffer_Reflection,
-						cmd
+						cmd,
+						IsCloudCameraCut(cameraClouds, cameraCloudsPrev)
 					);
 
 					wiRenderer::UpdateCameraCB(
@@ -1227,12 +1515,15 @@ void RenderPath3D::Render(int mode) const
 	}
 
 	// Main camera opaque color pass:
-	cmd = device->BeginCommandList();
-	device->WaitCommandList(cmd, cmd_maincamera_compute_effects);
-	wiJobSystem::Execute(ctx, [this, cmd, previousCamera, cloudIndex](wiJobArgs args) {
+	//	With many visible objects the scene draws are recorded into several command lists concurrently.
+	//	The command lists are submitted in the order they are begun, and a render pass can't continue in an other command list,
+	//	so the first one begins renderpass_main and the next ones continue it with renderpass_main_load
+	const uint32_t opaque_chunks = getMSAASampleCount() > 1 ? 1 : wiRenderer::GetDrawSceneChunkCount(visibility_main, drawscene_flags);
+
+	// The state that the opaque scene draws expect in every command list of the pass:
+	auto bind_opaque_state = [this, previousCamera](CommandList cmd) {
 
 		GraphicsDevice* device = wiRenderer::GetDevice();
-		device->EventBegin("Opaque Scene", cmd);
 
 		wiRenderer::UpdateCameraCB(
 			*camera,
@@ -1241,37 +1532,14 @@ void RenderPath3D::Render(int mode) const
 			cmd
 		);
 
-		// This can't run in "main camera compute effects" async compute,
-		//	because it depends on shadow maps, and envmaps
-		if (getRaytracedReflectionEnabled())
-		{
-			wiRenderer::Postprocess_RTReflection(
-				rtreflectionResources,
-				*scene,
-				depthBuffer_Copy,
-				depthBuffer_Copy1,
-				GetGbuffer_Read(),
-				rtSSR,
-				cmd
-			);
-		}
-
-		device->RenderPassBegin(&renderpass_main, cmd);
-
-		
-
 		Viewport vp;
 		vp.Width = (float)depthBuffer_Main.GetDesc().Width;
 		vp.Height = (float)depthBuffer_Main.GetDesc().Height;
 		device->BindViewports(1, &vp, cmd);
 
-		auto range = wiProfiler::BeginRangeGPU("Opaque - Scene", cmd);
-
 		#ifndef REMOVE_RAY_TRACED_SHADOW
 		if (wiRenderer::GetRaytracedShadowsEnabled() || wiRenderer::GetScreenSpaceShadowsEnabled())
 		{
-			GPUBarrier barrier = GPUBarrier::Image(&rtShadow, rtShadow.desc.layout, IMAGE_LAYOUT_SHADER_RESOURCE);
-			device->Barrier(&barrier, 1, cmd);
 			device->BindResource(PS, &rtShadow, TEXSLOT_RENDERPATH_RTSHADOW, cmd);
 		}
 		else
@@ -1283,40 +1551,15 @@ void RenderPath3D::Render(int mode) const
 		#endif
 
 		device->BindResource(PS, &tiledLightResources.entityTiles_Opaque, TEXSLOT_RENDERPATH_ENTITYTILES, cmd);
-//#ifdef GGREDUCED
-//		const Texture* transparent = wiTextureHelper::getTransparent();
-//		if (!(transparent != nullptr && transparent->IsValid()))
-//		{
-//			__debugbreak();
-//		}
-//		else
-//			device->BindResource(PS, getReflectionsEnabled() ? &rtReflection : transparent, TEXSLOT_RENDERPATH_REFLECTION, cmd);
-//#else
 		device->BindResource(PS, getReflectionsEnabled() ? &rtReflection : wiTextureHelper::getTransparent(), TEXSLOT_RENDERPATH_REFLECTION, cmd);
-//#endif
-
-//#ifdef GGREDUCED
-//		// this can fail and crash (maybe race condition?)
-//		const Texture* white = wiTextureHelper::getWhite();
-//		if( !(white != nullptr && white->IsValid()))
-//		{
-//			__debugbreak();
-//		}
-//		else
-//		{
-//			device->BindResource(PS, getAOEnabled() ? &rtAO : white, TEXSLOT_RENDERPATH_AO, cmd);
-//		}
-//#else
 		device->BindResource(PS, getAOEnabled() ? &rtAO : wiTextureHelper::getWhite(), TEXSLOT_RENDERPATH_AO, cmd);
-//#endif
-//#ifdef GGREDUCED
-//		if ((transparent != nullptr && transparent->IsValid()))
-//			device->BindResource(PS, getSSREnabled() || getRaytracedReflectionEnabled() ? &rtSSR : transparent, TEXSLOT_RENDERPATH_SSR, cmd);
-//#else
 		device->BindResource(PS, getSSREnabled() || getRaytracedReflectionEnabled() ? &rtSSR : wiTextureHelper::getTransparent(), TEXSLOT_RENDERPATH_SSR, cmd);
-//#endif
-		wiRenderer::DrawScene(visibility_main, RENDERPASS_MAIN, cmd, drawscene_flags);
-		wiProfiler::EndRange(range); // Opaque Scene
+	};
+
+	// The opaque pass after the scene draws, it ends the render pass:
+	auto render_opaque_rest = [this, previousCamera, cloudIndex](CommandList cmd) {
+
+		GraphicsDevice* device = wiRenderer::GetDevice();
 
 #ifdef GGREDUCED
 		if (!g_bNoTerrainRender)
@@ -1333,7 +1576,7 @@ void RenderPath3D::Render(int mode) const
 #ifdef GGREDUCED
 		if (!g_bNoTerrainRender)
 		{
-			range = wiProfiler::BeginRangeGPU("Opaque - Sky", cmd);
+			auto range = wiProfiler::BeginRangeGPU("Opaque - Sky", cmd);
 			wiRenderer::DrawSky(*scene, cmd);
 			wiProfiler::EndRange(range);
 		}
@@ -1377,9 +1620,117 @@ void RenderPath3D::Render(int mode) const
 			device->Barrier(&barrier, 1, cmd);
 		}
 #endif
+	};
+
+	cmd = device->BeginCommandList();
+	device->WaitCommandList(cmd, cmd_maincamera_compute_effects);
+	device->WaitCommandList(cmd, cmd_simulation);
+	wiJobSystem::Execute(ctx, [this, cmd, previousCamera, opaque_chunks, bind_opaque_state, render_opaque_rest](wiJobArgs args) {
+
+		GraphicsDevice* device = wiRenderer::GetDevice();
+		device->EventBegin("Opaque Scene", cmd);
+		auto pass = wiProfiler::BeginPassGPU("Opaque", cmd);
+
+		wiRenderer::UpdateCameraCB(
+			*camera,
+			*previousCamera,
+			camera_reflection,
+			cmd
+		);
+
+		// This can't run in "main camera compute effects" async compute,
+		//	because it depends on shadow maps, and envmaps
+		if (getRaytracedReflectionEnabled())
+		{
+			wiRenderer::Postprocess_RTReflection(
+				rtreflectionResources,
+				*scene,
+				depthBuffer_Copy,
+				depthBuffer_Copy1,
+				GetGbuffer_Read(),
+				rtSSR,
+				cmd
+			);
+		}
+
+		// Culls the opaque pass against the depth prepass, before the render pass begins:
+		if (wiRenderer::GetGPUCullingEnabled())
+		{
+			wiRenderer::GPUCulling_Prepare(visibility_main, &rtLinearDepth, drawscene_flags, cmd);
+		}
+#ifdef GGREDUCED
+		wiRenderer::GPUCulling_TerrainChunks(*camera, &rtLinearDepth, cmd);
+#endif
+
+		#ifndef REMOVE_RAY_TRACED_SHADOW
+		if (wiRenderer::GetRaytracedShadowsEnabled() || wiRenderer::GetScreenSpaceShadowsEnabled())
+		{
+			GPUBarrier barrier = GPUBarrier::Image(&rtShadow, rtShadow.desc.layout, IMAGE_LAYOUT_SHADER_RESOURCE);
+			device->Barrier(&barrier, 1, cmd);
+		}
+		#endif
+
+		device->RenderPassBegin(&renderpass_main, cmd);
+
+		bind_opaque_state(cmd);
+
+		auto range = wiProfiler::BeginRangeGPU("Opaque - Scene", cmd);
+		wiRenderer::DrawScene_Chunk(visibility_main, RENDERPASS_MAIN, cmd, drawscene_flags, 0, opaque_chunks);
+		wiProfiler::EndRange(range); // Opaque Scene
+
+		if (opaque_chunks > 1)
+		{
+			device->RenderPassEnd(cmd);
+		}
+		else
+		{
+			render_opaque_rest(cmd);
+		}
+
+		wiProfiler::EndPassGPU(pass);
 		device->EventEnd(cmd);
 		});
 
+	for (uint32_t chunk = 1; chunk < opaque_chunks; ++chunk)
+	{
+		cmd = device->BeginCommandList();
+		device->WaitCommandList(cmd, cmd_maincamera_compute_effects);
+		device->WaitCommandList(cmd, cmd_simulation);
+		wiJobSystem::Execute(ctx, [this, cmd, chunk, opaque_chunks, bind_opaque_state](wiJobArgs args) {
+
+			GraphicsDevice* device = wiRenderer::GetDevice();
+			device->EventBegin("Opaque Scene - Chunk", cmd);
+
+			device->RenderPassBegin(&renderpass_main_load, cmd);
+			bind_opaque_state(cmd);
+			wiRenderer::DrawScene_Chunk(visibility_main, RENDERPASS_MAIN, cmd, drawscene_flags, chunk, opaque_chunks);
+			device->RenderPassEnd(cmd);
+
+			device->EventEnd(cmd);
+			});
+	}
+
+	// The rest of the opaque pass is recorded after the chunks:
+	if (opaque_chunks > 1)
+	{
+		cmd = device->BeginCommandList();
+		device->WaitCommandList(cmd, cmd_maincamera_compute_effects);
+		device->WaitCommandList(cmd, cmd_simulation);
+		wiJobSystem::Execute(ctx, [this, cmd, bind_opaque_state, render_opaque_rest](wiJobArgs args) {
+
+			GraphicsDevice* device = wiRenderer::GetDevice();
+			device->EventBegin("Opaque Scene - Continue", cmd);
+			auto pass = wiProfiler::BeginPassGPU("Opaque - Continue", cmd);
+
+			device->RenderPassBegin(&renderpass_main_load, cmd);
+			bind_opaque_state(cmd);
+			render_opaque_rest(cmd);
+
+			wiProfiler::EndPassGPU(pass);
+			device->EventEnd(cmd);
+			});
+	}
+
 	// Transparents, post processes, etc:
 	cmd = device->BeginCommandList();
 	wiJobSystem::Execute(ctx, [this, cmd, previousCamera, mode](wiJobArgs args) {
@@ -1401,13 +1752,24 @@ void RenderPath3D::Render(int mode) const
 		device->BindViewports(1, &vp, cmd);
 #endif
 
+		auto pass = wiProfiler::BeginPassGPU("Light Shafts and Volumetrics", cmd);
 		RenderLightShafts(cmd, mode);
 
 		RenderVolumetrics(cmd);
+		wiProfiler::EndPassGPU(pass);
 
+		pass = wiProfiler::BeginPassGPU("Transparent", cmd);
 		RenderSceneMIPChain(cmd);
 
 		RenderTransparents(cmd, mode);
+		wiProfiler::EndPassGPU(pass);
+
+		if (wiRenderer::GetDebugOverdraw())
+		{
+			pass = wiProfiler::BeginPassGPU("Overdraw Visualizer", cmd);
+			wiRenderer::DrawOverdraw(visibility_main, renderpass_overdraw, debugUAV, cmd);
+			wiProfiler::EndPassGPU(pass);
+		}
 
 		RenderPostprocessChain(cmd);
 
@@ -1442,7 +1804,7 @@ void RenderPath3D::Compose(CommandList cmd) const
 	wiImage::Draw(GetLastPostprocessRT(), fx, cmd);
 	device->EventEnd(cmd);
 
-	if (wiRenderer::GetDebugLightCulling() || wiRenderer::GetVariableRateShadingClassificationDebug())
+	if (wiRenderer::GetDebugLightCulling() || wiRenderer::GetVariableRateShadingClassificationDebug() || wiRenderer::GetDebugOverdraw())
 	{
 		fx.enableFullScreen();
 		fx.blendFlag = BLENDMODE_PREMULTIPLIED;
@@ -1497,6 +1859,10 @@ void RenderPath3D::RenderAO(CommandList cmd) const
 
 	if (getAOEnabled())
 	{
+		wiRenderer::BeginTransientPass(transientResources, TRANSIENT_PASS_AO, cmd);
+
+		const Texture& output = rtAO_reduced.IsValid() ? rtAO_reduced : rtAO;
+
 		switch (getAO())
 		{
 		case AO_SSAO:
@@ -1504,7 +1870,7 @@ void RenderPath3D::RenderAO(CommandList cmd) const
 				ssaoResources,
 				depthBuffer_Copy,
 				rtLinearDepth,
-				rtAO,
+				output,
 				cmd,
 				getAORange(),
 				getAOSampleCount(),
@@ -1516,7 +1882,7 @@ void RenderPath3D::RenderAO(CommandList cmd) const
 				ssaoResources,
 				*camera,
 				rtLinearDepth,
-				rtAO,
+				output,
 				cmd,
 				getAOPower()
 				);
@@ -1534,6 +1900,7 @@ void RenderPath3D::RenderAO(CommandList cmd) const
 		case AO_RTAO:
 			wiRenderer::Postprocess_RTAO(
 				rtaoResources,
+				rtdenoiserResources,
 				*scene,
 				depthBuffer_Copy,
 				rtLinearDepth,
@@ -1546,6 +1913,11 @@ void RenderPath3D::RenderAO(CommandList cmd) const
 			);
 			break;
 		}
+
+		if (rtAO_reduced.IsValid())
+		{
+			wiRenderer::Postprocess_Upsample_Bilateral(rtAO_reduced, rtLinearDepth, rtAO, cmd);
+		}
 	}
 }
 void RenderPath3D::RenderSSR(CommandList cmd) const
@@ -1564,9 +1936,14 @@ void RenderPath3D::RenderSSR(CommandList cmd) const
 			rtLinearDepth,
 			depthBuffer_Copy1,
 			GetGbuffer_Read(),
-			rtSSR, 
+			rtSSR_reduced.IsValid() ? rtSSR_reduced : rtSSR,
 			cmd
 		);
+
+		if (rtSSR_reduced.IsValid())
+		{
+			wiRenderer::Postprocess_Upsample_Bilateral(rtSSR_reduced, rtLinearDepth, rtSSR, cmd);
+		}
 	}
 }
 void RenderPath3D::RenderOutline(CommandList cmd) const
@@ -1759,7 +2136,7 @@ void RenderPath3D::RenderTransparents(CommandList cmd, int mode) const
 
 		device->BindResource(VS, &rtLinearDepth, TEXSLOT_LINEARDEPTH, cmd);
 
-		device->BindResource(PS, &tiledLightResources.entityTiles_Transparent, TEXSLOT_RENDERPATH_ENTITYTILES, cmd);
+		device->BindResource(PS, &tiledLightResources.GetEntityTiles_Transparent(), TEXSLOT_RENDERPATH_ENTITYTILES, cmd);
 		device->BindResource(PS, &rtLinearDepth, TEXSLOT_LINEARDEPTH, cmd);
 		device->BindResource(PS, getReflectionsEnabled() ? &rtReflection : wiTextureHelper::getTransparent(), TEXSLOT_RENDERPATH_REFLECTION, cmd);
 		device->BindResource(PS, &rtSceneCopy, TEXSLOT_RENDERPATH_REFRACTION, cmd);
@@ -1895,33 +2272,42 @@ void RenderPath3D::RenderPostprocessChain(CommandList cmd) const
 {
 	GraphicsDevice* device = wiRenderer::GetDevice();
 
+	// With temporal upscaling, the effects before the resolve are at the 3D resolution and the ones after it at the output resolution:
+	const bool temporal_upscaling = IsTemporalUpscaling();
+
 	const Texture* rt_first = nullptr; // not ping-ponged with read / write
 	const Texture* rt_read = GetGbuffer_Read(GBUFFER_COLOR);
-	const Texture* rt_write = &rtPostprocess_HDR;
+	const Texture* rt_write = temporal_upscaling ? &rtPostprocess_HDR_reduced : &rtPostprocess_HDR;
+
+	auto temporal_resolve = [&]() {
+		int output = device->GetFrameCount() % 2;
+		int history = 1 - output;
+		auto pass = wiProfiler::BeginPassGPU("Postprocess - Temporal AA", cmd);
+		wiRenderer::Postprocess_TemporalAA(
+			*rt_read, rtTemporalAA[history], 
+			rtLinearDepth,
+			depthBuffer_Copy1,
+			GetGbuffer_Read(),
+			rtTemporalAA[output], 
+			cmd
+		);
+		wiProfiler::EndPassGPU(pass);
+		rt_first = &rtTemporalAA[output];
+	};
 
 	// 1.) HDR post process chain
 	{
 #ifndef REMOVE_TEMPORAL_AA
-		if (wiRenderer::GetTemporalAAEnabled() && !wiRenderer::GetTemporalAADebugEnabled())
+		if (!temporal_upscaling && wiRenderer::GetTemporalAAEnabled() && !wiRenderer::GetTemporalAADebugEnabled())
 		{
-			GraphicsDevice* device = wiRenderer::GetDevice();
-
-			int output = device->GetFrameCount() % 2;
-			int history = 1 - output;
-			wiRenderer::Postprocess_TemporalAA(
-				*rt_read, rtTemporalAA[history], 
-				rtLinearDepth,
-				depthBuffer_Copy1,
-				GetGbuffer_Read(),
-				rtTemporalAA[output], 
-				cmd
-			);
-			rt_first = &rtTemporalAA[output];
+			temporal_resolve();
 		}
 #endif
 
 		if (getDepthOfFieldEnabled() && camera->aperture_size > 0 && getDepthOfFieldStrength() > 0)
 		{
+			auto pass = wiProfiler::BeginPassGPU("Postprocess - Depth of Field", cmd);
+			wiRenderer::BeginTransientPass(transientResources, TRANSIENT_PASS_DEPTHOFFIELD, cmd);
 			wiRenderer::Postprocess_DepthOfField(
 				depthoffieldResources,
 				rt_first == nullptr ? *rt_read : *rt_first,
@@ -1930,6 +2316,7 @@ void RenderPath3D::RenderPostprocessChain(CommandList cmd) const
 				cmd,
 				getDepthOfFieldStrength()
 			);
+			wiProfiler::EndPassGPU(pass);
 			rt_first = nullptr;
 
 			std::swap(rt_read, rt_write);
@@ -1938,6 +2325,8 @@ void RenderPath3D::RenderPostprocessChain(CommandList cmd) const
 
 		if (getMotionBlurEnabled() && getMotionBlurStrength() > 0)
 		{
+			auto pass = wiProfiler::BeginPassGPU("Postprocess - Motion Blur", cmd);
+			wiRenderer::BeginTransientPass(transientResources, TRANSIENT_PASS_MOTIONBLUR, cmd);
 			wiRenderer::Postprocess_MotionBlur(
 				motionblurResources,
 				rt_first == nullptr ? *rt_read : *rt_first,
@@ -1947,14 +2336,23 @@ void RenderPath3D::RenderPostprocessChain(CommandList cmd) const
 				cmd,
 				getMotionBlurStrength()
 			);
+			wiProfiler::EndPassGPU(pass);
 			rt_first = nullptr;
 
 			std::swap(rt_read, rt_write);
 			device->UnbindResources(TEXSLOT_ONDEMAND0, 1, cmd);
 		}
 
+		if (temporal_upscaling)
+		{
+			// Depth of field and motion blur need the depth and velocity of every pixel, so they were done before this:
+			temporal_resolve();
+			rt_write = &rtPostprocess_HDR;
+		}
+
 		if (getBloomEnabled())
 		{
+			auto pass = wiProfiler::BeginPassGPU("Postprocess - Bloom", cmd);
 			wiRenderer::Postprocess_Bloom(
 				bloomResources,
 				rt_first == nullptr ? *rt_read : *rt_first,
@@ -1963,6 +2361,7 @@ void RenderPath3D::RenderPostprocessChain(CommandList cmd) const
 				getBloomThreshold(),
 				getBloomStrength()
 			);
+			wiProfiler::EndPassGPU(pass);
 			rt_first = nullptr;
 
 			std::swap(rt_read, rt_write);
@@ -1970,9 +2369,19 @@ void RenderPath3D::RenderPostprocessChain(CommandList cmd) const
 		}
 	}
 
+	// Sharpen is the first LDR filter, so it can always be merged into the tone mapping pass
+	//	Chromatic aberration is the last one, so it can only be merged when there are no other LDR filters
+	bool tonemap_chromatic_aberration = getChromaticAberrationEnabled() && !getFXAAEnabled();
+#ifdef GGREDUCED
+	tonemap_chromatic_aberration = tonemap_chromatic_aberration && !getRainEnabled() && !getSnowEnabled();
+#endif
+	const float tonemap_sharpen_amount = getSharpenFilterEnabled() ? getSharpenFilterAmount() : 0;
+	const float tonemap_chromatic_aberration_amount = tonemap_chromatic_aberration ? getChromaticAberrationAmount() : 0;
+
 	// 2.) Tone mapping HDR -> LDR
 	{
 		rt_write = &rtPostprocess_LDR[0];
+		auto pass = wiProfiler::BeginPassGPU("Postprocess - Tonemap", cmd);
 
 #ifdef GGREDUCED
 		if (!g_bNoTerrainRender)
@@ -1988,7 +2397,9 @@ void RenderPath3D::RenderPostprocessChain(CommandList cmd) const
 				getColorGradingEnabled() ? (scene->weather.colorGradingMap == nullptr ? nullptr : &scene->weather.colorGradingMap->texture) : nullptr,
 				getMSAASampleCount() > 1 ? &rtParticleDistortion_Resolved : &rtParticleDistortion,
 				getEyeAdaptionEnabled() ? wiRenderer::ComputeLuminance(luminanceResources, *GetGbuffer_Read(GBUFFER_COLOR), cmd, getEyeAdaptionRate()) : nullptr,
-				getEyeAdaptionKey()
+				getEyeAdaptionKey(),
+				tonemap_sharpen_amount,
+				tonemap_chromatic_aberration_amount
 			);
 #else
 			wiRenderer::Postprocess_Tonemap(
@@ -2000,7 +2411,9 @@ void RenderPath3D::RenderPostprocessChain(CommandList cmd) const
 				getColorGradingEnabled() ? (scene->weather.colorGradingMap == nullptr ? nullptr : &scene->weather.colorGradingMap->texture) : nullptr,
 				nullptr,
 				getEyeAdaptionEnabled() ? wiRenderer::ComputeLuminance(luminanceResources, *GetGbuffer_Read(GBUFFER_COLOR), cmd, getEyeAdaptionRate()) : nullptr,
-				getEyeAdaptionKey()
+				getEyeAdaptionKey(),
+				tonemap_sharpen_amount,
+				tonemap_chromatic_aberration_amount
 			);
 #endif
 #ifdef GGREDUCED
@@ -2017,11 +2430,15 @@ void RenderPath3D::RenderPostprocessChain(CommandList cmd) const
 				nullptr,
 				getMSAASampleCount() > 1 ? &rtParticleDistortion_Resolved : &rtParticleDistortion,
 				getEyeAdaptionEnabled() ? wiRenderer::ComputeLuminance(luminanceResources, *GetGbuffer_Read(GBUFFER_COLOR), cmd, getEyeAdaptionRate()) : nullptr,
-				getEyeAdaptionKey()
+				getEyeAdaptionKey(),
+				tonemap_sharpen_amount,
+				tonemap_chromatic_aberration_amount
 			);
 		}
 #endif
 
+		wiProfiler::EndPassGPU(pass);
+
 		rt_first = nullptr;
 		rt_read = rt_write;
 		rt_write = &rtPostprocess_LDR[1];
@@ -2030,21 +2447,15 @@ void RenderPath3D::RenderPostprocessChain(CommandList cmd) const
 
 	// 3.) LDR post process chain
 	{
-		if (getSharpenFilterEnabled())
-		{
-			wiRenderer::Postprocess_Sharpen(*rt_read, *rt_write, cmd, getSharpenFilterAmount());
-
-			std::swap(rt_read, rt_write);
-			device->UnbindResources(TEXSLOT_ONDEMAND0, 1, cmd);
-		}
-
 		#ifdef GGREDUCED
 		if (getRainEnabled())
 		{
 			//PE: Test rain shader.
 			if (!(rainTextureMap == nullptr || rainNormalMap == nullptr))
 			{
+				auto pass = wiProfiler::BeginPassGPU("Postprocess - Rain", cmd);
 				wiRenderer::Postprocess_Rain(*rt_read, *rt_write, cmd, rainTextureMap->texture, rainNormalMap->texture, rainOpacity, rainScaleX, rainScaleY, rainOffsetX, rainOffsetY, rainRefreactionScale);
+				wiProfiler::EndPassGPU(pass);
 				std::swap(rt_read, rt_write);
 				device->UnbindResources(TEXSLOT_ONDEMAND0, 1, cmd);
 				device->UnbindResources(TEXSLOT_ONDEMAND1, 1, cmd);
@@ -2054,7 +2465,9 @@ void RenderPath3D::RenderPostprocessChain(CommandList cmd) const
 		if (getSnowEnabled())
 		{
 			//PE: Test snow shader.
+			auto pass = wiProfiler::BeginPassGPU("Postprocess - Snow", cmd);
 			wiRenderer::Postprocess_Snow(*rt_read, *rt_write, cmd, snowOpacity, snowLayers, snowDepth, snowWindiness, snowSpeed, snowOffset);
+			wiProfiler::EndPassGPU(pass);
 			std::swap(rt_read, rt_write);
 			device->UnbindResources(TEXSLOT_ONDEMAND0, 1, cmd);
 			device->UnbindResources(TEXSLOT_ONDEMAND1, 1, cmd);
@@ -2064,15 +2477,19 @@ void RenderPath3D::RenderPostprocessChain(CommandList cmd) const
 
 		if (getFXAAEnabled())
 		{
+			auto pass = wiProfiler::BeginPassGPU("Postprocess - FXAA", cmd);
 			wiRenderer::Postprocess_FXAA(*rt_read, *rt_write, cmd);
+			wiProfiler::EndPassGPU(pass);
 
 			std::swap(rt_read, rt_write);
 			device->UnbindResources(TEXSLOT_ONDEMAND0, 1, cmd);
 		}
 
-		if (getChromaticAberrationEnabled())
+		if (getChromaticAberrationEnabled() && !tonemap_chromatic_aberration)
 		{
+			auto pass = wiProfiler::BeginPassGPU("Postprocess - Chromatic Aberration", cmd);
 			wiRenderer::Postprocess_Chromatic_Aberration(*rt_read, *rt_write, cmd, getChromaticAberrationAmount());
+			wiProfiler::EndPassGPU(pass);
 
 			std::swap(rt_read, rt_write);
 			device->UnbindResources(TEXSLOT_ONDEMAND0, 1, cmd);
@@ -2093,7 +2510,9 @@ void RenderPath3D::RenderPostprocessChain(CommandList cmd) const
 
 		if (rtFSR[0].IsValid() && getFSREnabled())
 		{
+			auto pass = wiProfiler::BeginPassGPU("Postprocess - FSR", cmd);
 			wiRenderer::Postprocess_FSR(*rt_read, rtFSR[1], rtFSR[0], cmd, getFSRSharpness());
+			wiProfiler::EndPassGPU(pass);
 
 			device->UnbindResources(TEXSLOT_ONDEMAND0, 1, cmd);
 		}
@@ -2105,12 +2524,14 @@ void RenderPath3D::setAO(AO value)
 	ao = value;
 
 	rtAO = {};
+	rtAO_reduced = {};
 	ssaoResources = {};
 	msaoResources = {};
 	rtaoResources = {};
 
 	if (ao == AO_DISABLED)
 	{
+		CreateTransientResources();
 		return;
 	}
 
@@ -2129,7 +2550,20 @@ void RenderPath3D::setAO(AO value)
 	case RenderPath3D::AO_HBAO:
 		desc.Width = internalResolution.x / 2;
 		desc.Height = internalResolution.y / 2;
-		wiRenderer::CreateSSAOResources(ssaoResources, internalResolution);
+		if (getAOResolution() == EFFECT_RESOLUTION_HALF)
+		{
+			// The AO is rendered into the reduced texture, and rtAO stays at the default resolution for the bilateral upsampling:
+			TextureDesc reduced_desc = desc;
+			reduced_desc.Width = std::max(1u, desc.Width / 2);
+			reduced_desc.Height = std::max(1u, desc.Height / 2);
+			wiRenderer::GetDevice()->CreateTexture(&reduced_desc, nullptr, &rtAO_reduced);
+			wiRenderer::GetDevice()->SetName(&rtAO_reduced, "rtAO_reduced");
+			wiRenderer::CreateSSAOResources(ssaoResources, XMUINT2(internalResolution.x / 2, internalResolution.y / 2));
+		}
+		else
+		{
+			wiRenderer::CreateSSAOResources(ssaoResources, internalResolution);
+		}
 		break;
 	case RenderPath3D::AO_MSAO:
 		desc.Width = internalResolution.x;
@@ -2148,6 +2582,72 @@ void RenderPath3D::setAO(AO value)
 	GraphicsDevice* device = wiRenderer::GetDevice();
 	device->CreateTexture(&desc, nullptr, &rtAO);
 	device->SetName(&rtAO, "rtAO");
+
+	CreateTransientResources();
+}
+void RenderPath3D::CreateTransientResources()
+{
+	transientResources.entries.clear();
+
+	Texture* ao_textures[] = {
+		&rtAO_reduced,
+		&ssaoResources.temp,
+		&msaoResources.texture_lineardepth_downsize1,
+		&msaoResources.texture_lineardepth_tiled1,
+		&msaoResources.texture_lineardepth_downsize2,
+		&msaoResources.texture_lineardepth_tiled2,
+		&msaoResources.texture_lineardepth_downsize3,
+		&msaoResources.texture_lineardepth_tiled3,
+		&msaoResources.texture_lineardepth_downsize4,
+		&msaoResources.texture_lineardepth_tiled4,
+		&msaoResources.texture_ao_merged1,
+		&msaoResources.texture_ao_hq1,
+		&msaoResources.texture_ao_smooth1,
+		&msaoResources.texture_ao_merged2,
+		&msaoResources.texture_ao_hq2,
+		&msaoResources.texture_ao_smooth2,
+		&msaoResources.texture_ao_merged3,
+		&msaoResources.texture_ao_hq3,
+		&msaoResources.texture_ao_smooth3,
+		&msaoResources.texture_ao_merged4,
+		&msaoResources.texture_ao_hq4,
+	};
+	for (auto texture : ao_textures)
+	{
+		wiRenderer::DeclareTransientTexture(transientResources, *texture, TRANSIENT_PASS_AO, TRANSIENT_PASS_AO);
+	}
+
+	Texture* depthoffield_textures[] = {
+		&depthoffieldResources.texture_tilemax_horizontal,
+		&depthoffieldResources.texture_tilemin_horizontal,
+		&depthoffieldResources.texture_tilemax,
+		&depthoffieldResources.texture_tilemin,
+		&depthoffieldResources.texture_neighborhoodmax,
+		&depthoffieldResources.texture_presort,
+		&depthoffieldResources.texture_prefilter,
+		&depthoffieldResources.texture_main,
+		&depthoffieldResources.texture_postfilter,
+		&depthoffieldResources.texture_alpha1,
+		&depthoffieldResources.texture_alpha2,
+	};
+	for (auto texture : depthoffield_textures)
+	{
+		wiRenderer::DeclareTransientTexture(transientResources, *texture, TRANSIENT_PASS_DEPTHOFFIELD, TRANSIENT_PASS_DEPTHOFFIELD);
+	}
+
+	Texture* motionblur_textures[] = {
+		&motionblurResources.texture_tilemin_horizontal,
+		&motionblurResources.texture_tilemax_horizontal,
+		&motionblurResources.texture_tilemax,
+		&motionblurResources.texture_tilemin,
+		&motionblurResources.texture_neighborhoodmax,
+	};
+	for (auto texture : motionblur_textures)
+	{
+		wiRenderer::DeclareTransientTexture(transientResources, *texture, TRANSIENT_PASS_MOTIONBLUR, TRANSIENT_PASS_MOTIONBLUR);
+	}
+
+	wiRenderer::CreateTransientTextureResources(transientResources);
 }
 
 void RenderPath3D::setRainTextures(char *tex, char *normal)
@@ -2178,13 +2678,77 @@ void RenderPath3D::setSSREnabled(bool value)
 		device->CreateTexture(&desc, nullptr, &rtSSR);
 		device->SetName(&rtSSR, "rtSSR");
 
-		wiRenderer::CreateSSRResources(ssrResources, internalResolution);
+		if (getSSRResolution() == EFFECT_RESOLUTION_HALF)
+		{
+			desc.Width = std::max(1u, desc.Width / 2);
+			desc.Height = std::max(1u, desc.Height / 2);
+			device->CreateTexture(&desc, nullptr, &rtSSR_reduced);
+			device->SetName(&rtSSR_reduced, "rtSSR_reduced");
+			wiRenderer::CreateSSRResources(ssrResources, XMUINT2(internalResolution.x / 2, internalResolution.y / 2));
+		}
+		else
+		{
+			rtSSR_reduced = {};
+			wiRenderer::CreateSSRResources(ssrResources, internalResolution);
+		}
 	}
 	else
 	{
 		ssrResources = {};
+		rtSSR_reduced = {};
+	}
+}
+
+void RenderPath3D::setAOResolution(EFFECT_RESOLUTION value)
+{
+	if (aoResolution != value)
+	{
+		aoResolution = value;
+		setAO(ao);
+	}
+}
+void RenderPath3D::setSSRResolution(EFFECT_RESOLUTION value)
+{
+	if (ssrResolution != value)
+	{
+		ssrResolution = value;
+		setSSREnabled(ssrEnabled);
+	}
+}
+void RenderPath3D::setVolumetricCloudResolution(EFFECT_RESOLUTION value)
+{
+	if (volumetricCloudResolution != value)
+	{
+		volumetricCloudResolution = value;
+		if (volumetriccloudResources[0].texture_cloudRender.IsValid())
+		{
+			CreateVolumetricCloudResources();
+		}
 	}
 }
+void RenderPath3D::setVolumetricCloudAmortizedEnabled(bool value)
+{
+	if (volumetricCloudAmortizedEnabled != value)
+	{
+		volumetricCloudAmortizedEnabled = value;
+		if (volumetriccloudResources[0].texture_cloudRender.IsValid())
+		{
+			CreateVolumetricCloudResources();
+		}
+	}
+}
+void RenderPath3D::CreateVolumetricCloudResources()
+{
+	// The clouds are already rendered in a checkerboard pattern and temporally reconstructed, the reduced resolution halves every step of that:
+	const uint32_t divider = getVolumetricCloudResolution() == EFFECT_RESOLUTION_HALF ? 2 : 1;
+	const uint32_t blocksize = getVolumetricCloudAmortizedEnabled() ? 4 : 2;
+	const XMUINT2 resolution = XMUINT2((uint32_t)GetWidth3D() / divider, (uint32_t)GetHeight3D() / divider);
+	const XMUINT2 resolution_reflection = XMUINT2(depthBuffer_Reflection.desc.Width / divider, depthBuffer_Reflection.desc.Height / divider);
+	wiRenderer::CreateVolumetricCloudResources(volumetriccloudResources[0], resolution, blocksize);
+	wiRenderer::CreateVolumetricCloudResources(volumetriccloudResources[1], resolution, blocksize);
+	wiRenderer::CreateVolumetricCloudResources(volumetriccloudResources_reflection[0], resolution_reflection, blocksize);
+	wiRenderer::CreateVolumetricCloudResources(volumetriccloudResources_reflection[1], resolution_reflection, blocksize);
+}
 
 void RenderPath3D::setRaytracedReflectionsEnabled(bool value)
 {
@@ -2218,7 +2782,7 @@ void RenderPath3D::setFSREnabled(bool value)
 	fsrEnabled = value;
 	
 	//if (resolutionScale < 1.0f && fsrEnabled)
-	if (GetFSRScale() != 1.0f && fsrEnabled) //PE: GGREDUCED
+	if (GetFSRScale() != 1.0f && fsrEnabled && !IsTemporalUpscaling()) //PE: GGREDUCED
 	{
 		GraphicsDevice* device = wiRenderer::GetDevice();
 
@@ -23,6 +23,19 @@ public:
 		AO_RTAO,		// ray traced ambient occlusion
 		// Don't alter order! (bound to lua manually)
 	};
+	// Groups of compute passes that can run on the async compute queue, overlapping with the depth prepass and shadow map rendering:
+	enum ASYNC_COMPUTE
+	{
+		ASYNC_COMPUTE_ACCELERATION_STRUCTURES = 1 << 0,	// ray tracing acceleration structure updates
+		ASYNC_COMPUTE_SIMULATION = 1 << 1,				// emitted particle and ocean simulation
+		ASYNC_COMPUTE_EFFECTS = 1 << 2,					// depth pyramid, AO, volumetric clouds, light culling, SSR, screen space shadows
+	};
+	// The resolution that a screen space effect is rendered at, the reduced one is for the GPUs with a small time budget (eg. integrated graphics at 1080p):
+	enum EFFECT_RESOLUTION
+	{
+		EFFECT_RESOLUTION_DEFAULT,	// the resolution that the effect was made for
+		EFFECT_RESOLUTION_HALF,		// half of the default in both dimensions, bilateral upsampled to the default
+	};
 private:
 	float exposure = 1.0f;
 	float bloomThreshold = 1.0f;
@@ -66,6 +79,7 @@ private:
 	float width3D;
 	float height3D;
 	float fsrUpScale = 1.0f;
+	bool temporalUpscalingEnabled = false;
 #endif	
 
 	AO ao = AO_DISABLED;
@@ -89,9 +103,15 @@ private:
 	bool occlusionCullingEnabled = true;
 	bool sceneUpdateEnabled = true;
 	bool fsrEnabled = true;
+	uint32_t asyncCompute = ASYNC_COMPUTE_ACCELERATION_STRUCTURES | ASYNC_COMPUTE_SIMULATION | ASYNC_COMPUTE_EFFECTS;
 
 	uint32_t msaaSampleCount = 1;
 
+	EFFECT_RESOLUTION aoResolution = EFFECT_RESOLUTION_DEFAULT;
+	EFFECT_RESOLUTION ssrResolution = EFFECT_RESOLUTION_DEFAULT;
+	EFFECT_RESOLUTION volumetricCloudResolution = EFFECT_RESOLUTION_DEFAULT;
+	bool volumetricCloudAmortizedEnabled = false;
+
 public:
 	wiGraphics::Texture rtGbuffer[GBUFFER_COUNT];
 	wiGraphics::Texture rtGbuffer_resolved[GBUFFER_COUNT];
@@ -107,14 +127,19 @@ public:
 	wiGraphics::Texture rtBloom; // contains the bright parts of the image + mipchain
 	wiGraphics::Texture rtBloom_tmp; // temporary for bloom downsampling
 	wiGraphics::Texture rtAO; // full res AO
+	wiGraphics::Texture rtAO_reduced; // AO at the reduced effect resolution, upsampled into rtAO
+	wiGraphics::Texture rtSSR_reduced; // screen-space reflections at the reduced effect resolution, upsampled into rtSSR
 	wiGraphics::Texture rtShadow; // raytraced shadows mask
 	wiGraphics::Texture rtSun[2]; // 0: sun render target used for lightshafts (can be MSAA), 1: radial blurred lightshafts
 	wiGraphics::Texture rtSun_resolved; // sun render target, but the resolved version if MSAA is enabled
 	wiGraphics::Texture rtGUIBlurredBackground[3];	// downsampled, gaussian blurred scene for GUI
 	wiGraphics::Texture rtShadingRate; // UINT8 shading rate per tile
+	wiGraphics::Texture rtShadingRate_transparent; // UINT8 shading rate per tile for the transparent pass
+	wiGraphics::Texture rtOverdraw; // count of rasterized layers for the overdraw visualizer
 	wiGraphics::Texture rtFSR[2]; // FSR upscaling result (full resolution LDR)
 
 	wiGraphics::Texture rtPostprocess_HDR; // ping-pong with main scene RT in HDR post-process chain
+	wiGraphics::Texture rtPostprocess_HDR_reduced; // ping-pong with main scene RT for the effects before the temporal upscaling (at the 3D resolution)
 	wiGraphics::Texture rtPostprocess_LDR[2]; // ping-pong with itself in LDR post-process chain
 
 #ifdef GGREDUCED
@@ -129,6 +154,7 @@ public:
 
 	wiGraphics::RenderPass renderpass_depthprepass;
 	wiGraphics::RenderPass renderpass_main;
+	wiGraphics::RenderPass renderpass_main_load;
 	wiGraphics::RenderPass renderpass_transparent;
 	wiGraphics::RenderPass renderpass_reflection_depthprepass;
 	wiGraphics::RenderPass renderpass_reflection;
@@ -137,6 +163,7 @@ public:
 	wiGraphics::RenderPass renderpass_volumetriclight;
 	wiGraphics::RenderPass renderpass_particledistortion;
 	wiGraphics::RenderPass renderpass_waterripples;
+	wiGraphics::RenderPass renderpass_overdraw;
 
 	wiGraphics::Texture debugUAV; // debug UAV can be used by some shaders...
 	wiRenderer::TiledLightResources tiledLightResources;
@@ -144,6 +171,7 @@ public:
 	wiRenderer::LuminanceResources luminanceResources;
 	wiRenderer::SSAOResources ssaoResources;
 	wiRenderer::MSAOResources msaoResources;
+	wiRenderer::RTDenoiserResources rtdenoiserResources; // shared by RTAO and RTShadow
 	wiRenderer::RTAOResources rtaoResources;
 	wiRenderer::RTReflectionResources rtreflectionResources;
 	wiRenderer::SSRResources ssrResources;
@@ -155,6 +183,17 @@ public:
 	wiRenderer::VolumetricCloudResources volumetriccloudResources_reflection[2]; // one each for left and right eyes
 	wiRenderer::BloomResources bloomResources;
 
+	// Passes of the frame whose internal textures share memory, ordered as they are rendered:
+	enum TRANSIENT_PASS
+	{
+		TRANSIENT_PASS_AO,
+		TRANSIENT_PASS_DEPTHOFFIELD,
+		TRANSIENT_PASS_MOTIONBLUR,
+	};
+	wiRenderer::TransientTextureResources transientResources;
+	void CreateTransientResources();
+	void CreateVolumetricCloudResources();
+
 	const constexpr wiGraphics::Texture* GetGbuffer_Read() const
 	{
 		if (getMSAASampleCount() > 1)
@@ -211,6 +250,12 @@ public:
 #endif
 
 	void ResizeBuffers() override;
+#ifdef GGREDUCED
+	void UpdateDynamicResolution();
+	uint32_t dynamicResolutionFrames = 0;
+	float dynamicResolutionTime = 0;
+	bool dynamicResolutionVRS = false; // the shading rate classification was enabled by the dynamic resolution
+#endif
 
 	wiScene::CameraComponent* camera = &wiScene::GetCamera();
 	wiScene::CameraComponent camera_previous;
@@ -275,9 +320,18 @@ public:
 	constexpr bool getOcclusionCullingEnabled() const { return occlusionCullingEnabled; }
 	constexpr bool getSceneUpdateEnabled() const { return sceneUpdateEnabled; }
 	constexpr bool getFSREnabled() const { return fsrEnabled; }
+	// When disabled, the passes are executed on the graphics queue instead (for GPUs where async compute doesn't pay off)
+	constexpr bool getAsyncComputeEnabled(ASYNC_COMPUTE value) const { return asyncCompute & value; }
 
 	constexpr uint32_t getMSAASampleCount() const { return msaaSampleCount; }
 
+	// The reduced resolution of AO is for SSAO and HBAO, MSAO and RTAO are always rendered at the default resolution
+	constexpr EFFECT_RESOLUTION getAOResolution() const { return aoResolution; }
+	constexpr EFFECT_RESOLUTION getSSRResolution() const { return ssrResolution; }
+	constexpr EFFECT_RESOLUTION getVolumetricCloudResolution() const { return volumetricCloudResolution; }
+	// When enabled, the clouds are raymarched for 1/16 of the pixels per frame in a 4x4 Bayer pattern instead of 1/4 in a checkerboard, the rest is reprojected with the camera and wind motion
+	constexpr bool getVolumetricCloudAmortizedEnabled() const { return volumetricCloudAmortizedEnabled; }
+
 	constexpr void setExposure(float value) { exposure = value; }
 	constexpr void setBloomThreshold(float value){ bloomThreshold = value; }
 	constexpr void setBloomStrength(float value){ bloomStrength = value; }
@@ -338,16 +392,47 @@ public:
 	constexpr void setDitherEnabled(bool value) { ditherEnabled = value; }
 	constexpr void setOcclusionCullingEnabled(bool value) { occlusionCullingEnabled = value; }
 	constexpr void setSceneUpdateEnabled(bool value) { sceneUpdateEnabled = value; }
+	constexpr void setAsyncComputeEnabled(ASYNC_COMPUTE value, bool enabled) { if (enabled) { asyncCompute |= value; } else { asyncCompute &= ~value; } }
 	void setFSREnabled(bool value);
+	void setAOResolution(EFFECT_RESOLUTION value);
+	void setSSRResolution(EFFECT_RESOLUTION value);
+	void setVolumetricCloudResolution(EFFECT_RESOLUTION value);
+	void setVolumetricCloudAmortizedEnabled(bool value);
 
 	virtual void setMSAASampleCount(uint32_t value) { msaaSampleCount = value; }
 
+	bool IsTemporalUpscaling() const;
+	// The resolution of the temporal AA output and the post processes after it, the 3D resolution unless temporal upscaling is active
+	XMUINT2 GetPostprocessResolution() const;
+
 #ifdef GGREDUCED
 	void Set3DResolution( float width, float height , bool resizebuffers = true);
 	float GetWidth3D() const { return width3D; }
 	float GetHeight3D() const { return height3D; }
 	void SetFSRScale( float scale );
 	float GetFSRScale() const { return fsrUpScale; }
+
+	// Temporal upscaling: the reduced 3D resolution (GetFSRScale() > 1) is upscaled by the temporal AA resolve with the camera jitter, instead of FSR
+	//	Depth of field and motion blur are done before the resolve at the 3D resolution, bloom, tone mapping and the LDR chain after it at the output resolution
+	//	The history is at the output resolution, so it is kept when the dynamic resolution only changes the 3D resolution
+	void SetTemporalUpscalingEnabled(bool value);
+	bool GetTemporalUpscalingEnabled() const { return temporalUpscalingEnabled; }
+
+	// Dynamic resolution: the 3D resolution is scaled between minScale and maxScale of the output resolution to hold the target GPU frame time
+	//	The GPU frame time is read from wiProfiler (profiling must be enabled), and the result is upscaled by FSR
+	//	The scale is changed by one step at most every interval frames, so the render targets are only recreated for a real change of load
+	//	With variableRateShading, the shading rate classification is enabled before the resolution is lowered (if the device supports it), and disabled when the load is low again
+	struct DynamicResolution
+	{
+		bool enabled = false;
+		bool variableRateShading = true;
+		float targetFrameTime = 1000.0f / 60.0f; // milliseconds
+		float minScale = 0.5f;
+		float maxScale = 1.0f;
+		float step = 0.1f;
+		uint32_t interval = 30;
+	} dynamicResolution;
+	float GetDynamicResolutionScale() const { return 1.0f / fsrUpScale; }
 #endif
 
 	void PreUpdate() override;
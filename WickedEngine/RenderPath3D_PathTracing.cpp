@@ -36,6 +36,7 @@ using namespace wiGraphics;
 using namespace wiScene;
 
 
+
 void RenderPath3D_PathTracing::ResizeBuffers()
 {
 	RenderPath2D::ResizeBuffers(); // we don't need to use any buffers from RenderPath3D, so skip those
@@ -53,6 +54,13 @@ void RenderPath3D_PathTracing::ResizeBuffers()
 		device->CreateTexture(&desc, nullptr, &traceResult);
 		device->SetName(&traceResult, "traceResult");
 
+		desc.BindFlags = BIND_UNORDERED_ACCESS;
+		desc.Format = FORMAT_R32_FLOAT;
+		desc.layout = IMAGE_LAYOUT_UNORDERED_ACCESS;
+		device->CreateTexture(&desc, nullptr, &traceMoment);
+		device->SetName(&traceMoment, "traceMoment");
+		desc.Format = FORMAT_R32G32B32A32_FLOAT;
+
 #ifdef OPEN_IMAGE_DENOISE
 		desc.BindFlags = BIND_UNORDERED_ACCESS;
 		desc.layout = IMAGE_LAYOUT_UNORDERED_ACCESS;
@@ -92,6 +100,29 @@ void RenderPath3D_PathTracing::ResizeBuffers()
 
 		device->CreateRenderPass(&desc, &renderpass_debugbvh);
 	}
+	{
+		tileCountX = (internalResolution.x + RAYTRACING_TILE_SIZE - 1) / RAYTRACING_TILE_SIZE;
+		tileCountY = (internalResolution.y + RAYTRACING_TILE_SIZE - 1) / RAYTRACING_TILE_SIZE;
+
+		GPUBufferDesc desc;
+		desc.BindFlags = BIND_UNORDERED_ACCESS;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = sizeof(uint32_t);
+		desc.ByteWidth = desc.StructureByteStride * std::max(1u, tileCountX * tileCountY);
+		device->CreateBuffer(&desc, nullptr, &tileErrorBuffer);
+		device->SetName(&tileErrorBuffer, "tileErrorBuffer");
+
+		desc.Usage = USAGE_STAGING;
+		desc.CPUAccessFlags = CPU_ACCESS_READ;
+		desc.BindFlags = 0;
+		desc.MiscFlags = 0;
+		for (auto& x : tileReadbacks)
+		{
+			device->CreateBuffer(&desc, nullptr, &x.buffer);
+			device->SetName(&x.buffer, "tileErrorReadback");
+			x.tiles.clear();
+		}
+	}
 	
 	// also reset accumulation buffer state:
 	sam = -1;
@@ -135,26 +166,153 @@ void RenderPath3D_PathTracing::Update(float dt)
 	}
 	sam++;
 
-	if (sam > target)
+	GraphicsDevice* device = wiRenderer::GetDevice();
+
+	if (sam == 0)
+	{
+		resetCount++;
+		tileStates.clear();
+		tileStates.resize(tileCountX * tileCountY);
+		denoiserResult = Texture();
+		denoiserPreviewSamples = 8;
+		denoiserFinished = false;
+	}
+
+	// The errors of the tiles that were traced GetBufferCount() frames ago:
+	TileReadback& readback = tileReadbacks[device->GetFrameCount() % GraphicsDevice::GetBufferCount()];
+	if (!readback.tiles.empty())
+	{
+		if (readback.resetCount == resetCount)
+		{
+			Mapping mapping;
+			mapping._flags = Mapping::FLAG_READ;
+			mapping.size = readback.buffer.GetDesc().ByteWidth;
+			device->Map(&readback.buffer, &mapping);
+			if (mapping.data != nullptr)
+			{
+				const uint32_t* errors = (const uint32_t*)mapping.data;
+				const TextureDesc& desc = traceResult.GetDesc();
+				for (uint32_t index : readback.tiles)
+				{
+					const uint32_t width = std::min(RAYTRACING_TILE_SIZE, desc.Width - (index % tileCountX) * RAYTRACING_TILE_SIZE);
+					const uint32_t height = std::min(RAYTRACING_TILE_SIZE, desc.Height - (index / tileCountX) * RAYTRACING_TILE_SIZE);
+					tileStates[index].error = float(errors[index]) / RAYTRACING_TILE_ERROR_SCALE / float(width * height);
+				}
+			}
+			device->Unmap(&readback.buffer);
+		}
+
+		// The tile count of the time budget, from the GPU time of a recent frame:
+		const float time = wiProfiler::GetRangeTime("Traced Scene");
+		if (time > 0)
+		{
+			const float timePerTile = time / (float)readback.tiles.size();
+			pathsPerSecond = float(RAYTRACING_TILE_SIZE * RAYTRACING_TILE_SIZE) / (timePerTile * 0.001f);
+			tilesPerFrame = traceBudget > 0 ? std::max(1u, uint32_t(traceBudget / timePerTile)) : ~0u;
+		}
+		readback.tiles.clear();
+	}
+
+	// Schedule the tiles of this frame:
+	std::vector<uint32_t> candidates;
+	float progressSum = 0;
+	uint64_t sampleSum = 0;
+	for (uint32_t i = 0; i < (uint32_t)tileStates.size(); ++i)
 	{
-		sam = target;
+		const TileState& state = tileStates[i];
+		sampleSum += state.samples;
+		const bool converged = adaptiveThreshold > 0 && state.samples >= (uint32_t)adaptiveMinSamples && state.error < adaptiveThreshold;
+		if (converged || state.samples >= (uint32_t)target)
+		{
+			progressSum += 1;
+		}
+		else
+		{
+			progressSum += (float)state.samples / (float)target;
+			candidates.push_back(i);
+		}
 	}
-	if (target < sam)
+	finished = candidates.empty();
+	progress = tileStates.empty() ? 0 : progressSum / (float)tileStates.size();
+	averageSampleCount = tileStates.empty() ? 0 : int(sampleSum / tileStates.size());
+
+	tracedTiles.clear();
+	if (!wiRenderer::GetRaytraceDebugBVHVisualizerEnabled())
 	{
-		resetProgress();
+		if (candidates.size() > tilesPerFrame)
+		{
+			// The tiles below the minimum sample count are first with the fewest samples, then the others with the highest error:
+			const uint32_t minSamples = adaptiveThreshold > 0 ? (uint32_t)adaptiveMinSamples : (uint32_t)target;
+			std::nth_element(candidates.begin(), candidates.begin() + tilesPerFrame, candidates.end(), [&](uint32_t a, uint32_t b) {
+				const TileState& A = tileStates[a];
+				const TileState& B = tileStates[b];
+				const bool minA = A.samples < minSamples;
+				const bool minB = B.samples < minSamples;
+				if (minA != minB)
+				{
+					return minA;
+				}
+				if (minA)
+				{
+					return A.samples < B.samples;
+				}
+				return A.error > B.error;
+			});
+			candidates.resize(tilesPerFrame);
+		}
+		for (uint32_t index : candidates)
+		{
+			TileState& state = tileStates[index];
+			const XMFLOAT4& halton = wiMath::GetHaltonSequence((int)state.samples);
+			RaytracingTile tile = {};
+			tile.offset = XMUINT2((index % tileCountX) * RAYTRACING_TILE_SIZE, (index / tileCountX) * RAYTRACING_TILE_SIZE);
+			tile.sampleIndex = state.samples;
+			tile.accumulationFactor = 1.0f / ((float)state.samples + 1.0f);
+			tile.pixelOffset = XMFLOAT2(halton.x, halton.y);
+			tile.errorIndex = index;
+			tracedTiles.push_back(tile);
+			state.samples++;
+		}
+		readback.tiles = std::move(candidates);
+		readback.resetCount = resetCount;
 	}
 
 	scene->SetAccelerationStructureUpdateRequested(sam == 0);
 	setSceneUpdateEnabled(sam == 0);
 
+	wiRenderer::PrefetchShaders(SHADERGROUP_PATHTRACING);
+
 	RenderPath3D::Update(dt);
 
 
 #ifdef OPEN_IMAGE_DENOISE
-	if (sam == target)
+	// The finished denoiser job replaces the displayed result, unless the accumulation was reset since it started:
+	if (denoiserOutput.IsValid() && !wiJobSystem::IsBusy(denoiserContext))
+	{
+		if (denoiserResetCount == resetCount)
+		{
+			denoiserResult = denoiserOutput;
+		}
+		denoiserOutput = Texture();
+	}
+
+	// The final image is denoised when every tile finished, and the previews every time the average sample count doubles:
+	const bool denoiseFinal = finished && !denoiserFinished;
+	const bool denoisePreview = !finished && averageSampleCount >= denoiserPreviewSamples;
+	if (denoiseFinal || denoisePreview)
 	{
-		if (!denoiserResult.IsValid() && !wiJobSystem::IsBusy(denoiserContext))
+		if (!wiJobSystem::IsBusy(denoiserContext))
 		{
+			if (denoiseFinal)
+			{
+				denoiserFinished = true;
+			}
+			else
+			{
+				denoiserPreviewSamples = std::max(denoiserPreviewSamples * 2, averageSampleCount + 1);
+			}
+			denoiserResetCount = resetCount;
+
 			//wiHelper::saveTextureToFile(denoiserAlbedo, "C:/PROJECTS/WickedEngine/Editor/_albedo.png");
 			//wiHelper::saveTextureToFile(denoiserNormal, "C:/PROJECTS/WickedEngine/Editor/_normal.png");
 
@@ -228,17 +386,12 @@ void RenderPath3D_PathTracing::Update(float dt)
 					SubresourceData initdata;
 					initdata.pSysMem = texturedata_dst.data();
 					initdata.SysMemPitch = uint32_t(sizeof(XMFLOAT4) * width);
-					device->CreateTexture(&desc, &initdata, &denoiserResult);
+					device->CreateTexture(&desc, &initdata, &denoiserOutput);
 
 					});
 			}
 		}
 	}
-	else
-	{
-		denoiserResult = Texture();
-		denoiserProgress = 0;
-	}
 #endif // OPEN_IMAGE_DENOISE
 }
 
@@ -248,13 +401,14 @@ void RenderPath3D_PathTracing::Render( int mode ) const
 	wiJobSystem::context ctx;
 	CommandList cmd;
 
-	if (sam < target)
+	if (!tracedTiles.empty() || wiRenderer::GetRaytraceDebugBVHVisualizerEnabled())
 	{
 	// Setup:
 	cmd = device->BeginCommandList();
 	wiJobSystem::Execute(ctx, [this, cmd](wiJobArgs args) {
 
 		wiRenderer::UpdateRenderData(visibility_main, frameCB, cmd);
+		wiRenderer::UpdateRenderDataAsync(visibility_main, cmd);
 
 			if (scene->IsAccelerationStructureUpdateRequested())
 		{
@@ -291,19 +445,41 @@ void RenderPath3D_PathTracing::Render( int mode ) const
 		}
 		else
 		{
+			std::vector<uint32_t> errors(tileStates.size(), 0);
+			device->UpdateBuffer(&tileErrorBuffer, errors.data(), cmd, int(sizeof(uint32_t) * errors.size()));
+
 			auto range = wiProfiler::BeginRangeGPU("Traced Scene", cmd);
 
 				wiRenderer::RayTraceScene(
 					*scene,
 					traceResult,
-					sam,
+					tracedTiles.data(),
+					(uint32_t)tracedTiles.size(),
 					cmd,
 					denoiserAlbedo.IsValid() ? &denoiserAlbedo : nullptr,
-					denoiserNormal.IsValid() ? &denoiserNormal : nullptr
+					denoiserNormal.IsValid() ? &denoiserNormal : nullptr,
+					&traceMoment,
+					&tileErrorBuffer
 				);
 
 
 			wiProfiler::EndRange(range); // Traced Scene
+
+			// The tile errors are read back by Update() GetBufferCount() frames later:
+			const GPUBuffer& readback = tileReadbacks[device->GetFrameCount() % GraphicsDevice::GetBufferCount()].buffer;
+			{
+				GPUBarrier barriers[] = {
+					GPUBarrier::Buffer(&tileErrorBuffer, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_COPY_SRC),
+				};
+				device->Barrier(barriers, arraysize(barriers), cmd);
+			}
+			device->CopyResource(&readback, &tileErrorBuffer, cmd);
+			{
+				GPUBarrier barriers[] = {
+					GPUBarrier::Buffer(&tileErrorBuffer, BUFFER_STATE_COPY_SRC, BUFFER_STATE_UNORDERED_ACCESS),
+				};
+				device->Barrier(barriers, arraysize(barriers), cmd);
+			}
 		}
 
 		wiRenderer::Postprocess_Tonemap(
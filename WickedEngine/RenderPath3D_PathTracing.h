@@ -1,14 +1,43 @@
 #pragma once
 #include "RenderPath3D.h"
+#include "shaders/ShaderInterop_Raytracing.h"
 
 
 class RenderPath3D_PathTracing :
 	public RenderPath3D
 {
 protected:
-	int sam = -1;
+	int sam = -1; // frames since the accumulation was reset
 	int target = 1024;
 	wiGraphics::Texture traceResult;
+	wiGraphics::Texture traceMoment;
+
+	// The image is traced in tiles of RAYTRACING_TILE_SIZE pixels, each of them has its own sample count:
+	//	Every frame traces a sample of as many tiles as fit in the time budget, until every tile reached the minimum sample count,
+	//	then the tiles with the highest estimated error are traced, until they reach the target sample count or their error is below the threshold
+	struct TileState
+	{
+		uint32_t samples = 0;
+		float error = FLT_MAX; // the average relative error of the pixels, it is measured GetBufferCount() frames after tracing
+	};
+	std::vector<TileState> tileStates;
+	uint32_t tileCountX = 0;
+	uint32_t tileCountY = 0;
+	uint32_t tilesPerFrame = ~0u;
+	std::vector<RaytracingTile> tracedTiles; // the tiles of the current frame
+	wiGraphics::GPUBuffer tileErrorBuffer;
+	struct TileReadback
+	{
+		wiGraphics::GPUBuffer buffer;
+		std::vector<uint32_t> tiles;
+		uint32_t resetCount = 0;
+	};
+	TileReadback tileReadbacks[wiGraphics::GraphicsDevice::GetBufferCount()];
+	uint32_t resetCount = 0;
+	bool finished = false;
+	float progress = 0;
+	int averageSampleCount = 0;
+	float pathsPerSecond = 0;
 
 	std::vector<uint8_t> texturedata_src;
 	std::vector<uint8_t> texturedata_dst;
@@ -17,7 +46,11 @@ protected:
 	wiGraphics::Texture denoiserAlbedo;
 	wiGraphics::Texture denoiserNormal;
 	wiGraphics::Texture denoiserResult;
+	wiGraphics::Texture denoiserOutput; // written by the denoiser job, it becomes the denoiserResult when the job is finished
 	wiJobSystem::context denoiserContext;
+	uint32_t denoiserResetCount = 0;
+	int denoiserPreviewSamples = 0; // the next average sample count at which a preview is denoised
+	bool denoiserFinished = false;
 
 	wiGraphics::RenderPass renderpass_debugbvh;
 	
@@ -30,13 +63,38 @@ public:
 	void Render( int mode ) const override;
 	void Compose(wiGraphics::CommandList cmd) const override;
 
-	int getCurrentSampleCount() const { return sam; }
+	// The average sample count of the tiles
+	int getCurrentSampleCount() const { return averageSampleCount; }
 	void setTargetSampleCount(int value) { target = value; }
-	float getProgress() const { return (float)sam / (float)target; }
+	float getProgress() const { return progress; }
+	// Returns true when every tile reached the target sample count, or converged with adaptive sampling
+	bool isFinished() const { return finished; }
+
+	// The GPU time of tracing per frame in milliseconds, the number of traced tiles is adjusted to it, so the application stays interactive
+	//	It is measured with wiProfiler, while it is disabled or the budget is 0, every tile is traced in every frame
+	float traceBudget = 16;
+	void setTraceBudget(float value) { traceBudget = value; }
+	float getTraceBudget() const { return traceBudget; }
+
+	// Adaptive sampling: a tile is finished when its relative error is below the threshold, after it has at least adaptiveMinSamples samples
+	//	The threshold 0 disables it, then every tile is traced until the target sample count
+	float adaptiveThreshold = 0.02f;
+	int adaptiveMinSamples = 16;
+	void setAdaptiveThreshold(float value) { adaptiveThreshold = value; }
+	float getAdaptiveThreshold() const { return adaptiveThreshold; }
+	void setAdaptiveMinSamples(int value) { adaptiveMinSamples = value; }
+	int getAdaptiveMinSamples() const { return adaptiveMinSamples; }
+
+	uint32_t getTileCount() const { return (uint32_t)tileStates.size(); }
+	uint32_t getTracedTileCount() const { return (uint32_t)tracedTiles.size(); }
 
 	float denoiserProgress = 0;
 	float getDenoiserProgress() const { return denoiserProgress; }
 	bool isDenoiserAvailable() const;
 
+	// The traced paths per second (one path for every pixel of a traced tile) of the last measured frame, from the GPU time of the tracing
+	//	It is only measured while wiProfiler is enabled, otherwise it returns 0
+	float getPathsPerSecond() const { return pathsPerSecond; }
+
 	void resetProgress() { sam = -1; denoiserProgress = 0; }
 };
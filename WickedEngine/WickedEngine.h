@@ -23,13 +23,16 @@
 #include "wiIntersect.h"
 #include "wiImage.h"
 #include "wiFont.h"
+#include "wiUIRenderer.h"
 #include "wiSprite.h"
 #include "wiSpriteFont.h"
 #include "wiScene.h"
+#include "wiSceneStreaming.h"
 #include "wiEmittedParticle.h"
 #include "wiHairParticle.h"
 #include "wiRenderer.h"
 #include "wiMath.h"
+#include "wiMathBatch.h"
 #include "wiAudio.h"
 #include "wiResourceManager.h"
 #include "wiTimer.h"
@@ -44,20 +47,25 @@
 #include "wiEnums.h"
 #include "wiInitializer.h"
 #include "wiLua.h"
+#include "wiLuaJobs.h"
 #include "wiLuna.h"
 #include "wiGraphicsDevice.h"
 #include "wiGUI.h"
 #include "wiWidget.h"
 #include "wiArchive.h"
+#include "wiPackage.h"
 #include "wiSpinLock.h"
 #include "wiRectPacker.h"
 #include "wiProfiler.h"
+#include "wiMemoryTracker.h"
+#include "wiCounters.h"
 #include "wiOcean.h"
 #include "wiStartupArguments.h"
 #include "wiGPUBVH.h"
 #include "wiGPUSortLib.h"
 #include "wiJobSystem.h"
 #include "wiNetwork.h"
+#include "wiReplication.h"
 #include "wiEvent.h"
 #include "wiShaderCompiler.h"
 #include "wiCanvas.h"
@@ -1,9 +1,11 @@
 #include "WickedEngine.h"
+#include "wiCompression.h"
 
 #include <iostream>
 #include <vector>
 #include <filesystem>
 #include <mutex>
+#include <atomic>
 #include <unordered_map>
 #include <sstream>
 
@@ -21,15 +23,81 @@ extern "C" void gpup_draw_bydistance(const wiScene::CameraComponent & camera, wi
 std::mutex locker;
 std::vector<std::string> shaders[wiGraphics::SHADERSTAGE_COUNT];
 std::unordered_map<std::string, wiGraphics::SHADERMODEL> minshadermodels;
+struct Permutation
+{
+	std::string shader;
+	std::vector<std::string> defines;
+};
+std::vector<Permutation> permutations[wiGraphics::SHADERSTAGE_COUNT]; // extra binaries that are compiled from the shaders with defines
 struct Target
 {
 	wiGraphics::SHADERFORMAT format;
 	std::string dir;
+	std::string subdir; // used when more targets are compiled to the same output path
 };
 std::vector<Target> targets;
 std::unordered_map<std::string, wiShaderCompiler::CompilerOutput> results;
+std::string cachePath;
+std::atomic<uint32_t> compiled_count{ 0 };
+std::atomic<uint32_t> cached_count{ 0 };
 bool rebuild = false;
 bool shaderdump_enabled = false;
+bool shaderbundle_enabled = false;
+int shaderbundle_compression = 0;
+
+// The cached shader binary of the given source content, compiled with the input's parameters
+std::string GetCacheFileName(uint64_t sourcehash, const wiShaderCompiler::CompilerInput& input)
+{
+	size_t key = (size_t)sourcehash;
+	wiHelper::hash_combine(key, (int)input.format);
+	wiHelper::hash_combine(key, (int)input.stage);
+	wiHelper::hash_combine(key, (int)input.minshadermodel);
+	wiHelper::hash_combine(key, input.shadersourcefilename);
+	for (auto& x : input.defines)
+	{
+		wiHelper::hash_combine(key, x);
+	}
+	std::stringstream ss;
+	ss << cachePath << std::hex << std::setw(16) << std::setfill('0') << (uint64_t)key << ".cso";
+	return ss.str();
+}
+
+// Copy the shader from the cache if it was compiled from the same sources as the current ones
+bool LoadFromCache(const std::string& shaderbinaryfilename, const wiShaderCompiler::CompilerInput& input)
+{
+	std::vector<std::string> dependencies;
+	uint64_t sourcehash = 0;
+	if (!wiShaderCompiler::LoadShaderMetadata(shaderbinaryfilename, dependencies, sourcehash) || dependencies.empty())
+	{
+		return false; // the includes are not known before compiling the shader at least once
+	}
+	sourcehash = wiShaderCompiler::ComputeSourceHash(dependencies);
+	if (sourcehash == 0)
+	{
+		return false;
+	}
+
+	std::string cachefilename = GetCacheFileName(sourcehash, input);
+	std::vector<std::string> cached_dependencies;
+	uint64_t cached_sourcehash = 0;
+	if (!wiShaderCompiler::LoadShaderMetadata(cachefilename, cached_dependencies, cached_sourcehash) ||
+		cached_sourcehash != sourcehash ||
+		cached_dependencies != dependencies)
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> shaderdata;
+	if (!wiHelper::FileRead(cachefilename, shaderdata))
+	{
+		return false;
+	}
+	wiShaderCompiler::CompilerOutput output;
+	output.shaderdata = shaderdata.data();
+	output.shadersize = shaderdata.size();
+	output.dependencies = std::move(cached_dependencies);
+	return wiShaderCompiler::SaveShaderAndMetadata(shaderbinaryfilename, output);
+}
 
 int main(int argc, char* argv[])
 {
@@ -41,6 +109,10 @@ int main(int argc, char* argv[])
 	std::cout << "\tspirv : \tCompile shaders to spirv (vulkan) format (using dxcompiler)" << std::endl;
 	std::cout << "\trebuild : \tAll shaders will be rebuilt, regardless if they are outdated or not" << std::endl;
 	std::cout << "\tshaderdump : \tShaders will be saved to wiShaderDump.h C++ header file (rebuild is assumed)" << std::endl;
+	std::cout << "\tshaderbundle : \tShaders will be packed into a bundle file next to the output directory, that is loaded by the engine instead of the separate files" << std::endl;
+	std::cout << "\tcompress : \tThe shader bundle will be compressed" << std::endl;
+	std::cout << "\t-cachepath <dir> : \tCompiled shaders are also stored in this directory by the content hash of their sources, and reused from there instead of compiling them again" << std::endl;
+	std::cout << "\tIf more formats are specified, they are compiled together into the hlsl5/, hlsl6/ and spirv/ subdirectories of the output path" << std::endl;
 	*/
 
 	wiStartupArguments::Parse(argc, argv);
@@ -58,7 +130,16 @@ int main(int argc, char* argv[])
 			}
 
 			outputPath = argv[ i + 1 ];
-			break;
+		}
+		else if ( strcmp(argv[i], "-cachepath") == 0 )
+		{
+			if ( i == argc - 1 )
+			{
+				std::cout << "Error: -cachepath must be followed by a path" << std::endl;
+				return 1;
+			}
+
+			cachePath = argv[ i + 1 ];
 		}
 	}
 
@@ -68,23 +149,40 @@ int main(int argc, char* argv[])
 		return 1;
 	}
 
+	if (outputPath.back() != '/' && outputPath.back() != '\\')
+	{
+		outputPath += "/";
+	}
+	if (!cachePath.empty() && cachePath.back() != '/' && cachePath.back() != '\\')
+	{
+		cachePath += "/";
+	}
+
 	std::cout << "Output format selected: ";
 
 	if (wiStartupArguments::HasArgument("hlsl5"))
 	{
-		targets.push_back({ wiGraphics::SHADERFORMAT_HLSL5, outputPath });
+		targets.push_back({ wiGraphics::SHADERFORMAT_HLSL5, outputPath, "hlsl5/" });
 		std::cout << "hlsl5 ";
 	}
-	else if (wiStartupArguments::HasArgument("hlsl6"))
+	if (wiStartupArguments::HasArgument("hlsl6"))
 	{
-		targets.push_back({ wiGraphics::SHADERFORMAT_HLSL6, outputPath });
+		targets.push_back({ wiGraphics::SHADERFORMAT_HLSL6, outputPath, "hlsl6/" });
 		std::cout << "hlsl6 ";
 	}
-	else if (wiStartupArguments::HasArgument("spirv"))
+	if (wiStartupArguments::HasArgument("spirv"))
 	{
-		targets.push_back({ wiGraphics::SHADERFORMAT_SPIRV, outputPath });
+		targets.push_back({ wiGraphics::SHADERFORMAT_SPIRV, outputPath, "spirv/" });
 		std::cout << "spirv ";
 	}
+	if (targets.size() > 1)
+	{
+		// The formats are compiled together by the same jobs, but they can't share the output directory:
+		for (auto& target : targets)
+		{
+			target.dir += target.subdir;
+		}
+	}
 
 	if (wiStartupArguments::HasArgument("shaderdump"))
 	{
@@ -93,20 +191,37 @@ int main(int argc, char* argv[])
 		std::cout << "shaderdump ";
 	}
 
+	if (wiStartupArguments::HasArgument("shaderbundle"))
+	{
+		shaderbundle_enabled = true;
+		std::cout << "shaderbundle ";
+		if (wiStartupArguments::HasArgument("compress"))
+		{
+			shaderbundle_compression = wiCompression::LEVEL_BEST;
+			std::cout << "compress ";
+		}
+	}
+
 	if (wiStartupArguments::HasArgument("rebuild"))
 	{
 		rebuild = true;
 		std::cout << "rebuild ";
 	}
 
+	if (!cachePath.empty())
+	{
+		wiHelper::DirectoryCreate(cachePath);
+		std::cout << "cache: " << cachePath << " ";
+	}
+
 	std::cout << std::endl;
 
 	if (targets.empty())
 	{
 		targets = {
-			{ wiGraphics::SHADERFORMAT_HLSL5, "shaders/hlsl5/" },
-			{ wiGraphics::SHADERFORMAT_HLSL6, "shaders/hlsl6/" },
-			{ wiGraphics::SHADERFORMAT_SPIRV, "shaders/spirv/" },
+			{ wiGraphics::SHADERFORMAT_HLSL5, "shaders/hlsl5/", "hlsl5/" },
+			{ wiGraphics::SHADERFORMAT_HLSL6, "shaders/hlsl6/", "hlsl6/" },
+			{ wiGraphics::SHADERFORMAT_SPIRV, "shaders/spirv/", "spirv/" },
 		};
 		std::cout << "No shader formats were specified, assuming command arguments: hlsl5 spirv hlsl6" << std::endl;
 	}
@@ -114,6 +229,7 @@ int main(int argc, char* argv[])
 	shaders[wiGraphics::CS] = {
 		"hairparticle_simulateCS.hlsl"								,
 		"hairparticle_finishUpdateCS.hlsl"							,
+		"hairparticle_generateCS.hlsl"								,
 		"emittedparticle_simulateCS.hlsl"							,
 		"generateMIPChainCubeCS_float4.hlsl"						,
 		"generateMIPChainCubeCS_unorm4.hlsl"						,
@@ -123,6 +239,9 @@ int main(int argc, char* argv[])
 		"generateMIPChain3DCS_unorm4.hlsl"							,
 		"generateMIPChain2DCS_float4.hlsl"							,
 		"generateMIPChain2DCS_unorm4.hlsl"							,
+		"spdCS_float4.hlsl"											,
+		"spdCS_unorm4.hlsl"											,
+		"spdCS_max.hlsl"											,
 		"blur_gaussian_float4CS.hlsl"								,
 		"bloomseparateCS.hlsl"										,
 		"depthoffield_mainCS.hlsl"									,
@@ -133,14 +252,18 @@ int main(int argc, char* argv[])
 		"depthoffield_tileMaxCOC_horizontalCS.hlsl"					,
 		"voxelRadianceSecondaryBounceCS.hlsl"						,
 		"voxelSceneCopyClearCS.hlsl"								,
-		"voxelClearOnlyNormalCS.hlsl"								,
+		"voxelClipMapClearCS.hlsl"								,
 		"upsample_bilateral_float1CS.hlsl"							,
 		"upsample_bilateral_float4CS.hlsl"							,
 		"upsample_bilateral_unorm1CS.hlsl"							,
 		"upsample_bilateral_unorm4CS.hlsl"							,
 		"temporalaaCS.hlsl"											,
+		"temporalaaCS_upsample.hlsl"								,
 		"tileFrustumsCS.hlsl"										,
 		"tonemapCS.hlsl"											,
+		"tonemap_sharpenCS.hlsl"									,
+		"tonemap_chromatic_aberrationCS.hlsl"						,
+		"tonemap_sharpen_chromatic_aberrationCS.hlsl"				,
 		"fsr_upscalingCS.hlsl"										,
 		"fsr_sharpenCS.hlsl"										,
 		"ssr_resolveCS.hlsl"										,
@@ -151,6 +274,18 @@ int main(int argc, char* argv[])
 		"sharpenCS.hlsl"											,
 		"skinningCS.hlsl"											,
 		"skinningCS_LDS.hlsl"										,
+		"boneTransformsCS.hlsl"										,
+		"morphCS.hlsl"												,
+		"clothIntegrateCS.hlsl"										,
+		"clothSolveCS.hlsl"											,
+		"clothFinishCS.hlsl"										,
+		"instanceTableUpdateCS.hlsl"								,
+		"materialTableUpdateCS.hlsl"								,
+		"gpuCullingCS.hlsl"											,
+		"meshletCullingCS.hlsl"										,
+		"gpuCullingBoxesCS.hlsl"									,
+		"instanceCullingCS.hlsl"									,
+		"occlusionCullingHiZCS.hlsl"								,
 		"resolveMSAADepthStencilCS.hlsl"							,
 		"raytraceCS.hlsl"											,
 		"raytraceCS_rtapi.hlsl"										,
@@ -178,12 +313,18 @@ int main(int argc, char* argv[])
 		"luminancePass1CS.hlsl"										,
 		"lightShaftsCS.hlsl"										,
 		"lightCullingCS_ADVANCED_DEBUG.hlsl"						,
+		"lightClusterCullingCS.hlsl"								,
 		"lightCullingCS_DEBUG.hlsl"									,
+		"overdraw_heatmapCS.hlsl"									,
 		"lightCullingCS.hlsl"										,
 		"lightCullingCS_ADVANCED.hlsl"								,
 		"hbaoCS.hlsl"												,
 		"gpusortlib_sortInnerCS.hlsl"								,
 		"gpusortlib_sortStepCS.hlsl"								,
+		"gpusortlib_radixKickoffCS.hlsl"							,
+		"gpusortlib_radixCountCS.hlsl"								,
+		"gpusortlib_radixScanCS.hlsl"								,
+		"gpusortlib_radixScatterCS.hlsl"							,
 		"gpusortlib_kickoffSortCS.hlsl"								,
 		"gpusortlib_sortCS.hlsl"									,
 		"fxaaCS.hlsl"												,
@@ -205,6 +346,11 @@ int main(int argc, char* argv[])
 		"emittedparticle_emitCS_FROMMESH.hlsl"						,
 		"emittedparticle_emitCS_volume.hlsl"						,
 		"emittedparticle_finishUpdateCS.hlsl"						,
+		"emittedparticle_poolResetCS.hlsl"							,
+		"emittedparticle_poolKickoffCS.hlsl"						,
+		"emittedparticle_poolEmitCS.hlsl"							,
+		"emittedparticle_poolSimulateCS.hlsl"						,
+		"emittedparticle_poolFinishCS.hlsl"							,
 		"downsample4xCS.hlsl"										,
 		"depthoffield_prepassCS_earlyexit.hlsl"						,
 		"depthoffield_mainCS_cheap.hlsl"							,
@@ -274,6 +420,7 @@ int main(int argc, char* argv[])
 		"imagePS_masked.hlsl"							,
 		"imagePS_backgroundblur.hlsl"					,
 		"imagePS.hlsl"									,
+		"imagePS_batched.hlsl"							,
 		"emittedparticlePS_soft_lighting.hlsl"			,
 		"oceanSurfacePS.hlsl"							,
 		"hairparticlePS.hlsl"							,
@@ -310,6 +457,7 @@ int main(int argc, char* argv[])
 		"objectPS_hologram.hlsl"						,
 		"objectPS_paintradius.hlsl"						,
 		"objectPS_simple.hlsl"						,
+		"overdrawPS.hlsl"							,
 		"objectPS_lod.hlsl"						,
 		"objectPS_transparent_lod.hlsl"						,
 		"objectPS_debug.hlsl"							,
@@ -336,12 +484,14 @@ int main(int argc, char* argv[])
 		"hairparticlePS_prepass.hlsl"					,
 		"forceFieldVisualizerPS.hlsl"					,
 		"fontPS.hlsl"									,
+		"uiPS.hlsl"										,
 		"envMap_skyPS_static.hlsl"						,
 		"envMap_skyPS_dynamic.hlsl"						,
 		"envMapPS.hlsl"									,
 		"envMapPS_terrain.hlsl"							,
 		"emittedparticlePS_soft_distortion.hlsl"		,
 		"downsampleDepthBuffer4xPS.hlsl"				,
+		"shadowCacheCopyPS.hlsl"						,
 		"emittedparticlePS_simple.hlsl"				,
 		"cubeMapPS.hlsl"								,
 		"circlePS.hlsl"									,
@@ -354,7 +504,9 @@ int main(int argc, char* argv[])
 		"hairparticleVS.hlsl"							,
 		"emittedparticleVS.hlsl"						,
 		"imageVS.hlsl"									,
+		"imageVS_batched.hlsl"							,
 		"fontVS.hlsl"									,
+		"uiVS.hlsl"										,
 		"voxelVS.hlsl"									,
 		"vertexcolorVS.hlsl"							,
 		"volumetriclight_directionalVS.hlsl"			,
@@ -395,6 +547,7 @@ int main(int argc, char* argv[])
 		"cubeShadowVS_emulation.hlsl"					,
 		"cubeShadowVS_alphatest_emulation.hlsl"			,
 		"cubeShadowVS_transparent.hlsl"					,
+		"shadowCacheCopyVS.hlsl"						,
 		"cubeShadowVS_transparent_emulation.hlsl"		,
 		"cubeVS.hlsl",
 	};
@@ -445,6 +598,12 @@ int main(int argc, char* argv[])
 	minshadermodels["rtao_denoise_tileclassificationCS.hlsl"] = wiGraphics::SHADERMODEL_6_0;
 	minshadermodels["rtao_denoise_filterCS.hlsl"] = wiGraphics::SHADERMODEL_6_0;
 
+	// The specialized object shader permutations (the full permutation is objectPS itself):
+	for (uint32_t permutation = 0; permutation < OBJECTSHADER_PERMUTATION_ALL; ++permutation)
+	{
+		permutations[wiGraphics::PS].push_back({ "objectPS.hlsl", { "OBJECTSHADER_PERMUTATION=" + std::to_string(permutation) } });
+	}
+
 	wiShaderCompiler::Initialize();
 	wiJobSystem::Initialize();
 	wiJobSystem::context ctx;
@@ -475,10 +634,17 @@ int main(int argc, char* argv[])
 				}
 			}
 
+			std::vector<Permutation> jobs = permutations[i];
 			for (auto& shader : shaders[i])
+			{
+				jobs.push_back({ shader, {} });
+			}
+
+			for (auto& job : jobs)
 			{
 				wiJobSystem::Execute(ctx, [=](wiJobArgs args) {
-					std::string shaderbinaryfilename = wiHelper::ReplaceExtension(SHADERPATH + shader, "cso");
+					const std::string& shader = job.shader;
+					std::string shaderbinaryfilename = wiHelper::ReplaceExtension(SHADERPATH + wiShaderCompiler::GetPermutationFileName(shader, job.defines), "cso");
 					if (!rebuild && !wiShaderCompiler::IsShaderOutdated(shaderbinaryfilename))
 					{
 						return;
@@ -489,6 +655,7 @@ int main(int argc, char* argv[])
 					input.stage = (wiGraphics::SHADERSTAGE)i;
 					input.shadersourcefilename = SHADERSOURCEPATH + shader;
 					input.include_directories.push_back(SHADERSOURCEPATH);
+					input.defines = job.defines;
 
 					auto it = minshadermodels.find(shader);
 					if (it != minshadermodels.end())
@@ -502,12 +669,30 @@ int main(int argc, char* argv[])
 						return;
 					}
 
+					if (!rebuild && !cachePath.empty() && LoadFromCache(shaderbinaryfilename, input))
+					{
+						cached_count.fetch_add(1);
+						locker.lock();
+						std::cout << "shader from cache: " << shaderbinaryfilename << std::endl;
+						locker.unlock();
+						return;
+					}
+
 					wiShaderCompiler::CompilerOutput output;
 					wiShaderCompiler::Compile(input, output);
 
 					if (output.IsValid())
 					{
 						wiShaderCompiler::SaveShaderAndMetadata(shaderbinaryfilename, output);
+						compiled_count.fetch_add(1);
+						if (!cachePath.empty())
+						{
+							const uint64_t sourcehash = wiShaderCompiler::ComputeSourceHash(output.dependencies);
+							if (sourcehash != 0)
+							{
+								wiShaderCompiler::SaveShaderAndMetadata(GetCacheFileName(sourcehash, input), output);
+							}
+						}
 
 						locker.lock();
 						if (!output.error_message.empty())
@@ -535,7 +720,28 @@ int main(int argc, char* argv[])
 	}
 	wiJobSystem::Wait(ctx);
 
-	std::cout << "[Wicked Engine Offline Shader Compiler] Finished in " << std::setprecision(4) << timer.elapsed_seconds() << " seconds" << std::endl;
+	std::cout << "[Wicked Engine Offline Shader Compiler] Finished in " << std::setprecision(4) << timer.elapsed_seconds() << " seconds (compiled: " << compiled_count.load() << ", from cache: " << cached_count.load() << ")" << std::endl;
+
+	if (shaderbundle_enabled)
+	{
+		for (auto& target : targets)
+		{
+			std::string bundle = target.dir;
+			while (!bundle.empty() && (bundle.back() == '/' || bundle.back() == '\\'))
+			{
+				bundle.pop_back();
+			}
+			bundle += ".wipak";
+
+			timer.record();
+			if (!wiPackage::Create(bundle, target.dir, shaderbundle_compression, "cso"))
+			{
+				std::cerr << "[Wicked Engine Offline Shader Compiler] Creating shader bundle FAILED: " << bundle << std::endl;
+				return 1;
+			}
+			std::cout << "[Wicked Engine Offline Shader Compiler] Shader bundle written to " << bundle << " in " << std::setprecision(4) << timer.elapsed_seconds() << " seconds" << std::endl;
+		}
+	}
 
 	if (shaderdump_enabled)
 	{
@@ -15,6 +15,7 @@
 // These are bound on demand and alive until another is bound at the same slot
 #define CBSLOT_IMAGE							3
 #define CBSLOT_FONT								4
+#define CBSLOT_UI								4
 
 #define CBSLOT_RENDERER_MISC					5
 #define CBSLOT_RENDERER_MATERIAL				6
@@ -24,14 +25,15 @@
 #define CBSLOT_RENDERER_DECAL					7
 #define CBSLOT_RENDERER_TESSELLATION			7
 #define CBSLOT_RENDERER_DISPATCHPARAMS			7
-#define CBSLOT_RENDERER_VOXELIZER				7
 #define CBSLOT_RENDERER_TRACED					7
 #define CBSLOT_RENDERER_BVH						7
 #define CBSLOT_RENDERER_UTILITY					7
 #define CBSLOT_RENDERER_POSTPROCESS				7
+#define CBSLOT_RENDERER_CLOTH					7
 #define CBSLOT_RENDERER_CUBEMAPRENDER			8
 
 #define CBSLOT_OTHER_EMITTEDPARTICLE			7
+#define CBSLOT_OTHER_EMITTEDPARTICLEPOOL		8
 #define CBSLOT_OTHER_HAIRPARTICLE				7
 #define CBSLOT_OTHER_FFTGENERATOR				7
 #define CBSLOT_OTHER_OCEAN_SIMULATION_IMMUTABLE	7
@@ -42,6 +44,7 @@
 #define CBSLOT_RENDERER_MATERIAL_BLEND1			8
 #define CBSLOT_RENDERER_MATERIAL_BLEND2			9
 #define CBSLOT_RENDERER_MATERIAL_BLEND3			10
+#define CBSLOT_RENDERER_VOXELIZER				11 // the voxelizer also uses the forward light mask and the blend materials
 
 
 
@@ -90,6 +90,37 @@
 #define SKINNINGSLOT_IN_VERTEX_BON	TEXSLOT_ONDEMAND2
 #define SKINNINGSLOT_IN_BONEBUFFER	TEXSLOT_ONDEMAND3
 
+// Bone transforms:
+#define BONETRANSFORMSSLOT_IN_TRANSFORMS	TEXSLOT_ONDEMAND0
+#define BONETRANSFORMSSLOT_IN_STATICS		TEXSLOT_ONDEMAND1
+
+// Instance table:
+#define INSTANCETABLESLOT_IN_UPDATES	TEXSLOT_ONDEMAND0
+
+// Material table:
+#define MATERIALTABLESLOT_IN_UPDATES	TEXSLOT_ONDEMAND0
+
+// GPU culling:
+#define GPUCULLINGSLOT_IN_INPUT		TEXSLOT_ONDEMAND0
+#define GPUCULLINGSLOT_IN_HIZ		TEXSLOT_ONDEMAND1
+#define MESHLETCULLINGSLOT_IN_MESHLETS	TEXSLOT_ONDEMAND2
+#define MESHLETCULLINGSLOT_IN_INDICES	TEXSLOT_ONDEMAND3
+
+// Hi-Z occlusion culling:
+#define OCCLUSIONCULLINGSLOT_IN_LINEARDEPTH	TEXSLOT_ONDEMAND0
+
+// Morph targets:
+#define MORPHSLOT_IN_VERTICES	TEXSLOT_ONDEMAND0
+#define MORPHSLOT_IN_DELTAS		TEXSLOT_ONDEMAND1
+#define MORPHSLOT_IN_WEIGHTS	TEXSLOT_ONDEMAND2
+
+// Cloth (the skinning inputs are bound at the skinning slots):
+#define CLOTHSLOT_IN_CONSTRAINTS	TEXSLOT_ONDEMAND4
+#define CLOTHSLOT_IN_RINGS			TEXSLOT_ONDEMAND5
+#define CLOTHSLOT_IN_MAPPING		TEXSLOT_ONDEMAND6
+#define CLOTHSLOT_IN_POSITIONS		TEXSLOT_ONDEMAND7
+#define CLOTHSLOT_IN_PARTICLES		TEXSLOT_ONDEMAND8
+
 
 // wiRenderer object shader resources:
 #define TEXSLOT_RENDERER_BASECOLORMAP			TEXSLOT_ONDEMAND0
@@ -12,6 +12,11 @@ CBUFFER(BVHCB, CBSLOT_RENDERER_BVH)
 	uint xBVHMeshTriangleOffset;
 	uint xBVHMeshTriangleCount;
 	uint xBVHMeshVertexPOSStride;
+
+	uint xBVHRefit; // the primitives are written in place, but their sorted order is kept
+	uint xBVHPadding0;
+	uint xBVHPadding1;
+	uint xBVHPadding2;
 };
 
 
@@ -22,15 +22,26 @@ struct ParticleCounters
 	uint deadCount;
 	uint realEmitCount;
 	uint aliveCount_afterSimulation;
+	uint drawOffset; // first element of the drawn index list range, only written for the pooled emitters
+	uint3 padding;
 };
 static const uint PARTICLECOUNTER_OFFSET_ALIVECOUNT = 0;
 static const uint PARTICLECOUNTER_OFFSET_DEADCOUNT = PARTICLECOUNTER_OFFSET_ALIVECOUNT + 4;
 static const uint PARTICLECOUNTER_OFFSET_REALEMITCOUNT = PARTICLECOUNTER_OFFSET_DEADCOUNT + 4;
 static const uint PARTICLECOUNTER_OFFSET_ALIVECOUNT_AFTERSIMULATION = PARTICLECOUNTER_OFFSET_REALEMITCOUNT + 4;
+static const uint PARTICLECOUNTER_OFFSET_DRAWOFFSET = PARTICLECOUNTER_OFFSET_ALIVECOUNT_AFTERSIMULATION + 4;
+static const uint PARTICLECOUNTER_STRIDE = 32;
 
 static const uint EMITTER_OPTION_BIT_FRAME_BLENDING_ENABLED = 1 << 0;
 static const uint EMITTER_OPTION_BIT_SPH_ENABLED = 1 << 1;
 static const uint EMITTER_OPTION_BIT_MESH_SHADER_ENABLED = 1 << 2;
+static const uint EMITTER_OPTION_BIT_POOLED = 1 << 3;
+// These are only used by the particle pool, the other emitters select shader variants instead:
+static const uint EMITTER_OPTION_BIT_VOLUME = 1 << 4;
+static const uint EMITTER_OPTION_BIT_SORTING = 1 << 5;
+static const uint EMITTER_OPTION_BIT_DEPTHCOLLISIONS = 1 << 6;
+static const uint EMITTER_OPTION_BIT_PAUSED = 1 << 7;
+static const uint EMITTER_OPTION_BIT_RESET = 1 << 8;
 
 CBUFFER(EmittedParticleCB, CBSLOT_OTHER_EMITTEDPARTICLE)
 {
@@ -54,7 +65,7 @@ CBUFFER(EmittedParticleCB, CBSLOT_OTHER_EMITTEDPARTICLE)
 	float		xParticleMass;
 	float		xParticleMotionBlurAmount;
 	float		xEmitterOpacity;
-	uint		xEmitterMaxParticleCount;
+	uint		xEmitterMaxParticleCount;	// no emission over this alive count (level of detail)
 
 	uint2		xEmitterFramesXY;
 	uint		xEmitterFrameCount;
@@ -85,8 +96,79 @@ CBUFFER(EmittedParticleCB, CBSLOT_OTHER_EMITTEDPARTICLE)
 	float3		xParticleVelocity;
 	float		xParticleRandomColorFactor;
 
+	uint		xEmitterPoolSlot;		// counter slot of a pooled emitter (EMITTER_OPTION_BIT_POOLED)
+	float		xEmitterAgeSpread;		// the emitted particles get a random age up to this, when a big time step is simulated
+	uint		xEmitterPoolPadding1;
+	uint		xEmitterPoolPadding2;
+
+};
+
+// Particle pool: the emitters without SPH and emitter mesh share the pool buffers and they are simulated together,
+//	one dispatch per phase for all of them, the thread groups of an emitter are a row of the dispatch (SV_GroupID.y)
+//	Every emitter has a range of the particle and dead lists (particleOffset, particleCount),
+//	and two ranges of the alive list, which is twice the pool size, because CURRENT and NEW alternate separately for every emitter
+//	The counters of an emitter are at slot * PARTICLECOUNTER_STRIDE, slot 0 is the pool counter, its aliveCount_afterSimulation is the sort count
+//	The sorted emitters are first in the emitter list, their surviving particles are appended to the sort list and sorted together,
+//	the sort key is (emitter << 23 | quantized distance), so every emitter gets a contiguous back to front range of the sorted list
+struct EmittedParticlePoolEmitter
+{
+	float4 mat0; // emitter world matrix rows
+	float4 mat1;
+	float4 mat2;
+
+	uint emitCount;
+	uint options;
+	uint layerMask;
+	float randomness;
+
+	float particleSize;
+	float particleScaling;
+	float particleRotation;
+	uint particleColor;
+
+	float randomFactor;
+	float normalFactor;
+	float lifeSpan;
+	float lifeSpanRandomness;
+
+	float mass;
+	float fixedTimestep;
+	float drag;
+	float randomColorFactor;
+
+	float3 gravity;
+	uint aliveOffsetCurrent;
+
+	float3 velocity;
+	uint aliveOffsetNew;
+
+	uint particleOffset;
+	uint particleCount;
+	uint slot;
+	uint particleLimit; // no emission over this alive count (level of detail)
+
+	float ageSpread; // the emitted particles get a random age up to this, when a big time step is simulated
+	uint padding0;
+	uint padding1;
+	uint padding2;
+};
+
+CBUFFER(EmittedParticlePoolCB, CBSLOT_OTHER_EMITTEDPARTICLEPOOL)
+{
+	uint		xPoolEmitterCount;
+	uint		xPoolResetCount;		// largest particle count of the emitters that are reset
+	uint		xPoolPadding0;
+	uint		xPoolPadding1;
 };
 
+static const uint THREADCOUNT_POOL = 64;
+static const uint POOL_SORT_MAX_EMITTERS = 256;
+static const uint POOL_SORT_DEPTH_BITS = 23;
+
+static const uint POOL_ARGUMENTBUFFER_OFFSET_DISPATCHEMIT = 0;
+static const uint POOL_ARGUMENTBUFFER_OFFSET_DISPATCHSIMULATION = POOL_ARGUMENTBUFFER_OFFSET_DISPATCHEMIT + (3 * 4);
+static const uint POOL_ARGUMENTBUFFER_OFFSET_DRAWPARTICLES = POOL_ARGUMENTBUFFER_OFFSET_DISPATCHSIMULATION + (3 * 4); // + slot * 16
+
 static const uint THREADCOUNT_EMIT = 256;
 static const uint THREADCOUNT_SIMULATION = 256;
 static const uint THREADCOUNT_MESH_SHADER = 32;
@@ -98,18 +180,22 @@ static const uint ARGUMENTBUFFER_OFFSET_DRAWPARTICLES = ARGUMENTBUFFER_OFFSET_DI
 
 // If this is not defined, SPH will be resolved as N-body simulation (O(n^2) complexity)
 // If this is defined, SPH will be sorted into a hashed grid structure and response lookup will be accelerated
+//	The particles are sorted by their bucket, and every bucket holds the range of its particles in the sorted list
+//	The x neighbors of a cell are the next buckets, so the 3 cells of a row are one range of the sorted list (unless the buckets wrap around)
 #define SPH_USE_ACCELERATION_GRID
-static const uint SPH_PARTITION_BUCKET_COUNT = 128 * 128 * 64;
+static const uint SPH_PARTITION_BUCKET_COUNT = 128 * 128 * 64; // power of two
+static const uint SPH_PARTITION_EMPTY_FIRST = 0xFFFFFFFF; // the range of an empty bucket is [SPH_PARTITION_EMPTY_FIRST, 0)
 
 inline uint SPH_GridHash(int3 cellIndex)
 {
-	const uint p1 = 73856093;   // some large primes 
-	const uint p2 = 19349663;
+	const uint p2 = 19349663;   // some large primes 
 	const uint p3 = 83492791;
-	int n = p1 * cellIndex.x ^ p2*cellIndex.y ^ p3*cellIndex.z;
-	n %= SPH_PARTITION_BUCKET_COUNT;
-	return n;
+	return ((((uint)cellIndex.y * p2) ^ ((uint)cellIndex.z * p3)) + (uint)cellIndex.x) & (SPH_PARTITION_BUCKET_COUNT - 1);
 }
 
+// A step is stable while the pressure waves don't travel more than SPH_CFL * smoothing radius in it (the speed of sound is sqrt(pressure constant))
+static const float SPH_CFL = 0.4f;
+static const uint SPH_MAX_SUBSTEPS = 4;
+
 #endif // WI_SHADERINTEROP_EMITTEDPARTICLE_H
 
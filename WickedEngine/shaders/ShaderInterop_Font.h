@@ -9,7 +9,7 @@ CBUFFER(FontCB, CBSLOT_FONT)
 	float4		g_xFont_Color;
 	uint		g_xFont_BufferOffset;
 	int			g_xFont_TextureIndex;
-	float		g_xFont_padding0;
+	uint		g_xFont_SDF; // 1: the atlas contains signed distance fields instead of coverage
 	float		g_xFont_padding1;
 };
 
@@ -9,4 +9,20 @@ CBUFFER(SortConstants, CBSLOT_OTHER_GPUSORTLIB)
 	uint counterReadOffset;
 };
 
+// Radix sort: 8 bits of the 32 bit keys are sorted in every pass
+//	The groups of the count and scatter passes process blocks of GPUSORTLIB_RADIX_BLOCK_SIZE elements, the scan pass is one group
+#define GPUSORTLIB_RADIX_BITS			8
+#define GPUSORTLIB_RADIX_BINS			256
+#define GPUSORTLIB_RADIX_THREADS		256
+#define GPUSORTLIB_RADIX_BLOCK_SIZE		1024
+#define GPUSORTLIB_RADIX_SCAN_THREADS	1024
+
+CBUFFER(RadixSortConstants, CBSLOT_OTHER_GPUSORTLIB)
+{
+	uint radix_counterReadOffset;
+	uint radix_maxCount;
+	uint radix_shift; // the first bit of the sorted digit, 0 in the first pass, which reads the keys from the comparison buffer
+	uint radix_padding;
+};
+
 #endif // WI_SHADERINTEROP_GPUSORTLIB_H
@@ -16,7 +16,7 @@ struct Patch
 struct PatchSimulationData
 {
 	float3 velocity;
-	uint padding;
+	uint frame; // the last frame when it was simulated, it is reset to the rest pose when the simulation was interrupted by culling
 };
 
 CBUFFER(HairParticleCB, CBSLOT_OTHER_HAIRPARTICLE)
@@ -46,6 +46,13 @@ CBUFFER(HairParticleCB, CBSLOT_OTHER_HAIRPARTICLE)
 	float2 xHairTexMul;
 	float xHairAspect;
 	uint xHairLayerMask;
+
+	float4x4 xHairOcclusionVP; // view projection of the camera of the Hi-Z occlusion culling texture
+
+	float xHairOcclusionZNear;
+	float xHairOcclusionZFar;
+	uint xHairOcclusion; // the strands are occlusion culled with the Hi-Z texture
+	float xHairDensityFalloff; // the strand density falls off from this fraction of the view distance
 };
 
 #endif // WI_SHADERINTEROP_HAIRPARTICLE_H
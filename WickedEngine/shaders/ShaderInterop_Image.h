@@ -12,6 +12,24 @@ CBUFFER(ImageCB, CBSLOT_IMAGE)
 	float4	xTexMulAdd;
 	float4	xTexMulAdd2;
 	float4	xColor;
+
+	uint	xInstanceOffset; // batched images: byte offset of the ImageInstance array in the instance buffer
+	uint3	xPadding_ImageCB;
+};
+
+// A batched image, the instance buffer is an array of these
+struct ImageInstance
+{
+	float4 corners0;
+	float4 corners1;
+	float4 corners2;
+	float4 corners3;
+	float4 texMulAdd;
+	float4 color;
+	int texture_index; // bindless descriptor of the base texture, unused without bindless, then every image of a batch has the same texture
+	int padding0;
+	int padding1;
+	int padding2;
 };
 
 struct PushConstantsImage
@@ -35,16 +35,17 @@ CBUFFER(Ocean_RenderCB, CBSLOT_OTHER_OCEAN_RENDER)
 	float       xOceanFogMinAmount;
 
 	float4		xOceanScreenSpaceParams;
+	float4		xOceanScreenRect; // the part of the screen that the grid covers in clip space (min.xy, max.xy)
 
 	float		xOceanTexelLength;
 	float		xOceanPatchSizeRecip;
 	float		xOceanMapHalfTexel;
 	float		xOceanWaterHeight;
 
-	float		xOceanSurfaceDisplacementTolerance;
 	float		xOceanFogMin;
 	float		xOceanFogMax;
 	float       xOceanPadding0;
+	float       xOceanPadding1;
 };
 
 #endif // WI_SHADERINTEROP_OCEAN_H
@@ -17,6 +17,10 @@ CBUFFER(PostProcessCB, CBSLOT_RENDERER_POSTPROCESS)
 #define lineardepth_inputresolution xPPParams0.xy
 #define lineardepth_inputresolution_rcp xPPParams0.zw
 
+// Temporal upscaling: the current frame and the velocity are at the input resolution, the history and the output at xPPResolution
+#define temporalaa_input_resolution xPPParams0.xy
+#define temporalaa_input_resolution_rcp xPPParams0.zw
+
 #define ssr_input_maxmip xPPParams0.x
 #define ssr_input_resolution_max xPPParams0.y
 
@@ -37,6 +41,10 @@ static const uint POSTPROCESS_HBAO_THREADCOUNT = 320;
 
 #define sss_step xPPParams0
 
+// The reprojected clouds are updated in blocks of blocksize x blocksize pixels, one pixel of every block per frame (2: checkerboard, 4: Bayer order)
+#define volumetricclouds_blocksize xPPParams1.x
+#define volumetricclouds_historyreset xPPParams1.y
+
 static const uint POSTPROCESS_MSAO_BLOCKSIZE = 16;
 CBUFFER(MSAOCB, CBSLOT_RENDERER_POSTPROCESS)
 {
@@ -68,7 +76,17 @@ CBUFFER(ShadingRateClassificationCB, CBSLOT_RENDERER_POSTPROCESS)
 	uint SHADING_RATE_2X4;
 	uint SHADING_RATE_4X2;
 	uint SHADING_RATE_4X4;
+
+	float xShadingRateCoCScale;		// depth of field: circle of confusion scale * aperture size, 0 without depth of field
+	float xShadingRateMaxCoC;
+	float xShadingRateFocus;		// depth of field: focal length / far plane, the linear depth that is in focus
+	uint xShadingRateOptions;		// SHADINGRATE_OPTION bits
+
+	uint xShadingRateCoarsestOpaque;		// the coarsest rate that is written for the opaque pass
+	uint xShadingRateCoarsestTransparent;	// the coarsest rate that is written for the transparent pass
+	uint2 xShadingRatePadding;
 };
+static const uint SHADINGRATE_OPTION_LUMINANCE = 1 << 0; // the luminance variance of the previous frame (TEXSLOT_ONDEMAND0) selects the rate of the tile
 
 CBUFFER(FSRCB, CBSLOT_RENDERER_POSTPROCESS)
 {
@@ -96,6 +114,8 @@ struct PushConstantsTonemap
 	int texture_input_distortion;
 	int texture_colorgrade_lookuptable;
 	int texture_output;
+	float sharpen;
+	float chromatic_aberration;
 };
 #define tonemap_exposure xPPParams0.x
 #define tonemap_dither xPPParams0.y
@@ -103,6 +123,8 @@ struct PushConstantsTonemap
 #define tonemap_eyeadaption xPPParams0.w
 #define tonemap_distortion xPPParams1.x
 #define tonemap_eyeadaptionkey xPPParams1.y
+#define tonemap_sharpen xPPParams1.z
+#define tonemap_chromatic_aberration xPPParams1.w
 
 #define luminance_adaptionrate xPPParams0.x
 
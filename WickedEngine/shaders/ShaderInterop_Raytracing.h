@@ -4,6 +4,20 @@
 
 
 static const uint RAYTRACING_LAUNCH_BLOCKSIZE = 8;
+static const uint RAYTRACING_TILE_SIZE = 64; // the scene is traced in square tiles of this many pixels, a multiple of RAYTRACING_LAUNCH_BLOCKSIZE
+static const float RAYTRACING_TILE_ERROR_SCALE = 1024; // the pixel errors are summed in this fixed point precision
+static const float RAYTRACING_TILE_ERROR_MAX = 64; // the error of a pixel is clamped to this, so the sum of a tile can't overflow
+
+struct RaytracingTile
+{
+	uint2 offset; // the top left pixel of the tile
+	uint sampleIndex;
+	float accumulationFactor;
+
+	float2 pixelOffset;
+	uint errorIndex; // the error of the tile is added to this element of the error buffer
+	uint padding;
+};
 
 
 CBUFFER(RaytracingCB, CBSLOT_RENDERER_TRACED)
@@ -11,6 +11,15 @@ static const uint SHADERMATERIAL_OPTION_BIT_USE_WIND = 1 << 4;
 static const uint SHADERMATERIAL_OPTION_BIT_RECEIVE_SHADOW = 1 << 5;
 static const uint SHADERMATERIAL_OPTION_BIT_CAST_SHADOW = 1 << 6;
 
+// Material features of the specialized object shader permutations, which are compiled with the OBJECTSHADER_PERMUTATION define
+//	The features that are not in the permutation are compiled out instead of being branched on at runtime
+static const uint OBJECTSHADER_PERMUTATION_NORMALMAP = 1 << 0;
+static const uint OBJECTSHADER_PERMUTATION_SURFACEMAP = 1 << 1; // surface map and specular map
+static const uint OBJECTSHADER_PERMUTATION_EMISSIVEMAP = 1 << 2;
+static const uint OBJECTSHADER_PERMUTATION_OCCLUSIONMAP = 1 << 3; // secondary occlusion map
+static const uint OBJECTSHADER_PERMUTATION_COUNT = 1 << 4;
+static const uint OBJECTSHADER_PERMUTATION_ALL = OBJECTSHADER_PERMUTATION_COUNT - 1; // this is the uber shader itself
+
 struct ShaderMaterial
 {
 	float4		baseColor;
@@ -95,6 +104,9 @@ struct ShaderMaterial
 	inline bool IsReceiveShadow() { return options & SHADERMATERIAL_OPTION_BIT_RECEIVE_SHADOW; }
 	inline bool IsCastingShadow() { return options & SHADERMATERIAL_OPTION_BIT_CAST_SHADOW; }
 };
+#define MATERIALTABLE_STRIDE 368 // sizeof(ShaderMaterial)
+#define MATERIALTABLE_UPDATE_STRIDE (16 + MATERIALTABLE_STRIDE) // material index (padded to 16 bytes) + ShaderMaterial
+#define MATERIALTABLE_UPDATE_THREADCOUNT 64
 
 struct ShaderMesh
 {
@@ -125,10 +137,83 @@ struct ShaderMeshSubset
 struct ObjectPushConstants
 {
 	int mesh;
-	int material;
+	int material; // index into the material table
 	int instances;
 	uint instance_offset;
+	int instance_table; // if valid, instances only contains (object index, dither | frustum index) pairs that refer to the instance table
+};
+
+// Persistent instance data of an object in the instance table, updated only when it changes
+struct ShaderInstance
+{
+	float4 mat0;
+	float4 mat1;
+	float4 mat2;
+	uint color;
+	uint emissive;
+	uint2 padding;
+	float4 matPrev0;
+	float4 matPrev1;
+	float4 matPrev2;
+	float4 atlasMulAdd;
 };
+#define INSTANCETABLE_STRIDE 128
+#define INSTANCETABLE_REFERENCE_STRIDE 8
+#define INSTANCETABLE_UPDATE_STRIDE (16 + INSTANCETABLE_STRIDE) // object index (padded to 16 bytes) + ShaderInstance
+#define INSTANCETABLE_UPDATE_THREADCOUNT 64
+
+// GPU culling of the opaque main camera instances against the frustum and the Hi-Z depth pyramid
+//	The input starts with uint4(batch count, candidates offset, occlusion enabled, 0)
+//	then every batch is uint4(first reference, candidate count, index count, index offset), the index count is 0 for batches of the meshlet culling
+//	and every candidate is float4(aabb min, object index), float4(aabb max, dither and frustum index)
+//	One thread group compacts the visible references of one batch and writes its IndirectDrawArgsIndexedInstanced
+#define GPUCULLING_BATCH_STRIDE 16
+#define GPUCULLING_CANDIDATE_STRIDE 32
+#define GPUCULLING_ARGS_STRIDE 20
+#define GPUCULLING_THREADCOUNT 64
+
+// GPU occlusion test of boxes for the systems that draw their own geometry (eg. terrain chunks), against the Hi-Z of the GPU culling
+//	The input starts with uint4(box count, occlusion enabled, 0, 0), then the view projection of the Hi-Z camera (4 rows), float4(zNearP, zFarP, 0, 0)
+//	then every box is float4(aabb min, output index), float4(aabb max, 0) with GPUCULLING_CANDIDATE_STRIDE. The output is a uint per box at its output index, 1 if it can be visible
+#define GPUCULLING_BOXES_HEADER_SIZE 96
+
+// GPU culling and LOD selection of instances for several views at once (eg. the cameras and shadow cascades of a frame), for the systems that draw many copies of a few meshes (eg. trees)
+//	The input starts with uint4(instance count, view count, lod count, occlusion view or ~0), the view projection of the Hi-Z camera (4 rows), float4(zNearP, zFarP, 0, 0)
+//	then INSTANCECULLING_MAX_LODS float4(max distance, index count, index offset, 0) and INSTANCECULLING_MAX_VIEWS views of 6 frustum planes and float4(position, 0)
+//	then every instance is float4(aabb min, 0), float4(aabb max, 0) with GPUCULLING_CANDIDATE_STRIDE
+//	The args are an IndirectDrawArgsIndexedInstanced for every [view * lod count + lod], its visible instance indices are at [(view * lod count + lod) * instance count], which is also its instance start
+#define INSTANCECULLING_MAX_LODS 8
+#define INSTANCECULLING_MAX_VIEWS 8
+#define INSTANCECULLING_VIEW_STRIDE 112
+#define INSTANCECULLING_LODS_OFFSET 96
+#define INSTANCECULLING_VIEWS_OFFSET (INSTANCECULLING_LODS_OFFSET + INSTANCECULLING_MAX_LODS * 16)
+#define INSTANCECULLING_HEADER_SIZE (INSTANCECULLING_VIEWS_OFFSET + INSTANCECULLING_MAX_VIEWS * INSTANCECULLING_VIEW_STRIDE)
+
+// Cluster of a mesh for the GPU meshlet culling, its triangles are a contiguous range of the mesh index buffer
+//	The bounds and the backface cone are in object space, the cone is degenerate when cone_cutoff >= 1
+struct ShaderMeshlet
+{
+	float3 center;
+	float radius;
+	float3 cone_axis;
+	float cone_cutoff;
+	uint indexOffset;
+	uint indexCount;
+	uint2 padding;
+};
+
+// GPU meshlet culling of the instances of meshes with clusters, after the instance culling of the same batches
+//	Every candidate is float4 mat0, mat1, mat2 (the rows of the world matrix) and uint4(object index, dither and frustum index, output index offset, reference slot)
+//	One thread group culls the clusters of one candidate, copies their indices to the output index buffer and writes its own IndirectDrawArgsIndexedInstanced
+//	The output is limited to MESHLETCULLING_MAX_INDICES, the batches that don't fit anymore are only culled per instance
+#define MESHLETCULLING_CANDIDATE_STRIDE 64
+#define MESHLETCULLING_MAX_INDICES (16 * 1024 * 1024)
+
+// Hi-Z occlusion culling: the farthest linear depth of the main camera is reduced to a fixed grid of cells for CPU readback
+//	The cells are stored row by row as floats, and the grid is reprojected to the current camera before it is tested
+#define OCCLUSIONCULLING_HIZ_WIDTH 128
+#define OCCLUSIONCULLING_HIZ_HEIGHT 64
+#define OCCLUSIONCULLING_HIZ_BLOCKSIZE 8
 
 // Warning: the size of this structure directly affects shader performance.
 //	Try to reduce it as much as possible!
@@ -140,7 +225,7 @@ struct ShaderEntity
 	uint type8_flags8_range16;
 
 	uint2 direction16_coneAngleCos16;
-	uint energy16_X16; // 16 bits free
+	uint energy16_X16; // spotlight: shadow atlas tile size
 	uint color;
 
 	uint layerMask;
@@ -186,6 +271,15 @@ struct ShaderEntity
 	{
 		return f16tof32((cubeRemap >> 16) & 0xFFFF);
 	}
+	// Spotlight shadow atlas tile in texels of the atlas page, reusing the cubemap remap that only point lights need:
+	inline float2 GetShadowAtlasOffset()
+	{
+		return float2(cubeRemap & 0xFFFF, (cubeRemap >> 16) & 0xFFFF);
+	}
+	inline float GetShadowAtlasSize()
+	{
+		return (float)((energy16_X16 >> 16) & 0xFFFF);
+	}
 	inline float4 GetColor()
 	{
 		float4 fColor;
@@ -249,6 +343,11 @@ struct ShaderEntity
 	{
 		cubeRemap |= XMConvertFloatToHalf(value) << 16;
 	}
+	inline void SetShadowAtlasTile(uint x, uint y, uint size)
+	{
+		cubeRemap = (x & 0xFFFF) | ((y & 0xFFFF) << 16);
+		energy16_X16 |= (size & 0xFFFF) << 16;
+	}
 	inline void SetIndices(uint matrixIndex, uint textureIndex)
 	{
 		indices = matrixIndex & 0xFFFF;
@@ -276,8 +375,9 @@ static const uint MATRIXARRAY_COUNT = 128;
 static const uint TILED_CULLING_BLOCKSIZE = 16;
 static const uint TILED_CULLING_THREADSIZE = 8;
 static const uint TILED_CULLING_GRANULARITY = TILED_CULLING_BLOCKSIZE / TILED_CULLING_THREADSIZE;
+static const uint CLUSTERED_CULLING_SLICES = 16; // depth slices of every tile when clustered entity culling is used
 
-static const int impostorCaptureAngles = 36;
+static const uint impostorCaptureGrid = 8; // the views of an impostor are captured from the cell directions of an octahedral grid with this size
 
 struct AtmosphereParameters
 {
@@ -530,7 +630,6 @@ static const uint OPTION_BIT_TEMPORALAA_ENABLED = 1 << 0;
 static const uint OPTION_BIT_TRANSPARENTSHADOWS_ENABLED = 1 << 1;
 static const uint OPTION_BIT_VOXELGI_ENABLED = 1 << 2;
 static const uint OPTION_BIT_VOXELGI_REFLECTIONS_ENABLED = 1 << 3;
-static const uint OPTION_BIT_VOXELGI_RETARGETTED = 1 << 4;
 static const uint OPTION_BIT_SIMPLE_SKY = 1 << 5;
 static const uint OPTION_BIT_REALISTIC_SKY = 1 << 6;
 static const uint OPTION_BIT_HEIGHT_FOG = 1 << 7;
@@ -539,6 +638,11 @@ static const uint OPTION_BIT_DISABLE_ALBEDO_MAPS = 1 << 9;
 static const uint OPTION_BIT_SHADOW_MASK = 1 << 10;
 static const uint OPTION_BIT_WATER_ENABLED = 1 << 11;
 
+// Voxel GI clipmaps: every clipmap is a grid of g_xFrame_VoxelRadianceDataRes^3 voxels around the camera, with twice the voxel size of the previous one
+//	They are stacked along the Z axis of the voxel radiance texture, and every clipmap is stored toroidally (at world voxel coordinate modulo resolution)
+static const uint VOXEL_GI_CLIPMAP_COUNT = 4;
+static const uint VOXEL_GI_CLIPMAP_SCROLL_GRANULARITY = 4; // clipmaps follow the camera in steps of this many voxels
+
 // ---------- Common Constant buffers: -----------------
 
 CBUFFER(FrameCB, CBSLOT_RENDERER_FRAME)
@@ -635,7 +739,7 @@ CBUFFER(FrameCB, CBSLOT_RENDERER_FRAME)
 
 	float		g_xFrame_ShadowResSpot2D;
 	float		g_xFrame_ShadowKernelSpot2D;
-	float2		filler2;
+	float2		g_xFrame_EntityCullingClusterScaleBias;	// clustered culling depth slice = log(view depth) * x + y
 
 	float3      g_xFrame_WaterColor;
 	float       g_xFrame_WaterHeight;
@@ -643,12 +747,14 @@ CBUFFER(FrameCB, CBSLOT_RENDERER_FRAME)
 	float		g_xFrame_WaterFogMin;
 	float		g_xFrame_WaterFogMax;
 	float		g_xFrame_WaterFogMinAmount;
-	float       g_xFrame_padding2;
+	int			g_xFrame_MaterialTableIndex;			// bindless descriptor of the material table, it holds a ShaderMaterial for every material of the scene
 
 	int			g_xFrame_ObjectShaderSamplerIndex;
 	float		g_xFrame_BlueNoisePhase;
 	float2		g_xFrame_padding1;
 
+	float4		g_xFrame_VoxelClipMaps[VOXEL_GI_CLIPMAP_COUNT];	// xyz: center of the clipmap in world space units, w: voxel half-extent
+
 	AtmosphereParameters g_xFrame_Atmosphere;
 	VolumetricCloudParameters g_xFrame_VolumetricClouds;
 };
@@ -772,6 +878,15 @@ CBUFFER(CubemapRenderCB, CBSLOT_RENDERER_CUBEMAPRENDER)
 	CubemapRenderCam xCubemapRenderCams[6];
 };
 
+// The region of a voxel GI clipmap that is updated, in world voxel coordinates of the clipmap
+CBUFFER(VoxelizerCB, CBSLOT_RENDERER_VOXELIZER)
+{
+	int3 xVoxelizer_RegionMin;
+	uint xVoxelizer_ClipMap;
+	int3 xVoxelizer_RegionMax; // exclusive
+	uint xVoxelizer_TemporalSmoothing; // blend with the previous content of the region (only if it was already voxelized at the same place)
+};
+
 CBUFFER(TessellationCB, CBSLOT_RENDERER_TESSELLATION)
 {
 	float4 xTessellationFactors;
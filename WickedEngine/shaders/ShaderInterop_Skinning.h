@@ -6,5 +6,101 @@
 // Skinning compute params:
 #define SKINNING_COMPUTE_THREADCOUNT 128
 
+// Bone transform compute params:
+//	One thread group computes the skinning matrices of a whole armature, so this is also the largest supported bone count
+#define BONETRANSFORMS_COMPUTE_THREADCOUNT 256
+
+// Compact local transform of a bone, uploaded every frame (relative to the parent bone, or to the armature for root bones)
+struct ShaderBoneTransform
+{
+	uint2 rotation; // quaternion, as four half floats
+	float3 translation;
+	float scale; // uniform scale
+};
+
+// Bone data that only changes when the armature is modified
+struct ShaderBoneStatic
+{
+	float4 inverseBind0; // inverse bind matrix in the same layout as the skinning bone buffer
+	float4 inverseBind1;
+	float4 inverseBind2;
+	uint parent; // index of the parent bone inside the armature, ~0 for root bones
+	uint depth; // number of parent bones
+	uint levels; // number of depth levels in the armature (same for every bone)
+	uint padding;
+};
+
+// Morph target compute params:
+#define MORPH_COMPUTE_THREADCOUNT 64
+
+// A vertex that is moved by at least one morph target, with its base attributes
+struct ShaderMorphVertex
+{
+	float3 position;
+	uint vertex; // index of the vertex in the mesh
+	float3 normal;
+	uint wind;
+	uint deltaOffset; // first delta of the vertex
+	uint deltaCount;
+	uint2 padding;
+};
+
+// Offset of a vertex by one morph target (scaled by the target weight)
+struct ShaderMorphDelta
+{
+	float3 position;
+	uint target; // index of the morph target in the mesh
+	float3 normal;
+	uint padding;
+};
+
+// Cloth compute params:
+#define CLOTH_COMPUTE_THREADCOUNT 64
+#define CLOTH_SOLVER_ITERATIONS 8 // even, so that the last iteration writes the positions that the next frame starts from
+#define CLOTH_MAX_COLLIDERS 32
+
+// Simulation state of a cloth particle (a physics vertex of the soft body)
+struct ShaderClothParticle
+{
+	float3 previous; // world space position at the previous step
+	float inverseMass; // 0: the particle follows the animation
+	uint vertex; // the graphics vertex that gives the animated position
+	uint constraintOffset; // distance constraints to the neighbors
+	uint constraintCount;
+	uint ringOffset; // triangles around the particle, for the normal
+	uint ringCount;
+	uint3 padding;
+};
+
+// Capsule collider in world space, it is a sphere when the two ends are the same
+struct ShaderClothCollider
+{
+	float3 a;
+	float radius;
+	float3 b;
+	float padding;
+};
+
+#define CLOTH_OPTION_SKINNED (1 << 0)
+#define CLOTH_OPTION_RESET (1 << 1) // the particles are placed to the animated positions
+
+CBUFFER(ClothCB, CBSLOT_RENDERER_CLOTH)
+{
+	float4x4 xClothWorld;
+
+	float3 xClothAcceleration; // gravity and wind
+	float xClothDeltaTime;
+
+	uint xClothParticleCount;
+	uint xClothVertexCount;
+	uint xClothColliderCount;
+	uint xClothOptions;
+
+	float xClothDamping;
+	float3 padding_clothCB;
+
+	ShaderClothCollider xClothColliders[CLOTH_MAX_COLLIDERS];
+};
+
 
 #endif // WI_SHADERINTEROP_SKINNING_H
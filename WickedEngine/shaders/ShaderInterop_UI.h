@@ -0,0 +1,14 @@
+#ifndef WI_SHADERINTEROP_UI_H
+#define WI_SHADERINTEROP_UI_H
+
+#include "ShaderInterop.h"
+
+CBUFFER(UICB, CBSLOT_UI)
+{
+	float4x4	g_xUI_Transform;
+	int			g_xUI_TextureIndex; // bindless descriptor of the texture, unused without bindless
+	uint3		g_xUI_padding;
+};
+
+
+#endif // WI_SHADERINTEROP_UI_H
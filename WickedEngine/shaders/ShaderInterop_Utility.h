@@ -16,6 +16,24 @@ CBUFFER(GenerateMIPChainCB, CBSLOT_RENDERER_UTILITY)
 };
 static const uint MIPGEN_OPTION_BIT_PRESERVE_COVERAGE = 1 << 0;
 
+// Single pass downsampler params (spdCS):
+#define SPD_MAX_MIPS 12
+#define SPD_THREADCOUNT 256
+#define SPD_INTERMEDIATE_SIZE 64 // the group count of a dispatch that generates more than 6 mips is at most SPD_INTERMEDIATE_SIZE in both dimensions
+#define SPD_EDGE_STRIDE 8192 // the max mip size + 1 of the conservative (max) reduction
+#define SPD_SLOT_COUNTER 12
+#define SPD_SLOT_INTERMEDIATE 13
+#define SPD_SLOT_EDGES 14
+
+CBUFFER(SPDCB, CBSLOT_RENDERER_UTILITY)
+{
+	uint2 spdInputResolution;
+	uint spdMipCount;
+	uint spdGroupCount;
+	uint2 spdGroupResolution;
+	uint2 padding_spdCB;
+};
+
 CBUFFER(FilterEnvmapCB, CBSLOT_RENDERER_UTILITY)
 {
 	uint2 filterResolution;
@@ -0,0 +1,83 @@
+#include "ResourceMapping.h"
+#include "ShaderInterop_Skinning.h"
+
+// Computes the skinning matrices of an armature from the compact local bone transforms
+//	The bones are resolved level by level, so that every parent is finished before its children
+
+struct Bone
+{
+	float4 pose0;
+	float4 pose1;
+	float4 pose2;
+};
+
+STRUCTUREDBUFFER(boneTransforms, ShaderBoneTransform, BONETRANSFORMSSLOT_IN_TRANSFORMS);
+STRUCTUREDBUFFER(boneStatics, ShaderBoneStatic, BONETRANSFORMSSLOT_IN_STATICS);
+
+RWSTRUCTUREDBUFFER(boneBuffer_output, Bone, 0);
+
+// Armature space bone matrices (the last row is implicitly 0, 0, 0, 1):
+groupshared float3x4 bone_world[BONETRANSFORMS_COMPUTE_THREADCOUNT];
+
+inline float3x4 MultiplyAffine(in float3x4 a, in float3x4 b)
+{
+	float3x4 result;
+	[unroll]
+	for (uint i = 0; i < 3; ++i)
+	{
+		result[i] = a[i].x * b[0] + a[i].y * b[1] + a[i].z * b[2] + float4(0, 0, 0, a[i].w);
+	}
+	return result;
+}
+
+inline float3x4 LoadLocal(in ShaderBoneTransform transform)
+{
+	const float4 q = float4(f16tof32(transform.rotation.x), f16tof32(transform.rotation.x >> 16), f16tof32(transform.rotation.y), f16tof32(transform.rotation.y >> 16));
+	const float3 t = transform.translation;
+	const float s = transform.scale;
+	return float3x4(
+		float4(1 - 2 * (q.y * q.y + q.z * q.z), 2 * (q.x * q.y - q.w * q.z), 2 * (q.x * q.z + q.w * q.y), 0) * s + float4(0, 0, 0, t.x),
+		float4(2 * (q.x * q.y + q.w * q.z), 1 - 2 * (q.x * q.x + q.z * q.z), 2 * (q.y * q.z - q.w * q.x), 0) * s + float4(0, 0, 0, t.y),
+		float4(2 * (q.x * q.z - q.w * q.y), 2 * (q.y * q.z + q.w * q.x), 1 - 2 * (q.x * q.x + q.y * q.y), 0) * s + float4(0, 0, 0, t.z)
+	);
+}
+
+[numthreads(BONETRANSFORMS_COMPUTE_THREADCOUNT, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	uint boneCount, stride;
+	boneStatics.GetDimensions(boneCount, stride);
+
+	const uint bone = DTid.x;
+	const bool valid = bone < boneCount;
+
+	ShaderBoneStatic info = (ShaderBoneStatic)0;
+	float3x4 local = (float3x4)0;
+	if (valid)
+	{
+		info = boneStatics[bone];
+		local = LoadLocal(boneTransforms[bone]);
+	}
+
+	const uint levels = boneStatics[0].levels;
+	for (uint level = 0; level < levels; ++level)
+	{
+		if (valid && info.depth == level)
+		{
+			bone_world[bone] = info.parent == ~0u ? local : MultiplyAffine(bone_world[info.parent], local);
+		}
+		GroupMemoryBarrierWithGroupSync();
+	}
+
+	if (valid)
+	{
+		const float3x4 inverseBind = float3x4(info.inverseBind0, info.inverseBind1, info.inverseBind2);
+		const float3x4 skinning = MultiplyAffine(bone_world[bone], inverseBind);
+
+		Bone result;
+		result.pose0 = skinning[0];
+		result.pose1 = skinning[1];
+		result.pose2 = skinning[2];
+		boneBuffer_output[bone] = result;
+	}
+}
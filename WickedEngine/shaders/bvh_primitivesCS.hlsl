@@ -5,6 +5,7 @@
 //	- This shader is run per object.
 //	- Each thread processes a triangle
 //	- Computes triangle bounding box, morton code and other properties and stores into global primitive buffer
+//	- When the BVH is refitted, it only runs for the changed objects and doesn't write the morton codes
 
 STRUCTUREDBUFFER(materialBuffer, ShaderMaterial, TEXSLOT_ONDEMAND0);
 TYPEDBUFFER(meshIndexBuffer, uint, TEXSLOT_ONDEMAND1);
@@ -138,14 +139,19 @@ void main(uint3 DTid : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex)
 		primitiveBuffer[primitiveID] = prim;
 		primitiveDataBuffer[primitiveID] = primdata;
 
-		primitiveIDBuffer[primitiveID] = primitiveID; // will be sorted by morton so we need this!
+		// When the tree is refitted, the primitive IDs are in the sorted order of the last rebuild:
+		[branch]
+		if (!xBVHRefit)
+		{
+			primitiveIDBuffer[primitiveID] = primitiveID; // will be sorted by morton so we need this!
 
 
-		// Compute triangle morton code:
-		float3 minAABB = min(v0, min(v1, v2));
-		float3 maxAABB = max(v0, max(v1, v2));
-		float3 centerAABB = (minAABB + maxAABB) * 0.5f;
-		const uint mortoncode = morton3D((centerAABB - g_xFrame_WorldBoundsMin) * g_xFrame_WorldBoundsExtents_rcp);
-		primitiveMortonBuffer[primitiveID] = (float)mortoncode; // convert to float before sorting
+			// Compute triangle morton code:
+			float3 minAABB = min(v0, min(v1, v2));
+			float3 maxAABB = max(v0, max(v1, v2));
+			float3 centerAABB = (minAABB + maxAABB) * 0.5f;
+			const uint mortoncode = morton3D((centerAABB - g_xFrame_WorldBoundsMin) * g_xFrame_WorldBoundsExtents_rcp);
+			primitiveMortonBuffer[primitiveID] = (float)mortoncode; // convert to float before sorting
+		}
 	}
 }
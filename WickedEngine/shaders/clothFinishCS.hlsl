@@ -0,0 +1,53 @@
+#include "clothHF.hlsli"
+
+// Writes the simulated particles into the deformed vertex buffers that the mesh is drawn from, in world space like the CPU soft bodies
+//	The normal is the area weighted sum of the triangles around the particle, the animated tangent is made orthogonal to it
+
+STRUCTUREDBUFFER(particleBuffer, ShaderClothParticle, CLOTHSLOT_IN_PARTICLES);
+STRUCTUREDBUFFER(ringBuffer, uint2, CLOTHSLOT_IN_RINGS); // the other two particles of a triangle around the particle, in winding order
+STRUCTUREDBUFFER(mappingBuffer, uint, CLOTHSLOT_IN_MAPPING); // the particle of every graphics vertex
+STRUCTUREDBUFFER(positionBuffer, float4, CLOTHSLOT_IN_POSITIONS);
+
+RWRAWBUFFER(streamoutBuffer_POS, 0);
+RWRAWBUFFER(streamoutBuffer_TAN, 1);
+
+[numthreads(CLOTH_COMPUTE_THREADCOUNT, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	if (DTid.x >= xClothVertexCount)
+	{
+		return;
+	}
+
+	const AnimatedVertex vertex = LoadAnimatedVertex(DTid.x);
+	const uint index = mappingBuffer[DTid.x];
+	const ShaderClothParticle particle = particleBuffer[index];
+	const float3 position = positionBuffer[index].xyz;
+
+	float3 normal = 0;
+	for (uint i = 0; i < particle.ringCount; ++i)
+	{
+		const uint2 ring = ringBuffer[particle.ringOffset + i];
+		normal += cross(positionBuffer[ring.x].xyz - position, positionBuffer[ring.y].xyz - position);
+	}
+	normal = dot(normal, normal) > 0 ? normalize(normal) : vertex.normal;
+
+	float3 tangent = vertex.tangent.xyz - normal * dot(normal, vertex.tangent.xyz);
+	tangent = dot(tangent, tangent) > 0 ? normalize(tangent) : vertex.tangent.xyz;
+
+	// Same packing as MeshComponent::Vertex_POS and Vertex_TAN:
+	uint normal_wind = 0;
+	normal_wind |= (uint)((normal.x * 0.5f + 0.5f) * 255.0f) << 0;
+	normal_wind |= (uint)((normal.y * 0.5f + 0.5f) * 255.0f) << 8;
+	normal_wind |= (uint)((normal.z * 0.5f + 0.5f) * 255.0f) << 16;
+	normal_wind |= vertex.wind << 24;
+
+	uint tan_u = 0;
+	tan_u |= (uint)((tangent.x * 0.5f + 0.5f) * 255.0f) << 0;
+	tan_u |= (uint)((tangent.y * 0.5f + 0.5f) * 255.0f) << 8;
+	tan_u |= (uint)((tangent.z * 0.5f + 0.5f) * 255.0f) << 16;
+	tan_u |= (uint)((vertex.tangent.w * 0.5f + 0.5f) * 255.0f) << 24;
+
+	streamoutBuffer_POS.Store4(DTid.x * 16, uint4(asuint(position), normal_wind));
+	streamoutBuffer_TAN.Store(DTid.x * 4, tan_u);
+}
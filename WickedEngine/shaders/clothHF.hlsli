@@ -0,0 +1,87 @@
+#ifndef WI_CLOTH_HF
+#define WI_CLOTH_HF
+#include "ResourceMapping.h"
+#include "ShaderInterop_Skinning.h"
+
+struct Bone
+{
+	float4 pose0;
+	float4 pose1;
+	float4 pose2;
+};
+STRUCTUREDBUFFER(boneBuffer, Bone, SKINNINGSLOT_IN_BONEBUFFER);
+
+RAWBUFFER(vertexBuffer_POS, SKINNINGSLOT_IN_VERTEX_POS);
+RAWBUFFER(vertexBuffer_TAN, SKINNINGSLOT_IN_VERTEX_TAN);
+RAWBUFFER(vertexBuffer_BON, SKINNINGSLOT_IN_VERTEX_BON);
+
+// A graphics vertex where the animation puts it, in world space
+struct AnimatedVertex
+{
+	float3 position;
+	float3 normal;
+	float4 tangent;
+	uint wind;
+};
+
+// The same unpacking and skinning as skinningCS, followed by the world matrix of the soft body:
+AnimatedVertex LoadAnimatedVertex(uint vertex)
+{
+	const uint4 pos_nor_u = vertexBuffer_POS.Load4(vertex * 16);
+	const uint tan_u = vertexBuffer_TAN.Load(vertex * 4);
+
+	AnimatedVertex v;
+	v.position = asfloat(pos_nor_u.xyz);
+	v.normal.x = (float)((pos_nor_u.w >> 0) & 0x000000FF) / 255.0f * 2.0f - 1.0f;
+	v.normal.y = (float)((pos_nor_u.w >> 8) & 0x000000FF) / 255.0f * 2.0f - 1.0f;
+	v.normal.z = (float)((pos_nor_u.w >> 16) & 0x000000FF) / 255.0f * 2.0f - 1.0f;
+	v.wind = (pos_nor_u.w >> 24) & 0x000000FF;
+	v.tangent.x = (float)((tan_u >> 0) & 0x000000FF) / 255.0f * 2.0f - 1.0f;
+	v.tangent.y = (float)((tan_u >> 8) & 0x000000FF) / 255.0f * 2.0f - 1.0f;
+	v.tangent.z = (float)((tan_u >> 16) & 0x000000FF) / 255.0f * 2.0f - 1.0f;
+	v.tangent.w = (float)((tan_u >> 24) & 0x000000FF) / 255.0f * 2.0f - 1.0f;
+
+	if (xClothOptions & CLOTH_OPTION_SKINNED)
+	{
+		const uint4 ind_wei_u = vertexBuffer_BON.Load4(vertex * 16);
+		const uint4 ind = uint4(
+			(ind_wei_u.x >> 0) & 0x0000FFFF,
+			(ind_wei_u.x >> 16) & 0x0000FFFF,
+			(ind_wei_u.y >> 0) & 0x0000FFFF,
+			(ind_wei_u.y >> 16) & 0x0000FFFF
+		);
+		const float4 wei = float4(
+			(float)((ind_wei_u.z >> 0) & 0x0000FFFF) / 65535.0f,
+			(float)((ind_wei_u.z >> 16) & 0x0000FFFF) / 65535.0f,
+			(float)((ind_wei_u.w >> 0) & 0x0000FFFF) / 65535.0f,
+			(float)((ind_wei_u.w >> 16) & 0x0000FFFF) / 65535.0f
+		);
+		if (any(wei))
+		{
+			float3 p = 0;
+			float3 n = 0;
+			float3 t = 0;
+			float weisum = 0;
+			[loop]
+			for (uint i = 0; ((i < 4) && (weisum < 1.0f)); ++i)
+			{
+				const Bone bone = boneBuffer[ind[i]];
+				const float4x4 m = float4x4(bone.pose0, bone.pose1, bone.pose2, float4(0, 0, 0, 1));
+				p += mul(m, float4(v.position, 1)).xyz * wei[i];
+				n += mul((float3x3)m, v.normal) * wei[i];
+				t += mul((float3x3)m, v.tangent.xyz) * wei[i];
+				weisum += wei[i];
+			}
+			v.position = p;
+			v.normal = n;
+			v.tangent.xyz = t;
+		}
+	}
+
+	v.position = mul(xClothWorld, float4(v.position, 1)).xyz;
+	v.normal = normalize(mul((float3x3)xClothWorld, v.normal));
+	v.tangent.xyz = normalize(mul((float3x3)xClothWorld, v.tangent.xyz));
+	return v;
+}
+
+#endif // WI_CLOTH_HF
@@ -0,0 +1,35 @@
+#include "clothHF.hlsli"
+
+// Moves the cloth particles by their velocities and the acceleration (Verlet integration), which gives the predicted positions for the solver
+//	The particles without mass are placed to the animated positions, the others keep their simulated state between frames
+
+RWSTRUCTUREDBUFFER(particleBuffer, ShaderClothParticle, 0);
+RWSTRUCTUREDBUFFER(positionBuffer, float4, 1); // xyz: position, w: inverse mass
+
+[numthreads(CLOTH_COMPUTE_THREADCOUNT, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	if (DTid.x >= xClothParticleCount)
+	{
+		return;
+	}
+
+	ShaderClothParticle particle = particleBuffer[DTid.x];
+	const float3 animated = LoadAnimatedVertex(particle.vertex).position;
+
+	float3 position = positionBuffer[DTid.x].xyz;
+	if ((xClothOptions & CLOTH_OPTION_RESET) || particle.inverseMass == 0)
+	{
+		position = animated;
+		particle.previous = animated;
+	}
+	else
+	{
+		const float3 velocity = (position - particle.previous) * xClothDamping;
+		particle.previous = position;
+		position += velocity + xClothAcceleration * xClothDeltaTime * xClothDeltaTime;
+	}
+
+	particleBuffer[DTid.x] = particle;
+	positionBuffer[DTid.x] = float4(position, particle.inverseMass);
+}
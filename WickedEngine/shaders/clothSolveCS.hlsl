@@ -0,0 +1,64 @@
+#include "clothHF.hlsli"
+
+// One Jacobi iteration of the distance constraints and the collisions, the positions are read from the previous iteration
+//	Every particle gathers the corrections of its own constraints, so there are no write conflicts between the threads
+//	The corrections are averaged and over-relaxed, which keeps the stiffness independent of the number of neighbors
+
+STRUCTUREDBUFFER(particleBuffer, ShaderClothParticle, CLOTHSLOT_IN_PARTICLES);
+STRUCTUREDBUFFER(constraintBuffer, uint2, CLOTHSLOT_IN_CONSTRAINTS); // x: neighbor particle, y: rest length (asuint)
+STRUCTUREDBUFFER(positionBuffer, float4, CLOTHSLOT_IN_POSITIONS);
+
+RWSTRUCTUREDBUFFER(output_positionBuffer, float4, 0);
+
+static const float relaxation = 1.5f;
+
+[numthreads(CLOTH_COMPUTE_THREADCOUNT, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	if (DTid.x >= xClothParticleCount)
+	{
+		return;
+	}
+
+	const float4 current = positionBuffer[DTid.x];
+	float3 position = current.xyz;
+	const float inverseMass = current.w;
+
+	if (inverseMass > 0)
+	{
+		const ShaderClothParticle particle = particleBuffer[DTid.x];
+		float3 correction = 0;
+		for (uint i = 0; i < particle.constraintCount; ++i)
+		{
+			const uint2 constraint = constraintBuffer[particle.constraintOffset + i];
+			const float4 neighbor = positionBuffer[constraint.x];
+			const float3 d = position - neighbor.xyz;
+			const float distance = length(d);
+			if (distance > 0)
+			{
+				correction -= inverseMass / (inverseMass + neighbor.w) * (distance - asfloat(constraint.y)) * d / distance;
+			}
+		}
+		if (particle.constraintCount > 0)
+		{
+			position += correction * relaxation / particle.constraintCount;
+		}
+
+		// The particle is pushed out to the surface of the colliders that it is inside of:
+		for (uint c = 0; c < xClothColliderCount; ++c)
+		{
+			const ShaderClothCollider collider = xClothColliders[c];
+			const float3 ab = collider.b - collider.a;
+			const float t = saturate(dot(position - collider.a, ab) / max(dot(ab, ab), 0.000001f));
+			const float3 closest = collider.a + ab * t;
+			const float3 d = position - closest;
+			const float distance = length(d);
+			if (distance > 0 && distance < collider.radius)
+			{
+				position = closest + d * (collider.radius / distance);
+			}
+		}
+	}
+
+	output_positionBuffer[DTid.x] = float4(position, inverseMass);
+}
@@ -9,6 +9,7 @@ static const float3 BILLBOARD[] = {
 	float3(1, 1, 0),	// 4
 };
 
+RAWBUFFER(counterBuffer, TEXSLOT_ONDEMAND20);
 STRUCTUREDBUFFER(particleBuffer, Particle, TEXSLOT_ONDEMAND21);
 STRUCTUREDBUFFER(aliveList, uint, TEXSLOT_ONDEMAND22);
 
@@ -16,8 +17,16 @@ VertextoPixel main(uint vertexID : SV_VERTEXID, uint instanceID : SV_INSTANCEID)
 {
 	VertextoPixel Out;
 
+	// the pooled emitters draw a range of the pooled alive or sort list:
+	uint drawOffset = 0;
+	[branch]
+	if (xEmitterOptions & EMITTER_OPTION_BIT_POOLED)
+	{
+		drawOffset = counterBuffer.Load(xEmitterPoolSlot * PARTICLECOUNTER_STRIDE + PARTICLECOUNTER_OFFSET_DRAWOFFSET);
+	}
+
 	// load particle data:
-	Particle particle = particleBuffer[aliveList[instanceID]];
+	Particle particle = particleBuffer[aliveList[drawOffset + instanceID]];
 
 	// calculate render properties from life:
 	float lifeLerp = 1 - particle.life / particle.maxLife;
@@ -114,6 +114,11 @@ void main(uint3 DTid : SV_DispatchThreadID)
 		color_modifier |= (uint)(255.0 * lerp(1, rand(seed, uv), xParticleRandomColorFactor)) << 16;
 		particle.color_mirror |= xParticleColor & color_modifier;
 
+		// when a big time step is simulated, the particles are spread over it, as if they were emitted continuously:
+		const float age = rand(seed, uv) * xEmitterAgeSpread;
+		particle.life -= age;
+		particle.position += particle.velocity * age;
+
 
 		// new particle index retrieved from dead list (pop):
 		uint deadCount;
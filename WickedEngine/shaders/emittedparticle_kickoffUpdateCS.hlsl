@@ -16,6 +16,9 @@ void main(uint3 DTid : SV_DispatchThreadID)
 	// we can not emit more than there are free slots in the dead list:
 	uint realEmitCount = min(deadCount, xEmitCount);
 
+	// and not more than the particle limit of the level of detail:
+	realEmitCount = min(realEmitCount, xEmitterMaxParticleCount - min(xEmitterMaxParticleCount, aliveCount_NEW));
+
 	// Fill dispatch argument buffer for emitting (ThreadGroupCountX, ThreadGroupCountY, ThreadGroupCountZ):
 	indirectBuffers.Store3(ARGUMENTBUFFER_OFFSET_DISPATCHEMIT, uint3(ceil((float)realEmitCount / (float)THREADCOUNT_EMIT), 1, 1));
 
@@ -0,0 +1,82 @@
+#include "globals.hlsli"
+#include "ShaderInterop_EmittedParticle.h"
+
+STRUCTUREDBUFFER(emitterBuffer, EmittedParticlePoolEmitter, TEXSLOT_ONDEMAND0);
+
+RWSTRUCTUREDBUFFER(particleBuffer, Particle, 0);
+RWSTRUCTUREDBUFFER(aliveBuffer, uint, 1);
+RWSTRUCTUREDBUFFER(deadBuffer, uint, 2);
+RWRAWBUFFER(counterBuffer, 3);
+
+[numthreads(THREADCOUNT_EMIT, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID, uint3 Gid : SV_GroupID)
+{
+	EmittedParticlePoolEmitter emitter = emitterBuffer[Gid.y];
+	const uint address = emitter.slot * PARTICLECOUNTER_STRIDE;
+
+	uint emitCount = counterBuffer.Load(address + PARTICLECOUNTER_OFFSET_REALEMITCOUNT);
+
+	if (DTid.x < emitCount)
+	{
+		// we can emit:
+
+		const float4x4 emitterWorld = float4x4(emitter.mat0, emitter.mat1, emitter.mat2, float4(0, 0, 0, 1));
+
+		float2 uv = float2(g_xFrame_Time + emitter.randomness, (float)DTid.x / (float)THREADCOUNT_EMIT);
+		float seed = 0.12345;
+
+		float3 pos;
+		[branch]
+		if (emitter.options & EMITTER_OPTION_BIT_VOLUME)
+		{
+			// Emit inside volume:
+			pos = mul(emitterWorld, float4(rand(seed, uv) * 2 - 1, rand(seed, uv) * 2 - 1, rand(seed, uv) * 2 - 1, 1)).xyz;
+		}
+		else
+		{
+			// Just emit from center point:
+			pos = mul(emitterWorld, float4(0, 0, 0, 1)).xyz;
+		}
+
+		float particleStartingSize = emitter.particleSize + emitter.particleSize * (rand(seed, uv) - 0.5f) * emitter.randomFactor;
+
+		// create new particle:
+		Particle particle;
+		particle.position = pos;
+		particle.force = 0;
+		particle.mass = emitter.mass;
+		particle.velocity = emitter.velocity + ((float3(rand(seed, uv), rand(seed, uv), rand(seed, uv)) - 0.5f) * emitter.randomFactor) * emitter.normalFactor;
+		particle.rotationalVelocity = emitter.particleRotation + (rand(seed, uv) - 0.5f) * emitter.randomFactor;
+		particle.maxLife = emitter.lifeSpan + emitter.lifeSpan * (rand(seed, uv) - 0.5f) * emitter.lifeSpanRandomness;
+		particle.life = particle.maxLife;
+		particle.sizeBeginEnd = float2(particleStartingSize, particleStartingSize * emitter.particleScaling);
+		particle.color_mirror = 0;
+		particle.color_mirror |= ((rand(seed, uv) > 0.5f) << 31) & 0x10000000;
+		particle.color_mirror |= ((rand(seed, uv) < 0.5f) << 30) & 0x20000000;
+
+		uint color_modifier = 0;
+		color_modifier |= (uint)(255.0 * lerp(1, rand(seed, uv), emitter.randomColorFactor)) << 0;
+		color_modifier |= (uint)(255.0 * lerp(1, rand(seed, uv), emitter.randomColorFactor)) << 8;
+		color_modifier |= (uint)(255.0 * lerp(1, rand(seed, uv), emitter.randomColorFactor)) << 16;
+		particle.color_mirror |= emitter.particleColor & color_modifier;
+
+		// when a big time step is simulated, the particles are spread over it, as if they were emitted continuously:
+		const float age = rand(seed, uv) * emitter.ageSpread;
+		particle.life -= age;
+		particle.position += particle.velocity * age;
+
+
+		// new particle index retrieved from the dead list range of the emitter (pop):
+		uint deadCount;
+		counterBuffer.InterlockedAdd(address + PARTICLECOUNTER_OFFSET_DEADCOUNT, -1, deadCount);
+		uint newParticleIndex = deadBuffer[emitter.particleOffset + deadCount - 1];
+
+		// write out the new particle:
+		particleBuffer[newParticleIndex] = particle;
+
+		// and add index to the CURRENT alive list range of the emitter (push):
+		uint aliveCount;
+		counterBuffer.InterlockedAdd(address + PARTICLECOUNTER_OFFSET_ALIVECOUNT, 1, aliveCount);
+		aliveBuffer[emitter.aliveOffsetCurrent + aliveCount] = newParticleIndex;
+	}
+}
@@ -0,0 +1,33 @@
+#include "globals.hlsli"
+#include "ShaderInterop_EmittedParticle.h"
+
+STRUCTUREDBUFFER(emitterBuffer, EmittedParticlePoolEmitter, TEXSLOT_ONDEMAND0);
+
+RWRAWBUFFER(counterBuffer, 3);
+RWRAWBUFFER(indirectBuffers, 4);
+
+[numthreads(THREADCOUNT_POOL, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	if (DTid.x >= xPoolEmitterCount)
+		return;
+
+	EmittedParticlePoolEmitter emitter = emitterBuffer[DTid.x];
+	const uint address = emitter.slot * PARTICLECOUNTER_STRIDE;
+	uint particleCount = counterBuffer.Load(address + PARTICLECOUNTER_OFFSET_ALIVECOUNT_AFTERSIMULATION);
+
+	uint drawOffset = emitter.aliveOffsetNew;
+	if (emitter.options & EMITTER_OPTION_BIT_SORTING)
+	{
+		// The sorted emitters are first in the emitter list, their ranges are in the same order in the sort list:
+		drawOffset = 0;
+		for (uint i = 0; i < DTid.x; ++i)
+		{
+			drawOffset += counterBuffer.Load(emitterBuffer[i].slot * PARTICLECOUNTER_STRIDE + PARTICLECOUNTER_OFFSET_ALIVECOUNT_AFTERSIMULATION);
+		}
+	}
+	counterBuffer.Store(address + PARTICLECOUNTER_OFFSET_DRAWOFFSET, drawOffset);
+
+	// Create draw argument buffer (VertexCountPerInstance, InstanceCount, StartVertexLocation, StartInstanceLocation):
+	indirectBuffers.Store4(POOL_ARGUMENTBUFFER_OFFSET_DRAWPARTICLES + emitter.slot * 16, uint4(4, particleCount, 0, 0));
+}
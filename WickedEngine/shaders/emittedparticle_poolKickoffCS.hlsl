@@ -0,0 +1,59 @@
+#include "globals.hlsli"
+#include "ShaderInterop_EmittedParticle.h"
+
+STRUCTUREDBUFFER(emitterBuffer, EmittedParticlePoolEmitter, TEXSLOT_ONDEMAND0);
+
+RWRAWBUFFER(counterBuffer, 3);
+RWRAWBUFFER(indirectBuffers, 4);
+
+groupshared uint maxEmitCount;
+groupshared uint maxSimulationCount;
+
+// One thread group kicks off every emitter of the pool, and the dispatches are sized for the largest of them
+[numthreads(THREADCOUNT_POOL, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex)
+{
+	if (groupIndex == 0)
+	{
+		maxEmitCount = 0;
+		maxSimulationCount = 0;
+
+		// reset the sort count:
+		counterBuffer.Store(PARTICLECOUNTER_OFFSET_ALIVECOUNT_AFTERSIMULATION, 0);
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	for (uint i = groupIndex; i < xPoolEmitterCount; i += THREADCOUNT_POOL)
+	{
+		EmittedParticlePoolEmitter emitter = emitterBuffer[i];
+		const uint address = emitter.slot * PARTICLECOUNTER_STRIDE;
+
+		// Load dead particle count:
+		uint deadCount = counterBuffer.Load(address + PARTICLECOUNTER_OFFSET_DEADCOUNT);
+
+		// Load alive particle count:
+		uint aliveCount_NEW = counterBuffer.Load(address + PARTICLECOUNTER_OFFSET_ALIVECOUNT_AFTERSIMULATION);
+
+		// we can not emit more than there are free slots in the dead list:
+		uint realEmitCount = (emitter.options & EMITTER_OPTION_BIT_PAUSED) ? 0 : min(deadCount, emitter.emitCount);
+
+		// and not more than the particle limit of the level of detail:
+		realEmitCount = min(realEmitCount, emitter.particleLimit - min(emitter.particleLimit, aliveCount_NEW));
+
+		InterlockedMax(maxEmitCount, realEmitCount);
+		InterlockedMax(maxSimulationCount, aliveCount_NEW + realEmitCount);
+
+		// copy new alivelistcount to current alivelistcount, reset new alivecount and write real emit count:
+		counterBuffer.Store(address + PARTICLECOUNTER_OFFSET_ALIVECOUNT, aliveCount_NEW);
+		counterBuffer.Store(address + PARTICLECOUNTER_OFFSET_ALIVECOUNT_AFTERSIMULATION, 0);
+		counterBuffer.Store(address + PARTICLECOUNTER_OFFSET_REALEMITCOUNT, realEmitCount);
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	if (groupIndex == 0)
+	{
+		// Every emitter is a row of thread groups (ThreadGroupCountX, ThreadGroupCountY, ThreadGroupCountZ):
+		indirectBuffers.Store3(POOL_ARGUMENTBUFFER_OFFSET_DISPATCHEMIT, uint3((maxEmitCount + THREADCOUNT_EMIT - 1) / THREADCOUNT_EMIT, xPoolEmitterCount, 1));
+		indirectBuffers.Store3(POOL_ARGUMENTBUFFER_OFFSET_DISPATCHSIMULATION, uint3((maxSimulationCount + THREADCOUNT_SIMULATION - 1) / THREADCOUNT_SIMULATION, xPoolEmitterCount, 1));
+	}
+}
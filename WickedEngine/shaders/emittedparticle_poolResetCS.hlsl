@@ -0,0 +1,28 @@
+#include "globals.hlsli"
+#include "ShaderInterop_EmittedParticle.h"
+
+STRUCTUREDBUFFER(emitterBuffer, EmittedParticlePoolEmitter, TEXSLOT_ONDEMAND0);
+
+RWSTRUCTUREDBUFFER(deadBuffer, uint, 2);
+RWRAWBUFFER(counterBuffer, 3);
+
+[numthreads(THREADCOUNT_EMIT, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID, uint3 Gid : SV_GroupID)
+{
+	EmittedParticlePoolEmitter emitter = emitterBuffer[Gid.y];
+
+	if ((emitter.options & EMITTER_OPTION_BIT_RESET) == 0)
+		return;
+
+	// every particle of the range is dead:
+	if (DTid.x < emitter.particleCount)
+	{
+		deadBuffer[emitter.particleOffset + DTid.x] = emitter.particleOffset + DTid.x;
+	}
+
+	if (DTid.x == 0)
+	{
+		const uint address = emitter.slot * PARTICLECOUNTER_STRIDE;
+		counterBuffer.Store4(address, uint4(0, emitter.particleCount, 0, 0));
+	}
+}
@@ -0,0 +1,149 @@
+#include "globals.hlsli"
+#include "ShaderInterop_EmittedParticle.h"
+
+STRUCTUREDBUFFER(emitterBuffer, EmittedParticlePoolEmitter, TEXSLOT_ONDEMAND0);
+
+RWSTRUCTUREDBUFFER(particleBuffer, Particle, 0);
+RWSTRUCTUREDBUFFER(aliveBuffer, uint, 1);
+RWSTRUCTUREDBUFFER(deadBuffer, uint, 2);
+RWRAWBUFFER(counterBuffer, 3);
+RWSTRUCTUREDBUFFER(distanceBuffer, float, 5);
+RWSTRUCTUREDBUFFER(sortBuffer, uint, 6);
+
+[numthreads(THREADCOUNT_SIMULATION, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID, uint3 Gid : SV_GroupID)
+{
+	EmittedParticlePoolEmitter emitter = emitterBuffer[Gid.y];
+	const uint address = emitter.slot * PARTICLECOUNTER_STRIDE;
+
+	uint aliveCount = counterBuffer.Load(address + PARTICLECOUNTER_OFFSET_ALIVECOUNT);
+
+	if (DTid.x < aliveCount)
+	{
+		// simulation can be either fixed or variable timestep:
+		const float dt = emitter.fixedTimestep >= 0 ? emitter.fixedTimestep : g_xFrame_DeltaTime;
+
+		uint particleIndex = aliveBuffer[emitter.aliveOffsetCurrent + DTid.x];
+		Particle particle = particleBuffer[particleIndex];
+
+		// the particles of a paused emitter are only moved to the NEW alive list:
+		const bool paused = emitter.options & EMITTER_OPTION_BIT_PAUSED;
+
+		if (paused || particle.life > 0)
+		{
+			[branch]
+			if (!paused)
+			{
+				// simulate:
+				for (uint i = 0; i < g_xFrame_ForceFieldArrayCount; ++i)
+				{
+					ShaderEntity forceField = EntityArray[g_xFrame_ForceFieldArrayOffset + i];
+
+					[branch]
+					if (forceField.layerMask & emitter.layerMask)
+					{
+						float3 dir = forceField.position - particle.position;
+						float dist;
+						if (forceField.GetType() == ENTITY_TYPE_FORCEFIELD_POINT) // point-based force field
+						{
+							dist = length(dir);
+						}
+						else // planar force field
+						{
+							dist = dot(forceField.GetDirection(), dir);
+							dir = forceField.GetDirection();
+						}
+
+						particle.force += dir * forceField.GetEnergy() * (1 - saturate(dist * forceField.GetRange())); // GetRange() is actually uploaded as 1.0 / range
+					}
+				}
+
+				[branch]
+				if (emitter.options & EMITTER_OPTION_BIT_DEPTHCOLLISIONS)
+				{
+					// NOTE: We are using the textures from previous frame, so reproject against those! (PrevVP)
+
+					float4 pos2D = mul(g_xCamera_PrevVP, float4(particle.position, 1));
+					pos2D.xyz /= pos2D.w;
+
+					if (pos2D.x > -1 && pos2D.x < 1 && pos2D.y > -1 && pos2D.y < 1)
+					{
+						float2 uv = pos2D.xy * float2(0.5f, -0.5f) + 0.5f;
+						uint2 pixel = uv * g_xFrame_InternalResolution;
+
+						float depth0 = texture_depth[pixel];
+						float surfaceLinearDepth = getLinearDepth(depth0);
+						float surfaceThickness = 1.5f;
+
+						float lifeLerp = 1 - particle.life / particle.maxLife;
+						float particleSize = lerp(particle.sizeBeginEnd.x, particle.sizeBeginEnd.y, lifeLerp);
+
+						// check if particle is colliding with the depth buffer, but not completely behind it:
+						if ((pos2D.w + particleSize > surfaceLinearDepth) && (pos2D.w - particleSize < surfaceLinearDepth + surfaceThickness))
+						{
+							// Calculate surface normal and bounce off the particle:
+							float depth1 = texture_depth[pixel + uint2(1, 0)];
+							float depth2 = texture_depth[pixel + uint2(0, -1)];
+
+							float3 p0 = reconstructPosition(uv, depth0, g_xCamera_PrevInvVP);
+							float3 p1 = reconstructPosition(uv + float2(1, 0) * g_xFrame_InternalResolution_rcp, depth1, g_xCamera_PrevInvVP);
+							float3 p2 = reconstructPosition(uv + float2(0, -1) * g_xFrame_InternalResolution_rcp, depth2, g_xCamera_PrevInvVP);
+
+							float3 surfaceNormal = normalize(cross(p2 - p0, p1 - p0));
+
+							if (dot(particle.velocity, surfaceNormal) < 0)
+							{
+								const float restitution = 0.98f;
+								particle.velocity = reflect(particle.velocity, surfaceNormal) * restitution;
+							}
+						}
+					}
+				}
+
+				// integrate:
+				particle.force += emitter.gravity;
+				particle.velocity += particle.force * dt;
+				particle.position += particle.velocity * dt;
+
+				// reset force for next frame:
+				particle.force = 0;
+
+				// drag: 
+				particle.velocity *= emitter.drag;
+
+				particle.life -= dt;
+
+				// write back simulated particle:
+				particleBuffer[particleIndex] = particle;
+			}
+
+			// add to the NEW alive list range of the emitter:
+			uint newAliveIndex;
+			counterBuffer.InterlockedAdd(address + PARTICLECOUNTER_OFFSET_ALIVECOUNT_AFTERSIMULATION, 1, newAliveIndex);
+			aliveBuffer[emitter.aliveOffsetNew + newAliveIndex] = particleIndex;
+
+			[branch]
+			if (emitter.options & EMITTER_OPTION_BIT_SORTING)
+			{
+				// the sort key is the emitter in the upper bits and the distance to the main camera (far to near) in the lower bits,
+				//	it is below 2^31, so the bits of the float are sorted:
+				const float distance = length(particle.position - g_xCamera_CamPos);
+				const uint depthMax = (1u << POOL_SORT_DEPTH_BITS) - 1;
+				const uint depth = depthMax - (uint)(saturate(distance * g_xCamera_ZFarP_rcp) * depthMax);
+				distanceBuffer[particleIndex] = asfloat((Gid.y << POOL_SORT_DEPTH_BITS) | depth);
+
+				// add to the sort list of the pool:
+				uint sortIndex;
+				counterBuffer.InterlockedAdd(PARTICLECOUNTER_OFFSET_ALIVECOUNT_AFTERSIMULATION, 1, sortIndex);
+				sortBuffer[sortIndex] = particleIndex;
+			}
+		}
+		else
+		{
+			// kill:
+			uint deadIndex;
+			counterBuffer.InterlockedAdd(address + PARTICLECOUNTER_OFFSET_DEADCOUNT, 1, deadIndex);
+			deadBuffer[emitter.particleOffset + deadIndex] = particleIndex;
+		}
+	}
+}
@@ -4,10 +4,10 @@
 STRUCTUREDBUFFER(aliveBuffer_CURRENT, uint, 0);
 RAWBUFFER(counterBuffer, 1);
 STRUCTUREDBUFFER(particleBuffer, Particle, 2);
-STRUCTUREDBUFFER(cellIndexBuffer, float, 3);
-STRUCTUREDBUFFER(cellOffsetBuffer, uint, 4);
+STRUCTUREDBUFFER(cellRangeBuffer, uint2, 3);
+STRUCTUREDBUFFER(sortedPositionBuffer, float4, 4); // position, mass
 
-RWSTRUCTUREDBUFFER(densityBuffer, float, 0);
+RWSTRUCTUREDBUFFER(densityBuffer, float, 0); // in the order of the alive list
 
 #ifndef SPH_USE_ACCELERATION_GRID
 // grid structure is not a good fit to exploit shared memory because one threadgroup can load from different initial cells :(
@@ -27,17 +27,18 @@ void main( uint3 DTid : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex, ui
 
 	uint aliveCount = counterBuffer.Load(PARTICLECOUNTER_OFFSET_ALIVECOUNT);
 
-	uint particleIndexA;
 	float3 positionA;
 
 	if (DTid.x < aliveCount)
 	{
-		particleIndexA = aliveBuffer_CURRENT[DTid.x];
-		positionA = particleBuffer[particleIndexA].position;
+#ifdef SPH_USE_ACCELERATION_GRID
+		positionA = sortedPositionBuffer[DTid.x].xyz;
+#else
+		positionA = particleBuffer[aliveBuffer_CURRENT[DTid.x]].position;
+#endif // SPH_USE_ACCELERATION_GRID
 	}
 	else
 	{
-		particleIndexA = 0xFFFFFFFF;
 		positionA = 0;
 	}
 
@@ -52,50 +53,43 @@ void main( uint3 DTid : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex, ui
 	const float3 remappedPos = positionA * xSPH_h_rcp;
 	const int3 cellIndex = floor(remappedPos);
 
-	// iterate through all [27] neighbor cells:
+	// iterate through the [9] neighbor rows of [3] cells:
 	[loop]
-	for (int i = -1; i <= 1; ++i)
+	for (int j = -1; j <= 1; ++j)
 	{
 		[loop]
-		for (int j = -1; j <= 1; ++j)
+		for (int k = -1; k <= 1; ++k)
 		{
+			// the cells of a row are consecutive buckets, their particles are one range unless the buckets wrap around:
+			const uint firstBucket = SPH_GridHash(cellIndex + int3(-1, j, k));
+			const uint split = min(3u, SPH_PARTITION_BUCKET_COUNT - firstBucket);
+
 			[loop]
-			for (int k = -1; k <= 1; ++k)
+			for (uint segment = 0; segment < 2; ++segment)
 			{
-				// hashed cell index is retrieved:
-				const int3 neighborIndex = cellIndex + int3(i, j, k);
-				const uint flatNeighborIndex = SPH_GridHash(neighborIndex);
-
-				// look up the offset into particle list from neighbor cell:
-				uint neighborIterator = cellOffsetBuffer[flatNeighborIndex];
+				uint2 range = uint2(SPH_PARTITION_EMPTY_FIRST, 0);
+				for (uint b = (segment == 0 ? 0 : split); b < (segment == 0 ? split : 3); ++b)
+				{
+					const uint2 bucketRange = cellRangeBuffer[(firstBucket + b) & (SPH_PARTITION_BUCKET_COUNT - 1)];
+					range.x = min(range.x, bucketRange.x);
+					range.y = max(range.y, bucketRange.y);
+				}
 
-				// iterate through neighbor cell particles (if iterator offset is valid):
+				// SPH Density evaluation:
 				[loop]
-				while (neighborIterator != 0xFFFFFFFF && neighborIterator < aliveCount)
+				for (uint neighborIterator = range.x; neighborIterator < range.y; ++neighborIterator)
 				{
-					uint particleIndexB = aliveBuffer_CURRENT[neighborIterator];
-					if ((uint)cellIndexBuffer[particleIndexB] != flatNeighborIndex)
-					{
-						// here means we stepped out of the neighbor cell list!
-						break;
-					}
-
-					// SPH Density evaluation:
-					{
-						Particle particleB = particleBuffer[particleIndexB];
+					const float4 positionMassB = sortedPositionBuffer[neighborIterator];
 
-						float3 diff = positionA - particleB.position;
-						float r2 = dot(diff, diff); // distance squared
+					float3 diff = positionA - positionMassB.xyz;
+					float r2 = dot(diff, diff); // distance squared
 
-						if (r2 < h2)
-						{
-							float W = xSPH_poly6_constant * pow(h2 - r2, 3); // poly6 smoothing kernel
+					if (r2 < h2)
+					{
+						float W = xSPH_poly6_constant * pow(h2 - r2, 3); // poly6 smoothing kernel
 
-							density += particleB.mass * W;
-						}
+						density += positionMassB.w * W;
 					}
-
-					neighborIterator++;
 				}
 			}
 		}
@@ -159,7 +153,7 @@ void main( uint3 DTid : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex, ui
 		density = max(p0, density);
 
 		// Store the results:
-		densityBuffer[particleIndexA] = density;
+		densityBuffer[DTid.x] = density;
 	}
 
 
@@ -5,9 +5,10 @@
 
 STRUCTUREDBUFFER(aliveBuffer_CURRENT, uint, 0);
 RAWBUFFER(counterBuffer, 1);
-STRUCTUREDBUFFER(densityBuffer, float, 2);
-STRUCTUREDBUFFER(cellIndexBuffer, float, 3);
-STRUCTUREDBUFFER(cellOffsetBuffer, uint, 4);
+STRUCTUREDBUFFER(densityBuffer, float, 2); // in the order of the alive list
+STRUCTUREDBUFFER(cellRangeBuffer, uint2, 3);
+STRUCTUREDBUFFER(sortedPositionBuffer, float4, 4); // position, mass
+STRUCTUREDBUFFER(sortedVelocityBuffer, float4, 5);
 
 RWSTRUCTUREDBUFFER(particleBuffer, Particle, 0);
 
@@ -40,7 +41,7 @@ void main( uint3 DTid : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex, ui
 	{
 		particleIndexA = aliveBuffer_CURRENT[DTid.x];
 		particleA = particleBuffer[particleIndexA];
-		densityA = densityBuffer[particleIndexA];
+		densityA = densityBuffer[DTid.x];
 		pressureA = K * (densityA - p0);
 	}
 	else
@@ -64,65 +65,58 @@ void main( uint3 DTid : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex, ui
 	const float3 remappedPos = particleA.position  * xSPH_h_rcp;
 	const int3 cellIndex = floor(remappedPos);
 
-	// iterate through all [27] neighbor cells:
+	// iterate through the [9] neighbor rows of [3] cells:
 	[loop]
-	for (int i = -1; i <= 1; ++i)
+	for (int j = -1; j <= 1; ++j)
 	{
 		[loop]
-		for (int j = -1; j <= 1; ++j)
+		for (int k = -1; k <= 1; ++k)
 		{
+			// the cells of a row are consecutive buckets, their particles are one range unless the buckets wrap around:
+			const uint firstBucket = SPH_GridHash(cellIndex + int3(-1, j, k));
+			const uint split = min(3u, SPH_PARTITION_BUCKET_COUNT - firstBucket);
+
 			[loop]
-			for (int k = -1; k <= 1; ++k)
+			for (uint segment = 0; segment < 2; ++segment)
 			{
-				// hashed cell index is retrieved:
-				const int3 neighborIndex = cellIndex + int3(i, j, k);
-				const uint flatNeighborIndex = SPH_GridHash(neighborIndex);
-
-				// look up the offset into particle list from neighbor cell:
-				uint neighborIterator = cellOffsetBuffer[flatNeighborIndex];
+				uint2 range = uint2(SPH_PARTITION_EMPTY_FIRST, 0);
+				for (uint b = (segment == 0 ? 0 : split); b < (segment == 0 ? split : 3); ++b)
+				{
+					const uint2 bucketRange = cellRangeBuffer[(firstBucket + b) & (SPH_PARTITION_BUCKET_COUNT - 1)];
+					range.x = min(range.x, bucketRange.x);
+					range.y = max(range.y, bucketRange.y);
+				}
 
-				// iterate through neighbor cell particles (if iterator offset is valid):
+				// SPH Force evaluation:
 				[loop]
-				while (neighborIterator != 0xFFFFFFFF && neighborIterator < aliveCount)
+				for (uint neighborIterator = range.x; neighborIterator < range.y; ++neighborIterator)
 				{
-					if (neighborIterator != DTid.x)
+					if (neighborIterator == DTid.x)
+						continue;
+
+					const float4 positionMassB = sortedPositionBuffer[neighborIterator];
+
+					const float3 diff = particleA.position - positionMassB.xyz;
+					const float r2 = dot(diff, diff); // distance squared
+					const float r = sqrt(r2);
+
+					if (r > 0 && r < h) // avoid division by zero!
 					{
-						uint particleIndexB = aliveBuffer_CURRENT[neighborIterator];
-						if ((uint)cellIndexBuffer[particleIndexB] != flatNeighborIndex)
-						{
-							// here means we stepped out of the neighbor cell list!
-							break;
-						}
-
-						// SPH Force evaluation:
-						{
-							const float3 positionB = particleBuffer[particleIndexB].position.xyz;
-
-							const float3 diff = particleA.position - positionB;
-							const float r2 = dot(diff, diff); // distance squared
-							const float r = sqrt(r2);
-
-							if (r > 0 && r < h) // avoid division by zero!
-							{
-								const float3 velocityB = particleBuffer[particleIndexB].velocity.xyz;
-								const float densityB = densityBuffer[particleIndexB];
-								const float pressureB = K * (densityB - p0);
-
-								const float3 rNorm = diff / r;
-								float W = xSPH_spiky_constant * pow(h - r, 2); // spiky kernel smoothing function
-
-								const float mass = particleBuffer[particleIndexB].mass / particleA.mass;
-
-								f_a += mass * ((pressureA + pressureB) / (2 * densityA * densityB)) * W * rNorm;
-
-								float r3 = r2 * r;
-								W = -(r3 / (2 * h3)) + (r2 / h2) + (h / (2 * r)) - 1; // laplacian smoothing function
-								f_av += mass * (1.0f / densityB) * (velocityB - particleA.velocity) * W * rNorm;
-							}
-						}
-					}
+						const float3 velocityB = sortedVelocityBuffer[neighborIterator].xyz;
+						const float densityB = densityBuffer[neighborIterator];
+						const float pressureB = K * (densityB - p0);
+
+						const float3 rNorm = diff / r;
+						float W = xSPH_spiky_constant * pow(h - r, 2); // spiky kernel smoothing function
 
-					neighborIterator++;
+						const float mass = positionMassB.w / particleA.mass;
+
+						f_a += mass * ((pressureA + pressureB) / (2 * densityA * densityB)) * W * rNorm;
+
+						float r3 = r2 * r;
+						W = -(r3 / (2 * h3)) + (r2 / h2) + (h / (2 * r)) - 1; // laplacian smoothing function
+						f_av += mass * (1.0f / densityB) * (velocityB - particleA.velocity) * W * rNorm;
+					}
 				}
 			}
 		}
@@ -142,7 +136,7 @@ void main( uint3 DTid : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex, ui
 		{
 			uint particleIndex = aliveBuffer_CURRENT[id];
 
-			float density = densityBuffer[particleIndex];
+			float density = densityBuffer[id];
 			positions_densities[groupIndex] = float4(particleBuffer[particleIndex].position, density);
 
 			float pressure = K * (density - p0);
@@ -4,8 +4,11 @@
 STRUCTUREDBUFFER(aliveBuffer_CURRENT, uint, 0);
 RAWBUFFER(counterBuffer, 1);
 STRUCTUREDBUFFER(cellIndexBuffer, float, 2);
+STRUCTUREDBUFFER(particleBuffer, Particle, 3);
 
-RWSTRUCTUREDBUFFER(cellOffsetBuffer, uint, 0);
+RWSTRUCTUREDBUFFER(cellRangeBuffer, uint2, 0);
+RWSTRUCTUREDBUFFER(sortedPositionBuffer, float4, 1); // position, mass
+RWSTRUCTUREDBUFFER(sortedVelocityBuffer, float4, 2);
 
 [numthreads(THREADCOUNT_SIMULATION, 1, 1)]
 void main(uint3 DTid : SV_DispatchThreadID)
@@ -17,6 +20,19 @@ void main(uint3 DTid : SV_DispatchThreadID)
 		uint particleIndex = aliveBuffer_CURRENT[DTid.x];
 		uint cellIndex = (uint)cellIndexBuffer[particleIndex];
 
-		InterlockedMin(cellOffsetBuffer[cellIndex], DTid.x);
+		// The first and the last particle of a bucket in the sorted list write its range, so there are no atomics:
+		if (DTid.x == 0 || (uint)cellIndexBuffer[aliveBuffer_CURRENT[DTid.x - 1]] != cellIndex)
+		{
+			cellRangeBuffer[cellIndex].x = DTid.x;
+		}
+		if (DTid.x == aliveCount - 1 || (uint)cellIndexBuffer[aliveBuffer_CURRENT[DTid.x + 1]] != cellIndex)
+		{
+			cellRangeBuffer[cellIndex].y = DTid.x + 1;
+		}
+
+		// The neighbor loops read the particles in the sorted order, where the particles of a bucket are next to each other in memory:
+		Particle particle = particleBuffer[particleIndex];
+		sortedPositionBuffer[DTid.x] = float4(particle.position, particle.mass);
+		sortedVelocityBuffer[DTid.x] = float4(particle.velocity, 0);
 	}
 }
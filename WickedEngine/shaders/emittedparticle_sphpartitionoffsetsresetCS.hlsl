@@ -1,10 +1,10 @@
 #include "globals.hlsli"
 #include "ShaderInterop_EmittedParticle.h"
 
-RWSTRUCTUREDBUFFER(cellOffsetBuffer, uint, 0);
+RWSTRUCTUREDBUFFER(cellRangeBuffer, uint2, 0);
 
 [numthreads(THREADCOUNT_SIMULATION, 1, 1)]
 void main(uint3 DTid : SV_DispatchThreadID)
 {
-	cellOffsetBuffer[DTid.x] = 0xFFFFFFFF; // invalid offset
+	cellRangeBuffer[DTid.x] = uint2(SPH_PARTITION_EMPTY_FIRST, 0); // empty range
 }
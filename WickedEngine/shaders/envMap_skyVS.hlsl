@@ -7,8 +7,8 @@ PixelInput main(uint vid : SV_VERTEXID, uint instanceID : SV_INSTANCEID)
 {
 	PixelInput output;
 
-	output.RTIndex = instanceID;
-	output.pos = mul(xCubemapRenderCams[output.RTIndex].VP, float4(ICOSPHERE[vid].xyz,0));
+	output.RTIndex = xCubemapRenderCams[instanceID].properties.x;
+	output.pos = mul(xCubemapRenderCams[instanceID].VP, float4(ICOSPHERE[vid].xyz,0));
 	output.nor = ICOSPHERE[vid].xyz;
 
 	return output;
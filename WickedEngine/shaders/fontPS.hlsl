@@ -18,5 +18,15 @@ struct VertextoPixel
 
 float4 main(VertextoPixel PSIn) : SV_TARGET
 {
-	return texture_font.SampleLevel(sampler_font, PSIn.tex, 0).rrrr * g_xFont_Color;
+	float value = texture_font.SampleLevel(sampler_font, PSIn.tex, 0);
+
+	[branch]
+	if (g_xFont_SDF)
+	{
+		// The edge of the glyph is where the distance is zero, it is antialiased over one screen pixel at any scale:
+		const float edge = 128.0 / 255.0;
+		value = saturate((value - edge) / max(fwidth(value), 0.0001) + 0.5);
+	}
+
+	return value * g_xFont_Color;
 }
@@ -203,6 +203,20 @@ inline uint flatten3D(uint3 coord, uint3 dim)
 {
 	return (coord.z * dim.x * dim.y) + (coord.y * dim.x) + coord.x;
 }
+// Returns the address of the first entity culling bucket of a tile, P is the world position of the shaded point
+//	With clustered culling, the tiles are also divided into exponential depth slices (g_xFrame_EntityCullingTileCount.z)
+inline uint GetEntityCullingBucketAddress(uint2 tileIndex, float3 P)
+{
+	uint3 cluster = uint3(tileIndex, 0);
+	[branch]
+	if (g_xFrame_EntityCullingTileCount.z > 1)
+	{
+		const float depthVS = max(0.0001, mul(g_xCamera_View, float4(P, 1)).z);
+		const float slice = log(depthVS) * g_xFrame_EntityCullingClusterScaleBias.x + g_xFrame_EntityCullingClusterScaleBias.y;
+		cluster.z = (uint)clamp(slice, 0, g_xFrame_EntityCullingTileCount.z - 1);
+	}
+	return flatten3D(cluster, g_xFrame_EntityCullingTileCount) * SHADER_ENTITY_TILE_BUCKET_COUNT;
+}
 // flattened array index to 3D array index
 inline uint3 unflatten3D(uint idx, uint3 dim)
 {
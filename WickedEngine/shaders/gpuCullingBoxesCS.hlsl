@@ -0,0 +1,37 @@
+#include "gpuCullingHF.hlsli"
+
+// Occlusion test of one box per thread, the input layout is described next to GPUCULLING_BOXES_HEADER_SIZE
+
+RAWBUFFER(input, GPUCULLINGSLOT_IN_INPUT);
+
+RWRAWBUFFER(visibility, 0);
+
+[numthreads(GPUCULLING_THREADCOUNT, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	const uint4 header = input.Load4(0);
+	if (DTid.x >= header.x)
+	{
+		return;
+	}
+
+	const uint address = GPUCULLING_BOXES_HEADER_SIZE + DTid.x * GPUCULLING_CANDIDATE_STRIDE;
+	const uint4 candidate_min = input.Load4(address);
+	const float3 aabb_min = asfloat(candidate_min.xyz);
+	const float3 aabb_max = asfloat(input.Load3(address + 16));
+
+	bool visible = true;
+	if (header.y != 0)
+	{
+		// The matrix is stored by rows, like the camera matrices on the CPU:
+		const float4x4 VP = transpose(float4x4(
+			asfloat(input.Load4(16)),
+			asfloat(input.Load4(32)),
+			asfloat(input.Load4(48)),
+			asfloat(input.Load4(64))
+		));
+		const float2 zNearFar = asfloat(input.Load2(80));
+		visible = !IsOccluded(aabb_min, aabb_max, VP, zNearFar.x, zNearFar.y);
+	}
+	visibility.Store(candidate_min.w * 4, visible ? 1 : 0);
+}
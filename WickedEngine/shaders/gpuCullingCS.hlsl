@@ -0,0 +1,51 @@
+#include "gpuCullingHF.hlsli"
+
+// Culls the candidate instances of one batch per thread group, the visible references are compacted to the start of the batch range
+//	The input layout is described next to GPUCULLING_BATCH_STRIDE
+
+RAWBUFFER(input, GPUCULLINGSLOT_IN_INPUT);
+
+RWRAWBUFFER(args, 0);
+RWRAWBUFFER(references, 1);
+
+groupshared uint visibleCount;
+
+[numthreads(GPUCULLING_THREADCOUNT, 1, 1)]
+void main(uint3 Gid : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+	const uint4 header = input.Load4(0);
+	const uint4 batch = input.Load4(16 + Gid.x * GPUCULLING_BATCH_STRIDE); // first reference, candidate count, index count, index offset
+	if (batch.z == 0)
+	{
+		// The batch is culled per cluster by meshletCullingCS
+		return;
+	}
+
+	if (groupIndex == 0)
+	{
+		visibleCount = 0;
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	for (uint i = groupIndex; i < batch.y; i += GPUCULLING_THREADCOUNT)
+	{
+		const uint address = header.y + (batch.x + i) * GPUCULLING_CANDIDATE_STRIDE;
+		const uint4 candidate_min = input.Load4(address);
+		const uint4 candidate_max = input.Load4(address + 16);
+		if (IsVisible(asfloat(candidate_min.xyz), asfloat(candidate_max.xyz), header.z != 0))
+		{
+			uint index;
+			InterlockedAdd(visibleCount, 1, index);
+			references.Store2((batch.x + index) * INSTANCETABLE_REFERENCE_STRIDE, uint2(candidate_min.w, candidate_max.w));
+		}
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	if (groupIndex == 0)
+	{
+		// IndirectDrawArgsIndexedInstanced:
+		const uint address = Gid.x * GPUCULLING_ARGS_STRIDE;
+		args.Store4(address, uint4(batch.z, visibleCount, batch.w, 0));
+		args.Store(address + 16, 0);
+	}
+}
@@ -0,0 +1,102 @@
+#ifndef WI_GPUCULLING_HF
+#define WI_GPUCULLING_HF
+#include "globals.hlsli"
+#include "ShaderInterop_Renderer.h"
+
+// Shared visibility test of the GPU culling shaders, the hiz texture is the conservative farthest depth chain of GPUCulling_Prepare()
+//	The shaders that use other resources on GPUCULLINGSLOT_IN_HIZ can define GPUCULLING_HIZ_SLOT before including it
+
+#ifndef GPUCULLING_HIZ_SLOT
+#define GPUCULLING_HIZ_SLOT GPUCULLINGSLOT_IN_HIZ
+#endif // GPUCULLING_HIZ_SLOT
+
+TEXTURE2D(hiz, float, GPUCULLING_HIZ_SLOT);
+
+bool IsInFrustum(float3 aabb_min, float3 aabb_max)
+{
+	// Frustum: the box is outside when its corner that is farthest along the plane normal is behind the plane
+	for (uint p = 0; p < 6; ++p)
+	{
+		const float4 plane = g_xCamera_FrustumPlanes[p];
+		const float3 corner = float3(
+			plane.x < 0 ? aabb_min.x : aabb_max.x,
+			plane.y < 0 ? aabb_min.y : aabb_max.y,
+			plane.z < 0 ? aabb_min.z : aabb_max.z
+		);
+		if (dot(plane.xyz, corner) + plane.w < 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Occlusion: the nearest depth of the box is compared with the farthest depth of the Hi-Z texels covering its screen rectangle
+//	VP, zNear and zFar are of the camera that rendered the depth of the Hi-Z
+bool IsOccluded(float3 aabb_min, float3 aabb_max, float4x4 VP, float zNear, float zFar)
+{
+	float2 uv_min = 1;
+	float2 uv_max = 0;
+	float nearest = zFar;
+	for (uint i = 0; i < 8; ++i)
+	{
+		const float3 corner = float3(
+			i & 1 ? aabb_max.x : aabb_min.x,
+			i & 2 ? aabb_max.y : aabb_min.y,
+			i & 4 ? aabb_max.z : aabb_min.z
+		);
+		const float4 clip = mul(VP, float4(corner, 1));
+		if (clip.w <= zNear)
+		{
+			// The box reaches the camera, keep it
+			return false;
+		}
+		const float2 uv = clip.xy / clip.w * float2(0.5, -0.5) + 0.5;
+		uv_min = min(uv_min, uv);
+		uv_max = max(uv_max, uv);
+		nearest = min(nearest, clip.w);
+	}
+	nearest /= zFar;
+
+	uint2 dim;
+	uint mips;
+	hiz.GetDimensions(0, dim.x, dim.y, mips);
+
+	// One extra texel of margin for the temporal jitter and the rounding of the Hi-Z size:
+	uv_min = saturate(uv_min - 1.0 / dim);
+	uv_max = saturate(uv_max + 1.0 / dim);
+	const uint2 lo0 = min(uint2(uv_min * dim), dim - 1);
+	const uint2 hi0 = min(uint2(uv_max * dim), dim - 1);
+
+	// A texel of mip N covers the texels [x << N, (x + 1) << N) of the top mip, the first mip where the rectangle spans at most 2x2 texels is used:
+	uint mip = 0;
+	while (mip < mips - 1 && ((hi0.x >> mip) - (lo0.x >> mip) > 1 || (hi0.y >> mip) - (lo0.y >> mip) > 1))
+	{
+		mip++;
+	}
+	hiz.GetDimensions(mip, dim.x, dim.y, mips);
+	const uint2 lo = min(lo0 >> mip, dim - 1);
+	const uint2 hi = min(hi0 >> mip, dim - 1);
+	if (hi.x - lo.x > 1 || hi.y - lo.y > 1)
+	{
+		// Only when the smallest mip is still too detailed
+		return false;
+	}
+
+	const float farthest = max(
+		max(hiz.Load(uint3(lo.x, lo.y, mip)), hiz.Load(uint3(hi.x, lo.y, mip))),
+		max(hiz.Load(uint3(lo.x, hi.y, mip)), hiz.Load(uint3(hi.x, hi.y, mip)))
+	);
+	return nearest > farthest;
+}
+
+bool IsVisible(float3 aabb_min, float3 aabb_max, bool occlusion)
+{
+	if (!IsInFrustum(aabb_min, aabb_max))
+	{
+		return false;
+	}
+	return !occlusion || !IsOccluded(aabb_min, aabb_max, g_xCamera_VP, g_xCamera_ZNearP, g_xCamera_ZFarP);
+}
+
+#endif // WI_GPUCULLING_HF
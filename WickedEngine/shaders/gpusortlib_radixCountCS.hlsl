@@ -0,0 +1,33 @@
+#define RADIX_SCAN_SIZE GPUSORTLIB_RADIX_THREADS
+#include "radixSortHF.hlsli"
+
+STRUCTUREDBUFFER(comparisonBuffer, float, 1);
+STRUCTUREDBUFFER(keyBuffer, uint, 2);
+STRUCTUREDBUFFER(valueBuffer, uint, 3);
+
+RWSTRUCTUREDBUFFER(histogramBuffer, uint, 0);
+
+groupshared uint histogram[GPUSORTLIB_RADIX_BINS];
+
+// Counts the digits of a block, the histograms are stored digit by digit, so that scanning them gives the output offsets of every block
+[numthreads(GPUSORTLIB_RADIX_THREADS, 1, 1)]
+void main(uint3 Gid : SV_GroupID, uint GI : SV_GroupIndex)
+{
+	histogram[GI] = 0;
+	GroupMemoryBarrierWithGroupSync();
+
+	const uint count = GetRadixSortCount();
+	const uint blockStart = Gid.x * GPUSORTLIB_RADIX_BLOCK_SIZE;
+	for (uint i = 0; i < GPUSORTLIB_RADIX_BLOCK_SIZE; i += GPUSORTLIB_RADIX_THREADS)
+	{
+		const uint index = blockStart + i + GI;
+		if (index < count)
+		{
+			const uint key = radix_shift == 0 ? FloatToSortableKey(asuint(comparisonBuffer[valueBuffer[index]])) : keyBuffer[index];
+			InterlockedAdd(histogram[(key >> radix_shift) & (GPUSORTLIB_RADIX_BINS - 1)], 1);
+		}
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	histogramBuffer[GI * GetRadixSortBlockCount(count) + Gid.x] = histogram[GI];
+}
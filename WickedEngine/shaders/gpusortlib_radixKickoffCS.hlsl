@@ -0,0 +1,11 @@
+#define RADIX_SCAN_SIZE 1
+#include "radixSortHF.hlsli"
+
+RWRAWBUFFER(indirectBuffers, 0);
+
+[numthreads(1, 1, 1)]
+void main( uint3 DTid : SV_DispatchThreadID )
+{
+	// The count and scatter passes have a group for every block:
+	indirectBuffers.Store3(0, uint3(GetRadixSortBlockCount(GetRadixSortCount()), 1, 1));
+}
@@ -0,0 +1,32 @@
+#define RADIX_SCAN_SIZE GPUSORTLIB_RADIX_SCAN_THREADS
+#include "radixSortHF.hlsli"
+
+RWSTRUCTUREDBUFFER(histogramBuffer, uint, 0);
+
+// Exclusive prefix sum of the histograms of every block, with one group
+//	Every thread sums a contiguous range, then the ranges are offset by the scanned range sums
+[numthreads(GPUSORTLIB_RADIX_SCAN_THREADS, 1, 1)]
+void main(uint GI : SV_GroupIndex)
+{
+	const uint total = GetRadixSortBlockCount(GetRadixSortCount()) * GPUSORTLIB_RADIX_BINS;
+	const uint rangeSize = (total + GPUSORTLIB_RADIX_SCAN_THREADS - 1) / GPUSORTLIB_RADIX_SCAN_THREADS;
+	const uint rangeStart = min(GI * rangeSize, total);
+	const uint rangeEnd = min(rangeStart + rangeSize, total);
+
+	uint sum = 0;
+	uint i;
+	for (i = rangeStart; i < rangeEnd; ++i)
+	{
+		sum += histogramBuffer[i];
+	}
+
+	uint groupTotal;
+	uint offset = GroupExclusiveScan(sum, GI, groupTotal);
+
+	for (i = rangeStart; i < rangeEnd; ++i)
+	{
+		const uint value = histogramBuffer[i];
+		histogramBuffer[i] = offset;
+		offset += value;
+	}
+}
@@ -0,0 +1,84 @@
+#define RADIX_SCAN_SIZE GPUSORTLIB_RADIX_THREADS
+#include "radixSortHF.hlsli"
+
+STRUCTUREDBUFFER(comparisonBuffer, float, 1);
+STRUCTUREDBUFFER(keyBuffer, uint, 2);
+STRUCTUREDBUFFER(valueBuffer, uint, 3);
+STRUCTUREDBUFFER(histogramBuffer, uint, 4);
+
+RWSTRUCTUREDBUFFER(keyBuffer_output, uint, 0);
+RWSTRUCTUREDBUFFER(valueBuffer_output, uint, 1);
+
+groupshared uint digitOffset[GPUSORTLIB_RADIX_BINS]; // output position of the next element of every digit in this block
+groupshared uint digitStart[GPUSORTLIB_RADIX_BINS];
+groupshared uint sorted_keys[GPUSORTLIB_RADIX_THREADS];
+groupshared uint sorted_values[GPUSORTLIB_RADIX_THREADS];
+groupshared uint sorted_digits[GPUSORTLIB_RADIX_THREADS];
+
+// Writes the elements of a block to their sorted positions, in their original order within the same digit, so that the sort is stable
+//	The block is processed in chunks of a thread per element, the chunks are sorted locally with one bit split at a time
+[numthreads(GPUSORTLIB_RADIX_THREADS, 1, 1)]
+void main(uint3 Gid : SV_GroupID, uint GI : SV_GroupIndex)
+{
+	const uint count = GetRadixSortCount();
+	digitOffset[GI] = histogramBuffer[GI * GetRadixSortBlockCount(count) + Gid.x];
+	GroupMemoryBarrierWithGroupSync();
+
+	const uint blockStart = Gid.x * GPUSORTLIB_RADIX_BLOCK_SIZE;
+	for (uint chunk = 0; chunk < GPUSORTLIB_RADIX_BLOCK_SIZE; chunk += GPUSORTLIB_RADIX_THREADS)
+	{
+		const uint index = blockStart + chunk + GI;
+		const bool valid = index < count;
+
+		uint value = valid ? valueBuffer[index] : 0;
+		uint key = 0;
+		if (valid)
+		{
+			key = radix_shift == 0 ? FloatToSortableKey(asuint(comparisonBuffer[value])) : keyBuffer[index];
+		}
+		// The elements past the end have an extra digit, so they are sorted after the others:
+		uint digit = valid ? ((key >> radix_shift) & (GPUSORTLIB_RADIX_BINS - 1)) : GPUSORTLIB_RADIX_BINS;
+
+		for (uint bit = 0; bit <= GPUSORTLIB_RADIX_BITS; ++bit)
+		{
+			const uint b = (digit >> bit) & 1;
+			uint ones;
+			const uint onesBefore = GroupExclusiveScan(b, GI, ones);
+			const uint position = b ? (GPUSORTLIB_RADIX_THREADS - ones + onesBefore) : (GI - onesBefore);
+			sorted_keys[position] = key;
+			sorted_values[position] = value;
+			sorted_digits[position] = digit;
+			GroupMemoryBarrierWithGroupSync();
+			key = sorted_keys[GI];
+			value = sorted_values[GI];
+			digit = sorted_digits[GI];
+			GroupMemoryBarrierWithGroupSync();
+		}
+
+		// The equal digits are next to each other now, the rank of an element is its distance from the first one:
+		const bool counted = digit < GPUSORTLIB_RADIX_BINS;
+		if (counted && (GI == 0 || sorted_digits[GI - 1] != digit))
+		{
+			digitStart[digit] = GI;
+		}
+		GroupMemoryBarrierWithGroupSync();
+
+		if (counted)
+		{
+			const uint destination = digitOffset[digit] + GI - digitStart[digit];
+			if (radix_shift + GPUSORTLIB_RADIX_BITS < 32)
+			{
+				keyBuffer_output[destination] = key;
+			}
+			valueBuffer_output[destination] = value;
+		}
+		GroupMemoryBarrierWithGroupSync();
+
+		// The last element of every digit advances the offset of the digit for the next chunk:
+		if (counted && (GI == GPUSORTLIB_RADIX_THREADS - 1 || sorted_digits[GI + 1] != digit))
+		{
+			digitOffset[digit] += GI - digitStart[digit] + 1;
+		}
+		GroupMemoryBarrierWithGroupSync();
+	}
+}
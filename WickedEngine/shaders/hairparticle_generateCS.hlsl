@@ -0,0 +1,75 @@
+#include "globals.hlsli"
+#include "ShaderInterop_HairParticle.h"
+
+// Generates the rest pose of every strand in object space, it only needs to run again when the base mesh or the hair parameters change
+
+RWSTRUCTUREDBUFFER(strandBuffer, Patch, 0);
+
+TYPEDBUFFER(meshIndexBuffer, uint, TEXSLOT_ONDEMAND0);
+RAWBUFFER(meshVertexBuffer_POS, TEXSLOT_ONDEMAND1);
+TYPEDBUFFER(meshVertexBuffer_length, float, TEXSLOT_ONDEMAND2);
+
+[numthreads(THREADCOUNT_SIMULATEHAIR, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	if (DTid.x >= xHairStrandCount)
+		return;
+
+	// random triangle on emitter surface:
+	//	(Note that the usual rand() function is not used because that introduces unnatural clustering with high triangle count)
+	uint tri = (uint)((xHairBaseMeshIndexCount / 3) * hash1(DTid.x));
+
+	// load indices of triangle from index buffer
+	uint i0 = meshIndexBuffer[tri * 3 + 0];
+	uint i1 = meshIndexBuffer[tri * 3 + 1];
+	uint i2 = meshIndexBuffer[tri * 3 + 2];
+
+	// load vertices of triangle from vertex buffer:
+	float4 pos_nor0 = asfloat(meshVertexBuffer_POS.Load4(i0 * xHairBaseMeshVertexPositionStride));
+	float4 pos_nor1 = asfloat(meshVertexBuffer_POS.Load4(i1 * xHairBaseMeshVertexPositionStride));
+	float4 pos_nor2 = asfloat(meshVertexBuffer_POS.Load4(i2 * xHairBaseMeshVertexPositionStride));
+	float3 nor0 = unpack_unitvector(asuint(pos_nor0.w));
+	float3 nor1 = unpack_unitvector(asuint(pos_nor1.w));
+	float3 nor2 = unpack_unitvector(asuint(pos_nor2.w));
+	float length0 = meshVertexBuffer_length[i0];
+	float length1 = meshVertexBuffer_length[i1];
+	float length2 = meshVertexBuffer_length[i2];
+
+	// random barycentric coords:
+	float2 uv = hammersley2d(DTid.x, xHairNumDispatchGroups * THREADCOUNT_SIMULATEHAIR);
+	float seed = xHairRandomSeed;
+	float f = rand(seed, uv);
+	float g = rand(seed, uv);
+	[flatten]
+	if (f + g > 1)
+	{
+		f = 1 - f;
+		g = 1 - g;
+	}
+
+	// compute final surface position on triangle from barycentric coords:
+	float3 position = pos_nor0.xyz + f * (pos_nor1.xyz - pos_nor0.xyz) + g * (pos_nor2.xyz - pos_nor0.xyz);
+	float3 target = normalize(nor0 + f * (nor1 - nor0) + g * (nor2 - nor0));
+	float3 tangent = normalize(mul(float3(hemispherepoint_cos(rand(seed, uv), rand(seed, uv)).xy, 0), GetTangentSpace(target)));
+	float3 binormal = cross(target, tangent);
+	float strand_length = length0 + f * (length1 - length0) + g * (length2 - length0);
+
+	uint tangent_random = 0;
+	tangent_random |= (uint)((uint)(tangent.x * 127.5f + 127.5f) << 0);
+	tangent_random |= (uint)((uint)(tangent.y * 127.5f + 127.5f) << 8);
+	tangent_random |= (uint)((uint)(tangent.z * 127.5f + 127.5f) << 16);
+	tangent_random |= (uint)(rand(seed, uv) * 255) << 24;
+
+	uint binormal_length = 0;
+	binormal_length |= (uint)((uint)(binormal.x * 127.5f + 127.5f) << 0);
+	binormal_length |= (uint)((uint)(binormal.y * 127.5f + 127.5f) << 8);
+	binormal_length |= (uint)((uint)(binormal.z * 127.5f + 127.5f) << 16);
+	binormal_length |= (uint)(lerp(1, rand(seed, uv), saturate(xHairRandomness)) * strand_length * 255) << 24;
+
+	Patch strand;
+	strand.position = position;
+	strand.tangent_random = tangent_random;
+	strand.normal = target;
+	strand.binormal_length = binormal_length;
+	strandBuffer[DTid.x] = strand;
+}
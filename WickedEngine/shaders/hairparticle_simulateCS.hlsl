@@ -6,76 +6,57 @@ RWSTRUCTUREDBUFFER(simulationBuffer, PatchSimulationData, 1);
 RWSTRUCTUREDBUFFER(indexBuffer, uint, 2);
 RWRAWBUFFER(counterBuffer, 3);
 
-TYPEDBUFFER(meshIndexBuffer, uint, TEXSLOT_ONDEMAND0);
-RAWBUFFER(meshVertexBuffer_POS, TEXSLOT_ONDEMAND1);
-TYPEDBUFFER(meshVertexBuffer_length, float, TEXSLOT_ONDEMAND2);
+// The Hi-Z of the GPU culling is bound after the strand buffer:
+#define GPUCULLING_HIZ_SLOT TEXSLOT_ONDEMAND1
+#include "gpuCullingHF.hlsli"
 
+STRUCTUREDBUFFER(strandBuffer, Patch, TEXSLOT_ONDEMAND0);
+
+// One thread simulates every segment of a strand, the whole strand is culled first, then its segments
 [numthreads(THREADCOUNT_SIMULATEHAIR, 1, 1)]
 void main(uint3 DTid : SV_DispatchThreadID, uint3 Gid : SV_GroupID, uint groupIndex : SV_GroupIndex)
 {
-	if (DTid.x >= xHairParticleCount)
+	if (DTid.x >= xHairStrandCount)
 		return;
 
-	// Generate patch:
-
-	// random triangle on emitter surface:
-	//	(Note that the usual rand() function is not used because that introduces unnatural clustering with high triangle count)
-	uint tri = (uint)((xHairBaseMeshIndexCount / 3) * hash1(DTid.x));
-
-	// load indices of triangle from index buffer
-	uint i0 = meshIndexBuffer[tri * 3 + 0];
-	uint i1 = meshIndexBuffer[tri * 3 + 1];
-	uint i2 = meshIndexBuffer[tri * 3 + 2];
-
-	// load vertices of triangle from vertex buffer:
-	float4 pos_nor0 = asfloat(meshVertexBuffer_POS.Load4(i0 * xHairBaseMeshVertexPositionStride));
-	float4 pos_nor1 = asfloat(meshVertexBuffer_POS.Load4(i1 * xHairBaseMeshVertexPositionStride));
-	float4 pos_nor2 = asfloat(meshVertexBuffer_POS.Load4(i2 * xHairBaseMeshVertexPositionStride));
-    float3 nor0 = unpack_unitvector(asuint(pos_nor0.w));
-    float3 nor1 = unpack_unitvector(asuint(pos_nor1.w));
-    float3 nor2 = unpack_unitvector(asuint(pos_nor2.w));
-	float length0 = meshVertexBuffer_length[i0];
-	float length1 = meshVertexBuffer_length[i1];
-	float length2 = meshVertexBuffer_length[i2];
-
-	// random barycentric coords:
-	float2 uv = hammersley2d(DTid.x, xHairNumDispatchGroups * THREADCOUNT_SIMULATEHAIR);
-	float seed = xHairRandomSeed;
-	float f = rand(seed, uv);
-	float g = rand(seed, uv);
-	[flatten]
-	if (f + g > 1)
+	// The rest pose of the strand in object space, from hairparticle_generateCS:
+	const Patch strand = strandBuffer[DTid.x];
+	const uint tangent_random = strand.tangent_random;
+	uint binormal_length = strand.binormal_length;
+
+	// Transform particle by the emitter object matrix:
+	float3 base = mul(xWorld, float4(strand.position, 1)).xyz;
+	float3 target = normalize(mul((float3x3)xWorld, strand.normal));
+	const float3 root = base;
+
+	// Distance culling, and the density falls off with distance: the strands are removed in random order, they shrink before they disappear
+	const float dist = distance(root, g_xCamera_CamPos.xyz);
+	if (dist >= xHairViewDistance)
+		return;
+	const float density = 1 - saturate((dist / xHairViewDistance - xHairDensityFalloff) / max(0.001f, 1 - xHairDensityFalloff));
+	[branch]
+	if (density < 1)
 	{
-		f = 1 - f;
-		g = 1 - g;
+		const float threshold = hash1(DTid.x + xHairParticleCount);
+		if (threshold >= density)
+			return;
+		const uint len = (uint)(((binormal_length >> 24) & 0x000000FF) * saturate((density - threshold) * 8));
+		binormal_length = (binormal_length & 0x00FFFFFF) | (len << 24);
 	}
 
-	// compute final surface position on triangle from barycentric coords:
-	float3 position = pos_nor0.xyz + f * (pos_nor1.xyz - pos_nor0.xyz) + g * (pos_nor2.xyz - pos_nor0.xyz);
-	float3 target = normalize(nor0 + f * (nor1 - nor0) + g * (nor2 - nor0));
-	float3 tangent = normalize(mul(float3(hemispherepoint_cos(rand(seed, uv), rand(seed, uv)).xy, 0), GetTangentSpace(target)));
-	float3 binormal = cross(target, tangent);
-	float strand_length = length0 + f * (length1 - length0) + g * (length2 - length0);
-
-	uint tangent_random = 0;
-	tangent_random |= (uint)((uint)(tangent.x * 127.5f + 127.5f) << 0);
-	tangent_random |= (uint)((uint)(tangent.y * 127.5f + 127.5f) << 8);
-	tangent_random |= (uint)((uint)(tangent.z * 127.5f + 127.5f) << 16);
-	tangent_random |= (uint)(rand(seed, uv) * 255) << 24;
-
-	uint binormal_length = 0;
-	binormal_length |= (uint)((uint)(binormal.x * 127.5f + 127.5f) << 0);
-	binormal_length |= (uint)((uint)(binormal.y * 127.5f + 127.5f) << 8);
-	binormal_length |= (uint)((uint)(binormal.z * 127.5f + 127.5f) << 16);
-	binormal_length |= (uint)(lerp(1, rand(seed, uv), saturate(xHairRandomness)) * strand_length * 255) << 24;
+	// Frustum and occlusion culling of the strand, it can bend around its root up to its length:
+	const float strand_length = ((binormal_length >> 24) & 0x000000FF) / 255.0f * xLength * xHairSegmentCount;
+	if (!IsInFrustum(root - strand_length, root + strand_length))
+		return;
+	[branch]
+	if (xHairOcclusion && IsOccluded(root - strand_length, root + strand_length, xHairOcclusionVP, xHairOcclusionZNear, xHairOcclusionZFar))
+		return;
 
 	// Identifies the hair strand root particle:
-    const uint strandID = DTid.x * xHairSegmentCount;
-    
-	// Transform particle by the emitter object matrix:
-    float3 base = mul(xWorld, float4(position.xyz, 1)).xyz;
-    target = normalize(mul((float3x3)xWorld, target));
-	const float3 root = base;
+	const uint strandID = DTid.x * xHairSegmentCount;
+
+	// The simulation state is stale if the strand was culled in the last frame, then it starts from the rest pose:
+	const bool reset = xHairRegenerate || simulationBuffer[strandID].frame + 1 < g_xFrame_FrameCount;
 
 	float3 normal = 0;
     
@@ -86,7 +67,7 @@ void main(uint3 DTid : SV_DispatchThreadID, uint3 Gid : SV_GroupID, uint groupIn
 		particleBuffer[particleID].tangent_random = tangent_random;
 		particleBuffer[particleID].binormal_length = binormal_length;
 
-		if (xHairRegenerate)
+		if (reset)
 		{
 			particleBuffer[particleID].position = base;
 			particleBuffer[particleID].normal = target;
@@ -157,6 +138,7 @@ void main(uint3 DTid : SV_DispatchThreadID, uint3 Gid : SV_GroupID, uint groupIn
 
 		// Store simulation data:
 		simulationBuffer[particleID].velocity = velocity;
+		simulationBuffer[particleID].frame = g_xFrame_FrameCount;
 
 		// Offset next segment root to current tip:
         base = tip;
@@ -164,7 +146,6 @@ void main(uint3 DTid : SV_DispatchThreadID, uint3 Gid : SV_GroupID, uint groupIn
 
 		// Frustum culling:
 		uint infrustum = 1;
-		infrustum &= distance(base, g_xCamera_CamPos.xyz) < xHairViewDistance;
 		infrustum &= dot(g_xCamera_FrustumPlanes[0], float4(base, 1)) > -len;
 		infrustum &= dot(g_xCamera_FrustumPlanes[2], float4(base, 1)) > -len;
 		infrustum &= dot(g_xCamera_FrustumPlanes[3], float4(base, 1)) > -len;
@@ -23,6 +23,38 @@ float Wedge2D(float2 v, float2 w)
 	return v.x * w.y - v.y * w.x;
 }
 
+// Quad interpolation: http://reedbeta.com/blog/quadrilateral-interpolation-part-2/
+float2 compute_quad_uv(float2 q, float2 b1, float2 b2, float2 b3)
+{
+	// Set up quadratic formula
+	float A = Wedge2D(b2, b3);
+	float B = Wedge2D(b3, q) - Wedge2D(b1, b2);
+	float C = Wedge2D(b1, q);
+
+	// Solve for v
+	float2 uv;
+	if (abs(A) < 0.001)
+	{
+		// Linear form
+		uv.y = -C / B;
+	}
+	else
+	{
+		// Quadratic form. Take positive root for CCW winding with V-up
+		float discrim = B * B - 4 * A * C;
+		uv.y = 0.5 * (-B + sqrt(discrim)) / A;
+	}
+
+	// Solve for u, using largest-magnitude component
+	float2 denom = b1 + uv.y * b3;
+	if (abs(denom.x) > abs(denom.y))
+		uv.x = (q.x - b2.x * uv.y) / denom.x;
+	else
+		uv.x = (q.y - b2.y * uv.y) / denom.y;
+
+	return uv;
+}
+
 struct VertextoPixel
 {
 	float4 pos : SV_POSITION;
@@ -34,39 +66,29 @@ struct VertextoPixel
 
 	float4 compute_uvs()
 	{
-		// Quad interpolation: http://reedbeta.com/blog/quadrilateral-interpolation-part-2/
-
-		// Set up quadratic formula
-		float A = Wedge2D(b2, b3);
-		float B = Wedge2D(b3, q) - Wedge2D(b1, b2);
-		float C = Wedge2D(b1, q);
-
-		// Solve for v
-		float2 uv;
-		if (abs(A) < 0.001)
-		{
-			// Linear form
-			uv.y = -C / B;
-		}
-		else
-		{
-			// Quadratic form. Take positive root for CCW winding with V-up
-			float discrim = B * B - 4 * A * C;
-			uv.y = 0.5 * (-B + sqrt(discrim)) / A;
-		}
-
-		// Solve for u, using largest-magnitude component
-		float2 denom = b1 + uv.y * b3;
-		if (abs(denom.x) > abs(denom.y))
-			uv.x = (q.x - b2.x * uv.y) / denom.x;
-		else
-			uv.x = (q.y - b2.y * uv.y) / denom.y;
-
+		float2 uv = compute_quad_uv(q, b1, b2, b3);
 		float2 uv0 = uv * xTexMulAdd.xy + xTexMulAdd.zw;
 		float2 uv1 = uv * xTexMulAdd2.xy + xTexMulAdd2.zw;
 		return float4(uv0, uv1);
 	}
 };
 
+struct VertextoPixelBatched
+{
+	float4 pos : SV_POSITION;
+	float2 q : TEXCOORD3;
+	float2 b1 : TEXCOORD4;
+	float2 b2 : TEXCOORD5;
+	float2 b3 : TEXCOORD6;
+	nointerpolation float4 texMulAdd : TEXCOORD0;
+	nointerpolation float4 color : TEXCOORD1;
+	nointerpolation uint texture_index : TEXCOORD2;
+
+	float2 compute_uv()
+	{
+		return compute_quad_uv(q, b1, b2, b3) * texMulAdd.xy + texMulAdd.zw;
+	}
+};
+
 #endif // WI_IMAGE_HF
 
@@ -0,0 +1,14 @@
+#include "imageHF.hlsli"
+
+float4 main(VertextoPixelBatched input) : SV_TARGET
+{
+	float2 uv = input.compute_uv();
+#ifdef BINDLESS
+	// The texture can be different for every image of the batch:
+	float4 color = bindless_textures[NonUniformResourceIndex(input.texture_index)].Sample(Sampler, uv);
+#else
+	float4 color = texture_base.Sample(Sampler, uv);
+#endif // BINDLESS
+
+	return color * input.color;
+}
@@ -0,0 +1,44 @@
+#include "globals.hlsli"
+#include "imageHF.hlsli"
+
+RAWBUFFER(instanceBuffer, 0);
+
+VertextoPixelBatched main(uint vI : SV_VERTEXID, uint instanceID : SV_InstanceID)
+{
+	VertextoPixelBatched Out;
+
+	const uint address = xInstanceOffset + instanceID * 112; // sizeof(ImageInstance)
+	const float4 corners0 = asfloat(instanceBuffer.Load4(address + 0));
+	const float4 corners1 = asfloat(instanceBuffer.Load4(address + 16));
+	const float4 corners2 = asfloat(instanceBuffer.Load4(address + 32));
+	const float4 corners3 = asfloat(instanceBuffer.Load4(address + 48));
+	Out.texMulAdd = asfloat(instanceBuffer.Load4(address + 64));
+	Out.color = asfloat(instanceBuffer.Load4(address + 80));
+	Out.texture_index = instanceBuffer.Load(address + 96);
+
+	// The same trianglestrip as imageVS for every instance:
+	switch (vI)
+	{
+	default:
+	case 0:
+		Out.pos = corners0;
+		break;
+	case 1:
+		Out.pos = corners1;
+		break;
+	case 2:
+		Out.pos = corners2;
+		break;
+	case 3:
+		Out.pos = corners3;
+		break;
+	}
+
+	// Set up inverse bilinear interpolation
+	Out.q = Out.pos.xy - corners0.xy;
+	Out.b1 = corners1.xy - corners0.xy;
+	Out.b2 = corners2.xy - corners0.xy;
+	Out.b3 = corners0.xy - corners1.xy - corners2.xy + corners3.xy;
+
+	return Out;
+}
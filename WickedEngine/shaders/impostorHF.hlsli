@@ -13,4 +13,38 @@ struct VSOut
 
 TEXTURE2DARRAY(impostorTex, float4, TEXSLOT_ONDEMAND0);
 
+// Octahedral mapping of the unit sphere (Y up) to [0, 1] uv, the views of an impostor are captured in this layout
+//	This must match the capture directions in wiRenderer::RefreshImpostors()
+inline float2 impostor_sign(float2 v)
+{
+	return float2(v.x >= 0 ? 1 : -1, v.y >= 0 ? 1 : -1);
+}
+inline float2 impostor_encode(float3 dir)
+{
+	dir /= abs(dir.x) + abs(dir.y) + abs(dir.z);
+	float2 p = dir.xz;
+	if (dir.y < 0)
+	{
+		p = (1 - abs(p.yx)) * impostor_sign(p);
+	}
+	return p * 0.5f + 0.5f;
+}
+inline float3 impostor_decode(float2 uv)
+{
+	float2 p = uv * 2 - 1;
+	float3 dir = float3(p.x, 1 - abs(p.x) - abs(p.y), p.y);
+	if (dir.y < 0)
+	{
+		dir.xz = (1 - abs(dir.zx)) * impostor_sign(dir.xz);
+	}
+	return normalize(dir);
+}
+// The up direction of the capture camera that looks at the impostor from dir
+inline float3 impostor_capture_up(float3 dir)
+{
+	const float3 up = abs(dir.y) > 0.99f ? float3(0, 0, 1) : float3(0, 1, 0);
+	const float3 right = normalize(cross(up, -dir));
+	return cross(-dir, right);
+}
+
 #endif // WI_IMPOSTOR_HF
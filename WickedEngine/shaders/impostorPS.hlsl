@@ -7,9 +7,9 @@ GBuffer main(VSOut input)
 {
 	float3 uv_col = input.tex;
 	float3 uv_nor = uv_col;
-	uv_nor.z += impostorCaptureAngles;
+	uv_nor.z += 1;
 	float3 uv_sur = uv_nor;
-	uv_sur.z += impostorCaptureAngles;
+	uv_sur.z += 1;
 
 	float4 color = impostorTex.Sample(sampler_linear_clamp, uv_col) * unpack_rgba(input.instanceColor);
 	float3 N = impostorTex.Sample(sampler_linear_clamp, uv_nor).rgb * 2 - 1;
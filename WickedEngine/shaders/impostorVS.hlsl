@@ -32,27 +32,17 @@ VSOut main(uint fakeIndex : SV_VERTEXID)
 		);
 
 	float3 pos = BILLBOARD[vertexID];
-	float3 tex = float3(pos.xy * float2(0.5f, -0.5f) + 0.5f, userdata.y);
 
-	// We rotate the billboard to face camera, but unlike emitted particles, 
-	//	they don't rotate according to camera rotation, but the camera position relative
-	//	to the impostor (at least for now)
+	// The billboard faces the camera, and shows the view that was captured from the closest direction of the octahedral grid
+	//	The direction is computed in the space of the impostor, so that rotated instances also show the correct view
 	float3 origin = mul(WORLD, float4(0, 0, 0, 1)).xyz;
-	float3 up = normalize(mul((float3x3)WORLD, float3(0, 1, 0)));
-	float3 face = mul((float3x3)WORLD, g_xCamera_CamPos - origin);
-	face.y = 0; // only rotate around Y axis!
-	face = normalize(face);
-	float3 right = normalize(cross(face, up));
-	pos = mul(pos, float3x3(right, up, face));
-
-	// Decide which slice to show according to billboard facing direction:
-	float angle = acos(dot(face.xz, float2(0, 1))) / PI;
-	if (cross(face, float3(0, 0, 1)).y < 0)
-	{
-		angle = 2 - angle;
-	}
-	angle *= 0.5f;
-	tex.z += floor(angle * impostorCaptureAngles);
+	float3 face = normalize(mul(g_xCamera_CamPos - origin, (float3x3)WORLD));
+	const float2 cell = min(floor(impostor_encode(face) * impostorCaptureGrid), impostorCaptureGrid - 1);
+	const float3 capture_up = impostor_capture_up(impostor_decode((cell + 0.5f) / impostorCaptureGrid));
+	float3 right = normalize(cross(capture_up, -face));
+	float3 up = cross(-face, right);
+	float3 tex = float3((cell + pos.xy * float2(0.5f, -0.5f) + 0.5f) / impostorCaptureGrid, userdata.y);
+	pos = pos.x * right + pos.y * up;
 
 	float4 color_dither = unpack_rgba(userdata.x);
 
@@ -0,0 +1,101 @@
+#include "gpuCullingHF.hlsli"
+
+// Frustum culling and LOD selection of one instance per thread for every view, the input layout is described next to INSTANCECULLING_HEADER_SIZE
+//	g_xColor.x: 0 for the dispatch that resets the args of every view and LOD, 1 for the culling dispatch
+
+RAWBUFFER(input, GPUCULLINGSLOT_IN_INPUT);
+
+RWRAWBUFFER(args, 0);
+RWRAWBUFFER(visible, 1);
+
+bool IsInViewFrustum(uint view, float3 aabb_min, float3 aabb_max)
+{
+	const uint address = INSTANCECULLING_VIEWS_OFFSET + view * INSTANCECULLING_VIEW_STRIDE;
+	for (uint p = 0; p < 6; ++p)
+	{
+		const float4 plane = asfloat(input.Load4(address + p * 16));
+		const float3 corner = float3(
+			plane.x < 0 ? aabb_min.x : aabb_max.x,
+			plane.y < 0 ? aabb_min.y : aabb_max.y,
+			plane.z < 0 ? aabb_min.z : aabb_max.z
+		);
+		if (dot(plane.xyz, corner) + plane.w < 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+[numthreads(GPUCULLING_THREADCOUNT, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	const uint4 header = input.Load4(0); // instance count, view count, lod count, occlusion view
+	const uint instanceCount = header.x;
+	const uint viewCount = header.y;
+	const uint lodCount = header.z;
+
+	if (g_xColor.x == 0)
+	{
+		const uint draw = DTid.x;
+		if (draw < viewCount * lodCount)
+		{
+			const uint4 lod = input.Load4(INSTANCECULLING_LODS_OFFSET + (draw % lodCount) * 16);
+			args.Store4(draw * GPUCULLING_ARGS_STRIDE, uint4(lod.y, 0, lod.z, 0));
+			args.Store(draw * GPUCULLING_ARGS_STRIDE + 16, draw * instanceCount);
+		}
+		return;
+	}
+
+	const uint instance = DTid.x;
+	if (instance >= instanceCount)
+	{
+		return;
+	}
+
+	const uint address = INSTANCECULLING_HEADER_SIZE + instance * GPUCULLING_CANDIDATE_STRIDE;
+	const float3 aabb_min = asfloat(input.Load3(address));
+	const float3 aabb_max = asfloat(input.Load3(address + 16));
+
+	for (uint view = 0; view < viewCount; ++view)
+	{
+		if (!IsInViewFrustum(view, aabb_min, aabb_max))
+		{
+			continue;
+		}
+
+		// The LOD is selected by the distance of the nearest point of the box, the instances beyond the last LOD are not drawn:
+		const float3 position = asfloat(input.Load3(INSTANCECULLING_VIEWS_OFFSET + view * INSTANCECULLING_VIEW_STRIDE + 96));
+		const float dist = distance(position, clamp(position, aabb_min, aabb_max));
+		uint lod = 0;
+		while (lod < lodCount && dist >= asfloat(input.Load(INSTANCECULLING_LODS_OFFSET + lod * 16)))
+		{
+			lod++;
+		}
+		if (lod >= lodCount)
+		{
+			continue;
+		}
+
+		if (view == header.w)
+		{
+			// The matrix is stored by rows, like the camera matrices on the CPU:
+			const float4x4 VP = transpose(float4x4(
+				asfloat(input.Load4(16)),
+				asfloat(input.Load4(32)),
+				asfloat(input.Load4(48)),
+				asfloat(input.Load4(64))
+			));
+			const float2 zNearFar = asfloat(input.Load2(80));
+			if (IsOccluded(aabb_min, aabb_max, VP, zNearFar.x, zNearFar.y))
+			{
+				continue;
+			}
+		}
+
+		const uint draw = view * lodCount + lod;
+		uint slot;
+		args.InterlockedAdd(draw * GPUCULLING_ARGS_STRIDE + 4, 1, slot);
+		visible.Store((draw * instanceCount + slot) * 4, instance);
+	}
+}
@@ -0,0 +1,28 @@
+#include "ResourceMapping.h"
+#include "ShaderInterop_Renderer.h"
+
+// Scatters the changed entries into the persistent instance table
+//	The update buffer starts with the update count, then every update is an object index (padded to 16 bytes) and the new ShaderInstance
+
+RAWBUFFER(instanceTableUpdates, INSTANCETABLESLOT_IN_UPDATES);
+
+RWRAWBUFFER(instanceTable, 0);
+
+[numthreads(INSTANCETABLE_UPDATE_THREADCOUNT, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	const uint updateCount = instanceTableUpdates.Load(0);
+	if (DTid.x >= updateCount)
+	{
+		return;
+	}
+
+	const uint src = 16 + DTid.x * INSTANCETABLE_UPDATE_STRIDE;
+	const uint dst = instanceTableUpdates.Load(src) * INSTANCETABLE_STRIDE;
+
+	[unroll]
+	for (uint i = 0; i < INSTANCETABLE_STRIDE; i += 16)
+	{
+		instanceTable.Store4(dst + i, instanceTableUpdates.Load4(src + 16 + i));
+	}
+}
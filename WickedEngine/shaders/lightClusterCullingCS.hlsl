@@ -0,0 +1,149 @@
+#include "globals.hlsli"
+#include "cullingShaderHF.hlsli"
+#include "lightingHF.hlsli"
+
+// Clustered entity culling: the screen tiles are split into exponential depth slices (froxels), so the culling doesn't depend on the depth buffer
+//	The result is used by opaque and transparent passes alike, and entities are only assigned to the clusters that they actually touch in depth
+
+#define entityCount (g_xFrame_LightArrayCount + g_xFrame_DecalArrayCount + g_xFrame_EnvProbeArrayCount)
+
+STRUCTUREDBUFFER(in_Frustums, Frustum, TEXSLOT_ONDEMAND0);
+
+RWSTRUCTUREDBUFFER(EntityClusters, uint, 0);
+
+groupshared AABB GroupAABB;			// cluster AABB in View Space
+groupshared AABB GroupAABB_WS;		// cluster AABB in world space
+groupshared uint cluster_entities[SHADER_ENTITY_TILE_BUCKET_COUNT];
+
+void AppendEntity(uint entityIndex)
+{
+	const uint bucket_index = entityIndex / 32;
+	const uint bucket_place = entityIndex % 32;
+	InterlockedOr(cluster_entities[bucket_index], 1u << bucket_place);
+}
+
+[numthreads(TILED_CULLING_THREADSIZE * TILED_CULLING_THREADSIZE, 1, 1)]
+void main(uint3 Gid : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+	uint2 dim;
+	texture_depth.GetDimensions(dim.x, dim.y);
+	float2 dim_rcp = rcp(dim);
+
+	uint i = 0;
+
+	const uint flatTileIndex = flatten2D(Gid.xy, g_xFrame_EntityCullingTileCount.xy);
+	const uint clusterBucketsAddress = flatten3D(Gid, g_xFrame_EntityCullingTileCount) * SHADER_ENTITY_TILE_BUCKET_COUNT;
+	Frustum GroupFrustum = in_Frustums[flatTileIndex];
+
+	for (i = groupIndex; i < SHADER_ENTITY_TILE_BUCKET_COUNT; i += TILED_CULLING_THREADSIZE * TILED_CULLING_THREADSIZE)
+	{
+		cluster_entities[i] = 0;
+	}
+
+	// The view space depth range of the slice, inverse of the slice computation in GetEntityCullingBucketAddress():
+	const float2 scaleBias = g_xFrame_EntityCullingClusterScaleBias;
+	const float minDepthVS = exp(((float)Gid.z - scaleBias.y) / scaleBias.x);
+	const float maxDepthVS = exp(((float)Gid.z + 1 - scaleBias.y) / scaleBias.x);
+
+	if (groupIndex == 0)
+	{
+		// The tile corners on the near plane are scaled to the slice depth bounds:
+		float3 nearPlane[4];
+		nearPlane[0] = ScreenToView(float4(Gid.xy * TILED_CULLING_BLOCKSIZE, 1.0f, 1.0f), dim_rcp).xyz;
+		nearPlane[1] = ScreenToView(float4(float2(Gid.x + 1, Gid.y) * TILED_CULLING_BLOCKSIZE, 1.0f, 1.0f), dim_rcp).xyz;
+		nearPlane[2] = ScreenToView(float4(float2(Gid.x, Gid.y + 1) * TILED_CULLING_BLOCKSIZE, 1.0f, 1.0f), dim_rcp).xyz;
+		nearPlane[3] = ScreenToView(float4(float2(Gid.x + 1, Gid.y + 1) * TILED_CULLING_BLOCKSIZE, 1.0f, 1.0f), dim_rcp).xyz;
+
+		float3 minAABB = 10000000;
+		float3 maxAABB = -10000000;
+		[unroll]
+		for (uint i = 0; i < 4; ++i)
+		{
+			const float3 cornerMin = nearPlane[i] * (minDepthVS / nearPlane[i].z);
+			const float3 cornerMax = nearPlane[i] * (maxDepthVS / nearPlane[i].z);
+			minAABB = min(minAABB, min(cornerMin, cornerMax));
+			maxAABB = max(maxAABB, max(cornerMin, cornerMax));
+		}
+
+		AABBfromMinMax(GroupAABB, minAABB, maxAABB);
+
+		GroupAABB_WS = GroupAABB;
+		AABBtransform(GroupAABB_WS, g_xCamera_InvV);
+	}
+
+	GroupMemoryBarrierWithGroupSync();
+
+	// Each thread will cull one entity until all entities have been culled:
+	for (i = groupIndex; i < entityCount; i += TILED_CULLING_THREADSIZE * TILED_CULLING_THREADSIZE)
+	{
+		ShaderEntity entity = EntityArray[i];
+
+		if (entity.GetFlags() & ENTITY_FLAG_LIGHT_STATIC)
+		{
+			continue; // static lights will be skipped here (they are used at lightmap baking)
+		}
+
+		switch (entity.GetType())
+		{
+		case ENTITY_TYPE_POINTLIGHT:
+		{
+			float3 positionVS = mul(g_xCamera_View, float4(entity.position, 1)).xyz;
+			Sphere sphere = { positionVS.xyz, entity.GetRange() };
+			if (SphereInsideFrustum(sphere, GroupFrustum, minDepthVS, maxDepthVS) && SphereIntersectsAABB(sphere, GroupAABB))
+			{
+				AppendEntity(i);
+			}
+		}
+		break;
+		case ENTITY_TYPE_SPOTLIGHT:
+		{
+			float3 positionVS = mul(g_xCamera_View, float4(entity.position, 1)).xyz;
+			float3 directionVS = mul((float3x3)g_xCamera_View, entity.GetDirection());
+			// Construct a tight fitting sphere around the spotlight cone:
+			const float r = entity.GetRange() * 0.5f / (entity.GetConeAngleCos() * entity.GetConeAngleCos());
+			Sphere sphere = { positionVS - directionVS * r, r };
+			if (SphereInsideFrustum(sphere, GroupFrustum, minDepthVS, maxDepthVS) && SphereIntersectsAABB(sphere, GroupAABB))
+			{
+				AppendEntity(i);
+			}
+		}
+		break;
+		case ENTITY_TYPE_DIRECTIONALLIGHT:
+		{
+			AppendEntity(i);
+		}
+		break;
+		case ENTITY_TYPE_DECAL:
+		case ENTITY_TYPE_ENVMAP:
+		{
+			float3 positionVS = mul(g_xCamera_View, float4(entity.position, 1)).xyz;
+			Sphere sphere = { positionVS.xyz, entity.GetRange() };
+			if (SphereInsideFrustum(sphere, GroupFrustum, minDepthVS, maxDepthVS))
+			{
+				// unit AABB: 
+				AABB a;
+				a.c = 0;
+				a.e = 1.0;
+
+				// cluster AABB in world space transformed into the space of the probe/decal OBB:
+				AABB b = GroupAABB_WS;
+				AABBtransform(b, MatrixArray[entity.GetMatrixIndex()]);
+
+				if (IntersectAABB(a, b))
+				{
+					AppendEntity(i);
+				}
+			}
+		}
+		break;
+		}
+	}
+
+	GroupMemoryBarrierWithGroupSync();
+
+	// Each thread will export one bucket from LDS to global memory:
+	for (i = groupIndex; i < SHADER_ENTITY_TILE_BUCKET_COUNT; i += TILED_CULLING_THREADSIZE * TILED_CULLING_THREADSIZE)
+	{
+		EntityClusters[clusterBucketsAddress + i] = cluster_entities[i];
+	}
+}
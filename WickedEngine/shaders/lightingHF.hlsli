@@ -186,6 +186,10 @@ inline float3 shadowCascade(in ShaderEntity light, in float3 shadowPos, in float
 inline float3 shadowCascadeSpot(in ShaderEntity light, in float3 shadowPos, in float2 shadowUV, in uint cascade)
 {
 	const float slice = light.GetTextureIndex() + cascade;
+	// Move into the tile of the light in the shadow atlas page, the filter footprint is kept inside the tile:
+	const float2 tileMin = light.GetShadowAtlasOffset() + 2;
+	const float2 tileMax = light.GetShadowAtlasOffset() + light.GetShadowAtlasSize() - 2;
+	shadowUV = clamp(light.GetShadowAtlasOffset() + shadowUV * light.GetShadowAtlasSize(), tileMin, tileMax) * g_xFrame_ShadowKernelSpot2D;
 	const float realDistance = shadowPos.z; // bias was already applied when shadow map was rendered
 	float scaleFactor = 65536.0 / (cascade + 1);
 	float3 shadow = 0;
@@ -244,6 +248,10 @@ inline float3 shadowCascadeSpot(in ShaderEntity light, in float3 shadowPos, in f
 inline float3 shadowCascadeSpot(in ShaderEntity light, in float3 shadowPos, in float2 shadowUV, in uint cascade,in float dist)
 {
 	const float slice = light.GetTextureIndex() + cascade;
+	// Move into the tile of the light in the shadow atlas page, the filter footprint is kept inside the tile:
+	const float2 tileMin = light.GetShadowAtlasOffset() + 2;
+	const float2 tileMax = light.GetShadowAtlasOffset() + light.GetShadowAtlasSize() - 2;
+	shadowUV = clamp(light.GetShadowAtlasOffset() + shadowUV * light.GetShadowAtlasSize(), tileMin, tileMax) * g_xFrame_ShadowKernelSpot2D;
 	const float realDistance = shadowPos.z; // bias was already applied when shadow map was rendered
 	float scaleFactor = 65536.0 / (cascade + 1);
 	float3 shadow = 0;
@@ -801,9 +809,10 @@ inline void VoxelGI(in Surface surface, inout Lighting lighting)
 {
 	[branch] if (g_xFrame_VoxelRadianceDataRes != 0)
 	{
-		// determine blending factor (we will blend out voxel GI on grid edges):
-		float3 voxelSpacePos = surface.P - g_xFrame_VoxelRadianceDataCenter;
-		voxelSpacePos *= g_xFrame_VoxelRadianceDataSize_rcp;
+		// determine blending factor (we will blend out voxel GI on the edges of the largest clipmap):
+		const float4 clipmap = g_xFrame_VoxelClipMaps[VOXEL_GI_CLIPMAP_COUNT - 1];
+		float3 voxelSpacePos = surface.P - clipmap.xyz;
+		voxelSpacePos /= clipmap.w;
 		voxelSpacePos *= g_xFrame_VoxelRadianceDataRes_rcp;
 		voxelSpacePos = saturate(abs(voxelSpacePos));
 		float blend = 1 - pow(max(voxelSpacePos.x, max(voxelSpacePos.y, voxelSpacePos.z)), 4);
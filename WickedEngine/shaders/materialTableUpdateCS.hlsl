@@ -0,0 +1,28 @@
+#include "ResourceMapping.h"
+#include "ShaderInterop_Renderer.h"
+
+// Scatters the changed entries into the material table
+//	The update buffer starts with the update count, then every update is a material index (padded to 16 bytes) and the new ShaderMaterial
+
+RAWBUFFER(materialTableUpdates, MATERIALTABLESLOT_IN_UPDATES);
+
+RWRAWBUFFER(materialTable, 0);
+
+[numthreads(MATERIALTABLE_UPDATE_THREADCOUNT, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	const uint updateCount = materialTableUpdates.Load(0);
+	if (DTid.x >= updateCount)
+	{
+		return;
+	}
+
+	const uint src = 16 + DTid.x * MATERIALTABLE_UPDATE_STRIDE;
+	const uint dst = materialTableUpdates.Load(src) * MATERIALTABLE_STRIDE;
+
+	[unroll]
+	for (uint i = 0; i < MATERIALTABLE_STRIDE; i += 16)
+	{
+		materialTable.Store4(dst + i, materialTableUpdates.Load4(src + 16 + i));
+	}
+}
@@ -0,0 +1,108 @@
+#include "gpuCullingHF.hlsli"
+
+// Culls the clusters of one instance per thread group against the frustum, the backface cone and the Hi-Z, the indices of the visible clusters are copied to the output
+//	The input layout is described next to MESHLETCULLING_CANDIDATE_STRIDE
+//	g_xColor: first candidate of the dispatch, meshlet count of the mesh, occlusion enabled, cone culling enabled
+
+RAWBUFFER(input, GPUCULLINGSLOT_IN_INPUT);
+STRUCTUREDBUFFER(meshlets, ShaderMeshlet, MESHLETCULLINGSLOT_IN_MESHLETS);
+TYPEDBUFFER(meshIndices, uint, MESHLETCULLINGSLOT_IN_INDICES);
+
+RWRAWBUFFER(args, 0);
+RWRAWBUFFER(references, 1);
+RWRAWBUFFER(outputIndices, 2);
+
+groupshared uint visibleCount;
+groupshared uint outputCount;
+groupshared uint visibleMeshlets[GPUCULLING_THREADCOUNT];
+groupshared uint visibleOffsets[GPUCULLING_THREADCOUNT];
+
+[numthreads(GPUCULLING_THREADCOUNT, 1, 1)]
+void main(uint3 Gid : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+	const uint candidateIndex = (uint)g_xColor.x + Gid.x;
+	const uint meshletCount = (uint)g_xColor.y;
+	const uint address = candidateIndex * MESHLETCULLING_CANDIDATE_STRIDE;
+	const float4 mat0 = asfloat(input.Load4(address));
+	const float4 mat1 = asfloat(input.Load4(address + 16));
+	const float4 mat2 = asfloat(input.Load4(address + 32));
+	const uint4 candidate = input.Load4(address + 48); // object index, dither and frustum index, output index offset, reference slot
+
+	const float3 axis_x = float3(mat0.x, mat1.x, mat2.x);
+	const float3 axis_y = float3(mat0.y, mat1.y, mat2.y);
+	const float3 axis_z = float3(mat0.z, mat1.z, mat2.z);
+	const float3 scale = float3(length(axis_x), length(axis_y), length(axis_z));
+	const float scale_max = max(scale.x, max(scale.y, scale.z));
+	const float scale_min = min(scale.x, min(scale.y, scale.z));
+
+	// The cones are only valid when the transform keeps the winding and the normal directions (uniform scaling):
+	const bool cone = g_xColor.w > 0 && dot(cross(axis_x, axis_y), axis_z) > 0 && scale_max <= scale_min * 1.01;
+
+	if (groupIndex == 0)
+	{
+		outputCount = 0;
+	}
+
+	for (uint base = 0; base < meshletCount; base += GPUCULLING_THREADCOUNT)
+	{
+		if (groupIndex == 0)
+		{
+			visibleCount = 0;
+		}
+		GroupMemoryBarrierWithGroupSync();
+
+		const uint meshletIndex = base + groupIndex;
+		if (meshletIndex < meshletCount)
+		{
+			const ShaderMeshlet meshlet = meshlets[meshletIndex];
+			const float3 center = float3(
+				dot(mat0, float4(meshlet.center, 1)),
+				dot(mat1, float4(meshlet.center, 1)),
+				dot(mat2, float4(meshlet.center, 1))
+			);
+			const float radius = meshlet.radius * scale_max;
+
+			bool visible = true;
+			if (cone)
+			{
+				// Every triangle of the cluster is facing away when the view direction is inside the backface cone:
+				const float3 cone_axis = normalize(float3(dot(mat0.xyz, meshlet.cone_axis), dot(mat1.xyz, meshlet.cone_axis), dot(mat2.xyz, meshlet.cone_axis)));
+				const float3 view = center - g_xCamera_CamPos;
+				visible = dot(view, cone_axis) < meshlet.cone_cutoff * length(view) + radius;
+			}
+			visible = visible && IsVisible(center - radius, center + radius, g_xColor.z > 0);
+
+			if (visible)
+			{
+				uint slot;
+				InterlockedAdd(visibleCount, 1, slot);
+				uint offset;
+				InterlockedAdd(outputCount, meshlet.indexCount, offset);
+				visibleMeshlets[slot] = meshletIndex;
+				visibleOffsets[slot] = offset;
+			}
+		}
+		GroupMemoryBarrierWithGroupSync();
+
+		// The indices of the visible clusters are copied by the whole group:
+		for (uint i = 0; i < visibleCount; ++i)
+		{
+			const ShaderMeshlet meshlet = meshlets[visibleMeshlets[i]];
+			const uint dst = candidate.z + visibleOffsets[i];
+			for (uint j = groupIndex; j < meshlet.indexCount; j += GPUCULLING_THREADCOUNT)
+			{
+				outputIndices.Store((dst + j) * 4, meshIndices[meshlet.indexOffset + j]);
+			}
+		}
+		GroupMemoryBarrierWithGroupSync();
+	}
+
+	if (groupIndex == 0)
+	{
+		// The candidate is drawn by its own IndirectDrawArgsIndexedInstanced from its reference slot:
+		const uint args_address = candidateIndex * GPUCULLING_ARGS_STRIDE;
+		args.Store4(args_address, uint4(outputCount, outputCount > 0 ? 1 : 0, candidate.z, 0));
+		args.Store(args_address + 16, 0);
+		references.Store2(candidate.w * INSTANCETABLE_REFERENCE_STRIDE, candidate.xy);
+	}
+}
@@ -0,0 +1,43 @@
+#include "ResourceMapping.h"
+#include "ShaderInterop_Skinning.h"
+
+// Applies the weighted morph target deltas to the vertices that are moved by any target
+//	The other vertices of the position buffer are not touched and keep their base attributes
+
+STRUCTUREDBUFFER(morphVertices, ShaderMorphVertex, MORPHSLOT_IN_VERTICES);
+STRUCTUREDBUFFER(morphDeltas, ShaderMorphDelta, MORPHSLOT_IN_DELTAS);
+STRUCTUREDBUFFER(morphWeights, float, MORPHSLOT_IN_WEIGHTS);
+
+RWRAWBUFFER(vertexBuffer_POS, 0);
+
+[numthreads(MORPH_COMPUTE_THREADCOUNT, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	uint vertexCount, stride;
+	morphVertices.GetDimensions(vertexCount, stride);
+	if (DTid.x >= vertexCount)
+	{
+		return;
+	}
+
+	const ShaderMorphVertex vertex = morphVertices[DTid.x];
+	float3 pos = vertex.position;
+	float3 nor = vertex.normal;
+	for (uint i = vertex.deltaOffset; i < vertex.deltaOffset + vertex.deltaCount; ++i)
+	{
+		const ShaderMorphDelta delta = morphDeltas[i];
+		const float weight = morphWeights[delta.target];
+		pos += weight * delta.position;
+		nor += weight * delta.normal;
+	}
+	nor = normalize(nor);
+
+	// Same packing as MeshComponent::Vertex_POS:
+	uint normal_wind = 0;
+	normal_wind |= (uint)((nor.x * 0.5f + 0.5f) * 255.0f) << 0;
+	normal_wind |= (uint)((nor.y * 0.5f + 0.5f) * 255.0f) << 8;
+	normal_wind |= (uint)((nor.z * 0.5f + 0.5f) * 255.0f) << 16;
+	normal_wind |= (vertex.wind & 0xFF) << 24;
+
+	vertexBuffer_POS.Store4(vertex.vertex * 16, uint4(asuint(pos), normal_wind));
+}
@@ -31,8 +31,9 @@ void main(
 	{
 		GSOutput output;
 
-		// World space -> Voxel grid space:
-		output.pos.xyz = (input[i].pos.xyz - g_xFrame_VoxelRadianceDataCenter) * g_xFrame_VoxelRadianceDataSize_rcp;
+		// World space -> Voxel grid space of the clipmap that is voxelized:
+		const float4 clipmap = g_xFrame_VoxelClipMaps[xVoxelizer_ClipMap];
+		output.pos.xyz = (input[i].pos.xyz - clipmap.xyz) / clipmap.w;
 
 		// Project onto dominant axis:
 		[flatten]
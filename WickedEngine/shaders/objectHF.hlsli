@@ -16,6 +16,13 @@
 
 #define LIGHTMAP_QUALITY_BICUBIC
 
+// The material features that are not in the permutation (OBJECTSHADER_PERMUTATION_* bits) are compiled out:
+#ifdef OBJECTSHADER_PERMUTATION
+#define OBJECTSHADER_FEATURE(feature) ((OBJECTSHADER_PERMUTATION & (feature)) != 0)
+#else
+#define OBJECTSHADER_FEATURE(feature) true
+#endif
+
 
 #include "globals.hlsli"
 #include "brdf.hlsli"
@@ -34,21 +41,25 @@ inline ShaderMesh GetMesh()
 {
 	return bindless_buffers[push.mesh].Load<ShaderMesh>(0);
 }
+inline ShaderMaterial GetMaterialFromTable(uint materialIndex)
+{
+	return bindless_buffers[g_xFrame_MaterialTableIndex].Load<ShaderMaterial>(materialIndex * MATERIALTABLE_STRIDE);
+}
 inline ShaderMaterial GetMaterial()
 {
-	return bindless_buffers[push.material].Load<ShaderMaterial>(0);
+	return GetMaterialFromTable(push.material);
 }
 inline ShaderMaterial GetMaterial1()
 {
-	return bindless_buffers[GetMesh().blendmaterial1].Load<ShaderMaterial>(0);
+	return GetMaterialFromTable(GetMesh().blendmaterial1);
 }
 inline ShaderMaterial GetMaterial2()
 {
-	return bindless_buffers[GetMesh().blendmaterial2].Load<ShaderMaterial>(0);
+	return GetMaterialFromTable(GetMesh().blendmaterial2);
 }
 inline ShaderMaterial GetMaterial3()
 {
-	return bindless_buffers[GetMesh().blendmaterial3].Load<ShaderMaterial>(0);
+	return GetMaterialFromTable(GetMesh().blendmaterial3);
 }
 
 #define sampler_objectshader			bindless_samplers[g_xFrame_ObjectShaderSamplerIndex]
@@ -289,11 +300,33 @@ struct VertexInput
 	}
 #endif // OBJECTSHADER_INPUT_TEX
 
+	// With the instance table, the instances only contain (object index, dither | frustum index) and the data is in the table:
+	uint2 GetInstanceReference()
+	{
+		return bindless_buffers[push.instances].Load<uint2>(push.instance_offset + instanceID * INSTANCETABLE_REFERENCE_STRIDE);
+	}
+	uint GetInstanceTableAddress()
+	{
+		return GetInstanceReference().x * INSTANCETABLE_STRIDE;
+	}
+
 	float4x4 GetInstanceMatrix()
 	{
-		float4 mat0 = bindless_buffers[push.instances].Load<float4>(push.instance_offset + instanceID * instance_stride + 16 * 0);
-		float4 mat1 = bindless_buffers[push.instances].Load<float4>(push.instance_offset + instanceID * instance_stride + 16 * 1);
-		float4 mat2 = bindless_buffers[push.instances].Load<float4>(push.instance_offset + instanceID * instance_stride + 16 * 2);
+		float4 mat0, mat1, mat2;
+		[branch]
+		if (push.instance_table >= 0)
+		{
+			const uint address = GetInstanceTableAddress();
+			mat0 = bindless_buffers[push.instance_table].Load<float4>(address + 16 * 0);
+			mat1 = bindless_buffers[push.instance_table].Load<float4>(address + 16 * 1);
+			mat2 = bindless_buffers[push.instance_table].Load<float4>(address + 16 * 2);
+		}
+		else
+		{
+			mat0 = bindless_buffers[push.instances].Load<float4>(push.instance_offset + instanceID * instance_stride + 16 * 0);
+			mat1 = bindless_buffers[push.instances].Load<float4>(push.instance_offset + instanceID * instance_stride + 16 * 1);
+			mat2 = bindless_buffers[push.instances].Load<float4>(push.instance_offset + instanceID * instance_stride + 16 * 2);
+		}
 		return  float4x4(
 			mat0,
 			mat1,
@@ -303,6 +336,15 @@ struct VertexInput
 	}
 	uint4 GetInstanceUserdata()
 	{
+		[branch]
+		if (push.instance_table >= 0)
+		{
+			const uint2 reference = GetInstanceReference();
+			const uint4 data = bindless_buffers[push.instance_table].Load<uint4>(reference.x * INSTANCETABLE_STRIDE + 16 * 3);
+			float4 color = unpack_rgba(data.x);
+			color.a *= 1 - (float)(reference.y >> 16u) / 65535.0;
+			return uint4(pack_rgba(color), reference.y & 0xFFFF, data.y, 0);
+		}
 		return bindless_buffers[push.instances].Load<uint4>(push.instance_offset + instanceID * instance_stride + 16 * 3);
 	}
 
@@ -319,9 +361,21 @@ struct VertexInput
 	}
 	float4x4 GetInstanceMatrixPrev()
 	{
-		float4 matPrev0 = bindless_buffers[push.instances].Load<float4>(push.instance_offset + instanceID * instance_stride + 16 * 4);
-		float4 matPrev1 = bindless_buffers[push.instances].Load<float4>(push.instance_offset + instanceID * instance_stride + 16 * 5);
-		float4 matPrev2 = bindless_buffers[push.instances].Load<float4>(push.instance_offset + instanceID * instance_stride + 16 * 6);
+		float4 matPrev0, matPrev1, matPrev2;
+		[branch]
+		if (push.instance_table >= 0)
+		{
+			const uint address = GetInstanceTableAddress();
+			matPrev0 = bindless_buffers[push.instance_table].Load<float4>(address + 16 * 4);
+			matPrev1 = bindless_buffers[push.instance_table].Load<float4>(address + 16 * 5);
+			matPrev2 = bindless_buffers[push.instance_table].Load<float4>(address + 16 * 6);
+		}
+		else
+		{
+			matPrev0 = bindless_buffers[push.instances].Load<float4>(push.instance_offset + instanceID * instance_stride + 16 * 4);
+			matPrev1 = bindless_buffers[push.instances].Load<float4>(push.instance_offset + instanceID * instance_stride + 16 * 5);
+			matPrev2 = bindless_buffers[push.instances].Load<float4>(push.instance_offset + instanceID * instance_stride + 16 * 6);
+		}
 		return  float4x4(
 			matPrev0,
 			matPrev1,
@@ -341,6 +395,11 @@ struct VertexInput
 	}
 	float4 GetInstanceAtlas()
 	{
+		[branch]
+		if (push.instance_table >= 0)
+		{
+			return bindless_buffers[push.instance_table].Load<float4>(GetInstanceTableAddress() + 16 * 7);
+		}
 		return bindless_buffers[push.instances].Load<float4>(push.instance_offset + instanceID * instance_stride + 16 * 4);
 	}
 #endif // OBJECTSHADER_INPUT_ATL
@@ -651,7 +710,7 @@ inline void LightMapping(in float2 ATLAS, inout Lighting lighting)
 inline void NormalMapping(in float4 uvsets, inout float3 N, in float3x3 TBN, out float3 bumpColor)
 {
 	[branch]
-	if (GetMaterial().normalMapStrength > 0 && GetMaterial().uvset_normalMap >= 0)
+	if (OBJECTSHADER_FEATURE(OBJECTSHADER_PERMUTATION_NORMALMAP) && GetMaterial().normalMapStrength > 0 && GetMaterial().uvset_normalMap >= 0)
 	{
 		const float2 UV_normalMap = GetMaterial().uvset_normalMap == 0 ? uvsets.xy : uvsets.zw;
 		float3 normalMap = texture_normalmap.Sample(sampler_objectshader, UV_normalMap).rgb;
@@ -747,7 +806,17 @@ inline void ForwardLighting(inout Surface surface, inout Lighting lighting)
 					// mipmapping needs to be performed by hand:
 					const float2 decalDX = mul(P_dx, (float3x3)decalProjection).xy * texMulAdd.xy;
 					const float2 decalDY = mul(P_dy, (float3x3)decalProjection).xy * texMulAdd.xy;
+#ifdef BINDLESS
+					// decals sample their own texture, the index is invalid if the decal has no texture:
+					float4 decalColor = 1;
+					[branch]
+					if (decal.userdata != ~0u)
+					{
+						decalColor = bindless_textures[NonUniformResourceIndex(decal.userdata)].SampleGrad(sampler_linear_clamp, uvw.xy * texMulAdd.xy + texMulAdd.zw, decalDX, decalDY);
+					}
+#else
 					float4 decalColor = texture_decalatlas.SampleGrad(sampler_linear_clamp, uvw.xy * texMulAdd.xy + texMulAdd.zw, decalDX, decalDY);
+#endif // BINDLESS
 					// blend out if close to cube Z:
 					float edgeBlend = 1 - pow(saturate(abs(clipSpacePos.z)), 8);
 					decalColor.a *= edgeBlend;
@@ -909,7 +978,7 @@ inline void TiledLighting(inout Surface surface, inout Lighting lighting, out fl
 	envmapAmbient = 0;
 
 	const uint2 tileIndex = uint2(floor(surface.pixel / TILED_CULLING_BLOCKSIZE));
-	const uint flatTileIndex = flatten2D(tileIndex, g_xFrame_EntityCullingTileCount.xy) * SHADER_ENTITY_TILE_BUCKET_COUNT;
+	const uint flatTileIndex = GetEntityCullingBucketAddress(tileIndex, surface.P);
 
 #ifndef DISABLE_DECALS
 	[branch]
@@ -959,7 +1028,17 @@ inline void TiledLighting(inout Surface surface, inout Lighting lighting, out fl
 						// mipmapping needs to be performed by hand:
 						const float2 decalDX = mul(P_dx, (float3x3)decalProjection).xy * texMulAdd.xy;
 						const float2 decalDY = mul(P_dy, (float3x3)decalProjection).xy * texMulAdd.xy;
+#ifdef BINDLESS
+						// decals sample their own texture, the index is invalid if the decal has no texture:
+						float4 decalColor = 1;
+						[branch]
+						if (decal.userdata != ~0u)
+						{
+							decalColor = bindless_textures[NonUniformResourceIndex(decal.userdata)].SampleGrad(sampler_linear_clamp, uvw.xy * texMulAdd.xy + texMulAdd.zw, decalDX, decalDY);
+						}
+#else
 						float4 decalColor = texture_decalatlas.SampleGrad(sampler_linear_clamp, uvw.xy * texMulAdd.xy + texMulAdd.zw, decalDX, decalDY);
+#endif // BINDLESS
 						// blend out if close to cube Z:
 						float edgeBlend = 1 - pow(saturate(abs(clipSpacePos.z)), 8);
 						decalColor.a *= edgeBlend;
@@ -1498,7 +1577,7 @@ struct OutputPrepass
 #ifdef OBJECTSHADER_USE_UVSETS
 #ifndef OBJECTLOD
 	[branch]
-	if (GetMaterial().uvset_surfaceMap >= 0)
+	if (OBJECTSHADER_FEATURE(OBJECTSHADER_PERMUTATION_SURFACEMAP) && GetMaterial().uvset_surfaceMap >= 0)
 	{
 		const float2 UV_surfaceMap = GetMaterial().uvset_surfaceMap == 0 ? input.uvsets.xy : input.uvsets.zw;
 		surfaceMap = texture_surfacemap.Sample(sampler_objectshader, UV_surfaceMap);
@@ -1515,7 +1594,7 @@ struct OutputPrepass
 #ifdef OBJECTSHADER_USE_UVSETS
 #ifndef OBJECTLOD
 	[branch]
-	if (GetMaterial().uvset_specularMap >= 0)
+	if (OBJECTSHADER_FEATURE(OBJECTSHADER_PERMUTATION_SURFACEMAP) && GetMaterial().uvset_specularMap >= 0)
 	{
 		const float2 UV_specularMap = GetMaterial().uvset_specularMap == 0 ? input.uvsets.xy : input.uvsets.zw;
 		specularMap = texture_specularmap.Sample(sampler_objectshader, UV_specularMap);
@@ -1535,7 +1614,7 @@ struct OutputPrepass
 #ifdef OBJECTSHADER_USE_UVSETS
 #ifndef OBJECTLOD
 	[branch]
-	if (surface.emissiveColor.a > 0 && GetMaterial().uvset_emissiveMap >= 0)
+	if (OBJECTSHADER_FEATURE(OBJECTSHADER_PERMUTATION_EMISSIVEMAP) && surface.emissiveColor.a > 0 && GetMaterial().uvset_emissiveMap >= 0)
 	{
 		const float2 UV_emissiveMap = GetMaterial().uvset_emissiveMap == 0 ? input.uvsets.xy : input.uvsets.zw;
 		float4 emissiveMap = texture_emissivemap.Sample(sampler_objectshader, UV_emissiveMap);
@@ -1601,6 +1680,7 @@ struct OutputPrepass
 		{
 			float2 uv = GetMaterial().uvset_normalMap == 0 ? input.uvsets.xy : input.uvsets.zw;
 			sam.rgb = texture_normalmap.Sample(sampler_objectshader, uv).rgb;
+			sam.b = sam.b == 0 ? 1 : sam.b; // fix for missing blue channel
 			sam.rgb = sam.rgb * 2 - 1;
 			surface2.N = lerp(baseN, mul(sam.rgb, TBN), GetMaterial().normalMapStrength);
 		}
@@ -1669,6 +1749,7 @@ struct OutputPrepass
 		{
 			float2 uv = GetMaterial1().uvset_normalMap == 0 ? input.uvsets.xy : input.uvsets.zw;
 			sam.rgb = texture_blend1_normalmap.Sample(sampler_objectshader, uv).rgb;
+			sam.b = sam.b == 0 ? 1 : sam.b; // fix for missing blue channel
 			sam.rgb = sam.rgb * 2 - 1;
 			surface2.N = lerp(baseN, mul(sam.rgb, TBN), GetMaterial1().normalMapStrength);
 		}
@@ -1739,6 +1820,7 @@ struct OutputPrepass
 		{
 			float2 uv = GetMaterial2().uvset_normalMap == 0 ? input.uvsets.xy : input.uvsets.zw;
 			sam.rgb = texture_blend2_normalmap.Sample(sampler_objectshader, uv).rgb;
+			sam.b = sam.b == 0 ? 1 : sam.b; // fix for missing blue channel
 			sam.rgb = sam.rgb * 2 - 1;
 			surface2.N = lerp(baseN, mul(sam.rgb, TBN), GetMaterial2().normalMapStrength);
 		}
@@ -1809,6 +1891,7 @@ struct OutputPrepass
 		{
 			float2 uv = GetMaterial3().uvset_normalMap == 0 ? input.uvsets.xy : input.uvsets.zw;
 			sam.rgb = texture_blend3_normalmap.Sample(sampler_objectshader, uv).rgb;
+			sam.b = sam.b == 0 ? 1 : sam.b; // fix for missing blue channel
 			sam.rgb = sam.rgb * 2 - 1;
 			surface2.N = lerp(baseN, mul(sam.rgb, TBN), GetMaterial3().normalMapStrength);
 		}
@@ -1853,7 +1936,7 @@ struct OutputPrepass
 #ifndef OBJECTLOD
 	// Secondary occlusion map:
 	[branch]
-	if (GetMaterial().IsOcclusionEnabled_Secondary() && GetMaterial().uvset_occlusionMap >= 0)
+	if (OBJECTSHADER_FEATURE(OBJECTSHADER_PERMUTATION_OCCLUSIONMAP) && GetMaterial().IsOcclusionEnabled_Secondary() && GetMaterial().uvset_occlusionMap >= 0)
 	{
 		const float2 UV_occlusionMap = GetMaterial().uvset_occlusionMap == 0 ? input.uvsets.xy : input.uvsets.zw;
 		surface.occlusion *= texture_occlusionmap.Sample(sampler_objectshader, UV_occlusionMap).r;
@@ -21,11 +21,11 @@ void main(PSInput input)
 	float3 N = normalize(input.N);
 	float3 P = input.P;
 
-	float3 diff = (P - g_xFrame_VoxelRadianceDataCenter) * g_xFrame_VoxelRadianceDataRes_rcp * g_xFrame_VoxelRadianceDataSize_rcp;
-	float3 uvw = diff * float3(0.5f, -0.5f, 0.5f) + 0.5f;
+	// Only the region of the clipmap that is updated is written:
+	const int3 voxel = VoxelClipMapVoxel(P, xVoxelizer_ClipMap);
 
 	[branch]
-	if (is_saturated(uvw))
+	if (all(voxel >= xVoxelizer_RegionMin) && all(voxel < xVoxelizer_RegionMax))
 	{
 		float4 baseColor;
 		[branch]
@@ -320,8 +320,7 @@ void main(PSInput input)
 		uint normal_encoded = pack_unitvector(N);
 
 		// output:
-		uint3 writecoord = floor(uvw * g_xFrame_VoxelRadianceDataRes);
-		uint id = flatten3D(writecoord, g_xFrame_VoxelRadianceDataRes);
+		uint id = VoxelClipMapIndex(voxel, xVoxelizer_ClipMap);
 		InterlockedMax(output[id].colorMask, color_encoded);
 		InterlockedMax(output[id].normalMask, normal_encoded);
 	}
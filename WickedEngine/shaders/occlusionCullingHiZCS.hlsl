@@ -0,0 +1,36 @@
+#include "globals.hlsli"
+#include "ShaderInterop_Renderer.h"
+
+// Every cell of the occlusion culling grid is the farthest linear depth of its footprint in the full resolution lineardepth
+//	The lineardepth mips can't be used for this, because they are point sampled
+
+TEXTURE2D(input_lineardepth, float, OCCLUSIONCULLINGSLOT_IN_LINEARDEPTH);
+
+RWRAWBUFFER(output, 0);
+
+[numthreads(OCCLUSIONCULLING_HIZ_BLOCKSIZE, OCCLUSIONCULLING_HIZ_BLOCKSIZE, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	const uint2 cells = uint2(OCCLUSIONCULLING_HIZ_WIDTH, OCCLUSIONCULLING_HIZ_HEIGHT);
+	if (any(DTid.xy >= cells))
+	{
+		return;
+	}
+
+	uint2 dim;
+	input_lineardepth.GetDimensions(dim.x, dim.y);
+
+	// The footprints are rounded outwards, so neighbouring cells can share border texels:
+	const uint2 begin = min(DTid.xy * dim / cells, dim - 1);
+	const uint2 end = min(max(begin + 1, ((DTid.xy + 1) * dim + cells - 1) / cells), dim);
+
+	float farthest = 0;
+	for (uint y = begin.y; y < end.y; ++y)
+	{
+		for (uint x = begin.x; x < end.x; ++x)
+		{
+			farthest = max(farthest, input_lineardepth[uint2(x, y)]);
+		}
+	}
+	output.Store((DTid.y * OCCLUSIONCULLING_HIZ_WIDTH + DTid.x) * 4, asuint(farthest));
+}
@@ -40,11 +40,9 @@ PSIn main(uint fakeIndex : SV_VERTEXID)
 	Out.pos.xy *= invdim;
 	Out.pos.xy += float2(instanceID % dimX, instanceID / dimX) * invdim;
 	float2 nextPos = Out.pos.xy + invdim;
-	Out.pos.xy = Out.pos.xy * 2 - 1;
-	Out.pos.xy *= max(1, xOceanSurfaceDisplacementTolerance); // extrude screen space grid to tolerate displacement
-
-	nextPos.xy = nextPos.xy * 2 - 1;
-	nextPos.xy *= max(1, xOceanSurfaceDisplacementTolerance);
+	// The screen rect is extruded beyond the screen to tolerate displacement, but it only covers the part where the ocean can be:
+	Out.pos.xy = lerp(xOceanScreenRect.xy, xOceanScreenRect.zw, Out.pos.xy);
+	nextPos.xy = lerp(xOceanScreenRect.xy, xOceanScreenRect.zw, nextPos.xy);
 
 	// Perform ray tracing of screen grid and plane surface to unproject to world space:
 	float3 o = g_xCamera_CamPos;
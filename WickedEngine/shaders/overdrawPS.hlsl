@@ -0,0 +1,6 @@
+// Counts the rasterized layers of the overdraw visualizer with additive blending
+//	There is no input, so it can follow the vertex output of any shader
+float4 main() : SV_TARGET
+{
+	return 1;
+}
@@ -0,0 +1,32 @@
+#include "globals.hlsli"
+#include "ShaderInterop_Postprocess.h"
+
+TEXTURE2D(input, float, TEXSLOT_ONDEMAND0);
+
+RWTEXTURE2D(output, unorm float4, 0);
+
+[numthreads(POSTPROCESS_BLOCKSIZE, POSTPROCESS_BLOCKSIZE, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	if (any(DTid.xy >= (uint2)xPPResolution))
+		return;
+
+	const float overdraw = input[DTid.xy];
+	const float maxHeat = xPPParams0.x;
+
+	// Same ramp as the light culling heatmap:
+	const float3 mapTex[] = {
+		float3(0,0,0),
+		float3(0,0,1),
+		float3(0,1,1),
+		float3(0,1,0),
+		float3(1,1,0),
+		float3(1,0,0),
+	};
+	const uint mapTexLen = 5;
+
+	float l = saturate(overdraw / maxHeat) * mapTexLen;
+	float3 a = mapTex[floor(l)];
+	float3 b = mapTex[ceil(l)];
+	output[DTid.xy] = float4(lerp(a, b, l - floor(l)), 0.8);
+}
@@ -0,0 +1,72 @@
+#ifndef WI_RADIX_SORT_HF
+#define WI_RADIX_SORT_HF
+#include "globals.hlsli"
+#include "ShaderInterop_GPUSortLib.h"
+
+// The including shader defines RADIX_SCAN_SIZE, the thread count of its groups
+
+RAWBUFFER(counterBuffer, 0);
+
+// The sorted element count of this frame
+inline uint GetRadixSortCount()
+{
+	return min(counterBuffer.Load(radix_counterReadOffset), radix_maxCount);
+}
+inline uint GetRadixSortBlockCount(uint count)
+{
+	return (count + GPUSORTLIB_RADIX_BLOCK_SIZE - 1) / GPUSORTLIB_RADIX_BLOCK_SIZE;
+}
+
+// The comparison values are floats, this maps them to unsigned integers with the same ordering
+//	Non-negative floats only get their sign bit flipped, so unsigned integers below 2^31 that are stored as floats keep their order too
+inline uint FloatToSortableKey(uint value)
+{
+	const uint mask = (uint)(-int(value >> 31)) | 0x80000000;
+	return value ^ mask;
+}
+
+groupshared uint radix_scan[RADIX_SCAN_SIZE];
+
+// Exclusive prefix sum of a value of every thread of the group, total is the sum of all values
+//	Every thread of the group must call it
+uint GroupExclusiveScan(uint value, uint groupIndex, out uint total)
+{
+#ifdef DISABLE_WAVE_INTRINSICS
+	radix_scan[groupIndex] = value;
+	GroupMemoryBarrierWithGroupSync();
+	for (uint offset = 1; offset < RADIX_SCAN_SIZE; offset <<= 1)
+	{
+		const uint other = groupIndex >= offset ? radix_scan[groupIndex - offset] : 0;
+		GroupMemoryBarrierWithGroupSync();
+		radix_scan[groupIndex] += other;
+		GroupMemoryBarrierWithGroupSync();
+	}
+	const uint inclusive = radix_scan[groupIndex];
+	total = radix_scan[RADIX_SCAN_SIZE - 1];
+	GroupMemoryBarrierWithGroupSync();
+	return inclusive - value;
+#else
+	// The waves scan their values, then the wave sums are added up:
+	const uint laneCount = WaveGetLaneCount();
+	const uint wave = groupIndex / laneCount;
+	const uint waveCount = (RADIX_SCAN_SIZE + laneCount - 1) / laneCount;
+	const uint prefix = WavePrefixSum(value);
+	if (WaveGetLaneIndex() == laneCount - 1)
+	{
+		radix_scan[wave] = prefix + value;
+	}
+	GroupMemoryBarrierWithGroupSync();
+	uint waveOffset = 0;
+	total = 0;
+	for (uint i = 0; i < waveCount; ++i)
+	{
+		const uint sum = radix_scan[i];
+		waveOffset += i < wave ? sum : 0;
+		total += sum;
+	}
+	GroupMemoryBarrierWithGroupSync();
+	return waveOffset + prefix;
+#endif // DISABLE_WAVE_INTRINSICS
+}
+
+#endif // WI_RADIX_SORT_HF
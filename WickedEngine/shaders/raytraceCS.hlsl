@@ -7,12 +7,18 @@
 RWTEXTURE2D(output, float4, 0);
 RWTEXTURE2D(output_albedo, float4, 1);
 RWTEXTURE2D(output_normal, float4, 2);
+RWTEXTURE2D(output_moment, float, 3);
+RWSTRUCTUREDBUFFER(output_tileerrors, uint, 4);
 
+STRUCTUREDBUFFER(tiles, RaytracingTile, TEXSLOT_ONDEMAND6);
+
+// Every Z group is a tile of RAYTRACING_TILE_SIZE pixels, with its own sample index
 [numthreads(RAYTRACING_LAUNCH_BLOCKSIZE, RAYTRACING_LAUNCH_BLOCKSIZE, 1)]
-void main(uint3 DTid : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex)
+void main(uint3 DTid : SV_DispatchThreadID, uint3 Gid : SV_GroupID, uint groupIndex : SV_GroupIndex)
 {
-	uint2 pixel = DTid.xy;
-	if (pixel.x >= xTraceResolution.x || pixel.y >= xTraceResolution.y)
+	const RaytracingTile tile = tiles[Gid.z];
+	uint2 pixel = tile.offset + DTid.xy;
+	if (DTid.x >= RAYTRACING_TILE_SIZE || DTid.y >= RAYTRACING_TILE_SIZE || pixel.x >= xTraceResolution.x || pixel.y >= xTraceResolution.y)
 	{
 		return;
 	}
@@ -24,8 +30,8 @@ void main(uint3 DTid : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex)
 	float3 primary_normal = 0;
 
 	// Compute screen coordinates:
-	float2 uv = float2((pixel + xTracePixelOffset) * xTraceResolution_rcp.xy * 2 - 1) * float2(1, -1);
-	float seed = xTraceAccumulationFactor;
+	float2 uv = float2((pixel + tile.pixelOffset) * xTraceResolution_rcp.xy * 2 - 1) * float2(1, -1);
+	float seed = tile.accumulationFactor;
 
 	// Create starting ray:
 	RayDesc ray = CreateCameraRay(uv);
@@ -355,13 +361,25 @@ void main(uint3 DTid : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex)
 	}
 
 	// Pre-clear result texture for first bounce and first accumulation sample:
-	if (xTraceSampleIndex == 0)
+	if (tile.sampleIndex == 0)
 	{
 		output[pixel] = 0;
 		output_albedo[pixel] = 0;
 		output_normal[pixel] = 0;
+		output_moment[pixel] = 0;
 	}
-	output[pixel] = lerp(output[pixel], float4(result, 1), xTraceAccumulationFactor);
-	output_albedo[pixel] = lerp(output_albedo[pixel], float4(primary_albedo, 1), xTraceAccumulationFactor);
-	output_normal[pixel] = lerp(output_normal[pixel], float4(primary_normal, 1), xTraceAccumulationFactor);
+	const float4 accumulated = lerp(output[pixel], float4(result, 1), tile.accumulationFactor);
+	output[pixel] = accumulated;
+	output_albedo[pixel] = lerp(output_albedo[pixel], float4(primary_albedo, 1), tile.accumulationFactor);
+	output_normal[pixel] = lerp(output_normal[pixel], float4(primary_normal, 1), tile.accumulationFactor);
+
+	// Error estimate for adaptive sampling, the standard error of the mean luminance from its second moment
+	//	It is relative to the square root of the luminance, so that the dark regions are not oversampled:
+	const float luminance = dot(result, float3(0.2126, 0.7152, 0.0722));
+	const float moment = lerp(output_moment[pixel], luminance * luminance, tile.accumulationFactor);
+	output_moment[pixel] = moment;
+	const float mean = dot(accumulated.rgb, float3(0.2126, 0.7152, 0.0722));
+	const float variance = max(0, moment - mean * mean);
+	const float error = sqrt(variance * tile.accumulationFactor) / (sqrt(max(0, mean)) + 0.01);
+	InterlockedAdd(output_tileerrors[tile.errorIndex], (uint)(min(error, RAYTRACING_TILE_ERROR_MAX) * RAYTRACING_TILE_ERROR_SCALE));
 }
@@ -3,13 +3,19 @@
 
 static const uint THREAD_COUNT = 64;
 
+TEXTURE2D(texture_previous, float4, TEXSLOT_ONDEMAND0);
+
 RWTEXTURE2D(output, uint, 0);
 
 #ifdef DEBUG_SHADINGRATECLASSIFICATION
 RWTEXTURE2D(output_debug, float4, 1);
 #endif // DEBUG_SHADINGRATECLASSIFICATION
 
+RWTEXTURE2D(output_transparent, uint, 2);
+
 groupshared uint tile_rate;
+groupshared uint tile_luminance_sum;
+groupshared uint tile_luminance_sum_squared;
 
 [numthreads(THREAD_COUNT, 1, 1)]
 void main( uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID, uint groupIndex : SV_GroupIndex )
@@ -17,6 +23,8 @@ void main( uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID, uint groupInde
 	if (groupIndex == 0)
 	{
 		tile_rate = 0xFF;
+		tile_luminance_sum = 0;
+		tile_luminance_sum_squared = 0;
 	}
 	GroupMemoryBarrierWithGroupSync();
 
@@ -33,8 +41,8 @@ void main( uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID, uint groupInde
 		const uint2 tile_pixel = unflatten2D(i, xShadingRateTileSize);
 		const uint2 pixel = min(tile * xShadingRateTileSize + tile_pixel, dim - 1);
 
-		const float2 velocity = abs(texture_gbuffer2[pixel].xy);
-		const float magnitude = max(velocity.x, velocity.y);
+		const float2 velocity = texture_gbuffer2[pixel].xy;
+		const float magnitude = max(abs(velocity.x), abs(velocity.y));
 
 		uint rate = 0;
 		if (magnitude > 0.1f)
@@ -59,15 +67,68 @@ void main( uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID, uint groupInde
 			// most detailed
 			rate = SHADING_RATE_1X1;
 		}
+
+		// The pixels that depth of field will blur can be shaded coarser, the circle of confusion is in pixels:
+		if (xShadingRateCoCScale > 0)
+		{
+			const float lineardepth = texture_lineardepth[pixel];
+			const float coc = min(xShadingRateMaxCoC, xShadingRateCoCScale * pow(abs(1 - xShadingRateFocus / lineardepth), 2.0f));
+			if (coc > 8)
+			{
+				rate = max(rate, SHADING_RATE_4X4);
+			}
+			else if (coc > 4)
+			{
+				rate = max(rate, SHADING_RATE_2X2);
+			}
+			else if (coc > 2)
+			{
+				rate = max(rate, SHADING_RATE_2X1);
+			}
+		}
 		InterlockedMin(tile_rate, rate);
+
+		// The luminance is tonemapped so that the variance is perceptual, and it is read from where the pixel was in the previous frame:
+		if (xShadingRateOptions & SHADINGRATE_OPTION_LUMINANCE)
+		{
+			const float2 uv = (pixel + 0.5f) / (float2)dim + velocity;
+			const float3 color = texture_previous.SampleLevel(sampler_linear_clamp, uv, 0).rgb;
+			const float luminance = dot(color, float3(0.2126, 0.7152, 0.0722));
+			const uint quantized = (uint)(saturate(luminance / (1 + luminance)) * 255);
+			InterlockedAdd(tile_luminance_sum, quantized);
+			InterlockedAdd(tile_luminance_sum_squared, quantized * quantized);
+		}
 	}
 
 	GroupMemoryBarrierWithGroupSync();
 
 	uint rate = tile_rate;
+
+	// A flat tile can be shaded coarser, the standard deviation is in the 0..1 range of the tonemapped luminance:
+	if (xShadingRateOptions & SHADINGRATE_OPTION_LUMINANCE)
+	{
+		const float mean = tile_luminance_sum / 255.0f / sqrtile;
+		const float mean_squared = tile_luminance_sum_squared / (255.0f * 255.0f) / sqrtile;
+		const float deviation = sqrt(max(0, mean_squared - mean * mean));
+		if (deviation < 0.005f)
+		{
+			rate = max(rate, SHADING_RATE_4X4);
+		}
+		else if (deviation < 0.015f)
+		{
+			rate = max(rate, SHADING_RATE_2X2);
+		}
+		else if (deviation < 0.03f)
+		{
+			rate = max(rate, SHADING_RATE_2X1);
+		}
+	}
+	rate = min(rate, xShadingRateCoarsestOpaque);
+
 	if (groupIndex == 0)
 	{
 		output[tile] = rate;
+		output_transparent[tile] = min(rate, xShadingRateCoarsestTransparent);
 	}
 
 #ifdef DEBUG_SHADINGRATECLASSIFICATION
@@ -88,7 +149,7 @@ void main( uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID, uint groupInde
 		else if (rate == SHADING_RATE_1X2 || rate == SHADING_RATE_2X1)
 			debugcolor = float4(0, 0, 1, debugalpha);
 
-		if (tile_pixel.x == 0 || tile_pixel.x == xShadingRateTileSize - 1 || 
+		if (tile_pixel.x == 0 || tile_pixel.x == xShadingRateTileSize - 1 ||
 			tile_pixel.y == 0 || tile_pixel.y == xShadingRateTileSize - 1)
 			debugcolor = float4(0, 0, 0, debugalpha);
 
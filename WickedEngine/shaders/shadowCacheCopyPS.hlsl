@@ -0,0 +1,23 @@
+#include "globals.hlsli"
+
+// Writes the depth of the cached static shadow casters, the dynamic casters are rendered on top of it
+//	g_xColor.xy: top left corner of the viewport, the cache is stored from its top left corner
+//	g_xColor.z: first source slice, g_xColor.w: offset of the depth that is not cleared
+//	It also moves the content of scrolled directional light cascades, the texels without source are written as cleared
+TEXTURE2DARRAY(cache, float, TEXSLOT_ONDEMAND0);
+
+float main(float4 pos : SV_Position, nointerpolation uint slice : SLICE) : SV_DEPTH
+{
+	uint3 dim;
+	cache.GetDimensions(dim.x, dim.y, dim.z);
+	const int2 coord = int2(pos.xy) - int2(g_xColor.xy);
+
+	[branch]
+	if (any(coord < 0) || any(coord >= int2(dim.xy)))
+	{
+		return 0;
+	}
+
+	const float depth = cache[uint3(coord, slice + (uint)g_xColor.z)];
+	return depth > 0 ? depth + g_xColor.w : 0;
+}
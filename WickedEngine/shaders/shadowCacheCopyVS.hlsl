@@ -0,0 +1,18 @@
+#include "globals.hlsli"
+
+// Full screen triangle for every array slice of a shadow map, the slice is selected by the instance
+struct VSOut
+{
+	float4 pos : SV_Position;
+	nointerpolation uint slice : SLICE;
+	uint RTIndex : SV_RenderTargetArrayIndex;
+};
+
+VSOut main(uint vertexID : SV_VertexID, uint instanceID : SV_InstanceID)
+{
+	VSOut Out;
+	FullScreenTriangle(vertexID, Out.pos);
+	Out.slice = instanceID;
+	Out.RTIndex = instanceID;
+	return Out;
+}
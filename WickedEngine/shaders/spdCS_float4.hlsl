@@ -0,0 +1,295 @@
+#include "globals.hlsli"
+#include "ShaderInterop_Utility.h"
+
+// Single pass downsampler: up to SPD_MAX_MIPS mips of a 2D texture are generated by one dispatch
+//	Every group reduces a 64x64 tile of the input to 6 mips in groupshared memory, then the group that finishes last
+//	(counted with an atomic) reduces the 1x1 results of all the groups to the rest of the mips
+//	The footprint of a texel is averaged, or with SPD_REDUCE_MAX the max is taken and the last row and column of every mip
+//	also cover the input that doesn't fit into the floor sized mips, so the chain is conservative (Hi-Z)
+
+#ifndef SPD_OUTPUT_FORMAT
+#define SPD_OUTPUT_FORMAT float4
+#endif
+
+#ifdef SPD_REDUCE_MAX
+#define SPD_COHERENT globallycoherent // the last group reads back the outputs of the others
+#else
+#define SPD_COHERENT
+#endif
+
+TEXTURE2D(input, float4, TEXSLOT_ONDEMAND0);
+
+SPD_COHERENT RWTEXTURE2D(output_mip0, SPD_OUTPUT_FORMAT, 0);
+SPD_COHERENT RWTEXTURE2D(output_mip1, SPD_OUTPUT_FORMAT, 1);
+SPD_COHERENT RWTEXTURE2D(output_mip2, SPD_OUTPUT_FORMAT, 2);
+SPD_COHERENT RWTEXTURE2D(output_mip3, SPD_OUTPUT_FORMAT, 3);
+SPD_COHERENT RWTEXTURE2D(output_mip4, SPD_OUTPUT_FORMAT, 4);
+SPD_COHERENT RWTEXTURE2D(output_mip5, SPD_OUTPUT_FORMAT, 5);
+SPD_COHERENT RWTEXTURE2D(output_mip6, SPD_OUTPUT_FORMAT, 6);
+SPD_COHERENT RWTEXTURE2D(output_mip7, SPD_OUTPUT_FORMAT, 7);
+SPD_COHERENT RWTEXTURE2D(output_mip8, SPD_OUTPUT_FORMAT, 8);
+SPD_COHERENT RWTEXTURE2D(output_mip9, SPD_OUTPUT_FORMAT, 9);
+SPD_COHERENT RWTEXTURE2D(output_mip10, SPD_OUTPUT_FORMAT, 10);
+SPD_COHERENT RWTEXTURE2D(output_mip11, SPD_OUTPUT_FORMAT, 11);
+
+RWRAWBUFFER(counter, SPD_SLOT_COUNTER);
+globallycoherent RWSTRUCTUREDBUFFER(intermediate, float4, SPD_SLOT_INTERMEDIATE); // 1x1 result of every group
+#ifdef SPD_REDUCE_MAX
+globallycoherent RWSTRUCTUREDBUFFER(edges, float, SPD_SLOT_EDGES); // the texels just outside of the last column and row of every mip
+#endif
+
+groupshared float4 tile[32][32];
+groupshared bool lastGroup;
+
+float4 Reduce(float4 a, float4 b, float4 c, float4 d)
+{
+#ifdef SPD_REDUCE_MAX
+	return max(max(a, b), max(c, d));
+#else
+	return (a + b + c + d) * 0.25f;
+#endif
+}
+
+#ifdef SPD_REDUCE_MAX
+#define SPD_VALUE(value) value.x
+#else
+#define SPD_VALUE(value) value
+#endif
+
+// The writes outside of the mip are discarded, so the groups that are partly outside don't have to check:
+#define SPD_CASE_STORE(index) case index: output_mip##index[pixel] = SPD_VALUE(value); break;
+void Store(uint mip, uint2 pixel, float4 value)
+{
+	switch (mip)
+	{
+		SPD_CASE_STORE(0)
+		SPD_CASE_STORE(1)
+		SPD_CASE_STORE(2)
+		SPD_CASE_STORE(3)
+		SPD_CASE_STORE(4)
+		SPD_CASE_STORE(5)
+		SPD_CASE_STORE(6)
+		SPD_CASE_STORE(7)
+		SPD_CASE_STORE(8)
+		SPD_CASE_STORE(9)
+		SPD_CASE_STORE(10)
+		SPD_CASE_STORE(11)
+	}
+}
+
+#ifdef SPD_REDUCE_MAX
+#define SPD_CASE_DIMENSIONS(index) case index: output_mip##index.GetDimensions(dim.x, dim.y); break;
+uint2 GetMipDimensions(uint mip)
+{
+	uint2 dim = 0;
+	switch (mip)
+	{
+		SPD_CASE_DIMENSIONS(0)
+		SPD_CASE_DIMENSIONS(1)
+		SPD_CASE_DIMENSIONS(2)
+		SPD_CASE_DIMENSIONS(3)
+		SPD_CASE_DIMENSIONS(4)
+		SPD_CASE_DIMENSIONS(5)
+		SPD_CASE_DIMENSIONS(6)
+		SPD_CASE_DIMENSIONS(7)
+		SPD_CASE_DIMENSIONS(8)
+		SPD_CASE_DIMENSIONS(9)
+		SPD_CASE_DIMENSIONS(10)
+		SPD_CASE_DIMENSIONS(11)
+	}
+	return dim;
+}
+
+#define SPD_CASE_LOAD(index) case index: return output_mip##index[pixel];
+float LoadOutput(uint mip, uint2 pixel)
+{
+	switch (mip)
+	{
+		SPD_CASE_LOAD(0)
+		SPD_CASE_LOAD(1)
+		SPD_CASE_LOAD(2)
+		SPD_CASE_LOAD(3)
+		SPD_CASE_LOAD(4)
+		SPD_CASE_LOAD(5)
+		SPD_CASE_LOAD(6)
+		SPD_CASE_LOAD(7)
+		SPD_CASE_LOAD(8)
+		SPD_CASE_LOAD(9)
+		SPD_CASE_LOAD(10)
+		SPD_CASE_LOAD(11)
+	}
+	return 0;
+}
+
+// A texel of mip N covers the input [x << (N + 1), (x + 1) << (N + 1)), the input after the last texel is the band that it also has to cover
+bool2 HasBand(uint mip, uint2 dim)
+{
+	return (dim << (mip + 1)) < spdInputResolution;
+}
+#endif // SPD_REDUCE_MAX
+
+void Emit(uint mip, uint2 pixel, float4 value)
+{
+	Store(mip, pixel, value);
+
+#ifdef SPD_REDUCE_MAX
+	// The texel after the last column or row covers the band, it is kept for the fixup in the last group:
+	const uint2 dim = GetMipDimensions(mip);
+	if (pixel.x == dim.x && pixel.y <= dim.y)
+	{
+		edges[(mip * 2 + 0) * SPD_EDGE_STRIDE + pixel.y] = value.x;
+	}
+	if (pixel.y == dim.y && pixel.x <= dim.x)
+	{
+		edges[(mip * 2 + 1) * SPD_EDGE_STRIDE + pixel.x] = value.x;
+	}
+#endif // SPD_REDUCE_MAX
+}
+
+// Reduces the size * 2 square at the top left of the tile to size, in place, offset is the position of the tile in the mip in tiles
+void DownsampleTile(uint groupIndex, uint size, uint mip, uint2 offset)
+{
+	const bool active = groupIndex < size * size;
+	const uint2 p = uint2(groupIndex % size, groupIndex / size);
+	float4 value = 0;
+	if (active)
+	{
+		value = Reduce(
+			tile[p.y * 2 + 0][p.x * 2 + 0],
+			tile[p.y * 2 + 0][p.x * 2 + 1],
+			tile[p.y * 2 + 1][p.x * 2 + 0],
+			tile[p.y * 2 + 1][p.x * 2 + 1]
+		);
+	}
+	GroupMemoryBarrierWithGroupSync();
+	if (active)
+	{
+		tile[p.y][p.x] = value;
+		Emit(mip, offset * size + p, value);
+	}
+	GroupMemoryBarrierWithGroupSync();
+}
+
+float4 LoadInput(uint2 pixel)
+{
+	return input[min(pixel, spdInputResolution - 1)];
+}
+
+float4 LoadIntermediate(uint2 group)
+{
+	group = min(group, spdGroupResolution - 1);
+	return intermediate[group.y * SPD_INTERMEDIATE_SIZE + group.x];
+}
+
+[numthreads(SPD_THREADCOUNT, 1, 1)]
+void main(uint3 Gid : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+	uint i;
+	uint mip;
+	uint size;
+
+	// The first mip of the tile is reduced from the input, every thread does 4 texels:
+	for (i = groupIndex; i < 32 * 32; i += SPD_THREADCOUNT)
+	{
+		const uint2 p = uint2(i % 32, i / 32);
+		const uint2 pixel = Gid.xy * 32 + p;
+		const float4 value = Reduce(
+			LoadInput(pixel * 2 + uint2(0, 0)),
+			LoadInput(pixel * 2 + uint2(1, 0)),
+			LoadInput(pixel * 2 + uint2(0, 1)),
+			LoadInput(pixel * 2 + uint2(1, 1))
+		);
+		tile[p.y][p.x] = value;
+		Emit(0, pixel, value);
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	for (mip = 1, size = 16; mip < min(spdMipCount, 6); ++mip, size /= 2)
+	{
+		DownsampleTile(groupIndex, size, mip, Gid.xy);
+	}
+
+#ifndef SPD_REDUCE_MAX
+	if (spdMipCount <= 6)
+		return;
+#endif // SPD_REDUCE_MAX
+
+	if (groupIndex == 0 && spdMipCount > 6)
+	{
+		intermediate[Gid.y * SPD_INTERMEDIATE_SIZE + Gid.x] = tile[0][0];
+	}
+
+	// Every write of the group has to be visible before it is counted as finished:
+	DeviceMemoryBarrierWithGroupSync();
+	if (groupIndex == 0)
+	{
+		uint finished;
+		counter.InterlockedAdd(0, 1, finished);
+		lastGroup = finished == spdGroupCount - 1;
+	}
+	GroupMemoryBarrierWithGroupSync();
+	if (!lastGroup)
+		return;
+
+	if (groupIndex == 0)
+	{
+		counter.Store(0, 0); // reset for the next dispatch
+	}
+
+	if (spdMipCount > 6)
+	{
+		// The rest of the mips are reduced from the results of the groups, that are at most 64x64:
+		for (i = groupIndex; i < 32 * 32; i += SPD_THREADCOUNT)
+		{
+			const uint2 p = uint2(i % 32, i / 32);
+			const float4 value = Reduce(
+				LoadIntermediate(p * 2 + uint2(0, 0)),
+				LoadIntermediate(p * 2 + uint2(1, 0)),
+				LoadIntermediate(p * 2 + uint2(0, 1)),
+				LoadIntermediate(p * 2 + uint2(1, 1))
+			);
+			tile[p.y][p.x] = value;
+			Emit(6, p, value);
+		}
+		GroupMemoryBarrierWithGroupSync();
+
+		for (mip = 7, size = 16; mip < spdMipCount; ++mip, size /= 2)
+		{
+			DownsampleTile(groupIndex, size, mip, 0);
+		}
+	}
+
+#ifdef SPD_REDUCE_MAX
+	// The last column, then the last row of every mip is merged with the band after it (the corner with both):
+	DeviceMemoryBarrierWithGroupSync();
+	for (mip = 0; mip < spdMipCount; ++mip)
+	{
+		const uint2 dim = GetMipDimensions(mip);
+		const bool2 band = HasBand(mip, dim);
+		if (band.x)
+		{
+			for (i = groupIndex; i < dim.y; i += SPD_THREADCOUNT)
+			{
+				const uint2 pixel = uint2(dim.x - 1, i);
+				float value = max(LoadOutput(mip, pixel), edges[(mip * 2 + 0) * SPD_EDGE_STRIDE + i]);
+				Store(mip, pixel, value);
+			}
+		}
+		DeviceMemoryBarrierWithGroupSync();
+		if (band.y)
+		{
+			for (i = groupIndex; i < dim.x; i += SPD_THREADCOUNT)
+			{
+				const uint2 pixel = uint2(i, dim.y - 1);
+				float value = max(LoadOutput(mip, pixel), edges[(mip * 2 + 1) * SPD_EDGE_STRIDE + i]);
+				if (band.x && i == dim.x - 1)
+				{
+					value = max(value, edges[(mip * 2 + 1) * SPD_EDGE_STRIDE + dim.x]);
+				}
+				Store(mip, pixel, value);
+			}
+		}
+		DeviceMemoryBarrierWithGroupSync();
+	}
+#endif // SPD_REDUCE_MAX
+}
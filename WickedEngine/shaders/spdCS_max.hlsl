@@ -0,0 +1,4 @@
+#define SPD_REDUCE_MAX
+#define SPD_OUTPUT_FORMAT float
+
+#include "spdCS_float4.hlsl"
@@ -0,0 +1,3 @@
+#define SPD_OUTPUT_FORMAT unorm float4
+
+#include "spdCS_float4.hlsl"
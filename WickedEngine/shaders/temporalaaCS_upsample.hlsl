@@ -0,0 +1,79 @@
+#include "globals.hlsli"
+#include "ShaderInterop_Postprocess.h"
+
+// Temporal upscaling: the current frame is rendered at a lower resolution with the jitter, and accumulated into the history at the output resolution
+//	Every output pixel reconstructs the current frame from the 3x3 input pixels around it, weighted by the distance of their jittered sample positions
+//	A sample that lands close to the output pixel is blended in faster, so over the jitter sequence every output pixel converges to its own detail
+
+TEXTURE2D(input_current, float3, TEXSLOT_ONDEMAND0);
+TEXTURE2D(input_history, float3, TEXSLOT_ONDEMAND1);
+
+RWTEXTURE2D(output, float3, 0);
+
+[numthreads(POSTPROCESS_BLOCKSIZE, POSTPROCESS_BLOCKSIZE, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	const float2 uv = (DTid.xy + 0.5f) * xPPResolution_rcp;
+
+	// The input was rasterized with the jitter offset, the unjittered output pixel is at this position of the input (in pixels):
+	const float2 position = (uv + g_xFrame_TemporalAAJitter * float2(0.5f, -0.5f)) * temporalaa_input_resolution;
+	const int2 center = int2(floor(position));
+	const int2 last = int2(temporalaa_input_resolution) - 1;
+
+	// Reconstruct the current frame, search for best velocity and compute color clamping range in 3x3 neighborhood (in tonemapped space, so that bright samples don't dominate):
+	float3 neighborhoodMin = 100000;
+	float3 neighborhoodMax = -100000;
+	float3 current = 0;
+	float weightSum = 0;
+	float confidence = 0;
+	float bestDepth = 1;
+	int2 bestPixel = clamp(center, 0, last);
+	for (int x = -1; x <= 1; ++x)
+	{
+		for (int y = -1; y <= 1; ++y)
+		{
+			const int2 pixel = clamp(center + int2(x, y), 0, last);
+
+			const float3 neighbor = tonemap(input_current[pixel].rgb);
+			neighborhoodMin = min(neighborhoodMin, neighbor);
+			neighborhoodMax = max(neighborhoodMax, neighbor);
+
+			// Gaussian fit of the Blackman-Harris window, with the distance in input pixels:
+			const float2 offset = pixel + 0.5f - position;
+			const float weight = exp(-2.29f * dot(offset, offset));
+			current += neighbor * weight;
+			weightSum += weight;
+			confidence = max(confidence, weight);
+
+			const float depth = texture_lineardepth[pixel];
+			if (depth < bestDepth)
+			{
+				bestDepth = depth;
+				bestPixel = pixel;
+			}
+		}
+	}
+	current /= weightSum;
+	const float2 velocity = texture_gbuffer2[bestPixel].xy;
+
+	const float2 prevUV = uv + velocity;
+
+	// the history is at the output resolution, the linear filter is corrected below like in the regular resolve:
+	float3 history = tonemap(input_history.SampleLevel(sampler_linear_clamp, prevUV, 0).rgb);
+
+	// simple correction of image signal incoherency (eg. moving shadows or lighting changes):
+	history = clamp(history, neighborhoodMin, neighborhoodMax);
+
+	// the linear filtering can cause blurry image, try to account for that:
+	const float subpixelCorrection = frac(max(abs(velocity.x) * xPPResolution.x, abs(velocity.y) * xPPResolution.y)) * 0.5f;
+
+	// the current frame is trusted less where its closest sample is far from the output pixel:
+	float blendfactor = saturate(lerp(0.05f, 0.8f, subpixelCorrection)) * confidence;
+
+	// if information can not be found on the screen, revert to the reconstructed image:
+	blendfactor = is_saturated(prevUV) ? blendfactor : 1.0f;
+
+	const float3 resolved = lerp(history, current, blendfactor);
+
+	output[DTid.xy] = inverseTonemap(resolved);
+}
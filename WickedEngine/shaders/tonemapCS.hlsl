@@ -72,55 +72,60 @@ float3 ACESFitted(float3 color)
 	return color;
 }
 
-[numthreads(POSTPROCESS_BLOCKSIZE, POSTPROCESS_BLOCKSIZE, 1)]
-void main(uint3 DTid : SV_DispatchThreadID)
-{
 #ifdef BINDLESS
-	const float2 uv = (DTid.xy + 0.5f) * push.xPPResolution_rcp;
-	float exposure = push.exposure;
-	const bool is_dither = push.dither != 0;
-	const bool is_colorgrading = push.texture_colorgrade_lookuptable >= 0;
-	const bool is_eyeadaption = push.texture_input_luminance >= 0;
-	const bool is_distortion = push.texture_input_distortion >= 0;
+#define tonemap_resolution_rcp push.xPPResolution_rcp
+#define tonemap_sharpen_amount push.sharpen
+#define tonemap_chromatic_aberration_amount push.chromatic_aberration
+#else
+#define tonemap_resolution_rcp xPPResolution_rcp
+#define tonemap_sharpen_amount tonemap_sharpen
+#define tonemap_chromatic_aberration_amount tonemap_chromatic_aberration
+#endif // BINDLESS
 
+float4 SampleHDR(float2 uv)
+{
 	float2 distortion = 0;
+#ifdef BINDLESS
 	[branch]
-	if (is_distortion)
+	if (push.texture_input_distortion >= 0)
 	{
 		distortion = bindless_textures[push.texture_input_distortion].SampleLevel(sampler_linear_clamp, uv, 0).rg;
 	}
-
-	float4 hdr = bindless_textures[push.texture_input].SampleLevel(sampler_linear_clamp, uv + distortion, 0);
-
-	[branch]
-	if (is_eyeadaption)
-	{
-		exposure *= push.eyeadaptionkey / max(bindless_textures[push.texture_input_luminance][uint2(0, 0)].r, 0.0001);
-	}
+	return bindless_textures[push.texture_input].SampleLevel(sampler_linear_clamp, uv + distortion, 0);
 #else
-	const float2 uv = (DTid.xy + 0.5f) * xPPResolution_rcp;
-	float exposure = tonemap_exposure;
-	const bool is_dither = tonemap_dither != 0;
-	const bool is_colorgrading = tonemap_colorgrading != 0;
-	const bool is_eyeadaption = tonemap_eyeadaption != 0;
-	const bool is_distortion = tonemap_distortion != 0;
-
-	float2 distortion = 0;
 	[branch]
-	if (is_distortion)
+	if (tonemap_distortion != 0)
 	{
 		distortion = input_distortion.SampleLevel(sampler_linear_clamp, uv, 0).rg;
 	}
+	return input.SampleLevel(sampler_linear_clamp, uv + distortion, 0);
+#endif // BINDLESS
+}
 
-	float4 hdr = input.SampleLevel(sampler_linear_clamp, uv + distortion, 0);
-
-	[branch]
-	if (is_eyeadaption)
-	{
-		exposure *= tonemap_eyeadaptionkey / max(input_luminance[uint2(0, 0)].r, 0.0001);
-	}
+// Returns the final LDR color of one location, the pixel is only used for the dithering pattern
+float4 Tonemap(float2 uv, int2 pixel, float exposure)
+{
+#ifdef BINDLESS
+	const bool is_dither = push.dither != 0;
+	const bool is_colorgrading = push.texture_colorgrade_lookuptable >= 0;
+#else
+	const bool is_dither = tonemap_dither != 0;
+	const bool is_colorgrading = tonemap_colorgrading != 0;
 #endif // BINDLESS
 
+#ifdef TONEMAP_CHROMATIC_ABERRATION
+	// The color channels are taken from displaced locations, instead of doing it in a separate pass over the LDR image:
+	const float2 distortion = (uv - 0.5f) * tonemap_chromatic_aberration_amount * tonemap_resolution_rcp;
+	float4 hdr = float4(
+		SampleHDR(uv + distortion).r,
+		SampleHDR(uv).g,
+		SampleHDR(uv - distortion).b,
+		1
+	);
+#else
+	float4 hdr = SampleHDR(uv);
+#endif // TONEMAP_CHROMATIC_ABERRATION
+
 	hdr.rgb *= exposure;
 
 	//#ifdef GGREDUCED
@@ -131,7 +136,7 @@ void main(uint3 DTid : SV_DispatchThreadID)
 	//#endif
 
 #if 0 // DEBUG luminance
-	if(DTid.x<800)
+	if(pixel.x<800)
 		ldr = average_luminance;
 #endif
 
@@ -150,9 +155,44 @@ void main(uint3 DTid : SV_DispatchThreadID)
 	if (is_dither)
 	{
 		// dithering before outputting to SDR will reduce color banding:
-		ldr.rgb += (dither((float2)DTid.xy) - 0.5f) / 64.0f;
+		ldr.rgb += (dither((float2)pixel) - 0.5f) / 64.0f;
 	}
 
+	return ldr;
+}
+
+[numthreads(POSTPROCESS_BLOCKSIZE, POSTPROCESS_BLOCKSIZE, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	const float2 uv = (DTid.xy + 0.5f) * tonemap_resolution_rcp;
+
+#ifdef BINDLESS
+	float exposure = push.exposure;
+	[branch]
+	if (push.texture_input_luminance >= 0)
+	{
+		exposure *= push.eyeadaptionkey / max(bindless_textures[push.texture_input_luminance][uint2(0, 0)].r, 0.0001);
+	}
+#else
+	float exposure = tonemap_exposure;
+	[branch]
+	if (tonemap_eyeadaption != 0)
+	{
+		exposure *= tonemap_eyeadaptionkey / max(input_luminance[uint2(0, 0)].r, 0.0001);
+	}
+#endif // BINDLESS
+
+	float4 ldr = Tonemap(uv, DTid.xy, exposure);
+
+#ifdef TONEMAP_SHARPEN
+	// The neighbors are tonemapped as well, so the sharpen filter doesn't need a separate pass over the LDR image:
+	const float4 top = Tonemap(uv + float2(0, -1) * tonemap_resolution_rcp, (int2)DTid.xy + int2(0, -1), exposure);
+	const float4 left = Tonemap(uv + float2(-1, 0) * tonemap_resolution_rcp, (int2)DTid.xy + int2(-1, 0), exposure);
+	const float4 right = Tonemap(uv + float2(1, 0) * tonemap_resolution_rcp, (int2)DTid.xy + int2(1, 0), exposure);
+	const float4 bottom = Tonemap(uv + float2(0, 1) * tonemap_resolution_rcp, (int2)DTid.xy + int2(0, 1), exposure);
+	ldr = saturate(ldr + (4 * ldr - top - bottom - left - right) * tonemap_sharpen_amount);
+#endif // TONEMAP_SHARPEN
+
 #ifdef BINDLESS
 	bindless_rwtextures[push.texture_output][DTid.xy] = ldr;
 #else
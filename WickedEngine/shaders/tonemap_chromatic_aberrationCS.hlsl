@@ -0,0 +1,2 @@
+#define TONEMAP_CHROMATIC_ABERRATION
+#include "tonemapCS.hlsl"
@@ -0,0 +1,2 @@
+#define TONEMAP_SHARPEN
+#include "tonemapCS.hlsl"
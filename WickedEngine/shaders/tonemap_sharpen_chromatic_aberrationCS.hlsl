@@ -0,0 +1,3 @@
+#define TONEMAP_SHARPEN
+#define TONEMAP_CHROMATIC_ABERRATION
+#include "tonemapCS.hlsl"
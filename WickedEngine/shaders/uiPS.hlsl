@@ -0,0 +1,23 @@
+#include "globals.hlsli"
+#include "ShaderInterop_UI.h"
+
+#ifdef BINDLESS
+Texture2D<float4> bindless_textures[] : register(space1);
+#define texture_ui	bindless_textures[g_xUI_TextureIndex]
+#else
+TEXTURE2D(texture_ui, float4, TEXSLOT_ONDEMAND0);
+#endif // BINDLESS
+
+SAMPLERSTATE(sampler_ui, SSLOT_ONDEMAND0);
+
+struct VertexToPixel
+{
+	float4 pos	: SV_POSITION;
+	float2 uv	: TEXCOORD0;
+	float4 col	: COLOR;
+};
+
+float4 main(VertexToPixel PSIn) : SV_TARGET
+{
+	return PSIn.col * texture_ui.Sample(sampler_ui, PSIn.uv);
+}
@@ -0,0 +1,20 @@
+#include "globals.hlsli"
+#include "ShaderInterop_UI.h"
+
+struct VertexToPixel
+{
+	float4 pos	: SV_POSITION;
+	float2 uv	: TEXCOORD0;
+	float4 col	: COLOR;
+};
+
+VertexToPixel main(float2 inPos : POSITION, float2 inUV : TEXCOORD0, float4 inCol : COLOR)
+{
+	VertexToPixel Out;
+
+	Out.pos = mul(g_xUI_Transform, float4(inPos, 0, 1));
+	Out.uv = inUV;
+	Out.col = inCol;
+
+	return Out;
+}
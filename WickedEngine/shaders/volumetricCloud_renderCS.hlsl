@@ -561,6 +561,14 @@ float CalculateAtmosphereBlend(float tDepth)
 
 static const uint2 g_HalfResIndexToCoordinateOffset[4] = { uint2(0, 0), uint2(1, 0), uint2(0, 1), uint2(1, 1) };
 
+// The pixel of the 4x4 block that is updated in each of the 16 frames, in Bayer order so that the updated pixels are spread evenly:
+static const uint2 g_BayerIndexToCoordinateOffset[16] = {
+	uint2(0, 0), uint2(2, 2), uint2(2, 0), uint2(0, 2),
+	uint2(1, 1), uint2(3, 3), uint2(3, 1), uint2(1, 3),
+	uint2(1, 0), uint2(3, 2), uint2(3, 0), uint2(1, 2),
+	uint2(0, 1), uint2(2, 3), uint2(2, 1), uint2(0, 3),
+};
+
 // Calculates checkerboard undersampling position
 int ComputeCheckerBoardIndex(int2 renderCoord, int subPixelIndex)
 {
@@ -572,9 +580,18 @@ int ComputeCheckerBoardIndex(int2 renderCoord, int subPixelIndex)
 [numthreads(POSTPROCESS_BLOCKSIZE, POSTPROCESS_BLOCKSIZE, 1)]
 void main(uint3 DTid : SV_DispatchThreadID)
 {
-	int subPixelIndex = g_xFrame_FrameCount % 4;
-	int checkerBoardIndex = ComputeCheckerBoardIndex(DTid.xy, subPixelIndex);
-	uint2 halfResCoord = DTid.xy * 2 + g_HalfResIndexToCoordinateOffset[checkerBoardIndex];
+	uint2 halfResCoord;
+	[branch]
+	if (volumetricclouds_blocksize > 2)
+	{
+		halfResCoord = DTid.xy * 4 + g_BayerIndexToCoordinateOffset[g_xFrame_FrameCount % 16];
+	}
+	else
+	{
+		int subPixelIndex = g_xFrame_FrameCount % 4;
+		int checkerBoardIndex = ComputeCheckerBoardIndex(DTid.xy, subPixelIndex);
+		halfResCoord = DTid.xy * 2 + g_HalfResIndexToCoordinateOffset[checkerBoardIndex];
+	}
 
 	const float2 uv = (halfResCoord + 0.5) * xPPParams0.zw;
     
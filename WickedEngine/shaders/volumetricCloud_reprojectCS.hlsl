@@ -29,10 +29,18 @@ float getInverseLinearDepth(float lin, float near, float far)
 	return (near - temp) / (lin - temp);
 }
 
+// The distance that the clouds moved with the wind since the previous frame, the density is sampled at the position + wind offset of the frame (see volumetricCloud_renderCS)
+float3 GetCloudMotion()
+{
+	float3 windDirection = float3(cos(g_xFrame_VolumetricClouds.WindAngle), -g_xFrame_VolumetricClouds.WindUpAmount, sin(g_xFrame_VolumetricClouds.WindAngle));
+	return -g_xFrame_VolumetricClouds.WindSpeed * g_xFrame_VolumetricClouds.AnimationMultiplier * windDirection * (g_xFrame_Time - g_xFrame_TimePrev);
+}
+
 [numthreads(POSTPROCESS_BLOCKSIZE, POSTPROCESS_BLOCKSIZE, 1)]
 void main(uint3 DTid : SV_DispatchThreadID)
 {
-	uint2 renderCoord = DTid.xy / 2;
+	const uint blocksize = (uint)volumetricclouds_blocksize;
+	uint2 renderCoord = DTid.xy / blocksize;
 	const float2 uv = (DTid.xy + 0.5f) * xPPResolution_rcp;
 	
 #if 0
@@ -61,8 +69,11 @@ void main(uint3 DTid : SV_DispatchThreadID)
 	
 	float4 thisClip = float4(screenPosition, currentCloudDepth, 1.0);
 	
-	float4 prevClip = mul(g_xCamera_InvVP, thisClip);
-	prevClip = mul(g_xCamera_PrevVP, prevClip);
+	// The cloud was at the previous frame where it is now minus the distance it moved with the wind:
+	float4 worldPosition = mul(g_xCamera_InvVP, thisClip);
+	worldPosition.xyz = worldPosition.xyz / worldPosition.w - GetCloudMotion();
+	worldPosition.w = 1;
+	float4 prevClip = mul(g_xCamera_PrevVP, worldPosition);
 	
 	//float4 prevClip = mul(g_xCamera_PrevVP, worldPosition);
 	float2 prevScreen = prevClip.xy / prevClip.w;
@@ -72,13 +83,23 @@ void main(uint3 DTid : SV_DispatchThreadID)
     
 #endif
 	
-	bool validHistory = is_saturated(prevUV);
+	bool validHistory = is_saturated(prevUV) && volumetricclouds_historyreset == 0;
 
-	int subPixelIndex = g_xFrame_FrameCount % 4;
-	int localIndex = (DTid.x & 1) + (DTid.y & 1) * 2;
-	int currentIndex = ComputeCheckerBoardIndex(renderCoord, subPixelIndex);
-	
-	bool shouldUpdatePixel = (localIndex == currentIndex);
+	bool shouldUpdatePixel;
+	[branch]
+	if (blocksize > 2)
+	{
+		// Bayer order, matching g_BayerIndexToCoordinateOffset of volumetricCloud_renderCS:
+		static const uint bayer[16] = { 0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5 };
+		shouldUpdatePixel = bayer[(DTid.x % 4) + (DTid.y % 4) * 4] == g_xFrame_FrameCount % 16;
+	}
+	else
+	{
+		int subPixelIndex = g_xFrame_FrameCount % 4;
+		int localIndex = (DTid.x & 1) + (DTid.y & 1) * 2;
+		int currentIndex = ComputeCheckerBoardIndex(renderCoord, subPixelIndex);
+		shouldUpdatePixel = (localIndex == currentIndex);
+	}
 	
 	float4 result = 0.0;
 	float2 depthResult = 0.0;
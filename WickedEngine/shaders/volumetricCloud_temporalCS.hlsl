@@ -136,6 +136,13 @@ float getInverseLinearDepth(float lin, float near, float far)
 	return (near - temp) / (lin - temp);
 }
 
+// The distance that the clouds moved with the wind since the previous frame, the density is sampled at the position + wind offset of the frame (see volumetricCloud_renderCS)
+float3 GetCloudMotion()
+{
+	float3 windDirection = float3(cos(g_xFrame_VolumetricClouds.WindAngle), -g_xFrame_VolumetricClouds.WindUpAmount, sin(g_xFrame_VolumetricClouds.WindAngle));
+	return -g_xFrame_VolumetricClouds.WindSpeed * g_xFrame_VolumetricClouds.AnimationMultiplier * windDirection * (g_xFrame_Time - g_xFrame_TimePrev);
+}
+
 [numthreads(POSTPROCESS_BLOCKSIZE, POSTPROCESS_BLOCKSIZE, 1)]
 void main(uint3 DTid : SV_DispatchThreadID)
 {
@@ -171,8 +178,11 @@ void main(uint3 DTid : SV_DispatchThreadID)
 	
 	float4 thisClip = float4(screenPosition, currentCloudDepth, 1.0);
 	
-	float4 prevClip = mul(g_xCamera_InvVP, thisClip);
-	prevClip = mul(g_xCamera_PrevVP, prevClip);
+	// The cloud was at the previous frame where it is now minus the distance it moved with the wind:
+	float4 worldPosition = mul(g_xCamera_InvVP, thisClip);
+	worldPosition.xyz = worldPosition.xyz / worldPosition.w - GetCloudMotion();
+	worldPosition.w = 1;
+	float4 prevClip = mul(g_xCamera_PrevVP, worldPosition);
 	
 	//float4 prevClip = mul(g_xCamera_PrevVP, worldPosition);
 	float2 prevScreen = prevClip.xy / prevClip.w;
@@ -192,7 +202,7 @@ void main(uint3 DTid : SV_DispatchThreadID)
 
 	float4 result = lerp(previous, current, temporalResponse);
     
-	result = is_saturated(prevUV) ? result : current;
+	result = is_saturated(prevUV) && volumetricclouds_historyreset == 0 ? result : current;
 
 	output[DTid.xy] = result;
 
@@ -0,0 +1,17 @@
+#include "globals.hlsli"
+#include "voxelHF.hlsli"
+
+RWSTRUCTUREDBUFFER(output, VoxelType, 0);
+
+// Deletes the packed voxel scene data of a clipmap region before it is voxelized again
+[numthreads(4, 4, 4)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	const int3 voxel = xVoxelizer_RegionMin + (int3)DTid;
+	if (any(voxel >= xVoxelizer_RegionMax))
+		return;
+
+	const uint id = VoxelClipMapIndex(voxel, xVoxelizer_ClipMap);
+	output[id].colorMask = 0;
+	output[id].normalMask = 0;
+}
@@ -1,12 +1,13 @@
 #ifndef WI_VOXEL_CONERACING_HF
 #define WI_VOXEL_CONERACING_HF
 #include "globals.hlsli"
+#include "voxelHF.hlsli"
 
 #ifndef VOXEL_INITIAL_OFFSET
 #define VOXEL_INITIAL_OFFSET 2
 #endif // VOXEL_INITIAL_OFFSET
 
-// voxels:			3D Texture containing voxel scene with direct diffuse lighting (or direct + secondary indirect bounce)
+// voxels:			3D Texture containing the voxel clipmaps with direct diffuse lighting (or direct + secondary indirect bounce)
 // P:				world-space position of receiving surface
 // N:				world-space normal vector of receiving surface
 // coneDirection:	world-space cone direction in the direction to perform the trace
@@ -21,24 +22,30 @@ inline float4 ConeTrace(in Texture3D<float4> voxels, in float3 P, in float3 N, i
 	float dist = g_xFrame_VoxelRadianceDataSize; // offset by cone dir so that first sample of all cones are not the same
 	float3 startPos = P + N * g_xFrame_VoxelRadianceDataSize * VOXEL_INITIAL_OFFSET * SQRT2; // sqrt2 is diagonal voxel half-extent
 
+	uint clipmap = 0;
+
 	// We will break off the loop if the sampling distance is too far for performance reasons:
 	while (dist < g_xFrame_VoxelRadianceMaxDistance && alpha < 1)
 	{
 		float diameter = max(g_xFrame_VoxelRadianceDataSize, 2 * coneAperture * dist);
-		float mip = log2(diameter * g_xFrame_VoxelRadianceDataSize_rcp);
+		float lod = max(0, log2(diameter * g_xFrame_VoxelRadianceDataSize_rcp));
 
-		// Because we do the ray-marching in world space, we need to remap into 3d texture space before sampling:
-		//	todo: optimization could be doing ray-marching in texture space
 		float3 tc = startPos + coneDirection * dist;
-		tc = (tc - g_xFrame_VoxelRadianceDataCenter) * g_xFrame_VoxelRadianceDataSize_rcp;
-		tc *= g_xFrame_VoxelRadianceDataRes_rcp;
-		tc = tc * float3(0.5f, -0.5f, 0.5f) + 0.5f;
+
+		// Every clipmap has the resolution of the previous one's next mip level, so the cone continues in the coarser clipmaps as it widens
+		//	But the sample must be inside the clipmap, the cone also moves to a coarser one if it leaves the finer one:
+		clipmap = max(clipmap, (uint)lod);
+		while (clipmap < VOXEL_GI_CLIPMAP_COUNT && !VoxelClipMapContains(tc, clipmap, 1))
+		{
+			clipmap++;
+		}
+		float mip = max(0, lod - clipmap);
 
 		// break if the ray exits the voxel grid, or we sample from the last mip:
-		if (!is_saturated(tc) || mip >= (float)g_xFrame_VoxelRadianceDataMIPs)
+		if (clipmap >= VOXEL_GI_CLIPMAP_COUNT || mip >= (float)g_xFrame_VoxelRadianceDataMIPs)
 			break;
 
-		float4 sam = voxels.SampleLevel(sampler_linear_clamp, tc, mip);
+		float4 sam = SampleVoxelClipMap(voxels, tc, clipmap, mip);
 
 		// this is the correct blending to avoid black-staircase artifact (ray stepped front-to back, so blend front to back):
 		float a = 1 - alpha;
@@ -52,7 +59,7 @@ inline float4 ConeTrace(in Texture3D<float4> voxels, in float3 P, in float3 N, i
 	return float4(color, alpha);
 }
 
-// voxels:			3D Texture containing voxel scene with direct diffuse lighting (or direct + secondary indirect bounce)
+// voxels:			3D Texture containing the voxel clipmaps with direct diffuse lighting (or direct + secondary indirect bounce)
 // P:				world-space position of receiving surface
 // N:				world-space normal vector of receiving surface
 inline float4 ConeTraceDiffuse(in Texture3D<float4> voxels, in float3 P, in float3 N)
@@ -77,7 +84,7 @@ inline float4 ConeTraceDiffuse(in Texture3D<float4> voxels, in float3 P, in floa
 	return amount;
 }
 
-// voxels:			3D Texture containing voxel scene with direct diffuse lighting (or direct + secondary indirect bounce)
+// voxels:			3D Texture containing the voxel clipmaps with direct diffuse lighting (or direct + secondary indirect bounce)
 // P:				world-space position of receiving surface
 // N:				world-space normal vector of receiving surface
 // V:				world-space view-vector (cameraPosition - P)
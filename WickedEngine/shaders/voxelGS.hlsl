@@ -18,14 +18,10 @@ void main(
 		for (uint i = 0; i < 14; i++)
 		{
 			GSOutput element;
-			element.pos = input[0].pos;
 			element.col = input[0].col;
 
-			element.pos.xyz = element.pos.xyz / g_xFrame_VoxelRadianceDataRes * 2 - 1;
-			element.pos.y = -element.pos.y;
-			element.pos.xyz *= g_xFrame_VoxelRadianceDataRes;
-			element.pos.xyz += (CreateCube(i) - float3(0, 1, 0)) * 2;
-			element.pos.xyz *= g_xFrame_VoxelRadianceDataRes * g_xFrame_VoxelRadianceDataSize / g_xFrame_VoxelRadianceDataRes;
+			// The input position is the voxel center in world space and the voxel half-extent:
+			element.pos.xyz = input[0].pos.xyz + (CreateCube(i) * 2 - 1) * input[0].pos.w;
 
 			element.pos = mul(g_xTransform, float4(element.pos.xyz, 1));
 			element.col *= g_xColor;
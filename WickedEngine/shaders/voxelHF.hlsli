@@ -50,4 +50,62 @@ float4 UnpackVoxelColor(in uint colorMask)
 	return color;
 }
 
+// Voxel GI clipmap addressing (see VOXEL_GI_CLIPMAP_COUNT):
+
+// Edge length of a voxel of the clipmap in world space
+inline float VoxelClipMapVoxelSize(uint clipmap)
+{
+	return g_xFrame_VoxelClipMaps[clipmap].w * 2;
+}
+// World voxel coordinate of the first voxel of the clipmap
+inline int3 VoxelClipMapOrigin(uint clipmap)
+{
+	return (int3)round(g_xFrame_VoxelClipMaps[clipmap].xyz / VoxelClipMapVoxelSize(clipmap)) - (int)g_xFrame_VoxelRadianceDataRes / 2;
+}
+// World voxel coordinate of a world space position
+inline int3 VoxelClipMapVoxel(float3 P, uint clipmap)
+{
+	return (int3)floor(P / VoxelClipMapVoxelSize(clipmap));
+}
+// World voxel coordinate of a storage coordinate inside the clipmap
+inline int3 VoxelClipMapStorageToVoxel(uint3 storage, uint clipmap)
+{
+	const int res = (int)g_xFrame_VoxelRadianceDataRes;
+	const int3 origin = VoxelClipMapOrigin(clipmap);
+	return origin + ((((int3)storage - origin) % res) + res) % res;
+}
+// Storage coordinate of a world voxel coordinate inside the clipmap (toroidal addressing)
+inline uint3 VoxelClipMapStorage(int3 voxel)
+{
+	const int res = (int)g_xFrame_VoxelRadianceDataRes;
+	return (uint3)(((voxel % res) + res) % res);
+}
+// Index of a world voxel coordinate in the voxel scene buffer, that holds all clipmaps one after the other
+inline uint VoxelClipMapIndex(int3 voxel, uint clipmap)
+{
+	const uint res = g_xFrame_VoxelRadianceDataRes;
+	return flatten3D(VoxelClipMapStorage(voxel), res) + clipmap * res * res * res;
+}
+// Texel of a world voxel coordinate in the voxel radiance texture
+inline uint3 VoxelClipMapTexel(int3 voxel, uint clipmap)
+{
+	return VoxelClipMapStorage(voxel) + uint3(0, 0, clipmap * g_xFrame_VoxelRadianceDataRes);
+}
+// Whether a world space position is inside the clipmap, with a margin in voxels of the clipmap
+inline bool VoxelClipMapContains(float3 P, uint clipmap, float margin)
+{
+	const float3 diff = abs(P - g_xFrame_VoxelClipMaps[clipmap].xyz);
+	const float halfwidth = g_xFrame_VoxelClipMaps[clipmap].w * ((float)g_xFrame_VoxelRadianceDataRes - margin * 2);
+	return all(diff < halfwidth);
+}
+// Filtered sample of the voxel radiance texture at a world space position inside the clipmap
+//	The toroidal addressing wraps around with the sampler on the X and Y axes, but the clipmaps are stacked on the Z axis, so it is clamped there
+inline float4 SampleVoxelClipMap(in Texture3D<float4> voxels, float3 P, uint clipmap, float mip)
+{
+	float3 uvw = frac(P / (VoxelClipMapVoxelSize(clipmap) * g_xFrame_VoxelRadianceDataRes));
+	const float border = 0.5f * exp2(ceil(mip)) * g_xFrame_VoxelRadianceDataRes_rcp;
+	uvw.z = (clamp(uvw.z, border, 1 - border) + clipmap) / (float)VOXEL_GI_CLIPMAP_COUNT;
+	return voxels.SampleLevel(sampler_linear_wrap, uvw, mip);
+}
+
 #endif // WI_VOXEL_HF
@@ -7,6 +7,7 @@ TEXTURE3D(input_emission, float4, 0);
 STRUCTUREDBUFFER(input_voxelscene, VoxelType, 1);
 RWTEXTURE3D(output, float4, 0);
 
+// The clipmaps are processed together, the dispatch covers the whole voxel radiance texture:
 [numthreads(8, 8, 8)]
 void main( uint3 DTid : SV_DispatchThreadID )
 {
@@ -16,14 +17,12 @@ void main( uint3 DTid : SV_DispatchThreadID )
 
 	if (emission.a > 0)
 	{
-		float3 N = unpack_unitvector(input_voxelscene[DTid.x].normalMask);
-
-		float3 P = ((float3)writecoord + 0.5f) * g_xFrame_VoxelRadianceDataRes_rcp;
-		P = P * 2 - 1;
-		P.y *= -1;
-		P *= g_xFrame_VoxelRadianceDataSize;
-		P *= g_xFrame_VoxelRadianceDataRes;
-		P += g_xFrame_VoxelRadianceDataCenter;
+		const uint clipmap = DTid.z / g_xFrame_VoxelRadianceDataRes;
+		const int3 voxel = VoxelClipMapStorageToVoxel(uint3(DTid.xy, DTid.z % g_xFrame_VoxelRadianceDataRes), clipmap);
+
+		float3 N = unpack_unitvector(input_voxelscene[VoxelClipMapIndex(voxel, clipmap)].normalMask);
+
+		float3 P = ((float3)voxel + 0.5f) * VoxelClipMapVoxelSize(clipmap);
 
 		float4 radiance = ConeTraceDiffuse(input_emission, P, N);
 
@@ -1,17 +1,22 @@
 #include "globals.hlsli"
 #include "voxelHF.hlsli"
 
-RWSTRUCTUREDBUFFER(input_output, VoxelType, 0);
-RWTEXTURE3D(output_emission, float4, 1);
+STRUCTUREDBUFFER(input_voxelscene, VoxelType, 0);
+RWTEXTURE3D(output_emission, float4, 0);
 
-[numthreads(256, 1, 1)]
+// Copies the voxelized region of a clipmap from the packed voxel scene data to the 3D texture, the cone tracing will operate on the 3D texture
+[numthreads(4, 4, 4)]
 void main( uint3 DTid : SV_DispatchThreadID )
 {
-	VoxelType voxel = input_output[DTid.x];
+	const int3 voxel = xVoxelizer_RegionMin + (int3)DTid;
+	if (any(voxel >= xVoxelizer_RegionMax))
+		return;
 
-	const float4 color = UnpackVoxelColor(voxel.colorMask);
+	VoxelType data = input_voxelscene[VoxelClipMapIndex(voxel, xVoxelizer_ClipMap)];
 
-	const uint3 writecoord = unflatten3D(DTid.x, g_xFrame_VoxelRadianceDataRes);
+	const float4 color = UnpackVoxelColor(data.colorMask);
+
+	const uint3 writecoord = VoxelClipMapTexel(voxel, xVoxelizer_ClipMap);
 
 	[branch]
 	if (color.a > 0)
@@ -19,16 +24,16 @@ void main( uint3 DTid : SV_DispatchThreadID )
 #ifdef TEMPORAL_SMOOTHING
 		// Blend voxels with the previous frame's data to avoid popping artifacts for dynamic objects:
 		[branch]
-		if (g_xFrame_Options & OPTION_BIT_VOXELGI_RETARGETTED)
+		if (xVoxelizer_TemporalSmoothing)
 		{
-			// Do not perform the blend if an offset happened to the voxel grid's center. 
-			// The offset is not accounted for in the blend operation which can introduce severe light leaking.
-			output_emission[writecoord] = float4(color.rgb, 1);
+			// This operation requires Feature: Typed UAV additional format loads!
+			output_emission[writecoord] = lerp(output_emission[writecoord], float4(color.rgb, 1), 0.2f);
 		}
 		else
 		{
-			// This operation requires Feature: Typed UAV additional format loads!
-			output_emission[writecoord] = lerp(output_emission[writecoord], float4(color.rgb, 1), 0.2f);
+			// Do not perform the blend if the region wasn't voxelized at the same place before (for example because the clipmap scrolled there)
+			//	The previous content belongs to an other place, which can introduce severe light leaking.
+			output_emission[writecoord] = float4(color.rgb, 1);
 		}
 #else
 		output_emission[writecoord] = float4(color.rgb, 1);
@@ -38,7 +43,4 @@ void main( uint3 DTid : SV_DispatchThreadID )
 	{
 		output_emission[writecoord] = 0;
 	}
-
-	// delete emission data, but keep normals (no need to delete, we will only read normal values of filled voxels)
-	input_output[DTid.x].colorMask = 0;
 }
@@ -8,13 +8,24 @@ struct VSOut
 	float4 col : TEXCOORD;
 };
 
+// Every voxel of the clipmaps is a vertex, the voxels that are covered by a finer clipmap are not drawn
 VSOut main( uint vertexID : SV_VERTEXID )
 {
 	VSOut o;
 
-	uint3 coord = unflatten3D(vertexID, g_xFrame_VoxelRadianceDataRes);
-	o.pos = float4(coord, 1);
-	o.col = texture_voxelradiance[coord];
+	const uint res = g_xFrame_VoxelRadianceDataRes;
+	const uint clipmap = vertexID / (res * res * res);
+	const uint3 storage = unflatten3D(vertexID % (res * res * res), res);
+	const int3 voxel = VoxelClipMapStorageToVoxel(storage, clipmap);
+
+	// xyz: voxel center in world space, w: voxel half-extent
+	o.pos = float4(((float3)voxel + 0.5f) * VoxelClipMapVoxelSize(clipmap), g_xFrame_VoxelClipMaps[clipmap].w);
+	o.col = texture_voxelradiance[storage + uint3(0, 0, clipmap * res)];
+
+	if (clipmap > 0 && VoxelClipMapContains(o.pos.xyz, clipmap - 1, 0))
+	{
+		o.col = 0;
+	}
 
 	return o;
-}
\ No newline at end of file
+}
@@ -2,6 +2,9 @@
 #include <cstdint>
 #include <memory>
 #include <cassert>
+#include <new>
+#include <type_traits>
+#include <xmmintrin.h> // _mm_malloc
 
 namespace wiAllocators
 {
@@ -63,6 +66,18 @@ namespace wiAllocators
 			offset = 0;
 		}
 
+		inline size_t get_offset() const
+		{
+			return offset;
+		}
+
+		// Free every allocation that was made after get_offset() returned the specified value
+		inline void rewind(size_t value)
+		{
+			assert(value <= offset);
+			offset = value;
+		}
+
 		inline uint8_t* top()
 		{
 			return &buffer[offset];
@@ -75,4 +90,60 @@ namespace wiAllocators
 		size_t alignment = 1;
 	};
 
+	// Temporary array that is allocated from a linear allocator when it has enough space, otherwise from the heap
+	//	The linear allocator is rewound when the array goes out of scope, so arrays using the same allocator must be destroyed in reverse order
+	template<typename T>
+	class ScratchArray
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "ScratchArray elements are not destroyed");
+	public:
+		ScratchArray(size_t count, LinearAllocator* allocator) : count(count)
+		{
+			if (allocator != nullptr && count > 0)
+			{
+				const size_t prev_offset = allocator->get_offset();
+				ptr = (T*)allocator->allocate(sizeof(T) * count);
+				if (ptr != nullptr)
+				{
+					this->allocator = allocator;
+					offset = prev_offset;
+				}
+			}
+			if (ptr == nullptr)
+			{
+				heap.reset(new T[count]());
+				ptr = heap.get();
+			}
+			else
+			{
+				for (size_t i = 0; i < count; ++i)
+				{
+					new (ptr + i) T();
+				}
+			}
+		}
+		~ScratchArray()
+		{
+			if (allocator != nullptr)
+			{
+				allocator->rewind(offset);
+			}
+		}
+		ScratchArray(const ScratchArray&) = delete;
+		ScratchArray& operator=(const ScratchArray&) = delete;
+
+		inline T* data() { return ptr; }
+		inline const T* data() const { return ptr; }
+		inline size_t size() const { return count; }
+		inline T& operator[](size_t index) { return ptr[index]; }
+		inline const T& operator[](size_t index) const { return ptr[index]; }
+
+	private:
+		T* ptr = nullptr;
+		size_t count = 0;
+		std::unique_ptr<T[]> heap;
+		LinearAllocator* allocator = nullptr;
+		size_t offset = 0;
+	};
+
 }
@@ -1,15 +1,141 @@
 #include "wiArchive.h"
 #include "wiHelper.h"
+#include "wiCompression.h"
+#include "wiJobSystem.h"
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 
 // this should always be only INCREMENTED and only if a new serialization is implemeted somewhere!
-uint64_t __archiveVersion = 72;
+uint64_t __archiveVersion = 85;
 // this is the version number of which below the archive is not compatible with the current version
 uint64_t __archiveVersionBarrier = 22;
 
 // version history is logged in ArchiveVersionHistory.txt file!
 
+// Compressed archive files start with this instead of the version number, followed by the uncompressed size, the block size, the block count,
+//	the stored size of every block, and the blocks. Blocks that didn't get smaller are stored uncompressed (their stored size equals the block size)
+static constexpr uint64_t __archiveCompressedMagic = 0x315A484352414957ull; // "WIARCHZ1"
+
+static bool IsCompressedArchive(const uint8_t* data, size_t size)
+{
+	uint64_t magic = 0;
+	if (size >= sizeof(magic))
+	{
+		memcpy(&magic, data, sizeof(magic));
+	}
+	return magic == __archiveCompressedMagic;
+}
+
+// The blocks are decompressed in parallel
+template<typename T>
+static bool DecompressArchive(const uint8_t* data, size_t size, std::vector<uint8_t, T>& result)
+{
+	uint64_t header[4] = {};
+	if (size < sizeof(header))
+	{
+		return false;
+	}
+	memcpy(header, data, sizeof(header));
+	const uint64_t uncompressed_size = header[1];
+	const uint64_t block_size = header[2];
+	const uint64_t block_count = header[3];
+	if (block_size == 0 || block_count != (uncompressed_size + block_size - 1) / block_size || size < sizeof(header) + block_count * sizeof(uint64_t))
+	{
+		return false;
+	}
+
+	std::vector<uint64_t> offsets(block_count + 1);
+	offsets[0] = sizeof(header) + block_count * sizeof(uint64_t);
+	for (uint64_t i = 0; i < block_count; ++i)
+	{
+		uint64_t stored_size;
+		memcpy(&stored_size, data + sizeof(header) + i * sizeof(uint64_t), sizeof(stored_size));
+		offsets[i + 1] = offsets[i] + stored_size;
+	}
+	if (offsets.back() > size)
+	{
+		return false;
+	}
+
+	result.resize((size_t)uncompressed_size);
+	std::atomic_bool success{ true };
+	wiJobSystem::context ctx;
+	wiJobSystem::Dispatch(ctx, (uint32_t)block_count, 1, [&](wiJobArgs args) {
+		const uint64_t begin = args.jobIndex * block_size;
+		const size_t raw_size = (size_t)(std::min(uncompressed_size, begin + block_size) - begin);
+		const size_t stored_size = (size_t)(offsets[args.jobIndex + 1] - offsets[args.jobIndex]);
+		const uint8_t* src = data + offsets[args.jobIndex];
+		uint8_t* dst = result.data() + begin;
+		if (stored_size == raw_size)
+		{
+			memcpy(dst, src, raw_size);
+		}
+		else if (!wiCompression::Decompress(src, stored_size, dst, raw_size))
+		{
+			success.store(false);
+		}
+	});
+	wiJobSystem::Wait(ctx);
+	return success.load();
+}
+
+// The blocks are compressed in parallel
+static void CompressArchive(const uint8_t* data, size_t size, int level, size_t block_size, std::vector<uint8_t>& result)
+{
+	const size_t block_count = (size + block_size - 1) / block_size;
+	std::vector<std::vector<uint8_t>> blocks(block_count);
+	wiJobSystem::context ctx;
+	wiJobSystem::Dispatch(ctx, (uint32_t)block_count, 1, [&](wiJobArgs args) {
+		const size_t begin = args.jobIndex * block_size;
+		const size_t raw_size = std::min(size, begin + block_size) - begin;
+		std::vector<uint8_t>& block = blocks[args.jobIndex];
+		block.resize(raw_size - 1);
+		const size_t compressed_size = wiCompression::Compress(data + begin, raw_size, block.data(), block.size(), level);
+		if (compressed_size == 0)
+		{
+			block.assign(data + begin, data + begin + raw_size);
+		}
+		else
+		{
+			block.resize(compressed_size);
+		}
+	});
+	wiJobSystem::Wait(ctx);
+
+	const uint64_t header[4] = { __archiveCompressedMagic, (uint64_t)size, (uint64_t)block_size, (uint64_t)block_count };
+	size_t total = sizeof(header) + block_count * sizeof(uint64_t);
+	for (auto& block : blocks)
+	{
+		total += block.size();
+	}
+	result.resize(total);
+	uint8_t* dst = result.data();
+	memcpy(dst, header, sizeof(header));
+	dst += sizeof(header);
+	for (auto& block : blocks)
+	{
+		const uint64_t stored_size = block.size();
+		memcpy(dst, &stored_size, sizeof(stored_size));
+		dst += sizeof(stored_size);
+	}
+	for (auto& block : blocks)
+	{
+		memcpy(dst, block.data(), block.size());
+		dst += block.size();
+	}
+}
+
+struct wiArchive::WriteStream
+{
+	std::ofstream file;
+	decltype(wiArchive::DATA) buffer; // the flushed block that the job is writing
+	size_t buffer_size = 0;
+	wiJobSystem::context ctx;
+	std::vector<std::pair<size_t, uint64_t>> patches; // values that were patched after they were flushed
+};
+
 wiArchive::wiArchive()
 {
 	CreateEmpty();
@@ -21,7 +147,28 @@ wiArchive::wiArchive(const std::string& fileName, bool readMode) : fileName(file
 		directory = wiHelper::GetDirectoryFromPath(fileName);
 		if (readMode)
 		{
-			if (wiHelper::FileRead(fileName, DATA))
+			mapped = wiHelper::FileMap(fileName, mapped_size);
+			std::vector<uint8_t> filedata;
+			if (mapped == nullptr && wiHelper::FileRead(fileName, filedata))
+			{
+				DATA.assign(filedata.begin(), filedata.end());
+			}
+			// Compressed files are decompressed into DATA:
+			const uint8_t* contents = _data();
+			const size_t contents_size = mapped != nullptr ? mapped_size : DATA.size();
+			if (IsCompressedArchive(contents, contents_size))
+			{
+				decltype(DATA) decompressed;
+				if (!DecompressArchive(contents, contents_size, decompressed))
+				{
+					wiHelper::messageBox(("The compressed archive is corrupted: " + fileName).c_str(), "Error!");
+					decompressed.clear();
+				}
+				DATA.swap(decompressed);
+				mapped.reset();
+				mapped_size = 0;
+			}
+			if (mapped != nullptr || !DATA.empty())
 			{
 				(*this) >> version;
 				if (version < __archiveVersionBarrier)
@@ -45,6 +192,12 @@ wiArchive::wiArchive(const std::string& fileName, bool readMode) : fileName(file
 	}
 }
 
+wiArchive::wiArchive(const uint8_t* data, size_t size) : readMode(true)
+{
+	DATA.assign(data, data + size);
+	(*this) >> version;
+}
+
 void wiArchive::CreateEmpty()
 {
 	readMode = false;
@@ -55,11 +208,29 @@ void wiArchive::CreateEmpty()
 	(*this) << version;
 }
 
+void wiArchive::ShrinkToFit()
+{
+	if (!readMode && stream == nullptr && mapped == nullptr)
+	{
+		DATA.resize(pos);
+		DATA.shrink_to_fit();
+	}
+}
+
 void wiArchive::SetReadModeAndResetPos(bool isReadMode)
 {
+	assert(stream == nullptr); // the streamed data is not in memory
 	readMode = isReadMode; 
 	pos = 0;
 
+	if (!readMode && mapped != nullptr)
+	{
+		// The mapped file can't be written, so writing starts from a copy:
+		DATA.assign(mapped.get(), mapped.get() + mapped_size);
+		mapped.reset();
+		mapped_size = 0;
+	}
+
 	if (readMode)
 	{
 		(*this) >> version;
@@ -73,21 +244,126 @@ void wiArchive::SetReadModeAndResetPos(bool isReadMode)
 bool wiArchive::IsOpen()
 {
 	// when it is open, DATA is not null because it contains the version number at least!
-	return !DATA.empty();
+	return !DATA.empty() || mapped != nullptr;
 }
 
 void wiArchive::Close()
 {
-	if (!readMode && !fileName.empty())
+	if (stream != nullptr)
+	{
+		FlushStream();
+		WriteStream& s = *stream;
+		wiJobSystem::Wait(s.ctx);
+		for (auto& patch : s.patches)
+		{
+			s.file.seekp((std::streamoff)patch.first);
+			s.file.write((const char*)&patch.second, sizeof(patch.second));
+		}
+		s.file.close();
+		if (s.file.fail())
+		{
+			wiHelper::messageBox(("Could not write " + fileName + "!").c_str(), "Error!");
+		}
+		stream.reset();
+		stream_offset = 0;
+		pos = 0; // everything is saved already
+	}
+	else if (!readMode && !fileName.empty())
 	{
 		SaveFile(fileName);
 	}
 	DATA.clear();
+	mapped.reset();
+	mapped_size = 0;
+}
+
+void wiArchive::SetCompression(int level, size_t blocksize)
+{
+	compression_level = level;
+	compression_block_size = std::max(size_t(1024), blocksize);
+}
+
+bool wiArchive::SetWriteStreaming(size_t blocksize)
+{
+	assert(!readMode && !fileName.empty() && stream == nullptr);
+	if (readMode || fileName.empty() || stream != nullptr)
+	{
+		return false;
+	}
+	auto newstream = std::make_shared<WriteStream>();
+	newstream->file.open(fileName, std::ios::binary | std::ios::trunc);
+	if (!newstream->file.is_open())
+	{
+		return false;
+	}
+	newstream->ctx.priority = wiJobSystem::Priority::Background;
+	stream = newstream;
+	DATA.resize(std::max(std::max(size_t(1024), blocksize), pos));
+	return true;
+}
+
+void wiArchive::FlushStream()
+{
+	WriteStream& s = *stream;
+	wiJobSystem::Wait(s.ctx);
+
+	// The filled block is given to the job and the previously written one becomes the new block (it is allocated on the first flush):
+	const size_t blocksize = DATA.size();
+	s.buffer.swap(DATA);
+	s.buffer_size = pos;
+	DATA.resize(blocksize);
+	stream_offset += pos;
+	pos = 0;
+
+	if (s.buffer_size > 0)
+	{
+		wiJobSystem::Execute(s.ctx, [&s](wiJobArgs args) {
+			s.file.write((const char*)s.buffer.data(), (std::streamsize)s.buffer_size);
+		});
+	}
+}
+
+void wiArchive::StreamWrite(const void* data, size_t size)
+{
+	FlushStream();
+	if (size > DATA.size())
+	{
+		// Data that is larger than a block (eg. embedded resources) is written without copying, the caller owns it so it can't be done by the job:
+		wiJobSystem::Wait(stream->ctx);
+		stream->file.write((const char*)data, (std::streamsize)size);
+		stream_offset += size;
+	}
+	else
+	{
+		memcpy(DATA.data(), data, size);
+		pos = size;
+	}
+}
+
+void wiArchive::Patch(size_t position, uint64_t value)
+{
+	assert(!readMode && position + sizeof(value) <= GetSize());
+	if (position >= stream_offset)
+	{
+		memcpy(DATA.data() + (position - stream_offset), &value, sizeof(value));
+	}
+	else
+	{
+		stream->patches.push_back(std::make_pair(position, value));
+	}
 }
 
 bool wiArchive::SaveFile(const std::string& fileName)
 {
-	return wiHelper::FileWrite(fileName, DATA.data(), pos);
+	assert(stream == nullptr); // the streamed data is not in memory
+
+	if (compression_level > 0 && pos > 0)
+	{
+		std::vector<uint8_t> compressed;
+		CompressArchive(_data(), pos, compression_level, compression_block_size, compressed);
+		return wiHelper::FileWrite(fileName, compressed.data(), compressed.size());
+	}
+	return wiHelper::FileWrite(fileName, _data(), pos);
 }
 
 const std::string& wiArchive::GetSourceDirectory() const
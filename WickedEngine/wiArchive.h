@@ -2,21 +2,79 @@
 #include "CommonInclude.h"
 #include <stdint.h>
 
+#include <memory>
 #include <string>
+#include <type_traits>
 #include <vector>
 
+// Allocator that leaves new elements uninitialized, so that growing the archive doesn't clear memory that is overwritten anyway
+template<typename T>
+struct wiArchiveAllocator : public std::allocator<T>
+{
+	template<typename U>
+	struct rebind
+	{
+		using other = wiArchiveAllocator<U>;
+	};
+	wiArchiveAllocator() = default;
+	template<typename U>
+	wiArchiveAllocator(const wiArchiveAllocator<U>& other) noexcept : std::allocator<T>(other) {}
+
+	template<typename U>
+	void construct(U* ptr) noexcept(std::is_nothrow_default_constructible<U>::value)
+	{
+		::new(static_cast<void*>(ptr)) U;
+	}
+	template<typename U, typename... Args>
+	void construct(U* ptr, Args&&... args)
+	{
+		::new(static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+	}
+};
+
+// Element types of std::vector that are serialized with a single copy of the whole vector,
+//	because their serialized layout is the same as in memory. since is the first archive version that stores them this way
+template<typename T> struct wiArchiveBulk { static constexpr uint64_t since = ~0ull; };
+template<> struct wiArchiveBulk<char> { static constexpr uint64_t since = 0; };
+template<> struct wiArchiveBulk<unsigned char> { static constexpr uint64_t since = 0; };
+template<> struct wiArchiveBulk<float> { static constexpr uint64_t since = 0; };
+template<> struct wiArchiveBulk<double> { static constexpr uint64_t since = 0; };
+template<> struct wiArchiveBulk<XMFLOAT2> { static constexpr uint64_t since = 0; };
+template<> struct wiArchiveBulk<XMFLOAT3> { static constexpr uint64_t since = 0; };
+template<> struct wiArchiveBulk<XMFLOAT4> { static constexpr uint64_t since = 0; };
+template<> struct wiArchiveBulk<XMFLOAT3X3> { static constexpr uint64_t since = 0; };
+template<> struct wiArchiveBulk<XMFLOAT4X3> { static constexpr uint64_t since = 0; };
+template<> struct wiArchiveBulk<XMFLOAT4X4> { static constexpr uint64_t since = 0; };
+template<> struct wiArchiveBulk<XMUINT2> { static constexpr uint64_t since = 0; };
+template<> struct wiArchiveBulk<XMUINT3> { static constexpr uint64_t since = 0; };
+template<> struct wiArchiveBulk<XMUINT4> { static constexpr uint64_t since = 0; };
+template<> struct wiArchiveBulk<int> { static constexpr uint64_t since = 78; }; // single values are stored in 64 bits, vectors in 32 bits
+template<> struct wiArchiveBulk<unsigned int> { static constexpr uint64_t since = 78; };
+
 class wiArchive
 {
 private:
 	uint64_t version = 0;
 	bool readMode = false;
 	size_t pos = 0;
-	std::vector<uint8_t> DATA;
+	std::vector<uint8_t, wiArchiveAllocator<uint8_t>> DATA;
+	std::shared_ptr<const uint8_t> mapped; // memory mapped file contents in read mode, DATA is empty while it is used
+	size_t mapped_size = 0;
 
 	std::string fileName; // save to this file on closing if not empty
 	std::string directory;
 
+	int compression_level = 0;
+	size_t compression_block_size = 1 << 20;
+
+	// Streaming write mode: DATA only holds the bytes after stream_offset, the rest is already written (or being written) to the file
+	struct WriteStream;
+	std::shared_ptr<WriteStream> stream;
+	size_t stream_offset = 0;
+
 	void CreateEmpty();
+	void FlushStream();
+	void StreamWrite(const void* data, size_t size);
 
 public:
 	// Create empty arhive for writing
@@ -24,22 +82,61 @@ public:
 	wiArchive(const wiArchive&) = default;
 	wiArchive(wiArchive&&) = default;
 	// Create archive and link to file
+	//	In read mode the file is memory mapped if it can be, instead of being read into memory
 	wiArchive(const std::string& fileName, bool readMode = true);
+	// Create archive for reading from a copy of memory that was written by an other archive (including its version number)
+	wiArchive(const uint8_t* data, size_t size);
 	~wiArchive() { Close(); }
 
 	wiArchive& operator=(const wiArchive&) = default;
 	wiArchive& operator=(wiArchive&&) = default;
 
-	const uint8_t* GetData() const { return DATA.data(); }
-	size_t GetSize() const { return pos; }
+	const uint8_t* GetData() const { return _data(); }
+	size_t GetSize() const { return stream_offset + pos; }
+	// The memory that is allocated for the data in write mode, it grows ahead of GetSize()
+	size_t GetMemoryUsage() const { return DATA.capacity(); }
+	// Free the memory that was allocated ahead of the written data, for archives that are kept in memory after writing
+	void ShrinkToFit();
 	uint64_t GetVersion() const { return version; }
 	bool IsReadMode() const { return readMode; }
 	void SetReadModeAndResetPos(bool isReadMode);
 	bool IsOpen();
 	void Close();
 	bool SaveFile(const std::string& fileName);
+	// Compress the file when it is saved (including the save on closing), reading compressed files is transparent
+	//	level : from wiCompression::LEVEL_FASTEST to wiCompression::LEVEL_BEST, higher levels compress better but slower, decompression speed is the same. 0 disables compression
+	//	blocksize : the data is split into independent blocks that are compressed and decompressed in parallel, larger blocks compress better
+	void SetCompression(int level, size_t blocksize = 1 << 20);
+	// Write the archive to its file while it is being serialized, instead of keeping all of it in memory until closing
+	//	The data is flushed in blocks of blocksize bytes, each block is written by a background job while the next one is filled
+	//	Only for archives that were created for writing to a file, before anything is written. Streamed files are not compressed
+	//	GetData() only contains the part that is not flushed yet while streaming. Returns false if the file can't be opened
+	bool SetWriteStreaming(size_t blocksize = 4 << 20);
+	bool IsWriteStreaming() const { return stream != nullptr; }
+	// Overwrite a value that was written earlier at position (the GetSize() before writing it), for example a size that is only known after the data
+	//	In streaming mode the value can already be flushed, then it is written to the file when the archive is closed
+	void Patch(size_t position, uint64_t value);
 	const std::string& GetSourceDirectory() const;
 	const std::string& GetSourceFileName() const;
+	// Archives that are embedded into an other one can inherit its directory, so relative paths are resolved the same way
+	void SetSourceDirectory(const std::string& value) { directory = value; }
+
+	// Raw memory operations, for embedding the data of an other archive:
+	inline void WriteData(const uint8_t* data, size_t size)
+	{
+		if (size > 0)
+		{
+			_write(*data, size);
+		}
+	}
+	// Returns a pointer to the next size bytes of the archive and skips them
+	//	The pointer is valid while the archive is alive, so the data can be used without copying it
+	inline const uint8_t* ReadData(size_t size)
+	{
+		const uint8_t* data = _data() + pos;
+		pos += size;
+		return data;
+	}
 
 	// It could be templated but we have to be extremely careful of different datasizes on different platforms
 	// because serialized data should be interchangeable!
@@ -158,6 +255,18 @@ public:
 	{
 		// Here we will use the << operator so that non-specified types will have compile error!
 		(*this) << data.size();
+		if constexpr (wiArchiveBulk<T>::since != ~0ull)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "bulk serialized types must be trivially copyable");
+			if (version >= wiArchiveBulk<T>::since)
+			{
+				if (!data.empty())
+				{
+					_write(*data.data(), data.size());
+				}
+				return *this;
+			}
+		}
 		for (const T& x : data)
 		{
 			(*this) << x;
@@ -288,11 +397,9 @@ public:
 	{
 		uint64_t len;
 		_read(len);
-		char* str = new char[(size_t)len];
-		memset(str, '\0', (size_t)(sizeof(char)*len));
-		_read(*str, len);
-		data = std::string(str);
-		delete[] str;
+		// Assigned directly from the archive memory, the string ends at the null-terminator (or the first null character):
+		const char* str = (const char*)ReadData((size_t)len);
+		data.assign(str, strnlen(str, (size_t)len));
 		return *this;
 	}
 	template<typename T>
@@ -302,6 +409,17 @@ public:
 		size_t count;
 		(*this) >> count;
 		data.resize(count);
+		if constexpr (wiArchiveBulk<T>::since != ~0ull)
+		{
+			if (version >= wiArchiveBulk<T>::since)
+			{
+				if (count > 0)
+				{
+					_read(*data.data(), count);
+				}
+				return *this;
+			}
+		}
 		for (size_t i = 0; i < count; ++i)
 		{
 			(*this) >> data[i];
@@ -325,17 +443,28 @@ private:
 		size_t _right = pos + _size;
 		if (_right > DATA.size())
 		{
+			if (stream != nullptr)
+			{
+				StreamWrite(&data, _size);
+				return;
+			}
 			DATA.resize(_right * 2);
 		}
-		memcpy(reinterpret_cast<void*>((uint64_t)DATA.data() + (uint64_t)pos), &data, _size);
+		memcpy(DATA.data() + pos, &data, _size);
 		pos = _right;
 	}
 
+	// The memory that is read from
+	inline const uint8_t* _data() const
+	{
+		return mapped != nullptr ? mapped.get() : DATA.data();
+	}
+
 	// Read data using memory operations
 	template<typename T>
 	inline void _read(T& data, uint64_t count = 1)
 	{
-		memcpy(&data, reinterpret_cast<void*>((uint64_t)DATA.data() + (uint64_t)pos), (size_t)(sizeof(data)*count));
+		memcpy(&data, _data() + pos, (size_t)(sizeof(data)*count));
 		pos += (size_t)(sizeof(data)*count);
 	}
 };
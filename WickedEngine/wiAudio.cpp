@@ -1,7 +1,14 @@
 #include "wiAudio.h"
 #include "wiBackLog.h"
 #include "wiHelper.h"
-
+#include "wiMemoryTracker.h"
+#include "wiJobSystem.h"
+#include "wiCounters.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <cmath>
 #include <vector>
 
 #define STB_VORBIS_HEADER_ONLY
@@ -59,6 +66,148 @@ namespace wiAudio
 		XAUDIO2FX_I3DL2_PRESET_PLATE,
 	};
 
+	// Streamed sound instances decode the Ogg Vorbis file into a small ring of buffers
+	//	When the voice finishes with a buffer, the next chunk is decoded into it by a job and submitted again
+	struct SoundStream
+	{
+		static constexpr uint32_t BUFFER_COUNT = 3;
+		static constexpr uint32_t BUFFER_FRAMES = 16384; // samples per channel in a buffer
+
+		IXAudio2SourceVoice* sourceVoice = nullptr; // nullptr while the instance is virtual
+		uint32_t generation = 0; // changed whenever the voice is taken away, the buffers of an earlier voice are not refilled
+		stb_vorbis* decoder = nullptr;
+		uint32_t channels = 0;
+		uint32_t total_frames = 0;
+		uint32_t loop_begin = 0;
+		uint32_t loop_end = 0;
+		uint32_t position = 0; // next frame to decode
+		bool exit_loop = false;
+		bool finished = false; // the end of stream buffer was submitted
+		std::vector<short> buffers[BUFFER_COUNT];
+		wiMemoryTracker::ScopedAllocation memory;
+
+		std::mutex locker; // decoding and submitting is guarded, so that the voice can't be taken away meanwhile
+
+		~SoundStream()
+		{
+			if (decoder != nullptr)
+				stb_vorbis_close(decoder);
+		}
+
+		// Decodes the next chunk into the buffer and submits it, the loop region is repeated until ExitLoop()
+		void Refill(uint32_t index)
+		{
+			std::vector<short>& buffer = buffers[index];
+			uint32_t frames = 0;
+			while (frames < BUFFER_FRAMES && !finished)
+			{
+				const uint32_t end = exit_loop ? total_frames : loop_end;
+				if (position >= end)
+				{
+					if (exit_loop || loop_begin >= loop_end)
+					{
+						finished = true;
+						break;
+					}
+					stb_vorbis_seek(decoder, loop_begin);
+					position = loop_begin;
+					continue;
+				}
+				const int request = (int)std::min(BUFFER_FRAMES - frames, end - position);
+				const int decoded = stb_vorbis_get_samples_short_interleaved(decoder, (int)channels, buffer.data() + frames * channels, request * (int)channels);
+				if (decoded <= 0)
+				{
+					// The decoder reached the end of the file earlier than its reported length:
+					total_frames = position;
+					loop_end = std::min(loop_end, total_frames);
+					loop_begin = std::min(loop_begin, loop_end);
+					continue;
+				}
+				frames += (uint32_t)decoded;
+				position += (uint32_t)decoded;
+			}
+
+			if (frames == 0)
+			{
+				// Nothing is left to play, the buffers that were submitted before end the stream:
+				HRESULT hr = sourceVoice->Discontinuity();
+				assert(SUCCEEDED(hr));
+				return;
+			}
+
+			XAUDIO2_BUFFER desc = {};
+			desc.AudioBytes = frames * channels * sizeof(short);
+			desc.pAudioData = (const BYTE*)buffer.data();
+			desc.Flags = finished ? XAUDIO2_END_OF_STREAM : 0;
+			desc.pContext = (void*)(uintptr_t(generation) << 8 | uintptr_t(index));
+			HRESULT hr = sourceVoice->SubmitSourceBuffer(&desc);
+			assert(SUCCEEDED(hr));
+		}
+		// Decodes from the frame into every buffer
+		void Seek(uint32_t frame)
+		{
+			stb_vorbis_seek(decoder, frame);
+			position = frame;
+			finished = false;
+			for (uint32_t i = 0; i < BUFFER_COUNT && !finished; ++i)
+			{
+				Refill(i);
+			}
+		}
+	};
+	wiJobSystem::context streaming_ctx; // refills of every stream
+
+	// The source voices are pooled by their format, a voice is only owned by a sound instance while it is audible (see SetMaxVoices())
+	struct PooledVoice : public IXAudio2VoiceCallback
+	{
+		IXAudio2SourceVoice* sourceVoice = nullptr;
+		uint64_t format = 0;
+
+		// The data of the last owner that the submitted buffers point to is kept alive until the buffers are released:
+		std::mutex locker; // OnBufferEnd() is called on the audio thread
+		std::shared_ptr<SoundStream> stream;
+		std::shared_ptr<void> keepalive;
+
+		~PooledVoice()
+		{
+			if (sourceVoice != nullptr)
+				sourceVoice->DestroyVoice();
+		}
+
+		void STDMETHODCALLTYPE OnBufferEnd(void* pBufferContext) override
+		{
+			std::shared_ptr<SoundStream> target;
+			{
+				std::lock_guard<std::mutex> lock(locker);
+				target = stream;
+			}
+			if (target == nullptr)
+				return;
+			// The audio thread must not be blocked by decoding:
+			const uint32_t index = uint32_t(uintptr_t(pBufferContext) & 0xFF);
+			const uint32_t generation = uint32_t(uintptr_t(pBufferContext) >> 8);
+			wiJobSystem::Execute(streaming_ctx, [target, index, generation](wiJobArgs args) {
+				std::lock_guard<std::mutex> lock(target->locker);
+				if (target->sourceVoice != nullptr && target->generation == generation && !target->finished)
+				{
+					target->Refill(index);
+				}
+			});
+		}
+		void STDMETHODCALLTYPE OnVoiceProcessingPassStart(UINT32 BytesRequired) override {}
+		void STDMETHODCALLTYPE OnVoiceProcessingPassEnd() override {}
+		void STDMETHODCALLTYPE OnStreamEnd() override {}
+		void STDMETHODCALLTYPE OnBufferStart(void* pBufferContext) override {}
+		void STDMETHODCALLTYPE OnLoopEnd(void* pBufferContext) override {}
+		void STDMETHODCALLTYPE OnVoiceError(void* pBufferContext, HRESULT Error) override {}
+	};
+
+	struct RetiringVoice
+	{
+		PooledVoice* voice = nullptr;
+		bool flushed = false;
+	};
+
 	struct AudioInternal
 	{
 		bool success = false;
@@ -152,8 +301,16 @@ namespace wiAudio
 
 			success = SUCCEEDED(hr);
 		}
+		std::vector<std::unique_ptr<PooledVoice>> voices;
+		std::vector<PooledVoice*> free_voices;
+		std::vector<RetiringVoice> retiring_voices;
+
 		~AudioInternal()
 		{
+			wiJobSystem::Wait(streaming_ctx);
+			free_voices.clear();
+			retiring_voices.clear();
+			voices.clear();
 
 			if (reverbSubmix != nullptr)
 				reverbSubmix->DestroyVoice();
@@ -173,29 +330,268 @@ namespace wiAudio
 		}
 	};
 	std::shared_ptr<AudioInternal> audio;
+	float streaming_threshold = 20;
 
 	struct SoundInternal
 	{
 		std::shared_ptr<AudioInternal> audio;
 		WAVEFORMATEX wfx = {};
-		std::vector<uint8_t> audioData;
+		std::vector<uint8_t> audioData; // PCM data, or the Ogg Vorbis file data of a streamed sound
+		bool streaming = false;
+		wiMemoryTracker::ScopedAllocation memory;
 	};
+
 	struct SoundInstanceInternal
 	{
 		std::shared_ptr<AudioInternal> audio;
 		std::shared_ptr<SoundInternal> soundinternal;
-		IXAudio2SourceVoice* sourceVoice = nullptr;
-		XAUDIO2_VOICE_DETAILS voiceDetails = {};
+		std::shared_ptr<SoundStream> stream; // only for streamed sounds
+		PooledVoice* voice = nullptr; // nullptr while the instance is virtual
+
+		SUBMIX_TYPE type = SUBMIX_TYPE_SOUNDEFFECT;
+		bool reverb = false;
+		uint32_t channels = 0;
+		uint32_t sample_rate = 0;
+		uint32_t total_frames = 0;
+		uint32_t loop_begin = 0;
+		uint32_t loop_end = 0;
+
+		// The playback state is kept for virtual instances, and it is applied to the voice when they get one:
+		bool playing = false;
+		bool ended = false; // played to the end, Play() has no effect until Stop()
+		bool exit_loop = false;
+		float volume = 1;
+		bool spatialized = false;
+		float frequencyRatio = 1;
 		std::vector<float> outputMatrix;
 		std::vector<float> channelAzimuths;
-		XAUDIO2_BUFFER buffer = {};
+		float lpfDirect = 1;
+		float reverbLevel = 0;
+		float lpfReverb = 1;
+		float attenuation = 1; // average gain of the 3D output matrix
+		float audibility = 0; // volume after the 3D attenuation, the most audible instances get the voices
+		uint64_t cursor = 0; // playback position in frames
+		float fraction = 0; // part of a frame that the cursor of a virtual instance is ahead
+		uint64_t samplesPlayed = 0; // SamplesPlayed of the voice when the cursor was last updated
+
+		~SoundInstanceInternal();
+	};
+
+	// Every sound instance is registered, so that Update() can assign the voices
+	//	The voices and the instance states are guarded by one lock
+	std::mutex voice_locker;
+	std::vector<SoundInstanceInternal*> instances;
+	uint32_t max_voices = 64;
+	uint32_t real_voice_count = 0;
+
+	uint64_t GetFormatKey(const WAVEFORMATEX& wfx)
+	{
+		return uint64_t(wfx.nChannels) | (uint64_t(wfx.wBitsPerSample) << 16) | (uint64_t(wfx.nSamplesPerSec) << 32);
+	}
 
-		~SoundInstanceInternal()
+	// Moves the playback position forward, wrapping around in the loop region
+	void AdvanceCursor(SoundInstanceInternal& instance, uint64_t frames)
+	{
+		instance.cursor += frames;
+		const uint64_t end = instance.exit_loop ? instance.total_frames : instance.loop_end;
+		if (instance.cursor >= end)
 		{
-			sourceVoice->Stop();
-			sourceVoice->DestroyVoice();
+			if (!instance.exit_loop && instance.loop_end > instance.loop_begin)
+			{
+				instance.cursor = instance.loop_begin + (instance.cursor - instance.loop_begin) % (instance.loop_end - instance.loop_begin);
+			}
+			else
+			{
+				// The sound has ended:
+				instance.cursor = 0;
+				instance.playing = false;
+				instance.ended = true;
+			}
 		}
-	};
+	}
+
+	void ApplyVoiceSettings(SoundInstanceInternal& instance, UINT32 operationSet = XAUDIO2_COMMIT_NOW)
+	{
+		IXAudio2SourceVoice* sourceVoice = instance.voice->sourceVoice;
+		IXAudio2SubmixVoice* submix = instance.audio->submixVoices[instance.type];
+		HRESULT hr;
+
+		hr = sourceVoice->SetFrequencyRatio(instance.frequencyRatio, operationSet);
+		assert(SUCCEEDED(hr));
+
+		if (instance.spatialized)
+		{
+			hr = sourceVoice->SetOutputMatrix(submix, instance.channels, instance.audio->masteringVoiceDetails.InputChannels, instance.outputMatrix.data(), operationSet);
+			assert(SUCCEEDED(hr));
+		}
+
+		XAUDIO2_FILTER_PARAMETERS FilterParametersDirect = { LowPassFilter, 2.0f * sinf(X3DAUDIO_PI / 6.0f * instance.lpfDirect), 1.0f };
+		hr = sourceVoice->SetOutputFilterParameters(submix, &FilterParametersDirect, operationSet);
+		assert(SUCCEEDED(hr));
+
+		if (instance.reverb && instance.spatialized)
+		{
+			hr = sourceVoice->SetOutputMatrix(instance.audio->reverbSubmix, instance.channels, 1, &instance.reverbLevel, operationSet);
+			assert(SUCCEEDED(hr));
+			XAUDIO2_FILTER_PARAMETERS FilterParametersReverb = { LowPassFilter, 2.0f * sinf(X3DAUDIO_PI / 6.0f * instance.lpfReverb), 1.0f };
+			hr = sourceVoice->SetOutputFilterParameters(instance.audio->reverbSubmix, &FilterParametersReverb, operationSet);
+			assert(SUCCEEDED(hr));
+		}
+	}
+
+	// Gives a voice to the instance and continues playing from its cursor. The lock must be held
+	bool AcquireVoice(SoundInstanceInternal& instance)
+	{
+		assert(instance.voice == nullptr);
+		AudioInternal& audioref = *instance.audio;
+		const WAVEFORMATEX& wfx = instance.soundinternal->wfx;
+		const uint64_t format = GetFormatKey(wfx);
+
+		PooledVoice* voice = nullptr;
+		for (size_t i = 0; i < audioref.free_voices.size(); ++i)
+		{
+			if (audioref.free_voices[i]->format == format)
+			{
+				voice = audioref.free_voices[i];
+				audioref.free_voices[i] = audioref.free_voices.back();
+				audioref.free_voices.pop_back();
+				break;
+			}
+		}
+		if (voice == nullptr)
+		{
+			auto pooled = std::make_unique<PooledVoice>();
+			pooled->format = format;
+			HRESULT hr = audioref.audioEngine->CreateSourceVoice(&pooled->sourceVoice, &wfx,
+				0, XAUDIO2_DEFAULT_FREQ_RATIO, pooled.get(), NULL, NULL);
+			if (FAILED(hr))
+			{
+				assert(0);
+				return false;
+			}
+			voice = pooled.get();
+			audioref.voices.push_back(std::move(pooled));
+		}
+		instance.voice = voice;
+		real_voice_count++;
+
+		HRESULT hr;
+		XAUDIO2_SEND_DESCRIPTOR SFXSend[] = {
+			{ XAUDIO2_SEND_USEFILTER, audioref.submixVoices[instance.type] },
+			{ XAUDIO2_SEND_USEFILTER, audioref.reverbSubmix }, // this should be last to enable/disable reverb simply
+		};
+		XAUDIO2_VOICE_SENDS SFXSendList = {
+			instance.reverb ? arraysize(SFXSend) : 1,
+			SFXSend
+		};
+		hr = voice->sourceVoice->SetOutputVoices(&SFXSendList);
+		assert(SUCCEEDED(hr));
+
+		// The voice starts silent, and the volume change is ramped by XAudio2, so it fades in without a pop:
+		hr = voice->sourceVoice->SetVolume(0);
+		assert(SUCCEEDED(hr));
+		ApplyVoiceSettings(instance);
+
+		if (instance.stream != nullptr)
+		{
+			{
+				std::lock_guard<std::mutex> lock(voice->locker);
+				voice->stream = instance.stream;
+				voice->keepalive.reset();
+			}
+			std::lock_guard<std::mutex> lock(instance.stream->locker);
+			instance.stream->sourceVoice = voice->sourceVoice;
+			instance.stream->exit_loop = instance.exit_loop;
+			instance.stream->Seek((uint32_t)instance.cursor);
+		}
+		else
+		{
+			{
+				std::lock_guard<std::mutex> lock(voice->locker);
+				voice->stream.reset();
+				voice->keepalive = instance.soundinternal;
+			}
+			XAUDIO2_BUFFER buffer = {};
+			buffer.AudioBytes = (UINT32)instance.soundinternal->audioData.size();
+			buffer.pAudioData = instance.soundinternal->audioData.data();
+			buffer.Flags = XAUDIO2_END_OF_STREAM;
+			buffer.PlayBegin = (UINT32)instance.cursor;
+			if (!instance.exit_loop && instance.loop_begin < instance.loop_end)
+			{
+				buffer.LoopCount = XAUDIO2_LOOP_INFINITE;
+				buffer.LoopBegin = instance.loop_begin;
+				buffer.LoopLength = instance.loop_end < instance.total_frames ? instance.loop_end - instance.loop_begin : 0;
+			}
+			hr = voice->sourceVoice->SubmitSourceBuffer(&buffer);
+			assert(SUCCEEDED(hr));
+		}
+
+		XAUDIO2_VOICE_STATE state = {};
+		voice->sourceVoice->GetState(&state);
+		instance.samplesPlayed = state.SamplesPlayed;
+
+		hr = voice->sourceVoice->Start();
+		assert(SUCCEEDED(hr));
+		hr = voice->sourceVoice->SetVolume(instance.volume);
+		assert(SUCCEEDED(hr));
+		return true;
+	}
+
+	// Takes the voice from the instance, it fades out and returns to the pool when its buffers are released. The lock must be held
+	void ReleaseVoice(SoundInstanceInternal& instance)
+	{
+		assert(instance.voice != nullptr);
+		HRESULT hr = instance.voice->sourceVoice->SetVolume(0);
+		assert(SUCCEEDED(hr));
+		if (instance.stream != nullptr)
+		{
+			// The buffers that are still queued are played out silently, but they are not refilled any more:
+			std::lock_guard<std::mutex> lock(instance.stream->locker);
+			instance.stream->sourceVoice = nullptr;
+			instance.stream->generation++;
+		}
+		RetiringVoice retiring;
+		retiring.voice = instance.voice;
+		instance.audio->retiring_voices.push_back(retiring);
+		instance.voice = nullptr;
+		real_voice_count--;
+	}
+
+	// Updates the cursor from the samples that the voice played. The lock must be held
+	void UpdateCursor(SoundInstanceInternal& instance)
+	{
+		XAUDIO2_VOICE_STATE state = {};
+		instance.voice->sourceVoice->GetState(&state);
+		const uint64_t played = state.SamplesPlayed >= instance.samplesPlayed ? state.SamplesPlayed - instance.samplesPlayed : state.SamplesPlayed;
+		instance.samplesPlayed = state.SamplesPlayed;
+		AdvanceCursor(instance, played);
+		if (state.BuffersQueued == 0)
+		{
+			// The voice played to the end:
+			instance.cursor = 0;
+			instance.playing = false;
+			instance.ended = true;
+		}
+	}
+
+	SoundInstanceInternal::~SoundInstanceInternal()
+	{
+		std::lock_guard<std::mutex> lock(voice_locker);
+		if (voice != nullptr)
+		{
+			ReleaseVoice(*this);
+		}
+		for (size_t i = 0; i < instances.size(); ++i)
+		{
+			if (instances[i] == this)
+			{
+				instances[i] = instances.back();
+				instances.pop_back();
+				break;
+			}
+		}
+	}
+
 	SoundInternal* to_internal(const Sound* param)
 	{
 		return static_cast<SoundInternal*>(param->internal_state.get());
@@ -265,6 +661,15 @@ namespace wiAudio
 
 	}
 
+	void SetStreamingThreshold(float seconds)
+	{
+		streaming_threshold = seconds;
+	}
+	float GetStreamingThreshold()
+	{
+		return streaming_threshold;
+	}
+
 	bool CreateSound(const std::string& filename, Sound* sound)
 	{
 		std::vector<uint8_t> filedata;
@@ -324,15 +729,36 @@ namespace wiAudio
 		else
 		{
 			// Ogg decoder:
-			int channels = 0;
-			int sample_rate = 0;
-			short* output = nullptr;
-			int samples = stb_vorbis_decode_memory(data, (int)size, &channels, &sample_rate, &output);
-			if (samples < 0)
+			int error = 0;
+			stb_vorbis* decoder = stb_vorbis_open_memory(data, (int)size, &error, nullptr);
+			if (decoder == nullptr)
 			{
 				assert(0);
 				return false;
 			}
+			const stb_vorbis_info info = stb_vorbis_get_info(decoder);
+			const unsigned int length = stb_vorbis_stream_length_in_samples(decoder);
+			stb_vorbis_close(decoder);
+
+			int channels = info.channels;
+			int sample_rate = (int)info.sample_rate;
+			short* output = nullptr;
+			int samples = 0;
+			if (sample_rate > 0 && float(length) / float(sample_rate) > streaming_threshold)
+			{
+				// Long sounds are kept compressed, every instance decodes them while playing:
+				soundinternal->streaming = true;
+				soundinternal->audioData.assign(data, data + size);
+			}
+			else
+			{
+				samples = stb_vorbis_decode_memory(data, (int)size, &channels, &sample_rate, &output);
+				if (samples < 0)
+				{
+					assert(0);
+					return false;
+				}
+			}
 
 			// WAVEFORMATEX: https://docs.microsoft.com/en-us/previous-versions/dd757713(v=vs.85)?redirectedfrom=MSDN
 			soundinternal->wfx.wFormatTag = WAVE_FORMAT_PCM;
@@ -342,65 +768,79 @@ namespace wiAudio
 			soundinternal->wfx.nBlockAlign = (WORD)channels * sizeof(short); // is this right?
 			soundinternal->wfx.nAvgBytesPerSec = soundinternal->wfx.nSamplesPerSec * soundinternal->wfx.nBlockAlign;
 
-			size_t output_size = (size_t)samples * sizeof(short);
-			soundinternal->audioData.resize(output_size);
-			memcpy(soundinternal->audioData.data(), output, output_size);
+			if (output != nullptr)
+			{
+				size_t output_size = (size_t)samples * (size_t)channels * sizeof(short);
+				soundinternal->audioData.resize(output_size);
+				memcpy(soundinternal->audioData.data(), output, output_size);
 
-			free(output);
+				free(output);
+			}
 		}
 
+		soundinternal->memory.Set(wiMemoryTracker::TAG_AUDIO, soundinternal->audioData.size());
 		return true;
 	}
 	bool CreateSoundInstance(const Sound* sound, SoundInstance* instance)
 	{
-		HRESULT hr;
 		const auto& soundinternal = std::static_pointer_cast<SoundInternal>(sound->internal_state);
 		std::shared_ptr<SoundInstanceInternal> instanceinternal = std::make_shared<SoundInstanceInternal>();
-		instance->internal_state = instanceinternal;
 
 		instanceinternal->audio = audio;
 		instanceinternal->soundinternal = soundinternal;
+		instanceinternal->type = instance->type;
+		instanceinternal->reverb = instance->IsEnableReverb() && audio->reverbSubmix != nullptr;
+		instanceinternal->channels = soundinternal->wfx.nChannels;
+		instanceinternal->sample_rate = soundinternal->wfx.nSamplesPerSec;
 
-		XAUDIO2_SEND_DESCRIPTOR SFXSend[] = { 
-			{ XAUDIO2_SEND_USEFILTER, audio->submixVoices[instance->type] },
-			{ XAUDIO2_SEND_USEFILTER, audio->reverbSubmix }, // this should be last to enable/disable reverb simply
-		};
-		XAUDIO2_VOICE_SENDS SFXSendList = { 
-			instance->IsEnableReverb() ? arraysize(SFXSend) : 1, 
-			SFXSend 
-		};
+		if (soundinternal->streaming)
+		{
+			auto stream = std::make_shared<SoundStream>();
+			int error = 0;
+			stream->decoder = stb_vorbis_open_memory(soundinternal->audioData.data(), (int)soundinternal->audioData.size(), &error, nullptr);
+			if (stream->decoder == nullptr)
+			{
+				assert(0);
+				return false;
+			}
+			stream->channels = instanceinternal->channels;
+			for (auto& x : stream->buffers)
+			{
+				x.resize(SoundStream::BUFFER_FRAMES * stream->channels);
+			}
+			stream->memory.Set(wiMemoryTracker::TAG_AUDIO, SoundStream::BUFFER_COUNT * SoundStream::BUFFER_FRAMES * stream->channels * sizeof(short));
+			instanceinternal->total_frames = stb_vorbis_stream_length_in_samples(stream->decoder);
+			instanceinternal->stream = std::move(stream);
+		}
+		else if (soundinternal->wfx.nBlockAlign > 0)
+		{
+			instanceinternal->total_frames = uint32_t(soundinternal->audioData.size() / soundinternal->wfx.nBlockAlign);
+		}
 
-		hr = audio->audioEngine->CreateSourceVoice(&instanceinternal->sourceVoice, &soundinternal->wfx, 
-			0, XAUDIO2_DEFAULT_FREQ_RATIO, NULL, &SFXSendList, NULL);
-		if (FAILED(hr))
+		// The loop region is in the frames of the sound, not of the mastering voice:
+		const uint32_t total_frames = instanceinternal->total_frames;
+		instanceinternal->loop_begin = std::min(total_frames, uint32_t(instance->loop_begin * instanceinternal->sample_rate));
+		instanceinternal->loop_end = instance->loop_length > 0 ? std::min(total_frames, instanceinternal->loop_begin + uint32_t(instance->loop_length * instanceinternal->sample_rate)) : total_frames;
+		if (instanceinternal->stream != nullptr)
 		{
-			assert(0);
-			return false;
+			instanceinternal->stream->total_frames = total_frames;
+			instanceinternal->stream->loop_begin = instanceinternal->loop_begin;
+			instanceinternal->stream->loop_end = instanceinternal->loop_end;
 		}
 
-		instanceinternal->sourceVoice->GetVoiceDetails(&instanceinternal->voiceDetails);
-		
-		instanceinternal->outputMatrix.resize(size_t(instanceinternal->voiceDetails.InputChannels) * size_t(audio->masteringVoiceDetails.InputChannels));
-		instanceinternal->channelAzimuths.resize(instanceinternal->voiceDetails.InputChannels);
+		instanceinternal->outputMatrix.resize(size_t(instanceinternal->channels) * size_t(audio->masteringVoiceDetails.InputChannels));
+		instanceinternal->channelAzimuths.resize(instanceinternal->channels);
 		for (size_t i = 0; i < instanceinternal->channelAzimuths.size(); ++i)
 		{
 			instanceinternal->channelAzimuths[i] = X3DAUDIO_2PI * float(i) / float(instanceinternal->channelAzimuths.size());
 		}
 
-		instanceinternal->buffer.AudioBytes = (UINT32)soundinternal->audioData.size();
-		instanceinternal->buffer.pAudioData = soundinternal->audioData.data();
-		instanceinternal->buffer.Flags = XAUDIO2_END_OF_STREAM;
-		instanceinternal->buffer.LoopCount = XAUDIO2_LOOP_INFINITE;
-		instanceinternal->buffer.LoopBegin = UINT32(instance->loop_begin * audio->masteringVoiceDetails.InputSampleRate);
-		instanceinternal->buffer.LoopLength = UINT32(instance->loop_length * audio->masteringVoiceDetails.InputSampleRate);
-
-		hr = instanceinternal->sourceVoice->SubmitSourceBuffer(&instanceinternal->buffer);
-		if (FAILED(hr))
+		// The instance is virtual until it is played:
 		{
-			assert(0);
-			return false;
+			std::lock_guard<std::mutex> lock(voice_locker);
+			instances.push_back(instanceinternal.get());
 		}
-
+		instance->internal_state = instanceinternal;
 		return true;
 	}
 	void Play(SoundInstance* instance)
@@ -408,8 +848,15 @@ namespace wiAudio
 		if (instance != nullptr && instance->IsValid())
 		{
 			auto instanceinternal = to_internal(instance);
-			HRESULT hr = instanceinternal->sourceVoice->Start();
-			assert(SUCCEEDED(hr));
+			std::lock_guard<std::mutex> lock(voice_locker);
+			if (instanceinternal->playing || instanceinternal->ended)
+				return;
+			instanceinternal->playing = true;
+			if (real_voice_count < max_voices)
+			{
+				// A voice is given right away if there is one to spare, otherwise Update() decides if the instance is audible enough:
+				AcquireVoice(*instanceinternal);
+			}
 		}
 	}
 	void Pause(SoundInstance* instance)
@@ -417,8 +864,13 @@ namespace wiAudio
 		if (instance != nullptr && instance->IsValid())
 		{
 			auto instanceinternal = to_internal(instance);
-			HRESULT hr = instanceinternal->sourceVoice->Stop(); // preserves cursor position
-			assert(SUCCEEDED(hr));
+			std::lock_guard<std::mutex> lock(voice_locker);
+			if (instanceinternal->voice != nullptr)
+			{
+				UpdateCursor(*instanceinternal);
+				ReleaseVoice(*instanceinternal); // preserves cursor position
+			}
+			instanceinternal->playing = false;
 		}
 	}
 	void Stop(SoundInstance* instance)
@@ -426,12 +878,16 @@ namespace wiAudio
 		if (instance != nullptr && instance->IsValid())
 		{
 			auto instanceinternal = to_internal(instance);
-			HRESULT hr = instanceinternal->sourceVoice->Stop(); // preserves cursor position
-			assert(SUCCEEDED(hr)); 
-			hr = instanceinternal->sourceVoice->FlushSourceBuffers(); // reset submitted audio buffer
-			assert(SUCCEEDED(hr)); 
-			hr = instanceinternal->sourceVoice->SubmitSourceBuffer(&instanceinternal->buffer); // resubmit
-			assert(SUCCEEDED(hr));
+			std::lock_guard<std::mutex> lock(voice_locker);
+			if (instanceinternal->voice != nullptr)
+			{
+				ReleaseVoice(*instanceinternal);
+			}
+			instanceinternal->playing = false;
+			instanceinternal->ended = false;
+			instanceinternal->exit_loop = false;
+			instanceinternal->cursor = 0;
+			instanceinternal->fraction = 0;
 		}
 	}
 	void SetVolume(float volume, SoundInstance* instance)
@@ -444,8 +900,15 @@ namespace wiAudio
 		else
 		{
 			auto instanceinternal = to_internal(instance);
-			HRESULT hr = instanceinternal->sourceVoice->SetVolume(volume);
-			assert(SUCCEEDED(hr));
+			std::lock_guard<std::mutex> lock(voice_locker);
+			if (instanceinternal->volume == volume)
+				return;
+			instanceinternal->volume = volume;
+			if (instanceinternal->voice != nullptr)
+			{
+				HRESULT hr = instanceinternal->voice->sourceVoice->SetVolume(volume);
+				assert(SUCCEEDED(hr));
+			}
 		}
 	}
 	float GetVolume(const SoundInstance* instance)
@@ -458,7 +921,8 @@ namespace wiAudio
 		else
 		{
 			auto instanceinternal = to_internal(instance);
-			instanceinternal->sourceVoice->GetVolume(&volume);
+			std::lock_guard<std::mutex> lock(voice_locker);
+			volume = instanceinternal->volume;
 		}
 		return volume;
 	}
@@ -467,8 +931,21 @@ namespace wiAudio
 		if (instance != nullptr && instance->IsValid())
 		{
 			auto instanceinternal = to_internal(instance);
-			HRESULT hr = instanceinternal->sourceVoice->ExitLoop();
-			assert(SUCCEEDED(hr));
+			std::lock_guard<std::mutex> lock(voice_locker);
+			if (instanceinternal->exit_loop)
+				return;
+			instanceinternal->exit_loop = true;
+			if (instanceinternal->stream != nullptr)
+			{
+				// The stream continues to the end of the file instead of the loop region:
+				std::lock_guard<std::mutex> lock(instanceinternal->stream->locker);
+				instanceinternal->stream->exit_loop = true;
+			}
+			else if (instanceinternal->voice != nullptr)
+			{
+				HRESULT hr = instanceinternal->voice->sourceVoice->ExitLoop();
+				assert(SUCCEEDED(hr));
+			}
 		}
 	}
 
@@ -484,75 +961,266 @@ namespace wiAudio
 		return volume;
 	}
 
+	// The result of the X3DAudio calculation of an instance, the output matrix is written separately
+	struct Spatialization
+	{
+		float frequencyRatio = 1;
+		float lpfDirect = 1;
+		float reverbLevel = 0;
+		float lpfReverb = 1;
+		float attenuation = 1;
+	};
+	// Only reads the creation time state of the instance, so it doesn't need the lock
+	void CalculateSpatialization(const SoundInstanceInternal& instance, const SoundInstance3D& instance3D, float* outputMatrix, Spatialization& result)
+	{
+		X3DAUDIO_LISTENER listener = {};
+		listener.Position = instance3D.listenerPos;
+		listener.OrientFront = instance3D.listenerFront;
+		listener.OrientTop = instance3D.listenerUp;
+		listener.Velocity = instance3D.listenerVelocity;
+
+		X3DAUDIO_EMITTER emitter = {};
+		emitter.Position = instance3D.emitterPos;
+		emitter.OrientFront = instance3D.emitterFront;
+		emitter.OrientTop = instance3D.emitterUp;
+		emitter.Velocity = instance3D.emitterVelocity;
+		emitter.InnerRadius = instance3D.emitterRadius;
+		emitter.InnerRadiusAngle = X3DAUDIO_PI / 4.0f;
+		emitter.ChannelCount = instance.channels;
+		emitter.pChannelAzimuths = const_cast<float*>(instance.channelAzimuths.data());
+		emitter.ChannelRadius = 0.1f;
+		emitter.CurveDistanceScaler = 1;
+		emitter.DopplerScaler = 1;
+
+		UINT32 flags = 0;
+		flags |= X3DAUDIO_CALCULATE_MATRIX;
+		flags |= X3DAUDIO_CALCULATE_LPF_DIRECT;
+		flags |= X3DAUDIO_CALCULATE_REVERB;
+		flags |= X3DAUDIO_CALCULATE_LPF_REVERB;
+		flags |= X3DAUDIO_CALCULATE_DOPPLER;
+		//flags |= X3DAUDIO_CALCULATE_DELAY;
+		//flags |= X3DAUDIO_CALCULATE_EMITTER_ANGLE;
+		//flags |= X3DAUDIO_CALCULATE_ZEROCENTER;
+		//flags |= X3DAUDIO_CALCULATE_REDIRECT_TO_LFE;
+
+		X3DAUDIO_DSP_SETTINGS settings = {};
+		settings.SrcChannelCount = instance.channels;
+		settings.DstChannelCount = instance.audio->masteringVoiceDetails.InputChannels;
+		settings.pMatrixCoefficients = outputMatrix;
+
+		X3DAudioCalculate(instance.audio->audio3D, &listener, &emitter, flags, &settings);
+
+		result.frequencyRatio = settings.DopplerFactor;
+		result.lpfDirect = settings.LPFDirectCoefficient;
+		result.reverbLevel = settings.ReverbLevel;
+		result.lpfReverb = settings.LPFReverbCoefficient;
+		float gain = 0;
+		for (UINT32 i = 0; i < settings.SrcChannelCount * settings.DstChannelCount; ++i)
+		{
+			gain += outputMatrix[i];
+		}
+		result.attenuation = settings.SrcChannelCount > 0 ? gain / float(settings.SrcChannelCount) : 0;
+	}
+	// The settings are kept for when a virtual instance gets a voice. The lock must be held
+	void StoreSpatialization(SoundInstanceInternal& instance, const float* outputMatrix, const Spatialization& result, UINT32 operationSet)
+	{
+		instance.spatialized = true;
+		instance.frequencyRatio = result.frequencyRatio;
+		instance.lpfDirect = result.lpfDirect;
+		instance.reverbLevel = result.reverbLevel;
+		instance.lpfReverb = result.lpfReverb;
+		instance.attenuation = result.attenuation;
+		if (outputMatrix != instance.outputMatrix.data())
+		{
+			std::copy(outputMatrix, outputMatrix + instance.outputMatrix.size(), instance.outputMatrix.begin());
+		}
+
+		if (instance.voice != nullptr)
+		{
+			ApplyVoiceSettings(instance, operationSet);
+		}
+	}
+
 	void Update3D(SoundInstance* instance, const SoundInstance3D& instance3D)
 	{
 		if (instance != nullptr && instance->IsValid())
 		{
 			auto instanceinternal = to_internal(instance);
+			std::lock_guard<std::mutex> lock(voice_locker);
+			Spatialization result;
+			CalculateSpatialization(*instanceinternal, instance3D, instanceinternal->outputMatrix.data(), result);
+			StoreSpatialization(*instanceinternal, instanceinternal->outputMatrix.data(), result, XAUDIO2_COMMIT_NOW);
+		}
+	}
+	void Update3D(SoundInstance* const* instances, const SoundInstance3D* instances3D, uint32_t count)
+	{
+		if (count == 0)
+			return;
 
-			X3DAUDIO_LISTENER listener = {};
-			listener.Position = instance3D.listenerPos;
-			listener.OrientFront = instance3D.listenerFront;
-			listener.OrientTop = instance3D.listenerUp;
-			listener.Velocity = instance3D.listenerVelocity;
-
-			X3DAUDIO_EMITTER emitter = {};
-			emitter.Position = instance3D.emitterPos;
-			emitter.OrientFront = instance3D.emitterFront;
-			emitter.OrientTop = instance3D.emitterUp;
-			emitter.Velocity = instance3D.emitterVelocity;
-			emitter.InnerRadius = instance3D.emitterRadius;
-			emitter.InnerRadiusAngle = X3DAUDIO_PI / 4.0f;
-			emitter.ChannelCount = instanceinternal->voiceDetails.InputChannels;
-			emitter.pChannelAzimuths = instanceinternal->channelAzimuths.data();
-			emitter.ChannelRadius = 0.1f;
-			emitter.CurveDistanceScaler = 1;
-			emitter.DopplerScaler = 1;
-
-			UINT32 flags = 0;
-			flags |= X3DAUDIO_CALCULATE_MATRIX;
-			flags |= X3DAUDIO_CALCULATE_LPF_DIRECT;
-			flags |= X3DAUDIO_CALCULATE_REVERB;
-			flags |= X3DAUDIO_CALCULATE_LPF_REVERB;
-			flags |= X3DAUDIO_CALCULATE_DOPPLER;
-			//flags |= X3DAUDIO_CALCULATE_DELAY;
-			//flags |= X3DAUDIO_CALCULATE_EMITTER_ANGLE;
-			//flags |= X3DAUDIO_CALCULATE_ZEROCENTER;
-			//flags |= X3DAUDIO_CALCULATE_REDIRECT_TO_LFE;
-
-			X3DAUDIO_DSP_SETTINGS settings = {};
-			settings.SrcChannelCount = instanceinternal->voiceDetails.InputChannels;
-			settings.DstChannelCount = audio->masteringVoiceDetails.InputChannels;
-			settings.pMatrixCoefficients = instanceinternal->outputMatrix.data();
-
-			X3DAudioCalculate(audio->audio3D, &listener, &emitter, flags, &settings);
+		// Every instance gets its own range in the scratch memory, so the calculations can run in parallel without the lock:
+		std::vector<uint32_t> offsets(count);
+		uint32_t matrix_size = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			offsets[i] = matrix_size;
+			if (instances[i] != nullptr && instances[i]->IsValid())
+			{
+				matrix_size += (uint32_t)to_internal(instances[i])->outputMatrix.size();
+			}
+		}
+		std::vector<float> matrices(matrix_size);
+		std::vector<Spatialization> results(count);
 
-			HRESULT hr;
+		wiJobSystem::context ctx;
+		wiJobSystem::Dispatch(ctx, count, 16, [&](wiJobArgs args) {
+			const SoundInstance* instance = instances[args.jobIndex];
+			if (instance != nullptr && instance->IsValid())
+			{
+				CalculateSpatialization(*to_internal(instance), instances3D[args.jobIndex], matrices.data() + offsets[args.jobIndex], results[args.jobIndex]);
+			}
+		});
+		wiJobSystem::Wait(ctx);
 
-			hr = instanceinternal->sourceVoice->SetFrequencyRatio(settings.DopplerFactor);
-			assert(SUCCEEDED(hr));
+		// The voice changes are deferred into one operation set and committed together, so they take effect in the same audio frame:
+		static std::atomic<UINT32> next_operation_set{ 1 };
+		UINT32 operationSet = next_operation_set.fetch_add(1);
+		if (operationSet == XAUDIO2_COMMIT_NOW)
+		{
+			operationSet = next_operation_set.fetch_add(1);
+		}
+		{
+			std::lock_guard<std::mutex> lock(voice_locker);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				if (instances[i] != nullptr && instances[i]->IsValid())
+				{
+					StoreSpatialization(*to_internal(instances[i]), matrices.data() + offsets[i], results[i], operationSet);
+				}
+			}
+		}
+		HRESULT hr = audio->audioEngine->CommitChanges(operationSet);
+		assert(SUCCEEDED(hr));
+	}
 
-			hr = instanceinternal->sourceVoice->SetOutputMatrix(
-				audio->submixVoices[instance->type],
-				settings.SrcChannelCount, 
-				settings.DstChannelCount, 
-				settings.pMatrixCoefficients
-			);
-			assert(SUCCEEDED(hr));
-			
-			XAUDIO2_FILTER_PARAMETERS FilterParametersDirect = { LowPassFilter, 2.0f * sinf(X3DAUDIO_PI / 6.0f * settings.LPFDirectCoefficient), 1.0f };
-			hr = instanceinternal->sourceVoice->SetOutputFilterParameters(audio->submixVoices[instance->type], &FilterParametersDirect);
-			assert(SUCCEEDED(hr));
+	void SetMaxVoices(uint32_t count)
+	{
+		std::lock_guard<std::mutex> lock(voice_locker);
+		max_voices = count;
+	}
+	uint32_t GetMaxVoices()
+	{
+		return max_voices;
+	}
 
-			if (instance->IsEnableReverb())
+	void Update(float dt)
+	{
+		if (audio == nullptr || !audio->success)
+			return;
+
+		std::lock_guard<std::mutex> lock(voice_locker);
+		AudioInternal& audioref = *audio;
+
+		// Voices that were taken away faded out since the last update, they are stopped and returned to the pool once their buffers are released:
+		for (size_t i = 0; i < audioref.retiring_voices.size();)
+		{
+			RetiringVoice& retiring = audioref.retiring_voices[i];
+			IXAudio2SourceVoice* sourceVoice = retiring.voice->sourceVoice;
+			if (!retiring.flushed)
 			{
-				hr = instanceinternal->sourceVoice->SetOutputMatrix(audio->reverbSubmix, settings.SrcChannelCount, 1, &settings.ReverbLevel);
+				HRESULT hr = sourceVoice->Stop();
 				assert(SUCCEEDED(hr));
-				XAUDIO2_FILTER_PARAMETERS FilterParametersReverb = { LowPassFilter, 2.0f * sinf(X3DAUDIO_PI / 6.0f * settings.LPFReverbCoefficient), 1.0f };
-				hr = instanceinternal->sourceVoice->SetOutputFilterParameters(audio->reverbSubmix, &FilterParametersReverb);
+				hr = sourceVoice->FlushSourceBuffers();
 				assert(SUCCEEDED(hr));
+				retiring.flushed = true;
+				i++;
+				continue;
+			}
+			XAUDIO2_VOICE_STATE state = {};
+			sourceVoice->GetState(&state, XAUDIO2_VOICE_NOSAMPLESPLAYED);
+			if (state.BuffersQueued > 0)
+			{
+				i++;
+				continue;
+			}
+			{
+				std::lock_guard<std::mutex> voicelock(retiring.voice->locker);
+				retiring.voice->stream.reset();
+				retiring.voice->keepalive.reset();
 			}
+			audioref.free_voices.push_back(retiring.voice);
+			audioref.retiring_voices[i] = audioref.retiring_voices.back();
+			audioref.retiring_voices.pop_back();
 		}
+
+		// The cursors of virtual instances move as if they were playing:
+		static std::vector<SoundInstanceInternal*> audible;
+		audible.clear();
+		for (SoundInstanceInternal* instance : instances)
+		{
+			if (instance->playing)
+			{
+				if (instance->voice != nullptr)
+				{
+					UpdateCursor(*instance);
+				}
+				else
+				{
+					const float frames = dt * float(instance->sample_rate) * instance->frequencyRatio + instance->fraction;
+					instance->fraction = frames - std::floor(frames);
+					AdvanceCursor(*instance, uint64_t(std::max(0.0f, frames)));
+				}
+			}
+			if (instance->playing)
+			{
+				instance->audibility = instance->volume * instance->attenuation;
+				if (instance->voice != nullptr)
+				{
+					// The instances that have a voice keep it unless an other one is clearly louder:
+					instance->audibility *= 1.1f;
+				}
+				audible.push_back(instance);
+			}
+			else if (instance->voice != nullptr)
+			{
+				ReleaseVoice(*instance);
+			}
+		}
+
+		// Only the most audible instances have voices:
+		if (audible.size() > max_voices)
+		{
+			std::nth_element(audible.begin(), audible.begin() + max_voices, audible.end(), [](const SoundInstanceInternal* a, const SoundInstanceInternal* b) {
+				return a->audibility > b->audibility;
+			});
+			for (size_t i = max_voices; i < audible.size(); ++i)
+			{
+				if (audible[i]->voice != nullptr)
+				{
+					ReleaseVoice(*audible[i]);
+				}
+			}
+			audible.resize(max_voices);
+		}
+		for (SoundInstanceInternal* instance : audible)
+		{
+			if (instance->voice == nullptr)
+			{
+				AcquireVoice(*instance);
+			}
+		}
+
+		static const wiCounters::counter_id counter_real = wiCounters::Register("Audio.RealVoices", wiCounters::TYPE_GAUGE);
+		static const wiCounters::counter_id counter_virtual = wiCounters::Register("Audio.VirtualVoices", wiCounters::TYPE_GAUGE);
+		uint32_t virtual_count = 0;
+		for (const SoundInstanceInternal* instance : instances)
+		{
+			if (instance->playing && instance->voice == nullptr)
+			{
+				virtual_count++;
+			}
+		}
+		wiCounters::Set(counter_real, (double)real_voice_count);
+		wiCounters::Set(counter_virtual, (double)virtual_count);
 	}
 
 	void SetReverb(REVERB_PRESET preset)
@@ -570,6 +1238,9 @@ namespace wiAudio
 {
 	void Initialize() {}
 
+	void SetStreamingThreshold(float seconds) {}
+	float GetStreamingThreshold() { return 0; }
+
 	bool CreateSound(const std::string& filename, Sound* sound) { return false; }
 	bool CreateSound(const std::vector<uint8_t>& data, Sound* sound) { return false; }
 	bool CreateSound(const uint8_t* data, size_t size, Sound* sound) { return false; }
@@ -586,6 +1257,11 @@ namespace wiAudio
 	float GetSubmixVolume(SUBMIX_TYPE type) { return 0; }
 
 	void Update3D(SoundInstance* instance, const SoundInstance3D& instance3D) {}
+	void Update3D(SoundInstance* const* instances, const SoundInstance3D* instances3D, uint32_t count) {}
+
+	void SetMaxVoices(uint32_t count) {}
+	uint32_t GetMaxVoices() { return 0; }
+	void Update(float dt) {}
 
 	void SetReverb(REVERB_PRESET preset) {}
 }
@@ -45,6 +45,11 @@ namespace wiAudio
 		inline bool IsEnableReverb() const { return _flags & ENABLE_REVERB; }
 	};
 
+	// Ogg Vorbis sounds that are longer than this many seconds are streamed: every instance decodes them in small chunks while it plays
+	//	Shorter sounds are decoded fully when the sound is created. Default is 20 seconds
+	void SetStreamingThreshold(float seconds);
+	float GetStreamingThreshold();
+
 	bool CreateSound(const std::string& filename, Sound* sound);
 	bool CreateSound(const std::vector<uint8_t>& data, Sound* sound);
 	bool CreateSound(const uint8_t* data, size_t size, Sound* sound);
@@ -73,6 +78,16 @@ namespace wiAudio
 		float emitterRadius = 0;
 	};
 	void Update3D(SoundInstance* instance, const SoundInstance3D& instance3D);
+	// Updates many sound instances at once: the X3DAudio calculations run on worker threads, then the changes of every voice are committed together in one XAudio2 operation set
+	void Update3D(SoundInstance* const* instances, const SoundInstance3D* instances3D, uint32_t count);
+
+	// Only this many of the playing sound instances have an XAudio2 voice, the most audible ones by their volume and 3D attenuation
+	//	The others are virtual: their playback position moves on without being mixed, and they get a voice again when they become audible enough. Default is 64
+	//	The voices are pooled by the sound format and reused between the instances
+	void SetMaxVoices(uint32_t count);
+	uint32_t GetMaxVoices();
+	// Assigns the voices to the sound instances, it is called once per frame by the MainComponent
+	void Update(float dt);
 
 	enum REVERB_PRESET
 	{
@@ -0,0 +1,269 @@
+#include "wiBVH.h"
+#include "wiArchive.h"
+
+#include <algorithm>
+#include <numeric>
+
+float wiBVH::SurfaceArea(const AABB& aabb)
+{
+	const XMFLOAT3 extents = XMFLOAT3(
+		std::max(0.0f, aabb._max.x - aabb._min.x),
+		std::max(0.0f, aabb._max.y - aabb._min.y),
+		std::max(0.0f, aabb._max.z - aabb._min.z)
+	);
+	return 2 * (extents.x * extents.y + extents.y * extents.z + extents.z * extents.x);
+}
+
+void wiBVH::Build(const AABB* aabbs, uint32_t count)
+{
+	Clear();
+	if (count == 0)
+	{
+		return;
+	}
+	itemCount = count;
+
+	std::vector<uint32_t> order(count);
+	std::iota(order.begin(), order.end(), 0);
+	std::vector<XMFLOAT3> centers(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		// Unbounded boxes (for example directional lights) are centered to the origin:
+		const AABB& aabb = aabbs[i];
+		centers[i] = aabb._max.x - aabb._min.x < FLT_MAX ? aabb.getCenter() : XMFLOAT3(0, 0, 0);
+	}
+
+	struct Range
+	{
+		uint32_t node;
+		uint32_t begin;
+		uint32_t end;
+	};
+	std::vector<Range> stack;
+	stack.push_back({ 0, 0, count });
+	nodes.emplace_back();
+
+	// Top-down median split along the largest axis of the centers' bounds, parents are always placed before their children:
+	while (!stack.empty())
+	{
+		const Range range = stack.back();
+		stack.pop_back();
+
+		AABB bounds;
+		XMFLOAT3 center_min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 center_max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (uint32_t i = range.begin; i < range.end; ++i)
+		{
+			bounds = AABB::Merge(bounds, aabbs[order[i]]);
+			const XMFLOAT3& center = centers[order[i]];
+			center_min = XMFLOAT3(std::min(center_min.x, center.x), std::min(center_min.y, center.y), std::min(center_min.z, center.z));
+			center_max = XMFLOAT3(std::max(center_max.x, center.x), std::max(center_max.y, center.y), std::max(center_max.z, center.z));
+		}
+		nodes[range.node].aabb = bounds;
+
+		const uint32_t rangeCount = range.end - range.begin;
+		if (rangeCount <= leaf_size)
+		{
+			Node& leaf = nodes[range.node];
+			leaf.left = (uint32_t)items.size();
+			leaf.count = rangeCount;
+			items.insert(items.end(), order.begin() + range.begin, order.begin() + range.end);
+			items.resize(items.size() + leaf_size - rangeCount, INVALID_ITEM);
+			continue;
+		}
+
+		const XMFLOAT3 extents = XMFLOAT3(center_max.x - center_min.x, center_max.y - center_min.y, center_max.z - center_min.z);
+		const int axis = extents.x > extents.y && extents.x > extents.z ? 0 : (extents.y > extents.z ? 1 : 2);
+		const uint32_t mid = range.begin + rangeCount / 2;
+		std::nth_element(order.begin() + range.begin, order.begin() + mid, order.begin() + range.end, [&](uint32_t a, uint32_t b) {
+			return (&centers[a].x)[axis] < (&centers[b].x)[axis];
+		});
+
+		const uint32_t left = (uint32_t)nodes.size();
+		nodes[range.node].left = left;
+		nodes.emplace_back();
+		nodes.emplace_back();
+		stack.push_back({ left + 1, mid, range.end });
+		stack.push_back({ left, range.begin, mid });
+	}
+
+	leaf_boxes.resize(items.size());
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		if (items[i] != INVALID_ITEM)
+		{
+			leaf_boxes.set(i, aabbs[items[i]]);
+		}
+	}
+
+	buildCost = 0;
+	for (const Node& node : nodes)
+	{
+		buildCost += SurfaceArea(node.aabb);
+	}
+}
+
+bool wiBVH::Refit(const AABB* aabbs)
+{
+	float cost = 0;
+	for (size_t i = nodes.size(); i > 0; --i)
+	{
+		Node& node = nodes[i - 1];
+		if (node.IsLeaf())
+		{
+			node.aabb = AABB();
+			for (uint32_t j = node.left; j < node.left + node.count; ++j)
+			{
+				const AABB& aabb = aabbs[items[j]];
+				node.aabb = AABB::Merge(node.aabb, aabb);
+				leaf_boxes.set(j, aabb);
+			}
+		}
+		else
+		{
+			node.aabb = AABB::Merge(nodes[node.left].aabb, nodes[node.left + 1].aabb);
+		}
+		cost += SurfaceArea(node.aabb);
+	}
+
+	// The tree quality is measured by the summed node areas, moving boxes apart makes it grow:
+	return !(cost > buildCost * 2);
+}
+
+void wiBVH::Clear()
+{
+	nodes.clear();
+	items.clear();
+	leaf_boxes.resize(0);
+	itemCount = 0;
+	buildCost = 0;
+}
+
+void wiBVH::Serialize(wiArchive& archive)
+{
+	if (archive.IsReadMode())
+	{
+		Clear();
+
+		size_t nodeCount;
+		archive >> nodeCount;
+		nodes.resize(nodeCount);
+		for (Node& node : nodes)
+		{
+			archive >> node.aabb._min;
+			archive >> node.aabb._max;
+			archive >> node.left;
+			archive >> node.count;
+		}
+		archive >> items;
+		archive >> itemCount;
+		archive >> buildCost;
+
+		archive >> leaf_boxes.min_x;
+		archive >> leaf_boxes.min_y;
+		archive >> leaf_boxes.min_z;
+		archive >> leaf_boxes.max_x;
+		archive >> leaf_boxes.max_y;
+		archive >> leaf_boxes.max_z;
+		leaf_boxes.count = items.size();
+	}
+	else
+	{
+		archive << nodes.size();
+		for (const Node& node : nodes)
+		{
+			archive << node.aabb._min;
+			archive << node.aabb._max;
+			archive << node.left;
+			archive << node.count;
+		}
+		archive << items;
+		archive << itemCount;
+		archive << buildCost;
+
+		archive << leaf_boxes.min_x;
+		archive << leaf_boxes.min_y;
+		archive << leaf_boxes.min_z;
+		archive << leaf_boxes.max_x;
+		archive << leaf_boxes.max_y;
+		archive << leaf_boxes.max_z;
+	}
+}
+
+// Classifies a box against the frustum planes with the nearest and furthest corners along each plane normal
+static Frustum::BoxFrustumIntersect ClassifyBox(const Frustum& frustum, const AABB& box)
+{
+	const XMVECTOR max = XMLoadFloat3(&box._max);
+	const XMVECTOR min = XMLoadFloat3(&box._min);
+	const XMVECTOR zero = XMVectorZero();
+	Frustum::BoxFrustumIntersect result = Frustum::BOX_FRUSTUM_INSIDE;
+	for (int p = 0; p < 6; ++p)
+	{
+		const XMVECTOR plane = XMLoadFloat4(&frustum.planes[p]);
+		const XMVECTOR lt = XMVectorLess(plane, zero);
+		const XMVECTOR furthestFromPlane = XMVectorSelect(max, min, lt);
+		if (XMVectorGetX(XMPlaneDotCoord(plane, furthestFromPlane)) < 0.0f)
+		{
+			return Frustum::BOX_FRUSTUM_OUTSIDE;
+		}
+		const XMVECTOR nearestToPlane = XMVectorSelect(min, max, lt);
+		if (XMVectorGetX(XMPlaneDotCoord(plane, nearestToPlane)) < 0.0f)
+		{
+			result = Frustum::BOX_FRUSTUM_INTERSECTS;
+		}
+	}
+	return result;
+}
+
+void wiBVH::CullFrustum(const Frustum& frustum, uint32_t* mask) const
+{
+	std::fill(mask, mask + GetMaskSize(), 0u);
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	struct Entry
+	{
+		uint32_t node;
+		bool inside; // the parent is completely inside, so there is nothing to test
+	};
+	Entry stack[64];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = { 0, false };
+	while (stackSize > 0)
+	{
+		const Entry entry = stack[--stackSize];
+		const Node& node = nodes[entry.node];
+
+		bool inside = entry.inside;
+		if (!inside)
+		{
+			const Frustum::BoxFrustumIntersect intersect = ClassifyBox(frustum, node.aabb);
+			if (intersect == Frustum::BOX_FRUSTUM_OUTSIDE)
+			{
+				continue;
+			}
+			inside = intersect == Frustum::BOX_FRUSTUM_INSIDE;
+		}
+
+		if (node.IsLeaf())
+		{
+			const uint32_t visible = inside ? ~0u : frustum.CheckBoxes4(leaf_boxes, node.left);
+			for (uint32_t i = 0; i < node.count; ++i)
+			{
+				if ((visible >> i) & 1)
+				{
+					const uint32_t item = items[node.left + i];
+					mask[item / 32] |= 1u << (item % 32);
+				}
+			}
+		}
+		else
+		{
+			assert(stackSize + 2 <= arraysize(stack));
+			stack[stackSize++] = { node.left + 1, inside };
+			stack[stackSize++] = { node.left, inside };
+		}
+	}
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include "CommonInclude.h"
+#include "wiIntersect.h"
+
+#include <vector>
+
+class wiArchive;
+
+// CPU bounding volume hierarchy over an array of AABBs (for example the aabb_objects of a scene)
+//	Build() creates the tree, Refit() updates the node bounds after the boxes moved but keeps the tree structure
+//	Every leaf holds up to 4 items, and leaf boxes are also kept in structure of arrays layout, so they can be tested by one 4-wide kernel
+class wiBVH
+{
+public:
+	static constexpr uint32_t leaf_size = 4;
+	static constexpr uint32_t INVALID_ITEM = ~0u;
+
+	struct Node
+	{
+		AABB aabb;
+		uint32_t left = 0; // inner node: index of the first child (the second child is left + 1), leaf: first item slot
+		uint32_t count = 0; // number of items in a leaf, 0 for inner nodes
+		inline bool IsLeaf() const { return count > 0; }
+	};
+
+	// Create the tree for count boxes, the items are referred to by their index in the aabbs array
+	void Build(const AABB* aabbs, uint32_t count);
+	// Update the tree bounds from the boxes that were used to build it (same count and order)
+	//	Returns false if the tree has degraded too much from moving boxes, and should be rebuilt
+	bool Refit(const AABB* aabbs);
+	void Clear();
+	void Serialize(wiArchive& archive);
+
+	inline bool IsEmpty() const { return nodes.empty(); }
+	inline size_t GetMemorySize() const { return nodes.capacity() * sizeof(Node) + items.capacity() * sizeof(uint32_t) + leaf_boxes.min_x.capacity() * sizeof(float) * 6; }
+	inline uint32_t GetItemCount() const { return itemCount; }
+
+	// Calls func(item) for every item inside leaves whose bounds pass overlaps(const AABB&)
+	//	The item boxes themselves are not tested, that is up to the caller
+	template<typename Overlaps, typename F>
+	inline void Intersects(Overlaps overlaps, F func) const
+	{
+		if (nodes.empty())
+		{
+			return;
+		}
+		uint32_t stack[64];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const Node& node = nodes[stack[--stackSize]];
+			if (!overlaps(node.aabb))
+			{
+				continue;
+			}
+			if (node.IsLeaf())
+			{
+				for (uint32_t i = 0; i < node.count; ++i)
+				{
+					func(items[node.left + i]);
+				}
+			}
+			else
+			{
+				assert(stackSize + 2 <= arraysize(stack));
+				stack[stackSize++] = node.left + 1;
+				stack[stackSize++] = node.left;
+			}
+		}
+	}
+
+	// Traversal for a packet of up to 32 rays (or other queries), that share the visited nodes
+	//	overlaps(const AABB&, uint32_t mask) returns the subset of the mask whose rays can hit the box
+	//	func(item, mask) is called for every item inside leaves that were reached, with the mask of rays that reached them
+	template<typename Overlaps, typename F>
+	inline void IntersectsPacket(uint32_t mask, Overlaps overlaps, F func) const
+	{
+		if (nodes.empty() || mask == 0)
+		{
+			return;
+		}
+		struct Entry
+		{
+			uint32_t node;
+			uint32_t mask;
+		};
+		Entry stack[64];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = { 0, mask };
+		while (stackSize > 0)
+		{
+			const Entry entry = stack[--stackSize];
+			const Node& node = nodes[entry.node];
+			const uint32_t active = overlaps(node.aabb, entry.mask);
+			if (active == 0)
+			{
+				continue;
+			}
+			if (node.IsLeaf())
+			{
+				for (uint32_t i = 0; i < node.count; ++i)
+				{
+					func(items[node.left + i], active);
+				}
+			}
+			else
+			{
+				assert(stackSize + 2 <= arraysize(stack));
+				stack[stackSize++] = { node.left + 1, active };
+				stack[stackSize++] = { node.left, active };
+			}
+		}
+	}
+
+	// Frustum culling of every item: bit (item % 32) of mask[item / 32] is set if the item box is inside or intersecting the frustum
+	//	The mask must have room for GetMaskSize() elements
+	//	The items of subtrees that are completely inside are accepted without further tests
+	void CullFrustum(const Frustum& frustum, uint32_t* mask) const;
+	inline uint32_t GetMaskSize() const { return (itemCount + 31) / 32; }
+	static inline bool IsVisible(const uint32_t* mask, uint32_t item) { return (mask[item / 32] >> (item % 32)) & 1; }
+
+private:
+	std::vector<Node> nodes;
+	std::vector<uint32_t> items; // item indices in leaf order, every leaf starts at a multiple of leaf_size (unused slots are INVALID_ITEM)
+	AABB_SOA leaf_boxes; // item boxes in the same order as items
+	uint32_t itemCount = 0;
+	float buildCost = 0;
+
+	static float SurfaceArea(const AABB& aabb);
+};
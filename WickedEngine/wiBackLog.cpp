@@ -10,17 +10,71 @@
 #include "wiLua.h"
 #include "wiInput.h"
 #include "wiPlatform.h"
+#include "wiContainers.h"
 
 #include <mutex>
 #include <deque>
+#include <thread>
+#include <chrono>
+#include <cstring>
 
 using namespace wiGraphics;
 
 
 namespace wiBackLog
 {
+	// Posted messages are copied into preallocated slots of a lock-free queue, longer messages are truncated, and a full queue drops them
+	static constexpr size_t MESSAGE_SIZE = 512;
+	static constexpr size_t QUEUE_SIZE = 2048;
+	struct Message
+	{
+		uint32_t length = 0;
+		char text[MESSAGE_SIZE];
+	};
+	wiContainers::MultiProducerRingBuffer<Message>& GetQueue()
+	{
+		static wiContainers::MultiProducerRingBuffer<Message>* queue = [] {
+			auto q = new wiContainers::MultiProducerRingBuffer<Message>; // not destroyed, so that it outlives the static objects that post at exit
+			q->init(QUEUE_SIZE);
+			return q;
+		}();
+		return *queue;
+	}
+	std::atomic<uint64_t> dropped{ 0 };
+	uint64_t droppedReported = 0; // by the draining thread
+	wiSpinLock drainLock; // held by the thread that drains the queue
+
+	// The drained lines are kept in a bounded ring, the strings are reused:
+	std::vector<std::string> stream;
+	size_t streamStart = 0;
+	size_t streamCount = 0;
+	std::string streamText; // all the lines, rebuilt when it changed
+	bool streamTextDirty = false;
+	std::string drained; // scratch line of the draining thread
+
+	// The writer thread drains the queue asynchronously, and writes the log file:
+	struct AsyncWriter
+	{
+		std::thread thread;
+		std::atomic_bool exit{ false };
+		std::ofstream file;
+		~AsyncWriter()
+		{
+			stop();
+		}
+		void stop()
+		{
+			if (thread.joinable())
+			{
+				exit.store(true);
+				thread.join();
+				exit.store(false);
+			}
+		}
+	} writer;
+	std::atomic_bool asyncWriting{ false };
+
 	bool enabled = false;
-	std::deque<std::string> stream;
 	std::deque<std::string> history;
 	const float speed = 50.0f;
 	unsigned int deletefromline = 500;
@@ -31,7 +85,54 @@ namespace wiBackLog
 	wiSpriteFont font;
 	wiSpinLock logLock;
 	Texture backgroundTex;
-	bool refitscroll = false;
+	std::atomic_bool refitscroll{ false };
+
+	// Takes the posted messages from the queue, prints them and adds them to the stream. drainLock must be held
+	void DrainQueue()
+	{
+		while (GetQueue().pop([](Message& message) { drained.assign(message.text, message.length); }))
+		{
+#ifdef _WIN32
+			OutputDebugStringA(drained.c_str());
+#endif // _WIN32
+			std::cout << drained;
+			if (writer.file.is_open())
+			{
+				writer.file << drained;
+			}
+
+			logLock.lock();
+			if (stream.size() < deletefromline)
+			{
+				stream.resize(deletefromline);
+			}
+			if (streamCount < stream.size())
+			{
+				stream[(streamStart + streamCount) % stream.size()].assign(drained);
+				streamCount++;
+			}
+			else
+			{
+				stream[streamStart].assign(drained);
+				streamStart = (streamStart + 1) % stream.size();
+			}
+			streamTextDirty = true;
+			logLock.unlock();
+			refitscroll.store(true);
+		}
+
+		const uint64_t count = dropped.load() - droppedReported;
+		if (count > 0)
+		{
+			droppedReported += count;
+			std::string message = "[wiBackLog] " + std::to_string(count) + " messages were dropped\n";
+			std::cout << message;
+			if (writer.file.is_open())
+			{
+				writer.file << message;
+			}
+		}
+	}
 
 	void Toggle() 
 	{
@@ -109,9 +210,8 @@ namespace wiBackLog
 
 
 			font.SetText(getText());
-			if (refitscroll)
+			if (refitscroll.exchange(false))
 			{
-				refitscroll = false;
 				float textheight = font.textHeight();
 				float limit = canvas.GetLogicalHeight() * 0.9f;
 				if (scroll + textheight > limit)
@@ -140,18 +240,26 @@ namespace wiBackLog
 	std::string getText()
 	{
 		logLock.lock();
-		std::string retval;
-		for (auto& x : stream)
+		if (streamTextDirty)
 		{
-			retval += x;
+			streamTextDirty = false;
+			streamText.clear();
+			for (size_t i = 0; i < streamCount; ++i)
+			{
+				streamText += stream[(streamStart + i) % stream.size()];
+			}
 		}
+		std::string retval = streamText;
 		logLock.unlock();
 		return retval;
 	}
 	void clear() 
 	{
 		logLock.lock();
-		stream.clear();
+		streamStart = 0;
+		streamCount = 0;
+		streamText.clear();
+		streamTextDirty = false;
 		scroll = 0;
 		logLock.unlock();
 	}
@@ -160,24 +268,80 @@ namespace wiBackLog
 #ifdef GGREDUCED
 		//LB: Also do not post anything to anything
 #else
-		logLock.lock();
-		std::string str;
-		str = input;
-		str += '\n';
-		stream.push_back(str);
-		if (stream.size() > deletefromline)
+		const size_t length = std::min(strlen(input), MESSAGE_SIZE - 1);
+		const bool pushed = GetQueue().push([&](Message& message) {
+			memcpy(message.text, input, length);
+			message.text[length] = '\n';
+			message.length = uint32_t(length + 1);
+		});
+		if (!pushed)
 		{
-			stream.pop_front();
+			dropped.fetch_add(1);
 		}
-		refitscroll = true;
-		logLock.unlock();
 
-#ifdef _WIN32
-		OutputDebugStringA(str.c_str());
-#endif // _WIN32
-		std::cout << str;
+		if (!asyncWriting.load())
+		{
+			// The posting thread drains the queue, unless an other thread is already doing it, which will see this message too:
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			while (drainLock.try_lock())
+			{
+				DrainQueue();
+				drainLock.unlock();
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (GetQueue().empty())
+				{
+					break;
+				}
+			}
+		}
 #endif
 	}
+	void flush()
+	{
+		drainLock.lock();
+		DrainQueue();
+		if (writer.file.is_open())
+		{
+			writer.file.flush();
+		}
+		drainLock.unlock();
+	}
+	void startAsyncWriter(const std::string& logfile)
+	{
+		stopAsyncWriter();
+		if (!logfile.empty())
+		{
+			writer.file.open(logfile, std::ios::out | std::ios::trunc);
+		}
+		asyncWriting.store(true);
+		writer.thread = std::thread([] {
+			while (true)
+			{
+				drainLock.lock();
+				DrainQueue();
+				drainLock.unlock();
+				if (writer.exit.load())
+				{
+					break; // after the last drain, so that the messages before exit are written
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			}
+		});
+	}
+	void stopAsyncWriter()
+	{
+		writer.stop();
+		asyncWriting.store(false);
+		flush();
+		if (writer.file.is_open())
+		{
+			writer.file.close();
+		}
+	}
+	uint64_t getDroppedCount()
+	{
+		return dropped.load();
+	}
 	void input(const char input) 
 	{
 		inputArea += input;
@@ -15,7 +15,18 @@ namespace wiBackLog
 
 	std::string getText();
 	void clear();
+	// Post a message from any thread. It's copied into a preallocated slot of a lock-free queue (long messages are truncated,
+	//	and the messages are dropped while the queue is full), then the queue is drained into the backlog and printed:
+	//	by the posting thread (unless an other thread is already doing it), or by the async writer thread if it's running
 	void post(const char* input);
+	// Drain the posted messages now
+	void flush();
+	// Drain, print and write the posted messages to the log file (if it's not empty) on a background thread, so posting doesn't print
+	void startAsyncWriter(const std::string& logfile = "");
+	// Stop the background thread after it wrote every message, and close the log file
+	void stopAsyncWriter();
+	// Count of the messages that were dropped because the queue was full
+	uint64_t getDroppedCount();
 	void input(const char input);
 	void acceptInput();
 	void deletefromInput();
@@ -0,0 +1,235 @@
+#include "wiCompression.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace wiCompression
+{
+	static constexpr size_t MIN_MATCH = 4;
+	static constexpr size_t MAX_OFFSET = 65535;
+	static constexpr uint32_t HASH_BITS = 16;
+	static constexpr uint32_t INVALID_POSITION = ~0u;
+
+	static inline uint32_t Read32(const uint8_t* data)
+	{
+		uint32_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+	static inline uint32_t Hash(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	size_t CompressBound(size_t size)
+	{
+		// Incompressible data is a single literal run with its length bytes, and the token
+		return size + size / 255 + 16;
+	}
+
+	size_t Compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity, int level)
+	{
+		level = std::max(LEVEL_FASTEST, std::min(LEVEL_BEST, level));
+		const uint32_t depth = 1u << (level - 1); // candidates that are compared at every position
+		const bool full_insert = level > LEVEL_FASTEST; // the positions inside matches are also remembered
+
+		// The hash table holds the last position of every hashed 4 byte sequence, the chains link to the previous position with the same hash:
+		std::vector<uint32_t> head(size_t(1) << HASH_BITS, INVALID_POSITION);
+		std::vector<uint32_t> chain;
+		if (depth > 1)
+		{
+			chain.resize(size, INVALID_POSITION);
+		}
+		auto insert = [&](size_t position) {
+			const uint32_t hash = Hash(Read32(src + position));
+			if (depth > 1)
+			{
+				chain[position] = head[hash];
+			}
+			head[hash] = (uint32_t)position;
+		};
+
+		uint8_t* out = dst;
+		uint8_t* const out_end = dst + capacity;
+		auto write_length = [&](size_t length) {
+			while (length >= 255)
+			{
+				if (out >= out_end)
+				{
+					return false;
+				}
+				*out++ = 255;
+				length -= 255;
+			}
+			if (out >= out_end)
+			{
+				return false;
+			}
+			*out++ = uint8_t(length);
+			return true;
+		};
+		// A sequence is a token (literal length and match length in 4 bits each), the extended literal length, the literals,
+		//	and if there is a match: the 16 bit offset and the extended match length
+		auto write_sequence = [&](const uint8_t* literals, size_t literal_length, size_t offset, size_t match_length) {
+			if (out >= out_end)
+			{
+				return false;
+			}
+			uint8_t* token = out++;
+			*token = uint8_t(std::min(literal_length, size_t(15)) << 4);
+			if (literal_length >= 15 && !write_length(literal_length - 15))
+			{
+				return false;
+			}
+			if (size_t(out_end - out) < literal_length)
+			{
+				return false;
+			}
+			std::memcpy(out, literals, literal_length);
+			out += literal_length;
+			if (match_length == 0)
+			{
+				return true;
+			}
+			if (out_end - out < 2)
+			{
+				return false;
+			}
+			*out++ = uint8_t(offset & 0xFF);
+			*out++ = uint8_t(offset >> 8);
+			const size_t length = match_length - MIN_MATCH;
+			*token |= uint8_t(std::min(length, size_t(15)));
+			if (length >= 15 && !write_length(length - 15))
+			{
+				return false;
+			}
+			return true;
+		};
+
+		size_t anchor = 0;
+		size_t position = 0;
+		while (position + MIN_MATCH <= size)
+		{
+			const uint32_t sequence = Read32(src + position);
+			size_t best_length = 0;
+			size_t best_offset = 0;
+			uint32_t candidate = head[Hash(sequence)];
+			for (uint32_t tries = 0; tries < depth && candidate != INVALID_POSITION && position - candidate <= MAX_OFFSET; ++tries)
+			{
+				if (Read32(src + candidate) == sequence)
+				{
+					size_t length = MIN_MATCH;
+					while (position + length < size && src[candidate + length] == src[position + length])
+					{
+						length++;
+					}
+					if (length > best_length)
+					{
+						best_length = length;
+						best_offset = position - candidate;
+					}
+				}
+				candidate = depth > 1 ? chain[candidate] : INVALID_POSITION;
+			}
+			insert(position);
+
+			if (best_length >= MIN_MATCH)
+			{
+				if (!write_sequence(src + anchor, position - anchor, best_offset, best_length))
+				{
+					return 0;
+				}
+				const size_t match_end = position + best_length;
+				if (full_insert)
+				{
+					for (size_t i = position + 1; i < match_end && i + MIN_MATCH <= size; ++i)
+					{
+						insert(i);
+					}
+				}
+				position = match_end;
+				anchor = position;
+			}
+			else
+			{
+				position++;
+			}
+		}
+
+		// The last sequence only has literals (possibly none), which tells the decoder where the data ends:
+		if (!write_sequence(src + anchor, size - anchor, 0, 0))
+		{
+			return 0;
+		}
+		return size_t(out - dst);
+	}
+
+	bool Decompress(const uint8_t* src, size_t srcsize, uint8_t* dst, size_t dstsize)
+	{
+		const uint8_t* in = src;
+		const uint8_t* const in_end = src + srcsize;
+		uint8_t* out = dst;
+		uint8_t* const out_end = dst + dstsize;
+		auto read_length = [&](size_t& length) {
+			uint8_t value;
+			do
+			{
+				if (in >= in_end)
+				{
+					return false;
+				}
+				value = *in++;
+				length += value;
+			} while (value == 255);
+			return true;
+		};
+
+		while (in < in_end)
+		{
+			const uint8_t token = *in++;
+			size_t literal_length = token >> 4;
+			if (literal_length == 15 && !read_length(literal_length))
+			{
+				return false;
+			}
+			if (size_t(in_end - in) < literal_length || size_t(out_end - out) < literal_length)
+			{
+				return false;
+			}
+			std::memcpy(out, in, literal_length);
+			in += literal_length;
+			out += literal_length;
+			if (in == in_end)
+			{
+				break;
+			}
+
+			if (in_end - in < 2)
+			{
+				return false;
+			}
+			const size_t offset = size_t(in[0]) | (size_t(in[1]) << 8);
+			in += 2;
+			size_t match_length = token & 15;
+			if (match_length == 15 && !read_length(match_length))
+			{
+				return false;
+			}
+			match_length += MIN_MATCH;
+			if (offset == 0 || offset > size_t(out - dst) || size_t(out_end - out) < match_length)
+			{
+				return false;
+			}
+			// The match can overlap the output that it is copied to, so it is copied byte by byte:
+			const uint8_t* match = out - offset;
+			for (size_t i = 0; i < match_length; ++i)
+			{
+				out[i] = match[i];
+			}
+			out += match_length;
+		}
+
+		return out == out_end;
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "CommonInclude.h"
+
+// Lossless LZ77 byte compression with an LZ4 style sequence format (literal runs followed by back references of up to 64 KB distance)
+//	Decompression speed doesn't depend on the level, higher levels search longer for matches which gives better ratio but slower compression
+namespace wiCompression
+{
+	static constexpr int LEVEL_FASTEST = 1;
+	static constexpr int LEVEL_DEFAULT = 4;
+	static constexpr int LEVEL_BEST = 9;
+
+	// The largest possible compressed size of size bytes
+	size_t CompressBound(size_t size);
+	// Compress size bytes of src into dst, which can hold capacity bytes
+	//	Returns the compressed size, or 0 if it doesn't fit into capacity
+	size_t Compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity, int level = LEVEL_DEFAULT);
+	// Decompress the data that was compressed by Compress() into exactly dstsize bytes
+	//	Returns false if the data is corrupted
+	bool Decompress(const uint8_t* src, size_t srcsize, uint8_t* dst, size_t dstsize);
+};
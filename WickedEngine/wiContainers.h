@@ -1,6 +1,10 @@
 #pragma once
 #include "wiSpinLock.h"
 
+#include <atomic>
+#include <vector>
+#include <memory>
+
 namespace wiContainers
 {
 	// Fixed size very simple thread safe ring buffer
@@ -49,4 +53,160 @@ namespace wiContainers
 		size_t tail = 0;
 		wiSpinLock lock;
 	};
+
+	// Ring buffer for one producer thread and one consumer thread, without locking
+	//	The items are preallocated, they are written and read in place instead of being copied in and out
+	template <typename T>
+	class SingleProducerRingBuffer
+	{
+	public:
+		inline void init(size_t capacity)
+		{
+			data.resize(capacity + 1); // one item is always kept empty to tell a full buffer from an empty one
+			head.store(0);
+			tail.store(0);
+		}
+
+		// Producer: count of the free items that can be written
+		inline size_t writable() const
+		{
+			const size_t h = head.load(std::memory_order_relaxed);
+			const size_t t = tail.load(std::memory_order_acquire);
+			return (t + data.size() - h - 1) % data.size();
+		}
+		// Producer: the free item at an offset from the end, offset must be less than writable()
+		inline T& write_item(size_t offset)
+		{
+			return data[(head.load(std::memory_order_relaxed) + offset) % data.size()];
+		}
+		// Producer: makes the count of written items at the end visible to the consumer
+		inline void push(size_t count)
+		{
+			head.store((head.load(std::memory_order_relaxed) + count) % data.size(), std::memory_order_release);
+		}
+
+		// Consumer: the oldest item, or nullptr if there are none
+		inline T* front()
+		{
+			const size_t t = tail.load(std::memory_order_relaxed);
+			if (t == head.load(std::memory_order_acquire))
+				return nullptr;
+			return &data[t];
+		}
+		// Consumer: releases the oldest item, so that the producer can write it again
+		inline void pop_front()
+		{
+			tail.store((tail.load(std::memory_order_relaxed) + 1) % data.size(), std::memory_order_release);
+		}
+
+	private:
+		std::vector<T> data;
+		alignas(64) std::atomic<size_t> head{ 0 }; // written by the producer
+		alignas(64) std::atomic<size_t> tail{ 0 }; // written by the consumer
+	};
+
+	// Ring buffer for any number of producer and consumer threads, without locking (bounded queue of Dmitry Vyukov)
+	//	The items are preallocated, they are written and read in place by the functions given to push() and pop()
+	template <typename T>
+	class MultiProducerRingBuffer
+	{
+	public:
+		// The capacity is rounded up to a power of two
+		inline void init(size_t capacity)
+		{
+			size_t size = 2;
+			while (size < capacity)
+			{
+				size *= 2;
+			}
+			cells = std::make_unique<Cell[]>(size);
+			mask = size - 1;
+			for (size_t i = 0; i < size; ++i)
+			{
+				cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+			head.store(0, std::memory_order_relaxed);
+			tail.store(0, std::memory_order_relaxed);
+		}
+
+		// Producer: writes a free item with write(T&) if there is any
+		//	Returns false if the buffer is full
+		template <typename F>
+		inline bool push(F&& write)
+		{
+			Cell* cell;
+			size_t pos = head.load(std::memory_order_relaxed);
+			while (true)
+			{
+				cell = &cells[pos & mask];
+				const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+				const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+				if (diff == 0)
+				{
+					if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (diff < 0)
+				{
+					return false;
+				}
+				else
+				{
+					pos = head.load(std::memory_order_relaxed);
+				}
+			}
+			write(cell->data);
+			cell->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer: reads the oldest item with read(T&) if there is any, then releases it
+		//	Returns false if the buffer is empty
+		template <typename F>
+		inline bool pop(F&& read)
+		{
+			Cell* cell;
+			size_t pos = tail.load(std::memory_order_relaxed);
+			while (true)
+			{
+				cell = &cells[pos & mask];
+				const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+				const intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+				if (diff == 0)
+				{
+					if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (diff < 0)
+				{
+					return false;
+				}
+				else
+				{
+					pos = tail.load(std::memory_order_relaxed);
+				}
+			}
+			read(cell->data);
+			cell->sequence.store(pos + mask + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Whether there is an item that pop() can read
+		inline bool empty() const
+		{
+			const size_t pos = tail.load(std::memory_order_relaxed);
+			return cells[pos & mask].sequence.load(std::memory_order_acquire) != pos + 1;
+		}
+
+	private:
+		struct Cell
+		{
+			std::atomic<size_t> sequence;
+			T data;
+		};
+		std::unique_ptr<Cell[]> cells;
+		size_t mask = 0;
+		alignas(64) std::atomic<size_t> head{ 0 }; // written by the producers
+		alignas(64) std::atomic<size_t> tail{ 0 }; // written by the consumers
+	};
 }
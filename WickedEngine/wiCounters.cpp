@@ -0,0 +1,184 @@
+#include "wiCounters.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <mutex>
+#include <sstream>
+
+namespace wiCounters
+{
+	struct Counter
+	{
+		std::string name;
+		TYPE type = TYPE_GAUGE;
+		std::atomic<double> value{ 0 };
+
+		std::mutex locker; // measure and samples
+		std::function<double()> measure;
+		double samples[HISTOGRAM_SAMPLES] = {};
+		uint32_t sampleCount = 0; // total recorded samples, the kept ones are the last HISTOGRAM_SAMPLES of them
+	};
+	Counter counters[MAX_COUNTERS];
+	std::atomic<uint32_t> counterCount{ 0 }; // the counters below this are registered, and their name and type don't change
+	std::mutex registry_locker;
+
+	inline Counter* GetCounter(counter_id id)
+	{
+		if (id >= counterCount.load(std::memory_order_acquire))
+			return nullptr;
+		return &counters[id];
+	}
+
+	counter_id Find_Locked(const std::string& name)
+	{
+		const uint32_t count = counterCount.load(std::memory_order_relaxed);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (counters[i].name == name)
+			{
+				return i;
+			}
+		}
+		return INVALID_COUNTER;
+	}
+
+	counter_id Register(const std::string& name, TYPE type)
+	{
+		std::lock_guard<std::mutex> lock(registry_locker);
+		counter_id id = Find_Locked(name);
+		if (id != INVALID_COUNTER)
+		{
+			return id;
+		}
+		id = counterCount.load(std::memory_order_relaxed);
+		if (id >= MAX_COUNTERS)
+		{
+			assert(0); // increase MAX_COUNTERS
+			return INVALID_COUNTER;
+		}
+		counters[id].name = name;
+		counters[id].type = type;
+		counterCount.store(id + 1, std::memory_order_release);
+		return id;
+	}
+	counter_id Find(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(registry_locker);
+		return Find_Locked(name);
+	}
+
+	void Set(counter_id id, double value)
+	{
+		Counter* counter = GetCounter(id);
+		if (counter == nullptr)
+			return;
+		assert(counter->type == TYPE_GAUGE);
+		counter->value.store(value, std::memory_order_relaxed);
+	}
+	void Add(counter_id id, double value)
+	{
+		Counter* counter = GetCounter(id);
+		if (counter == nullptr)
+			return;
+		assert(counter->type == TYPE_GAUGE);
+		double current = counter->value.load(std::memory_order_relaxed);
+		while (!counter->value.compare_exchange_weak(current, current + value, std::memory_order_relaxed));
+	}
+	void SetMeasurement(counter_id id, std::function<double()> measure)
+	{
+		Counter* counter = GetCounter(id);
+		if (counter == nullptr)
+			return;
+		assert(counter->type == TYPE_GAUGE);
+		std::lock_guard<std::mutex> lock(counter->locker);
+		counter->measure = std::move(measure);
+	}
+
+	void Sample(counter_id id, double value)
+	{
+		Counter* counter = GetCounter(id);
+		if (counter == nullptr)
+			return;
+		assert(counter->type == TYPE_HISTOGRAM);
+		std::lock_guard<std::mutex> lock(counter->locker);
+		counter->samples[counter->sampleCount % HISTOGRAM_SAMPLES] = value;
+		counter->sampleCount++;
+		counter->value.store(value, std::memory_order_relaxed);
+	}
+
+	bool Get(counter_id id, Value& result)
+	{
+		Counter* counter = GetCounter(id);
+		if (counter == nullptr)
+			return false;
+
+		result = {};
+		result.name = counter->name;
+		result.type = counter->type;
+
+		std::lock_guard<std::mutex> lock(counter->locker);
+		if (counter->measure)
+		{
+			counter->value.store(counter->measure(), std::memory_order_relaxed);
+		}
+		result.value = counter->value.load(std::memory_order_relaxed);
+
+		if (counter->type == TYPE_HISTOGRAM && counter->sampleCount > 0)
+		{
+			result.count = std::min(counter->sampleCount, HISTOGRAM_SAMPLES);
+			double sorted[HISTOGRAM_SAMPLES];
+			std::copy(counter->samples, counter->samples + result.count, sorted);
+			std::sort(sorted, sorted + result.count);
+			double sum = 0;
+			for (uint32_t i = 0; i < result.count; ++i)
+			{
+				sum += sorted[i];
+			}
+			result.min = sorted[0];
+			result.max = sorted[result.count - 1];
+			result.avg = sum / result.count;
+			result.p50 = sorted[(result.count - 1) / 2];
+			result.p95 = sorted[(result.count - 1) * 95 / 100];
+		}
+		return true;
+	}
+	bool Get(const std::string& name, Value& result)
+	{
+		return Get(Find(name), result);
+	}
+	void GetAll(std::vector<Value>& result)
+	{
+		const uint32_t count = counterCount.load(std::memory_order_acquire);
+		result.resize(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			Get(i, result[i]);
+		}
+		std::sort(result.begin(), result.end(), [](const Value& a, const Value& b) {
+			return a.name < b.name;
+		});
+	}
+
+	std::string GetReport(const std::string& filter)
+	{
+		std::vector<Value> values;
+		GetAll(values);
+
+		std::stringstream ss;
+		ss.precision(2);
+		ss << std::fixed;
+		for (auto& x : values)
+		{
+			if (x.name.compare(0, filter.length(), filter) != 0)
+				continue;
+			ss << x.name << ": " << x.value;
+			if (x.type == TYPE_HISTOGRAM)
+			{
+				ss << " (avg " << x.avg << ", p50 " << x.p50 << ", p95 " << x.p95 << ", max " << x.max << ", " << x.count << " samples)";
+			}
+			ss << std::endl;
+		}
+		return ss.str();
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "CommonInclude.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Registry of named performance counters, they can be published by any subsystem and read by scripts, the backlog or telemetry
+//	Gauges hold the last value that was set, or the value that their measurement callback returns when they are read
+//	Histograms keep their last HISTOGRAM_SAMPLES samples, and report the distribution of them
+//	Updating a counter by its id doesn't allocate, and gauges are updated without locking, so it is cheap enough to do every frame
+namespace wiCounters
+{
+	enum TYPE
+	{
+		TYPE_GAUGE,
+		TYPE_HISTOGRAM,
+	};
+	typedef uint32_t counter_id;
+	static constexpr counter_id INVALID_COUNTER = ~0u;
+	static constexpr uint32_t MAX_COUNTERS = 256;
+	static constexpr uint32_t HISTOGRAM_SAMPLES = 256;
+
+	// Register a counter, or return the existing one with the same name (then the type is not changed). Returns INVALID_COUNTER if the registry is full
+	//	The names are grouped by a prefix by convention, for example "Renderer.VisibleObjects"
+	counter_id Register(const std::string& name, TYPE type = TYPE_GAUGE);
+	// Returns the counter with this name, or INVALID_COUNTER if it is not registered
+	counter_id Find(const std::string& name);
+
+	// Set the value of a gauge
+	void Set(counter_id id, double value);
+	// Add to the value of a gauge, it is thread safe
+	void Add(counter_id id, double value);
+	// Make a gauge measured, the callback returns its current value. It is called on the thread that reads the counter
+	void SetMeasurement(counter_id id, std::function<double()> measure);
+
+	// Record a sample of a histogram, it is thread safe
+	void Sample(counter_id id, double value);
+
+	struct Value
+	{
+		std::string name;
+		TYPE type = TYPE_GAUGE;
+		double value = 0; // value of a gauge, or the last sample of a histogram
+
+		// Distribution of the kept samples of a histogram:
+		uint32_t count = 0;
+		double min = 0;
+		double max = 0;
+		double avg = 0;
+		double p50 = 0;
+		double p95 = 0;
+	};
+	bool Get(counter_id id, Value& result);
+	bool Get(const std::string& name, Value& result);
+	// Returns every registered counter, sorted by name
+	void GetAll(std::vector<Value>& result);
+
+	// Every counter whose name starts with the filter in a line of text
+	std::string GetReport(const std::string& filter = "");
+}
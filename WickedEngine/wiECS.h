@@ -3,31 +3,133 @@
 
 #include "wiArchive.h"
 #include "wiJobSystem.h"
+#include "wiSpinLock.h"
 
 #include <cstdint>
 #include <cassert>
 #include <vector>
 #include <unordered_map>
 #include <atomic>
-
-#define CACHEARRAY 40000
-#define MAXVAL64 18446744073709551615
+#include <memory>
+#include <algorithm>
+#include <array>
+#include <tuple>
+#include <utility>
 namespace wiECS
 {
+	// An entity is made of an index (lower bits) and a generation (upper bits)
+	//	The index is recycled after the entity is destroyed, while the generation is incremented, 
+	//	so that stale entity handles can be detected and don't alias the entity that reuses the index
 	using Entity = uint32_t;
 	static const Entity INVALID_ENTITY = 0;
+	static constexpr uint32_t ENTITY_INDEX_BITS = 24;
+	static constexpr uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+	static constexpr uint32_t ENTITY_GENERATION_BITS = 32 - ENTITY_INDEX_BITS;
+	static constexpr uint32_t ENTITY_GENERATION_MASK = (1u << ENTITY_GENERATION_BITS) - 1;
+
+	inline uint32_t GetEntityIndex(Entity entity) { return entity & ENTITY_INDEX_MASK; }
+	inline uint32_t GetEntityGeneration(Entity entity) { return (entity >> ENTITY_INDEX_BITS) & ENTITY_GENERATION_MASK; }
+	inline Entity MakeEntity(uint32_t index, uint32_t generation)
+	{
+		assert(index <= ENTITY_INDEX_MASK);
+		return (Entity)(index | ((generation & ENTITY_GENERATION_MASK) << ENTITY_INDEX_BITS));
+	}
+
+	// Hands out entity indices and keeps track of their current generation
+	//	Destroyed indices are only reused once enough of them are queued up, 
+	//	to slow down the wrapping of the generation counter of any single index
+	class EntityAllocator
+	{
+	public:
+		static constexpr size_t MINIMUM_FREE_INDICES = 1024;
+
+		inline Entity Create()
+		{
+			locker.lock();
+			uint32_t index;
+			if (free_indices.size() - free_head > MINIMUM_FREE_INDICES)
+			{
+				index = free_indices[free_head++];
+				if (free_head * 2 > free_indices.size())
+				{
+					// drop the consumed part of the queue:
+					free_indices.erase(free_indices.begin(), free_indices.begin() + free_head);
+					free_head = 0;
+				}
+			}
+			else
+			{
+				index = (uint32_t)generations.size();
+				assert(index <= ENTITY_INDEX_MASK); // ran out of entity indices!
+				generations.push_back(0);
+			}
+			const Entity entity = MakeEntity(index, generations[index]);
+			locker.unlock();
+			return entity;
+		}
+
+		// Returns the index of the entity to the allocator. Stale and repeated destroys are ignored
+		inline void Destroy(Entity entity)
+		{
+			const uint32_t index = GetEntityIndex(entity);
+			locker.lock();
+			if (index != 0 && index < generations.size() && generations[index] == GetEntityGeneration(entity))
+			{
+				generations[index] = uint8_t((generations[index] + 1) & ENTITY_GENERATION_MASK);
+				free_indices.push_back(index);
+			}
+			locker.unlock();
+		}
+
+		// Check whether the entity is the current generation of its index
+		inline bool IsAlive(Entity entity)
+		{
+			const uint32_t index = GetEntityIndex(entity);
+			locker.lock();
+			const bool alive = index != 0 && index < generations.size() && generations[index] == GetEntityGeneration(entity);
+			locker.unlock();
+			return alive;
+		}
+
+	private:
+		static_assert(ENTITY_GENERATION_BITS <= 8, "generations are stored as uint8_t");
+		wiSpinLock locker;
+		std::vector<uint8_t> generations = std::vector<uint8_t>(1, 0); // index 0 is reserved for INVALID_ENTITY
+		std::vector<uint32_t> free_indices;
+		size_t free_head = 0;
+	};
+	inline EntityAllocator& GetEntityAllocator()
+	{
+		static EntityAllocator allocator;
+		return allocator;
+	}
+
 	// Runtime can create a new entity with this
 	inline Entity CreateEntity()
 	{
-		static std::atomic<Entity> next{ INVALID_ENTITY + 1 };
-		return next.fetch_add(1);
+		return GetEntityAllocator().Create();
+	}
+	// Give back an entity to be recycled. The entity must not be used after this, 
+	//	and any remaining handle to it will be rejected by the component managers once the index is reused
+	inline void DestroyEntity(Entity entity)
+	{
+		GetEntityAllocator().Destroy(entity);
+	}
+	inline bool IsEntityAlive(Entity entity)
+	{
+		return GetEntityAllocator().IsAlive(entity);
 	}
 
 	struct EntitySerializer
 	{
 		wiJobSystem::context ctx; // allow components to spawn serialization subtasks
 		std::unordered_map<uint64_t, Entity> remap;
+		wiSpinLock remap_locker; // components can be serialized in parallel
 		bool allow_remap = true;
+		// The chunk archives of the components that were read are kept alive until the subtasks finish, 
+		//	because those can still refer to the archive (for example to its directory)
+		std::vector<std::unique_ptr<wiArchive>> chunk_archives;
+		wiSpinLock chunk_locker; // component managers can be serialized in parallel
 
 		~EntitySerializer()
 		{
@@ -45,6 +147,7 @@ namespace wiECS
 
 			if (seri.allow_remap)
 			{
+				seri.remap_locker.lock();
 				auto it = seri.remap.find(mem);
 				if (it == seri.remap.end())
 				{
@@ -55,6 +158,7 @@ namespace wiECS
 				{
 					entity = it->second;
 				}
+				seri.remap_locker.unlock();
 			}
 			else
 			{
@@ -67,6 +171,164 @@ namespace wiECS
 		}
 	}
 
+	// Container memory of a component manager (heap memory owned by the components themselves is not included)
+	struct MemoryUsage
+	{
+		size_t used = 0; // bytes that are taken by alive elements
+		size_t reserved = 0; // bytes that are allocated
+		inline MemoryUsage& operator+=(const MemoryUsage& other)
+		{
+			used += other.used;
+			reserved += other.reserved;
+			return *this;
+		}
+	};
+
+	// Paged sparse array that maps entities to component indices (the sparse part of a sparse set)
+	//	Lookup is a direct array access for any entity, and pages are only allocated for entity ranges that are actually used
+	//	Pages are addressed by the entity index, and the full entity is stored in the entry so a stale generation is not found
+	class EntityLookup
+	{
+	public:
+		static constexpr size_t page_size = 1024; // number of entities per page
+		static constexpr size_t INVALID_INDEX = ~size_t(0);
+
+		EntityLookup() = default;
+		EntityLookup(const EntityLookup& other) { *this = other; }
+		EntityLookup& operator=(const EntityLookup& other)
+		{
+			if (this != &other)
+			{
+				pages.clear();
+				pages.resize(other.pages.size());
+				for (size_t i = 0; i < other.pages.size(); ++i)
+				{
+					if (other.pages[i] != nullptr)
+					{
+						pages[i].reset(new Entry[page_size]);
+						std::copy(other.pages[i].get(), other.pages[i].get() + page_size, pages[i].get());
+					}
+				}
+				count = other.count;
+			}
+			return *this;
+		}
+
+		// Returns the index that belongs to the entity, or INVALID_INDEX
+		inline size_t find(Entity entity) const
+		{
+			const uint32_t slot = GetEntityIndex(entity);
+			const size_t page = slot / page_size;
+			if (page < pages.size() && pages[page] != nullptr)
+			{
+				const Entry& entry = pages[page][slot % page_size];
+				if (entry.index != INVALID_PAGE_ENTRY && entry.entity == entity)
+				{
+					return entry.index;
+				}
+			}
+			return INVALID_INDEX;
+		}
+
+		inline bool contains(Entity entity) const
+		{
+			return find(entity) != INVALID_INDEX;
+		}
+
+		// Set the index of an entity (adds the entity if it is not present yet)
+		//	An other generation of the same entity index must not be present!
+		inline void set(Entity entity, size_t index)
+		{
+			assert(index < INVALID_PAGE_ENTRY);
+			const uint32_t slot = GetEntityIndex(entity);
+			const size_t page = slot / page_size;
+			if (page >= pages.size())
+			{
+				pages.resize(page + 1);
+			}
+			if (pages[page] == nullptr)
+			{
+				pages[page].reset(new Entry[page_size]);
+			}
+			Entry& entry = pages[page][slot % page_size];
+			if (entry.index == INVALID_PAGE_ENTRY)
+			{
+				count++;
+			}
+			assert(entry.index == INVALID_PAGE_ENTRY || entry.entity == entity);
+			entry.entity = entity;
+			entry.index = (uint32_t)index;
+		}
+
+		// Remove an entity if it is present
+		inline void erase(Entity entity)
+		{
+			const uint32_t slot = GetEntityIndex(entity);
+			const size_t page = slot / page_size;
+			if (page < pages.size() && pages[page] != nullptr)
+			{
+				Entry& entry = pages[page][slot % page_size];
+				if (entry.index != INVALID_PAGE_ENTRY && entry.entity == entity)
+				{
+					entry.index = INVALID_PAGE_ENTRY;
+					count--;
+				}
+			}
+		}
+
+		// Remove every entity and free the pages
+		inline void clear()
+		{
+			pages.clear();
+			count = 0;
+		}
+
+		// Number of entities that are present
+		inline size_t size() const { return count; }
+
+		// Free the pages that don't contain any entity
+		inline void shrink()
+		{
+			for (auto& page : pages)
+			{
+				if (page != nullptr && std::all_of(page.get(), page.get() + page_size, [](const Entry& entry) { return entry.index == INVALID_PAGE_ENTRY; }))
+				{
+					page.reset();
+				}
+			}
+			while (!pages.empty() && pages.back() == nullptr)
+			{
+				pages.pop_back();
+			}
+			pages.shrink_to_fit();
+		}
+
+		inline MemoryUsage GetMemoryUsage() const
+		{
+			MemoryUsage usage;
+			usage.used = count * sizeof(Entry);
+			usage.reserved = pages.capacity() * sizeof(pages[0]);
+			for (auto& page : pages)
+			{
+				if (page != nullptr)
+				{
+					usage.reserved += page_size * sizeof(Entry);
+				}
+			}
+			return usage;
+		}
+
+	private:
+		static constexpr uint32_t INVALID_PAGE_ENTRY = ~0u;
+		struct Entry
+		{
+			Entity entity = INVALID_ENTITY;
+			uint32_t index = INVALID_PAGE_ENTRY;
+		};
+		std::vector<std::unique_ptr<Entry[]>> pages;
+		size_t count = 0;
+	};
+
 	template<typename Component>
 	class ComponentManager
 	{
@@ -77,15 +339,6 @@ namespace wiECS
 		{
 			components.reserve(reservedCount);
 			entities.reserve(reservedCount);
-			lookup.reserve(reservedCount);
-			#ifdef CACHEARRAY
-			if (b_cachearray_init)
-			{
-				for (int i = 0; i < CACHEARRAY; i++) cachearray[i] = MAXVAL64;
-				b_cachearray_init = false;
-			}
-			#endif
-
 		}
 
 		// Clear the whole container
@@ -94,12 +347,9 @@ namespace wiECS
 			components.clear();
 			entities.clear();
 			lookup.clear();
-			#ifdef CACHEARRAY
-			for (int i = 0; i < CACHEARRAY; i++) cachearray[i] = MAXVAL64;
-			b_cachearray_init = false;
-			//memset(&cachearray[0], MAXVAL64, sizeof(cachearray));
-			#endif
-
+			versions.clear();
+			chunk_versions.clear();
+			structure_version++;
 		}
 
 		// Perform deep copy of all the contents of "other" into this
@@ -109,9 +359,10 @@ namespace wiECS
 			components = other.components;
 			entities = other.entities;
 			lookup = other.lookup;
-			#ifdef CACHEARRAY
-			memcpy(&cachearray[0], &other.cachearray[0], sizeof(cachearray));
-			#endif
+			versions = other.versions;
+			chunk_versions = other.chunk_versions;
+			version = std::max(version, other.version);
+			structure_version++;
 		}
 
 		// Merge in an other component manager of the same type to this. 
@@ -121,22 +372,46 @@ namespace wiECS
 		{
 			components.reserve(GetCount() + other.GetCount());
 			entities.reserve(GetCount() + other.GetCount());
-			lookup.reserve(GetCount() + other.GetCount());
 
 			for (size_t i = 0; i < other.GetCount(); ++i)
 			{
 				Entity entity = other.entities[i];
 				assert(!Contains(entity));
 				entities.push_back(entity);
-				lookup[entity] = components.size();
-				#ifdef CACHEARRAY
-				if (entity < CACHEARRAY)
-					cachearray[entity] = components.size();
-				#endif
+				lookup.set(entity, components.size());
 				components.push_back(std::move(other.components[i]));
+				push_version();
 			}
 
 			other.Clear();
+			structure_version++;
+		}
+
+		// Move the components of the given entities from an other component manager into this, entities that the other doesn't contain are skipped
+		//	The other component manager keeps the moved-from components until it is cleared, so it must not be used after this, only cleared
+		inline void MergeMany(ComponentManager<Component>& other, const Entity* entities_to_merge, size_t count)
+		{
+			bool merged = false;
+			for (size_t i = 0; i < count; ++i)
+			{
+				Entity entity = entities_to_merge[i];
+				const size_t index = other.lookup.find(entity);
+				if (index == EntityLookup::INVALID_INDEX)
+				{
+					continue;
+				}
+				assert(!Contains(entity));
+				entities.push_back(entity);
+				lookup.set(entity, components.size());
+				components.push_back(std::move(other.components[index]));
+				push_version();
+				merged = true;
+			}
+
+			if (merged)
+			{
+				structure_version++;
+			}
 		}
 
 		// Read/Write everything to an archive depending on the archive state
@@ -150,9 +425,46 @@ namespace wiECS
 				archive >> count;
 
 				components.resize(count);
-				for (size_t i = 0; i < count; ++i)
+				if (archive.GetVersion() >= 73)
+				{
+					// Chunked: every chunk is an embedded archive that is decoded by a separate job
+					uint64_t chunk_size;
+					archive >> chunk_size;
+					std::vector<std::unique_ptr<wiArchive>> chunks;
+					for (size_t first = 0; first < count; first += (size_t)chunk_size)
+					{
+						uint64_t chunk_bytes;
+						archive >> chunk_bytes;
+						const uint8_t* chunk_data = archive.ReadData((size_t)chunk_bytes);
+						chunks.emplace_back(new wiArchive(chunk_data, (size_t)chunk_bytes));
+						chunks.back()->SetSourceDirectory(archive.GetSourceDirectory());
+					}
+
+					wiJobSystem::context ctx;
+					wiJobSystem::Dispatch(ctx, (uint32_t)chunks.size(), 1, [&](wiJobArgs args) {
+						wiArchive& chunk = *chunks[args.jobIndex];
+						const size_t first = args.jobIndex * (size_t)chunk_size;
+						const size_t last = std::min(count, first + (size_t)chunk_size);
+						for (size_t i = first; i < last; ++i)
+						{
+							components[i].Serialize(chunk, seri);
+						}
+					});
+					wiJobSystem::Wait(ctx);
+
+					seri.chunk_locker.lock();
+					for (auto& chunk : chunks)
+					{
+						seri.chunk_archives.push_back(std::move(chunk));
+					}
+					seri.chunk_locker.unlock();
+				}
+				else
 				{
-					components[i].Serialize(archive, seri);
+					for (size_t i = 0; i < count; ++i)
+					{
+						components[i].Serialize(archive, seri);
+					}
 				}
 
 				entities.resize(count);
@@ -161,20 +473,46 @@ namespace wiECS
 					Entity entity;
 					SerializeEntity(archive, entity, seri);
 					entities[i] = entity;
-					lookup[entity] = i;
-					#ifdef CACHEARRAY
-					if (entity < CACHEARRAY)
-						cachearray[entity] = i;
-					#endif
-
+					lookup.set(entity, i);
+					push_version();
 				}
+				structure_version++;
 			}
 			else
 			{
 				archive << components.size();
-				for (Component& component : components)
+				if (archive.GetVersion() >= 73)
 				{
-					component.Serialize(archive, seri);
+					// Chunked: every chunk is written into an own archive by a separate job, then they are embedded with their sizes
+					const size_t count = components.size();
+					archive << (uint64_t)serialize_chunk_size;
+					std::vector<wiArchive> chunks((count + serialize_chunk_size - 1) / serialize_chunk_size);
+
+					wiJobSystem::context ctx;
+					wiJobSystem::Dispatch(ctx, (uint32_t)chunks.size(), 1, [&](wiJobArgs args) {
+						wiArchive& chunk = chunks[args.jobIndex];
+						chunk.SetSourceDirectory(archive.GetSourceDirectory());
+						const size_t first = args.jobIndex * serialize_chunk_size;
+						const size_t last = std::min(count, first + serialize_chunk_size);
+						for (size_t i = first; i < last; ++i)
+						{
+							components[i].Serialize(chunk, seri);
+						}
+					});
+					wiJobSystem::Wait(ctx);
+
+					for (const wiArchive& chunk : chunks)
+					{
+						archive << (uint64_t)chunk.GetSize();
+						archive.WriteData(chunk.GetData(), chunk.GetSize());
+					}
+				}
+				else
+				{
+					for (Component& component : components)
+					{
+						component.Serialize(archive, seri);
+					}
 				}
 				for (Entity entity : entities)
 				{
@@ -190,50 +528,114 @@ namespace wiECS
 			assert(entity != INVALID_ENTITY);
 
 			// Only one of this component type per entity is allowed!
-			assert(lookup.find(entity) == lookup.end());
+			assert(!lookup.contains(entity));
 
 			// Entity count must always be the same as the number of coponents!
 			assert(entities.size() == components.size());
 			assert(lookup.size() == components.size());
 
 			// Update the entity lookup table:
-			lookup[entity] = components.size();
-			#ifdef CACHEARRAY
-			if (entity < CACHEARRAY)
-				cachearray[entity] = components.size();
-			#endif
+			lookup.set(entity, components.size());
 
 			// New components are always pushed to the end:
 			components.emplace_back();
 
 			// Also push corresponding entity:
 			entities.push_back(entity);
-			#ifdef CACHEARRAY
-			if (b_cachearray_init)
+
+			// New components are reported as changed:
+			push_version();
+			structure_version++;
+
+			return components.back();
+		}
+
+		// Create new components for multiple entities at once, the new components are placed contiguously at the end
+		//	returns the index of the first new component, so they can be filled with operator[]: first_index + [0, count)
+		inline size_t CreateMany(const Entity* entities_to_create, size_t count)
+		{
+			const size_t first_index = components.size();
+			components.reserve(first_index + count);
+			entities.reserve(first_index + count);
+			versions.reserve(first_index + count);
+
+			// New components are default constructed in place:
+			components.resize(first_index + count);
+
+			for (size_t i = 0; i < count; ++i)
 			{
-				for (int i = 0; i < CACHEARRAY; i++) cachearray[i] = MAXVAL64;
-				b_cachearray_init = false;
+				const Entity entity = entities_to_create[i];
+				assert(entity != INVALID_ENTITY);
+				assert(!lookup.contains(entity));
+				lookup.set(entity, first_index + i);
+				entities.push_back(entity);
+				push_version();
 			}
-			#endif
-			return components.back();
+			structure_version++;
+
+			assert(entities.size() == components.size());
+			assert(lookup.size() == components.size());
+			return first_index;
 		}
 
-		// Remove a component of a certain entity if it exists
-		inline void Remove(Entity entity)
+		// Remove the components of multiple entities at once (entities without this component are skipped)
+		//	This compacts the container in a single pass instead of moving elements around for each entity, and keeps the current ordering
+		inline void RemoveMany(const Entity* entities_to_remove, size_t count)
 		{
-			#ifdef CACHEARRAY
-			if (b_cachearray_init)
+			size_t first_removed = components.size();
+			std::vector<uint8_t> removed;
+			for (size_t i = 0; i < count; ++i)
 			{
-				for (int i = 0; i < CACHEARRAY; i++) cachearray[i] = MAXVAL64;
-				b_cachearray_init = false;
+				const size_t index = lookup.find(entities_to_remove[i]);
+				if (index != EntityLookup::INVALID_INDEX)
+				{
+					if (removed.empty())
+					{
+						removed.resize(components.size());
+					}
+					removed[index] = 1;
+					first_removed = std::min(first_removed, index);
+				}
+			}
+			if (removed.empty())
+			{
+				return;
 			}
-			#endif
 
-			auto it = lookup.find(entity);
-			if (it != lookup.end())
+			size_t write = first_removed;
+			for (size_t read = first_removed; read < components.size(); ++read)
+			{
+				if (removed[read])
+				{
+					lookup.erase(entities[read]);
+					continue;
+				}
+				components[write] = std::move(components[read]);
+				entities[write] = entities[read];
+				lookup.set(entities[write], write);
+				MarkChanged(write);
+				write++;
+			}
+
+			// Shrink the containers:
+			components.erase(components.begin() + write, components.end());
+			entities.erase(entities.begin() + write, entities.end());
+			while (versions.size() > write)
+			{
+				pop_version();
+			}
+			structure_version++;
+
+			assert(lookup.size() == components.size());
+		}
+
+		// Remove a component of a certain entity if it exists
+		inline void Remove(Entity entity)
+		{
+			const size_t index = lookup.find(entity);
+			if (index != EntityLookup::INVALID_INDEX)
 			{
 				// Directly index into components and entities array:
-				const size_t index = it->second;
 				const Entity entity = entities[index];
 
 				if (index < components.size() - 1)
@@ -243,42 +645,28 @@ namespace wiECS
 					entities[index] = entities.back();
 
 					// Update the lookup table:
-					lookup[entities[index]] = index;
-					#ifdef CACHEARRAY
-					if (entities[index] < CACHEARRAY)
-						cachearray[entities[index]] = index;
-					#endif
+					lookup.set(entities[index], index);
 
+					// The moved component is reported as changed, because it lives at a new index:
+					MarkChanged(index);
 				}
 
 				// Shrink the container:
 				components.pop_back();
 				entities.pop_back();
 				lookup.erase(entity);
-				#ifdef CACHEARRAY
-				if(entity < CACHEARRAY)
-					cachearray[entity] = MAXVAL64;
-				#endif
-
+				pop_version();
+				structure_version++;
 			}
 		}
 
 		// Remove a component of a certain entity if it exists while keeping the current ordering
 		inline void Remove_KeepSorted(Entity entity)
 		{
-			#ifdef CACHEARRAY
-			if (b_cachearray_init)
-			{
-				for (int i = 0; i < CACHEARRAY; i++) cachearray[i] = MAXVAL64;
-				b_cachearray_init = false;
-			}
-			#endif
-
-			auto it = lookup.find(entity);
-			if (it != lookup.end())
+			const size_t index = lookup.find(entity);
+			if (index != EntityLookup::INVALID_INDEX)
 			{
 				// Directly index into components and entities array:
-				const size_t index = it->second;
 				const Entity entity = entities[index];
 
 				if (index < components.size() - 1)
@@ -292,12 +680,8 @@ namespace wiECS
 					for (size_t i = index + 1; i < entities.size(); ++i)
 					{
 						entities[i - 1] = entities[i];
-						lookup[entities[i - 1]] = i - 1;
-						#ifdef CACHEARRAY
-						if (entities[i - 1] < CACHEARRAY)
-							cachearray[entities[i - 1]] = i - 1;
-						#endif
-
+						lookup.set(entities[i - 1], i - 1);
+						MarkChanged(i - 1);
 					}
 				}
 
@@ -305,25 +689,14 @@ namespace wiECS
 				components.pop_back();
 				entities.pop_back();
 				lookup.erase(entity);
-				#ifdef CACHEARRAY
-				if (entity < CACHEARRAY)
-					cachearray[entity] = MAXVAL64;
-				#endif
-
+				pop_version();
+				structure_version++;
 			}
 		}
 
 		// Place an entity-component to the specified index position while keeping the ordering intact
 		inline void MoveItem(size_t index_from, size_t index_to)
 		{
-			#ifdef CACHEARRAY
-			if (b_cachearray_init)
-			{
-				for (int i = 0; i < CACHEARRAY; i++) cachearray[i] = MAXVAL64;
-				b_cachearray_init = false;
-			}
-			#endif
-
 			assert(index_from < GetCount());
 			assert(index_to < GetCount());
 			if (index_from == index_to)
@@ -342,52 +715,31 @@ namespace wiECS
 				const size_t next = i + direction;
 				components[i] = std::move(components[next]);
 				entities[i] = entities[next];
-				lookup[entities[i]] = i;
-				#ifdef CACHEARRAY
-				if (entities[i] < CACHEARRAY)
-					cachearray[entities[i]] = i;
-				#endif
-
+				lookup.set(entities[i], i);
+				MarkChanged(i);
 			}
 
 			// Saved entity-component moved to the required position:
 			components[index_to] = std::move(component);
 			entities[index_to] = entity;
-			lookup[entity] = index_to;
-			#ifdef CACHEARRAY
-			if (entity < CACHEARRAY)
-				cachearray[entity] = index_to;
-			#endif
+			lookup.set(entity, index_to);
+			MarkChanged(index_to);
+			structure_version++;
 		}
 
 		// Check if a component exists for a given entity or not
 		inline bool Contains(Entity entity) const
 		{
-			#ifdef CACHEARRAY
-			if (entity < CACHEARRAY)
-				if (cachearray[entity] < MAXVAL64 ) return true;
-			#endif
-
-			return lookup.find(entity) != lookup.end();
+			return lookup.contains(entity);
 		}
 
 		// Retrieve a [read/write] component specified by an entity (if it exists, otherwise nullptr)
 		inline Component* GetComponent(Entity entity)
 		{
-			#ifdef CACHEARRAY
-			if (entity < CACHEARRAY)
-			{
-				if(cachearray[entity] < MAXVAL64)
-					return &components[cachearray[entity]];
-				else
-					return nullptr;
-			}
-			#endif
-			auto it = lookup.find(entity);
-
-			if (it != lookup.end())
+			const size_t index = lookup.find(entity);
+			if (index != EntityLookup::INVALID_INDEX)
 			{
-				return &components[it->second];
+				return &components[index];
 			}
 			return nullptr;
 		}
@@ -395,17 +747,10 @@ namespace wiECS
 		// Retrieve a [read only] component specified by an entity (if it exists, otherwise nullptr)
 		inline const Component* GetComponent(Entity entity) const
 		{
-			#ifdef CACHEARRAY
-			if (entity < CACHEARRAY)
-			{
-				if (cachearray[entity] < MAXVAL64)
-					return &components[cachearray[entity]];
-			}
-			#endif
-			const auto it = lookup.find(entity);
-			if (it != lookup.end())
+			const size_t index = lookup.find(entity);
+			if (index != EntityLookup::INVALID_INDEX)
 			{
-				return &components[it->second];
+				return &components[index];
 			}
 			return nullptr;
 		}
@@ -413,25 +758,31 @@ namespace wiECS
 		// Retrieve component index by entity handle (if not exists, returns ~0 value)
 		inline size_t GetIndex(Entity entity) const 
 		{
-			#ifdef CACHEARRAY
-			if (entity < CACHEARRAY)
-			{
-				if (cachearray[entity] < MAXVAL64)
-					return cachearray[entity];
-			}
-			#endif
-
-			const auto it = lookup.find(entity);
-			if (it != lookup.end())
-			{
-				return it->second;
-			}
-			return ~0;
+			return lookup.find(entity);
 		}
 
 		// Retrieve the number of existing entries
 		inline size_t GetCount() const { return components.size(); }
 
+		// Release the memory that is not used by the existing entries (for example after removing many of them, or after Clear())
+		inline void Compact()
+		{
+			components.shrink_to_fit();
+			entities.shrink_to_fit();
+			versions.shrink_to_fit();
+			chunk_versions.shrink_to_fit();
+			lookup.shrink();
+		}
+
+		// Retrieve the container memory (the components' own allocations are not included)
+		inline MemoryUsage GetMemoryUsage() const
+		{
+			MemoryUsage usage = lookup.GetMemoryUsage();
+			usage.used += components.size() * sizeof(Component) + entities.size() * sizeof(Entity) + versions.size() * sizeof(uint64_t) + chunk_versions.size() * sizeof(ChunkVersion);
+			usage.reserved += components.capacity() * sizeof(Component) + entities.capacity() * sizeof(Entity) + versions.capacity() * sizeof(uint64_t) + chunk_versions.capacity() * sizeof(ChunkVersion);
+			return usage;
+		}
+
 		// Directly index a specific component without indirection
 		//	0 <= index < GetCount()
 		inline Entity GetEntity(size_t index) const { return entities[index]; }
@@ -444,20 +795,220 @@ namespace wiECS
 		//	0 <= index < GetCount()
 		inline const Component& operator[](size_t index) const { return components[index]; }
 
+		// Change tracking:
+		//	Every component has a version that is stamped when it is created, moved to an other index or marked as changed
+		//	Plain mutable access (operator[], GetComponent) doesn't stamp, because most systems use it for reading too
+		//	An incremental system keeps the version it has seen last and processes only the newer components:
+		//
+		//		const uint64_t upto = manager.AdvanceVersion();
+		//		manager.ForEachChanged(last_version, [&](size_t index) { ... });
+		//		last_version = upto;
+
+		// Report a component as changed by index. Can be called from multiple threads, but not together with AdvanceVersion()
+		inline void MarkChanged(size_t index)
+		{
+			assert(index < GetCount());
+			versions[index] = version;
+			chunk_versions[index / version_chunk_size].value.store(version, std::memory_order_relaxed);
+		}
+
+		// Report a component as changed by entity (if it exists)
+		inline void MarkChanged(Entity entity)
+		{
+			const size_t index = lookup.find(entity);
+			if (index != EntityLookup::INVALID_INDEX)
+			{
+				MarkChanged(index);
+			}
+		}
+
+		// Retrieve a [read/write] component by index and report it as changed
+		inline Component& Write(size_t index)
+		{
+			MarkChanged(index);
+			return components[index];
+		}
+
+		// The version that the changes are stamped with currently
+		inline uint64_t GetVersion() const { return version; }
+
+		// Close the current version: returns it, and subsequent changes will be stamped with a newer one
+		inline uint64_t AdvanceVersion() { return version++; }
+
+		// This changes every time a component is added, removed or moved to an other index
+		inline uint64_t GetStructureVersion() const { return structure_version; }
+
+		// Check whether a component has changed after the given version
+		inline bool IsChanged(size_t index, uint64_t since) const { return versions[index] > since; }
+
+		// Check whether any component has changed after the given version, with one check per 64 components
+		inline bool IsAnyChanged(uint64_t since) const
+		{
+			for (const ChunkVersion& chunk : chunk_versions)
+			{
+				if (chunk.value.load(std::memory_order_relaxed) > since)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Iterate the indices of components that changed after the given version
+		//	The cost is proportional to the number of changed components (plus one check per 64 components)
+		template<typename F>
+		inline void ForEachChanged(uint64_t since, F func) const
+		{
+			const size_t count = GetCount();
+			for (size_t chunk = 0; chunk < chunk_versions.size(); ++chunk)
+			{
+				if (chunk_versions[chunk].value.load(std::memory_order_relaxed) <= since)
+				{
+					continue;
+				}
+				const size_t end = std::min(count, (chunk + 1) * version_chunk_size);
+				for (size_t index = chunk * version_chunk_size; index < end; ++index)
+				{
+					if (versions[index] > since)
+					{
+						func(index);
+					}
+				}
+			}
+		}
+
 	private:
 		// This is a linear array of alive components
 		std::vector<Component> components;
 		// This is a linear array of entities corresponding to each alive component
 		std::vector<Entity> entities;
 		// This is a lookup table for entities
-		std::unordered_map<Entity, size_t> lookup;
-		#ifdef CACHEARRAY
-		size_t cachearray[CACHEARRAY];
-		bool b_cachearray_init = true;
-		#endif
+		EntityLookup lookup;
+
+		// Change versions of each component, and the newest version within every chunk of components
+		static constexpr size_t version_chunk_size = 64;
+		struct ChunkVersion
+		{
+			std::atomic<uint64_t> value{ 0 };
+			ChunkVersion() = default;
+			ChunkVersion(const ChunkVersion& other) : value(other.value.load(std::memory_order_relaxed)) {}
+			ChunkVersion& operator=(const ChunkVersion& other) { value.store(other.value.load(std::memory_order_relaxed), std::memory_order_relaxed); return *this; }
+		};
+		std::vector<uint64_t> versions;
+		std::vector<ChunkVersion> chunk_versions;
+		uint64_t version = 1;
+		uint64_t structure_version = 0;
+
+		inline void push_version()
+		{
+			versions.push_back(0);
+			if (chunk_versions.size() * version_chunk_size < versions.size())
+			{
+				chunk_versions.emplace_back();
+			}
+			MarkChanged(versions.size() - 1);
+		}
+		inline void pop_version()
+		{
+			versions.pop_back();
+			if ((chunk_versions.size() - 1) * version_chunk_size >= versions.size())
+			{
+				chunk_versions.pop_back();
+			}
+		}
+
+		// Number of components that are serialized together by one job
+		static constexpr size_t serialize_chunk_size = 64;
+
 		// Disallow this to be copied by mistake
 		ComponentManager(const ComponentManager&) = delete;
 	};
+
+	// Joins the components of other managers to every component of a primary manager
+	//	The component indices are resolved once and cached until any of the managers is structurally changed,
+	//	so iterating the view doesn't need any entity lookups
+	//	The callback receives the primary index and component, and a pointer for every other component (nullptr if the entity doesn't have it):
+	//
+	//		View<LightComponent, TransformComponent, LayerComponent> view(lights, transforms, layers);
+	//		view.ParallelEach(ctx, 64, [](size_t index, LightComponent& light, TransformComponent* transform, LayerComponent* layer) { ... });
+	template<typename Primary, typename... Others>
+	class View
+	{
+	public:
+		View(ComponentManager<Primary>& primary, ComponentManager<Others>&... others) : primary(primary), others(others...) {}
+
+		// Rebuild the cached indices if any of the managers changed. Not thread safe, call before iterating
+		inline void Update()
+		{
+			const std::array<uint64_t, sizeof...(Others) + 1> current = structure_versions(std::index_sequence_for<Others...>());
+			if (valid && current == seen_versions)
+			{
+				return;
+			}
+			valid = true;
+			seen_versions = current;
+			indices.resize(primary.GetCount());
+			for (size_t i = 0; i < indices.size(); ++i)
+			{
+				resolve(i, std::index_sequence_for<Others...>());
+			}
+		}
+
+		// Number of primary components (valid after Update())
+		inline size_t GetCount() const { return indices.size(); }
+
+		// Iterate every primary component on the calling thread
+		template<typename F>
+		inline void Each(F func)
+		{
+			Update();
+			for (size_t i = 0; i < indices.size(); ++i)
+			{
+				invoke(func, i, std::index_sequence_for<Others...>());
+			}
+		}
+
+		// Iterate every primary component with the job system, func(index, primary, others...)
+		//	This is asynchronous, so the view and the managers must be kept alive and unchanged until ctx is waited!
+		template<typename F>
+		inline void ParallelEach(wiJobSystem::context& ctx, uint32_t groupSize, F func)
+		{
+			Update();
+			wiJobSystem::Dispatch(ctx, (uint32_t)indices.size(), groupSize, [this, func](wiJobArgs args) mutable {
+				invoke(func, args.jobIndex, std::index_sequence_for<Others...>());
+			});
+		}
+
+	private:
+		static constexpr uint32_t INVALID_INDEX = ~0u;
+		ComponentManager<Primary>& primary;
+		std::tuple<ComponentManager<Others>&...> others;
+		std::vector<std::array<uint32_t, sizeof...(Others)>> indices;
+		std::array<uint64_t, sizeof...(Others) + 1> seen_versions = {};
+		bool valid = false;
+
+		template<size_t... I>
+		inline std::array<uint64_t, sizeof...(Others) + 1> structure_versions(std::index_sequence<I...>) const
+		{
+			return { primary.GetStructureVersion(), std::get<I>(others).GetStructureVersion()... };
+		}
+		template<size_t... I>
+		inline void resolve(size_t index, std::index_sequence<I...>)
+		{
+			const Entity entity = primary.GetEntity(index);
+			((indices[index][I] = (uint32_t)std::min(std::get<I>(others).GetIndex(entity), (size_t)INVALID_INDEX)), ...);
+		}
+		template<typename T>
+		static inline T* component_at(ComponentManager<T>& manager, uint32_t index)
+		{
+			return index == INVALID_INDEX ? nullptr : &manager[index];
+		}
+		template<typename F, size_t... I>
+		inline void invoke(F& func, size_t index, std::index_sequence<I...>)
+		{
+			func(index, primary[index], component_at(std::get<I>(others), indices[index][I])...);
+		}
+	};
 }
 
 #endif // WI_ENTITY_COMPONENT_SYSTEM_H
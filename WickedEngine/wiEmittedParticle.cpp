@@ -14,6 +14,8 @@
 #include "wiEvent.h"
 
 #include <algorithm>
+#include <vector>
+#include <cstring>
 
 using namespace wiGraphics;
 
@@ -23,6 +25,7 @@ namespace wiScene
 static Shader		vertexShader;
 static Shader		meshShader;
 static Shader		pixelShader[wiEmittedParticle::PARTICLESHADERTYPE_COUNT];
+static Shader		overdrawPS;
 static Shader		kickoffUpdateCS;
 static Shader		finishUpdateCS;
 static Shader		emitCS;
@@ -37,6 +40,11 @@ static Shader		simulateCS;
 static Shader		simulateCS_SORTING;
 static Shader		simulateCS_DEPTHCOLLISIONS;
 static Shader		simulateCS_SORTING_DEPTHCOLLISIONS;
+static Shader		poolResetCS;
+static Shader		poolKickoffCS;
+static Shader		poolEmitCS;
+static Shader		poolSimulateCS;
+static Shader		poolFinishCS;
 
 static BlendState			blendStates[BLENDMODE_COUNT];
 static RasterizerState		rasterizerState;
@@ -44,9 +52,269 @@ static RasterizerState		wireFrameRS;
 static DepthStencilState	depthStencilState;
 static PipelineState		PSO[BLENDMODE_COUNT][wiEmittedParticle::PARTICLESHADERTYPE_COUNT];
 static PipelineState		PSO_wire;
+static PipelineState		PSO_overdraw;
 
 static bool ALLOW_MESH_SHADER = false;
 
+// The particle pool of the emitters that are simulated by UpdateGPU_Pooled()
+//	Every emitter has a slot (counters and draw arguments) and a range of the pooled buffers
+//	The ranges stay at the same place while the emitter uses them, when the pool grows, the buffers are created again and every emitter restarts
+//	The slots of the emitters that were not updated for a while are only released when the pool runs out of space
+struct ParticlePool
+{
+	struct Slot
+	{
+		uint32_t particleOffset = 0;
+		uint32_t particleCount = 0;
+		uint32_t parity = 0; // the half of the alive list that is CURRENT
+		uint32_t generation = 0;
+		uint64_t frame = 0; // the last pooled update that used it
+		bool used = false;
+		bool reset = true;
+	};
+	struct Range
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	static constexpr uint32_t MIN_PARTICLE_CAPACITY = 64 * 1024;
+	static constexpr uint32_t MIN_SLOT_CAPACITY = 256;
+
+	bool enabled = true;
+	uint64_t frame = 0;
+
+	std::vector<Slot> slots; // slot 0 is the pool counter
+	std::vector<uint32_t> freeSlots;
+	std::vector<Range> freeRanges; // sorted by offset, the neighbours are merged
+	uint32_t slotCapacity = 0;
+	uint32_t particleCapacity = 0;
+
+	GPUBuffer particleBuffer;
+	GPUBuffer aliveList; // two halves, CURRENT and NEW alternate for every emitter separately
+	GPUBuffer deadList;
+	GPUBuffer distanceBuffer; // sort keys
+	GPUBuffer sortList;
+	GPUBuffer counterBuffer;
+	GPUBuffer indirectBuffers; // emit, simulation, then the draw arguments of every slot
+	GPUBuffer emitterBuffer;
+	GPUBuffer constantBuffer;
+
+	GPUBuffer statisticsReadbackBuffer[GraphicsDevice::GetBufferCount() + 3];
+	uint32_t statisticsReadBackIndex = 0;
+	std::vector<ParticleCounters> statistics; // of every slot, with GPU delay
+
+	std::vector<EmittedParticlePoolEmitter> emitterData;
+	struct Update
+	{
+		const wiEmittedParticle* emitter;
+		const TransformComponent* transform;
+		const MaterialComponent* material;
+	};
+	std::vector<Update> updates;
+
+	uint32_t AllocateRange(uint32_t count)
+	{
+		for (size_t i = 0; i < freeRanges.size(); ++i)
+		{
+			Range& range = freeRanges[i];
+			if (range.count >= count)
+			{
+				const uint32_t offset = range.offset;
+				range.offset += count;
+				range.count -= count;
+				if (range.count == 0)
+				{
+					freeRanges.erase(freeRanges.begin() + i);
+				}
+				return offset;
+			}
+		}
+		return ~0u;
+	}
+	void FreeRange(uint32_t offset, uint32_t count)
+	{
+		auto it = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset, [](const Range& range, uint32_t offset) {
+			return range.offset < offset;
+		});
+		it = freeRanges.insert(it, { offset, count });
+		if (it + 1 != freeRanges.end() && it->offset + it->count == (it + 1)->offset)
+		{
+			it->count += (it + 1)->count;
+			freeRanges.erase(it + 1);
+		}
+		if (it != freeRanges.begin() && (it - 1)->offset + (it - 1)->count == it->offset)
+		{
+			(it - 1)->count += it->count;
+			freeRanges.erase(it);
+		}
+	}
+	void FreeSlot(uint32_t index)
+	{
+		Slot& slot = slots[index];
+		FreeRange(slot.particleOffset, slot.particleCount);
+		slot.used = false;
+		slot.generation++;
+		freeSlots.push_back(index);
+	}
+	// Release the slots that were not used by the last two pooled updates
+	bool FreeUnusedSlots()
+	{
+		bool freed = false;
+		for (uint32_t i = 1; i < (uint32_t)slots.size(); ++i)
+		{
+			if (slots[i].used && slots[i].frame + 2 <= frame)
+			{
+				FreeSlot(i);
+				freed = true;
+			}
+		}
+		return freed;
+	}
+	void ResetAll()
+	{
+		for (auto& slot : slots)
+		{
+			slot.reset = true;
+		}
+	}
+
+	void CreateParticleBuffers(uint32_t capacity)
+	{
+		GraphicsDevice* device = wiRenderer::GetDevice();
+
+		if (capacity > particleCapacity)
+		{
+			FreeRange(particleCapacity, capacity - particleCapacity);
+		}
+		particleCapacity = capacity;
+
+		GPUBufferDesc bd;
+		bd.Usage = USAGE_DEFAULT;
+		bd.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+		bd.CPUAccessFlags = 0;
+		bd.MiscFlags = RESOURCE_MISC_BUFFER_STRUCTURED;
+
+		bd.StructureByteStride = sizeof(Particle);
+		bd.ByteWidth = bd.StructureByteStride * particleCapacity;
+		device->CreateBuffer(&bd, nullptr, &particleBuffer);
+
+		bd.StructureByteStride = sizeof(uint32_t);
+		bd.ByteWidth = bd.StructureByteStride * particleCapacity * 2;
+		device->CreateBuffer(&bd, nullptr, &aliveList);
+
+		bd.ByteWidth = bd.StructureByteStride * particleCapacity;
+		device->CreateBuffer(&bd, nullptr, &deadList);
+		device->CreateBuffer(&bd, nullptr, &sortList);
+
+		bd.StructureByteStride = sizeof(float);
+		bd.ByteWidth = bd.StructureByteStride * particleCapacity;
+		device->CreateBuffer(&bd, nullptr, &distanceBuffer);
+
+		// The contents are lost, every range is initialized again:
+		ResetAll();
+	}
+	void CreateSlotBuffers(uint32_t capacity)
+	{
+		GraphicsDevice* device = wiRenderer::GetDevice();
+
+		slotCapacity = capacity;
+
+		GPUBufferDesc bd;
+		bd.Usage = USAGE_DEFAULT;
+		bd.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+		bd.CPUAccessFlags = 0;
+
+		// The counters start from zero, so the slots that were not reset yet are empty:
+		std::vector<ParticleCounters> counters(slotCapacity);
+		std::memset(counters.data(), 0, sizeof(ParticleCounters) * counters.size());
+		SubresourceData data;
+		data.pSysMem = counters.data();
+		bd.ByteWidth = (uint32_t)sizeof(ParticleCounters) * slotCapacity;
+		bd.StructureByteStride = sizeof(ParticleCounters);
+		bd.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		device->CreateBuffer(&bd, &data, &counterBuffer);
+
+		bd.BindFlags = BIND_UNORDERED_ACCESS;
+		bd.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS | RESOURCE_MISC_INDIRECT_ARGS;
+		bd.ByteWidth = POOL_ARGUMENTBUFFER_OFFSET_DRAWPARTICLES + (uint32_t)sizeof(IndirectDrawArgsInstanced) * slotCapacity;
+		device->CreateBuffer(&bd, nullptr, &indirectBuffers);
+
+		bd.BindFlags = BIND_SHADER_RESOURCE;
+		bd.MiscFlags = RESOURCE_MISC_BUFFER_STRUCTURED;
+		bd.StructureByteStride = sizeof(EmittedParticlePoolEmitter);
+		bd.ByteWidth = bd.StructureByteStride * slotCapacity;
+		device->CreateBuffer(&bd, nullptr, &emitterBuffer);
+
+		GPUBufferDesc readbackDesc = counterBuffer.GetDesc();
+		readbackDesc.Usage = USAGE_STAGING;
+		readbackDesc.CPUAccessFlags = CPU_ACCESS_READ;
+		readbackDesc.BindFlags = 0;
+		readbackDesc.MiscFlags = 0;
+		for (int i = 0; i < arraysize(statisticsReadbackBuffer); ++i)
+		{
+			device->CreateBuffer(&readbackDesc, nullptr, &statisticsReadbackBuffer[i]);
+		}
+		statisticsReadBackIndex = 0;
+		statistics.clear();
+		statistics.resize(slotCapacity);
+
+		ResetAll();
+	}
+
+	// Returns the slot of the emitter, it is assigned again if it was released, taken by a copy of the emitter, or the particle count changed
+	uint32_t AcquireSlot(uint32_t currentSlot, uint32_t& generation, uint32_t particleCount)
+	{
+		if (currentSlot > 0 && currentSlot < (uint32_t)slots.size())
+		{
+			Slot& slot = slots[currentSlot];
+			if (slot.used && slot.generation == generation && slot.frame != frame)
+			{
+				if (slot.particleCount == particleCount)
+				{
+					slot.frame = frame;
+					return currentSlot;
+				}
+				FreeSlot(currentSlot);
+			}
+		}
+
+		uint32_t offset = AllocateRange(particleCount);
+		if (offset == ~0u && FreeUnusedSlots())
+		{
+			offset = AllocateRange(particleCount);
+		}
+		if (offset == ~0u)
+		{
+			CreateParticleBuffers(std::max(MIN_PARTICLE_CAPACITY, std::max(particleCapacity * 2, particleCapacity + particleCount)));
+			offset = AllocateRange(particleCount);
+			assert(offset != ~0u);
+		}
+
+		uint32_t index;
+		if (freeSlots.empty())
+		{
+			index = (uint32_t)slots.size();
+			slots.emplace_back();
+		}
+		else
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		Slot& slot = slots[index];
+		slot.particleOffset = offset;
+		slot.particleCount = particleCount;
+		slot.parity = 0;
+		slot.frame = frame;
+		slot.used = true;
+		slot.reset = true;
+		generation = slot.generation;
+		return index;
+	}
+};
+static ParticlePool pool;
+
 
 void wiEmittedParticle::SetMaxParticleCount(uint32_t value)
 {
@@ -54,13 +322,51 @@ void wiEmittedParticle::SetMaxParticleCount(uint32_t value)
 	MAX_PARTICLES = value;
 }
 
+bool wiEmittedParticle::CanBePooled() const
+{
+	return
+		pool.enabled &&
+		!IsSPHEnabled() &&
+		meshID == wiECS::INVALID_ENTITY &&
+		!(ALLOW_MESH_SHADER && wiRenderer::GetDevice()->CheckCapability(GRAPHICSDEVICE_CAPABILITY_MESH_SHADER));
+}
+
 void wiEmittedParticle::CreateSelfBuffers()
 {
-	if (buffersUpToDate)
+	const bool poolable = CanBePooled();
+	if (buffersUpToDate && pooled == poolable && (pooled || sphPartitionCellIndices.IsValid() == IsSPHEnabled()))
 	{
 		return;
 	}
 	buffersUpToDate = true;
+	pooled = poolable;
+	poolReset = true;
+
+	if (pooled)
+	{
+		// The particles are in the particle pool, only the constant buffer of the emitter is needed:
+		particleBuffer = GPUBuffer();
+		aliveList[0] = GPUBuffer();
+		aliveList[1] = GPUBuffer();
+		deadList = GPUBuffer();
+		distanceBuffer = GPUBuffer();
+		sphPartitionCellIndices = GPUBuffer();
+		sphPartitionCellRanges = GPUBuffer();
+		sphSortedPositions = GPUBuffer();
+		sphSortedVelocities = GPUBuffer();
+		densityBuffer = GPUBuffer();
+		counterBuffer = GPUBuffer();
+		indirectBuffers = GPUBuffer();
+
+		GPUBufferDesc bd;
+		bd.Usage = USAGE_DEFAULT;
+		bd.ByteWidth = sizeof(EmittedParticleCB);
+		bd.BindFlags = BIND_CONSTANT_BUFFER;
+		bd.CPUAccessFlags = 0;
+		bd.MiscFlags = 0;
+		wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &constantBuffer);
+		return;
+	}
 
 
 	// GPU-local buffer descriptors:
@@ -101,23 +407,41 @@ void wiEmittedParticle::CreateSelfBuffers()
 	wiRenderer::GetDevice()->CreateBuffer(&bd, &data, &distanceBuffer);
 	data.pSysMem = nullptr;
 
-	// SPH Partitioning grid indices per particle:
-	bd.StructureByteStride = sizeof(float); // really, it is uint, but sorting is performing comparisons on floats, so whateva
-	bd.ByteWidth = bd.StructureByteStride * MAX_PARTICLES;
-	wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &sphPartitionCellIndices);
-
-	// SPH Partitioning grid cell offsets into particle index list:
-	bd.StructureByteStride = sizeof(uint32_t);
-	bd.ByteWidth = bd.StructureByteStride * SPH_PARTITION_BUCKET_COUNT;
-	wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &sphPartitionCellOffsets);
-
-	// Density buffer (for SPH simulation):
-	bd.StructureByteStride = sizeof(float);
-	bd.ByteWidth = bd.StructureByteStride * MAX_PARTICLES;
-	wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &densityBuffer);
+	// The SPH buffers are only created for the emitters that simulate it, the partitioning grid alone is 8 MB:
+	if (IsSPHEnabled())
+	{
+		// SPH Partitioning grid indices per particle:
+		bd.StructureByteStride = sizeof(float); // really, it is uint, but sorting is performing comparisons on floats, so whateva
+		bd.ByteWidth = bd.StructureByteStride * MAX_PARTICLES;
+		wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &sphPartitionCellIndices);
+
+		// SPH Partitioning grid cell ranges in the sorted particle index list:
+		bd.StructureByteStride = sizeof(XMUINT2);
+		bd.ByteWidth = bd.StructureByteStride * SPH_PARTITION_BUCKET_COUNT;
+		wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &sphPartitionCellRanges);
+
+		// Positions (and masses) and velocities in the sorted order, for the neighbor lookups:
+		bd.StructureByteStride = sizeof(XMFLOAT4);
+		bd.ByteWidth = bd.StructureByteStride * MAX_PARTICLES;
+		wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &sphSortedPositions);
+		wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &sphSortedVelocities);
+
+		// Density buffer (for SPH simulation):
+		bd.StructureByteStride = sizeof(float);
+		bd.ByteWidth = bd.StructureByteStride * MAX_PARTICLES;
+		wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &densityBuffer);
+	}
+	else
+	{
+		sphPartitionCellIndices = GPUBuffer();
+		sphPartitionCellRanges = GPUBuffer();
+		sphSortedPositions = GPUBuffer();
+		sphSortedVelocities = GPUBuffer();
+		densityBuffer = GPUBuffer();
+	}
 
 	// Particle System statistics:
-	ParticleCounters counters;
+	ParticleCounters counters = {};
 	counters.aliveCount = 0;
 	counters.deadCount = MAX_PARTICLES;
 	counters.realEmitCount = 0;
@@ -164,6 +488,12 @@ void wiEmittedParticle::CreateSelfBuffers()
 
 uint32_t wiEmittedParticle::GetMemorySizeInBytes() const
 {
+	if (pooled)
+	{
+		// particle, two alive list halves, dead list, sort key and sort list of the pool range:
+		return MAX_PARTICLES * (sizeof(Particle) + sizeof(uint32_t) * 5) + constantBuffer.GetDesc().ByteWidth;
+	}
+
 	if (!particleBuffer.IsValid())
 		return 0;
 
@@ -175,7 +505,9 @@ uint32_t wiEmittedParticle::GetMemorySizeInBytes() const
 	retVal += deadList.GetDesc().ByteWidth;
 	retVal += distanceBuffer.GetDesc().ByteWidth;
 	retVal += sphPartitionCellIndices.GetDesc().ByteWidth;
-	retVal += sphPartitionCellOffsets.GetDesc().ByteWidth;
+	retVal += sphPartitionCellRanges.GetDesc().ByteWidth;
+	retVal += sphSortedPositions.GetDesc().ByteWidth;
+	retVal += sphSortedVelocities.GetDesc().ByteWidth;
 	retVal += densityBuffer.GetDesc().ByteWidth;
 	retVal += counterBuffer.GetDesc().ByteWidth;
 	retVal += indirectBuffers.GetDesc().ByteWidth;
@@ -184,22 +516,113 @@ uint32_t wiEmittedParticle::GetMemorySizeInBytes() const
 	return retVal;
 }
 
-void wiEmittedParticle::UpdateCPU(const TransformComponent& transform, float dt)
+void wiEmittedParticle::UpdateCPU(const TransformComponent& transform, const MeshComponent* mesh, float dt)
 {
 	CreateSelfBuffers();
 
+	// The visibility of the previous frame:
+	if (visibilityTested)
+	{
+		offscreenFrameCount = visibilityOnscreen ? 0 : offscreenFrameCount + 1;
+	}
+	if (lod_distance_end <= lod_distance_start)
+	{
+		lodFactor = 1;
+	}
+	else if (visibilityTested)
+	{
+		const float lod = saturate((visibilityDistance - lod_distance_start) / (lod_distance_end - lod_distance_start));
+		lodFactor = wiMath::Lerp(1.0f, saturate(lod_factor_min), lod);
+	}
+	visibilityTested = false;
+	visibilityOnscreen = false;
+	visibilityDistance = FLT_MAX;
+
+	center = transform.GetPosition();
+
+	// Bounds: the emitter shape, extended by the farthest that a particle can get in its life span
+	const float maxLife = std::max(0.0f, life * (1 + 0.5f * std::abs(random_life)));
+	{
+		const XMMATRIX W = XMLoadFloat4x4(&transform.world);
+		if (mesh != nullptr)
+		{
+			aabb = mesh->aabb.transform(W);
+		}
+		else if (IsVolumeEnabled())
+		{
+			aabb = AABB(XMFLOAT3(-1, -1, -1), XMFLOAT3(1, 1, 1)).transform(W);
+		}
+		else
+		{
+			aabb = AABB(center, center);
+		}
+		const float speed = XMVectorGetX(XMVector3Length(XMVector3TransformNormal(XMLoadFloat3(&velocity), W))) +
+			(0.87f * std::abs(random_factor) + (mesh != nullptr ? 1 : 0)) * std::abs(normal_factor);
+		const float particleSize = size * (1 + 0.5f * std::abs(random_factor)) * std::max(1.0f, std::abs(scaleX));
+		const float extent = speed * maxLife + particleSize;
+		const XMFLOAT3 fall = XMFLOAT3(0.5f * gravity.x * maxLife * maxLife, 0.5f * gravity.y * maxLife * maxLife, 0.5f * gravity.z * maxLife * maxLife);
+		aabb._min = XMFLOAT3(aabb._min.x - extent + std::min(0.0f, fall.x), aabb._min.y - extent + std::min(0.0f, fall.y), aabb._min.z - extent + std::min(0.0f, fall.z));
+		aabb._max = XMFLOAT3(aabb._max.x + extent + std::max(0.0f, fall.x), aabb._max.y + extent + std::max(0.0f, fall.y), aabb._max.z + extent + std::max(0.0f, fall.z));
+	}
+
+	simulationSteps = 1;
+	simulationStepTime = -1;
+
 	if (IsPaused())
 		return;
 
-	emit = std::max(0.0f, emit - floorf(emit));
+	// Off screen throttling:
+	skippedTime += dt;
+	if (offscreen_frames > 0 && offscreenFrameCount >= offscreen_frames)
+	{
+		const uint32_t throttledFrame = offscreenFrameCount - offscreen_frames;
+		if (offscreen_interval == 0 || (throttledFrame % offscreen_interval) != 0)
+		{
+			simulationSteps = 0;
+			return;
+		}
+	}
+	float time = skippedTime;
+	skippedTime = 0;
 
-	center = transform.GetPosition();
+	// The skipped time is caught up with in fixed length steps, so the result only depends on the elapsed time
+	//	Only the last life span needs to be simulated, the particles emitted before that would be dead by now
+	if (time > dt)
+	{
+		time = std::min(time, std::max(maxLife, dt));
+		simulationSteps = std::max(1u, std::min(OFFSCREEN_CATCHUP_MAX_STEPS, (uint32_t)std::ceil(time / OFFSCREEN_CATCHUP_STEP)));
+		simulationStepTime = time / simulationSteps;
+	}
 
-	emit += (float)count*dt;
+	// SPH is unstable when a step is longer than the CFL limit, the steps are divided into substeps then (a fixed timestep is left as set):
+	if (IsSPHEnabled() && FIXED_TIMESTEP < 0 && time > 0)
+	{
+		const float maxStepTime = SPH_CFL * SPH_h / std::sqrt(std::max(SPH_K, 0.0001f));
+		const uint32_t substeps = std::min(SPH_MAX_SUBSTEPS, (uint32_t)std::ceil(time / simulationSteps / maxStepTime));
+		if (substeps > 1)
+		{
+			simulationSteps *= substeps;
+			simulationStepTime = time / simulationSteps;
+		}
+	}
+
+	emit = std::max(0.0f, emit - floorf(emit));
+
+	emit += (float)count * time * lodFactor;
 
 	emit += burst;
 	burst = 0;
 
+	if (pooled)
+	{
+		// The pool alternates the alive lists and reads back the statistics:
+		if (poolSlot < pool.statistics.size())
+		{
+			statistics = pool.statistics[poolSlot];
+		}
+		return;
+	}
+
 	// Swap CURRENT alivelist with NEW alivelist
 	std::swap(aliveList[0], aliveList[1]);
 
@@ -220,6 +643,19 @@ void wiEmittedParticle::UpdateCPU(const TransformComponent& transform, float dt)
 	}
 	statisticsReadBackIndex++;
 }
+void wiEmittedParticle::SetVisibility(bool onscreen, float distance) const
+{
+	visibilityTested = true;
+	visibilityOnscreen = visibilityOnscreen || onscreen;
+	visibilityDistance = std::min(visibilityDistance, distance);
+}
+uint32_t wiEmittedParticle::GetStepEmitCount(uint32_t step) const
+{
+	// The emitted particles are distributed evenly between the steps:
+	const uint64_t total = (uint64_t)emit;
+	const uint64_t steps = std::max(1u, simulationSteps);
+	return (uint32_t)(total * (step + 1) / steps - total * step / steps);
+}
 void wiEmittedParticle::Burst(int num)
 {
 	if (IsPaused())
@@ -233,13 +669,92 @@ void wiEmittedParticle::Restart()
 	SetPaused(false);
 }
 
+void wiEmittedParticle::FillConstantBuffer(EmittedParticleCB& cb, const TransformComponent& transform, const MaterialComponent& material, const MeshComponent* mesh) const
+{
+	GraphicsDevice* device = wiRenderer::GetDevice();
+
+	cb.xEmitterWorld = transform.world;
+	cb.xEmitCount = (uint32_t)emit;
+	cb.xEmitterMeshIndexCount = mesh == nullptr ? 0 : (uint32_t)mesh->GetIndexCount();
+	cb.xEmitterMeshVertexPositionStride = sizeof(MeshComponent::Vertex_POS);
+	cb.xEmitterRandomness = wiRandom::getRandom(0, 1000) * 0.001f;
+	cb.xParticleLifeSpan = life;
+	cb.xParticleLifeSpanRandomness = random_life;
+	cb.xParticleNormalFactor = normal_factor;
+	cb.xParticleRandomFactor = random_factor;
+	cb.xParticleScaling = scaleX;
+	cb.xParticleSize = size;
+	cb.xParticleMotionBlurAmount = motionBlurAmount;
+	cb.xParticleRotation = rotation * XM_PI * 60;
+	cb.xParticleColor = wiMath::CompressColor(XMFLOAT4(material.baseColor.x, material.baseColor.y, material.baseColor.z, 1));
+	cb.xParticleEmissive = material.emissiveColor.w;
+	cb.xEmitterOpacity = material.GetOpacity();
+	cb.xParticleMass = mass;
+	cb.xEmitterMaxParticleCount = std::min(MAX_PARTICLES, std::max(1u, (uint32_t)(MAX_PARTICLES * lodFactor)));
+	cb.xEmitterFixedTimestep = FIXED_TIMESTEP;
+	cb.xEmitterFramesXY = uint2(std::max(1u, framesX), std::max(1u, framesY));
+	cb.xEmitterFrameCount = std::max(1u, frameCount);
+	cb.xEmitterFrameStart = frameStart;
+	cb.xEmitterTexMul = float2(1.0f / (float)cb.xEmitterFramesXY.x, 1.0f / (float)cb.xEmitterFramesXY.y);
+	cb.xEmitterFrameRate = frameRate;
+	cb.xParticleGravity = gravity;
+	cb.xParticleDrag = drag;
+	XMStoreFloat3(&cb.xParticleVelocity, XMVector3TransformNormal(XMLoadFloat3(&velocity), XMLoadFloat4x4(&transform.world)));
+	cb.xParticleRandomColorFactor = random_color;
+	cb.xEmitterLayerMask = layerMask;
+
+	cb.xEmitterOptions = 0;
+	if (IsSPHEnabled())
+	{
+		cb.xEmitterOptions |= EMITTER_OPTION_BIT_SPH_ENABLED;
+	}
+	if (IsFrameBlendingEnabled())
+	{
+		cb.xEmitterOptions |= EMITTER_OPTION_BIT_FRAME_BLENDING_ENABLED;
+	}
+	if (ALLOW_MESH_SHADER && device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_MESH_SHADER))
+	{
+		cb.xEmitterOptions |= EMITTER_OPTION_BIT_MESH_SHADER_ENABLED;
+	}
+
+	// SPH:
+	cb.xSPH_h = SPH_h;
+	cb.xSPH_h_rcp = 1.0f / SPH_h;
+	cb.xSPH_h2 = SPH_h * SPH_h;
+	cb.xSPH_h3 = cb.xSPH_h2 * SPH_h;
+	const float h6 = cb.xSPH_h2 * cb.xSPH_h2 * cb.xSPH_h2;
+	const float h9 = h6 * cb.xSPH_h3;
+	cb.xSPH_poly6_constant = (315.0f / (64.0f * XM_PI * h9));
+	cb.xSPH_spiky_constant = (-45.0f / (XM_PI * h6));
+	cb.xSPH_K = SPH_K;
+	cb.xSPH_p0 = SPH_p0;
+	cb.xSPH_e = SPH_e;
+
+	cb.xEmitterPoolSlot = 0;
+	cb.xEmitterAgeSpread = 0;
+	cb.xEmitterPoolPadding1 = 0;
+	cb.xEmitterPoolPadding2 = 0;
+}
+
 void wiEmittedParticle::UpdateGPU(const TransformComponent& transform, const MaterialComponent& material, const MeshComponent* mesh, CommandList cmd) const
 {
-	if (!particleBuffer.IsValid())
+	if (!particleBuffer.IsValid() || IsSimulationSkipped())
 	{
 		return;
 	}
 
+	for (uint32_t step = 0; step < simulationSteps; ++step)
+	{
+		if (step > 0)
+		{
+			// The NEW alive list of the previous step is the CURRENT of this one:
+			std::swap(aliveList[0], aliveList[1]);
+		}
+		UpdateGPU_Step(transform, material, mesh, step, cmd);
+	}
+}
+void wiEmittedParticle::UpdateGPU_Step(const TransformComponent& transform, const MaterialComponent& material, const MeshComponent* mesh, uint32_t step, CommandList cmd) const
+{
 	GraphicsDevice* device = wiRenderer::GetDevice();
 
 	if (!IsPaused())
@@ -247,62 +762,13 @@ void wiEmittedParticle::UpdateGPU(const TransformComponent& transform, const Mat
 		device->EventBegin("UpdateEmittedParticles", cmd);
 
 		EmittedParticleCB cb;
-		cb.xEmitterWorld = transform.world;
-		cb.xEmitCount = (uint32_t)emit;
-		cb.xEmitterMeshIndexCount = mesh == nullptr ? 0 : (uint32_t)mesh->indices.size();
-		cb.xEmitterMeshVertexPositionStride = sizeof(MeshComponent::Vertex_POS);
-		cb.xEmitterRandomness = wiRandom::getRandom(0, 1000) * 0.001f;
-		cb.xParticleLifeSpan = life;
-		cb.xParticleLifeSpanRandomness = random_life;
-		cb.xParticleNormalFactor = normal_factor;
-		cb.xParticleRandomFactor = random_factor;
-		cb.xParticleScaling = scaleX;
-		cb.xParticleSize = size;
-		cb.xParticleMotionBlurAmount = motionBlurAmount;
-		cb.xParticleRotation = rotation * XM_PI * 60;
-		cb.xParticleColor = wiMath::CompressColor(XMFLOAT4(material.baseColor.x, material.baseColor.y, material.baseColor.z, 1));
-		cb.xParticleEmissive = material.emissiveColor.w;
-		cb.xEmitterOpacity = material.GetOpacity();
-		cb.xParticleMass = mass;
-		cb.xEmitterMaxParticleCount = MAX_PARTICLES;
-		cb.xEmitterFixedTimestep = FIXED_TIMESTEP;
-		cb.xEmitterFramesXY = uint2(std::max(1u, framesX), std::max(1u, framesY));
-		cb.xEmitterFrameCount = std::max(1u, frameCount);
-		cb.xEmitterFrameStart = frameStart;
-		cb.xEmitterTexMul = float2(1.0f / (float)cb.xEmitterFramesXY.x, 1.0f / (float)cb.xEmitterFramesXY.y);
-		cb.xEmitterFrameRate = frameRate;
-		cb.xParticleGravity = gravity;
-		cb.xParticleDrag = drag;
-		XMStoreFloat3(&cb.xParticleVelocity, XMVector3TransformNormal(XMLoadFloat3(&velocity), XMLoadFloat4x4(&transform.world)));
-		cb.xParticleRandomColorFactor = random_color;
-		cb.xEmitterLayerMask = layerMask;
-
-		cb.xEmitterOptions = 0;
-		if (IsSPHEnabled())
-		{
-			cb.xEmitterOptions |= EMITTER_OPTION_BIT_SPH_ENABLED;
-		}
-		if (IsFrameBlendingEnabled())
-		{
-			cb.xEmitterOptions |= EMITTER_OPTION_BIT_FRAME_BLENDING_ENABLED;
-		}
-		if (ALLOW_MESH_SHADER && device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_MESH_SHADER))
-		{
-			cb.xEmitterOptions |= EMITTER_OPTION_BIT_MESH_SHADER_ENABLED;
-		}
-
-		// SPH:
-		cb.xSPH_h = SPH_h;
-		cb.xSPH_h_rcp = 1.0f / SPH_h;
-		cb.xSPH_h2 = SPH_h * SPH_h;
-		cb.xSPH_h3 = cb.xSPH_h2 * SPH_h;
-		const float h6 = cb.xSPH_h2 * cb.xSPH_h2 * cb.xSPH_h2;
-		const float h9 = h6 * cb.xSPH_h3;
-		cb.xSPH_poly6_constant = (315.0f / (64.0f * XM_PI * h9));
-		cb.xSPH_spiky_constant = (-45.0f / (XM_PI * h6));
-		cb.xSPH_K = SPH_K;
-		cb.xSPH_p0 = SPH_p0;
-		cb.xSPH_e = SPH_e;
+		FillConstantBuffer(cb, transform, material, mesh);
+		cb.xEmitCount = GetStepEmitCount(step);
+		if (simulationStepTime >= 0)
+		{
+			cb.xEmitterFixedTimestep = simulationStepTime;
+			cb.xEmitterAgeSpread = simulationStepTime;
+		}
 
 		device->UpdateBuffer(&constantBuffer, &cb, cmd);
 		device->BindConstantBuffer(CS, &constantBuffer, CB_GETBINDSLOT(EmittedParticleCB), cmd);
@@ -356,7 +822,7 @@ void wiEmittedParticle::UpdateGPU(const TransformComponent& transform, const Mat
 		device->Barrier(&barrier_memory, 1, cmd);
 		device->EventEnd(cmd);
 
-		if (IsSPHEnabled())
+		if (IsSPHEnabled() && sphPartitionCellIndices.IsValid())
 		{
 			auto range = wiProfiler::BeginRangeGPU("SPH - Simulation", cmd);
 
@@ -385,27 +851,34 @@ void wiEmittedParticle::UpdateGPU(const TransformComponent& transform, const Mat
 			// 2.) Sort particle index list based on partition grid cell index:
 			wiGPUSortLib::Sort(MAX_PARTICLES, sphPartitionCellIndices, counterBuffer, PARTICLECOUNTER_OFFSET_ALIVECOUNT, aliveList[0], cmd);
 
-			// 3.) Reset grid cell offset buffer with invalid offsets (max uint):
+			// 3.) Reset grid cell range buffer with empty ranges:
 			device->EventBegin("PartitionOffsetsReset", cmd);
 			device->BindComputeShader(&sphpartitionoffsetsresetCS, cmd);
 			device->UnbindUAVs(0, 8, cmd);
 			const GPUResource* uav_partitionoffsets[] = {
-				&sphPartitionCellOffsets,
+				&sphPartitionCellRanges,
 			};
 			device->BindUAVs(CS, uav_partitionoffsets, 0, arraysize(uav_partitionoffsets), cmd);
 			device->Dispatch((uint32_t)ceilf((float)SPH_PARTITION_BUCKET_COUNT / (float)THREADCOUNT_SIMULATION), 1, 1, cmd);
 			device->Barrier(&barrier_memory, 1, cmd);
 			device->EventEnd(cmd);
 
-			// 4.) Assemble grid cell offsets from the sorted particle index list <--> grid cell index list connection:
+			// 4.) Assemble grid cell ranges from the sorted particle index list <--> grid cell index list connection, and copy the particles in sorted order:
 			device->EventBegin("PartitionOffsets", cmd);
 			device->BindComputeShader(&sphpartitionoffsetsCS, cmd);
 			const GPUResource* res_partitionoffsets[] = {
 				&aliveList[0], // CURRENT alivelist
 				&counterBuffer,
 				&sphPartitionCellIndices,
+				&particleBuffer,
 			};
 			device->BindResources(CS, res_partitionoffsets, 0, arraysize(res_partitionoffsets), cmd);
+			const GPUResource* uav_sorted[] = {
+				&sphPartitionCellRanges,
+				&sphSortedPositions,
+				&sphSortedVelocities,
+			};
+			device->BindUAVs(CS, uav_sorted, 0, arraysize(uav_sorted), cmd);
 			device->DispatchIndirect(&indirectBuffers, ARGUMENTBUFFER_OFFSET_DISPATCHSIMULATION, cmd);
 			device->Barrier(&barrier_memory, 1, cmd);
 			device->EventEnd(cmd);
@@ -420,8 +893,8 @@ void wiEmittedParticle::UpdateGPU(const TransformComponent& transform, const Mat
 				&aliveList[0], // CURRENT alivelist
 				&counterBuffer,
 				&particleBuffer,
-				&sphPartitionCellIndices,
-				&sphPartitionCellOffsets,
+				&sphPartitionCellRanges,
+				&sphSortedPositions,
 			};
 			device->BindResources(CS, res_density, 0, arraysize(res_density), cmd);
 			const GPUResource* uav_density[] = {
@@ -440,8 +913,9 @@ void wiEmittedParticle::UpdateGPU(const TransformComponent& transform, const Mat
 				&aliveList[0], // CURRENT alivelist
 				&counterBuffer,
 				&densityBuffer,
-				&sphPartitionCellIndices,
-				&sphPartitionCellOffsets,
+				&sphPartitionCellRanges,
+				&sphSortedPositions,
+				&sphSortedVelocities,
 			};
 			device->BindResources(CS, res_force, 0, arraysize(res_force), cmd);
 			const GPUResource* uav_force[] = {
@@ -452,7 +926,7 @@ void wiEmittedParticle::UpdateGPU(const TransformComponent& transform, const Mat
 			device->Barrier(&barrier_memory, 1, cmd);
 			device->EventEnd(cmd);
 
-			device->UnbindResources(0, 3, cmd);
+			device->UnbindResources(0, 6, cmd);
 			device->UnbindUAVs(0, 8, cmd);
 
 			device->EventEnd(cmd);
@@ -565,9 +1039,313 @@ void wiEmittedParticle::UpdateGPU(const TransformComponent& transform, const Mat
 	}
 }
 
+void wiEmittedParticle::UpdateGPU_Pooled(const Scene& scene, const uint32_t* emitterIndices, size_t count, CommandList cmd)
+{
+	pool.updates.clear();
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint32_t emitterIndex = emitterIndices[i];
+		const wiEmittedParticle& emitter = scene.emitters[emitterIndex];
+		if (!emitter.IsPooled() || !emitter.constantBuffer.IsValid() || emitter.MAX_PARTICLES == 0 || emitter.IsSimulationSkipped())
+		{
+			continue;
+		}
+		const wiECS::Entity entity = scene.emitters.GetEntity(emitterIndex);
+		const TransformComponent* transform = scene.transforms.GetComponent(entity);
+		const MaterialComponent* material = scene.materials.GetComponent(entity);
+		if (transform == nullptr || material == nullptr)
+		{
+			continue;
+		}
+		pool.updates.push_back({ &emitter, transform, material });
+	}
+	if (pool.updates.empty())
+	{
+		return;
+	}
+
+	GraphicsDevice* device = wiRenderer::GetDevice();
+
+	if (!pool.constantBuffer.IsValid())
+	{
+		GPUBufferDesc bd;
+		bd.Usage = USAGE_DEFAULT;
+		bd.ByteWidth = sizeof(EmittedParticlePoolCB);
+		bd.BindFlags = BIND_CONSTANT_BUFFER;
+		device->CreateBuffer(&bd, nullptr, &pool.constantBuffer);
+
+		pool.slots.emplace_back(); // the pool counter
+		pool.slots.back().used = true;
+	}
+
+	// The sorted emitters are first, their index in the list is the upper bits of the sort key:
+	std::stable_partition(pool.updates.begin(), pool.updates.end(), [](const ParticlePool::Update& update) {
+		return update.emitter->IsSorted();
+	});
+
+	pool.frame++;
+	for (auto& update : pool.updates)
+	{
+		const wiEmittedParticle& emitter = *update.emitter;
+		emitter.poolSlot = pool.AcquireSlot(emitter.poolSlot, emitter.poolGeneration, emitter.MAX_PARTICLES);
+		if (emitter.poolReset)
+		{
+			pool.slots[emitter.poolSlot].reset = true;
+			emitter.poolReset = false;
+		}
+	}
+	if ((uint32_t)pool.slots.size() > pool.slotCapacity)
+	{
+		pool.CreateSlotBuffers(std::max(ParticlePool::MIN_SLOT_CAPACITY, (uint32_t)pool.slots.size() * 2));
+	}
+
+	// Read back statistics (with GPU delay):
+	if (pool.statisticsReadBackIndex > arraysize(pool.statisticsReadbackBuffer))
+	{
+		const uint32_t oldest_stat_index = (pool.statisticsReadBackIndex + 1) % arraysize(pool.statisticsReadbackBuffer);
+		Mapping mapping;
+		mapping._flags = Mapping::FLAG_READ;
+		mapping.size = sizeof(ParticleCounters) * pool.statistics.size();
+		device->Map(&pool.statisticsReadbackBuffer[oldest_stat_index], &mapping);
+		if (mapping.data != nullptr)
+		{
+			memcpy(pool.statistics.data(), mapping.data, sizeof(ParticleCounters) * pool.statistics.size());
+			device->Unmap(&pool.statisticsReadbackBuffer[oldest_stat_index]);
+		}
+	}
+	const uint32_t stat_index = pool.statisticsReadBackIndex % arraysize(pool.statisticsReadbackBuffer);
+	pool.statisticsReadBackIndex++;
+
+	device->EventBegin("UpdateEmittedParticles (Pool)", cmd);
+
+	// The emitters that catch up with the time skipped off screen take part in more rounds, one simulation step in each,
+	//	their rounds are the last ones, so every emitter does its last step in the last round, which also sorts and fills the draw arguments
+	uint32_t rounds = 1;
+	for (auto& update : pool.updates)
+	{
+		rounds = std::max(rounds, update.emitter->simulationSteps);
+	}
+
+	for (uint32_t round = 0; round < rounds; ++round)
+	{
+		const bool lastRound = round == rounds - 1;
+
+		pool.emitterData.clear();
+		uint32_t resetCount = 0;
+		uint32_t sortedCount = 0;
+		for (auto& update : pool.updates)
+		{
+			const wiEmittedParticle& emitter = *update.emitter;
+			if (round + emitter.simulationSteps < rounds)
+			{
+				continue;
+			}
+			const uint32_t step = round + emitter.simulationSteps - rounds;
+			ParticlePool::Slot& slot = pool.slots[emitter.poolSlot];
+
+			EmittedParticleCB cb;
+			emitter.FillConstantBuffer(cb, *update.transform, *update.material, nullptr);
+			cb.xEmitterOptions |= EMITTER_OPTION_BIT_POOLED;
+			cb.xEmitterPoolSlot = emitter.poolSlot;
+			if (lastRound)
+			{
+				// The constant buffer of the emitter is only used for drawing:
+				device->UpdateBuffer(&emitter.constantBuffer, &cb, cmd);
+			}
+
+			pool.emitterData.emplace_back();
+			EmittedParticlePoolEmitter& data = pool.emitterData.back();
+			const XMFLOAT4X4& world = update.transform->world;
+			data.mat0 = XMFLOAT4(world._11, world._21, world._31, world._41);
+			data.mat1 = XMFLOAT4(world._12, world._22, world._32, world._42);
+			data.mat2 = XMFLOAT4(world._13, world._23, world._33, world._43);
+			data.emitCount = emitter.IsPaused() ? 0 : emitter.GetStepEmitCount(step);
+			data.layerMask = cb.xEmitterLayerMask;
+			data.randomness = cb.xEmitterRandomness;
+			data.particleSize = cb.xParticleSize;
+			data.particleScaling = cb.xParticleScaling;
+			data.particleRotation = cb.xParticleRotation;
+			data.particleColor = cb.xParticleColor;
+			data.randomFactor = cb.xParticleRandomFactor;
+			data.normalFactor = cb.xParticleNormalFactor;
+			data.lifeSpan = cb.xParticleLifeSpan;
+			data.lifeSpanRandomness = cb.xParticleLifeSpanRandomness;
+			data.mass = cb.xParticleMass;
+			data.fixedTimestep = emitter.simulationStepTime >= 0 ? emitter.simulationStepTime : cb.xEmitterFixedTimestep;
+			data.drag = cb.xParticleDrag;
+			data.randomColorFactor = cb.xParticleRandomColorFactor;
+			data.gravity = cb.xParticleGravity;
+			data.velocity = cb.xParticleVelocity;
+			data.particleOffset = slot.particleOffset;
+			data.particleCount = slot.particleCount;
+			data.slot = emitter.poolSlot;
+			data.particleLimit = cb.xEmitterMaxParticleCount;
+			data.ageSpread = std::max(0.0f, emitter.simulationStepTime);
+			data.padding0 = 0;
+			data.padding1 = 0;
+			data.padding2 = 0;
+
+			// CURRENT is the NEW of the last update of the emitter:
+			data.aliveOffsetCurrent = slot.parity * pool.particleCapacity + slot.particleOffset;
+			slot.parity ^= 1;
+			data.aliveOffsetNew = slot.parity * pool.particleCapacity + slot.particleOffset;
+
+			data.options = 0;
+			if (emitter.IsVolumeEnabled())
+			{
+				data.options |= EMITTER_OPTION_BIT_VOLUME;
+			}
+			if (emitter.IsDepthCollisionEnabled())
+			{
+				data.options |= EMITTER_OPTION_BIT_DEPTHCOLLISIONS;
+			}
+			if (emitter.IsPaused())
+			{
+				data.options |= EMITTER_OPTION_BIT_PAUSED;
+			}
+			// Only the last round is sorted, and the emitters over the sort key limit are drawn unsorted:
+			if (lastRound)
+			{
+				emitter.poolSorted = emitter.IsSorted() && sortedCount < POOL_SORT_MAX_EMITTERS;
+				if (emitter.poolSorted)
+				{
+					data.options |= EMITTER_OPTION_BIT_SORTING;
+					sortedCount++;
+				}
+			}
+			if (slot.reset)
+			{
+				data.options |= EMITTER_OPTION_BIT_RESET;
+				resetCount = std::max(resetCount, slot.particleCount);
+				slot.reset = false;
+			}
+		}
+		device->UpdateBuffer(&pool.emitterBuffer, pool.emitterData.data(), cmd, int(sizeof(EmittedParticlePoolEmitter) * pool.emitterData.size()));
+
+		EmittedParticlePoolCB cb;
+		cb.xPoolEmitterCount = (uint32_t)pool.emitterData.size();
+		cb.xPoolResetCount = resetCount;
+		cb.xPoolPadding0 = 0;
+		cb.xPoolPadding1 = 0;
+		device->UpdateBuffer(&pool.constantBuffer, &cb, cmd);
+		device->BindConstantBuffer(CS, &pool.constantBuffer, CB_GETBINDSLOT(EmittedParticlePoolCB), cmd);
+
+		device->BindResource(CS, &pool.emitterBuffer, TEXSLOT_ONDEMAND0, cmd);
+
+		const GPUResource* uavs[] = {
+			&pool.particleBuffer,
+			&pool.aliveList,
+			&pool.deadList,
+			&pool.counterBuffer,
+			&pool.indirectBuffers,
+			&pool.distanceBuffer,
+			&pool.sortList,
+		};
+		device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+		GPUBarrier barrier_indirect_uav = GPUBarrier::Buffer(&pool.indirectBuffers, BUFFER_STATE_INDIRECT_ARGUMENT, BUFFER_STATE_UNORDERED_ACCESS);
+		GPUBarrier barrier_uav_indirect = GPUBarrier::Buffer(&pool.indirectBuffers, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_INDIRECT_ARGUMENT);
+		GPUBarrier barrier_memory = GPUBarrier::Memory();
+
+		device->Barrier(&barrier_indirect_uav, 1, cmd);
+
+		// the new and restarted emitters fill their dead list range:
+		if (resetCount > 0)
+		{
+			device->EventBegin("Reset", cmd);
+			device->BindComputeShader(&poolResetCS, cmd);
+			device->Dispatch((resetCount + THREADCOUNT_EMIT - 1) / THREADCOUNT_EMIT, cb.xPoolEmitterCount, 1, cmd);
+			device->Barrier(&barrier_memory, 1, cmd);
+			device->EventEnd(cmd);
+		}
+
+		// kick off updating, set up state of every emitter
+		device->EventBegin("KickOff Update", cmd);
+		device->BindComputeShader(&poolKickoffCS, cmd);
+		device->Dispatch(1, 1, 1, cmd);
+		device->Barrier(&barrier_memory, 1, cmd);
+		device->EventEnd(cmd);
+
+		device->Barrier(&barrier_uav_indirect, 1, cmd);
+
+		// emit the required amount if there are free slots in dead list
+		device->EventBegin("Emit", cmd);
+		device->BindComputeShader(&poolEmitCS, cmd);
+		device->DispatchIndirect(&pool.indirectBuffers, POOL_ARGUMENTBUFFER_OFFSET_DISPATCHEMIT, cmd);
+		device->Barrier(&barrier_memory, 1, cmd);
+		device->EventEnd(cmd);
+
+		// update CURRENT alive list, write NEW alive list and the sort list
+		device->EventBegin("Simulate", cmd);
+		device->BindComputeShader(&poolSimulateCS, cmd);
+		device->DispatchIndirect(&pool.indirectBuffers, POOL_ARGUMENTBUFFER_OFFSET_DISPATCHSIMULATION, cmd);
+		device->Barrier(&barrier_memory, 1, cmd);
+		device->EventEnd(cmd);
+
+		device->UnbindUAVs(0, arraysize(uavs), cmd);
+
+		// one sort for the particles of every sorted emitter, the count is in the pool counter:
+		if (sortedCount > 0)
+		{
+			wiGPUSortLib::Sort(pool.particleCapacity, pool.distanceBuffer, pool.counterBuffer, PARTICLECOUNTER_OFFSET_ALIVECOUNT_AFTERSIMULATION, pool.sortList, cmd);
+		}
+
+		// finish updating, update draw argument buffers:
+		device->EventBegin("FinishUpdate", cmd);
+		device->BindComputeShader(&poolFinishCS, cmd);
+		device->BindConstantBuffer(CS, &pool.constantBuffer, CB_GETBINDSLOT(EmittedParticlePoolCB), cmd);
+		device->BindResource(CS, &pool.emitterBuffer, TEXSLOT_ONDEMAND0, cmd);
+		device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+		{
+			GPUBarrier barriers[] = {
+				GPUBarrier::Memory(),
+				GPUBarrier::Buffer(&pool.indirectBuffers, BUFFER_STATE_INDIRECT_ARGUMENT, BUFFER_STATE_UNORDERED_ACCESS),
+			};
+			device->Barrier(barriers, arraysize(barriers), cmd);
+		}
+
+		device->Dispatch((cb.xPoolEmitterCount + THREADCOUNT_POOL - 1) / THREADCOUNT_POOL, 1, 1, cmd);
+
+		device->UnbindUAVs(0, arraysize(uavs), cmd);
+		device->UnbindResources(TEXSLOT_ONDEMAND0, 1, cmd);
+		device->EventEnd(cmd);
+
+		{
+			GPUBarrier barriers[] = {
+				GPUBarrier::Memory(),
+				GPUBarrier::Buffer(&pool.counterBuffer, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_COPY_SRC),
+			};
+			device->Barrier(barriers, arraysize(barriers), cmd);
+		}
+
+		// Statistics of every slot is copied to readback:
+		device->CopyResource(&pool.statisticsReadbackBuffer[stat_index], &pool.counterBuffer, cmd);
+
+		{
+			const GPUBarrier barriers[] = {
+				GPUBarrier::Buffer(&pool.indirectBuffers, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_INDIRECT_ARGUMENT),
+				GPUBarrier::Buffer(&pool.counterBuffer, BUFFER_STATE_COPY_SRC, BUFFER_STATE_SHADER_RESOURCE),
+				GPUBarrier::Buffer(&pool.particleBuffer, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE),
+				GPUBarrier::Buffer(&pool.aliveList, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE),
+				GPUBarrier::Buffer(&pool.sortList, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE),
+			};
+			device->Barrier(barriers, arraysize(barriers), cmd);
+		}
+	}
+
+	device->EventEnd(cmd);
+}
+
 
 void wiEmittedParticle::Draw(const CameraComponent& camera, const MaterialComponent& material, CommandList cmd) const
 {
+	if (pooled && (poolSlot == 0 || poolSlot >= pool.slots.size() || pool.slots[poolSlot].frame != pool.frame))
+	{
+		// not updated by the last pooled update
+		return;
+	}
+
 	GraphicsDevice* device = wiRenderer::GetDevice();
 	device->EventBegin("EmittedParticle", cmd);
 
@@ -575,6 +1353,10 @@ void wiEmittedParticle::Draw(const CameraComponent& camera, const MaterialCompon
 	{
 		device->BindPipelineState(&PSO_wire, cmd);
 	}
+	else if (wiRenderer::IsOverdrawRender(cmd))
+	{
+		device->BindPipelineState(&PSO_overdraw, cmd);
+	}
 	else
 	{
 		const BLENDMODE blendMode = material.GetBlendMode();
@@ -587,14 +1369,33 @@ void wiEmittedParticle::Draw(const CameraComponent& camera, const MaterialCompon
 		{
 			device->BindResource(PS, material.textures[MaterialComponent::BASECOLORMAP].GetGPUResource(), TEXSLOT_ONDEMAND0, cmd);
 		}
-		device->BindShadingRate(material.shadingRate, cmd);
+		if (wiRenderer::GetVariableRateShadingClassification())
+		{
+			// The particles are not in the classification, they are drawn with the coarser of the material and the policy rate:
+			device->BindShadingRate(std::max(material.shadingRate, wiRenderer::GetVariableRateShadingPolicy(wiRenderer::VARIABLE_RATE_SHADING_PASS_PARTICLES)), cmd);
+		}
+		else
+		{
+			device->BindShadingRate(material.shadingRate, cmd);
+		}
 	}
 
 	device->BindConstantBuffer(VS, &constantBuffer, CB_GETBINDSLOT(EmittedParticleCB), cmd);
 	device->BindConstantBuffer(PS, &constantBuffer, CB_GETBINDSLOT(EmittedParticleCB), cmd);
 	device->BindConstantBuffer(PS, &material.constantBuffer, CB_GETBINDSLOT(MaterialCB), cmd);
 
-	if (ALLOW_MESH_SHADER && device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_MESH_SHADER))
+	if (pooled)
+	{
+		// The counter of the slot has the start of the range in the alive or sort list:
+		const GPUResource* res[] = {
+			&pool.counterBuffer,
+			&pool.particleBuffer,
+			poolSorted ? &pool.sortList : &pool.aliveList,
+		};
+		device->BindResources(VS, res, TEXSLOT_ONDEMAND20, arraysize(res), cmd);
+		device->DrawInstancedIndirect(&pool.indirectBuffers, POOL_ARGUMENTBUFFER_OFFSET_DRAWPARTICLES + poolSlot * (uint32_t)sizeof(IndirectDrawArgsInstanced), cmd);
+	}
+	else if (ALLOW_MESH_SHADER && device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_MESH_SHADER))
 	{
 		const GPUResource* res[] = {
 			&counterBuffer,
@@ -635,6 +1436,7 @@ namespace wiEmittedParticle_Internal
 		wiRenderer::LoadShader(PS, pixelShader[wiEmittedParticle::SOFT_DISTORTION], "emittedparticlePS_soft_distortion.cso");
 		wiRenderer::LoadShader(PS, pixelShader[wiEmittedParticle::SIMPLE], "emittedparticlePS_simple.cso");
 		wiRenderer::LoadShader(PS, pixelShader[wiEmittedParticle::SOFT_LIGHTING], "emittedparticlePS_soft_lighting.cso");
+		wiRenderer::LoadShader(PS, overdrawPS, "overdrawPS.cso");
 
 		wiRenderer::LoadShader(CS, kickoffUpdateCS, "emittedparticle_kickoffUpdateCS.cso");
 		wiRenderer::LoadShader(CS, finishUpdateCS, "emittedparticle_finishUpdateCS.cso");
@@ -650,6 +1452,11 @@ namespace wiEmittedParticle_Internal
 		wiRenderer::LoadShader(CS, simulateCS_SORTING, "emittedparticle_simulateCS_SORTING.cso");
 		wiRenderer::LoadShader(CS, simulateCS_DEPTHCOLLISIONS, "emittedparticle_simulateCS_DEPTHCOLLISIONS.cso");
 		wiRenderer::LoadShader(CS, simulateCS_SORTING_DEPTHCOLLISIONS, "emittedparticle_simulateCS_SORTING_DEPTHCOLLISIONS.cso");
+		wiRenderer::LoadShader(CS, poolResetCS, "emittedparticle_poolResetCS.cso");
+		wiRenderer::LoadShader(CS, poolKickoffCS, "emittedparticle_poolKickoffCS.cso");
+		wiRenderer::LoadShader(CS, poolEmitCS, "emittedparticle_poolEmitCS.cso");
+		wiRenderer::LoadShader(CS, poolSimulateCS, "emittedparticle_poolSimulateCS.cso");
+		wiRenderer::LoadShader(CS, poolFinishCS, "emittedparticle_poolFinishCS.cso");
 
 
 		GraphicsDevice* device = wiRenderer::GetDevice();
@@ -694,6 +1501,12 @@ namespace wiEmittedParticle_Internal
 			desc.dss = &depthStencilState;
 
 			device->CreatePipelineState(&desc, &PSO_wire);
+
+			desc.ps = &overdrawPS;
+			desc.bs = &blendStates[BLENDMODE_ADDITIVE];
+			desc.rs = &rasterizerState;
+			desc.dss = wiRenderer::GetDepthStencilState(DSSTYPE_XRAY);
+			device->CreatePipelineState(&desc, &PSO_overdraw);
 		}
 
 	}
@@ -778,6 +1591,15 @@ void wiEmittedParticle::Initialize()
 	wiBackLog::post("wiEmittedParticle Initialized");
 }
 
+void wiEmittedParticle::SetPoolingEnabled(bool value)
+{
+	pool.enabled = value;
+}
+bool wiEmittedParticle::IsPoolingEnabled()
+{
+	return pool.enabled;
+}
+
 
 void wiEmittedParticle::Serialize(wiArchive& archive, wiECS::EntitySerializer& seri)
 {
@@ -834,6 +1656,15 @@ void wiEmittedParticle::Serialize(wiArchive& archive, wiECS::EntitySerializer& s
 				drag = 0.98f;
 			}
 		}
+
+		if (archive.GetVersion() >= 82)
+		{
+			archive >> lod_distance_start;
+			archive >> lod_distance_end;
+			archive >> lod_factor_min;
+			archive >> offscreen_frames;
+			archive >> offscreen_interval;
+		}
 	}
 	else
 	{
@@ -874,6 +1705,15 @@ void wiEmittedParticle::Serialize(wiArchive& archive, wiECS::EntitySerializer& s
 			archive << drag;
 			archive << random_color;
 		}
+
+		if (archive.GetVersion() >= 82)
+		{
+			archive << lod_distance_start;
+			archive << lod_distance_end;
+			archive << lod_factor_min;
+			archive << offscreen_frames;
+			archive << offscreen_interval;
+		}
 	}
 }
 
@@ -34,25 +34,51 @@ private:
 	wiGraphics::GPUBuffer statisticsReadbackBuffer[wiGraphics::GraphicsDevice::GetBufferCount() + 3];
 
 	wiGraphics::GPUBuffer particleBuffer;
-	wiGraphics::GPUBuffer aliveList[2];
+	mutable wiGraphics::GPUBuffer aliveList[2]; // CURRENT and NEW, they are swapped by every simulation step
 	wiGraphics::GPUBuffer deadList;
 	wiGraphics::GPUBuffer distanceBuffer; // for sorting
 	wiGraphics::GPUBuffer sphPartitionCellIndices; // for SPH
-	wiGraphics::GPUBuffer sphPartitionCellOffsets; // for SPH
+	wiGraphics::GPUBuffer sphPartitionCellRanges; // for SPH
+	wiGraphics::GPUBuffer sphSortedPositions; // for SPH
+	wiGraphics::GPUBuffer sphSortedVelocities; // for SPH
 	wiGraphics::GPUBuffer densityBuffer; // for SPH
 	wiGraphics::GPUBuffer counterBuffer;
 	wiGraphics::GPUBuffer indirectBuffers; // kickoffUpdate, simulation, draw
 	wiGraphics::GPUBuffer constantBuffer;
 	void CreateSelfBuffers();
+	void FillConstantBuffer(EmittedParticleCB& cb, const TransformComponent& transform, const MaterialComponent& material, const MeshComponent* mesh) const;
 
 	float emit = 0.0f;
 	int burst = 0;
 
+	// Level of detail and off screen throttling state:
+	float lodFactor = 1.0f;
+	uint32_t offscreenFrameCount = 0;
+	float skippedTime = 0; // the time that was not simulated because of the off screen throttling
+	uint32_t simulationSteps = 1; // 0: skipped in this frame
+	float simulationStepTime = -1; // >=0: catching up with the skipped time or SPH substeps, in steps of this length
+	uint32_t GetStepEmitCount(uint32_t step) const;
+	void UpdateGPU_Step(const TransformComponent& transform, const MaterialComponent& material, const MeshComponent* mesh, uint32_t step, wiGraphics::CommandList cmd) const;
+
+	// Visibility feedback, written by the renderer (wiRenderer::UpdateVisibility()) and used by the next UpdateCPU():
+	mutable bool visibilityTested = false;
+	mutable bool visibilityOnscreen = false;
+	mutable float visibilityDistance = FLT_MAX;
+
 	bool buffersUpToDate = false;
 	uint32_t MAX_PARTICLES = 1000;
 
+	// Particle pool state:
+	bool pooled = false; // the particles are in the particle pool instead of the own buffers
+	mutable bool poolReset = true; // the pool range is reset by the next pooled update
+	mutable bool poolSorted = false; // drawn from the sort list of the pool
+	mutable uint32_t poolSlot = 0; // 0: no pool slot yet
+	mutable uint32_t poolGeneration = 0;
+	bool CanBePooled() const;
+
 public:
-	void UpdateCPU(const TransformComponent& transform, float dt);
+	// The mesh is optional, it is the emitter mesh (meshID) for the bounds
+	void UpdateCPU(const TransformComponent& transform, const MeshComponent* mesh, float dt);
 	void Burst(int num);
 	void Restart();
 
@@ -60,6 +86,28 @@ public:
 	void UpdateGPU(const TransformComponent& transform, const MaterialComponent& material, const MeshComponent* mesh, wiGraphics::CommandList cmd) const;
 	void Draw(const CameraComponent& camera, const MaterialComponent& material, wiGraphics::CommandList cmd) const;
 
+	// Particle pool: the emitters without SPH and emitter mesh share big particle buffers, with a range for every emitter,
+	//	and they are simulated together with one dispatch per phase, the sorted ones with one combined sort
+	//	UpdateGPU() doesn't do anything for the pooled emitters, they must be updated by UpdateGPU_Pooled() before they are drawn
+	//	emitterIndices are indices into scene.emitters, the ones that are not pooled are skipped
+	static void UpdateGPU_Pooled(const Scene& scene, const uint32_t* emitterIndices, size_t count, wiGraphics::CommandList cmd);
+	// Pooling is enabled by default, the emitters switch to their own buffers by the next UpdateCPU() when it is disabled
+	static void SetPoolingEnabled(bool value);
+	static bool IsPoolingEnabled();
+	inline bool IsPooled() const { return pooled; }
+
+	// The renderer reports that a camera tested the emitter, if it was inside the camera frustum, and the distance to the camera
+	void SetVisibility(bool onscreen, float distance) const;
+	// The emitter is throttled off screen and it is not simulated in this frame, it shouldn't be updated or drawn until the next UpdateCPU()
+	inline bool IsSimulationSkipped() const { return simulationSteps == 0; }
+	// Simulation steps of the next update, more than one if it catches up with the time skipped off screen, or SPH needs shorter steps
+	inline uint32_t GetSimulationSteps() const { return simulationSteps; }
+	inline float GetLODFactor() const { return lodFactor; }
+
+	// The time skipped off screen is simulated with steps of at least this length, and at most this many steps:
+	static constexpr float OFFSCREEN_CATCHUP_STEP = 1.0f / 30.0f;
+	static constexpr uint32_t OFFSCREEN_CATCHUP_MAX_STEPS = 8;
+
 	ParticleCounters GetStatistics() { return statistics; }
 
 	enum FLAGS
@@ -110,12 +158,24 @@ public:
 	uint32_t frameStart = 0;
 	float frameRate = 0; // frames per second
 
+	// Level of detail: farther from the camera than lod_distance_start, the emission rate and the particle count limit are reduced gradually,
+	//	down to lod_factor_min at lod_distance_end and beyond (lod_distance_end <= lod_distance_start: disabled)
+	float lod_distance_start = 0;
+	float lod_distance_end = 0;
+	float lod_factor_min = 0.25f;
+
+	// Off screen throttling: after offscreen_frames frames outside of every camera frustum, the emitter is only simulated in every offscreen_interval-th frame (0: not at all),
+	//	the time that was skipped is caught up with in a few fixed length steps when it is simulated again (offscreen_frames = 0: disabled)
+	uint32_t offscreen_frames = 60;
+	uint32_t offscreen_interval = 0;
+
 	void SetMaxParticleCount(uint32_t value);
 	uint32_t GetMaxParticleCount() const { return MAX_PARTICLES; }
 	uint32_t GetMemorySizeInBytes() const;
 
 	// Non-serialized attributes:
 	XMFLOAT3 center;
+	AABB aabb; // estimated bounds of the particles, from the emitter shape, the starting velocities, gravity and the life span (force fields can move the particles outside)
 	uint32_t statisticsReadBackIndex = 0;
 	uint32_t layerMask = ~0u;
 
@@ -103,6 +103,7 @@ enum CBTYPES
 	CBTYPE_TESSELLATION,
 	CBTYPE_RAYTRACE,
 	CBTYPE_MIPGEN,
+	CBTYPE_SPD,
 	CBTYPE_FILTERENVMAP,
 	CBTYPE_COPYTEXTURE,
 	CBTYPE_FORWARDENTITYMASK,
@@ -114,6 +115,8 @@ enum CBTYPES
 	CBTYPE_PAINTRADIUS,
 	CBTYPE_SHADINGRATECLASSIFICATION,
 	CBTYPE_VOLUMETRICCLOUDS,
+	CBTYPE_VOXELIZER,
+	CBTYPE_CLOTH,
 	CBTYPE_COUNT
 };
 
@@ -158,6 +161,7 @@ enum SHADERTYPE
     VSTYPE_SHADOWCUBEMAPRENDER,
 	VSTYPE_SHADOWCUBEMAPRENDER_ALPHATEST,
 	VSTYPE_SHADOWCUBEMAPRENDER_TRANSPARENT,
+	VSTYPE_SHADOWCACHE_COPY,
     VSTYPE_IMPOSTOR,
     VSTYPE_VERTEXCOLOR,
     VSTYPE_VOLUMETRICLIGHT_DIRECTIONAL,
@@ -209,6 +213,7 @@ enum SHADERTYPE
     PSTYPE_OBJECT_DEBUG,
     PSTYPE_OBJECT_PAINTRADIUS,
     PSTYPE_OBJECT_SIMPLE,
+    PSTYPE_OVERDRAW,
 	PSTYPE_OBJECT_PREPASS,
 	PSTYPE_OBJECT_PREPASS_ALPHATEST,
     PSTYPE_IMPOSTOR_PREPASS,
@@ -243,6 +248,7 @@ enum SHADERTYPE
     PSTYPE_RENDERLIGHTMAP,
     PSTYPE_RAYTRACE_DEBUGBVH,
     PSTYPE_DOWNSAMPLEDEPTHBUFFER,
+    PSTYPE_SHADOWCACHE_COPY,
     PSTYPE_POSTPROCESS_UPSAMPLE_BILATERAL,
     PSTYPE_POSTPROCESS_OUTLINE,
     PSTYPE_LENSFLARE,
@@ -282,13 +288,15 @@ enum SHADERTYPE
     CSTYPE_TILEFRUSTUMS,
     CSTYPE_LIGHTCULLING,
     CSTYPE_LIGHTCULLING_DEBUG,
+    CSTYPE_OVERDRAW_HEATMAP,
     CSTYPE_LIGHTCULLING_ADVANCED,
     CSTYPE_LIGHTCULLING_ADVANCED_DEBUG,
+    CSTYPE_LIGHTCLUSTERCULLING,
     CSTYPE_RESOLVEMSAADEPTHSTENCIL,
     CSTYPE_VOXELSCENECOPYCLEAR,
     CSTYPE_VOXELSCENECOPYCLEAR_TEMPORALSMOOTHING,
     CSTYPE_VOXELRADIANCESECONDARYBOUNCE,
-    CSTYPE_VOXELCLEARONLYNORMAL,
+    CSTYPE_VOXELCLIPMAPCLEAR,
     CSTYPE_SKYATMOSPHERE_TRANSMITTANCELUT,
     CSTYPE_SKYATMOSPHERE_MULTISCATTEREDLUMINANCELUT,
     CSTYPE_SKYATMOSPHERE_SKYVIEWLUT,
@@ -301,6 +309,9 @@ enum SHADERTYPE
     CSTYPE_GENERATEMIPCHAINCUBE_FLOAT4,
     CSTYPE_GENERATEMIPCHAINCUBEARRAY_UNORM4,
     CSTYPE_GENERATEMIPCHAINCUBEARRAY_FLOAT4,
+    CSTYPE_SPD_UNORM4,
+    CSTYPE_SPD_FLOAT4,
+    CSTYPE_SPD_MAX,
     CSTYPE_FILTERENVMAP,
     CSTYPE_COPYTEXTURE2D_UNORM4,
     CSTYPE_COPYTEXTURE2D_FLOAT4,
@@ -308,6 +319,18 @@ enum SHADERTYPE
     CSTYPE_COPYTEXTURE2D_FLOAT4_BORDEREXPAND,
     CSTYPE_SKINNING,
     CSTYPE_SKINNING_LDS,
+    CSTYPE_BONETRANSFORMS,
+    CSTYPE_MORPH,
+    CSTYPE_CLOTH_INTEGRATE,
+    CSTYPE_CLOTH_SOLVE,
+    CSTYPE_CLOTH_FINISH,
+    CSTYPE_INSTANCETABLE_UPDATE,
+    CSTYPE_MATERIALTABLE_UPDATE,
+    CSTYPE_GPUCULLING,
+    CSTYPE_MESHLETCULLING,
+    CSTYPE_GPUCULLING_BOXES,
+    CSTYPE_INSTANCECULLING,
+    CSTYPE_OCCLUSIONCULLING_HIZ,
     CSTYPE_RAYTRACE,
     CSTYPE_PAINT_TEXTURE,
     CSTYPE_POSTPROCESS_BLUR_GAUSSIAN_FLOAT1,
@@ -374,9 +397,13 @@ enum SHADERTYPE
 	CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_TEMPORAL,
     CSTYPE_POSTPROCESS_FXAA,
     CSTYPE_POSTPROCESS_TEMPORALAA,
+    CSTYPE_POSTPROCESS_TEMPORALAA_UPSAMPLE,
     CSTYPE_POSTPROCESS_LINEARDEPTH,
     CSTYPE_POSTPROCESS_SHARPEN,
     CSTYPE_POSTPROCESS_TONEMAP,
+    CSTYPE_POSTPROCESS_TONEMAP_SHARPEN,
+    CSTYPE_POSTPROCESS_TONEMAP_CHROMATIC_ABERRATION,
+    CSTYPE_POSTPROCESS_TONEMAP_SHARPEN_CHROMATIC_ABERRATION,
     CSTYPE_POSTPROCESS_FSR_UPSCALING,
     CSTYPE_POSTPROCESS_FSR_SHARPEN,
     CSTYPE_POSTPROCESS_CHROMATIC_ABERRATION,
@@ -409,6 +436,24 @@ enum SHADERTYPE
     SHADERTYPE_COUNT,
 };
 
+// shaders of optional features, that are created on demand
+enum SHADERGROUP
+{
+	SHADERGROUP_VOXELGI,
+	SHADERGROUP_PATHTRACING,
+	SHADERGROUP_SSR,
+	SHADERGROUP_LIGHTSHAFTS,
+	SHADERGROUP_DEPTHOFFIELD,
+	SHADERGROUP_MOTIONBLUR,
+	SHADERGROUP_BLOOM,
+	SHADERGROUP_VOLUMETRICCLOUDS,
+	SHADERGROUP_CHROMATIC_ABERRATION,
+	SHADERGROUP_FSR,
+	SHADERGROUP_RTSHADOW,
+	SHADERGROUP_RTAO,
+	SHADERGROUP_COUNT
+};
+
 // input layouts
 enum ILTYPES
 {
@@ -1,5 +1,6 @@
 #include "wiFont.h"
 #include "wiRenderer.h"
+#include "wiImage.h"
 #include "wiResourceManager.h"
 #include "wiHelper.h"
 #include "shaders/ResourceMapping.h"
@@ -15,6 +16,7 @@
 #include "Utility/stb_truetype.h"
 
 #include <fstream>
+#include <cstring>
 #include <atomic>
 #include <unordered_map>
 #include <unordered_set>
@@ -53,13 +55,14 @@ namespace wiFont_Internal
 		float y;
 		float width;
 		float height;
+		float advance; // horizontal size without the padding of distance fields
 		uint16_t tc_left;
 		uint16_t tc_right;
 		uint16_t tc_top;
 		uint16_t tc_bottom;
 	};
 	std::unordered_map<int32_t, Glyph> glyph_lookup;
-	std::unordered_map<int32_t, rect_xywh> rect_lookup;
+	std::unordered_map<int32_t, rect_xywh> rect_lookup; // the glyph rects in the atlas, without padding
 	// pack glyph identifiers to a 32-bit hash:
 	//	height:	10 bits	(height supported: 0 - 1023)
 	//	style:	6 bits	(number of font styles supported: 0 - 63)
@@ -70,6 +73,35 @@ namespace wiFont_Internal
 	constexpr int heightfromhash(int64_t hash) { return int((hash >> 0) & 0x3FF); }
 	std::unordered_set<int32_t> pendingGlyphs;
 	wiSpinLock glyphLock;
+	std::atomic<uint64_t> atlasVersion{ 1 }; // incremented when the atlas changes, the new glyphs and a grown atlas change the layouts
+
+	// The atlas grows incrementally: the new glyphs are placed on shelves (rows of glyphs with similar heights) in the free space,
+	//	so the glyphs that are already in the atlas are not rasterized or moved again. When it grows, only the texture coordinates change
+	static constexpr int ATLAS_WIDTH = 1024;
+	static constexpr int ATLAS_MAX_HEIGHT = 4096;
+	struct Shelf
+	{
+		int y;
+		int height;
+		int x; // the free space begins here
+	};
+	std::vector<Shelf> shelves;
+	std::vector<uint8_t> atlasBitmap; // CPU-side copy of the atlas
+	int atlasHeight = 0;
+	int texcoordHeight = 0; // the atlas height that the texture coordinates were computed for
+
+	// Signed distance field glyphs are rasterized once at a reference height, and scaled to every font size:
+	std::atomic_bool sdfRendering{ false };
+	static constexpr int SDF_HEIGHT = 48;
+	static constexpr int SDF_PADDING = 6; // distance range outside the glyph in texels
+	static constexpr unsigned char SDF_ONEDGE = 128;
+	static constexpr float SDF_PIXEL_DIST_SCALE = float(SDF_ONEDGE) / SDF_PADDING;
+
+	// The height that the glyphs of a font size are rasterized at:
+	inline int GetRasterHeight(const wiFontParams& params, bool sdf)
+	{
+		return sdf ? SDF_HEIGHT : params.size;
+	}
 
 	struct wiFontStyle
 	{
@@ -116,6 +148,8 @@ namespace wiFont_Internal
 	{
 		const wiFontStyle& fontStyle = fontStyles[params.style];
 		const float fontScale = stbtt_ScaleForPixelHeight(&fontStyle.fontInfo, (float)params.size);
+		const int rasterHeight = GetRasterHeight(params, sdfRendering.load());
+		const float glyphScaling = params.scaling * float(params.size) / float(rasterHeight);
 
 		uint32_t quadCount = 0;
 		float line = 0;
@@ -146,7 +180,7 @@ namespace wiFont_Internal
 		{
 			T character = text[i++];
 			int code = (int)character;
-			const int32_t hash = glyphhash(code, params.style, params.size);
+			const int32_t hash = glyphhash(code, params.style, rasterHeight);
 
 			if (glyph_lookup.count(hash) == 0)
 			{
@@ -181,10 +215,10 @@ namespace wiFont_Internal
 			else
 			{
 				const Glyph& glyph = glyph_lookup.at(hash);
-				const float glyphWidth = glyph.width * params.scaling;
-				const float glyphHeight = glyph.height * params.scaling;
-				const float glyphOffsetX = glyph.x * params.scaling;
-				const float glyphOffsetY = glyph.y * params.scaling;
+				const float glyphWidth = glyph.width * glyphScaling;
+				const float glyphHeight = glyph.height * glyphScaling;
+				const float glyphOffsetX = glyph.x * glyphScaling;
+				const float glyphOffsetY = glyph.y * glyphScaling;
 
 				const size_t vertexID = size_t(quadCount) * 4;
 
@@ -224,7 +258,7 @@ namespace wiFont_Internal
 				vertexList[vertexID + 3].Tex.x = glyph.tc_right;
 				vertexList[vertexID + 3].Tex.y = glyph.tc_bottom;
 
-				pos += glyph.width * params.scaling + params.spacingX;
+				pos += glyph.advance * glyphScaling + params.spacingX;
 				pos_last_letter = pos;
 
 				quadCount++;
@@ -347,18 +381,73 @@ void Initialize()
 	initialized.store(true);
 }
 
+// Remove every glyph from the atlas, they will be rasterized again when they are drawn
+void ResetAtlas()
+{
+	glyph_lookup.clear();
+	rect_lookup.clear();
+	shelves.clear();
+	atlasBitmap.clear();
+	atlasHeight = 0;
+	atlasVersion.fetch_add(1);
+}
+// Find free space for a rect on the shelves, returns false if the atlas is full
+bool AllocateAtlasRect(rect_xywh& rect)
+{
+	Shelf* best = nullptr;
+	for (Shelf& shelf : shelves)
+	{
+		// A shelf only takes glyphs that fill at least half of its height, to not waste the space above small glyphs:
+		if (rect.h <= shelf.height && rect.h * 2 >= shelf.height && shelf.x + rect.w <= ATLAS_WIDTH)
+		{
+			if (best == nullptr || shelf.height < best->height)
+			{
+				best = &shelf;
+			}
+		}
+	}
+	if (best == nullptr)
+	{
+		// The new shelf height is aligned, so that the next glyphs with a bit different heights fit too:
+		const int y = shelves.empty() ? 0 : shelves.back().y + shelves.back().height;
+		const int height = (rect.h + 7) & ~7;
+		if (rect.w > ATLAS_WIDTH || y + height > ATLAS_MAX_HEIGHT)
+		{
+			return false;
+		}
+		shelves.push_back({ y, height, 0 });
+		best = &shelves.back();
+	}
+	rect.x = best->x;
+	rect.y = best->y;
+	best->x += rect.w;
+	return true;
+}
+void UpdateTexCoords(Glyph& glyph, const rect_xywh& rect)
+{
+	const float inv_width = 1.0f / ATLAS_WIDTH;
+	const float inv_height = 1.0f / atlasHeight;
+	glyph.tc_left = XMConvertFloatToHalf(float(rect.x) * inv_width);
+	glyph.tc_right = XMConvertFloatToHalf(float(rect.x + rect.w) * inv_width);
+	glyph.tc_top = XMConvertFloatToHalf(float(rect.y) * inv_height);
+	glyph.tc_bottom = XMConvertFloatToHalf(float(rect.y + rect.h) * inv_height);
+}
 void UpdatePendingGlyphs()
 {
 	glyphLock.lock();
 
-	// If there are pending glyphs, render them and repack the atlas:
+	// If there are pending glyphs, render them into the free space of the atlas:
 	if (!pendingGlyphs.empty())
 	{
 		// Pad the glyph rects in the atlas to avoid bleeding from nearby texels:
 		const int borderPadding = 1;
 
-		// Font resolution is upscaled to make it sharper:
-		const float upscaling = 2.0f;//std::max(2.0f, wiRenderer::GetDevice()->GetDPIScaling());
+		// Font resolution is upscaled to make it sharper (the distance fields are scaled by the shader instead):
+		const bool sdf = sdfRendering.load();
+		const float upscaling = sdf ? 1.0f : 2.0f;//std::max(2.0f, wiRenderer::GetDevice()->GetDPIScaling());
+
+		std::vector<int32_t> added;
+		added.reserve(pendingGlyphs.size());
 
 		for (int32_t hash : pendingGlyphs)
 		{
@@ -369,101 +458,145 @@ void UpdatePendingGlyphs()
 
 			float fontScaling = stbtt_ScaleForPixelHeight(&fontStyle.fontInfo, height);
 
-			// get bounding box for character (may be offset to account for chars that dip above or below the line
-			int left, top, right, bottom;
-			stbtt_GetCodepointBitmapBox(&fontStyle.fontInfo, code, fontScaling, fontScaling, &left, &top, &right, &bottom);
-
-			// Glyph dimensions are calculated without padding:
-			Glyph& glyph = glyph_lookup[hash];
-			glyph.x = float(left);
-			glyph.y = float(top) + float(fontStyle.ascent) * fontScaling;
-			glyph.width = float(right - left);
-			glyph.height = float(bottom - top);
-
-			// Remove dpi upscaling:
-			glyph.x = glyph.x / upscaling;
-			glyph.y = glyph.y / upscaling;
-			glyph.width = glyph.width / upscaling;
-			glyph.height = glyph.height / upscaling;
-
-			// Add padding to the rectangle that will be packed in the atlas:
-			right += borderPadding * 2;
-			bottom += borderPadding * 2;
-			rect_lookup[hash] = rect_ltrb(left, top, right, bottom);
+			Glyph glyph;
+			int bitmapWidth = 0;
+			int bitmapHeight = 0;
+			unsigned char* sdfBitmap = nullptr;
+			if (sdf)
+			{
+				// The distance field contains the padding around the glyph, the quad is drawn with it:
+				int xoff, yoff;
+				sdfBitmap = stbtt_GetCodepointSDF(&fontStyle.fontInfo, fontScaling, code, SDF_PADDING, SDF_ONEDGE, SDF_PIXEL_DIST_SCALE, &bitmapWidth, &bitmapHeight, &xoff, &yoff);
+				if (sdfBitmap == nullptr)
+				{
+					bitmapWidth = 0;
+					bitmapHeight = 0;
+					xoff = 0;
+					yoff = 0;
+				}
+				glyph.x = float(xoff);
+				glyph.y = float(yoff) + float(fontStyle.ascent) * fontScaling;
+				glyph.width = float(bitmapWidth);
+				glyph.height = float(bitmapHeight);
+				glyph.advance = float(std::max(0, bitmapWidth - SDF_PADDING * 2));
+			}
+			else
+			{
+				// get bounding box for character (may be offset to account for chars that dip above or below the line
+				int left, top, right, bottom;
+				stbtt_GetCodepointBitmapBox(&fontStyle.fontInfo, code, fontScaling, fontScaling, &left, &top, &right, &bottom);
+				bitmapWidth = right - left;
+				bitmapHeight = bottom - top;
+
+				// Glyph dimensions are calculated without padding, and dpi upscaling is removed:
+				glyph.x = float(left) / upscaling;
+				glyph.y = (float(top) + float(fontStyle.ascent) * fontScaling) / upscaling;
+				glyph.width = float(bitmapWidth) / upscaling;
+				glyph.height = float(bitmapHeight) / upscaling;
+				glyph.advance = glyph.width;
+			}
+
+			if (bitmapWidth + borderPadding * 2 > ATLAS_WIDTH || bitmapHeight + borderPadding * 2 > ATLAS_MAX_HEIGHT)
+			{
+				// The glyph is still laid out, but it's not drawn:
+				assert(0 && "The glyph won't fit into the atlas!");
+				bitmapWidth = 0;
+				bitmapHeight = 0;
+				glyph.width = 0;
+				glyph.height = 0;
+			}
+
+			// Add padding to the rectangle that will be placed in the atlas:
+			rect_xywh rect(0, 0, bitmapWidth + borderPadding * 2, bitmapHeight + borderPadding * 2);
+			if (!AllocateAtlasRect(rect))
+			{
+				// The atlas is full, the glyphs that are no longer used are dropped by starting a new one
+				//	(glyphs that were added before by this update are dropped too, and they become pending again when they are drawn):
+				ResetAtlas();
+				added.clear();
+				AllocateAtlasRect(rect);
+			}
+
+			// Remove border padding from the rectangle (we don't want to touch the border, it should stay transparent):
+			rect.x += borderPadding;
+			rect.y += borderPadding;
+			rect.w -= borderPadding * 2;
+			rect.h -= borderPadding * 2;
+
+			// Grow the CPU-side atlas, the existing rows stay where they are:
+			if (rect.y + rect.h > atlasHeight)
+			{
+				atlasHeight = std::max(atlasHeight, 64);
+				while (rect.y + rect.h > atlasHeight)
+				{
+					atlasHeight *= 2;
+				}
+				atlasHeight = std::min(atlasHeight, ATLAS_MAX_HEIGHT);
+				atlasBitmap.resize(size_t(ATLAS_WIDTH) * size_t(atlasHeight), 0);
+			}
+
+			// Render the glyph inside the CPU-side atlas:
+			uint8_t* dst = atlasBitmap.data() + rect.x + size_t(rect.y) * ATLAS_WIDTH;
+			if (sdf)
+			{
+				for (int y = 0; y < rect.h; ++y)
+				{
+					std::memcpy(dst + size_t(y) * ATLAS_WIDTH, sdfBitmap + size_t(y) * rect.w, size_t(rect.w));
+				}
+				stbtt_FreeSDF(sdfBitmap, fontStyle.fontInfo.userdata);
+			}
+			else
+			{
+				stbtt_MakeCodepointBitmap(&fontStyle.fontInfo, dst, rect.w, rect.h, ATLAS_WIDTH, fontScaling, fontScaling, code);
+			}
+
+			glyph_lookup[hash] = glyph;
+			rect_lookup[hash] = rect;
+			added.push_back(hash);
 		}
 		pendingGlyphs.clear();
 
-		// This reference array will be used for packing:
-		std::vector<rect_xywh*> out_rects;
-		out_rects.reserve(rect_lookup.size());
-		for (auto& it : rect_lookup)
+		// Texture coordinates are relative to the atlas height, so all of them change if the atlas grew:
+		if (texcoordHeight != atlasHeight)
 		{
-			out_rects.push_back(&it.second);
+			texcoordHeight = atlasHeight;
+			for (auto& it : rect_lookup)
+			{
+				UpdateTexCoords(glyph_lookup[it.first], it.second);
+			}
 		}
-
-		// Perform packing and process the result if successful:
-		std::vector<bin> bins;
-		if (pack(out_rects.data(), (int)out_rects.size(), 4096, bins))
+		else
 		{
-			assert(bins.size() == 1 && "The regions won't fit into one texture!");
-
-			// Retrieve texture atlas dimensions:
-			const int bitmapWidth = bins[0].size.w;
-			const int bitmapHeight = bins[0].size.h;
-			const float inv_width = 1.0f / bitmapWidth;
-			const float inv_height = 1.0f / bitmapHeight;
-
-			// Create the CPU-side texture atlas and fill with transparency (0):
-			std::vector<uint8_t> bitmap(size_t(bitmapWidth) * size_t(bitmapHeight));
-			std::fill(bitmap.begin(), bitmap.end(), 0);
-
-			// Iterate all packed glyph rectangles:
-			for (auto it : rect_lookup)
+			for (int32_t hash : added)
 			{
-				const int32_t hash = it.first;
-				const wchar_t code = codefromhash(hash);
-				const int style = stylefromhash(hash);
-				const float height = (float)heightfromhash(hash) * upscaling;
-				const wiFontStyle& fontStyle = fontStyles[style];
-				rect_xywh& rect = it.second;
-				Glyph& glyph = glyph_lookup[hash];
-
-				// Remove border padding from the packed rectangle (we don't want to touch the border, it should stay transparent):
-				rect.x += borderPadding;
-				rect.y += borderPadding;
-				rect.w -= borderPadding * 2;
-				rect.h -= borderPadding * 2;
-
-				float fontScaling = stbtt_ScaleForPixelHeight(&fontStyle.fontInfo, height);
-
-				// Render the glyph inside the CPU-side atlas:
-				int byteOffset = rect.x + (rect.y * bitmapWidth);
-				stbtt_MakeCodepointBitmap(&fontStyle.fontInfo, bitmap.data() + byteOffset, rect.w, rect.h, bitmapWidth, fontScaling, fontScaling, code);
-
-				// Compute texture coordinates for the glyph:
-				float tc_left = float(rect.x);
-				float tc_right = tc_left + float(rect.w);
-				float tc_top = float(rect.y);
-				float tc_bottom = tc_top + float(rect.h);
-
-				tc_left *= inv_width;
-				tc_right *= inv_width;
-				tc_top *= inv_height;
-				tc_bottom *= inv_height;
-
-				glyph.tc_left = XMConvertFloatToHalf(tc_left);
-				glyph.tc_right = XMConvertFloatToHalf(tc_right);
-				glyph.tc_top = XMConvertFloatToHalf(tc_top);
-				glyph.tc_bottom = XMConvertFloatToHalf(tc_bottom);
+				UpdateTexCoords(glyph_lookup[hash], rect_lookup[hash]);
 			}
+		}
 
-			// Upload the CPU-side texture atlas bitmap to the GPU:
-			wiTextureHelper::CreateTexture(texture, bitmap.data(), bitmapWidth, bitmapHeight, FORMAT_R8_UNORM);
+		// Upload the CPU-side texture atlas bitmap to the GPU:
+		if (atlasHeight > 0)
+		{
+			wiTextureHelper::CreateTexture(texture, atlasBitmap.data(), ATLAS_WIDTH, atlasHeight, FORMAT_R8_UNORM);
 		}
+		atlasVersion.fetch_add(1);
 	}
 
 	glyphLock.unlock();
 }
+void SetSDFRendering(bool value)
+{
+	if (sdfRendering.exchange(value) != value)
+	{
+		glyphLock.lock();
+		ResetAtlas();
+		pendingGlyphs.clear();
+		glyphLock.unlock();
+	}
+}
+bool IsSDFRendering()
+{
+	return sdfRendering.load();
+}
 const Texture* GetAtlas()
 {
 	return &texture;
@@ -506,13 +639,16 @@ float textWidth_internal(const T* text, const wiFontParams& params)
 		return 0;
 	}
 
+	const int rasterHeight = GetRasterHeight(params, sdfRendering.load());
+	const float sizeScaling = float(params.size) / float(rasterHeight);
+
 	float maxWidth = 0;
 	float currentLineWidth = 0;
 	size_t i = 0;
 	while (text[i] != 0)
 	{
 		int code = (int)text[i++];
-		const int32_t hash = glyphhash(code, params.style, params.size);
+		const int32_t hash = glyphhash(code, params.style, rasterHeight);
 
 		if (glyph_lookup.count(hash) == 0)
 		{
@@ -535,7 +671,7 @@ float textWidth_internal(const T* text, const wiFontParams& params)
 		else
 		{
 			const Glyph& glyph = glyph_lookup.at(hash);
-			currentLineWidth += glyph.width + float(params.spacingX) * params.scaling;
+			currentLineWidth += glyph.advance * sizeScaling + float(params.spacingX) * params.scaling;
 		}
 		maxWidth = std::max(maxWidth, currentLineWidth);
 	}
@@ -565,6 +701,119 @@ float textHeight_internal(const T* text, const wiFontParams& params)
 	return height;
 }
 
+// Offset of the aligned text from its position
+template<typename T>
+void GetAlignmentOffset(const T* text, const wiFontParams& params, float& offsetX, float& offsetY)
+{
+	offsetX = 0;
+	offsetY = 0;
+	if (params.h_align == WIFALIGN_CENTER)
+		offsetX -= textWidth_internal(text, params) / 2;
+	else if (params.h_align == WIFALIGN_RIGHT)
+		offsetX -= textWidth_internal(text, params);
+	if (params.v_align == WIFALIGN_CENTER)
+		offsetY -= textHeight_internal(text, params) / 2;
+	else if (params.v_align == WIFALIGN_BOTTOM)
+		offsetY -= textHeight_internal(text, params);
+}
+
+// Draws the glyph quads from a buffer at the text position
+void Draw_quads(const GPUBuffer* buffer, uint32_t offset, uint32_t quadCount, float posX, float posY, const wiFontParams& params, CommandList cmd)
+{
+	GraphicsDevice* device = wiRenderer::GetDevice();
+
+	// The text must be on top of the batched images before it:
+	wiImage::FlushBatch(cmd);
+
+	device->EventBegin("Font", cmd);
+
+	device->BindPipelineState(&PSO, cmd);
+
+	device->BindConstantBuffer(VS, &constantBuffer, CB_GETBINDSLOT(FontCB), cmd);
+	device->BindConstantBuffer(PS, &constantBuffer, CB_GETBINDSLOT(FontCB), cmd);
+
+	FontCB cb;
+	cb.g_xFont_BufferOffset = offset;
+	cb.g_xFont_SDF = sdfRendering.load() ? 1 : 0;
+
+	if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS))
+	{
+		cb.g_xFont_TextureIndex = device->GetDescriptorIndex(&texture, SRV);
+	}
+	else
+	{
+	device->BindResource(PS, &texture, TEXSLOT_FONTATLAS, cmd);
+	}
+
+	device->BindResource(VS, buffer, 0, cmd);
+
+	const wiCanvas& canvas = canvases[cmd];
+	// Asserts will check that a proper canvas was set for this cmd with wiImage::SetCanvas()
+	//	The canvas must be set to have dpi aware rendering
+	assert(canvas.width > 0);
+	assert(canvas.height > 0);
+	assert(canvas.dpi > 0);
+	const XMMATRIX Projection = canvas.GetProjection();
+
+	if (params.shadowColor.getA() > 0)
+	{
+		// font shadow render:
+		XMStoreFloat4x4(&cb.g_xFont_Transform,
+			XMMatrixTranslation(posX + 1, posY + 1, 0)
+			* Projection
+		);
+		cb.g_xFont_Color = params.shadowColor.toFloat4();
+		device->UpdateBuffer(&constantBuffer, &cb, cmd);
+
+		device->DrawInstanced(4, quadCount, 0, 0, cmd);
+	}
+
+	// font base render:
+	XMStoreFloat4x4(&cb.g_xFont_Transform,
+		XMMatrixTranslation(posX, posY, 0)
+		* Projection
+	);
+	cb.g_xFont_Color = params.color.toFloat4();
+	device->UpdateBuffer(&constantBuffer, &cb, cmd);
+
+	device->DrawInstanced(4, quadCount, 0, 0, cmd);
+
+	device->EventEnd(cmd);
+}
+
+// Hash the text draw into the record of wiImage, and add its bounds
+template<typename T>
+void Record(wiImage::DrawRecord& record, const T* text, size_t text_length, const wiFontParams& params)
+{
+	record.Hash(text, sizeof(T) * text_length);
+	record.Hash(&params.posX, sizeof(params.posX));
+	record.Hash(&params.posY, sizeof(params.posY));
+	record.Hash(&params.size, sizeof(params.size));
+	record.Hash(&params.scaling, sizeof(params.scaling));
+	record.Hash(&params.spacingX, sizeof(params.spacingX));
+	record.Hash(&params.spacingY, sizeof(params.spacingY));
+	record.Hash(&params.h_align, sizeof(params.h_align));
+	record.Hash(&params.v_align, sizeof(params.v_align));
+	record.Hash(&params.color, sizeof(params.color));
+	record.Hash(&params.shadowColor, sizeof(params.shadowColor));
+	record.Hash(&params.h_wrap, sizeof(params.h_wrap));
+	record.Hash(&params.style, sizeof(params.style));
+	record.Hash(&record.clip, sizeof(record.clip));
+	// The glyphs that were missing from the atlas are drawn after it changed:
+	const uint64_t version = atlasVersion.load();
+	record.Hash(&version, sizeof(version));
+
+	float offsetX, offsetY;
+	GetAlignmentOffset(text, params, offsetX, offsetY);
+	const float left = params.posX + offsetX;
+	const float top = params.posY + offsetY;
+	// The glyphs can reach out of the line, and the shadow is offset:
+	const float margin = float(params.size) * params.scaling + 1;
+	const float right = left + textWidth_internal(text, params);
+	const float bottom = params.h_wrap >= 0 ? FLT_MAX : top + textHeight_internal(text, params); // the wrapped lines are not measured
+	record.AddBounds(left - margin, top - margin, right + margin, bottom + margin);
+}
+
 template<typename T>
 void Draw_internal(const T* text, size_t text_length, const wiFontParams& params, CommandList cmd)
 {
@@ -573,16 +822,15 @@ void Draw_internal(const T* text, size_t text_length, const wiFontParams& params
 		return;
 	}
 
-	wiFontParams newProps = params;
+	wiImage::DrawRecord* record = wiImage::GetRecord(cmd);
+	if (record != nullptr)
+	{
+		Record(*record, text, text_length, params);
+		return;
+	}
 
-	if (params.h_align == WIFALIGN_CENTER)
-		newProps.posX -= textWidth_internal(text, newProps) / 2;
-	else if (params.h_align == WIFALIGN_RIGHT)
-		newProps.posX -= textWidth_internal(text, newProps);
-	if (params.v_align == WIFALIGN_CENTER)
-		newProps.posY -= textHeight_internal(text, newProps) / 2;
-	else if (params.v_align == WIFALIGN_BOTTOM)
-		newProps.posY -= textHeight_internal(text, newProps);
+	float offsetX, offsetY;
+	GetAlignmentOffset(text, params, offsetX, offsetY);
 
 	GraphicsDevice* device = wiRenderer::GetDevice();
 
@@ -592,63 +840,87 @@ void Draw_internal(const T* text, size_t text_length, const wiFontParams& params
 		return;
 	}
 	volatile FontVertex* textBuffer = (volatile FontVertex*)mem.data;
-	const uint32_t quadCount = WriteVertices(textBuffer, text, newProps);
+	const uint32_t quadCount = WriteVertices(textBuffer, text, params);
 
 	if (quadCount > 0)
 	{
-		device->EventBegin("Font", cmd);
+		Draw_quads(mem.buffer, mem.offset, quadCount, params.posX + offsetX, params.posY + offsetY, params, cmd);
+	}
 
-		device->BindPipelineState(&PSO, cmd);
+	UpdatePendingGlyphs();
+}
 
-		device->BindConstantBuffer(VS, &constantBuffer, CB_GETBINDSLOT(FontCB), cmd);
-		device->BindConstantBuffer(PS, &constantBuffer, CB_GETBINDSLOT(FontCB), cmd);
+template<typename T>
+void Draw_cached(TextCache& cache, const T* text, size_t text_length, const wiFontParams& params, CommandList cmd)
+{
+	if (!initialized.load())
+	{
+		return;
+	}
 
-		FontCB cb;
-		cb.g_xFont_BufferOffset = mem.offset;
+	wiImage::DrawRecord* record = wiImage::GetRecord(cmd);
+	if (record != nullptr)
+	{
+		Record(*record, text, text_length, params);
+		return;
+	}
 
-		if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS))
-		{
-			cb.g_xFont_TextureIndex = device->GetDescriptorIndex(&texture, SRV);
-		}
-		else
+	bool current =
+		cache.atlasVersion == atlasVersion.load() &&
+		cache.text.size() == text_length &&
+		cache.params.size == params.size &&
+		cache.params.scaling == params.scaling &&
+		cache.params.spacingX == params.spacingX &&
+		cache.params.spacingY == params.spacingY &&
+		cache.params.h_wrap == params.h_wrap &&
+		cache.params.style == params.style &&
+		cache.params.h_align == params.h_align &&
+		cache.params.v_align == params.v_align;
+	for (size_t i = 0; current && i < text_length; ++i)
+	{
+		current = cache.text[i] == (uint32_t)text[i];
+	}
+
+	if (!current)
+	{
+		// A changed text is only cached if it stays the same for the next draw too, so that a text that changes every frame doesn't create a buffer every frame:
+		cache.atlasVersion = atlasVersion.load(); // before the layout, so that the glyphs that it finds missing cause a new layout after they are packed
+		cache.text.resize(text_length);
+		for (size_t i = 0; i < text_length; ++i)
 		{
-		device->BindResource(PS, &texture, TEXSLOT_FONTATLAS, cmd);
+			cache.text[i] = (uint32_t)text[i];
 		}
+		cache.params = params;
+		cache.laidOut = false;
+		cache.quadCount = 0;
+		cache.vertexBuffer = {};
+		Draw_internal(text, text_length, params, cmd);
+		return;
+	}
 
-		device->BindResource(VS, mem.buffer, 0, cmd);
-
-		const wiCanvas& canvas = canvases[cmd];
-		// Asserts will check that a proper canvas was set for this cmd with wiImage::SetCanvas()
-		//	The canvas must be set to have dpi aware rendering
-		assert(canvas.width > 0);
-		assert(canvas.height > 0);
-		assert(canvas.dpi > 0);
-		const XMMATRIX Projection = canvas.GetProjection();
+	if (!cache.laidOut)
+	{
+		cache.laidOut = true;
+		GetAlignmentOffset(text, params, cache.offsetX, cache.offsetY);
 
-		if (newProps.shadowColor.getA() > 0)
+		std::vector<FontVertex> vertices(text_length * 4);
+		cache.quadCount = text_length > 0 ? WriteVertices(vertices.data(), text, params) : 0;
+		if (cache.quadCount > 0)
 		{
-			// font shadow render:
-			XMStoreFloat4x4(&cb.g_xFont_Transform,
-				XMMatrixTranslation((float)newProps.posX + 1, (float)newProps.posY + 1, 0)
-				* Projection
-			);
-			cb.g_xFont_Color = newProps.shadowColor.toFloat4();
-			device->UpdateBuffer(&constantBuffer, &cb, cmd);
-
-			device->DrawInstanced(4, quadCount, 0, 0, cmd);
+			GPUBufferDesc desc;
+			desc.ByteWidth = uint32_t(sizeof(FontVertex) * cache.quadCount * 4);
+			desc.Usage = USAGE_IMMUTABLE;
+			desc.BindFlags = BIND_SHADER_RESOURCE;
+			desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+			SubresourceData initdata;
+			initdata.pSysMem = vertices.data();
+			wiRenderer::GetDevice()->CreateBuffer(&desc, &initdata, &cache.vertexBuffer);
 		}
+	}
 
-		// font base render:
-		XMStoreFloat4x4(&cb.g_xFont_Transform,
-			XMMatrixTranslation((float)newProps.posX, (float)newProps.posY, 0)
-			* Projection
-		);
-		cb.g_xFont_Color = newProps.color.toFloat4();
-		device->UpdateBuffer(&constantBuffer, &cb, cmd);
-
-		device->DrawInstanced(4, quadCount, 0, 0, cmd);
-
-		device->EventEnd(cmd);
+	if (cache.quadCount > 0)
+	{
+		Draw_quads(&cache.vertexBuffer, 0, cache.quadCount, params.posX + cache.offsetX, params.posY + cache.offsetY, params, cmd);
 	}
 
 	UpdatePendingGlyphs();
@@ -686,6 +958,23 @@ void Draw(const std::wstring& text, const wiFontParams& params, CommandList cmd)
 	Draw_internal(text.c_str(), text.length(), params, cmd);
 }
 
+void Draw(TextCache& cache, const char* text, const wiFontParams& params, CommandList cmd)
+{
+	Draw_cached(cache, text, strlen(text), params, cmd);
+}
+void Draw(TextCache& cache, const wchar_t* text, const wiFontParams& params, CommandList cmd)
+{
+	Draw_cached(cache, text, wcslen(text), params, cmd);
+}
+void Draw(TextCache& cache, const std::string& text, const wiFontParams& params, CommandList cmd)
+{
+	Draw_cached(cache, text.c_str(), text.length(), params, cmd);
+}
+void Draw(TextCache& cache, const std::wstring& text, const wiFontParams& params, CommandList cmd)
+{
+	Draw_cached(cache, text.c_str(), text.length(), params, cmd);
+}
+
 float textWidth(const char* text, const wiFontParams& params)
 {
 	return textWidth_internal(text, params);
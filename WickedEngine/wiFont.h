@@ -5,6 +5,7 @@
 #include "wiCanvas.h"
 
 #include <string>
+#include <vector>
 
 // Do not alter order because it is bound to lua manually
 enum wiFontAlign
@@ -42,6 +43,12 @@ namespace wiFont
 
 	const wiGraphics::Texture* GetAtlas();
 
+	// Signed distance field rendering: every glyph is rasterized once as a distance field and scaled to every font size,
+	//	instead of being rasterized again for every size. The edges stay sharp when the text is scaled up (default: disabled)
+	//	Changing it clears the atlas, so set it before drawing text, not while text is drawn on other threads
+	void SetSDFRendering(bool value);
+	bool IsSDFRendering();
+
 	// Create a font from a file. It must be an existing .ttf file.
 	//	fontName : path to .ttf font
 	//	Returns fontStyleID that is reusable. If font already exists, just return its ID
@@ -64,6 +71,29 @@ namespace wiFont
 	void Draw(const std::string& text, const wiFontParams& params, wiGraphics::CommandList cmd);
 	void Draw(const std::wstring& text, const wiFontParams& params, wiGraphics::CommandList cmd);
 
+	// The glyph quads of a text that is laid out once and kept in a GPU buffer
+	//	It is laid out again only when the text, the layout parameters (size, scaling, spacing, wrap, style, alignment) or the font atlas changed,
+	//	the position and the colors of the params can change freely
+	//	A text that changes on every draw is drawn like without the cache, it's only laid out into the buffer when it stays the same
+	struct TextCache
+	{
+		std::vector<uint32_t> text; // character codes of the laid out text
+		wiFontParams params; // layout parameters of the laid out text
+		uint64_t atlasVersion = 0;
+		float offsetX = 0, offsetY = 0; // alignment offset from the text position
+		uint32_t quadCount = 0;
+		bool laidOut = false; // whether the vertexBuffer contains the text
+		wiGraphics::GPUBuffer vertexBuffer;
+
+		// Lay out again on the next draw
+		inline void Invalidate() { text.clear(); atlasVersion = 0; laidOut = false; }
+	};
+	// Draw a text with a cache, which must be used only for this text (it can change)
+	void Draw(TextCache& cache, const char* text, const wiFontParams& params, wiGraphics::CommandList cmd);
+	void Draw(TextCache& cache, const wchar_t* text, const wiFontParams& params, wiGraphics::CommandList cmd);
+	void Draw(TextCache& cache, const std::string& text, const wiFontParams& params, wiGraphics::CommandList cmd);
+	void Draw(TextCache& cache, const std::wstring& text, const wiFontParams& params, wiGraphics::CommandList cmd);
+
 	float textWidth(const char* text, const wiFontParams& params);
 	float textWidth(const wchar_t* text, const wiFontParams& params);
 	float textWidth(const std::string& text, const wiFontParams& params);
@@ -8,6 +8,12 @@
 #include "wiTextureHelper.h"
 #include "wiBackLog.h"
 #include "wiEvent.h"
+#include "wiTimer.h"
+
+#include <cstring>
+#include <algorithm>
+#include <numeric>
+#include <string>
 
 //#define BVH_VALIDATE // slow but great for debug!
 #ifdef BVH_VALIDATE
@@ -30,6 +36,211 @@ static GPUBuffer constantBuffer;
 
 static const int atlasWrapBorder = 1;
 
+struct wiGPUBVH::SAHTree
+{
+	uint32_t generation = 0;
+	uint32_t primitiveCount = 0;
+	std::vector<BVHPrimitive> primitives;
+	std::vector<BVHNode> nodes;
+	std::vector<uint32_t> parents;
+	std::vector<uint32_t> ids;
+	float buildTime = 0;
+	float cost = 0;
+	float lbvhCost = 0;
+};
+
+namespace wiGPUBVH_Internal
+{
+	struct Bounds
+	{
+		XMFLOAT3 min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		void Merge(const XMFLOAT3& p)
+		{
+			min = XMFLOAT3(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+			max = XMFLOAT3(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+		}
+		void Merge(const Bounds& b)
+		{
+			if (b.min.x > b.max.x)
+			{
+				return;
+			}
+			Merge(b.min);
+			Merge(b.max);
+		}
+		float Area() const
+		{
+			if (min.x > max.x)
+			{
+				return 0;
+			}
+			const float x = max.x - min.x;
+			const float y = max.y - min.y;
+			const float z = max.z - min.z;
+			return 2 * (x * y + y * z + z * x);
+		}
+	};
+	inline float GetAxis(const XMFLOAT3& p, int axis)
+	{
+		return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+	}
+}
+using namespace wiGPUBVH_Internal;
+
+// Builds the tree with binned SAH splits down to single primitive leaves, in the node layout of the GPU builder:
+	//	The internal nodes are [0, count - 1) with the root at 0, the leaf nodes are [count - 1, 2 * count - 1)
+	//	The leaf k refers to the primitive ids[k], the AABBs of the leaves are written by the AABB propagation on the GPU
+void wiGPUBVH::BuildSAH(SAHTree& tree)
+{
+	static constexpr int BIN_COUNT = 16;
+	const uint32_t count = tree.primitiveCount;
+	const uint32_t leafNodeOffset = count - 1;
+
+	std::vector<Bounds> boxes(count);
+	std::vector<XMFLOAT3> centers(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const BVHPrimitive& prim = tree.primitives[i];
+		boxes[i].Merge(XMFLOAT3(prim.x0, prim.y0, prim.z0));
+		boxes[i].Merge(XMFLOAT3(prim.x1, prim.y1, prim.z1));
+		boxes[i].Merge(XMFLOAT3(prim.x2, prim.y2, prim.z2));
+		centers[i] = XMFLOAT3(
+			(boxes[i].min.x + boxes[i].max.x) * 0.5f,
+			(boxes[i].min.y + boxes[i].max.y) * 0.5f,
+			(boxes[i].min.z + boxes[i].max.z) * 0.5f
+		);
+	}
+
+	std::vector<uint32_t> order(count);
+	std::iota(order.begin(), order.end(), 0);
+
+	tree.nodes.resize(count * 2 - 1);
+	tree.parents.resize(count * 2 - 1);
+	tree.ids.resize(count);
+	tree.parents[0] = 0;
+
+	struct Task
+	{
+		uint32_t node;
+		uint32_t begin;
+		uint32_t end;
+	};
+	std::vector<Task> stack;
+	stack.push_back({ 0, 0, count });
+	uint32_t internalCount = 1;
+	uint32_t leafCount = 0;
+	float area = 0;
+	float rootArea = 0;
+
+	while (!stack.empty())
+	{
+		const Task task = stack.back();
+		stack.pop_back();
+
+		Bounds bounds;
+		Bounds centerBounds;
+		for (uint32_t i = task.begin; i < task.end; ++i)
+		{
+			bounds.Merge(boxes[order[i]]);
+			centerBounds.Merge(centers[order[i]]);
+		}
+		if (task.node == 0)
+		{
+			rootArea = bounds.Area();
+		}
+		area += bounds.Area();
+
+		BVHNode& node = tree.nodes[task.node];
+		node.min = bounds.min;
+		node.max = bounds.max;
+
+		// The lowest cost split between the bins of the centers along every axis:
+		int bestAxis = -1;
+		int bestSplit = 0;
+		float bestCost = FLT_MAX;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float axisMin = GetAxis(centerBounds.min, axis);
+			const float extent = GetAxis(centerBounds.max, axis) - axisMin;
+			if (extent <= 0)
+			{
+				continue;
+			}
+			Bounds binBounds[BIN_COUNT];
+			uint32_t binCounts[BIN_COUNT] = {};
+			for (uint32_t i = task.begin; i < task.end; ++i)
+			{
+				const int bin = std::min(BIN_COUNT - 1, int((GetAxis(centers[order[i]], axis) - axisMin) / extent * BIN_COUNT));
+				binBounds[bin].Merge(boxes[order[i]]);
+				binCounts[bin]++;
+			}
+			float rightCosts[BIN_COUNT] = {};
+			Bounds right;
+			uint32_t rightCount = 0;
+			for (int bin = BIN_COUNT - 1; bin > 0; --bin)
+			{
+				right.Merge(binBounds[bin]);
+				rightCount += binCounts[bin];
+				rightCosts[bin] = right.Area() * rightCount;
+			}
+			Bounds left;
+			uint32_t leftCount = 0;
+			for (int bin = 0; bin < BIN_COUNT - 1; ++bin)
+			{
+				left.Merge(binBounds[bin]);
+				leftCount += binCounts[bin];
+				const float cost = left.Area() * leftCount + rightCosts[bin + 1];
+				if (leftCount > 0 && leftCount < task.end - task.begin && cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = bin;
+				}
+			}
+		}
+
+		uint32_t mid;
+		if (bestAxis >= 0)
+		{
+			const float axisMin = GetAxis(centerBounds.min, bestAxis);
+			const float extent = GetAxis(centerBounds.max, bestAxis) - axisMin;
+			mid = uint32_t(std::partition(order.begin() + task.begin, order.begin() + task.end, [&](uint32_t i) {
+				return std::min(BIN_COUNT - 1, int((GetAxis(centers[i], bestAxis) - axisMin) / extent * BIN_COUNT)) <= bestSplit;
+			}) - order.begin());
+		}
+		else
+		{
+			// All the centers are in the same place, they are split in half
+			mid = task.begin + (task.end - task.begin) / 2;
+		}
+
+		const uint32_t ranges[2][2] = { { task.begin, mid }, { mid, task.end } };
+		uint32_t children[2];
+		for (int i = 0; i < 2; ++i)
+		{
+			if (ranges[i][1] - ranges[i][0] == 1)
+			{
+				children[i] = leafNodeOffset + leafCount;
+				tree.ids[leafCount++] = order[ranges[i][0]];
+				tree.nodes[children[i]] = {};
+			}
+			else
+			{
+				children[i] = internalCount++;
+				stack.push_back({ children[i], ranges[i][0], ranges[i][1] });
+			}
+			tree.parents[children[i]] = task.node;
+		}
+		node.LeftChildIndex = children[0];
+		node.RightChildIndex = children[1];
+	}
+	assert(internalCount == count - 1 && leafCount == count);
+
+	tree.cost = rootArea > 0 ? area / rootArea : 0;
+}
+
 void wiGPUBVH::UpdateGlobalMaterialResources(const Scene& scene)
 {
 	GraphicsDevice* device = wiRenderer::GetDevice();
@@ -124,7 +335,8 @@ void wiGPUBVH::UpdateGlobalMaterialResources(const Scene& scene)
 		}
 	}
 
-	materialArray.clear();
+	std::vector<ShaderMaterial> materialArrayPrev;
+	std::swap(materialArray, materialArrayPrev);
 
 	// Pre-gather scene properties:
 	for (size_t i = 0; i < scene.objects.GetCount(); ++i)
@@ -197,6 +409,9 @@ void wiGPUBVH::UpdateGlobalMaterialResources(const Scene& scene)
 		}
 	}
 
+	materialsChanged = repackAtlas || materialArray.size() != materialArrayPrev.size() ||
+		std::memcmp(materialArray.data(), materialArrayPrev.data(), sizeof(ShaderMaterial) * materialArray.size()) != 0;
+
 	if (materialArray.empty())
 	{
 		return;
@@ -259,13 +474,14 @@ void wiGPUBVH::Update(const wiScene::Scene& scene)
 		{
 			const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
 
-			totalTriangles += (uint)mesh.indices.size() / 3;
+			totalTriangles += (uint)mesh.GetIndexCount() / 3;
 		}
 	}
 
 	if (totalTriangles > primitiveCapacity)
 	{
 		primitiveCapacity = std::max(2u, totalTriangles);
+		rebuild = true;
 
 		GPUBufferDesc desc;
 
@@ -341,9 +557,173 @@ void wiGPUBVH::Update(const wiScene::Scene& scene)
 	}
 
 	UpdateGlobalMaterialResources(scene);
+
+	// Change tracking, the updates are accumulated until the next Build():
+	if (objectStates.size() != scene.objects.GetCount())
+	{
+		objectStates.resize(scene.objects.GetCount());
+		rebuild = true;
+	}
+	objectUpdates.resize(objectStates.size());
+	for (size_t i = 0; i < scene.objects.GetCount(); ++i)
+	{
+		const ObjectComponent& object = scene.objects[i];
+
+		ObjectState state;
+		bool deformed = false;
+		if (object.meshID != INVALID_ENTITY)
+		{
+			const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
+			state.world = object.transform_index >= 0 ? scene.transforms[object.transform_index].world : IDENTITYMATRIX;
+			state.color = object.color;
+			state.geometry = mesh.vertexBuffer_POS.internal_state.get();
+			state.triangleCount = (uint32_t)mesh.GetIndexCount() / 3;
+			deformed = mesh.streamoutBuffer_POS.IsValid();
+		}
+
+		ObjectState& prev = objectStates[i];
+		if (prev.geometry != state.geometry || prev.triangleCount != state.triangleCount)
+		{
+			rebuild = true;
+		}
+		if (state.geometry != nullptr && (deformed || materialsChanged ||
+			std::memcmp(&prev.world, &state.world, sizeof(state.world)) != 0 ||
+			std::memcmp(&prev.color, &state.color, sizeof(state.color)) != 0))
+		{
+			objectUpdates[i] = 1;
+			refit = true;
+		}
+		prev = state;
+	}
+
+	if (!rebuild && refit && ++refitCount >= REBUILD_INTERVAL)
+	{
+		rebuild = true;
+	}
+	if (rebuild)
+	{
+		std::fill(objectUpdates.begin(), objectUpdates.end(), 1);
+		refitCount = 0;
+	}
+
+	// SAH builder:
+	if (builder == BUILDER_SAH && primitiveReadback.GetDesc().ByteWidth != primitiveBuffer.GetDesc().ByteWidth)
+	{
+		GPUBufferDesc desc = primitiveBuffer.GetDesc();
+		desc.Usage = USAGE_STAGING;
+		desc.CPUAccessFlags = CPU_ACCESS_READ;
+		desc.BindFlags = 0;
+		desc.MiscFlags = 0;
+		device->CreateBuffer(&desc, nullptr, &primitiveReadback);
+		device->SetName(&primitiveReadback, "primitiveReadback");
+
+		desc = bvhNodeBuffer.GetDesc();
+		desc.Usage = USAGE_STAGING;
+		desc.CPUAccessFlags = CPU_ACCESS_READ;
+		desc.BindFlags = 0;
+		desc.MiscFlags = 0;
+		device->CreateBuffer(&desc, nullptr, &nodeReadback);
+		device->SetName(&nodeReadback, "BVHNodeReadback");
+
+		readbackPending = false;
+	}
+	if (sahTree != nullptr && !wiJobSystem::IsBusy(sahContext))
+	{
+		if (sahTree->generation == generation && !rebuild && builder == BUILDER_SAH)
+		{
+			// The LBVH hierarchy is replaced, the AABBs are computed by the AABB propagation of the next Build(), like a refit:
+			SAHTree& tree = *sahTree;
+			tree.nodes.resize(primitiveCapacity * 2);
+			tree.parents.resize(primitiveCapacity * 2);
+			tree.ids.resize(primitiveCapacity);
+
+			SubresourceData data;
+			GPUBufferDesc desc = bvhNodeBuffer.GetDesc();
+			data.pSysMem = tree.nodes.data();
+			device->CreateBuffer(&desc, &data, &bvhNodeBuffer);
+			device->SetName(&bvhNodeBuffer, "BVHNodeBuffer");
+
+			desc = bvhParentBuffer.GetDesc();
+			data.pSysMem = tree.parents.data();
+			device->CreateBuffer(&desc, &data, &bvhParentBuffer);
+			device->SetName(&bvhParentBuffer, "BVHParentBuffer");
+
+			desc = primitiveIDBuffer.GetDesc();
+			data.pSysMem = tree.ids.data();
+			device->CreateBuffer(&desc, &data, &primitiveIDBuffer);
+			device->SetName(&primitiveIDBuffer, "primitiveIDBuffer");
+
+			refit = true;
+
+			sahStatistics.primitiveCount = tree.primitiveCount;
+			sahStatistics.buildTime = tree.buildTime;
+			sahStatistics.cost = tree.cost;
+			sahStatistics.lbvhCost = tree.lbvhCost;
+
+			wiBackLog::post(("BVH SAH build: " + std::to_string(tree.primitiveCount) + " triangles in " + std::to_string(tree.buildTime) +
+				" ms, cost: " + std::to_string(tree.cost) + " (LBVH: " + std::to_string(tree.lbvhCost) + ")").c_str());
+		}
+		sahTree.reset();
+	}
+	if (readbackPending && device->GetFrameCount() >= readbackFrame + GraphicsDevice::GetBufferCount())
+	{
+		readbackPending = false;
+		if (builder == BUILDER_SAH && !rebuild && sahTree == nullptr)
+		{
+			auto tree = std::make_shared<SAHTree>();
+			tree->generation = generation;
+			tree->primitiveCount = readbackCount;
+			tree->primitives.resize(readbackCount);
+
+			Mapping mapping;
+			mapping._flags = Mapping::FLAG_READ;
+			mapping.size = sizeof(BVHPrimitive) * readbackCount;
+			device->Map(&primitiveReadback, &mapping);
+			if (mapping.data != nullptr)
+			{
+				std::memcpy(tree->primitives.data(), mapping.data, mapping.size);
+
+				mapping.size = sizeof(BVHNode) * (readbackCount - 1);
+				device->Map(&nodeReadback, &mapping);
+				if (mapping.data != nullptr)
+				{
+					// The cost of the LBVH, with the same metric as the SAH builder:
+					const BVHNode* nodes = (const BVHNode*)mapping.data;
+					Bounds root;
+					root.Merge(nodes[0].min);
+					root.Merge(nodes[0].max);
+					float area = 0;
+					for (uint32_t i = 0; i < readbackCount - 1; ++i)
+					{
+						Bounds node;
+						node.Merge(nodes[i].min);
+						node.Merge(nodes[i].max);
+						area += node.Area();
+					}
+					tree->lbvhCost = root.Area() > 0 ? area / root.Area() : 0;
+				}
+				device->Unmap(&nodeReadback);
+
+				sahTree = tree;
+				wiJobSystem::Execute(sahContext, [tree](wiJobArgs args) {
+					wiTimer timer;
+					BuildSAH(*tree);
+					tree->buildTime = (float)timer.elapsed_milliseconds();
+					tree->primitives.clear();
+				});
+			}
+			device->Unmap(&primitiveReadback);
+		}
+	}
 }
 void wiGPUBVH::Build(const Scene& scene, CommandList cmd) const
 {
+	if (!rebuild && !refit)
+	{
+		// None of the objects changed since the last build
+		return;
+	}
+
 	GraphicsDevice* device = wiRenderer::GetDevice();
 
 	// Pre-gather scene properties:
@@ -356,11 +736,16 @@ void wiGPUBVH::Build(const Scene& scene, CommandList cmd) const
 		{
 			const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
 
-			totalTriangles += (uint)mesh.indices.size() / 3;
+			totalTriangles += (uint)mesh.GetIndexCount() / 3;
 		}
 	}
 
-	auto range = wiProfiler::BeginRangeGPU("BVH Rebuild", cmd);
+	auto range = wiProfiler::BeginRangeGPU(rebuild ? "BVH Rebuild" : "BVH Refit", cmd);
+
+	if (rebuild)
+	{
+		generation++;
+	}
 
 	if (repackAtlas)
 	{
@@ -369,7 +754,10 @@ void wiGPUBVH::Build(const Scene& scene, CommandList cmd) const
 			wiRenderer::CopyTexture2D(globalMaterialAtlas, -1, it.second.x + atlasWrapBorder, it.second.y + atlasWrapBorder, it.first->texture, 0, cmd, wiRenderer::BORDEREXPAND_WRAP);
 		}
 	}
-	device->UpdateBuffer(&globalMaterialBuffer, materialArray.data(), cmd, sizeof(ShaderMaterial) * (int)materialArray.size());
+	if (materialsChanged || rebuild)
+	{
+		device->UpdateBuffer(&globalMaterialBuffer, materialArray.data(), cmd, sizeof(ShaderMaterial) * (int)materialArray.size());
+	}
 
 	uint32_t primitiveCount = 0;
 	uint32_t materialCount = 0;
@@ -393,13 +781,22 @@ void wiGPUBVH::Build(const Scene& scene, CommandList cmd) const
 			{
 				const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
 
+				if (i < objectUpdates.size() && !objectUpdates[i])
+				{
+					// Its primitives are still in place from an earlier build
+					primitiveCount += (uint)mesh.GetIndexCount() / 3;
+					materialCount += (uint32_t)mesh.subsets.size();
+					continue;
+				}
+
 				BVHCB cb;
 				cb.xBVHWorld = object.transform_index >= 0 ? scene.transforms[object.transform_index].world : IDENTITYMATRIX;
 				cb.xBVHInstanceColor = object.color;
 				cb.xBVHMaterialOffset = materialCount;
 				cb.xBVHMeshTriangleOffset = primitiveCount;
-				cb.xBVHMeshTriangleCount = (uint)mesh.indices.size() / 3;
+				cb.xBVHMeshTriangleCount = (uint)mesh.GetIndexCount() / 3;
 				cb.xBVHMeshVertexPOSStride = sizeof(MeshComponent::Vertex_POS);
+				cb.xBVHRefit = rebuild ? 0 : 1;
 
 				device->UpdateBuffer(&constantBuffer, &cb, cmd);
 
@@ -433,36 +830,45 @@ void wiGPUBVH::Build(const Scene& scene, CommandList cmd) const
 	device->UpdateBuffer(&primitiveCounterBuffer, &primitiveCount, cmd);
 	device->EventEnd(cmd);
 
-	device->EventBegin("BVH - Sort Primitive Mortons", cmd);
-	wiGPUSortLib::Sort(primitiveCount, primitiveMortonBuffer, primitiveCounterBuffer, 0, primitiveIDBuffer, cmd);
-	device->EventEnd(cmd);
-
-	device->EventBegin("BVH - Build Hierarchy", cmd);
+	if (rebuild)
 	{
-		device->BindComputeShader(&computeShaders[CSTYPE_BVH_HIERARCHY], cmd);
-		const GPUResource* uavs[] = {
-			&bvhNodeBuffer,
-			&bvhParentBuffer,
-			&bvhFlagBuffer
-		};
-		device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
-
-		const GPUResource* res[] = {
-			&primitiveCounterBuffer,
-			&primitiveIDBuffer,
-			&primitiveMortonBuffer,
-		};
-		device->BindResources(CS, res, TEXSLOT_ONDEMAND0, arraysize(res), cmd);
+		device->EventBegin("BVH - Sort Primitive Mortons", cmd);
+		wiGPUSortLib::Sort(primitiveCount, primitiveMortonBuffer, primitiveCounterBuffer, 0, primitiveIDBuffer, cmd);
+		device->EventEnd(cmd);
 
-		device->Dispatch((primitiveCount + BVH_BUILDER_GROUPSIZE - 1) / BVH_BUILDER_GROUPSIZE, 1, 1, cmd);
-
-		GPUBarrier barriers[] = {
-			GPUBarrier::Memory()
-		};
-		device->Barrier(barriers, arraysize(barriers), cmd);
-		device->UnbindUAVs(0, arraysize(uavs), cmd);
+		device->EventBegin("BVH - Build Hierarchy", cmd);
+		{
+			device->BindComputeShader(&computeShaders[CSTYPE_BVH_HIERARCHY], cmd);
+			const GPUResource* uavs[] = {
+				&bvhNodeBuffer,
+				&bvhParentBuffer,
+				&bvhFlagBuffer
+			};
+			device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+			const GPUResource* res[] = {
+				&primitiveCounterBuffer,
+				&primitiveIDBuffer,
+				&primitiveMortonBuffer,
+			};
+			device->BindResources(CS, res, TEXSLOT_ONDEMAND0, arraysize(res), cmd);
+
+			device->Dispatch((primitiveCount + BVH_BUILDER_GROUPSIZE - 1) / BVH_BUILDER_GROUPSIZE, 1, 1, cmd);
+
+			GPUBarrier barriers[] = {
+				GPUBarrier::Memory()
+			};
+			device->Barrier(barriers, arraysize(barriers), cmd);
+			device->UnbindUAVs(0, arraysize(uavs), cmd);
+		}
+		device->EventEnd(cmd);
+	}
+	else if (primitiveCount > 1)
+	{
+		// Refit: the sorted primitive order and the hierarchy are kept, only the propagation flags are reset, which the hierarchy builder would do
+		std::vector<uint32_t> flags((primitiveCount - 1 + 31) / 32, 0);
+		device->UpdateBuffer(&bvhFlagBuffer, flags.data(), cmd, int(flags.size() * sizeof(uint32_t)));
 	}
-	device->EventEnd(cmd);
 
 	device->EventBegin("BVH - Propagate AABB", cmd);
 	{
@@ -495,6 +901,35 @@ void wiGPUBVH::Build(const Scene& scene, CommandList cmd) const
 
 	wiProfiler::EndRange(range); // BVH rebuild
 
+	if (rebuild && builder == BUILDER_SAH && primitiveCount > 1 && primitiveReadback.IsValid() && nodeReadback.IsValid())
+	{
+		// The primitives of the LBVH are copied for the SAH builder, they are read in Update() when the GPU finished with them:
+		{
+			GPUBarrier barriers[] = {
+				GPUBarrier::Buffer(&primitiveBuffer, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_COPY_SRC),
+				GPUBarrier::Buffer(&bvhNodeBuffer, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_COPY_SRC),
+			};
+			device->Barrier(barriers, arraysize(barriers), cmd);
+		}
+		device->CopyResource(&primitiveReadback, &primitiveBuffer, cmd);
+		device->CopyResource(&nodeReadback, &bvhNodeBuffer, cmd);
+		{
+			GPUBarrier barriers[] = {
+				GPUBarrier::Buffer(&primitiveBuffer, BUFFER_STATE_COPY_SRC, BUFFER_STATE_UNORDERED_ACCESS),
+				GPUBarrier::Buffer(&bvhNodeBuffer, BUFFER_STATE_COPY_SRC, BUFFER_STATE_UNORDERED_ACCESS),
+			};
+			device->Barrier(barriers, arraysize(barriers), cmd);
+		}
+
+		readbackPending = true;
+		readbackFrame = device->GetFrameCount();
+		readbackCount = primitiveCount;
+	}
+
+	std::fill(objectUpdates.begin(), objectUpdates.end(), 0);
+	rebuild = false;
+	refit = false;
+
 #ifdef BVH_VALIDATE
 	{
 		GPUBufferDesc readback_desc;
@@ -580,6 +1015,14 @@ void wiGPUBVH::Build(const Scene& scene, CommandList cmd) const
 	}
 #endif // BVH_VALIDATE
 
+}
+void wiGPUBVH::SetBuilder(BUILDER value)
+{
+	if (builder != value)
+	{
+		builder = value;
+		rebuild = true;
+	}
 }
 void wiGPUBVH::Bind(SHADERSTAGE stage, CommandList cmd) const
 {
@@ -599,6 +1042,13 @@ void wiGPUBVH::Bind(SHADERSTAGE stage, CommandList cmd) const
 void wiGPUBVH::Clear()
 {
 	primitiveCapacity = 0;
+	objectStates.clear();
+	objectUpdates.clear();
+	rebuild = true;
+	refit = false;
+	refitCount = 0;
+	readbackPending = false;
+	sahTree.reset();
 	materialArray.clear();
 	storedTextures.clear();
 	sceneTextures.clear();
@@ -5,13 +5,31 @@
 #include "wiRectPacker.h"
 #include "shaders/ShaderInterop_Renderer.h"
 #include "wiResourceManager.h"
+#include "wiJobSystem.h"
 
 #include <vector>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
 class wiGPUBVH
 {
+public:
+	enum BUILDER
+	{
+		BUILDER_LBVH,	// linear BVH from the sorted morton codes of the primitives, it is built on the GPU every time, fast to build but slower to trace
+		BUILDER_SAH,	// binned surface area heuristic, the LBVH is replaced by it when it is finished on the CPU in the background, for static content that is built once and traced many times
+	};
+
+	// The statistics of the last SAH build, the costs are the sum of the internal node surface areas relative to the root (lower is faster to trace)
+	struct SAHStatistics
+	{
+		uint32_t primitiveCount = 0;
+		float buildTime = 0; // milliseconds
+		float cost = 0;
+		float lbvhCost = 0; // the cost of the LBVH that it replaced
+	};
+
 private:
 	// Scene BVH intersection resources:
 	wiGraphics::GPUBuffer bvhNodeBuffer;
@@ -31,9 +49,52 @@ private:
 	std::unordered_map<std::shared_ptr<wiResource>, wiRectPacker::rect_xywh> storedTextures;
 	std::unordered_set<std::shared_ptr<wiResource>> sceneTextures;
 	bool repackAtlas = false;
+	bool materialsChanged = true;
 	void UpdateGlobalMaterialResources(const wiScene::Scene& scene);
 
+	// Change tracking of the objects, Update() compares them with the last frame:
+	//	Only the primitives of the changed objects are written again by Build()
+	//	If the objects have the same geometry as in the last build, the bounds of the tree are refitted, otherwise it is rebuilt
+	struct ObjectState
+	{
+		XMFLOAT4X4 world;
+		XMFLOAT4 color;
+		const void* geometry = nullptr; // the vertex buffer of the mesh
+		uint32_t triangleCount = 0;
+	};
+	std::vector<ObjectState> objectStates;
+	mutable std::vector<uint8_t> objectUpdates; // the objects whose primitives will be written by the next Build()
+	mutable bool rebuild = true;
+	mutable bool refit = false;
+	uint32_t refitCount = 0; // since the last rebuild
+
+	// SAH builder: after every rebuild the primitives are read back, and the tree is built from them by a job
+	//	The generation is incremented by every rebuild, a finished tree is only used if no rebuild happened since its primitives were read back
+	BUILDER builder = BUILDER_LBVH;
+	wiGraphics::GPUBuffer primitiveReadback;
+	wiGraphics::GPUBuffer nodeReadback;
+	mutable bool readbackPending = false;
+	mutable uint64_t readbackFrame = 0;
+	mutable uint32_t readbackCount = 0;
+	mutable uint32_t generation = 0;
+	struct SAHTree;
+	std::shared_ptr<SAHTree> sahTree;
+	static void BuildSAH(SAHTree& tree);
+	wiJobSystem::context sahContext;
+	SAHStatistics sahStatistics;
+
 public:
+	// The tree is rebuilt after this many consecutive refits, because its quality degrades as the objects move
+	static constexpr uint32_t REBUILD_INTERVAL = 64;
+
+	void SetBuilder(BUILDER value);
+	BUILDER GetBuilder() const { return builder; }
+	const SAHStatistics& GetSAHStatistics() const { return sahStatistics; }
+	// Returns true if the next Build() would do work, when it isn't needed, Build() returns immediately
+	bool IsBuildRequired() const { return rebuild || refit; }
+	// Returns true while an SAH tree is being built, Update() must be called every frame until it is finished, even if the scene didn't change
+	bool IsUpdatePending() const { return readbackPending || sahTree != nullptr; }
+
 	void Update(const wiScene::Scene& scene);
 	void Build(const wiScene::Scene& scene, wiGraphics::CommandList cmd) const;
 	void Bind(wiGraphics::SHADERSTAGE stage, wiGraphics::CommandList cmd) const;
@@ -4,6 +4,9 @@
 #include "shaders/ShaderInterop_GPUSortLib.h"
 #include "wiEvent.h"
 
+#include <mutex>
+#include <atomic>
+
 using namespace wiGraphics;
 
 namespace wiGPUSortLib
@@ -15,6 +18,26 @@ namespace wiGPUSortLib
 	static Shader sortInnerCS;
 	static Shader sortStepCS;
 
+	static GPUBuffer radixCB;
+	static GPUBuffer radixIndirectBuffer;
+	static Shader radixKickoffCS;
+	static Shader radixCountCS;
+	static Shader radixScanCS;
+	static Shader radixScatterCS;
+
+	// Temporary buffers of the radix sort, they are replaced by bigger ones when a bigger sort is recorded:
+	struct RadixBuffers
+	{
+		uint32_t capacity = 0;
+		GPUBuffer keys[2];
+		GPUBuffer values;
+		GPUBuffer histogram;
+	};
+	static RadixBuffers radixBuffers;
+	static std::mutex radixLocker;
+
+	static std::atomic<SORT_ALGORITHM> algorithm{ SORT_ALGORITHM_RADIX };
+
 
 	void LoadShaders()
 	{
@@ -25,6 +48,11 @@ namespace wiGPUSortLib
 		wiRenderer::LoadShader(CS, sortInnerCS, "gpusortlib_sortInnerCS.cso");
 		wiRenderer::LoadShader(CS, sortStepCS, "gpusortlib_sortStepCS.cso");
 
+		wiRenderer::LoadShader(CS, radixKickoffCS, "gpusortlib_radixKickoffCS.cso");
+		wiRenderer::LoadShader(CS, radixCountCS, "gpusortlib_radixCountCS.cso");
+		wiRenderer::LoadShader(CS, radixScanCS, "gpusortlib_radixScanCS.cso");
+		wiRenderer::LoadShader(CS, radixScatterCS, "gpusortlib_radixScatterCS.cso");
+
 	}
 
 	void Initialize()
@@ -38,6 +66,9 @@ namespace wiGPUSortLib
 		bd.ByteWidth = sizeof(SortConstants);
 		wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &sortCB);
 
+		bd.ByteWidth = sizeof(RadixSortConstants);
+		wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &radixCB);
+
 
 		bd.Usage = USAGE_DEFAULT;
 		bd.CPUAccessFlags = 0;
@@ -45,12 +76,22 @@ namespace wiGPUSortLib
 		bd.MiscFlags = RESOURCE_MISC_INDIRECT_ARGS | RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
 		bd.ByteWidth = sizeof(IndirectDispatchArgs);
 		wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &indirectBuffer);
+		wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &radixIndirectBuffer);
 
 		static wiEvent::Handle handle = wiEvent::Subscribe(SYSTEM_EVENT_RELOAD_SHADERS, [](uint64_t userdata) { LoadShaders(); });
 		LoadShaders();
 	}
 
 
+	void SetAlgorithm(SORT_ALGORITHM value)
+	{
+		algorithm.store(value);
+	}
+	SORT_ALGORITHM GetAlgorithm()
+	{
+		return algorithm.load();
+	}
+
 	void Sort(
 		uint32_t maxCount, 
 		const GPUBuffer& comparisonBuffer_read, 
@@ -58,6 +99,25 @@ namespace wiGPUSortLib
 		uint32_t counterReadOffset, 
 		const GPUBuffer& indexBuffer_write,
 		CommandList cmd)
+	{
+		// Up to 512 elements, the bitonic sort is only the kickoff and one sorting dispatch:
+		if (algorithm.load() == SORT_ALGORITHM_RADIX && maxCount > 512)
+		{
+			SortRadix(maxCount, comparisonBuffer_read, counterBuffer_read, counterReadOffset, indexBuffer_write, cmd);
+		}
+		else
+		{
+			SortBitonic(maxCount, comparisonBuffer_read, counterBuffer_read, counterReadOffset, indexBuffer_write, cmd);
+		}
+	}
+
+	void SortBitonic(
+		uint32_t maxCount, 
+		const GPUBuffer& comparisonBuffer_read, 
+		const GPUBuffer& counterBuffer_read, 
+		uint32_t counterReadOffset, 
+		const GPUBuffer& indexBuffer_write,
+		CommandList cmd)
 	{
 		GraphicsDevice* device = wiRenderer::GetDevice();
 
@@ -212,4 +272,170 @@ namespace wiGPUSortLib
 		device->EventEnd(cmd);
 	}
 
+	void SortRadix(
+		uint32_t maxCount,
+		const GPUBuffer& comparisonBuffer_read,
+		const GPUBuffer& counterBuffer_read,
+		uint32_t counterReadOffset,
+		const GPUBuffer& indexBuffer_write,
+		CommandList cmd)
+	{
+		if (maxCount == 0)
+		{
+			return;
+		}
+
+		GraphicsDevice* device = wiRenderer::GetDevice();
+
+		// The buffers are copied, so a bigger sort that is recorded on an other thread doesn't replace them during this one:
+		RadixBuffers buffers;
+		{
+			std::scoped_lock lock(radixLocker);
+			if (radixBuffers.capacity < maxCount)
+			{
+				const uint32_t blockCount = (maxCount + GPUSORTLIB_RADIX_BLOCK_SIZE - 1) / GPUSORTLIB_RADIX_BLOCK_SIZE;
+
+				GPUBufferDesc bd;
+				bd.Usage = USAGE_DEFAULT;
+				bd.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+				bd.MiscFlags = RESOURCE_MISC_BUFFER_STRUCTURED;
+				bd.StructureByteStride = sizeof(uint32_t);
+				bd.ByteWidth = bd.StructureByteStride * maxCount;
+				bool success = device->CreateBuffer(&bd, nullptr, &radixBuffers.keys[0]);
+				success &= device->CreateBuffer(&bd, nullptr, &radixBuffers.keys[1]);
+				success &= device->CreateBuffer(&bd, nullptr, &radixBuffers.values);
+				bd.ByteWidth = bd.StructureByteStride * blockCount * GPUSORTLIB_RADIX_BINS;
+				success &= device->CreateBuffer(&bd, nullptr, &radixBuffers.histogram);
+				device->SetName(&radixBuffers.keys[0], "GPUSortLib::radixKeys[0]");
+				device->SetName(&radixBuffers.keys[1], "GPUSortLib::radixKeys[1]");
+				device->SetName(&radixBuffers.values, "GPUSortLib::radixValues");
+				device->SetName(&radixBuffers.histogram, "GPUSortLib::radixHistogram");
+				radixBuffers.capacity = success ? maxCount : 0;
+			}
+			buffers = radixBuffers;
+		}
+		if (buffers.capacity == 0)
+		{
+			// Without the temporary buffers, the bitonic sort is still possible:
+			SortBitonic(maxCount, comparisonBuffer_read, counterBuffer_read, counterReadOffset, indexBuffer_write, cmd);
+			return;
+		}
+
+		device->EventBegin("GPUSortLib - Radix", cmd);
+
+		RadixSortConstants sc = {};
+		sc.radix_counterReadOffset = counterReadOffset;
+		sc.radix_maxCount = maxCount;
+		device->UpdateBuffer(&radixCB, &sc, cmd);
+		device->BindConstantBuffer(CS, &radixCB, CB_GETBINDSLOT(RadixSortConstants), cmd);
+
+		device->UnbindUAVs(0, 8, cmd);
+
+		// initialize the block count of the count and scatter dispatches:
+		{
+			device->BindComputeShader(&radixKickoffCS, cmd);
+
+			const GPUResource* res[] = {
+				&counterBuffer_read,
+			};
+			device->BindResources(CS, res, 0, arraysize(res), cmd);
+
+			const GPUResource* uavs[] = {
+				&radixIndirectBuffer,
+			};
+			device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+			{
+				GPUBarrier barriers[] = {
+					GPUBarrier::Buffer(&radixIndirectBuffer, BUFFER_STATE_INDIRECT_ARGUMENT, BUFFER_STATE_UNORDERED_ACCESS)
+				};
+				device->Barrier(barriers, arraysize(barriers), cmd);
+			}
+
+			device->Dispatch(1, 1, 1, cmd);
+
+			{
+				GPUBarrier barriers[] = {
+					GPUBarrier::Memory(),
+					GPUBarrier::Buffer(&radixIndirectBuffer, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_INDIRECT_ARGUMENT)
+				};
+				device->Barrier(barriers, arraysize(barriers), cmd);
+			}
+
+			device->UnbindUAVs(0, arraysize(uavs), cmd);
+		}
+
+		// Every pass sorts 8 bits, from the lowest ones. The keys and values are ping-ponged between the temporary buffers and the index buffer,
+		//	the first pass reads the keys from the comparison buffer, and the last one writes the values into the index buffer:
+		for (uint32_t pass = 0; pass < 32 / GPUSORTLIB_RADIX_BITS; ++pass)
+		{
+			const bool odd = (pass & 1) != 0;
+			const GPUBuffer& keys_read = buffers.keys[odd ? 0 : 1]; // unused by the first pass
+			const GPUBuffer& keys_write = buffers.keys[odd ? 1 : 0];
+			const GPUBuffer& values_read = odd ? buffers.values : indexBuffer_write;
+			const GPUBuffer& values_write = odd ? indexBuffer_write : buffers.values;
+
+			if (pass > 0)
+			{
+				sc.radix_shift = pass * GPUSORTLIB_RADIX_BITS;
+				device->UpdateBuffer(&radixCB, &sc, cmd);
+				device->BindConstantBuffer(CS, &radixCB, CB_GETBINDSLOT(RadixSortConstants), cmd);
+			}
+
+			const GPUResource* resources[] = {
+				&counterBuffer_read,
+				&comparisonBuffer_read,
+				&keys_read,
+				&values_read,
+				&buffers.histogram,
+			};
+
+			// count the digits of every block, then scan the histograms into the output offsets of every block:
+			device->BindResources(CS, resources, 0, 4, cmd);
+			{
+				const GPUResource* uavs[] = {
+					&buffers.histogram,
+				};
+				device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+				GPUBarrier barriers[] = {
+					GPUBarrier::Memory(),
+				};
+
+				device->BindComputeShader(&radixCountCS, cmd);
+				device->DispatchIndirect(&radixIndirectBuffer, 0, cmd);
+				device->Barrier(barriers, arraysize(barriers), cmd);
+
+				device->BindComputeShader(&radixScanCS, cmd);
+				device->Dispatch(1, 1, 1, cmd);
+				device->Barrier(barriers, arraysize(barriers), cmd);
+
+				device->UnbindUAVs(0, arraysize(uavs), cmd);
+			}
+
+			// write the elements to their offsets:
+			device->BindResources(CS, resources, 0, arraysize(resources), cmd);
+			{
+				const GPUResource* uavs[] = {
+					&keys_write,
+					&values_write,
+				};
+				device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+				device->BindComputeShader(&radixScatterCS, cmd);
+				device->DispatchIndirect(&radixIndirectBuffer, 0, cmd);
+
+				GPUBarrier barriers[] = {
+					GPUBarrier::Memory(),
+				};
+				device->Barrier(barriers, arraysize(barriers), cmd);
+
+				device->UnbindUAVs(0, arraysize(uavs), cmd);
+			}
+			device->UnbindResources(0, arraysize(resources), cmd);
+		}
+
+		device->EventEnd(cmd);
+	}
+
 }
@@ -4,7 +4,17 @@
 
 namespace wiGPUSortLib
 {
-	// Perform bitonic sort on a GPU dataset
+	enum SORT_ALGORITHM
+	{
+		SORT_ALGORITHM_RADIX,	// LSD radix sort in four 8 bit passes, stable, O(n)
+		SORT_ALGORITHM_BITONIC,	// O(n log^2 n), without temporary buffers
+	};
+	// The algorithm of Sort(), radix by default. Small datasets are always sorted with the bitonic sort, which is one dispatch for them
+	void SetAlgorithm(SORT_ALGORITHM value);
+	SORT_ALGORITHM GetAlgorithm();
+
+	// Perform sort on a GPU dataset, with the algorithm of SetAlgorithm()
+	//	The comparison values are floats, unsigned integers below 2^31 can be sorted by storing them as floats too (the bits are compared)
 	//	maxCount				-	Maximum size of the dataset. GPU count can be smaller (see: counterBuffer_read param)
 	//	comparisonBuffer_read	-	Buffer containing values to compare by (Read Only)
 	//	counterBuffer_read		-	Buffer containing count of values to sort (Read Only)
@@ -19,5 +29,25 @@ namespace wiGPUSortLib
 		wiGraphics::CommandList cmd
 	);
 
+	// The sort algorithms with the same parameters as Sort()
+	void SortBitonic(
+		uint32_t maxCount,
+		const wiGraphics::GPUBuffer& comparisonBuffer_read,
+		const wiGraphics::GPUBuffer& counterBuffer_read,
+		uint32_t counterReadOffset,
+		const wiGraphics::GPUBuffer& indexBuffer_write,
+		wiGraphics::CommandList cmd
+	);
+	//	The index buffer must be a structured buffer that can be bound as shader resource too
+	//	The temporary buffers are shared by all sorts, and they grow to the largest maxCount
+	void SortRadix(
+		uint32_t maxCount,
+		const wiGraphics::GPUBuffer& comparisonBuffer_read,
+		const wiGraphics::GPUBuffer& counterBuffer_read,
+		uint32_t counterReadOffset,
+		const wiGraphics::GPUBuffer& indexBuffer_write,
+		wiGraphics::CommandList cmd
+	);
+
 	void Initialize();
 };
@@ -1,10 +1,58 @@
 #include "wiGUI.h"
 #include "wiRenderer.h"
+#include "wiImage.h"
 #include "wiInput.h"
 #include "wiIntersect.h"
+#include "wiTextureHelper.h"
+
+#include <cmath>
 
 using namespace wiGraphics;
 
+namespace wiGUI_Internal
+{
+	inline bool IsEmpty(const Rect& rect)
+	{
+		return rect.left >= rect.right || rect.top >= rect.bottom;
+	}
+	inline bool Intersects(const Rect& a, const Rect& b)
+	{
+		return !IsEmpty(a) && !IsEmpty(b) && a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+	}
+	inline bool Contains(const Rect& a, const Rect& b)
+	{
+		return a.left <= b.left && a.top <= b.top && a.right >= b.right && a.bottom >= b.bottom;
+	}
+	inline void Merge(Rect& a, const Rect& b)
+	{
+		if (IsEmpty(b))
+		{
+			return;
+		}
+		if (IsEmpty(a))
+		{
+			a = b;
+			return;
+		}
+		a.left = std::min(a.left, b.left);
+		a.top = std::min(a.top, b.top);
+		a.right = std::max(a.right, b.right);
+		a.bottom = std::max(a.bottom, b.bottom);
+	}
+	// Logical canvas rect to physical scissor rect, the same way as wiWidget::ApplyScissor()
+	inline Rect ToScissor(const wiCanvas& canvas, const Rect& rect)
+	{
+		const float scale = canvas.GetDPIScaling();
+		Rect scissor;
+		scissor.left = int32_t((float)rect.left * scale);
+		scissor.top = int32_t((float)rect.top * scale);
+		scissor.right = int32_t((float)rect.right * scale);
+		scissor.bottom = int32_t((float)rect.bottom * scale);
+		return scissor;
+	}
+}
+using namespace wiGUI_Internal;
+
 void wiGUI::Update(const wiCanvas& canvas, float dt)
 {
 	if (!visible)
@@ -67,14 +115,38 @@ void wiGUI::Render(const wiCanvas& canvas, CommandList cmd) const
 	GraphicsDevice* device = wiRenderer::GetDevice();
 
 	device->EventBegin("GUI", cmd);
-	// Rendering is back to front:
-	for (auto it = widgets.rbegin(); it != widgets.rend(); ++it)
+	if (retained && layer.IsValid())
 	{
-		const wiWidget* widget = (*it);
+		wiImage::FlushBatch(cmd);
 		device->BindScissorRects(1, &scissorRect, cmd);
-		widget->Render(canvas, cmd);
+
+		// The background blur of the widgets is under the layer:
+		for (const Rect& rect : layerBackgrounds)
+		{
+			wiImageParams fx((float)rect.left, (float)rect.top, float(rect.right - rect.left), float(rect.bottom - rect.top), XMFLOAT4(0, 0, 0, 0));
+			fx.blendFlag = BLENDMODE_OPAQUE;
+			fx.enableBackground();
+			wiImage::Draw(wiTextureHelper::getWhite(), fx, cmd);
+		}
+
+		wiImageParams fx;
+		fx.enableFullScreen();
+		fx.blendFlag = BLENDMODE_PREMULTIPLIED;
+		wiImage::Draw(&layer, fx, cmd);
+	}
+	else
+	{
+		// Rendering is back to front:
+		for (auto it = widgets.rbegin(); it != widgets.rend(); ++it)
+		{
+			const wiWidget* widget = (*it);
+			wiImage::FlushBatch(cmd);
+			device->BindScissorRects(1, &scissorRect, cmd);
+			widget->Render(canvas, cmd);
+		}
 	}
 
+	wiImage::FlushBatch(cmd);
 	device->BindScissorRects(1, &scissorRect, cmd);
 	for (auto& x : widgets)
 	{
@@ -84,6 +156,174 @@ void wiGUI::Render(const wiCanvas& canvas, CommandList cmd) const
 	device->EventEnd(cmd);
 }
 
+void wiGUI::SetRetainedRendering(bool value)
+{
+	retained = value;
+	layerInvalid = true;
+	if (!retained)
+	{
+		layer = Texture();
+		layerRenderPass = RenderPass();
+		layerEntries.clear();
+		layerBackgrounds.clear();
+		entryBackgrounds.clear();
+	}
+}
+
+void wiGUI::RenderLayer(const wiCanvas& canvas, CommandList cmd) const
+{
+	if (!visible || !retained)
+	{
+		return;
+	}
+
+	GraphicsDevice* device = wiRenderer::GetDevice();
+
+	const uint32_t width = canvas.GetPhysicalWidth();
+	const uint32_t height = canvas.GetPhysicalHeight();
+	if (width == 0 || height == 0)
+	{
+		return;
+	}
+	if (!layer.IsValid() || layer.GetDesc().Width != width || layer.GetDesc().Height != height)
+	{
+		TextureDesc desc;
+		desc.BindFlags = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE;
+		desc.Format = FORMAT_R8G8B8A8_UNORM;
+		desc.Width = width;
+		desc.Height = height;
+		desc.layout = IMAGE_LAYOUT_SHADER_RESOURCE;
+		device->CreateTexture(&desc, nullptr, &layer);
+		device->SetName(&layer, "wiGUI::layer");
+
+		RenderPassDesc renderpassdesc;
+		renderpassdesc.attachments.push_back(RenderPassAttachment::RenderTarget(&layer, RenderPassAttachment::LOADOP_LOAD));
+		device->CreateRenderPass(&renderpassdesc, &layerRenderPass);
+
+		layerInvalid = true;
+	}
+
+	Rect full;
+	full.left = 0;
+	full.top = 0;
+	full.right = (int32_t)std::ceil(canvas.GetLogicalWidth());
+	full.bottom = (int32_t)std::ceil(canvas.GetLogicalHeight());
+
+	// Record the draws of every widget in rendering order (back to front), without rendering them:
+	recordedEntries.clear();
+	entryBackgrounds.resize(widgets.size());
+	for (size_t i = 0; i < widgets.size(); ++i)
+	{
+		const wiWidget* widget = widgets[widgets.size() - 1 - i];
+		record.Clear(full);
+		wiImage::SetRecord(&record, cmd);
+		widget->Render(canvas, cmd);
+		wiImage::SetRecord(nullptr, cmd);
+
+		LayerEntry& entry = recordedEntries.emplace_back();
+		entry.widget = widget;
+		entry.hash = record.hash;
+		entry.bounds = record.bounds;
+		entryBackgrounds[i].swap(record.backgrounds);
+	}
+
+	// The dirty region contains the old and the new bounds of the widgets that draw something different:
+	Rect damage = { 0, 0, 0, 0 };
+	if (layerInvalid || recordedEntries.size() != layerEntries.size())
+	{
+		damage = full;
+	}
+	else
+	{
+		for (size_t i = 0; i < recordedEntries.size(); ++i)
+		{
+			if (recordedEntries[i].widget != layerEntries[i].widget || recordedEntries[i].hash != layerEntries[i].hash)
+			{
+				Merge(damage, layerEntries[i].bounds);
+				Merge(damage, recordedEntries[i].bounds);
+			}
+		}
+	}
+	layerEntries.swap(recordedEntries);
+	layerInvalid = false;
+	if (IsEmpty(damage))
+	{
+		return;
+	}
+	// Extended by a unit, because the rounding to physical pixels can leave the edges partially covered:
+	damage.left = std::max(full.left, damage.left - 1);
+	damage.top = std::max(full.top, damage.top - 1);
+	damage.right = std::min(full.right, damage.right + 1);
+	damage.bottom = std::min(full.bottom, damage.bottom + 1);
+
+	// The background blur regions, without the ones that are inside an other one:
+	layerBackgrounds.clear();
+	for (auto& rects : entryBackgrounds)
+	{
+		for (const Rect& rect : rects)
+		{
+			bool contained = false;
+			for (auto it = layerBackgrounds.begin(); it != layerBackgrounds.end();)
+			{
+				if (Contains(*it, rect))
+				{
+					contained = true;
+					break;
+				}
+				if (Contains(rect, *it))
+				{
+					it = layerBackgrounds.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+			if (!contained)
+			{
+				layerBackgrounds.push_back(rect);
+			}
+		}
+	}
+
+	device->EventBegin("GUI Layer", cmd);
+	device->RenderPassBegin(&layerRenderPass, cmd);
+
+	Viewport vp;
+	vp.Width = (float)width;
+	vp.Height = (float)height;
+	device->BindViewports(1, &vp, cmd);
+
+	const Rect scissor = ToScissor(canvas, damage);
+	wiWidget::SetScissorLimit(&damage, cmd);
+	wiImage::SetLayerRendering(true, cmd);
+	wiImage::BeginBatch(cmd);
+
+	// Clear the dirty region to transparent:
+	device->BindScissorRects(1, &scissor, cmd);
+	wiImageParams fx((float)damage.left, (float)damage.top, float(damage.right - damage.left), float(damage.bottom - damage.top), XMFLOAT4(0, 0, 0, 0));
+	fx.blendFlag = BLENDMODE_OPAQUE;
+	wiImage::Draw(wiTextureHelper::getWhite(), fx, cmd);
+
+	// Only the widgets in the dirty region are rendered again, and they are clipped to it:
+	for (const LayerEntry& entry : layerEntries)
+	{
+		if (Intersects(entry.bounds, damage))
+		{
+			wiImage::FlushBatch(cmd);
+			device->BindScissorRects(1, &scissor, cmd);
+			entry.widget->Render(canvas, cmd);
+		}
+	}
+
+	wiImage::EndBatch(cmd);
+	wiImage::SetLayerRendering(false, cmd);
+	wiWidget::SetScissorLimit(nullptr, cmd);
+
+	device->RenderPassEnd(cmd);
+	device->EventEnd(cmd);
+}
+
 void wiGUI::AddWidget(wiWidget* widget)
 {
 	if (widget != nullptr)
@@ -3,6 +3,7 @@
 #include "wiGraphicsDevice.h"
 #include "wiCanvas.h"
 #include "wiWidget.h"
+#include "wiImage.h"
 
 #include <vector>
 
@@ -12,6 +13,23 @@ private:
 	std::vector<wiWidget*> widgets;
 	bool focus = false;
 	bool visible = true;
+
+	// Retained rendering:
+	struct LayerEntry
+	{
+		const wiWidget* widget = nullptr;
+		size_t hash = 0;
+		wiGraphics::Rect bounds = { 0, 0, 0, 0 };
+	};
+	bool retained = false;
+	mutable bool layerInvalid = true;
+	mutable wiGraphics::Texture layer;
+	mutable wiGraphics::RenderPass layerRenderPass;
+	mutable std::vector<LayerEntry> layerEntries; // the widgets in the layer, in rendering order
+	mutable std::vector<LayerEntry> recordedEntries;
+	mutable std::vector<wiGraphics::Rect> layerBackgrounds; // the regions of the layer that have background blur under them
+	mutable std::vector<std::vector<wiGraphics::Rect>> entryBackgrounds; // for each widget in the layer
+	mutable wiImage::DrawRecord record;
 public:
 
 	void Update(const wiCanvas& canvas, float dt);
@@ -26,5 +44,15 @@ public:
 
 	void SetVisible(bool value) { visible = value; }
 	bool IsVisible() { return visible; }
+
+	// Retained rendering: the widgets are rendered into a layer, which is composited by Render()
+	//	The draws of the widgets are recorded every frame (wiImage::DrawRecord), and only the regions of the widgets whose draws changed are rendered again
+	//	A texture of a widget that changes without being replaced must be reported with InvalidateLayer()
+	void SetRetainedRendering(bool value);
+	bool IsRetainedRendering() const { return retained; }
+	// Render the whole layer again on the next frame
+	void InvalidateLayer() { layerInvalid = true; }
+	// Render the changed regions of the layer. It must be called outside of render passes, before Render()
+	void RenderLayer(const wiCanvas& canvas, wiGraphics::CommandList cmd) const;
 };
 
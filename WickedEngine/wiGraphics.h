@@ -271,6 +271,7 @@ namespace wiGraphics
 		GPU_QUERY_TYPE_TIMESTAMP,			// retrieve time point of gpu execution
 		GPU_QUERY_TYPE_OCCLUSION,			// how many samples passed depth test?
 		GPU_QUERY_TYPE_OCCLUSION_BINARY,	// depth test passed or not?
+		GPU_QUERY_TYPE_PIPELINE_STATISTICS,	// how much work did the pipeline stages do? (needs GRAPHICSDEVICE_CAPABILITY_PIPELINE_STATISTICS)
 	};
 	enum INDEXBUFFER_FORMAT
 	{
@@ -355,6 +356,7 @@ namespace wiGraphics
 #ifdef GGREDUCED
 		RESOURCE_MISC_GEN_MIPMAPS = 1 << 7,
 #endif
+		RESOURCE_MISC_ALIASING_TEXTURE_NON_RT_DS = 1 << 8, // buffer: only memory is allocated, that textures without render target and depth stencil binding can be placed into
 	};
 	enum GRAPHICSDEVICE_CAPABILITY
 	{
@@ -371,6 +373,8 @@ namespace wiGraphics
 		GRAPHICSDEVICE_CAPABILITY_VARIABLE_RATE_SHADING_TIER2 = 1 << 10,
 		GRAPHICSDEVICE_CAPABILITY_MESH_SHADER = 1 << 11,
 		GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS = 1 << 12,
+		GRAPHICSDEVICE_CAPABILITY_RESOURCE_ALIASING = 1 << 13,
+		GRAPHICSDEVICE_CAPABILITY_PIPELINE_STATISTICS = 1 << 14,
 
 
 		// helper query for full raytracing support:
@@ -513,6 +517,38 @@ namespace wiGraphics
 		GPU_QUERY_TYPE type = GPU_QUERY_TYPE_TIMESTAMP;
 		uint32_t queryCount = 0;
 	};
+	// The result of a GPU_QUERY_TYPE_PIPELINE_STATISTICS query, the layout matches the DX11, DX12 and Vulkan results
+	struct PipelineStatistics
+	{
+		uint64_t IAVertices = 0;
+		uint64_t IAPrimitives = 0;
+		uint64_t VSInvocations = 0;
+		uint64_t GSInvocations = 0;
+		uint64_t GSPrimitives = 0;
+		uint64_t CInvocations = 0;	// primitives that were sent to the clipper
+		uint64_t CPrimitives = 0;	// primitives that were output by the clipper
+		uint64_t PSInvocations = 0;
+		uint64_t HSInvocations = 0;
+		uint64_t DSInvocations = 0;
+		uint64_t CSInvocations = 0;
+
+		inline PipelineStatistics& operator+=(const PipelineStatistics& other)
+		{
+			IAVertices += other.IAVertices;
+			IAPrimitives += other.IAPrimitives;
+			VSInvocations += other.VSInvocations;
+			GSInvocations += other.GSInvocations;
+			GSPrimitives += other.GSPrimitives;
+			CInvocations += other.CInvocations;
+			CPrimitives += other.CPrimitives;
+			PSInvocations += other.PSInvocations;
+			HSInvocations += other.HSInvocations;
+			DSInvocations += other.DSInvocations;
+			CSInvocations += other.CSInvocations;
+			return *this;
+		}
+	};
+	static_assert(sizeof(PipelineStatistics) == sizeof(uint64_t) * 11, "PipelineStatistics must match the layout of the API results");
 	struct PipelineStateDesc
 	{
 		const Shader*			vs = nullptr;
@@ -536,6 +572,7 @@ namespace wiGraphics
 			MEMORY_BARRIER,		// UAV accesses
 			IMAGE_BARRIER,		// image layout transition
 			BUFFER_BARRIER,		// buffer state transition
+			ALIASING_BARRIER,	// a different resource starts using the same memory, its contents are undefined
 		} type = MEMORY_BARRIER;
 
 		struct Memory
@@ -556,11 +593,17 @@ namespace wiGraphics
 			BUFFER_STATE state_before;
 			BUFFER_STATE state_after;
 		};
+		struct Aliasing
+		{
+			const GPUResource* resource_before;
+			const GPUResource* resource_after;
+		};
 		union
 		{
 			Memory memory;
 			Image image;
 			Buffer buffer;
+			Aliasing aliasing;
 		};
 
 		static GPUBarrier Memory(const GPUResource* resource = nullptr)
@@ -591,6 +634,15 @@ namespace wiGraphics
 			barrier.buffer.state_after = after;
 			return barrier;
 		}
+		// The after resource will be in its default layout, but the contents must be overwritten before reads
+		static GPUBarrier Aliasing(const GPUResource* before, const GPUResource* after)
+		{
+			GPUBarrier barrier;
+			barrier.type = ALIASING_BARRIER;
+			barrier.aliasing.resource_before = before;
+			barrier.aliasing.resource_after = after;
+			return barrier;
+		}
 	};
 	struct RenderPassAttachment
 	{
@@ -1,5 +1,8 @@
 #include "wiGraphicsDevice.h"
 #include "wiEvent.h"
+#include "wiHelper.h"
+
+#include <unordered_set>
 
 using namespace wiGraphics;
 
@@ -157,3 +160,408 @@ bool GraphicsDevice::IsFormatStencilSupport(FORMAT value) const
 
 	return false;
 }
+
+uint64_t GraphicsDevice::HashBytes(const void* data, size_t size, uint64_t seed)
+{
+	// FNV-1a, it must give the same result in every session, unlike std::hash which can be implementation defined
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+uint64_t GraphicsDevice::ComputePipelineStateKey(const PipelineStateDesc& desc) const
+{
+	uint64_t key = HashBytes(nullptr, 0);
+	auto hash = [&](uint64_t value) {
+		key = HashBytes(&value, sizeof(value), key);
+	};
+
+	const Shader* shaders[] = { desc.vs, desc.ps, desc.hs, desc.ds, desc.gs, desc.ms, desc.as };
+	for (const Shader* shader : shaders)
+	{
+		hash(shader == nullptr ? 0 : GetShaderHash(shader));
+	}
+
+	// The states are hashed by their members, because the padding bytes of the structures are undefined:
+	if (desc.bs != nullptr)
+	{
+		const BlendState& bs = *desc.bs;
+		hash(bs.AlphaToCoverageEnable);
+		hash(bs.IndependentBlendEnable);
+		for (const auto& rt : bs.RenderTarget)
+		{
+			hash(rt.BlendEnable);
+			hash(rt.SrcBlend);
+			hash(rt.DestBlend);
+			hash(rt.BlendOp);
+			hash(rt.SrcBlendAlpha);
+			hash(rt.DestBlendAlpha);
+			hash(rt.BlendOpAlpha);
+			hash(rt.RenderTargetWriteMask);
+		}
+	}
+	if (desc.rs != nullptr)
+	{
+		const RasterizerState& rs = *desc.rs;
+		hash(rs.FillMode);
+		hash(rs.CullMode);
+		hash(rs.FrontCounterClockwise);
+		hash((uint64_t)(int64_t)rs.DepthBias);
+		key = HashBytes(&rs.DepthBiasClamp, sizeof(rs.DepthBiasClamp), key);
+		key = HashBytes(&rs.SlopeScaledDepthBias, sizeof(rs.SlopeScaledDepthBias), key);
+		hash(rs.DepthClipEnable);
+		hash(rs.MultisampleEnable);
+		hash(rs.AntialiasedLineEnable);
+		hash(rs.ConservativeRasterizationEnable);
+		hash(rs.ForcedSampleCount);
+	}
+	if (desc.dss != nullptr)
+	{
+		const DepthStencilState& dss = *desc.dss;
+		hash(dss.DepthEnable);
+		hash(dss.DepthWriteMask);
+		hash(dss.DepthFunc);
+		hash(dss.StencilEnable);
+		hash(dss.StencilReadMask);
+		hash(dss.StencilWriteMask);
+		for (const auto& op : { dss.FrontFace, dss.BackFace })
+		{
+			hash(op.StencilFailOp);
+			hash(op.StencilDepthFailOp);
+			hash(op.StencilPassOp);
+			hash(op.StencilFunc);
+		}
+	}
+	if (desc.il != nullptr)
+	{
+		for (const auto& element : desc.il->elements)
+		{
+			key = HashBytes(element.SemanticName.c_str(), element.SemanticName.length(), key);
+			hash(element.SemanticIndex);
+			hash(element.Format);
+			hash(element.InputSlot);
+			hash(element.AlignedByteOffset);
+			hash(element.InputSlotClass);
+		}
+	}
+	hash(desc.pt);
+	hash(desc.sampleMask);
+
+	return key;
+}
+
+void GraphicsDevice::RegisterPrewarmPipelineState(uint64_t pso_key, const PipelineState* pso) const
+{
+	PipelineState copy;
+	copy.hash = pso->hash;
+	copy.desc = pso->desc;
+
+	std::scoped_lock lock(prewarm_locker);
+	prewarm_psos[pso_key] = std::make_pair(copy, std::weak_ptr<void>(pso->internal_state));
+}
+
+void GraphicsDevice::RegisterPrewarmRenderPass(const RenderPass* renderpass) const
+{
+	// Only the hash and the internal state are used to compile the pipelines, the attachment textures can be gone by then:
+	RenderPass copy;
+	copy.hash = renderpass->hash;
+
+	std::scoped_lock lock(prewarm_locker);
+	prewarm_renderpasses[renderpass->hash] = std::make_pair(copy, std::weak_ptr<void>(renderpass->internal_state));
+}
+
+void GraphicsDevice::RecordPrewarmPipeline(uint64_t pso_key, uint64_t renderpass_hash, uint64_t vertex_hash, const uint32_t* vertex_strides)
+{
+	PipelinePrewarmEntry entry;
+	entry.pso_key = pso_key;
+	entry.renderpass_hash = renderpass_hash;
+	entry.vertex_hash = vertex_hash;
+	if (vertex_strides != nullptr)
+	{
+		std::memcpy(entry.vertex_strides, vertex_strides, sizeof(entry.vertex_strides));
+	}
+
+	std::scoped_lock lock(prewarm_locker);
+	prewarm_list.push_back(entry);
+}
+
+static constexpr uint32_t PIPELINE_PREWARM_MAGIC = 0x57525057; // "WPRW"
+static constexpr uint32_t PIPELINE_PREWARM_VERSION = 1;
+
+bool GraphicsDevice::SavePipelinePrewarmList(const std::string& filename) const
+{
+	std::vector<uint8_t> data;
+	auto write = [&](const void* src, size_t size) {
+		data.insert(data.end(), (const uint8_t*)src, (const uint8_t*)src + size);
+	};
+
+	std::scoped_lock lock(prewarm_locker);
+
+	// The same combination can be compiled by multiple command lists in the same frame:
+	std::unordered_set<uint64_t> unique;
+	std::vector<const PipelinePrewarmEntry*> entries;
+	for (const auto& entry : prewarm_list)
+	{
+		const uint64_t hash = HashBytes(&entry, sizeof(entry));
+		if (unique.insert(hash).second)
+		{
+			entries.push_back(&entry);
+		}
+	}
+
+	const uint32_t count = (uint32_t)entries.size();
+	write(&PIPELINE_PREWARM_MAGIC, sizeof(PIPELINE_PREWARM_MAGIC));
+	write(&PIPELINE_PREWARM_VERSION, sizeof(PIPELINE_PREWARM_VERSION));
+	write(&count, sizeof(count));
+	for (const PipelinePrewarmEntry* entry : entries)
+	{
+		write(entry, sizeof(PipelinePrewarmEntry));
+	}
+
+	return wiHelper::FileWrite(filename, data.data(), data.size());
+}
+
+void GraphicsDevice::ClearPipelinePrewarmList()
+{
+	std::scoped_lock lock(prewarm_locker);
+	prewarm_list.clear();
+}
+
+bool GraphicsDevice::LoadPipelinePrewarmList(const std::string& filename, std::vector<PipelinePrewarmEntry>& entries)
+{
+	entries.clear();
+	std::vector<uint8_t> data;
+	if (!wiHelper::FileRead(filename, data))
+	{
+		return false;
+	}
+
+	const size_t header_size = sizeof(uint32_t) * 3;
+	if (data.size() < header_size)
+	{
+		return false;
+	}
+	uint32_t magic, version, count;
+	std::memcpy(&magic, data.data(), sizeof(magic));
+	std::memcpy(&version, data.data() + sizeof(uint32_t), sizeof(version));
+	std::memcpy(&count, data.data() + sizeof(uint32_t) * 2, sizeof(count));
+	if (magic != PIPELINE_PREWARM_MAGIC || version != PIPELINE_PREWARM_VERSION || data.size() < header_size + size_t(count) * sizeof(PipelinePrewarmEntry))
+	{
+		return false;
+	}
+
+	entries.resize(count);
+	std::memcpy(entries.data(), data.data() + header_size, size_t(count) * sizeof(PipelinePrewarmEntry));
+	return true;
+}
+
+bool GraphicsDevice::PrewarmPipeline(const PipelinePrewarmEntry& entry)
+{
+	PipelineState pso;
+	RenderPass renderpass;
+	{
+		std::scoped_lock lock(prewarm_locker);
+		auto it_pso = prewarm_psos.find(entry.pso_key);
+		auto it_renderpass = prewarm_renderpasses.find(entry.renderpass_hash);
+		if (it_pso == prewarm_psos.end() || it_renderpass == prewarm_renderpasses.end())
+		{
+			return false;
+		}
+		pso = it_pso->second.first;
+		pso.internal_state = it_pso->second.second.lock();
+		renderpass = it_renderpass->second.first;
+		renderpass.internal_state = it_renderpass->second.second.lock();
+	}
+	if (pso.internal_state == nullptr || renderpass.internal_state == nullptr)
+	{
+		return false;
+	}
+
+	return CompilePrewarmPipeline(&pso, &renderpass, entry);
+}
+
+uint32_t GraphicsDevice::PrewarmPipelines(const std::string& filename)
+{
+	std::vector<PipelinePrewarmEntry> entries;
+	if (!LoadPipelinePrewarmList(filename, entries))
+	{
+		return 0;
+	}
+
+	uint32_t compiled = 0;
+	for (const PipelinePrewarmEntry& entry : entries)
+	{
+		if (PrewarmPipeline(entry))
+		{
+			compiled++;
+		}
+	}
+	return compiled;
+}
+
+bool GraphicsDevice::ReadPipelineCacheFile(const std::string& filename, const PipelineCacheHeader& expected, std::vector<uint8_t>& data)
+{
+	data.clear();
+	std::vector<uint8_t> filedata;
+	if (!wiHelper::FileRead(filename, filedata) || filedata.size() < sizeof(PipelineCacheHeader))
+	{
+		return false;
+	}
+
+	PipelineCacheHeader header;
+	std::memcpy(&header, filedata.data(), sizeof(header));
+	if (header.magic != expected.magic ||
+		header.version != expected.version ||
+		header.vendorID != expected.vendorID ||
+		header.deviceID != expected.deviceID ||
+		header.driverVersion != expected.driverVersion ||
+		std::memcmp(header.uuid, expected.uuid, sizeof(header.uuid)) != 0 ||
+		header.dataSize != filedata.size() - sizeof(PipelineCacheHeader))
+	{
+		return false;
+	}
+
+	data.assign(filedata.begin() + sizeof(PipelineCacheHeader), filedata.end());
+	return true;
+}
+
+bool GraphicsDevice::WritePipelineCacheFile(const std::string& filename, PipelineCacheHeader header, const void* data, size_t size)
+{
+	header.dataSize = size;
+	std::vector<uint8_t> filedata(sizeof(PipelineCacheHeader) + size);
+	std::memcpy(filedata.data(), &header, sizeof(header));
+	if (size > 0)
+	{
+		std::memcpy(filedata.data() + sizeof(header), data, size);
+	}
+	return wiHelper::FileWrite(filename, filedata.data(), filedata.size());
+}
+
+uint64_t GraphicsDevice::ReadbackTexture(const Texture* texture, CommandList cmd, ReadbackCallback callback)
+{
+	Readback readback;
+	readback.desc = texture->GetDesc();
+	readback.desc.MipLevels = 1;
+	readback.callback = std::move(callback);
+
+	// The staging textures of the finished readbacks are reused for the same size and format:
+	readback_locker.lock();
+	for (size_t i = 0; i < readback_staging_pool.size(); ++i)
+	{
+		const TextureDesc& desc = readback_staging_pool[i].GetDesc();
+		if (desc.Width == readback.desc.Width && desc.Height == readback.desc.Height && desc.Format == readback.desc.Format)
+		{
+			readback.staging = std::move(readback_staging_pool[i]);
+			readback_staging_pool.erase(readback_staging_pool.begin() + i);
+			break;
+		}
+	}
+	readback_locker.unlock();
+
+	if (!readback.staging.IsValid())
+	{
+		TextureDesc staging_desc = readback.desc;
+		staging_desc.Usage = USAGE_STAGING;
+		staging_desc.CPUAccessFlags = CPU_ACCESS_READ;
+		staging_desc.BindFlags = 0;
+		staging_desc.MiscFlags = 0;
+		staging_desc.ArraySize = 1;
+		staging_desc.layout = IMAGE_LAYOUT_COPY_DST;
+		bool success = CreateTexture(&staging_desc, nullptr, &readback.staging);
+		assert(success);
+	}
+
+	if (readback.staging.IsValid())
+	{
+		{
+			GPUBarrier barriers[] = {
+				GPUBarrier::Image(texture, texture->desc.layout, IMAGE_LAYOUT_COPY_SRC, 0)
+			};
+			Barrier(barriers, arraysize(barriers), cmd);
+		}
+
+		CopyResource(&readback.staging, texture, cmd);
+
+		{
+			GPUBarrier barriers[] = {
+				GPUBarrier::Image(texture, IMAGE_LAYOUT_COPY_SRC, texture->desc.layout, 0)
+			};
+			Barrier(barriers, arraysize(barriers), cmd);
+		}
+	}
+
+	std::scoped_lock lock(readback_locker);
+	readback.ticket = readback_next_ticket++;
+	readback.frame = FRAMECOUNT;
+	const uint64_t ticket = readback.ticket;
+	readbacks.push_back(std::move(readback));
+	return ticket;
+}
+
+bool GraphicsDevice::IsReadbackFinished(uint64_t ticket)
+{
+	std::scoped_lock lock(readback_locker);
+	return ticket <= readback_finished_ticket;
+}
+
+void GraphicsDevice::ProcessReadbacks()
+{
+	while (true)
+	{
+		// The readbacks are finished in the order they were requested, because their frames are in the same order:
+		readback_locker.lock();
+		if (readbacks.empty() || readbacks.front().frame + BUFFERCOUNT > FRAMECOUNT)
+		{
+			readback_locker.unlock();
+			break;
+		}
+		Readback readback = std::move(readbacks.front());
+		readbacks.pop_front();
+		readback_locker.unlock();
+
+		std::vector<uint8_t> data;
+		if (readback.staging.IsValid())
+		{
+			const uint32_t data_stride = GetFormatStride(readback.desc.Format);
+			data.resize(size_t(readback.desc.Width) * size_t(readback.desc.Height) * size_t(data_stride));
+
+			Mapping mapping;
+			mapping._flags = Mapping::FLAG_READ;
+			mapping.size = data.size();
+			Map(&readback.staging, &mapping);
+			if (mapping.data != nullptr)
+			{
+				// Copy the padded texture row by row:
+				const size_t cpysize = size_t(readback.desc.Width) * size_t(data_stride);
+				const size_t rowpitch = mapping.rowpitch == 0 ? cpysize : size_t(mapping.rowpitch);
+				for (uint32_t i = 0; i < readback.desc.Height; ++i)
+				{
+					std::memcpy(data.data() + i * cpysize, (const uint8_t*)mapping.data + i * rowpitch, cpysize);
+				}
+				Unmap(&readback.staging);
+			}
+			else
+			{
+				data.clear();
+			}
+		}
+
+		if (readback.callback)
+		{
+			readback.callback(data, readback.desc);
+		}
+
+		readback_locker.lock();
+		if (readback.staging.IsValid() && readback_staging_pool.size() < BUFFERCOUNT * 2)
+		{
+			readback_staging_pool.push_back(std::move(readback.staging));
+		}
+		readback_finished_ticket = std::max(readback_finished_ticket, readback.ticket);
+		readback_locker.unlock();
+	}
+}
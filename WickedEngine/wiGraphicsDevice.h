@@ -4,6 +4,11 @@
 #include "wiPlatform.h"
 #include "wiEvent.h"
 
+#include <mutex>
+#include <unordered_map>
+#include <functional>
+#include <deque>
+
 namespace wiGraphics
 {
 	typedef uint8_t CommandList;
@@ -28,6 +33,16 @@ namespace wiGraphics
 		uint32_t back;
 	};
 
+	// Pipeline prewarm list entry, only made of keys that are valid across sessions
+	//	The pipeline state key includes the shader bytecodes, the blend, rasterizer and depth stencil states, the input layout and the primitive topology
+	struct PipelinePrewarmEntry
+	{
+		uint64_t pso_key = 0; // ComputePipelineStateKey()
+		uint64_t renderpass_hash = 0; // RenderPass::hash, made of the attachment formats
+		uint64_t vertex_hash = 0; // for the backends that compile the vertex strides into the pipeline
+		uint32_t vertex_strides[8] = {};
+	};
+
 	class GraphicsDevice
 	{
 	protected:
@@ -40,12 +55,68 @@ namespace wiGraphics
 		uint32_t VARIABLE_RATE_SHADING_TILE_SIZE = 0;
 		uint64_t TIMESTAMP_FREQUENCY = 0;
 
+		// Header of the pipeline cache files, a file is only accepted if it was written by the same adapter and driver
+		struct PipelineCacheHeader
+		{
+			uint32_t magic = 0;
+			uint32_t version = 0;
+			uint32_t vendorID = 0;
+			uint32_t deviceID = 0;
+			uint64_t driverVersion = 0;
+			uint8_t uuid[16] = {};
+			uint64_t dataSize = 0;
+		};
+		static bool ReadPipelineCacheFile(const std::string& filename, const PipelineCacheHeader& expected, std::vector<uint8_t>& data);
+		static bool WritePipelineCacheFile(const std::string& filename, PipelineCacheHeader header, const void* data, size_t size);
+
+		mutable std::mutex prewarm_locker;
+		std::vector<PipelinePrewarmEntry> prewarm_list;
+		// The objects that can be prewarmed, they are copied without their internal state, which is only referenced weakly:
+		mutable std::unordered_map<uint64_t, std::pair<PipelineState, std::weak_ptr<void>>> prewarm_psos;
+		mutable std::unordered_map<uint64_t, std::pair<RenderPass, std::weak_ptr<void>>> prewarm_renderpasses;
+
+		// Persistent key of a pipeline state, made of its states and the GetShaderHash() of its shaders
+		uint64_t ComputePipelineStateKey(const PipelineStateDesc& desc) const;
+		// Stable hash of the shader bytecode
+		virtual uint64_t GetShaderHash(const Shader* shader) const { return 0; }
+		static uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+		void RegisterPrewarmPipelineState(uint64_t pso_key, const PipelineState* pso) const;
+		void RegisterPrewarmRenderPass(const RenderPass* renderpass) const;
+		// Called when a pipeline was compiled for drawing
+		void RecordPrewarmPipeline(uint64_t pso_key, uint64_t renderpass_hash, uint64_t vertex_hash = 0, const uint32_t* vertex_strides = nullptr);
+		// Compile the pipeline of a combination if it wasn't yet, returns true if it was compiled
+		//	This can be called from any thread, the pipeline is added to the pipelines of the device at the next SubmitCommandLists()
+		virtual bool CompilePrewarmPipeline(const PipelineState* pso, const RenderPass* renderpass, const PipelinePrewarmEntry& entry) { return false; }
+
+	public:
+		// The callback of an asynchronous readback, data is the tightly packed texels of the first mip, empty if the copy couldn't be made
+		typedef std::function<void(std::vector<uint8_t>& data, const TextureDesc& desc)> ReadbackCallback;
+
+	protected:
+		struct Readback
+		{
+			uint64_t ticket = 0;
+			uint64_t frame = 0; // the GPU has finished the copy when this frame is GetBufferCount() frames old
+			Texture staging;
+			TextureDesc desc;
+			ReadbackCallback callback;
+		};
+		std::mutex readback_locker;
+		std::deque<Readback> readbacks;
+		std::vector<Texture> readback_staging_pool;
+		uint64_t readback_next_ticket = 1;
+		uint64_t readback_finished_ticket = 0;
+		// Called at the end of SubmitCommandLists() by the backends, calls the callbacks of the readbacks that the GPU has finished
+		void ProcessReadbacks();
+
 	public:
 
 #ifdef GGREDUCED
 		virtual void* GetDeviceForIMGUI(void) = 0;
 		virtual void* GetImmediateForIMGUI(void) = 0;
 		virtual void* GetDeviceContext(int cmd) = 0;
+		// Calls func with the native device context of the command list, in the order of the other commands of the command list
+		virtual void ExecuteNativeCommands(CommandList cmd, const std::function<void(void* context)>& func) { func(GetDeviceContext(cmd)); }
 		virtual void SetScissorArea(int cmd, const XMFLOAT4 area) = 0;
 		virtual void SetRenderTarget(CommandList cmd, void* renderTarget) = 0;
 		virtual void* MaterialGetSRV(void* resource) = 0;
@@ -57,7 +128,9 @@ namespace wiGraphics
 		virtual ~GraphicsDevice() = default;
 		virtual bool CreateSwapChain(const SwapChainDesc* pDesc, wiPlatform::window_type window, SwapChain* swapChain) const = 0;
 		virtual bool CreateBuffer(const GPUBufferDesc *pDesc, const SubresourceData* pInitialData, GPUBuffer *pBuffer) const = 0;
-		virtual bool CreateTexture(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture *pTexture) const = 0;
+		// If alias is not null, the texture is placed into the memory of a buffer that was created with RESOURCE_MISC_ALIASING_TEXTURE_NON_RT_DS
+		//	alias_offset must be a multiple of 64 KB, returns false if the texture doesn't fit into the remaining memory
+		virtual bool CreateTexture(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture *pTexture, const GPUBuffer* alias = nullptr, uint64_t alias_offset = 0) const = 0;
 		virtual bool CreateShader(SHADERSTAGE stage, const void *pShaderBytecode, size_t BytecodeLength, Shader *pShader) const = 0;
 		virtual bool CreateSampler(const SamplerDesc *pSamplerDesc, Sampler *pSamplerState) const = 0;
 		virtual bool CreateQueryHeap(const GPUQueryHeapDesc *pDesc, GPUQueryHeap *pQueryHeap) const = 0;
@@ -65,6 +138,9 @@ namespace wiGraphics
 		virtual bool CreateRenderPass(const RenderPassDesc* pDesc, RenderPass* renderpass) const = 0;
 		virtual bool CreateRaytracingAccelerationStructure(const RaytracingAccelerationStructureDesc* pDesc, RaytracingAccelerationStructure* bvh) const { return false; }
 		virtual bool CreateRaytracingPipelineState(const RaytracingPipelineStateDesc* pDesc, RaytracingPipelineState* rtpso) const { return false; }
+		// Create the destination of CompactRaytracingAccelerationStructure(), with the size that was written by WriteRaytracingAccelerationStructureCompactedSize()
+		//	The compacted acceleration structure can be traced like the source, but it can't be built or refitted again
+		virtual bool CreateRaytracingAccelerationStructureCompacted(const RaytracingAccelerationStructure* src, uint64_t size, RaytracingAccelerationStructure* bvh) const { return false; }
 		
 		virtual int CreateSubresource(Texture* texture, SUBRESOURCE_TYPE type, uint32_t firstSlice, uint32_t sliceCount, uint32_t firstMip, uint32_t mipCount) const = 0;
 		virtual int CreateSubresource(GPUBuffer* buffer, SUBRESOURCE_TYPE type, uint64_t offset, uint64_t size = ~0) const = 0;
@@ -78,6 +154,7 @@ namespace wiGraphics
 		
 		virtual void Map(const GPUResource* resource, Mapping* mapping) const = 0;
 		virtual void Unmap(const GPUResource* resource) const = 0;
+		// The results are one uint64_t per query, except GPU_QUERY_TYPE_PIPELINE_STATISTICS, which writes one PipelineStatistics per query
 		virtual void QueryRead(const GPUQueryHeap* heap, uint32_t index, uint32_t count, uint64_t* results) const = 0;
 
 		virtual void SetCommonSampler(const StaticSampler* sam) = 0;
@@ -94,6 +171,28 @@ namespace wiGraphics
 		virtual void WaitForGPU() const = 0;
 		virtual void ClearPipelineStateCache() {};
 
+		// Frame latency: by default the CPU can record GetBufferCount() frames ahead of the GPU, which adds input latency
+		//	This blocks until at most maxFramesInFlight - 1 submitted frames are still executing, and the swapchain can accept a new frame (DXGI frame latency waitable object)
+		//	Call it after SubmitCommandLists() and before the input of the next frame is sampled. maxFramesInFlight is clamped to [1, GetBufferCount()]
+		virtual void WaitForFrameLatency(const SwapChain* swapchain, uint32_t maxFramesInFlight) {}
+
+		// Persistent pipeline cache, so the driver doesn't compile the same pipelines again in every session
+		//	A file that was written by a different adapter or driver is ignored, and a new cache is started
+		//	After it was loaded, the cache is also saved to the same file when the device is destroyed
+		virtual bool LoadPipelineCache(const std::string& filename) { return false; }
+		virtual bool SavePipelineCache(const std::string& filename) { return false; }
+
+		// The pipeline state and render pass combinations that were compiled for drawing are recorded into a prewarm list
+		//	Saving the list per level and prewarming with it while the level is loaded moves the compilation hitches of the first draws into the loading
+		bool SavePipelinePrewarmList(const std::string& filename) const;
+		void ClearPipelinePrewarmList();
+		static bool LoadPipelinePrewarmList(const std::string& filename, std::vector<PipelinePrewarmEntry>& entries);
+		//	Compiles the pipeline of an entry, it is skipped if its pipeline state or render pass doesn't exist. Returns true if it was compiled
+		//	This can be called from any thread (also while command lists are recorded), the draws use the pipeline after the next SubmitCommandLists()
+		bool PrewarmPipeline(const PipelinePrewarmEntry& entry);
+		//	Compiles every pipeline of a prewarm list on the calling thread, returns the number of compiled pipelines
+		uint32_t PrewarmPipelines(const std::string& filename);
+
 		constexpr uint64_t GetFrameCount() const { return FRAMECOUNT; }
 
 		inline bool CheckCapability(GRAPHICSDEVICE_CAPABILITY capability) const { return capabilities & capability; }
@@ -114,8 +213,18 @@ namespace wiGraphics
 
 		virtual SHADERFORMAT GetShaderFormat() const { return SHADERFORMAT_NONE; }
 
+		// Returns the memory size that a texture would need when it is placed into an aliasing buffer, 0 if resource aliasing is not supported
+		virtual uint64_t GetTextureMemorySize(const TextureDesc* pDesc) const { return 0; }
+
 		virtual Texture GetBackBuffer(const SwapChain* swapchain) const = 0;
 
+		// Asynchronous readback of the first mip of a texture, the copy is recorded into cmd and nothing waits for the GPU
+		//	The callback is called in a later SubmitCommandLists() on the submitting thread, after the GPU has finished the frame of the copy (GetBufferCount() frames later)
+		//	Returns the ticket of the readback for IsReadbackFinished()
+		uint64_t ReadbackTexture(const Texture* texture, CommandList cmd, ReadbackCallback callback);
+		// Returns true if the callback of the readback was already called
+		bool IsReadbackFinished(uint64_t ticket);
+
 		///////////////Thread-sensitive////////////////////////
 
 		virtual void WaitCommandList(CommandList cmd, CommandList wait_for) {}
@@ -158,12 +267,22 @@ namespace wiGraphics
 		virtual void CopyBufferRegion(const GPUBuffer* pDst, uint32_t dstOffset, const GPUBuffer* pSrc, uint32_t srcOffset, uint32_t srcLength, CommandList cmd) = 0;
 		virtual char* GetGraphicsCardName(void) = 0;
 #endif
-		virtual void UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize = -1) = 0;
+		// Copies dataSize bytes (the whole buffer with -1) into the buffer starting at dstOffset, a dynamic buffer can only be updated entirely
+		virtual void UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize = -1, uint32_t dstOffset = 0) = 0;
 		virtual void QueryBegin(const GPUQueryHeap *heap, uint32_t index, CommandList cmd) = 0;
 		virtual void QueryEnd(const GPUQueryHeap *heap, uint32_t index, CommandList cmd) = 0;
 		virtual void QueryResolve(const GPUQueryHeap* heap, uint32_t index, uint32_t count, CommandList cmd) {}
 		virtual void Barrier(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd) = 0;
+		// Split barriers: BarrierBegin() starts the transitions as soon as the resources are not used any more, and BarrierEnd() finishes them before the next use,
+		//	so the GPU can overlap them with the unrelated work in between. The same barriers must be given to both, in the same command list and outside of render passes
+		//	The resources of split barriers can't be used or transitioned by other barriers between the two calls
+		virtual void BarrierBegin(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd) {}
+		virtual void BarrierEnd(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd) { Barrier(barriers, numBarriers, cmd); }
 		virtual void BuildRaytracingAccelerationStructure(const RaytracingAccelerationStructure* dst, CommandList cmd, const RaytracingAccelerationStructure* src = nullptr) {}
+		// Write the compacted size of a built acceleration structure that was created with RaytracingAccelerationStructureDesc::FLAG_ALLOW_COMPACTION
+		//	The size is written as uint64_t into the dest buffer, which must have BIND_UNORDERED_ACCESS. The build must be finished by a memory barrier before this
+		virtual void WriteRaytracingAccelerationStructureCompactedSize(const RaytracingAccelerationStructure* bvh, const GPUBuffer* dest, uint64_t dest_offset, CommandList cmd) {}
+		virtual void CompactRaytracingAccelerationStructure(const RaytracingAccelerationStructure* dst, const RaytracingAccelerationStructure* src, CommandList cmd) {}
 		virtual void BindRaytracingPipelineState(const RaytracingPipelineState* rtpso, CommandList cmd) {}
 		virtual void DispatchRays(const DispatchRaysDesc* desc, CommandList cmd) {}
 		virtual void PushConstants(const void* data, uint32_t size, CommandList cmd) {}
@@ -182,6 +301,39 @@ namespace wiGraphics
 		//	The CPU pointer gets invalidated as soon as there is a Draw() or Dispatch() event on the same thread
 		//	This allocation can be used to provide temporary vertex buffer, index buffer or raw buffer data to shaders
 		virtual GPUAllocation AllocateGPU(size_t dataSize, CommandList cmd) = 0;
+
+		// Usage of the temporary allocations made by AllocateGPU()
+		struct GPUAllocatorStatistics
+		{
+			uint64_t frameBytes = 0; // bytes allocated in the last submitted frame
+			uint64_t peakFrameBytes = 0; // high-water mark of frameBytes
+			uint32_t pageCount = 0; // number of upload pages that were created
+			uint32_t framePages = 0; // upload pages used in the last submitted frame
+			uint32_t peakFramePages = 0; // high-water mark of framePages
+		};
+		virtual GPUAllocatorStatistics GetGPUAllocatorStatistics() const { return {}; }
+
+		// Video memory usage of the process and the budget that the OS gives it, exceeding the budget makes the OS page resources out
+		enum MEMORY_HEAP
+		{
+			MEMORY_HEAP_DEVICE,	// video memory (local to the GPU)
+			MEMORY_HEAP_HOST,	// system memory that the GPU can access
+		};
+		struct MemoryBudget
+		{
+			uint64_t usage = 0;
+			uint64_t budget = 0; // 0 if the budget is unknown
+		};
+		virtual MemoryBudget GetMemoryBudget(MEMORY_HEAP heap) const { return {}; }
+
+		// Hint for the OS about which resources to keep resident when the budget is exceeded, resources with lower priority are paged out first
+		enum RESIDENCY_PRIORITY
+		{
+			RESIDENCY_PRIORITY_LOW,
+			RESIDENCY_PRIORITY_NORMAL,
+			RESIDENCY_PRIORITY_HIGH,
+		};
+		virtual void SetResidencyPriority(const GPUResource* resource, RESIDENCY_PRIORITY priority) const {}
 		
 		virtual void EventBegin(const char* name, CommandList cmd) = 0;
 		virtual void EventEnd(CommandList cmd) = 0;
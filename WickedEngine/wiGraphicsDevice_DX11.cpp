@@ -4,6 +4,7 @@
 
 #include "wiHelper.h"
 #include "wiBackLog.h"
+#include "wiMemoryTracker.h"
 
 #pragma comment(lib,"dxguid.lib")
 
@@ -1108,6 +1109,7 @@ namespace DX11_Internal
 		ComPtr<ID3D11UnorderedAccessView> uav;
 		std::vector<ComPtr<ID3D11ShaderResourceView>> subresources_srv;
 		std::vector<ComPtr<ID3D11UnorderedAccessView>> subresources_uav;
+		wiMemoryTracker::ScopedAllocation memory;
 	};
 	struct Texture_DX11 : public Resource_DX11
 	{
@@ -1191,9 +1193,190 @@ namespace DX11_Internal
 	{
 		return static_cast<SwapChain_DX11*>(param->internal_state.get());
 	}
+
+	// Shadow binding of a slot whose state in the context is not known:
+	template<typename T>
+	inline T* UnknownBinding()
+	{
+		return reinterpret_cast<T*>(~uintptr_t(0));
+	}
+
+	inline void SetShaderResources(ID3D11DeviceContext* context, int stage, uint32_t slot, uint32_t count, ID3D11ShaderResourceView* const* views)
+	{
+		switch (stage)
+		{
+		case wiGraphics::VS:
+			context->VSSetShaderResources(slot, count, views);
+			break;
+		case wiGraphics::HS:
+			context->HSSetShaderResources(slot, count, views);
+			break;
+		case wiGraphics::DS:
+			context->DSSetShaderResources(slot, count, views);
+			break;
+		case wiGraphics::GS:
+			context->GSSetShaderResources(slot, count, views);
+			break;
+		case wiGraphics::PS:
+			context->PSSetShaderResources(slot, count, views);
+			break;
+		case wiGraphics::CS:
+			context->CSSetShaderResources(slot, count, views);
+			break;
+		default:
+			break;
+		}
+	}
+	inline void SetConstantBuffers(ID3D11DeviceContext* context, int stage, uint32_t slot, uint32_t count, ID3D11Buffer* const* buffers)
+	{
+		switch (stage)
+		{
+		case wiGraphics::VS:
+			context->VSSetConstantBuffers(slot, count, buffers);
+			break;
+		case wiGraphics::HS:
+			context->HSSetConstantBuffers(slot, count, buffers);
+			break;
+		case wiGraphics::DS:
+			context->DSSetConstantBuffers(slot, count, buffers);
+			break;
+		case wiGraphics::GS:
+			context->GSSetConstantBuffers(slot, count, buffers);
+			break;
+		case wiGraphics::PS:
+			context->PSSetConstantBuffers(slot, count, buffers);
+			break;
+		case wiGraphics::CS:
+			context->CSSetConstantBuffers(slot, count, buffers);
+			break;
+		default:
+			break;
+		}
+	}
+	inline void SetSamplers(ID3D11DeviceContext* context, int stage, uint32_t slot, uint32_t count, ID3D11SamplerState* const* samplers)
+	{
+		switch (stage)
+		{
+		case wiGraphics::VS:
+			context->VSSetSamplers(slot, count, samplers);
+			break;
+		case wiGraphics::HS:
+			context->HSSetSamplers(slot, count, samplers);
+			break;
+		case wiGraphics::DS:
+			context->DSSetSamplers(slot, count, samplers);
+			break;
+		case wiGraphics::GS:
+			context->GSSetSamplers(slot, count, samplers);
+			break;
+		case wiGraphics::PS:
+			context->PSSetSamplers(slot, count, samplers);
+			break;
+		case wiGraphics::CS:
+			context->CSSetSamplers(slot, count, samplers);
+			break;
+		default:
+			break;
+		}
+	}
+
+	// Calls set(slot, count, bindings) for every contiguous range of the dirty slots, unknown slots are skipped
+	template<typename T, typename Range, typename F>
+	inline void FlushBindingRange(T* const* bindings, Range& dirty, F set)
+	{
+		uint32_t begin = dirty.begin;
+		while (begin < dirty.end)
+		{
+			if (bindings[begin] == UnknownBinding<T>())
+			{
+				begin++;
+				continue;
+			}
+			uint32_t end = begin + 1;
+			while (end < dirty.end && bindings[end] != UnknownBinding<T>())
+			{
+				end++;
+			}
+			set(begin, end - begin, bindings + begin);
+			begin = end;
+		}
+		dirty = {};
+	}
 }
 using namespace DX11_Internal;
 
+void GraphicsDevice_DX11::bind_srv(SHADERSTAGE stage, uint32_t slot, ID3D11ShaderResourceView* srv, ID3D11Resource* resource, CommandList cmd)
+{
+	assert(slot < D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT);
+	StageBindings& stage_bindings = bindings[cmd][stage];
+	if (stage_bindings.srv[slot] == srv)
+		return;
+
+	stage_bindings.srv[slot] = srv;
+	stage_bindings.srv_resource[slot] = resource;
+	stage_bindings.srv_used = std::max(stage_bindings.srv_used, slot + 1);
+	stage_bindings.srv_dirty.add(slot);
+}
+void GraphicsDevice_DX11::flush_bindings(CommandList cmd)
+{
+	ID3D11DeviceContext* context = deviceContexts[cmd].Get();
+	for (int stage = VS; stage <= CS; ++stage)
+	{
+		StageBindings& stage_bindings = bindings[cmd][stage];
+		if (!stage_bindings.srv_dirty.empty())
+		{
+			FlushBindingRange(stage_bindings.srv, stage_bindings.srv_dirty, [&](uint32_t slot, uint32_t count, ID3D11ShaderResourceView* const* views) {
+				SetShaderResources(context, stage, slot, count, views);
+			});
+		}
+		if (!stage_bindings.cb_dirty.empty())
+		{
+			FlushBindingRange(stage_bindings.cb, stage_bindings.cb_dirty, [&](uint32_t slot, uint32_t count, ID3D11Buffer* const* buffers) {
+				SetConstantBuffers(context, stage, slot, count, buffers);
+			});
+		}
+		if (!stage_bindings.sam_dirty.empty())
+		{
+			FlushBindingRange(stage_bindings.sam, stage_bindings.sam_dirty, [&](uint32_t slot, uint32_t count, ID3D11SamplerState* const* samplers) {
+				SetSamplers(context, stage, slot, count, samplers);
+			});
+		}
+	}
+}
+void GraphicsDevice_DX11::reset_bindings(bool known, CommandList cmd)
+{
+	for (StageBindings& stage_bindings : bindings[cmd])
+	{
+		std::fill(std::begin(stage_bindings.srv), std::end(stage_bindings.srv), known ? nullptr : UnknownBinding<ID3D11ShaderResourceView>());
+		std::fill(std::begin(stage_bindings.srv_resource), std::end(stage_bindings.srv_resource), nullptr);
+		std::fill(std::begin(stage_bindings.cb), std::end(stage_bindings.cb), known ? nullptr : UnknownBinding<ID3D11Buffer>());
+		std::fill(std::begin(stage_bindings.sam), std::end(stage_bindings.sam), known ? nullptr : UnknownBinding<ID3D11SamplerState>());
+		stage_bindings.srv_used = known ? 0 : D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT;
+		stage_bindings.srv_dirty = {};
+		stage_bindings.cb_dirty = {};
+		stage_bindings.sam_dirty = {};
+	}
+	if (known)
+	{
+		std::fill(std::begin(cs_uav_resources[cmd]), std::end(cs_uav_resources[cmd]), nullptr);
+	}
+}
+void GraphicsDevice_DX11::invalidate_output(ID3D11Resource* resource, CommandList cmd)
+{
+	for (StageBindings& stage_bindings : bindings[cmd])
+	{
+		assert(stage_bindings.srv_dirty.empty()); // the bindings must be flushed before the outputs change
+		for (uint32_t slot = 0; slot < stage_bindings.srv_used; ++slot)
+		{
+			if (resource == nullptr || stage_bindings.srv_resource[slot] == resource)
+			{
+				stage_bindings.srv[slot] = UnknownBinding<ID3D11ShaderResourceView>();
+				stage_bindings.srv_resource[slot] = nullptr;
+			}
+		}
+	}
+}
+
 void GraphicsDevice_DX11::pso_validate(CommandList cmd)
 {
 	if (!dirty_pso[cmd])
@@ -1469,6 +1652,8 @@ GraphicsDevice_DX11::GraphicsDevice_DX11(bool debuglayer)
 	hr = DXGIAdapter->GetParent(__uuidof(IDXGIFactory2), (void**)&DXGIFactory);
 	assert(SUCCEEDED(hr));
 
+	DXGIAdapter.As(&DXGIAdapter3);
+
 	if (debuglayer)
 	{
 		ID3D11Debug* d3dDebug = nullptr;
@@ -1504,10 +1689,18 @@ GraphicsDevice_DX11::GraphicsDevice_DX11(bool debuglayer)
 		assert(SUCCEEDED(hr));
 	}
 
+	queryDesc.Query = D3D11_QUERY_EVENT;
+	for (auto& x : frameFences)
+	{
+		hr = device->CreateQuery(&queryDesc, &x);
+		assert(SUCCEEDED(hr));
+	}
+
 	D3D_FEATURE_LEVEL aquiredFeatureLevel = device->GetFeatureLevel();
 	if (aquiredFeatureLevel >= D3D_FEATURE_LEVEL_11_0)
 	{
 		capabilities |= GRAPHICSDEVICE_CAPABILITY_TESSELLATION;
+		capabilities |= GRAPHICSDEVICE_CAPABILITY_PIPELINE_STATISTICS;
 	}
 
 	//D3D11_FEATURE_DATA_D3D11_OPTIONS features_0;
@@ -1548,6 +1741,15 @@ GraphicsDevice_DX11::GraphicsDevice_DX11(bool debuglayer)
 		capabilities |= GRAPHICSDEVICE_CAPABILITY_RENDERTARGET_AND_VIEWPORT_ARRAYINDEX_WITHOUT_GS;
 	}
 
+	// Without driver command lists the deferred contexts are emulated by the runtime, then the commands are recorded into packets instead:
+	D3D11_FEATURE_DATA_THREADING threading = {};
+	hr = device->CheckFeatureSupport(D3D11_FEATURE_THREADING, &threading, sizeof(threading));
+	command_packets = FAILED(hr) || threading.DriverCommandLists == FALSE;
+	if (command_packets)
+	{
+		wiBackLog::post("GraphicsDevice_DX11: driver command lists are not supported, command packets will be used for recording");
+	}
+
 	CreateBackBufferResources();
 
 	emptyresource = std::make_shared<EmptyResourceHandle>();
@@ -1687,8 +1889,22 @@ void* GraphicsDevice_DX11::GetDeviceContext(int cmd)
 {
 	return (void*)deviceContexts[cmd].Get();
 }
+void GraphicsDevice_DX11::ExecuteNativeCommands(CommandList cmd, const std::function<void(void* context)>& func)
+{
+	if (record_packet(cmd, [=]() { ExecuteNativeCommands(cmd, func); }))
+		return;
+
+	flush_bindings(cmd);
+	func(deviceContexts[cmd].Get());
+
+	// The native commands could have changed any binding:
+	reset_bindings(false, cmd);
+}
 void GraphicsDevice_DX11::SetScissorArea(int cmd, const XMFLOAT4 area)
 {
+	if (record_packet(cmd, [=]() { SetScissorArea(cmd, area); }))
+		return;
+
 	D3D11_RECT pRects[1];
 	pRects[0].bottom = (LONG) area.w;
 	pRects[0].left = (LONG) area.x;
@@ -1699,8 +1915,15 @@ void GraphicsDevice_DX11::SetScissorArea(int cmd, const XMFLOAT4 area)
 
 void GraphicsDevice_DX11::SetRenderTarget(CommandList cmd, void* renderView)
 {
+	if (record_packet(cmd, [=]() { SetRenderTarget(cmd, renderView); }))
+		return;
+
+	flush_bindings(cmd);
+
 	ID3D11RenderTargetView* RTV = (ID3D11RenderTargetView*)renderView;
 	deviceContexts[cmd]->OMSetRenderTargets(1, &RTV, 0);
+
+	invalidate_output(nullptr, cmd);
 }
 
 void* GraphicsDevice_DX11::MaterialGetSRV(void* resource)
@@ -1752,6 +1975,8 @@ bool GraphicsDevice_DX11::CreateBuffer(const GPUBufferDesc *pDesc, const Subreso
 
 	if (SUCCEEDED(hr))
 	{
+		internal_state->memory.Set(wiMemoryTracker::TAG_GPU_BUFFER, (size_t)desc.ByteWidth);
+
 		// Create resource views if needed
 		if (pDesc->BindFlags & BIND_SHADER_RESOURCE)
 		{
@@ -1765,8 +1990,14 @@ bool GraphicsDevice_DX11::CreateBuffer(const GPUBufferDesc *pDesc, const Subreso
 
 	return SUCCEEDED(hr);
 }
-bool GraphicsDevice_DX11::CreateTexture(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture *pTexture) const
+bool GraphicsDevice_DX11::CreateTexture(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture *pTexture, const GPUBuffer* alias, uint64_t alias_offset) const
 {
+	if (alias != nullptr)
+	{
+		// Resource aliasing is not supported (GRAPHICSDEVICE_CAPABILITY_RESOURCE_ALIASING)
+		return false;
+	}
+
 	auto internal_state = std::make_shared<Texture_DX11>();
 	pTexture->internal_state = internal_state;
 	pTexture->type = GPUResource::GPU_RESOURCE_TYPE::TEXTURE;
@@ -1835,6 +2066,28 @@ bool GraphicsDevice_DX11::CreateTexture(const TextureDesc* pDesc, const Subresou
 		pTexture->desc.MipLevels = (uint32_t)log2(std::max(pTexture->desc.Width, pTexture->desc.Height)) + 1;
 	}
 
+	// DX11 doesn't expose the allocation size, so it is estimated from the description:
+	{
+		const bool blockcompressed = IsFormatBlockCompressed(pTexture->desc.Format);
+		const uint32_t stride = GetFormatStride(pTexture->desc.Format);
+		uint64_t size = 0;
+		for (uint32_t mip = 0; mip < pTexture->desc.MipLevels; ++mip)
+		{
+			uint64_t width = std::max(1u, pTexture->desc.Width >> mip);
+			uint64_t height = std::max(1u, pTexture->desc.Height >> mip);
+			const uint64_t depth = std::max(1u, pTexture->desc.Depth >> mip);
+			if (blockcompressed)
+			{
+				width = (width + 3) / 4;
+				height = (height + 3) / 4;
+			}
+			size += width * height * depth * stride;
+		}
+		size *= pTexture->desc.ArraySize * std::max(1u, pTexture->desc.SampleCount);
+		const bool rendertarget = pTexture->desc.BindFlags & (BIND_RENDER_TARGET | BIND_DEPTH_STENCIL);
+		internal_state->memory.Set(rendertarget ? wiMemoryTracker::TAG_GPU_RENDERTARGET : wiMemoryTracker::TAG_GPU_TEXTURE, (size_t)size);
+	}
+
 	if (pTexture->desc.BindFlags & BIND_RENDER_TARGET)
 	{
 		CreateSubresource(pTexture, RTV, 0, -1, 0, -1);
@@ -1960,6 +2213,9 @@ bool GraphicsDevice_DX11::CreateQueryHeap(const GPUQueryHeapDesc* pDesc, GPUQuer
 	case GPU_QUERY_TYPE_OCCLUSION_BINARY:
 		desc.Query = D3D11_QUERY_OCCLUSION_PREDICATE;
 		break;
+	case GPU_QUERY_TYPE_PIPELINE_STATISTICS:
+		desc.Query = D3D11_QUERY_PIPELINE_STATISTICS;
+		break;
 	}
 
 	internal_state->resources.resize(pDesc->queryCount);
@@ -2729,6 +2985,12 @@ void GraphicsDevice_DX11::QueryRead(const GPUQueryHeap* heap, uint32_t index, ui
 			results[i] = (uint64_t)passed;
 			break;
 		}
+		case GPU_QUERY_TYPE_PIPELINE_STATISTICS:
+		{
+			static_assert(sizeof(D3D11_QUERY_DATA_PIPELINE_STATISTICS) == sizeof(PipelineStatistics), "PipelineStatistics must match D3D11_QUERY_DATA_PIPELINE_STATISTICS");
+			hr = immediateContext->GetData(QUERY, (PipelineStatistics*)results + i, sizeof(PipelineStatistics), _flags);
+			break;
+		}
 		}
 	}
 }
@@ -2776,25 +3038,33 @@ CommandList GraphicsDevice_DX11::BeginCommandList(QUEUE_TYPE queue)
 	{
 		// need to create one more command list:
 
-		HRESULT hr = device->CreateDeferredContext(0, &deviceContexts[cmd]);
-		assert(SUCCEEDED(hr));
+		if (command_packets)
+		{
+			// The packets are replayed on the immediate context:
+			deviceContexts[cmd] = immediateContext;
+		}
+		else
+		{
+			HRESULT hr = device->CreateDeferredContext(0, &deviceContexts[cmd]);
+			assert(SUCCEEDED(hr));
+		}
 
-		hr = deviceContexts[cmd].As(&userDefinedAnnotations[cmd]);
+		HRESULT hr = deviceContexts[cmd].As(&userDefinedAnnotations[cmd]);
 		assert(SUCCEEDED(hr));
+	}
 
-		// Temporary allocations will use the following buffer type:
-		GPUBufferDesc frameAllocatorDesc;
-		frameAllocatorDesc.ByteWidth = 1024 * 1024; // 1 MB starting size
-		frameAllocatorDesc.BindFlags = BIND_SHADER_RESOURCE | BIND_INDEX_BUFFER | BIND_VERTEX_BUFFER;
-		frameAllocatorDesc.Usage = USAGE_DYNAMIC;
-		frameAllocatorDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
-		frameAllocatorDesc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
-		bool success = CreateBuffer(&frameAllocatorDesc, nullptr, &frame_allocators[cmd].buffer);
-		assert(success);
-		SetName(&frame_allocators[cmd].buffer, "frame_allocator");
-
+	// The state is reset when the command list starts executing, which is when it is replayed for command packets:
+	if (!record_packet(cmd, [=]() { reset_command_list(cmd); }))
+	{
+		reset_command_list(cmd);
 	}
 
+	return cmd;
+}
+void GraphicsDevice_DX11::reset_command_list(CommandList cmd)
+{
+	reset_bindings(true, cmd);
+
 	BindPipelineState(nullptr, cmd);
 	BindComputeShader(nullptr, cmd);
 
@@ -2855,8 +3125,6 @@ CommandList GraphicsDevice_DX11::BeginCommandList(QUEUE_TYPE queue)
 	active_pso[cmd] = nullptr;
 	dirty_pso[cmd] = false;
 	active_renderpass[cmd] = nullptr;
-
-	return cmd;
 }
 void GraphicsDevice_DX11::SubmitCommandLists()
 {
@@ -2867,17 +3135,52 @@ void GraphicsDevice_DX11::SubmitCommandLists()
 	// Execute deferred command lists:
 	CommandList cmd_last = cmd_count.load();
 	cmd_count.store(0);
+	uint64_t upload_bytes = 0;
+	uint32_t upload_pages_used = 0;
 	for (CommandList cmd = 0; cmd < cmd_last; ++cmd)
 	{
-		HRESULT hr = deviceContexts[cmd]->FinishCommandList(false, &commandLists[cmd]);
-		assert(SUCCEEDED(hr));
+		if (command_packets)
+		{
+			// Each command list starts from the default state, like a deferred context:
+			immediateContext->ClearState();
+			replaying_packets = true;
+			command_streams[cmd].replay();
+			replaying_packets = false;
+			command_streams[cmd].reset();
+		}
+
+		commit_allocations(cmd);
+
+		// The upload pages of the command list are reused after the GPU finished this frame:
+		GPUAllocator& allocator = frame_allocators[cmd];
+		if (allocator.page != nullptr)
+		{
+			allocator.filled.push_back(allocator.page);
+			allocator.page = nullptr;
+		}
+		for (UploadPage* page : allocator.filled)
+		{
+			retire_upload_page(page);
+		}
+		upload_bytes += allocator.frameBytes;
+		upload_pages_used += (uint32_t)allocator.filled.size();
+		allocator.filled.clear();
+		allocator.byteOffset = 0;
+		allocator.frameBytes = 0;
+
+		HRESULT hr = S_OK;
+		if (!command_packets)
+		{
+			hr = deviceContexts[cmd]->FinishCommandList(false, &commandLists[cmd]);
+			assert(SUCCEEDED(hr));
 #ifdef GGREDUCED
 #ifdef OPTICK_ENABLE
-		OPTICK_EVENT("ExecuteCommandList");
+			OPTICK_EVENT("ExecuteCommandList");
 #endif
 #endif
-		immediateContext->ExecuteCommandList(commandLists[cmd].Get(), false);
-		commandLists[cmd].Reset();
+			immediateContext->ExecuteCommandList(commandLists[cmd].Get(), false);
+			commandLists[cmd].Reset();
+		}
 
 		for (auto& swapchain : swapchains[cmd])
 		{
@@ -2929,7 +3232,34 @@ void GraphicsDevice_DX11::SubmitCommandLists()
 		TIMESTAMP_FREQUENCY = disjoint.Frequency;
 	}
 
+	// Frame fence of the upload page recycling:
+	immediateContext->End(frameFences[FRAMECOUNT % FRAME_FENCE_COUNT].Get());
+	while (completedFrames <= FRAMECOUNT)
+	{
+		// The fence of the oldest frame must be finished when the next frame reuses it, otherwise it is only polled:
+		const bool wait = completedFrames + FRAME_FENCE_COUNT <= FRAMECOUNT + 1;
+		BOOL result;
+		hr = immediateContext->GetData(frameFences[completedFrames % FRAME_FENCE_COUNT].Get(), &result, sizeof(result), wait ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH);
+		if (hr == S_OK)
+		{
+			completedFrames++;
+		}
+		else if (!wait || FAILED(hr))
+		{
+			break;
+		}
+	}
+
+	upload_page_locker.lock();
+	upload_statistics.frameBytes = upload_bytes;
+	upload_statistics.peakFrameBytes = std::max(upload_statistics.peakFrameBytes, upload_bytes);
+	upload_statistics.framePages = upload_pages_used;
+	upload_statistics.peakFramePages = std::max(upload_statistics.peakFramePages, upload_pages_used);
+	upload_page_locker.unlock();
+
 	FRAMECOUNT++;
+
+	ProcessReadbacks();
 }
 
 void GraphicsDevice_DX11::WaitForGPU() const
@@ -2949,6 +3279,20 @@ void GraphicsDevice_DX11::WaitForGPU() const
 	while (immediateContext->GetData(query.Get(), &result, sizeof(result), 0) == S_FALSE);
 	assert(result == TRUE);
 }
+void GraphicsDevice_DX11::WaitForFrameLatency(const SwapChain* swapchain, uint32_t maxFramesInFlight)
+{
+	// The DX11 device doesn't track frames in flight, DXGI blocks in Present() when the frame latency is exceeded:
+	maxFramesInFlight = std::max(1u, std::min(maxFramesInFlight, GetBufferCount()));
+	if (max_frame_latency != maxFramesInFlight)
+	{
+		ComPtr<IDXGIDevice1> pDXGIDevice;
+		HRESULT hr = device.As(&pDXGIDevice);
+		assert(SUCCEEDED(hr));
+		hr = pDXGIDevice->SetMaximumFrameLatency(maxFramesInFlight);
+		assert(SUCCEEDED(hr));
+		max_frame_latency = maxFramesInFlight;
+	}
+}
 
 
 Texture GraphicsDevice_DX11::GetBackBuffer(const SwapChain* swapchain) const
@@ -2973,17 +3317,93 @@ void GraphicsDevice_DX11::commit_allocations(CommandList cmd)
 {
 	// DX11 needs to unmap allocations before it can execute safely
 
-	if (frame_allocators[cmd].dirty)
+	GPUAllocator& allocator = frame_allocators[cmd];
+	auto unmap = [&](UploadPage* page) {
+		if (page->mappedData != nullptr)
+		{
+			deviceContexts[cmd]->Unmap(to_internal(&page->buffer)->resource.Get(), 0);
+			page->mappedData = nullptr;
+		}
+	};
+	if (allocator.page != nullptr)
 	{
-		auto internal_state = to_internal(&frame_allocators[cmd].buffer);
-		deviceContexts[cmd]->Unmap(internal_state->resource.Get(), 0);
-		frame_allocators[cmd].dirty = false;
+		unmap(allocator.page);
+	}
+	for (UploadPage* page : allocator.filled)
+	{
+		unmap(page);
+	}
+}
+void* GraphicsDevice_DX11::map_upload_page(UploadPage* page, size_t offset, CommandList cmd)
+{
+	if (page->mappedData == nullptr)
+	{
+		// The first map of a dynamic buffer in a deferred context must discard, then allocations are appended:
+		D3D11_MAP mapping = offset == 0 ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+		D3D11_MAPPED_SUBRESOURCE mappedResource;
+		HRESULT hr = deviceContexts[cmd]->Map(to_internal(&page->buffer)->resource.Get(), 0, mapping, 0, &mappedResource);
+		assert(SUCCEEDED(hr) && "GPUBuffer mapping failed!");
+		page->mappedData = mappedResource.pData;
 	}
+	return (void*)((size_t)page->mappedData + offset);
+}
+GraphicsDevice_DX11::UploadPage* GraphicsDevice_DX11::acquire_upload_page(size_t dataSize)
+{
+	uint32_t size = UPLOAD_PAGE_SIZE;
+	while (size < dataSize)
+	{
+		assert(size < 0x80000000u);
+		size *= 2;
+	}
+
+	std::scoped_lock lock(upload_page_locker);
+
+	// The smallest page that fits and is no longer used by the GPU:
+	size_t best = upload_pages_free.size();
+	for (size_t i = 0; i < upload_pages_free.size(); ++i)
+	{
+		const UploadPage* page = upload_pages_free[i];
+		if (page->retiredFrame < completedFrames && page->buffer.desc.ByteWidth >= size &&
+			(best == upload_pages_free.size() || page->buffer.desc.ByteWidth < upload_pages_free[best]->buffer.desc.ByteWidth))
+		{
+			best = i;
+		}
+	}
+	if (best < upload_pages_free.size())
+	{
+		UploadPage* page = upload_pages_free[best];
+		upload_pages_free[best] = upload_pages_free.back();
+		upload_pages_free.pop_back();
+		return page;
+	}
+
+	auto page = std::make_unique<UploadPage>();
+	GPUBufferDesc desc;
+	desc.ByteWidth = size;
+	desc.BindFlags = BIND_SHADER_RESOURCE | BIND_INDEX_BUFFER | BIND_VERTEX_BUFFER;
+	desc.Usage = USAGE_DYNAMIC;
+	desc.CPUAccessFlags = CPU_ACCESS_WRITE;
+	desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+	bool success = CreateBuffer(&desc, nullptr, &page->buffer);
+	assert(success);
+	SetName(&page->buffer, "upload_page");
+	upload_pages.push_back(std::move(page));
+	upload_statistics.pageCount = (uint32_t)upload_pages.size();
+	return upload_pages.back().get();
+}
+void GraphicsDevice_DX11::retire_upload_page(UploadPage* page)
+{
+	std::scoped_lock lock(upload_page_locker);
+	page->retiredFrame = FRAMECOUNT;
+	upload_pages_free.push_back(page);
 }
 
 
 void GraphicsDevice_DX11::RenderPassBegin(const SwapChain* swapchain, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { RenderPassBegin(swapchain, cmd); }))
+		return;
+
 	swapchains[cmd].push_back(swapchain);
 	active_renderpass[cmd] = &dummyrenderpass;
 	auto internal_state = to_internal(swapchain);
@@ -2994,6 +3414,11 @@ void GraphicsDevice_DX11::RenderPassBegin(const SwapChain* swapchain, CommandLis
 }
 void GraphicsDevice_DX11::RenderPassBegin(const RenderPass* renderpass, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { RenderPassBegin(renderpass, cmd); }))
+		return;
+
+	flush_bindings(cmd);
+
 	active_renderpass[cmd] = renderpass;
 	const RenderPassDesc& desc = renderpass->GetDesc();
 
@@ -3006,6 +3431,11 @@ void GraphicsDevice_DX11::RenderPassBegin(const RenderPass* renderpass, CommandL
 		int subresource = attachment.subresource;
 		auto internal_state = to_internal(texture);
 
+		if (attachment.type == RenderPassAttachment::RENDERTARGET || attachment.type == RenderPassAttachment::DEPTH_STENCIL)
+		{
+			invalidate_output(internal_state->resource.Get(), cmd);
+		}
+
 		if (attachment.type == RenderPassAttachment::RENDERTARGET)
 		{
 			if (subresource < 0 || internal_state->subresources_rtv.empty())
@@ -3054,6 +3484,7 @@ void GraphicsDevice_DX11::RenderPassBegin(const RenderPass* renderpass, CommandL
 		const uint32_t slot = raster_uavs_slot[cmd];
 
 		deviceContexts[cmd]->OMSetRenderTargetsAndUnorderedAccessViews(rt_count, RTVs, DSV, slot, count, &raster_uavs[cmd][slot], nullptr);
+		invalidate_output(nullptr, cmd);
 
 		raster_uavs_count[cmd] = 0;
 		raster_uavs_slot[cmd] = 8;
@@ -3065,8 +3496,21 @@ void GraphicsDevice_DX11::RenderPassBegin(const RenderPass* renderpass, CommandL
 }
 void GraphicsDevice_DX11::RenderPassEnd(CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { RenderPassEnd(cmd); }))
+		return;
+
+	flush_bindings(cmd);
 	deviceContexts[cmd]->OMSetRenderTargets(0, nullptr, nullptr);
 
+	// The shader resources that were bound while they were outputs are not bound:
+	for (auto& attachment : active_renderpass[cmd]->desc.attachments)
+	{
+		if ((attachment.type == RenderPassAttachment::RENDERTARGET || attachment.type == RenderPassAttachment::DEPTH_STENCIL) && attachment.texture != nullptr)
+		{
+			invalidate_output(to_internal(attachment.texture)->resource.Get(), cmd);
+		}
+	}
+
 	// Perform resolves:
 	int dst_counter = 0;
 	for (auto& attachment : active_renderpass[cmd]->desc.attachments)
@@ -3100,6 +3544,12 @@ void GraphicsDevice_DX11::RenderPassEnd(CommandList cmd)
 }
 void GraphicsDevice_DX11::BindScissorRects(uint32_t numRects, const Rect* rects, CommandList cmd)
 {
+	if (recording_packets())
+	{
+		const Rect* rects_copy = command_streams[cmd].copy(rects, numRects);
+		command_streams[cmd].push([=]() { BindScissorRects(numRects, rects_copy, cmd); });
+		return;
+	}
 	assert(rects != nullptr);
 	assert(numRects <= D3D11_VIEWPORT_AND_SCISSORRECT_MAX_INDEX);
 	D3D11_RECT pRects[D3D11_VIEWPORT_AND_SCISSORRECT_MAX_INDEX];
@@ -3132,6 +3582,12 @@ void GraphicsDevice_DX11::BindScissorRects(uint32_t numRects, const Rect* rects,
 }
 void GraphicsDevice_DX11::BindViewports(uint32_t NumViewports, const Viewport* pViewports, CommandList cmd)
 {
+	if (recording_packets())
+	{
+		const Viewport* viewports_copy = command_streams[cmd].copy(pViewports, NumViewports);
+		command_streams[cmd].push([=]() { BindViewports(NumViewports, viewports_copy, cmd); });
+		return;
+	}
 	assert(pViewports != nullptr);
 	assert(NumViewports <= D3D11_VIEWPORT_AND_SCISSORRECT_MAX_INDEX);
 	D3D11_VIEWPORT d3dViewPorts[D3D11_VIEWPORT_AND_SCISSORRECT_MAX_INDEX];
@@ -3156,6 +3612,9 @@ void GraphicsDevice_DX11::BindViewports(uint32_t NumViewports, const Viewport* p
 
 void GraphicsDevice_DX11::BindResource(SHADERSTAGE stage, const GPUResource* resource, uint32_t slot, CommandList cmd, int subresource)
 {
+	if (record_packet(cmd, [=]() { BindResource(stage, resource, slot, cmd, subresource); }))
+		return;
+
 	if (resource != nullptr && resource->IsValid())
 	{
 		auto internal_state = to_internal(resource);
@@ -3186,30 +3645,8 @@ void GraphicsDevice_DX11::BindResource(SHADERSTAGE stage, const GPUResource* res
 			SRV = internal_state->subresources_srv[subresource].Get();
 		}
 
-		switch (stage)
-		{
-		case wiGraphics::VS:
-			deviceContexts[cmd]->VSSetShaderResources(slot, 1, &SRV);
-			break;
-		case wiGraphics::HS:
-			deviceContexts[cmd]->HSSetShaderResources(slot, 1, &SRV);
-			break;
-		case wiGraphics::DS:
-			deviceContexts[cmd]->DSSetShaderResources(slot, 1, &SRV);
-			break;
-		case wiGraphics::GS:
-			deviceContexts[cmd]->GSSetShaderResources(slot, 1, &SRV);
-			break;
-		case wiGraphics::PS:
-			//PE: Crash in here, was from reflection, moved to mainthread for testing (looks good).
-			deviceContexts[cmd]->PSSetShaderResources(slot, 1, &SRV);
-			break;
-		case wiGraphics::CS:
-			deviceContexts[cmd]->CSSetShaderResources(slot, 1, &SRV);
-			break;
-		default:
-			break;
-		}
+		//PE: Crash in here (PSSetShaderResources), was from reflection, moved to mainthread for testing (looks good).
+		bind_srv(stage, slot, SRV, internal_state->resource.Get(), cmd);
 	}
 }
 #ifdef GGREDUCED
@@ -3218,39 +3655,31 @@ void GraphicsDevice_DX11::BindResource(SHADERSTAGE stage, const GPUResource* res
 
 void GraphicsDevice_DX11::BindResources(SHADERSTAGE stage, const GPUResource *const* resources, uint32_t slot, uint32_t count, CommandList cmd)
 {
-	assert(count <= 16);
-	ID3D11ShaderResourceView* srvs[16];
-	for (uint32_t i = 0; i < count; ++i)
+	if (recording_packets())
 	{
-		srvs[i] = resources[i] != nullptr && resources[i]->IsValid() ? to_internal(resources[i])->srv.Get() : nullptr;
+		const GPUResource* const* resources_copy = command_streams[cmd].copy(resources, count);
+		command_streams[cmd].push([=]() { BindResources(stage, resources_copy, slot, count, cmd); });
+		return;
 	}
-
-	switch (stage)
+	assert(count <= 16);
+	for (uint32_t i = 0; i < count; ++i)
 	{
-	case wiGraphics::VS:
-		deviceContexts[cmd]->VSSetShaderResources(slot, count, srvs);
-		break;
-	case wiGraphics::HS:
-		deviceContexts[cmd]->HSSetShaderResources(slot, count, srvs);
-		break;
-	case wiGraphics::DS:
-		deviceContexts[cmd]->DSSetShaderResources(slot, count, srvs);
-		break;
-	case wiGraphics::GS:
-		deviceContexts[cmd]->GSSetShaderResources(slot, count, srvs);
-		break;
-	case wiGraphics::PS:
-		deviceContexts[cmd]->PSSetShaderResources(slot, count, srvs);
-		break;
-	case wiGraphics::CS:
-		deviceContexts[cmd]->CSSetShaderResources(slot, count, srvs);
-		break;
-	default:
-		break;
+		if (resources[i] != nullptr && resources[i]->IsValid())
+		{
+			auto internal_state = to_internal(resources[i]);
+			bind_srv(stage, slot + i, internal_state->srv.Get(), internal_state->resource.Get(), cmd);
+		}
+		else
+		{
+			bind_srv(stage, slot + i, nullptr, nullptr, cmd);
+		}
 	}
 }
 void GraphicsDevice_DX11::BindUAV(SHADERSTAGE stage, const GPUResource* resource, uint32_t slot, CommandList cmd, int subresource)
 {
+	if (record_packet(cmd, [=]() { BindUAV(stage, resource, slot, cmd, subresource); }))
+		return;
+
 	if (resource != nullptr && resource->IsValid())
 	{
 		auto internal_state = to_internal(resource);
@@ -3268,7 +3697,14 @@ void GraphicsDevice_DX11::BindUAV(SHADERSTAGE stage, const GPUResource* resource
 
 		if (stage == CS)
 		{
+			assert(slot < arraysize(cs_uav_resources[cmd]));
+			flush_bindings(cmd);
 			deviceContexts[cmd]->CSSetUnorderedAccessViews(slot, 1, &UAV, nullptr);
+
+			// The shader resource views of the new output are unbound by the runtime, and the previous output can be bound again:
+			invalidate_output(internal_state->resource.Get(), cmd);
+			invalidate_output(cs_uav_resources[cmd][slot], cmd);
+			cs_uav_resources[cmd][slot] = internal_state->resource.Get();
 		}
 		else
 		{
@@ -3280,6 +3716,12 @@ void GraphicsDevice_DX11::BindUAV(SHADERSTAGE stage, const GPUResource* resource
 }
 void GraphicsDevice_DX11::BindUAVs(SHADERSTAGE stage, const GPUResource *const* resources, uint32_t slot, uint32_t count, CommandList cmd)
 {
+	if (recording_packets())
+	{
+		const GPUResource* const* resources_copy = command_streams[cmd].copy(resources, count);
+		command_streams[cmd].push([=]() { BindUAVs(stage, resources_copy, slot, count, cmd); });
+		return;
+	}
 	assert(slot + count <= 8);
 	ID3D11UnorderedAccessView* uavs[8];
 	for (uint32_t i = 0; i < count; ++i)
@@ -3294,7 +3736,22 @@ void GraphicsDevice_DX11::BindUAVs(SHADERSTAGE stage, const GPUResource *const*
 
 	if(stage == CS)
 	{
+		flush_bindings(cmd);
 		deviceContexts[cmd]->CSSetUnorderedAccessViews(static_cast<uint32_t>(slot), static_cast<uint32_t>(count), uavs, nullptr);
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			ID3D11Resource* resource = uavs[i] != nullptr ? to_internal(resources[i])->resource.Get() : nullptr;
+			if (resource != nullptr)
+			{
+				invalidate_output(resource, cmd);
+			}
+			if (cs_uav_resources[cmd][slot + i] != nullptr)
+			{
+				invalidate_output(cs_uav_resources[cmd][slot + i], cmd);
+			}
+			cs_uav_resources[cmd][slot + i] = resource;
+		}
 	}
 	else
 	{
@@ -3304,83 +3761,83 @@ void GraphicsDevice_DX11::BindUAVs(SHADERSTAGE stage, const GPUResource *const*
 }
 void GraphicsDevice_DX11::UnbindResources(uint32_t slot, uint32_t num, CommandList cmd)
 {
-	assert(num <= arraysize(__nullBlob) && "Extend nullBlob to support more resource unbinding!");
-	deviceContexts[cmd]->PSSetShaderResources(slot, num, (ID3D11ShaderResourceView**)__nullBlob);
-	deviceContexts[cmd]->VSSetShaderResources(slot, num, (ID3D11ShaderResourceView**)__nullBlob);
-	deviceContexts[cmd]->GSSetShaderResources(slot, num, (ID3D11ShaderResourceView**)__nullBlob);
-	deviceContexts[cmd]->HSSetShaderResources(slot, num, (ID3D11ShaderResourceView**)__nullBlob);
-	deviceContexts[cmd]->DSSetShaderResources(slot, num, (ID3D11ShaderResourceView**)__nullBlob);
-	deviceContexts[cmd]->CSSetShaderResources(slot, num, (ID3D11ShaderResourceView**)__nullBlob);
+	if (record_packet(cmd, [=]() { UnbindResources(slot, num, cmd); }))
+		return;
+
+	assert(slot + num <= D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT);
+	for (int stage = VS; stage <= CS; ++stage)
+	{
+		for (uint32_t i = 0; i < num; ++i)
+		{
+			bind_srv((SHADERSTAGE)stage, slot + i, nullptr, nullptr, cmd);
+		}
+	}
 }
 void GraphicsDevice_DX11::UnbindUAVs(uint32_t slot, uint32_t num, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { UnbindUAVs(slot, num, cmd); }))
+		return;
+
 	assert(num <= arraysize(__nullBlob) && "Extend nullBlob to support more resource unbinding!");
+	flush_bindings(cmd);
 	deviceContexts[cmd]->CSSetUnorderedAccessViews(slot, num, (ID3D11UnorderedAccessView**)__nullBlob, 0);
 
+	for (uint32_t i = slot; i < std::min(slot + num, (uint32_t)arraysize(cs_uav_resources[cmd])); ++i)
+	{
+		if (cs_uav_resources[cmd][i] != nullptr)
+		{
+			invalidate_output(cs_uav_resources[cmd][i], cmd);
+			cs_uav_resources[cmd][i] = nullptr;
+		}
+	}
+
 	raster_uavs_count[cmd] = 0;
 	raster_uavs_slot[cmd] = 8;
 }
 void GraphicsDevice_DX11::BindSampler(SHADERSTAGE stage, const Sampler* sampler, uint32_t slot, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { BindSampler(stage, sampler, slot, cmd); }))
+		return;
+
 	if (sampler != nullptr && sampler->IsValid())
 	{
 		auto internal_state = to_internal(sampler);
 		ID3D11SamplerState* SAM = internal_state->resource.Get();
 
-		switch (stage)
+		assert(slot < D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT);
+		StageBindings& stage_bindings = bindings[cmd][stage];
+		if (stage_bindings.sam[slot] != SAM)
 		{
-		case wiGraphics::VS:
-			deviceContexts[cmd]->VSSetSamplers(slot, 1, &SAM);
-			break;
-		case wiGraphics::HS:
-			deviceContexts[cmd]->HSSetSamplers(slot, 1, &SAM);
-			break;
-		case wiGraphics::DS:
-			deviceContexts[cmd]->DSSetSamplers(slot, 1, &SAM);
-			break;
-		case wiGraphics::GS:
-			deviceContexts[cmd]->GSSetSamplers(slot, 1, &SAM);
-			break;
-		case wiGraphics::PS:
-			deviceContexts[cmd]->PSSetSamplers(slot, 1, &SAM);
-			break;
-		case wiGraphics::CS:
-			deviceContexts[cmd]->CSSetSamplers(slot, 1, &SAM);
-			break;
-		default:
-			break;
+			stage_bindings.sam[slot] = SAM;
+			stage_bindings.sam_dirty.add(slot);
 		}
 	}
 }
 void GraphicsDevice_DX11::BindConstantBuffer(SHADERSTAGE stage, const GPUBuffer* buffer, uint32_t slot, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { BindConstantBuffer(stage, buffer, slot, cmd); }))
+		return;
+
 	ID3D11Buffer* res = buffer != nullptr && buffer->IsValid() ? (ID3D11Buffer*)to_internal(buffer)->resource.Get() : nullptr;
-	switch (stage)
+
+	assert(slot < D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT);
+	StageBindings& stage_bindings = bindings[cmd][stage];
+	if (stage_bindings.cb[slot] != res)
 	{
-	case wiGraphics::VS:
-		deviceContexts[cmd]->VSSetConstantBuffers(slot, 1, &res);
-		break;
-	case wiGraphics::HS:
-		deviceContexts[cmd]->HSSetConstantBuffers(slot, 1, &res);
-		break;
-	case wiGraphics::DS:
-		deviceContexts[cmd]->DSSetConstantBuffers(slot, 1, &res);
-		break;
-	case wiGraphics::GS:
-		deviceContexts[cmd]->GSSetConstantBuffers(slot, 1, &res);
-		break;
-	case wiGraphics::PS:
-		deviceContexts[cmd]->PSSetConstantBuffers(slot, 1, &res);
-		break;
-	case wiGraphics::CS:
-		deviceContexts[cmd]->CSSetConstantBuffers(slot, 1, &res);
-		break;
-	default:
-		break;
+		stage_bindings.cb[slot] = res;
+		stage_bindings.cb_dirty.add(slot);
 	}
 }
 void GraphicsDevice_DX11::BindVertexBuffers(const GPUBuffer *const* vertexBuffers, uint32_t slot, uint32_t count, const uint32_t* strides, const uint32_t* offsets, CommandList cmd)
 {
+	if (recording_packets())
+	{
+		const GPUBuffer* const* vertexBuffers_copy = command_streams[cmd].copy(vertexBuffers, count);
+		const uint32_t* strides_copy = command_streams[cmd].copy(strides, count);
+		const uint32_t* offsets_copy = command_streams[cmd].copy(offsets, count);
+		command_streams[cmd].push([=]() { BindVertexBuffers(vertexBuffers_copy, slot, count, strides_copy, offsets_copy, cmd); });
+		return;
+	}
 	assert(count <= 8);
 	ID3D11Buffer* res[8] = {};
 	for (uint32_t i = 0; i < count; ++i)
@@ -3391,15 +3848,24 @@ void GraphicsDevice_DX11::BindVertexBuffers(const GPUBuffer *const* vertexBuffer
 }
 void GraphicsDevice_DX11::BindIndexBuffer(const GPUBuffer* indexBuffer, const INDEXBUFFER_FORMAT format, uint32_t offset, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { BindIndexBuffer(indexBuffer, format, offset, cmd); }))
+		return;
+
 	ID3D11Buffer* res = indexBuffer != nullptr && indexBuffer->IsValid() ? (ID3D11Buffer*)to_internal(indexBuffer)->resource.Get() : nullptr;
 	deviceContexts[cmd]->IASetIndexBuffer(res, (format == INDEXBUFFER_FORMAT::INDEXFORMAT_16BIT ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT), offset);
 }
 void GraphicsDevice_DX11::BindStencilRef(uint32_t value, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { BindStencilRef(value, cmd); }))
+		return;
+
 	stencilRef[cmd] = value;
 }
 void GraphicsDevice_DX11::BindBlendFactor(float r, float g, float b, float a, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { BindBlendFactor(r, g, b, a, cmd); }))
+		return;
+
 	blendFactor[cmd].x = r;
 	blendFactor[cmd].y = g;
 	blendFactor[cmd].z = b;
@@ -3407,6 +3873,9 @@ void GraphicsDevice_DX11::BindBlendFactor(float r, float g, float b, float a, Co
 }
 void GraphicsDevice_DX11::BindPipelineState(const PipelineState* pso, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { BindPipelineState(pso, cmd); }))
+		return;
+
 	if (active_pso[cmd] == pso)
 		return;
 
@@ -3415,6 +3884,9 @@ void GraphicsDevice_DX11::BindPipelineState(const PipelineState* pso, CommandLis
 }
 void GraphicsDevice_DX11::BindComputeShader(const Shader* cs, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { BindComputeShader(cs, cmd); }))
+		return;
+
 	ID3D11ComputeShader* _cs = cs == nullptr ? nullptr : static_cast<ComputeShader_DX11*>(cs->internal_state.get())->resource.Get();
 	if (_cs != prev_cs[cmd])
 	{
@@ -3432,60 +3904,95 @@ void GraphicsDevice_DX11::BindComputeShader(const Shader* cs, CommandList cmd)
 }
 void GraphicsDevice_DX11::Draw(uint32_t vertexCount, uint32_t startVertexLocation, CommandList cmd) 
 {
+	if (record_packet(cmd, [=]() { Draw(vertexCount, startVertexLocation, cmd); }))
+		return;
+
 	pso_validate(cmd);
+	flush_bindings(cmd);
 	commit_allocations(cmd);
 
 	deviceContexts[cmd]->Draw(vertexCount, startVertexLocation);
 }
 void GraphicsDevice_DX11::DrawIndexed(uint32_t indexCount, uint32_t startIndexLocation, uint32_t baseVertexLocation, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { DrawIndexed(indexCount, startIndexLocation, baseVertexLocation, cmd); }))
+		return;
+
 	pso_validate(cmd);
+	flush_bindings(cmd);
 	commit_allocations(cmd);
 
 	deviceContexts[cmd]->DrawIndexed(indexCount, startIndexLocation, baseVertexLocation);
 }
 void GraphicsDevice_DX11::DrawInstanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t startVertexLocation, uint32_t startInstanceLocation, CommandList cmd) 
 {
+	if (record_packet(cmd, [=]() { DrawInstanced(vertexCount, instanceCount, startVertexLocation, startInstanceLocation, cmd); }))
+		return;
+
 	pso_validate(cmd);
+	flush_bindings(cmd);
 	commit_allocations(cmd);
 
 	deviceContexts[cmd]->DrawInstanced(vertexCount, instanceCount, startVertexLocation, startInstanceLocation);
 }
 void GraphicsDevice_DX11::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndexLocation, uint32_t baseVertexLocation, uint32_t startInstanceLocation, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { DrawIndexedInstanced(indexCount, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation, cmd); }))
+		return;
+
 	pso_validate(cmd);
+	flush_bindings(cmd);
 	commit_allocations(cmd);
 
 	deviceContexts[cmd]->DrawIndexedInstanced(indexCount, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation);
 }
 void GraphicsDevice_DX11::DrawInstancedIndirect(const GPUBuffer* args, uint32_t args_offset, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { DrawInstancedIndirect(args, args_offset, cmd); }))
+		return;
+
 	pso_validate(cmd);
+	flush_bindings(cmd);
 	commit_allocations(cmd);
 
 	deviceContexts[cmd]->DrawInstancedIndirect((ID3D11Buffer*)to_internal(args)->resource.Get(), args_offset);
 }
 void GraphicsDevice_DX11::DrawIndexedInstancedIndirect(const GPUBuffer* args, uint32_t args_offset, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { DrawIndexedInstancedIndirect(args, args_offset, cmd); }))
+		return;
+
 	pso_validate(cmd);
+	flush_bindings(cmd);
 	commit_allocations(cmd);
 
 	deviceContexts[cmd]->DrawIndexedInstancedIndirect((ID3D11Buffer*)to_internal(args)->resource.Get(), args_offset);
 }
 void GraphicsDevice_DX11::Dispatch(uint32_t threadGroupCountX, uint32_t threadGroupCountY, uint32_t threadGroupCountZ, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { Dispatch(threadGroupCountX, threadGroupCountY, threadGroupCountZ, cmd); }))
+		return;
+
+	flush_bindings(cmd);
 	commit_allocations(cmd);
 
 	deviceContexts[cmd]->Dispatch(threadGroupCountX, threadGroupCountY, threadGroupCountZ);
 }
 void GraphicsDevice_DX11::DispatchIndirect(const GPUBuffer* args, uint32_t args_offset, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { DispatchIndirect(args, args_offset, cmd); }))
+		return;
+
+	flush_bindings(cmd);
 	commit_allocations(cmd);
 
 	deviceContexts[cmd]->DispatchIndirect((ID3D11Buffer*)to_internal(args)->resource.Get(), args_offset);
 }
 void GraphicsDevice_DX11::CopyResource(const GPUResource* pDst, const GPUResource* pSrc, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { CopyResource(pDst, pSrc, cmd); }))
+		return;
+
 	assert(pDst != nullptr && pSrc != nullptr);
 	auto internal_state_src = to_internal(pSrc);
 	auto internal_state_dst = to_internal(pDst);
@@ -3494,6 +4001,9 @@ void GraphicsDevice_DX11::CopyResource(const GPUResource* pDst, const GPUResourc
 #ifdef GGREDUCED
 void GraphicsDevice_DX11::CopyTexture2D_Region(const Texture* pDst, uint32_t dstMip, uint32_t dstX, uint32_t dstY, const Texture* pSrc, uint32_t srcMip, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { CopyTexture2D_Region(pDst, dstMip, dstX, dstY, pSrc, srcMip, cmd); }))
+		return;
+
 	assert(pDst != nullptr && pSrc != nullptr);
 	auto internal_state_src = to_internal(pSrc);
 	auto internal_state_dst = to_internal(pDst);
@@ -3503,6 +4013,9 @@ void GraphicsDevice_DX11::CopyTexture2D_Region(const Texture* pDst, uint32_t dst
 
 void GraphicsDevice_DX11::MSAAResolve(const Texture* pDst, const Texture* pSrc, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { MSAAResolve(pDst, pSrc, cmd); }))
+		return;
+
 	assert(pDst != nullptr && pSrc != nullptr);
 	auto internal_state_src = to_internal(pSrc);
 	auto internal_state_dst = to_internal(pDst);
@@ -3514,6 +4027,20 @@ void GraphicsDevice_DX11::UpdateTexture(const Texture* tex, uint32_t mipLevel, u
 	GPUResource* res = (GPUResource*)tex;
 	if ( res == nullptr || !res->IsValid() ) return;
 
+	if (cmd >= 0 && cmd < COMMANDLIST_COUNT && recording_packets())
+	{
+		const TextureDesc& desc = tex->GetDesc();
+		uint32_t rows = dstBox != nullptr ? dstBox->bottom - dstBox->top : std::max(1u, desc.Height >> mipLevel);
+		if (IsFormatBlockCompressed(desc.Format))
+		{
+			rows = (rows + 3) / 4;
+		}
+		CopyBox* box_copy = command_streams[cmd].copy(dstBox, 1);
+		const uint8_t* data_copy = command_streams[cmd].copy((const uint8_t*)data, size_t(dataRowStride) * rows);
+		command_streams[cmd].push([=]() { UpdateTexture(tex, mipLevel, arraySlice, box_copy, data_copy, dataRowStride, cmd); });
+		return;
+	}
+
 	auto internal_state = to_internal(res);
 	ID3D11Texture2D* d3dTex = (ID3D11Texture2D*) internal_state->resource.Get();
 
@@ -3529,6 +4056,9 @@ void GraphicsDevice_DX11::GenerateMipmaps(Texture* tex, CommandList cmd)
 	GPUResource* res = (GPUResource*)tex;
 
 	if ( res == nullptr || !res->IsValid() ) return;
+
+	if (cmd >= 0 && cmd < COMMANDLIST_COUNT && record_packet(cmd, [=]() { GenerateMipmaps(tex, cmd); }))
+		return;
 	
 	auto internal_state = to_internal(res);
 	ID3D11ShaderResourceView* shaderView = internal_state->srv.Get();
@@ -3540,6 +4070,9 @@ void GraphicsDevice_DX11::GenerateMipmaps(Texture* tex, CommandList cmd)
 
 void GraphicsDevice_DX11::CopyBufferRegion(const GPUBuffer* pDst, uint32_t dstOffset, const GPUBuffer* pSrc, uint32_t srcOffset, uint32_t srcLength, CommandList cmd)
 {
+	if (cmd >= 0 && cmd < COMMANDLIST_COUNT && record_packet(cmd, [=]() { CopyBufferRegion(pDst, dstOffset, pSrc, srcOffset, srcLength, cmd); }))
+		return;
+
 	ID3D11DeviceContext* context = immediateContext.Get();
 	if ( cmd >= 0 && cmd < COMMANDLIST_COUNT ) context = deviceContexts[cmd].Get();
 
@@ -3563,22 +4096,36 @@ char* GraphicsDevice_DX11::GetGraphicsCardName(void)
 }
 #endif
 
-void GraphicsDevice_DX11::UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize)
+void GraphicsDevice_DX11::UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize, uint32_t dstOffset)
 {
 	assert(buffer->desc.Usage != USAGE_IMMUTABLE && "Cannot update IMMUTABLE GPUBuffer!");
-	assert((int)buffer->desc.ByteWidth >= dataSize || dataSize < 0 && "Data size is too big!");
+	assert(dstOffset <= buffer->desc.ByteWidth && "Offset is out of bounds!");
+	assert((int)(buffer->desc.ByteWidth - dstOffset) >= dataSize || dataSize < 0 && "Data size is too big!");
 
 	if (dataSize == 0)
 	{
 		return;
 	}
 
+	if (recording_packets())
+	{
+		const size_t size = dataSize < 0 ? (size_t)(buffer->desc.ByteWidth - dstOffset) : (size_t)std::min((int)(buffer->desc.ByteWidth - dstOffset), dataSize);
+		const uint8_t* data_copy = command_streams[cmd].copy((const uint8_t*)data, size);
+		command_streams[cmd].push([=]() { UpdateBuffer(buffer, data_copy, cmd, dataSize, dstOffset); });
+		return;
+	}
+
 	auto internal_state = to_internal(buffer);
 
-	dataSize = std::min((int)buffer->desc.ByteWidth, dataSize);
+	dataSize = std::min((int)(buffer->desc.ByteWidth - dstOffset), dataSize);
+	if (dstOffset > 0 && dataSize < 0)
+	{
+		dataSize = (int)(buffer->desc.ByteWidth - dstOffset);
+	}
 
 	if (buffer->desc.Usage == USAGE_DYNAMIC)
 	{
+		assert(dstOffset == 0 && "Dynamic buffer can only be updated entirely!");
 		D3D11_MAPPED_SUBRESOURCE mappedResource;
 		HRESULT hr = deviceContexts[cmd]->Map(internal_state->resource.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
 		assert(SUCCEEDED(hr) && "GPUBuffer mapping failed!");
@@ -3587,13 +4134,14 @@ void GraphicsDevice_DX11::UpdateBuffer(const GPUBuffer* buffer, const void* data
 	}
 	else if (buffer->desc.BindFlags & BIND_CONSTANT_BUFFER || dataSize < 0)
 	{
+		assert(dstOffset == 0 && "Constant buffer can only be updated entirely!");
 		deviceContexts[cmd]->UpdateSubresource(internal_state->resource.Get(), 0, nullptr, data, 0, 0);
 	}
 	else
 	{
 		D3D11_BOX box = {};
-		box.left = 0;
-		box.right = static_cast<uint32_t>(dataSize);
+		box.left = dstOffset;
+		box.right = dstOffset + static_cast<uint32_t>(dataSize);
 		box.top = 0;
 		box.bottom = 1;
 		box.front = 0;
@@ -3603,11 +4151,17 @@ void GraphicsDevice_DX11::UpdateBuffer(const GPUBuffer* buffer, const void* data
 }
 void GraphicsDevice_DX11::QueryBegin(const GPUQueryHeap* heap, uint32_t index, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { QueryBegin(heap, index, cmd); }))
+		return;
+
 	auto internal_state = to_internal(heap);
 	deviceContexts[cmd]->Begin(internal_state->resources[index].Get());
 }
 void GraphicsDevice_DX11::QueryEnd(const GPUQueryHeap* heap, uint32_t index, CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { QueryEnd(heap, index, cmd); }))
+		return;
+
 	auto internal_state = to_internal(heap);
 	deviceContexts[cmd]->End(internal_state->resources[index].Get());
 }
@@ -3621,41 +4175,93 @@ GraphicsDevice::GPUAllocation GraphicsDevice_DX11::AllocateGPU(size_t dataSize,
 	}
 
 	GPUAllocator& allocator = frame_allocators[cmd];
-	if (allocator.buffer.desc.ByteWidth <= dataSize)
+	if (allocator.page == nullptr || allocator.byteOffset + dataSize > allocator.page->buffer.desc.ByteWidth)
 	{
-		// If allocation too large, grow the allocator:
-		allocator.buffer.desc.ByteWidth = uint32_t((dataSize + 1) * 2);
-		bool success = CreateBuffer(&allocator.buffer.desc, nullptr, &allocator.buffer);
-		assert(success);
-		SetName(&allocator.buffer, "frame_allocator");
+		// The filled page stays mapped until the next commit, so the earlier allocations remain writable:
+		if (allocator.page != nullptr)
+		{
+			allocator.filled.push_back(allocator.page);
+		}
+		allocator.page = acquire_upload_page(dataSize);
 		allocator.byteOffset = 0;
 	}
 
-	auto internal_state = to_internal(&allocator.buffer);
-
-	allocator.dirty = true;
-
-	size_t position = allocator.byteOffset;
-	bool wrap = position == 0 || position + dataSize > allocator.buffer.desc.ByteWidth || allocator.residentFrame != FRAMECOUNT;
-	position = wrap ? 0 : position;
-
-	// Issue buffer rename (realloc) on wrap, otherwise just append data:
-	D3D11_MAP mapping = wrap ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
-	HRESULT hr = deviceContexts[cmd]->Map(internal_state->resource.Get(), 0, mapping, 0, &mappedResource);
-	assert(SUCCEEDED(hr) && "GPUBuffer mapping failed!");
+	UploadPage* page = allocator.page;
+	const size_t offset = allocator.byteOffset;
+	result.buffer = &page->buffer;
+	result.offset = (uint32_t)offset;
+	if (recording_packets())
+	{
+		// The data is written into the packet stream, and copied into the page when it is replayed:
+		void* data = command_streams[cmd].allocate(dataSize, 16);
+		command_streams[cmd].push([=]() { std::memcpy(map_upload_page(page, offset, cmd), data, dataSize); });
+		result.data = data;
+	}
+	else
+	{
+		result.data = map_upload_page(page, offset, cmd);
+	}
 
-	allocator.byteOffset = position + dataSize;
-	allocator.residentFrame = FRAMECOUNT;
+	allocator.byteOffset += dataSize;
+	allocator.frameBytes += dataSize;
+	return result;
+}
+GraphicsDevice::GPUAllocatorStatistics GraphicsDevice_DX11::GetGPUAllocatorStatistics() const
+{
+	std::scoped_lock lock(upload_page_locker);
+	return upload_statistics;
+}
 
-	result.buffer = &allocator.buffer;
-	result.offset = (uint32_t)position;
-	result.data = (void*)((size_t)mappedResource.pData + position);
+GraphicsDevice::MemoryBudget GraphicsDevice_DX11::GetMemoryBudget(MEMORY_HEAP heap) const
+{
+	MemoryBudget result;
+	if (DXGIAdapter3 != nullptr)
+	{
+		DXGI_QUERY_VIDEO_MEMORY_INFO info = {};
+		HRESULT hr = DXGIAdapter3->QueryVideoMemoryInfo(0, heap == MEMORY_HEAP_DEVICE ? DXGI_MEMORY_SEGMENT_GROUP_LOCAL : DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL, &info);
+		if (SUCCEEDED(hr))
+		{
+			result.usage = info.CurrentUsage;
+			result.budget = info.Budget;
+		}
+	}
 	return result;
 }
 
+void GraphicsDevice_DX11::SetResidencyPriority(const GPUResource* resource, RESIDENCY_PRIORITY priority) const
+{
+	if (resource == nullptr || !resource->IsValid())
+	{
+		return;
+	}
+	ComPtr<IDXGIResource> dxgiResource;
+	HRESULT hr = to_internal(resource)->resource.As(&dxgiResource);
+	if (SUCCEEDED(hr))
+	{
+		UINT value = DXGI_RESOURCE_PRIORITY_NORMAL;
+		switch (priority)
+		{
+		case RESIDENCY_PRIORITY_LOW:
+			value = DXGI_RESOURCE_PRIORITY_LOW;
+			break;
+		case RESIDENCY_PRIORITY_HIGH:
+			value = DXGI_RESOURCE_PRIORITY_HIGH;
+			break;
+		default:
+			break;
+		}
+		dxgiResource->SetEvictionPriority(value);
+	}
+}
+
 void GraphicsDevice_DX11::EventBegin(const char* name, CommandList cmd)
 {
+	if (recording_packets())
+	{
+		const char* name_copy = command_streams[cmd].copy(name, strlen(name) + 1);
+		command_streams[cmd].push([=]() { EventBegin(name_copy, cmd); });
+		return;
+	}
 	wchar_t text[128];
 	if (wiHelper::StringConvert(name, text) > 0)
 	{
@@ -3664,10 +4270,19 @@ void GraphicsDevice_DX11::EventBegin(const char* name, CommandList cmd)
 }
 void GraphicsDevice_DX11::EventEnd(CommandList cmd)
 {
+	if (record_packet(cmd, [=]() { EventEnd(cmd); }))
+		return;
+
 	userDefinedAnnotations[cmd]->EndEvent();
 }
 void GraphicsDevice_DX11::SetMarker(const char* name, CommandList cmd)
 {
+	if (recording_packets())
+	{
+		const char* name_copy = command_streams[cmd].copy(name, strlen(name) + 1);
+		command_streams[cmd].push([=]() { SetMarker(name_copy, cmd); });
+		return;
+	}
 	wchar_t text[128];
 	if (wiHelper::StringConvert(name, text) > 0)
 	{
@@ -10,9 +10,18 @@
 
 #include <d3d11_3.h>
 #include <DXGI1_3.h>
+#include <dxgi1_4.h>
 #include <wrl/client.h> // ComPtr
 
 #include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstring>
+#include <type_traits>
+#include <algorithm>
+#include <new>
 
 namespace wiGraphics
 {
@@ -23,6 +32,7 @@ namespace wiGraphics
 		D3D_DRIVER_TYPE driverType;
 		D3D_FEATURE_LEVEL featureLevel;
 		Microsoft::WRL::ComPtr<IDXGIFactory2> DXGIFactory;
+		Microsoft::WRL::ComPtr<IDXGIAdapter3> DXGIAdapter3; // for video memory budget queries, not available before Windows 10
 		Microsoft::WRL::ComPtr<ID3D11Device> device;
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> immediateContext;
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContexts[COMMANDLIST_COUNT];
@@ -62,14 +72,187 @@ namespace wiGraphics
 		uint8_t raster_uavs_count[COMMANDLIST_COUNT] = {};
 		void validate_raster_uavs(CommandList cmd);
 
-		struct GPUAllocator
+		// Shadow state of the shader resource, constant buffer and sampler bindings of every stage
+		//	Redundant binds are dropped, and the changed slots are applied before draws and dispatches with one call for every contiguous range
+		//	The runtime unbinds the shader resources of resources that become outputs, so those slots become unknown, and they are bound again by the next bind
+		struct BindingRange
+		{
+			uint32_t begin = ~0u;
+			uint32_t end = 0;
+			inline void add(uint32_t slot) { begin = std::min(begin, slot); end = std::max(end, slot + 1); }
+			inline bool empty() const { return begin >= end; }
+		};
+		struct StageBindings
+		{
+			ID3D11ShaderResourceView* srv[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+			ID3D11Resource* srv_resource[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT]; // the resources of the views, to find the views of outputs
+			ID3D11Buffer* cb[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+			ID3D11SamplerState* sam[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+			uint32_t srv_used = 0; // the slots after this were never bound
+			BindingRange srv_dirty;
+			BindingRange cb_dirty;
+			BindingRange sam_dirty;
+		} bindings[COMMANDLIST_COUNT][SHADERSTAGE_COUNT];
+		ID3D11Resource* cs_uav_resources[COMMANDLIST_COUNT][8] = {};
+		void bind_srv(SHADERSTAGE stage, uint32_t slot, ID3D11ShaderResourceView* srv, ID3D11Resource* resource, CommandList cmd);
+		void flush_bindings(CommandList cmd);
+		// Known: the context has nothing bound (at the start of command lists), otherwise every binding becomes unknown
+		void reset_bindings(bool known, CommandList cmd);
+		// The shader resource views of a resource that becomes an output are unbound by the runtime, nullptr means every resource
+		void invalidate_output(ID3D11Resource* resource, CommandList cmd);
+
+		// Temporary allocations are made from a ring of fixed size upload pages, the pages are never recreated while they are referenced
+		//	A page is retired when it is full or its command list was submitted, and it is reused after the GPU finished the frame that retired it
+		//	Requests that don't fit into a page get a page of their own, rounded up to a power of two, which is recycled the same way
+		static constexpr uint32_t UPLOAD_PAGE_SIZE = 1024 * 1024;
+		struct UploadPage
 		{
 			GPUBuffer buffer;
+			uint64_t retiredFrame = 0;
+			void* mappedData = nullptr; // the page is mapped in the command list that uses it
+		};
+		mutable std::mutex upload_page_locker;
+		std::deque<std::unique_ptr<UploadPage>> upload_pages; // owns every page, their addresses are stable
+		std::vector<UploadPage*> upload_pages_free;
+		GPUAllocatorStatistics upload_statistics;
+
+		uint32_t max_frame_latency = 1; // DXGI maximum frame latency of the device
+		UploadPage* acquire_upload_page(size_t dataSize);
+		void retire_upload_page(UploadPage* page);
+
+		// Frame fences, the pages retired in a frame are reused after its query completed
+		static constexpr uint32_t FRAME_FENCE_COUNT = 8;
+		Microsoft::WRL::ComPtr<ID3D11Query> frameFences[FRAME_FENCE_COUNT];
+		uint64_t completedFrames = 0; // every frame before this one was finished by the GPU
+
+		struct GPUAllocator
+		{
+			UploadPage* page = nullptr;
 			size_t byteOffset = 0;
-			uint64_t residentFrame = 0;
-			bool dirty = false;
+			size_t frameBytes = 0;
+			std::vector<UploadPage*> filled; // earlier pages of the command list, they are retired when it is submitted
 		} frame_allocators[COMMANDLIST_COUNT];
 		void commit_allocations(CommandList cmd);
+		void* map_upload_page(UploadPage* page, size_t offset, CommandList cmd);
+
+		// Command packet path, used when the driver doesn't support command lists natively (D3D11_FEATURE_DATA_THREADING::DriverCommandLists)
+		//	The runtime emulation of deferred contexts costs more than it saves there, so the command functions are instead recorded into compact packet streams
+		//	by the recording threads, and the streams are replayed on the immediate context in SubmitCommandLists()
+		//	In this mode the objects that the commands refer to must stay alive until SubmitCommandLists()
+		class CommandPacketStream
+		{
+		public:
+			static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+			~CommandPacketStream() { reset(); }
+
+			// Linear memory that stays valid until reset()
+			void* allocate(size_t size, size_t alignment)
+			{
+				while (current < blocks.size())
+				{
+					Block& block = blocks[current];
+					const size_t offset = (block.offset + alignment - 1) & ~(alignment - 1);
+					if (offset + size <= block.size)
+					{
+						block.offset = offset + size;
+						return block.data.get() + offset;
+					}
+					current++;
+				}
+				Block block;
+				block.size = std::max(BLOCK_SIZE, size + alignment);
+				block.data = std::make_unique<uint8_t[]>(block.size);
+				blocks.push_back(std::move(block));
+				return allocate(size, alignment);
+			}
+			template<typename T>
+			T* copy(const T* data, size_t count)
+			{
+				static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable data can be copied into packets!");
+				if (data == nullptr)
+					return nullptr;
+				T* dst = (T*)allocate(sizeof(T) * count, alignof(T));
+				std::memcpy(dst, data, sizeof(T) * count);
+				return dst;
+			}
+			// Append a command, which is a callable that is executed by replay()
+			template<typename F>
+			void push(F&& func)
+			{
+				using T = typename std::decay<F>::type;
+				Packet* packet = (Packet*)allocate(sizeof(Packet), alignof(Packet));
+				packet->payload = allocate(sizeof(T), alignof(T));
+				new (packet->payload) T(std::forward<F>(func));
+				packet->execute = [](void* payload) { (*(T*)payload)(); };
+				packet->destroy = [](void* payload) { ((T*)payload)->~T(); };
+				packet->next = nullptr;
+				if (last == nullptr)
+				{
+					first = packet;
+				}
+				else
+				{
+					last->next = packet;
+				}
+				last = packet;
+			}
+			void replay() const
+			{
+				for (const Packet* packet = first; packet != nullptr; packet = packet->next)
+				{
+					packet->execute(packet->payload);
+				}
+			}
+			void reset()
+			{
+				for (Packet* packet = first; packet != nullptr; packet = packet->next)
+				{
+					packet->destroy(packet->payload);
+				}
+				first = nullptr;
+				last = nullptr;
+				// Oversized blocks are released, regular blocks are kept for the next frame:
+				blocks.erase(std::remove_if(blocks.begin(), blocks.end(), [](const Block& block) { return block.size > BLOCK_SIZE; }), blocks.end());
+				for (Block& block : blocks)
+				{
+					block.offset = 0;
+				}
+				current = 0;
+			}
+
+		private:
+			struct Packet
+			{
+				void(*execute)(void* payload);
+				void(*destroy)(void* payload);
+				void* payload;
+				Packet* next;
+			};
+			struct Block
+			{
+				std::unique_ptr<uint8_t[]> data;
+				size_t size = 0;
+				size_t offset = 0;
+			};
+			std::vector<Block> blocks;
+			size_t current = 0;
+			Packet* first = nullptr;
+			Packet* last = nullptr;
+		} command_streams[COMMANDLIST_COUNT];
+		bool command_packets = false;
+		bool replaying_packets = false;
+		inline bool recording_packets() const { return command_packets && !replaying_packets; }
+		// Records the command into the packet stream of the command list, returns false if it must be executed instead
+		template<typename F>
+		inline bool record_packet(CommandList cmd, F&& func)
+		{
+			if (!recording_packets())
+				return false;
+			command_streams[cmd].push(std::forward<F>(func));
+			return true;
+		}
+		void reset_command_list(CommandList cmd);
 
 		void CreateBackBufferResources();
 
@@ -85,6 +268,7 @@ namespace wiGraphics
 		void* GetDeviceForIMGUI(void) override;
 		void* GetImmediateForIMGUI(void) override;
 		void* GetDeviceContext(int cmd) override;
+		void ExecuteNativeCommands(CommandList cmd, const std::function<void(void* context)>& func) override;
 		void SetScissorArea(int cmd, const XMFLOAT4 area) override;
 		void SetRenderTarget(CommandList cmd, void* renderTarget) override;
 		void* MaterialGetSRV(void* resource) override;
@@ -96,7 +280,7 @@ namespace wiGraphics
 
 		bool CreateSwapChain(const SwapChainDesc* pDesc, wiPlatform::window_type window, SwapChain* swapChain) const override;
 		bool CreateBuffer(const GPUBufferDesc *pDesc, const SubresourceData* pInitialData, GPUBuffer *pBuffer) const override;
-		bool CreateTexture(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture *pTexture) const override;
+		bool CreateTexture(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture *pTexture, const GPUBuffer* alias = nullptr, uint64_t alias_offset = 0) const override;
 		bool CreateShader(SHADERSTAGE stage, const void *pShaderBytecode, size_t BytecodeLength, Shader *pShader) const override;
 		bool CreateSampler(const SamplerDesc *pSamplerDesc, Sampler *pSamplerState) const override;
 		bool CreateQueryHeap(const GPUQueryHeapDesc *pDesc, GPUQueryHeap *pQueryHeap) const override;
@@ -115,6 +299,7 @@ namespace wiGraphics
 		void SetName(GPUResource* pResource, const char* name) override;
 
 		void WaitForGPU() const override;
+		void WaitForFrameLatency(const SwapChain* swapchain, uint32_t maxFramesInFlight) override;
 
 		CommandList BeginCommandList(QUEUE_TYPE queue = QUEUE_GRAPHICS) override;
 		void SubmitCommandLists() override;
@@ -161,12 +346,15 @@ namespace wiGraphics
 		void CopyBufferRegion(const GPUBuffer* pDst, uint32_t dstOffset, const GPUBuffer* pSrc, uint32_t srcOffset, uint32_t srcLength, CommandList cmd) override;
 		char* GetGraphicsCardName(void) override;
 #endif
-		void UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize = -1) override;
+		void UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize = -1, uint32_t dstOffset = 0) override;
 		void QueryBegin(const GPUQueryHeap* heap, uint32_t index, CommandList cmd) override;
 		void QueryEnd(const GPUQueryHeap* heap, uint32_t index, CommandList cmd) override;
 		void Barrier(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd) override {}
 
 		GPUAllocation AllocateGPU(size_t dataSize, CommandList cmd) override;
+		GPUAllocatorStatistics GetGPUAllocatorStatistics() const override;
+		MemoryBudget GetMemoryBudget(MEMORY_HEAP heap) const override;
+		void SetResidencyPriority(const GPUResource* resource, RESIDENCY_PRIORITY priority) const override;
 
 		void EventBegin(const char* name, CommandList cmd) override;
 		void EventEnd(CommandList cmd) override;
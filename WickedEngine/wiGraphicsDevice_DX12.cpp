@@ -5,6 +5,8 @@
 #include "wiGraphicsDevice_SharedInternals.h"
 #include "wiHelper.h"
 #include "wiBackLog.h"
+#include "wiProfiler.h"
+#include "wiMemoryTracker.h"
 
 #include "Utility/dx12/d3dx12.h"
 #include "Utility/D3D12MemAlloc.h"
@@ -1249,6 +1251,7 @@ namespace DX12_Internal
 		D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
 
 		D3D12_GPU_VIRTUAL_ADDRESS gpu_address = 0;
+		wiMemoryTracker::ScopedAllocation memory;
 
 		GraphicsDevice::GPUAllocation dynamic[COMMANDLIST_COUNT];
 
@@ -1283,6 +1286,7 @@ namespace DX12_Internal
 		SingleDescriptor dsv = {};
 		std::vector<SingleDescriptor> subresources_rtv;
 		std::vector<SingleDescriptor> subresources_dsv;
+		std::shared_ptr<void> aliased_memory; // keeps the aliasing buffer alive while the texture is placed in its heap
 
 		~Texture_DX12() override
 		{
@@ -1364,6 +1368,8 @@ namespace DX12_Internal
 		std::vector<uint8_t> shadercode;
 		std::vector<D3D12_INPUT_ELEMENT_DESC> input_elements;
 
+		uint64_t persistent_hash = 0; // shader: hash of the bytecode, pipeline state: key that is valid across sessions
+
 		struct PSO_STREAM
 		{
 			struct PSO_STREAM1
@@ -1441,6 +1447,11 @@ namespace DX12_Internal
 		D3D12_RENDER_PASS_DEPTH_STENCIL_DESC DSV = {};
 		const Texture* shading_rate_image = nullptr;
 
+		// The attachment formats that the pipelines are compiled with:
+		DXGI_FORMAT pipeline_DSFormat = DXGI_FORMAT_UNKNOWN;
+		D3D12_RT_FORMAT_ARRAY pipeline_RTFormats = {};
+		DXGI_SAMPLE_DESC pipeline_sampleDesc = { 1, 0 };
+
 		// Due to a API bug, this resolve_subresources array must be kept alive between BeginRenderpass() and EndRenderpass()!
 		D3D12_RENDER_PASS_ENDING_ACCESS_RESOLVE_SUBRESOURCE_PARAMETERS resolve_subresources[D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT] = {};
 	};
@@ -1448,6 +1459,8 @@ namespace DX12_Internal
 	{
 		std::shared_ptr<GraphicsDevice_DX12::AllocationHandler> allocationhandler;
 		Microsoft::WRL::ComPtr<IDXGISwapChain3> swapChain;
+		HANDLE frameLatencyWaitable = NULL;
+		uint32_t maxFrameLatency = 0;
 		std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> backBuffers;
 		std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> backbufferRTV;
 
@@ -1456,6 +1469,10 @@ namespace DX12_Internal
 
 		~SwapChain_DX12()
 		{
+			if (frameLatencyWaitable != NULL)
+			{
+				CloseHandle(frameLatencyWaitable);
+			}
 			allocationhandler->destroylocker.lock();
 			uint64_t framecount = allocationhandler->framecount;
 			for (auto& x : backBuffers)
@@ -1514,6 +1531,75 @@ namespace DX12_Internal
 	{
 		return static_cast<SwapChain_DX12*>(param->internal_state.get());
 	}
+
+	void compute_pipeline_formats(const RenderPassDesc& desc, RenderPass_DX12& internal_state)
+	{
+		DXGI_FORMAT& DSFormat = internal_state.pipeline_DSFormat;
+		D3D12_RT_FORMAT_ARRAY& formats = internal_state.pipeline_RTFormats;
+		DXGI_SAMPLE_DESC& sampleDesc = internal_state.pipeline_sampleDesc;
+		DSFormat = DXGI_FORMAT_UNKNOWN;
+		formats = {};
+		sampleDesc.Count = 1;
+		sampleDesc.Quality = 0;
+		for (auto& attachment : desc.attachments)
+		{
+			if (attachment.type == RenderPassAttachment::RESOLVE ||
+				attachment.type == RenderPassAttachment::SHADING_RATE_SOURCE ||
+				attachment.texture == nullptr)
+				continue;
+
+			switch (attachment.type)
+			{
+			case RenderPassAttachment::RENDERTARGET:
+				switch (attachment.texture->desc.Format)
+				{
+				case FORMAT_R16_TYPELESS:
+					formats.RTFormats[formats.NumRenderTargets] = DXGI_FORMAT_R16_UNORM;
+					break;
+				case FORMAT_R32_TYPELESS:
+					formats.RTFormats[formats.NumRenderTargets] = DXGI_FORMAT_R32_FLOAT;
+					break;
+				case FORMAT_R24G8_TYPELESS:
+					formats.RTFormats[formats.NumRenderTargets] = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+					break;
+				case FORMAT_R32G8X24_TYPELESS:
+					formats.RTFormats[formats.NumRenderTargets] = DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS;
+					break;
+				default:
+					formats.RTFormats[formats.NumRenderTargets] = _ConvertFormat(attachment.texture->desc.Format);
+					break;
+				}
+				formats.NumRenderTargets++;
+				break;
+			case RenderPassAttachment::DEPTH_STENCIL:
+				switch (attachment.texture->desc.Format)
+				{
+				case FORMAT_R16_TYPELESS:
+					DSFormat = DXGI_FORMAT_D16_UNORM;
+					break;
+				case FORMAT_R32_TYPELESS:
+					DSFormat = DXGI_FORMAT_D32_FLOAT;
+					break;
+				case FORMAT_R24G8_TYPELESS:
+					DSFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
+					break;
+				case FORMAT_R32G8X24_TYPELESS:
+					DSFormat = DXGI_FORMAT_D32_FLOAT_S8X24_UINT;
+					break;
+				default:
+					DSFormat = _ConvertFormat(attachment.texture->desc.Format);
+					break;
+				}
+				break;
+			default:
+				assert(0);
+				break;
+			}
+
+			sampleDesc.Count = attachment.texture->desc.SampleCount;
+			sampleDesc.Quality = 0;
+		}
+	}
 }
 using namespace DX12_Internal;
 
@@ -2083,6 +2169,61 @@ using namespace DX12_Internal;
 	}
 
 
+	ComPtr<ID3D12PipelineState> GraphicsDevice_DX12::create_pipeline(const PipelineState* pso, const RenderPass* renderpass)
+	{
+		auto internal_state = to_internal(pso);
+		auto renderpass_internal = to_internal(renderpass);
+
+		// make copy, mustn't overwrite internal_state from here!
+		PipelineState_DX12::PSO_STREAM stream = internal_state->stream;
+		stream.stream1.DSFormat = renderpass_internal->pipeline_DSFormat;
+		stream.stream1.Formats = renderpass_internal->pipeline_RTFormats;
+		stream.stream1.SampleDesc = renderpass_internal->pipeline_sampleDesc;
+
+		D3D12_PIPELINE_STATE_STREAM_DESC streamDesc = {};
+		streamDesc.pPipelineStateSubobjectStream = &stream;
+		streamDesc.SizeInBytes = sizeof(stream.stream1);
+		if (CheckCapability(GRAPHICSDEVICE_CAPABILITY_MESH_SHADER))
+		{
+			streamDesc.SizeInBytes += sizeof(stream.stream2);
+		}
+
+		ComPtr<ID3D12PipelineState> newpso;
+		if (pipeline_library == nullptr)
+		{
+			wiProfiler::MarkEvent("Pipeline State Creation");
+			HRESULT hr = device->CreatePipelineState(&streamDesc, IID_PPV_ARGS(&newpso));
+			assert(SUCCEEDED(hr));
+			return newpso;
+		}
+
+		// The pipelines are named in the library by keys that are valid across sessions:
+		size_t key = (size_t)internal_state->persistent_hash;
+		wiHelper::hash_combine(key, renderpass->hash);
+		wchar_t name[32] = {};
+		swprintf_s(name, L"%016llx", (unsigned long long)key);
+
+		HRESULT hr;
+		{
+			std::scoped_lock lock(pipeline_library_locker);
+			hr = pipeline_library->LoadPipeline(name, &streamDesc, IID_PPV_ARGS(&newpso));
+		}
+		if (SUCCEEDED(hr))
+		{
+			return newpso;
+		}
+
+		// Not in the library (E_INVALIDARG), so it is compiled and stored:
+		wiProfiler::MarkEvent("Pipeline State Creation");
+		hr = device->CreatePipelineState(&streamDesc, IID_PPV_ARGS(&newpso));
+		assert(SUCCEEDED(hr));
+		if (SUCCEEDED(hr))
+		{
+			std::scoped_lock lock(pipeline_library_locker);
+			pipeline_library->StorePipeline(name, newpso.Get()); // fails if an other thread stored it in the meantime, which is fine
+		}
+		return newpso;
+	}
 	void GraphicsDevice_DX12::pso_validate(CommandList cmd)
 	{
 		if (!dirty_pso[cmd])
@@ -2108,88 +2249,8 @@ using namespace DX12_Internal;
 
 			if (pipeline == nullptr)
 			{
-				// make copy, mustn't overwrite internal_state from here!
-				PipelineState_DX12::PSO_STREAM stream = internal_state->stream;
-
-				DXGI_FORMAT DSFormat = DXGI_FORMAT_UNKNOWN;
-				D3D12_RT_FORMAT_ARRAY formats = {};
-				formats.NumRenderTargets = 0;
-				DXGI_SAMPLE_DESC sampleDesc = {};
-				sampleDesc.Count = 1;
-				sampleDesc.Quality = 0;
-					for (auto& attachment : active_renderpass[cmd]->desc.attachments)
-					{
-						if (attachment.type == RenderPassAttachment::RESOLVE ||
-							attachment.type == RenderPassAttachment::SHADING_RATE_SOURCE ||
-							attachment.texture == nullptr)
-							continue;
-
-						switch (attachment.type)
-						{
-						case RenderPassAttachment::RENDERTARGET:
-							switch (attachment.texture->desc.Format)
-							{
-							case FORMAT_R16_TYPELESS:
-								formats.RTFormats[formats.NumRenderTargets] = DXGI_FORMAT_R16_UNORM;
-								break;
-							case FORMAT_R32_TYPELESS:
-								formats.RTFormats[formats.NumRenderTargets] = DXGI_FORMAT_R32_FLOAT;
-								break;
-							case FORMAT_R24G8_TYPELESS:
-								formats.RTFormats[formats.NumRenderTargets] = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
-								break;
-							case FORMAT_R32G8X24_TYPELESS:
-								formats.RTFormats[formats.NumRenderTargets] = DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS;
-								break;
-							default:
-								formats.RTFormats[formats.NumRenderTargets] = _ConvertFormat(attachment.texture->desc.Format);
-								break;
-							}
-							formats.NumRenderTargets++;
-							break;
-						case RenderPassAttachment::DEPTH_STENCIL:
-							switch (attachment.texture->desc.Format)
-							{
-							case FORMAT_R16_TYPELESS:
-								DSFormat = DXGI_FORMAT_D16_UNORM;
-								break;
-							case FORMAT_R32_TYPELESS:
-								DSFormat = DXGI_FORMAT_D32_FLOAT;
-								break;
-							case FORMAT_R24G8_TYPELESS:
-								DSFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
-								break;
-							case FORMAT_R32G8X24_TYPELESS:
-								DSFormat = DXGI_FORMAT_D32_FLOAT_S8X24_UINT;
-								break;
-							default:
-								DSFormat = _ConvertFormat(attachment.texture->desc.Format);
-								break;
-							}
-							break;
-						default:
-							assert(0);
-							break;
-						}
-
-						sampleDesc.Count = attachment.texture->desc.SampleCount;
-						sampleDesc.Quality = 0;
-					}
-				stream.stream1.DSFormat = DSFormat;
-				stream.stream1.Formats = formats;
-				stream.stream1.SampleDesc = sampleDesc;
-
-				D3D12_PIPELINE_STATE_STREAM_DESC streamDesc = {};
-				streamDesc.pPipelineStateSubobjectStream = &stream;
-				streamDesc.SizeInBytes = sizeof(stream.stream1);
-				if (CheckCapability(GRAPHICSDEVICE_CAPABILITY_MESH_SHADER))
-				{
-					streamDesc.SizeInBytes += sizeof(stream.stream2);
-				}
-
-				ComPtr<ID3D12PipelineState> newpso;
-				HRESULT hr = device->CreatePipelineState(&streamDesc, IID_PPV_ARGS(&newpso));
-				assert(SUCCEEDED(hr));
+				ComPtr<ID3D12PipelineState> newpso = create_pipeline(pso, active_renderpass[cmd]);
+				RecordPrewarmPipeline(internal_state->persistent_hash, active_renderpass[cmd]->hash);
 
 				pipelines_worker[cmd].push_back(std::make_pair(pipeline_hash, newpso));
 				pipeline = newpso.Get();
@@ -2278,6 +2339,16 @@ using namespace DX12_Internal;
 						sizeof(uint64_t) * x.index
 					);
 					break;
+				case GPU_QUERY_TYPE_PIPELINE_STATISTICS:
+					GetCommandList(cmd)->ResolveQueryData(
+						internal_state->heap.Get(),
+						D3D12_QUERY_TYPE_PIPELINE_STATISTICS,
+						x.index,
+						x.count,
+						internal_state->resource.Get(),
+						sizeof(D3D12_QUERY_DATA_PIPELINE_STATISTICS) * x.index
+					);
+					break;
 				}
 
 			}
@@ -2553,6 +2624,23 @@ using namespace DX12_Internal;
 			}
 		}
 
+		// The pipeline cache files are only valid on the same adapter and driver:
+		{
+			DXGI_ADAPTER_DESC1 adapterDesc;
+			dxgiAdapter1->GetDesc1(&adapterDesc);
+			pipeline_cache_header.magic = 0x43504457; // "WDPC"
+			pipeline_cache_header.version = 1;
+			pipeline_cache_header.vendorID = adapterDesc.VendorId;
+			pipeline_cache_header.deviceID = adapterDesc.DeviceId;
+			std::memcpy(pipeline_cache_header.uuid, &adapterDesc.SubSysId, sizeof(adapterDesc.SubSysId));
+			std::memcpy(pipeline_cache_header.uuid + sizeof(adapterDesc.SubSysId), &adapterDesc.Revision, sizeof(adapterDesc.Revision));
+			LARGE_INTEGER driverVersion = {};
+			if (SUCCEEDED(dxgiAdapter1->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion)))
+			{
+				pipeline_cache_header.driverVersion = (uint64_t)driverVersion.QuadPart;
+			}
+		}
+
 		D3D12MA::ALLOCATOR_DESC allocatorDesc = {};
 		allocatorDesc.pDevice = device.Get();
 		allocatorDesc.pAdapter = dxgiAdapter1.Get();
@@ -2646,6 +2734,8 @@ using namespace DX12_Internal;
 		// Query features:
 
 		capabilities |= GRAPHICSDEVICE_CAPABILITY_TESSELLATION;
+		capabilities |= GRAPHICSDEVICE_CAPABILITY_RESOURCE_ALIASING;
+		capabilities |= GRAPHICSDEVICE_CAPABILITY_PIPELINE_STATISTICS;
 
 		hr = device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &features_0, sizeof(features_0));
 		if (features_0.ConservativeRasterizationTier >= D3D12_CONSERVATIVE_RASTERIZATION_TIER_1)
@@ -2899,6 +2989,10 @@ using namespace DX12_Internal;
 	GraphicsDevice_DX12::~GraphicsDevice_DX12()
 	{
 		WaitForGPU();
+		if (!pipeline_cache_filename.empty())
+		{
+			SavePipelineCache(pipeline_cache_filename);
+		}
 		copyAllocator.destroy();
 	}
 
@@ -2928,7 +3022,7 @@ using namespace DX12_Internal;
 			swapChainDesc.SampleDesc.Quality = 0;
 			swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
 			swapChainDesc.BufferCount = pDesc->buffercount;
-			swapChainDesc.Flags = 0;
+			swapChainDesc.Flags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
 			swapChainDesc.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
 			swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
 
@@ -2968,6 +3062,12 @@ using namespace DX12_Internal;
 			{
 				return false;
 			}
+
+			// The waitable swapchain would limit the latency to 1 frame by default, keep the usual latency until WaitForFrameLatency() asks for less:
+			internal_state->maxFrameLatency = BUFFERCOUNT;
+			hr = internal_state->swapChain->SetMaximumFrameLatency(internal_state->maxFrameLatency);
+			assert(SUCCEEDED(hr));
+			internal_state->frameLatencyWaitable = internal_state->swapChain->GetFrameLatencyWaitableObject();
 		}
 		else
 		{
@@ -2985,7 +3085,7 @@ using namespace DX12_Internal;
 				pDesc->width,
 				pDesc->height,
 				_ConvertFormat(pDesc->format),
-				0
+				DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT
 			);
 			assert(SUCCEEDED(hr));
 		}
@@ -3012,6 +3112,10 @@ using namespace DX12_Internal;
 		internal_state->renderpass = RenderPass();
 		wiHelper::hash_combine(internal_state->renderpass.hash, pDesc->format);
 		internal_state->renderpass.desc.attachments.push_back(RenderPassAttachment::RenderTarget(&internal_state->dummyTexture));
+		auto renderpass_internal = std::make_shared<RenderPass_DX12>();
+		compute_pipeline_formats(internal_state->renderpass.desc, *renderpass_internal);
+		internal_state->renderpass.internal_state = renderpass_internal;
+		RegisterPrewarmRenderPass(&internal_state->renderpass);
 
 		return true;
 	}
@@ -3061,6 +3165,22 @@ using namespace DX12_Internal;
 
 		HRESULT hr = E_FAIL;
 
+		if (pDesc->MiscFlags & RESOURCE_MISC_ALIASING_TEXTURE_NON_RT_DS)
+		{
+			// Only the heap memory is allocated, textures will be placed into it by CreateTexture():
+			D3D12MA::ALLOCATION_DESC allocationDesc = {};
+			allocationDesc.HeapType = D3D12_HEAP_TYPE_DEFAULT;
+			allocationDesc.ExtraHeapFlags = D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+
+			D3D12_RESOURCE_ALLOCATION_INFO allocationInfo = {};
+			allocationInfo.SizeInBytes = (UINT64)Align((size_t)pDesc->ByteWidth, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+			allocationInfo.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+
+			hr = allocationhandler->allocator->AllocateMemory(&allocationDesc, &allocationInfo, &internal_state->allocation);
+			assert(SUCCEEDED(hr));
+			return SUCCEEDED(hr);
+		}
+
 		size_t alignedSize = pDesc->ByteWidth;
 		if (pDesc->BindFlags & BIND_CONSTANT_BUFFER)
 		{
@@ -3113,6 +3233,10 @@ using namespace DX12_Internal;
 			IID_PPV_ARGS(&internal_state->resource)
 		);
 		assert(SUCCEEDED(hr));
+		if (SUCCEEDED(hr))
+		{
+			internal_state->memory.Set(wiMemoryTracker::TAG_GPU_BUFFER, (size_t)internal_state->allocation->GetSize());
+		}
 
 		internal_state->gpu_address = internal_state->resource->GetGPUVirtualAddress();
 
@@ -3151,7 +3275,7 @@ using namespace DX12_Internal;
 
 		return SUCCEEDED(hr);
 	}
-	bool GraphicsDevice_DX12::CreateTexture(const TextureDesc* pDesc, const SubresourceData* pInitialData, Texture* pTexture) const
+	bool GraphicsDevice_DX12::CreateTexture(const TextureDesc* pDesc, const SubresourceData* pInitialData, Texture* pTexture, const GPUBuffer* alias, uint64_t alias_offset) const
 	{
 		auto internal_state = std::make_shared<Texture_DX12>();
 		internal_state->allocationhandler = allocationhandler;
@@ -3271,15 +3395,49 @@ using namespace DX12_Internal;
 			}
 		}
 
-		hr = allocationhandler->allocator->CreateResource(
-			&allocationDesc,
-			&desc,
-			resourceState,
-			useClearValue ? &optimizedClearValue : nullptr,
-			&internal_state->allocation,
-			IID_PPV_ARGS(&internal_state->resource)
-		);
-		assert(SUCCEEDED(hr));
+		if (alias != nullptr)
+		{
+			// Placed into the aliasing buffer's heap, the texture doesn't own any memory:
+			assert(pInitialData == nullptr);
+			assert(!(pDesc->BindFlags & (BIND_RENDER_TARGET | BIND_DEPTH_STENCIL)));
+			assert(alias->desc.MiscFlags & RESOURCE_MISC_ALIASING_TEXTURE_NON_RT_DS);
+			auto alias_internal = to_internal(alias);
+			const D3D12_RESOURCE_ALLOCATION_INFO allocationInfo = device->GetResourceAllocationInfo(0, 1, &desc);
+			if (alias_internal->allocation == nullptr || alias_offset + allocationInfo.SizeInBytes > alias_internal->allocation->GetSize())
+			{
+				return false;
+			}
+			hr = allocationhandler->allocator->CreateAliasingResource(
+				alias_internal->allocation,
+				alias_offset,
+				&desc,
+				resourceState,
+				nullptr,
+				IID_PPV_ARGS(&internal_state->resource)
+			);
+			if (FAILED(hr))
+			{
+				return false;
+			}
+			internal_state->aliased_memory = alias->internal_state;
+		}
+		else
+		{
+			hr = allocationhandler->allocator->CreateResource(
+				&allocationDesc,
+				&desc,
+				resourceState,
+				useClearValue ? &optimizedClearValue : nullptr,
+				&internal_state->allocation,
+				IID_PPV_ARGS(&internal_state->resource)
+			);
+			assert(SUCCEEDED(hr));
+			if (SUCCEEDED(hr))
+			{
+				const bool rendertarget = pDesc->BindFlags & (BIND_RENDER_TARGET | BIND_DEPTH_STENCIL);
+				internal_state->memory.Set(rendertarget ? wiMemoryTracker::TAG_GPU_RENDERTARGET : wiMemoryTracker::TAG_GPU_TEXTURE, (size_t)internal_state->allocation->GetSize());
+			}
+		}
 
 		if (pTexture->desc.MipLevels == 0)
 		{
@@ -3351,6 +3509,71 @@ using namespace DX12_Internal;
 
 		return SUCCEEDED(hr);
 	}
+	uint64_t GraphicsDevice_DX12::GetTextureMemorySize(const TextureDesc* pDesc) const
+	{
+		D3D12_RESOURCE_DESC desc = {};
+		desc.Format = _ConvertFormat(pDesc->Format);
+		desc.Width = pDesc->Width;
+		desc.Height = pDesc->Height;
+		desc.MipLevels = pDesc->MipLevels;
+		desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+		desc.DepthOrArraySize = (UINT16)(pDesc->type == TextureDesc::TEXTURE_3D ? pDesc->Depth : pDesc->ArraySize);
+		desc.SampleDesc.Count = pDesc->SampleCount;
+		desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+		if (pDesc->BindFlags & BIND_UNORDERED_ACCESS)
+		{
+			desc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+		}
+		switch (pDesc->type)
+		{
+		case TextureDesc::TEXTURE_1D:
+			desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE1D;
+			break;
+		default:
+		case TextureDesc::TEXTURE_2D:
+			desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+			break;
+		case TextureDesc::TEXTURE_3D:
+			desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+			break;
+		}
+		return device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+	}
+	GraphicsDevice::MemoryBudget GraphicsDevice_DX12::GetMemoryBudget(MEMORY_HEAP heap) const
+	{
+		// The allocator queries IDXGIAdapter3::QueryVideoMemoryInfo for the local and non-local segment groups:
+		D3D12MA::Budget gpu_budget = {};
+		D3D12MA::Budget cpu_budget = {};
+		allocationhandler->allocator->GetBudget(&gpu_budget, &cpu_budget);
+		const D3D12MA::Budget& budget = heap == MEMORY_HEAP_DEVICE ? gpu_budget : cpu_budget;
+
+		MemoryBudget result;
+		result.usage = budget.UsageBytes;
+		result.budget = budget.BudgetBytes;
+		return result;
+	}
+	void GraphicsDevice_DX12::SetResidencyPriority(const GPUResource* resource, RESIDENCY_PRIORITY priority) const
+	{
+		if (resource == nullptr || !resource->IsValid())
+		{
+			return;
+		}
+		ID3D12Pageable* pageable = to_internal(resource)->resource.Get();
+		D3D12_RESIDENCY_PRIORITY value = D3D12_RESIDENCY_PRIORITY_NORMAL;
+		switch (priority)
+		{
+		case RESIDENCY_PRIORITY_LOW:
+			value = D3D12_RESIDENCY_PRIORITY_LOW;
+			break;
+		case RESIDENCY_PRIORITY_HIGH:
+			value = D3D12_RESIDENCY_PRIORITY_HIGH;
+			break;
+		default:
+			break;
+		}
+		HRESULT hr = device->SetResidencyPriority(1, &pageable, &value);
+		assert(SUCCEEDED(hr));
+	}
 	bool GraphicsDevice_DX12::CreateShader(SHADERSTAGE stage, const void* pShaderBytecode, size_t BytecodeLength, Shader* pShader) const
 	{
 		auto internal_state = std::make_shared<PipelineState_DX12>();
@@ -3359,6 +3582,7 @@ using namespace DX12_Internal;
 
 		internal_state->shadercode.resize(BytecodeLength);
 		std::memcpy(internal_state->shadercode.data(), pShaderBytecode, BytecodeLength);
+		internal_state->persistent_hash = HashBytes(pShaderBytecode, BytecodeLength);
 		pShader->stage = stage;
 
 		HRESULT hr = (internal_state->shadercode.empty() ? E_FAIL : S_OK);
@@ -3953,7 +4177,12 @@ using namespace DX12_Internal;
 		case GPU_QUERY_TYPE_OCCLUSION_BINARY:
 			desc.Type = D3D12_QUERY_HEAP_TYPE_OCCLUSION;
 			break;
+		case GPU_QUERY_TYPE_PIPELINE_STATISTICS:
+			desc.Type = D3D12_QUERY_HEAP_TYPE_PIPELINE_STATISTICS;
+			break;
 		}
+		static_assert(sizeof(D3D12_QUERY_DATA_PIPELINE_STATISTICS) == sizeof(PipelineStatistics), "PipelineStatistics must match D3D12_QUERY_DATA_PIPELINE_STATISTICS");
+		const size_t stride = pDesc->type == GPU_QUERY_TYPE_PIPELINE_STATISTICS ? sizeof(PipelineStatistics) : sizeof(uint64_t);
 
 		HRESULT hr = allocationhandler->device->CreateQueryHeap(&desc, IID_PPV_ARGS(&internal_state->heap));
 		assert(SUCCEEDED(hr));
@@ -3964,7 +4193,7 @@ using namespace DX12_Internal;
 		D3D12_RESOURCE_DESC resdesc = {};
 		resdesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
 		resdesc.Format = DXGI_FORMAT_UNKNOWN;
-		resdesc.Width = (UINT64)(desc.Count * sizeof(uint64_t));
+		resdesc.Width = (UINT64)(desc.Count * stride);
 		resdesc.Height = 1;
 		resdesc.MipLevels = 1;
 		resdesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
@@ -4008,6 +4237,11 @@ using namespace DX12_Internal;
 		wiHelper::hash_combine(pso->hash, pDesc->dss);
 		wiHelper::hash_combine(pso->hash, pDesc->pt);
 		wiHelper::hash_combine(pso->hash, pDesc->sampleMask);
+		// The shader states are also hashed, so the cached pipelines are not used after a shader was loaded again:
+		for (const Shader* shader : { pDesc->ms, pDesc->as, pDesc->vs, pDesc->ps, pDesc->hs, pDesc->ds, pDesc->gs })
+		{
+			wiHelper::hash_combine(pso->hash, shader == nullptr ? nullptr : shader->internal_state.get());
+		}
 
 		HRESULT hr = S_OK;
 
@@ -4485,6 +4719,9 @@ using namespace DX12_Internal;
 
 		stream.stream1.pRootSignature = internal_state->rootSignature.Get();
 
+		internal_state->persistent_hash = ComputePipelineStateKey(pso->desc);
+		RegisterPrewarmPipelineState(internal_state->persistent_hash, pso);
+
 		return SUCCEEDED(hr);
 	}
 	bool GraphicsDevice_DX12::CreateRenderPass(const RenderPassDesc* pDesc, RenderPass* renderpass) const
@@ -4713,6 +4950,9 @@ using namespace DX12_Internal;
 			}
 		}
 
+		compute_pipeline_formats(renderpass->desc, *internal_state);
+		RegisterPrewarmRenderPass(renderpass);
+
 		return true;
 	}
 	bool GraphicsDevice_DX12::CreateRaytracingAccelerationStructure(const RaytracingAccelerationStructureDesc* pDesc, RaytracingAccelerationStructure* bvh) const
@@ -4835,6 +5075,10 @@ using namespace DX12_Internal;
 			IID_PPV_ARGS(&internal_state->resource)
 		);
 		assert(SUCCEEDED(hr));
+		if (SUCCEEDED(hr))
+		{
+			internal_state->memory.Set(wiMemoryTracker::TAG_GPU_ACCELERATION_STRUCTURE, (size_t)internal_state->allocation->GetSize());
+		}
 
 		internal_state->gpu_address = internal_state->resource->GetGPUVirtualAddress();
 
@@ -4850,6 +5094,65 @@ using namespace DX12_Internal;
 
 		return CreateBuffer(&scratch_desc, nullptr, &internal_state->scratch);
 	}
+	bool GraphicsDevice_DX12::CreateRaytracingAccelerationStructureCompacted(const RaytracingAccelerationStructure* src, uint64_t size, RaytracingAccelerationStructure* bvh) const
+	{
+		auto src_internal = to_internal(src);
+		assert(src->desc._flags & RaytracingAccelerationStructureDesc::FLAG_ALLOW_COMPACTION);
+
+		auto internal_state = std::make_shared<BVH_DX12>();
+		internal_state->allocationhandler = allocationhandler;
+		internal_state->desc = src_internal->desc;
+		internal_state->geometries = src_internal->geometries;
+		internal_state->desc.pGeometryDescs = internal_state->geometries.data();
+		internal_state->info = src_internal->info;
+		internal_state->info.ResultDataMaxSizeInBytes = size;
+		bvh->internal_state = internal_state;
+		bvh->type = GPUResource::GPU_RESOURCE_TYPE::RAYTRACING_ACCELERATION_STRUCTURE;
+		bvh->desc = src->desc;
+
+		D3D12_RESOURCE_DESC desc;
+		desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		desc.Format = DXGI_FORMAT_UNKNOWN;
+		desc.Width = (UINT64)Align((size_t)size, (size_t)D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+		desc.Height = 1;
+		desc.MipLevels = 1;
+		desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+		desc.DepthOrArraySize = 1;
+		desc.Alignment = 0;
+		desc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+		desc.SampleDesc.Count = 1;
+		desc.SampleDesc.Quality = 0;
+
+		D3D12MA::ALLOCATION_DESC allocationDesc = {};
+		allocationDesc.HeapType = D3D12_HEAP_TYPE_DEFAULT;
+
+		HRESULT hr = allocationhandler->allocator->CreateResource(
+			&allocationDesc,
+			&desc,
+			D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
+			nullptr,
+			&internal_state->allocation,
+			IID_PPV_ARGS(&internal_state->resource)
+		);
+		assert(SUCCEEDED(hr));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+		internal_state->memory.Set(wiMemoryTracker::TAG_GPU_ACCELERATION_STRUCTURE, (size_t)internal_state->allocation->GetSize());
+
+		internal_state->gpu_address = internal_state->resource->GetGPUVirtualAddress();
+
+		D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
+		srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srv_desc.ViewDimension = D3D12_SRV_DIMENSION_RAYTRACING_ACCELERATION_STRUCTURE;
+		srv_desc.RaytracingAccelerationStructure.Location = internal_state->gpu_address;
+
+		internal_state->srv.init(this, srv_desc, nullptr);
+
+		// No scratch memory, the compacted acceleration structure is not built again
+		return true;
+	}
 	bool GraphicsDevice_DX12::CreateRaytracingPipelineState(const RaytracingPipelineStateDesc* pDesc, RaytracingPipelineState* rtpso) const
 	{
 		auto internal_state = std::make_shared<RTPipelineState_DX12>();
@@ -5561,16 +5864,18 @@ using namespace DX12_Internal;
 
 		auto internal_state = to_internal(heap);
 
+		const size_t stride = heap->desc.type == GPU_QUERY_TYPE_PIPELINE_STATISTICS ? sizeof(PipelineStatistics) : sizeof(uint64_t);
+
 		D3D12_RANGE range;
-		range.Begin = (size_t)index * sizeof(uint64_t);
-		range.End = range.Begin + sizeof(uint64_t) * count;
+		range.Begin = (size_t)index * stride;
+		range.End = range.Begin + stride * count;
 		D3D12_RANGE nullrange = {};
 		void* data = nullptr;
 
 		HRESULT hr = internal_state->resource->Map(0, &range, &data);
 		if (SUCCEEDED(hr))
 		{
-			std::memcpy(results, (void*)((size_t)data + range.Begin), sizeof(uint64_t) * count);
+			std::memcpy(results, (void*)((size_t)data + range.Begin), stride * count);
 			internal_state->resource->Unmap(0, &nullrange);
 		}
 	}
@@ -5746,6 +6051,24 @@ using namespace DX12_Internal;
 				pipelines_worker[cmd].clear();
 			}
 
+			// pipelines that were compiled by prewarming in the background:
+			pipelines_prewarmed_locker.lock();
+			for (auto& x : pipelines_prewarmed)
+			{
+				if (pipelines_global.count(x.first) == 0)
+				{
+					pipelines_global[x.first] = x.second;
+				}
+				else
+				{
+					allocationhandler->destroylocker.lock();
+					allocationhandler->destroyer_pipelines.push_back(std::make_pair(x.second, FRAMECOUNT));
+					allocationhandler->destroylocker.unlock();
+				}
+			}
+			pipelines_prewarmed.clear();
+			pipelines_prewarmed_locker.unlock();
+
 			// submit last cmd batch:
 			assert(submit_queue < QUEUE_COUNT);
 			assert(queues[submit_queue].submit_cmds > 0);
@@ -5804,6 +6127,8 @@ using namespace DX12_Internal;
 
 			allocationhandler->Update(FRAMECOUNT, BUFFERCOUNT);
 		}
+
+		ProcessReadbacks();
 	}
 
 	void GraphicsDevice_DX12::WaitForGPU() const
@@ -5824,6 +6149,39 @@ using namespace DX12_Internal;
 			fence->Signal(0);
 		}
 	}
+	void GraphicsDevice_DX12::WaitForFrameLatency(const SwapChain* swapchain, uint32_t maxFramesInFlight)
+	{
+		maxFramesInFlight = std::max(1u, std::min(maxFramesInFlight, GetBufferCount()));
+
+		// The frames before FRAMECOUNT - maxFramesInFlight must be finished (the older ones were already waited for by SubmitCommandLists()):
+		if (maxFramesInFlight < BUFFERCOUNT && FRAMECOUNT >= maxFramesInFlight)
+		{
+			auto& frame = frames[(FRAMECOUNT - maxFramesInFlight) % BUFFERCOUNT];
+			for (int queue = 0; queue < QUEUE_COUNT; ++queue)
+			{
+				if (frame.fence[queue]->GetCompletedValue() < 1)
+				{
+					HRESULT hr = frame.fence[queue]->SetEventOnCompletion(1, NULL);
+					assert(SUCCEEDED(hr));
+				}
+			}
+		}
+
+		if (swapchain != nullptr && swapchain->IsValid())
+		{
+			auto internal_state = to_internal(swapchain);
+			if (internal_state->maxFrameLatency != maxFramesInFlight)
+			{
+				HRESULT hr = internal_state->swapChain->SetMaximumFrameLatency(maxFramesInFlight);
+				assert(SUCCEEDED(hr));
+				internal_state->maxFrameLatency = maxFramesInFlight;
+			}
+			if (internal_state->frameLatencyWaitable != NULL)
+			{
+				WaitForSingleObjectEx(internal_state->frameLatencyWaitable, 1000, TRUE);
+			}
+		}
+	}
 	void GraphicsDevice_DX12::ClearPipelineStateCache()
 	{
 		allocationhandler->destroylocker.lock();
@@ -5850,9 +6208,89 @@ using namespace DX12_Internal;
 			}
 			pipelines_worker[i].clear();
 		}
+
+		pipelines_prewarmed_locker.lock();
+		for (auto& x : pipelines_prewarmed)
+		{
+			allocationhandler->destroyer_pipelines.push_back(std::make_pair(x.second, FRAMECOUNT));
+		}
+		pipelines_prewarmed.clear();
+		pipelines_prewarm_known.clear();
+		pipelines_prewarmed_locker.unlock();
 		allocationhandler->destroylocker.unlock();
 	}
 
+	bool GraphicsDevice_DX12::LoadPipelineCache(const std::string& filename)
+	{
+		pipeline_cache_filename = filename;
+
+		std::scoped_lock lock(pipeline_library_locker);
+		pipeline_library.Reset();
+		HRESULT hr = E_FAIL;
+		if (ReadPipelineCacheFile(filename, pipeline_cache_header, pipeline_library_data))
+		{
+			hr = device->CreatePipelineLibrary(pipeline_library_data.data(), pipeline_library_data.size(), IID_PPV_ARGS(&pipeline_library));
+			if (SUCCEEDED(hr))
+			{
+				return true;
+			}
+			// D3D12_ERROR_DRIVER_VERSION_MISMATCH, D3D12_ERROR_ADAPTER_NOT_FOUND or a corrupt file, a new library is started instead
+		}
+
+		pipeline_library_data.clear();
+		hr = device->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&pipeline_library));
+		if (FAILED(hr))
+		{
+			// Not supported by the OS/driver, the pipelines will be compiled without it:
+			pipeline_library.Reset();
+		}
+		return false;
+	}
+	bool GraphicsDevice_DX12::SavePipelineCache(const std::string& filename)
+	{
+		std::scoped_lock lock(pipeline_library_locker);
+		if (pipeline_library == nullptr)
+		{
+			return false;
+		}
+
+		std::vector<uint8_t> data(pipeline_library->GetSerializedSize());
+		HRESULT hr = pipeline_library->Serialize(data.data(), data.size());
+		if (FAILED(hr))
+		{
+			return false;
+		}
+		return WritePipelineCacheFile(filename, pipeline_cache_header, data.data(), data.size());
+	}
+	uint64_t GraphicsDevice_DX12::GetShaderHash(const Shader* shader) const
+	{
+		return to_internal(shader)->persistent_hash;
+	}
+	bool GraphicsDevice_DX12::CompilePrewarmPipeline(const PipelineState* pso, const RenderPass* renderpass, const PipelinePrewarmEntry& entry)
+	{
+		// Same key as the BindPipelineState() inside a render pass:
+		size_t pipeline_hash = 0;
+		wiHelper::hash_combine(pipeline_hash, pso->hash);
+		wiHelper::hash_combine(pipeline_hash, renderpass->hash);
+		{
+			// pipelines_global is only accessed by the recording threads, so the prewarmed pipelines are tracked separately:
+			std::scoped_lock lock(pipelines_prewarmed_locker);
+			if (!pipelines_prewarm_known.insert(pipeline_hash).second)
+			{
+				return false;
+			}
+		}
+
+		ComPtr<ID3D12PipelineState> newpso = create_pipeline(pso, renderpass);
+		if (newpso == nullptr)
+		{
+			return false;
+		}
+		std::scoped_lock lock(pipelines_prewarmed_locker);
+		pipelines_prewarmed.push_back(std::make_pair(pipeline_hash, newpso));
+		return true;
+	}
+
 	Texture GraphicsDevice_DX12::GetBackBuffer(const SwapChain* swapchain) const
 	{
 		auto swapchain_internal = to_internal(swapchain);
@@ -6311,6 +6749,15 @@ using namespace DX12_Internal;
 #ifdef GGREDUCED
 	void GraphicsDevice_DX12::CopyTexture2D_Region(const Texture* pDst, uint32_t dstMip, uint32_t dstX, uint32_t dstY, const Texture* pSrc, uint32_t srcMip, CommandList cmd)
 	{
+		barrier_flush(cmd);
+
+		assert(pDst != nullptr && pSrc != nullptr);
+		auto internal_state_src = to_internal(pSrc);
+		auto internal_state_dst = to_internal(pDst);
+
+		CD3DX12_TEXTURE_COPY_LOCATION Dst(internal_state_dst->resource.Get(), D3D12CalcSubresource(dstMip, 0, 0, pDst->desc.MipLevels, pDst->desc.ArraySize));
+		CD3DX12_TEXTURE_COPY_LOCATION Src(internal_state_src->resource.Get(), D3D12CalcSubresource(srcMip, 0, 0, pSrc->desc.MipLevels, pSrc->desc.ArraySize));
+		GetCommandList(cmd)->CopyTextureRegion(&Dst, dstX, dstY, 0, &Src, nullptr);
 	}
 	void GraphicsDevice_DX12::MSAAResolve(const Texture* pDst, const Texture* pSrc, CommandList cmd)
 	{
@@ -6329,18 +6776,19 @@ using namespace DX12_Internal;
 		return NULL;
 	}
 #endif
-	void GraphicsDevice_DX12::UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize)
+	void GraphicsDevice_DX12::UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize, uint32_t dstOffset)
 	{
 		assert(buffer->desc.Usage != USAGE_IMMUTABLE && "Cannot update IMMUTABLE GPUBuffer!");
-		assert((int)buffer->desc.ByteWidth >= dataSize || dataSize < 0 && "Data size is too big!");
+		assert(dstOffset <= buffer->desc.ByteWidth && "Offset is out of bounds!");
+		assert((int)(buffer->desc.ByteWidth - dstOffset) >= dataSize || dataSize < 0 && "Data size is too big!");
 
 		if (dataSize == 0)
 		{
 			return;
 		}
 
-		dataSize = std::min((int)buffer->desc.ByteWidth, dataSize);
-		dataSize = (dataSize >= 0 ? dataSize : buffer->desc.ByteWidth);
+		dataSize = std::min((int)(buffer->desc.ByteWidth - dstOffset), dataSize);
+		dataSize = (dataSize >= 0 ? dataSize : buffer->desc.ByteWidth - dstOffset);
 
 		auto internal_state_dst = to_internal(buffer);
 
@@ -6350,6 +6798,7 @@ using namespace DX12_Internal;
 		if (buffer->desc.Usage == USAGE_DYNAMIC && buffer->desc.BindFlags & BIND_CONSTANT_BUFFER)
 		{
 			// Dynamic buffer will be used from host memory directly:
+			assert(dstOffset == 0 && "Dynamic buffer can only be updated entirely!");
 			internal_state_dst->dynamic[cmd] = allocation;
 
 			// The proper binding slot is not tracked properly, but instead all the previous bindings are invalidated:
@@ -6383,7 +6832,7 @@ using namespace DX12_Internal;
 			barrier_flush(cmd);
 
 			GetCommandList(cmd)->CopyBufferRegion(
-				internal_state_dst->resource.Get(), 0,
+				internal_state_dst->resource.Get(), dstOffset,
 				internal_state_src->resource.Get(), allocation.offset,
 				dataSize
 			);
@@ -6422,6 +6871,13 @@ using namespace DX12_Internal;
 				index
 			);
 			break;
+		case GPU_QUERY_TYPE_PIPELINE_STATISTICS:
+			GetCommandList(cmd)->BeginQuery(
+				internal_state->heap.Get(),
+				D3D12_QUERY_TYPE_PIPELINE_STATISTICS,
+				index
+			);
+			break;
 		}
 	}
 	void GraphicsDevice_DX12::QueryEnd(const GPUQueryHeap* heap, uint32_t index, CommandList cmd)
@@ -6451,6 +6907,13 @@ using namespace DX12_Internal;
 				index
 			);
 			break;
+		case GPU_QUERY_TYPE_PIPELINE_STATISTICS:
+			GetCommandList(cmd)->EndQuery(
+				internal_state->heap.Get(),
+				D3D12_QUERY_TYPE_PIPELINE_STATISTICS,
+				index
+			);
+			break;
 		}
 	}
 	void GraphicsDevice_DX12::QueryResolve(const GPUQueryHeap* heap, uint32_t index, uint32_t count, CommandList cmd)
@@ -6517,6 +6980,14 @@ using namespace DX12_Internal;
 				barrierdesc.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
 			}
 			break;
+			case GPUBarrier::ALIASING_BARRIER:
+			{
+				barrierdesc.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+				barrierdesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+				barrierdesc.Aliasing.pResourceBefore = barrier.aliasing.resource_before == nullptr ? nullptr : to_internal(barrier.aliasing.resource_before)->resource.Get();
+				barrierdesc.Aliasing.pResourceAfter = barrier.aliasing.resource_after == nullptr ? nullptr : to_internal(barrier.aliasing.resource_after)->resource.Get();
+			}
+			break;
 			}
 
 			// Try to detect redundant barriers:
@@ -6527,6 +6998,10 @@ using namespace DX12_Internal;
 				{
 					switch (x.Type)
 					{
+					case D3D12_RESOURCE_BARRIER_TYPE_ALIASING:
+						found = x.Aliasing.pResourceBefore == barrierdesc.Aliasing.pResourceBefore &&
+							x.Aliasing.pResourceAfter == barrierdesc.Aliasing.pResourceAfter;
+						break;
 					default:
 					case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
 						if (x.Transition.pResource == barrierdesc.Transition.pResource &&
@@ -6547,6 +7022,42 @@ using namespace DX12_Internal;
 			}
 		}
 	}
+	void GraphicsDevice_DX12::BarrierBegin(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd)
+	{
+		// The pending barriers are not split, so they are recorded first, then only the new ones remain:
+		barrier_flush(cmd);
+		Barrier(barriers, numBarriers, cmd);
+
+		auto& barrierdescs = frame_barriers[cmd];
+		for (size_t i = 0; i < barrierdescs.size(); ++i)
+		{
+			auto& barrierdesc = barrierdescs[i];
+			if (barrierdesc.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+			{
+				barrierdesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+			}
+			else
+			{
+				// Only transitions can be split, the others are performed by BarrierEnd():
+				barrierdesc = barrierdescs.back();
+				barrierdescs.pop_back();
+				i--;
+			}
+		}
+	}
+	void GraphicsDevice_DX12::BarrierEnd(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd)
+	{
+		barrier_flush(cmd);
+		Barrier(barriers, numBarriers, cmd);
+
+		for (auto& barrierdesc : frame_barriers[cmd])
+		{
+			if (barrierdesc.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+			{
+				barrierdesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+			}
+		}
+	}
 	void GraphicsDevice_DX12::BuildRaytracingAccelerationStructure(const RaytracingAccelerationStructure* dst, CommandList cmd, const RaytracingAccelerationStructure* src)
 	{
 		barrier_flush(cmd);
@@ -6619,6 +7130,26 @@ using namespace DX12_Internal;
 		desc.ScratchAccelerationStructureData = to_internal(&dst_internal->scratch)->gpu_address;
 		GetCommandList(cmd)->BuildRaytracingAccelerationStructure(&desc, 0, nullptr);
 	}
+	void GraphicsDevice_DX12::WriteRaytracingAccelerationStructureCompactedSize(const RaytracingAccelerationStructure* bvh, const GPUBuffer* dest, uint64_t dest_offset, CommandList cmd)
+	{
+		barrier_flush(cmd);
+
+		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC desc = {};
+		desc.InfoType = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE;
+		desc.DestBuffer = to_internal(dest)->gpu_address + (D3D12_GPU_VIRTUAL_ADDRESS)dest_offset;
+		D3D12_GPU_VIRTUAL_ADDRESS address = to_internal(bvh)->gpu_address;
+		GetCommandList(cmd)->EmitRaytracingAccelerationStructurePostbuildInfo(&desc, 1, &address);
+	}
+	void GraphicsDevice_DX12::CompactRaytracingAccelerationStructure(const RaytracingAccelerationStructure* dst, const RaytracingAccelerationStructure* src, CommandList cmd)
+	{
+		barrier_flush(cmd);
+
+		GetCommandList(cmd)->CopyRaytracingAccelerationStructure(
+			to_internal(dst)->gpu_address,
+			to_internal(src)->gpu_address,
+			D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_COMPACT
+		);
+	}
 	void GraphicsDevice_DX12::BindRaytracingPipelineState(const RaytracingPipelineState* rtpso, CommandList cmd)
 	{
 		active_cs[cmd] = nullptr;
@@ -19,6 +19,7 @@
 #include "Utility/D3D12MemAlloc.h"
 
 #include <unordered_map>
+#include <unordered_set>
 #include <deque>
 #include <atomic>
 #include <mutex>
@@ -176,6 +177,9 @@ namespace wiGraphics
 
 		std::unordered_map<size_t, Microsoft::WRL::ComPtr<ID3D12PipelineState>> pipelines_global;
 		std::vector<std::pair<size_t, Microsoft::WRL::ComPtr<ID3D12PipelineState>>> pipelines_worker[COMMANDLIST_COUNT];
+		std::mutex pipelines_prewarmed_locker;
+		std::vector<std::pair<size_t, Microsoft::WRL::ComPtr<ID3D12PipelineState>>> pipelines_prewarmed; // merged into pipelines_global in SubmitCommandLists()
+		std::unordered_set<size_t> pipelines_prewarm_known;
 		size_t prev_pipeline_hash[COMMANDLIST_COUNT] = {};
 		const PipelineState* active_pso[COMMANDLIST_COUNT] = {};
 		const Shader* active_cs[COMMANDLIST_COUNT] = {};
@@ -196,6 +200,17 @@ namespace wiGraphics
 
 		bool dirty_pso[COMMANDLIST_COUNT] = {};
 		void pso_validate(CommandList cmd);
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> create_pipeline(const PipelineState* pso, const RenderPass* renderpass);
+
+		// Persistent pipeline cache:
+		Microsoft::WRL::ComPtr<ID3D12PipelineLibrary1> pipeline_library;
+		std::vector<uint8_t> pipeline_library_data; // the library references this memory, so it must outlive it
+		std::mutex pipeline_library_locker;
+		std::string pipeline_cache_filename;
+		PipelineCacheHeader pipeline_cache_header;
+
+		uint64_t GetShaderHash(const Shader* shader) const override;
+		bool CompilePrewarmPipeline(const PipelineState* pso, const RenderPass* renderpass, const PipelinePrewarmEntry& entry) override;
 
 		void query_flush(CommandList cmd);
 		void barrier_flush(CommandList cmd);
@@ -229,13 +244,14 @@ namespace wiGraphics
 
 		bool CreateSwapChain(const SwapChainDesc* pDesc, wiPlatform::window_type window, SwapChain* swapChain) const override;
 		bool CreateBuffer(const GPUBufferDesc *pDesc, const SubresourceData* pInitialData, GPUBuffer *pBuffer) const override;
-		bool CreateTexture(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture *pTexture) const override;
+		bool CreateTexture(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture *pTexture, const GPUBuffer* alias = nullptr, uint64_t alias_offset = 0) const override;
 		bool CreateShader(SHADERSTAGE stage, const void *pShaderBytecode, size_t BytecodeLength, Shader *pShader) const override;
 		bool CreateSampler(const SamplerDesc *pSamplerDesc, Sampler *pSamplerState) const override;
 		bool CreateQueryHeap(const GPUQueryHeapDesc* pDesc, GPUQueryHeap* pQueryHeap) const override;
 		bool CreatePipelineState(const PipelineStateDesc* pDesc, PipelineState* pso) const override;
 		bool CreateRenderPass(const RenderPassDesc* pDesc, RenderPass* renderpass) const override;
 		bool CreateRaytracingAccelerationStructure(const RaytracingAccelerationStructureDesc* pDesc, RaytracingAccelerationStructure* bvh) const override;
+		bool CreateRaytracingAccelerationStructureCompacted(const RaytracingAccelerationStructure* src, uint64_t size, RaytracingAccelerationStructure* bvh) const override;
 		bool CreateRaytracingPipelineState(const RaytracingPipelineStateDesc* pDesc, RaytracingPipelineState* rtpso) const override;
 		
 		int CreateSubresource(Texture* texture, SUBRESOURCE_TYPE type, uint32_t firstSlice, uint32_t sliceCount, uint32_t firstMip, uint32_t mipCount) const override;
@@ -261,8 +277,15 @@ namespace wiGraphics
 
 		void WaitForGPU() const override;
 		void ClearPipelineStateCache() override;
+		void WaitForFrameLatency(const SwapChain* swapchain, uint32_t maxFramesInFlight) override;
+
+		bool LoadPipelineCache(const std::string& filename) override;
+		bool SavePipelineCache(const std::string& filename) override;
 
 		SHADERFORMAT GetShaderFormat() const override { return SHADERFORMAT_HLSL6; }
+		uint64_t GetTextureMemorySize(const TextureDesc* pDesc) const override;
+		MemoryBudget GetMemoryBudget(MEMORY_HEAP heap) const override;
+		void SetResidencyPriority(const GPUResource* resource, RESIDENCY_PRIORITY priority) const override;
 
 		Texture GetBackBuffer(const SwapChain* swapchain) const override;
 
@@ -308,12 +331,16 @@ namespace wiGraphics
 		void CopyBufferRegion(const GPUBuffer* pDst, uint32_t dstOffset, const GPUBuffer* pSrc, uint32_t srcOffset, uint32_t srcLength, CommandList cmd) override;
 		char* GetGraphicsCardName(void) override;
 #endif
-		void UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize = -1) override;
+		void UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize = -1, uint32_t dstOffset = 0) override;
 		void QueryBegin(const GPUQueryHeap* heap, uint32_t index, CommandList cmd) override;
 		void QueryEnd(const GPUQueryHeap* heap, uint32_t index, CommandList cmd) override;
 		void QueryResolve(const GPUQueryHeap* heap, uint32_t index, uint32_t count, CommandList cmd) override;
 		void Barrier(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd) override;
+		void BarrierBegin(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd) override;
+		void BarrierEnd(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd) override;
 		void BuildRaytracingAccelerationStructure(const RaytracingAccelerationStructure* dst, CommandList cmd, const RaytracingAccelerationStructure* src = nullptr) override;
+		void WriteRaytracingAccelerationStructureCompactedSize(const RaytracingAccelerationStructure* bvh, const GPUBuffer* dest, uint64_t dest_offset, CommandList cmd) override;
+		void CompactRaytracingAccelerationStructure(const RaytracingAccelerationStructure* dst, const RaytracingAccelerationStructure* src, CommandList cmd) override;
 		void BindRaytracingPipelineState(const RaytracingPipelineState* rtpso, CommandList cmd) override;
 		void DispatchRays(const DispatchRaysDesc* desc, CommandList cmd) override;
 		void PushConstants(const void* data, uint32_t size, CommandList cmd) override;
@@ -10,6 +10,8 @@
 #include "wiGraphicsDevice_SharedInternals.h"
 #include "wiHelper.h"
 #include "wiBackLog.h"
+#include "wiProfiler.h"
+#include "wiMemoryTracker.h"
 #include "wiVersion.h"
 
 #define VMA_IMPLEMENTATION
@@ -659,6 +661,7 @@ namespace Vulkan_Internal
 		std::vector<int> subresources_uav_index;
 		VkDeviceAddress address = 0;
 		bool is_typedbuffer = false;
+		wiMemoryTracker::ScopedAllocation memory;
 
 		GraphicsDevice::GPUAllocation dynamic[COMMANDLIST_COUNT];
 
@@ -731,6 +734,9 @@ namespace Vulkan_Internal
 		std::vector<uint32_t> subresources_framebuffer_layercount;
 
 		VkSubresourceLayout subresourcelayout = {};
+		wiMemoryTracker::ScopedAllocation memory;
+
+		std::shared_ptr<void> aliased_memory; // keeps the aliasing buffer alive while the texture is bound to its memory
 
 		~Texture_Vulkan()
 		{
@@ -823,6 +829,7 @@ namespace Vulkan_Internal
 		VkPushConstantRange pushconstants = {};
 
 		size_t binding_hash = 0;
+		uint64_t persistent_hash = 0; // hash of the bytecode
 
 		~Shader_Vulkan()
 		{
@@ -850,6 +857,7 @@ namespace Vulkan_Internal
 		VkPushConstantRange pushconstants = {};
 
 		size_t binding_hash = 0;
+		uint64_t persistent_hash = 0; // key that is valid across sessions
 
 		VkGraphicsPipelineCreateInfo pipelineInfo = {};
 		VkPipelineShaderStageCreateInfo shaderStages[SHADERSTAGE_COUNT] = {};
@@ -871,6 +879,11 @@ namespace Vulkan_Internal
 		VkRenderPassBeginInfo beginInfo = {};
 		VkClearValue clearColors[9] = {};
 
+		// The attachment properties that the pipelines are compiled with:
+		VkSampleCountFlagBits pipeline_samples = VK_SAMPLE_COUNT_1_BIT;
+		uint32_t pipeline_rendertargets[8] = {}; // attachment indices of the render targets
+		uint32_t pipeline_rendertarget_count = 0;
+
 		~RenderPass_Vulkan()
 		{
 			if (allocationhandler == nullptr)
@@ -897,6 +910,8 @@ namespace Vulkan_Internal
 		std::vector<uint32_t> primitiveCounts;
 		VkDeviceAddress scratch_address = 0;
 		VkDeviceAddress as_address = 0;
+		VkQueryPool compactedsize_pool = VK_NULL_HANDLE; // only with FLAG_ALLOW_COMPACTION
+		wiMemoryTracker::ScopedAllocation memory;
 
 		~BVH_Vulkan()
 		{
@@ -906,6 +921,7 @@ namespace Vulkan_Internal
 			uint64_t framecount = allocationhandler->framecount;
 			if (buffer) allocationhandler->destroyer_buffers.push_back(std::make_pair(std::make_pair(buffer, allocation), framecount));
 			if (resource) allocationhandler->destroyer_bvhs.push_back(std::make_pair(resource, framecount));
+			if (compactedsize_pool) allocationhandler->destroyer_querypools.push_back(std::make_pair(compactedsize_pool, framecount));
 			if (index >= 0) allocationhandler->destroyer_bindlessAccelerationStructures.push_back(std::make_pair(index, framecount));
 			allocationhandler->destroylocker.unlock();
 		}
@@ -1000,6 +1016,22 @@ namespace Vulkan_Internal
 	{
 		return static_cast<SwapChain_Vulkan*>(param->internal_state.get());
 	}
+
+	inline const GPUResource* GetBarrierResource(const GPUBarrier& barrier)
+	{
+		switch (barrier.type)
+		{
+		case GPUBarrier::IMAGE_BARRIER:
+			return barrier.image.texture;
+		case GPUBarrier::BUFFER_BARRIER:
+			return barrier.buffer.buffer;
+		case GPUBarrier::ALIASING_BARRIER:
+			return barrier.aliasing.resource_after;
+		default:
+		case GPUBarrier::MEMORY_BARRIER:
+			return barrier.memory.resource;
+		}
+	}
 }
 using namespace Vulkan_Internal;
 
@@ -1022,6 +1054,8 @@ using namespace Vulkan_Internal;
 
 		VkResult res = vkCreateSemaphore(device->device, &createInfo, nullptr, &semaphore);
 		assert(res == VK_SUCCESS);
+
+		dedicated = device->copyQueue != device->graphicsQueue && device->copyQueue != device->computeQueue;
 	}
 	void GraphicsDevice_Vulkan::CopyAllocator::destroy()
 	{
@@ -1114,17 +1148,21 @@ using namespace Vulkan_Internal;
 
 		// It was very slow in Vulkan to submit the copies immediately
 		//	In Vulkan, the submit is not thread safe, so it had to be locked
-		//	Instead, the submits are batched and performed in flush() function
+		//	Instead, the submits are batched and performed in flush() function, or when a batch is full on a dedicated queue
 		locker.lock();
 		cmd.target = ++fenceValue;
 		worklist.push_back(cmd);
 		submit_cmds.push_back(cmd.commandBuffer);
 		submit_wait = std::max(submit_wait, cmd.target);
+		submit_bytes += cmd.uploadbuffer.desc.ByteWidth;
+		if (dedicated && submit_bytes >= SUBMIT_BATCH_BYTES)
+		{
+			submit_batch();
+		}
 		locker.unlock();
 	}
-	uint64_t GraphicsDevice_Vulkan::CopyAllocator::flush()
+	void GraphicsDevice_Vulkan::CopyAllocator::submit_batch()
 	{
-		locker.lock();
 		if (!submit_cmds.empty())
 		{
 			VkSubmitInfo submitInfo = {};
@@ -1140,7 +1178,7 @@ using namespace Vulkan_Internal;
 			timelineInfo.waitSemaphoreValueCount = 0;
 			timelineInfo.pWaitSemaphoreValues = nullptr;
 			timelineInfo.signalSemaphoreValueCount = 1;
-			timelineInfo.pSignalSemaphoreValues = &submit_wait;
+			timelineInfo.pSignalSemaphoreValues = &fenceValue; // the batch holds every copy up to the last one
 
 			submitInfo.pNext = &timelineInfo;
 
@@ -1149,6 +1187,12 @@ using namespace Vulkan_Internal;
 
 			submit_cmds.clear();
 		}
+		submit_bytes = 0;
+	}
+	uint64_t GraphicsDevice_Vulkan::CopyAllocator::flush()
+	{
+		locker.lock();
+		submit_batch();
 
 		// free up the finished command lists:
 		uint64_t completed_fence_value;
@@ -1165,6 +1209,26 @@ using namespace Vulkan_Internal;
 			}
 		}
 
+		// A burst of streaming shouldn't keep its staging memory forever, the largest buffers are released first:
+		uint64_t pooled_bytes = 0;
+		for (auto& x : freelist)
+		{
+			pooled_bytes += x.uploadbuffer.desc.ByteWidth;
+		}
+		if (pooled_bytes > STAGING_POOL_BYTES)
+		{
+			std::sort(freelist.begin(), freelist.end(), [](const CopyCMD& a, const CopyCMD& b) {
+				return a.uploadbuffer.desc.ByteWidth < b.uploadbuffer.desc.ByteWidth;
+			});
+			for (auto it = freelist.rbegin(); it != freelist.rend() && pooled_bytes > STAGING_POOL_BYTES; ++it)
+			{
+				pooled_bytes -= it->uploadbuffer.desc.ByteWidth;
+				it->uploadbuffer = {}; // the destruction is deferred by the allocation handler
+				it->data = nullptr;
+				it->upload_resource = VK_NULL_HANDLE;
+			}
+		}
+
 		uint64_t value = submit_wait;
 		submit_wait = 0;
 		locker.unlock();
@@ -1762,6 +1826,154 @@ using namespace Vulkan_Internal;
 		);
 	}
 
+	VkPipeline GraphicsDevice_Vulkan::create_pipeline(const PipelineState* pso, const RenderPass* renderpass, const uint32_t* vertex_strides)
+	{
+		auto internal_state = to_internal(pso);
+		auto renderpass_internal = to_internal(renderpass);
+		VkPipeline pipeline = VK_NULL_HANDLE;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo = internal_state->pipelineInfo; // make a copy here
+		pipelineInfo.renderPass = renderpass_internal->renderpass;
+		pipelineInfo.subpass = 0;
+
+		// MSAA:
+		VkPipelineMultisampleStateCreateInfo multisampling = {};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.sampleShadingEnable = VK_FALSE;
+		multisampling.rasterizationSamples = renderpass_internal->pipeline_samples;
+		if (pso->desc.rs != nullptr)
+		{
+			const RasterizerState& desc = *pso->desc.rs;
+			if (desc.ForcedSampleCount > 1)
+			{
+				multisampling.rasterizationSamples = (VkSampleCountFlagBits)desc.ForcedSampleCount;
+			}
+		}
+		multisampling.minSampleShading = 1.0f;
+		VkSampleMask samplemask = internal_state->samplemask;
+		samplemask = pso->desc.sampleMask;
+		multisampling.pSampleMask = &samplemask;
+		multisampling.alphaToCoverageEnable = VK_FALSE;
+		multisampling.alphaToOneEnable = VK_FALSE;
+
+		pipelineInfo.pMultisampleState = &multisampling;
+
+
+		// Blending:
+		uint32_t numBlendAttachments = 0;
+		VkPipelineColorBlendAttachmentState colorBlendAttachments[8] = {};
+		for (uint32_t rt = 0; rt < renderpass_internal->pipeline_rendertarget_count; ++rt)
+		{
+			const uint32_t i = renderpass_internal->pipeline_rendertargets[rt];
+
+			size_t attachmentIndex = 0;
+			if (pso->desc.bs->IndependentBlendEnable)
+				attachmentIndex = i;
+
+			const auto& desc = pso->desc.bs->RenderTarget[attachmentIndex];
+			VkPipelineColorBlendAttachmentState& attachment = colorBlendAttachments[numBlendAttachments];
+			numBlendAttachments++;
+
+			attachment.blendEnable = desc.BlendEnable ? VK_TRUE : VK_FALSE;
+
+			attachment.colorWriteMask = 0;
+			if (desc.RenderTargetWriteMask & COLOR_WRITE_ENABLE_RED)
+			{
+				attachment.colorWriteMask |= VK_COLOR_COMPONENT_R_BIT;
+			}
+			if (desc.RenderTargetWriteMask & COLOR_WRITE_ENABLE_GREEN)
+			{
+				attachment.colorWriteMask |= VK_COLOR_COMPONENT_G_BIT;
+			}
+			if (desc.RenderTargetWriteMask & COLOR_WRITE_ENABLE_BLUE)
+			{
+				attachment.colorWriteMask |= VK_COLOR_COMPONENT_B_BIT;
+			}
+			if (desc.RenderTargetWriteMask & COLOR_WRITE_ENABLE_ALPHA)
+			{
+				attachment.colorWriteMask |= VK_COLOR_COMPONENT_A_BIT;
+			}
+
+			attachment.srcColorBlendFactor = _ConvertBlend(desc.SrcBlend);
+			attachment.dstColorBlendFactor = _ConvertBlend(desc.DestBlend);
+			attachment.colorBlendOp = _ConvertBlendOp(desc.BlendOp);
+			attachment.srcAlphaBlendFactor = _ConvertBlend(desc.SrcBlendAlpha);
+			attachment.dstAlphaBlendFactor = _ConvertBlend(desc.DestBlendAlpha);
+			attachment.alphaBlendOp = _ConvertBlendOp(desc.BlendOpAlpha);
+		}
+
+		VkPipelineColorBlendStateCreateInfo colorBlending = {};
+		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlending.logicOpEnable = VK_FALSE;
+		colorBlending.logicOp = VK_LOGIC_OP_COPY;
+		colorBlending.attachmentCount = numBlendAttachments;
+		colorBlending.pAttachments = colorBlendAttachments;
+		colorBlending.blendConstants[0] = 1.0f;
+		colorBlending.blendConstants[1] = 1.0f;
+		colorBlending.blendConstants[2] = 1.0f;
+		colorBlending.blendConstants[3] = 1.0f;
+
+		pipelineInfo.pColorBlendState = &colorBlending;
+
+		// Input layout:
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		std::vector<VkVertexInputBindingDescription> bindings;
+		std::vector<VkVertexInputAttributeDescription> attributes;
+		if (pso->desc.il != nullptr)
+		{
+			uint32_t lastBinding = 0xFFFFFFFF;
+			for (auto& x : pso->desc.il->elements)
+			{
+				if (x.InputSlot == lastBinding)
+					continue;
+				lastBinding = x.InputSlot;
+				VkVertexInputBindingDescription& bind = bindings.emplace_back();
+				bind.binding = x.InputSlot;
+				bind.inputRate = x.InputSlotClass == INPUT_PER_VERTEX_DATA ? VK_VERTEX_INPUT_RATE_VERTEX : VK_VERTEX_INPUT_RATE_INSTANCE;
+				bind.stride = vertex_strides[x.InputSlot];
+			}
+
+			uint32_t offset = 0;
+			uint32_t i = 0;
+			lastBinding = 0xFFFFFFFF;
+			for (auto& x : pso->desc.il->elements)
+			{
+				VkVertexInputAttributeDescription attr = {};
+				attr.binding = x.InputSlot;
+				if (attr.binding != lastBinding)
+				{
+					lastBinding = attr.binding;
+					offset = 0;
+				}
+				attr.format = _ConvertFormat(x.Format);
+				attr.location = i;
+				attr.offset = x.AlignedByteOffset;
+				if (attr.offset == InputLayout::APPEND_ALIGNED_ELEMENT)
+				{
+					// need to manually resolve this from the format spec.
+					attr.offset = offset;
+					offset += GetFormatStride(x.Format);
+				}
+
+				attributes.push_back(attr);
+
+				i++;
+			}
+
+			vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
+			vertexInputInfo.pVertexBindingDescriptions = bindings.data();
+			vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+			vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
+		}
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+
+		wiProfiler::MarkEvent("Pipeline State Creation");
+		VkResult res = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+		assert(res == VK_SUCCESS);
+
+		return pipeline;
+	}
 	void GraphicsDevice_Vulkan::pso_validate(CommandList cmd)
 	{
 		if (!dirty_pso[cmd])
@@ -1787,152 +1999,8 @@ using namespace Vulkan_Internal;
 
 			if (pipeline == VK_NULL_HANDLE)
 			{
-				VkGraphicsPipelineCreateInfo pipelineInfo = internal_state->pipelineInfo; // make a copy here
-				pipelineInfo.renderPass = to_internal(active_renderpass[cmd])->renderpass;
-				pipelineInfo.subpass = 0;
-
-				// MSAA:
-				VkPipelineMultisampleStateCreateInfo multisampling = {};
-				multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-				multisampling.sampleShadingEnable = VK_FALSE;
-				multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-				if (active_renderpass[cmd]->desc.attachments.size() > 0 && active_renderpass[cmd]->desc.attachments[0].texture != nullptr)
-				{
-					multisampling.rasterizationSamples = (VkSampleCountFlagBits)active_renderpass[cmd]->desc.attachments[0].texture->desc.SampleCount;
-				}
-				if (pso->desc.rs != nullptr)
-				{
-					const RasterizerState& desc = *pso->desc.rs;
-					if (desc.ForcedSampleCount > 1)
-					{
-						multisampling.rasterizationSamples = (VkSampleCountFlagBits)desc.ForcedSampleCount;
-					}
-				}
-				multisampling.minSampleShading = 1.0f;
-				VkSampleMask samplemask = internal_state->samplemask;
-				samplemask = pso->desc.sampleMask;
-				multisampling.pSampleMask = &samplemask;
-				multisampling.alphaToCoverageEnable = VK_FALSE;
-				multisampling.alphaToOneEnable = VK_FALSE;
-
-				pipelineInfo.pMultisampleState = &multisampling;
-
-
-				// Blending:
-				uint32_t numBlendAttachments = 0;
-				VkPipelineColorBlendAttachmentState colorBlendAttachments[8] = {};
-				const size_t blend_loopCount = active_renderpass[cmd]->desc.attachments.size();
-				for (size_t i = 0; i < blend_loopCount; ++i)
-				{
-					if (active_renderpass[cmd]->desc.attachments[i].type != RenderPassAttachment::RENDERTARGET)
-					{
-						continue;
-					}
-
-					size_t attachmentIndex = 0;
-					if (pso->desc.bs->IndependentBlendEnable)
-						attachmentIndex = i;
-
-					const auto& desc = pso->desc.bs->RenderTarget[attachmentIndex];
-					VkPipelineColorBlendAttachmentState& attachment = colorBlendAttachments[numBlendAttachments];
-					numBlendAttachments++;
-
-					attachment.blendEnable = desc.BlendEnable ? VK_TRUE : VK_FALSE;
-
-					attachment.colorWriteMask = 0;
-					if (desc.RenderTargetWriteMask & COLOR_WRITE_ENABLE_RED)
-					{
-						attachment.colorWriteMask |= VK_COLOR_COMPONENT_R_BIT;
-					}
-					if (desc.RenderTargetWriteMask & COLOR_WRITE_ENABLE_GREEN)
-					{
-						attachment.colorWriteMask |= VK_COLOR_COMPONENT_G_BIT;
-					}
-					if (desc.RenderTargetWriteMask & COLOR_WRITE_ENABLE_BLUE)
-					{
-						attachment.colorWriteMask |= VK_COLOR_COMPONENT_B_BIT;
-					}
-					if (desc.RenderTargetWriteMask & COLOR_WRITE_ENABLE_ALPHA)
-					{
-						attachment.colorWriteMask |= VK_COLOR_COMPONENT_A_BIT;
-					}
-
-					attachment.srcColorBlendFactor = _ConvertBlend(desc.SrcBlend);
-					attachment.dstColorBlendFactor = _ConvertBlend(desc.DestBlend);
-					attachment.colorBlendOp = _ConvertBlendOp(desc.BlendOp);
-					attachment.srcAlphaBlendFactor = _ConvertBlend(desc.SrcBlendAlpha);
-					attachment.dstAlphaBlendFactor = _ConvertBlend(desc.DestBlendAlpha);
-					attachment.alphaBlendOp = _ConvertBlendOp(desc.BlendOpAlpha);
-				}
-
-				VkPipelineColorBlendStateCreateInfo colorBlending = {};
-				colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-				colorBlending.logicOpEnable = VK_FALSE;
-				colorBlending.logicOp = VK_LOGIC_OP_COPY;
-				colorBlending.attachmentCount = numBlendAttachments;
-				colorBlending.pAttachments = colorBlendAttachments;
-				colorBlending.blendConstants[0] = 1.0f;
-				colorBlending.blendConstants[1] = 1.0f;
-				colorBlending.blendConstants[2] = 1.0f;
-				colorBlending.blendConstants[3] = 1.0f;
-
-				pipelineInfo.pColorBlendState = &colorBlending;
-
-				// Input layout:
-				VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-				vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-				std::vector<VkVertexInputBindingDescription> bindings;
-				std::vector<VkVertexInputAttributeDescription> attributes;
-				if (pso->desc.il != nullptr)
-				{
-					uint32_t lastBinding = 0xFFFFFFFF;
-					for (auto& x : pso->desc.il->elements)
-					{
-						if (x.InputSlot == lastBinding)
-							continue;
-						lastBinding = x.InputSlot;
-						VkVertexInputBindingDescription& bind = bindings.emplace_back();
-						bind.binding = x.InputSlot;
-						bind.inputRate = x.InputSlotClass == INPUT_PER_VERTEX_DATA ? VK_VERTEX_INPUT_RATE_VERTEX : VK_VERTEX_INPUT_RATE_INSTANCE;
-						bind.stride = vb_strides[cmd][x.InputSlot];
-					}
-
-					uint32_t offset = 0;
-					uint32_t i = 0;
-					lastBinding = 0xFFFFFFFF;
-					for (auto& x : pso->desc.il->elements)
-					{
-						VkVertexInputAttributeDescription attr = {};
-						attr.binding = x.InputSlot;
-						if (attr.binding != lastBinding)
-						{
-							lastBinding = attr.binding;
-							offset = 0;
-						}
-						attr.format = _ConvertFormat(x.Format);
-						attr.location = i;
-						attr.offset = x.AlignedByteOffset;
-						if (attr.offset == InputLayout::APPEND_ALIGNED_ELEMENT)
-						{
-							// need to manually resolve this from the format spec.
-							attr.offset = offset;
-							offset += GetFormatStride(x.Format);
-						}
-
-						attributes.push_back(attr);
-
-						i++;
-					}
-
-					vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
-					vertexInputInfo.pVertexBindingDescriptions = bindings.data();
-					vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
-					vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
-				}
-				pipelineInfo.pVertexInputState = &vertexInputInfo;
-
-				VkResult res = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
-				assert(res == VK_SUCCESS);
+				pipeline = create_pipeline(pso, active_renderpass[cmd], vb_strides[cmd]);
+				RecordPrewarmPipeline(internal_state->persistent_hash, active_renderpass[cmd]->hash, vb_hash[cmd], vb_strides[cmd]);
 
 				pipelines_worker[cmd].push_back(std::make_pair(pipeline_hash, pipeline));
 			}
@@ -2290,6 +2358,12 @@ using namespace Vulkan_Internal;
 						properties_chain = &fragment_shading_rate_properties.pNext;
 					}
 
+					memoryBudget = checkExtensionSupport(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, available_deviceExtensions);
+					if (memoryBudget)
+					{
+						enabled_deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+					}
+
 					if (checkExtensionSupport(VK_NV_MESH_SHADER_EXTENSION_NAME, available_deviceExtensions))
 					{
 						enabled_deviceExtensions.push_back(VK_NV_MESH_SHADER_EXTENSION_NAME);
@@ -2339,7 +2413,13 @@ using namespace Vulkan_Internal;
 			{
 				capabilities |= GRAPHICSDEVICE_CAPABILITY_UAV_LOAD_FORMAT_COMMON;
 			}
+			if (features2.features.pipelineStatisticsQuery == VK_TRUE && features2.features.tessellationShader == VK_TRUE)
+			{
+				// the tessellation counters are needed for the result layout of PipelineStatistics
+				capabilities |= GRAPHICSDEVICE_CAPABILITY_PIPELINE_STATISTICS;
+			}
 			capabilities |= GRAPHICSDEVICE_CAPABILITY_RENDERTARGET_AND_VIEWPORT_ARRAYINDEX_WITHOUT_GS; // let's hope for the best...
+			capabilities |= GRAPHICSDEVICE_CAPABILITY_RESOURCE_ALIASING;
 
 			if (raytracing_features.rayTracingPipeline == VK_TRUE)
 			{
@@ -2501,9 +2581,14 @@ using namespace Vulkan_Internal;
 		allocatorInfo.physicalDevice = physicalDevice;
 		allocatorInfo.device = device;
 		allocatorInfo.instance = instance;
+		allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_2;
 		if (features_1_2.bufferDeviceAddress)
 		{
-			allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+			allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+		}
+		if (memoryBudget)
+		{
+			allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
 		}
 		res = vmaCreateAllocator(&allocatorInfo, &allocationhandler->allocator);
 		assert(res == VK_SUCCESS);
@@ -2764,6 +2849,20 @@ using namespace Vulkan_Internal;
 			allocationhandler->bindlessAccelerationStructures.init(device, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 32);
 		}
 
+		// Every pipeline is created through the pipeline cache, LoadPipelineCache() merges a cache file into it:
+		{
+			pipeline_cache_header.magic = 0x43505657; // "WVPC"
+			pipeline_cache_header.version = 1;
+			pipeline_cache_header.vendorID = properties2.properties.vendorID;
+			pipeline_cache_header.deviceID = properties2.properties.deviceID;
+			pipeline_cache_header.driverVersion = properties2.properties.driverVersion;
+			std::memcpy(pipeline_cache_header.uuid, properties2.properties.pipelineCacheUUID, sizeof(pipeline_cache_header.uuid));
+
+			VkPipelineCacheCreateInfo createInfo = {};
+			createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+			res = vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache);
+			assert(res == VK_SUCCESS);
+		}
 
 		wiBackLog::post("Created GraphicsDevice_Vulkan");
 	}
@@ -2793,6 +2892,14 @@ using namespace Vulkan_Internal;
 			{
 				descriptormanager.destroy();
 			}
+
+			for (auto& events : frame.splitEvents)
+			{
+				for (auto& event : events)
+				{
+					vkDestroyEvent(device, event, nullptr);
+				}
+			}
 		}
 
 		copyAllocator.destroy();
@@ -2814,6 +2921,16 @@ using namespace Vulkan_Internal;
 		{
 			vkDestroyPipeline(device, x.second, nullptr);
 		}
+		for (auto& x : pipelines_prewarmed)
+		{
+			vkDestroyPipeline(device, x.second, nullptr);
+		}
+
+		if (!pipeline_cache_filename.empty())
+		{
+			SavePipelineCache(pipeline_cache_filename);
+		}
+		vkDestroyPipelineCache(device, pipelineCache, nullptr);
 
 		vmaDestroyBuffer(allocationhandler->allocator, nullBuffer, nullBufferAllocation);
 		vkDestroyBufferView(device, nullBufferView, nullptr);
@@ -3040,8 +3157,10 @@ using namespace Vulkan_Internal;
 			renderpass_internal->allocationhandler = allocationhandler;
 			internal_state->renderpass.internal_state = renderpass_internal;
 			internal_state->renderpass.desc.attachments.push_back(RenderPassAttachment::RenderTarget());
+			renderpass_internal->pipeline_rendertarget_count = 1;
 			res = vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderpass_internal->renderpass);
 			assert(res == VK_SUCCESS);
+			RegisterPrewarmRenderPass(&internal_state->renderpass);
 
 		}
 
@@ -3255,9 +3374,39 @@ using namespace Vulkan_Internal;
 		{
 			allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
 		}
+		if (pDesc->MiscFlags & RESOURCE_MISC_ALIASING_TEXTURE_NON_RT_DS)
+		{
+			// Textures will be bound into this memory by CreateTexture(), so it must be a memory type that sampled and storage images support:
+			VkImageCreateInfo imageInfo = {};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+			imageInfo.extent = { 1, 1, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			VkImage image = VK_NULL_HANDLE;
+			res = vkCreateImage(device, &imageInfo, nullptr, &image);
+			assert(res == VK_SUCCESS);
+			VkMemoryRequirements memory_requirements = {};
+			vkGetImageMemoryRequirements(device, image, &memory_requirements);
+			vkDestroyImage(device, image, nullptr);
+
+			allocInfo.memoryTypeBits = memory_requirements.memoryTypeBits;
+			allocInfo.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT; // own memory block, so image alignments are relative to the start of the memory
+		}
 
 		res = vmaCreateBuffer(allocationhandler->allocator, &bufferInfo, &allocInfo, &internal_state->resource, &internal_state->allocation, nullptr);
 		assert(res == VK_SUCCESS);
+		if (res == VK_SUCCESS)
+		{
+			internal_state->memory.Set(wiMemoryTracker::TAG_GPU_BUFFER, (size_t)internal_state->allocation->GetSize());
+		}
 
 		if (bufferInfo.usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
 		{
@@ -3310,7 +3459,9 @@ using namespace Vulkan_Internal;
 					&copyRegion
 				);
 
-				VkAccessFlags tmp = barrier.srcAccessMask;
+				copyAllocator.submit(cmd);
+
+				// The transfer queue can't make the buffer visible to the other stages, the graphics queue does it after it waited for the copies:
 				barrier.srcAccessMask = barrier.dstAccessMask;
 				barrier.dstAccessMask = 0;
 
@@ -3339,8 +3490,9 @@ using namespace Vulkan_Internal;
 					barrier.dstAccessMask |= VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
 				}
 
+				initLocker.lock();
 				vkCmdPipelineBarrier(
-					cmd.commandBuffer,
+					GetFrameResources().initCommandBuffer,
 					VK_PIPELINE_STAGE_TRANSFER_BIT,
 					VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
 					0,
@@ -3348,8 +3500,8 @@ using namespace Vulkan_Internal;
 					1, &barrier,
 					0, nullptr
 				);
-
-				copyAllocator.submit(cmd);
+				submit_inits = true;
+				initLocker.unlock();
 			}
 		}
 		else if(pDesc->Usage != USAGE_STAGING)
@@ -3395,7 +3547,7 @@ using namespace Vulkan_Internal;
 
 		return res == VK_SUCCESS;
 	}
-	bool GraphicsDevice_Vulkan::CreateTexture(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture *pTexture) const
+	bool GraphicsDevice_Vulkan::CreateTexture(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture *pTexture, const GPUBuffer* alias, uint64_t alias_offset) const
 	{
 		auto internal_state = std::make_shared<Texture_Vulkan>();
 		internal_state->allocationhandler = allocationhandler;
@@ -3509,6 +3661,10 @@ using namespace Vulkan_Internal;
 
 			res = vmaCreateBuffer(allocationhandler->allocator, &bufferInfo, &allocInfo, &internal_state->staging_resource, &internal_state->allocation, nullptr);
 			assert(res == VK_SUCCESS);
+			if (res == VK_SUCCESS)
+			{
+				internal_state->memory.Set(wiMemoryTracker::TAG_GPU_TEXTURE, (size_t)internal_state->allocation->GetSize());
+			}
 
 			imageInfo.tiling = VK_IMAGE_TILING_LINEAR;
 			VkImage image;
@@ -3522,10 +3678,43 @@ using namespace Vulkan_Internal;
 			vkDestroyImage(device, image, nullptr);
 			return res == VK_SUCCESS;
 		}
+		else if (alias != nullptr)
+		{
+			// Bound into the aliasing buffer's memory, the texture doesn't own any memory:
+			assert(pInitialData == nullptr);
+			assert(!(pDesc->BindFlags & (BIND_RENDER_TARGET | BIND_DEPTH_STENCIL)));
+			assert(alias->desc.MiscFlags & RESOURCE_MISC_ALIASING_TEXTURE_NON_RT_DS);
+			auto alias_internal = to_internal(alias);
+
+			res = vkCreateImage(device, &imageInfo, nullptr, &internal_state->resource);
+			assert(res == VK_SUCCESS);
+
+			VkMemoryRequirements memory_requirements = {};
+			vkGetImageMemoryRequirements(device, internal_state->resource, &memory_requirements);
+			VmaAllocationInfo alias_info = {};
+			vmaGetAllocationInfo(allocationhandler->allocator, alias_internal->allocation, &alias_info);
+			if ((memory_requirements.memoryTypeBits & (1u << alias_info.memoryType)) == 0 ||
+				(alias_offset % memory_requirements.alignment) != 0 ||
+				alias_offset + memory_requirements.size > alias_info.size)
+			{
+				vkDestroyImage(device, internal_state->resource, nullptr);
+				internal_state->resource = VK_NULL_HANDLE;
+				return false;
+			}
+
+			res = vmaBindImageMemory2(allocationhandler->allocator, alias_internal->allocation, alias_offset, internal_state->resource, nullptr);
+			assert(res == VK_SUCCESS);
+			internal_state->aliased_memory = alias->internal_state;
+		}
 		else
 		{
 			res = vmaCreateImage(allocationhandler->allocator, &imageInfo, &allocInfo, &internal_state->resource, &internal_state->allocation, nullptr);
 			assert(res == VK_SUCCESS);
+			if (res == VK_SUCCESS)
+			{
+				const bool rendertarget = pDesc->BindFlags & (BIND_RENDER_TARGET | BIND_DEPTH_STENCIL);
+				internal_state->memory.Set(rendertarget ? wiMemoryTracker::TAG_GPU_RENDERTARGET : wiMemoryTracker::TAG_GPU_TEXTURE, (size_t)internal_state->allocation->GetSize());
+			}
 		}
 
 		// Issue data copy on request:
@@ -3719,6 +3908,62 @@ using namespace Vulkan_Internal;
 
 		return res == VK_SUCCESS;
 	}
+	uint64_t GraphicsDevice_Vulkan::GetTextureMemorySize(const TextureDesc* pDesc) const
+	{
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.extent.width = pDesc->Width;
+		imageInfo.extent.height = pDesc->Height;
+		imageInfo.extent.depth = pDesc->type == TextureDesc::TEXTURE_3D ? pDesc->Depth : 1;
+		imageInfo.format = _ConvertFormat(pDesc->Format);
+		imageInfo.arrayLayers = pDesc->ArraySize;
+		imageInfo.mipLevels = pDesc->MipLevels == 0 ? (uint32_t)log2(std::max(pDesc->Width, pDesc->Height)) + 1 : pDesc->MipLevels;
+		imageInfo.samples = (VkSampleCountFlagBits)pDesc->SampleCount;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		if (pDesc->BindFlags & BIND_SHADER_RESOURCE)
+		{
+			imageInfo.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+		}
+		if (pDesc->BindFlags & BIND_UNORDERED_ACCESS)
+		{
+			imageInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		}
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.imageType = pDesc->type == TextureDesc::TEXTURE_1D ? VK_IMAGE_TYPE_1D : (pDesc->type == TextureDesc::TEXTURE_3D ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D);
+
+		VkImage image = VK_NULL_HANDLE;
+		VkResult res = vkCreateImage(device, &imageInfo, nullptr, &image);
+		if (res != VK_SUCCESS)
+		{
+			return 0;
+		}
+		VkMemoryRequirements memory_requirements = {};
+		vkGetImageMemoryRequirements(device, image, &memory_requirements);
+		vkDestroyImage(device, image, nullptr);
+		return memory_requirements.size;
+	}
+	GraphicsDevice::MemoryBudget GraphicsDevice_Vulkan::GetMemoryBudget(MEMORY_HEAP heap) const
+	{
+		// Without VK_EXT_memory_budget, the usage is only what the allocator knows about and the budget is estimated from the heap sizes:
+		VmaBudget budgets[VK_MAX_MEMORY_HEAPS] = {};
+		vmaGetBudget(allocationhandler->allocator, budgets);
+		const VkPhysicalDeviceMemoryProperties* memory_properties = nullptr;
+		vmaGetMemoryProperties(allocationhandler->allocator, &memory_properties);
+
+		MemoryBudget result;
+		for (uint32_t i = 0; i < memory_properties->memoryHeapCount; ++i)
+		{
+			const bool device_local = memory_properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+			if (device_local == (heap == MEMORY_HEAP_DEVICE))
+			{
+				result.usage += budgets[i].usage;
+				result.budget += budgets[i].budget;
+			}
+		}
+		return result;
+	}
 	bool GraphicsDevice_Vulkan::CreateShader(SHADERSTAGE stage, const void *pShaderBytecode, size_t BytecodeLength, Shader *pShader) const
 	{
 		auto internal_state = std::make_shared<Shader_Vulkan>();
@@ -3726,6 +3971,7 @@ using namespace Vulkan_Internal;
 		pShader->internal_state = internal_state;
 
 		pShader->stage = stage;
+		internal_state->persistent_hash = HashBytes(pShaderBytecode, BytecodeLength);
 
 		VkResult res = VK_SUCCESS;
 
@@ -4026,7 +4272,7 @@ using namespace Vulkan_Internal;
 			pipelineInfo.stage = internal_state->stageInfo;
 
 
-			res = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &internal_state->pipeline_cs);
+			res = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &internal_state->pipeline_cs);
 			assert(res == VK_SUCCESS);
 		}
 
@@ -4258,6 +4504,23 @@ using namespace Vulkan_Internal;
 		case GPU_QUERY_TYPE_OCCLUSION_BINARY:
 			poolInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
 			break;
+		case GPU_QUERY_TYPE_PIPELINE_STATISTICS:
+			assert(CheckCapability(GRAPHICSDEVICE_CAPABILITY_PIPELINE_STATISTICS));
+			poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			// The results are written in the order of the bits, which is the order of PipelineStatistics:
+			poolInfo.pipelineStatistics =
+				VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_GEOMETRY_SHADER_INVOCATIONS_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_GEOMETRY_SHADER_PRIMITIVES_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_CONTROL_SHADER_PATCHES_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+			break;
 		}
 
 		VkResult res = vkCreateQueryPool(device, &poolInfo, nullptr, &internal_state->pool);
@@ -4288,6 +4551,11 @@ using namespace Vulkan_Internal;
 		wiHelper::hash_combine(pso->hash, pDesc->dss);
 		wiHelper::hash_combine(pso->hash, pDesc->pt);
 		wiHelper::hash_combine(pso->hash, pDesc->sampleMask);
+		// The shader states are also hashed, so the cached pipelines are not used after a shader was loaded again:
+		for (const Shader* shader : { pDesc->ms, pDesc->as, pDesc->vs, pDesc->ps, pDesc->hs, pDesc->ds, pDesc->gs })
+		{
+			wiHelper::hash_combine(pso->hash, shader == nullptr ? nullptr : shader->internal_state.get());
+		}
 
 		VkResult res = VK_SUCCESS;
 
@@ -4682,6 +4950,9 @@ using namespace Vulkan_Internal;
 
 		pipelineInfo.pDynamicState = &dynamicStateInfo;
 
+		internal_state->persistent_hash = ComputePipelineStateKey(pso->desc);
+		RegisterPrewarmPipelineState(internal_state->persistent_hash, pso);
+
 		return res == VK_SUCCESS;
 	}
 	bool GraphicsDevice_Vulkan::CreateRenderPass(const RenderPassDesc* pDesc, RenderPass* renderpass) const
@@ -4996,6 +5267,20 @@ using namespace Vulkan_Internal;
 			}
 		}
 
+		for (uint32_t i = 0; i < (uint32_t)pDesc->attachments.size(); ++i)
+		{
+			const RenderPassAttachment& attachment = pDesc->attachments[i];
+			if (attachment.type == RenderPassAttachment::RENDERTARGET)
+			{
+				internal_state->pipeline_rendertargets[internal_state->pipeline_rendertarget_count++] = i;
+			}
+		}
+		if (pDesc->attachments.size() > 0 && pDesc->attachments[0].texture != nullptr)
+		{
+			internal_state->pipeline_samples = (VkSampleCountFlagBits)pDesc->attachments[0].texture->desc.SampleCount;
+		}
+		RegisterPrewarmRenderPass(renderpass);
+
 		return res == VK_SUCCESS;
 	}
 	bool GraphicsDevice_Vulkan::CreateRaytracingAccelerationStructure(const RaytracingAccelerationStructureDesc* pDesc, RaytracingAccelerationStructure* bvh) const
@@ -5127,6 +5412,10 @@ using namespace Vulkan_Internal;
 			nullptr
 		);
 		assert(res == VK_SUCCESS);
+		if (res == VK_SUCCESS)
+		{
+			internal_state->memory.Set(wiMemoryTracker::TAG_GPU_ACCELERATION_STRUCTURE, (size_t)internal_state->allocation->GetSize());
+		}
 
 		// Create the acceleration structure:
 		internal_state->createInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
@@ -5155,6 +5444,15 @@ using namespace Vulkan_Internal;
 		internal_state->scratch_address = vkGetBufferDeviceAddress(device, &addressinfo)
 			+ internal_state->sizeInfo.accelerationStructureSize;
 
+		if (pDesc->_flags & RaytracingAccelerationStructureDesc::FLAG_ALLOW_COMPACTION)
+		{
+			VkQueryPoolCreateInfo poolInfo = {};
+			poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			poolInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+			poolInfo.queryCount = 1;
+			VkResult poolres = vkCreateQueryPool(device, &poolInfo, nullptr, &internal_state->compactedsize_pool);
+			assert(poolres == VK_SUCCESS);
+		}
 
 		if (pDesc->type == RaytracingAccelerationStructureDesc::TOPLEVEL)
 		{
@@ -5190,6 +5488,72 @@ using namespace Vulkan_Internal;
 
 		return res == VK_SUCCESS;
 	}
+	bool GraphicsDevice_Vulkan::CreateRaytracingAccelerationStructureCompacted(const RaytracingAccelerationStructure* src, uint64_t size, RaytracingAccelerationStructure* bvh) const
+	{
+		auto src_internal = to_internal(src);
+		assert(src->desc._flags & RaytracingAccelerationStructureDesc::FLAG_ALLOW_COMPACTION);
+		assert(src->desc.type == RaytracingAccelerationStructureDesc::BOTTOMLEVEL);
+
+		auto internal_state = std::make_shared<BVH_Vulkan>();
+		internal_state->allocationhandler = allocationhandler;
+		internal_state->buildInfo = src_internal->buildInfo;
+		internal_state->geometries = src_internal->geometries;
+		internal_state->primitiveCounts = src_internal->primitiveCounts;
+		internal_state->buildInfo.pGeometries = internal_state->geometries.data();
+		internal_state->sizeInfo = src_internal->sizeInfo;
+		internal_state->sizeInfo.accelerationStructureSize = size;
+		internal_state->sizeInfo.buildScratchSize = 0;
+		internal_state->sizeInfo.updateScratchSize = 0;
+		bvh->internal_state = internal_state;
+		bvh->type = GPUResource::GPU_RESOURCE_TYPE::RAYTRACING_ACCELERATION_STRUCTURE;
+		bvh->desc = src->desc;
+
+		// Backing memory without scratch, the compacted acceleration structure is not built again:
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR;
+		bufferInfo.usage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+		bufferInfo.flags = 0;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VmaAllocationCreateInfo allocInfo = {};
+		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+		VkResult res = vmaCreateBuffer(
+			allocationhandler->allocator,
+			&bufferInfo,
+			&allocInfo,
+			&internal_state->buffer,
+			&internal_state->allocation,
+			nullptr
+		);
+		assert(res == VK_SUCCESS);
+		if (res != VK_SUCCESS)
+		{
+			return false;
+		}
+		internal_state->memory.Set(wiMemoryTracker::TAG_GPU_ACCELERATION_STRUCTURE, (size_t)internal_state->allocation->GetSize());
+
+		internal_state->createInfo = src_internal->createInfo;
+		internal_state->createInfo.buffer = internal_state->buffer;
+		internal_state->createInfo.size = size;
+
+		res = vkCreateAccelerationStructureKHR(
+			device,
+			&internal_state->createInfo,
+			nullptr,
+			&internal_state->resource
+		);
+		assert(res == VK_SUCCESS);
+
+		VkAccelerationStructureDeviceAddressInfoKHR addrinfo = {};
+		addrinfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+		addrinfo.accelerationStructure = internal_state->resource;
+		internal_state->as_address = vkGetAccelerationStructureDeviceAddressKHR(device, &addrinfo);
+
+		return res == VK_SUCCESS;
+	}
 	bool GraphicsDevice_Vulkan::CreateRaytracingPipelineState(const RaytracingPipelineStateDesc* pDesc, RaytracingPipelineState* rtpso) const
 	{
 		auto internal_state = std::make_shared<RTPipelineState_Vulkan>();
@@ -5279,7 +5643,7 @@ using namespace Vulkan_Internal;
 		VkResult res = vkCreateRayTracingPipelinesKHR(
 			device,
 			VK_NULL_HANDLE,
-			VK_NULL_HANDLE,
+			pipelineCache,
 			1,
 			&info,
 			nullptr,
@@ -5880,14 +6244,16 @@ using namespace Vulkan_Internal;
 
 		auto internal_state = to_internal(heap);
 
+		const size_t stride = heap->desc.type == GPU_QUERY_TYPE_PIPELINE_STATISTICS ? sizeof(PipelineStatistics) : sizeof(uint64_t);
+
 		VkResult res = vkGetQueryPoolResults(
 			device,
 			internal_state->pool,
 			index,
 			count,
-			sizeof(uint64_t) * count,
+			stride * count,
 			results,
-			sizeof(uint64_t),
+			stride,
 			VK_QUERY_RESULT_64_BIT
 		);
 
@@ -5999,6 +6365,16 @@ using namespace Vulkan_Internal;
 		// reset descriptor allocators:
 		GetFrameResources().descriptors[cmd].reset();
 
+		// reset split barrier events, the GPU finished with them when the frame was begun:
+		assert(split_barriers[cmd].empty()); // a BarrierBegin() was not ended in the previous use of the command list
+		split_barriers[cmd].clear();
+		for (uint32_t i = 0; i < split_event_count[cmd]; ++i)
+		{
+			res = vkResetEvent(device, GetFrameResources().splitEvents[cmd][i]);
+			assert(res == VK_SUCCESS);
+		}
+		split_event_count[cmd] = 0;
+
 		// reset immediate resource allocators:
 		GetFrameResources().resourceBuffer[cmd].clear();
 
@@ -6132,6 +6508,42 @@ using namespace Vulkan_Internal;
 				pipelines_worker[cmd].clear();
 			}
 
+			// Copies and initial transitions are not held back when there was no command list in this frame:
+			if (submit_queue == QUEUE_COUNT && (copy_sync > 0 || submit_inits))
+			{
+				submit_queue = QUEUE_GRAPHICS;
+				if (copy_sync > 0)
+				{
+					queues[submit_queue].submit_waitStages.push_back(VK_PIPELINE_STAGE_TRANSFER_BIT);
+					queues[submit_queue].submit_waitSemaphores.push_back(copyAllocator.semaphore);
+					queues[submit_queue].submit_waitValues.push_back(copy_sync);
+					copy_sync = 0;
+				}
+				if (submit_inits)
+				{
+					queues[submit_queue].submit_cmds.push_back(frame.initCommandBuffer);
+					submit_inits = false;
+				}
+			}
+
+			// pipelines that were compiled by prewarming in the background:
+			pipelines_prewarmed_locker.lock();
+			for (auto& x : pipelines_prewarmed)
+			{
+				if (pipelines_global.count(x.first) == 0)
+				{
+					pipelines_global[x.first] = x.second;
+				}
+				else
+				{
+					allocationhandler->destroylocker.lock();
+					allocationhandler->destroyer_pipelines.push_back(std::make_pair(x.second, FRAMECOUNT));
+					allocationhandler->destroylocker.unlock();
+				}
+			}
+			pipelines_prewarmed.clear();
+			pipelines_prewarmed_locker.unlock();
+
 			// final submits with fences:
 			for (int queue = 0; queue < QUEUE_COUNT; ++queue)
 			{
@@ -6178,6 +6590,8 @@ using namespace Vulkan_Internal;
 
 		submit_inits = false;
 		initLocker.unlock();
+
+		ProcessReadbacks();
 	}
 
 	void GraphicsDevice_Vulkan::WaitForGPU() const
@@ -6185,6 +6599,19 @@ using namespace Vulkan_Internal;
 		VkResult res = vkDeviceWaitIdle(device);
 		assert(res == VK_SUCCESS);
 	}
+	void GraphicsDevice_Vulkan::WaitForFrameLatency(const SwapChain* swapchain, uint32_t maxFramesInFlight)
+	{
+		maxFramesInFlight = std::max(1u, std::min(maxFramesInFlight, GetBufferCount()));
+
+		// The frames before FRAMECOUNT - maxFramesInFlight must be finished (the older ones were already waited for by SubmitCommandLists())
+		//	The swapchain image is acquired when the swapchain render pass begins, so there is nothing else to wait for here
+		if (maxFramesInFlight < BUFFERCOUNT && FRAMECOUNT >= maxFramesInFlight)
+		{
+			const FrameResources& frame = frames[(FRAMECOUNT - maxFramesInFlight) % BUFFERCOUNT];
+			VkResult res = vkWaitForFences(device, QUEUE_COUNT, frame.fence, true, 0xFFFFFFFFFFFFFFFF);
+			assert(res == VK_SUCCESS);
+		}
+	}
 	void GraphicsDevice_Vulkan::ClearPipelineStateCache()
 	{
 		allocationhandler->destroylocker.lock();
@@ -6212,9 +6639,89 @@ using namespace Vulkan_Internal;
 			}
 			pipelines_worker[i].clear();
 		}
+
+		pipelines_prewarmed_locker.lock();
+		for (auto& x : pipelines_prewarmed)
+		{
+			allocationhandler->destroyer_pipelines.push_back(std::make_pair(x.second, FRAMECOUNT));
+		}
+		pipelines_prewarmed.clear();
+		pipelines_prewarm_known.clear();
+		pipelines_prewarmed_locker.unlock();
 		allocationhandler->destroylocker.unlock();
 	}
 
+	bool GraphicsDevice_Vulkan::LoadPipelineCache(const std::string& filename)
+	{
+		pipeline_cache_filename = filename;
+
+		// The driver also validates its own header in the data, but a mismatching cache file is rejected before it gets there:
+		std::vector<uint8_t> data;
+		if (!ReadPipelineCacheFile(filename, pipeline_cache_header, data))
+		{
+			return false;
+		}
+
+		VkPipelineCacheCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		createInfo.initialDataSize = data.size();
+		createInfo.pInitialData = data.data();
+		VkPipelineCache loaded = VK_NULL_HANDLE;
+		VkResult res = vkCreatePipelineCache(device, &createInfo, nullptr, &loaded);
+		if (res != VK_SUCCESS)
+		{
+			return false;
+		}
+		res = vkMergePipelineCaches(device, pipelineCache, 1, &loaded);
+		vkDestroyPipelineCache(device, loaded, nullptr);
+		return res == VK_SUCCESS;
+	}
+	bool GraphicsDevice_Vulkan::SavePipelineCache(const std::string& filename)
+	{
+		size_t size = 0;
+		VkResult res = vkGetPipelineCacheData(device, pipelineCache, &size, nullptr);
+		if (res != VK_SUCCESS)
+		{
+			return false;
+		}
+		std::vector<uint8_t> data(size);
+		res = vkGetPipelineCacheData(device, pipelineCache, &size, data.data());
+		if (res != VK_SUCCESS)
+		{
+			return false;
+		}
+		return WritePipelineCacheFile(filename, pipeline_cache_header, data.data(), size);
+	}
+	uint64_t GraphicsDevice_Vulkan::GetShaderHash(const Shader* shader) const
+	{
+		return to_internal(shader)->persistent_hash;
+	}
+	bool GraphicsDevice_Vulkan::CompilePrewarmPipeline(const PipelineState* pso, const RenderPass* renderpass, const PipelinePrewarmEntry& entry)
+	{
+		// Same key as the BindPipelineState() inside a render pass, with the vertex buffer strides of pso_validate():
+		size_t pipeline_hash = 0;
+		wiHelper::hash_combine(pipeline_hash, pso->hash);
+		wiHelper::hash_combine(pipeline_hash, renderpass->hash);
+		wiHelper::hash_combine(pipeline_hash, (size_t)entry.vertex_hash);
+		{
+			// pipelines_global is only accessed by the recording threads, so the prewarmed pipelines are tracked separately:
+			std::scoped_lock lock(pipelines_prewarmed_locker);
+			if (!pipelines_prewarm_known.insert(pipeline_hash).second)
+			{
+				return false;
+			}
+		}
+
+		VkPipeline pipeline = create_pipeline(pso, renderpass, entry.vertex_strides);
+		if (pipeline == VK_NULL_HANDLE)
+		{
+			return false;
+		}
+		std::scoped_lock lock(pipelines_prewarmed_locker);
+		pipelines_prewarmed.push_back(std::make_pair(pipeline_hash, pipeline));
+		return true;
+	}
+
 	Texture GraphicsDevice_Vulkan::GetBackBuffer(const SwapChain* swapchain) const
 	{
 		auto swapchain_internal = to_internal(swapchain);
@@ -6810,6 +7317,34 @@ using namespace Vulkan_Internal;
 #ifdef GGREDUCED
 	void GraphicsDevice_Vulkan::CopyTexture2D_Region(const Texture* pDst, uint32_t dstMip, uint32_t dstX, uint32_t dstY, const Texture* pSrc, uint32_t srcMip, CommandList cmd)
 	{
+		barrier_flush(cmd);
+
+		assert(pDst != nullptr && pSrc != nullptr);
+		auto internal_state_src = to_internal(pSrc);
+		auto internal_state_dst = to_internal(pDst);
+
+		VkImageCopy copy = {};
+		copy.extent.width = std::max(1u, pSrc->desc.Width >> srcMip);
+		copy.extent.height = std::max(1u, pSrc->desc.Height >> srcMip);
+		copy.extent.depth = 1;
+
+		copy.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy.srcSubresource.baseArrayLayer = 0;
+		copy.srcSubresource.layerCount = 1;
+		copy.srcSubresource.mipLevel = srcMip;
+
+		copy.dstOffset.x = (int32_t)dstX;
+		copy.dstOffset.y = (int32_t)dstY;
+		copy.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy.dstSubresource.baseArrayLayer = 0;
+		copy.dstSubresource.layerCount = 1;
+		copy.dstSubresource.mipLevel = dstMip;
+
+		vkCmdCopyImage(GetCommandList(cmd),
+			internal_state_src->resource, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			internal_state_dst->resource, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &copy
+		);
 	}
 	void GraphicsDevice_Vulkan::MSAAResolve(const Texture* pDst, const Texture* pSrc, CommandList cmd)
 	{
@@ -6828,18 +7363,19 @@ using namespace Vulkan_Internal;
 		return NULL;
 	}
 #endif
-	void GraphicsDevice_Vulkan::UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize)
+	void GraphicsDevice_Vulkan::UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize, uint32_t dstOffset)
 	{
 		assert(buffer->desc.Usage != USAGE_IMMUTABLE && "Cannot update IMMUTABLE GPUBuffer!");
-		assert((int)buffer->desc.ByteWidth >= dataSize || dataSize < 0 && "Data size is too big!");
+		assert(dstOffset <= buffer->desc.ByteWidth && "Offset is out of bounds!");
+		assert((int)(buffer->desc.ByteWidth - dstOffset) >= dataSize || dataSize < 0 && "Data size is too big!");
 
 		if (dataSize == 0)
 		{
 			return;
 		}
 
-		dataSize = std::min((int)buffer->desc.ByteWidth, dataSize);
-		dataSize = (dataSize >= 0 ? dataSize : buffer->desc.ByteWidth);
+		dataSize = std::min((int)(buffer->desc.ByteWidth - dstOffset), dataSize);
+		dataSize = (dataSize >= 0 ? dataSize : buffer->desc.ByteWidth - dstOffset);
 
 		auto internal_state_dst = to_internal(buffer);
 
@@ -6849,6 +7385,7 @@ using namespace Vulkan_Internal;
 		if (buffer->desc.Usage == USAGE_DYNAMIC && buffer->desc.BindFlags & BIND_CONSTANT_BUFFER)
 		{
 			// Dynamic buffer will be used from host memory directly:
+			assert(dstOffset == 0 && "Dynamic buffer can only be updated entirely!");
 			internal_state_dst->dynamic[cmd] = allocation;
 			GetFrameResources().descriptors[cmd].dirty = true;
 		}
@@ -6898,7 +7435,7 @@ using namespace Vulkan_Internal;
 			VkBufferCopy copyRegion = {};
 			copyRegion.size = dataSize;
 			copyRegion.srcOffset = (VkDeviceSize)allocation.offset;
-			copyRegion.dstOffset = 0;
+			copyRegion.dstOffset = (VkDeviceSize)dstOffset;
 
 			vkCmdCopyBuffer(
 				GetCommandList(cmd),
@@ -6927,6 +7464,9 @@ using namespace Vulkan_Internal;
 		case GPU_QUERY_TYPE_OCCLUSION:
 			vkCmdBeginQuery(GetCommandList(cmd), internal_state->pool, index, VK_QUERY_CONTROL_PRECISE_BIT);
 			break;
+		case GPU_QUERY_TYPE_PIPELINE_STATISTICS:
+			vkCmdBeginQuery(GetCommandList(cmd), internal_state->pool, index, 0);
+			break;
 		}
 	}
 	void GraphicsDevice_Vulkan::QueryEnd(const GPUQueryHeap* heap, uint32_t index, CommandList cmd)
@@ -6940,6 +7480,7 @@ using namespace Vulkan_Internal;
 			break;
 		case GPU_QUERY_TYPE_OCCLUSION_BINARY:
 		case GPU_QUERY_TYPE_OCCLUSION:
+		case GPU_QUERY_TYPE_PIPELINE_STATISTICS:
 			vkCmdEndQuery(GetCommandList(cmd), internal_state->pool, index);
 			break;
 		}
@@ -7039,6 +7580,38 @@ using namespace Vulkan_Internal;
 				}
 			}
 			break;
+			case GPUBarrier::ALIASING_BARRIER:
+			{
+				// The previous user of the memory must be finished, and the new texture starts from undefined contents in its default layout:
+				VkMemoryBarrier barrierdesc = {};
+				barrierdesc.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+				barrierdesc.pNext = nullptr;
+				barrierdesc.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				barrierdesc.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarriers.push_back(barrierdesc);
+
+				if (barrier.aliasing.resource_after != nullptr && barrier.aliasing.resource_after->IsTexture())
+				{
+					const Texture* texture = (const Texture*)barrier.aliasing.resource_after;
+					VkImageMemoryBarrier imagebarrierdesc = {};
+					imagebarrierdesc.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+					imagebarrierdesc.pNext = nullptr;
+					imagebarrierdesc.image = to_internal(texture)->resource;
+					imagebarrierdesc.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+					imagebarrierdesc.newLayout = _ConvertImageLayout(texture->desc.layout);
+					imagebarrierdesc.srcAccessMask = 0;
+					imagebarrierdesc.dstAccessMask = _ParseImageLayout(texture->desc.layout);
+					imagebarrierdesc.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					imagebarrierdesc.subresourceRange.baseMipLevel = 0;
+					imagebarrierdesc.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+					imagebarrierdesc.subresourceRange.baseArrayLayer = 0;
+					imagebarrierdesc.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+					imagebarrierdesc.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					imagebarrierdesc.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					imageBarriers.push_back(imagebarrierdesc);
+				}
+			}
+			break;
 			case GPUBarrier::BUFFER_BARRIER:
 			{
 				auto internal_state = to_internal(barrier.buffer.buffer);
@@ -7078,6 +7651,70 @@ using namespace Vulkan_Internal;
 			}
 		}
 	}
+	void GraphicsDevice_Vulkan::BarrierBegin(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd)
+	{
+		if (numBarriers == 0)
+			return;
+
+		auto& events = GetFrameResources().splitEvents[cmd];
+		if (split_event_count[cmd] >= events.size())
+		{
+			VkEventCreateInfo eventInfo = {};
+			eventInfo.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO;
+
+			VkEvent event = VK_NULL_HANDLE;
+			VkResult res = vkCreateEvent(device, &eventInfo, nullptr, &event);
+			assert(res == VK_SUCCESS);
+			events.push_back(event);
+		}
+
+		SplitBarrier split;
+		split.resource = GetBarrierResource(barriers[0]);
+		split.event = events[split_event_count[cmd]++];
+		split_barriers[cmd].push_back(split);
+
+		// The event is signaled when the work before it is finished, and the transitions are performed by waiting for it:
+		vkCmdSetEvent(GetCommandList(cmd), split.event, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	}
+	void GraphicsDevice_Vulkan::BarrierEnd(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd)
+	{
+		if (numBarriers == 0)
+			return;
+
+		const GPUResource* resource = GetBarrierResource(barriers[0]);
+		auto& splits = split_barriers[cmd];
+		auto it = std::find_if(splits.begin(), splits.end(), [&](const SplitBarrier& x) { return x.resource == resource; });
+		if (it == splits.end())
+		{
+			assert(0); // BarrierBegin() was not called with these barriers in this command list
+			Barrier(barriers, numBarriers, cmd);
+			return;
+		}
+		VkEvent event = it->event;
+		splits.erase(it);
+
+		// The pending barriers are not split, so they are recorded first, then only the new ones remain:
+		barrier_flush(cmd);
+		Barrier(barriers, numBarriers, cmd);
+
+		auto& memoryBarriers = frame_memoryBarriers[cmd];
+		auto& imageBarriers = frame_imageBarriers[cmd];
+		auto& bufferBarriers = frame_bufferBarriers[cmd];
+
+		vkCmdWaitEvents(
+			GetCommandList(cmd),
+			1, &event,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			(uint32_t)memoryBarriers.size(), memoryBarriers.data(),
+			(uint32_t)bufferBarriers.size(), bufferBarriers.data(),
+			(uint32_t)imageBarriers.size(), imageBarriers.data()
+		);
+
+		memoryBarriers.clear();
+		imageBarriers.clear();
+		bufferBarriers.clear();
+	}
 	void GraphicsDevice_Vulkan::BuildRaytracingAccelerationStructure(const RaytracingAccelerationStructure* dst, CommandList cmd, const RaytracingAccelerationStructure* src)
 	{
 		barrier_flush(cmd);
@@ -7182,6 +7819,44 @@ using namespace Vulkan_Internal;
 			&pRangeInfo
 		);
 	}
+	void GraphicsDevice_Vulkan::WriteRaytracingAccelerationStructureCompactedSize(const RaytracingAccelerationStructure* bvh, const GPUBuffer* dest, uint64_t dest_offset, CommandList cmd)
+	{
+		barrier_flush(cmd);
+
+		auto internal_state = to_internal(bvh);
+		assert(internal_state->compactedsize_pool != VK_NULL_HANDLE);
+
+		vkCmdResetQueryPool(GetCommandList(cmd), internal_state->compactedsize_pool, 0, 1);
+		vkCmdWriteAccelerationStructuresPropertiesKHR(
+			GetCommandList(cmd),
+			1,
+			&internal_state->resource,
+			VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR,
+			internal_state->compactedsize_pool,
+			0
+		);
+		vkCmdCopyQueryPoolResults(
+			GetCommandList(cmd),
+			internal_state->compactedsize_pool,
+			0,
+			1,
+			to_internal(dest)->resource,
+			(VkDeviceSize)dest_offset,
+			sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT
+		);
+	}
+	void GraphicsDevice_Vulkan::CompactRaytracingAccelerationStructure(const RaytracingAccelerationStructure* dst, const RaytracingAccelerationStructure* src, CommandList cmd)
+	{
+		barrier_flush(cmd);
+
+		VkCopyAccelerationStructureInfoKHR info = {};
+		info.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+		info.src = to_internal(src)->resource;
+		info.dst = to_internal(dst)->resource;
+		info.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+		vkCmdCopyAccelerationStructureKHR(GetCommandList(cmd), &info);
+	}
 	void GraphicsDevice_Vulkan::BindRaytracingPipelineState(const RaytracingPipelineState* rtpso, CommandList cmd)
 	{
 		prev_pipeline_hash[cmd] = 0;
@@ -22,6 +22,7 @@
 
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <deque>
 #include <atomic>
 #include <mutex>
@@ -33,6 +34,7 @@ namespace wiGraphics
 	{
 	protected:
 		bool debugUtils = false;
+		bool memoryBudget = false;
 		VkInstance instance = VK_NULL_HANDLE;
 	    VkDebugUtilsMessengerEXT debugUtilsMessenger = VK_NULL_HANDLE;
 		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
@@ -169,11 +171,20 @@ namespace wiGraphics
 			std::vector<CopyCMD> worklist; // in progress
 			std::vector<VkCommandBuffer> submit_cmds; // for next submit
 			uint64_t submit_wait = 0; // last submit wait value
+			uint64_t submit_bytes = 0; // staging bytes of the next submit
+
+			// When the copy queue is not shared with the other queues, copies are submitted as soon as the batch is large enough,
+			//	so that streaming uploads run on the transfer queue while the frame is still recorded
+			bool dedicated = false;
+			static constexpr uint64_t SUBMIT_BATCH_BYTES = 8ull * 1024ull * 1024ull;
+			// Staging buffers of the finished copies above this size are released instead of kept for reuse:
+			static constexpr uint64_t STAGING_POOL_BYTES = 256ull * 1024ull * 1024ull;
 
 			void init(GraphicsDevice_Vulkan* device);
 			void destroy();
 			CopyCMD allocate(uint32_t staging_size);
 			void submit(CopyCMD cmd);
+			void submit_batch(); // must be called when locked
 			uint64_t flush();
 		};
 		mutable CopyAllocator copyAllocator;
@@ -217,6 +228,8 @@ namespace wiGraphics
 			};
 			DescriptorBinder descriptors[COMMANDLIST_COUNT];
 
+			std::vector<VkEvent> splitEvents[COMMANDLIST_COUNT]; // signaled by BarrierBegin(), waited by BarrierEnd()
+
 
 			struct ResourceFrameAllocator
 			{
@@ -253,6 +266,14 @@ namespace wiGraphics
 		std::vector<VkImageMemoryBarrier> frame_imageBarriers[COMMANDLIST_COUNT];
 		std::vector<VkBufferMemoryBarrier> frame_bufferBarriers[COMMANDLIST_COUNT];
 
+		struct SplitBarrier
+		{
+			const GPUResource* resource = nullptr; // the resource of the first barrier identifies the split
+			VkEvent event = VK_NULL_HANDLE;
+		};
+		std::vector<SplitBarrier> split_barriers[COMMANDLIST_COUNT]; // begun, but not yet ended
+		uint32_t split_event_count[COMMANDLIST_COUNT] = {};
+
 		struct PSOLayout
 		{
 			VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
@@ -265,6 +286,9 @@ namespace wiGraphics
 
 		std::unordered_map<size_t, VkPipeline> pipelines_global;
 		std::vector<std::pair<size_t, VkPipeline>> pipelines_worker[COMMANDLIST_COUNT];
+		std::mutex pipelines_prewarmed_locker;
+		std::vector<std::pair<size_t, VkPipeline>> pipelines_prewarmed; // merged into pipelines_global in SubmitCommandLists()
+		std::unordered_set<size_t> pipelines_prewarm_known;
 		size_t prev_pipeline_hash[COMMANDLIST_COUNT] = {};
 		const PipelineState* active_pso[COMMANDLIST_COUNT] = {};
 		const Shader* active_cs[COMMANDLIST_COUNT] = {};
@@ -285,6 +309,15 @@ namespace wiGraphics
 
 		bool dirty_pso[COMMANDLIST_COUNT] = {};
 		void pso_validate(CommandList cmd);
+		VkPipeline create_pipeline(const PipelineState* pso, const RenderPass* renderpass, const uint32_t* vertex_strides);
+
+		// Persistent pipeline cache, every pipeline is created through it:
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		std::string pipeline_cache_filename;
+		PipelineCacheHeader pipeline_cache_header;
+
+		uint64_t GetShaderHash(const Shader* shader) const override;
+		bool CompilePrewarmPipeline(const PipelineState* pso, const RenderPass* renderpass, const PipelinePrewarmEntry& entry) override;
 
 		void barrier_flush(CommandList cmd);
 		void predraw(CommandList cmd);
@@ -311,13 +344,14 @@ namespace wiGraphics
 
 		bool CreateSwapChain(const SwapChainDesc* pDesc, wiPlatform::window_type window, SwapChain* swapChain) const override;
 		bool CreateBuffer(const GPUBufferDesc *pDesc, const SubresourceData* pInitialData, GPUBuffer *pBuffer) const override;
-		bool CreateTexture(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture *pTexture) const override;
+		bool CreateTexture(const TextureDesc* pDesc, const SubresourceData *pInitialData, Texture *pTexture, const GPUBuffer* alias = nullptr, uint64_t alias_offset = 0) const override;
 		bool CreateShader(SHADERSTAGE stage, const void *pShaderBytecode, size_t BytecodeLength, Shader *pShader) const override;
 		bool CreateSampler(const SamplerDesc *pSamplerDesc, Sampler *pSamplerState) const override;
 		bool CreateQueryHeap(const GPUQueryHeapDesc* pDesc, GPUQueryHeap* pQueryHeap) const override;
 		bool CreatePipelineState(const PipelineStateDesc* pDesc, PipelineState* pso) const override;
 		bool CreateRenderPass(const RenderPassDesc* pDesc, RenderPass* renderpass) const override;
 		bool CreateRaytracingAccelerationStructure(const RaytracingAccelerationStructureDesc* pDesc, RaytracingAccelerationStructure* bvh) const override;
+		bool CreateRaytracingAccelerationStructureCompacted(const RaytracingAccelerationStructure* src, uint64_t size, RaytracingAccelerationStructure* bvh) const override;
 		bool CreateRaytracingPipelineState(const RaytracingPipelineStateDesc* pDesc, RaytracingPipelineState* rtpso) const override;
 		
 		int CreateSubresource(Texture* texture, SUBRESOURCE_TYPE type, uint32_t firstSlice, uint32_t sliceCount, uint32_t firstMip, uint32_t mipCount) const override;
@@ -343,8 +377,14 @@ namespace wiGraphics
 
 		void WaitForGPU() const override;
 		void ClearPipelineStateCache() override;
+		void WaitForFrameLatency(const SwapChain* swapchain, uint32_t maxFramesInFlight) override;
+
+		bool LoadPipelineCache(const std::string& filename) override;
+		bool SavePipelineCache(const std::string& filename) override;
 
 		SHADERFORMAT GetShaderFormat() const override { return SHADERFORMAT_SPIRV; }
+		uint64_t GetTextureMemorySize(const TextureDesc* pDesc) const override;
+		MemoryBudget GetMemoryBudget(MEMORY_HEAP heap) const override;
 
 		Texture GetBackBuffer(const SwapChain* swapchain) const override;
 
@@ -390,11 +430,15 @@ namespace wiGraphics
 		void CopyBufferRegion(const GPUBuffer* pDst, uint32_t dstOffset, const GPUBuffer* pSrc, uint32_t srcOffset, uint32_t srcLength, CommandList cmd) override;
 		char* GetGraphicsCardName(void) override;
 #endif
-		void UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize = -1) override;
+		void UpdateBuffer(const GPUBuffer* buffer, const void* data, CommandList cmd, int dataSize = -1, uint32_t dstOffset = 0) override;
 		void QueryBegin(const GPUQueryHeap* heap, uint32_t index, CommandList cmd) override;
 		void QueryEnd(const GPUQueryHeap* heap, uint32_t index, CommandList cmd) override;
 		void Barrier(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd) override;
+		void BarrierBegin(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd) override;
+		void BarrierEnd(const GPUBarrier* barriers, uint32_t numBarriers, CommandList cmd) override;
 		void BuildRaytracingAccelerationStructure(const RaytracingAccelerationStructure* dst, CommandList cmd, const RaytracingAccelerationStructure* src = nullptr) override;
+		void WriteRaytracingAccelerationStructureCompactedSize(const RaytracingAccelerationStructure* bvh, const GPUBuffer* dest, uint64_t dest_offset, CommandList cmd) override;
+		void CompactRaytracingAccelerationStructure(const RaytracingAccelerationStructure* dst, const RaytracingAccelerationStructure* src, CommandList cmd) override;
 		void BindRaytracingPipelineState(const RaytracingPipelineState* rtpso, CommandList cmd) override;
 		void DispatchRays(const DispatchRaysDesc* desc, CommandList cmd) override;
 		void PushConstants(const void* data, uint32_t size, CommandList cmd) override;
@@ -22,6 +22,8 @@ static Shader vs;
 static Shader ps_prepass;
 static Shader ps;
 static Shader ps_simple;
+static Shader ps_overdraw;
+static Shader cs_generate;
 static Shader cs_simulate;
 static Shader cs_finishUpdate;
 static DepthStencilState dss_default, dss_equal;
@@ -29,6 +31,7 @@ static RasterizerState rs, ncrs, wirers;
 static BlendState bs; 
 static PipelineState PSO[RENDERPASS_COUNT];
 static PipelineState PSO_wire;
+static PipelineState PSO_overdraw;
 
 void wiHairParticle::UpdateCPU(const TransformComponent& transform, const MeshComponent& mesh, float dt)
 {
@@ -66,6 +69,9 @@ void wiHairParticle::UpdateCPU(const TransformComponent& transform, const MeshCo
 			if (strandCount*segmentCount > 0)
 			{
 				bd.StructureByteStride = sizeof(Patch);
+				bd.ByteWidth = bd.StructureByteStride * strandCount;
+				device->CreateBuffer(&bd, nullptr, &strandBuffer);
+
 				bd.ByteWidth = bd.StructureByteStride * strandCount * segmentCount;
 				device->CreateBuffer(&bd, nullptr, &particleBuffer);
 
@@ -188,24 +194,31 @@ void wiHairParticle::UpdateGPU(const MeshComponent& mesh, const MaterialComponen
 	hcb.xHairTexMul = float2(1.0f / (float)hcb.xHairFramesXY.x, 1.0f / (float)hcb.xHairFramesXY.y);
 	hcb.xHairAspect = (float)std::max(1u, desc.Width) / (float)std::max(1u, desc.Height);
 	hcb.xHairLayerMask = layerMask;
+	hcb.xHairDensityFalloff = wiMath::Clamp(densityFalloff, 0, 1);
+	const Texture* hiz = wiRenderer::GetGPUCullingHiZ(hcb.xHairOcclusionVP, hcb.xHairOcclusionZNear, hcb.xHairOcclusionZFar);
+	hcb.xHairOcclusion = hiz != nullptr ? 1 : 0;
 	device->UpdateBuffer(&cb, &hcb, cmd);
 
-	// Simulate:
+	device->BindConstantBuffer(CS, &cb, CB_GETBINDSLOT(HairParticleCB), cmd);
+
+	const uint32_t strandGroupCount = (strandCount + THREADCOUNT_SIMULATEHAIR - 1) / THREADCOUNT_SIMULATEHAIR;
+
+	// Generate the rest pose of the strands, only when the surface of the mesh could have changed:
+	const GPUBuffer& vertexBuffer_POS = mesh.streamoutBuffer_POS.IsValid() ? mesh.streamoutBuffer_POS : mesh.vertexBuffer_POS;
+	if (regenerate_frame || mesh.streamoutBuffer_POS.IsValid() || generated_mesh != vertexBuffer_POS.internal_state.get())
 	{
-		device->BindComputeShader(&cs_simulate, cmd);
-		device->BindConstantBuffer(CS, &cb, CB_GETBINDSLOT(HairParticleCB), cmd);
+		generated_mesh = vertexBuffer_POS.internal_state.get();
+
+		device->BindComputeShader(&cs_generate, cmd);
 
 		const GPUResource* uavs[] = {
-			&particleBuffer,
-			&simulationBuffer,
-			&culledIndexBuffer,
-			&indirectBuffer
+			&strandBuffer,
 		};
 		device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
 
 		const GPUResource* res[] = {
 			indexBuffer.IsValid() ? &indexBuffer : &mesh.indexBuffer,
-			mesh.streamoutBuffer_POS.IsValid() ? &mesh.streamoutBuffer_POS : &mesh.vertexBuffer_POS,
+			&vertexBuffer_POS,
 			&vertexBuffer_length
 		};
 		device->BindResources(CS, res, TEXSLOT_ONDEMAND0, arraysize(res), cmd);
@@ -217,7 +230,37 @@ void wiHairParticle::UpdateGPU(const MeshComponent& mesh, const MaterialComponen
 			device->Barrier(barriers, arraysize(barriers), cmd);
 		}
 
-		device->Dispatch(hcb.xHairNumDispatchGroups, 1, 1, cmd);
+		device->Dispatch(strandGroupCount, 1, 1, cmd);
+
+		GPUBarrier barriers[] = {
+			GPUBarrier::Memory(),
+			GPUBarrier::Buffer(&mesh.indexBuffer, BUFFER_STATE_SHADER_RESOURCE, BUFFER_STATE_INDEX_BUFFER),
+		};
+		device->Barrier(barriers, arraysize(barriers), cmd);
+
+		device->UnbindUAVs(0, arraysize(uavs), cmd);
+		device->UnbindResources(TEXSLOT_ONDEMAND0, arraysize(res), cmd);
+	}
+
+	// Simulate, with culling of the strands by distance, frustum and the Hi-Z of the previous frame:
+	{
+		device->BindComputeShader(&cs_simulate, cmd);
+
+		const GPUResource* uavs[] = {
+			&particleBuffer,
+			&simulationBuffer,
+			&culledIndexBuffer,
+			&indirectBuffer
+		};
+		device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+		const GPUResource* res[] = {
+			&strandBuffer,
+			hiz != nullptr ? (const GPUResource*)hiz : wiTextureHelper::getWhite(),
+		};
+		device->BindResources(CS, res, TEXSLOT_ONDEMAND0, arraysize(res), cmd);
+
+		device->Dispatch(strandGroupCount, 1, 1, cmd);
 
 		GPUBarrier barriers[] = {
 			GPUBarrier::Memory()
@@ -250,13 +293,6 @@ void wiHairParticle::UpdateGPU(const MeshComponent& mesh, const MaterialComponen
 		device->UnbindUAVs(0, arraysize(uavs), cmd);
 	}
 
-	{
-		GPUBarrier barriers[] = {
-			GPUBarrier::Buffer(&mesh.indexBuffer, BUFFER_STATE_SHADER_RESOURCE, BUFFER_STATE_INDEX_BUFFER),
-		};
-		device->Barrier(barriers, arraysize(barriers), cmd);
-	}
-
 	device->EventEnd(cmd);
 
 	regenerate_frame = false;
@@ -274,13 +310,13 @@ void wiHairParticle::Draw(const CameraComponent& camera, const MaterialComponent
 
 	device->BindStencilRef(STENCILREF_DEFAULT, cmd);
 
-	if (wiRenderer::IsWireRender())
+	if (wiRenderer::IsWireRender() || wiRenderer::IsOverdrawRender(cmd))
 	{
 		if (renderPass == RENDERPASS_PREPASS)
 		{
 			return;
 		}
-		device->BindPipelineState(&PSO_wire, cmd);
+		device->BindPipelineState(wiRenderer::IsWireRender() ? &PSO_wire : &PSO_overdraw, cmd);
 		device->BindResource(VS, wiTextureHelper::getWhite(), TEXSLOT_ONDEMAND0, cmd);
 	}
 	else
@@ -346,6 +382,11 @@ void wiHairParticle::Serialize(wiArchive& archive, wiECS::EntitySerializer& seri
 			uint8_t shadingRate;
 			archive >> shadingRate; // no longer needed
 		}
+
+		if (archive.GetVersion() >= 83)
+		{
+			archive >> densityFalloff;
+		}
 	}
 	else
 	{
@@ -369,6 +410,11 @@ void wiHairParticle::Serialize(wiArchive& archive, wiECS::EntitySerializer& seri
 			archive << frameCount;
 			archive << frameStart;
 		}
+
+		if (archive.GetVersion() >= 83)
+		{
+			archive << densityFalloff;
+		}
 	}
 }
 
@@ -381,9 +427,11 @@ namespace wiHairParticle_Internal
 		wiRenderer::LoadShader(VS, vs, "hairparticleVS.cso");
 
 		wiRenderer::LoadShader(PS, ps_simple, "hairparticlePS_simple.cso");
+		wiRenderer::LoadShader(PS, ps_overdraw, "overdrawPS.cso");
 		wiRenderer::LoadShader(PS, ps_prepass, "hairparticlePS_prepass.cso");
 		wiRenderer::LoadShader(PS, ps, "hairparticlePS.cso");
 
+		wiRenderer::LoadShader(CS, cs_generate, "hairparticle_generateCS.cso");
 		wiRenderer::LoadShader(CS, cs_simulate, "hairparticle_simulateCS.cso");
 		wiRenderer::LoadShader(CS, cs_finishUpdate, "hairparticle_finishUpdateCS.cso");
 
@@ -426,6 +474,17 @@ namespace wiHairParticle_Internal
 			device->CreatePipelineState(&desc, &PSO_wire);
 		}
 
+		{
+			PipelineStateDesc desc;
+			desc.vs = &vs;
+			desc.ps = &ps_overdraw;
+			desc.bs = wiRenderer::GetBlendState(BSTYPE_ADDITIVE);
+			desc.rs = &ncrs;
+			desc.dss = wiRenderer::GetDepthStencilState(DSSTYPE_XRAY);
+			desc.pt = TRIANGLESTRIP;
+			device->CreatePipelineState(&desc, &PSO_overdraw);
+		}
+
 
 	}
 }
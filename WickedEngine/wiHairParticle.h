@@ -17,6 +17,7 @@ class wiHairParticle
 {
 private:
 	wiGraphics::GPUBuffer cb;
+	wiGraphics::GPUBuffer strandBuffer; // rest pose of the strands in object space
 	wiGraphics::GPUBuffer particleBuffer;
 	wiGraphics::GPUBuffer simulationBuffer;
 	wiGraphics::GPUBuffer culledIndexBuffer;
@@ -24,6 +25,8 @@ private:
 
 	wiGraphics::GPUBuffer indexBuffer;
 	wiGraphics::GPUBuffer vertexBuffer_length;
+
+	mutable const void* generated_mesh = nullptr; // the vertex buffer that the strands were generated from
 public:
 
 	void UpdateCPU(const TransformComponent& transform, const MeshComponent& mesh, float dt);
@@ -47,6 +50,7 @@ public:
 	float stiffness = 10.0f;
 	float randomness = 0.2f;
 	float viewDistance = 200;
+	float densityFalloff = 0.5f; // the strands are thinned out from this fraction of viewDistance, until none are left at viewDistance
 	std::vector<float> vertex_lengths;
 
 	// Sprite sheet properties:
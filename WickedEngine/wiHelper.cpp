@@ -3,6 +3,8 @@
 #include "wiRenderer.h"
 #include "wiBackLog.h"
 #include "wiEvent.h"
+#include "wiPackage.h"
+#include "wiJobSystem.h"
 
 #include "Utility/stb_image_write.h"
 
@@ -14,6 +16,8 @@
 #include <sstream>
 #include <codecvt> // string conversion
 #include <filesystem>
+#include <atomic>
+#include <system_error>
 
 #ifdef _WIN32
 #include <direct.h>
@@ -31,12 +35,69 @@
 #endif // PLATFORM_UWP
 #else
 #include "Utility/portable-file-dialogs.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif // _WIN32
 
 
 namespace wiHelper
 {
 
+	uint64_t HashData(const void* data, size_t size, uint64_t seed)
+	{
+		// Four independent lanes of 64 bit multiply-rotate mixing (similar to xxHash64), so the multiplications can overlap:
+		static constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+		static constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+		static constexpr uint64_t PRIME3 = 0x165667B19E3779F9ull;
+		auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+		auto round = [&](uint64_t acc, uint64_t input) { return rotl(acc + input * PRIME2, 31) * PRIME1; };
+		auto read64 = [](const uint8_t* p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; };
+
+		const uint8_t* p = (const uint8_t*)data;
+		const uint8_t* const end = p + size;
+		uint64_t hash;
+		if (size >= 32)
+		{
+			uint64_t lanes[4] = { seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1 };
+			for (; p + 32 <= end; p += 32)
+			{
+				lanes[0] = round(lanes[0], read64(p));
+				lanes[1] = round(lanes[1], read64(p + 8));
+				lanes[2] = round(lanes[2], read64(p + 16));
+				lanes[3] = round(lanes[3], read64(p + 24));
+			}
+			hash = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+			for (uint64_t lane : lanes)
+			{
+				hash = (hash ^ round(0, lane)) * PRIME1 + PRIME3;
+			}
+		}
+		else
+		{
+			hash = seed + PRIME3;
+		}
+		hash += (uint64_t)size;
+
+		for (; p + 8 <= end; p += 8)
+		{
+			hash = rotl(hash ^ round(0, read64(p)), 27) * PRIME1 + PRIME3;
+		}
+		for (; p < end; ++p)
+		{
+			hash = rotl(hash ^ (*p * PRIME3), 11) * PRIME1;
+		}
+
+		// Final avalanche, so that every input bit affects every output bit:
+		hash ^= hash >> 33;
+		hash *= PRIME2;
+		hash ^= hash >> 29;
+		hash *= PRIME3;
+		hash ^= hash >> 32;
+		return hash;
+	}
+
 	std::string toUpper(const std::string& s)
 	{
 		std::string result;
@@ -87,14 +148,14 @@ namespace wiHelper
 			filename = directory + "/sc_" + getCurrentDateTimeAsString() + ".jpg";
 		}
 
-		bool result = saveTextureToFile(wiRenderer::GetDevice()->GetBackBuffer(&swapchain), filename);
-		assert(result);
-
-		if (result)
-		{
-			std::string msg = "Screenshot saved: " + filename;
-			wiBackLog::post(msg.c_str());
-		}
+		saveTextureToFileAsync(wiRenderer::GetDevice()->GetBackBuffer(&swapchain), filename, [filename](bool result) {
+			assert(result);
+			if (result)
+			{
+				std::string msg = "Screenshot saved: " + filename;
+				wiBackLog::post(msg.c_str());
+			}
+		});
 	}
 
 	bool saveTextureToMemory(const wiGraphics::Texture& texture, std::vector<uint8_t>& texturedata)
@@ -292,6 +353,57 @@ namespace wiHelper
 		return false;
 	}
 
+	// The encoding jobs of the asynchronous saves, nothing waits for them:
+	wiJobSystem::context save_ctx;
+
+	uint64_t saveTextureToFileAsync(const wiGraphics::Texture& texture, const std::string& fileName, std::function<void(bool success)> callback)
+	{
+		using namespace wiGraphics;
+
+		GraphicsDevice* device = wiRenderer::GetDevice();
+		CommandList cmd = device->BeginCommandList();
+		return device->ReadbackTexture(&texture, cmd, [fileName, callback](std::vector<uint8_t>& data, const TextureDesc& desc) {
+			if (data.empty())
+			{
+				if (callback)
+				{
+					callback(false);
+				}
+				return;
+			}
+			wiJobSystem::Execute(save_ctx, [texturedata = std::move(data), desc, fileName, callback](wiJobArgs args) {
+				const bool result = saveTextureToFile(texturedata, desc, fileName);
+				if (callback)
+				{
+					callback(result);
+				}
+			});
+		});
+	}
+
+	uint64_t saveTextureToMemoryFileAsync(const wiGraphics::Texture& texture, const std::string& fileExtension, std::function<void(std::vector<uint8_t>& filedata)> callback)
+	{
+		using namespace wiGraphics;
+
+		GraphicsDevice* device = wiRenderer::GetDevice();
+		CommandList cmd = device->BeginCommandList();
+		return device->ReadbackTexture(&texture, cmd, [fileExtension, callback](std::vector<uint8_t>& data, const TextureDesc& desc) {
+			if (data.empty())
+			{
+				callback(data);
+				return;
+			}
+			wiJobSystem::Execute(save_ctx, [texturedata = std::move(data), desc, fileExtension, callback](wiJobArgs args) {
+				std::vector<uint8_t> filedata;
+				if (!saveTextureToMemoryFile(texturedata, desc, fileExtension, filedata))
+				{
+					filedata.clear();
+				}
+				callback(filedata);
+			});
+		});
+	}
+
 	bool saveTextureToFile(const std::vector<uint8_t>& texturedata, const wiGraphics::TextureDesc& desc, const std::string& fileName)
 	{
 		using namespace wiGraphics;
@@ -417,6 +529,11 @@ namespace wiHelper
 
 	bool FileRead(const std::string& fileName, std::vector<uint8_t>& data)
 	{
+		if (wiPackage::Read(fileName, data))
+		{
+			return true;
+		}
+
 #ifndef PLATFORM_UWP
 #ifdef SDL_FILESYSTEM_UNIX
 		std::string filepath = fileName;
@@ -492,6 +609,71 @@ namespace wiHelper
 		return false;
 	}
 
+	std::shared_ptr<const uint8_t> FileMap(const std::string& fileName, size_t& size)
+	{
+		size = 0;
+		if (wiPackage::Contains(fileName))
+		{
+			// Files in packages are mapped views of the package, unless they are compressed, then they are read by FileRead():
+			return wiPackage::Map(fileName, size);
+		}
+#if defined(_WIN32) && !defined(PLATFORM_UWP)
+		std::wstring wstr;
+		StringConvert(fileName, wstr);
+		HANDLE file = CreateFileW(wstr.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return nullptr;
+		}
+		LARGE_INTEGER filesize = {};
+		if (!GetFileSizeEx(file, &filesize) || filesize.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return nullptr;
+		}
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (mapping == nullptr)
+		{
+			return nullptr;
+		}
+		// The view keeps the mapping alive after its handle is closed:
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (view == nullptr)
+		{
+			return nullptr;
+		}
+		size = (size_t)filesize.QuadPart;
+		return std::shared_ptr<const uint8_t>((const uint8_t*)view, [](const uint8_t* data) { UnmapViewOfFile(data); });
+#elif !defined(_WIN32)
+		std::string filepath = fileName;
+		std::replace(filepath.begin(), filepath.end(), '\\', '/');
+		int file = open(filepath.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			return nullptr;
+		}
+		struct stat filestat = {};
+		if (fstat(file, &filestat) != 0 || filestat.st_size <= 0)
+		{
+			close(file);
+			return nullptr;
+		}
+		void* view = mmap(nullptr, (size_t)filestat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		close(file);
+		if (view == MAP_FAILED)
+		{
+			return nullptr;
+		}
+		const size_t viewsize = (size_t)filestat.st_size;
+		size = viewsize;
+		return std::shared_ptr<const uint8_t>((const uint8_t*)view, [viewsize](const uint8_t* data) { munmap((void*)data, viewsize); });
+#else
+		return nullptr;
+#endif
+	}
+
 	bool FileWrite(const std::string& fileName, const uint8_t* data, size_t size)
 	{
 		if (size <= 0)
@@ -565,8 +747,38 @@ namespace wiHelper
 		return false;
 	}
 
+	bool FileWriteAtomic(const std::string& fileName, const uint8_t* data, size_t size)
+	{
+		static std::atomic<uint32_t> tempfile_counter{ 0 };
+
+		const std::filesystem::path directory = std::filesystem::path(fileName).parent_path();
+		if (!directory.empty())
+		{
+			DirectoryCreate(directory.string());
+		}
+		const std::string tempfile = fileName + "." + std::to_string(tempfile_counter.fetch_add(1)) + ".tmp";
+		if (!FileWrite(tempfile, data, size))
+		{
+			return false;
+		}
+
+		// std::filesystem::rename() replaces an existing file on every platform (std::rename() fails for it on Windows):
+		std::error_code ec;
+		std::filesystem::rename(tempfile, fileName, ec);
+		if (ec)
+		{
+			std::filesystem::remove(tempfile, ec);
+			return false;
+		}
+		return true;
+	}
+
 	bool FileExists(const std::string& fileName)
 	{
+		if (wiPackage::Contains(fileName))
+		{
+			return true;
+		}
 		bool exists = std::filesystem::exists(fileName);
 		return exists;
 	}
@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <memory>
 
 namespace wiHelper
 {
@@ -31,10 +32,14 @@ namespace wiHelper
 		return hash;
 	}
 
+	// Fast 64 bit hash of memory contents, for identifying file contents (not cryptographic)
+	uint64_t HashData(const void* data, size_t size, uint64_t seed = 0);
+
 	std::string toUpper(const std::string& s);
 
 	void messageBox(const std::string& msg, const std::string& caption = "Warning!");
 
+	// Saves the back buffer to a file, without waiting for the GPU (the file is written by a background job a few frames later)
 	void screenshot(const wiGraphics::SwapChain& swapchain, const std::string& name = "");
 
 	// Save raw pixel data from the texture to memory
@@ -52,6 +57,16 @@ namespace wiHelper
 	// Save raw texture data to file format
 	bool saveTextureToFile(const std::vector<uint8_t>& texturedata, const wiGraphics::TextureDesc& desc, const std::string& fileName);
 
+	// Save texture to file format without waiting for the GPU: the texture is read back asynchronously (GraphicsDevice::ReadbackTexture()),
+	//	and the file is encoded and written by a background job. If the callback is set, it is called by the job with the result
+	//	Returns the readback ticket
+	uint64_t saveTextureToFileAsync(const wiGraphics::Texture& texture, const std::string& fileName, std::function<void(bool success)> callback = nullptr);
+
+	// Save texture to memory as a file format without waiting for the GPU, like saveTextureToFileAsync()
+	//	The callback is called by the encoding job with the file data, it is empty if the readback or the encoding failed
+	//	Returns the readback ticket
+	uint64_t saveTextureToMemoryFileAsync(const wiGraphics::Texture& texture, const std::string& fileExtension, std::function<void(std::vector<uint8_t>& filedata)> callback);
+
 	std::string getCurrentDateTimeAsString();
 
 	void SplitPath(const std::string& fullPath, std::string& dir, std::string& fileName);
@@ -72,8 +87,16 @@ namespace wiHelper
 
 	bool FileRead(const std::string& fileName, std::vector<uint8_t>& data);
 
+	// Map the file contents into memory for reading, the view stays valid while the returned pointer is alive
+	//	Returns nullptr if the file can't be mapped (for example it is empty, or the platform doesn't support it), then FileRead() can be used instead
+	std::shared_ptr<const uint8_t> FileMap(const std::string& fileName, size_t& size);
+
 	bool FileWrite(const std::string& fileName, const uint8_t* data, size_t size);
 
+	// Writes the file through a temporary file that replaces it when it is complete, so that concurrent readers never see a partially written file (for example in the caches)
+	//	The directory of the file is created if it doesn't exist. Returns false if the file could not be written or replaced
+	bool FileWriteAtomic(const std::string& fileName, const uint8_t* data, size_t size);
+
 	bool FileExists(const std::string& fileName);
 
 	struct FileDialogParams
@@ -9,6 +9,10 @@
 #include "wiEvent.h"
 
 #include <atomic>
+#include <vector>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
 
 using namespace wiGraphics;
 
@@ -34,8 +38,13 @@ namespace wiImage
 	RasterizerState			rasterizerState;
 	DepthStencilState		depthStencilStates[STENCILMODE_COUNT][STENCILREFMODE_COUNT];
 	PipelineState			imagePSO[IMAGE_SHADER_COUNT][BLENDMODE_COUNT][STENCILMODE_COUNT][STENCILREFMODE_COUNT];
+	Shader					batchVS;
+	Shader					batchPS;
+	PipelineState			batchPSO[BLENDMODE_COUNT][STENCILMODE_COUNT][STENCILREFMODE_COUNT];
 	Texture					backgroundTextures[COMMANDLIST_COUNT];
 	wiCanvas				canvases[COMMANDLIST_COUNT];
+	DrawRecord*				records[COMMANDLIST_COUNT] = {};
+	bool					layerRendering[COMMANDLIST_COUNT] = {};
 
 	std::atomic_bool initialized{ false };
 
@@ -49,23 +58,8 @@ namespace wiImage
 		canvases[cmd] = canvas;
 	}
 
-	void Draw(const Texture* texture, const wiImageParams& params, CommandList cmd)
+	const Sampler* GetImageSampler(const wiImageParams& params)
 	{
-		if (!initialized.load())
-		{
-			return;
-		}
-
-		GraphicsDevice* device = wiRenderer::GetDevice();
-		device->EventBegin("Image", cmd);
-
-		uint32_t stencilRef = params.stencilRef;
-		if (params.stencilRefMode == STENCILREFMODE_USER)
-		{
-			stencilRef = wiRenderer::CombineStencilrefs(STENCILREF_EMPTY, (uint8_t)stencilRef);
-		}
-		device->BindStencilRef(stencilRef, cmd);
-
 		const Sampler* sampler = wiRenderer::GetSampler(SSLOT_LINEAR_CLAMP);
 
 		if (params.quality == QUALITY_NEAREST)
@@ -96,41 +90,33 @@ namespace wiImage
 				sampler = wiRenderer::GetSampler(SSLOT_ANISO_CLAMP);
 		}
 
-		if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS))
-		{
-			PushConstantsImage push;
-			push.texture_base_index = device->GetDescriptorIndex(texture, SRV);
-			push.texture_mask_index = device->GetDescriptorIndex(params.maskMap, SRV);
-			push.texture_background_index = device->GetDescriptorIndex(&backgroundTextures[cmd], SRV);
-			push.sampler_index = device->GetDescriptorIndex(sampler);
-			device->PushConstants(&push, sizeof(push), cmd);
-		}
-		else
+		return sampler;
+	}
+
+	uint32_t GetImageStencilRef(const wiImageParams& params)
+	{
+		uint32_t stencilRef = params.stencilRef;
+		if (params.stencilRefMode == STENCILREFMODE_USER)
 		{
-			device->BindResource(PS, texture, TEXSLOT_IMAGE_BASE, cmd);
-			device->BindResource(PS, params.maskMap, TEXSLOT_IMAGE_MASK, cmd);
-			device->BindResource(PS, &backgroundTextures[cmd], TEXSLOT_IMAGE_BACKGROUND, cmd);
-			device->BindSampler(PS, sampler, SSLOT_ONDEMAND0, cmd);
+			stencilRef = wiRenderer::CombineStencilrefs(STENCILREF_EMPTY, (uint8_t)stencilRef);
 		}
+		return stencilRef;
+	}
 
-		ImageCB cb;
-		cb.xColor = params.color;
+	XMFLOAT4 GetImageColor(const wiImageParams& params)
+	{
+		XMFLOAT4 color = params.color;
 		const float darken = 1 - params.fade;
-		cb.xColor.x *= darken;
-		cb.xColor.y *= darken;
-		cb.xColor.z *= darken;
-		cb.xColor.w *= params.opacity;
-
-		if (params.isFullScreenEnabled())
-		{
-			device->BindPipelineState(&imagePSO[IMAGE_SHADER_FULLSCREEN][params.blendFlag][params.stencilComp][params.stencilRefMode], cmd);
-			device->UpdateBuffer(&constantBuffer, &cb, cmd);
-			device->BindConstantBuffer(PS, &constantBuffer, CB_GETBINDSLOT(ImageCB), cmd);
-			device->Draw(3, 0, cmd);
-			device->EventEnd(cmd);
-			return;
-		}
+		color.x *= darken;
+		color.y *= darken;
+		color.z *= darken;
+		color.w *= params.opacity;
+		return color;
+	}
 
+	// Computes the projected corners of the image quad
+	void GetImageCorners(const wiImageParams& params, CommandList cmd, XMFLOAT4& corners0, XMFLOAT4& corners1, XMFLOAT4& corners2, XMFLOAT4& corners3)
+	{
 		XMMATRIX M = XMMatrixScaling(params.scale.x * params.siz.x, params.scale.y * params.siz.y, 1);
 		M = M * XMMatrixRotationZ(params.rotation);
 
@@ -167,19 +153,19 @@ namespace wiImage
 		//PE: Fix AMD issue - cant index dynamically (Black Screen).
 		XMVECTOR V = XMVectorSet(params.corners[0].x - params.pivot.x, params.corners[0].y - params.pivot.y, 0, 1);
 		V = XMVector2Transform(V, M); // division by w will happen on GPU
-		XMStoreFloat4(&cb.corners0, V);
+		XMStoreFloat4(&corners0, V);
 
 		V = XMVectorSet(params.corners[1].x - params.pivot.x, params.corners[1].y - params.pivot.y, 0, 1);
 		V = XMVector2Transform(V, M); // division by w will happen on GPU
-		XMStoreFloat4(&cb.corners1, V);
+		XMStoreFloat4(&corners1, V);
 
 		V = XMVectorSet(params.corners[2].x - params.pivot.x, params.corners[2].y - params.pivot.y, 0, 1);
 		V = XMVector2Transform(V, M); // division by w will happen on GPU
-		XMStoreFloat4(&cb.corners2, V);
+		XMStoreFloat4(&corners2, V);
 
 		V = XMVectorSet(params.corners[3].x - params.pivot.x, params.corners[3].y - params.pivot.y, 0, 1);
 		V = XMVector2Transform(V, M); // division by w will happen on GPU
-		XMStoreFloat4(&cb.corners3, V);
+		XMStoreFloat4(&corners3, V);
 
 		if (params.isMirrorEnabled())
 		{
@@ -187,41 +173,364 @@ namespace wiImage
 			//std::swap(cb.xCorners[2], cb.xCorners[3]);
 
 			//PE: Fix AMD issue - cant index dynamically (Black Screen).
-			std::swap(cb.corners0, cb.corners1);
-			std::swap(cb.corners2, cb.corners3);
+			std::swap(corners0, corners1);
+			std::swap(corners2, corners3);
 		}
+	}
 
-		const TextureDesc& desc = texture->GetDesc();
-		const float inv_width = 1.0f / float(desc.Width);
-		const float inv_height = 1.0f / float(desc.Height);
+	// Computes the texture coordinate multiply-add of a draw rect and texture offset
+	XMFLOAT4 GetImageTexMulAdd(bool drawRectEnabled, const XMFLOAT4& drawRect, const XMFLOAT2& texOffset, float inv_width, float inv_height)
+	{
+		XMFLOAT4 texMulAdd;
+		if (drawRectEnabled)
+		{
+			texMulAdd.x = drawRect.z * inv_width;	// drawRec.width: mul
+			texMulAdd.y = drawRect.w * inv_height;	// drawRec.heigh: mul
+			texMulAdd.z = drawRect.x * inv_width;	// drawRec.x: add
+			texMulAdd.w = drawRect.y * inv_height;	// drawRec.y: add
+		}
+		else
+		{
+			texMulAdd = XMFLOAT4(1, 1, 0, 0);	// disabled draw rect
+		}
+		texMulAdd.z += texOffset.x * inv_width;	// texOffset.x: add
+		texMulAdd.w += texOffset.y * inv_height;	// texOffset.y: add
+		return texMulAdd;
+	}
 
-		if (params.isDrawRectEnabled())
+	// Batching:
+	//	Consecutive images that only differ in their quads, colors and textures are merged into one instanced draw of the batched shaders,
+	//	their instances are collected on the CPU, and written into a GPU allocation when the batch is flushed
+	//	Without bindless descriptors, the texture is part of the batch state, so only images of the same texture (or atlas) are merged
+	struct Batch
+	{
+		bool enabled = false;
+		const Texture* texture = nullptr; // nullptr with bindless descriptors
+		const Sampler* sampler = nullptr;
+		BLENDMODE blendFlag = BLENDMODE_ALPHA;
+		STENCILMODE stencilComp = STENCILMODE_DISABLED;
+		STENCILREFMODE stencilRefMode = STENCILREFMODE_ALL;
+		uint32_t stencilRef = 0;
+		std::vector<ImageInstance> instances;
+	};
+	Batch batches[COMMANDLIST_COUNT];
+	static_assert(sizeof(ImageInstance) == 112, "imageVS_batched.hlsl reads the instances with this stride");
+
+	// Only the images of the standard shader can be batched
+	inline bool IsBatchable(const wiImageParams& params)
+	{
+		return
+			!params.isFullScreenEnabled() &&
+			!params.isExtractNormalMapEnabled() &&
+			!params.isBackgroundEnabled() &&
+			params.maskMap == nullptr;
+	}
+
+	void BeginBatch(CommandList cmd)
+	{
+		batches[cmd].enabled = true;
+	}
+
+	void FlushBatch(CommandList cmd)
+	{
+		Batch& batch = batches[cmd];
+		if (batch.instances.empty())
 		{
-			cb.xTexMulAdd.x = params.drawRect.z * inv_width;	// drawRec.width: mul
-			cb.xTexMulAdd.y = params.drawRect.w * inv_height;	// drawRec.heigh: mul
-			cb.xTexMulAdd.z = params.drawRect.x * inv_width;	// drawRec.x: add
-			cb.xTexMulAdd.w = params.drawRect.y * inv_height;	// drawRec.y: add
+			return;
+		}
+
+		GraphicsDevice* device = wiRenderer::GetDevice();
+
+		const uint32_t instanceCount = (uint32_t)batch.instances.size();
+		GraphicsDevice::GPUAllocation mem = device->AllocateGPU(sizeof(ImageInstance) * instanceCount, cmd);
+		if (!mem.IsValid())
+		{
+			batch.instances.clear();
+			return;
+		}
+		memcpy(mem.data, batch.instances.data(), sizeof(ImageInstance) * instanceCount);
+		batch.instances.clear();
+
+		device->EventBegin("Image Batch", cmd);
+
+		device->BindStencilRef(batch.stencilRef, cmd);
+		device->BindPipelineState(&batchPSO[batch.blendFlag][batch.stencilComp][batch.stencilRefMode], cmd);
+
+		if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS))
+		{
+			PushConstantsImage push;
+			push.texture_base_index = -1;
+			push.texture_mask_index = -1;
+			push.texture_background_index = -1;
+			push.sampler_index = device->GetDescriptorIndex(batch.sampler);
+			device->PushConstants(&push, sizeof(push), cmd);
 		}
 		else
 		{
-			cb.xTexMulAdd = XMFLOAT4(1, 1, 0, 0);	// disabled draw rect
+			device->BindResource(PS, batch.texture, TEXSLOT_IMAGE_BASE, cmd);
+			device->BindSampler(PS, batch.sampler, SSLOT_ONDEMAND0, cmd);
+		}
+
+		ImageCB cb = {};
+		cb.xInstanceOffset = mem.offset;
+		device->UpdateBuffer(&constantBuffer, &cb, cmd);
+		device->BindConstantBuffer(VS, &constantBuffer, CB_GETBINDSLOT(ImageCB), cmd);
+		device->BindResource(VS, mem.buffer, 0, cmd);
+
+		device->DrawInstanced(4, instanceCount, 0, 0, cmd);
+
+		device->EventEnd(cmd);
+	}
+
+	void EndBatch(CommandList cmd)
+	{
+		FlushBatch(cmd);
+		batches[cmd].enabled = false;
+	}
+
+	void DrawRecord::Clear(const Rect& clip_rect)
+	{
+		hash = 0;
+		clip = clip_rect;
+		bounds = { 0, 0, 0, 0 };
+		backgrounds.clear();
+	}
+	void DrawRecord::Hash(const void* data, size_t size)
+	{
+		// FNV-1a, combined with the draws recorded before:
+		size_t value = sizeof(size_t) == 8 ? 0xcbf29ce484222325 : 0x811c9dc5;
+		const size_t prime = sizeof(size_t) == 8 ? 0x00000100000001b3 : 0x01000193;
+		const uint8_t* bytes = (const uint8_t*)data;
+		for (size_t i = 0; i < size; ++i)
+		{
+			value ^= size_t(bytes[i]);
+			value *= prime;
+		}
+		wiHelper::hash_combine(hash, value);
+	}
+	inline bool ClipBounds(const Rect& clip, float left, float top, float right, float bottom, Rect& result)
+	{
+		result.left = std::max(clip.left, (int32_t)std::floor(std::max(left, -1e6f)));
+		result.top = std::max(clip.top, (int32_t)std::floor(std::max(top, -1e6f)));
+		result.right = std::min(clip.right, (int32_t)std::ceil(std::min(right, 1e6f)));
+		result.bottom = std::min(clip.bottom, (int32_t)std::ceil(std::min(bottom, 1e6f)));
+		return result.left < result.right && result.top < result.bottom;
+	}
+	void DrawRecord::AddBounds(float left, float top, float right, float bottom)
+	{
+		Rect rect;
+		if (!ClipBounds(clip, left, top, right, bottom, rect))
+		{
+			return;
+		}
+		if (bounds.left >= bounds.right || bounds.top >= bounds.bottom)
+		{
+			bounds = rect;
+			return;
+		}
+		bounds.left = std::min(bounds.left, rect.left);
+		bounds.top = std::min(bounds.top, rect.top);
+		bounds.right = std::max(bounds.right, rect.right);
+		bounds.bottom = std::max(bounds.bottom, rect.bottom);
+	}
+	void DrawRecord::AddBackground(float left, float top, float right, float bottom)
+	{
+		Rect rect;
+		if (ClipBounds(clip, left, top, right, bottom, rect))
+		{
+			backgrounds.push_back(rect);
+		}
+	}
+	void SetRecord(DrawRecord* record, CommandList cmd)
+	{
+		records[cmd] = record;
+	}
+	DrawRecord* GetRecord(CommandList cmd)
+	{
+		return records[cmd];
+	}
+	void SetLayerRendering(bool value, CommandList cmd)
+	{
+		layerRendering[cmd] = value;
+	}
+
+	// Hash the parameters of an image draw into the record, and add its bounds
+	void RecordImage(DrawRecord& record, const Texture* texture, const wiImageParams& params, CommandList cmd)
+	{
+		// The fields are hashed one by one, because the params contain padding:
+		record.Hash(&texture, sizeof(texture));
+		record.Hash(&params._flags, sizeof(params._flags));
+		record.Hash(&params.pos, sizeof(params.pos));
+		record.Hash(&params.siz, sizeof(params.siz));
+		record.Hash(&params.scale, sizeof(params.scale));
+		record.Hash(&params.color, sizeof(params.color));
+		record.Hash(&params.drawRect, sizeof(params.drawRect));
+		record.Hash(&params.drawRect2, sizeof(params.drawRect2));
+		record.Hash(&params.texOffset, sizeof(params.texOffset));
+		record.Hash(&params.texOffset2, sizeof(params.texOffset2));
+		record.Hash(&params.pivot, sizeof(params.pivot));
+		record.Hash(&params.rotation, sizeof(params.rotation));
+		record.Hash(&params.fade, sizeof(params.fade));
+		record.Hash(&params.opacity, sizeof(params.opacity));
+		record.Hash(&params.corners, sizeof(params.corners));
+		if (params.customRotation != nullptr)
+		{
+			record.Hash(params.customRotation, sizeof(XMMATRIX));
+		}
+		if (params.customProjection != nullptr)
+		{
+			record.Hash(params.customProjection, sizeof(XMMATRIX));
+		}
+		record.Hash(&params.stencilRef, sizeof(params.stencilRef));
+		record.Hash(&params.stencilComp, sizeof(params.stencilComp));
+		record.Hash(&params.stencilRefMode, sizeof(params.stencilRefMode));
+		record.Hash(&params.blendFlag, sizeof(params.blendFlag));
+		record.Hash(&params.sampleFlag, sizeof(params.sampleFlag));
+		record.Hash(&params.quality, sizeof(params.quality));
+		record.Hash(&params.maskMap, sizeof(params.maskMap));
+		record.Hash(&record.clip, sizeof(record.clip));
+
+		float left = -FLT_MAX;
+		float top = -FLT_MAX;
+		float right = FLT_MAX;
+		float bottom = FLT_MAX;
+		if (!params.isFullScreenEnabled() && params.customProjection == nullptr)
+		{
+			// The corners in canvas space, like GetImageCorners() without the projection:
+			XMMATRIX M = XMMatrixScaling(params.scale.x * params.siz.x, params.scale.y * params.siz.y, 1);
+			M = M * XMMatrixRotationZ(params.rotation);
+			if (params.customRotation != nullptr)
+			{
+				M = M * (*params.customRotation);
+			}
+			M = M * XMMatrixTranslation(params.pos.x, params.pos.y, params.pos.z);
+			for (int i = 0; i < 4; ++i)
+			{
+				XMFLOAT2 corner;
+				XMStoreFloat2(&corner, XMVector2Transform(XMVectorSet(params.corners[i].x - params.pivot.x, params.corners[i].y - params.pivot.y, 0, 1), M));
+				left = i == 0 ? corner.x : std::min(left, corner.x);
+				top = i == 0 ? corner.y : std::min(top, corner.y);
+				right = i == 0 ? corner.x : std::max(right, corner.x);
+				bottom = i == 0 ? corner.y : std::max(bottom, corner.y);
+			}
+		}
+		record.AddBounds(left, top, right, bottom);
+		if (params.isBackgroundEnabled())
+		{
+			record.AddBackground(left, top, right, bottom);
+		}
+	}
+
+	void Draw(const Texture* texture, const wiImageParams& params, CommandList cmd)
+	{
+		if (!initialized.load())
+		{
+			return;
 		}
-		cb.xTexMulAdd.z += params.texOffset.x * inv_width;	// texOffset.x: add
-		cb.xTexMulAdd.w += params.texOffset.y * inv_height;	// texOffset.y: add
 
-		if (params.isDrawRect2Enabled())
+		if (records[cmd] != nullptr)
 		{
-			cb.xTexMulAdd2.x = params.drawRect2.z * inv_width;	// drawRec.width: mul
-			cb.xTexMulAdd2.y = params.drawRect2.w * inv_height;	// drawRec.heigh: mul
-			cb.xTexMulAdd2.z = params.drawRect2.x * inv_width;	// drawRec.x: add
-			cb.xTexMulAdd2.w = params.drawRect2.y * inv_height;	// drawRec.y: add
+			RecordImage(*records[cmd], texture, params, cmd);
+			return;
+		}
+
+		if (layerRendering[cmd] && params.isBackgroundEnabled())
+		{
+			// The image replaces what's under it in the layer, with its premultiplied color:
+			wiImageParams fx = params;
+			fx.disableBackground();
+			fx.blendFlag = BLENDMODE_OPAQUE;
+			fx.color = XMFLOAT4(0, 0, 0, 0);
+			Draw(texture, fx, cmd);
+			fx.blendFlag = BLENDMODE_ALPHA;
+			fx.color = params.color;
+			Draw(texture, fx, cmd);
+			return;
+		}
+
+		GraphicsDevice* device = wiRenderer::GetDevice();
+		const Sampler* sampler = GetImageSampler(params);
+		const uint32_t stencilRef = GetImageStencilRef(params);
+
+		Batch& batch = batches[cmd];
+		if (batch.enabled && IsBatchable(params))
+		{
+			const bool bindless = device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS);
+			const Texture* batchTexture = bindless ? nullptr : texture;
+			if (!batch.instances.empty() && (
+				batch.texture != batchTexture ||
+				batch.sampler != sampler ||
+				batch.blendFlag != params.blendFlag ||
+				batch.stencilComp != params.stencilComp ||
+				batch.stencilRefMode != params.stencilRefMode ||
+				batch.stencilRef != stencilRef
+				))
+			{
+				FlushBatch(cmd);
+			}
+			batch.texture = batchTexture;
+			batch.sampler = sampler;
+			batch.blendFlag = params.blendFlag;
+			batch.stencilComp = params.stencilComp;
+			batch.stencilRefMode = params.stencilRefMode;
+			batch.stencilRef = stencilRef;
+
+			const TextureDesc& desc = texture->GetDesc();
+			ImageInstance& instance = batch.instances.emplace_back();
+			GetImageCorners(params, cmd, instance.corners0, instance.corners1, instance.corners2, instance.corners3);
+			instance.texMulAdd = GetImageTexMulAdd(params.isDrawRectEnabled(), params.drawRect, params.texOffset, 1.0f / float(desc.Width), 1.0f / float(desc.Height));
+			instance.color = GetImageColor(params);
+			instance.texture_index = bindless ? device->GetDescriptorIndex(texture, SRV) : -1;
+			instance.padding0 = 0;
+			instance.padding1 = 0;
+			instance.padding2 = 0;
+			return;
+		}
+
+		// The images that are drawn right away must be on top of the batched ones before them:
+		FlushBatch(cmd);
+
+		device->EventBegin("Image", cmd);
+
+		device->BindStencilRef(stencilRef, cmd);
+
+		if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS))
+		{
+			PushConstantsImage push;
+			push.texture_base_index = device->GetDescriptorIndex(texture, SRV);
+			push.texture_mask_index = device->GetDescriptorIndex(params.maskMap, SRV);
+			push.texture_background_index = device->GetDescriptorIndex(&backgroundTextures[cmd], SRV);
+			push.sampler_index = device->GetDescriptorIndex(sampler);
+			device->PushConstants(&push, sizeof(push), cmd);
 		}
 		else
 		{
-			cb.xTexMulAdd2 = XMFLOAT4(1, 1, 0, 0);	// disabled draw rect
+			device->BindResource(PS, texture, TEXSLOT_IMAGE_BASE, cmd);
+			device->BindResource(PS, params.maskMap, TEXSLOT_IMAGE_MASK, cmd);
+			device->BindResource(PS, &backgroundTextures[cmd], TEXSLOT_IMAGE_BACKGROUND, cmd);
+			device->BindSampler(PS, sampler, SSLOT_ONDEMAND0, cmd);
 		}
-		cb.xTexMulAdd2.z += params.texOffset2.x * inv_width;	// texOffset.x: add
-		cb.xTexMulAdd2.w += params.texOffset2.y * inv_height;	// texOffset.y: add
+
+		ImageCB cb = {};
+		cb.xColor = GetImageColor(params);
+
+		if (params.isFullScreenEnabled())
+		{
+			device->BindPipelineState(&imagePSO[IMAGE_SHADER_FULLSCREEN][params.blendFlag][params.stencilComp][params.stencilRefMode], cmd);
+			device->UpdateBuffer(&constantBuffer, &cb, cmd);
+			device->BindConstantBuffer(PS, &constantBuffer, CB_GETBINDSLOT(ImageCB), cmd);
+			device->Draw(3, 0, cmd);
+			device->EventEnd(cmd);
+			return;
+		}
+
+		GetImageCorners(params, cmd, cb.corners0, cb.corners1, cb.corners2, cb.corners3);
+
+		const TextureDesc& desc = texture->GetDesc();
+		const float inv_width = 1.0f / float(desc.Width);
+		const float inv_height = 1.0f / float(desc.Height);
+		cb.xTexMulAdd = GetImageTexMulAdd(params.isDrawRectEnabled(), params.drawRect, params.texOffset, inv_width, inv_height);
+		cb.xTexMulAdd2 = GetImageTexMulAdd(params.isDrawRect2Enabled(), params.drawRect2, params.texOffset2, inv_width, inv_height);
 
 		device->UpdateBuffer(&constantBuffer, &cb, cmd);
 
@@ -285,6 +594,9 @@ namespace wiImage
 		wiRenderer::LoadShader(PS, imagePS[IMAGE_SHADER_BACKGROUND_MASKED], "imagePS_backgroundblur_masked.cso");
 		wiRenderer::LoadShader(PS, imagePS[IMAGE_SHADER_FULLSCREEN], "screenPS.cso");
 
+		wiRenderer::LoadShader(VS, batchVS, "imageVS_batched.cso");
+		wiRenderer::LoadShader(PS, batchPS, "imagePS_batched.cso");
+
 
 		GraphicsDevice* device = wiRenderer::GetDevice();
 
@@ -317,6 +629,27 @@ namespace wiImage
 			}
 		}
 
+		{
+			PipelineStateDesc desc;
+			desc.vs = &batchVS;
+			desc.ps = &batchPS;
+			desc.rs = &rasterizerState;
+			desc.pt = TRIANGLESTRIP;
+
+			for (int j = 0; j < BLENDMODE_COUNT; ++j)
+			{
+				desc.bs = &blendStates[j];
+				for (int k = 0; k < STENCILMODE_COUNT; ++k)
+				{
+					for (int m = 0; m < STENCILREFMODE_COUNT; ++m)
+					{
+						desc.dss = &depthStencilStates[k][m];
+						device->CreatePipelineState(&desc, &batchPSO[j][k][m]);
+					}
+				}
+			}
+		}
+
 
 	}
 
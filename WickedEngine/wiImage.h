@@ -5,6 +5,8 @@
 #include "wiColor.h"
 #include "wiCanvas.h"
 
+#include <vector>
+
 struct wiImageParams;
 
 namespace wiImage
@@ -18,6 +20,39 @@ namespace wiImage
 	// Draw the specified texture with the specified parameters
 	void Draw(const wiGraphics::Texture* texture, const wiImageParams& params, wiGraphics::CommandList cmd);
 
+	// Batch the images of this CommandList until EndBatch(): consecutive Draw() calls with the same states are merged into one instanced draw call
+	//	The blend mode, stencil and sampler must match, and the texture too if the device doesn't support bindless descriptors
+	//	Images with a mask, background, normal map extraction or full screen can't be batched, they flush the batch and they are drawn right away
+	//	The drawing order is kept, but the batch must be flushed before any other rendering on the CommandList (wiFont does it)
+	void BeginBatch(wiGraphics::CommandList cmd);
+	// Draw the images that were batched until now
+	void FlushBatch(wiGraphics::CommandList cmd);
+	// Flush and stop batching
+	void EndBatch(wiGraphics::CommandList cmd);
+
+	// Draw recording: while a record is set for a CommandList, the image and font draws are not rendered,
+	//	their parameters are hashed, and their screen bounds are accumulated instead
+	//	wiGUI uses it to find out which widgets draw something different than when they were rendered last time
+	struct DrawRecord
+	{
+		size_t hash = 0;
+		wiGraphics::Rect clip; // the draws are limited to this rect (logical canvas units), the recorder sets it (like wiWidget::ApplyScissor())
+		wiGraphics::Rect bounds = { 0, 0, 0, 0 }; // union of the draws within the clip rect (logical canvas units)
+		std::vector<wiGraphics::Rect> backgrounds; // bounds of the images with background blur
+
+		void Clear(const wiGraphics::Rect& clip_rect);
+		void Hash(const void* data, size_t size);
+		// Add the clipped bounds of a draw
+		void AddBounds(float left, float top, float right, float bottom);
+		void AddBackground(float left, float top, float right, float bottom);
+	};
+	void SetRecord(DrawRecord* record, wiGraphics::CommandList cmd); // nullptr: stop recording
+	DrawRecord* GetRecord(wiGraphics::CommandList cmd);
+
+	// Layer rendering: the images with background blur are drawn without the background into a layer with premultiplied alpha,
+	//	replacing what's under them. The background must be drawn under their bounds before the layer is composited
+	void SetLayerRendering(bool value, wiGraphics::CommandList cmd);
+
 	// Initialize the image renderer
 	void Initialize();
 };
@@ -3,11 +3,14 @@
 
 #include <string>
 #include <sstream>
+#include <initializer_list>
 
 namespace wiInitializer
 {
 	bool initializationStarted = false;
 	wiJobSystem::context ctx;
+	wiJobSystem::TaskGraph graph;
+	wiTimer timer;
 
 	void InitializeComponentsImmediate()
 	{
@@ -16,7 +19,9 @@ namespace wiInitializer
 	}
 	void InitializeComponentsAsync()
 	{
+		wiJobSystem::Wait(ctx); // the graph of a previous initialization must not be running
 		initializationStarted = true;
+		timer.record();
 
 		std::stringstream ss;
 		ss << std::endl << "[wiInitializer] Initializing Wicked Engine, please wait..." << std::endl;
@@ -26,6 +31,39 @@ namespace wiInitializer
 		wiJobSystem::Initialize();
 		wiShaderCompiler::Initialize();
 
+		wiMemoryTracker::SetMeasurement(wiMemoryTracker::TAG_ECS, [] {
+			return wiScene::GetScene().GetMemoryUsage().reserved;
+		});
+		wiMemoryTracker::SetMeasurement(wiMemoryTracker::TAG_MESH_DATA, [] {
+			const wiScene::Scene& scene = wiScene::GetScene();
+			size_t size = 0;
+			for (size_t i = 0; i < scene.meshes.GetCount(); ++i)
+			{
+				size += scene.meshes[i].GetCPUDataSize();
+			}
+			return size;
+		});
+		wiMemoryTracker::SetMeasurement(wiMemoryTracker::TAG_RESOURCE_FILEDATA, [] {
+			return wiResourceManager::GetRetainedFileDataSize();
+		});
+
+		wiCounters::SetMeasurement(wiCounters::Register("JobSystem.QueueDepth"), [] {
+			return (double)wiJobSystem::GetQueueDepth();
+		});
+		wiCounters::SetMeasurement(wiCounters::Register("GPU.UploadBytes"), [] {
+			wiGraphics::GraphicsDevice* device = wiRenderer::GetDevice();
+			return device == nullptr ? 0.0 : (double)device->GetGPUAllocatorStatistics().frameBytes;
+		});
+		wiCounters::SetMeasurement(wiCounters::Register("GPU.FrameTime"), [] {
+			return (double)wiProfiler::GetGPUFrameTime();
+		});
+		wiCounters::SetMeasurement(wiCounters::Register("Resources.StreamedMB"), [] {
+			return wiResourceManager::GetResidencyStatistics().streamedInBytes / 1024.0 / 1024.0;
+		});
+
+		// The shader bundle is mounted before the systems start loading their shaders:
+		wiRenderer::MountShaderBundle();
+
 		size_t shaderdump_count = wiRenderer::GetShaderDumpCount();
 		if (shaderdump_count > 0)
 		{
@@ -33,22 +71,69 @@ namespace wiInitializer
 		}
 
 		wiBackLog::post("");
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { wiFont::Initialize(); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { wiImage::Initialize(); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { wiInput::Initialize(); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { wiRenderer::Initialize(); wiWidget::Initialize(); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { wiAudio::Initialize(); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { wiNetwork::Initialize(); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { wiTextureHelper::Initialize(); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { wiScene::wiHairParticle::Initialize(); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { wiScene::wiEmittedParticle::Initialize(); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { wiOcean::Initialize(); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { wiGPUSortLib::Initialize(); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { wiGPUBVH::Initialize(); });
+
+		// The systems are initialized by a task graph, every stage starts as soon as the stages that it depends on are finished
+		//	The duration of every stage is reported to the backlog
+		using Node = wiJobSystem::TaskGraph::Node;
+		graph.Clear();
+		std::vector<Node> stages;
+		auto stage = [&](const char* name, void(*func)(), std::initializer_list<Node> dependencies = {}) {
+			const Node node = graph.AddNode([name, func](wiJobSystem::context& ctx) {
+				wiTimer stage_timer;
+				func();
+				wiBackLog::post(("[wiInitializer] " + std::string(name) + ": " + std::to_string((int)stage_timer.elapsed_milliseconds()) + " ms").c_str());
+			});
+			for (Node dependency : dependencies)
+			{
+				graph.AddDependency(dependency, node);
+			}
+			stages.push_back(node);
+			return node;
+		};
+
+		// The pipeline states of the renderer and the particle systems refer to the states of the renderer, the widgets use its shaders:
+		const Node renderer_states = stage("wiRenderer states", wiRenderer::InitializeStates);
+		const Node renderer_shaders = stage("wiRenderer shaders", wiRenderer::InitializeShaders, { renderer_states });
+		const Node renderer_shadowmaps = stage("wiRenderer shadow maps", wiRenderer::InitializeShadowMaps);
+
+		// The renderer reports when all of its stages are finished, like wiRenderer::Initialize() does (the time is since the start of the initialization):
+		const Node renderer = graph.AddNode([](wiJobSystem::context& ctx) {
+			wiBackLog::post("wiRenderer Initialized");
+			wiBackLog::post(("[wiInitializer] wiRenderer: " + std::to_string((int)timer.elapsed_milliseconds()) + " ms").c_str());
+		});
+		graph.AddDependency(renderer_states, renderer);
+		graph.AddDependency(renderer_shaders, renderer);
+		graph.AddDependency(renderer_shadowmaps, renderer);
+		stages.push_back(renderer);
+		stage("wiWidget", wiWidget::Initialize, { renderer_shaders });
+		stage("wiScene::wiHairParticle", wiScene::wiHairParticle::Initialize, { renderer_states });
+		stage("wiScene::wiEmittedParticle", wiScene::wiEmittedParticle::Initialize, { renderer_states });
+		stage("wiFont", wiFont::Initialize);
+		stage("wiImage", wiImage::Initialize);
+		stage("wiUIRenderer", wiUIRenderer::Initialize);
+		stage("wiInput", wiInput::Initialize);
+		stage("wiAudio", wiAudio::Initialize);
+		stage("wiNetwork", wiNetwork::Initialize);
+		stage("wiTextureHelper", wiTextureHelper::Initialize);
+		stage("wiOcean", wiOcean::Initialize);
+		stage("wiGPUSortLib", wiGPUSortLib::Initialize);
+		stage("wiGPUBVH", wiGPUBVH::Initialize);
+		// The physics engine is not a stage, it is initialized by the first physics update, so it costs nothing when there is no simulation
+
+		const Node finished = graph.AddNode([](wiJobSystem::context& ctx) {
+			wiBackLog::post(("[wiInitializer] Initialized in " + std::to_string((int)timer.elapsed_milliseconds()) + " ms").c_str());
+		});
+		for (Node node : stages)
+		{
+			graph.AddDependency(node, finished);
+		}
+		wiJobSystem::Run(graph, ctx);
+
 #ifndef GGREDUCED
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { wiPhysicsEngine::Initialize(); });
-		// Initialize this immediately:
+		// Initialize this immediately, because scripts can be run right after this returns:
+		wiTimer lua_timer;
 		wiLua::Initialize();
+		wiBackLog::post(("[wiInitializer] wiLua: " + std::to_string((int)lua_timer.elapsed_milliseconds()) + " ms").c_str());
 #endif
 	}
 
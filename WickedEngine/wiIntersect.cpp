@@ -1,6 +1,13 @@
 #include "wiIntersect.h"
 #include "wiMath.h"
 
+#include <algorithm>
+#include <vector>
+
+#if defined(__AVX__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif // __AVX__
+
 
 void AABB::createFromHalfWidth(const XMFLOAT3& center, const XMFLOAT3& halfwidth) 
 {
@@ -10,36 +17,20 @@ void AABB::createFromHalfWidth(const XMFLOAT3& center, const XMFLOAT3& halfwidth
 //PE: Faster intersections -> https://github.com/turanszkij/WickedEngine/commit/54d11f1e9138813b7815e9d523f2e7b8fac523a2
 AABB AABB::transform(const XMMATRIX& mat) const
 {
-	const XMVECTOR vcorners[8] = {
-		XMVector3Transform(XMLoadFloat3(&_min), mat),
-		XMVector3Transform(XMVectorSet(_min.x, _max.y, _min.z, 1), mat),
-		XMVector3Transform(XMVectorSet(_min.x, _max.y, _max.z, 1), mat),
-		XMVector3Transform(XMVectorSet(_min.x, _min.y, _max.z, 1), mat),
-		XMVector3Transform(XMVectorSet(_max.x, _min.y, _min.z, 1), mat),
-		XMVector3Transform(XMVectorSet(_max.x, _max.y, _min.z, 1), mat),
-		XMVector3Transform(XMLoadFloat3(&_max), mat),
-		XMVector3Transform(XMVectorSet(_max.x, _min.y, _max.z, 1), mat),
-	};
-	XMVECTOR vmin = vcorners[0];
-	XMVECTOR vmax = vcorners[0];
-	vmin = XMVectorMin(vmin, vcorners[1]);
-	vmax = XMVectorMax(vmax, vcorners[1]);
-	vmin = XMVectorMin(vmin, vcorners[2]);
-	vmax = XMVectorMax(vmax, vcorners[2]);
-	vmin = XMVectorMin(vmin, vcorners[3]);
-	vmax = XMVectorMax(vmax, vcorners[3]);
-	vmin = XMVectorMin(vmin, vcorners[4]);
-	vmax = XMVectorMax(vmax, vcorners[4]);
-	vmin = XMVectorMin(vmin, vcorners[5]);
-	vmax = XMVectorMax(vmax, vcorners[5]);
-	vmin = XMVectorMin(vmin, vcorners[6]);
-	vmax = XMVectorMax(vmax, vcorners[6]);
-	vmin = XMVectorMin(vmin, vcorners[7]);
-	vmax = XMVectorMax(vmax, vcorners[7]);
+	// The center is transformed, the extents are scaled by the absolute values of the matrix, the result contains every transformed corner
+	//	The halves are taken before the addition, so that the FLT_MAX boxes don't overflow:
+	const XMVECTOR half = XMVectorReplicate(0.5f);
+	const XMVECTOR vmin = XMVectorMultiply(XMLoadFloat3(&_min), half);
+	const XMVECTOR vmax = XMVectorMultiply(XMLoadFloat3(&_max), half);
+	const XMVECTOR center = XMVector3Transform(XMVectorAdd(vmin, vmax), mat);
+	const XMVECTOR extent = XMVectorSubtract(vmax, vmin);
+	XMVECTOR transformed = XMVectorMultiply(XMVectorAbs(mat.r[0]), XMVectorSplatX(extent));
+	transformed = XMVectorMultiplyAdd(XMVectorAbs(mat.r[1]), XMVectorSplatY(extent), transformed);
+	transformed = XMVectorMultiplyAdd(XMVectorAbs(mat.r[2]), XMVectorSplatZ(extent), transformed);
 
 	XMFLOAT3 min, max;
-	XMStoreFloat3(&min, vmin);
-	XMStoreFloat3(&max, vmax);
+	XMStoreFloat3(&min, XMVectorSubtract(center, transformed));
+	XMStoreFloat3(&max, XMVectorAdd(center, transformed));
 	return AABB(min, max);
 }
 
@@ -354,6 +345,54 @@ void Frustum::Create(const XMMATRIX& viewProjection)
 	// Bottom plane:
 	XMStoreFloat4(&planes[5], XMPlaneNormalize(mat.r[3] + mat.r[1]));
 }
+void Frustum::CreateUnion(const XMMATRIX* viewProjections, size_t count)
+{
+	assert(count > 0);
+	if (count == 1)
+	{
+		Create(viewProjections[0]);
+		return;
+	}
+
+	std::vector<Frustum> frusta(count);
+	std::vector<XMVECTOR> corners;
+	corners.reserve(count * 8);
+	for (size_t i = 0; i < count; ++i)
+	{
+		frusta[i].Create(viewProjections[i]);
+		const XMMATRIX inverseViewProjection = XMMatrixInverse(nullptr, viewProjections[i]);
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			const XMVECTOR ndc = XMVectorSet(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : 0.0f, 1);
+			corners.push_back(XMVector3TransformCoord(ndc, inverseViewProjection));
+		}
+	}
+
+	for (int p = 0; p < 6; ++p)
+	{
+		// Of the planes that contain every corner, the tightest one is kept:
+		planes[p] = XMFLOAT4(0, 0, 0, 1);
+		float best = FLT_MAX;
+		for (size_t i = 0; i < count; ++i)
+		{
+			const XMVECTOR plane = XMLoadFloat4(&frusta[i].planes[p]);
+			float nearest = FLT_MAX;
+			float furthest = 0;
+			for (const XMVECTOR& corner : corners)
+			{
+				const float distance = XMVectorGetX(XMPlaneDotCoord(plane, corner));
+				nearest = std::min(nearest, distance);
+				furthest = std::max(furthest, std::abs(distance));
+			}
+			// The corners on the plane itself are let through with a tolerance that scales with the size of the frusta:
+			if (nearest >= -furthest * 0.0001f && nearest < best)
+			{
+				best = nearest;
+				planes[p] = frusta[i].planes[p];
+			}
+		}
+	}
+}
 
 bool Frustum::CheckPoint(const XMFLOAT3& point) const
 {
@@ -382,6 +421,17 @@ bool Frustum::CheckSphere(const XMFLOAT3& center, float radius) const
 
 	return true;
 }
+void AABB_SOA::resize(size_t newCount)
+{
+	count = newCount;
+	const size_t padded = (newCount + 7) & ~size_t(7);
+	min_x.resize(padded, FLT_MAX);
+	min_y.resize(padded, FLT_MAX);
+	min_z.resize(padded, FLT_MAX);
+	max_x.resize(padded, -FLT_MAX);
+	max_y.resize(padded, -FLT_MAX);
+	max_z.resize(padded, -FLT_MAX);
+}
 Frustum::BoxFrustumIntersect Frustum::CheckBox(const AABB& box) const
 {
 	int iTotalIn = 0;
@@ -429,6 +479,107 @@ bool Frustum::CheckBoxFast(const AABB& box) const
 	}
 	return true;
 }
+// The frustum planes replicated for testing multiple boxes at once
+struct FrustumPlanesSOA
+{
+	XMVECTOR x[6], y[6], z[6], w[6];
+	FrustumPlanesSOA(const XMFLOAT4* planes)
+	{
+		for (size_t p = 0; p < 6; ++p)
+		{
+			x[p] = XMVectorReplicate(planes[p].x);
+			y[p] = XMVectorReplicate(planes[p].y);
+			z[p] = XMVectorReplicate(planes[p].z);
+			w[p] = XMVectorReplicate(planes[p].w);
+		}
+	}
+};
+static inline uint32_t CheckBoxes4_Internal(const XMFLOAT4* planes, const FrustumPlanesSOA& soa, const AABB_SOA& boxes, size_t i)
+{
+	const XMVECTOR zero = XMVectorZero();
+	XMVECTOR inside = XMVectorTrueInt();
+	for (size_t p = 0; p < 6; ++p)
+	{
+		// The corner that is furthest along the plane normal is selected per plane, so it's the same for all 4 boxes:
+		const float* x = planes[p].x < 0 ? &boxes.min_x[i] : &boxes.max_x[i];
+		const float* y = planes[p].y < 0 ? &boxes.min_y[i] : &boxes.max_y[i];
+		const float* z = planes[p].z < 0 ? &boxes.min_z[i] : &boxes.max_z[i];
+		XMVECTOR distance = XMVectorMultiplyAdd(XMLoadFloat4((const XMFLOAT4*)x), soa.x[p], soa.w[p]);
+		distance = XMVectorMultiplyAdd(XMLoadFloat4((const XMFLOAT4*)y), soa.y[p], distance);
+		distance = XMVectorMultiplyAdd(XMLoadFloat4((const XMFLOAT4*)z), soa.z[p], distance);
+		inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(distance, zero));
+	}
+	uint32_t lanes[4];
+	XMStoreInt4(lanes, inside);
+	return (lanes[0] & 1) | (lanes[1] & 2) | (lanes[2] & 4) | (lanes[3] & 8);
+}
+#if defined(__AVX__) || defined(__AVX2__)
+static inline uint32_t CheckBoxes8_Internal(const XMFLOAT4* planes, const AABB_SOA& boxes, size_t i)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+	for (size_t p = 0; p < 6; ++p)
+	{
+		const float* x = planes[p].x < 0 ? &boxes.min_x[i] : &boxes.max_x[i];
+		const float* y = planes[p].y < 0 ? &boxes.min_y[i] : &boxes.max_y[i];
+		const float* z = planes[p].z < 0 ? &boxes.min_z[i] : &boxes.max_z[i];
+		__m256 distance = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(x), _mm256_set1_ps(planes[p].x)), _mm256_set1_ps(planes[p].w));
+		distance = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(y), _mm256_set1_ps(planes[p].y)), distance);
+		distance = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(z), _mm256_set1_ps(planes[p].z)), distance);
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+	}
+	return (uint32_t)_mm256_movemask_ps(inside);
+}
+#endif // __AVX__
+void Frustum::CheckBoxesFast(const AABB_SOA& boxes, size_t first, size_t count, uint8_t* results) const
+{
+	assert(first % 4 == 0);
+	assert(first + count <= boxes.size());
+
+	const FrustumPlanesSOA soa(planes);
+	for (size_t i = first; i < first + count; i += 4)
+	{
+		const uint32_t visible = CheckBoxes4_Internal(planes, soa, boxes, i);
+		for (size_t lane = 0; lane < 4 && i + lane < first + count; ++lane)
+		{
+			results[i + lane - first] = (visible >> lane) & 1;
+		}
+	}
+}
+void Frustum::CheckBoxesMask(const AABB_SOA& boxes, size_t first, size_t count, uint32_t* mask) const
+{
+	assert(first % 4 == 0);
+	assert(first + count <= boxes.size());
+
+	const FrustumPlanesSOA soa(planes);
+	std::memset(mask, 0, sizeof(uint32_t) * ((count + 31) / 32));
+	size_t i = first;
+#if defined(__AVX__) || defined(__AVX2__)
+	// 8 boxes can be read while they are inside the padded arrays, every batch stays within one mask element:
+	for (; i < first + count && i + 8 <= boxes.min_x.size(); i += 8)
+	{
+		const size_t bit = i - first;
+		mask[bit / 32] |= CheckBoxes8_Internal(planes, boxes, i) << (bit % 32);
+	}
+#endif // __AVX__
+	for (; i < first + count; i += 4)
+	{
+		const size_t bit = i - first;
+		mask[bit / 32] |= CheckBoxes4_Internal(planes, soa, boxes, i) << (bit % 32);
+	}
+
+	// The lanes after the last box are cleared:
+	if (count % 32 != 0)
+	{
+		mask[count / 32] &= (1u << (count % 32)) - 1;
+	}
+}
+uint32_t Frustum::CheckBoxes4(const AABB_SOA& boxes, size_t first) const
+{
+	assert(first % 4 == 0);
+	assert(first + 4 <= boxes.min_x.size());
+	return CheckBoxes4_Internal(planes, FrustumPlanesSOA(planes), boxes, first);
+}
 
 const XMFLOAT4& Frustum::getNearPlane() const { return planes[0]; }
 const XMFLOAT4& Frustum::getFarPlane() const { return planes[1]; }
@@ -112,11 +112,36 @@ struct RAY
 	bool intersects(const SPHERE& b) const;
 };
 
+// Structure of arrays storage of bounding boxes, so that kernels can stream only the coordinates and process 4 or 8 boxes at a time
+//	The arrays are padded to a multiple of 8 elements (with empty boxes)
+struct AABB_SOA
+{
+	std::vector<float> min_x, min_y, min_z;
+	std::vector<float> max_x, max_y, max_z;
+	size_t count = 0;
+
+	void resize(size_t newCount);
+	inline void set(size_t index, const AABB& aabb)
+	{
+		assert(index < count);
+		min_x[index] = aabb._min.x;
+		min_y[index] = aabb._min.y;
+		min_z[index] = aabb._min.z;
+		max_x[index] = aabb._max.x;
+		max_y[index] = aabb._max.y;
+		max_z[index] = aabb._max.z;
+	}
+	inline size_t size() const { return count; }
+};
+
 struct Frustum
 {
 	XMFLOAT4 planes[6];
 
 	void Create(const XMMATRIX& viewProjection);
+	// The frustum that contains all of the view frusta, for culling several views at once (split-screen, or the eyes of stereo rendering)
+	//	Every plane is a plane of one of the frusta that has every frustum corner on its inside, the sides without such a plane are not culled
+	void CreateUnion(const XMMATRIX* viewProjections, size_t count);
 
 	bool CheckPoint(const XMFLOAT3&) const;
 	bool CheckSphere(const XMFLOAT3&, float) const;
@@ -129,6 +154,14 @@ struct Frustum
 	};
 	BoxFrustumIntersect CheckBox(const AABB& box) const;
 	bool CheckBoxFast(const AABB& box) const;
+	// Same test as CheckBoxFast() for a range of boxes, 4 at a time. first must be a multiple of 4
+	//	results[i - first] is set to 1 if box i is inside or intersecting, otherwise 0
+	void CheckBoxesFast(const AABB_SOA& boxes, size_t first, size_t count, uint8_t* results) const;
+	// Same test as CheckBoxFast() for a range of boxes, 8 at a time with AVX, otherwise 4 at a time. first must be a multiple of 4
+	//	Bit (i - first) of the mask is set if box i is inside or intersecting, the mask must have room for (count + 31) / 32 elements
+	void CheckBoxesMask(const AABB_SOA& boxes, size_t first, size_t count, uint32_t* mask) const;
+	// Same test as CheckBoxFast() for the 4 boxes starting at first (a multiple of 4), bit i of the result is set if box (first + i) is visible
+	uint32_t CheckBoxes4(const AABB_SOA& boxes, size_t first) const;
 
 	const XMFLOAT4& getNearPlane() const;
 	const XMFLOAT4& getFarPlane() const;
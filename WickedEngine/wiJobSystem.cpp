@@ -1,96 +1,1078 @@
 #include "wiJobSystem.h"
 #include "wiSpinLock.h"
 #include "wiBackLog.h"
-#include "wiContainers.h"
 #include "wiPlatform.h"
+#include "wiAllocators.h"
+#include "CommonInclude.h"
 
 #include <thread>
 #include <condition_variable>
 #include <string>
 #include <algorithm>
+#include <cassert>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstring>
+
+#ifdef PLATFORM_LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <ucontext.h>
+#endif // PLATFORM_LINUX
+
+#ifdef GGREDUCED
+#ifdef OPTICK_ENABLE
+#include "optick.h"
+#endif
+#endif
+
+#ifdef _MSC_VER
+#define WI_NOINLINE __declspec(noinline)
+#else
+#define WI_NOINLINE __attribute__((noinline))
+#endif // _MSC_VER
 
 namespace wiJobSystem
 {
+	// The task of an Execute() or Dispatch() call is stored once in a block that every resulting job references
+	struct TaskBlock
+	{
+		Task task;
+		std::atomic<uint32_t> refCount{ 0 }; // number of jobs still referencing this block
+		TaskBlock* next = nullptr; // free list link
+	};
+
+	// Task blocks are recycled through a free list, so job submission doesn't allocate in steady state
+	struct TaskBlockPool
+	{
+		static constexpr size_t page_size = 256;
+		std::vector<std::unique_ptr<TaskBlock[]>> pages;
+		TaskBlock* freelist = nullptr;
+		wiSpinLock locker;
+
+		inline TaskBlock* allocate()
+		{
+			locker.lock();
+			if (freelist == nullptr)
+			{
+				// Only grows when every block is in use:
+				pages.emplace_back(new TaskBlock[page_size]);
+				TaskBlock* page = pages.back().get();
+				for (size_t i = 0; i < page_size; ++i)
+				{
+					page[i].next = freelist;
+					freelist = &page[i];
+				}
+			}
+			TaskBlock* block = freelist;
+			freelist = block->next;
+			locker.unlock();
+			return block;
+		}
+
+		inline void free(TaskBlock* block)
+		{
+			locker.lock();
+			block->next = freelist;
+			freelist = block;
+			locker.unlock();
+		}
+	};
+	TaskBlockPool taskBlockPool;
+
 	struct Job
 	{
 		context* ctx;
-		std::function<void(wiJobArgs)> task;
+		TaskBlock* block;
 		uint32_t groupID;
 		uint32_t groupJobOffset;
 		uint32_t groupJobEnd;
 		uint32_t sharedmemory_size;
 	};
 
+	// Queue events for the statistics:
+	std::atomic<uint32_t> queueGrowCount{ 0 };
+	std::atomic<uint32_t> queueContentionCount{ 0 };
+
+	// Work-stealing job queue (Chase-Lev style access pattern):
+	//	The owner thread pushes and pops at the back (LIFO, the most recent job is the most likely to be hot in cache)
+	//	Other threads steal from the front (FIFO, the oldest jobs are stolen first)
+	//	The storage is a growable ring buffer, so pushing never fails and never blocks the producer
+	//	Each queue has its own lock and lives on its own cache line, so threads only contend when they touch the same queue
+	struct alignas(64) JobQueue
+	{
+		std::vector<Job> data = std::vector<Job>(256);
+		size_t head = 0; // index of the front element
+		size_t count = 0; // number of elements
+		wiSpinLock locker;
+
+		inline void lock()
+		{
+			if (!locker.try_lock())
+			{
+				queueContentionCount.fetch_add(1, std::memory_order_relaxed);
+				locker.lock();
+			}
+		}
+
+		inline void push_back(const Job& item)
+		{
+			lock();
+			if (count == data.size())
+			{
+				queueGrowCount.fetch_add(1, std::memory_order_relaxed);
+				// Grow the ring buffer and linearize the contents:
+				std::vector<Job> grown(data.size() * 2);
+				for (size_t i = 0; i < count; ++i)
+				{
+					grown[i] = data[(head + i) % data.size()];
+				}
+				data = std::move(grown);
+				head = 0;
+			}
+			data[(head + count) % data.size()] = item;
+			count++;
+			locker.unlock();
+		}
+
+		inline bool pop_back(Job& item)
+		{
+			bool result = false;
+			lock();
+			if (count > 0)
+			{
+				count--;
+				item = data[(head + count) % data.size()];
+				result = true;
+			}
+			locker.unlock();
+			return result;
+		}
+
+		inline bool steal(Job& item)
+		{
+			bool result = false;
+			lock();
+			if (count > 0)
+			{
+				item = data[head];
+				head = (head + 1) % data.size();
+				count--;
+				result = true;
+			}
+			locker.unlock();
+			return result;
+		}
+	};
+
+	static const uint32_t INVALID_QUEUE = ~0u;
+	static constexpr uint32_t priorityCount = (uint32_t)Priority::Count;
+
 	uint32_t numThreads = 0;
-	wiContainers::ThreadSafeRingBuffer<Job, 256> jobQueue;
-	std::condition_variable wakeCondition;
-	std::mutex wakeMutex;
+	std::unique_ptr<JobQueue[]> jobQueuePerThread[priorityCount]; // every worker thread owns one queue per priority
+	std::atomic<uint32_t> nextQueue{ 0 };
+	std::atomic<uint32_t> pendingJobs[priorityCount] = {}; // number of queued jobs per priority
+	uint32_t backgroundThreadLimit = 1;
+	std::atomic<uint32_t> backgroundThreadsBusy{ 0 };
+	uint32_t idleSpinCount = 0;
 
-	// This function executes the next item from the job queue. Returns true if successful, false if there was no job available
-	inline bool work()
+	// The queue owned by the current thread, or INVALID_QUEUE for threads that are not workers (eg. main thread)
+	thread_local uint32_t tls_queueIndex = INVALID_QUEUE;
+
+	// Statistics, written by the thread that they belong to and consumed by ConsumeStats():
+	std::atomic<bool> statsEnabled{ false };
+	static const uint32_t contextStatsCapacity = 32;
+	struct alignas(64) ThreadStats
 	{
-		Job job;
-		if (jobQueue.pop_front(job))
+		std::atomic<uint64_t> busyTime{ 0 };
+		std::atomic<uint64_t> idleTime{ 0 };
+		std::atomic<uint64_t> stealTime{ 0 };
+		std::atomic<uint32_t> jobCount{ 0 };
+		std::atomic<uint32_t> stealCount{ 0 };
+		std::atomic<uint32_t> sleepCount{ 0 };
+		struct Context
+		{
+			std::atomic<const char*> name{ nullptr };
+			std::atomic<uint64_t> time{ 0 };
+			std::atomic<uint32_t> jobCount{ 0 };
+		};
+		Context contexts[contextStatsCapacity];
+
+		inline void add_context(const char* name, uint64_t time)
+		{
+			for (auto& x : contexts)
+			{
+				const char* slot = x.name.load(std::memory_order_acquire);
+				if (slot == nullptr)
+				{
+					// Claim a free slot, threads that are not workers share the same stats, so this can race:
+					if (!x.name.compare_exchange_strong(slot, name) && slot != name)
+					{
+						continue;
+					}
+				}
+				else if (slot != name)
+				{
+					continue;
+				}
+				x.time.fetch_add(time, std::memory_order_relaxed);
+				x.jobCount.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		}
+	};
+	std::unique_ptr<ThreadStats[]> threadStats; // one for every worker, and a last one shared by every other thread
+
+	inline uint64_t stats_timestamp()
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Fibers (optional, see InitDesc::fibers):
+	//	Worker threads run their scheduling loop on pooled fibers. When a job waits on a busy context, its fiber is suspended and the worker continues on a free fiber
+	//	The suspended fiber is resumed by any worker once the context is finished, so it might continue on a different thread
+	struct Fiber
+	{
+#ifdef _WIN32
+		void* handle = nullptr;
+#else
+		ucontext_t state;
+		std::unique_ptr<uint8_t[]> stack;
+#endif // _WIN32
+		wiAllocators::LinearAllocator scratch; // jobs on the fiber use this instead of the thread's scratch allocator, because a job can continue on an other thread
+	};
+	struct WaitingFiber
+	{
+		Fiber* fiber = nullptr;
+		const context* ctx = nullptr;
+	};
+	bool fibersEnabled = false;
+	std::unique_ptr<Fiber[]> fibers;
+	std::vector<Fiber*> freeFibers;
+	wiSpinLock freeFibersLock;
+	std::vector<WaitingFiber> waitingFibers; // suspended until their context is finished
+	std::vector<Fiber*> readyFibers; // their context is finished, they can be resumed
+	std::atomic<uint32_t> waitingFiberCount{ 0 };
+	std::atomic<uint32_t> readyFiberCount{ 0 };
+	wiSpinLock waitingFibersLock;
+
+	thread_local Fiber* tls_fiber = nullptr; // the fiber running on the current thread, nullptr if the thread is not a worker with fibers
+	thread_local Fiber* tls_fiberToFree = nullptr; // the fiber that was switched away from, to be returned to the pool
+	thread_local WaitingFiber tls_fiberToWait; // the fiber that was switched away from, to be suspended
+
+	// Code that runs on a fiber can continue on an other thread after a fiber switch, so thread local variables are only accessed from non-inlined functions
+	//	Otherwise the compiler could keep using the address of the thread local variables of the previous thread
+	WI_NOINLINE uint32_t current_queue()
+	{
+		return tls_queueIndex;
+	}
+
+	inline ThreadStats& thread_stats(uint32_t queueIndex)
+	{
+		return threadStats[queueIndex == INVALID_QUEUE ? numThreads : queueIndex];
+	}
+
+	// Scratch memory for wiJobArgs::scratch, one for every thread that executes jobs (or for every fiber):
+	uint32_t scratchSize = 0;
+	thread_local wiAllocators::LinearAllocator tls_scratch;
+
+	WI_NOINLINE wiAllocators::LinearAllocator* current_scratch()
+	{
+		wiAllocators::LinearAllocator* scratch = tls_fiber != nullptr ? &tls_fiber->scratch : &tls_scratch;
+		if (scratch->get_capacity() == 0 && scratchSize > 0)
+		{
+			scratch->reserve(scratchSize, 16);
+		}
+		return scratch;
+	}
+
+	// Per-worker event that an idle worker sleeps on
+	struct alignas(64) Parker
+	{
+		std::mutex locker;
+		std::condition_variable condition;
+		bool signaled = false;
+
+		inline void park()
+		{
+			std::unique_lock<std::mutex> lock(locker);
+			condition.wait(lock, [this] { return signaled; });
+			signaled = false;
+		}
+		inline void unpark()
+		{
+			{
+				std::lock_guard<std::mutex> lock(locker);
+				signaled = true;
+			}
+			condition.notify_one();
+		}
+	};
+	std::unique_ptr<Parker[]> parkers;
+	std::vector<uint32_t> sleepingWorkers; // workers that are parked or about to be parked
+	std::atomic<uint32_t> sleepingWorkerCount{ 0 };
+	wiSpinLock sleepingWorkersLock;
+
+	// Check whether there is any job that an idle worker could pick up
+	inline bool has_work()
+	{
+		return
+			readyFiberCount.load() > 0 ||
+			pendingJobs[(uint32_t)Priority::High].load() > 0 ||
+			pendingJobs[(uint32_t)Priority::Normal].load() > 0 ||
+			(pendingJobs[(uint32_t)Priority::Background].load() > 0 && backgroundThreadsBusy.load() < backgroundThreadLimit);
+	}
+
+	// Wake up at most the specified number of sleeping workers
+	inline void wake(uint32_t count)
+	{
+		// The pending job counters were already incremented here, and a worker registers itself as sleeping before checking them for a last time,
+		//	so either the worker sees the new jobs, or it is seen here:
+		if (sleepingWorkerCount.load() == 0)
+		{
+			return;
+		}
+		uint32_t woken[64];
+		uint32_t wokenCount = 0;
+		sleepingWorkersLock.lock();
+		while (count > 0 && wokenCount < arraysize(woken) && !sleepingWorkers.empty())
+		{
+			woken[wokenCount++] = sleepingWorkers.back();
+			sleepingWorkers.pop_back();
+			sleepingWorkerCount.fetch_sub(1);
+			count--;
+		}
+		sleepingWorkersLock.unlock();
+		for (uint32_t i = 0; i < wokenCount; ++i)
+		{
+			parkers[woken[i]].unpark();
+		}
+	}
+
+	// Spin for a while, then sleep until woken up by new jobs
+	inline void wait_for_work(uint32_t threadID)
+	{
+		for (uint32_t i = 0; i < idleSpinCount; ++i)
+		{
+			if (has_work())
+			{
+				return;
+			}
+			_mm_pause();
+		}
+
+		sleepingWorkersLock.lock();
+		sleepingWorkers.push_back(threadID);
+		sleepingWorkerCount.fetch_add(1);
+		sleepingWorkersLock.unlock();
+
+		if (has_work())
 		{
-			wiJobArgs args;
-			args.groupID = job.groupID;
-			if (job.sharedmemory_size > 0)
+			// Jobs arrived while registering, try to take back the sleep request:
+			bool removed = false;
+			sleepingWorkersLock.lock();
+			auto it = std::find(sleepingWorkers.begin(), sleepingWorkers.end(), threadID);
+			if (it != sleepingWorkers.end())
 			{
-				args.sharedmemory = alloca(job.sharedmemory_size);
+				sleepingWorkers.erase(it);
+				sleepingWorkerCount.fetch_sub(1);
+				removed = true;
+			}
+			sleepingWorkersLock.unlock();
+			if (removed)
+			{
+				return;
+			}
+			// Otherwise a producer already took this worker from the list and is about to signal it, the signal is consumed below without blocking
+		}
+
+		threadStats[threadID].sleepCount.fetch_add(1, std::memory_order_relaxed);
+		parkers[threadID].park();
+	}
+
+	// Idle worker: wait for new jobs
+	inline void idle(uint32_t threadID)
+	{
+		if (statsEnabled.load(std::memory_order_relaxed))
+		{
+			const uint64_t time_begin = stats_timestamp();
+			wait_for_work(threadID);
+			threadStats[threadID].idleTime.fetch_add(stats_timestamp() - time_begin, std::memory_order_relaxed);
+		}
+		else
+		{
+			wait_for_work(threadID);
+		}
+	}
+
+	Fiber* acquire_fiber()
+	{
+		Fiber* fiber = nullptr;
+		freeFibersLock.lock();
+		if (!freeFibers.empty())
+		{
+			fiber = freeFibers.back();
+			freeFibers.pop_back();
+		}
+		freeFibersLock.unlock();
+		return fiber;
+	}
+
+	// Finish the bookkeeping of the fiber that the current thread switched away from
+	//	This can't be done before the switch, because an other thread could resume that fiber while it is still running
+	WI_NOINLINE void after_switch()
+	{
+		if (tls_fiberToFree != nullptr)
+		{
+			freeFibersLock.lock();
+			freeFibers.push_back(tls_fiberToFree);
+			freeFibersLock.unlock();
+			tls_fiberToFree = nullptr;
+		}
+		if (tls_fiberToWait.fiber != nullptr)
+		{
+			WaitingFiber waiting = tls_fiberToWait;
+			tls_fiberToWait = {};
+
+			waitingFibersLock.lock();
+			// The waiting count is published before checking the context, and execute() checks it after finishing a context, so one of them will see the other:
+			waitingFiberCount.fetch_add(1);
+			if (waiting.ctx->counter.load() == 0)
+			{
+				// The context was finished in the meantime:
+				waitingFiberCount.fetch_sub(1);
+				readyFibers.push_back(waiting.fiber);
+				readyFiberCount.fetch_add(1);
 			}
 			else
 			{
-				args.sharedmemory = nullptr;
+				waitingFibers.push_back(waiting);
 			}
+			waitingFibersLock.unlock();
+		}
+	}
 
-			for (uint32_t i = job.groupJobOffset; i < job.groupJobEnd; ++i)
+	// Switch the current thread to an other fiber
+	//	free	: the current fiber is returned to the pool of free fibers
+	//	ctx		: if not nullptr, the current fiber is suspended until this context is finished
+	WI_NOINLINE void switch_fiber(Fiber* to, bool free, const context* ctx)
+	{
+		Fiber* from = tls_fiber;
+		if (free)
+		{
+			tls_fiberToFree = from;
+		}
+		if (ctx != nullptr)
+		{
+			tls_fiberToWait = { from, ctx };
+		}
+		tls_fiber = to;
+#ifdef _WIN32
+		SwitchToFiber(to->handle);
+#else
+		swapcontext(&from->state, &to->state);
+#endif // _WIN32
+		after_switch();
+	}
+
+	// Move the suspended fibers whose context is finished to the ready list, and wake up workers to resume them
+	void resume_waiting_fibers()
+	{
+		uint32_t count = 0;
+		waitingFibersLock.lock();
+		for (size_t i = 0; i < waitingFibers.size();)
+		{
+			if (waitingFibers[i].ctx->counter.load() == 0)
 			{
-				args.jobIndex = i;
-				args.groupIndex = i - job.groupJobOffset;
-				args.isFirstJobInGroup = (i == job.groupJobOffset);
-				args.isLastJobInGroup = (i == job.groupJobEnd - 1);
-				job.task(args);
+				readyFibers.push_back(waitingFibers[i].fiber);
+				waitingFibers[i] = waitingFibers.back();
+				waitingFibers.pop_back();
+				count++;
 			}
+			else
+			{
+				i++;
+			}
+		}
+		waitingFiberCount.fetch_sub(count);
+		readyFiberCount.fetch_add(count);
+		waitingFibersLock.unlock();
+
+		wake(count);
+	}
 
-			job.ctx->counter.fetch_sub(1);
+	// Push a job to the queue of the current worker thread, or distribute it between worker queues when called from outside the job system
+	inline void submit(const Job& job, Priority priority)
+	{
+		uint32_t queueIndex = current_queue();
+		if (queueIndex == INVALID_QUEUE)
+		{
+			queueIndex = nextQueue.fetch_add(1) % numThreads;
+		}
+		jobQueuePerThread[(uint32_t)priority][queueIndex].push_back(job);
+		pendingJobs[(uint32_t)priority].fetch_add(1);
+	}
+
+	// Retrieve the next job of a given priority: first from the own queue, then try to steal from the others
+	inline bool pop(Job& job, Priority priority)
+	{
+		JobQueue* queues = jobQueuePerThread[(uint32_t)priority].get();
+		const uint32_t ownQueue = current_queue();
+		if (ownQueue != INVALID_QUEUE && queues[ownQueue].pop_back(job))
+		{
+			pendingJobs[(uint32_t)priority].fetch_sub(1);
 			return true;
 		}
+
+		const bool stats = statsEnabled.load(std::memory_order_relaxed);
+		const uint64_t time_begin = stats ? stats_timestamp() : 0;
+		bool result = false;
+
+		// Victims are visited starting from a rotating offset so that thieves don't all hammer the same queue:
+		const uint32_t start = (ownQueue == INVALID_QUEUE ? nextQueue.load(std::memory_order_relaxed) : ownQueue + 1);
+		for (uint32_t i = 0; i < numThreads; ++i)
+		{
+			const uint32_t victim = (start + i) % numThreads;
+			if (victim != ownQueue && queues[victim].steal(job))
+			{
+				pendingJobs[(uint32_t)priority].fetch_sub(1);
+				result = true;
+				break;
+			}
+		}
+
+		if (stats)
+		{
+			ThreadStats& thread = thread_stats(ownQueue);
+			thread.stealTime.fetch_add(stats_timestamp() - time_begin, std::memory_order_relaxed);
+			if (result)
+			{
+				thread.stealCount.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		return result;
+	}
+
+	// Execute every job of a job group (this is not inlined, so the shared memory stack allocation is freed after every group)
+	void execute(Job& job)
+	{
+#ifdef GGREDUCED
+#ifdef OPTICK_ENABLE
+		OPTICK_EVENT();
+#endif
+#endif
+		const bool stats = statsEnabled.load(std::memory_order_relaxed);
+		const uint64_t time_begin = stats ? stats_timestamp() : 0;
+
+		wiJobArgs args;
+		args.groupID = job.groupID;
+		args.scratch = current_scratch();
+		if (job.sharedmemory_size > 0)
+		{
+			args.sharedmemory = alloca(job.sharedmemory_size);
+		}
+		else
+		{
+			args.sharedmemory = nullptr;
+		}
+
+		for (uint32_t i = job.groupJobOffset; i < job.groupJobEnd; ++i)
+		{
+			args.jobIndex = i;
+			args.groupIndex = i - job.groupJobOffset;
+			args.isFirstJobInGroup = (i == job.groupJobOffset);
+			args.isLastJobInGroup = (i == job.groupJobEnd - 1);
+			const size_t scratch_offset = args.scratch->get_offset();
+			job.block->task(args);
+			args.scratch->rewind(scratch_offset);
+		}
+
+		if (stats)
+		{
+			// The thread is queried again, because the job could have continued on an other fiber thread:
+			const uint64_t time = stats_timestamp() - time_begin;
+			ThreadStats& thread = thread_stats(current_queue());
+			thread.busyTime.fetch_add(time, std::memory_order_relaxed);
+			thread.jobCount.fetch_add(1, std::memory_order_relaxed);
+			if (job.ctx->name != nullptr)
+			{
+				thread.add_context(job.ctx->name, time);
+			}
+		}
+
+		// The last job referencing the task releases it (and its captures) before signaling the context:
+		if (job.block->refCount.fetch_sub(1) == 1)
+		{
+			job.block->task.reset();
+			taskBlockPool.free(job.block);
+		}
+
+		if (job.ctx->counter.fetch_sub(1) == 1 && waitingFiberCount.load() > 0)
+		{
+			// A suspended fiber might be waiting for this context:
+			resume_waiting_fibers();
+		}
+	}
+
+	// This function executes the next item from the job queues. Returns true if successful, false if there was no job available
+	//	lowest	: the lowest priority that is allowed to be picked up. Higher priorities are always tried first
+	inline bool work(Priority lowest)
+	{
+		Job job;
+		for (uint32_t priority = 0; priority <= (uint32_t)lowest; ++priority)
+		{
+			if (pop(job, (Priority)priority))
+			{
+				execute(job);
+				return true;
+			}
+		}
 		return false;
 	}
 
-	void Initialize()
+	// Background jobs are only picked up by workers when no other jobs are available, and only by a limited number of workers at the same time
+	inline bool work_background()
+	{
+		if (backgroundThreadsBusy.fetch_add(1) >= backgroundThreadLimit)
+		{
+			backgroundThreadsBusy.fetch_sub(1);
+			return false;
+		}
+		Job job;
+		bool result = pop(job, Priority::Background);
+		if (result)
+		{
+			execute(job);
+		}
+		backgroundThreadsBusy.fetch_sub(1);
+		return result;
+	}
+
+	// Resume a fiber whose context is finished. Returns true if there was any (the current fiber only continues when it is reused from the pool later)
+	inline bool resume_ready_fiber()
 	{
+		if (readyFiberCount.load() == 0)
+		{
+			return false;
+		}
+		Fiber* fiber = nullptr;
+		waitingFibersLock.lock();
+		if (!readyFibers.empty())
+		{
+			fiber = readyFibers.back();
+			readyFibers.pop_back();
+			readyFiberCount.fetch_sub(1);
+		}
+		waitingFibersLock.unlock();
+		if (fiber == nullptr)
+		{
+			return false;
+		}
+		switch_fiber(fiber, true, nullptr);
+		return true;
+	}
+
+	// Scheduling loop of the worker threads when fibers are enabled. Every free fiber is either not yet started, or suspended inside this loop
+	void fiber_loop()
+	{
+		while (true)
+		{
+			if (!resume_ready_fiber() && !work(Priority::Normal) && !work_background())
+			{
+				idle(current_queue());
+			}
+		}
+	}
+
+#ifdef _WIN32
+	void WINAPI fiber_entry(void*)
+#else
+	void fiber_entry()
+#endif // _WIN32
+	{
+		after_switch();
+		fiber_loop();
+	}
+
+	bool create_fiber(Fiber& fiber, size_t stackSize)
+	{
+#ifdef _WIN32
+		fiber.handle = CreateFiberEx(0, stackSize, FIBER_FLAG_FLOAT_SWITCH, fiber_entry, nullptr);
+		return fiber.handle != nullptr;
+#else
+		if (getcontext(&fiber.state) != 0)
+		{
+			return false;
+		}
+		fiber.stack.reset(new uint8_t[stackSize]);
+		fiber.state.uc_stack.ss_sp = fiber.stack.get();
+		fiber.state.uc_stack.ss_size = stackSize;
+		fiber.state.uc_link = nullptr;
+		makecontext(&fiber.state, fiber_entry, 0);
+		return true;
+#endif // _WIN32
+	}
+
+	// Suspend the current job until the context is finished. Returns false if this is not possible (not on a worker fiber, or there is no free fiber)
+	WI_NOINLINE bool wait_fiber(const context& ctx)
+	{
+		if (tls_fiber == nullptr)
+		{
+			return false;
+		}
+		Fiber* fiber = acquire_fiber();
+		if (fiber == nullptr)
+		{
+			return false;
+		}
+		switch_fiber(fiber, false, &ctx);
+		return true;
+	}
+
+	// A logical processor that a worker thread can be pinned to
+	struct LogicalProcessor
+	{
+		uint16_t group = 0; // processor group (Windows), always 0 on other platforms
+		uint32_t index = 0; // logical processor number within the group
+	};
+
+	// Returns the logical processors that are allowed by the processor group and NUMA node filters,
+	//	grouped by physical core
+	std::vector<std::vector<LogicalProcessor>> GatherPhysicalCores(const InitDesc& desc)
+	{
+		std::vector<std::vector<LogicalProcessor>> cores;
+
+#ifdef PLATFORM_WINDOWS_DESKTOP
+		GROUP_AFFINITY numa_affinity = {};
+		if (desc.numaNode >= 0 && !GetNumaNodeProcessorMaskEx((USHORT)desc.numaNode, &numa_affinity))
+		{
+			wiBackLog::post(("[wiJobSystem] NUMA node " + std::to_string(desc.numaNode) + " is not available, ignoring NUMA node filter").c_str());
+			numa_affinity.Mask = 0;
+		}
+
+		DWORD length = 0;
+		GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length);
+		std::vector<uint8_t> buffer(length);
+		if (length > 0 && GetLogicalProcessorInformationEx(RelationProcessorCore, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buffer.data(), &length))
+		{
+			for (DWORD offset = 0; offset < length;)
+			{
+				const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info = (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)(buffer.data() + offset);
+				offset += info->Size;
+
+				const GROUP_AFFINITY& core_affinity = info->Processor.GroupMask[0]; // a physical core never spans across processor groups
+				if (desc.processorGroup >= 0 && core_affinity.Group != (WORD)desc.processorGroup)
+					continue;
+				KAFFINITY mask = core_affinity.Mask;
+				if (numa_affinity.Mask != 0)
+				{
+					if (core_affinity.Group != numa_affinity.Group)
+						continue;
+					mask &= numa_affinity.Mask;
+				}
+
+				std::vector<LogicalProcessor> core;
+				for (uint32_t bit = 0; bit < sizeof(KAFFINITY) * 8; ++bit)
+				{
+					if (mask & (KAFFINITY(1) << bit))
+					{
+						LogicalProcessor processor;
+						processor.group = core_affinity.Group;
+						processor.index = bit;
+						core.push_back(processor);
+					}
+				}
+				if (!core.empty())
+				{
+					cores.push_back(core);
+				}
+			}
+		}
+#elif defined(PLATFORM_LINUX)
+		// Parses the sysfs cpu list format, eg. "0-3,8,10-11"
+		auto read_cpulist = [](const std::string& path) {
+			std::vector<uint32_t> result;
+			std::ifstream file(path);
+			std::string list;
+			if (file.is_open() && std::getline(file, list))
+			{
+				std::stringstream ss(list);
+				std::string range;
+				while (std::getline(ss, range, ','))
+				{
+					if (range.empty())
+						continue;
+					size_t dash = range.find('-');
+					uint32_t first = (uint32_t)std::stoul(range.substr(0, dash));
+					uint32_t last = dash == std::string::npos ? first : (uint32_t)std::stoul(range.substr(dash + 1));
+					for (uint32_t cpu = first; cpu <= last; ++cpu)
+					{
+						result.push_back(cpu);
+					}
+				}
+			}
+			return result;
+		};
+		auto read_value = [](const std::string& path) {
+			std::ifstream file(path);
+			int value = -1;
+			if (file.is_open())
+			{
+				file >> value;
+			}
+			return value;
+		};
+
+		// Only the processors that the process is allowed to run on are considered:
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+		if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+		{
+			return cores;
+		}
+		if (desc.numaNode >= 0)
+		{
+			std::vector<uint32_t> node_cpus = read_cpulist("/sys/devices/system/node/node" + std::to_string(desc.numaNode) + "/cpulist");
+			if (node_cpus.empty())
+			{
+				wiBackLog::post(("[wiJobSystem] NUMA node " + std::to_string(desc.numaNode) + " is not available, ignoring NUMA node filter").c_str());
+			}
+			else
+			{
+				cpu_set_t node_set;
+				CPU_ZERO(&node_set);
+				for (uint32_t cpu : node_cpus)
+				{
+					if (cpu < CPU_SETSIZE)
+					{
+						CPU_SET(cpu, &node_set);
+					}
+				}
+				CPU_AND(&allowed, &allowed, &node_set);
+			}
+		}
+
+		std::vector<std::pair<int, int>> core_ids; // (package, core) for each entry of cores
+		for (uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+		{
+			if (!CPU_ISSET(cpu, &allowed))
+				continue;
+			const std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+			std::pair<int, int> id = std::make_pair(read_value(topology + "physical_package_id"), read_value(topology + "core_id"));
+			if (id.second < 0)
+			{
+				id.second = (int)cpu; // no topology info, treat every logical processor as a physical core
+			}
+
+			LogicalProcessor processor;
+			processor.index = cpu;
+			auto it = std::find(core_ids.begin(), core_ids.end(), id);
+			if (it == core_ids.end())
+			{
+				core_ids.push_back(id);
+				cores.emplace_back();
+				cores.back().push_back(processor);
+			}
+			else
+			{
+				cores[it - core_ids.begin()].push_back(processor);
+			}
+		}
+#endif // PLATFORM_WINDOWS_DESKTOP
+
+		return cores;
+	}
+
+	// Returns the logical processors in the order they should be assigned to worker threads
+	std::vector<LogicalProcessor> GatherPlacement(const InitDesc& desc)
+	{
+		std::vector<LogicalProcessor> placement;
+
+		switch (desc.affinity)
+		{
+		case AffinityPolicy::PhysicalFirst:
+		{
+			// The first logical processor of every core is used first, then the SMT siblings:
+			std::vector<std::vector<LogicalProcessor>> cores = GatherPhysicalCores(desc);
+			size_t max_siblings = 0;
+			for (auto& core : cores)
+			{
+				max_siblings = std::max(max_siblings, core.size());
+			}
+			for (size_t sibling = 0; sibling < max_siblings; ++sibling)
+			{
+				for (auto& core : cores)
+				{
+					if (sibling < core.size())
+					{
+						placement.push_back(core[sibling]);
+					}
+				}
+			}
+		}
+		break;
+		case AffinityPolicy::ExplicitMask:
+			for (uint32_t bit = 0; bit < 64; ++bit)
+			{
+				if (desc.affinityMask & (1ull << bit))
+				{
+					LogicalProcessor processor;
+					processor.group = (uint16_t)std::max(0, desc.processorGroup);
+					processor.index = bit;
+					placement.push_back(processor);
+				}
+			}
+			break;
+		default:
+			break;
+		}
+
+		return placement;
+	}
+
+	// Pin a thread to one logical processor
+	bool SetAffinity(std::thread& thread, const LogicalProcessor& processor)
+	{
+#ifdef PLATFORM_WINDOWS_DESKTOP
+		GROUP_AFFINITY affinity = {};
+		affinity.Group = processor.group;
+		affinity.Mask = KAFFINITY(1) << processor.index;
+		return SetThreadGroupAffinity((HANDLE)thread.native_handle(), &affinity, nullptr) != 0;
+#elif defined(_WIN32)
+		return SetThreadAffinityMask((HANDLE)thread.native_handle(), DWORD_PTR(1) << processor.index) != 0;
+#elif defined(PLATFORM_LINUX)
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		CPU_SET(processor.index, &cpuset);
+		return pthread_setaffinity_np(thread.native_handle(), sizeof(cpuset), &cpuset) == 0;
+#else
+		return false;
+#endif // PLATFORM_WINDOWS_DESKTOP
+	}
+
+	void Initialize(const InitDesc& desc)
+	{
+		if (numThreads > 0)
+		{
+			return; // already initialized
+		}
+
 		// Retrieve the number of hardware threads in this system:
 		auto numCores = std::thread::hardware_concurrency();
 
-		// Calculate the actual number of worker threads we want (-1 main thread):
-		numThreads = std::max(1u, numCores - 1);
+		// The logical processors that workers will be pinned to, in order:
+		std::vector<LogicalProcessor> placement = GatherPlacement(desc);
+		if (desc.affinity != AffinityPolicy::None && placement.empty())
+		{
+			wiBackLog::post("[wiJobSystem] No logical processor matches the requested affinity, worker threads will not be pinned");
+		}
+		const uint32_t numAvailable = placement.empty() ? numCores : (uint32_t)placement.size();
+
+		// Calculate the actual number of worker threads we want (-1 main thread, unless the processors were selected explicitly):
+		if (desc.threadCount > 0)
+		{
+			numThreads = desc.threadCount;
+		}
+		else if (desc.affinity == AffinityPolicy::ExplicitMask && !placement.empty())
+		{
+			numThreads = numAvailable;
+		}
+		else
+		{
+			numThreads = std::max(1u, numAvailable - 1);
+		}
+
+		// With the PhysicalFirst policy, the first physical core is left to the main thread if there are enough processors:
+		const uint32_t placementOffset = (desc.affinity == AffinityPolicy::PhysicalFirst && numThreads < numAvailable) ? 1 : 0;
+
+		// Every worker thread owns a job queue per priority:
+		for (auto& queues : jobQueuePerThread)
+		{
+			queues.reset(new JobQueue[numThreads]);
+		}
+
+		// By default, half of the workers can be busy with background work:
+		backgroundThreadLimit = std::max(1u, numThreads / 2);
+
+		idleSpinCount = desc.idleSpinCount;
+		scratchSize = desc.scratchSize;
+		parkers.reset(new Parker[numThreads]);
+		threadStats.reset(new ThreadStats[numThreads + 1]);
+		sleepingWorkers.reserve(numThreads);
+
+		fibersEnabled = desc.fibers;
+		if (fibersEnabled)
+		{
+			// Every worker needs a fiber for its scheduling loop, the rest are available for waiting jobs:
+			const uint32_t fiberCount = std::max(desc.fiberCount, numThreads * 2);
+			fibers.reset(new Fiber[fiberCount]);
+			freeFibers.reserve(fiberCount);
+			waitingFibers.reserve(fiberCount);
+			readyFibers.reserve(fiberCount);
+			for (uint32_t i = 0; i < fiberCount; ++i)
+			{
+				bool fiber_result = create_fiber(fibers[i], desc.fiberStackSize);
+				assert(fiber_result);
+				if (fiber_result)
+				{
+					freeFibers.push_back(&fibers[i]);
+				}
+			}
+		}
 
 		for (uint32_t threadID = 0; threadID < numThreads; ++threadID)
 		{
-			std::thread worker([] {
+			std::thread worker([threadID] {
+
+				tls_queueIndex = threadID;
+
+#ifdef GGREDUCED
+#ifdef OPTICK_ENABLE
+				// Register the worker to have its own timeline in the captures:
+				const std::string threadname = "wiJobSystem_" + std::to_string(threadID);
+				OPTICK_THREAD(threadname.c_str());
+#endif
+#endif
+
+				if (fibersEnabled)
+				{
+					// The worker continues on a pooled fiber, the original context of the thread is never resumed:
+					Fiber threadFiber;
+#ifdef _WIN32
+					threadFiber.handle = ConvertThreadToFiberEx(nullptr, FIBER_FLAG_FLOAT_SWITCH);
+					assert(threadFiber.handle != nullptr);
+#endif // _WIN32
+					tls_fiber = &threadFiber;
+					Fiber* fiber = acquire_fiber();
+					assert(fiber != nullptr);
+					switch_fiber(fiber, false, nullptr);
+				}
 
 				while (true)
 				{
-					if (!work())
+					if (!work(Priority::Normal) && !work_background())
 					{
-						// no job, put thread to sleep
-						std::unique_lock<std::mutex> lock(wakeMutex);
-						wakeCondition.wait(lock);
+						// no job, spin for a while then put thread to sleep
+						idle(threadID);
 					}
 				}
 
 			});
 
+			if (!placement.empty())
+			{
+				// Put each thread on to dedicated logical processor:
+				bool affinity_result = SetAffinity(worker, placement[(threadID + placementOffset) % placement.size()]);
+				assert(affinity_result);
+			}
+
 #ifdef _WIN32
 			// Do Windows-specific thread setup:
 			HANDLE handle = (HANDLE)worker.native_handle();
 
-			// Put each thread on to dedicated core:
-			DWORD_PTR affinityMask = 1ull << threadID;
-			DWORD_PTR affinity_result = SetThreadAffinityMask(handle, affinityMask);
-			assert(affinity_result > 0);
-
 			//// Increase thread priority:
 			//BOOL priority_result = SetThreadPriority(handle, THREAD_PRIORITY_HIGHEST);
 			//assert(priority_result != 0);
@@ -104,7 +1086,8 @@ namespace wiJobSystem
 			worker.detach();
 		}
 
-		wiBackLog::post(("wiJobSystem Initialized with [" + std::to_string(numCores) + " cores] [" + std::to_string(numThreads) + " threads]").c_str());
+		static const char* affinity_names[] = { "none", "physical first", "explicit mask" };
+		wiBackLog::post(("wiJobSystem Initialized with [" + std::to_string(numCores) + " cores] [" + std::to_string(numThreads) + " threads] [affinity: " + affinity_names[(int)desc.affinity] + "]" + (fibersEnabled ? " [fibers]" : "")).c_str());
 	}
 
 	uint32_t GetThreadCount()
@@ -112,27 +1095,55 @@ namespace wiJobSystem
 		return numThreads;
 	}
 
-	void Execute(context& ctx, const std::function<void(wiJobArgs)>& task)
+	uint32_t GetQueueDepth()
+	{
+		uint32_t depth = 0;
+		for (uint32_t i = 0; i < priorityCount; ++i)
+		{
+			depth += pendingJobs[i].load(std::memory_order_relaxed);
+		}
+		return depth;
+	}
+
+	uint32_t GetCurrentWorkerIndex()
+	{
+		return current_queue();
+	}
+
+	void SetBackgroundThreadLimit(uint32_t value)
+	{
+		backgroundThreadLimit = std::max(1u, value);
+	}
+
+	uint32_t GetBackgroundThreadLimit()
+	{
+		return backgroundThreadLimit;
+	}
+
+	void Execute(context& ctx, Task&& task)
 	{
 		// Context state is updated:
 		ctx.counter.fetch_add(1);
 
+		TaskBlock* block = taskBlockPool.allocate();
+		block->task = std::move(task);
+		block->refCount.store(1);
+
 		Job job;
 		job.ctx = &ctx;
-		job.task = task;
+		job.block = block;
 		job.groupID = 0;
 		job.groupJobOffset = 0;
 		job.groupJobEnd = 1;
 		job.sharedmemory_size = 0;
 
-		// Try to push a new job until it is pushed successfully:
-		while (!jobQueue.push_back(job)) { wakeCondition.notify_all(); work(); }
+		submit(job, ctx.priority);
 
 		// Wake any one thread that might be sleeping:
-		wakeCondition.notify_one();
+		wake(1);
 	}
 
-	void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, const std::function<void(wiJobArgs)>& task, size_t sharedmemory_size)
+	void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, Task&& task, size_t sharedmemory_size)
 	{
 		if (jobCount == 0 || groupSize == 0)
 		{
@@ -144,9 +1155,14 @@ namespace wiJobSystem
 		// Context state is updated:
 		ctx.counter.fetch_add(groupCount);
 
+		// The task is stored once, every group job references it:
+		TaskBlock* block = taskBlockPool.allocate();
+		block->task = std::move(task);
+		block->refCount.store(groupCount);
+
 		Job job;
 		job.ctx = &ctx;
-		job.task = task;
+		job.block = block;
 		job.sharedmemory_size = (uint32_t)sharedmemory_size;
 
 		for (uint32_t groupID = 0; groupID < groupCount; ++groupID)
@@ -156,12 +1172,76 @@ namespace wiJobSystem
 			job.groupJobOffset = groupID * groupSize;
 			job.groupJobEnd = std::min(job.groupJobOffset + groupSize, jobCount);
 
-			// Try to push a new job until it is pushed successfully:
-			while (!jobQueue.push_back(job)) { wakeCondition.notify_all(); work(); }
+			submit(job, ctx.priority);
+		}
+
+		// Wake as many threads as there are new jobs:
+		wake(groupCount);
+	}
+
+	void SetStatsEnabled(bool value)
+	{
+		statsEnabled.store(value);
+	}
+
+	bool IsStatsEnabled()
+	{
+		return statsEnabled.load();
+	}
+
+	void ConsumeStats(Stats& stats)
+	{
+		stats.workers.clear();
+		stats.contexts.clear();
+		if (threadStats == nullptr)
+		{
+			return;
+		}
+
+		stats.workers.resize(numThreads + 1);
+		for (uint32_t i = 0; i <= numThreads; ++i)
+		{
+			ThreadStats& thread = threadStats[i];
+			WorkerStats& worker = stats.workers[i];
+			worker.busyTime = thread.busyTime.exchange(0, std::memory_order_relaxed);
+			worker.idleTime = thread.idleTime.exchange(0, std::memory_order_relaxed);
+			worker.stealTime = thread.stealTime.exchange(0, std::memory_order_relaxed);
+			worker.jobCount = thread.jobCount.exchange(0, std::memory_order_relaxed);
+			worker.stealCount = thread.stealCount.exchange(0, std::memory_order_relaxed);
+			worker.sleepCount = thread.sleepCount.exchange(0, std::memory_order_relaxed);
+
+			for (auto& x : thread.contexts)
+			{
+				const char* name = x.name.load(std::memory_order_acquire);
+				if (name == nullptr)
+				{
+					break;
+				}
+				const uint64_t time = x.time.exchange(0, std::memory_order_relaxed);
+				const uint32_t jobCount = x.jobCount.exchange(0, std::memory_order_relaxed);
+				if (jobCount == 0)
+				{
+					continue;
+				}
+				// The same name can be a different string literal in an other translation unit:
+				auto it = std::find_if(stats.contexts.begin(), stats.contexts.end(), [&](const ContextStats& other) { return strcmp(other.name, name) == 0; });
+				if (it == stats.contexts.end())
+				{
+					stats.contexts.emplace_back();
+					it = stats.contexts.end() - 1;
+					it->name = name;
+				}
+				it->time += time;
+				it->jobCount += jobCount;
+			}
 		}
 
-		// Wake any threads that might be sleeping:
-		wakeCondition.notify_all();
+		for (uint32_t i = 0; i < priorityCount; ++i)
+		{
+			stats.queueDepth[i] = pendingJobs[i].load();
+		}
+		stats.queueGrowCount = queueGrowCount.exchange(0, std::memory_order_relaxed);
+		stats.queueContentionCount = queueContentionCount.exchange(0, std::memory_order_relaxed);
 	}
 
 	uint32_t DispatchGroupCount(uint32_t jobCount, uint32_t groupSize)
@@ -178,23 +1258,120 @@ namespace wiJobSystem
 
 	void Wait(const context& ctx)
 	{
-		// Wake any threads that might be sleeping:
-		wakeCondition.notify_all();
+		// Inside a job running on a worker fiber, the job is suspended until the context is finished, so the worker can continue with other jobs on a fresh stack
+		if (fibersEnabled && IsBusy(ctx))
+		{
+			wait_fiber(ctx);
+		}
 
-		// Waiting will also put the current thread to good use by working on an other job if it can:
-		while (IsBusy(ctx)) { work(); }
+		// Waiting will also put the current thread to good use by working on an other job if it can
+		//	Only jobs with at least the priority of the context are picked up, so that waiting on frame critical work doesn't get stuck in a long background task:
+		while (IsBusy(ctx)) { work(ctx.priority); }
 	}
 
 	void WaitSleep(const context& ctx, uint32_t time)
 	{
-		// Wake any threads that might be sleeping:
-		wakeCondition.notify_all();
-
 		//PE: Give time for free threads to take over jobs, before jumping in.
 		Sleep(time);
 
-		// Waiting will also put the current thread to good use by working on an other job if it can:
-		while (IsBusy(ctx)) { work(); }
+		// Waiting will also put the current thread to good use by working on an other job if it can
+		//	Only jobs with at least the priority of the context are picked up, so that waiting on frame critical work doesn't get stuck in a long background task:
+		while (IsBusy(ctx)) { work(ctx.priority); }
+	}
+
+	uint32_t GrainSize::Calculate(uint32_t count)
+	{
+		// Target duration of a job group: long enough to hide the scheduling overhead, short enough for load balancing
+		static const float target_group_ns = 50000.0f;
+
+		const uint32_t items = measuredItems.exchange(0, std::memory_order_relaxed);
+		const uint64_t nanoseconds = measuredNanoseconds.exchange(0, std::memory_order_relaxed);
+		float cost = nsPerItem.load(std::memory_order_relaxed);
+		if (items > 0)
+		{
+			const float measured = std::max(1.0f, float(nanoseconds) / float(items));
+			cost = cost > 0 ? (cost * 0.75f + measured * 0.25f) : measured;
+			nsPerItem.store(cost, std::memory_order_relaxed);
+		}
+		if (cost <= 0)
+		{
+			return std::max(1u, initialGroupSize);
+		}
+		return std::max(1u, std::min(count, uint32_t(target_group_ns / cost)));
+	}
+
+	TaskGraph::Node TaskGraph::AddNode(const std::function<void(context&)>& task)
+	{
+		NodeData node;
+		node.task = task;
+		nodes.push_back(std::move(node));
+		return Node(nodes.size() - 1);
+	}
+
+	void TaskGraph::AddDependency(Node predecessor, Node successor)
+	{
+		assert(predecessor < nodes.size());
+		assert(successor < nodes.size());
+		assert(predecessor != successor);
+		nodes[predecessor].successors.push_back(successor);
+		nodes[successor].predecessorCount++;
+	}
+
+	void TaskGraph::Clear()
+	{
+		nodes.clear();
+	}
+
+	// Execute a single node, then start every successor that has no more unfinished predecessors
+	void RunNode(TaskGraph& graph, TaskGraph::Node node, context& ctx)
+	{
+		Execute(ctx, [&graph, node, &ctx](wiJobArgs args) {
+
+			// The node's own subtasks are waited here, the waiting thread keeps executing other jobs meanwhile:
+			context node_ctx;
+			node_ctx.name = ctx.name; // subtasks are reported as part of the graph
+			graph.nodes[node].task(node_ctx);
+			Wait(node_ctx);
+
+			// The successors are started before this job finishes, so the graph context can't reach zero before the whole graph is done:
+			for (TaskGraph::Node successor : graph.nodes[node].successors)
+			{
+				if (graph.remaining[successor].fetch_sub(1) == 1)
+				{
+					RunNode(graph, successor, ctx);
+				}
+			}
+		});
+	}
+
+	void Run(TaskGraph& graph, context& ctx)
+	{
+		if (graph.nodes.empty())
+		{
+			return;
+		}
+
+		// The counters are only reallocated when the graph grew since the last run:
+		if (graph.remaining_capacity < graph.nodes.size())
+		{
+			graph.remaining_capacity = graph.nodes.size();
+			graph.remaining.reset(new std::atomic<uint32_t>[graph.remaining_capacity]);
+		}
+		for (size_t i = 0; i < graph.nodes.size(); ++i)
+		{
+			graph.remaining[i].store(graph.nodes[i].predecessorCount);
+		}
+
+		bool root_found = false;
+		for (size_t i = 0; i < graph.nodes.size(); ++i)
+		{
+			if (graph.nodes[i].predecessorCount == 0)
+			{
+				root_found = true;
+				RunNode(graph, TaskGraph::Node(i), ctx);
+			}
+		}
+		assert(root_found && "The task graph contains a cycle!");
 	}
 
 }
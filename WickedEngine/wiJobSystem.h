@@ -2,6 +2,20 @@
 
 #include <functional>
 #include <atomic>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <iterator>
+#include <chrono>
+
+namespace wiAllocators
+{
+	class LinearAllocator;
+}
 
 struct wiJobArgs
 {
@@ -11,28 +25,190 @@ struct wiJobArgs
 	bool isFirstJobInGroup;	// is the current job the first one in the group?
 	bool isLastJobInGroup;	// is the current job the last one in the group?
 	void* sharedmemory;		// stack memory shared within the current group (jobs within a group execute serially)
+	wiAllocators::LinearAllocator* scratch; // linear allocator of the executing thread for temporary memory, everything allocated from it is freed after the job
 };
 
 namespace wiJobSystem
 {
-	void Initialize();
+	// Worker thread placement policy
+	enum class AffinityPolicy
+	{
+		None,			// worker threads are not pinned, the OS scheduler decides
+		PhysicalFirst,	// one worker per physical core first, SMT siblings are only used when there are more workers than physical cores
+		ExplicitMask,	// workers are pinned round-robin to the logical processors specified by InitDesc::affinityMask
+	};
+
+	struct InitDesc
+	{
+		uint32_t threadCount = 0; // number of worker threads, 0 = one for every available logical processor except the one of the main thread
+		AffinityPolicy affinity = AffinityPolicy::PhysicalFirst;
+		uint64_t affinityMask = 0; // logical processors in the selected processor group, used with AffinityPolicy::ExplicitMask
+		int processorGroup = -1; // restrict workers to a processor group (Windows, for systems with more than 64 logical processors), -1 = all groups
+		int numaNode = -1; // restrict workers to the processors of a NUMA node, -1 = all nodes
+		uint32_t idleSpinCount = 2000; // how many times an idle worker checks for new jobs before going to sleep, 0 = sleep immediately
+		bool fibers = false; // run jobs on fibers, so that Wait() inside a job suspends it instead of executing other jobs nested on its stack. Jobs can continue on a different thread after Wait()
+		uint32_t fiberCount = 128; // number of fibers available for suspended jobs and worker loops
+		uint32_t fiberStackSize = 256 * 1024; // stack size of each fiber in bytes
+		uint32_t scratchSize = 1024 * 1024; // capacity of the wiJobArgs::scratch allocator in bytes, allocated on first use by each thread (and each fiber if fibers are enabled)
+	};
+
+	// Create the worker threads. Calling it again after the job system was initialized has no effect,
+	//	so an application can initialize with a custom InitDesc before wiInitializer does it with the defaults
+	void Initialize(const InitDesc& desc = {});
 
 	uint32_t GetThreadCount();
 
+	// Returns the number of queued jobs that didn't start yet, of every priority
+	uint32_t GetQueueDepth();
+
+	// Returns the index of the worker thread that calls it in [0, GetThreadCount()), or ~0u if it is not a worker (eg. main thread)
+	uint32_t GetCurrentWorkerIndex();
+
+	// Job priorities. Worker threads always pick up the highest priority job available
+	enum class Priority
+	{
+		High,		// frame critical work that the rest of the frame is waiting for (eg. visibility culling)
+		Normal,		// default per-frame work
+		Background,	// long running or streaming work (eg. resource loading). Only picked up when no High or Normal jobs are available
+		Count
+	};
+
+	// Set the maximum number of worker threads that can be busy with Background priority jobs at the same time
+	void SetBackgroundThreadLimit(uint32_t value);
+	uint32_t GetBackgroundThreadLimit();
+
 	// Defines a state of execution, can be waited on
 	struct context
 	{
 		std::atomic<uint32_t> counter{ 0 };
+		Priority priority = Priority::Normal; // every job that is started with this context will have this priority
+		const char* name = nullptr; // optional, the job time of named contexts is reported separately in the statistics. Must point to a string that is never freed (eg. a literal)
+	};
+
+	// Type erased callable for job tasks, similar to std::function<void(wiJobArgs)> but move-only
+	//	Callables up to inline_capacity bytes (eg. lambdas with a handful of captures) are stored inline without heap allocation
+	//	Bigger callables fall back to a heap allocation
+	class Task
+	{
+	public:
+		static constexpr size_t inline_capacity = 128;
+
+		Task() = default;
+		template<typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, Task>::value>>
+		Task(F&& func)
+		{
+			using T = std::decay_t<F>;
+			if constexpr (sizeof(T) <= inline_capacity && alignof(T) <= alignof(std::max_align_t))
+			{
+				new (storage) T(std::forward<F>(func));
+				ops = &inline_ops<T>;
+			}
+			else
+			{
+				*reinterpret_cast<T**>(storage) = new T(std::forward<F>(func));
+				ops = &heap_ops<T>;
+			}
+		}
+		Task(Task&& other) noexcept { move_from(other); }
+		Task& operator=(Task&& other) noexcept
+		{
+			if (this != &other)
+			{
+				reset();
+				move_from(other);
+			}
+			return *this;
+		}
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+		~Task() { reset(); }
+
+		inline void operator()(const wiJobArgs& args) { ops->invoke(storage, args); }
+		inline bool IsValid() const { return ops != nullptr; }
+
+		// Destroy the stored callable
+		inline void reset()
+		{
+			if (ops != nullptr)
+			{
+				ops->destroy(storage);
+				ops = nullptr;
+			}
+		}
+
+	private:
+		struct Ops
+		{
+			void (*invoke)(void* storage, const wiJobArgs& args);
+			void (*move)(void* dst, void* src); // move constructs into dst and destroys src
+			void (*destroy)(void* storage);
+		};
+		template<typename T>
+		static constexpr Ops inline_ops = {
+			[](void* storage, const wiJobArgs& args) { (*reinterpret_cast<T*>(storage))(args); },
+			[](void* dst, void* src) { new (dst) T(std::move(*reinterpret_cast<T*>(src))); reinterpret_cast<T*>(src)->~T(); },
+			[](void* storage) { reinterpret_cast<T*>(storage)->~T(); },
+		};
+		template<typename T>
+		static constexpr Ops heap_ops = {
+			[](void* storage, const wiJobArgs& args) { (**reinterpret_cast<T**>(storage))(args); },
+			[](void* dst, void* src) { *reinterpret_cast<T**>(dst) = *reinterpret_cast<T**>(src); },
+			[](void* storage) { delete *reinterpret_cast<T**>(storage); },
+		};
+
+		inline void move_from(Task& other)
+		{
+			if (other.ops != nullptr)
+			{
+				other.ops->move(storage, other.storage);
+				ops = other.ops;
+				other.ops = nullptr;
+			}
+		}
+
+		alignas(std::max_align_t) unsigned char storage[inline_capacity];
+		const Ops* ops = nullptr;
 	};
 
 	// Add a task to execute asynchronously. Any idle thread will execute this.
-	void Execute(context& ctx, const std::function<void(wiJobArgs)>& task);
+	void Execute(context& ctx, Task&& task);
 
 	// Divide a task onto multiple jobs and execute in parallel.
 	//	jobCount	: how many jobs to generate for this task.
 	//	groupSize	: how many jobs to execute per thread. Jobs inside a group execute serially. It might be worth to increase for small jobs
-	//	task		: receives a wiJobArgs as parameter
-	void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, const std::function<void(wiJobArgs)>& task, size_t sharedmemory_size = 0);
+	//	task		: receives a wiJobArgs as parameter. It is stored only once and shared by every job of the dispatch
+	void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, Task&& task, size_t sharedmemory_size = 0);
+
+	// Statistics for profiling. Job and idle timings are only recorded while enabled, because they add a small cost to every job
+	void SetStatsEnabled(bool value);
+	bool IsStatsEnabled();
+
+	struct WorkerStats
+	{
+		uint64_t busyTime = 0; // nanoseconds spent executing jobs (including jobs executed while waiting inside an other job)
+		uint64_t idleTime = 0; // nanoseconds spent spinning or sleeping without any job
+		uint64_t stealTime = 0; // nanoseconds spent searching the queues of other threads
+		uint32_t jobCount = 0; // executed job groups
+		uint32_t stealCount = 0; // job groups taken from the queues of other threads
+		uint32_t sleepCount = 0; // how many times the worker went to sleep
+	};
+	struct ContextStats
+	{
+		const char* name = nullptr;
+		uint64_t time = 0; // nanoseconds spent executing jobs of contexts with this name
+		uint32_t jobCount = 0;
+	};
+	struct Stats
+	{
+		std::vector<WorkerStats> workers; // one for each worker thread, the last one is shared by all other threads (eg. the main thread helping in Wait())
+		std::vector<ContextStats> contexts; // named contexts that had jobs executed
+		uint32_t queueDepth[(size_t)Priority::Count] = {}; // number of job groups currently waiting in the queues
+		uint32_t queueGrowCount = 0; // how many times a job queue was full and had to grow its ring buffer
+		uint32_t queueContentionCount = 0; // how many times a thread found a job queue locked by an other thread
+	};
+
+	// Retrieve the statistics that were recorded since the previous call
+	void ConsumeStats(Stats& stats);
 
 	// Returns the amount of job groups that will be created for a set number of jobs and group size
 	uint32_t DispatchGroupCount(uint32_t jobCount, uint32_t groupSize);
@@ -40,9 +216,268 @@ namespace wiJobSystem
 	// Check if any threads are working currently or not
 	bool IsBusy(const context& ctx);
 
-	// Wait until all threads become idle
+	// Wait until all jobs of the context are finished
+	//	The waiting thread helps by executing jobs which have at least the priority of the context
+	//	With InitDesc::fibers enabled, a job that waits is suspended instead, and resumed by any worker after the context is finished
 	void Wait(const context& ctx);
 #ifdef GGREDUCED
 	void WaitSleep(const context& ctx,uint32_t time);
 #endif
+
+	// Task graph: a set of tasks with explicit dependencies between them
+	//	A task is started as soon as all of its predecessors have finished, so there is no need for barriers that wait on unrelated tasks
+	//	Every task receives its own context that it can use to spawn subtasks. The task only counts as finished when all of its subtasks finished too
+	//	The graph can be built once and run many times
+	struct TaskGraph
+	{
+		using Node = uint32_t;
+
+		struct NodeData
+		{
+			std::function<void(context&)> task;
+			std::vector<Node> successors;
+			uint32_t predecessorCount = 0;
+		};
+		std::vector<NodeData> nodes;
+		std::unique_ptr<std::atomic<uint32_t>[]> remaining; // remaining predecessor count for each node while the graph is running
+		size_t remaining_capacity = 0;
+
+		// Add a new task to the graph and return its handle
+		Node AddNode(const std::function<void(context&)>& task);
+
+		// The successor node will only start after the predecessor node has finished
+		void AddDependency(Node predecessor, Node successor);
+
+		// Remove every node from the graph. Must not be called while the graph is running
+		void Clear();
+
+		// Check whether any node was added to the graph
+		bool IsEmpty() const { return nodes.empty(); }
+	};
+
+	// Start executing every node of the task graph, respecting the dependencies
+	//	ctx	: can be waited on for the completion of the whole graph
+	//	The graph must not be modified or destroyed while it is running
+	void Run(TaskGraph& graph, context& ctx);
+
+	// Automatic group size selection for ParallelFor(), based on the measured cost per item of the previous runs
+	//	Keep one instance per call site (eg. as a static variable), because the cost depends on the work that is done for each item
+	struct GrainSize
+	{
+		uint32_t initialGroupSize = 64; // used until the first measurement is available
+		std::atomic<float> nsPerItem{ 0 }; // smoothed cost of one item in nanoseconds, 0 = not measured yet
+		std::atomic<uint64_t> measuredNanoseconds{ 0 }; // accumulated by the running jobs
+		std::atomic<uint32_t> measuredItems{ 0 };
+
+		// Consume the latest measurement and return the group size to use for the specified amount of items
+		uint32_t Calculate(uint32_t count);
+
+		inline void Measure(uint32_t items, uint64_t nanoseconds)
+		{
+			measuredItems.fetch_add(items, std::memory_order_relaxed);
+			measuredNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+		}
+	};
+
+	// Execute func(uint32_t index) for every index in [0, count) asynchronously, groupSize indices per job
+	template<typename F>
+	void ParallelFor(context& ctx, uint32_t count, uint32_t groupSize, F&& func)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		Dispatch(ctx, DispatchGroupCount(count, groupSize), 1, [=](const wiJobArgs& args) mutable {
+			const uint32_t begin = args.jobIndex * groupSize;
+			const uint32_t end = std::min(begin + groupSize, count);
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				func(i);
+			}
+		});
+	}
+
+	// Execute func(uint32_t index) for every index in [0, count) asynchronously, the group size is chosen automatically
+	template<typename F>
+	void ParallelFor(context& ctx, uint32_t count, GrainSize& grain, F&& func)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		const uint32_t groupSize = grain.Calculate(count);
+		GrainSize* grain_ptr = &grain;
+		Dispatch(ctx, DispatchGroupCount(count, groupSize), 1, [=](const wiJobArgs& args) mutable {
+			const uint32_t begin = args.jobIndex * groupSize;
+			const uint32_t end = std::min(begin + groupSize, count);
+			const auto time_begin = std::chrono::steady_clock::now();
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				func(i);
+			}
+			const auto time_end = std::chrono::steady_clock::now();
+			grain_ptr->Measure(end - begin, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(time_end - time_begin).count());
+		});
+	}
+
+	// Parallel stream compaction, asynchronously
+	//	func		: bool(uint32_t index, T& element), returns true if the index produced an element
+	//	output		: must have room for count elements
+	//	outputCount	: incremented by the number of written elements
+	//	The elements are first collected in group shared memory, then each group appends its list to the output with one atomic operation,
+	//	so elements of a group remain in order, but the order of the groups is not deterministic
+	template<typename T, typename F>
+	void ParallelCompact(context& ctx, uint32_t count, uint32_t groupSize, T* output, std::atomic<uint32_t>& outputCount, F&& func)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable, it is stored in group shared memory");
+		const size_t counter_offset = ((groupSize * sizeof(T) + alignof(uint32_t) - 1) / alignof(uint32_t)) * alignof(uint32_t);
+		std::atomic<uint32_t>* output_count = &outputCount;
+		Dispatch(ctx, count, groupSize, [=](const wiJobArgs& args) mutable {
+			T* group_list = (T*)args.sharedmemory;
+			uint32_t& group_count = *(uint32_t*)((uint8_t*)args.sharedmemory + counter_offset);
+			if (args.isFirstJobInGroup)
+			{
+				group_count = 0; // first job initializes local counter
+			}
+
+			// Local stream compaction:
+			if (func(args.jobIndex, group_list[group_count]))
+			{
+				group_count++;
+			}
+
+			// Global stream compaction:
+			if (args.isLastJobInGroup && group_count > 0)
+			{
+				const uint32_t prev_count = output_count->fetch_add(group_count);
+				std::copy(group_list, group_list + group_count, output + prev_count);
+			}
+		}, counter_offset + sizeof(uint32_t));
+	}
+
+	// Parallel reduction, waits for ctx
+	//	map		: T(uint32_t index), the value of an index
+	//	combine	: T(const T&, const T&), must be associative. Partial results are combined in index order, so the result is deterministic
+	template<typename T, typename Map, typename Combine>
+	T ParallelReduce(context& ctx, uint32_t count, uint32_t groupSize, const T& identity, Map&& map, Combine&& combine)
+	{
+		const uint32_t groupCount = DispatchGroupCount(count, groupSize);
+		std::vector<T> partials(groupCount, identity);
+		T* partials_ptr = partials.data();
+		Dispatch(ctx, groupCount, 1, [=, &map, &combine](const wiJobArgs& args) {
+			const uint32_t begin = args.jobIndex * groupSize;
+			const uint32_t end = std::min(begin + groupSize, count);
+			T value = identity;
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				value = combine(value, map(i));
+			}
+			partials_ptr[args.jobIndex] = value;
+		});
+		Wait(ctx);
+
+		T result = identity;
+		for (const T& value : partials)
+		{
+			result = combine(result, value);
+		}
+		return result;
+	}
+
+	// Parallel exclusive prefix scan: output[i] = identity op input[0] op ... op input[i - 1], waits for ctx
+	//	input and output can be the same array
+	//	op	: T(const T&, const T&), must be associative
+	//	Returns the total of every input element
+	template<typename T, typename Op>
+	T ParallelExclusiveScan(context& ctx, uint32_t count, uint32_t groupSize, const T* input, T* output, const T& identity, Op&& op)
+	{
+		// Reduce the groups:
+		const uint32_t groupCount = DispatchGroupCount(count, groupSize);
+		std::vector<T> offsets(groupCount, identity);
+		T* offsets_ptr = offsets.data();
+		Dispatch(ctx, groupCount, 1, [=, &op](const wiJobArgs& args) {
+			const uint32_t begin = args.jobIndex * groupSize;
+			const uint32_t end = std::min(begin + groupSize, count);
+			T value = identity;
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				value = op(value, input[i]);
+			}
+			offsets_ptr[args.jobIndex] = value;
+		});
+		Wait(ctx);
+
+		// Scan the group totals serially, there are only a few of them:
+		T total = identity;
+		for (T& value : offsets)
+		{
+			T next = op(total, value);
+			value = total;
+			total = next;
+		}
+
+		// Scan inside the groups, starting from the group offsets:
+		Dispatch(ctx, groupCount, 1, [=, &op](const wiJobArgs& args) {
+			const uint32_t begin = args.jobIndex * groupSize;
+			const uint32_t end = std::min(begin + groupSize, count);
+			T value = offsets_ptr[args.jobIndex];
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				T next = op(value, input[i]);
+				output[i] = value;
+				value = next;
+			}
+		});
+		Wait(ctx);
+
+		return total;
+	}
+
+	// Parallel sort, waits for ctx
+	//	The array is split into chunks that are sorted in parallel with std::sort, then the sorted chunks are merged in parallel pairwise rounds
+	//	minChunkSize	: arrays are not split below this size, small arrays are simply sorted on the calling thread
+	template<typename T, typename Compare = std::less<T>>
+	void ParallelSort(context& ctx, T* data, uint32_t count, Compare comp = Compare(), uint32_t minChunkSize = 1024)
+	{
+		uint32_t chunkCount = 1;
+		while (chunkCount <= GetThreadCount() && count / (chunkCount * 2) >= minChunkSize)
+		{
+			chunkCount *= 2;
+		}
+		if (chunkCount == 1)
+		{
+			std::sort(data, data + count, comp);
+			return;
+		}
+		auto chunk_begin = [=](uint32_t chunk) { return uint32_t(uint64_t(std::min(chunk, chunkCount)) * count / chunkCount); };
+
+		Dispatch(ctx, chunkCount, 1, [=](const wiJobArgs& args) {
+			std::sort(data + chunk_begin(args.jobIndex), data + chunk_begin(args.jobIndex + 1), comp);
+		});
+		Wait(ctx);
+
+		std::vector<T> temp(count);
+		T* src = data;
+		T* dst = temp.data();
+		for (uint32_t width = 1; width < chunkCount; width *= 2)
+		{
+			Dispatch(ctx, chunkCount / (width * 2), 1, [=](const wiJobArgs& args) {
+				const uint32_t first = args.jobIndex * width * 2;
+				const uint32_t begin = chunk_begin(first);
+				const uint32_t middle = chunk_begin(first + width);
+				const uint32_t end = chunk_begin(first + width * 2);
+				std::merge(
+					std::make_move_iterator(src + begin), std::make_move_iterator(src + middle),
+					std::make_move_iterator(src + middle), std::make_move_iterator(src + end),
+					dst + begin, comp
+				);
+			});
+			Wait(ctx);
+			std::swap(src, dst);
+		}
+		if (src != data)
+		{
+			std::move(src, src + count, data);
+		}
+	}
 }
@@ -2,6 +2,10 @@
 #include "wiLua_Globals.h"
 #include "wiBackLog.h"
 #include "wiHelper.h"
+#include "wiMemoryTracker.h"
+#include "wiCounters.h"
+#include "wiProfiler.h"
+#include "wiTimer.h"
 #include "MainComponent_BindLua.h"
 #include "RenderPath_BindLua.h"
 #include "RenderPath2D_BindLua.h"
@@ -25,6 +29,9 @@
 #include <sstream>
 #include <memory>
 #include <vector>
+#include <atomic>
+#include <cstdio>
+#include <algorithm>
 
 #define WILUA_ERROR_PREFIX "[Lua Error] "
 
@@ -46,6 +53,15 @@ namespace wiLua
 	LuaInternal luainternal;
 	std::string script_path;
 
+	double gc_budget = 0;
+	size_t gc_baseline = 0; // heap size after the last finished collection cycle
+	uint64_t gc_cycles = 0;
+
+	size_t GetHeapSize()
+	{
+		return (size_t)lua_gc(luainternal.m_luaState, LUA_GCCOUNT, 0) * 1024 + (size_t)lua_gc(luainternal.m_luaState, LUA_GCCOUNTB, 0);
+	}
+
 	int Internal_DoFile(lua_State* L)
 	{
 		int argc = SGetArgCount(L);
@@ -90,6 +106,9 @@ namespace wiLua
 	{
 		luainternal.m_luaState = luaL_newstate();
 		luaL_openlibs(luainternal.m_luaState);
+		wiMemoryTracker::SetMeasurement(wiMemoryTracker::TAG_LUA, GetHeapSize);
+		wiCounters::SetMeasurement(wiCounters::Register("Lua.HeapSize"), [] { return (double)GetHeapSize(); });
+		wiCounters::SetMeasurement(wiCounters::Register("Lua.GCCycles"), [] { return (double)gc_cycles; });
 		RegisterFunc("dofile", Internal_DoFile);
 		RunText(wiLua_Globals);
 
@@ -157,25 +176,85 @@ namespace wiLua
 			lua_pop(luainternal.m_luaState, 1); // remove error message
 		}
 	}
+	bool RunScript()
+	{
+		luainternal.m_status = lua_pcall(luainternal.m_luaState, 0, LUA_MULTRET, 0);
+		if (Failed())
+		{
+			PostErrorMsg();
+			return false;
+		}
+		return true;
+	}
+
+	std::string bytecode_cache_directory;
+	void SetBytecodeCacheDirectory(const std::string& directory)
+	{
+		bytecode_cache_directory = directory;
+		if (!bytecode_cache_directory.empty() && bytecode_cache_directory.back() != '/' && bytecode_cache_directory.back() != '\\')
+		{
+			bytecode_cache_directory += "/";
+		}
+	}
+	const std::string& GetBytecodeCacheDirectory()
+	{
+		return bytecode_cache_directory;
+	}
+	int WriteBytecode(lua_State* L, const void* p, size_t sz, void* ud)
+	{
+		std::vector<uint8_t>& bytecode = *(std::vector<uint8_t>*)ud;
+		bytecode.insert(bytecode.end(), (const uint8_t*)p, (const uint8_t*)p + sz);
+		return 0;
+	}
 	bool RunFile(const std::string& filename)
 	{
 		script_path = wiHelper::GetDirectoryFromPath(filename);
 		std::vector<uint8_t> filedata;
-		if (wiHelper::FileRead(filename, filedata))
+		if (!wiHelper::FileRead(filename, filedata))
 		{
-			return RunText(std::string(filedata.begin(), filedata.end()));
+			return false;
 		}
-		return false;
-	}
-	bool RunScript()
-	{
-		luainternal.m_status = lua_pcall(luainternal.m_luaState, 0, LUA_MULTRET, 0);
+		// The file can be source or precompiled bytecode (for example from luac or from the cache directory):
+		const std::string chunkname = "@" + filename;
+		lua_State* L = luainternal.m_luaState;
+
+		std::string cachefile;
+		if (!bytecode_cache_directory.empty() && (filedata.empty() || filedata[0] != LUA_SIGNATURE[0]))
+		{
+			// The cache is keyed by the hash of the source and the bytecode format of this Lua build:
+			const uint64_t hash = wiHelper::HashData(filedata.data(), filedata.size(), LUA_VERSION_NUM * 100 + sizeof(void*) * 10 + sizeof(lua_Number));
+			char name[32];
+			snprintf(name, arraysize(name), "%016llx.luac", (unsigned long long)hash);
+			cachefile = bytecode_cache_directory + name;
+
+			std::vector<uint8_t> bytecode;
+			if (wiHelper::FileExists(cachefile) && wiHelper::FileRead(cachefile, bytecode) && !bytecode.empty())
+			{
+				luainternal.m_status = luaL_loadbufferx(L, (const char*)bytecode.data(), bytecode.size(), chunkname.c_str(), "b");
+				if (Success())
+				{
+					return RunScript();
+				}
+				lua_pop(L, 1); // the cached file is broken, the source is compiled again
+			}
+		}
+
+		luainternal.m_status = luaL_loadbufferx(L, (const char*)filedata.data(), filedata.size(), chunkname.c_str(), nullptr);
 		if (Failed())
 		{
 			PostErrorMsg();
 			return false;
 		}
-		return true;
+
+		if (!cachefile.empty())
+		{
+			std::vector<uint8_t> bytecode;
+			if (lua_dump(L, WriteBytecode, &bytecode, 0) == 0 && !bytecode.empty())
+			{
+				wiHelper::FileWriteAtomic(cachefile, bytecode.data(), bytecode.size());
+			}
+		}
+		return RunScript();
 	}
 	bool RunText(const std::string& script)
 	{
@@ -254,12 +333,60 @@ namespace wiLua
 	void Update()
 	{
 		Signal("wickedengine_update_tick");
+
+		if (gc_budget > 0)
+		{
+			static const wiCounters::counter_id counter_gc_time = wiCounters::Register("Lua.GCTime", wiCounters::TYPE_HISTOGRAM);
+			auto range = wiProfiler::BeginRangeCPU("Lua GC");
+			wiTimer timer;
+
+			const bool overgrown = GetHeapSize() > gc_baseline * 2;
+			bool finished = false;
+			do {
+				finished = lua_gc(luainternal.m_luaState, LUA_GCSTEP, 0) != 0;
+			} while (!finished && (overgrown || timer.elapsed_milliseconds() < gc_budget));
+
+			if (finished)
+			{
+				gc_baseline = GetHeapSize();
+				gc_cycles++;
+			}
+
+			wiCounters::Sample(counter_gc_time, timer.elapsed_milliseconds());
+			wiProfiler::EndRange(range);
+		}
 	}
 	void Render()
 	{
 		Signal("wickedengine_render_tick");
 	}
 
+	void SetGarbageCollectionBudget(double milliseconds)
+	{
+		if (milliseconds > 0 && gc_budget <= 0)
+		{
+			lua_gc(luainternal.m_luaState, LUA_GCSTOP, 0);
+			gc_baseline = GetHeapSize();
+		}
+		else if (milliseconds <= 0 && gc_budget > 0)
+		{
+			lua_gc(luainternal.m_luaState, LUA_GCRESTART, 0);
+		}
+		gc_budget = std::max(0.0, milliseconds);
+	}
+	double GetGarbageCollectionBudget()
+	{
+		return gc_budget;
+	}
+	void CollectGarbage()
+	{
+		auto range = wiProfiler::BeginRangeCPU("Lua GC");
+		lua_gc(luainternal.m_luaState, LUA_GCCOLLECT, 0);
+		gc_baseline = GetHeapSize();
+		gc_cycles++;
+		wiProfiler::EndRange(range);
+	}
+
 	inline void SignalHelper(lua_State* L, const std::string& name)
 	{
 		lua_getglobal(L, "signal");
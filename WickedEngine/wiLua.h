@@ -28,8 +28,12 @@ namespace wiLua
 	std::string PopErrorMsg();
 	//post error to backlog and/or debug output
 	void PostErrorMsg();
-	//run a script from file
+	//run a script from file, it can be source or precompiled bytecode
 	bool RunFile(const std::string& filename);
+	//set a directory where RunFile() keeps the compiled bytecode of the source files, keyed by the hash of the source (empty: disabled, default)
+	//	a script that was run before is loaded from the cache instead of being compiled again
+	void SetBytecodeCacheDirectory(const std::string& directory);
+	const std::string& GetBytecodeCacheDirectory();
 	//run a script from param
 	bool RunText(const std::string& script);
 	//register function to use in scripts
@@ -56,6 +60,15 @@ namespace wiLua
 	//issue lua drawing commands which are waiting for a render tick
 	void Render();
 
+	//set a time budget for the garbage collector in every Update() (0: disabled, default)
+	//	by default Lua collects whenever its heap grows enough, and the whole collection can happen in the middle of any script call
+	//	with a budget the automatic collector is stopped, and Update() runs steps of the incremental collector until the budget is spent
+	//	if the heap still grows to twice its size after the last finished cycle, the collection is finished regardless of the budget
+	void SetGarbageCollectionBudget(double milliseconds);
+	double GetGarbageCollectionBudget();
+	//run a full garbage collection cycle right now, for example when a loading screen hides the hitch
+	void CollectGarbage();
+
 	//send a signal to lua
 	void Signal(const std::string& name);
 
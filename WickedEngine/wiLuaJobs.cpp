@@ -0,0 +1,329 @@
+#include "wiLuaJobs.h"
+#include "wiLua.h"
+#include "wiScene.h"
+#include "wiHelper.h"
+#include "wiBackLog.h"
+#include "wiSpinLock.h"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#define WILUA_ERROR_PREFIX "[Lua Error] "
+
+using namespace wiECS;
+using namespace wiScene;
+
+namespace wiLuaJobs
+{
+	static constexpr size_t MAX_ERRORS = 16; // per state, between two ApplyCommands(), so that a failing script doesn't flood the backlog
+
+	enum COMMAND
+	{
+		COMMAND_SET_TRANSLATION,
+		COMMAND_SET_ROTATION,
+		COMMAND_SET_SCALE,
+		COMMAND_TRANSLATE,
+		COMMAND_ROTATE,
+		COMMAND_SCALE,
+	};
+	struct Command
+	{
+		Entity entity;
+		COMMAND type;
+		XMFLOAT4 value;
+	};
+	struct JobState
+	{
+		lua_State* L = nullptr;
+		const Scene* scene = nullptr; // the scene of the running job
+		std::vector<Command> commands;
+		std::vector<std::string> errors;
+		size_t dropped_errors = 0;
+
+		~JobState()
+		{
+			if (L != nullptr)
+			{
+				lua_close(L);
+			}
+		}
+	};
+	std::vector<std::unique_ptr<JobState>> states; // a state for each worker thread, the last one is for the other threads
+	std::mutex nonworker_locker; // the threads that are not workers (the main thread when it helps in Wait()) share the last state
+	std::once_flag initialized;
+
+	void PushError(JobState& state)
+	{
+		const char* str = lua_tostring(state.L, -1);
+		if (state.errors.size() < MAX_ERRORS)
+		{
+			state.errors.push_back(str == nullptr ? "unknown error" : str);
+		}
+		else
+		{
+			state.dropped_errors++;
+		}
+		lua_pop(state.L, 1);
+	}
+
+	inline JobState& GetState(lua_State* L)
+	{
+		return *static_cast<JobState*>(lua_touserdata(L, lua_upvalueindex(1)));
+	}
+	inline const TransformComponent* GetTransform(lua_State* L, Entity& entity)
+	{
+		entity = (Entity)luaL_checkinteger(L, 1);
+		return GetState(L).scene->transforms.GetComponent(entity);
+	}
+	int Internal_GetPosition(lua_State* L)
+	{
+		Entity entity;
+		const TransformComponent* transform = GetTransform(L, entity);
+		if (transform == nullptr)
+		{
+			return 0;
+		}
+		const XMFLOAT3 value = transform->GetPosition();
+		lua_pushnumber(L, value.x);
+		lua_pushnumber(L, value.y);
+		lua_pushnumber(L, value.z);
+		return 3;
+	}
+	int Internal_GetRotation(lua_State* L)
+	{
+		Entity entity;
+		const TransformComponent* transform = GetTransform(L, entity);
+		if (transform == nullptr)
+		{
+			return 0;
+		}
+		const XMFLOAT4 value = transform->GetRotation();
+		lua_pushnumber(L, value.x);
+		lua_pushnumber(L, value.y);
+		lua_pushnumber(L, value.z);
+		lua_pushnumber(L, value.w);
+		return 4;
+	}
+	int Internal_GetScale(lua_State* L)
+	{
+		Entity entity;
+		const TransformComponent* transform = GetTransform(L, entity);
+		if (transform == nullptr)
+		{
+			return 0;
+		}
+		const XMFLOAT3 value = transform->GetScale();
+		lua_pushnumber(L, value.x);
+		lua_pushnumber(L, value.y);
+		lua_pushnumber(L, value.z);
+		return 3;
+	}
+
+	template<COMMAND type, int components>
+	int Internal_Command(lua_State* L)
+	{
+		Command command;
+		command.entity = (Entity)luaL_checkinteger(L, 1);
+		command.type = type;
+		command.value.x = (float)luaL_checknumber(L, 2);
+		command.value.y = (float)luaL_checknumber(L, 3);
+		command.value.z = (float)luaL_checknumber(L, 4);
+		command.value.w = components > 3 ? (float)luaL_checknumber(L, 5) : 0;
+		GetState(L).commands.push_back(command);
+		return 0;
+	}
+
+	void Initialize()
+	{
+		std::call_once(initialized, [] {
+			const uint32_t count = wiJobSystem::GetThreadCount() + 1;
+			states.resize(count);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				states[i] = std::make_unique<JobState>();
+				JobState& state = *states[i];
+				state.L = luaL_newstate();
+
+				// Only the libraries without side effects:
+				static const luaL_Reg libs[] = {
+					{ "_G", luaopen_base },
+					{ LUA_COLIBNAME, luaopen_coroutine },
+					{ LUA_TABLIBNAME, luaopen_table },
+					{ LUA_STRLIBNAME, luaopen_string },
+					{ LUA_MATHLIBNAME, luaopen_math },
+					{ LUA_UTF8LIBNAME, luaopen_utf8 },
+				};
+				for (auto& lib : libs)
+				{
+					luaL_requiref(state.L, lib.name, lib.func, 1);
+					lua_pop(state.L, 1);
+				}
+				lua_pushnil(state.L);
+				lua_setglobal(state.L, "dofile");
+				lua_pushnil(state.L);
+				lua_setglobal(state.L, "loadfile");
+
+				static const luaL_Reg functions[] = {
+					{ "GetPosition", Internal_GetPosition },
+					{ "GetRotation", Internal_GetRotation },
+					{ "GetScale", Internal_GetScale },
+					{ "SetTranslation", Internal_Command<COMMAND_SET_TRANSLATION, 3> },
+					{ "SetRotation", Internal_Command<COMMAND_SET_ROTATION, 4> },
+					{ "SetScale", Internal_Command<COMMAND_SET_SCALE, 3> },
+					{ "Translate", Internal_Command<COMMAND_TRANSLATE, 3> },
+					{ "Rotate", Internal_Command<COMMAND_ROTATE, 4> },
+					{ "Scale", Internal_Command<COMMAND_SCALE, 3> },
+					{ NULL, NULL }
+				};
+				lua_pushglobaltable(state.L);
+				lua_pushlightuserdata(state.L, &state);
+				luaL_setfuncs(state.L, functions, 1);
+				lua_pop(state.L, 1);
+			}
+			wiBackLog::post("wiLuaJobs Initialized");
+		});
+	}
+
+	bool RunChunk(const char* data, size_t size, const char* chunkname)
+	{
+		Initialize();
+		bool success = true;
+		for (auto& x : states)
+		{
+			int status = luaL_loadbuffer(x->L, data, size, chunkname);
+			if (status == LUA_OK)
+			{
+				status = lua_pcall(x->L, 0, 0, 0);
+			}
+			if (status != LUA_OK)
+			{
+				// Every state fails the same way, so the error is only posted once:
+				if (success)
+				{
+					std::string error = WILUA_ERROR_PREFIX;
+					const char* str = lua_tostring(x->L, -1);
+					error += str == nullptr ? "unknown error" : str;
+					wiBackLog::post(error.c_str());
+				}
+				lua_pop(x->L, 1);
+				success = false;
+			}
+		}
+		return success;
+	}
+	bool RunFile(const std::string& filename)
+	{
+		std::vector<uint8_t> filedata;
+		if (!wiHelper::FileRead(filename, filedata))
+		{
+			return false;
+		}
+		const std::string chunkname = "@" + filename;
+		return RunChunk((const char*)filedata.data(), filedata.size(), chunkname.c_str());
+	}
+	bool RunText(const std::string& script)
+	{
+		return RunChunk(script.c_str(), script.length(), script.c_str());
+	}
+
+	void Dispatch(wiJobSystem::context& ctx, const Scene& scene, const std::string& function, const Entity* entities, size_t count, float dt)
+	{
+		Initialize();
+		if (count == 0)
+		{
+			return;
+		}
+
+		struct Batch
+		{
+			const Scene* scene;
+			std::string function;
+			std::vector<Entity> entities;
+			float dt;
+		};
+		auto batch = std::make_shared<Batch>();
+		batch->scene = &scene;
+		batch->function = function;
+		batch->entities.assign(entities, entities + count);
+		batch->dt = dt;
+
+		wiJobSystem::Dispatch(ctx, (uint32_t)count, 16, [batch](wiJobArgs args) {
+			const uint32_t worker = wiJobSystem::GetCurrentWorkerIndex();
+			const bool nonworker = worker >= states.size() - 1;
+			JobState& state = *states[nonworker ? states.size() - 1 : worker];
+			if (nonworker)
+			{
+				nonworker_locker.lock();
+			}
+
+			state.scene = batch->scene;
+			lua_getglobal(state.L, batch->function.c_str());
+			lua_pushinteger(state.L, (lua_Integer)batch->entities[args.jobIndex]);
+			lua_pushnumber(state.L, batch->dt);
+			if (lua_pcall(state.L, 2, 0, 0) != LUA_OK)
+			{
+				PushError(state);
+			}
+			state.scene = nullptr;
+
+			if (nonworker)
+			{
+				nonworker_locker.unlock();
+			}
+		});
+	}
+
+	void ApplyCommands(Scene& scene)
+	{
+		for (auto& x : states)
+		{
+			JobState& state = *x;
+			for (const Command& command : state.commands)
+			{
+				TransformComponent* transform = scene.transforms.GetComponent(command.entity);
+				if (transform == nullptr)
+				{
+					continue;
+				}
+				const XMFLOAT3 value3 = XMFLOAT3(command.value.x, command.value.y, command.value.z);
+				switch (command.type)
+				{
+				case COMMAND_SET_TRANSLATION:
+					transform->translation_local = value3;
+					transform->SetDirty();
+					break;
+				case COMMAND_SET_ROTATION:
+					transform->rotation_local = command.value;
+					transform->SetDirty();
+					break;
+				case COMMAND_SET_SCALE:
+					transform->scale_local = value3;
+					transform->SetDirty();
+					break;
+				case COMMAND_TRANSLATE:
+					transform->Translate(value3);
+					break;
+				case COMMAND_ROTATE:
+					transform->Rotate(command.value);
+					break;
+				case COMMAND_SCALE:
+					transform->Scale(value3);
+					break;
+				}
+			}
+			state.commands.clear();
+
+			for (auto& error : state.errors)
+			{
+				wiBackLog::post((WILUA_ERROR_PREFIX + error).c_str());
+			}
+			if (state.dropped_errors > 0)
+			{
+				wiBackLog::post((WILUA_ERROR_PREFIX + std::to_string(state.dropped_errors) + " more job script errors").c_str());
+			}
+			state.errors.clear();
+			state.dropped_errors = 0;
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "CommonInclude.h"
+#include "wiECS.h"
+#include "wiJobSystem.h"
+
+#include <string>
+
+namespace wiScene
+{
+	struct Scene;
+}
+
+// Job scripts: per-entity Lua scripts that run in parallel on the job system
+//	Every worker thread has its own isolated lua_State, separate from wiLua::GetLuaState(), so job scripts can't share globals with the other scripts
+//	Job scripts can read the scene, but they can't modify it directly. Their changes are recorded into per-state command buffers,
+//	which are applied to the scene by ApplyCommands() after the jobs finished
+//	The job script API is documented in ScriptingAPI-Documentation.md (Job Scripts)
+namespace wiLuaJobs
+{
+	// Create the job script states, one for every worker thread and one for the main thread
+	//	It is done by the first call to the other functions too
+	void Initialize();
+
+	// Run a script in every job script state, for example to define the functions that are called by Dispatch()
+	//	It must not be called while the jobs of a Dispatch() are running
+	bool RunFile(const std::string& filename);
+	bool RunText(const std::string& script);
+
+	// Call a global function of the job scripts for every entity in parallel, as function(entity, dt)
+	//	The scene must not be modified until the jobs of the context finished, then the changes can be applied by ApplyCommands()
+	//	The entities are copied, so they don't need to outlive the call
+	void Dispatch(wiJobSystem::context& ctx, const wiScene::Scene& scene, const std::string& function, const wiECS::Entity* entities, size_t count, float dt);
+
+	// Apply the changes of the finished jobs to the scene, and post the script errors to the backlog. Call it on the main thread
+	//	The commands of an entity are applied in the order that its script recorded them
+	void ApplyCommands(wiScene::Scene& scene);
+}
@@ -1,5 +1,7 @@
 #include "wiMath.h"
 
+#include <algorithm>
+
 namespace wiMath
 {
 	float TriangleArea(const XMVECTOR& A, const XMVECTOR& B, const XMVECTOR& C)
@@ -47,6 +49,59 @@ namespace wiMath
 		return getQuadraticBezierPos(XMFLOAT3(a.x, a.y, a.z), XMFLOAT3(b.x, b.y, b.z), XMFLOAT3(c.x, c.y, c.z), t);
 	}
 	
+	void SlerpMany(const XMFLOAT4* a, const XMFLOAT4* b, const float* t, XMFLOAT4* result, size_t count, bool normalize)
+	{
+		// Same steps as XMQuaternionSlerp(), but the lanes hold x, y, z or w of four different quaternions:
+		const XMVECTOR one = XMVectorReplicate(1.0f);
+		const XMVECTOR oneMinusEpsilon = XMVectorReplicate(1.0f - 0.00001f);
+		for (size_t i = 0; i < count; i += 4)
+		{
+			const size_t batch = std::min(count - i, size_t(4));
+			XMMATRIX A = XMMatrixIdentity();
+			XMMATRIX B = XMMatrixIdentity();
+			XMFLOAT4 T = XMFLOAT4(0, 0, 0, 0);
+			for (size_t j = 0; j < batch; ++j)
+			{
+				A.r[j] = XMLoadFloat4(&a[i + j]);
+				B.r[j] = XMLoadFloat4(&b[i + j]);
+				(&T.x)[j] = t[i + j];
+			}
+			A = XMMatrixTranspose(A);
+			B = XMMatrixTranspose(B);
+			const XMVECTOR vT = XMLoadFloat4(&T);
+
+			XMVECTOR cosOmega = A.r[0] * B.r[0] + A.r[1] * B.r[1] + A.r[2] * B.r[2] + A.r[3] * B.r[3];
+			const XMVECTOR sign = XMVectorSelect(one, -one, XMVectorLess(cosOmega, XMVectorZero()));
+			cosOmega *= sign;
+			const XMVECTOR control = XMVectorLess(cosOmega, oneMinusEpsilon);
+			const XMVECTOR sinOmega = XMVectorSqrt(XMVectorNegativeMultiplySubtract(cosOmega, cosOmega, one));
+			const XMVECTOR omega = XMVectorATan2(sinOmega, cosOmega);
+			const XMVECTOR invSinOmega = XMVectorReciprocal(sinOmega);
+			const XMVECTOR t0 = one - vT;
+			const XMVECTOR s0 = XMVectorSelect(t0, XMVectorSin(t0 * omega) * invSinOmega, control);
+			const XMVECTOR s1 = XMVectorSelect(vT, XMVectorSin(vT * omega) * invSinOmega, control) * sign;
+
+			XMMATRIX R;
+			R.r[0] = A.r[0] * s0 + B.r[0] * s1;
+			R.r[1] = A.r[1] * s0 + B.r[1] * s1;
+			R.r[2] = A.r[2] * s0 + B.r[2] * s1;
+			R.r[3] = A.r[3] * s0 + B.r[3] * s1;
+			if (normalize)
+			{
+				const XMVECTOR invLength = XMVectorReciprocalSqrt(R.r[0] * R.r[0] + R.r[1] * R.r[1] + R.r[2] * R.r[2] + R.r[3] * R.r[3]);
+				R.r[0] *= invLength;
+				R.r[1] *= invLength;
+				R.r[2] *= invLength;
+				R.r[3] *= invLength;
+			}
+			R = XMMatrixTranspose(R);
+			for (size_t j = 0; j < batch; ++j)
+			{
+				XMStoreFloat4(&result[i + j], R.r[j]);
+			}
+		}
+	}
+
 	XMFLOAT3 QuaternionToRollPitchYaw(const XMFLOAT4& quaternion)
 	{
 		float roll = atan2f(2 * quaternion.x*quaternion.w - 2 * quaternion.y*quaternion.z, 1 - 2 * quaternion.x*quaternion.x - 2 * quaternion.z*quaternion.z);
@@ -111,6 +111,9 @@ namespace wiMath
 		XMStoreFloat4(&retVal, result);
 		return retVal;
 	}
+	// Spherical interpolation of many quaternions: result[i] = Slerp(a[i], b[i], t[i])
+	//	Four quaternions are interpolated at once in structure of arrays layout, the results can be optionally normalized
+	void SlerpMany(const XMFLOAT4* a, const XMFLOAT4* b, const float* t, XMFLOAT4* result, size_t count, bool normalize = false);
 	inline constexpr XMFLOAT3 Max(const XMFLOAT3& a, const XMFLOAT3& b) {
 		float x = (a.x > b.x) ? a.x : b.x;
 		float y = (a.y > b.y) ? a.y : b.y;
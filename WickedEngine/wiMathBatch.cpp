@@ -0,0 +1,201 @@
+#include "wiMathBatch.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif // __AVX__
+
+namespace wiMath
+{
+	namespace
+	{
+		// A pack is BATCH_WIDTH floats, the functions below are the only ones that depend on the instruction set:
+#if defined(__AVX__) || defined(__AVX2__)
+		typedef __m256 Pack;
+		inline Pack Load(const float* p) { return _mm256_loadu_ps(p); }
+		inline void Store(float* p, Pack v) { _mm256_storeu_ps(p, v); }
+		inline Pack Replicate(float x) { return _mm256_set1_ps(x); }
+		inline Pack Add(Pack a, Pack b) { return _mm256_add_ps(a, b); }
+		inline Pack Subtract(Pack a, Pack b) { return _mm256_sub_ps(a, b); }
+		inline Pack Multiply(Pack a, Pack b) { return _mm256_mul_ps(a, b); }
+		inline Pack Sqrt(Pack a) { return _mm256_sqrt_ps(a); }
+#else
+		typedef XMVECTOR Pack;
+		inline Pack Load(const float* p) { return XMLoadFloat4((const XMFLOAT4*)p); }
+		inline void Store(float* p, Pack v) { XMStoreFloat4((XMFLOAT4*)p, v); }
+		inline Pack Replicate(float x) { return XMVectorReplicate(x); }
+		inline Pack Add(Pack a, Pack b) { return XMVectorAdd(a, b); }
+		inline Pack Subtract(Pack a, Pack b) { return XMVectorSubtract(a, b); }
+		inline Pack Multiply(Pack a, Pack b) { return XMVectorMultiply(a, b); }
+		inline Pack Sqrt(Pack a) { return XMVectorSqrt(a); }
+#endif // __AVX__
+		inline Pack MultiplyAdd(Pack a, Pack b, Pack c) { return Add(Multiply(a, b), c); }
+
+		// The 3D vectors of one pack as a structure of arrays, the lanes after the element count are zero:
+		struct Lanes3
+		{
+			float x[BATCH_WIDTH];
+			float y[BATCH_WIDTH];
+			float z[BATCH_WIDTH];
+
+			inline void Gather(const uint8_t* base, size_t stride, size_t count)
+			{
+				for (size_t lane = 0; lane < BATCH_WIDTH; ++lane)
+				{
+					if (lane < count)
+					{
+						const XMFLOAT3& p = *(const XMFLOAT3*)(base + lane * stride);
+						x[lane] = p.x;
+						y[lane] = p.y;
+						z[lane] = p.z;
+					}
+					else
+					{
+						x[lane] = 0;
+						y[lane] = 0;
+						z[lane] = 0;
+					}
+				}
+			}
+		};
+
+		// The rows of a matrix replicated to every lane:
+		struct MatrixPack
+		{
+			Pack m[4][3];
+
+			MatrixPack(const XMFLOAT4X4& M)
+			{
+				for (int row = 0; row < 4; ++row)
+				{
+					for (int column = 0; column < 3; ++column)
+					{
+						m[row][column] = Replicate(M.m[row][column]);
+					}
+				}
+			}
+		};
+
+		template<bool squared>
+		void DistanceBatch_Internal(const XMFLOAT3* points, size_t stride, size_t count, const XMFLOAT3& origin, float* results)
+		{
+			const uint8_t* base = (const uint8_t*)points;
+			const Pack ox = Replicate(origin.x);
+			const Pack oy = Replicate(origin.y);
+			const Pack oz = Replicate(origin.z);
+			Lanes3 p;
+			float d[BATCH_WIDTH];
+			for (size_t i = 0; i < count; i += BATCH_WIDTH)
+			{
+				const size_t lanes = std::min(BATCH_WIDTH, count - i);
+				p.Gather(base + i * stride, stride, lanes);
+				const Pack dx = Subtract(Load(p.x), ox);
+				const Pack dy = Subtract(Load(p.y), oy);
+				const Pack dz = Subtract(Load(p.z), oz);
+				const Pack distanceSquared = MultiplyAdd(dx, dx, MultiplyAdd(dy, dy, Multiply(dz, dz)));
+				Store(d, squared ? distanceSquared : Sqrt(distanceSquared));
+				std::memcpy(results + i, d, sizeof(float) * lanes);
+			}
+		}
+	}
+
+	void DistanceBatch(const XMFLOAT3* points, size_t stride, size_t count, const XMFLOAT3& origin, float* results)
+	{
+		DistanceBatch_Internal<false>(points, stride, count, origin, results);
+	}
+	void DistanceSquaredBatch(const XMFLOAT3* points, size_t stride, size_t count, const XMFLOAT3& origin, float* results)
+	{
+		DistanceBatch_Internal<true>(points, stride, count, origin, results);
+	}
+
+	void TransformPointBatch(const XMFLOAT3* points, size_t count, const XMFLOAT4X4& M, XMFLOAT3* results)
+	{
+		const MatrixPack m(M);
+		Lanes3 p;
+		Lanes3 r;
+		for (size_t i = 0; i < count; i += BATCH_WIDTH)
+		{
+			const size_t lanes = std::min(BATCH_WIDTH, count - i);
+			p.Gather((const uint8_t*)(points + i), sizeof(XMFLOAT3), lanes);
+			const Pack x = Load(p.x);
+			const Pack y = Load(p.y);
+			const Pack z = Load(p.z);
+			Store(r.x, MultiplyAdd(x, m.m[0][0], MultiplyAdd(y, m.m[1][0], MultiplyAdd(z, m.m[2][0], m.m[3][0]))));
+			Store(r.y, MultiplyAdd(x, m.m[0][1], MultiplyAdd(y, m.m[1][1], MultiplyAdd(z, m.m[2][1], m.m[3][1]))));
+			Store(r.z, MultiplyAdd(x, m.m[0][2], MultiplyAdd(y, m.m[1][2], MultiplyAdd(z, m.m[2][2], m.m[3][2]))));
+			for (size_t lane = 0; lane < lanes; ++lane)
+			{
+				results[i + lane] = XMFLOAT3(r.x[lane], r.y[lane], r.z[lane]);
+			}
+		}
+	}
+
+	void TransformAABBBatch(const AABB* boxes, size_t count, const XMFLOAT4X4& M, AABB* results)
+	{
+		// The absolute values of the matrix scale the extents, so the result contains every transformed corner:
+		const MatrixPack m(M);
+		Pack a[3][3];
+		for (int row = 0; row < 3; ++row)
+		{
+			for (int column = 0; column < 3; ++column)
+			{
+				a[row][column] = Replicate(std::abs(M.m[row][column]));
+			}
+		}
+		const Pack half = Replicate(0.5f);
+		Lanes3 lo;
+		Lanes3 hi;
+		for (size_t i = 0; i < count; i += BATCH_WIDTH)
+		{
+			const size_t lanes = std::min(BATCH_WIDTH, count - i);
+			lo.Gather((const uint8_t*)&boxes[i]._min, sizeof(AABB), lanes);
+			hi.Gather((const uint8_t*)&boxes[i]._max, sizeof(AABB), lanes);
+
+			// Halved before the addition, so that the FLT_MAX boxes don't overflow:
+			const Pack min_x = Multiply(Load(lo.x), half);
+			const Pack min_y = Multiply(Load(lo.y), half);
+			const Pack min_z = Multiply(Load(lo.z), half);
+			const Pack max_x = Multiply(Load(hi.x), half);
+			const Pack max_y = Multiply(Load(hi.y), half);
+			const Pack max_z = Multiply(Load(hi.z), half);
+			const Pack cx = Add(min_x, max_x);
+			const Pack cy = Add(min_y, max_y);
+			const Pack cz = Add(min_z, max_z);
+			const Pack ex = Subtract(max_x, min_x);
+			const Pack ey = Subtract(max_y, min_y);
+			const Pack ez = Subtract(max_z, min_z);
+
+			for (int column = 0; column < 3; ++column)
+			{
+				const Pack center = MultiplyAdd(cx, m.m[0][column], MultiplyAdd(cy, m.m[1][column], MultiplyAdd(cz, m.m[2][column], m.m[3][column])));
+				const Pack extent = MultiplyAdd(ex, a[0][column], MultiplyAdd(ey, a[1][column], Multiply(ez, a[2][column])));
+				float* dst_lo = column == 0 ? lo.x : column == 1 ? lo.y : lo.z;
+				float* dst_hi = column == 0 ? hi.x : column == 1 ? hi.y : hi.z;
+				Store(dst_lo, Subtract(center, extent));
+				Store(dst_hi, Add(center, extent));
+			}
+			for (size_t lane = 0; lane < lanes; ++lane)
+			{
+				results[i + lane] = AABB(XMFLOAT3(lo.x[lane], lo.y[lane], lo.z[lane]), XMFLOAT3(hi.x[lane], hi.y[lane], hi.z[lane]));
+			}
+		}
+	}
+	void TransformAABBBatch(const AABB* boxes, const XMFLOAT4X4* matrices, size_t count, AABB* results)
+	{
+		// Every box has its own matrix, so the lanes are the x, y, z of one box:
+		for (size_t i = 0; i < count; ++i)
+		{
+			results[i] = boxes[i].transform(XMLoadFloat4x4(&matrices[i]));
+		}
+	}
+
+	void MultiplyBatch(const XMFLOAT4X4* A, const XMFLOAT4X4* B, size_t count, XMFLOAT4X4* results)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			XMStoreFloat4x4(&results[i], XMMatrixMultiply(XMLoadFloat4x4(&A[i]), XMLoadFloat4x4(&B[i])));
+		}
+	}
+}
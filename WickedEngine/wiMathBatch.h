@@ -0,0 +1,32 @@
+#pragma once
+#include "CommonInclude.h"
+#include "wiIntersect.h"
+
+// Batched versions of the wiMath and AABB helpers for the loops that process many elements
+//	The elements are loaded into packs of BATCH_WIDTH lanes (a structure of arrays), so that the math is done for all lanes with the same instructions
+//	The inputs of the distance functions are strided, so that they can be read in place from an array of components
+namespace wiMath
+{
+#if defined(__AVX__) || defined(__AVX2__)
+	static constexpr size_t BATCH_WIDTH = 8;
+#else
+	static constexpr size_t BATCH_WIDTH = 4; // DirectXMath vectors (SSE or NEON)
+#endif // __AVX__
+
+	// results[i] = Distance(points[i], origin), stride is the byte offset between two points (eg. sizeof(LightComponent) for &lights[0].position)
+	void DistanceBatch(const XMFLOAT3* points, size_t stride, size_t count, const XMFLOAT3& origin, float* results);
+	// results[i] = DistanceSquared(points[i], origin), stride is the byte offset between two points
+	void DistanceSquaredBatch(const XMFLOAT3* points, size_t stride, size_t count, const XMFLOAT3& origin, float* results);
+
+	// results[i] = XMVector3Transform(points[i], M), the results can be the same array as the points
+	void TransformPointBatch(const XMFLOAT3* points, size_t count, const XMFLOAT4X4& M, XMFLOAT3* results);
+
+	// results[i] = boxes[i].transform(M), the results can be the same array as the boxes
+	//	The box is transformed with its center and extents instead of its 8 corners, the result is the same
+	void TransformAABBBatch(const AABB* boxes, size_t count, const XMFLOAT4X4& M, AABB* results);
+	// results[i] = boxes[i].transform(matrices[i]), the results can be the same array as the boxes
+	void TransformAABBBatch(const AABB* boxes, const XMFLOAT4X4* matrices, size_t count, AABB* results);
+
+	// results[i] = A[i] * B[i], the results can be the same array as A or B
+	void MultiplyBatch(const XMFLOAT4X4* A, const XMFLOAT4X4* B, size_t count, XMFLOAT4X4* results);
+}
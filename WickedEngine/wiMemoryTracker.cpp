@@ -0,0 +1,126 @@
+#include "wiMemoryTracker.h"
+
+#include <atomic>
+#include <cassert>
+#include <mutex>
+#include <sstream>
+
+namespace wiMemoryTracker
+{
+	// The counters are constant initialized, so allocations can be counted by the static initializers of other files (for example the Bullet allocator)
+	struct TagState
+	{
+		std::atomic<uint64_t> bytes{ 0 };
+		std::atomic<uint64_t> peak{ 0 };
+		std::atomic<uint32_t> count{ 0 };
+	};
+	TagState tags[TAG_COUNT];
+	std::function<size_t()> measures[TAG_COUNT];
+	std::mutex measure_locker;
+
+	const char* GetTagName(TAG tag)
+	{
+		switch (tag)
+		{
+		case TAG_ECS:
+			return "ECS";
+		case TAG_MESH_DATA:
+			return "Mesh Data";
+		case TAG_RESOURCE_FILEDATA:
+			return "Resource File Data";
+		case TAG_LUA:
+			return "Lua";
+		case TAG_PHYSICS:
+			return "Physics";
+		case TAG_AUDIO:
+			return "Audio";
+		case TAG_GPU_BUFFER:
+			return "GPU Buffers";
+		case TAG_GPU_TEXTURE:
+			return "GPU Textures";
+		case TAG_GPU_RENDERTARGET:
+			return "GPU Render Targets";
+		case TAG_GPU_ACCELERATION_STRUCTURE:
+			return "GPU Acceleration Structures";
+		default:
+			break;
+		}
+		return "";
+	}
+	bool IsGPUTag(TAG tag)
+	{
+		return tag >= TAG_GPU_BUFFER && tag < TAG_COUNT;
+	}
+
+	inline void UpdatePeak(TagState& state, uint64_t bytes)
+	{
+		uint64_t peak = state.peak.load(std::memory_order_relaxed);
+		while (bytes > peak && !state.peak.compare_exchange_weak(peak, bytes, std::memory_order_relaxed));
+	}
+
+	void Allocate(TAG tag, size_t size)
+	{
+		assert(tag < TAG_COUNT);
+		TagState& state = tags[tag];
+		const uint64_t bytes = state.bytes.fetch_add(size, std::memory_order_relaxed) + size;
+		state.count.fetch_add(1, std::memory_order_relaxed);
+		UpdatePeak(state, bytes);
+	}
+	void Free(TAG tag, size_t size)
+	{
+		assert(tag < TAG_COUNT);
+		TagState& state = tags[tag];
+		state.bytes.fetch_sub(size, std::memory_order_relaxed);
+		state.count.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	void SetMeasurement(TAG tag, std::function<size_t()> measure)
+	{
+		assert(tag < TAG_COUNT);
+		std::lock_guard<std::mutex> lock(measure_locker);
+		measures[tag] = std::move(measure);
+	}
+
+	Statistics GetStatistics(TAG tag)
+	{
+		assert(tag < TAG_COUNT);
+		TagState& state = tags[tag];
+		Statistics stats;
+		{
+			std::lock_guard<std::mutex> lock(measure_locker);
+			if (measures[tag])
+			{
+				const uint64_t bytes = (uint64_t)measures[tag]();
+				state.bytes.store(bytes, std::memory_order_relaxed);
+				UpdatePeak(state, bytes);
+				state.count.store(0, std::memory_order_relaxed);
+			}
+		}
+		stats.bytes = state.bytes.load(std::memory_order_relaxed);
+		stats.peak = state.peak.load(std::memory_order_relaxed);
+		stats.count = state.count.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	std::string GetReport()
+	{
+		std::stringstream ss;
+		ss.precision(2);
+		uint64_t total_cpu = 0;
+		uint64_t total_gpu = 0;
+		for (int i = 0; i < TAG_COUNT; ++i)
+		{
+			const TAG tag = (TAG)i;
+			const Statistics stats = GetStatistics(tag);
+			(IsGPUTag(tag) ? total_gpu : total_cpu) += stats.bytes;
+			ss << GetTagName(tag) << ": " << std::fixed << stats.bytes / 1024.0 / 1024.0 << " MB (peak " << stats.peak / 1024.0 / 1024.0 << " MB";
+			if (stats.count > 0)
+			{
+				ss << ", " << stats.count << " allocations";
+			}
+			ss << ")" << std::endl;
+		}
+		ss << "Tracked CPU Memory: " << std::fixed << total_cpu / 1024.0 / 1024.0 << " MB, GPU Memory: " << total_gpu / 1024.0 / 1024.0 << " MB" << std::endl;
+		return ss.str();
+	}
+}
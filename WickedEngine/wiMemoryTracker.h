@@ -0,0 +1,76 @@
+#pragma once
+#include "CommonInclude.h"
+
+#include <functional>
+#include <string>
+
+// Memory accounting of the engine subsystems
+//	Counted tags are updated where the memory is allocated and freed (Allocate() and Free(), or a ScopedAllocation member of the owner)
+//	Measured tags are queried from their owner by a callback whenever the statistics are read
+namespace wiMemoryTracker
+{
+	enum TAG
+	{
+		TAG_ECS,						// component containers of the scene (measured)
+		TAG_MESH_DATA,					// CPU side vertex, index and BVH data of the scene meshes (measured)
+		TAG_RESOURCE_FILEDATA,			// file data retained by the resource manager (measured)
+		TAG_LUA,						// Lua heap (measured)
+		TAG_PHYSICS,					// Bullet allocations
+		TAG_AUDIO,						// decoded sound data
+		TAG_GPU_BUFFER,					// video memory of buffers
+		TAG_GPU_TEXTURE,				// video memory of textures that are not render targets
+		TAG_GPU_RENDERTARGET,			// video memory of render target and depth stencil textures
+		TAG_GPU_ACCELERATION_STRUCTURE,	// video memory of raytracing acceleration structures
+		TAG_COUNT
+	};
+	const char* GetTagName(TAG tag);
+	bool IsGPUTag(TAG tag);
+
+	// Count an allocation of a counted tag, it is thread safe
+	void Allocate(TAG tag, size_t size);
+	// Count the release of an allocation that was counted by Allocate()
+	void Free(TAG tag, size_t size);
+
+	// Make a tag measured, the callback returns its current size in bytes. It is called on the thread that reads the statistics
+	void SetMeasurement(TAG tag, std::function<size_t()> measure);
+
+	struct Statistics
+	{
+		uint64_t bytes = 0;
+		uint64_t peak = 0; // high-water mark of bytes (measured tags only have the peak of their measurements)
+		uint32_t count = 0; // count of live allocations, 0 for measured tags
+	};
+	Statistics GetStatistics(TAG tag);
+
+	// Every tag in a line of text
+	std::string GetReport();
+
+	// Counts a size under a tag for as long as it is alive, for the objects that own a tracked allocation (for example a GPU resource internal state)
+	struct ScopedAllocation
+	{
+		TAG tag = TAG_COUNT;
+		size_t size = 0;
+
+		ScopedAllocation() = default;
+		ScopedAllocation(const ScopedAllocation&) = delete;
+		ScopedAllocation& operator=(const ScopedAllocation&) = delete;
+		~ScopedAllocation() { Reset(); }
+
+		inline void Set(TAG newtag, size_t newsize)
+		{
+			Reset();
+			tag = newtag;
+			size = newsize;
+			Allocate(tag, size);
+		}
+		inline void Reset()
+		{
+			if (tag != TAG_COUNT)
+			{
+				Free(tag, size);
+				tag = TAG_COUNT;
+				size = 0;
+			}
+		}
+	};
+}
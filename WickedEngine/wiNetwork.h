@@ -51,4 +51,46 @@ namespace wiNetwork
 	//	data		:	buffer to hold received data, must be already allocated to a sufficient size
 	//	dataSize	:	expected data size in bytes
 	bool Receive(const Socket* sock, Connection* connection, void* data, size_t dataSize);
+
+
+	// High throughput mode for servers with many clients:
+	//	A background I/O thread receives the packets of the socket into a queue of preallocated packets, which the game thread reads without locking
+	//	Batched system calls are used where the platform has them (recvmmsg and sendmmsg on Linux)
+
+	static const size_t MAX_PACKET_SIZE = 1472; // biggest UDP payload that is not fragmented on Ethernet, bigger packets are truncated by the receive thread
+	struct Packet
+	{
+		Connection connection; // sender
+		uint32_t size = 0;
+		uint8_t data[MAX_PACKET_SIZE];
+	};
+
+	// Starts receiving the packets of the socket on a background thread. The socket must be listening to a port already (see ListenPort())
+	//	After this, the packets are read with PeekPacket() and PopPacket() instead of CanReceive() and Receive()
+	//	sock		:	socket that receives packets
+	//	capacity	:	count of preallocated packets in the queue. The packets that arrive while the queue is full are dropped
+	bool StartReceiveThread(const Socket* sock, uint32_t capacity = 1024);
+
+	// Returns the oldest received packet, or nullptr if the queue is empty. The packet is valid until PopPacket() is called
+	//	It must be called by only one thread
+	const Packet* PeekPacket(const Socket* sock);
+
+	// Removes the oldest received packet, so its memory can receive a new one
+	void PopPacket(const Socket* sock);
+
+	// Returns the count of packets that were dropped because the receive queue was full
+	uint64_t GetDroppedPacketCount(const Socket* sock);
+
+	struct Message
+	{
+		Connection connection; // receiver
+		const void* data = nullptr;
+		size_t dataSize = 0;
+	};
+	// Sends many data packets with as few system calls as possible
+	//	sock		:	socket that sends the packets
+	//	messages	:	array of the messages to send
+	//	count		:	count of messages in the array
+	//	returns the count of messages that were sent
+	uint32_t SendBatch(const Socket* sock, const Message* messages, uint32_t count);
 }
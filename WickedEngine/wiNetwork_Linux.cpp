@@ -3,43 +3,350 @@
 #ifdef PLATFORM_LINUX
 #include "wiNetwork.h"
 #include "wiBackLog.h"
+#include "wiContainers.h"
+
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 namespace wiNetwork
 {
+	static const unsigned int BATCH_SIZE = 64; // packets per recvmmsg and sendmmsg call
+
+	struct SocketInternal
+	{
+		int handle = -1;
+
+		wiContainers::SingleProducerRingBuffer<Packet> queue;
+		std::atomic<uint64_t> dropped{ 0 };
+		std::atomic_bool exit{ false };
+		std::thread thread;
+
+		~SocketInternal()
+		{
+			if (thread.joinable())
+			{
+				exit.store(true);
+				thread.join();
+			}
+			if (handle >= 0)
+			{
+				int result = close(handle);
+				if (result < 0)
+				{
+					int error = errno;
+					assert(0 && error);
+				}
+			}
+		}
+	};
+	SocketInternal* to_internal(const Socket* param)
+	{
+		return static_cast<SocketInternal*>(param->internal_state.get());
+	}
+
+	void PostError(const char* function)
+	{
+		std::stringstream ss;
+		ss << "wiNetwork error in " << function << ": " << strerror(errno);
+		wiBackLog::post(ss.str().c_str());
+	}
+	sockaddr_in ToAddress(const Connection& connection)
+	{
+		sockaddr_in target = {};
+		target.sin_family = AF_INET;
+		target.sin_port = htons(connection.port); // reverse byte order from host to network
+		memcpy(&target.sin_addr.s_addr, connection.ipaddress.data(), sizeof(target.sin_addr.s_addr)); // the address bytes are in network order
+		return target;
+	}
+	void FromAddress(const sockaddr_in& sender, Connection& connection)
+	{
+		connection.port = ntohs(sender.sin_port); // reverse byte order from network to host
+		memcpy(connection.ipaddress.data(), &sender.sin_addr.s_addr, sizeof(sender.sin_addr.s_addr));
+	}
+
 	void Initialize()
 	{
-		wiBackLog::post("TODO wiNetwork_Linux");
+		wiBackLog::post("wiNetwork Initialized");
 	}
 
 	bool CreateSocket(Socket* sock)
 	{
-		return false;
+		std::shared_ptr<SocketInternal> socketinternal = std::make_shared<SocketInternal>();
+		sock->internal_state = socketinternal;
+
+		socketinternal->handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		if (socketinternal->handle < 0)
+		{
+			PostError("CreateSocket");
+			return false;
+		}
+
+		return true;
 	}
 	bool Destroy(Socket* sock)
 	{
+		if (sock != nullptr && sock->IsValid())
+		{
+			sock->internal_state.reset();
+			return true;
+		}
 		return false;
 	}
 
 	bool Send(const Socket* sock, const Connection* connection, const void* data, size_t dataSize)
 	{
+		if (sock != nullptr && sock->IsValid())
+		{
+			sockaddr_in target = ToAddress(*connection);
+
+			auto socketinternal = to_internal(sock);
+
+			ssize_t result = sendto(socketinternal->handle, data, dataSize, 0, (const sockaddr*)&target, sizeof(target));
+			if (result < 0)
+			{
+				PostError("Send");
+				return false;
+			}
+
+			return true;
+		}
 		return false;
 	}
 
 	bool ListenPort(const Socket* sock, uint16_t port)
 	{
+		if (sock != nullptr && sock->IsValid())
+		{
+			sockaddr_in target = {};
+			target.sin_family = AF_INET;
+			target.sin_port = htons(port);
+			target.sin_addr.s_addr = htonl(INADDR_ANY);
+
+			auto socketinternal = to_internal(sock);
+
+			int result = bind(socketinternal->handle, (const sockaddr*)&target, sizeof(target));
+			if (result < 0)
+			{
+				PostError("ListenPort");
+				return false;
+			}
+
+			return true;
+		}
 		return false;
 	}
 
 	bool CanReceive(const Socket* sock, long timeout_microseconds)
 	{
+		if (sock != nullptr && sock->IsValid())
+		{
+			auto socketinternal = to_internal(sock);
+
+			fd_set readfds;
+			FD_ZERO(&readfds);
+			FD_SET(socketinternal->handle, &readfds);
+			timeval timeout;
+			timeout.tv_sec = timeout_microseconds / 1000000;
+			timeout.tv_usec = timeout_microseconds % 1000000;
+			int result = select(socketinternal->handle + 1, &readfds, NULL, NULL, &timeout);
+			if (result < 0)
+			{
+				PostError("CanReceive");
+				assert(0);
+				return false;
+			}
+
+			return FD_ISSET(socketinternal->handle, &readfds);
+		}
 		return false;
 	}
 
 	bool Receive(const Socket* sock, Connection* connection, void* data, size_t dataSize)
 	{
+		if (sock != nullptr && sock->IsValid())
+		{
+			auto socketinternal = to_internal(sock);
+
+			sockaddr_in sender;
+			socklen_t targetsize = sizeof(sender);
+			ssize_t result = recvfrom(socketinternal->handle, data, dataSize, 0, (sockaddr*)&sender, &targetsize);
+			if (result < 0)
+			{
+				PostError("Receive");
+				return false;
+			}
+
+			FromAddress(sender, *connection);
+
+			return true;
+		}
+		return false;
+	}
+
+	void ReceiveThread(SocketInternal* socketinternal)
+	{
+		std::vector<mmsghdr> headers(BATCH_SIZE);
+		std::vector<iovec> buffers(BATCH_SIZE);
+		std::vector<sockaddr_in> senders(BATCH_SIZE);
+		Packet overflow; // receives the packets that don't fit into the queue, so they can be dropped
+
+		while (!socketinternal->exit.load())
+		{
+			// The wait has a timeout, so that the thread notices when the socket is destroyed:
+			pollfd fd = {};
+			fd.fd = socketinternal->handle;
+			fd.events = POLLIN;
+			int result = poll(&fd, 1, 100);
+			if (result <= 0)
+			{
+				if (result < 0 && errno != EINTR)
+				{
+					PostError("ReceiveThread");
+					return;
+				}
+				continue;
+			}
+
+			// Receive every queued packet directly into the free packets of the queue, BATCH_SIZE at a time:
+			while (true)
+			{
+				const size_t writable = socketinternal->queue.writable();
+				const unsigned int count = writable > 0 ? (unsigned int)std::min(writable, (size_t)BATCH_SIZE) : 1;
+				for (unsigned int i = 0; i < count; ++i)
+				{
+					Packet& packet = writable > 0 ? socketinternal->queue.write_item(i) : overflow;
+					buffers[i].iov_base = packet.data;
+					buffers[i].iov_len = sizeof(packet.data);
+					headers[i] = {};
+					headers[i].msg_hdr.msg_name = &senders[i];
+					headers[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+					headers[i].msg_hdr.msg_iov = &buffers[i];
+					headers[i].msg_hdr.msg_iovlen = 1;
+				}
+
+				int received = recvmmsg(socketinternal->handle, headers.data(), count, MSG_DONTWAIT, nullptr);
+				if (received <= 0)
+				{
+					if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+					{
+						PostError("ReceiveThread");
+					}
+					break;
+				}
+				if (writable == 0)
+				{
+					socketinternal->dropped.fetch_add((uint64_t)received);
+					continue;
+				}
+				for (int i = 0; i < received; ++i)
+				{
+					Packet& packet = socketinternal->queue.write_item(i);
+					packet.size = headers[i].msg_len;
+					FromAddress(senders[i], packet.connection);
+				}
+				socketinternal->queue.push((size_t)received);
+			}
+		}
+	}
+
+	bool StartReceiveThread(const Socket* sock, uint32_t capacity)
+	{
+		if (sock != nullptr && sock->IsValid())
+		{
+			auto socketinternal = to_internal(sock);
+			if (socketinternal->thread.joinable())
+			{
+				return true;
+			}
+			socketinternal->queue.init(capacity);
+			socketinternal->thread = std::thread(ReceiveThread, socketinternal);
+			return true;
+		}
 		return false;
 	}
 
+	const Packet* PeekPacket(const Socket* sock)
+	{
+		if (sock != nullptr && sock->IsValid())
+		{
+			return to_internal(sock)->queue.front();
+		}
+		return nullptr;
+	}
+
+	void PopPacket(const Socket* sock)
+	{
+		if (sock != nullptr && sock->IsValid())
+		{
+			to_internal(sock)->queue.pop_front();
+		}
+	}
+
+	uint64_t GetDroppedPacketCount(const Socket* sock)
+	{
+		if (sock != nullptr && sock->IsValid())
+		{
+			return to_internal(sock)->dropped.load();
+		}
+		return 0;
+	}
+
+	uint32_t SendBatch(const Socket* sock, const Message* messages, uint32_t count)
+	{
+		if (sock != nullptr && sock->IsValid())
+		{
+			auto socketinternal = to_internal(sock);
+
+			mmsghdr headers[BATCH_SIZE];
+			iovec buffers[BATCH_SIZE];
+			sockaddr_in targets[BATCH_SIZE];
+
+			uint32_t sent = 0;
+			while (sent < count)
+			{
+				const unsigned int batch = std::min(count - sent, BATCH_SIZE);
+				for (unsigned int i = 0; i < batch; ++i)
+				{
+					const Message& message = messages[sent + i];
+					targets[i] = ToAddress(message.connection);
+					buffers[i].iov_base = const_cast<void*>(message.data);
+					buffers[i].iov_len = message.dataSize;
+					headers[i] = {};
+					headers[i].msg_hdr.msg_name = &targets[i];
+					headers[i].msg_hdr.msg_namelen = sizeof(targets[i]);
+					headers[i].msg_hdr.msg_iov = &buffers[i];
+					headers[i].msg_hdr.msg_iovlen = 1;
+				}
+
+				int result = sendmmsg(socketinternal->handle, headers, batch, 0);
+				if (result < 0)
+				{
+					if (errno == EINTR)
+						continue;
+					PostError("SendBatch");
+					break;
+				}
+				if (result == 0)
+					break;
+				sent += (uint32_t)result;
+			}
+			return sent;
+		}
+		return 0;
+	}
+
 }
 
 #endif // LINUX
@@ -40,6 +40,30 @@ namespace wiNetwork
 		return false;
 	}
 
+	bool StartReceiveThread(const Socket* sock, uint32_t capacity)
+	{
+		return false;
+	}
+
+	const Packet* PeekPacket(const Socket* sock)
+	{
+		return nullptr;
+	}
+
+	void PopPacket(const Socket* sock)
+	{
+	}
+
+	uint64_t GetDroppedPacketCount(const Socket* sock)
+	{
+		return 0;
+	}
+
+	uint32_t SendBatch(const Socket* sock, const Message* messages, uint32_t count)
+	{
+		return 0;
+	}
+
 }
 
 #endif // _WIN32 && PLATFORM_UWP
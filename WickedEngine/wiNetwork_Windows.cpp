@@ -3,8 +3,11 @@
 #if defined(_WIN32) && !defined(PLATFORM_UWP)
 #include "wiNetwork.h"
 #include "wiBackLog.h"
+#include "wiContainers.h"
 
 #include <sstream>
+#include <atomic>
+#include <thread>
 
 #include <winsock.h>
 #pragma comment(lib,"ws2_32.lib")
@@ -27,8 +30,18 @@ namespace wiNetwork
 		std::shared_ptr<wiNetworkInternal> networkinternal;
 		SOCKET handle = NULL;
 
+		wiContainers::SingleProducerRingBuffer<Packet> queue;
+		std::atomic<uint64_t> dropped{ 0 };
+		std::atomic_bool exit{ false };
+		std::thread thread;
+
 		~SocketInternal()
 		{
+			if (thread.joinable())
+			{
+				exit.store(true);
+				thread.join();
+			}
 			int result = closesocket(handle);
 			if (result == SOCKET_ERROR)
 			{
@@ -79,6 +92,15 @@ namespace wiNetwork
 
 		return true;
 	}
+	bool Destroy(Socket* sock)
+	{
+		if (sock != nullptr && sock->IsValid())
+		{
+			sock->internal_state.reset();
+			return true;
+		}
+		return false;
+	}
 
 	bool Send(const Socket* sock, const Connection* connection, const void* data, size_t dataSize)
 	{
@@ -191,6 +213,125 @@ namespace wiNetwork
 		return false;
 	}
 
+	void ReceiveThread(SocketInternal* socketinternal)
+	{
+		Packet overflow; // receives the packets that don't fit into the queue, so they can be dropped
+
+		while (!socketinternal->exit.load())
+		{
+			// The wait has a timeout, so that the thread notices when the socket is destroyed:
+			fd_set readfds;
+			FD_ZERO(&readfds);
+			FD_SET(socketinternal->handle, &readfds);
+			timeval timeout;
+			timeout.tv_sec = 0;
+			timeout.tv_usec = 100000;
+			int result = select(0, &readfds, NULL, NULL, &timeout);
+			if (result == SOCKET_ERROR)
+			{
+				std::stringstream ss;
+				ss << "wiNetwork error in ReceiveThread: " << WSAGetLastError();
+				wiBackLog::post(ss.str().c_str());
+				return;
+			}
+			if (result == 0)
+			{
+				continue;
+			}
+
+			// Receive every queued packet directly into the free packets of the queue, the pushes are made visible to the game thread together:
+			size_t received = 0;
+			size_t writable = socketinternal->queue.writable();
+			do
+			{
+				Packet& packet = received < writable ? socketinternal->queue.write_item(received) : overflow;
+				sockaddr_in sender;
+				int targetsize = sizeof(sender);
+				result = recvfrom(socketinternal->handle, (char*)packet.data, (int)sizeof(packet.data), 0, (sockaddr*)&sender, &targetsize);
+				if (result == SOCKET_ERROR && WSAGetLastError() != WSAEMSGSIZE) // bigger packets are truncated
+				{
+					break;
+				}
+				if (received < writable)
+				{
+					packet.size = result == SOCKET_ERROR ? (uint32_t)sizeof(packet.data) : (uint32_t)result;
+					packet.connection.port = htons(sender.sin_port); // reverse byte order from network to host
+					packet.connection.ipaddress[0] = sender.sin_addr.S_un.S_un_b.s_b1;
+					packet.connection.ipaddress[1] = sender.sin_addr.S_un.S_un_b.s_b2;
+					packet.connection.ipaddress[2] = sender.sin_addr.S_un.S_un_b.s_b3;
+					packet.connection.ipaddress[3] = sender.sin_addr.S_un.S_un_b.s_b4;
+					received++;
+				}
+				else
+				{
+					socketinternal->dropped.fetch_add(1);
+				}
+
+				FD_ZERO(&readfds);
+				FD_SET(socketinternal->handle, &readfds);
+				timeout.tv_usec = 0;
+			} while (select(0, &readfds, NULL, NULL, &timeout) > 0);
+			socketinternal->queue.push(received);
+		}
+	}
+
+	bool StartReceiveThread(const Socket* sock, uint32_t capacity)
+	{
+		if (sock != nullptr && sock->IsValid())
+		{
+			auto socketinternal = to_internal(sock);
+			if (socketinternal->thread.joinable())
+			{
+				return true;
+			}
+			socketinternal->queue.init(capacity);
+			socketinternal->thread = std::thread(ReceiveThread, socketinternal);
+			return true;
+		}
+		return false;
+	}
+
+	const Packet* PeekPacket(const Socket* sock)
+	{
+		if (sock != nullptr && sock->IsValid())
+		{
+			return to_internal(sock)->queue.front();
+		}
+		return nullptr;
+	}
+
+	void PopPacket(const Socket* sock)
+	{
+		if (sock != nullptr && sock->IsValid())
+		{
+			to_internal(sock)->queue.pop_front();
+		}
+	}
+
+	uint64_t GetDroppedPacketCount(const Socket* sock)
+	{
+		if (sock != nullptr && sock->IsValid())
+		{
+			return to_internal(sock)->dropped.load();
+		}
+		return 0;
+	}
+
+	uint32_t SendBatch(const Socket* sock, const Message* messages, uint32_t count)
+	{
+		// Winsock has no batched send for this kind of socket, the messages are sent one by one
+		uint32_t sent = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (!Send(sock, &messages[i].connection, messages[i].data, messages[i].dataSize))
+			{
+				break;
+			}
+			sent++;
+		}
+		return sent;
+	}
+
 }
 
 #endif // _WIN32 && !PLATFORM_UWP
@@ -5,6 +5,7 @@
 #include "wiScene.h"
 #include "wiBackLog.h"
 #include "wiEvent.h"
+#include "wiMath.h"
 
 #include <algorithm>
 #include <vector>
@@ -271,9 +272,81 @@ void wiOcean::initHeightMap(const OceanParameters& params, XMFLOAT2* out_h0, flo
 	}
 }
 
+wiOcean::Coverage wiOcean::ComputeCoverage(const CameraComponent& camera, const OceanParameters& params)
+{
+	static constexpr int GRID = 16;
+	static constexpr float CELL = 2.0f / (GRID - 1);
+
+	const XMMATRIX InvVP = camera.GetInvViewProjection();
+	const XMVECTOR O = camera.GetEye();
+	const float height = params.waterHeight - camera.Eye.y;
+
+	Coverage coverage;
+	XMFLOAT2 hit_min = XMFLOAT2(FLT_MAX, FLT_MAX);
+	XMFLOAT2 hit_max = XMFLOAT2(-FLT_MAX, -FLT_MAX);
+	uint32_t hits = 0;
+	for (int y = 0; y < GRID; ++y)
+	{
+		for (int x = 0; x < GRID; ++x)
+		{
+			const XMFLOAT2 clip = XMFLOAT2(-1 + x * CELL, -1 + y * CELL);
+
+			// Z = 1 is the near plane with the reversed depth:
+			const XMVECTOR D = XMVector3Normalize(XMVector3TransformCoord(XMVectorSet(clip.x, clip.y, 1, 1), InvVP) - O);
+			const float dir = XMVectorGetY(D);
+			if (std::abs(dir) < 1e-6f)
+			{
+				continue;
+			}
+			const float dist = height / dir;
+			if (dist < 0 || dist > camera.zFarP)
+			{
+				continue;
+			}
+
+			hits++;
+			hit_min.x = std::min(hit_min.x, clip.x);
+			hit_min.y = std::min(hit_min.y, clip.y);
+			hit_max.x = std::max(hit_max.x, clip.x);
+			hit_max.y = std::max(hit_max.y, clip.y);
+		}
+	}
+	if (hits == 0)
+	{
+		return coverage;
+	}
+	coverage.amount = (float)hits / (float)(GRID * GRID);
+
+	// The ocean can continue until the next sample, and the displacement can pull the surface in from beyond the screen edges:
+	const float tolerance = std::max(1.0f, params.surfaceDisplacementTolerance);
+	coverage.rect.x = hit_min.x <= -1 ? -tolerance : std::max(-1.0f, hit_min.x - CELL);
+	coverage.rect.y = hit_min.y <= -1 ? -tolerance : std::max(-1.0f, hit_min.y - CELL);
+	coverage.rect.z = hit_max.x >= 1 ? tolerance : std::min(1.0f, hit_max.x + CELL);
+	coverage.rect.w = hit_max.y >= 1 ? tolerance : std::min(1.0f, hit_max.y + CELL);
+	return coverage;
+}
+
+void wiOcean::UpdateDisplacementMap(const OceanParameters& params, const Coverage& coverage, CommandList cmd) const
+{
+	if (!coverage.IsVisible())
+	{
+		return;
+	}
+
+	const uint64_t frame = wiRenderer::GetDevice()->GetFrameCount();
+	const float rate = wiMath::Clamp(coverage.amount / FULL_RATE_COVERAGE, 0, 1);
+	const uint64_t interval = (uint64_t)std::round(wiMath::Lerp((float)MAX_UPDATE_INTERVAL, 1.0f, rate));
+	if (updateFrame <= frame && frame - updateFrame < interval)
+	{
+		return;
+	}
+
+	UpdateDisplacementMap(params, cmd);
+}
 void wiOcean::UpdateDisplacementMap(const OceanParameters& params, CommandList cmd) const
 {
 	GraphicsDevice* device = wiRenderer::GetDevice();
+	updateFrame = device->GetFrameCount();
 
 	device->EventBegin("Ocean Simulation", cmd);
 
@@ -354,6 +427,12 @@ void wiOcean::UpdateDisplacementMap(const OceanParameters& params, CommandList c
 
 void wiOcean::Render(const CameraComponent& camera, const OceanParameters& params, CommandList cmd) const
 {
+	const Coverage coverage = ComputeCoverage(camera, params);
+	if (!coverage.IsVisible())
+	{
+		return;
+	}
+
 	GraphicsDevice* device = wiRenderer::GetDevice();
 
 	device->EventBegin("Ocean Rendering", cmd);
@@ -370,19 +449,24 @@ void wiOcean::Render(const CameraComponent& camera, const OceanParameters& param
 	}
 
 
-	const uint2 dim = uint2(160 * params.surfaceDetail, 90 * params.surfaceDetail);
+	// The grid cells are as large as if the grid covered the whole extruded screen, but only the coverage rectangle is drawn:
+	const float tolerance = std::max(1.0f, params.surfaceDisplacementTolerance);
+	const uint2 dim = uint2(
+		std::max(1u, (uint32_t)std::ceil(160 * params.surfaceDetail * (coverage.rect.z - coverage.rect.x) / (2 * tolerance))),
+		std::max(1u, (uint32_t)std::ceil(90 * params.surfaceDetail * (coverage.rect.w - coverage.rect.y) / (2 * tolerance)))
+	);
 
 	Ocean_RenderCB cb;
 	cb.xOceanWaterColor = XMFLOAT3( params.waterColor.x, params.waterColor.y, params.waterColor.z );
 	cb.xOceanTexelLength = params.patch_length / params.dmap_dim;
 	cb.xOceanScreenSpaceParams = XMFLOAT4((float)dim.x, (float)dim.y, 1.0f / (float)dim.x, 1.0f / (float)dim.y);
+	cb.xOceanScreenRect = coverage.rect;
 	cb.xOceanPatchSizeRecip = 1.0f / params.patch_length;
 	cb.xOceanMapHalfTexel = 0.5f / params.dmap_dim;
 	cb.xOceanWaterHeight = params.waterHeight;
 	cb.xOceanFogMin = params.fogMinDist;
 	cb.xOceanFogMax = params.fogMaxDist;
 	cb.xOceanFogMinAmount = params.fogMinAmount;
-	cb.xOceanSurfaceDisplacementTolerance = std::max(1.0f, params.surfaceDisplacementTolerance);
 
 	device->UpdateBuffer(&shadingCB, &cb, cmd);
 
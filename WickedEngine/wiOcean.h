@@ -42,7 +42,24 @@ public:
 	};
 	void Create(const OceanParameters& params);
 
+	// The part of the screen that the ocean can cover, from the rays of a coarse screen grid against the water plane (occlusion is not considered)
+	struct Coverage
+	{
+		float amount = 0; // fraction of the screen [0,1]
+		XMFLOAT4 rect = XMFLOAT4(0, 0, 0, 0); // bounds of the projected grid in clip space (min.xy, max.xy), extruded by the surfaceDisplacementTolerance at the screen edges
+
+		inline bool IsVisible() const { return amount > 0; }
+	};
+	static Coverage ComputeCoverage(const wiScene::CameraComponent& camera, const OceanParameters& params);
+
+	// The displacement map is updated every frame when the ocean covers much of the screen, otherwise the update rate is reduced down to every MAX_UPDATE_INTERVAL frames
+	//	Nothing is updated when the ocean is not visible
+	static constexpr float FULL_RATE_COVERAGE = 0.25f;
+	static constexpr uint32_t MAX_UPDATE_INTERVAL = 4;
+	void UpdateDisplacementMap(const OceanParameters& params, const Coverage& coverage, wiGraphics::CommandList cmd) const;
+	// Update the displacement map unconditionally
 	void UpdateDisplacementMap(const OceanParameters& params, wiGraphics::CommandList cmd) const;
+	// Render the projected grid only over the part of the screen that the ocean covers, nothing is drawn if it is not visible
 	void Render(const wiScene::CameraComponent& camera, const OceanParameters& params, wiGraphics::CommandList cmd) const;
 
 	const wiGraphics::Texture* getDisplacementMap() const;
@@ -75,4 +92,6 @@ protected:
 
 	wiGraphics::GPUBuffer immutableCB;
 	wiGraphics::GPUBuffer perFrameCB;
+
+	mutable uint64_t updateFrame = ~0ull; // the frame of the last displacement map update
 };
@@ -0,0 +1,365 @@
+#include "wiPackage.h"
+#include "wiHelper.h"
+#include "wiCompression.h"
+#include "wiBackLog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+
+namespace wiPackage
+{
+	// The package file starts with the header, followed by the file contents (aligned to 16 bytes), the index sorted by name hash, and the names
+	static constexpr uint64_t PACKAGE_MAGIC = 0x3130304B41504957ull; // "WIPAK001"
+	static constexpr uint64_t PACKAGE_ALIGNMENT = 16;
+	struct Header
+	{
+		uint64_t magic;
+		uint64_t entry_count;
+		uint64_t index_offset;
+		uint64_t names_offset;
+		uint64_t names_size;
+	};
+	struct Entry
+	{
+		uint64_t hash; // hash of the normalized name
+		uint64_t offset;
+		uint64_t stored_size; // equals size if the file is stored uncompressed
+		uint64_t size;
+		uint32_t name_offset;
+		uint32_t name_length;
+	};
+	static_assert(sizeof(Entry) % 8 == 0, "package entries must keep 8 byte alignment");
+
+	struct Package
+	{
+		std::string file;
+		std::string mount_relative; // normalized mount directory as it was given
+		std::string mount_absolute; // normalized absolute mount directory
+		std::shared_ptr<const uint8_t> data;
+		size_t size = 0;
+		const Entry* entries = nullptr;
+		size_t entry_count = 0;
+		const char* names = nullptr;
+	};
+	std::mutex locker;
+	std::vector<std::shared_ptr<Package>> packages;
+	std::atomic<uint32_t> package_count{ 0 }; // file operations don't lock when nothing is mounted
+
+	static bool IsAbsolute(const std::string& path)
+	{
+		return (!path.empty() && path[0] == '/') || (path.size() > 1 && path[1] == ':');
+	}
+
+	// Lowercase path with forward slashes, without empty and "." parts, and with ".." parts resolved where possible
+	static std::string NormalizePath(const std::string& path)
+	{
+		std::vector<std::string> parts;
+		const bool rooted = !path.empty() && (path[0] == '/' || path[0] == '\\');
+		size_t begin = 0;
+		while (begin <= path.size())
+		{
+			size_t end = path.find_first_of("/\\", begin);
+			if (end == std::string::npos)
+			{
+				end = path.size();
+			}
+			std::string part = path.substr(begin, end - begin);
+			begin = end + 1;
+			if (part.empty() || part == ".")
+			{
+				continue;
+			}
+			if (part == "..")
+			{
+				if (!parts.empty() && parts.back() != ".." && parts.back().back() != ':')
+				{
+					parts.pop_back();
+					continue;
+				}
+				if (rooted || !parts.empty())
+				{
+					continue; // above the root
+				}
+			}
+			std::transform(part.begin(), part.end(), part.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+			parts.push_back(part);
+		}
+
+		std::string result = rooted ? "/" : "";
+		for (size_t i = 0; i < parts.size(); ++i)
+		{
+			if (i > 0)
+			{
+				result += '/';
+			}
+			result += parts[i];
+		}
+		return result;
+	}
+
+	static uint64_t HashName(const std::string& name)
+	{
+		return wiHelper::HashData(name.data(), name.size());
+	}
+
+	// Finds the newest mounted package that contains the file
+	static bool Find(const std::string& fileName, std::shared_ptr<Package>& package, Entry& entry)
+	{
+		if (package_count.load() == 0)
+		{
+			return false;
+		}
+		const std::string name = NormalizePath(fileName);
+		const bool absolute = IsAbsolute(name);
+
+		std::lock_guard<std::mutex> lock(locker);
+		for (auto it = packages.rbegin(); it != packages.rend(); ++it)
+		{
+			const Package& candidate = **it;
+			const std::string& mount = absolute ? candidate.mount_absolute : candidate.mount_relative;
+			if (name.compare(0, mount.size(), mount) != 0)
+			{
+				continue;
+			}
+			const std::string relative = name.substr(mount.size());
+			const uint64_t hash = HashName(relative);
+			const Entry* first = std::lower_bound(candidate.entries, candidate.entries + candidate.entry_count, hash, [](const Entry& entry, uint64_t hash) {
+				return entry.hash < hash;
+			});
+			for (const Entry* x = first; x < candidate.entries + candidate.entry_count && x->hash == hash; ++x)
+			{
+				if (relative.compare(0, std::string::npos, candidate.names + x->name_offset, x->name_length) == 0)
+				{
+					package = *it;
+					entry = *x;
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	bool Create(const std::string& packagefile, const std::string& directory, int compression_level, const std::string& extension)
+	{
+		// The file list is collected before the package is opened, so it doesn't contain itself:
+		std::error_code error;
+		std::vector<std::filesystem::path> files;
+		for (auto& it : std::filesystem::recursive_directory_iterator(directory, error))
+		{
+			if (it.is_regular_file() && (extension.empty() || wiHelper::toUpper(wiHelper::GetExtensionFromFileName(it.path().string())) == wiHelper::toUpper(extension)))
+			{
+				files.push_back(it.path());
+			}
+		}
+		if (error)
+		{
+			wiBackLog::post(("wiPackage::Create failed to list directory: " + directory).c_str());
+			return false;
+		}
+
+		std::ofstream file(packagefile, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		Header header = {};
+		header.magic = PACKAGE_MAGIC;
+		file.write((const char*)&header, sizeof(header));
+		uint64_t offset = sizeof(header);
+		auto align = [&](uint64_t alignment) {
+			static const char zeros[PACKAGE_ALIGNMENT] = {};
+			const uint64_t padding = (alignment - offset % alignment) % alignment;
+			file.write(zeros, (std::streamsize)padding);
+			offset += padding;
+		};
+
+		std::vector<Entry> entries;
+		std::string names;
+		std::vector<uint8_t> data;
+		std::vector<uint8_t> compressed;
+		for (auto& path : files)
+		{
+			if (!wiHelper::FileRead(path.string(), data))
+			{
+				continue;
+			}
+			const std::string name = NormalizePath(std::filesystem::relative(path, directory, error).generic_string());
+			if (error || name.empty())
+			{
+				continue;
+			}
+
+			const uint8_t* stored = data.data();
+			size_t stored_size = data.size();
+			if (compression_level > 0 && !data.empty())
+			{
+				compressed.resize(data.size() - 1);
+				const size_t compressed_size = wiCompression::Compress(data.data(), data.size(), compressed.data(), compressed.size(), compression_level);
+				if (compressed_size > 0)
+				{
+					stored = compressed.data();
+					stored_size = compressed_size;
+				}
+			}
+
+			align(PACKAGE_ALIGNMENT);
+			Entry entry = {};
+			entry.hash = HashName(name);
+			entry.offset = offset;
+			entry.stored_size = stored_size;
+			entry.size = data.size();
+			entry.name_offset = (uint32_t)names.size();
+			entry.name_length = (uint32_t)name.size();
+			entries.push_back(entry);
+			names += name;
+
+			file.write((const char*)stored, (std::streamsize)stored_size);
+			offset += stored_size;
+		}
+
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+			return a.hash < b.hash;
+		});
+		align(sizeof(uint64_t));
+		header.entry_count = entries.size();
+		header.index_offset = offset;
+		file.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(Entry)));
+		offset += entries.size() * sizeof(Entry);
+		header.names_offset = offset;
+		header.names_size = names.size();
+		file.write(names.data(), (std::streamsize)names.size());
+
+		file.seekp(0);
+		file.write((const char*)&header, sizeof(header));
+		file.close();
+		return !file.fail();
+	}
+
+	bool Mount(const std::string& packagefile, const std::string& mountdirectory)
+	{
+		auto package = std::make_shared<Package>();
+		package->file = NormalizePath(packagefile);
+		package->data = wiHelper::FileMap(packagefile, package->size);
+		if (package->data == nullptr)
+		{
+			auto buffer = std::make_shared<std::vector<uint8_t>>();
+			if (!wiHelper::FileRead(packagefile, *buffer))
+			{
+				return false;
+			}
+			package->size = buffer->size();
+			package->data = std::shared_ptr<const uint8_t>(buffer, buffer->data());
+		}
+
+		Header header = {};
+		const uint8_t* data = package->data.get();
+		const uint64_t size = package->size;
+		if (size >= sizeof(header))
+		{
+			memcpy(&header, data, sizeof(header));
+		}
+		bool valid = header.magic == PACKAGE_MAGIC && header.index_offset % sizeof(uint64_t) == 0 &&
+			header.index_offset <= size && header.entry_count <= (size - header.index_offset) / sizeof(Entry) &&
+			header.names_offset <= size && header.names_size <= size - header.names_offset;
+		if (valid)
+		{
+			package->entries = (const Entry*)(data + header.index_offset);
+			package->entry_count = (size_t)header.entry_count;
+			package->names = (const char*)(data + header.names_offset);
+			for (size_t i = 0; i < package->entry_count && valid; ++i)
+			{
+				const Entry& entry = package->entries[i];
+				valid = entry.offset <= size && entry.stored_size <= size - entry.offset &&
+					uint64_t(entry.name_offset) + uint64_t(entry.name_length) <= header.names_size;
+			}
+		}
+		if (!valid)
+		{
+			wiBackLog::post(("wiPackage::Mount failed, the package is invalid: " + packagefile).c_str());
+			return false;
+		}
+
+		std::error_code error;
+		std::filesystem::path absolute = std::filesystem::absolute(mountdirectory.empty() ? std::filesystem::path(".") : std::filesystem::path(mountdirectory), error);
+		package->mount_relative = NormalizePath(mountdirectory);
+		package->mount_absolute = NormalizePath(absolute.generic_string());
+		for (std::string* mount : { &package->mount_relative, &package->mount_absolute })
+		{
+			if (!mount->empty() && mount->back() != '/')
+			{
+				*mount += '/';
+			}
+		}
+
+		Unmount(packagefile);
+		std::lock_guard<std::mutex> lock(locker);
+		packages.push_back(package);
+		package_count.store((uint32_t)packages.size());
+		return true;
+	}
+
+	void Unmount(const std::string& packagefile)
+	{
+		const std::string file = NormalizePath(packagefile);
+		std::lock_guard<std::mutex> lock(locker);
+		packages.erase(std::remove_if(packages.begin(), packages.end(), [&](const std::shared_ptr<Package>& package) {
+			return package->file == file;
+		}), packages.end());
+		package_count.store((uint32_t)packages.size());
+	}
+
+	void UnmountAll()
+	{
+		std::lock_guard<std::mutex> lock(locker);
+		packages.clear();
+		package_count.store(0);
+	}
+
+	bool Contains(const std::string& fileName)
+	{
+		std::shared_ptr<Package> package;
+		Entry entry;
+		return Find(fileName, package, entry);
+	}
+
+	bool Read(const std::string& fileName, std::vector<uint8_t>& data)
+	{
+		std::shared_ptr<Package> package;
+		Entry entry;
+		if (!Find(fileName, package, entry))
+		{
+			return false;
+		}
+
+		// The package is kept alive by the reference, so it is read without locking:
+		const uint8_t* src = package->data.get() + entry.offset;
+		data.resize((size_t)entry.size);
+		if (entry.stored_size == entry.size)
+		{
+			memcpy(data.data(), src, (size_t)entry.size);
+			return true;
+		}
+		if (!wiCompression::Decompress(src, (size_t)entry.stored_size, data.data(), data.size()))
+		{
+			wiBackLog::post(("wiPackage::Read failed, the file is corrupted: " + fileName).c_str());
+			data.clear();
+			return false;
+		}
+		return true;
+	}
+
+	std::shared_ptr<const uint8_t> Map(const std::string& fileName, size_t& size)
+	{
+		std::shared_ptr<Package> package;
+		Entry entry;
+		if (!Find(fileName, package, entry) || entry.stored_size != entry.size || entry.size == 0)
+		{
+			return nullptr;
+		}
+		size = (size_t)entry.size;
+		return std::shared_ptr<const uint8_t>(package->data, package->data.get() + entry.offset);
+	}
+}
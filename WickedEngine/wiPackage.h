@@ -0,0 +1,33 @@
+#pragma once
+#include "CommonInclude.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Virtual file system of package files: many files packed into a single file with an index, which is memory mapped once when it is mounted
+//	wiHelper::FileRead(), wiHelper::FileMap() and wiHelper::FileExists() look up the mounted packages first, so everything that loads files
+//	through them (resources, scenes, shaders) can be loaded from packages without opening the files one by one
+//	File names are case insensitive in packages, and both slash types are accepted
+namespace wiPackage
+{
+	// Create a package file from every file in the directory and its subdirectories, their names are relative to the directory
+	//	compression_level : the files are compressed with wiCompression at this level, files that don't get smaller are stored uncompressed. 0 disables compression
+	//	extension : only the files with this extension are packed (for example "cso"), empty packs every file
+	bool Create(const std::string& packagefile, const std::string& directory, int compression_level = 0, const std::string& extension = "");
+
+	// Mount a package file, the files in it are accessed as if they were in the mount directory
+	//	mountdirectory : the directory of the files in the package, empty means the working directory
+	//	Packages that are mounted later are looked up first, so they can override files of earlier packages
+	bool Mount(const std::string& packagefile, const std::string& mountdirectory = "");
+	void Unmount(const std::string& packagefile);
+	void UnmountAll();
+
+	// Returns true if the file is in a mounted package
+	bool Contains(const std::string& fileName);
+	// Read the file from the mounted packages, returns false if it is not in any of them
+	bool Read(const std::string& fileName, std::vector<uint8_t>& data);
+	// Returns a view of an uncompressed file in the mapped package, which stays valid while the returned pointer is alive
+	//	Returns nullptr if the file is not in a mounted package, or it is compressed
+	std::shared_ptr<const uint8_t> Map(const std::string& fileName, size_t& size);
+};
@@ -3,9 +3,13 @@
 #include "wiScene_Decl.h"
 #include "wiJobSystem.h"
 
+#include <string>
+#include <vector>
+
 namespace wiPhysicsEngine
 {
 	// Initializes the physics engine
+	//	This is done by the first physics update, calling it is only needed to create the physics world earlier. Calling it again has no effect
 	void Initialize();
 
 	// Enable/disable the physics engine all together
@@ -28,6 +32,27 @@ namespace wiPhysicsEngine
 	void SetAccuracy(int value);
 	int GetAccuracy();
 
+	// Set the physics LOD distance (0 = disabled, default)
+	//	Rigid bodies that are farther than this from every observer are frozen: they are removed from the dynamics world and restored when an observer comes closer
+	//	Frozen bodies are not simulated, they are not hit by scene queries and their transforms are left untouched
+	void SetLODDistance(float value);
+	float GetLODDistance();
+	// Set the positions that keep the rigid bodies around them simulated, the main camera is used if there are none
+	void SetLODObservers(const XMFLOAT3* positions, uint32_t count);
+
+	// Enable/disable asynchronous simulation
+	//	The simulation step runs on worker threads while the frame is rendered, and its results are applied by the next update (one frame later)
+	//	Kinematic inputs are latched when the step is started, forces and impulses that are applied meanwhile take effect in the next step
+	//	Default is disabled
+	void SetAsyncEnabled(bool value);
+	bool IsAsyncEnabled();
+
+	// Set a directory where the optimized BVH of triangle mesh collision shapes are cached
+	//	Triangle mesh shapes that were built before are loaded from the cache instead of building the BVH again
+	//	Empty directory disables the cache (default)
+	void SetShapeCacheDirectory(const std::string& directory);
+	const std::string& GetShapeCacheDirectory();
+
 	// Update the physics state, run simulation, etc.
 	void RunPhysicsUpdateSystem(
 		wiJobSystem::context& ctx,
@@ -58,4 +83,66 @@ namespace wiPhysicsEngine
 		const XMFLOAT3& impulse,
 		const XMFLOAT3& at
 	);
+
+	// Scene queries against the rigid bodies of the physics world
+	//	The queries of a batch are executed in parallel on the job system, and every query writes its own result in the result array
+	//	They must not be called while the physics update system is running. In async mode they wait for the running simulation step
+
+	// Shape of the sweep and overlap queries
+	struct QueryShape
+	{
+		enum TYPE
+		{
+			SPHERE,
+			BOX,
+			CAPSULE,
+		} type = SPHERE;
+		float radius = 0.5f; // SPHERE, CAPSULE
+		float height = 1; // CAPSULE
+		XMFLOAT3 halfextents = XMFLOAT3(0.5f, 0.5f, 0.5f); // BOX
+	};
+	struct RayQuery
+	{
+		XMFLOAT3 origin = XMFLOAT3(0, 0, 0);
+		XMFLOAT3 direction = XMFLOAT3(0, 0, 1); // normalized
+		float distance = 1000;
+		wiECS::Entity ignore = wiECS::INVALID_ENTITY; // rigid body that is not hit, for example the character that casts it
+	};
+	struct SweepQuery
+	{
+		QueryShape shape;
+		XMFLOAT3 origin = XMFLOAT3(0, 0, 0);
+		XMFLOAT4 rotation = XMFLOAT4(0, 0, 0, 1);
+		XMFLOAT3 direction = XMFLOAT3(0, 0, 1); // normalized
+		float distance = 1000;
+		wiECS::Entity ignore = wiECS::INVALID_ENTITY;
+	};
+	struct OverlapQuery
+	{
+		QueryShape shape;
+		XMFLOAT3 position = XMFLOAT3(0, 0, 0);
+		XMFLOAT4 rotation = XMFLOAT4(0, 0, 0, 1);
+		wiECS::Entity ignore = wiECS::INVALID_ENTITY;
+	};
+	// The closest hit of a ray or sweep query
+	struct QueryHit
+	{
+		wiECS::Entity entity = wiECS::INVALID_ENTITY; // INVALID_ENTITY if nothing was hit
+		XMFLOAT3 position = XMFLOAT3(0, 0, 0);
+		XMFLOAT3 normal = XMFLOAT3(0, 0, 0);
+		float distance = 0;
+	};
+	// The overlapping entities of an overlap query are [offset, offset + count) in the entity array
+	struct OverlapResult
+	{
+		uint32_t offset = 0;
+		uint32_t count = 0;
+	};
+
+	// Cast rays, results[i] is the closest hit of queries[i]
+	void RayCast(const RayQuery* queries, uint32_t count, QueryHit* results);
+	// Sweep convex shapes, results[i] is the first hit of queries[i] along its direction
+	void SweepTest(const SweepQuery* queries, uint32_t count, QueryHit* results);
+	// Find the rigid bodies that intersect the shapes, the entities of every query are appended to the entities array
+	void OverlapTest(const OverlapQuery* queries, uint32_t count, OverlapResult* results, std::vector<wiECS::Entity>& entities);
 }
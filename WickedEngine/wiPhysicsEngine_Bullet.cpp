@@ -4,15 +4,24 @@
 #include "wiBackLog.h"
 #include "wiJobSystem.h"
 #include "wiRenderer.h"
+#include "wiMemoryTracker.h"
+#include "wiHelper.h"
+#include "wiCounters.h"
+#include "wiTimer.h"
 
 #include "btBulletDynamicsCommon.h"
 #include "BulletSoftBody/btSoftBodyHelpers.h"
 #include "BulletSoftBody/btDefaultSoftBodySolver.h"
 #include "BulletSoftBody/btSoftRigidDynamicsWorld.h"
 #include "BulletSoftBody/btSoftBodyRigidBodyCollisionConfiguration.h"
+#include "BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h"
 
+#include <atomic>
+#include <cstdio>
 #include <mutex>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 using namespace wiECS;
 using namespace wiScene;
@@ -23,14 +32,155 @@ namespace wiPhysicsEngine
 	bool ENABLED = true;
 	bool SIMULATION_ENABLED = true;
 	bool DEBUGDRAW_ENABLED = false;
+	bool ASYNC_ENABLED = false;
+	float LOD_DISTANCE = 0;
 	int ACCURACY = 10;
 	std::mutex physicsLock;
 
+	// Bullet allocations are counted by the memory tracker. The size is stored in front of the allocation
+	//	The allocator is set by a static initializer before the static Bullet objects below, so everything that Bullet frees was allocated by it
+	static constexpr size_t bullet_allocation_header = 16;
+	void* BulletAllocate(size_t size)
+	{
+		uint8_t* ptr = (uint8_t*)malloc(size + bullet_allocation_header);
+		if (ptr == nullptr)
+			return nullptr;
+		*(size_t*)ptr = size;
+		wiMemoryTracker::Allocate(wiMemoryTracker::TAG_PHYSICS, size);
+		return ptr + bullet_allocation_header;
+	}
+	void BulletFree(void* ptr)
+	{
+		if (ptr == nullptr)
+			return;
+		uint8_t* base = (uint8_t*)ptr - bullet_allocation_header;
+		wiMemoryTracker::Free(wiMemoryTracker::TAG_PHYSICS, *(size_t*)base);
+		free(base);
+	}
+	struct BulletAllocatorSetter
+	{
+		BulletAllocatorSetter() { btAlignedAllocSetCustom(BulletAllocate, BulletFree); }
+	} bulletAllocatorSetter;
+
 	btVector3 gravity(0, -10, 0);
 	int softbodyIterationCount = 5;
 	btSoftBodyRigidBodyCollisionConfiguration collisionConfiguration;
 	btDbvtBroadphase overlappingPairCache;
 	btSequentialImpulseConstraintSolver solver;
+
+	// Soft body solver that processes the soft bodies (cloth) in parallel on the job system
+	//	Every soft body only writes its own nodes, except when it pushes rigid bodies (anchors, rigid contacts) or other soft bodies (soft contacts)
+	//	The soft bodies that share a dynamic rigid body or have soft contacts are solved on the calling thread after the parallel ones
+	class JobSystemSoftBodySolver : public btDefaultSoftBodySolver
+	{
+		std::vector<btSoftBody*> independent;
+		std::vector<btSoftBody*> dependent;
+		std::unordered_map<const btCollisionObject*, uint32_t> rigid_users; // soft body index + 1 that pushes the rigid body, or ~0u if more than one
+
+		// Returns the rigid body that a soft body can push, or nullptr if it can't be moved
+		static const btCollisionObject* GetDynamicRigid(const btCollisionObject* object)
+		{
+			const btRigidBody* rigidbody = btRigidBody::upcast(object);
+			if (rigidbody == nullptr || rigidbody->getInvMass() == 0)
+				return nullptr;
+			return object;
+		}
+		template<typename F>
+		void ForEachRigid(btSoftBody* softbody, F func)
+		{
+			for (int i = 0; i < softbody->m_anchors.size(); ++i)
+			{
+				const btCollisionObject* rigid = GetDynamicRigid(softbody->m_anchors[i].m_body);
+				if (rigid != nullptr)
+					func(rigid);
+			}
+			for (int i = 0; i < softbody->m_rcontacts.size(); ++i)
+			{
+				const btCollisionObject* rigid = GetDynamicRigid(softbody->m_rcontacts[i].m_cti.m_colObj);
+				if (rigid != nullptr)
+					func(rigid);
+			}
+		}
+
+	public:
+		void predictMotion(float timeStep) override
+		{
+			wiJobSystem::context ctx;
+			wiJobSystem::Dispatch(ctx, (uint32_t)m_softBodySet.size(), 1, [&](wiJobArgs args) {
+				btSoftBody* softbody = m_softBodySet[args.jobIndex];
+				if (softbody->isActive())
+				{
+					// The broadphase is not thread safe, the bounds are given to it below:
+					btBroadphaseProxy* proxy = softbody->getBroadphaseHandle();
+					softbody->setBroadphaseHandle(nullptr);
+					softbody->predictMotion(timeStep);
+					softbody->setBroadphaseHandle(proxy);
+				}
+			});
+			wiJobSystem::Wait(ctx);
+
+			for (int i = 0; i < m_softBodySet.size(); ++i)
+			{
+				btSoftBody* softbody = m_softBodySet[i];
+				if (softbody->isActive() && softbody->getBroadphaseHandle() != nullptr)
+				{
+					btSoftBodyWorldInfo* info = softbody->getWorldInfo();
+					info->m_broadphase->setAabb(softbody->getBroadphaseHandle(), softbody->m_bounds[0], softbody->m_bounds[1], info->m_dispatcher);
+				}
+			}
+		}
+		void solveConstraints(float solverdt) override
+		{
+			rigid_users.clear();
+			for (int i = 0; i < m_softBodySet.size(); ++i)
+			{
+				btSoftBody* softbody = m_softBodySet[i];
+				if (softbody->isActive())
+				{
+					ForEachRigid(softbody, [&](const btCollisionObject* rigid) {
+						uint32_t& user = rigid_users[rigid];
+						user = (user == 0 || user == uint32_t(i + 1)) ? uint32_t(i + 1) : ~0u;
+					});
+				}
+			}
+
+			independent.clear();
+			dependent.clear();
+			for (int i = 0; i < m_softBodySet.size(); ++i)
+			{
+				btSoftBody* softbody = m_softBodySet[i];
+				if (!softbody->isActive())
+					continue;
+				bool shared = softbody->m_scontacts.size() > 0;
+				ForEachRigid(softbody, [&](const btCollisionObject* rigid) { shared |= rigid_users[rigid] == ~0u; });
+				(shared ? dependent : independent).push_back(softbody);
+			}
+
+			wiJobSystem::context ctx;
+			wiJobSystem::Dispatch(ctx, (uint32_t)independent.size(), 1, [&](wiJobArgs args) {
+				independent[args.jobIndex]->solveConstraints();
+			});
+			wiJobSystem::Wait(ctx);
+			for (btSoftBody* softbody : dependent)
+			{
+				softbody->solveConstraints();
+			}
+		}
+		void updateSoftBodies() override
+		{
+			wiJobSystem::context ctx;
+			wiJobSystem::Dispatch(ctx, (uint32_t)m_softBodySet.size(), 1, [&](wiJobArgs args) {
+				btSoftBody* softbody = m_softBodySet[args.jobIndex];
+				if (softbody->isActive())
+				{
+					softbody->integrateMotion();
+				}
+			});
+			wiJobSystem::Wait(ctx);
+		}
+	};
+	JobSystemSoftBodySolver softBodySolver;
+
 	std::unique_ptr<btCollisionDispatcher> dispatcher;
 	std::unique_ptr<btDynamicsWorld> dynamicsWorld;
 
@@ -64,29 +214,32 @@ namespace wiPhysicsEngine
 	};
 	DebugDraw debugDraw;
 
+	std::once_flag initialized;
 	void Initialize()
 	{
-		dispatcher = std::make_unique<btCollisionDispatcher>(&collisionConfiguration);
-		dynamicsWorld = std::make_unique<btSoftRigidDynamicsWorld>(dispatcher.get(), &overlappingPairCache, &solver, &collisionConfiguration);
+		std::call_once(initialized, [] {
+			dispatcher = std::make_unique<btCollisionDispatcher>(&collisionConfiguration);
+			dynamicsWorld = std::make_unique<btSoftRigidDynamicsWorld>(dispatcher.get(), &overlappingPairCache, &solver, &collisionConfiguration, &softBodySolver);
 
-		dynamicsWorld->getSolverInfo().m_solverMode |= SOLVER_RANDMIZE_ORDER;
-		dynamicsWorld->getDispatchInfo().m_enableSatConvex = true;
-		dynamicsWorld->getSolverInfo().m_splitImpulse = true;
+			dynamicsWorld->getSolverInfo().m_solverMode |= SOLVER_RANDMIZE_ORDER;
+			dynamicsWorld->getDispatchInfo().m_enableSatConvex = true;
+			dynamicsWorld->getSolverInfo().m_splitImpulse = true;
 
-		dynamicsWorld->setGravity(gravity);
+			dynamicsWorld->setGravity(gravity);
 
-		btSoftRigidDynamicsWorld* softRigidWorld = (btSoftRigidDynamicsWorld*)dynamicsWorld.get();
-		btSoftBodyWorldInfo& softWorldInfo = softRigidWorld->getWorldInfo();
-		softWorldInfo.air_density = btScalar(1.2f);
-		softWorldInfo.water_density = 0;
-		softWorldInfo.water_offset = 0;
-		softWorldInfo.water_normal = btVector3(0, 0, 0);
-		softWorldInfo.m_gravity.setValue(gravity.x(), gravity.y(), gravity.z());
-		softWorldInfo.m_sparsesdf.Initialize();
+			btSoftRigidDynamicsWorld* softRigidWorld = (btSoftRigidDynamicsWorld*)dynamicsWorld.get();
+			btSoftBodyWorldInfo& softWorldInfo = softRigidWorld->getWorldInfo();
+			softWorldInfo.air_density = btScalar(1.2f);
+			softWorldInfo.water_density = 0;
+			softWorldInfo.water_offset = 0;
+			softWorldInfo.water_normal = btVector3(0, 0, 0);
+			softWorldInfo.m_gravity.setValue(gravity.x(), gravity.y(), gravity.z());
+			softWorldInfo.m_sparsesdf.Initialize();
 
-		softRigidWorld->setDebugDrawer(&debugDraw);
+			softRigidWorld->setDebugDrawer(&debugDraw);
 
-		wiBackLog::post("wiPhysicsEngine_Bullet Initialized");
+			wiBackLog::post("wiPhysicsEngine_Bullet Initialized");
+		});
 	}
 
 	bool IsEnabled() { return ENABLED; }
@@ -101,7 +254,370 @@ namespace wiPhysicsEngine
 	int GetAccuracy() { return ACCURACY; }
 	void SetAccuracy(int value) { ACCURACY = value; }
 
-	void AddRigidBody(Entity entity, wiScene::RigidBodyPhysicsComponent& physicscomponent, const wiScene::TransformComponent& transform, const wiScene::MeshComponent* mesh)
+	// Asynchronous simulation: the step is started at the end of the physics update and runs on the job system while the frame renders
+	//	Nothing touches the physics world while the step is running, the next update waits for it before it applies the results and latches the new inputs
+	wiJobSystem::context step_ctx;
+	bool step_pending = false; // the results of the started step were not applied yet
+	struct RigidBodyResult
+	{
+		Entity entity = INVALID_ENTITY;
+		btRigidBody* rigidbody = nullptr;
+		XMFLOAT3 position;
+		XMFLOAT4 rotation;
+	};
+	// The results are double buffered, the step writes one while the results of the previous step are applied from the other:
+	std::vector<RigidBodyResult> step_results;
+	std::vector<RigidBodyResult> applied_results;
+
+	// Forces and impulses that were applied while the step was running, they are applied to the rigid bodies when the next step is started
+	struct RigidBodyCommand
+	{
+		enum TYPE
+		{
+			FORCE,
+			FORCE_AT,
+			IMPULSE,
+			IMPULSE_AT,
+		} type;
+		btRigidBody* rigidbody;
+		btVector3 value;
+		btVector3 at;
+	};
+	btAlignedObjectArray<RigidBodyCommand> commands;
+	std::mutex commandLock;
+
+	// Physics LOD: the rigid bodies that are farther than the LOD distance from every observer are frozen, they are removed from the dynamics world until an observer approaches
+	//	Frozen bodies are only visited every LOD_INTERVAL frames, the restore distance is smaller than the freeze distance, so bodies at the border don't switch every frame
+	static constexpr uint32_t LOD_INTERVAL = 8;
+	static constexpr float LOD_RESTORE = 0.9f;
+	std::vector<XMFLOAT3> lod_observers;
+	std::unordered_map<btRigidBody*, Entity> frozen_rigidbodies;
+	uint32_t lod_frame = 0;
+
+	void SetLODDistance(float value) { LOD_DISTANCE = value; }
+	float GetLODDistance() { return LOD_DISTANCE; }
+	void SetLODObservers(const XMFLOAT3* positions, uint32_t count)
+	{
+		lod_observers.assign(positions, positions + count);
+	}
+
+	// Returns the squared distance to the closest observer, the main camera is the observer if none was set
+	float GetObserverDistanceSquared(const XMFLOAT3& position)
+	{
+		const XMVECTOR P = XMLoadFloat3(&position);
+		if (lod_observers.empty())
+		{
+			return XMVectorGetX(XMVector3LengthSq(P - XMLoadFloat3(&wiScene::GetCamera().Eye)));
+		}
+		float result = FLT_MAX;
+		for (const XMFLOAT3& observer : lod_observers)
+		{
+			result = std::min(result, XMVectorGetX(XMVector3LengthSq(P - XMLoadFloat3(&observer))));
+		}
+		return result;
+	}
+
+	void SetAsyncEnabled(bool value)
+	{
+		if (!value)
+		{
+			wiJobSystem::Wait(step_ctx);
+		}
+		ASYNC_ENABLED = value;
+	}
+	bool IsAsyncEnabled() { return ASYNC_ENABLED; }
+
+	void ExecuteCommand(const RigidBodyCommand& command)
+	{
+		switch (command.type)
+		{
+		case RigidBodyCommand::FORCE:
+			command.rigidbody->applyCentralForce(command.value);
+			break;
+		case RigidBodyCommand::FORCE_AT:
+			command.rigidbody->applyForce(command.value, command.at);
+			break;
+		case RigidBodyCommand::IMPULSE:
+			command.rigidbody->applyCentralImpulse(command.value);
+			break;
+		case RigidBodyCommand::IMPULSE_AT:
+			command.rigidbody->applyImpulse(command.value, command.at);
+			break;
+		}
+	}
+	// Applies the force/impulse immediately, or queues it when the step could be running on an other thread
+	void ApplyCommand(const RigidBodyCommand& command)
+	{
+		if (ASYNC_ENABLED)
+		{
+			std::lock_guard<std::mutex> lock(commandLock);
+			commands.push_back(command);
+			return;
+		}
+		ExecuteCommand(command);
+	}
+	void FlushCommands()
+	{
+		std::lock_guard<std::mutex> lock(commandLock);
+		for (int i = 0; i < commands.size(); ++i)
+		{
+			ExecuteCommand(commands[i]);
+		}
+		commands.clear();
+	}
+
+	void CaptureResults(const std::vector<std::pair<btRigidBody*, Entity>>& rigidbodies, std::vector<RigidBodyResult>& results)
+	{
+		results.resize(rigidbodies.size());
+		for (size_t i = 0; i < rigidbodies.size(); ++i)
+		{
+			RigidBodyResult& result = results[i];
+			result.rigidbody = rigidbodies[i].first;
+			result.entity = rigidbodies[i].second;
+
+			btTransform physicsTransform;
+			result.rigidbody->getMotionState()->getWorldTransform(physicsTransform);
+			btVector3 T = physicsTransform.getOrigin();
+			btQuaternion R = physicsTransform.getRotation();
+			result.position = XMFLOAT3(T.x(), T.y(), T.z());
+			result.rotation = XMFLOAT4(R.x(), R.y(), R.z(), R.w());
+		}
+	}
+
+	// The collision shapes made from meshes are shared by the rigid bodies that use the same mesh:
+	//	Triangle meshes are shared unscaled, every rigid body scales them with its own btScaledBvhTriangleMeshShape
+	//	Convex hulls are shared by the rigid bodies that have the same scale
+	//	The cache is accessed under physicsLock
+	struct ShapeKey
+	{
+		Entity meshID = INVALID_ENTITY;
+		int type = 0;
+		XMFLOAT3 scale = XMFLOAT3(1, 1, 1);
+		size_t vertexCount = 0; // the shape is not reused when the geometry of the mesh was changed
+		size_t indexCount = 0;
+
+		bool operator==(const ShapeKey& other) const
+		{
+			return meshID == other.meshID && type == other.type &&
+				scale.x == other.scale.x && scale.y == other.scale.y && scale.z == other.scale.z &&
+				vertexCount == other.vertexCount && indexCount == other.indexCount;
+		}
+	};
+	struct ShapeKeyHasher
+	{
+		size_t operator()(const ShapeKey& key) const
+		{
+			size_t hash = 0;
+			wiHelper::hash_combine(hash, key.meshID);
+			wiHelper::hash_combine(hash, key.type);
+			wiHelper::hash_combine(hash, key.scale.x);
+			wiHelper::hash_combine(hash, key.scale.y);
+			wiHelper::hash_combine(hash, key.scale.z);
+			wiHelper::hash_combine(hash, key.vertexCount);
+			wiHelper::hash_combine(hash, key.indexCount);
+			return hash;
+		}
+	};
+	struct ShapeCacheEntry
+	{
+		btCollisionShape* shape = nullptr;
+		// Triangle mesh data that the shape references:
+		btAlignedObjectArray<btVector3> vertices;
+		btAlignedObjectArray<int> indices;
+		btTriangleIndexVertexArray* meshInterface = nullptr;
+		void* bvhBuffer = nullptr; // the optimized BVH that was loaded from the shape cache directory lives in this buffer
+		uint32_t refCount = 0;
+	};
+	std::unordered_map<ShapeKey, ShapeCacheEntry, ShapeKeyHasher> shapeCache;
+	std::unordered_map<const btCollisionShape*, ShapeKey> shapeCacheKeys;
+	std::string shape_cache_directory;
+
+	void SetShapeCacheDirectory(const std::string& directory)
+	{
+		shape_cache_directory = directory;
+		if (!shape_cache_directory.empty() && shape_cache_directory.back() != '/' && shape_cache_directory.back() != '\\')
+		{
+			shape_cache_directory += "/";
+		}
+	}
+	const std::string& GetShapeCacheDirectory()
+	{
+		return shape_cache_directory;
+	}
+
+	// Creates the triangle mesh shape of a cache entry, the optimized BVH is read from the shape cache directory if it was built before
+	btBvhTriangleMeshShape* CreateTriangleMeshShape(ShapeCacheEntry& entry, const wiScene::MeshComponent& mesh)
+	{
+		entry.vertices.resize((int)mesh.vertex_positions.size());
+		for (int i = 0; i < entry.vertices.size(); ++i)
+		{
+			const XMFLOAT3& pos = mesh.vertex_positions[i];
+			entry.vertices[i] = btVector3(pos.x, pos.y, pos.z);
+		}
+		entry.indices.resize((int)mesh.indices.size());
+		for (int i = 0; i < entry.indices.size(); ++i)
+		{
+			entry.indices[i] = (int)mesh.indices[i];
+		}
+
+		entry.meshInterface = new btTriangleIndexVertexArray(
+			entry.indices.size() / 3,
+			&entry.indices[0],
+			3 * sizeof(int),
+			entry.vertices.size(),
+			(btScalar*)&entry.vertices[0].x(),
+			sizeof(btVector3)
+		);
+
+		const bool useQuantizedAabbCompression = true;
+
+		std::string cachefile;
+		if (!shape_cache_directory.empty())
+		{
+			// The cache is keyed by the hash of the geometry and the layout of the serialized BVH:
+			uint64_t hash = wiHelper::HashData(mesh.vertex_positions.data(), mesh.vertex_positions.size() * sizeof(XMFLOAT3), BT_BULLET_VERSION * 100 + sizeof(void*));
+			hash = wiHelper::HashData(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), hash);
+
+			char filename[32];
+			snprintf(filename, arraysize(filename), "%016llx.bvh", (unsigned long long)hash);
+			cachefile = shape_cache_directory + filename;
+
+			std::vector<uint8_t> filedata;
+			if (wiHelper::FileExists(cachefile) && wiHelper::FileRead(cachefile, filedata) && !filedata.empty())
+			{
+				// The serialized BVH is used in place, so it is kept in an aligned buffer for the lifetime of the shape:
+				entry.bvhBuffer = btAlignedAlloc(filedata.size(), 16);
+				memcpy(entry.bvhBuffer, filedata.data(), filedata.size());
+				btOptimizedBvh* bvh = btOptimizedBvh::deSerializeInPlace(entry.bvhBuffer, (unsigned int)filedata.size(), false);
+				if (bvh != nullptr)
+				{
+					btBvhTriangleMeshShape* shape = new btBvhTriangleMeshShape(entry.meshInterface, useQuantizedAabbCompression, false);
+					shape->setOptimizedBvh(bvh);
+					return shape;
+				}
+				btAlignedFree(entry.bvhBuffer);
+				entry.bvhBuffer = nullptr;
+			}
+		}
+
+		btBvhTriangleMeshShape* shape = new btBvhTriangleMeshShape(entry.meshInterface, useQuantizedAabbCompression);
+
+		if (!cachefile.empty())
+		{
+			const btOptimizedBvh* bvh = shape->getOptimizedBvh();
+			const unsigned int size = bvh->calculateSerializeBufferSize();
+			void* buffer = btAlignedAlloc(size, 16);
+			if (bvh->serializeInPlace(buffer, size, false))
+			{
+				wiHelper::FileWriteAtomic(cachefile, (const uint8_t*)buffer, size);
+			}
+			btAlignedFree(buffer);
+		}
+
+		return shape;
+	}
+
+	// Returns the shared shape of a mesh and takes a reference to it, the shape is created if it is not cached yet
+	btCollisionShape* AcquireMeshShape(Entity meshID, const wiScene::MeshComponent& mesh, RigidBodyPhysicsComponent::CollisionShape type, const XMFLOAT3& scale)
+	{
+		ShapeKey key;
+		key.meshID = meshID;
+		key.type = (int)type;
+		if (type == RigidBodyPhysicsComponent::CollisionShape::CONVEX_HULL)
+		{
+			key.scale = scale;
+		}
+		key.vertexCount = mesh.vertex_positions.size();
+		key.indexCount = mesh.indices.size();
+
+		ShapeCacheEntry& entry = shapeCache[key];
+		if (entry.shape == nullptr)
+		{
+			if (type == RigidBodyPhysicsComponent::CollisionShape::CONVEX_HULL)
+			{
+				btAlignedObjectArray<btVector3> points;
+				points.resize((int)mesh.vertex_positions.size());
+				for (int i = 0; i < points.size(); ++i)
+				{
+					const XMFLOAT3& pos = mesh.vertex_positions[i];
+					points[i] = btVector3(pos.x, pos.y, pos.z);
+				}
+				entry.shape = new btConvexHullShape(points.size() > 0 ? &points[0].x() : nullptr, points.size(), sizeof(btVector3));
+				entry.shape->setLocalScaling(btVector3(scale.x, scale.y, scale.z));
+			}
+			else
+			{
+				entry.shape = CreateTriangleMeshShape(entry, mesh);
+			}
+			shapeCacheKeys[entry.shape] = key;
+		}
+		entry.refCount++;
+		return entry.shape;
+	}
+
+	// Releases the shape of a rigid body, the shared shapes are destroyed when they are no longer referenced
+	void ReleaseShape(btCollisionShape* shape)
+	{
+		if (shape == nullptr)
+			return;
+
+		if (shape->getShapeType() == SCALED_TRIANGLE_MESH_SHAPE_PROXYTYPE)
+		{
+			// The scaling wrapper is owned by the rigid body:
+			btCollisionShape* child = ((btScaledBvhTriangleMeshShape*)shape)->getChildShape();
+			delete shape;
+			shape = child;
+		}
+
+		auto it = shapeCacheKeys.find(shape);
+		if (it == shapeCacheKeys.end())
+		{
+			delete shape;
+			return;
+		}
+
+		auto entry = shapeCache.find(it->second);
+		assert(entry != shapeCache.end() && entry->second.refCount > 0);
+		if (--entry->second.refCount > 0)
+			return;
+
+		if (entry->second.bvhBuffer != nullptr)
+		{
+			btBvhTriangleMeshShape* trimesh = (btBvhTriangleMeshShape*)shape;
+			trimesh->getOptimizedBvh()->~btOptimizedBvh();
+		}
+		delete shape;
+		delete entry->second.meshInterface;
+		btAlignedFree(entry->second.bvhBuffer);
+		shapeCache.erase(entry);
+		shapeCacheKeys.erase(it);
+	}
+
+	// The shape can only be scaled in place if it is owned by the rigid body, shared convex hulls are copied for the rigid body first
+	void SetShapeScaling(btRigidBody* rigidbody, const btVector3& scaling)
+	{
+		btCollisionShape* shape = rigidbody->getCollisionShape();
+		if (shape->getLocalScaling() == scaling)
+			return;
+
+		std::lock_guard<std::mutex> lock(physicsLock);
+		if (shapeCacheKeys.count(shape) > 0)
+		{
+			btConvexHullShape* hull = (btConvexHullShape*)shape;
+			btConvexHullShape* unique = new btConvexHullShape(hull->getNumPoints() > 0 ? &hull->getUnscaledPoints()[0].x() : nullptr, hull->getNumPoints(), sizeof(btVector3));
+			unique->setLocalScaling(scaling);
+			rigidbody->setCollisionShape(unique);
+			if (rigidbody->getBroadphaseHandle() != nullptr)
+			{
+				dynamicsWorld->getBroadphase()->getOverlappingPairCache()->cleanProxyFromPairs(rigidbody->getBroadphaseHandle(), dynamicsWorld->getDispatcher());
+			}
+			ReleaseShape(shape);
+			return;
+		}
+		shape->setLocalScaling(scaling);
+	}
+
+	void AddRigidBody(Entity entity, wiScene::RigidBodyPhysicsComponent& physicscomponent, const wiScene::TransformComponent& transform, Entity meshID, const wiScene::MeshComponent* mesh)
 	{
 		btCollisionShape* shape = nullptr;
 
@@ -126,13 +642,7 @@ namespace wiPhysicsEngine
 		case RigidBodyPhysicsComponent::CollisionShape::CONVEX_HULL:
 			if(mesh != nullptr)
 			{
-				shape = new btConvexHullShape();
-				for (auto& pos : mesh->vertex_positions)
-				{
-					((btConvexHullShape*)shape)->addPoint(btVector3(pos.x, pos.y, pos.z));
-				}
-				btVector3 S(transform.scale_local.x, transform.scale_local.y, transform.scale_local.z);
-				shape->setLocalScaling(S);
+				shape = AcquireMeshShape(meshID, *mesh, physicscomponent.shape, transform.scale_local);
 			}
 			else
 			{
@@ -142,41 +652,11 @@ namespace wiPhysicsEngine
 			break;
 
 		case RigidBodyPhysicsComponent::CollisionShape::TRIANGLE_MESH:
-			if(mesh != nullptr)
+			if(mesh != nullptr && !mesh->vertex_positions.empty() && mesh->indices.size() >= 3)
 			{
-				int totalVerts = (int)mesh->vertex_positions.size();
-				int totalTriangles = (int)mesh->indices.size() / 3;
-
-				btVector3* btVerts = new btVector3[totalVerts];
-				size_t i = 0;
-				for (auto& pos : mesh->vertex_positions)
-				{
-					btVerts[i++] = btVector3(pos.x, pos.y, pos.z);
-				}
-
-				int* btInd = new int[mesh->indices.size()];
-				i = 0;
-				for (auto& ind : mesh->indices)
-				{
-					btInd[i++] = ind;
-				}
-
-				int vertStride = sizeof(btVector3);
-				int indexStride = 3 * sizeof(int);
-
-				btTriangleIndexVertexArray* indexVertexArrays = new btTriangleIndexVertexArray(
-					totalTriangles,
-					btInd,
-					indexStride,
-					totalVerts,
-					(btScalar*)&btVerts[0].x(),
-					vertStride
-				);
-
-				bool useQuantizedAabbCompression = true;
-				shape = new btBvhTriangleMeshShape(indexVertexArrays, useQuantizedAabbCompression);
+				btBvhTriangleMeshShape* trimesh = (btBvhTriangleMeshShape*)AcquireMeshShape(meshID, *mesh, physicscomponent.shape, transform.scale_local);
 				btVector3 S(transform.scale_local.x, transform.scale_local.y, transform.scale_local.z);
-				shape->setLocalScaling(S);
+				shape = new btScaledBvhTriangleMeshShape(trimesh, S);
 			}
 			else
 			{
@@ -331,6 +811,119 @@ namespace wiPhysicsEngine
 		}
 	}
 
+#ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
+	std::vector<std::pair<btSoftBody*, Entity>> feedback_softbodies;
+	void FeedbackSoftBodies(wiJobSystem::context& ctx, Scene& scene)
+	{
+		wiJobSystem::Dispatch(ctx, (uint32_t)feedback_softbodies.size(), 1, [&](wiJobArgs args) {
+			btSoftBody* softbody = feedback_softbodies[args.jobIndex].first;
+			Entity entity = feedback_softbodies[args.jobIndex].second;
+			SoftBodyPhysicsComponent* physicscomponent = scene.softbodies.GetComponent(entity);
+			MeshComponent* meshcomponent = scene.meshes.GetComponent(entity);
+			if (physicscomponent == nullptr || physicscomponent->physicsobject != softbody || meshcomponent == nullptr)
+				return; // removed after the step was started
+			MeshComponent& mesh = *meshcomponent;
+
+			// System mesh aabb will be queried from physics engine soft body:
+			btVector3 aabb_min;
+			btVector3 aabb_max;
+			softbody->getAabb(aabb_min, aabb_max);
+			physicscomponent->aabb = AABB(XMFLOAT3(aabb_min.x(), aabb_min.y(), aabb_min.z()), XMFLOAT3(aabb_max.x(), aabb_max.y(), aabb_max.z()));
+
+			// Soft body simulation nodes will update graphics mesh:
+			for (size_t ind = 0; ind < physicscomponent->vertex_positions_simulation.size(); ++ind)
+			{
+				uint32_t physicsInd = physicscomponent->graphicsToPhysicsVertexMapping[ind];
+				float weight = physicscomponent->weights[physicsInd];
+
+				btSoftBody::Node& node = softbody->m_nodes[physicsInd];
+
+				MeshComponent::Vertex_POS& vertex = physicscomponent->vertex_positions_simulation[ind];
+				vertex.pos.x = node.m_x.getX();
+				vertex.pos.y = node.m_x.getY();
+				vertex.pos.z = node.m_x.getZ();
+
+				XMFLOAT3 normal;
+				normal.x = -node.m_n.getX();
+				normal.y = -node.m_n.getY();
+				normal.z = -node.m_n.getZ();
+				vertex.MakeFromParams(normal);
+			}
+
+			// Update tangent vectors:
+			if (!mesh.vertex_uvset_0.empty())
+			{
+				for (size_t i = 0; i < mesh.indices.size(); i += 3)
+				{
+					const uint32_t i0 = mesh.indices[i + 0];
+					const uint32_t i1 = mesh.indices[i + 1];
+					const uint32_t i2 = mesh.indices[i + 2];
+
+					const XMFLOAT3 v0 = physicscomponent->vertex_positions_simulation[i0].pos;
+					const XMFLOAT3 v1 = physicscomponent->vertex_positions_simulation[i1].pos;
+					const XMFLOAT3 v2 = physicscomponent->vertex_positions_simulation[i2].pos;
+
+					const XMFLOAT2 u0 = mesh.vertex_uvset_0[i0];
+					const XMFLOAT2 u1 = mesh.vertex_uvset_0[i1];
+					const XMFLOAT2 u2 = mesh.vertex_uvset_0[i2];
+
+					const XMVECTOR nor0 = physicscomponent->vertex_positions_simulation[i0].LoadNOR();
+					const XMVECTOR nor1 = physicscomponent->vertex_positions_simulation[i1].LoadNOR();
+					const XMVECTOR nor2 = physicscomponent->vertex_positions_simulation[i2].LoadNOR();
+
+					const XMVECTOR facenormal = XMVector3Normalize(XMVectorAdd(XMVectorAdd(nor0, nor1), nor2));
+
+					const float x1 = v1.x - v0.x;
+					const float x2 = v2.x - v0.x;
+					const float y1 = v1.y - v0.y;
+					const float y2 = v2.y - v0.y;
+					const float z1 = v1.z - v0.z;
+					const float z2 = v2.z - v0.z;
+
+					const float s1 = u1.x - u0.x;
+					const float s2 = u2.x - u0.x;
+					const float t1 = u1.y - u0.y;
+					const float t2 = u2.y - u0.y;
+
+					const float r = 1.0f / (s1 * t2 - s2 * t1);
+					const XMVECTOR sdir = XMVectorSet((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r,
+						(t2 * z1 - t1 * z2) * r, 0);
+					const XMVECTOR tdir = XMVectorSet((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r,
+						(s1 * z2 - s2 * z1) * r, 0);
+
+					XMVECTOR tangent;
+					tangent = XMVector3Normalize(XMVectorSubtract(sdir, XMVectorMultiply(facenormal, XMVector3Dot(facenormal, sdir))));
+					float sign = XMVectorGetX(XMVector3Dot(XMVector3Cross(tangent, facenormal), tdir)) < 0.0f ? -1.0f : 1.0f;
+
+					XMFLOAT3 t;
+					XMStoreFloat3(&t, tangent);
+
+					physicscomponent->vertex_tangents_tmp[i0].x += t.x;
+					physicscomponent->vertex_tangents_tmp[i0].y += t.y;
+					physicscomponent->vertex_tangents_tmp[i0].z += t.z;
+					physicscomponent->vertex_tangents_tmp[i0].w = sign;
+
+					physicscomponent->vertex_tangents_tmp[i1].x += t.x;
+					physicscomponent->vertex_tangents_tmp[i1].y += t.y;
+					physicscomponent->vertex_tangents_tmp[i1].z += t.z;
+					physicscomponent->vertex_tangents_tmp[i1].w = sign;
+
+					physicscomponent->vertex_tangents_tmp[i2].x += t.x;
+					physicscomponent->vertex_tangents_tmp[i2].y += t.y;
+					physicscomponent->vertex_tangents_tmp[i2].z += t.z;
+					physicscomponent->vertex_tangents_tmp[i2].w = sign;
+				}
+
+				for (size_t i = 0; i < physicscomponent->vertex_tangents_simulation.size(); ++i)
+				{
+					physicscomponent->vertex_tangents_simulation[i].FromFULL(physicscomponent->vertex_tangents_tmp[i]);
+				}
+			}
+
+		});
+	}
+#endif
+
 	void RunPhysicsUpdateSystem(
 		wiJobSystem::context& ctx,
 		Scene& scene,
@@ -340,10 +933,37 @@ namespace wiPhysicsEngine
 		if (!IsEnabled() || dt <= 0)
 			return;
 
+		Initialize();
+
 		auto range = wiProfiler::BeginRangeCPU("Physics");
 
+		static const wiCounters::counter_id counter_step_time = wiCounters::Register("Physics.StepTime", wiCounters::TYPE_HISTOGRAM);
+		static const wiCounters::counter_id counter_async_wait = wiCounters::Register("Physics.AsyncWait", wiCounters::TYPE_HISTOGRAM);
+		static const wiCounters::counter_id counter_active_bodies = wiCounters::Register("Physics.ActiveBodies");
+		static const wiCounters::counter_id counter_frozen_bodies = wiCounters::Register("Physics.FrozenBodies");
+
+		if (step_pending)
+		{
+			step_pending = false;
+			// The step that was started by the previous update is finished before the physics world is touched:
+			wiTimer timer;
+			wiJobSystem::Wait(step_ctx);
+			wiCounters::Sample(counter_async_wait, timer.elapsed());
+
+#ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
+			FeedbackSoftBodies(ctx, scene);
+			wiJobSystem::Wait(ctx);
+#endif
+			std::swap(step_results, applied_results);
+			step_results.clear();
+		}
+
 		btVector3 wind = btVector3(scene.weather.windDirection.x, scene.weather.windDirection.y, scene.weather.windDirection.z);
 
+		lod_frame++;
+		const float lod_freeze_sq = LOD_DISTANCE * LOD_DISTANCE;
+		const float lod_restore_sq = lod_freeze_sq * LOD_RESTORE * LOD_RESTORE;
+
 		// System will register rigidbodies to objects, and update physics engine state for kinematics:
 		wiJobSystem::Dispatch(ctx, (uint32_t)scene.rigidbodies.GetCount(), 256, [&](wiJobArgs args) {
 
@@ -360,7 +980,7 @@ namespace wiPhysicsEngine
 					mesh = scene.meshes.GetComponent(object->meshID);
 				}
 				physicsLock.lock();
-				AddRigidBody(entity, physicscomponent, transform, mesh);
+				AddRigidBody(entity, physicscomponent, transform, object != nullptr ? object->meshID : INVALID_ENTITY, mesh);
 				physicsLock.unlock();
 			}
 
@@ -368,6 +988,31 @@ namespace wiPhysicsEngine
 			{
 				btRigidBody* rigidbody = (btRigidBody*)physicscomponent.physicsobject;
 
+				const bool frozen = rigidbody->getBroadphaseHandle() == nullptr;
+				if (LOD_DISTANCE > 0 || frozen)
+				{
+					if (frozen && LOD_DISTANCE > 0 && (args.jobIndex + lod_frame) % LOD_INTERVAL != 0)
+						return;
+
+					const TransformComponent& transform = *scene.transforms.GetComponent(entity);
+					const float distance_sq = LOD_DISTANCE > 0 ? GetObserverDistanceSquared(transform.GetPosition()) : 0;
+					if (!frozen && distance_sq > lod_freeze_sq)
+					{
+						std::lock_guard<std::mutex> lock(physicsLock);
+						dynamicsWorld->removeRigidBody(rigidbody);
+						frozen_rigidbodies[rigidbody] = entity;
+						return;
+					}
+					if (frozen)
+					{
+						if (distance_sq > lod_restore_sq)
+							return;
+						std::lock_guard<std::mutex> lock(physicsLock);
+						dynamicsWorld->addRigidBody(rigidbody);
+						frozen_rigidbodies.erase(rigidbody);
+					}
+				}
+
 				int activationState = rigidbody->getActivationState();
 				if (physicscomponent.IsDisableDeactivation())
 				{
@@ -408,10 +1053,9 @@ namespace wiPhysicsEngine
 						rigidbody->setWorldTransform(physicsTransform);
 					}
 
-					btCollisionShape* shape = rigidbody->getCollisionShape();
 					XMFLOAT3 scale = transform.GetScale();
 					btVector3 S(scale.x, scale.y, scale.z);
-					shape->setLocalScaling(S);
+					SetShapeScaling(rigidbody, S);
 				}
 			}
 		});
@@ -426,15 +1070,6 @@ namespace wiPhysicsEngine
 			const ArmatureComponent* armature = mesh.IsSkinned() ? scene.armatures.GetComponent(mesh.armatureID) : nullptr;
 			mesh.SetDynamic(true);
 
-			if (!mesh.vertexBuffer_PRE.IsValid())
-			{
-				using namespace wiGraphics;
-				GraphicsDevice* device = wiRenderer::GetDevice();
-				device->CreateBuffer(&mesh.vertexBuffer_POS.desc, nullptr, &mesh.streamoutBuffer_POS);
-				device->CreateBuffer(&mesh.vertexBuffer_POS.desc, nullptr, &mesh.vertexBuffer_PRE);
-				device->CreateBuffer(&mesh.vertexBuffer_TAN.desc, nullptr, &mesh.streamoutBuffer_TAN);
-			}
-
 			if (physicscomponent._flags & SoftBodyPhysicsComponent::FORCE_RESET)
 			{
 				physicscomponent._flags &= ~SoftBodyPhysicsComponent::FORCE_RESET;
@@ -443,7 +1078,32 @@ namespace wiPhysicsEngine
 					((btSoftRigidDynamicsWorld*)dynamicsWorld.get())->removeSoftBody((btSoftBody*)physicscomponent.physicsobject);
 					physicscomponent.physicsobject = nullptr;
 				}
+				physicscomponent.cloth_reset = true;
 			}
+			// The GPU simulated cloth is not registered, the renderer simulates it:
+			if (physicscomponent.IsGPUSimulation())
+			{
+				return;
+			}
+			if (physicscomponent.clothParticleBuffer.IsValid())
+			{
+				physicscomponent.clothParticleBuffer = wiGraphics::GPUBuffer();
+				physicscomponent.clothPositionBuffer[0] = wiGraphics::GPUBuffer();
+				physicscomponent.clothPositionBuffer[1] = wiGraphics::GPUBuffer();
+				physicscomponent.clothConstraintBuffer = wiGraphics::GPUBuffer();
+				physicscomponent.clothRingBuffer = wiGraphics::GPUBuffer();
+				physicscomponent.clothMappingBuffer = wiGraphics::GPUBuffer();
+			}
+
+			if (!mesh.vertexBuffer_PRE.IsValid())
+			{
+				using namespace wiGraphics;
+				GraphicsDevice* device = wiRenderer::GetDevice();
+				device->CreateBuffer(&mesh.vertexBuffer_POS.desc, nullptr, &mesh.streamoutBuffer_POS);
+				device->CreateBuffer(&mesh.vertexBuffer_POS.desc, nullptr, &mesh.vertexBuffer_PRE);
+				device->CreateBuffer(&mesh.vertexBuffer_TAN.desc, nullptr, &mesh.streamoutBuffer_TAN);
+			}
+
 			if (physicscomponent._flags & SoftBodyPhysicsComponent::SAFE_TO_REGISTER && physicscomponent.physicsobject == nullptr)
 			{
 				physicsLock.lock();
@@ -484,13 +1144,15 @@ namespace wiPhysicsEngine
 #endif
 		wiJobSystem::Wait(ctx);
 
-		// Perform internal simulation step:
-		if (IsSimulationEnabled())
-		{
-			dynamicsWorld->stepSimulation(dt, ACCURACY);
-		}
+		// The kinematic inputs are latched at this point, the forces and impulses that were queued meanwhile are applied now:
+		FlushCommands();
 
-		// Feedback physics engine state to system:
+		// Remove the physics objects of the removed components, and collect the ones that give feedback:
+		static std::vector<std::pair<btRigidBody*, Entity>> feedback_rigidbodies;
+		feedback_rigidbodies.clear();
+#ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
+		feedback_softbodies.clear();
+#endif
 		for (int i = 0; i < dynamicsWorld->getCollisionObjectArray().size(); ++i)
 		{
 			btCollisionObject* collisionobject = dynamicsWorld->getCollisionObjectArray()[i];
@@ -503,25 +1165,17 @@ namespace wiPhysicsEngine
 				if (physicscomponent == nullptr || physicscomponent->physicsobject != rigidbody)
 				{
 					dynamicsWorld->removeRigidBody(rigidbody);
+					ReleaseShape(rigidbody->getCollisionShape());
+					delete rigidbody->getMotionState();
+					delete rigidbody;
 					i--;
 					continue;
 				}
 
-				// Feedback non-kinematic objects to system:
-				if (IsSimulationEnabled() && !physicscomponent->IsKinematic())
+				// Feedback non-kinematic objects to system, sleeping ones didn't move:
+				if (IsSimulationEnabled() && !physicscomponent->IsKinematic() && rigidbody->isActive())
 				{
-					TransformComponent& transform = *scene.transforms.GetComponent(entity);
-
-					btMotionState* motionState = rigidbody->getMotionState();
-					btTransform physicsTransform;
-
-					motionState->getWorldTransform(physicsTransform);
-					btVector3 T = physicsTransform.getOrigin();
-					btQuaternion R = physicsTransform.getRotation();
-
-					transform.translation_local = XMFLOAT3(T.x(), T.y(), T.z());
-					transform.rotation_local = XMFLOAT4(R.x(), R.y(), R.z(), R.w());
-					transform.SetDirty();
+					feedback_rigidbodies.push_back(std::make_pair(rigidbody, entity));
 				}
 			}
 			else
@@ -538,115 +1192,84 @@ namespace wiPhysicsEngine
 						i--;
 						continue;
 					}
-
-					MeshComponent& mesh = *scene.meshes.GetComponent(entity);
-
-					// System mesh aabb will be queried from physics engine soft body:
-					btVector3 aabb_min;
-					btVector3 aabb_max;
-					softbody->getAabb(aabb_min, aabb_max);
-					physicscomponent->aabb = AABB(XMFLOAT3(aabb_min.x(), aabb_min.y(), aabb_min.z()), XMFLOAT3(aabb_max.x(), aabb_max.y(), aabb_max.z()));
-
-					// Soft body simulation nodes will update graphics mesh:
-					for (size_t ind = 0; ind < physicscomponent->vertex_positions_simulation.size(); ++ind)
-					{
-						uint32_t physicsInd = physicscomponent->graphicsToPhysicsVertexMapping[ind];
-						float weight = physicscomponent->weights[physicsInd];
-
-						btSoftBody::Node& node = softbody->m_nodes[physicsInd];
-
-						MeshComponent::Vertex_POS& vertex = physicscomponent->vertex_positions_simulation[ind];
-						vertex.pos.x = node.m_x.getX();
-						vertex.pos.y = node.m_x.getY();
-						vertex.pos.z = node.m_x.getZ();
-
-						XMFLOAT3 normal;
-						normal.x = -node.m_n.getX();
-						normal.y = -node.m_n.getY();
-						normal.z = -node.m_n.getZ();
-						vertex.MakeFromParams(normal);
-					}
-
-					// Update tangent vectors:
-					if (!mesh.vertex_uvset_0.empty())
-					{
-						for (size_t i = 0; i < mesh.indices.size(); i += 3)
-						{
-							const uint32_t i0 = mesh.indices[i + 0];
-							const uint32_t i1 = mesh.indices[i + 1];
-							const uint32_t i2 = mesh.indices[i + 2];
-
-							const XMFLOAT3 v0 = physicscomponent->vertex_positions_simulation[i0].pos;
-							const XMFLOAT3 v1 = physicscomponent->vertex_positions_simulation[i1].pos;
-							const XMFLOAT3 v2 = physicscomponent->vertex_positions_simulation[i2].pos;
-
-							const XMFLOAT2 u0 = mesh.vertex_uvset_0[i0];
-							const XMFLOAT2 u1 = mesh.vertex_uvset_0[i1];
-							const XMFLOAT2 u2 = mesh.vertex_uvset_0[i2];
-
-							const XMVECTOR nor0 = physicscomponent->vertex_positions_simulation[i0].LoadNOR();
-							const XMVECTOR nor1 = physicscomponent->vertex_positions_simulation[i1].LoadNOR();
-							const XMVECTOR nor2 = physicscomponent->vertex_positions_simulation[i2].LoadNOR();
-
-							const XMVECTOR facenormal = XMVector3Normalize(XMVectorAdd(XMVectorAdd(nor0, nor1), nor2));
-
-							const float x1 = v1.x - v0.x;
-							const float x2 = v2.x - v0.x;
-							const float y1 = v1.y - v0.y;
-							const float y2 = v2.y - v0.y;
-							const float z1 = v1.z - v0.z;
-							const float z2 = v2.z - v0.z;
-
-							const float s1 = u1.x - u0.x;
-							const float s2 = u2.x - u0.x;
-							const float t1 = u1.y - u0.y;
-							const float t2 = u2.y - u0.y;
-
-							const float r = 1.0f / (s1 * t2 - s2 * t1);
-							const XMVECTOR sdir = XMVectorSet((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r,
-								(t2 * z1 - t1 * z2) * r, 0);
-							const XMVECTOR tdir = XMVectorSet((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r,
-								(s1 * z2 - s2 * z1) * r, 0);
-
-							XMVECTOR tangent;
-							tangent = XMVector3Normalize(XMVectorSubtract(sdir, XMVectorMultiply(facenormal, XMVector3Dot(facenormal, sdir))));
-							float sign = XMVectorGetX(XMVector3Dot(XMVector3Cross(tangent, facenormal), tdir)) < 0.0f ? -1.0f : 1.0f;
-
-							XMFLOAT3 t;
-							XMStoreFloat3(&t, tangent);
-
-							physicscomponent->vertex_tangents_tmp[i0].x += t.x;
-							physicscomponent->vertex_tangents_tmp[i0].y += t.y;
-							physicscomponent->vertex_tangents_tmp[i0].z += t.z;
-							physicscomponent->vertex_tangents_tmp[i0].w = sign;
-
-							physicscomponent->vertex_tangents_tmp[i1].x += t.x;
-							physicscomponent->vertex_tangents_tmp[i1].y += t.y;
-							physicscomponent->vertex_tangents_tmp[i1].z += t.z;
-							physicscomponent->vertex_tangents_tmp[i1].w = sign;
-
-							physicscomponent->vertex_tangents_tmp[i2].x += t.x;
-							physicscomponent->vertex_tangents_tmp[i2].y += t.y;
-							physicscomponent->vertex_tangents_tmp[i2].z += t.z;
-							physicscomponent->vertex_tangents_tmp[i2].w = sign;
-						}
-
-						for (size_t i = 0; i < physicscomponent->vertex_tangents_simulation.size(); ++i)
-						{
-							physicscomponent->vertex_tangents_simulation[i].FromFULL(physicscomponent->vertex_tangents_tmp[i]);
-						}
-					}
-
+					feedback_softbodies.push_back(std::make_pair(softbody, entity));
 				}
 #endif
 			}
 		}
 
+		// The frozen bodies of removed components are not in the world, they are looked for every LOD_INTERVAL frames:
+		if (lod_frame % LOD_INTERVAL == 0)
+		{
+			for (auto it = frozen_rigidbodies.begin(); it != frozen_rigidbodies.end();)
+			{
+				btRigidBody* rigidbody = it->first;
+				const RigidBodyPhysicsComponent* physicscomponent = scene.rigidbodies.GetComponent(it->second);
+				if (physicscomponent == nullptr || physicscomponent->physicsobject != rigidbody)
+				{
+					ReleaseShape(rigidbody->getCollisionShape());
+					delete rigidbody->getMotionState();
+					delete rigidbody;
+					it = frozen_rigidbodies.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+		wiCounters::Set(counter_active_bodies, (double)feedback_rigidbodies.size());
+		wiCounters::Set(counter_frozen_bodies, (double)frozen_rigidbodies.size());
+
 		if (IsDebugDrawEnabled())
 		{
 			dynamicsWorld->debugDrawWorld();
 		}
 
+		// Perform internal simulation step:
+		if (IsSimulationEnabled() && ASYNC_ENABLED)
+		{
+			// The results of this step are applied by the next update, until then the results of the previous step are applied:
+			step_pending = true;
+			wiJobSystem::Execute(step_ctx, [dt](wiJobArgs args) {
+				wiTimer timer;
+				dynamicsWorld->stepSimulation(dt, ACCURACY);
+				CaptureResults(feedback_rigidbodies, step_results);
+				wiCounters::Sample(counter_step_time, timer.elapsed());
+			});
+		}
+		else
+		{
+			if (IsSimulationEnabled())
+			{
+				wiTimer timer;
+				dynamicsWorld->stepSimulation(dt, ACCURACY);
+				CaptureResults(feedback_rigidbodies, applied_results);
+				wiCounters::Sample(counter_step_time, timer.elapsed());
+			}
+#ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
+			FeedbackSoftBodies(ctx, scene);
+#endif
+		}
+
+		// Feedback physics engine state to system, every physics object writes only its own components:
+		wiJobSystem::Dispatch(ctx, (uint32_t)applied_results.size(), 64, [&](wiJobArgs args) {
+			const RigidBodyResult& result = applied_results[args.jobIndex];
+
+			// The component could have been removed or made kinematic since the step was started:
+			const RigidBodyPhysicsComponent* physicscomponent = scene.rigidbodies.GetComponent(result.entity);
+			TransformComponent* transform = scene.transforms.GetComponent(result.entity);
+			if (physicscomponent == nullptr || physicscomponent->physicsobject != result.rigidbody || physicscomponent->IsKinematic() || transform == nullptr)
+				return;
+
+			transform->translation_local = result.position;
+			transform->rotation_local = result.rotation;
+			transform->SetDirty();
+			scene.transforms.MarkChanged(result.entity);
+		});
+		wiJobSystem::Wait(ctx);
+		applied_results.clear();
+
 		wiProfiler::EndRange(range); // Physics
 	}
 
@@ -659,8 +1282,7 @@ namespace wiPhysicsEngine
 	{
 		if (physicscomponent.physicsobject != nullptr)
 		{
-			btRigidBody* rigidbody = (btRigidBody*)physicscomponent.physicsobject;
-			rigidbody->applyCentralForce(btVector3(force.x, force.y, force.z));
+			ApplyCommand({ RigidBodyCommand::FORCE, (btRigidBody*)physicscomponent.physicsobject, btVector3(force.x, force.y, force.z), btVector3(0, 0, 0) });
 		}
 	}
 	void ApplyForceAt(
@@ -671,8 +1293,7 @@ namespace wiPhysicsEngine
 	{
 		if (physicscomponent.physicsobject != nullptr)
 		{
-			btRigidBody* rigidbody = (btRigidBody*)physicscomponent.physicsobject;
-			rigidbody->applyForce(btVector3(force.x, force.y, force.z), btVector3(at.x, at.y, at.z));
+			ApplyCommand({ RigidBodyCommand::FORCE_AT, (btRigidBody*)physicscomponent.physicsobject, btVector3(force.x, force.y, force.z), btVector3(at.x, at.y, at.z) });
 		}
 	}
 
@@ -683,8 +1304,7 @@ namespace wiPhysicsEngine
 	{
 		if (physicscomponent.physicsobject != nullptr)
 		{
-			btRigidBody* rigidbody = (btRigidBody*)physicscomponent.physicsobject;
-			rigidbody->applyCentralImpulse(btVector3(impulse.x, impulse.y, impulse.z));
+			ApplyCommand({ RigidBodyCommand::IMPULSE, (btRigidBody*)physicscomponent.physicsobject, btVector3(impulse.x, impulse.y, impulse.z), btVector3(0, 0, 0) });
 		}
 	}
 	void ApplyImpulseAt(
@@ -695,8 +1315,236 @@ namespace wiPhysicsEngine
 	{
 		if (physicscomponent.physicsobject != nullptr)
 		{
-			btRigidBody* rigidbody = (btRigidBody*)physicscomponent.physicsobject;
-			rigidbody->applyImpulse(btVector3(impulse.x, impulse.y, impulse.z), btVector3(at.x, at.y, at.z));
+			ApplyCommand({ RigidBodyCommand::IMPULSE_AT, (btRigidBody*)physicscomponent.physicsobject, btVector3(impulse.x, impulse.y, impulse.z), btVector3(at.x, at.y, at.z) });
+		}
+	}
+
+
+	// The queries walk the broadphase trees with the re-entrant btDbvt traversals, because btDbvtBroadphase::rayTest() uses a shared stack
+	//	The narrow phase of ray and sweep tests is re-entrant. The overlap tests need collision algorithms from the dispatcher, its pool allocator is not thread safe, so they are serialized
+	std::mutex queryLock;
+
+	// Calls func(btCollisionObject*) for every rigid body in the broadphase that the query can hit
+	template<typename F>
+	struct QueryCollider : btDbvt::ICollide
+	{
+		Entity ignore;
+		F func;
+		QueryCollider(Entity ignore, F&& func) : ignore(ignore), func(std::move(func)) {}
+		void Process(const btDbvtNode* leaf) override
+		{
+			btBroadphaseProxy* proxy = (btBroadphaseProxy*)leaf->data;
+			btCollisionObject* collisionobject = (btCollisionObject*)proxy->m_clientObject;
+			if (btRigidBody::upcast(collisionobject) == nullptr || (Entity)collisionobject->getUserIndex() == ignore)
+				return;
+			func(collisionobject, proxy);
+		}
+	};
+	template<typename F>
+	void QueryRay(const btVector3& from, const btVector3& to, Entity ignore, F&& func)
+	{
+		QueryCollider<F> collider(ignore, std::move(func));
+		btDbvt::rayTest(overlappingPairCache.m_sets[0].m_root, from, to, collider);
+		btDbvt::rayTest(overlappingPairCache.m_sets[1].m_root, from, to, collider);
+	}
+	template<typename F>
+	void QueryVolume(const btVector3& aabb_min, const btVector3& aabb_max, Entity ignore, F&& func)
+	{
+		QueryCollider<F> collider(ignore, std::move(func));
+		const btDbvtVolume volume = btDbvtVolume::FromMM(aabb_min, aabb_max);
+		overlappingPairCache.m_sets[0].collideTV(overlappingPairCache.m_sets[0].m_root, volume, collider);
+		overlappingPairCache.m_sets[1].collideTV(overlappingPairCache.m_sets[1].m_root, volume, collider);
+	}
+
+	// Calls func(btConvexShape&) with the temporary Bullet shape of a query
+	template<typename F>
+	void WithQueryShape(const QueryShape& shape, F&& func)
+	{
+		switch (shape.type)
+		{
+		case QueryShape::BOX:
+		{
+			btBoxShape box(btVector3(shape.halfextents.x, shape.halfextents.y, shape.halfextents.z));
+			func(box);
+		}
+		break;
+		case QueryShape::CAPSULE:
+		{
+			btCapsuleShape capsule(btScalar(shape.radius), btScalar(shape.height));
+			func(capsule);
+		}
+		break;
+		default:
+		{
+			btSphereShape sphere(btScalar(shape.radius));
+			func(sphere);
+		}
+		break;
+		}
+	}
+
+	// The queries read the world, so the simulation step must not be running:
+	void WaitForStep()
+	{
+		wiJobSystem::Wait(step_ctx);
+	}
+
+	void RayCast(const RayQuery* queries, uint32_t count, QueryHit* results)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			results[i] = QueryHit();
+		}
+		if (!IsEnabled() || count == 0)
+			return;
+		WaitForStep();
+
+		wiJobSystem::context ctx;
+		wiJobSystem::Dispatch(ctx, count, 16, [&](wiJobArgs args) {
+			const RayQuery& query = queries[args.jobIndex];
+			QueryHit& result = results[args.jobIndex];
+
+			btVector3 from(query.origin.x, query.origin.y, query.origin.z);
+			btVector3 to = from + btVector3(query.direction.x, query.direction.y, query.direction.z) * query.distance;
+			btTransform fromTrans, toTrans;
+			fromTrans.setIdentity();
+			fromTrans.setOrigin(from);
+			toTrans.setIdentity();
+			toTrans.setOrigin(to);
+
+			btCollisionWorld::ClosestRayResultCallback callback(from, to);
+			QueryRay(from, to, query.ignore, [&](btCollisionObject* collisionobject, btBroadphaseProxy* proxy) {
+				if (callback.needsCollision(proxy))
+				{
+					btCollisionWorld::rayTestSingle(fromTrans, toTrans, collisionobject, collisionobject->getCollisionShape(), collisionobject->getWorldTransform(), callback);
+				}
+			});
+
+			if (callback.hasHit())
+			{
+				result.entity = (Entity)callback.m_collisionObject->getUserIndex();
+				result.position = XMFLOAT3(callback.m_hitPointWorld.x(), callback.m_hitPointWorld.y(), callback.m_hitPointWorld.z());
+				btVector3 normal = callback.m_hitNormalWorld.normalized();
+				result.normal = XMFLOAT3(normal.x(), normal.y(), normal.z());
+				result.distance = callback.m_closestHitFraction * query.distance;
+			}
+		});
+		wiJobSystem::Wait(ctx);
+	}
+
+	void SweepTest(const SweepQuery* queries, uint32_t count, QueryHit* results)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			results[i] = QueryHit();
+		}
+		if (!IsEnabled() || count == 0)
+			return;
+		WaitForStep();
+
+		wiJobSystem::context ctx;
+		wiJobSystem::Dispatch(ctx, count, 16, [&](wiJobArgs args) {
+			const SweepQuery& query = queries[args.jobIndex];
+			QueryHit& result = results[args.jobIndex];
+
+			btVector3 from(query.origin.x, query.origin.y, query.origin.z);
+			btVector3 to = from + btVector3(query.direction.x, query.direction.y, query.direction.z) * query.distance;
+			btQuaternion rotation(query.rotation.x, query.rotation.y, query.rotation.z, query.rotation.w);
+			btTransform fromTrans(rotation, from);
+			btTransform toTrans(rotation, to);
+
+			WithQueryShape(query.shape, [&](btConvexShape& shape) {
+				// The broadphase candidates are the ones that overlap the bounds of the whole sweep:
+				btVector3 aabb_min, aabb_max, to_min, to_max;
+				shape.getAabb(fromTrans, aabb_min, aabb_max);
+				shape.getAabb(toTrans, to_min, to_max);
+				aabb_min.setMin(to_min);
+				aabb_max.setMax(to_max);
+
+				btCollisionWorld::ClosestConvexResultCallback callback(from, to);
+				QueryVolume(aabb_min, aabb_max, query.ignore, [&](btCollisionObject* collisionobject, btBroadphaseProxy* proxy) {
+					if (callback.needsCollision(proxy))
+					{
+						btCollisionWorld::objectQuerySingle(&shape, fromTrans, toTrans, collisionobject, collisionobject->getCollisionShape(), collisionobject->getWorldTransform(), callback, 0);
+					}
+				});
+
+				if (callback.hasHit())
+				{
+					result.entity = (Entity)callback.m_hitCollisionObject->getUserIndex();
+					result.position = XMFLOAT3(callback.m_hitPointWorld.x(), callback.m_hitPointWorld.y(), callback.m_hitPointWorld.z());
+					btVector3 normal = callback.m_hitNormalWorld.normalized();
+					result.normal = XMFLOAT3(normal.x(), normal.y(), normal.z());
+					result.distance = callback.m_closestHitFraction * query.distance;
+				}
+			});
+		});
+		wiJobSystem::Wait(ctx);
+	}
+
+	void OverlapTest(const OverlapQuery* queries, uint32_t count, OverlapResult* results, std::vector<wiECS::Entity>& entities)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			results[i] = OverlapResult();
+		}
+		if (!IsEnabled() || count == 0)
+			return;
+		WaitForStep();
+
+		struct ContactCallback : btCollisionWorld::ContactResultCallback
+		{
+			bool hit = false;
+			btScalar addSingleResult(btManifoldPoint& cp, const btCollisionObjectWrapper* colObj0Wrap, int partId0, int index0, const btCollisionObjectWrapper* colObj1Wrap, int partId1, int index1) override
+			{
+				hit = hit || cp.getDistance() <= 0;
+				return 0;
+			}
+		};
+
+		std::vector<std::vector<Entity>> overlaps(count);
+
+		wiJobSystem::context ctx;
+		wiJobSystem::Dispatch(ctx, count, 4, [&](wiJobArgs args) {
+			const OverlapQuery& query = queries[args.jobIndex];
+			std::vector<Entity>& overlap = overlaps[args.jobIndex];
+
+			btTransform transform(
+				btQuaternion(query.rotation.x, query.rotation.y, query.rotation.z, query.rotation.w),
+				btVector3(query.position.x, query.position.y, query.position.z)
+			);
+
+			WithQueryShape(query.shape, [&](btConvexShape& shape) {
+				btCollisionObject queryobject;
+				queryobject.setCollisionShape(&shape);
+				queryobject.setWorldTransform(transform);
+
+				btVector3 aabb_min, aabb_max;
+				shape.getAabb(transform, aabb_min, aabb_max);
+
+				QueryVolume(aabb_min, aabb_max, query.ignore, [&](btCollisionObject* collisionobject, btBroadphaseProxy* proxy) {
+					ContactCallback callback;
+					if (!callback.needsCollision(proxy))
+						return;
+					{
+						std::lock_guard<std::mutex> lock(queryLock);
+						dynamicsWorld->contactPairTest(&queryobject, collisionobject, callback);
+					}
+					if (callback.hit)
+					{
+						overlap.push_back((Entity)collisionobject->getUserIndex());
+					}
+				});
+			});
+		});
+		wiJobSystem::Wait(ctx);
+
+		// The results are flattened in query order:
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			results[i].offset = (uint32_t)entities.size();
+			results[i].count = (uint32_t)overlaps[i].size();
+			entities.insert(entities.end(), overlaps[i].begin(), overlaps[i].end());
 		}
 	}
 
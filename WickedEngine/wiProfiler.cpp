@@ -6,6 +6,9 @@
 #include "wiTimer.h"
 #include "wiTextureHelper.h"
 #include "wiHelper.h"
+#include "wiJobSystem.h"
+#include "wiBackLog.h"
+#include "wiMemoryTracker.h"
 
 #include <string>
 #include <unordered_map>
@@ -13,6 +16,11 @@
 #include <mutex>
 #include <atomic>
 #include <sstream>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <cstring>
 
 using namespace wiGraphics;
 
@@ -34,6 +42,7 @@ namespace wiProfiler
 	std::mutex lock;
 	range_id cpu_frame;
 	range_id gpu_frame;
+	float gpu_frame_time = 0; // last measured "GPU Frame" range, before averaging
 	GPUQueryHeap queryHeap[wiGraphics::GraphicsDevice::GetBufferCount() + 1];
 	std::vector<uint64_t> queryResults;
 	std::atomic<uint32_t> nextQuery{ 0 };
@@ -49,7 +58,9 @@ namespace wiProfiler
 		float time = 0;
 		CommandList cmd = COMMANDLIST_COUNT;
 
-		wiTimer cpuBegin, cpuEnd;
+		float cpu_time = 0; // CPU: sum of the ranges with this name that ended in the current frame
+		uint32_t cpu_hits = 0; // CPU: count of the ranges with this name that ended in the current frame
+		uint32_t hits = 1; // count of ranges that were measured by the last frame's time
 
 		int gpuBegin[arraysize(queryHeap)];
 		int gpuEnd[arraysize(queryHeap)];
@@ -59,8 +70,660 @@ namespace wiProfiler
 	std::unordered_map<size_t, Range> ranges;
 	std::vector<range_id> rangeOrder[COMMANDLIST_COUNT + 1];
 
+	// CPU ranges are recorded as begin and end events into a ring buffer of the thread, that is written only by that thread without locking
+	//	EndFrame() reads the events of every thread and matches them into ranges
+	//	A range id of the CPU has the CPU_RANGE bit set, the thread index in bits [16, 32) and the nesting depth in bits [0, 16)
+	static constexpr uint32_t CPU_EVENT_CAPACITY = 4096; // per thread
+	static constexpr range_id CPU_RANGE = range_id(1) << (sizeof(range_id) * 8 - 1);
+	static constexpr range_id CPU_RANGE_DROPPED = range_id(1) << (sizeof(range_id) * 8 - 2);
+	enum CPU_EVENT_TYPE : uint8_t
+	{
+		CPU_EVENT_BEGIN,
+		CPU_EVENT_END, // the name is not stored
+		CPU_EVENT_MARK, // MarkEvent()
+	};
+	struct CPUEvent
+	{
+		const char* name;
+		uint64_t timestamp;
+		uint16_t thread;
+		uint16_t depth;
+		CPU_EVENT_TYPE type;
+	};
+	struct CPUThreadEvents
+	{
+		CPUEvent events[CPU_EVENT_CAPACITY];
+		std::atomic<uint64_t> write{ 0 }; // written by the owner thread
+		std::atomic<uint64_t> read{ 0 }; // written by EndFrame()
+		uint32_t depth = 0; // owner thread only: count of open ranges
+		uint32_t reserved = 0; // owner thread only: count of recorded open ranges, the space of their end events is reserved
+		uint16_t thread = 0;
+		uint32_t worker = ~0u; // job system worker index of the thread
+
+		std::vector<CPUEvent> open; // EndFrame() only: begin events that were not ended yet
+	};
+	std::mutex cpu_threads_lock; // only for adding a thread, and for reading the threads in EndFrame()
+	std::vector<std::unique_ptr<CPUThreadEvents>> cpu_threads;
+	thread_local CPUThreadEvents* cpu_thread_events = nullptr;
+	std::unordered_map<const char*, range_id> cpu_range_keys; // EndFrame() only: name -> key of ranges
+	std::atomic<uint32_t> cpu_events_dropped{ 0 };
+
+	// Trace recording, only accessed by the thread that calls BeginFrame() and EndFrame()
+	//	The frames are recorded while a capture is in progress or the spike detection is enabled, the spike detection keeps only the last frames
+	static constexpr uint32_t CAPTURE_GPU_TRACK = 1000; // the GPU track of a command list is CAPTURE_GPU_TRACK + cmd, the CPU tracks are the thread indices
+	struct CaptureEvent
+	{
+		std::string name;
+		uint32_t track = 0;
+		double begin = 0; // microseconds since the recording started
+		double duration = 0; // microseconds, negative for a marked event
+	};
+	struct CaptureCounter
+	{
+		const char* name = nullptr;
+		double time = 0; // microseconds since the recording started
+		double value = 0;
+	};
+	struct CaptureFrame
+	{
+		uint64_t index = 0;
+		float time = 0; // milliseconds since the previous frame
+		std::vector<CaptureEvent> events;
+		std::vector<CaptureCounter> counters;
+		std::vector<const char*> reasons; // the names of the marked events in the frame
+	};
+	std::deque<CaptureFrame> capture_frames; // the last one is the current frame, the indices are consecutive
+	uint64_t capture_frame_index = 0;
+	uint64_t capture_start = 0;
+	wiTimer capture_frame_timer;
+	uint16_t capture_main_thread = 0;
+	bool capture_disable_profiler = false; // the profiler was enabled by the recording
+	bool queryHeapCaptured[arraysize(queryHeap)] = {}; // the heap was written in a recorded frame
+	uint64_t queryHeapFrame[arraysize(queryHeap)] = {}; // the recorded frame that wrote the heap
+	uint64_t queryHeapSubmitted[arraysize(queryHeap)] = {}; // the CPU timestamp when the heap's frame was submitted
+
+	// BeginCapture():
+	std::string capture_filename;
+	uint64_t capture_first = 0; // the first frame of the capture
+	uint64_t capture_last = 0;
+	uint32_t capture_recording = 0; // count of frames that are still recorded
+	uint32_t capture_draining = 0; // count of frames that are waited for the GPU results after the recording
+
+	// SetSpikeDetectionEnabled():
+	bool spike_enabled = false;
+	SpikeDetection spike_desc;
+	uint64_t spike_frame = ~0ull; // the detected spike that will be written
+	uint64_t spike_written = 0; // frames up to this one were already written, the next spike must be after it
+
+	bool IsRecording()
+	{
+		return capture_recording > 0 || capture_draining > 0 || spike_enabled;
+	}
+	CaptureFrame* GetCaptureFrame(uint64_t index)
+	{
+		if (capture_frames.empty() || index < capture_frames.front().index || index > capture_frames.back().index)
+			return nullptr;
+		return &capture_frames[size_t(index - capture_frames.front().index)];
+	}
+
+	inline uint64_t CPUTimestamp()
+	{
+		return (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+	}
+	CPUThreadEvents& GetCPUThreadEvents()
+	{
+		if (cpu_thread_events == nullptr)
+		{
+			std::lock_guard<std::mutex> guard(cpu_threads_lock);
+			cpu_threads.push_back(std::make_unique<CPUThreadEvents>());
+			cpu_thread_events = cpu_threads.back().get();
+			cpu_thread_events->thread = (uint16_t)(cpu_threads.size() - 1);
+			cpu_thread_events->worker = wiJobSystem::GetCurrentWorkerIndex();
+		}
+		return *cpu_thread_events;
+	}
+	void EndRangeCPU(range_id id)
+	{
+		CPUThreadEvents& events = GetCPUThreadEvents();
+		if (((id >> 16) & 0xFFFF) != events.thread)
+		{
+			assert(0); // the range must be ended on the thread that it was begun on
+			return;
+		}
+		if (events.depth > 0)
+		{
+			events.depth--;
+		}
+		if (id & CPU_RANGE_DROPPED)
+			return;
+
+		const uint64_t write = events.write.load(std::memory_order_relaxed);
+		CPUEvent& event = events.events[write % CPU_EVENT_CAPACITY];
+		event.name = nullptr;
+		event.timestamp = CPUTimestamp();
+		event.thread = events.thread;
+		event.depth = (uint16_t)(id & 0xFFFF);
+		event.type = CPU_EVENT_END;
+		if (events.reserved > 0)
+		{
+			events.reserved--;
+		}
+		events.write.store(write + 1, std::memory_order_release);
+	}
+	// Read the recorded CPU events of every thread and add the ended ranges to the current frame
+	void MergeCPUEvents()
+	{
+		const double ticks_to_milliseconds = 1000.0 * (double)std::chrono::high_resolution_clock::period::num / (double)std::chrono::high_resolution_clock::period::den;
+
+		std::lock_guard<std::mutex> guard(cpu_threads_lock);
+		lock.lock();
+		for (auto& x : cpu_threads)
+		{
+			CPUThreadEvents& events = *x;
+			uint64_t read = events.read.load(std::memory_order_relaxed);
+			const uint64_t write = events.write.load(std::memory_order_acquire);
+			for (; read < write; ++read)
+			{
+				const CPUEvent& event = events.events[read % CPU_EVENT_CAPACITY];
+				if (event.type == CPU_EVENT_BEGIN)
+				{
+					events.open.push_back(event);
+					continue;
+				}
+				if (event.type == CPU_EVENT_MARK)
+				{
+					if (!capture_frames.empty() && event.timestamp >= capture_start)
+					{
+						CaptureFrame& frame = capture_frames.back();
+						CaptureEvent& capture = frame.events.emplace_back();
+						capture.name = event.name;
+						capture.track = event.thread;
+						capture.begin = (double)(event.timestamp - capture_start) * ticks_to_milliseconds * 1000.0;
+						capture.duration = -1;
+						if (std::find(frame.reasons.begin(), frame.reasons.end(), event.name) == frame.reasons.end())
+						{
+							frame.reasons.push_back(event.name);
+						}
+					}
+					continue;
+				}
+
+				// The begin event with the same depth, the open ones after it were discarded by SetEnabled():
+				auto it = std::find_if(events.open.rbegin(), events.open.rend(), [&](const CPUEvent& begin) { return begin.depth == event.depth; });
+				if (it == events.open.rend())
+					continue;
+				const CPUEvent begin = *it;
+				events.open.erase(std::next(it).base(), events.open.end());
+
+				range_id key;
+				auto key_it = cpu_range_keys.find(begin.name);
+				if (key_it == cpu_range_keys.end())
+				{
+					// Ranges with the same name are summed, but they must not be mixed with a GPU range of the same name:
+					key = wiHelper::string_hash(begin.name);
+					size_t differentiator = 0;
+					auto range_it = ranges.find(key);
+					while (range_it != ranges.end() && !range_it->second.IsCPURange())
+					{
+						wiHelper::hash_combine(key, differentiator++);
+						range_it = ranges.find(key);
+					}
+					cpu_range_keys[begin.name] = key;
+				}
+				else
+				{
+					key = key_it->second;
+				}
+
+				Range& range = ranges[key];
+				if (range.name.empty())
+				{
+					range.name = begin.name;
+					rangeOrder[0].push_back(key);
+				}
+				range.cpu_time += (float)((double)(event.timestamp - begin.timestamp) * ticks_to_milliseconds);
+				range.cpu_hits++;
+
+				if (!capture_frames.empty() && begin.timestamp >= capture_start)
+				{
+					CaptureEvent& capture = capture_frames.back().events.emplace_back();
+					capture.name = begin.name;
+					capture.track = begin.thread;
+					capture.begin = (double)(begin.timestamp - capture_start) * ticks_to_milliseconds * 1000.0;
+					capture.duration = (double)(event.timestamp - begin.timestamp) * ticks_to_milliseconds * 1000.0;
+				}
+			}
+			events.read.store(read, std::memory_order_release);
+		}
+		lock.unlock();
+	}
+
+	double CaptureTime(uint64_t timestamp)
+	{
+		const double ticks_to_microseconds = 1000000.0 * (double)std::chrono::high_resolution_clock::period::num / (double)std::chrono::high_resolution_clock::period::den;
+		return timestamp > capture_start ? (double)(timestamp - capture_start) * ticks_to_microseconds : 0;
+	}
+	void WriteTraceString(std::stringstream& ss, const std::string& str)
+	{
+		ss << '"';
+		for (char c : str)
+		{
+			if (c == '"' || c == '\\')
+			{
+				ss << '\\' << c;
+			}
+			else if ((unsigned char)c >= 0x20)
+			{
+				ss << c;
+			}
+		}
+		ss << '"';
+	}
+	// Write the recorded frames [first, last] into a Chrome trace JSON file
+	bool WriteCapture(uint64_t first, uint64_t last, const std::string& fileName)
+	{
+		std::stringstream ss;
+		ss.precision(3);
+		ss << std::fixed;
+		ss << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+
+		bool separator_needed = false;
+		auto separator = [&] {
+			if (separator_needed)
+			{
+				ss << "," << std::endl;
+			}
+			separator_needed = true;
+		};
+
+		// Track names:
+		std::vector<uint32_t> tracks;
+		for (uint64_t index = first; index <= last; ++index)
+		{
+			const CaptureFrame* frame = GetCaptureFrame(index);
+			if (frame == nullptr)
+				continue;
+			for (auto& x : frame->events)
+			{
+				if (std::find(tracks.begin(), tracks.end(), x.track) == tracks.end())
+				{
+					tracks.push_back(x.track);
+				}
+			}
+		}
+		for (uint32_t track : tracks)
+		{
+			std::string name;
+			if (track >= CAPTURE_GPU_TRACK)
+			{
+				name = "GPU (command list " + std::to_string(track - CAPTURE_GPU_TRACK) + ")";
+			}
+			else if (track == capture_main_thread)
+			{
+				name = "Main Thread";
+			}
+			else
+			{
+				cpu_threads_lock.lock();
+				const uint32_t worker = track < cpu_threads.size() ? cpu_threads[track]->worker : ~0u;
+				cpu_threads_lock.unlock();
+				name = worker == ~0u ? ("Thread " + std::to_string(track)) : ("Worker " + std::to_string(worker));
+			}
+			separator();
+			ss << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << track << ",\"args\":{\"name\":";
+			WriteTraceString(ss, name);
+			ss << "}}";
+			separator();
+			ss << "{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":0,\"tid\":" << track << ",\"args\":{\"sort_index\":" << (track == capture_main_thread ? 0 : track + 1) << "}}";
+		}
+
+		size_t count = 0;
+		for (uint64_t index = first; index <= last; ++index)
+		{
+			const CaptureFrame* frame = GetCaptureFrame(index);
+			if (frame == nullptr)
+				continue;
+			for (auto& x : frame->events)
+			{
+				separator();
+				ss << "{\"name\":";
+				WriteTraceString(ss, x.name);
+				if (x.duration < 0)
+				{
+					ss << ",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":" << x.track << ",\"ts\":" << x.begin << "}";
+				}
+				else
+				{
+					ss << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << x.track << ",\"ts\":" << x.begin << ",\"dur\":" << x.duration << "}";
+				}
+				count++;
+			}
+			for (auto& x : frame->counters)
+			{
+				separator();
+				ss << "{\"name\":";
+				WriteTraceString(ss, x.name);
+				ss << ",\"ph\":\"C\",\"pid\":0,\"ts\":" << x.time << ",\"args\":{\"value\":" << x.value << "}}";
+			}
+		}
+
+		ss << std::endl << "]}" << std::endl;
+
+		const std::string str = ss.str();
+		if (!wiHelper::FileWrite(fileName, (const uint8_t*)str.c_str(), str.length()))
+		{
+			wiBackLog::post(("[wiProfiler] trace could not be written: " + fileName).c_str());
+			return false;
+		}
+		wiBackLog::post(("[wiProfiler] trace written: " + fileName + " (" + std::to_string(last - first + 1) + " frames, " + std::to_string(count) + " events)").c_str());
+		return true;
+	}
+	// Write the frames around the detected spike, tagged with the marked events of the spike frame and the frame before it
+	void WriteSpike()
+	{
+		const CaptureFrame* frame = GetCaptureFrame(spike_frame);
+		if (frame == nullptr)
+		{
+			spike_frame = ~0ull;
+			return;
+		}
+
+		std::string reasons;
+		for (uint64_t index = spike_frame - 1; index <= spike_frame; ++index)
+		{
+			const CaptureFrame* x = GetCaptureFrame(index);
+			if (x == nullptr)
+				continue;
+			for (const char* reason : x->reasons)
+			{
+				if (reasons.find(reason) == std::string::npos)
+				{
+					reasons += reasons.empty() ? "" : ", ";
+					reasons += reason;
+				}
+			}
+		}
+		std::stringstream ss;
+		ss.precision(1);
+		ss << "Frame Spike: " << std::fixed << frame->time << " ms";
+		if (!reasons.empty())
+		{
+			ss << " (" << reasons << ")";
+		}
+		wiBackLog::post(("[wiProfiler] " + ss.str()).c_str());
+
+		// The spike is marked in the trace on the main thread at the end of the frame:
+		CaptureFrame* marked = GetCaptureFrame(spike_frame);
+		CaptureEvent& event = marked->events.emplace_back();
+		event.name = ss.str();
+		event.track = capture_main_thread;
+		event.begin = marked->counters.empty() ? 0 : marked->counters.back().time;
+		event.duration = -1;
+
+		const uint64_t first = std::max(capture_frames.front().index, spike_written + 1);
+		const uint64_t last = spike_frame + spike_desc.framesAfter;
+		WriteCapture(first, last, spike_desc.directory + "spike_frame_" + std::to_string(spike_frame) + ".json");
+
+		spike_written = last;
+		spike_frame = ~0ull;
+	}
+	// Stop the recording if neither the capture nor the spike detection needs it
+	void StopRecording()
+	{
+		if (IsRecording())
+			return;
+		capture_frames.clear();
+		capture_frames.shrink_to_fit();
+		if (capture_disable_profiler)
+		{
+			capture_disable_profiler = false;
+			SetEnabled(false);
+		}
+	}
+	void StartRecording()
+	{
+		if (!IsRecording())
+		{
+			capture_frames.clear();
+			capture_start = CPUTimestamp();
+			capture_frame_timer.record();
+			for (auto& x : queryHeapCaptured)
+			{
+				x = false;
+			}
+		}
+		if (!ENABLED)
+		{
+			SetEnabled(true);
+			capture_disable_profiler = true;
+		}
+	}
+
+	// GPU pass timing, the pass at index 0 is the whole frame:
+	bool PASS_TIMING_ENABLED = true;
+	bool pass_initialized = false;
+	std::mutex pass_lock;
+	GPUQueryHeap passQueryHeap[arraysize(queryHeap)];
+	struct PassQuery
+	{
+		size_t hash = 0;
+		CommandList cmd = COMMANDLIST_COUNT;
+		bool ended = false;
+		uint32_t stats_index = ~0u; // pipeline statistics query, if it was counted
+	};
+	std::vector<PassQuery> passQueries[arraysize(queryHeap)]; // pass i wrote the queries 2 * i and 2 * i + 1
+	std::vector<uint64_t> passQueryResults;
+	bool PIPELINE_STATISTICS_ENABLED = false;
+	GPUQueryHeap passStatsHeap[arraysize(queryHeap)];
+	uint32_t passStatsCount[arraysize(queryHeap)] = {};
+	bool passStatsActive[COMMANDLIST_COUNT] = {}; // only one statistics query can be active in a command list
+	std::vector<PipelineStatistics> passStatsResults;
+	std::unordered_map<size_t, std::string> passNames;
+	std::vector<PassTime> passTimes; // last measured frame
+	std::vector<size_t> passTimeHashes; // same order as passTimes
+	int passheap_idx = 0;
+	float pass_frame_time = 0;
+	const pass_id INVALID_PASS = ~0u;
+
+	void BeginPassFrame(CommandList cmd)
+	{
+		if (!pass_initialized)
+		{
+			pass_initialized = true;
+
+			GPUQueryHeapDesc desc;
+			desc.type = GPU_QUERY_TYPE_TIMESTAMP;
+			desc.queryCount = GPU_PASS_MAX * 2;
+			for (int i = 0; i < arraysize(passQueryHeap); ++i)
+			{
+				bool success = wiRenderer::GetDevice()->CreateQueryHeap(&desc, &passQueryHeap[i]);
+				assert(success);
+				passQueries[i].reserve(GPU_PASS_MAX);
+			}
+			passQueryResults.resize(desc.queryCount);
+
+			if (wiRenderer::GetDevice()->CheckCapability(GRAPHICSDEVICE_CAPABILITY_PIPELINE_STATISTICS))
+			{
+				desc.type = GPU_QUERY_TYPE_PIPELINE_STATISTICS;
+				desc.queryCount = GPU_PASS_MAX;
+				for (int i = 0; i < arraysize(passStatsHeap); ++i)
+				{
+					bool success = wiRenderer::GetDevice()->CreateQueryHeap(&desc, &passStatsHeap[i]);
+					assert(success);
+				}
+				passStatsResults.resize(desc.queryCount);
+			}
+		}
+
+		pass_id frame = BeginPassGPU("GPU Frame", cmd);
+		assert(frame == 0);
+	}
+	void EndPassFrame(CommandList cmd)
+	{
+		if (!pass_initialized)
+			return;
+
+		GraphicsDevice* device = wiRenderer::GetDevice();
+
+		pass_lock.lock();
+
+		// The frame pass ends in a different command list than it was begun in:
+		auto& queries = passQueries[passheap_idx];
+		if (!queries.empty())
+		{
+			queries[0].cmd = cmd;
+		}
+		pass_lock.unlock();
+		EndPassGPU(0);
+
+		pass_lock.lock();
+		if (!queries.empty())
+		{
+			device->QueryResolve(&passQueryHeap[passheap_idx], 0, (uint32_t)queries.size() * 2, cmd);
+		}
+		if (passStatsCount[passheap_idx] > 0)
+		{
+			device->QueryResolve(&passStatsHeap[passheap_idx], 0, passStatsCount[passheap_idx], cmd);
+		}
+
+		// The oldest heap in the ring was written BUFFERCOUNT frames ago, the GPU is finished with it:
+		passheap_idx = (passheap_idx + 1) % arraysize(passQueryHeap);
+		auto& readback = passQueries[passheap_idx];
+		if (!readback.empty())
+		{
+			device->QueryRead(&passQueryHeap[passheap_idx], 0, (uint32_t)readback.size() * 2, passQueryResults.data());
+			device->QueryRead(&passStatsHeap[passheap_idx], 0, passStatsCount[passheap_idx], (uint64_t*)passStatsResults.data());
+
+			const double gpu_frequency = (double)device->GetTimestampFrequency() / 1000.0;
+			passTimes.clear();
+			passTimeHashes.clear();
+			for (size_t i = 0; i < readback.size(); ++i)
+			{
+				const PassQuery& query = readback[i];
+				if (!query.ended)
+					continue;
+
+				const uint64_t begin_result = passQueryResults[i * 2];
+				const uint64_t end_result = passQueryResults[i * 2 + 1];
+				const float time = end_result > begin_result ? (float)((double)(end_result - begin_result) / gpu_frequency) : 0;
+
+				size_t index = 0;
+				while (index < passTimeHashes.size() && passTimeHashes[index] != query.hash)
+				{
+					index++;
+				}
+				if (index == passTimeHashes.size())
+				{
+					passTimeHashes.push_back(query.hash);
+					passTimes.emplace_back();
+					passTimes.back().name = passNames[query.hash];
+				}
+				passTimes[index].time += time;
+
+				if (query.stats_index < passStatsCount[passheap_idx])
+				{
+					const PipelineStatistics& stats = passStatsResults[query.stats_index];
+					passTimes[index].has_stats = true;
+					passTimes[index].stats += stats;
+					if (index > 0)
+					{
+						passTimes[0].has_stats = true;
+						passTimes[0].stats += stats;
+					}
+				}
+			}
+			if (!passTimes.empty() && readback[0].ended)
+			{
+				pass_frame_time = passTimes[0].time;
+			}
+			readback.clear();
+		}
+		passStatsCount[passheap_idx] = 0;
+		std::memset(passStatsActive, 0, sizeof(passStatsActive));
+
+		pass_lock.unlock();
+	}
+
+	wiJobSystem::Stats jobStats; // job system statistics of the last frame
+	wiTimer jobStatsTimer;
+	double jobStatsFrameTime = 0; // milliseconds that jobStats were collected for
+
+	// Write the job system statistics of the last frame
+	void WriteJobStats(std::stringstream& ss)
+	{
+		if (jobStats.workers.empty() || jobStatsFrameTime <= 0)
+			return;
+
+		const double frame_ns = jobStatsFrameTime * 1000000.0;
+		ss << "Job System: queued " << jobStats.queueDepth[(int)wiJobSystem::Priority::High] << " high, " << jobStats.queueDepth[(int)wiJobSystem::Priority::Normal] << " normal, " << jobStats.queueDepth[(int)wiJobSystem::Priority::Background] << " background";
+		ss << " | queue grow: " << jobStats.queueGrowCount << ", contention: " << jobStats.queueContentionCount << std::endl;
+		for (size_t i = 0; i < jobStats.workers.size(); ++i)
+		{
+			const wiJobSystem::WorkerStats& worker = jobStats.workers[i];
+			if (i == jobStats.workers.size() - 1)
+			{
+				ss << "Other threads";
+			}
+			else
+			{
+				ss << "Worker " << i;
+			}
+			ss << ": busy " << std::fixed << 100.0 * worker.busyTime / frame_ns << "%, idle " << 100.0 * worker.idleTime / frame_ns << "%, steal " << 100.0 * worker.stealTime / frame_ns << "%";
+			ss << " (" << worker.jobCount << " jobs, " << worker.stealCount << " stolen, " << worker.sleepCount << " sleeps)" << std::endl;
+		}
+		for (auto& x : jobStats.contexts)
+		{
+			ss << "Jobs - " << x.name << ": " << std::fixed << x.time / 1000000.0 << " ms (" << x.jobCount << " jobs)" << std::endl;
+		}
+	}
+
+	// Write the usage of the temporary GPU allocations of the last frame
+	void WriteGPUAllocatorStats(std::stringstream& ss)
+	{
+		const GraphicsDevice::GPUAllocatorStatistics stats = wiRenderer::GetDevice()->GetGPUAllocatorStatistics();
+		if (stats.pageCount == 0)
+			return;
+
+		ss << "GPU Allocator: " << std::fixed << stats.frameBytes / 1024.0 << " KB (peak " << stats.peakFrameBytes / 1024.0 << " KB)";
+		ss << " | pages: " << stats.framePages << " used (peak " << stats.peakFramePages << "), " << stats.pageCount << " created" << std::endl;
+	}
+
+	// Write the pipeline statistics of the GPU passes in the last measured frame
+	void WritePipelineStats(std::stringstream& ss)
+	{
+		if (!PIPELINE_STATISTICS_ENABLED)
+			return;
+
+		pass_lock.lock();
+		for (auto& pass : passTimes)
+		{
+			if (!pass.has_stats)
+				continue;
+			ss << pass.name << ": " << pass.stats.IAPrimitives << " prims (" << pass.stats.CPrimitives << " after clipping)";
+			ss << " | VS: " << pass.stats.VSInvocations << " | PS: " << pass.stats.PSInvocations << " | CS: " << pass.stats.CSInvocations << std::endl;
+		}
+		pass_lock.unlock();
+		ss << std::endl;
+	}
+
+	void WriteMemoryStats(std::stringstream& ss)
+	{
+		ss << wiMemoryTracker::GetReport();
+
+		const GraphicsDevice::MemoryBudget memory = wiRenderer::GetDevice()->GetMemoryBudget(GraphicsDevice::MEMORY_HEAP_DEVICE);
+		if (memory.budget > 0)
+		{
+			ss << "Video Memory: " << std::fixed << memory.usage / 1024.0 / 1024.0 << " MB / " << memory.budget / 1024.0 / 1024.0 << " MB" << std::endl;
+		}
+	}
+
 	void BeginFrame()
 	{
+		if (PASS_TIMING_ENABLED)
+		{
+			BeginPassFrame(wiRenderer::GetDevice()->BeginCommandList());
+		}
+
 		if (!ENABLED)
 			return;
 
@@ -80,6 +743,19 @@ namespace wiProfiler
 			}
 
 			queryResults.resize(desc.queryCount);
+
+			wiJobSystem::SetStatsEnabled(true);
+			wiJobSystem::ConsumeStats(jobStats); // discard everything before the first frame
+			jobStatsTimer.record();
+
+			// Discard the CPU events that were recorded before the profiler was enabled:
+			cpu_threads_lock.lock();
+			for (auto& x : cpu_threads)
+			{
+				x->read.store(x->write.load(std::memory_order_acquire), std::memory_order_release);
+				x->open.clear();
+			}
+			cpu_threads_lock.unlock();
 		}
 
 		cpu_frame = BeginRangeCPU("CPU Frame");
@@ -105,6 +781,11 @@ namespace wiProfiler
 	}
 	void EndFrame(CommandList cmd)
 	{
+		if (PASS_TIMING_ENABLED)
+		{
+			EndPassFrame(cmd);
+		}
+
 		if (!ENABLED || !initialized)
 			return;
 
@@ -117,18 +798,80 @@ namespace wiProfiler
 
 		EndRange(cpu_frame);
 
+		CaptureFrame* frame = nullptr;
+		if (IsRecording())
+		{
+			frame = &capture_frames.emplace_back();
+			frame->index = ++capture_frame_index;
+			frame->time = (float)capture_frame_timer.elapsed();
+			capture_frame_timer.record();
+			capture_main_thread = GetCPUThreadEvents().thread;
+		}
+
+		MergeCPUEvents();
+
+		if (frame != nullptr)
+		{
+			const double time = CaptureTime(CPUTimestamp());
+			auto counter = [&](const char* name, double value) {
+				CaptureCounter& x = frame->counters.emplace_back();
+				x.name = name;
+				x.time = time;
+				x.value = value;
+			};
+#ifdef GGREDUCED
+			counter("Draw Calls", iDrawCalls);
+			counter("Draw Calls (Shadows)", iDrawCallsShadows);
+			counter("Draw Calls (Transparent)", iDrawCallsTransparent);
+			counter("Polygons", iPolygonsDrawn);
+			counter("Polygons (Shadows)", iPolygonsDrawnShadows);
+			counter("Polygons (Transparent)", iPolygonsDrawnTransparent);
+#endif
+			counter("Frame Time (ms)", frame->time);
+			counter("CPU Range Events Dropped", cpu_events_dropped.load());
+		}
+
+		jobStatsFrameTime = jobStatsTimer.elapsed();
+		jobStatsTimer.record();
+		wiJobSystem::ConsumeStats(jobStats);
+
 		double gpu_frequency = (double)device->GetTimestampFrequency() / 1000.0;
 
 		device->QueryResolve(&queryHeap[queryheap_idx], 0, nextQuery.load(), cmd);
 
 		writtenQueries[queryheap_idx] = nextQuery.load();
 		nextQuery.store(0);
+		queryHeapCaptured[queryheap_idx] = frame != nullptr;
+		queryHeapFrame[queryheap_idx] = capture_frame_index;
+		queryHeapSubmitted[queryheap_idx] = CPUTimestamp();
+		if (capture_recording > 0 && --capture_recording == 0)
+		{
+			capture_last = capture_frame_index;
+			capture_draining = arraysize(queryHeap);
+		}
 		queryheap_idx = (queryheap_idx + 1) % arraysize(queryHeap);
 		if (writtenQueries[queryheap_idx] > 0)
 		{
 			wiRenderer::GetDevice()->QueryRead(&queryHeap[queryheap_idx], 0, writtenQueries[queryheap_idx], queryResults.data());
 		}
 
+		// The GPU ranges of a recorded frame are placed relative to the CPU time when the frame was submitted:
+		CaptureFrame* gpu_capture_frame = nullptr;
+		if (queryHeapCaptured[queryheap_idx] && writtenQueries[queryheap_idx] > 0)
+		{
+			gpu_capture_frame = GetCaptureFrame(queryHeapFrame[queryheap_idx]);
+		}
+		queryHeapCaptured[queryheap_idx] = false;
+		uint64_t capture_gpu_frame_begin = 0;
+		if (gpu_capture_frame != nullptr)
+		{
+			auto it = ranges.find(gpu_frame);
+			if (it != ranges.end() && it->second.gpuBegin[queryheap_idx] >= 0)
+			{
+				capture_gpu_frame_begin = queryResults[it->second.gpuBegin[queryheap_idx]];
+			}
+		}
+
 		for (auto& x : ranges)
 		{
 			auto& range = x.second;
@@ -136,7 +879,10 @@ namespace wiProfiler
 			range.time = 0;
 			if (range.IsCPURange())
 			{
-				range.time = (float)abs(range.cpuEnd.elapsed() - range.cpuBegin.elapsed());
+				range.time = range.cpu_time;
+				range.hits = range.cpu_hits;
+				range.cpu_time = 0;
+				range.cpu_hits = 0;
 			}
 			else
 			{
@@ -147,9 +893,22 @@ namespace wiProfiler
 					uint64_t begin_result = queryResults[begin_query];
 					uint64_t end_result = queryResults[end_query];
 					range.time = (float)abs((double)(end_result - begin_result) / gpu_frequency);
+
+					if (gpu_capture_frame != nullptr && capture_gpu_frame_begin > 0 && begin_result >= capture_gpu_frame_begin && end_result >= begin_result)
+					{
+						CaptureEvent& capture = gpu_capture_frame->events.emplace_back();
+						capture.name = range.name;
+						capture.track = CAPTURE_GPU_TRACK + (uint32_t)range.cmd;
+						capture.begin = CaptureTime(queryHeapSubmitted[queryheap_idx]) + (double)(begin_result - capture_gpu_frame_begin) / gpu_frequency * 1000.0;
+						capture.duration = (double)(end_result - begin_result) / gpu_frequency * 1000.0;
+					}
 				}
 				range.gpuBegin[queryheap_idx] = -1;
 				range.gpuEnd[queryheap_idx] = -1;
+				if (x.first == gpu_frame && range.time > 0)
+				{
+					gpu_frame_time = range.time;
+				}
 			}
 			range.times[range.avg_counter++ % arraysize(range.times)] = range.time;
 
@@ -165,33 +924,218 @@ namespace wiProfiler
 
 			range.in_use = false;
 		}
+
+		if (frame != nullptr && spike_enabled)
+		{
+			if (spike_frame == ~0ull && frame->index > spike_written && capture_frames.size() > 1 && frame->time > spike_desc.threshold)
+			{
+				spike_frame = frame->index;
+			}
+			if (spike_frame != ~0ull && frame->index >= spike_frame + spike_desc.framesAfter + arraysize(queryHeap))
+			{
+				WriteSpike();
+			}
+		}
+
+		if (capture_draining > 0 && --capture_draining == 0)
+		{
+			WriteCapture(capture_first, capture_last, capture_filename);
+			StopRecording();
+		}
+
+		if (IsRecording())
+		{
+			// Only the frames that can be written are kept:
+			uint64_t keep = ~0ull;
+			if (spike_enabled)
+			{
+				const uint64_t reference = spike_frame == ~0ull ? capture_frame_index : spike_frame;
+				keep = reference > spike_desc.historyFrames ? reference - spike_desc.historyFrames : 0;
+			}
+			if (capture_recording > 0 || capture_draining > 0)
+			{
+				keep = std::min(keep, capture_first);
+			}
+			while (!capture_frames.empty() && capture_frames.front().index < keep)
+			{
+				capture_frames.pop_front();
+			}
+		}
 	}
 
-	range_id BeginRangeCPU(const char* name)
+	float GetGPUFrameTime()
+	{
+		if (ENABLED && initialized)
+		{
+			return gpu_frame_time;
+		}
+		return PASS_TIMING_ENABLED ? pass_frame_time : 0;
+	}
+
+	float GetRangeTime(const char* name)
 	{
 		if (!ENABLED || !initialized)
 			return 0;
 
-		range_id id = wiHelper::string_hash(name);
-
+		float time = 0;
 		lock.lock();
+		auto it = ranges.find(wiHelper::string_hash(name));
+		if (it != ranges.end() && it->second.avg_counter > 0)
+		{
+			const Range& range = it->second;
+			time = range.times[(range.avg_counter - 1) % arraysize(range.times)];
+		}
+		lock.unlock();
+		return time;
+	}
 
-		// If one range name is hit multiple times, differentiate between them!
-		size_t differentiator = 0;
-		while (ranges[id].in_use)
+	pass_id BeginPassGPU(const char* name, CommandList cmd)
+	{
+		if (!PASS_TIMING_ENABLED || !pass_initialized)
+			return INVALID_PASS;
+
+		const size_t hash = wiHelper::string_hash(name);
+
+		pass_lock.lock();
+		auto& queries = passQueries[passheap_idx];
+		if (queries.size() >= GPU_PASS_MAX)
 		{
-			wiHelper::hash_combine(id, differentiator++);
+			pass_lock.unlock();
+			return INVALID_PASS;
 		}
-		ranges[id].in_use = true;
-		if ( ranges[id].name.length() == 0 ) rangeOrder[0].push_back( id );
-		ranges[id].name = name;
+		const pass_id id = (pass_id)queries.size();
+		queries.emplace_back();
+		queries.back().hash = hash;
+		queries.back().cmd = cmd;
+		if (passNames.count(hash) == 0)
+		{
+			passNames[hash] = name;
+		}
+		wiRenderer::GetDevice()->QueryEnd(&passQueryHeap[passheap_idx], id * 2, cmd);
+
+		// The frame pass is not counted, because it spans multiple command lists:
+		if (PIPELINE_STATISTICS_ENABLED && id > 0 && passStatsHeap[passheap_idx].IsValid() && !passStatsActive[cmd])
+		{
+			passStatsActive[cmd] = true;
+			queries.back().stats_index = passStatsCount[passheap_idx]++;
+			wiRenderer::GetDevice()->QueryBegin(&passStatsHeap[passheap_idx], queries.back().stats_index, cmd);
+		}
+		pass_lock.unlock();
+
+		return id;
+	}
+	void EndPassGPU(pass_id id)
+	{
+		if (id == INVALID_PASS || !PASS_TIMING_ENABLED || !pass_initialized)
+			return;
 
-		ranges[id].cpuBegin.record();
+		pass_lock.lock();
+		auto& queries = passQueries[passheap_idx];
+		if (id < queries.size() && !queries[id].ended)
+		{
+			queries[id].ended = true;
+			wiRenderer::GetDevice()->QueryEnd(&passQueryHeap[passheap_idx], id * 2 + 1, queries[id].cmd);
+			if (queries[id].stats_index != ~0u)
+			{
+				passStatsActive[queries[id].cmd] = false;
+				wiRenderer::GetDevice()->QueryEnd(&passStatsHeap[passheap_idx], queries[id].stats_index, queries[id].cmd);
+			}
+		}
+		pass_lock.unlock();
+	}
+	float GetPassTime(const char* name)
+	{
+		const size_t hash = wiHelper::string_hash(name);
+		float time = 0;
+		pass_lock.lock();
+		for (size_t i = 0; i < passTimeHashes.size(); ++i)
+		{
+			if (passTimeHashes[i] == hash)
+			{
+				time = passTimes[i].time;
+				break;
+			}
+		}
+		pass_lock.unlock();
+		return time;
+	}
+	void GetPassTimes(std::vector<PassTime>& result)
+	{
+		pass_lock.lock();
+		result = passTimes;
+		pass_lock.unlock();
+	}
+	void GetCPURangeTimes(std::vector<PassTime>& result)
+	{
+		result.clear();
+		if (!ENABLED || !initialized)
+			return;
 
+		lock.lock();
+		for (auto& x : ranges)
+		{
+			const Range& range = x.second;
+			if (range.IsCPURange() && range.hits > 0 && range.avg_counter > 0)
+			{
+				PassTime& pass = result.emplace_back();
+				pass.name = range.name;
+				pass.time = range.times[(range.avg_counter - 1) % arraysize(range.times)];
+			}
+		}
 		lock.unlock();
+	}
+
+	range_id BeginRangeCPU(const char* name)
+	{
+		if (!ENABLED || !initialized)
+			return 0;
+
+		CPUThreadEvents& events = GetCPUThreadEvents();
+		events.depth++;
+		const range_id id = CPU_RANGE | ((range_id)events.thread << 16) | (range_id)(events.depth & 0xFFFF);
+
+		// Both the begin and the end event must fit, and the end events of the open ranges too:
+		const uint64_t write = events.write.load(std::memory_order_relaxed);
+		const uint64_t read = events.read.load(std::memory_order_acquire);
+		if (write - read + events.reserved + 2 > CPU_EVENT_CAPACITY)
+		{
+			cpu_events_dropped.fetch_add(1, std::memory_order_relaxed);
+			return id | CPU_RANGE_DROPPED;
+		}
+
+		CPUEvent& event = events.events[write % CPU_EVENT_CAPACITY];
+		event.name = name;
+		event.timestamp = CPUTimestamp();
+		event.thread = events.thread;
+		event.depth = (uint16_t)(id & 0xFFFF);
+		event.type = CPU_EVENT_BEGIN;
+		events.reserved++;
+		events.write.store(write + 1, std::memory_order_release);
 
 		return id;
 	}
+	void MarkEvent(const char* name)
+	{
+		if (!ENABLED || !initialized)
+			return;
+
+		CPUThreadEvents& events = GetCPUThreadEvents();
+		const uint64_t write = events.write.load(std::memory_order_relaxed);
+		const uint64_t read = events.read.load(std::memory_order_acquire);
+		if (write - read + events.reserved + 1 > CPU_EVENT_CAPACITY)
+		{
+			cpu_events_dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		CPUEvent& event = events.events[write % CPU_EVENT_CAPACITY];
+		event.name = name;
+		event.timestamp = CPUTimestamp();
+		event.thread = events.thread;
+		event.depth = 0;
+		event.type = CPU_EVENT_MARK;
+		events.write.store(write + 1, std::memory_order_release);
+	}
 	range_id BeginRangeGPU(const char* name, CommandList cmd)
 	{
 		if (!ENABLED || !initialized)
@@ -201,9 +1145,9 @@ namespace wiProfiler
 
 		lock.lock();
 
-		// If one range name is hit multiple times, differentiate between them!
+		// If one range name is hit multiple times, differentiate between them! (and from the CPU ranges)
 		size_t differentiator = 0;
-		while (ranges[id].in_use)
+		while (ranges[id].in_use || (ranges[id].IsCPURange() && !ranges[id].name.empty()))
 		{
 			wiHelper::hash_combine(id, differentiator++);
 		}
@@ -222,6 +1166,13 @@ namespace wiProfiler
 	}
 	void EndRange(range_id id)
 	{
+		if (id & CPU_RANGE)
+		{
+			// It is also ended after the profiler was disabled, to keep the nesting of the thread:
+			EndRangeCPU(id);
+			return;
+		}
+
 		if (!ENABLED || !initialized)
 			return;
 
@@ -230,11 +1181,7 @@ namespace wiProfiler
 		auto it = ranges.find(id);
 		if (it != ranges.end())
 		{
-			if (it->second.IsCPURange())
-			{
-				it->second.cpuEnd.record();
-			}
-			else
+			if (!it->second.IsCPURange())
 			{
 				ranges[id].gpuEnd[queryheap_idx] = nextQuery.fetch_add(1);
 				wiRenderer::GetDevice()->QueryEnd(&queryHeap[queryheap_idx], it->second.gpuEnd[queryheap_idx], it->second.cmd);
@@ -290,6 +1237,13 @@ namespace wiProfiler
 		}
 		ss << std::endl;
 
+		WriteJobStats(ss);
+		WriteGPUAllocatorStats(ss);
+		ss << std::endl;
+		WriteMemoryStats(ss);
+		ss << std::endl;
+		WritePipelineStats(ss);
+
 		// Print GPU ranges:
 		float shadowTerrainTotal = 0;
 		float shadowTreesTotal = 0;
@@ -367,7 +1321,7 @@ namespace wiProfiler
 		{
 			if (x.second.IsCPURange())
 			{
-				time_cache_cpu[x.second.name].num_hits++;
+				time_cache_cpu[x.second.name].num_hits += x.second.hits;
 				time_cache_cpu[x.second.name].total_time += x.second.time;
 			}
 			else
@@ -384,8 +1338,19 @@ namespace wiProfiler
 			x.second.num_hits = 0;
 			x.second.total_time = 0;
 		}
+		if (cpu_events_dropped.load() > 0)
+		{
+			ss << "CPU range events dropped: " << cpu_events_dropped.load() << std::endl;
+		}
 		ss << std::endl;
 
+		WriteJobStats(ss);
+		WriteGPUAllocatorStats(ss);
+		ss << std::endl;
+		WriteMemoryStats(ss);
+		ss << std::endl;
+		WritePipelineStats(ss);
+
 		// Print GPU ranges:
 		for (auto& x : time_cache_gpu)
 		{
@@ -407,13 +1372,80 @@ namespace wiProfiler
 		wiFont::Draw(ss.str(), params, cmd);
 	}
 
+	void BeginCapture(uint32_t frameCount, const std::string& fileName)
+	{
+		if (frameCount == 0)
+			return;
+		if (IsCapturing())
+		{
+			wiBackLog::post("[wiProfiler] a capture is already in progress");
+			return;
+		}
+
+		StartRecording();
+		capture_filename = fileName;
+		capture_first = capture_frame_index + 1;
+		capture_recording = frameCount;
+		capture_draining = 0;
+	}
+	bool IsCapturing()
+	{
+		return capture_recording > 0 || capture_draining > 0;
+	}
+
+	void SetSpikeDetectionEnabled(bool value, const SpikeDetection& desc)
+	{
+		if (value)
+		{
+			StartRecording();
+			spike_desc = desc;
+			spike_desc.historyFrames = std::max(1u, spike_desc.historyFrames);
+			if (!spike_desc.directory.empty() && spike_desc.directory.back() != '/' && spike_desc.directory.back() != '\\')
+			{
+				spike_desc.directory += '/';
+			}
+			if (!spike_enabled)
+			{
+				spike_frame = ~0ull;
+				spike_written = capture_frame_index;
+			}
+			spike_enabled = true;
+		}
+		else if (spike_enabled)
+		{
+			spike_enabled = false;
+			spike_frame = ~0ull;
+			StopRecording();
+		}
+	}
+	bool IsSpikeDetectionEnabled()
+	{
+		return spike_enabled;
+	}
+
 	void SetEnabled(bool value)
 	{
 		if (value != ENABLED)
 		{
+			if (!value)
+			{
+				if (IsCapturing())
+				{
+					wiBackLog::post("[wiProfiler] capture aborted, because the profiler was disabled");
+				}
+				capture_recording = 0;
+				capture_draining = 0;
+				spike_enabled = false;
+				spike_frame = ~0ull;
+				capture_disable_profiler = false;
+				capture_frames.clear();
+				wiJobSystem::SetStatsEnabled(false);
+				jobStats = {};
+			}
 			initialized = false;
 			ranges.clear();
 			for( int i = 0; i < COMMANDLIST_COUNT+1; i++ ) rangeOrder[i].clear();
+			cpu_range_keys.clear();
 			ENABLED = value;
 		}
 	}
@@ -423,4 +1455,45 @@ namespace wiProfiler
 		return ENABLED;
 	}
 
+	uint32_t GetDroppedCPUEventCount()
+	{
+		return cpu_events_dropped.load();
+	}
+
+	void SetPassTimingEnabled(bool value)
+	{
+		pass_lock.lock();
+		if (value != PASS_TIMING_ENABLED)
+		{
+			for (auto& x : passQueries)
+			{
+				x.clear();
+			}
+			std::memset(passStatsCount, 0, sizeof(passStatsCount));
+			std::memset(passStatsActive, 0, sizeof(passStatsActive));
+			passTimes.clear();
+			passTimeHashes.clear();
+			pass_frame_time = 0;
+			PASS_TIMING_ENABLED = value;
+		}
+		pass_lock.unlock();
+	}
+
+	bool IsPassTimingEnabled()
+	{
+		return PASS_TIMING_ENABLED;
+	}
+
+	void SetPipelineStatisticsEnabled(bool value)
+	{
+		pass_lock.lock();
+		PIPELINE_STATISTICS_ENABLED = value;
+		pass_lock.unlock();
+	}
+
+	bool IsPipelineStatisticsEnabled()
+	{
+		return PIPELINE_STATISTICS_ENABLED;
+	}
+
 }
@@ -2,6 +2,9 @@
 #include "wiGraphicsDevice.h"
 #include "wiCanvas.h"
 
+#include <string>
+#include <vector>
+
 namespace wiProfiler
 {
 	typedef size_t range_id;
@@ -13,6 +16,9 @@ namespace wiProfiler
 	void EndFrame(wiGraphics::CommandList cmd);
 
 	// Start a CPU profiling range
+	//	The name is not copied, it must be a string that outlives the profiler (a string literal)
+	//	The range is recorded into a buffer of the calling thread without locking, and it must be ended on the same thread
+	//	The ranges with the same name are summed within a frame
 	range_id BeginRangeCPU(const char* name);
 
 	// Start a GPU profiling range
@@ -21,6 +27,74 @@ namespace wiProfiler
 	// End a profiling range
 	void EndRange(range_id id);
 
+	// Mark an event that can explain a frame time spike (for example a shader compile or a pipeline state creation)
+	//	The name is not copied, it must be a string literal. It is recorded like a CPU range, and it is shown in the traces as an instant event
+	void MarkEvent(const char* name);
+
+	// Returns the count of CPU range events that were not recorded since the start, because a thread's event buffer was full
+	uint32_t GetDroppedCPUEventCount();
+
+	// Returns the duration of the last measured GPU frame in milliseconds (not averaged), or 0 if it is not known
+	//	It is measured by the profiler ranges when profiling is enabled, otherwise by the GPU pass timing
+	float GetGPUFrameTime();
+
+	// Returns the last measured duration of a range in milliseconds (not averaged), or 0 if it is not known
+	//	GPU ranges are measured a few frames later than they were recorded
+	float GetRangeTime(const char* name);
+
+	// GPU pass timing: always-on timestamps around the main rendering stages, independent of SetEnabled()
+	//	The queries of a frame are placed in their own heap of a ring, and they are read back when the GPU is surely finished with them, so nothing waits
+	//	Every pass writes two queries, and up to GPU_PASS_MAX passes are measured in a frame, the rest are ignored
+	typedef uint32_t pass_id;
+	static constexpr uint32_t GPU_PASS_MAX = 128;
+	struct PassTime
+	{
+		std::string name;
+		float time = 0; // milliseconds, summed for all passes with the same name within the frame
+		bool has_stats = false; // whether the pipeline statistics were counted for this pass
+		wiGraphics::PipelineStatistics stats; // summed like the time
+	};
+
+	// Start measuring a GPU pass, the name is copied, so it doesn't need to outlive the call
+	pass_id BeginPassGPU(const char* name, wiGraphics::CommandList cmd);
+	// End measuring a GPU pass in the command list it was begun in
+	void EndPassGPU(pass_id id);
+	// Returns the duration of the passes with this name in the last measured frame in milliseconds, or 0 if it is not known
+	float GetPassTime(const char* name);
+	// Returns all the passes of the last measured frame, in the order they were begun in (the order of command lists can be different on the GPU)
+	void GetPassTimes(std::vector<PassTime>& result);
+	// Returns the CPU ranges that ended in the last frame with their summed durations (not averaged), it needs the profiler to be enabled
+	void GetCPURangeTimes(std::vector<PassTime>& result);
+
+	void SetPassTimingEnabled(bool value);
+	bool IsPassTimingEnabled();
+
+	// Pipeline statistics of the GPU passes: the passes also count the primitives and shader invocations of the GPU into PassTime::stats
+	//	A pass doesn't count when an other pass is already counting in the same command list, and the frame pass has the sum of the counted passes
+	//	It is disabled by default, because the counters can slow down the GPU. It needs the pass timing and GRAPHICSDEVICE_CAPABILITY_PIPELINE_STATISTICS
+	void SetPipelineStatisticsEnabled(bool value);
+	bool IsPipelineStatisticsEnabled();
+
+	// Record the next frameCount frames, then write them into a Chrome trace JSON file (chrome://tracing or https://ui.perfetto.dev)
+	//	The trace contains the CPU ranges of every thread, the GPU ranges of every command list and the frame counters. The profiler is enabled during the capture
+	//	The devices don't provide calibrated GPU timestamps, so the GPU ranges of a frame are placed on the CPU timeline relative to the time when the frame was submitted
+	//	The file is written a few frames after the last recorded one, when the GPU results of all recorded frames are available
+	void BeginCapture(uint32_t frameCount, const std::string& fileName);
+	bool IsCapturing();
+
+	// Frame time spike detection: the last frames are kept in memory, and when a frame takes longer than the threshold,
+	//	the frames around it are written into a trace file like BeginCapture(). The marked events of the spike frame are reported as its reason
+	//	The frame time is measured between the EndFrame() calls. The profiler is enabled while the detection is enabled
+	struct SpikeDetection
+	{
+		float threshold = 50; // milliseconds
+		uint32_t historyFrames = 300; // count of frames that are kept before the spike
+		uint32_t framesAfter = 30; // count of frames that are written after the spike
+		std::string directory; // where the spike_frame_<index>.json files are written
+	};
+	void SetSpikeDetectionEnabled(bool value, const SpikeDetection& desc = {});
+	bool IsSpikeDetectionEnabled();
+
 	// Renders a basic text of the Profiling results to the (x,y) screen coordinate
 	void DrawData(const wiCanvas& canvas, float x, float y, wiGraphics::CommandList cmd);
 
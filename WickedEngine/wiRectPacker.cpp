@@ -1,6 +1,7 @@
 #include "wiRectPacker.h"
 
 #include <algorithm>
+#include <climits>
 
 namespace wiRectPacker
 {
@@ -253,6 +254,128 @@ namespace wiRectPacker
 	}
 
 
+	// free rectangles that are inside an other one are redundant
+	//	only the ones from first are checked, the ones before it were not inside each other and can't be inside the new ones, which are parts of what they replaced
+	void remove_contained(std::vector<rect_xywh>& free, size_t first) {
+		for (size_t i = first; i < free.size(); ++i) {
+			const rect_xywh a = free[i];
+			for (size_t j = 0; j < free.size(); ++j) {
+				const rect_xywh& b = free[j];
+				if (i != j && a.x >= b.x && a.y >= b.y && a.r() <= b.r() && a.b() <= b.b()) {
+					free[i] = free.back();
+					free.pop_back();
+					--i;
+					break;
+				}
+			}
+		}
+	}
+
+	void free_rects::reset(int w, int h) {
+		width = w;
+		height = h;
+		used.clear();
+		free.clear();
+		free.push_back(rect_xywh(0, 0, w, h));
+		used_area = 0;
+		fragmented = false;
+	}
+
+	bool free_rects::insert(rect_xywh& rect) {
+		int best = -1;
+		int best_short = INT_MAX, best_long = INT_MAX;
+		for (int i = 0; i < (int)free.size(); ++i) {
+			const rect_xywh& f = free[i];
+			if (rect.w > f.w || rect.h > f.h) continue;
+			const int leftover_w = f.w - rect.w;
+			const int leftover_h = f.h - rect.h;
+			const int leftover_short = std::min(leftover_w, leftover_h);
+			const int leftover_long = std::max(leftover_w, leftover_h);
+			if (leftover_short < best_short || (leftover_short == best_short && leftover_long < best_long)) {
+				best = i;
+				best_short = leftover_short;
+				best_long = leftover_long;
+			}
+		}
+		if (best < 0) {
+			if (!fragmented) return false;
+			defragment();
+			return insert(rect);
+		}
+
+		rect.x = free[best].x;
+		rect.y = free[best].y;
+		occupy(rect);
+		return true;
+	}
+
+	void free_rects::occupy(const rect_xywh& rect) {
+		used.push_back(rect);
+		used_area += (long long)rect.w * (long long)rect.h;
+
+		// every free rectangle that overlaps is replaced by its parts that are outside of rect (at most 4, each of them maximal):
+		const size_t count = free.size();
+		for (size_t i = 0; i < count; ++i) {
+			const rect_xywh f = free[i];
+			if (rect.x >= f.r() || rect.r() <= f.x || rect.y >= f.b() || rect.b() <= f.y) continue;
+
+			if (rect.x > f.x) free.push_back(rect_xywh(f.x, f.y, rect.x - f.x, f.h));
+			if (rect.r() < f.r()) free.push_back(rect_xywh(rect.r(), f.y, f.r() - rect.r(), f.h));
+			if (rect.y > f.y) free.push_back(rect_xywh(f.x, f.y, f.w, rect.y - f.y));
+			if (rect.b() < f.b()) free.push_back(rect_xywh(f.x, rect.b(), f.w, f.b() - rect.b()));
+			free[i].w = 0; // to be removed
+		}
+		const size_t added = free.size() - count;
+		free.erase(std::remove_if(free.begin(), free.end(), [](const rect_xywh& f) { return f.w == 0 || f.h == 0; }), free.end());
+
+		remove_contained(free, free.size() - added);
+	}
+
+	void free_rects::remove(const rect_xywh& rect) {
+		bool found = false;
+		for (size_t i = 0; i < used.size(); ++i) {
+			if (used[i].x == rect.x && used[i].y == rect.y && used[i].w == rect.w && used[i].h == rect.h) {
+				used[i] = used.back();
+				used.pop_back();
+				found = true;
+				break;
+			}
+		}
+		if (!found) return;
+		used_area -= (long long)rect.w * (long long)rect.h;
+
+		// the area is grown by the free rectangles that share a whole edge with it, which are then covered by it:
+		rect_xywh merged = rect;
+		bool grown = true;
+		while (grown) {
+			grown = false;
+			for (size_t i = 0; i < free.size(); ++i) {
+				const rect_xywh& f = free[i];
+				const bool column = f.x == merged.x && f.w == merged.w && (f.b() == merged.y || f.y == merged.b());
+				const bool row = f.y == merged.y && f.h == merged.h && (f.r() == merged.x || f.x == merged.r());
+				if (column || row) {
+					merged = rect_xywh(std::min(f.x, merged.x), std::min(f.y, merged.y), column ? f.w : f.w + merged.w, column ? f.h + merged.h : f.h);
+					free[i] = free.back();
+					free.pop_back();
+					grown = true;
+					break;
+				}
+			}
+		}
+		// nothing could be inside the merged rectangle, because the free ones next to it were not inside each other:
+		free.push_back(merged);
+		fragmented = true;
+	}
+
+	void free_rects::defragment() {
+		std::vector<rect_xywh> remaining = std::move(used);
+		reset(width, height);
+		for (const rect_xywh& r : remaining) {
+			occupy(r);
+		}
+	}
+
+
 	rect_wh::rect_wh(const rect_ltrb& rr) : w(rr.w()), h(rr.h()) {}
 	rect_wh::rect_wh(const rect_xywh& rr) : w(rr.w), h(rr.h) {}
 	rect_wh::rect_wh(int w, int h) : w(w), h(h) {}
@@ -79,4 +79,28 @@ namespace wiRectPacker
 
 	bool pack(rect_xywh* const * v, int n, int max_side, std::vector<bin>& bins);
 
+	// Incremental packing into a bin of fixed size, so rectangles can be inserted and removed without moving the others
+	// The free space is tracked as a list of maximal free rectangles (possibly overlapping), new rectangles go to the free one whose shorter leftover side is the smallest
+	// Removing only merges the given back area with the free rectangles next to it, the list is made maximal again by defragment(), which insert() does when nothing fits
+	struct free_rects {
+		int width = 0, height = 0;
+		std::vector<rect_xywh> used;
+		std::vector<rect_xywh> free;
+		long long used_area = 0;
+		bool fragmented = false; // there were removals since the free list was last maximal
+
+		// removes every rectangle
+		void reset(int width, int height);
+		// finds a place for the size of rect and writes it into rect.x and rect.y, returns false if it doesn't fit
+		bool insert(rect_xywh& rect);
+		// marks the area of a rectangle as used, that was placed by other means (for example by pack())
+		void occupy(const rect_xywh& rect);
+		// gives back the area of an inserted or occupied rectangle
+		void remove(const rect_xywh& rect);
+		// rebuilds the free list from the used rectangles, the used ones are not moved
+		void defragment();
+		// the used fraction of the area, in the 0..1 range
+		float occupancy() const { return width > 0 && height > 0 ? float(double(used_area) / (double(width) * double(height))) : 0; }
+	};
+
 }
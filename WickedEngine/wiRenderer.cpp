@@ -5,6 +5,7 @@
 #include "wiScene.h"
 #include "wiHelper.h"
 #include "wiMath.h"
+#include "wiMathBatch.h"
 #include "wiTextureHelper.h"
 #include "wiEnums.h"
 #include "wiRectPacker.h"
@@ -20,6 +21,8 @@
 #include "wiPlatform.h"
 #include "wiSheenLUT.h"
 #include "wiShaderCompiler.h"
+#include "wiTimer.h"
+#include "wiPackage.h"
 
 #include "shaders/ShaderInterop_Postprocess.h"
 #include "shaders/ShaderInterop_Skinning.h"
@@ -30,6 +33,12 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
 
 #ifdef GGREDUCED
 #ifdef OPTICK_ENABLE
@@ -105,6 +114,9 @@ struct TerrainChunkOcclusion
 	uint32_t history = 1;
 	uint32_t writeQuery = 0;
 } ;
+static constexpr uint32_t TERRAIN_CHUNK_LODS = 9;
+static constexpr uint32_t TERRAIN_CHUNKS_PER_LOD = 64;
+bool terrainChunkGPUCulling = false; // the chunks are tested by GPUCulling_TerrainChunks() instead of the occlusion history
 
 namespace GGTerrain
 {
@@ -135,6 +147,11 @@ namespace GGTrees
 	extern "C" void GGTrees_Draw_EnvProbe( const SPHERE* culler, const Frustum* frusta, uint32_t frustum_count, wiGraphics::CommandList cmd );
 	extern "C" void __GGTrees_Draw_EnvProbe_EMPTY( const SPHERE* culler, const Frustum* frusta, uint32_t frustum_count, wiGraphics::CommandList cmd ) {}
 	#pragma comment(linker, "/alternatename:GGTrees_Draw_EnvProbe=__GGTrees_Draw_EnvProbe_EMPTY")
+
+	// Culls the trees for every view with wiRenderer::InstanceCulling(), the draw functions use the view of their pass (wiRenderer::TREECULLING_VIEW)
+	extern "C" void GGTrees_Cull( const wiRenderer::InstanceCullingView* views, uint32_t view_count, uint32_t occlusion_view, wiGraphics::CommandList cmd );
+	extern "C" void __GGTrees_Cull_EMPTY( const wiRenderer::InstanceCullingView* views, uint32_t view_count, uint32_t occlusion_view, wiGraphics::CommandList cmd ) {}
+	#pragma comment(linker, "/alternatename:GGTrees_Cull=__GGTrees_Cull_EMPTY")
 }
 
 namespace GGGrass
@@ -175,8 +192,25 @@ DepthStencilState	depthStencils[DSSTYPE_COUNT];
 BlendState			blendStates[BSTYPE_COUNT];
 GPUBuffer			constantBuffers[CBTYPE_COUNT];
 GPUBuffer			resourceBuffers[RBTYPE_COUNT];
+// The contents of the entity and matrix arrays on the GPU, only the elements that differ from these are uploaded:
+std::vector<ShaderEntity> entityArrayUploaded;
+std::vector<XMMATRIX> matrixArrayUploaded;
 Sampler				samplers[SSLOT_COUNT];
 
+// The registered shaders of the optional features, that are created when they are first used:
+struct OnDemandShader
+{
+	std::atomic_bool pending{ false };
+	std::mutex locker;
+	SHADERSTAGE stage = SHADERSTAGE_COUNT;
+	std::string filename;
+	SHADERMODEL minshadermodel = SHADERMODEL_5_0;
+	SHADERGROUP group = SHADERGROUP_COUNT;
+};
+OnDemandShader ondemandShaders[SHADERTYPE_COUNT];
+std::atomic_bool shadergroupPrefetched[SHADERGROUP_COUNT];
+wiJobSystem::context shaderPrefetchCtx;
+
 #ifdef GGREDUCED
 #ifdef GGREDUCEDEDITOR
 std::string SHADERPATH = "shaders/";
@@ -219,12 +253,26 @@ bool debugCameras = false;
 bool gridHelper = false;
 bool voxelHelper = false;
 bool advancedLightCulling = true;
+bool clusteredLightCulling = false;
 bool variableRateShadingClassification = false;
 bool variableRateShadingClassificationDebug = false;
+SHADING_RATE variableRateShadingPolicy[VARIABLE_RATE_SHADING_PASS_COUNT] = {
+	SHADING_RATE_4X4,
+	SHADING_RATE_2X2,
+	SHADING_RATE_2X2,
+};
 bool ldsSkinningEnabled = true;
+bool skinningCullingEnabled = true;
+static const uint64_t SKINNING_CULLING_FRAMES = 2; // the frames that a mesh is still deformed after it was last drawn, so the passes that are culled one frame late see the current pose
+bool gpuBoneTransformsEnabled = false;
+bool gpuCullingEnabled = false;
+bool meshletCullingEnabled = true;
 float GameSpeed = 1;
 bool debugLightCulling = false;
+bool debugOverdraw = false;
 bool occlusionCulling = false;
+bool occlusionCullingHiZ = false;
+bool shadowCaching = false;
 bool temporalAA = false;
 bool temporalAADEBUG = false;
 uint32_t raytraceBounceCount = 2;
@@ -240,17 +288,40 @@ float RESOLUTIONSCALE = 1.0f;
 struct VoxelizedSceneData
 {
 	bool enabled = false;
-	uint32_t res = 128;
-	float voxelsize = 1;
-	XMFLOAT3 center = XMFLOAT3(0, 0, 0);
-	XMFLOAT3 extents = XMFLOAT3(0, 0, 0);
+	uint32_t res = 64; // resolution of a clipmap
+	float voxelsize = 1; // voxel half-extent of the finest clipmap
 	uint32_t numCones = 2;
 	float rayStepSize = 0.75f;
 	float maxDistance = 20.0f;
 	bool secondaryBounceEnabled = false;
 	bool reflectionsEnabled = true;
-	bool centerChangedThisFrame = true;
 	uint32_t mips = 7;
+	uint32_t refreshInterval = 8;
+
+	struct ClipMap
+	{
+		XMINT3 origin = XMINT3(0, 0, 0); // world voxel coordinate of the first voxel
+		XMINT3 voxelized_origin = XMINT3(0, 0, 0); // origin that the voxelized content belongs to
+		bool voxelized = false;
+	} clipmaps[VOXEL_GI_CLIPMAP_COUNT];
+	float voxelized_voxelsize = 0; // the clipmaps are voxelized again when the voxel size changes
+	uint32_t refresh_clipmap = 0; // the clipmap that is voxelized completely at the next refresh
+	bool secondaryBounceValid = false; // the secondary bounce texture was computed from the current clipmaps
+	std::vector<AABB> object_bounds; // the object bounds that were last voxelized, moving objects are voxelized again
+
+	// Edge length of a voxel of the clipmap in world space
+	inline float GetVoxelSize(uint32_t clipmap) const { return voxelsize * 2 * float(1u << clipmap); }
+	// Center of the clipmap in world space
+	inline XMFLOAT3 GetCenter(uint32_t clipmap) const
+	{
+		const float size = GetVoxelSize(clipmap);
+		const int halfres = int(res / 2);
+		return XMFLOAT3(
+			float(clipmaps[clipmap].origin.x + halfres) * size,
+			float(clipmaps[clipmap].origin.y + halfres) * size,
+			float(clipmaps[clipmap].origin.z + halfres) * size
+		);
+	}
 } voxelSceneData;
 
 Texture shadowMapArray_2D;
@@ -261,6 +332,7 @@ Texture shadowMapArray_Transparent_Spot_2D;
 Texture shadowMapArray_Transparent_Cube;
 std::vector<RenderPass> renderpasses_shadow2D;
 std::vector<RenderPass> renderpasses_spot_shadow2D;
+std::vector<RenderPass> renderpasses_spot_shadow2D_load; // atlas tiles are rendered into the page that was cleared before
 std::vector<RenderPass> renderpasses_shadowCube;
 
 std::vector<std::pair<XMFLOAT4X4, XMFLOAT4>> renderableBoxes;
@@ -283,6 +355,9 @@ Texture texture_detailNoise;
 Texture texture_curlNoise;
 Texture texture_weatherMap;
 
+GPUBuffer raytraceTileBuffer;
+wiSpinLock raytraceTileLock;
+
 
 void SetDevice(std::shared_ptr<GraphicsDevice> newDevice)
 {
@@ -429,10 +504,11 @@ struct RenderBatch
 	bool blod;
 	//PE: NEWLOD
 	uint32_t active_lod;
+	uint32_t material; // material index of the first mesh subset, only used for sorting
 #ifdef GGREDUCED
 	//PE: Do not add distance , added in special sort.
 	//PE: Keep LODs in own batches (as no textures needed, fewer state changes).
-	inline void Create(size_t meshIndex, size_t instanceIndex, float _distance, bool bLOD = false, uint32_t activelod = 0)
+	inline void Create(size_t meshIndex, size_t instanceIndex, float _distance, bool bLOD = false, uint32_t activelod = 0, uint32_t materialIndex = 0)
 	{
 		hash = 0;
 		assert(meshIndex < 0x00FFFFFF);
@@ -445,6 +521,7 @@ struct RenderBatch
 		distance = _distance;
 		blod = bLOD;
 		active_lod = activelod;
+		material = materialIndex;
 	}
 
 	inline bool GetLOD() const
@@ -522,10 +599,13 @@ struct RenderQueue
 	{
 		if (batchCount > 1)
 		{
-			std::sort(batchArray, batchArray + batchCount, [sortType](const RenderBatch& a, const RenderBatch& b) -> bool
+			uint64_t* keys = AllocateKeys(batchCount);
+			for (uint32_t i = 0; i < batchCount; ++i)
 			{
-				return ((sortType == SORT_FRONT_TO_BACK) ? (a.distance < b.distance) : (a.distance > b.distance));
-			});
+				const uint32_t distance = DistanceKey(batchArray[i].distance);
+				keys[i] = sortType == SORT_FRONT_TO_BACK ? distance : ~distance;
+			}
+			RadixSort(batchArray, keys, batchCount);
 		}
 	}
 #endif
@@ -533,16 +613,91 @@ struct RenderQueue
 	{
 		if (batchCount > 1)
 		{
-			std::sort(batchArray, batchArray + batchCount, [sortType](const RenderBatch& a, const RenderBatch& b) -> bool
+			//PE: Special sort that use meshindex as primary sort and then sort by distance to maximize instancing
+			//PE: Plus keep overdraw to a min. by sorting be distance as secondary.
+			// The packed key is material (16 bits) | hash: LOD and mesh (32 bits) | quantized distance (16 bits)
+			uint64_t* keys = AllocateKeys(batchCount);
+			for (uint32_t i = 0; i < batchCount; ++i)
 			{
-				//return ((sortType == SORT_FRONT_TO_BACK) ? (a.hash < b.hash) : (a.hash > b.hash));
-				//PE: Special sort that use meshindex as primary sort and then sort by distance to maximize instancing
-				//PE: Plus keep overdraw to a min. by sorting be distance as secondary.
-				if (a.hash == b.hash)
-					return(a.distance < b.distance);
-				else
-					return (a.hash < b.hash);
-			});
+				const RenderBatch& batch = batchArray[i];
+				uint32_t distance = DistanceKey(batch.distance) >> 16u;
+				if (sortType == SORT_BACK_TO_FRONT)
+				{
+					distance = ~distance & 0xFFFF;
+				}
+				keys[i] = (uint64_t(std::min(batch.material, 0xFFFFu)) << 48ull) | (uint64_t(batch.hash) << 16ull) | distance;
+			}
+			RadixSort(batchArray, keys, batchCount);
+		}
+	}
+
+	// Maps a float to an unsigned integer with the same ordering (the upper bits are a coarser quantization of the same value)
+	static inline uint32_t DistanceKey(float distance)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &distance, sizeof(bits));
+		return bits ^ ((bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u);
+	}
+
+	static inline uint64_t* AllocateKeys(uint32_t count)
+	{
+		static thread_local std::vector<uint64_t> keys;
+		keys.resize(count);
+		return keys.data();
+	}
+
+	// Stable LSD radix sort of the batches by their keys with 8 bits per pass
+	//	The passes where every key has the same digit (for example the unused high bits) are skipped
+	static void RadixSort(RenderBatch* batches, uint64_t* keys, uint32_t count)
+	{
+		static thread_local std::vector<RenderBatch> batches_temp;
+		static thread_local std::vector<uint64_t> keys_temp;
+		batches_temp.resize(count);
+		keys_temp.resize(count);
+
+		uint32_t histograms[8][256] = {};
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const uint64_t key = keys[i];
+			for (uint32_t pass = 0; pass < 8; ++pass)
+			{
+				histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+			}
+		}
+
+		RenderBatch* src_batches = batches;
+		uint64_t* src_keys = keys;
+		RenderBatch* dst_batches = batches_temp.data();
+		uint64_t* dst_keys = keys_temp.data();
+		for (uint32_t pass = 0; pass < 8; ++pass)
+		{
+			const uint32_t shift = pass * 8;
+			uint32_t* histogram = histograms[pass];
+			if (histogram[(src_keys[0] >> shift) & 0xFF] == count)
+			{
+				continue;
+			}
+
+			uint32_t offset = 0;
+			for (uint32_t digit = 0; digit < 256; ++digit)
+			{
+				const uint32_t digitCount = histogram[digit];
+				histogram[digit] = offset;
+				offset += digitCount;
+			}
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				const uint32_t dst = histogram[(src_keys[i] >> shift) & 0xFF]++;
+				dst_batches[dst] = src_batches[i];
+				dst_keys[dst] = src_keys[i];
+			}
+			std::swap(src_batches, dst_batches);
+			std::swap(src_keys, dst_keys);
+		}
+
+		if (src_batches != batches)
+		{
+			std::copy(src_batches, src_batches + count, batches);
 		}
 	}
 
@@ -629,6 +784,171 @@ struct InstanceAtlas
 	}
 };
 
+// Lightmap atlas remapping of an object, zero if it has no lightmap
+inline XMFLOAT4 GetLightmapAtlasMulAdd(const ObjectComponent& object, const TextureDesc& lightmap_desc)
+{
+	if (!object.lightmap.IsValid())
+	{
+		return XMFLOAT4(0, 0, 0, 0);
+	}
+
+	auto rect = object.lightmap_rect;
+
+	// eliminate border expansion:
+	rect.x += Scene::atlasClampBorder;
+	rect.y += Scene::atlasClampBorder;
+	rect.w -= Scene::atlasClampBorder * 2;
+	rect.h -= Scene::atlasClampBorder * 2;
+
+	return XMFLOAT4(
+		(float)rect.w / (float)lightmap_desc.Width,
+		(float)rect.h / (float)lightmap_desc.Height,
+		(float)rect.x / (float)lightmap_desc.Width,
+		(float)rect.y / (float)lightmap_desc.Height
+	);
+}
+
+// Material table for the bindless object shaders, it holds a ShaderMaterial for every material of the scene, indexed by material index
+//	The render passes only refer to materials by index, so there is nothing to bind per subset
+//	The buffer is created in UpdatePerFrameData() (the descriptor goes into the frame constants), and the changed materials are scattered into it in UpdateRenderData()
+GPUBuffer materialTable;
+GPUBuffer materialTableUpdates;
+std::vector<uint8_t> materialTableUpdateData;
+const Scene* materialTableScene = nullptr;
+uint32_t materialTableCount = 0;
+static_assert(sizeof(ShaderMaterial) == MATERIALTABLE_STRIDE, "MATERIALTABLE_STRIDE must match ShaderMaterial!");
+
+void PrepareMaterialTable(const Scene& scene)
+{
+	const uint32_t materialCount = (uint32_t)scene.materials.GetCount();
+	if (materialCount == 0 || !device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS))
+	{
+		return;
+	}
+	if (!materialTable.IsValid() || materialTable.GetDesc().ByteWidth < materialCount * sizeof(ShaderMaterial))
+	{
+		GPUBufferDesc desc;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		desc.ByteWidth = uint32_t(sizeof(ShaderMaterial) * materialCount * 2); // growing room for added materials
+		device->CreateBuffer(&desc, nullptr, &materialTable);
+		device->SetName(&materialTable, "materialTable");
+		materialTableScene = nullptr; // contents are lost
+	}
+}
+
+// Persistent instance table for the bindless object shaders, it holds a ShaderInstance for every object of the scene
+//	Only the entries that changed since the last update are uploaded, the render passes refer to the entries by object index
+GPUBuffer instanceTable;
+GPUBuffer instanceTableUpdates;
+std::vector<ShaderInstance> instanceTableEntries; // CPU copy of the table contents, to find the changes
+std::vector<uint8_t> instanceTableUpdateData;
+const Scene* instanceTableScene = nullptr;
+
+void UpdateInstanceTable(const Scene& scene, CommandList cmd)
+{
+	const uint32_t objectCount = (uint32_t)scene.objects.GetCount();
+	if (objectCount == 0)
+	{
+		instanceTableScene = nullptr;
+		return;
+	}
+
+	bool fullUpdate = instanceTableScene != &scene || instanceTableEntries.size() != objectCount;
+	if (!instanceTable.IsValid() || instanceTable.GetDesc().ByteWidth < objectCount * sizeof(ShaderInstance))
+	{
+		GPUBufferDesc desc;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		desc.ByteWidth = uint32_t(sizeof(ShaderInstance) * objectCount * 2); // growing room for added objects
+		device->CreateBuffer(&desc, nullptr, &instanceTable);
+		device->SetName(&instanceTable, "instanceTable");
+		fullUpdate = true;
+	}
+	instanceTableScene = &scene;
+	instanceTableEntries.resize(objectCount);
+
+	const TextureDesc& lightmap_desc = scene.lightmap.GetDesc();
+	instanceTableUpdateData.resize(16);
+	uint32_t updateCount = 0;
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		const ObjectComponent& object = scene.objects[i];
+		const XMFLOAT4X4& worldMatrix = object.transform_index >= 0 ? scene.transforms[object.transform_index].world : IDENTITYMATRIX;
+		const XMFLOAT4X4& worldMatrixPrev = object.prev_transform_index >= 0 ? object.GetWorldMatrixPrev() : IDENTITYMATRIX;
+
+		Instance instance;
+		instance.Create(worldMatrix, object.color, 0, 0, object.emissiveColor);
+		InstancePrev instancePrev;
+		instancePrev.Create(worldMatrixPrev);
+
+		ShaderInstance entry = {};
+		entry.mat0 = instance.mat0;
+		entry.mat1 = instance.mat1;
+		entry.mat2 = instance.mat2;
+		entry.color = instance.userdata.x;
+		entry.emissive = instance.userdata.z;
+		entry.matPrev0 = instancePrev.mat0;
+		entry.matPrev1 = instancePrev.mat1;
+		entry.matPrev2 = instancePrev.mat2;
+		entry.atlasMulAdd = GetLightmapAtlasMulAdd(object, lightmap_desc);
+
+		if (!fullUpdate && std::memcmp(&entry, &instanceTableEntries[i], sizeof(entry)) == 0)
+		{
+			continue;
+		}
+		instanceTableEntries[i] = entry;
+
+		const size_t offset = instanceTableUpdateData.size();
+		instanceTableUpdateData.resize(offset + INSTANCETABLE_UPDATE_STRIDE);
+		uint8_t* update = instanceTableUpdateData.data() + offset;
+		std::memset(update, 0, 16);
+		std::memcpy(update, &i, sizeof(i));
+		std::memcpy(update + 16, &entry, sizeof(entry));
+		updateCount++;
+	}
+
+	if (updateCount == 0)
+	{
+		return;
+	}
+	std::memset(instanceTableUpdateData.data(), 0, 16);
+	std::memcpy(instanceTableUpdateData.data(), &updateCount, sizeof(updateCount));
+
+	if (!instanceTableUpdates.IsValid() || instanceTableUpdates.GetDesc().ByteWidth < instanceTableUpdateData.size())
+	{
+		GPUBufferDesc desc;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_SHADER_RESOURCE;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		desc.ByteWidth = uint32_t(instanceTableUpdateData.size() * 2);
+		device->CreateBuffer(&desc, nullptr, &instanceTableUpdates);
+		device->SetName(&instanceTableUpdates, "instanceTableUpdates");
+	}
+
+	device->EventBegin("Instance Table Update", cmd);
+	device->UpdateBuffer(&instanceTableUpdates, instanceTableUpdateData.data(), cmd, (int)instanceTableUpdateData.size());
+
+	device->BindComputeShader(&shaders[CSTYPE_INSTANCETABLE_UPDATE], cmd);
+	device->BindResource(CS, &instanceTableUpdates, INSTANCETABLESLOT_IN_UPDATES, cmd);
+	const GPUResource* uavs[] = {
+		&instanceTable,
+	};
+	device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+	device->Dispatch((updateCount + INSTANCETABLE_UPDATE_THREADCOUNT - 1) / INSTANCETABLE_UPDATE_THREADCOUNT, 1, 1, cmd);
+
+	GPUBarrier barriers[] = {
+		GPUBarrier::Memory(),
+	};
+	device->Barrier(barriers, arraysize(barriers), cmd);
+	device->UnbindUAVs(0, 1, cmd);
+	device->UnbindResources(INSTANCETABLESLOT_IN_UPDATES, 1, cmd);
+	device->EventEnd(cmd);
+}
+
 
 const Sampler* GetSampler(int slot)
 {
@@ -636,6 +956,10 @@ const Sampler* GetSampler(int slot)
 }
 const Shader* GetShader(SHADERTYPE id)
 {
+	if (ondemandShaders[id].pending.load())
+	{
+		LoadShaderOnDemand(id);
+	}
 	return &shaders[id];
 }
 const InputLayout* GetInputLayout(ILTYPES id)
@@ -691,8 +1015,23 @@ PipelineState PSO_object
 	[OBJECTRENDERING_TESSELLATION_COUNT]
 	[OBJECTRENDERING_ALPHATEST_COUNT];
 PipelineState PSO_object_terrain[RENDERPASS_COUNT];
+
+// Specialized permutations of the main pass opaque PBR object shader, for the materials that don't use all of its features
+//	The last one would be the same as PSTYPE_OBJECT, so it is not created
+Shader shaders_object_permutation[OBJECTSHADER_PERMUTATION_COUNT];
+PipelineState PSO_object_permutation
+	[OBJECTSHADER_PERMUTATION_COUNT]
+	[OBJECTRENDERING_DOUBLESIDED_COUNT]
+	[OBJECTRENDERING_ALPHATEST_COUNT];
+inline const PipelineState* GetObjectPermutationPSO(const MaterialComponent& material, OBJECTRENDERING_DOUBLESIDED doublesided, bool alphatest, const PipelineState* pso)
+{
+	const PipelineState* permutation_pso = &PSO_object_permutation[material.GetShaderPermutation()][doublesided][alphatest];
+	return permutation_pso->IsValid() ? permutation_pso : pso;
+}
 PipelineState PSO_object_wire;
 PipelineState PSO_object_wire_tessellation;
+PipelineState PSO_object_overdraw[OBJECTRENDERING_DOUBLESIDED_BACKSIDE]; // [doublesided]
+bool overdrawRender[COMMANDLIST_COUNT] = {}; // DrawOverdraw() is drawing into the command list
 
 std::vector<CustomShader> customShaders;
 int RegisterCustomShader(const CustomShader& customShader)
@@ -1011,6 +1350,7 @@ PipelineState PSO_decal;
 PipelineState PSO_occlusionquery;
 PipelineState PSO_impostor[RENDERPASS_COUNT];
 PipelineState PSO_impostor_wire;
+PipelineState PSO_impostor_overdraw;
 PipelineState PSO_captureimpostor_albedo;
 PipelineState PSO_captureimpostor_normal;
 PipelineState PSO_captureimpostor_surface;
@@ -1037,6 +1377,7 @@ PipelineState PSO_renderlightmap;
 PipelineState PSO_lensflare;
 
 PipelineState PSO_downsampledepthbuffer;
+PipelineState PSO_shadowcache_copy;
 PipelineState PSO_deferredcomposition;
 PipelineState PSO_sss_skin;
 PipelineState PSO_sss_snow;
@@ -1095,9 +1436,112 @@ size_t GetShaderDumpCount()
 }
 #endif // SHADERDUMP
 
-bool LoadShader(SHADERSTAGE stage, Shader& shader, const std::string& filename, SHADERMODEL minshadermodel)
+std::atomic<uint32_t> shaders_loaded{ 0 };
+std::atomic<uint32_t> shaders_failed{ 0 };
+
+// The compiler inputs of the loaded shaders, for compiling them again when they are outdated:
+struct ShaderSource
+{
+	SHADERSTAGE stage = SHADERSTAGE_COUNT;
+	SHADERMODEL minshadermodel = SHADERMODEL_5_0;
+	std::string sourcefilename;
+	std::vector<std::string> defines;
+};
+std::unordered_map<std::string, ShaderSource> shader_sources;
+// The binary that every shader was created from, so the unchanged ones are kept when the shaders are reloaded:
+struct LoadedShaderBinary
+{
+	std::string filename;
+	std::filesystem::file_time_type time;
+};
+std::unordered_map<const Shader*, LoadedShaderBinary> loaded_shader_binaries;
+// The replaced shader states are kept alive, so a new shader can't get the same address in the pipeline state hashes
+std::vector<std::shared_ptr<void>> retired_shader_states;
+std::mutex shader_reload_locker;
+std::string shader_bundle; // the mounted shader bundle file
+std::mutex shader_bundle_locker;
+
+ShaderLoadingStatistics GetShaderLoadingStatistics()
+{
+	ShaderLoadingStatistics statistics;
+	statistics.loaded = shaders_loaded.load();
+	statistics.failed = shaders_failed.load();
+	return statistics;
+}
+
+bool MountShaderBundle()
+{
+	std::lock_guard<std::mutex> lock(shader_bundle_locker);
+	if (!shader_bundle.empty())
+	{
+		wiPackage::Unmount(shader_bundle);
+		shader_bundle.clear();
+	}
+
+	std::string bundle = SHADERPATH;
+	while (!bundle.empty() && (bundle.back() == '/' || bundle.back() == '\\'))
+	{
+		bundle.pop_back();
+	}
+	bundle += ".wipak";
+	if (!wiHelper::FileExists(bundle) || !wiPackage::Mount(bundle, SHADERPATH))
+	{
+		return false;
+	}
+	shader_bundle = bundle;
+	wiBackLog::post(("shader bundle mounted: " + bundle).c_str());
+	return true;
+}
+
+static bool LoadShaderInternal(SHADERSTAGE stage, Shader& shader, const std::string& filename, SHADERMODEL minshadermodel, const std::vector<std::string>& permutation_defines);
+bool LoadShader(SHADERSTAGE stage, Shader& shader, const std::string& filename, SHADERMODEL minshadermodel, const std::vector<std::string>& permutation_defines)
+{
+	const std::string shaderbinaryfilename = SHADERPATH + wiShaderCompiler::GetPermutationFileName(filename, permutation_defines);
+	std::error_code ec;
+	const auto time = std::filesystem::last_write_time(shaderbinaryfilename, ec);
+	if (!ec && shader.IsValid() && !wiShaderCompiler::IsShaderOutdated(shaderbinaryfilename))
+	{
+		std::lock_guard<std::mutex> lock(shader_reload_locker);
+		auto it = loaded_shader_binaries.find(&shader);
+		if (it != loaded_shader_binaries.end() && it->second.filename == shaderbinaryfilename && it->second.time == time)
+		{
+			return true; // the same binary is already created
+		}
+	}
+	if (shader.IsValid())
+	{
+		std::lock_guard<std::mutex> lock(shader_reload_locker);
+		retired_shader_states.push_back(shader.internal_state);
+	}
+
+	const bool success = LoadShaderInternal(stage, shader, filename, minshadermodel, permutation_defines);
+	if (success)
+	{
+		std::error_code ec_loaded;
+		const auto time_loaded = std::filesystem::last_write_time(shaderbinaryfilename, ec_loaded);
+		std::lock_guard<std::mutex> lock(shader_reload_locker);
+		if (ec_loaded)
+		{
+			loaded_shader_binaries.erase(&shader); // not a file on disk (for example from the shader dump), it can't be checked
+		}
+		else
+		{
+			loaded_shader_binaries[&shader] = { shaderbinaryfilename, time_loaded };
+		}
+	}
+	if (success)
+	{
+		shaders_loaded.fetch_add(1);
+	}
+	else
+	{
+		shaders_failed.fetch_add(1);
+	}
+	return success;
+}
+static bool LoadShaderInternal(SHADERSTAGE stage, Shader& shader, const std::string& filename, SHADERMODEL minshadermodel, const std::vector<std::string>& permutation_defines)
 {
-	std::string shaderbinaryfilename = SHADERPATH + filename;
+	std::string shaderbinaryfilename = SHADERPATH + wiShaderCompiler::GetPermutationFileName(filename, permutation_defines);
 
 #ifdef SHADERDUMP_ENABLED
 	
@@ -1114,6 +1558,17 @@ bool LoadShader(SHADERSTAGE stage, Shader& shader, const std::string& filename,
 #endif // SHADERDUMP_ENABLED
 
 	wiShaderCompiler::RegisterShader(shaderbinaryfilename);
+	{
+		std::string sourcedir = SHADERSOURCEPATH;
+		wiHelper::MakePathAbsolute(sourcedir);
+		ShaderSource source;
+		source.stage = stage;
+		source.minshadermodel = minshadermodel;
+		source.sourcefilename = wiHelper::ReplaceExtension(sourcedir + filename, "hlsl");
+		source.defines = permutation_defines;
+		std::lock_guard<std::mutex> lock(shader_reload_locker);
+		shader_sources[shaderbinaryfilename] = std::move(source);
+	}
 
 	if (wiShaderCompiler::IsShaderOutdated(shaderbinaryfilename))
 	{
@@ -1121,6 +1576,7 @@ bool LoadShader(SHADERSTAGE stage, Shader& shader, const std::string& filename,
 		input.format = device->GetShaderFormat();
 		input.stage = stage;
 		input.minshadermodel = minshadermodel;
+		input.defines = permutation_defines;
 
 		std::string sourcedir = SHADERSOURCEPATH;
 		wiHelper::MakePathAbsolute(sourcedir);
@@ -1128,6 +1584,7 @@ bool LoadShader(SHADERSTAGE stage, Shader& shader, const std::string& filename,
 
 		input.shadersourcefilename = wiHelper::ReplaceExtension(sourcedir + filename, "hlsl");
 
+		wiProfiler::MarkEvent("Shader Compile");
 		wiShaderCompiler::CompilerOutput output;
 		wiShaderCompiler::Compile(input, output);
 
@@ -1148,6 +1605,13 @@ bool LoadShader(SHADERSTAGE stage, Shader& shader, const std::string& filename,
 		}
 	}
 
+	// The shaders of an uncompressed bundle are created from the mapped memory without copying them:
+	size_t size = 0;
+	auto mapped = wiHelper::FileMap(shaderbinaryfilename, size);
+	if (mapped != nullptr)
+	{
+		return device->CreateShader(stage, mapped.get(), size, &shader);
+	}
 	std::vector<uint8_t> buffer;
 	if (wiHelper::FileRead(shaderbinaryfilename, buffer))
 	{
@@ -1157,9 +1621,129 @@ bool LoadShader(SHADERSTAGE stage, Shader& shader, const std::string& filename,
 	return false;
 }
 
+void RegisterShaderOnDemand(SHADERSTAGE stage, SHADERTYPE id, const std::string& filename, SHADERGROUP group, SHADERMODEL minshadermodel = SHADERMODEL_5_0)
+{
+	OnDemandShader& ondemand = ondemandShaders[id];
+	std::lock_guard<std::mutex> lock(ondemand.locker);
+	ondemand.stage = stage;
+	ondemand.filename = filename;
+	ondemand.minshadermodel = minshadermodel;
+	ondemand.group = group;
+	ondemand.pending.store(true);
+}
+bool LoadShaderOnDemand(SHADERTYPE id)
+{
+	OnDemandShader& ondemand = ondemandShaders[id];
+	std::lock_guard<std::mutex> lock(ondemand.locker);
+	if (!ondemand.pending.load())
+	{
+		return shaders[id].IsValid(); // created by an other thread meanwhile, or not an on demand shader
+	}
+	const bool success = LoadShader(ondemand.stage, shaders[id], ondemand.filename, ondemand.minshadermodel);
+	ondemand.pending.store(false); // a failed shader is not retried every frame, only after the shaders are reloaded
+	return success;
+}
+void PrefetchShaders(SHADERGROUP group)
+{
+	if (shadergroupPrefetched[group].exchange(true))
+	{
+		return;
+	}
+	shaderPrefetchCtx.priority = wiJobSystem::Priority::Background;
+	for (int i = 0; i < SHADERTYPE_COUNT; ++i)
+	{
+		if (ondemandShaders[i].pending.load() && ondemandShaders[i].group == group)
+		{
+			wiJobSystem::Execute(shaderPrefetchCtx, [i](wiJobArgs args) {
+				LoadShaderOnDemand((SHADERTYPE)i);
+				});
+		}
+	}
+}
+uint32_t GetOnDemandShaderPendingCount()
+{
+	uint32_t count = 0;
+	for (auto& x : ondemandShaders)
+	{
+		if (x.pending.load())
+		{
+			count++;
+		}
+	}
+	return count;
+}
 
 void LoadShaders()
 {
+	// The prefetching jobs of the previous shaders must finish before the shaders are registered again:
+	wiJobSystem::Wait(shaderPrefetchCtx);
+	for (auto& x : shadergroupPrefetched)
+	{
+		x.store(false);
+	}
+
+	// The shaders of the optional features are registered before starting the jobs, because PSO creation can already request them with GetShader():
+	RegisterShaderOnDemand(CS, CSTYPE_VOXELSCENECOPYCLEAR, "voxelSceneCopyClearCS.cso", SHADERGROUP_VOXELGI);
+	RegisterShaderOnDemand(CS, CSTYPE_VOXELSCENECOPYCLEAR_TEMPORALSMOOTHING, "voxelSceneCopyClearCS_TemporalSmoothing.cso", SHADERGROUP_VOXELGI);
+	RegisterShaderOnDemand(CS, CSTYPE_VOXELRADIANCESECONDARYBOUNCE, "voxelRadianceSecondaryBounceCS.cso", SHADERGROUP_VOXELGI);
+	RegisterShaderOnDemand(CS, CSTYPE_VOXELCLIPMAPCLEAR, "voxelClipMapClearCS.cso", SHADERGROUP_VOXELGI);
+	if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
+	{
+		RegisterShaderOnDemand(CS, CSTYPE_RAYTRACE, "raytraceCS_rtapi.cso", SHADERGROUP_PATHTRACING, SHADERMODEL_6_5);
+	}
+	else
+	{
+		RegisterShaderOnDemand(CS, CSTYPE_RAYTRACE, "raytraceCS.cso", SHADERGROUP_PATHTRACING);
+	}
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_SSR_RAYTRACE, "ssr_raytraceCS.cso", SHADERGROUP_SSR);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_SSR_RESOLVE, "ssr_resolveCS.cso", SHADERGROUP_SSR);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_SSR_TEMPORAL, "ssr_temporalCS.cso", SHADERGROUP_SSR);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_SSR_MEDIAN, "ssr_medianCS.cso", SHADERGROUP_SSR);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_LIGHTSHAFTS, "lightShaftsCS.cso", SHADERGROUP_LIGHTSHAFTS);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_DEPTHOFFIELD_TILEMAXCOC_HORIZONTAL, "depthoffield_tileMaxCOC_horizontalCS.cso", SHADERGROUP_DEPTHOFFIELD);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_DEPTHOFFIELD_TILEMAXCOC_VERTICAL, "depthoffield_tileMaxCOC_verticalCS.cso", SHADERGROUP_DEPTHOFFIELD);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_DEPTHOFFIELD_NEIGHBORHOODMAXCOC, "depthoffield_neighborhoodMaxCOCCS.cso", SHADERGROUP_DEPTHOFFIELD);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_DEPTHOFFIELD_KICKJOBS, "depthoffield_kickjobsCS.cso", SHADERGROUP_DEPTHOFFIELD);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_DEPTHOFFIELD_PREPASS, "depthoffield_prepassCS.cso", SHADERGROUP_DEPTHOFFIELD);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_DEPTHOFFIELD_PREPASS_EARLYEXIT, "depthoffield_prepassCS_earlyexit.cso", SHADERGROUP_DEPTHOFFIELD);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_DEPTHOFFIELD_MAIN, "depthoffield_mainCS.cso", SHADERGROUP_DEPTHOFFIELD);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_DEPTHOFFIELD_MAIN_EARLYEXIT, "depthoffield_mainCS_earlyexit.cso", SHADERGROUP_DEPTHOFFIELD);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_DEPTHOFFIELD_MAIN_CHEAP, "depthoffield_mainCS_cheap.cso", SHADERGROUP_DEPTHOFFIELD);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_DEPTHOFFIELD_POSTFILTER, "depthoffield_postfilterCS.cso", SHADERGROUP_DEPTHOFFIELD);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_DEPTHOFFIELD_UPSAMPLE, "depthoffield_upsampleCS.cso", SHADERGROUP_DEPTHOFFIELD);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_MOTIONBLUR_TILEMAXVELOCITY_HORIZONTAL, "motionblur_tileMaxVelocity_horizontalCS.cso", SHADERGROUP_MOTIONBLUR);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_MOTIONBLUR_TILEMAXVELOCITY_VERTICAL, "motionblur_tileMaxVelocity_verticalCS.cso", SHADERGROUP_MOTIONBLUR);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_MOTIONBLUR_NEIGHBORHOODMAXVELOCITY, "motionblur_neighborhoodMaxVelocityCS.cso", SHADERGROUP_MOTIONBLUR);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_MOTIONBLUR_KICKJOBS, "motionblur_kickjobsCS.cso", SHADERGROUP_MOTIONBLUR);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_MOTIONBLUR, "motionblurCS.cso", SHADERGROUP_MOTIONBLUR);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_MOTIONBLUR_EARLYEXIT, "motionblurCS_earlyexit.cso", SHADERGROUP_MOTIONBLUR);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_MOTIONBLUR_CHEAP, "motionblurCS_cheap.cso", SHADERGROUP_MOTIONBLUR);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_BLOOMSEPARATE, "bloomseparateCS.cso", SHADERGROUP_BLOOM);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_BLOOMCOMBINE, "bloomcombineCS.cso", SHADERGROUP_BLOOM);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_SHAPENOISE, "volumetricCloud_shapenoiseCS.cso", SHADERGROUP_VOLUMETRICCLOUDS);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_DETAILNOISE, "volumetricCloud_detailnoiseCS.cso", SHADERGROUP_VOLUMETRICCLOUDS);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_CURLNOISE, "volumetricCloud_curlnoiseCS.cso", SHADERGROUP_VOLUMETRICCLOUDS);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_WEATHERMAP, "volumetricCloud_weathermapCS.cso", SHADERGROUP_VOLUMETRICCLOUDS);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_RENDER, "volumetricCloud_renderCS.cso", SHADERGROUP_VOLUMETRICCLOUDS);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_REPROJECT, "volumetricCloud_reprojectCS.cso", SHADERGROUP_VOLUMETRICCLOUDS);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_TEMPORAL, "volumetricCloud_temporalCS.cso", SHADERGROUP_VOLUMETRICCLOUDS);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_TONEMAP_CHROMATIC_ABERRATION, "tonemap_chromatic_aberrationCS.cso", SHADERGROUP_CHROMATIC_ABERRATION);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_TONEMAP_SHARPEN_CHROMATIC_ABERRATION, "tonemap_sharpen_chromatic_aberrationCS.cso", SHADERGROUP_CHROMATIC_ABERRATION);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_CHROMATIC_ABERRATION, "chromatic_aberrationCS.cso", SHADERGROUP_CHROMATIC_ABERRATION);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_FSR_UPSCALING, "fsr_upscalingCS.cso", SHADERGROUP_FSR);
+	RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_FSR_SHARPEN, "fsr_sharpenCS.cso", SHADERGROUP_FSR);
+	if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
+	{
+		RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_RTSHADOW, "rtshadowCS.cso", SHADERGROUP_RTSHADOW, SHADERMODEL_6_5);
+		RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_RTSHADOW_DENOISE_TILECLASSIFICATION, "rtshadow_denoise_tileclassificationCS.cso", SHADERGROUP_RTSHADOW);
+		RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_RTSHADOW_DENOISE_FILTER, "rtshadow_denoise_filterCS.cso", SHADERGROUP_RTSHADOW);
+		RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_RTSHADOW_DENOISE_TEMPORAL, "rtshadow_denoise_temporalCS.cso", SHADERGROUP_RTSHADOW);
+
+		RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_RTAO, "rtaoCS.cso", SHADERGROUP_RTAO, SHADERMODEL_6_5);
+		RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_RTAO_DENOISE_TILECLASSIFICATION, "rtao_denoise_tileclassificationCS.cso", SHADERGROUP_RTAO);
+		RegisterShaderOnDemand(CS, CSTYPE_POSTPROCESS_RTAO_DENOISE_FILTER, "rtao_denoise_filterCS.cso", SHADERGROUP_RTAO);
+	}
+
 	wiJobSystem::context ctx;
 
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) {
@@ -1303,6 +1887,7 @@ void LoadShaders()
 		wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(VS, shaders[VSTYPE_SHADOWCUBEMAPRENDER], "cubeShadowVS.cso"); });
 		wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(VS, shaders[VSTYPE_SHADOWCUBEMAPRENDER_ALPHATEST], "cubeShadowVS_alphatest.cso"); });
 		wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(VS, shaders[VSTYPE_SHADOWCUBEMAPRENDER_TRANSPARENT], "cubeShadowVS_transparent.cso"); });
+		wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(VS, shaders[VSTYPE_SHADOWCACHE_COPY], "shadowCacheCopyVS.cso"); });
 	}
 	else
 	{
@@ -1320,6 +1905,9 @@ void LoadShaders()
 	}
 
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_OBJECT], "objectPS.cso"); });
+	wiJobSystem::Dispatch(ctx, OBJECTSHADER_PERMUTATION_ALL, 1, [](wiJobArgs args) {
+		LoadShader(PS, shaders_object_permutation[args.jobIndex], "objectPS.cso", SHADERMODEL_5_0, { "OBJECTSHADER_PERMUTATION=" + std::to_string(args.jobIndex) });
+		});
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_OBJECT_TRANSPARENT], "objectPS_transparent.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_OBJECT_PLANARREFLECTION], "objectPS_planarreflection.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_OBJECT_TRANSPARENT_PLANARREFLECTION], "objectPS_transparent_planarreflection.cso"); });
@@ -1347,6 +1935,7 @@ void LoadShaders()
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_OBJECT_DEBUG], "objectPS_debug.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_OBJECT_PAINTRADIUS], "objectPS_paintradius.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_OBJECT_SIMPLE], "objectPS_simple.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_OVERDRAW], "overdrawPS.cso"); });
 
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_OBJECT_LOD], "objectPS_lod.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_OBJECT_TRANSPARENT_LOD], "objectPS_lod.cso"); });
@@ -1389,6 +1978,7 @@ void LoadShaders()
 	}
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_RAYTRACE_DEBUGBVH], "raytrace_debugbvhPS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_DOWNSAMPLEDEPTHBUFFER], "downsampleDepthBuffer4xPS.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_SHADOWCACHE_COPY], "shadowCacheCopyPS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_POSTPROCESS_UPSAMPLE_BILATERAL], "upsample_bilateralPS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_POSTPROCESS_OUTLINE], "outlinePS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(PS, shaders[PSTYPE_LENSFLARE], "lensFlarePS.cso"); });
@@ -1404,13 +1994,11 @@ void LoadShaders()
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_TILEFRUSTUMS], "tileFrustumsCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_LIGHTCULLING], "lightCullingCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_LIGHTCULLING_DEBUG], "lightCullingCS_DEBUG.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_OVERDRAW_HEATMAP], "overdraw_heatmapCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_LIGHTCULLING_ADVANCED], "lightCullingCS_ADVANCED.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_LIGHTCULLING_ADVANCED_DEBUG], "lightCullingCS_ADVANCED_DEBUG.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_LIGHTCLUSTERCULLING], "lightClusterCullingCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_RESOLVEMSAADEPTHSTENCIL], "resolveMSAADepthStencilCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_VOXELSCENECOPYCLEAR], "voxelSceneCopyClearCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_VOXELSCENECOPYCLEAR_TEMPORALSMOOTHING], "voxelSceneCopyClearCS_TemporalSmoothing.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_VOXELRADIANCESECONDARYBOUNCE], "voxelRadianceSecondaryBounceCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_VOXELCLEARONLYNORMAL], "voxelClearOnlyNormalCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_SKYATMOSPHERE_TRANSMITTANCELUT], "skyAtmosphere_transmittanceLutCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_SKYATMOSPHERE_MULTISCATTEREDLUMINANCELUT], "skyAtmosphere_multiScatteredLuminanceLutCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_SKYATMOSPHERE_SKYVIEWLUT], "skyAtmosphere_skyViewLutCS.cso"); });
@@ -1423,6 +2011,9 @@ void LoadShaders()
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_GENERATEMIPCHAINCUBE_FLOAT4], "generateMIPChainCubeCS_float4.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_GENERATEMIPCHAINCUBEARRAY_UNORM4], "generateMIPChainCubeArrayCS_unorm4.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_GENERATEMIPCHAINCUBEARRAY_FLOAT4], "generateMIPChainCubeArrayCS_float4.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_SPD_UNORM4], "spdCS_unorm4.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_SPD_FLOAT4], "spdCS_float4.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_SPD_MAX], "spdCS_max.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_FILTERENVMAP], "filterEnvMapCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_COPYTEXTURE2D_UNORM4], "copytexture2D_unorm4CS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_COPYTEXTURE2D_FLOAT4], "copytexture2D_float4CS.cso"); });
@@ -1430,14 +2021,18 @@ void LoadShaders()
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_COPYTEXTURE2D_FLOAT4_BORDEREXPAND], "copytexture2D_float4_borderexpandCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_SKINNING], "skinningCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_SKINNING_LDS], "skinningCS_LDS.cso"); });
-	if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
-	{
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_RAYTRACE], "raytraceCS_rtapi.cso", SHADERMODEL_6_5); });
-	}
-	else
-	{
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_RAYTRACE], "raytraceCS.cso"); });
-	}
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_BONETRANSFORMS], "boneTransformsCS.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_MORPH], "morphCS.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_CLOTH_INTEGRATE], "clothIntegrateCS.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_CLOTH_SOLVE], "clothSolveCS.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_CLOTH_FINISH], "clothFinishCS.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_INSTANCETABLE_UPDATE], "instanceTableUpdateCS.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_MATERIALTABLE_UPDATE], "materialTableUpdateCS.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_GPUCULLING], "gpuCullingCS.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_MESHLETCULLING], "meshletCullingCS.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_GPUCULLING_BOXES], "gpuCullingBoxesCS.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_INSTANCECULLING], "instanceCullingCS.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_OCCLUSIONCULLING_HIZ], "occlusionCullingHiZCS.cso"); });
 
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_PAINT_TEXTURE], "paint_textureCS.cso"); });
 
@@ -1471,46 +2066,13 @@ void LoadShaders()
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_MSAO_BLURUPSAMPLE_BLENDOUT], "msao_blurupsampleCS_blendout.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_MSAO_BLURUPSAMPLE_PREMIN], "msao_blurupsampleCS_premin.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_MSAO_BLURUPSAMPLE_PREMIN_BLENDOUT], "msao_blurupsampleCS_premin_blendout.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_SSR_RAYTRACE], "ssr_raytraceCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_SSR_RESOLVE], "ssr_resolveCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_SSR_TEMPORAL], "ssr_temporalCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_SSR_MEDIAN], "ssr_medianCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_LIGHTSHAFTS], "lightShaftsCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_TILEMAXCOC_HORIZONTAL], "depthoffield_tileMaxCOC_horizontalCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_TILEMAXCOC_VERTICAL], "depthoffield_tileMaxCOC_verticalCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_NEIGHBORHOODMAXCOC], "depthoffield_neighborhoodMaxCOCCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_KICKJOBS], "depthoffield_kickjobsCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_PREPASS], "depthoffield_prepassCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_PREPASS_EARLYEXIT], "depthoffield_prepassCS_earlyexit.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_MAIN], "depthoffield_mainCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_MAIN_EARLYEXIT], "depthoffield_mainCS_earlyexit.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_MAIN_CHEAP], "depthoffield_mainCS_cheap.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_POSTFILTER], "depthoffield_postfilterCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_UPSAMPLE], "depthoffield_upsampleCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_MOTIONBLUR_TILEMAXVELOCITY_HORIZONTAL], "motionblur_tileMaxVelocity_horizontalCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_MOTIONBLUR_TILEMAXVELOCITY_VERTICAL], "motionblur_tileMaxVelocity_verticalCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_MOTIONBLUR_NEIGHBORHOODMAXVELOCITY], "motionblur_neighborhoodMaxVelocityCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_MOTIONBLUR_KICKJOBS], "motionblur_kickjobsCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_MOTIONBLUR], "motionblurCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_MOTIONBLUR_EARLYEXIT], "motionblurCS_earlyexit.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_MOTIONBLUR_CHEAP], "motionblurCS_cheap.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_BLOOMSEPARATE], "bloomseparateCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_BLOOMCOMBINE], "bloomcombineCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_SHAPENOISE], "volumetricCloud_shapenoiseCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_DETAILNOISE], "volumetricCloud_detailnoiseCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_CURLNOISE], "volumetricCloud_curlnoiseCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_WEATHERMAP], "volumetricCloud_weathermapCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_RENDER], "volumetricCloud_renderCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_REPROJECT], "volumetricCloud_reprojectCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_TEMPORAL], "volumetricCloud_temporalCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_FXAA], "fxaaCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_TEMPORALAA], "temporalaaCS.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_TEMPORALAA_UPSAMPLE], "temporalaaCS_upsample.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_LINEARDEPTH], "lineardepthCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_SHARPEN], "sharpenCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_TONEMAP], "tonemapCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_FSR_UPSCALING], "fsr_upscalingCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_FSR_SHARPEN], "fsr_sharpenCS.cso"); });
-	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_CHROMATIC_ABERRATION], "chromatic_aberrationCS.cso"); });
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_TONEMAP_SHARPEN], "tonemap_sharpenCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_UPSAMPLE_BILATERAL_FLOAT1], "upsample_bilateral_float1CS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_UPSAMPLE_BILATERAL_UNORM1], "upsample_bilateral_unorm1CS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_UPSAMPLE_BILATERAL_FLOAT4], "upsample_bilateral_float4CS.cso"); });
@@ -1520,19 +2082,6 @@ void LoadShaders()
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_NORMALSFROMDEPTH], "normalsfromdepthCS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_SCREENSPACESHADOW], "screenspaceshadowCS.cso"); });
 
-	if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
-	{
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_RTSHADOW], "rtshadowCS.cso", SHADERMODEL_6_5); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_RTSHADOW_DENOISE_TILECLASSIFICATION], "rtshadow_denoise_tileclassificationCS.cso"); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_RTSHADOW_DENOISE_FILTER], "rtshadow_denoise_filterCS.cso"); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_RTSHADOW_DENOISE_TEMPORAL], "rtshadow_denoise_temporalCS.cso"); });
-
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_RTAO], "rtaoCS.cso", SHADERMODEL_6_5); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_RTAO_DENOISE_TILECLASSIFICATION], "rtao_denoise_tileclassificationCS.cso"); });
-		wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(CS, shaders[CSTYPE_POSTPROCESS_RTAO_DENOISE_FILTER], "rtao_denoise_filterCS.cso"); });
-
-	}
-
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(HS, shaders[HSTYPE_OBJECT], "objectHS.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(HS, shaders[HSTYPE_OBJECT_PREPASS], "objectHS_prepass.cso"); });
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) { LoadShader(HS, shaders[HSTYPE_OBJECT_PREPASS_ALPHATEST], "objectHS_prepass_alphatest.cso"); });
@@ -1740,6 +2289,18 @@ void LoadShaders()
 							}
 
 							device->CreatePipelineState(&desc, &PSO_object[shaderType][renderPass][blendMode][doublesided][tessellation][alphatest]);
+
+							if (shaderType == MaterialComponent::SHADERTYPE_PBR && renderPass == RENDERPASS_MAIN && blendMode == BLENDMODE_OPAQUE && !tessellation)
+							{
+								for (uint32_t permutation = 0; permutation < OBJECTSHADER_PERMUTATION_ALL; ++permutation)
+								{
+									if (shaders_object_permutation[permutation].IsValid())
+									{
+										desc.ps = &shaders_object_permutation[permutation];
+										device->CreatePipelineState(&desc, &PSO_object_permutation[permutation][doublesided][alphatest]);
+									}
+								}
+							}
 						}
 					}
 				}
@@ -1842,6 +2403,30 @@ void LoadShaders()
 		desc.ds = &shaders[DSTYPE_OBJECT_SIMPLE];
 		device->CreatePipelineState(&desc, &PSO_object_wire_tessellation);
 		});
+	wiJobSystem::Execute(ctx, [](wiJobArgs args) {
+		// Overdraw visualizer: every rasterized layer is counted, without depth testing
+		PipelineStateDesc desc;
+		desc.vs = &shaders[VSTYPE_OBJECT_SIMPLE];
+		desc.ps = &shaders[PSTYPE_OVERDRAW];
+		desc.rs = &rasterizers[RSTYPE_FRONT];
+		desc.bs = &blendStates[BSTYPE_ADDITIVE];
+		desc.dss = &depthStencils[DSSTYPE_XRAY];
+		desc.il = &inputLayouts[ILTYPE_OBJECT_POS_TEX];
+
+		if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS))
+		{
+			desc.il = nullptr;
+		}
+
+		device->CreatePipelineState(&desc, &PSO_object_overdraw[OBJECTRENDERING_DOUBLESIDED_DISABLED]);
+
+		desc.rs = &rasterizers[RSTYPE_DOUBLESIDED];
+		device->CreatePipelineState(&desc, &PSO_object_overdraw[OBJECTRENDERING_DOUBLESIDED_ENABLED]);
+
+		desc.vs = &shaders[VSTYPE_IMPOSTOR];
+		desc.il = nullptr;
+		device->CreatePipelineState(&desc, &PSO_impostor_overdraw);
+		});
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) {
 		PipelineStateDesc desc;
 		desc.vs = &shaders[VSTYPE_CUBE];
@@ -1999,6 +2584,19 @@ void LoadShaders()
 
 		device->CreatePipelineState(&desc, &PSO_downsampledepthbuffer);
 		});
+	if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RENDERTARGET_AND_VIEWPORT_ARRAYINDEX_WITHOUT_GS))
+	{
+		wiJobSystem::Execute(ctx, [](wiJobArgs args) {
+			PipelineStateDesc desc;
+			desc.vs = &shaders[VSTYPE_SHADOWCACHE_COPY];
+			desc.ps = &shaders[PSTYPE_SHADOWCACHE_COPY];
+			desc.rs = &rasterizers[RSTYPE_DOUBLESIDED];
+			desc.bs = &blendStates[BSTYPE_COLORWRITEDISABLE];
+			desc.dss = &depthStencils[DSSTYPE_WRITEONLY];
+
+			device->CreatePipelineState(&desc, &PSO_shadowcache_copy);
+			});
+	}
 	wiJobSystem::Execute(ctx, [](wiJobArgs args) {
 		PipelineStateDesc desc;
 		desc.vs = &shaders[VSTYPE_SCREEN];
@@ -2278,6 +2876,8 @@ void LoadBuffers()
 	bd.StructureByteStride = sizeof(XMMATRIX);
 	device->CreateBuffer(&bd, nullptr, &resourceBuffers[RBTYPE_MATRIXARRAY]);
 	device->SetName(&resourceBuffers[RBTYPE_MATRIXARRAY], "MatrixArray");
+	entityArrayUploaded.clear();
+	matrixArrayUploaded.clear();
 
 
 	// The following buffers will be DYNAMIC (short lifetime, fast update, slow read):
@@ -2302,6 +2902,14 @@ void LoadBuffers()
 	device->CreateBuffer(&bd, nullptr, &constantBuffers[CBTYPE_CUBEMAPRENDER]);
 	device->SetName(&constantBuffers[CBTYPE_CUBEMAPRENDER], "CubemapRenderCB");
 
+	bd.ByteWidth = sizeof(VoxelizerCB);
+	device->CreateBuffer(&bd, nullptr, &constantBuffers[CBTYPE_VOXELIZER]);
+	device->SetName(&constantBuffers[CBTYPE_VOXELIZER], "VoxelizerCB");
+
+	bd.ByteWidth = sizeof(ClothCB);
+	device->CreateBuffer(&bd, nullptr, &constantBuffers[CBTYPE_CLOTH]);
+	device->SetName(&constantBuffers[CBTYPE_CLOTH], "ClothCB");
+
 	bd.ByteWidth = sizeof(TessellationCB);
 	device->CreateBuffer(&bd, nullptr, &constantBuffers[CBTYPE_TESSELLATION]);
 	device->SetName(&constantBuffers[CBTYPE_TESSELLATION], "TessellationCB");
@@ -2314,6 +2922,10 @@ void LoadBuffers()
 	device->CreateBuffer(&bd, nullptr, &constantBuffers[CBTYPE_MIPGEN]);
 	device->SetName(&constantBuffers[CBTYPE_MIPGEN], "MipGeneratorCB");
 
+	bd.ByteWidth = sizeof(SPDCB);
+	device->CreateBuffer(&bd, nullptr, &constantBuffers[CBTYPE_SPD]);
+	device->SetName(&constantBuffers[CBTYPE_SPD], "SPDCB");
+
 	bd.ByteWidth = sizeof(FilterEnvmapCB);
 	device->CreateBuffer(&bd, nullptr, &constantBuffers[CBTYPE_FILTERENVMAP]);
 	device->SetName(&constantBuffers[CBTYPE_FILTERENVMAP], "FilterEnvmapCB");
@@ -2735,6 +3347,7 @@ const std::string& GetShaderPath()
 void SetShaderPath(const std::string& path)
 {
 	SHADERPATH = path;
+	MountShaderBundle();
 }
 const std::string& GetShaderSourcePath()
 {
@@ -2746,24 +3359,101 @@ void SetShaderSourcePath(const std::string& path)
 }
 void ReloadShaders()
 {
-	device->ClearPipelineStateCache();
-
+	// The pipeline state cache is not cleared, because the pipeline state hashes change only for the pipelines that use a reloaded shader
 	wiEvent::FireEvent(SYSTEM_EVENT_RELOAD_SHADERS, 0);
 }
-
-void Initialize()
+uint32_t CompileOutdatedShaders()
 {
-	SetUpStates();
-	LoadBuffers();
+	std::vector<std::pair<std::string, ShaderSource>> outdated;
+	{
+		std::lock_guard<std::mutex> lock(shader_reload_locker);
+		for (auto& x : shader_sources)
+		{
+			outdated.push_back(x);
+		}
+	}
+	outdated.erase(std::remove_if(outdated.begin(), outdated.end(), [](const std::pair<std::string, ShaderSource>& x) {
+		return !wiShaderCompiler::IsShaderOutdated(x.first);
+		}), outdated.end());
+	if (outdated.empty())
+	{
+		return 0;
+	}
 
+	std::string sourcedir = SHADERSOURCEPATH;
+	wiHelper::MakePathAbsolute(sourcedir);
+
+	std::atomic<uint32_t> compiled{ 0 };
+	wiJobSystem::context ctx;
+	ctx.priority = wiJobSystem::Priority::Background;
+	wiJobSystem::Dispatch(ctx, (uint32_t)outdated.size(), 1, [&](wiJobArgs args) {
+		const std::string& shaderbinaryfilename = outdated[args.jobIndex].first;
+		const ShaderSource& source = outdated[args.jobIndex].second;
+
+		wiShaderCompiler::CompilerInput input;
+		input.format = device->GetShaderFormat();
+		input.stage = source.stage;
+		input.minshadermodel = source.minshadermodel;
+		input.shadersourcefilename = source.sourcefilename;
+		input.include_directories.push_back(sourcedir);
+		input.defines = source.defines;
+
+		wiShaderCompiler::CompilerOutput output;
+		wiShaderCompiler::Compile(input, output);
+		if (output.IsValid())
+		{
+			wiShaderCompiler::SaveShaderAndMetadata(shaderbinaryfilename, output);
+			if (!output.error_message.empty())
+			{
+				wiBackLog::post(output.error_message.c_str());
+			}
+			wiBackLog::post(("shader compiled: " + shaderbinaryfilename).c_str());
+			compiled.fetch_add(1);
+		}
+		else
+		{
+			wiBackLog::post(("shader compile FAILED: " + shaderbinaryfilename + "\n" + output.error_message).c_str());
+		}
+		});
+	wiJobSystem::Wait(ctx);
+	return compiled.load();
+}
+void PrewarmPipelines(const std::string& filename, wiJobSystem::context& ctx)
+{
+	auto entries = std::make_shared<std::vector<PipelinePrewarmEntry>>();
+	if (!GraphicsDevice::LoadPipelinePrewarmList(filename, *entries) || entries->empty())
+	{
+		return;
+	}
+
+	wiJobSystem::Dispatch(ctx, (uint32_t)entries->size(), 16, [entries](wiJobArgs args) {
+		device->PrewarmPipeline(entries->at(args.jobIndex));
+	});
+}
+
+void Initialize()
+{
+	InitializeStates();
+	InitializeShaders();
+	InitializeShadowMaps();
+
+	wiBackLog::post("wiRenderer Initialized");
+}
+void InitializeStates()
+{
+	SetUpStates();
+	LoadBuffers();
+}
+void InitializeShaders()
+{
 	static wiEvent::Handle handle2 = wiEvent::Subscribe(SYSTEM_EVENT_RELOAD_SHADERS, [](uint64_t userdata) { LoadShaders(); });
 	LoadShaders();
-
+}
+void InitializeShadowMaps()
+{
 	SetShadowProps2D(SHADOWRES_2D, SHADOWCOUNT_2D);
 	SetShadowPropsCube(SHADOWRES_CUBE, SHADOWCOUNT_CUBE);
 	SetShadowPropsSpot2D(SHADOWRES_SPOT_2D, SHADOWCOUNT_SPOT_2D);
-
-	wiBackLog::post("wiRenderer Initialized");
 }
 void ClearWorld(Scene& scene)
 {
@@ -2813,19 +3503,40 @@ inline void CreateSpotLightShadowCam(const LightComponent& light, SHCAM& shcam)
 	shcam = SHCAM(light.position, light.rotation, 0.1f, light.GetRange(), light.fov);
 }
 
-#ifdef GGREDUCED
-#ifdef DELAYEDSHADOWS
-std::array<SHCAM, CASCADE_COUNT> restore_shcams;
-XMVECTOR restore_campos[CASCADE_COUNT];
-bool bUpdateCascade[CASCADE_COUNT];
-#endif
-#endif
+// Directional light shadow cascades can keep their content between frames to spread their cost:
+//	a cascade that is not due for an update keeps its content, and with scrolling it follows the camera by whole texels,
+//	so only the strips that were exposed by the movement have to be rendered
+enum SHADOWCASCADE_UPDATE
+{
+	SHADOWCASCADE_UPDATE_FULL,		// every caster is rendered into the cleared cascade
+	SHADOWCASCADE_UPDATE_SCROLL,	// the previous content is moved, then the exposed strips are rendered
+	SHADOWCASCADE_UPDATE_KEEP,		// the previous content and matrix are used as they are
+};
+struct ShadowCascade
+{
+	Entity light = INVALID_ENTITY;
+	XMFLOAT4X4 VP = {}; // the shadow camera that the content of the slice matches
+	Frustum frustum;
+	XMFLOAT3 eye = XMFLOAT3(0, 0, 0); // main camera position at the last full update
+	SHADOWCASCADE_UPDATE update = SHADOWCASCADE_UPDATE_FULL;
+	int scrollX = 0; // texel offset of the previous content in this frame
+	int scrollY = 0;
+	float scrollDepth = 0; // depth offset of the previous content in this frame
+	bool receivers_culled = false; // the content only has the casters that shadow the camera frustum of its frame, so it can't be kept
+};
+std::vector<ShadowCascade> shadowCascades; // one for every slice of shadowMapArray_2D
+uint32_t shadowCascadeUpdateInterval[CASCADE_COUNT] = {};
+bool shadowCascadeScrolling = true;
+bool shadowReceiverCulling = true;
+Texture shadowMapScroll_2D; // copy of the previous cascade content while scrolling, because the slice itself is rendered to
+RenderPass renderpass_shadowScroll_2D;
+std::vector<RenderPass> renderpasses_shadow2D_load;
 
 inline void CreateDirLightShadowCams(const LightComponent& light, CameraComponent camera, std::array<SHCAM, CASCADE_COUNT>& shcams)
 {
-	if (GetTemporalAAEnabled())
+	if (camera.jitter.x != 0 || camera.jitter.y != 0)
 	{
-		// remove camera jittering
+		// remove camera jittering (temporal AA or temporal upscaling)
 		camera.jitter = XMFLOAT2(0, 0);
 		camera.UpdateCamera();
 	}
@@ -2978,6 +3689,70 @@ inline void CreateDirLightShadowCams(const LightComponent& light, CameraComponen
 
 }
 
+// Chooses how the cascade is updated in this frame, and the shadow camera that its content will match
+static void UpdateShadowCascade(ShadowCascade& state, Entity light, const SHCAM& shcam, bool due, const XMFLOAT3& eye)
+{
+	XMFLOAT4X4 VP;
+	XMStoreFloat4x4(&VP, shcam.VP);
+
+	if (state.light != light || state.receivers_culled)
+	{
+		due = true;
+	}
+	else if (!due && shadowCascadeScrolling && PSO_shadowcache_copy.IsValid() && shadowMapScroll_2D.IsValid() && !GetTransparentShadowsEnabled())
+	{
+		// The light orientation and the cascade size must match within about a texel, then the projections only differ in translation:
+		const float res = (float)SHADOWRES_2D;
+		bool compatible = true;
+		for (int r = 0; r < 3 && compatible; ++r)
+		{
+			const float rowMax = std::max(std::abs(state.VP.m[r][0]), std::max(std::abs(state.VP.m[r][1]), std::abs(state.VP.m[r][2])));
+			for (int c = 0; c < 3 && compatible; ++c)
+			{
+				compatible = std::abs(VP.m[r][c] - state.VP.m[r][c]) <= rowMax * 1.5f / res;
+			}
+		}
+		const float scrollX = std::round((VP._41 - state.VP._41) * 0.5f * res);
+		const float scrollY = std::round((state.VP._42 - VP._42) * 0.5f * res);
+		if (compatible && std::abs(scrollX) < res * 0.5f && std::abs(scrollY) < res * 0.5f)
+		{
+			// The previous matrix is moved by whole texels, and the depth is shifted to the new depth range:
+			const bool moved = scrollX != 0 || scrollY != 0 || VP._43 != state.VP._43;
+			state.update = moved ? SHADOWCASCADE_UPDATE_SCROLL : SHADOWCASCADE_UPDATE_KEEP;
+			state.scrollX = (int)scrollX;
+			state.scrollY = (int)scrollY;
+			state.scrollDepth = VP._43 - state.VP._43;
+			state.VP._41 += scrollX * 2 / res;
+			state.VP._42 -= scrollY * 2 / res;
+			state.VP._43 = VP._43;
+			state.frustum.Create(XMLoadFloat4x4(&state.VP));
+			return;
+		}
+		due = true;
+	}
+	else if (!due)
+	{
+#ifdef GGREDUCED
+		//PE: To far from last center, update.
+		due = wiMath::Distance(eye, state.eye) > 64;
+#endif
+		if (!due)
+		{
+			state.update = SHADOWCASCADE_UPDATE_KEEP;
+			return;
+		}
+	}
+
+	state.light = light;
+	state.VP = VP;
+	state.frustum = shcam.frustum;
+	state.eye = eye;
+	state.update = SHADOWCASCADE_UPDATE_FULL;
+	state.scrollX = 0;
+	state.scrollY = 0;
+	state.scrollDepth = 0;
+}
+
 
 ForwardEntityMaskCB ForwardEntityCullingCPU(const Visibility& vis, const AABB& batch_aabb, RENDERPASS renderPass)
 {
@@ -3033,6 +3808,77 @@ ForwardEntityMaskCB ForwardEntityCullingCPU(const Visibility& vis, const AABB& b
 	return cb;
 }
 
+// The forward entity masks of the objects for the passes that cull the entities on the CPU, one cache per render pass
+//	An entry is valid while the key of the entities and the bounds of the object are the same as when it was written, so the masks of
+//	static objects are only computed again when a light, decal or probe changes. A pass is recorded by one thread at a time
+struct ForwardEntityMaskCache
+{
+	size_t key = 0;
+	AABB aabb;
+	ForwardEntityMaskCB mask = {};
+};
+std::vector<ForwardEntityMaskCache> forwardEntityMaskCache[RENDERPASS_COUNT];
+
+// The key of the entities that ForwardEntityCullingCPU() tests, with their order in the visibility and their bounds
+static size_t ForwardEntityCullingKey(const Visibility& vis, RENDERPASS renderPass)
+{
+	size_t key = 0;
+	auto combine = [&](uint32_t index, const AABB& aabb) {
+		wiHelper::hash_combine(key, index);
+		wiHelper::hash_combine(key, aabb._min.x);
+		wiHelper::hash_combine(key, aabb._min.y);
+		wiHelper::hash_combine(key, aabb._min.z);
+		wiHelper::hash_combine(key, aabb._max.x);
+		wiHelper::hash_combine(key, aabb._max.y);
+		wiHelper::hash_combine(key, aabb._max.z);
+	};
+
+	const size_t lightCount = std::min(size_t(64), vis.visibleLights.size());
+	wiHelper::hash_combine(key, lightCount);
+	for (size_t i = 0; i < lightCount; ++i)
+	{
+		const uint16_t lightIndex = vis.visibleLights[i].index;
+		combine(lightIndex, vis.scene->aabb_lights[lightIndex]);
+	}
+
+	const size_t decalCount = std::min(size_t(32), vis.visibleDecals.size());
+	wiHelper::hash_combine(key, decalCount);
+	for (size_t i = 0; i < decalCount; ++i)
+	{
+		const uint32_t decalIndex = vis.visibleDecals[vis.visibleDecals.size() - 1 - i];
+		combine(decalIndex, vis.scene->aabb_decals[decalIndex]);
+	}
+
+	if (renderPass != RENDERPASS_ENVMAPCAPTURE)
+	{
+		const size_t probeCount = std::min(size_t(32), vis.visibleEnvProbes.size());
+		wiHelper::hash_combine(key, probeCount);
+		for (size_t i = 0; i < probeCount; ++i)
+		{
+			const uint32_t probeIndex = vis.visibleEnvProbes[vis.visibleEnvProbes.size() - 1 - i];
+			combine(probeIndex, vis.scene->aabb_probes[probeIndex]);
+		}
+	}
+
+	return key;
+}
+
+// ForwardEntityCullingCPU() of one object, from the cache if its entry is still valid
+static const ForwardEntityMaskCB& ForwardEntityCullingCPU_Cached(const Visibility& vis, uint32_t instanceIndex, RENDERPASS renderPass, size_t key)
+{
+	ForwardEntityMaskCache& entry = forwardEntityMaskCache[renderPass][instanceIndex];
+	const AABB& aabb = vis.scene->aabb_objects[instanceIndex];
+	if (entry.key != key ||
+		std::memcmp(&entry.aabb._min, &aabb._min, sizeof(XMFLOAT3)) != 0 ||
+		std::memcmp(&entry.aabb._max, &aabb._max, sizeof(XMFLOAT3)) != 0)
+	{
+		entry.key = key;
+		entry.aabb = aabb;
+		entry.mask = ForwardEntityCullingCPU(vis, aabb, renderPass);
+	}
+	return entry.mask;
+}
+
 void BindConstantBuffers(SHADERSTAGE stage, CommandList cmd)
 {
 	device->BindConstantBuffer(stage, &constantBuffers[CBTYPE_FRAME], CB_GETBINDSLOT(FrameCB), cmd);
@@ -3051,34 +3897,274 @@ void BindShadowmaps(SHADERSTAGE stage, CommandList cmd)
 	}
 }
 
-void RenderMeshes(
+struct Instance_MATRIX_USERDATA
+{
+	Instance instance;
+};
+struct Instance_MATRIX_USERDATA_ATLAS
+{
+	Instance instance;
+	InstanceAtlas instanceAtlas;
+};
+struct Instance_MATRIX_USERDATA_MATRIXPREV
+{
+	Instance instance;
+	InstancePrev instancePrev;
+};
+
+// Purpose of InstancedBatch:
+//	The RenderQueue is sorted by meshIndex. There can be multiple instances for a single meshIndex,
+//	and the InstancedBatchArray contains this information. The array size will be the unique mesh count here.
+struct InstancedBatch
+{
+	uint32_t meshIndex;
+	int instanceCount;
+	uint32_t dataOffset;
+	uint8_t userStencilRefOverride;
+	uint8_t forceAlphatestForDithering; // padded bool
+#ifdef GGREDUCED
+	uint16_t paddingnickedfordistance;
+#else
+	uint16_t padding;
+#endif
+	ForwardEntityMaskCB forwardEntityMask; // the union of the masks of the instances, only written for the forwardLightmaskRequest
+	//bool bLOD;
+	uint32_t active_lod;
+};
+
+// GPU culling state of a command list, GPUCulling_Prepare() writes the batches and the culled indirect draws outside of the render pass
+//	and the next RenderMeshes() of the same visibility and render types draws them instead of writing its own batches
+struct GPUCulling
+{
+	const Visibility* vis = nullptr;
+	uint32_t renderTypeFlags = 0;
+	uint64_t frame = 0;
+	std::vector<InstancedBatch> batches;
+	std::vector<uint32_t> referenceData;
+	std::vector<uint8_t> inputData;
+	GPUBuffer input;
+	GPUBuffer args;
+	GPUBuffer references;
+
+	// Batches of meshes with meshlets are culled per cluster: every instance gets its own indirect draw from the meshletIndices
+	std::vector<uint32_t> meshletDraws; // first meshlet candidate of every batch, or ~0u if the batch is only culled per instance
+	std::vector<uint8_t> meshletInputData;
+	GPUBuffer meshletInput;
+	GPUBuffer meshletArgs;
+	GPUBuffer meshletIndices;
+
+	inline bool IsPrepared(const Visibility& visibility, RENDERPASS renderPass, uint32_t renderTypes) const
+	{
+		return vis == &visibility && renderPass == RENDERPASS_MAIN && renderTypeFlags == renderTypes && frame == device->GetFrameCount();
+	}
+};
+GPUCulling gpuCulling[COMMANDLIST_COUNT];
+Texture gpuCullingHiZ;
+struct GPUCullingHiZCamera
+{
+	XMFLOAT4X4 VP;
+	float zNearP = 0;
+	float zFarP = 0;
+	uint64_t frame = ~0ull; // the frame when GPUCulling_Prepare() built the Hi-Z
+} gpuCullingHiZCamera;
+
+// Writes the instance data of the render queue and groups the instances into InstancedBatches
+//	The batches are allocated from the render frame allocator of the command list, the batch count is returned
+static int WriteInstancedBatches(
 	const Visibility& vis,
 	const RenderQueue& renderQueue,
+	INSTANCETYPE instanceRequest,
+	uint32_t instanceDataSize,
+	bool instanceTableRequest,
+	bool forwardLightmaskRequest,
 	RENDERPASS renderPass,
-	uint32_t renderTypeFlags,
-	CommandList cmd,
-	bool tessellation = false,
-	const Frustum* frusta = nullptr,
-	uint32_t frustum_count = 1
+	const Frustum* frusta,
+	uint32_t frustum_count,
+	void* data,
+	uint32_t dataOffset,
+	InstancedBatch*& instancedBatchArray,
+	CommandList cmd
 )
 {
-	if (renderQueue.empty())
-	{
+	const TextureDesc& lightmap_desc = vis.scene->lightmap.GetDesc();
+	instancedBatchArray = nullptr;
+	int instancedBatchCount = 0;
+
+	size_t forwardEntityKey = 0;
+	if (forwardLightmaskRequest)
+	{
+		forwardEntityKey = ForwardEntityCullingKey(vis, renderPass);
+		std::vector<ForwardEntityMaskCache>& cache = forwardEntityMaskCache[renderPass];
+		if (cache.size() < vis.scene->aabb_objects.GetCount())
+		{
+			cache.resize(vis.scene->aabb_objects.GetCount());
+		}
+	}
+
+	// The following loop is writing the instancing batches to a GPUBuffer:
+	size_t prevMeshIndex = ~0;
+	uint8_t prevUserStencilRefOverride = 0;
+	//bool prevBLOD = 0;
+	uint32_t prevActiveLOD = 9999999;
+	uint32_t instanceCount = 0;
+	for (uint32_t batchID = 0; batchID < renderQueue.batchCount; ++batchID) // Do not break out of this loop!
+	{
+		const RenderBatch& batch = renderQueue.batchArray[batchID];
+		const uint32_t meshIndex = batch.GetMeshIndex();
+		//const bool bLOD = batch.GetLOD(); //PE: LOD
+		const uint32_t active_lod = batch.active_lod; //PE: NEWLOD
+		const uint32_t instanceIndex = batch.GetInstanceIndex();
+		const ObjectComponent& instance = vis.scene->objects[instanceIndex];
+		const AABB& instanceAABB = vis.scene->aabb_objects[instanceIndex];
+		const uint8_t userStencilRefOverride = instance.userStencilRef;
+
+		// When we encounter a new mesh inside the global instance array, we begin a new InstancedBatch:
+		//PE: LOD mesh.IsRenderLOD() must have there own batches. STORE inside batch.
+		if (meshIndex != prevMeshIndex || userStencilRefOverride != prevUserStencilRefOverride || prevActiveLOD != active_lod) //|| bLOD != prevBLOD
+		{
+			prevMeshIndex = meshIndex;
+			prevUserStencilRefOverride = userStencilRefOverride;
+			//prevBLOD = bLOD;
+			prevActiveLOD = active_lod;
+
+			// The deformed meshes remember that they were drawn, so their skinning isn't culled in the next frame:
+			const MeshComponent& mesh = vis.scene->meshes[meshIndex];
+			if ((mesh.IsSkinned() || mesh.morphVertexBuffer.IsValid()) && mesh.deform_drawn_frame.value.load(std::memory_order_relaxed) != device->GetFrameCount())
+			{
+				mesh.deform_drawn_frame.value.store(device->GetFrameCount(), std::memory_order_relaxed);
+			}
+
+			instancedBatchCount++;
+			InstancedBatch* instancedBatch = (InstancedBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(InstancedBatch));
+			instancedBatch->meshIndex = meshIndex;
+			instancedBatch->instanceCount = 0;
+			instancedBatch->dataOffset = dataOffset + instanceCount * instanceDataSize;
+			instancedBatch->userStencilRefOverride = userStencilRefOverride;
+			instancedBatch->forceAlphatestForDithering = 0;
+			instancedBatch->forwardEntityMask = {};
+			//instancedBatch->bLOD = bLOD;
+			instancedBatch->active_lod = active_lod;
 #ifdef GGREDUCED
-		if (renderPass == RENDERPASS_MAIN && renderTypeFlags & RENDERTYPE_TRANSPARENT)
+			if(batch.GetDistance()<16000)
+				instancedBatch->paddingnickedfordistance = batch.GetDistance();
+			else
+				instancedBatch->paddingnickedfordistance = 16000;
+#endif
+			if (instancedBatchArray == nullptr)
+			{
+				instancedBatchArray = instancedBatch;
+			}
+		}
+
+		InstancedBatch& current_batch = instancedBatchArray[instancedBatchCount - 1];
+
+		float dither = instance.GetTransparency();
+
+		if (instance.IsImpostorPlacement())
 		{
-			GPUParticles::gpup_draw_bydistance(wiScene::GetCamera(), cmd, 0.0f);
-			// repair constant buffers changed by particle shader
-			//BindCommonResources(cmd);
-			BindConstantBuffers(VS, cmd);
-			BindConstantBuffers(PS, cmd);
+			float distance = wiMath::Distance(instanceAABB.getCenter(), vis.camera->Eye);
+			float swapDistance = instance.impostorSwapDistance;
+			float fadeThreshold = instance.impostorFadeThresholdRadius;
+			dither = std::max(0.0f, distance - swapDistance) / fadeThreshold;
 		}
-#endif
-		return;
+
+		if (dither > 0)
+		{
+			current_batch.forceAlphatestForDithering = 1;
+		}
+
+		if (forwardLightmaskRequest)
+		{
+			const ForwardEntityMaskCB& mask = ForwardEntityCullingCPU_Cached(vis, instanceIndex, renderPass, forwardEntityKey);
+			current_batch.forwardEntityMask.xForwardLightMask.x |= mask.xForwardLightMask.x;
+			current_batch.forwardEntityMask.xForwardLightMask.y |= mask.xForwardLightMask.y;
+			current_batch.forwardEntityMask.xForwardDecalMask |= mask.xForwardDecalMask;
+			current_batch.forwardEntityMask.xForwardEnvProbeMask |= mask.xForwardEnvProbeMask;
+		}
+
+		const XMFLOAT4X4& worldMatrix = instance.transform_index >= 0 ? vis.scene->transforms[instance.transform_index].world : IDENTITYMATRIX;
+
+		for (uint32_t frustum_index = 0; frustum_index < frustum_count; ++frustum_index)
+		{
+			if (frusta != nullptr && !frusta[frustum_index].CheckBoxFast(instanceAABB))
+			{
+				// In case multiple cameras were provided and no intersection detected with frustum, we don't add the instance for the face:
+				continue;
+			}
+
+			if (instanceTableRequest)
+			{
+				// Reference into the instance table, the dither is quantized to 16 bits next to the frustum index:
+				const uint32_t dither_unorm = (uint32_t)(std::min(1.0f, dither) * 65535.0f);
+				volatile uint32_t* reference = (volatile uint32_t*)data + instanceCount * 2;
+				reference[0] = instanceIndex;
+				reference[1] = (dither_unorm << 16u) | (frustum_index & 0xFFFF);
+
+				current_batch.instanceCount++; // next instance in current InstancedBatch
+				instanceCount++;
+				continue;
+			}
+
+			// Write into actual GPU-buffer:
+			switch (instanceRequest)
+			{
+			default:
+			case INSTANCETYPE_MATRIX_USERDATA:
+				((volatile Instance_MATRIX_USERDATA*)data)[instanceCount].instance.Create(worldMatrix, instance.color, dither, frustum_index, instance.emissiveColor);
+				break;
+			case INSTANCETYPE_MATRIX_USERDATA_ATLAS:
+				((volatile Instance_MATRIX_USERDATA_ATLAS*)data)[instanceCount].instance.Create(worldMatrix, instance.color, dither, frustum_index, instance.emissiveColor);
+				((volatile Instance_MATRIX_USERDATA_ATLAS*)data)[instanceCount].instanceAtlas.Create(GetLightmapAtlasMulAdd(instance, lightmap_desc));
+				break;
+			case INSTANCETYPE_MATRIX_USERDATA_MATRIXPREV:
+				((volatile Instance_MATRIX_USERDATA_MATRIXPREV*)data)[instanceCount].instance.Create(worldMatrix, instance.color, dither, frustum_index, instance.emissiveColor);
+				((volatile Instance_MATRIX_USERDATA_MATRIXPREV*)data)[instanceCount].instancePrev.Create(instance.prev_transform_index >= 0 ? instance.GetWorldMatrixPrev() : IDENTITYMATRIX);
+				break;
+			}
+
+			current_batch.instanceCount++; // next instance in current InstancedBatch
+			instanceCount++;
+		}
+
 	}
+	return instancedBatchCount;
+}
+
+// The mesh subset (LOD level) that is drawn for an InstancedBatch
+static uint32_t GetInstancedBatchLOD(const MeshComponent& mesh, const InstancedBatch& instancedBatch, RENDERPASS renderPass, bool reflections)
+{
+	uint32_t setlodlevel = instancedBatch.active_lod;
+
+	//PE: Always use lowest lod for shadows.
+	if (bShadowsLowestLOD && (renderPass == RENDERPASS_SHADOW || renderPass == RENDERPASS_SHADOWCUBE))
+		setlodlevel = mesh.lodlevels;
+
+	//PE: Always lowest lod for probes.
+	if (bProbesLowestLOD && renderPass == RENDERPASS_ENVMAPCAPTURE)
+		setlodlevel = mesh.lodlevels;
+
+	if(bReflectionsLowestLOD && reflections)
+		setlodlevel = mesh.lodlevels;
+
+	return setlodlevel;
+}
+
+// The batch loop of RenderMeshes(), it is compiled for every render pass and binding model
+//	so the branches on them are resolved at compile time, and the shadow and depth only passes don't pay for the features of the others
+template<RENDERPASS renderPass, bool bindless>
+static void RenderMeshes_Internal(
+	const Visibility& vis,
+	const RenderQueue& renderQueue,
+	uint32_t renderTypeFlags,
+	CommandList cmd,
+	bool tessellation,
+	const Frustum* frusta,
+	uint32_t frustum_count
+)
+{
+	const bool overdraw = overdrawRender[cmd];
 
 		device->EventBegin("RenderMeshes", cmd);
-		const bool bindless = device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS);
 
 		tessellation = tessellation && device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_TESSELLATION);
 		if (tessellation)
@@ -3096,20 +4182,14 @@ void RenderMeshes(
 			renderPass == RENDERPASS_VOXELIZE;
 
 		const INSTANCETYPE instanceRequest = instanceTypes[renderPass];
-		struct Instance_MATRIX_USERDATA
-		{
-			Instance instance;
-		};
-		struct Instance_MATRIX_USERDATA_ATLAS
-		{
-			Instance instance;
-			InstanceAtlas instanceAtlas;
-		};
-		struct Instance_MATRIX_USERDATA_MATRIXPREV
-		{
-			Instance instance;
-			InstancePrev instancePrev;
-		};
+
+		// With the persistent instance table, the passes only write a reference to the object for every instance:
+		const bool instanceTableRequest = bindless && instanceTableScene == vis.scene && instanceTable.IsValid();
+		const int instanceTableDescriptorIndex = instanceTableRequest ? device->GetDescriptorIndex(&instanceTable, SRV) : -1;
+
+		// The batches of this pass could be already written and culled on the GPU by GPUCulling_Prepare(), then they are drawn indirectly:
+		GPUCulling& culling = gpuCulling[cmd];
+		const bool gpuCullingRequest = instanceTableRequest && frusta == nullptr && culling.IsPrepared(vis, renderPass, renderTypeFlags);
 
 		// Pre-allocate space for all the instances in GPU-buffer:
 		uint32_t instanceDataSize = 0;
@@ -3126,200 +4206,72 @@ void RenderMeshes(
 			instanceDataSize = sizeof(Instance_MATRIX_USERDATA_MATRIXPREV);
 			break;
 		}
-		size_t alloc_size = renderQueue.batchCount * frustum_count * instanceDataSize;
-		GraphicsDevice::GPUAllocation instances = device->AllocateGPU(alloc_size, cmd);
-		//PE: https://github.com/turanszkij/WickedEngine/commit/54d11f1e9138813b7815e9d523f2e7b8fac523a2
-		const int instanceBufferDescriptorIndex = device->GetDescriptorIndex(instances.buffer, SRV);
-
-		// Purpose of InstancedBatch:
-		//	The RenderQueue is sorted by meshIndex. There can be multiple instances for a single meshIndex,
-		//	and the InstancedBatchArray contains this information. The array size will be the unique mesh count here.
-		struct InstancedBatch
-		{
-			uint32_t meshIndex;
-			int instanceCount;
-			uint32_t dataOffset;
-			uint8_t userStencilRefOverride;
-			uint8_t forceAlphatestForDithering; // padded bool
-#ifdef GGREDUCED
-			uint16_t paddingnickedfordistance;
-#else
-			uint16_t padding;
-#endif
-			AABB aabb;
-			//bool bLOD;
-			uint32_t active_lod;
-		};
+		if (instanceTableRequest)
+		{
+			instanceDataSize = INSTANCETABLE_REFERENCE_STRIDE;
+		}
+		GraphicsDevice::GPUAllocation instances;
+		int instanceBufferDescriptorIndex = -1;
 		InstancedBatch* instancedBatchArray = nullptr;
 		int instancedBatchCount = 0;
+		if (gpuCullingRequest)
+		{
+			instanceBufferDescriptorIndex = device->GetDescriptorIndex(&culling.references, SRV);
+			instancedBatchArray = culling.batches.data();
+			instancedBatchCount = (int)culling.batches.size();
+			culling.vis = nullptr;
+		}
+		else
+		{
+			size_t alloc_size = renderQueue.batchCount * frustum_count * instanceDataSize;
+			instances = device->AllocateGPU(alloc_size, cmd);
+			//PE: https://github.com/turanszkij/WickedEngine/commit/54d11f1e9138813b7815e9d523f2e7b8fac523a2
+			instanceBufferDescriptorIndex = device->GetDescriptorIndex(instances.buffer, SRV);
 
-		// The following loop is writing the instancing batches to a GPUBuffer:
-		size_t prevMeshIndex = ~0;
-		uint8_t prevUserStencilRefOverride = 0;
-		//bool prevBLOD = 0;
-		uint32_t prevActiveLOD = 9999999;
-		uint32_t instanceCount = 0;
-		for (uint32_t batchID = 0; batchID < renderQueue.batchCount; ++batchID) // Do not break out of this loop!
-		{
-			const RenderBatch& batch = renderQueue.batchArray[batchID];
-			const uint32_t meshIndex = batch.GetMeshIndex();
-			//const bool bLOD = batch.GetLOD(); //PE: LOD
-			const uint32_t active_lod = batch.active_lod; //PE: NEWLOD
-			const uint32_t instanceIndex = batch.GetInstanceIndex();
-			const ObjectComponent& instance = vis.scene->objects[instanceIndex];
-			const AABB& instanceAABB = vis.scene->aabb_objects[instanceIndex];
-			const uint8_t userStencilRefOverride = instance.userStencilRef;
-
-			// When we encounter a new mesh inside the global instance array, we begin a new InstancedBatch:
-			//PE: LOD mesh.IsRenderLOD() must have there own batches. STORE inside batch.
-			if (meshIndex != prevMeshIndex || userStencilRefOverride != prevUserStencilRefOverride || prevActiveLOD != active_lod) //|| bLOD != prevBLOD
-			{
-				prevMeshIndex = meshIndex;
-				prevUserStencilRefOverride = userStencilRefOverride;
-				//prevBLOD = bLOD;
-				prevActiveLOD = active_lod;
-
-				instancedBatchCount++;
-				InstancedBatch* instancedBatch = (InstancedBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(InstancedBatch));
-				instancedBatch->meshIndex = meshIndex;
-				instancedBatch->instanceCount = 0;
-				instancedBatch->dataOffset = instances.offset + instanceCount * instanceDataSize;
-				instancedBatch->userStencilRefOverride = userStencilRefOverride;
-				instancedBatch->forceAlphatestForDithering = 0;
-				instancedBatch->aabb = AABB();
-				//instancedBatch->bLOD = bLOD;
-				instancedBatch->active_lod = active_lod;
+			instancedBatchCount = WriteInstancedBatches(vis, renderQueue, instanceRequest, instanceDataSize, instanceTableRequest, forwardLightmaskRequest, renderPass, frusta, frustum_count, instances.data, instances.offset, instancedBatchArray, cmd);
+		}
+
+		const bool reflections = renderTypeFlags & RENDERTYPE_REFLECTIONS;
 #ifdef GGREDUCED
-				if(batch.GetDistance()<16000)
-					instancedBatch->paddingnickedfordistance = batch.GetDistance();
-				else
-					instancedBatch->paddingnickedfordistance = 16000;
+		// special mode that can render an object TWICE (special feature for weapons that have multiple meshes that need to carve out the depth buffer before being rendered properly)
+		for (int iDoubleRender = 0; iDoubleRender < 2; iDoubleRender++)
 #endif
-				if (instancedBatchArray == nullptr)
+		{
+			// Render instanced batches:
+			for (int instancedBatchID = 0; instancedBatchID < instancedBatchCount; ++instancedBatchID)
+			{
+				const InstancedBatch& instancedBatch = instancedBatchArray[instancedBatchID];
+				const MeshComponent& mesh = vis.scene->meshes[instancedBatch.meshIndex];
+
+#ifdef GGREDUCED
+				// special mode that can render an object TWICE (special feature for weapons that have multiple meshes that need to carve out the depth buffer before being rendered properly)
+				if(iDoubleRender==0 )
 				{
-					instancedBatchArray = instancedBatch;
+					if (renderPass == RENDERPASS_MAIN && renderTypeFlags & RENDERTYPE_TRANSPARENT && !overdraw)
+					{
+						float fDistanceFromCamera = (float)instancedBatch.paddingnickedfordistance;
+						//float distance = wiMath::Distance(instancedBatch.aabb.getCenter(), vis.camera->Eye); // aabb empty :(
+						GPUParticles::gpup_draw_bydistance(wiScene::GetCamera(), cmd, fDistanceFromCamera);
+						//BindCommonResources(cmd);
+						BindConstantBuffers(VS, cmd);
+						BindConstantBuffers(PS, cmd);
+					}
 				}
-			}
+#endif
 
-			InstancedBatch& current_batch = instancedBatchArray[instancedBatchCount - 1];
+#ifdef GGREDUCED
+				// I am sure there is a 'quicker' way to isolate the weapon meshes (arms and then gun mesh)
+				// possibly remove this and render a 'blank' gun before the real gun, with the blank having the FORCEDEPTH mode
+				if (mesh.subsets.size()>0)
+				{
+					const MaterialComponent& material = vis.scene->materials[mesh.subsets[0].materialIndex];
+					if (iDoubleRender == 1 && material.GetBlendMode() != BLENDMODE_FORCEDEPTH)
+						continue;
+				}
+#endif
 
-			float dither = instance.GetTransparency();
-
-			if (instance.IsImpostorPlacement())
-			{
-				float distance = wiMath::Distance(instanceAABB.getCenter(), vis.camera->Eye);
-				float swapDistance = instance.impostorSwapDistance;
-				float fadeThreshold = instance.impostorFadeThresholdRadius;
-				dither = std::max(0.0f, distance - swapDistance) / fadeThreshold;
-			}
-
-			if (dither > 0)
-			{
-				current_batch.forceAlphatestForDithering = 1;
-			}
-
-			if (forwardLightmaskRequest)
-			{
-				current_batch.aabb = AABB::Merge(current_batch.aabb, instanceAABB);
-			}
-
-			const XMFLOAT4X4& worldMatrix = instance.transform_index >= 0 ? vis.scene->transforms[instance.transform_index].world : IDENTITYMATRIX;
-
-			for (uint32_t frustum_index = 0; frustum_index < frustum_count; ++frustum_index)
-			{
-				if (frusta != nullptr && !frusta[frustum_index].CheckBoxFast(instanceAABB))
-				{
-					// In case multiple cameras were provided and no intersection detected with frustum, we don't add the instance for the face:
-					continue;
-				}
-
-				// Write into actual GPU-buffer:
-				switch (instanceRequest)
-				{
-				default:
-				case INSTANCETYPE_MATRIX_USERDATA:
-					((volatile Instance_MATRIX_USERDATA*)instances.data)[instanceCount].instance.Create(worldMatrix, instance.color, dither, frustum_index, instance.emissiveColor);
-					break;
-				case INSTANCETYPE_MATRIX_USERDATA_ATLAS:
-					((volatile Instance_MATRIX_USERDATA_ATLAS*)instances.data)[instanceCount].instance.Create(worldMatrix, instance.color, dither, frustum_index, instance.emissiveColor);
-				{
-					XMFLOAT4 lightMapMulAdd;
-					if (instance.lightmap.IsValid())
-					{
-						auto rect = instance.lightmap_rect;
-
-						// eliminate border expansion:
-						rect.x += Scene::atlasClampBorder;
-						rect.y += Scene::atlasClampBorder;
-						rect.w -= Scene::atlasClampBorder * 2;
-						rect.h -= Scene::atlasClampBorder * 2;
-
-						lightMapMulAdd = XMFLOAT4(
-							(float)rect.w / (float)lightmap_desc.Width,
-							(float)rect.h / (float)lightmap_desc.Height,
-							(float)rect.x / (float)lightmap_desc.Width,
-							(float)rect.y / (float)lightmap_desc.Height
-						);
-					}
-					else
-					{
-						lightMapMulAdd = XMFLOAT4(0, 0, 0, 0);
-					}
-					((volatile Instance_MATRIX_USERDATA_ATLAS*)instances.data)[instanceCount].instanceAtlas.Create(lightMapMulAdd);
-				}
-					break;
-				case INSTANCETYPE_MATRIX_USERDATA_MATRIXPREV:
-					((volatile Instance_MATRIX_USERDATA_MATRIXPREV*)instances.data)[instanceCount].instance.Create(worldMatrix, instance.color, dither, frustum_index, instance.emissiveColor);
-					((volatile Instance_MATRIX_USERDATA_MATRIXPREV*)instances.data)[instanceCount].instancePrev.Create(instance.prev_transform_index >= 0 ? vis.scene->prev_transforms[instance.prev_transform_index].world_prev : IDENTITYMATRIX);
-					break;
-				}
-
-				current_batch.instanceCount++; // next instance in current InstancedBatch
-				instanceCount++;
-			}
-
-		}
-		const bool reflections = renderTypeFlags & RENDERTYPE_REFLECTIONS;
-#ifdef GGREDUCED
-		// special mode that can render an object TWICE (special feature for weapons that have multiple meshes that need to carve out the depth buffer before being rendered properly)
-		for (int iDoubleRender = 0; iDoubleRender < 2; iDoubleRender++)
-#endif
-		{
-			// Render instanced batches:
-			for (int instancedBatchID = 0; instancedBatchID < instancedBatchCount; ++instancedBatchID)
-			{
-				const InstancedBatch& instancedBatch = instancedBatchArray[instancedBatchID];
-				const MeshComponent& mesh = vis.scene->meshes[instancedBatch.meshIndex];
-
-#ifdef GGREDUCED
-				// special mode that can render an object TWICE (special feature for weapons that have multiple meshes that need to carve out the depth buffer before being rendered properly)
-				if(iDoubleRender==0 )
-				{
-					if (renderPass == RENDERPASS_MAIN && renderTypeFlags & RENDERTYPE_TRANSPARENT)
-					{
-						float fDistanceFromCamera = (float)instancedBatch.paddingnickedfordistance;
-						//float distance = wiMath::Distance(instancedBatch.aabb.getCenter(), vis.camera->Eye); // aabb empty :(
-						GPUParticles::gpup_draw_bydistance(wiScene::GetCamera(), cmd, fDistanceFromCamera);
-						//BindCommonResources(cmd);
-						BindConstantBuffers(VS, cmd);
-						BindConstantBuffers(PS, cmd);
-					}
-				}
-#endif
-
-#ifdef GGREDUCED
-				// I am sure there is a 'quicker' way to isolate the weapon meshes (arms and then gun mesh)
-				// possibly remove this and render a 'blank' gun before the real gun, with the blank having the FORCEDEPTH mode
-				if (mesh.subsets.size()>0)
-				{
-					const MaterialComponent& material = vis.scene->materials[mesh.subsets[0].materialIndex];
-					if (iDoubleRender == 1 && material.GetBlendMode() != BLENDMODE_FORCEDEPTH)
-						continue;
-				}
-#endif
-
-				const bool forceAlphaTestForDithering = instancedBatch.forceAlphatestForDithering != 0;
-				const uint8_t userStencilRefOverride = instancedBatch.userStencilRefOverride;
+				const bool forceAlphaTestForDithering = instancedBatch.forceAlphatestForDithering != 0;
+				const uint8_t userStencilRefOverride = instancedBatch.userStencilRefOverride;
 
 				const float tessF = mesh.GetTessellationFactor();
 				const bool tessellatorRequested = tessF > 0 && tessellation;
@@ -3335,12 +4287,19 @@ void RenderMeshes(
 
 				if (forwardLightmaskRequest)
 				{
-					ForwardEntityMaskCB cb = ForwardEntityCullingCPU(vis, instancedBatch.aabb, renderPass);
-					device->UpdateBuffer(&constantBuffers[CBTYPE_FORWARDENTITYMASK], &cb, cmd);
+					device->UpdateBuffer(&constantBuffers[CBTYPE_FORWARDENTITYMASK], &instancedBatch.forwardEntityMask, cmd);
 					device->BindConstantBuffer(PS, &constantBuffers[CBTYPE_FORWARDENTITYMASK], CB_GETBINDSLOT(ForwardEntityMaskCB), cmd);
 				}
 
-				device->BindIndexBuffer(&mesh.indexBuffer, mesh.GetIndexFormat(), 0, cmd);
+				const uint32_t meshletDraw = gpuCullingRequest ? culling.meshletDraws[instancedBatchID] : ~0u;
+				if (meshletDraw != ~0u)
+				{
+					device->BindIndexBuffer(&culling.meshletIndices, INDEXFORMAT_32BIT, 0, cmd);
+				}
+				else
+				{
+					device->BindIndexBuffer(&mesh.indexBuffer, mesh.GetIndexFormat(), 0, cmd);
+				}
 
 				ObjectPushConstants push; // used with bindless model only
 
@@ -3350,6 +4309,7 @@ void RenderMeshes(
 					//PE: https://github.com/turanszkij/WickedEngine/commit/54d11f1e9138813b7815e9d523f2e7b8fac523a2
 					push.instances = instanceBufferDescriptorIndex;
 					push.instance_offset = instancedBatch.dataOffset;
+					push.instance_table = instanceTableDescriptorIndex;
 				}
 				else
 				{
@@ -3398,19 +4358,8 @@ void RenderMeshes(
 
 				//instancedBatch.active_lod
 				uint32_t count = 0;
-				uint32_t setlodlevel = instancedBatch.active_lod;
-
-				//PE: Always use lowest lod for shadows.
-				if (bShadowsLowestLOD && (renderPass == RENDERPASS_SHADOW || renderPass == RENDERPASS_SHADOWCUBE))
-					setlodlevel = mesh.lodlevels;
+				const uint32_t setlodlevel = GetInstancedBatchLOD(mesh, instancedBatch, renderPass, reflections);
 
-				//PE: Always lowest lod for probes.
-				if (bProbesLowestLOD && renderPass == RENDERPASS_ENVMAPCAPTURE)
-					setlodlevel = mesh.lodlevels;
-
-				if(bReflectionsLowestLOD && reflections)
-					setlodlevel = mesh.lodlevels;
-				
 				for (const MeshComponent::MeshSubset& subset : mesh.subsets)
 				{
 					if (count++ != setlodlevel) //PE: NEWLOD
@@ -3455,6 +4404,10 @@ void RenderMeshes(
 									pso = tessellatorRequested ? &PSO_object_wire_tessellation : &PSO_object_wire;
 							}
 						}
+						else if (overdraw)
+						{
+							pso = &PSO_object_overdraw[(mesh.IsDoubleSided() || material.IsDoubleSided()) ? OBJECTRENDERING_DOUBLESIDED_ENABLED : OBJECTRENDERING_DOUBLESIDED_DISABLED];
+						}
 						else if (mesh.IsTerrain())
 						{
 							pso = &PSO_object_terrain[renderPass];
@@ -3525,6 +4478,10 @@ void RenderMeshes(
 							{
 								pso = &PSO_object[shaderType][renderPass][blendMode][doublesided][tessellatorRequested][alphatest];
 								assert(pso->IsValid());
+								if (shaderType == MaterialComponent::SHADERTYPE_PBR && renderPass == RENDERPASS_MAIN && blendMode == BLENDMODE_OPAQUE && !tessellatorRequested)
+								{
+									pso = GetObjectPermutationPSO(material, doublesided, alphatest, pso);
+								}
 							}
 #else
 							const BLENDMODE blendMode = material.GetBlendMode();
@@ -3532,6 +4489,10 @@ void RenderMeshes(
 							OBJECTRENDERING_DOUBLESIDED doublesided = (mesh.IsDoubleSided() || material.IsDoubleSided()) ? OBJECTRENDERING_DOUBLESIDED_ENABLED : OBJECTRENDERING_DOUBLESIDED_DISABLED;
 							pso = &PSO_object[material.shaderType][renderPass][blendMode][doublesided][tessellatorRequested][alphatest];
 							assert(pso->IsValid());
+							if (material.shaderType == MaterialComponent::SHADERTYPE_PBR && renderPass == RENDERPASS_MAIN && blendMode == BLENDMODE_OPAQUE && !tessellatorRequested)
+							{
+								pso = GetObjectPermutationPSO(material, doublesided, alphatest, pso);
+							}
 							if ((renderTypeFlags & RENDERTYPE_TRANSPARENT) && doublesided == OBJECTRENDERING_DOUBLESIDED_ENABLED)
 							{
 								doublesided = OBJECTRENDERING_DOUBLESIDED_BACKSIDE;
@@ -3554,7 +4515,7 @@ void RenderMeshes(
 					}
 					else if ( (renderTypeFlags & RENDERTYPE_TRANSPARENT) && (material.GetRenderTypes() & RENDERTYPE_TRANSPARENT) )
 					{
-						if (renderPass == RENDERPASS_MAIN)
+						if (renderPass == RENDERPASS_MAIN && !overdraw)
 						{
 							wiProfiler::CountDrawCallsTransparent();
 							wiProfiler::CountPolygonsTransparent((subset.indexCount / 3) * instancedBatch.instanceCount);
@@ -3562,7 +4523,7 @@ void RenderMeshes(
 					}
 					else
 					{
-						if (renderPass == RENDERPASS_MAIN)
+						if (renderPass == RENDERPASS_MAIN && !overdraw)
 						{
 							wiProfiler::CountDrawCalls();
 							wiProfiler::CountPolygons((subset.indexCount / 3) * instancedBatch.instanceCount);
@@ -3582,7 +4543,7 @@ void RenderMeshes(
 
 					if (bindless)
 					{
-						push.material = device->GetDescriptorIndex(&material.constantBuffer, SRV);
+						push.material = (int)subset.materialIndex;
 						device->PushConstants(&push, sizeof(push), cmd);
 					}
 					else
@@ -3658,22 +4619,119 @@ void RenderMeshes(
 						}
 					}
 
+					auto draw = [&]() {
+						if (meshletDraw != ~0u)
+						{
+							// Every instance draws the clusters that survived its own culling, from its reference slot:
+							for (int i = 0; i < instancedBatch.instanceCount; ++i)
+							{
+								push.instance_offset = instancedBatch.dataOffset + i * INSTANCETABLE_REFERENCE_STRIDE;
+								device->PushConstants(&push, sizeof(push), cmd);
+								device->DrawIndexedInstancedIndirect(&culling.meshletArgs, (meshletDraw + i) * GPUCULLING_ARGS_STRIDE, cmd);
+							}
+							push.instance_offset = instancedBatch.dataOffset;
+							device->PushConstants(&push, sizeof(push), cmd);
+						}
+						else if (gpuCullingRequest)
+						{
+							device->DrawIndexedInstancedIndirect(&culling.args, instancedBatchID * GPUCULLING_ARGS_STRIDE, cmd);
+						}
+						else
+						{
+							device->DrawIndexedInstanced(subset.indexCount, instancedBatch.instanceCount, subset.indexOffset, 0, 0, cmd);
+						}
+					};
+
 					if (pso_backside != nullptr)
 					{
 						device->BindPipelineState(pso_backside, cmd);
-						device->DrawIndexedInstanced(subset.indexCount, instancedBatch.instanceCount, subset.indexOffset, 0, 0, cmd);
+						draw();
 					}
 
 					device->BindPipelineState(pso, cmd);
-					device->DrawIndexedInstanced(subset.indexCount, instancedBatch.instanceCount, subset.indexOffset, 0, 0, cmd);
+					draw();
 				}
 			}
 		}
 
-		GetRenderFrameAllocator(cmd).free(sizeof(InstancedBatch) * instancedBatchCount);
+		if (!gpuCullingRequest)
+		{
+			GetRenderFrameAllocator(cmd).free(sizeof(InstancedBatch) * instancedBatchCount);
+		}
 
 		device->EventEnd(cmd);
 }
+template<RENDERPASS renderPass>
+static void RenderMeshes_Pass(
+	const Visibility& vis,
+	const RenderQueue& renderQueue,
+	uint32_t renderTypeFlags,
+	CommandList cmd,
+	bool tessellation,
+	const Frustum* frusta,
+	uint32_t frustum_count
+)
+{
+	if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS))
+	{
+		RenderMeshes_Internal<renderPass, true>(vis, renderQueue, renderTypeFlags, cmd, tessellation, frusta, frustum_count);
+	}
+	else
+	{
+		RenderMeshes_Internal<renderPass, false>(vis, renderQueue, renderTypeFlags, cmd, tessellation, frusta, frustum_count);
+	}
+}
+void RenderMeshes(
+	const Visibility& vis,
+	const RenderQueue& renderQueue,
+	RENDERPASS renderPass,
+	uint32_t renderTypeFlags,
+	CommandList cmd,
+	bool tessellation = false,
+	const Frustum* frusta = nullptr,
+	uint32_t frustum_count = 1
+)
+{
+	if (renderQueue.empty())
+	{
+#ifdef GGREDUCED
+		if (renderPass == RENDERPASS_MAIN && renderTypeFlags & RENDERTYPE_TRANSPARENT && !overdrawRender[cmd])
+		{
+			GPUParticles::gpup_draw_bydistance(wiScene::GetCamera(), cmd, 0.0f);
+			// repair constant buffers changed by particle shader
+			//BindCommonResources(cmd);
+			BindConstantBuffers(VS, cmd);
+			BindConstantBuffers(PS, cmd);
+		}
+#endif
+		return;
+	}
+
+	switch (renderPass)
+	{
+	case RENDERPASS_MAIN:
+		RenderMeshes_Pass<RENDERPASS_MAIN>(vis, renderQueue, renderTypeFlags, cmd, tessellation, frusta, frustum_count);
+		break;
+	case RENDERPASS_PREPASS:
+		RenderMeshes_Pass<RENDERPASS_PREPASS>(vis, renderQueue, renderTypeFlags, cmd, tessellation, frusta, frustum_count);
+		break;
+	case RENDERPASS_ENVMAPCAPTURE:
+		RenderMeshes_Pass<RENDERPASS_ENVMAPCAPTURE>(vis, renderQueue, renderTypeFlags, cmd, tessellation, frusta, frustum_count);
+		break;
+	case RENDERPASS_SHADOW:
+		RenderMeshes_Pass<RENDERPASS_SHADOW>(vis, renderQueue, renderTypeFlags, cmd, tessellation, frusta, frustum_count);
+		break;
+	case RENDERPASS_SHADOWCUBE:
+		RenderMeshes_Pass<RENDERPASS_SHADOWCUBE>(vis, renderQueue, renderTypeFlags, cmd, tessellation, frusta, frustum_count);
+		break;
+	case RENDERPASS_VOXELIZE:
+		RenderMeshes_Pass<RENDERPASS_VOXELIZE>(vis, renderQueue, renderTypeFlags, cmd, tessellation, frusta, frustum_count);
+		break;
+	default:
+		assert(0);
+		break;
+	}
+}
 
 void RenderImpostors(
 	const Visibility& vis,
@@ -3681,7 +4739,7 @@ void RenderImpostors(
 	CommandList cmd
 )
 {
-	const PipelineState* impostorRequest = GetImpostorPSO(renderPass);
+	const PipelineState* impostorRequest = overdrawRender[cmd] ? &PSO_impostor_overdraw : GetImpostorPSO(renderPass);
 
 	if (vis.scene->impostors.GetCount() > 0 && impostorRequest != nullptr)
 	{
@@ -3689,7 +4747,7 @@ void RenderImpostors(
 		for (size_t impostorID = 0; impostorID < vis.scene->impostors.GetCount(); ++impostorID)
 		{
 			const ImpostorComponent& impostor = vis.scene->impostors[impostorID];
-			if (vis.camera->frustum.CheckBoxFast(impostor.aabb))
+			if (impostor.ready && vis.camera->frustum.CheckBoxFast(impostor.aabb))
 			{
 				instanceCount += (uint32_t)impostor.instanceMatrices.size();
 			}
@@ -3711,7 +4769,7 @@ void RenderImpostors(
 		for (size_t impostorID = 0; impostorID < vis.scene->impostors.GetCount(); ++impostorID)
 		{
 			const ImpostorComponent& impostor = vis.scene->impostors[impostorID];
-			if (!vis.camera->frustum.CheckBoxFast(impostor.aabb))
+			if (!impostor.ready || !vis.camera->frustum.CheckBoxFast(impostor.aabb))
 			{
 				continue;
 			}
@@ -3728,7 +4786,7 @@ void RenderImpostors(
 
 				float dither = std::max(0.0f, impostor.swapInDistance - distance) / impostor.fadeThresholdRadius;
 
-				((volatile Instance*)instances.data)[drawableInstanceCount].Create(mat, impostor.color, dither, uint32_t(impostorID * impostorCaptureAngles * 3));
+				((volatile Instance*)instances.data)[drawableInstanceCount].Create(mat, impostor.color, dither, uint32_t(impostor.textureIndex * 3));
 
 				drawableInstanceCount++;
 			}
@@ -3763,57 +4821,94 @@ void ProcessDeferredMipGenRequests(CommandList cmd)
 	deferredMIPGens.clear();
 	deferredMIPGenLock.unlock();
 }
+// Gathers the indices of the boxes that are inside or intersecting the frustum, in increasing order
+//	The scene BVH is traversed with the batched box kernel if it's up to date with aabbs, otherwise every box is tested
+static void CullBoxes(const Scene& scene, const ComponentManager<AABB>& aabbs, const Frustum& frustum, std::vector<uint32_t>& mask, std::vector<uint32_t>& indices)
+{
+	indices.clear();
+	const wiBVH* bvh = scene.GetBVH(aabbs);
+	if (bvh == nullptr)
+	{
+		for (uint32_t i = 0; i < (uint32_t)aabbs.GetCount(); ++i)
+		{
+			if (frustum.CheckBoxFast(aabbs[i]))
+			{
+				indices.push_back(i);
+			}
+		}
+		return;
+	}
+	mask.resize(bvh->GetMaskSize());
+	bvh->CullFrustum(frustum, mask.data());
+	for (uint32_t word = 0; word < (uint32_t)mask.size(); ++word)
+	{
+		for (uint32_t bits = mask[word], bit = 0; bits != 0; bits >>= 1, ++bit)
+		{
+			if (bits & 1)
+			{
+				indices.push_back(word * 32 + bit);
+			}
+		}
+	}
+}
 //#pragma optimize("", off)
-void UpdateVisibility(Visibility& vis, float maxApparentSize)
+static void UpdateVisibility_Internal(Visibility& vis, float maxApparentSize, const Frustum& frustum)
 {
 	// Perform parallel frustum culling and obtain closest reflector:
 	wiJobSystem::context ctx;
 	wiJobSystem::context ctx_lights;
+	ctx.priority = wiJobSystem::Priority::High; // the rest of the frame is waiting for visibility
+	ctx_lights.priority = wiJobSystem::Priority::High;
+	ctx.name = "UpdateVisibility";
+	ctx_lights.name = "UpdateVisibility - Lights";
 	auto range = wiProfiler::BeginRangeCPU("Frustum Culling");
 
 	assert(vis.scene != nullptr); // User must provide a scene!
 	assert(vis.camera != nullptr); // User must provide a camera!
 
 	// The parallel frustum culling is first performed in shared memory, 
-	//	then each group writes out it's local list to global memory
+	//	then each group writes out it's local list to global memory (wiJobSystem::ParallelCompact)
 	//	The shared memory approach reduces atomics and helps the list to remain
 	//	more coherent (less randomly organized compared to original order)
 	static const uint32_t groupSize = 64;
-	static const size_t sharedmemory_size = (groupSize + 1) * sizeof(uint32_t); // list + counter per group
 
 	// Initialize visible indices:
 	vis.Clear();
 
 	if (!freezeCullingCamera)
 	{
-		vis.frustum = vis.camera->frustum;
+		vis.frustum = frustum;
 	}
 
 	if (vis.flags & Visibility::ALLOW_LIGHTS)
 	{
 		// Cull lights:
 		vis.visibleLights.resize(vis.scene->aabb_lights.GetCount());
-		wiJobSystem::Dispatch(ctx_lights, (uint32_t)vis.scene->aabb_lights.GetCount(), groupSize, [&](wiJobArgs args) {
-
-			// Setup stream compaction:
-			uint32_t& group_count = *(uint32_t*)args.sharedmemory;
-			Visibility::VisibleLight* group_list = (Visibility::VisibleLight*)args.sharedmemory + 1;
-			if (args.isFirstJobInGroup)
-			{
-				group_count = 0; // first thread initializes local counter
-			}
+		const wiBVH* light_bvh = vis.scene->GetBVH(vis.scene->aabb_lights);
+		if (light_bvh != nullptr)
+		{
+			vis.lightFrustumResults.resize(light_bvh->GetMaskSize());
+			light_bvh->CullFrustum(vis.frustum, vis.lightFrustumResults.data());
+		}
+		vis.lightDistances.resize(vis.scene->lights.GetCount());
+		if (!vis.lightDistances.empty())
+		{
+			wiMath::DistanceBatch(&vis.scene->lights[0].position, sizeof(LightComponent), vis.lightDistances.size(), vis.camera->Eye, vis.lightDistances.data());
+		}
+		wiJobSystem::ParallelCompact(ctx_lights, (uint32_t)vis.scene->aabb_lights.GetCount(), groupSize, vis.visibleLights.data(), vis.light_counter, [&, light_bvh](uint32_t index, Visibility::VisibleLight& visible) {
 
-			const AABB& aabb = vis.scene->aabb_lights[args.jobIndex];
-			LightComponent& lightcomponent = (LightComponent & ) vis.scene->lights[args.jobIndex];
+			bool result = false;
+			const AABB& aabb = vis.scene->aabb_lights[index];
+			LightComponent& lightcomponent = (LightComponent & ) vis.scene->lights[index];
 
 			if ((aabb.layerMask & vis.layerMask))
 			{
-				if (vis.frustum.CheckBoxFast(aabb))
+				if (light_bvh != nullptr ? wiBVH::IsVisible(vis.lightFrustumResults.data(), index) : vis.frustum.CheckBoxFast(aabb))
 				{
 					// Local stream compaction:
 					//	(also compute light distance for shadow priority sorting)
-					assert(args.jobIndex < 0xFFFF);
-					group_list[group_count].index = (uint16_t)args.jobIndex;
+					assert(index < 0xFFFF);
+					visible.index = (uint16_t)index;
 					float distance = 0;
 					if (lightcomponent.type != LightComponent::DIRECTIONAL)
 					{
@@ -3826,7 +4921,7 @@ void UpdateVisibility(Visibility& vis, float maxApparentSize)
 						}
 #endif
 
-						distance = wiMath::DistanceEstimated(lightcomponent.position, vis.camera->Eye);
+						distance = vis.lightDistances[index];
 #ifdef GGREDUCED
 						//PE: Before we allow more shadow lights, lets try this to stop more shadow popping.
 						if (bShadowsInFrontTakesPriority)
@@ -3863,8 +4958,8 @@ void UpdateVisibility(Visibility& vis, float maxApparentSize)
 #ifdef GGREDUCED
 					lightcomponent.bPrev_In_Frustom = true;
 #endif
-					group_list[group_count].distance = uint16_t(distance * 10);
-					group_count++;
+					visible.distance = uint16_t(distance * 10);
+					result = true;
 					if (lightcomponent.IsVolumetricsEnabled())
 					{
 						vis.volumetriclight_request.store(true);
@@ -3877,46 +4972,39 @@ void UpdateVisibility(Visibility& vis, float maxApparentSize)
 				}
 #endif
 			}
-			// Global stream compaction:
-			if (args.isLastJobInGroup && group_count > 0)
-			{
-				uint32_t prev_count = vis.light_counter.fetch_add(group_count);
-				for (uint32_t i = 0; i < group_count; ++i)
-				{
-					vis.visibleLights[prev_count + i] = group_list[i];
-				}
-			}
-
-			}, sharedmemory_size);
+			return result;
+		});
 	}
 
 	if (vis.flags & Visibility::ALLOW_OBJECTS)
 	{
 		// Cull objects:
 		vis.visibleObjects.resize(vis.scene->aabb_objects.GetCount());
-		wiJobSystem::Dispatch(ctx, (uint32_t)vis.scene->aabb_objects.GetCount(), groupSize, [&](wiJobArgs args) {
 
-			// Setup stream compaction:
-			uint32_t& group_count = *(uint32_t*)args.sharedmemory;
-			uint32_t* group_list = (uint32_t*)args.sharedmemory + 1;
-			if (args.isFirstJobInGroup)
-			{
-				group_count = 0; // first thread initializes local counter
-			}
+		// The frustum test is done first by traversing the scene BVH, which accepts or rejects whole groups of objects at once:
+		const wiBVH* object_bvh = vis.scene->GetBVH(vis.scene->aabb_objects);
+		if (object_bvh != nullptr)
+		{
+			vis.objectFrustumResults.resize(object_bvh->GetMaskSize());
+			object_bvh->CullFrustum(vis.frustum, vis.objectFrustumResults.data());
+		}
 
-			const AABB& aabb = vis.scene->aabb_objects[args.jobIndex];
+		wiJobSystem::ParallelCompact(ctx, (uint32_t)vis.scene->aabb_objects.GetCount(), groupSize, vis.visibleObjects.data(), vis.object_counter, [&, object_bvh](uint32_t index, uint32_t& visible) {
+
+			bool result = false;
+			const AABB& aabb = vis.scene->aabb_objects[index];
 			bool bFrustum = false;
 			bool bLayer = (aabb.layerMask & vis.layerMask);
 			float apparentSize = 9999.0f;
 			float centerX = 0.0f, centerY = 0.0f, centerZ = 0.0f;
 
-			ObjectComponent& object = (ObjectComponent&)vis.scene->objects[args.jobIndex];
-			if (!object.IsRenderable())
+			ObjectComponent& object = (ObjectComponent&)vis.scene->objects[index];
+			if (!object.IsRenderable() || object.IsHLODCulled())
 				bLayer = false;
 
 			if (bLayer)
 			{
-				bFrustum = vis.frustum.CheckBoxFast(aabb);
+				bFrustum = object_bvh != nullptr ? wiBVH::IsVisible(vis.objectFrustumResults.data(), index) : vis.frustum.CheckBoxFast(aabb);
 			}
 			if (bLayer && bFrustum)
 			{
@@ -3944,11 +5032,11 @@ void UpdateVisibility(Visibility& vis, float maxApparentSize)
 
 			if ( apparentSize > maxApparentSize && bLayer && bFrustum)
 			{
-				// Local stream compaction:
-				group_list[group_count++] = args.jobIndex;
+				visible = index;
+				result = true;
 				if (vis.flags == wiRenderer::Visibility::ALLOW_EVERYTHING) //GGREDUCED
 				{
-					//ObjectComponent& object = (ObjectComponent&)vis.scene->objects[args.jobIndex];
+					//ObjectComponent& object = (ObjectComponent&)vis.scene->objects[index];
 					//bTmpTesting
 					if (!object.bPrev_In_Frustum)
 					{
@@ -3959,7 +5047,7 @@ void UpdateVisibility(Visibility& vis, float maxApparentSize)
 				}
 				if (vis.flags & Visibility::ALLOW_REQUEST_REFLECTION)
 				{
-					//const ObjectComponent& object = vis.scene->objects[args.jobIndex];
+					//const ObjectComponent& object = vis.scene->objects[index];
 
 					if (object.IsRequestPlanarReflection())
 					{
@@ -3989,7 +5077,7 @@ void UpdateVisibility(Visibility& vis, float maxApparentSize)
 				//PE: Set object as culled.
 				if (bLayer && vis.flags == wiRenderer::Visibility::ALLOW_EVERYTHING) //GGREDUCED
 				{
-					//ObjectComponent& object = (ObjectComponent&) vis.scene->objects[args.jobIndex];
+					//ObjectComponent& object = (ObjectComponent&) vis.scene->objects[index];
 					//PE: If frustum culled , need distance to object for Animation Culling (object behind you,must still give shadow).
 					if (bEnableAnimationCulling && !bFrustum && apparentSize > maxApparentSize)
 					{
@@ -4019,73 +5107,50 @@ void UpdateVisibility(Visibility& vis, float maxApparentSize)
 				else
 					object.bPrev_In_Frustum = false;
 			}
-			// Global stream compaction:
-			if (args.isLastJobInGroup && group_count > 0)
-			{
-				uint32_t prev_count = vis.object_counter.fetch_add(group_count);
-				for (uint32_t i = 0; i < group_count; ++i)
-				{
-					vis.visibleObjects[prev_count + i] = group_list[i];
-				}
-			}
-
-		}, sharedmemory_size);
+			return result;
+		});
 	}
 
 	if (vis.flags & Visibility::ALLOW_DECALS)
 	{
 		vis.visibleDecals.resize(vis.scene->aabb_decals.GetCount());
-		wiJobSystem::Dispatch(ctx, (uint32_t)vis.scene->aabb_decals.GetCount(), groupSize, [&](wiJobArgs args) {
-
-			// Setup stream compaction:
-			uint32_t& group_count = *(uint32_t*)args.sharedmemory;
-			uint32_t* group_list = (uint32_t*)args.sharedmemory + 1;
-			if (args.isFirstJobInGroup)
-			{
-				group_count = 0; // first thread initializes local counter
-			}
-
-				const AABB& aabb = vis.scene->aabb_decals[args.jobIndex];
+		const wiBVH* decal_bvh = vis.scene->GetBVH(vis.scene->aabb_decals);
+		if (decal_bvh != nullptr)
+		{
+			vis.decalFrustumResults.resize(decal_bvh->GetMaskSize());
+			decal_bvh->CullFrustum(vis.frustum, vis.decalFrustumResults.data());
+		}
+		wiJobSystem::ParallelCompact(ctx, (uint32_t)vis.scene->aabb_decals.GetCount(), groupSize, vis.visibleDecals.data(), vis.decal_counter, [&, decal_bvh](uint32_t index, uint32_t& visible) {
 
-			if ((aabb.layerMask & vis.layerMask) && vis.frustum.CheckBoxFast(aabb))
-				{
-					// Local stream compaction:
-					group_list[group_count++] = args.jobIndex;
-				}
+			const AABB& aabb = vis.scene->aabb_decals[index];
 
-			// Global stream compaction:
-			if (args.isLastJobInGroup && group_count > 0)
+			if ((aabb.layerMask & vis.layerMask) && (decal_bvh != nullptr ? wiBVH::IsVisible(vis.decalFrustumResults.data(), index) : vis.frustum.CheckBoxFast(aabb)))
 			{
-				uint32_t prev_count = vis.decal_counter.fetch_add(group_count);
-				for (uint32_t i = 0; i < group_count; ++i)
-				{
-					vis.visibleDecals[prev_count + i] = group_list[i];
-				}
+				visible = index;
+				return true;
 			}
-
-			}, sharedmemory_size);
+			return false;
+		});
 	}
 
 	if (vis.flags & Visibility::ALLOW_ENVPROBES)
 	{
 		wiJobSystem::Execute(ctx, [&](wiJobArgs args) {
 			// Cull probes:
-			for (size_t i = 0; i < vis.scene->aabb_probes.GetCount(); ++i)
-			{
-				const AABB& aabb = vis.scene->aabb_probes[i];
-
-				if ((aabb.layerMask & vis.layerMask) && vis.frustum.CheckBoxFast(aabb))
+			vis.scene->QueryBVH(vis.scene->aabb_probes, [&](const AABB& aabb) { return vis.frustum.CheckBoxFast(aabb); }, [&](uint32_t index) {
+				if (vis.scene->aabb_probes[index].layerMask & vis.layerMask)
 				{
-					vis.visibleEnvProbes.push_back((uint32_t)i);
+					vis.visibleEnvProbes.push_back(index);
 				}
-			}
+			});
+			std::sort(vis.visibleEnvProbes.begin(), vis.visibleEnvProbes.end()); // the blending relies on the component order
 			});
 	}
 
 	if (vis.flags & Visibility::ALLOW_EMITTERS)
 	{
 		wiJobSystem::Execute(ctx, [&](wiJobArgs args) {
-			// Cull emitters:
+			// Cull emitters, the ones outside of the frustum are still simulated until they are throttled:
 			for (size_t i = 0; i < vis.scene->emitters.GetCount(); ++i)
 			{
 				const wiEmittedParticle& emitter = vis.scene->emitters[i];
@@ -4093,7 +5158,17 @@ void UpdateVisibility(Visibility& vis, float maxApparentSize)
 				{
 					continue;
 				}
-				vis.visibleEmitters.push_back((uint32_t)i);
+				const bool onscreen = vis.frustum.CheckBoxFast(emitter.aabb);
+				emitter.SetVisibility(onscreen, wiMath::Distance(emitter.center, vis.camera->Eye));
+				if (emitter.IsSimulationSkipped())
+				{
+					continue;
+				}
+				vis.simulatedEmitters.push_back((uint32_t)i);
+				if (onscreen)
+				{
+					vis.visibleEmitters.push_back((uint32_t)i);
+				}
 			}
 			});
 	}
@@ -4113,6 +5188,13 @@ void UpdateVisibility(Visibility& vis, float maxApparentSize)
 				{
 					continue;
 				}
+				// Every strand is farther than the view distance when the nearest point of the bounding box is:
+				const XMVECTOR E = XMLoadFloat3(&vis.camera->Eye);
+				const XMVECTOR N = XMVectorClamp(E, XMLoadFloat3(&hair.aabb._min), XMLoadFloat3(&hair.aabb._max));
+				if (XMVectorGetX(XMVector3Length(N - E)) > hair.viewDistance)
+				{
+					continue;
+				}
 				vis.visibleHairs.push_back((uint32_t)i);
 			}
 			});
@@ -4135,9 +5217,14 @@ void UpdateVisibility(Visibility& vis, float maxApparentSize)
 	if(vis.flags == wiRenderer::Visibility::ALLOW_EVERYTHING)
 		wiProfiler::SetFrustumCulled(vis.scene->aabb_objects.GetCount() - vis.visibleObjects.size());
 
+	if (vis.scene->weather.IsOceanEnabled())
+	{
+		vis.oceanCoverage = wiOcean::ComputeCoverage(*vis.camera, vis.scene->weather.oceanParameters);
+	}
+
 	if (!g_bNoTerrainRender)
 	{
-		if ((vis.flags & Visibility::ALLOW_REQUEST_REFLECTION) && vis.scene->weather.IsOceanEnabled())
+		if ((vis.flags & Visibility::ALLOW_REQUEST_REFLECTION) && vis.oceanCoverage.IsVisible())
 		{
 			// Ocean will override any current reflectors
 			vis.planar_reflection_visible = true;
@@ -4148,32 +5235,489 @@ void UpdateVisibility(Visibility& vis, float maxApparentSize)
 	wiProfiler::EndRange(range); // Frustum Culling
 }
 //#pragma optimize("", on)
-void UpdatePerFrameData(
-	Scene& scene,
-	const Visibility& vis,
-	FrameCB& frameCB,
-	XMUINT2 internalResolution,
-	const wiCanvas& canvas,
-	float dt
-)
+void UpdateVisibility(Visibility& vis, float maxApparentSize)
 {
-	for (int i = 0; i < COMMANDLIST_COUNT; ++i)
+	UpdateVisibility_Internal(vis, maxApparentSize, vis.camera->frustum);
+}
+void UpdateVisibility_Views(Visibility& shared, Visibility* views, uint32_t view_count, float maxApparentSize)
+{
+	assert(view_count > 0);
+	assert(views[0].camera != nullptr); // User must provide a camera for every view!
+
+	XMMATRIX viewProjections[8];
+	assert(view_count <= arraysize(viewProjections));
+	view_count = std::min(view_count, (uint32_t)arraysize(viewProjections));
+	for (uint32_t i = 0; i < view_count; ++i)
 	{
-		renderFrameAllocators[i].reset();
+		assert(views[i].camera != nullptr);
+		viewProjections[i] = views[i].camera->GetViewProjection();
 	}
+	Frustum frustum;
+	frustum.CreateUnion(viewProjections, view_count);
 
-	// Occlusion query allocation:
-	if (GetOcclusionCullingEnabled() && !GetFreezeCullingCameraEnabled())
-	{
-		//PE: Occlusion Culling.
-		if (bEnableObjectCulling)
+	// The first view is the camera of the distance based decisions (LOD, light priority, apparent size):
+	shared.camera = views[0].camera;
+	UpdateVisibility_Internal(shared, maxApparentSize, frustum);
+
+	// Every view keeps the shared objects that its own frustum sees, the other lists are the shared ones:
+	auto range = wiProfiler::BeginRangeCPU("Frustum Culling - Views");
+	wiJobSystem::context ctx;
+	ctx.priority = wiJobSystem::Priority::High;
+	wiJobSystem::Dispatch(ctx, view_count, 1, [&](wiJobArgs args) {
+		Visibility& view = views[args.jobIndex];
+		view.Clear();
+		view.scene = shared.scene;
+		view.layerMask = shared.layerMask;
+		view.flags = shared.flags;
+		if (!freezeCullingCamera)
 		{
-			for (int i = 0; i < vis.visibleObjects.size(); i++)
+			view.frustum = view.camera->frustum;
+		}
+
+		for (uint32_t index : shared.visibleObjects)
+		{
+			if (view.frustum.CheckBoxFast(shared.scene->aabb_objects[index]))
 			{
-				int idx = vis.visibleObjects[i];
-				ObjectComponent& object = scene.objects[idx];
-				if (!object.IsRenderable())
-					continue;
+				view.visibleObjects.push_back(index);
+			}
+		}
+		view.visibleLights = shared.visibleLights;
+		view.visibleDecals = shared.visibleDecals;
+		view.visibleEnvProbes = shared.visibleEnvProbes;
+		view.visibleEmitters = shared.visibleEmitters;
+		view.simulatedEmitters = shared.simulatedEmitters;
+		view.visibleHairs = shared.visibleHairs;
+
+		view.planar_reflection_visible = shared.planar_reflection_visible;
+		view.closestRefPlane = shared.closestRefPlane;
+		view.reflectionPlane = shared.reflectionPlane;
+		view.volumetriclight_request.store(shared.volumetriclight_request.load());
+		view.oceanCoverage = shared.oceanCoverage;
+	});
+	wiJobSystem::Wait(ctx);
+	wiProfiler::EndRange(range);
+}
+// Hi-Z occlusion culling of the main camera:
+//	The grid of every frame is copied to its own readback buffer, which is read by the CPU when the GPU has finished that frame
+//	The grid is reprojected to the current camera, so the latency of the readback doesn't make the results lag behind the camera
+struct OcclusionHiZ
+{
+	GPUBuffer grid;
+	GPUBuffer readback[GraphicsDevice::GetBufferCount()];
+	uint64_t readbackFrame[arraysize(readback)] = {};
+	bool readbackValid[arraysize(readback)] = {};
+	XMFLOAT4X4 readbackInvView[arraysize(readback)];
+	XMFLOAT4X4 readbackInvProjection[arraysize(readback)];
+	float readbackZFar[arraysize(readback)] = {};
+
+	// Reprojected farthest depth mip chain, starting with the full grid:
+	std::vector<float> cells;
+	uint32_t mipOffsets[16] = {};
+	uint32_t mipCount = 0;
+
+	// Reprojects the readback of the slot to the camera, returns false if there is no readback to test against
+	bool Reproject(uint32_t slot, const CameraComponent& camera)
+	{
+		if (!readbackValid[slot])
+		{
+			return false;
+		}
+
+		Mapping mapping;
+		mapping._flags = Mapping::FLAG_READ;
+		mapping.size = readback[slot].GetDesc().ByteWidth;
+		device->Map(&readback[slot], &mapping);
+		if (mapping.data == nullptr)
+		{
+			return false;
+		}
+		const float* data = (const float*)mapping.data;
+
+		if (mipCount == 0)
+		{
+			uint32_t width = OCCLUSIONCULLING_HIZ_WIDTH;
+			uint32_t height = OCCLUSIONCULLING_HIZ_HEIGHT;
+			uint32_t offset = 0;
+			while (true)
+			{
+				assert(mipCount < arraysize(mipOffsets));
+				mipOffsets[mipCount++] = offset;
+				offset += width * height;
+				if (width == 1 && height == 1)
+				{
+					break;
+				}
+				width = std::max(1u, width / 2);
+				height = std::max(1u, height / 2);
+			}
+			cells.resize(offset);
+		}
+
+		// Cells that nothing is reprojected to stay negative, and are opened up to the far plane afterwards:
+		std::fill(cells.begin(), cells.begin() + OCCLUSIONCULLING_HIZ_WIDTH * OCCLUSIONCULLING_HIZ_HEIGHT, -1.0f);
+
+		const XMMATRIX InvView = XMLoadFloat4x4(&readbackInvView[slot]);
+		const XMMATRIX InvProjection = XMLoadFloat4x4(&readbackInvProjection[slot]);
+		const XMMATRIX VP = camera.GetViewProjection();
+		const float zFar = readbackZFar[slot];
+		const float zFar_rcp = 1.0f / camera.zFarP;
+		for (uint32_t y = 0; y < OCCLUSIONCULLING_HIZ_HEIGHT; ++y)
+		{
+			for (uint32_t x = 0; x < OCCLUSIONCULLING_HIZ_WIDTH; ++x)
+			{
+				const float depth = data[y * OCCLUSIONCULLING_HIZ_WIDTH + x];
+				if (depth >= 1)
+				{
+					// Nothing was rendered there, it can't occlude
+					continue;
+				}
+
+				// The cell center is moved along its view ray to the farthest depth of the cell:
+				const float ndc_x = ((float)x + 0.5f) / OCCLUSIONCULLING_HIZ_WIDTH * 2 - 1;
+				const float ndc_y = 1 - ((float)y + 0.5f) / OCCLUSIONCULLING_HIZ_HEIGHT * 2;
+				XMVECTOR P = XMVector3TransformCoord(XMVectorSet(ndc_x, ndc_y, 0.5f, 1), InvProjection);
+				P = XMVectorScale(P, depth * zFar / XMVectorGetZ(P));
+				P = XMVector3TransformCoord(P, InvView);
+
+				const XMVECTOR clip = XMVector4Transform(XMVectorSetW(P, 1), VP);
+				const float w = XMVectorGetW(clip);
+				if (w <= camera.zNearP)
+				{
+					continue;
+				}
+				const float cell_x = (XMVectorGetX(clip) / w * 0.5f + 0.5f) * OCCLUSIONCULLING_HIZ_WIDTH;
+				const float cell_y = (0.5f - XMVectorGetY(clip) / w * 0.5f) * OCCLUSIONCULLING_HIZ_HEIGHT;
+				if (cell_x < 0 || cell_y < 0 || cell_x >= OCCLUSIONCULLING_HIZ_WIDTH || cell_y >= OCCLUSIONCULLING_HIZ_HEIGHT)
+				{
+					continue;
+				}
+				float& cell = cells[uint32_t(cell_y) * OCCLUSIONCULLING_HIZ_WIDTH + uint32_t(cell_x)];
+				cell = std::max(cell, w * zFar_rcp);
+			}
+		}
+
+		device->Unmap(&readback[slot]);
+
+		for (uint32_t i = 0; i < OCCLUSIONCULLING_HIZ_WIDTH * OCCLUSIONCULLING_HIZ_HEIGHT; ++i)
+		{
+			if (cells[i] < 0)
+			{
+				cells[i] = 1;
+			}
+		}
+
+		// Farthest depth reduction, the last row and column also take the extra cells of odd sizes:
+		uint32_t width = OCCLUSIONCULLING_HIZ_WIDTH;
+		uint32_t height = OCCLUSIONCULLING_HIZ_HEIGHT;
+		for (uint32_t mip = 1; mip < mipCount; ++mip)
+		{
+			const float* src = cells.data() + mipOffsets[mip - 1];
+			float* dst = cells.data() + mipOffsets[mip];
+			const uint32_t mip_width = std::max(1u, width / 2);
+			const uint32_t mip_height = std::max(1u, height / 2);
+			for (uint32_t y = 0; y < mip_height; ++y)
+			{
+				const uint32_t y_end = y == mip_height - 1 ? height : std::min(height, y * 2 + 2);
+				for (uint32_t x = 0; x < mip_width; ++x)
+				{
+					const uint32_t x_end = x == mip_width - 1 ? width : std::min(width, x * 2 + 2);
+					float farthest = 0;
+					for (uint32_t sy = y * 2; sy < y_end; ++sy)
+					{
+						for (uint32_t sx = x * 2; sx < x_end; ++sx)
+						{
+							farthest = std::max(farthest, src[sy * width + sx]);
+						}
+					}
+					dst[y * mip_width + x] = farthest;
+				}
+			}
+			width = mip_width;
+			height = mip_height;
+		}
+
+		return true;
+	}
+
+	// Tests the box against the reprojected Hi-Z, the camera must be the one that it was reprojected to
+	bool IsVisible(const AABB& aabb, const CameraComponent& camera) const
+	{
+		const XMMATRIX VP = camera.GetViewProjection();
+		float nearest = FLT_MAX;
+		XMFLOAT2 ndc_min = XMFLOAT2(FLT_MAX, FLT_MAX);
+		XMFLOAT2 ndc_max = XMFLOAT2(-FLT_MAX, -FLT_MAX);
+		for (int i = 0; i < 8; ++i)
+		{
+			const XMFLOAT3 corner = aabb.corner(i);
+			const XMVECTOR clip = XMVector4Transform(XMVectorSet(corner.x, corner.y, corner.z, 1), VP);
+			const float w = XMVectorGetW(clip);
+			if (w <= camera.zNearP)
+			{
+				// The box crosses the near plane
+				return true;
+			}
+			nearest = std::min(nearest, w);
+			const float ndc_x = XMVectorGetX(clip) / w;
+			const float ndc_y = XMVectorGetY(clip) / w;
+			ndc_min = XMFLOAT2(std::min(ndc_min.x, ndc_x), std::min(ndc_min.y, ndc_y));
+			ndc_max = XMFLOAT2(std::max(ndc_max.x, ndc_x), std::max(ndc_max.y, ndc_y));
+		}
+		if (ndc_max.x < -1 || ndc_max.y < -1 || ndc_min.x > 1 || ndc_min.y > 1)
+		{
+			// Outside of the screen, that is up to the frustum culling
+			return true;
+		}
+
+		// The rectangle of covered cells is extended by one cell, because the reprojected cells are only sampled at their centers:
+		const int x0 = std::max(0, int(std::floor((ndc_min.x * 0.5f + 0.5f) * OCCLUSIONCULLING_HIZ_WIDTH)) - 1);
+		const int x1 = std::min(OCCLUSIONCULLING_HIZ_WIDTH - 1, int(std::floor((ndc_max.x * 0.5f + 0.5f) * OCCLUSIONCULLING_HIZ_WIDTH)) + 1);
+		const int y0 = std::max(0, int(std::floor((0.5f - ndc_max.y * 0.5f) * OCCLUSIONCULLING_HIZ_HEIGHT)) - 1);
+		const int y1 = std::min(OCCLUSIONCULLING_HIZ_HEIGHT - 1, int(std::floor((0.5f - ndc_min.y * 0.5f) * OCCLUSIONCULLING_HIZ_HEIGHT)) + 1);
+
+		// The mip where the rectangle covers at most 2x2 cells:
+		uint32_t mip = 0;
+		while (mip + 1 < mipCount && ((x1 >> mip) - (x0 >> mip) > 1 || (y1 >> mip) - (y0 >> mip) > 1))
+		{
+			mip++;
+		}
+		const int mip_width = std::max(1, OCCLUSIONCULLING_HIZ_WIDTH >> mip);
+		const int mip_height = std::max(1, OCCLUSIONCULLING_HIZ_HEIGHT >> mip);
+		const float* mipCells = cells.data() + mipOffsets[mip];
+		float farthest = 0;
+		for (int y = std::min(y0 >> mip, mip_height - 1); y <= std::min(y1 >> mip, mip_height - 1); ++y)
+		{
+			for (int x = std::min(x0 >> mip, mip_width - 1); x <= std::min(x1 >> mip, mip_width - 1); ++x)
+			{
+				farthest = std::max(farthest, mipCells[y * mip_width + x]);
+			}
+		}
+
+		return nearest / camera.zFarP < farthest;
+	}
+};
+OcclusionHiZ occlusionHiZ;
+
+// Advances the occlusion history of the visible objects, terrain chunks and shadow lights with the Hi-Z test
+static void OcclusionCulling_HiZTest(Scene& scene, const Visibility& vis)
+{
+	auto range = wiProfiler::BeginRangeCPU("Occlusion Culling (Hi-Z)");
+
+	// The readback slot of this frame was written GetBufferCount() frames ago, so the GPU has already finished it:
+	const uint32_t slot = uint32_t(device->GetFrameCount() % arraysize(occlusionHiZ.readback));
+	const bool valid = occlusionHiZ.Reproject(slot, *vis.camera);
+	const CameraComponent& camera = *vis.camera;
+
+	if (bEnableObjectCulling)
+	{
+		wiJobSystem::context ctx;
+		wiJobSystem::Dispatch(ctx, (uint32_t)vis.visibleObjects.size(), 64, [&](wiJobArgs args) {
+			const uint32_t idx = vis.visibleObjects[args.jobIndex];
+			ObjectComponent& object = scene.objects[idx];
+			if (!object.IsRenderable() || object.IsCulled())
+			{
+				return;
+			}
+			const AABB& aabb = scene.aabb_objects[idx];
+			//PE: Dont occlude nearby object.
+			const bool visible = !valid || object.GetCameraDistance() < 1000 || aabb.intersects(camera.Eye) || occlusionHiZ.IsVisible(aabb, camera);
+			object.occlusionHistory = (object.occlusionHistory << 1) | (visible ? 1 : 0);
+		});
+		wiJobSystem::Wait(ctx);
+	}
+
+#ifdef GGREDUCED
+	if (bEnableTerrainChunkCulling && !terrainChunkGPUCulling)
+	{
+		const uint32_t lodstart = GGTerrain::GetChunkLodStart();
+		for (int lod = lodstart; lod < 9; lod++)
+		{
+			for (int i = 0; i < 64; i++)
+			{
+				TerrainChunkOcclusion* pTCO = GGTerrain::GetChunkVisibleMem(lod, i);
+				if (pTCO && pTCO->bChunkVisible)
+				{
+					const bool visible = !valid || occlusionHiZ.IsVisible(pTCO->aabb, camera);
+					pTCO->history = (pTCO->history << 1) | (visible ? 1 : 0);
+				}
+			}
+		}
+	}
+
+	if (bEnableSpotShadowCulling || bEnablePointShadowCulling)
+	{
+		for (auto visibleLight : vis.visibleLights)
+		{
+			LightComponent& light = scene.lights[visibleLight.index];
+			if (!light.IsCastingShadow() || light.IsStatic() || light.GetType() == LightComponent::DIRECTIONAL)
+			{
+				continue;
+			}
+			if (light.GetType() == LightComponent::SPOT ? !bEnableSpotShadowCulling : !bEnablePointShadowCulling)
+			{
+				continue;
+			}
+			const AABB& aabb = scene.aabb_lights[visibleLight.index];
+			const bool visible = !valid || aabb.intersects(camera.Eye) || occlusionHiZ.IsVisible(aabb, camera);
+			light.history = (light.history << 1) | (visible ? 1 : 0);
+		}
+	}
+#endif
+
+	wiProfiler::EndRange(range);
+}
+
+// Assigns the spot light shadow tiles within the fixed atlas pages of shadowMapArray_Spot_2D
+//	The tile size is the smallest power of two that covers the projected size of the light on the screen,
+//	if the lights don't fit into the pages, the least important tiles are halved and finally dropped
+static void PackSpotShadowAtlas(Scene& scene, const Visibility& vis)
+{
+	for (size_t i = 0; i < scene.lights.GetCount(); ++i)
+	{
+		scene.lights[i].shadow_page = -1;
+	}
+	if (SHADOWRES_SPOT_2D == 0 || SHADOWCOUNT_SPOT_2D == 0 || GetRaytracedShadowsEnabled())
+	{
+		return;
+	}
+
+	struct Candidate
+	{
+		uint32_t lightIndex;
+		float coverage;
+		int size;
+	};
+	static thread_local std::vector<Candidate> candidates;
+	candidates.clear();
+
+	const CameraComponent& camera = *vis.camera;
+	const int maxSize = (int)SHADOWRES_SPOT_2D;
+	const int minSize = std::min(maxSize, std::max(maxSize >> 3, 16));
+	for (auto visibleLight : vis.visibleLights)
+	{
+		const LightComponent& light = scene.lights[visibleLight.index];
+		if (light.GetType() != LightComponent::SPOT || !light.IsCastingShadow() || light.IsStatic())
+		{
+			continue;
+		}
+		if (light.history == 0 && bEnableSpotShadowCulling)
+		{
+			continue;
+		}
+
+		// Ratio of the projected light sphere and the screen height, 1 when the camera is inside:
+		const float range = light.GetRange();
+		const float dist = wiMath::Distance(light.position, camera.Eye);
+		const float coverage = dist > range ? std::min(1.0f, range * camera.Projection._22 / dist) : 1.0f;
+
+		int size = minSize;
+		while (size < maxSize && (float)size < coverage * maxSize)
+		{
+			size *= 2;
+		}
+		candidates.push_back({ visibleLight.index, coverage, size });
+	}
+	if (candidates.empty())
+	{
+		return;
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+		return a.coverage > b.coverage;
+	});
+
+	// Shrinks the least important tile that is still above the minimum size, or drops the least important light:
+	auto shrink = [&]() {
+		for (size_t i = candidates.size(); i > 0; --i)
+		{
+			if (candidates[i - 1].size > minSize)
+			{
+				candidates[i - 1].size /= 2;
+				return;
+			}
+		}
+		candidates.pop_back();
+	};
+
+	// The area check is cheap, so the packer is only tried when the tiles could already fit:
+	auto area = [&]() {
+		uint64_t result = 0;
+		for (const Candidate& x : candidates)
+		{
+			result += (uint64_t)x.size * x.size;
+		}
+		return result;
+	};
+	const uint64_t budget = (uint64_t)SHADOWCOUNT_SPOT_2D * maxSize * maxSize;
+	while (area() > budget)
+	{
+		shrink();
+	}
+
+	using namespace wiRectPacker;
+	static thread_local std::vector<rect_xywh> rects;
+	static thread_local std::vector<rect_xywh*> rect_pointers;
+	static thread_local std::vector<bin> bins;
+	while (!candidates.empty())
+	{
+		rects.resize(candidates.size());
+		rect_pointers.resize(candidates.size());
+		for (size_t i = 0; i < candidates.size(); ++i)
+		{
+			rects[i] = rect_xywh(0, 0, candidates[i].size, candidates[i].size);
+			rect_pointers[i] = &rects[i];
+		}
+		bins.clear();
+		if (pack(rect_pointers.data(), (int)rect_pointers.size(), maxSize, bins) && bins.size() <= SHADOWCOUNT_SPOT_2D)
+		{
+			break;
+		}
+		shrink();
+	}
+	if (candidates.empty())
+	{
+		return;
+	}
+
+	for (size_t page = 0; page < bins.size(); ++page)
+	{
+		for (rect_xywh* rect : bins[page].rects)
+		{
+			LightComponent& light = scene.lights[candidates[rect - rects.data()].lightIndex];
+			light.shadow_page = (int)page;
+			light.shadow_rect = *rect;
+		}
+	}
+}
+
+void UpdatePerFrameData(
+	Scene& scene,
+	const Visibility& vis,
+	FrameCB& frameCB,
+	XMUINT2 internalResolution,
+	const wiCanvas& canvas,
+	float dt
+)
+{
+	for (int i = 0; i < COMMANDLIST_COUNT; ++i)
+	{
+		renderFrameAllocators[i].reset();
+	}
+
+	if (GetOcclusionCullingEnabled() && GetOcclusionCullingHiZEnabled() && !GetFreezeCullingCameraEnabled())
+	{
+		OcclusionCulling_HiZTest(scene, vis);
+	}
+	// Occlusion query allocation:
+	else if (GetOcclusionCullingEnabled() && !GetFreezeCullingCameraEnabled())
+	{
+		//PE: Occlusion Culling.
+		if (bEnableObjectCulling)
+		{
+			for (int i = 0; i < vis.visibleObjects.size(); i++)
+			{
+				int idx = vis.visibleObjects[i];
+				ObjectComponent& object = scene.objects[idx];
+				if (!object.IsRenderable())
+					continue;
 				if (object.IsCulled())
 					continue;
 				//PE: Dont occlude nearby object.
@@ -4209,7 +5753,7 @@ void UpdatePerFrameData(
 #ifdef GGREDUCED
 		TerrainChunkOcclusion* pTCO;
 		uint32_t lodstart = GGTerrain::GetChunkLodStart();
-		if (bEnableTerrainChunkCulling)
+		if (bEnableTerrainChunkCulling && !terrainChunkGPUCulling)
 		{
 			for (int lod = lodstart; lod < 9; lod++)
 			{
@@ -4295,27 +5839,69 @@ void UpdatePerFrameData(
 
 	}
 
-	// Update Voxelization parameters:
-	if (scene.objects.GetCount() > 0)
+	// The spot shadow tiles are chosen after the occlusion results of the lights were updated:
+	PackSpotShadowAtlas(scene, vis);
+
+	PrepareMaterialTable(scene);
+
+	// Resources that finished loading or lost mips have new textures, so the descriptors of every material are refreshed:
+	if (wiResourceManager::ApplyPendingChanges())
 	{
-		// We don't update it if the scene is empty, this even makes it easier to debug
-		const float f = 0.05f / voxelSceneData.voxelsize;
-		XMFLOAT3 center = XMFLOAT3(floorf(vis.camera->Eye.x * f) / f, floorf(vis.camera->Eye.y * f) / f, floorf(vis.camera->Eye.z * f) / f);
-		if (wiMath::DistanceSquared(center, voxelSceneData.center) > 0)
+		for (size_t i = 0; i < scene.materials.GetCount(); ++i)
 		{
-			voxelSceneData.centerChangedThisFrame = true;
+			scene.materials[i].dirty_buffer = true;
 		}
-		else
+	}
+
+	// Textures of visible materials are kept resident with priority, and request the resolution that the objects need for streaming:
+	if (wiResourceManager::IsResidencyEnabled() || wiResourceManager::IsStreamingEnabled())
+	{
+		for (uint32_t instanceIndex : vis.visibleObjects)
+		{
+			const ObjectComponent& object = scene.objects[instanceIndex];
+			if (object.mesh_index == ~0u)
+				continue;
+			const MeshComponent& mesh = scene.meshes[object.mesh_index];
+			for (auto& subset : mesh.subsets)
+			{
+				const MaterialComponent* material = scene.materials.GetComponent(subset.materialID);
+				if (material == nullptr)
+					continue;
+				for (auto& map : material->textures)
+				{
+					if (map.resource != nullptr)
+					{
+						wiResourceManager::TouchResource(*map.resource, object.texture_resolution);
+					}
+				}
+			}
+		}
+	}
+
+	// Update the voxel GI clipmaps, they follow the camera in steps of VOXEL_GI_CLIPMAP_SCROLL_GRANULARITY voxels:
+	if (scene.objects.GetCount() > 0)
+	{
+		// We don't update it if the scene is empty, this even makes it easier to debug
+		for (uint32_t i = 0; i < VOXEL_GI_CLIPMAP_COUNT; ++i)
 		{
-			voxelSceneData.centerChangedThisFrame = false;
+			const float step = voxelSceneData.GetVoxelSize(i) * VOXEL_GI_CLIPMAP_SCROLL_GRANULARITY;
+			const int halfres = int(voxelSceneData.res / 2);
+			XMINT3& origin = voxelSceneData.clipmaps[i].origin;
+			origin.x = int(std::floor(vis.camera->Eye.x / step)) * int(VOXEL_GI_CLIPMAP_SCROLL_GRANULARITY) - halfres;
+			origin.y = int(std::floor(vis.camera->Eye.y / step)) * int(VOXEL_GI_CLIPMAP_SCROLL_GRANULARITY) - halfres;
+			origin.z = int(std::floor(vis.camera->Eye.z / step)) * int(VOXEL_GI_CLIPMAP_SCROLL_GRANULARITY) - halfres;
 		}
-		voxelSceneData.center = center;
-		voxelSceneData.extents = XMFLOAT3(voxelSceneData.res * voxelSceneData.voxelsize, voxelSceneData.res * voxelSceneData.voxelsize, voxelSceneData.res * voxelSceneData.voxelsize);
 	}
 
-	if (!device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_PIPELINE) && !device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE) && scene.IsAccelerationStructureUpdateRequested())
+	if (!device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_PIPELINE) && !device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE) &&
+		(scene.IsAccelerationStructureUpdateRequested() || scene.BVH.IsUpdatePending()))
 	{
 		scene.BVH.Update(scene);
+		if (scene.BVH.IsBuildRequired())
+		{
+			// A finished SAH tree is put in place by the next build, even if the update of the scene wasn't requested
+			scene.SetAccelerationStructureUpdateRequested(true);
+		}
 	}
 
 	// Update CPU-side frame constant buffer:
@@ -4368,9 +5954,22 @@ void UpdatePerFrameData(
 	frameCB.g_xFrame_VoxelRadianceNumCones = std::max(std::min(voxelSceneData.numCones, 16u), 1u);
 	frameCB.g_xFrame_VoxelRadianceNumCones_rcp = 1.0f / (float)frameCB.g_xFrame_VoxelRadianceNumCones;
 	frameCB.g_xFrame_VoxelRadianceRayStepSize = voxelSceneData.rayStepSize;
-	frameCB.g_xFrame_VoxelRadianceDataCenter = voxelSceneData.center;
+	frameCB.g_xFrame_VoxelRadianceDataCenter = voxelSceneData.GetCenter(0);
+	for (uint32_t i = 0; i < VOXEL_GI_CLIPMAP_COUNT; ++i)
+	{
+		const XMFLOAT3 center = voxelSceneData.GetCenter(i);
+		frameCB.g_xFrame_VoxelClipMaps[i] = XMFLOAT4(center.x, center.y, center.z, voxelSceneData.GetVoxelSize(i) * 0.5f);
+	}
 	frameCB.g_xFrame_EntityCullingTileCount = GetEntityCullingTileCount(internalResolution);
+	{
+		// Exponential depth slices between the near and far planes:
+		const float zNear = std::max(0.001f, vis.camera->zNearP);
+		const float zFar = std::max(zNear * 2, vis.camera->zFarP);
+		const float scale = (float)frameCB.g_xFrame_EntityCullingTileCount.z / std::log(zFar / zNear);
+		frameCB.g_xFrame_EntityCullingClusterScaleBias = XMFLOAT2(scale, -std::log(zNear) * scale);
+	}
 	frameCB.g_xFrame_ObjectShaderSamplerIndex = device->GetDescriptorIndex(&samplers[SSLOT_OBJECTSHADER]);
+	frameCB.g_xFrame_MaterialTableIndex = device->GetDescriptorIndex(&materialTable, SRV);
 
 	// The order is very important here:
 	frameCB.g_xFrame_DecalArrayOffset = 0;
@@ -4473,10 +6072,6 @@ void UpdatePerFrameData(
 	{
 		frameCB.g_xFrame_Options |= OPTION_BIT_VOXELGI_REFLECTIONS_ENABLED;
 	}
-	if (voxelSceneData.centerChangedThisFrame)
-	{
-		frameCB.g_xFrame_Options |= OPTION_BIT_VOXELGI_RETARGETTED;
-	}
 	if (vis.scene->weather.IsSimpleSky())
 	{
 		frameCB.g_xFrame_Options |= OPTION_BIT_SIMPLE_SKY;
@@ -4574,6 +6169,45 @@ void UpdatePerFrameData(
 		device->SetName(&texture_weatherMap, "texture_weatherMap");
 	}
 }
+
+// Uploads the elements that changed since the previous upload, the changes that are close to each other are merged into one copy
+template<typename T>
+static void UpdateBufferIncremental(const GPUBuffer& buffer, const T* data, uint32_t count, std::vector<T>& uploaded, CommandList cmd)
+{
+	static constexpr uint32_t merge_distance = 8; // elements
+	static constexpr uint32_t max_copies = 16; // after this, everything up to the last change is uploaded with one copy
+
+	const uint32_t uploaded_count = (uint32_t)std::min(uploaded.size(), (size_t)count);
+	uint32_t copies = 0;
+	uint32_t range_begin = ~0u;
+	uint32_t range_end = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (i < uploaded_count && std::memcmp(&uploaded[i], &data[i], sizeof(T)) == 0)
+		{
+			continue;
+		}
+		if (range_begin != ~0u && i > range_end + merge_distance && copies < max_copies - 1)
+		{
+			device->UpdateBuffer(&buffer, data + range_begin, cmd, int(sizeof(T) * (range_end - range_begin)), uint32_t(sizeof(T) * range_begin));
+			copies++;
+			range_begin = ~0u;
+		}
+		if (range_begin == ~0u)
+		{
+			range_begin = i;
+		}
+		range_end = i + 1;
+	}
+	if (range_begin != ~0u)
+	{
+		device->UpdateBuffer(&buffer, data + range_begin, cmd, int(sizeof(T) * (range_end - range_begin)), uint32_t(sizeof(T) * range_begin));
+	}
+
+	// The elements after count are not used by the shaders, so they don't need to match:
+	uploaded.assign(data, data + count);
+}
+
 void UpdateRenderData(
 	const Visibility& vis,
 	const FrameCB& frameCB,
@@ -4590,20 +6224,98 @@ void UpdateRenderData(
 
 	BindCommonResources(cmd);
 
-	// Update dirty material constant buffers:
-	for (size_t i = 0; i < vis.scene->materials.GetCount(); ++i)
+	wiResourceManager::UpdateResidency(cmd);
+
+	// Update the dirty materials in the material table, and their constant buffers:
+	//	With the material table, the object shaders don't use the constant buffers, only the hair and emitted particles bind them
+	const uint32_t materialCount = (uint32_t)vis.scene->materials.GetCount();
+	const bool materialTableRequest = materialTable.IsValid() && materialTable.GetDesc().ByteWidth >= materialCount * sizeof(ShaderMaterial);
+	const bool materialTableFullUpdate = materialTableRequest && (materialTableScene != vis.scene || materialTableCount != materialCount);
+	if (materialTableRequest)
+	{
+		materialTableScene = vis.scene;
+		materialTableCount = materialCount;
+	}
+	materialTableUpdateData.resize(16);
+	uint32_t materialUpdateCount = 0;
+	for (uint32_t i = 0; i < materialCount; ++i)
 	{
 		const MaterialComponent& material = vis.scene->materials[i];
-		if (material.dirty_buffer)
+		bool constantBufferRequest = !materialTableRequest;
+		if (!constantBufferRequest && (material.dirty_buffer || material.dirty_constantbuffer))
 		{
-			material.dirty_buffer = false;
-
-			ShaderMaterial shadermaterial;
-			material.WriteShaderMaterial(&shadermaterial);
-			device->UpdateBuffer(&material.constantBuffer, &shadermaterial, cmd);
+			const Entity entity = vis.scene->materials.GetEntity(i);
+			constantBufferRequest = vis.scene->hairs.Contains(entity) || vis.scene->emitters.Contains(entity);
 		}
-	}
-
+		if (!material.dirty_buffer && !materialTableFullUpdate && !(constantBufferRequest && material.dirty_constantbuffer))
+		{
+			continue;
+		}
+
+		ShaderMaterial shadermaterial;
+		material.WriteShaderMaterial(&shadermaterial);
+		if (material.dirty_buffer || material.dirty_constantbuffer)
+		{
+			if (constantBufferRequest)
+			{
+				device->UpdateBuffer(&material.constantBuffer, &shadermaterial, cmd);
+			}
+			material.dirty_constantbuffer = !constantBufferRequest; // updated when something starts to bind it
+			material.dirty_buffer = false;
+		}
+		if (materialTableRequest)
+		{
+			const size_t offset = materialTableUpdateData.size();
+			materialTableUpdateData.resize(offset + MATERIALTABLE_UPDATE_STRIDE);
+			uint8_t* update = materialTableUpdateData.data() + offset;
+			std::memset(update, 0, 16);
+			std::memcpy(update, &i, sizeof(i));
+			std::memcpy(update + 16, &shadermaterial, sizeof(shadermaterial));
+			materialUpdateCount++;
+		}
+	}
+	if (materialUpdateCount > 0)
+	{
+		std::memset(materialTableUpdateData.data(), 0, 16);
+		std::memcpy(materialTableUpdateData.data(), &materialUpdateCount, sizeof(materialUpdateCount));
+
+		if (!materialTableUpdates.IsValid() || materialTableUpdates.GetDesc().ByteWidth < materialTableUpdateData.size())
+		{
+			GPUBufferDesc desc;
+			desc.Usage = USAGE_DEFAULT;
+			desc.BindFlags = BIND_SHADER_RESOURCE;
+			desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+			desc.ByteWidth = uint32_t(materialTableUpdateData.size() * 2);
+			device->CreateBuffer(&desc, nullptr, &materialTableUpdates);
+			device->SetName(&materialTableUpdates, "materialTableUpdates");
+		}
+
+		device->EventBegin("Material Table Update", cmd);
+		device->UpdateBuffer(&materialTableUpdates, materialTableUpdateData.data(), cmd, (int)materialTableUpdateData.size());
+
+		device->BindComputeShader(&shaders[CSTYPE_MATERIALTABLE_UPDATE], cmd);
+		device->BindResource(CS, &materialTableUpdates, MATERIALTABLESLOT_IN_UPDATES, cmd);
+		const GPUResource* uavs[] = {
+			&materialTable,
+		};
+		device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+		device->Dispatch((materialUpdateCount + MATERIALTABLE_UPDATE_THREADCOUNT - 1) / MATERIALTABLE_UPDATE_THREADCOUNT, 1, 1, cmd);
+
+		GPUBarrier barriers[] = {
+			GPUBarrier::Memory(),
+		};
+		device->Barrier(barriers, arraysize(barriers), cmd);
+		device->UnbindUAVs(0, 1, cmd);
+		device->UnbindResources(MATERIALTABLESLOT_IN_UPDATES, 1, cmd);
+		device->EventEnd(cmd);
+	}
+
+	if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS))
+	{
+		UpdateInstanceTable(*vis.scene, cmd);
+	}
+
 	// Fill Entity Array with decals + envprobes + lights in the frustum:
 	{
 		// Reserve temporary entity array for GPU data upload:
@@ -4653,7 +6365,13 @@ void UpdateRenderData(
 			matrixArray[matrixCounter] = XMMatrixInverse(nullptr, XMLoadFloat4x4(&decal.world));
 
 			XMFLOAT4 atlasMulAdd;
-			if (decal.texture != nullptr)
+			if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS))
+			{
+				// The texture is sampled directly:
+				atlasMulAdd = XMFLOAT4(1, 1, 0, 0);
+				entityArray[entityCounter].userdata = decal.texture == nullptr ? ~0u : (uint32_t)device->GetDescriptorIndex(&decal.texture->texture, SRV);
+			}
+			else if (decal.texture != nullptr)
 			{
 				const TextureDesc& desc = vis.scene->decalAtlas.GetDesc();
 
@@ -4728,7 +6446,6 @@ void UpdateRenderData(
 
 		// Write lights into entity array:
 		uint32_t shadowCounter_2D = SHADOWRES_2D > 0 ? 0 : SHADOWCOUNT_2D;
-		uint32_t shadowCounter_Spot_2D = SHADOWRES_SPOT_2D > 0 ? 0 : SHADOWCOUNT_SPOT_2D;
 		uint32_t shadowCounter_Cube = SHADOWRES_CUBE > 0 ? 0 : SHADOWCOUNT_CUBE;
 		for (auto visibleLight : vis.visibleLights)
 		{
@@ -4776,6 +6493,7 @@ void UpdateRenderData(
 
 			// mark as no shadow by default:
 			entityArray[entityCounter].indices = ~0;
+			uint32_t shadowSlice = ~0u; // first slice of the directional light cascades
 
 			bool shadow = light.IsCastingShadow() && !light.IsStatic();
 
@@ -4794,14 +6512,15 @@ void UpdateRenderData(
 						if (shadowCounter_2D < SHADOWCOUNT_2D - CASCADE_COUNT + 1)
 						{
 							entityArray[entityCounter].SetIndices(matrixCounter, shadowCounter_2D);
+							shadowSlice = shadowCounter_2D;
 							shadowCounter_2D += CASCADE_COUNT;
 						}
 						break;
 					case LightComponent::SPOT:
-						if (shadowCounter_Spot_2D < SHADOWCOUNT_SPOT_2D)
+						if (light.shadow_page >= 0)
 						{
-							entityArray[entityCounter].SetIndices(matrixCounter, shadowCounter_Spot_2D);
-							shadowCounter_Spot_2D += 1;
+							entityArray[entityCounter].SetIndices(matrixCounter, (uint32_t)light.shadow_page);
+							entityArray[entityCounter].SetShadowAtlasTile(light.shadow_rect.x, light.shadow_rect.y, light.shadow_rect.w);
 						}
 						break;
 					default:
@@ -4826,32 +6545,40 @@ void UpdateRenderData(
 					std::array<SHCAM, CASCADE_COUNT> shcams;
 					CreateDirLightShadowCams(light, *vis.camera, shcams);
 
+					// The update intervals are offset by the cascade index, so the slow cascades are not all due in the same frame:
+					const uint64_t frame = device->GetFrameCount();
+					bool bUpdateCascade[CASCADE_COUNT];
+					for (uint32_t cascade = 0; cascade < CASCADE_COUNT; ++cascade)
+					{
+						const uint32_t interval = std::max(1u, shadowCascadeUpdateInterval[cascade]);
+						bUpdateCascade[cascade] = ((frame + cascade) % interval) == 0;
+					}
+
 					#ifdef GGREDUCED
 					#ifdef DELAYEDSHADOWS
-					int iDelayedShadows = device->GetFrameCount();
-					for (uint32_t cascade = 0; cascade < CASCADE_COUNT; ++cascade)
+					int iDelayedShadows = (int)frame;
+					if (g_bDelayedShadows)
 					{
-						bUpdateCascade[cascade] = true;
-						if (g_bDelayedShadowsLaptop && g_bDelayedShadows)
-						{
-							if (cascade == 4 && (iDelayedShadows % 9) != 0) bUpdateCascade[cascade] = false;
-							if (cascade == 3 && (iDelayedShadows % 5) != 0) bUpdateCascade[cascade] = false;
-							if (cascade == 2 && (iDelayedShadows % 4) != 0) bUpdateCascade[cascade] = false;
-							if (cascade == 1 && (iDelayedShadows % 3) != 0) bUpdateCascade[cascade] = false;
-							if (cascade == 0 && (iDelayedShadows % 2) != 0) bUpdateCascade[cascade] = false;
-						}
-						else if (g_bDelayedShadows)
+						for (uint32_t cascade = 0; cascade < CASCADE_COUNT; ++cascade)
 						{
-							if (cascade == 4 && (iDelayedShadows % 9) != 0) bUpdateCascade[cascade] = false;
-							if (cascade == 3 && (iDelayedShadows % 4) != 0) bUpdateCascade[cascade] = false;
-							if (cascade == 2 && (iDelayedShadows % 3) != 0) bUpdateCascade[cascade] = false;
-							if (cascade == 1 && (iDelayedShadows % 2) != 0) bUpdateCascade[cascade] = false;
+							bUpdateCascade[cascade] = true;
+							if (g_bDelayedShadowsLaptop)
+							{
+								if (cascade == 4 && (iDelayedShadows % 9) != 0) bUpdateCascade[cascade] = false;
+								if (cascade == 3 && (iDelayedShadows % 5) != 0) bUpdateCascade[cascade] = false;
+								if (cascade == 2 && (iDelayedShadows % 4) != 0) bUpdateCascade[cascade] = false;
+								if (cascade == 1 && (iDelayedShadows % 3) != 0) bUpdateCascade[cascade] = false;
+								if (cascade == 0 && (iDelayedShadows % 2) != 0) bUpdateCascade[cascade] = false;
+							}
+							else
+							{
+								if (cascade == 4 && (iDelayedShadows % 9) != 0) bUpdateCascade[cascade] = false;
+								if (cascade == 3 && (iDelayedShadows % 4) != 0) bUpdateCascade[cascade] = false;
+								if (cascade == 2 && (iDelayedShadows % 3) != 0) bUpdateCascade[cascade] = false;
+								if (cascade == 1 && (iDelayedShadows % 2) != 0) bUpdateCascade[cascade] = false;
+							}
 						}
 					}
-					#endif
-					#endif
-#ifdef GGREDUCED
-					#ifdef DELAYEDSHADOWS
 					//PE: Even out load.
 					if (bUpdateCascade[1] && bUpdateCascade[2] && bUpdateCascade[3])
 					{
@@ -4862,42 +6589,28 @@ void UpdateRenderData(
 						bUpdateCascade[3] = true;
 					}
 					#endif
-					for( uint32_t i = 0; i < CASCADE_COUNT; i++ )
+					#endif
+
+					// The matrices are taken from the cascade states, so the shadow map content and the lookup always use the same camera:
+					for (uint32_t cascade = 0; cascade < CASCADE_COUNT; ++cascade)
 					{
-						#ifdef DELAYEDSHADOWS
-						if (bUpdateCascade[i])
+						if (shadowSlice != ~0u)
 						{
-							restore_shcams[i] = shcams[i];
-							restore_campos[i] = vis.camera->GetEye();
-							matrixArray[matrixCounter++] = shcams[i].VP;
+							ShadowCascade& state = shadowCascades[shadowSlice + cascade];
+							UpdateShadowCascade(state, entity, shcams[cascade], bUpdateCascade[cascade], vis.camera->Eye);
+
+							// The casters are only culled against the camera for the cascades that are rendered in every frame anyway:
+							state.receivers_culled = shadowReceiverCulling && state.update == SHADOWCASCADE_UPDATE_FULL && shadowCascadeUpdateInterval[cascade] <= 1;
+#if defined(GGREDUCED) && defined(DELAYEDSHADOWS)
+							state.receivers_culled = state.receivers_culled && !g_bDelayedShadows;
+#endif
+							matrixArray[matrixCounter++] = XMLoadFloat4x4(&state.VP);
 						}
 						else
 						{
-							XMVECTOR vectorSub = XMVectorSubtract(vis.camera->GetEye(),restore_campos[i]);
-							XMVECTOR length = XMVector3LengthEst(vectorSub);
-
-							float Distance = 0.0f;
-							XMStoreFloat(&Distance, length);
-							if ( fabs(Distance) > 64)
-							{
-								//PE: To far from last center, update.
-								restore_shcams[i] = shcams[i];
-								restore_campos[i] = vis.camera->GetEye();
-								matrixArray[matrixCounter++] = shcams[i].VP;
-								bUpdateCascade[i] = true;
-							}
-							else
-								matrixArray[matrixCounter++] = restore_shcams[i].VP;
+							matrixArray[matrixCounter++] = shcams[cascade].VP;
 						}
-						#else
-						matrixArray[matrixCounter++] = shcams[i].VP;
-						#endif
 					}
-#else
-					matrixArray[matrixCounter++] = shcams[0].VP;
-					matrixArray[matrixCounter++] = shcams[1].VP;
-					matrixArray[matrixCounter++] = shcams[2].VP;
-#endif
 				}
 			}
 			break;
@@ -4971,9 +6684,9 @@ void UpdateRenderData(
 			entityCounter++;
 		}
 
-		// Issue GPU entity array update:
-		device->UpdateBuffer(&resourceBuffers[RBTYPE_ENTITYARRAY], entityArray, cmd, sizeof(ShaderEntity)*entityCounter);
-		device->UpdateBuffer(&resourceBuffers[RBTYPE_MATRIXARRAY], matrixArray, cmd, sizeof(XMMATRIX)*matrixCounter);
+		// Issue GPU entity array update, the entities of the static lights and probes are usually the same as in the previous frame:
+		UpdateBufferIncremental(resourceBuffers[RBTYPE_ENTITYARRAY], entityArray, entityCounter, entityArrayUploaded, cmd);
+		UpdateBufferIncremental(resourceBuffers[RBTYPE_MATRIXARRAY], matrixArray, matrixCounter, matrixArrayUploaded, cmd);
 
 		// Temporary array for GPU entities can be freed now:
 		GetRenderFrameAllocator(cmd).free(sizeof(ShaderEntity)*SHADER_ENTITY_COUNT);
@@ -4988,6 +6701,136 @@ void UpdateRenderData(
 		GPUBarrier* barriers_start = (GPUBarrier*)GetRenderFrameAllocator(cmd).top();
 		uint32_t numBarriers = 0;
 
+		// The deformed meshes that are visible in the main camera now are marked, the other passes are culled later and use their marks of the last frames:
+		const uint64_t frame = device->GetFrameCount();
+		for (uint32_t objectIndex : vis.visibleObjects)
+		{
+			const ObjectComponent& object = vis.scene->objects[objectIndex];
+			if (object.mesh_index < vis.scene->meshes.GetCount())
+			{
+				vis.scene->meshes[object.mesh_index].deform_drawn_frame.value.store(frame, std::memory_order_relaxed);
+			}
+		}
+		// The meshes that particles are emitted from or grown on are sampled even if they are not drawn:
+		for (size_t i = 0; i < vis.scene->emitters.GetCount(); ++i)
+		{
+			const MeshComponent* mesh = vis.scene->meshes.GetComponent(vis.scene->emitters[i].meshID);
+			if (mesh != nullptr)
+			{
+				mesh->deform_drawn_frame.value.store(frame, std::memory_order_relaxed);
+			}
+		}
+		for (size_t i = 0; i < vis.scene->hairs.GetCount(); ++i)
+		{
+			const MeshComponent* mesh = vis.scene->meshes.GetComponent(vis.scene->hairs[i].meshID);
+			if (mesh != nullptr)
+			{
+				mesh->deform_drawn_frame.value.store(frame, std::memory_order_relaxed);
+			}
+		}
+		// A mesh that is not drawn keeps its deformation pending (dirty morph weights are kept), it is computed again on the frame that it becomes visible:
+		const bool deform_culling = GetSkinningCullingEnabled() && !vis.scene->TLAS.IsValid();
+		auto IsDeformCulled = [&](const MeshComponent& mesh) {
+			return deform_culling && mesh.deform_valid && mesh.deform_drawn_frame.value.load(std::memory_order_relaxed) + SKINNING_CULLING_FRAMES < frame;
+		};
+
+		// Morph targets are applied on the GPU to the vertices that they move, so only the target weights are uploaded:
+		bool morphSetUp = false;
+		for (size_t i = 0; i < vis.scene->meshes.GetCount(); ++i)
+		{
+			const MeshComponent& mesh = vis.scene->meshes[i];
+			if (!mesh.dirty_morph || !mesh.morphVertexBuffer.IsValid() || IsDeformCulled(mesh))
+			{
+				continue;
+			}
+			mesh.dirty_morph = false;
+
+			if (!morphSetUp)
+			{
+				morphSetUp = true;
+				device->BindComputeShader(&shaders[CSTYPE_MORPH], cmd);
+			}
+
+			size_t tmp_alloc = sizeof(float) * mesh.targets.size();
+			float* weights = (float*)GetRenderFrameAllocator(cmd).allocate(tmp_alloc);
+			for (size_t j = 0; j < mesh.targets.size(); ++j)
+			{
+				weights[j] = mesh.targets[j].weight;
+			}
+			device->UpdateBuffer(&mesh.morphWeightBuffer, weights, cmd, (int)tmp_alloc);
+			GetRenderFrameAllocator(cmd).free(tmp_alloc);
+
+			const GPUResource* res[] = {
+				&mesh.morphVertexBuffer,
+				&mesh.morphDeltaBuffer,
+				&mesh.morphWeightBuffer,
+			};
+			const GPUResource* uavs[] = {
+				&mesh.vertexBuffer_POS,
+			};
+			device->BindResources(CS, res, MORPHSLOT_IN_VERTICES, arraysize(res), cmd);
+			device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+			device->Dispatch(((uint32_t)mesh.morph_vertices.size() + MORPH_COMPUTE_THREADCOUNT - 1) / MORPH_COMPUTE_THREADCOUNT, 1, 1, cmd);
+			mesh.deform_valid = true;
+		}
+		if (morphSetUp)
+		{
+			GPUBarrier barriers[] = {
+				GPUBarrier::Memory(),
+			};
+			device->Barrier(barriers, arraysize(barriers), cmd);
+
+			device->UnbindUAVs(0, 1, cmd);
+			device->UnbindResources(MORPHSLOT_IN_VERTICES, 3, cmd);
+		}
+
+		// Armatures with GPU bone transforms compute their skinning matrices first, one thread group per armature:
+		bool boneTransformsSetUp = false;
+		for (size_t i = 0; i < vis.scene->armatures.GetCount(); ++i)
+		{
+			const ArmatureComponent& armature = vis.scene->armatures[i];
+			if (!armature.gpu_bone_transforms)
+			{
+				continue;
+			}
+
+			if (!boneTransformsSetUp)
+			{
+				boneTransformsSetUp = true;
+				device->BindComputeShader(&shaders[CSTYPE_BONETRANSFORMS], cmd);
+			}
+
+			if (armature.boneStatics_dirty)
+			{
+				armature.boneStatics_dirty = false;
+				device->UpdateBuffer(&armature.boneStaticBuffer, armature.boneStatics.data(), cmd, (int)(sizeof(ShaderBoneStatic) * armature.boneStatics.size()));
+			}
+			device->UpdateBuffer(&armature.boneTransformBuffer, armature.boneTransforms.data(), cmd, (int)(sizeof(ShaderBoneTransform) * armature.boneTransforms.size()));
+
+			const GPUResource* res[] = {
+				&armature.boneTransformBuffer,
+				&armature.boneStaticBuffer,
+			};
+			const GPUResource* uavs[] = {
+				&armature.boneBuffer,
+			};
+			device->BindResources(CS, res, BONETRANSFORMSSLOT_IN_TRANSFORMS, arraysize(res), cmd);
+			device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+			device->Dispatch(1, 1, 1, cmd);
+		}
+		if (boneTransformsSetUp)
+		{
+			GPUBarrier barriers[] = {
+				GPUBarrier::Memory(),
+			};
+			device->Barrier(barriers, arraysize(barriers), cmd);
+
+			device->UnbindUAVs(0, 1, cmd);
+			device->UnbindResources(BONETRANSFORMSSLOT_IN_TRANSFORMS, 2, cmd);
+		}
+
 		for (size_t i = 0; i < vis.scene->meshes.GetCount(); ++i)
 		{
 			Entity entity = vis.scene->meshes.GetEntity(i);
@@ -5026,6 +6869,11 @@ void UpdateRenderData(
 				GetRenderFrameAllocator(cmd).free(tmp_alloc);
 			}
 
+			if (IsDeformCulled(mesh))
+			{
+				continue;
+			}
+
 			if (mesh.dirty_morph)
 			{
 				mesh.dirty_morph = false;
@@ -5087,8 +6935,19 @@ void UpdateRenderData(
 					device->BindComputeShader(&shaders[targetCS], cmd);
 				}
 
-				// Upload bones for skinning to shader
-				device->UpdateBuffer(&armature.boneBuffer, armature.boneData.data(), cmd, (int)(sizeof(ArmatureComponent::ShaderBoneType) * armature.boneData.size()));
+				// Upload bones for skinning to shader (unless they were computed on the GPU):
+				if (!armature.gpu_bone_transforms)
+				{
+					device->UpdateBuffer(&armature.boneBuffer, armature.boneData.data(), cmd, (int)(sizeof(ArmatureComponent::ShaderBoneType) * armature.boneData.size()));
+				}
+
+#ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
+				if (softbody != nullptr && softbody->IsGPUSimulation())
+				{
+					// The GPU cloth skins its vertices in the simulation, only the bones are needed:
+					continue;
+				}
+#endif
 
 				// Do the skinning
 				const GPUResource* vbs[] = {
@@ -5111,7 +6970,8 @@ void UpdateRenderData(
 				device->BindResources(CS, vbs, SKINNINGSLOT_IN_VERTEX_POS, arraysize(vbs), cmd);
 				device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
 
-				device->Dispatch(((uint32_t)mesh.vertex_positions.size() + SKINNING_COMPUTE_THREADCOUNT - 1) / SKINNING_COMPUTE_THREADCOUNT, 1, 1, cmd);
+				device->Dispatch(((uint32_t)mesh.GetVertexCount() + SKINNING_COMPUTE_THREADCOUNT - 1) / SKINNING_COMPUTE_THREADCOUNT, 1, 1, cmd);
+				mesh.deform_valid = true;
 #ifdef GGREDUCED
 				}
 #endif
@@ -5131,6 +6991,157 @@ void UpdateRenderData(
 			device->UnbindResources(SKINNINGSLOT_IN_VERTEX_POS, 4, cmd);
 		}
 
+#ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
+		// GPU cloth: the soft bodies are simulated by position based dynamics and written into the streamout buffers instead of the skinning
+		//	The pinned (zero weight) particles follow the skinned vertices, so the bones uploaded above are used
+		for (size_t i = 0; i < vis.scene->softbodies.GetCount(); ++i)
+		{
+			const SoftBodyPhysicsComponent& softbody = vis.scene->softbodies[i];
+			if (!softbody.IsGPUSimulation() || !softbody.clothParticleBuffer.IsValid())
+			{
+				continue;
+			}
+			Entity entity = vis.scene->softbodies.GetEntity(i);
+			const MeshComponent* mesh = vis.scene->meshes.GetComponent(entity);
+			if (mesh == nullptr || !mesh->streamoutBuffer_POS.IsValid() || IsDeformCulled(*mesh))
+			{
+				continue;
+			}
+			const ArmatureComponent* armature = mesh->IsSkinned() ? vis.scene->armatures.GetComponent(mesh->armatureID) : nullptr;
+
+			device->EventBegin("Cloth", cmd);
+
+			ClothCB cb = {};
+			cb.xClothWorld = softbody.worldMatrix;
+			// The wind is applied as an acceleration along its direction, gravity is the same as in the physics engine:
+			cb.xClothAcceleration = XMFLOAT3(vis.scene->weather.windDirection.x, vis.scene->weather.windDirection.y - 10, vis.scene->weather.windDirection.z);
+			cb.xClothDeltaTime = std::min(frameCB.g_xFrame_DeltaTime, 1.0f / 30.0f); // long frames are slowed down instead of destabilizing the solver
+			cb.xClothParticleCount = (uint32_t)softbody.physicsToGraphicsVertexMapping.size();
+			cb.xClothVertexCount = (uint32_t)softbody.graphicsToPhysicsVertexMapping.size();
+			cb.xClothOptions = 0;
+			if (armature != nullptr)
+			{
+				cb.xClothOptions |= CLOTH_OPTION_SKINNED;
+			}
+			if (softbody.cloth_reset)
+			{
+				softbody.cloth_reset = false;
+				cb.xClothOptions |= CLOTH_OPTION_RESET;
+			}
+			cb.xClothDamping = 0.99f;
+
+			// The bones are capsules that reach to their parent bone, the root bones are spheres:
+			if (armature != nullptr && softbody.colliderRadius > 0)
+			{
+				for (size_t b = 0; b < armature->boneCollection.size() && cb.xClothColliderCount < CLOTH_MAX_COLLIDERS; ++b)
+				{
+					const Entity bone = armature->boneCollection[b];
+					const TransformComponent* transform = vis.scene->transforms.GetComponent(bone);
+					if (transform == nullptr)
+					{
+						continue;
+					}
+					ShaderClothCollider& collider = cb.xClothColliders[cb.xClothColliderCount++];
+					collider.b = transform->GetPosition();
+					collider.a = collider.b;
+					collider.radius = softbody.colliderRadius;
+
+					const HierarchyComponent* hierarchy = vis.scene->hierarchy.GetComponent(bone);
+					if (hierarchy != nullptr && std::find(armature->boneCollection.begin(), armature->boneCollection.end(), hierarchy->parentID) != armature->boneCollection.end())
+					{
+						const TransformComponent* parent = vis.scene->transforms.GetComponent(hierarchy->parentID);
+						if (parent != nullptr)
+						{
+							collider.a = parent->GetPosition();
+						}
+					}
+				}
+			}
+
+			device->UpdateBuffer(&constantBuffers[CBTYPE_CLOTH], &cb, cmd);
+			device->BindConstantBuffer(CS, &constantBuffers[CBTYPE_CLOTH], CB_GETBINDSLOT(ClothCB), cmd);
+
+			const GPUResource* vbs[] = {
+				&mesh->vertexBuffer_POS,
+				&mesh->vertexBuffer_TAN,
+				armature == nullptr ? nullptr : &mesh->vertexBuffer_BON,
+				armature == nullptr ? nullptr : &armature->boneBuffer,
+			};
+			device->BindResources(CS, vbs, SKINNINGSLOT_IN_VERTEX_POS, arraysize(vbs), cmd);
+
+			const uint32_t particleGroups = (cb.xClothParticleCount + CLOTH_COMPUTE_THREADCOUNT - 1) / CLOTH_COMPUTE_THREADCOUNT;
+
+			// Integrate the particles from the positions of the previous frame:
+			{
+				device->BindComputeShader(&shaders[CSTYPE_CLOTH_INTEGRATE], cmd);
+				const GPUResource* uavs[] = {
+					&softbody.clothParticleBuffer,
+					&softbody.clothPositionBuffer[0],
+				};
+				device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+				device->Dispatch(particleGroups, 1, 1, cmd);
+
+				GPUBarrier barriers[] = {
+					GPUBarrier::Buffer(&softbody.clothParticleBuffer, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE),
+					GPUBarrier::Buffer(&softbody.clothPositionBuffer[0], BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE),
+				};
+				device->Barrier(barriers, arraysize(barriers), cmd);
+				device->UnbindUAVs(0, 2, cmd);
+			}
+
+			// Solve the constraints, every iteration reads one position buffer and writes the other:
+			device->BindComputeShader(&shaders[CSTYPE_CLOTH_SOLVE], cmd);
+			device->BindResource(CS, &softbody.clothParticleBuffer, CLOTHSLOT_IN_PARTICLES, cmd);
+			device->BindResource(CS, &softbody.clothConstraintBuffer, CLOTHSLOT_IN_CONSTRAINTS, cmd);
+			for (uint32_t iteration = 0; iteration < CLOTH_SOLVER_ITERATIONS; ++iteration)
+			{
+				const GPUBuffer& src = softbody.clothPositionBuffer[iteration % 2];
+				const GPUBuffer& dst = softbody.clothPositionBuffer[(iteration + 1) % 2];
+				if (iteration > 0)
+				{
+					GPUBarrier barriers[] = {
+						GPUBarrier::Buffer(&dst, BUFFER_STATE_SHADER_RESOURCE, BUFFER_STATE_UNORDERED_ACCESS),
+					};
+					device->Barrier(barriers, arraysize(barriers), cmd);
+				}
+				device->BindResource(CS, &src, CLOTHSLOT_IN_POSITIONS, cmd);
+				device->BindUAV(CS, &dst, 0, cmd);
+				device->Dispatch(particleGroups, 1, 1, cmd);
+
+				GPUBarrier barriers[] = {
+					GPUBarrier::Buffer(&dst, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE),
+				};
+				device->Barrier(barriers, arraysize(barriers), cmd);
+				device->UnbindUAVs(0, 1, cmd);
+			}
+
+			// Write the vertices, the last iteration wrote the first position buffer:
+			{
+				device->BindComputeShader(&shaders[CSTYPE_CLOTH_FINISH], cmd);
+				device->BindResource(CS, &softbody.clothRingBuffer, CLOTHSLOT_IN_RINGS, cmd);
+				device->BindResource(CS, &softbody.clothMappingBuffer, CLOTHSLOT_IN_MAPPING, cmd);
+				device->BindResource(CS, &softbody.clothPositionBuffer[0], CLOTHSLOT_IN_POSITIONS, cmd);
+				const GPUResource* uavs[] = {
+					&mesh->streamoutBuffer_POS,
+					&mesh->streamoutBuffer_TAN,
+				};
+				device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+				device->Dispatch((cb.xClothVertexCount + CLOTH_COMPUTE_THREADCOUNT - 1) / CLOTH_COMPUTE_THREADCOUNT, 1, 1, cmd);
+
+				GPUBarrier barriers[] = {
+					GPUBarrier::Buffer(&mesh->streamoutBuffer_POS, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE),
+					GPUBarrier::Buffer(&mesh->streamoutBuffer_TAN, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE),
+				};
+				device->Barrier(barriers, mesh->streamoutBuffer_TAN.IsValid() ? 2 : 1, cmd); // the mesh can be without tangents
+				device->UnbindUAVs(0, 2, cmd);
+			}
+			device->UnbindResources(SKINNINGSLOT_IN_VERTEX_POS, CLOTHSLOT_IN_PARTICLES - SKINNINGSLOT_IN_VERTEX_POS + 1, cmd);
+			mesh->deform_valid = true;
+
+			device->EventEnd(cmd);
+		}
+#endif
+
 	}
 	device->EventEnd(cmd);
 	wiProfiler::EndRange(range); // skinning
@@ -5141,6 +7152,10 @@ void UpdateRenderData(
 	{
 		Entity entity = vis.scene->softbodies.GetEntity(i);
 		const SoftBodyPhysicsComponent& softbody = vis.scene->softbodies[i];
+		if (softbody.IsGPUSimulation())
+		{
+			continue;
+		}
 
 		const MeshComponent* mesh = vis.scene->meshes.GetComponent(entity);
 		if (mesh != nullptr)
@@ -5151,27 +7166,6 @@ void UpdateRenderData(
 	}
 #endif
 
-	// GPU Particle systems simulation/sorting/culling:
-	if (!vis.visibleEmitters.empty())
-	{
-#ifdef GGREDUCED
-		range = wiProfiler::BeginRangeGPU("Particles - Simulate", cmd);
-#else
-		range = wiProfiler::BeginRangeGPU("EmittedParticles - Simulate", cmd);
-#endif
-		for (uint32_t emitterIndex : vis.visibleEmitters)
-		{
-			const wiEmittedParticle& emitter = vis.scene->emitters[emitterIndex];
-			Entity entity = vis.scene->emitters.GetEntity(emitterIndex);
-			const TransformComponent& transform = *vis.scene->transforms.GetComponent(entity);
-			const MaterialComponent& material = *vis.scene->materials.GetComponent(entity);
-			const MeshComponent* mesh = vis.scene->meshes.GetComponent(emitter.meshID);
-
-			emitter.UpdateGPU(transform, material, mesh, cmd);
-		}
-		wiProfiler::EndRange(range);
-	}
-
 	// Hair particle systems GPU simulation:
 	if (!vis.visibleHairs.empty())
 	{
@@ -5192,17 +7186,10 @@ void UpdateRenderData(
 		wiProfiler::EndRange(range);
 	}
 
-	// Compute water simulation:
-	if (vis.scene->weather.IsOceanEnabled())
-	{
-		range = wiProfiler::BeginRangeGPU("Ocean - Simulate", cmd);
-		vis.scene->ocean.UpdateDisplacementMap(vis.scene->weather.oceanParameters, cmd);
-		wiProfiler::EndRange(range);
-	}
-
 	if (vis.scene->weather.IsRealisticSky())
 	{
 		// Render Atmospheric Scattering textures for lighting and sky
+		SetAtmosphericScatteringInputs(frameCB, vis.camera->Eye);
 		RenderAtmosphericScatteringTextures(cmd);
 	}
 
@@ -5213,7 +7200,7 @@ void UpdateRenderData(
 		// Shape Noise pass:
 		{
 			device->EventBegin("Shape Noise", cmd);
-			device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_SHAPENOISE], cmd);
+			device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_SHAPENOISE), cmd);
 
 			const GPUResource* uavs[] = {
 				&texture_shapeNoise,
@@ -5240,7 +7227,7 @@ void UpdateRenderData(
 		// Detail Noise pass:
 	{
 			device->EventBegin("Detail Noise", cmd);
-			device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_DETAILNOISE], cmd);
+			device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_DETAILNOISE), cmd);
 
 			const GPUResource* uavs[] = {
 				&texture_detailNoise,
@@ -5278,7 +7265,7 @@ void UpdateRenderData(
 		// Curl Noise pass:
 		{
 			device->EventBegin("Curl Map", cmd);
-			device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_CURLNOISE], cmd);
+			device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_CURLNOISE), cmd);
 
 			const GPUResource* uavs[] = {
 				&texture_curlNoise,
@@ -5305,7 +7292,7 @@ void UpdateRenderData(
 		// Weather Map pass:
 	{
 			device->EventBegin("Weather Map", cmd);
-			device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_WEATHERMAP], cmd);
+			device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_WEATHERMAP), cmd);
 
 			const GPUResource* uavs[] = {
 				&texture_weatherMap,
@@ -5338,38 +7325,298 @@ void UpdateRenderData(
 		volumetric_clouds_precomputed = true;
 	}
 }
-void UpdateRaytracingAccelerationStructures(const Scene& scene, CommandList cmd)
+void UpdateRenderDataAsync(
+	const Visibility& vis,
+	CommandList cmd
+)
 {
-	if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_PIPELINE) || device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
-	{
+	// The command list can be on a different queue, so the common bindings and the camera are set up again:
+	BindCommonResources(cmd);
+	UpdateCameraCB(
+		*vis.camera,
+		*vis.camera,
+		*vis.camera,
+		cmd
+	);
 
-		if (!scene.TLAS.IsValid())
-			return;
+	wiProfiler::range_id range;
 
-		// BLAS:
+	// GPU Particle systems simulation/sorting/culling:
+	if (!vis.simulatedEmitters.empty())
+	{
+#ifdef GGREDUCED
+		range = wiProfiler::BeginRangeGPU("Particles - Simulate", cmd);
+#else
+		range = wiProfiler::BeginRangeGPU("EmittedParticles - Simulate", cmd);
+#endif
+		// The pooled emitters are simulated together, the others one by one:
+		wiEmittedParticle::UpdateGPU_Pooled(*vis.scene, vis.simulatedEmitters.data(), vis.simulatedEmitters.size(), cmd);
+
+		for (uint32_t emitterIndex : vis.simulatedEmitters)
+		{
+			const wiEmittedParticle& emitter = vis.scene->emitters[emitterIndex];
+			if (emitter.IsPooled())
+			{
+				continue;
+			}
+			Entity entity = vis.scene->emitters.GetEntity(emitterIndex);
+			const TransformComponent& transform = *vis.scene->transforms.GetComponent(entity);
+			const MaterialComponent& material = *vis.scene->materials.GetComponent(entity);
+			const MeshComponent* mesh = vis.scene->meshes.GetComponent(emitter.meshID);
+
+			emitter.UpdateGPU(transform, material, mesh, cmd);
+		}
+		wiProfiler::EndRange(range);
+	}
+
+	// Compute water simulation:
+	if (vis.scene->weather.IsOceanEnabled())
+	{
+		range = wiProfiler::BeginRangeGPU("Ocean - Simulate", cmd);
+		vis.scene->ocean.UpdateDisplacementMap(vis.scene->weather.oceanParameters, vis.oceanCoverage, cmd);
+		wiProfiler::EndRange(range);
+	}
+}
+uint32_t raytracingBLASBuildBudget = 1000000;
+void SetRaytracingBLASBuildBudget(uint32_t triangles)
+{
+	raytracingBLASBuildBudget = triangles;
+}
+uint32_t GetRaytracingBLASBuildBudget()
+{
+	return raytracingBLASBuildBudget;
+}
+bool raytracingBLASCompaction = true;
+void SetRaytracingBLASCompactionEnabled(bool value)
+{
+	raytracingBLASCompaction = value;
+}
+bool GetRaytracingBLASCompactionEnabled()
+{
+	return raytracingBLASCompaction;
+}
+// BLAS compaction:
+//	The compacted sizes of the built BLASes are copied to a readback buffer, which is read when the GPU has finished that frame
+//	Then the BLAS is copied into a compacted BLAS of that size, and the mesh is swapped to use the compacted BLAS
+struct BLASCompaction
+{
+	static constexpr uint32_t MAX_COUNT = 64; // per frame slot
+	struct Entry
+	{
+		Entity entity = INVALID_ENTITY;
+		RaytracingAccelerationStructure BLAS; // the BLAS that was queried, only swapped if the mesh still has it
+	};
+	GPUBuffer sizes;
+	GPUBuffer readback[GraphicsDevice::GetBufferCount()];
+	uint64_t readbackFrame[arraysize(readback)] = {};
+	std::vector<Entry> entries[arraysize(readback)];
+
+	bool IsPending(Entity entity) const
+	{
+		for (auto& x : entries)
+		{
+			for (auto& entry : x)
+			{
+				if (entry.entity == entity)
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+	void Cancel(Entity entity)
+	{
+		for (auto& x : entries)
+		{
+			for (auto& entry : x)
+			{
+				if (entry.entity == entity)
+				{
+					entry.entity = INVALID_ENTITY;
+				}
+			}
+		}
+	}
+};
+BLASCompaction blasCompaction;
+wiSpinLock blasCompactionLocker;
+
+static uint32_t GetBLASPrimitiveCount(const RaytracingAccelerationStructure& BLAS)
+{
+	uint32_t count = 0;
+	for (auto& x : BLAS.desc.bottomlevel.geometries)
+	{
+		count += x.type == RaytracingAccelerationStructureDesc::BottomLevel::Geometry::TRIANGLES ? x.triangles.indexCount / 3 : x.aabbs.count;
+	}
+	return count;
+}
+void UpdateRaytracingAccelerationStructures(const Scene& scene, CommandList cmd, const CameraComponent* camera)
+{
+	bool deferred = false;
+
+	if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_PIPELINE) || device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
+	{
+
+		if (!scene.TLAS.IsValid())
+			return;
+
+		bool BLAS_changed = false;
+
+		blasCompactionLocker.lock();
+
+		// BLAS compaction of the earlier frames (before the builds, so the builds of this frame can cancel the next queries):
+		if (raytracingBLASCompaction)
+		{
+			for (uint32_t slot = 0; slot < arraysize(blasCompaction.readback); ++slot)
+			{
+				auto& entries = blasCompaction.entries[slot];
+				if (entries.empty() || device->GetFrameCount() - blasCompaction.readbackFrame[slot] < device->GetBufferCount())
+				{
+					continue;
+				}
+
+				Mapping mapping;
+				mapping._flags = Mapping::FLAG_READ;
+				mapping.size = blasCompaction.readback[slot].GetDesc().ByteWidth;
+				device->Map(&blasCompaction.readback[slot], &mapping);
+				const uint64_t* sizes = (const uint64_t*)mapping.data;
+				if (sizes != nullptr)
+				{
+					for (size_t i = 0; i < entries.size(); ++i)
+					{
+						const BLASCompaction::Entry& entry = entries[i];
+						const MeshComponent* mesh = scene.meshes.GetComponent(entry.entity);
+						if (mesh == nullptr || mesh->BLAS.internal_state != entry.BLAS.internal_state || mesh->BLAS_state != MeshComponent::BLAS_STATE_COMPLETE)
+						{
+							continue;
+						}
+						RaytracingAccelerationStructure compacted;
+						if (sizes[i] > 0 && device->CreateRaytracingAccelerationStructureCompacted(&mesh->BLAS, sizes[i], &compacted))
+						{
+							device->SetName(&compacted, "BLAS (compacted)");
+							device->CompactRaytracingAccelerationStructure(&compacted, &mesh->BLAS, cmd);
+							mesh->BLAS = compacted; // the old BLAS is still used by the GPU this frame, its destruction is deferred by the device
+							mesh->BLAS_compacted = true;
+							BLAS_changed = true;
+						}
+						else
+						{
+							mesh->BLAS.desc._flags &= ~RaytracingAccelerationStructureDesc::FLAG_ALLOW_COMPACTION; // don't try again
+						}
+					}
+				}
+				device->Unmap(&blasCompaction.readback[slot]);
+				entries.clear();
+			}
+		}
+
+		// BLAS:
 		{
 			auto rangeCPU = wiProfiler::BeginRangeCPU("BLAS Update (CPU)");
 			auto range = wiProfiler::BeginRangeGPU("BLAS Update (GPU)", cmd);
 			device->EventBegin("BLAS Update", cmd);
 
+			// The BLASes that were not built yet are built right away, because the TLAS instances already reference them
+			//	The other rebuilds and refits are done in the order of camera distance until the primitive budget runs out,
+			//	the deferred ones keep their previous BLAS that is still valid to trace
+			struct Candidate
+			{
+				size_t index;
+				float priority;
+			};
+			static thread_local std::vector<Candidate> candidates;
+			static thread_local std::vector<float> distances;
+			candidates.clear();
+
+			auto build = [&](const MeshComponent& mesh, Entity entity) {
+				if (mesh.BLAS_compacted)
+				{
+					// The compacted BLAS can't be built again, so a complete one is created instead:
+					RaytracingAccelerationStructureDesc desc = mesh.BLAS.desc;
+					bool success = device->CreateRaytracingAccelerationStructure(&desc, &mesh.BLAS);
+					assert(success);
+					device->SetName(&mesh.BLAS, "BLAS");
+					mesh.BLAS_compacted = false;
+					mesh.BLAS_state = MeshComponent::BLAS_STATE_NEEDS_REBUILD;
+				}
+				switch (mesh.BLAS_state)
+				{
+				default:
+				case MeshComponent::BLAS_STATE_COMPLETE:
+					break;
+				case MeshComponent::BLAS_STATE_NEEDS_REBUILD:
+					device->BuildRaytracingAccelerationStructure(&mesh.BLAS, cmd, nullptr);
+					break;
+				case MeshComponent::BLAS_STATE_NEEDS_REFIT:
+					device->BuildRaytracingAccelerationStructure(&mesh.BLAS, cmd, &mesh.BLAS);
+					break;
+				}
+				mesh.BLAS_state = MeshComponent::BLAS_STATE_COMPLETE;
+				mesh.BLAS_built = true;
+				mesh.BLAS_build_delay = 0;
+				blasCompaction.Cancel(entity); // a queried size is not valid after the build
+				BLAS_changed = true;
+			};
+
 			for (size_t i = 0; i < scene.meshes.GetCount(); ++i)
 			{
 				const MeshComponent& mesh = scene.meshes[i];
-				if (mesh.BLAS.IsValid())
+				if (!mesh.BLAS.IsValid() || mesh.BLAS_state == MeshComponent::BLAS_STATE_COMPLETE)
+				{
+					continue;
+				}
+				if (!mesh.BLAS_built || camera == nullptr || raytracingBLASBuildBudget == 0)
+				{
+					build(mesh, scene.meshes.GetEntity(i));
+				}
+				else
+				{
+					candidates.push_back({ i, 0 });
+				}
+			}
+
+			if (!candidates.empty())
+			{
+				// The distance of a mesh is the distance of its closest instance:
+				distances.resize(scene.meshes.GetCount());
+				std::fill(distances.begin(), distances.end(), FLT_MAX);
+				const XMVECTOR eye = camera->GetEye();
+				for (size_t i = 0; i < scene.objects.GetCount() && i < scene.aabb_objects.GetCount(); ++i)
 				{
-					switch (mesh.BLAS_state)
+					const size_t meshIndex = scene.meshes.GetIndex(scene.objects[i].meshID);
+					if (meshIndex < distances.size())
 					{
-					default:
-					case MeshComponent::BLAS_STATE_COMPLETE:
-						break;
-					case MeshComponent::BLAS_STATE_NEEDS_REBUILD:
-						device->BuildRaytracingAccelerationStructure(&mesh.BLAS, cmd, nullptr);
-						break;
-					case MeshComponent::BLAS_STATE_NEEDS_REFIT:
-						device->BuildRaytracingAccelerationStructure(&mesh.BLAS, cmd, &mesh.BLAS);
-						break;
+						const AABB& aabb = scene.aabb_objects[i];
+						const XMFLOAT3 center = aabb.getCenter();
+						const float distance = std::max(0.0f, XMVectorGetX(XMVector3Length(XMLoadFloat3(&center) - eye)) - aabb.getRadius());
+						distances[meshIndex] = std::min(distances[meshIndex], distance);
+					}
+				}
+				for (auto& x : candidates)
+				{
+					// The waiting time raises the priority, so the distant meshes are not starved:
+					x.priority = distances[x.index] / float(1 + scene.meshes[x.index].BLAS_build_delay);
+				}
+				std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+					return a.priority < b.priority;
+				});
+
+				uint32_t budget = raytracingBLASBuildBudget;
+				for (size_t i = 0; i < candidates.size(); ++i)
+				{
+					const MeshComponent& mesh = scene.meshes[candidates[i].index];
+					const uint32_t cost = GetBLASPrimitiveCount(mesh.BLAS);
+					if (i == 0 || cost <= budget)
+					{
+						build(mesh, scene.meshes.GetEntity(candidates[i].index));
+						budget -= std::min(budget, cost);
+					}
+					else
+					{
+						mesh.BLAS_build_delay++;
+						deferred = true;
 					}
-					mesh.BLAS_state = MeshComponent::BLAS_STATE_COMPLETE;
 				}
 			}
 
@@ -5380,29 +7627,108 @@ void UpdateRaytracingAccelerationStructures(const Scene& scene, CommandList cmd)
 				device->Barrier(barriers, arraysize(barriers), cmd);
 			}
 
+			// Query the compacted sizes of the built static BLASes:
+			if (raytracingBLASCompaction)
+			{
+				uint32_t slot = ~0u;
+				for (uint32_t i = 0; i < arraysize(blasCompaction.readback); ++i)
+				{
+					if (blasCompaction.entries[i].empty())
+					{
+						slot = i;
+						break;
+					}
+				}
+				if (slot < arraysize(blasCompaction.readback))
+				{
+					auto& entries = blasCompaction.entries[slot];
+					for (size_t i = 0; i < scene.meshes.GetCount() && entries.size() < BLASCompaction::MAX_COUNT; ++i)
+					{
+						const MeshComponent& mesh = scene.meshes[i];
+						const Entity entity = scene.meshes.GetEntity(i);
+						if (mesh.BLAS.IsValid() &&
+							mesh.BLAS_built &&
+							!mesh.BLAS_compacted &&
+							mesh.BLAS_state == MeshComponent::BLAS_STATE_COMPLETE &&
+							(mesh.BLAS.desc._flags & RaytracingAccelerationStructureDesc::FLAG_ALLOW_COMPACTION) &&
+							!blasCompaction.IsPending(entity))
+						{
+							entries.push_back({ entity, mesh.BLAS });
+						}
+					}
+
+					if (!entries.empty())
+					{
+						if (!blasCompaction.sizes.IsValid())
+						{
+							GPUBufferDesc desc;
+							desc.ByteWidth = sizeof(uint64_t) * BLASCompaction::MAX_COUNT;
+							desc.BindFlags = BIND_UNORDERED_ACCESS;
+							desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+							device->CreateBuffer(&desc, nullptr, &blasCompaction.sizes);
+							device->SetName(&blasCompaction.sizes, "blasCompaction.sizes");
+
+							desc.Usage = USAGE_STAGING;
+							desc.CPUAccessFlags = CPU_ACCESS_READ;
+							desc.BindFlags = 0;
+							desc.MiscFlags = 0;
+							for (auto& x : blasCompaction.readback)
+							{
+								device->CreateBuffer(&desc, nullptr, &x);
+								device->SetName(&x, "blasCompaction.readback");
+							}
+						}
+
+						for (size_t i = 0; i < entries.size(); ++i)
+						{
+							device->WriteRaytracingAccelerationStructureCompactedSize(&entries[i].BLAS, &blasCompaction.sizes, i * sizeof(uint64_t), cmd);
+						}
+						{
+							GPUBarrier barriers[] = {
+								GPUBarrier::Memory(),
+								GPUBarrier::Buffer(&blasCompaction.sizes, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_COPY_SRC),
+							};
+							device->Barrier(barriers, arraysize(barriers), cmd);
+						}
+						device->CopyResource(&blasCompaction.readback[slot], &blasCompaction.sizes, cmd);
+						{
+							GPUBarrier barriers[] = {
+								GPUBarrier::Buffer(&blasCompaction.sizes, BUFFER_STATE_COPY_SRC, BUFFER_STATE_UNORDERED_ACCESS),
+							};
+							device->Barrier(barriers, arraysize(barriers), cmd);
+						}
+						blasCompaction.readbackFrame[slot] = device->GetFrameCount();
+					}
+				}
+			}
+
 			device->EventEnd(cmd);
 			wiProfiler::EndRange(range);
 			wiProfiler::EndRange(rangeCPU);
 		}
 
+		blasCompactionLocker.unlock();
+
 		// TLAS:
+		//	The instances are only written by the scene if they changed, so a static scene doesn't need to rebuild it
+		if (scene.TLAS_instances_changed.exchange(false) || BLAS_changed)
 		{
 			auto rangeCPU = wiProfiler::BeginRangeCPU("TLAS Update (CPU)");
 			auto range = wiProfiler::BeginRangeGPU("TLAS Update (GPU)", cmd);
 			device->EventBegin("TLAS Update", cmd);
 
 			device->UpdateBuffer(&scene.TLAS.desc.toplevel.instanceBuffer, scene.TLAS_instances.data(), cmd);
-	device->BuildRaytracingAccelerationStructure(&scene.TLAS, cmd, nullptr);
+			device->BuildRaytracingAccelerationStructure(&scene.TLAS, cmd, nullptr);
 
 			{
-	GPUBarrier barriers[] = {
-		GPUBarrier::Memory(&scene.TLAS),
-	};
-	device->Barrier(barriers, arraysize(barriers), cmd);
+				GPUBarrier barriers[] = {
+					GPUBarrier::Memory(&scene.TLAS),
+				};
+				device->Barrier(barriers, arraysize(barriers), cmd);
 			}
 
-	device->EventEnd(cmd);
-	wiProfiler::EndRange(range);
+			device->EventEnd(cmd);
+			wiProfiler::EndRange(range);
 			wiProfiler::EndRange(rangeCPU);
 		}
 	}
@@ -5411,12 +7737,13 @@ void UpdateRaytracingAccelerationStructures(const Scene& scene, CommandList cmd)
 		scene.BVH.Build(scene, cmd);
 	}
 
-	scene.acceleration_structure_update_requested = false;
+	// The deferred BLAS rebuilds are continued in the next frame:
+	scene.acceleration_structure_update_requested = deferred;
 }
 //#pragma optimize("", off)
 void OcclusionCulling_Render(const CameraComponent& camera_previous, const Visibility& vis, CommandList cmd)
 {
-	if (!GetOcclusionCullingEnabled() || GetFreezeCullingCameraEnabled())
+	if (!GetOcclusionCullingEnabled() || GetFreezeCullingCameraEnabled() || GetOcclusionCullingHiZEnabled())
 	{
 		return;
 	}
@@ -5510,7 +7837,7 @@ void OcclusionCulling_Render(const CameraComponent& camera_previous, const Visib
 #ifdef GGREDUCED
 		TerrainChunkOcclusion* pTCO;
 		uint32_t lodstart = GGTerrain::GetChunkLodStart();
-		if (bEnableTerrainChunkCulling)
+		if (bEnableTerrainChunkCulling && !terrainChunkGPUCulling)
 		{
 			for (int lod = lodstart; lod < 9; lod++)
 			{
@@ -5649,6 +7976,96 @@ void OcclusionCulling_Render(const CameraComponent& camera_previous, const Visib
 
 	wiProfiler::EndRange(range); // Occlusion Culling Render
 }
+void OcclusionCulling_HiZReadback(const CameraComponent& camera, const Texture& lineardepth, CommandList cmd)
+{
+	if (!GetOcclusionCullingEnabled() || !GetOcclusionCullingHiZEnabled() || GetFreezeCullingCameraEnabled())
+	{
+		return;
+	}
+
+	// Only the first camera of the frame is read back (for example the left eye in VR):
+	const uint64_t frame = device->GetFrameCount();
+	const uint32_t slot = uint32_t(frame % arraysize(occlusionHiZ.readback));
+	if (occlusionHiZ.readbackValid[slot] && occlusionHiZ.readbackFrame[slot] == frame)
+	{
+		return;
+	}
+
+	device->EventBegin("OcclusionCulling_HiZReadback", cmd);
+	auto range = wiProfiler::BeginRangeGPU("Occlusion Culling Hi-Z", cmd);
+
+	if (!occlusionHiZ.grid.IsValid())
+	{
+		GPUBufferDesc desc;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		desc.ByteWidth = OCCLUSIONCULLING_HIZ_WIDTH * OCCLUSIONCULLING_HIZ_HEIGHT * sizeof(float);
+		device->CreateBuffer(&desc, nullptr, &occlusionHiZ.grid);
+		device->SetName(&occlusionHiZ.grid, "occlusionHiZ.grid");
+
+		desc.Usage = USAGE_STAGING;
+		desc.CPUAccessFlags = CPU_ACCESS_READ;
+		desc.BindFlags = 0;
+		desc.MiscFlags = 0;
+		for (int i = 0; i < arraysize(occlusionHiZ.readback); ++i)
+		{
+			device->CreateBuffer(&desc, nullptr, &occlusionHiZ.readback[i]);
+			device->SetName(&occlusionHiZ.readback[i], "occlusionHiZ.readback");
+		}
+	}
+
+	device->BindComputeShader(&shaders[CSTYPE_OCCLUSIONCULLING_HIZ], cmd);
+	device->BindResource(CS, &lineardepth, OCCLUSIONCULLINGSLOT_IN_LINEARDEPTH, cmd);
+	const GPUResource* uavs[] = {
+		&occlusionHiZ.grid,
+	};
+	device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+	{
+		GPUBarrier barriers[] = {
+			GPUBarrier::Buffer(&occlusionHiZ.grid, BUFFER_STATE_SHADER_RESOURCE, BUFFER_STATE_UNORDERED_ACCESS),
+		};
+		device->Barrier(barriers, arraysize(barriers), cmd);
+	}
+
+	device->Dispatch(
+		(OCCLUSIONCULLING_HIZ_WIDTH + OCCLUSIONCULLING_HIZ_BLOCKSIZE - 1) / OCCLUSIONCULLING_HIZ_BLOCKSIZE,
+		(OCCLUSIONCULLING_HIZ_HEIGHT + OCCLUSIONCULLING_HIZ_BLOCKSIZE - 1) / OCCLUSIONCULLING_HIZ_BLOCKSIZE,
+		1,
+		cmd
+	);
+
+	{
+		GPUBarrier barriers[] = {
+			GPUBarrier::Memory(),
+			GPUBarrier::Buffer(&occlusionHiZ.grid, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_COPY_SRC),
+		};
+		device->Barrier(barriers, arraysize(barriers), cmd);
+	}
+
+	device->UnbindUAVs(0, arraysize(uavs), cmd);
+	device->UnbindResources(OCCLUSIONCULLINGSLOT_IN_LINEARDEPTH, 1, cmd);
+
+	device->CopyResource(&occlusionHiZ.readback[slot], &occlusionHiZ.grid, cmd);
+
+	{
+		GPUBarrier barriers[] = {
+			GPUBarrier::Buffer(&occlusionHiZ.grid, BUFFER_STATE_COPY_SRC, BUFFER_STATE_SHADER_RESOURCE),
+		};
+		device->Barrier(barriers, arraysize(barriers), cmd);
+	}
+
+	// The camera is saved to reproject the grid when it is read back:
+	occlusionHiZ.readbackValid[slot] = true;
+	occlusionHiZ.readbackFrame[slot] = frame;
+	occlusionHiZ.readbackInvView[slot] = camera.InvView;
+	occlusionHiZ.readbackInvProjection[slot] = camera.InvProjection;
+	occlusionHiZ.readbackZFar[slot] = camera.zFarP;
+
+	wiProfiler::EndRange(range);
+	device->EventEnd(cmd);
+}
 //#pragma optimize("", on)
 void DrawWaterRipples(const Visibility& vis, CommandList cmd)
 {
@@ -5717,7 +8134,7 @@ void DrawSoftParticles(
 		{
 			emitter.Draw(*vis.camera, material, cmd);
 		}
-		else if (!distortion && (emitter.shaderType == wiEmittedParticle::SOFT || emitter.shaderType == wiEmittedParticle::SOFT_LIGHTING || emitter.shaderType == wiEmittedParticle::SIMPLE || IsWireRender()))
+		else if (!distortion && (emitter.shaderType == wiEmittedParticle::SOFT || emitter.shaderType == wiEmittedParticle::SOFT_LIGHTING || emitter.shaderType == wiEmittedParticle::SIMPLE || IsWireRender() || overdrawRender[cmd]))
 		{
 			emitter.Draw(*vis.camera, material, cmd);
 		}
@@ -5727,36 +8144,118 @@ void DrawSoftParticles(
 
 	wiProfiler::EndRange(range);
 }
-void DrawLightVisualizers(
+void DrawOverdraw(
 	const Visibility& vis,
-	CommandList cmd
+	const RenderPass& renderpass,
+	const Texture& output,
+	CommandList cmd,
+	float maxOverdraw
 )
 {
-	if (!vis.visibleLights.empty())
-	{
-		device->EventBegin("Light Visualizer Render", cmd);
+	device->EventBegin("DrawOverdraw", cmd);
+	auto range = wiProfiler::BeginRangeGPU("Overdraw Visualizer", cmd);
 
-		device->BindConstantBuffer(PS, &constantBuffers[CBTYPE_VOLUMELIGHT], CB_GETBINDSLOT(VolumeLightCB), cmd);
-		device->BindConstantBuffer(VS, &constantBuffers[CBTYPE_VOLUMELIGHT], CB_GETBINDSLOT(VolumeLightCB), cmd);
+	const Texture& overdraw = *renderpass.desc.attachments[0].texture;
 
-		XMMATRIX camrot = XMLoadFloat3x3(&vis.camera->rotationMatrix);
-		XMMATRIX VP = vis.camera->GetViewProjection();
+	overdrawRender[cmd] = true;
+	device->RenderPassBegin(&renderpass, cmd);
 
-		for (int type = LightComponent::POINT; type < LightComponent::LIGHTTYPE_COUNT; ++type)
-		{
-			device->BindPipelineState(&PSO_lightvisualizer[type], cmd);
+	Viewport vp;
+	vp.Width = (float)overdraw.desc.Width;
+	vp.Height = (float)overdraw.desc.Height;
+	device->BindViewports(1, &vp, cmd);
 
-			for (auto visibleLight : vis.visibleLights)
-			{
-				uint16_t lightIndex = visibleLight.index;
-				const LightComponent& light = vis.scene->lights[lightIndex];
+	DrawScene(vis, RENDERPASS_MAIN, cmd, DRAWSCENE_OPAQUE | DRAWSCENE_TRANSPARENT | DRAWSCENE_HAIRPARTICLE);
 
-				if (light.GetType() == type && light.IsVisualizerEnabled())
-				{
+	for (uint32_t emitterIndex : vis.visibleEmitters)
+	{
+		const wiEmittedParticle& emitter = vis.scene->emitters[emitterIndex];
+		const Entity entity = vis.scene->emitters.GetEntity(emitterIndex);
+		const MaterialComponent& material = *vis.scene->materials.GetComponent(entity);
+		emitter.Draw(*vis.camera, material, cmd);
+	}
 
-					VolumeLightCB lcb;
-					lcb.lightColor = XMFLOAT4(light.color.x, light.color.y, light.color.z, 1);
-					lcb.lightEnerdis = XMFLOAT4(light.energy, light.GetRange(), light.fov, light.energy);
+	device->RenderPassEnd(cmd);
+	overdrawRender[cmd] = false;
+
+	// Heatmap:
+	device->BindComputeShader(&shaders[CSTYPE_OVERDRAW_HEATMAP], cmd);
+
+	device->BindResource(CS, &overdraw, TEXSLOT_ONDEMAND0, cmd);
+
+	const TextureDesc& desc = output.GetDesc();
+
+	PostProcessCB cb;
+	cb.xPPResolution.x = desc.Width;
+	cb.xPPResolution.y = desc.Height;
+	cb.xPPResolution_rcp.x = 1.0f / cb.xPPResolution.x;
+	cb.xPPResolution_rcp.y = 1.0f / cb.xPPResolution.y;
+	cb.xPPParams0.x = maxOverdraw;
+	device->UpdateBuffer(&constantBuffers[CBTYPE_POSTPROCESS], &cb, cmd);
+	device->BindConstantBuffer(CS, &constantBuffers[CBTYPE_POSTPROCESS], CB_GETBINDSLOT(PostProcessCB), cmd);
+
+	const GPUResource* uavs[] = {
+		&output,
+	};
+	device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+	{
+		GPUBarrier barriers[] = {
+			GPUBarrier::Image(&output, output.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+		};
+		device->Barrier(barriers, arraysize(barriers), cmd);
+	}
+
+	device->Dispatch(
+		(desc.Width + POSTPROCESS_BLOCKSIZE - 1) / POSTPROCESS_BLOCKSIZE,
+		(desc.Height + POSTPROCESS_BLOCKSIZE - 1) / POSTPROCESS_BLOCKSIZE,
+		1,
+		cmd
+	);
+
+	{
+		GPUBarrier barriers[] = {
+			GPUBarrier::Memory(),
+			GPUBarrier::Image(&output, IMAGE_LAYOUT_UNORDERED_ACCESS, output.desc.layout),
+		};
+		device->Barrier(barriers, arraysize(barriers), cmd);
+	}
+
+	device->UnbindUAVs(0, arraysize(uavs), cmd);
+
+	wiProfiler::EndRange(range);
+	device->EventEnd(cmd);
+}
+void DrawLightVisualizers(
+	const Visibility& vis,
+	CommandList cmd
+)
+{
+	if (!vis.visibleLights.empty())
+	{
+		device->EventBegin("Light Visualizer Render", cmd);
+
+		device->BindConstantBuffer(PS, &constantBuffers[CBTYPE_VOLUMELIGHT], CB_GETBINDSLOT(VolumeLightCB), cmd);
+		device->BindConstantBuffer(VS, &constantBuffers[CBTYPE_VOLUMELIGHT], CB_GETBINDSLOT(VolumeLightCB), cmd);
+
+		XMMATRIX camrot = XMLoadFloat3x3(&vis.camera->rotationMatrix);
+		XMMATRIX VP = vis.camera->GetViewProjection();
+
+		for (int type = LightComponent::POINT; type < LightComponent::LIGHTTYPE_COUNT; ++type)
+		{
+			device->BindPipelineState(&PSO_lightvisualizer[type], cmd);
+
+			for (auto visibleLight : vis.visibleLights)
+			{
+				uint16_t lightIndex = visibleLight.index;
+				const LightComponent& light = vis.scene->lights[lightIndex];
+
+				if (light.GetType() == type && light.IsVisualizerEnabled())
+				{
+
+					VolumeLightCB lcb;
+					lcb.lightColor = XMFLOAT4(light.color.x, light.color.y, light.color.z, 1);
+					lcb.lightEnerdis = XMFLOAT4(light.energy, light.GetRange(), light.fov, light.energy);
 
 					if (type == LightComponent::POINT)
 					{
@@ -5982,6 +8481,136 @@ void DrawLensFlares(
 }
 
 
+// Shadow caching of spot and point lights:
+//	The casters that stood still for a while are rendered into a persistent slot of the light, which is copied into the shadow map of the frame before the moving casters are drawn on top
+//	A slot is rendered again when the light moved or the set of its static casters changed, the least recently used slot is reassigned to a new light
+struct ShadowCache
+{
+	struct Slot
+	{
+		Entity light = INVALID_ENTITY;
+		size_t hash = 0; // the light and the static casters that the slot was rendered with
+		uint64_t frame = 0; // the last frame that used the slot
+	};
+	Texture texture;
+	std::vector<Slot> slots;
+	std::vector<RenderPass> renderpasses;
+	uint32_t faces = 1;
+
+	// Returns the slot of the light, it must be rendered again if valid is false
+	uint32_t Acquire(Entity light, size_t hash, uint64_t frame, bool& valid)
+	{
+		assert(!slots.empty());
+		uint32_t result = 0;
+		for (uint32_t i = 0; i < (uint32_t)slots.size(); ++i)
+		{
+			if (slots[i].light == light)
+			{
+				result = i;
+				break;
+			}
+			if (slots[i].frame < slots[result].frame)
+			{
+				result = i;
+			}
+		}
+		Slot& slot = slots[result];
+		valid = slot.light == light && slot.hash == hash;
+		slot.light = light;
+		slot.hash = hash;
+		slot.frame = frame;
+		return result;
+	}
+};
+ShadowCache shadowCache_Spot_2D;
+ShadowCache shadowCache_Cube;
+static const uint32_t SHADOWCACHE_STATIC_FRAMES = 60; // the number of frames that a caster must stand still to be cached
+
+// Creates the cache with one slot for every shadow map of the array, or releases it if shadow caching is disabled
+static void CreateShadowCache(ShadowCache& cache, uint32_t resolution, uint32_t count, uint32_t faces, const char* name)
+{
+	cache = ShadowCache();
+
+	// The copy selects the faces by the render target array index from the vertex shader:
+	if (!GetShadowCachingEnabled() || resolution == 0 || count == 0 || !device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RENDERTARGET_AND_VIEWPORT_ARRAYINDEX_WITHOUT_GS))
+	{
+		return;
+	}
+
+	TextureDesc desc;
+	desc.Width = resolution;
+	desc.Height = resolution;
+	desc.MipLevels = 1;
+	desc.ArraySize = count * faces;
+	desc.SampleCount = 1;
+	desc.Usage = USAGE_DEFAULT;
+	desc.BindFlags = BIND_DEPTH_STENCIL | BIND_SHADER_RESOURCE;
+	desc.Format = FORMAT_R32_TYPELESS;
+	desc.layout = IMAGE_LAYOUT_SHADER_RESOURCE;
+	device->CreateTexture(&desc, nullptr, &cache.texture);
+	device->SetName(&cache.texture, name);
+
+	cache.faces = faces;
+	cache.slots.resize(count);
+	cache.renderpasses.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		int subresource_index;
+		subresource_index = device->CreateSubresource(&cache.texture, DSV, i * faces, faces, 0, 1);
+		assert(subresource_index == i);
+		subresource_index = device->CreateSubresource(&cache.texture, SRV, i * faces, faces, 0, 1);
+		assert(subresource_index == i);
+
+		RenderPassDesc renderpassdesc;
+		renderpassdesc.attachments.push_back(
+			RenderPassAttachment::DepthStencil(
+				&cache.texture,
+				RenderPassAttachment::LOADOP_CLEAR,
+				RenderPassAttachment::STOREOP_STORE,
+				IMAGE_LAYOUT_SHADER_RESOURCE,
+				IMAGE_LAYOUT_DEPTHSTENCIL,
+				IMAGE_LAYOUT_SHADER_RESOURCE
+			)
+		);
+		renderpassdesc.attachments.back().subresource = subresource_index;
+		device->CreateRenderPass(&renderpassdesc, &cache.renderpasses[i]);
+	}
+}
+
+// Writes the depth of faces source slices into the bound depth render pass, starting from sourceSlice of the source subresource
+//	The source texel is read from the pixel position minus the offset, the texels that fall outside of the source are written as cleared
+//	depthOffset is added to the depth that is not cleared
+static void CopyShadowDepth(const Texture& source, int subresource, uint32_t sourceSlice, uint32_t faces, int offsetX, int offsetY, float depthOffset, CommandList cmd)
+{
+	device->BindPipelineState(&PSO_shadowcache_copy, cmd);
+
+	MiscCB cb;
+	cb.g_xColor = XMFLOAT4((float)offsetX, (float)offsetY, (float)sourceSlice, depthOffset);
+	device->UpdateBuffer(&constantBuffers[CBTYPE_MISC], &cb, cmd);
+	device->BindConstantBuffer(PS, &constantBuffers[CBTYPE_MISC], CB_GETBINDSLOT(MiscCB), cmd);
+
+	device->BindResource(PS, &source, TEXSLOT_ONDEMAND0, cmd, subresource);
+	device->DrawInstanced(3, faces, 0, 0, cmd);
+	device->UnbindResources(TEXSLOT_ONDEMAND0, 1, cmd);
+}
+
+// Writes the depth of the cached slot into every face of the current shadow map render pass
+//	The offset is the top left corner of the bound viewport, the cache slot is always rendered from its top left corner
+static void CopyShadowCache(const ShadowCache& cache, uint32_t slot, uint32_t offsetX, uint32_t offsetY, CommandList cmd)
+{
+	device->EventBegin("CopyShadowCache", cmd);
+	CopyShadowDepth(cache.texture, (int)slot, 0, cache.faces, (int)offsetX, (int)offsetY, 0, cmd);
+	device->EventEnd(cmd);
+}
+
+// Only the depth of opaque casters is cached, the transparent shadow colors are rendered every frame
+static bool IsStaticShadowCaster(const ObjectComponent& object)
+{
+	return !object.IsDynamic() &&
+		object.cached_frames >= SHADOWCACHE_STATIC_FRAMES &&
+		!(object.GetRenderTypes() & (RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER));
+}
+
 void SetShadowProps2D(int resolution, int count)
 {
 	if (resolution >= 0)
@@ -6028,6 +8657,7 @@ void SetShadowProps2D(int resolution, int count)
 #endif
 
 		renderpasses_shadow2D.resize(SHADOWCOUNT_2D);
+		renderpasses_shadow2D_load.resize(SHADOWCOUNT_2D);
 
 		for (uint32_t i = 0; i < SHADOWCOUNT_2D; ++i)
 		{
@@ -6075,9 +8705,45 @@ void SetShadowProps2D(int resolution, int count)
 #endif
 
 			device->CreateRenderPass(&renderpassdesc, &renderpasses_shadow2D[subresource_index]);
+
+			// Scrolled cascades keep their depth, they are only used when there are no transparent shadows:
+			renderpassdesc.attachments.resize(1);
+			renderpassdesc.attachments.back().loadop = RenderPassAttachment::LOADOP_LOAD;
+			device->CreateRenderPass(&renderpassdesc, &renderpasses_shadow2D_load[subresource_index]);
+		}
+
+		// The scrolling copy selects the slice by the render target array index from the vertex shader:
+		shadowMapScroll_2D = Texture();
+		if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RENDERTARGET_AND_VIEWPORT_ARRAYINDEX_WITHOUT_GS))
+		{
+			desc.ArraySize = 1;
+			desc.BindFlags = BIND_DEPTH_STENCIL | BIND_SHADER_RESOURCE;
+			desc.Format = FORMAT_R32_TYPELESS;
+			desc.layout = IMAGE_LAYOUT_SHADER_RESOURCE;
+			desc.Width = SHADOWRES_2D;
+			desc.Height = SHADOWRES_2D;
+			device->CreateTexture(&desc, nullptr, &shadowMapScroll_2D);
+			device->SetName(&shadowMapScroll_2D, "shadowMapScroll_2D");
+
+			RenderPassDesc renderpassdesc;
+			renderpassdesc.attachments.push_back(
+				RenderPassAttachment::DepthStencil(
+					&shadowMapScroll_2D,
+					RenderPassAttachment::LOADOP_CLEAR,
+					RenderPassAttachment::STOREOP_STORE,
+					IMAGE_LAYOUT_SHADER_RESOURCE,
+					IMAGE_LAYOUT_DEPTHSTENCIL,
+					IMAGE_LAYOUT_SHADER_RESOURCE
+				)
+			);
+			device->CreateRenderPass(&renderpassdesc, &renderpass_shadowScroll_2D);
 		}
 	}
 
+	// The new shadow maps have no content that could be kept:
+	shadowCascades.clear();
+	shadowCascades.resize(SHADOWCOUNT_2D);
+
 }
 
 void SetShadowPropsSpot2D(int resolution, int count)
@@ -6125,6 +8791,7 @@ void SetShadowPropsSpot2D(int resolution, int count)
 #endif
 
 		renderpasses_spot_shadow2D.resize(SHADOWCOUNT_SPOT_2D);
+		renderpasses_spot_shadow2D_load.resize(SHADOWCOUNT_SPOT_2D);
 
 		for (uint32_t i = 0; i < SHADOWCOUNT_SPOT_2D; ++i)
 		{
@@ -6171,9 +8838,16 @@ void SetShadowPropsSpot2D(int resolution, int count)
 #endif
 
 			device->CreateRenderPass(&renderpassdesc, &renderpasses_spot_shadow2D[subresource_index]);
+
+			for (auto& attachment : renderpassdesc.attachments)
+			{
+				attachment.loadop = RenderPassAttachment::LOADOP_LOAD;
+			}
+			device->CreateRenderPass(&renderpassdesc, &renderpasses_spot_shadow2D_load[subresource_index]);
 		}
 	}
 
+	CreateShadowCache(shadowCache_Spot_2D, SHADOWRES_SPOT_2D, SHADOWCOUNT_SPOT_2D, 1, "shadowCache_Spot_2D");
 }
 
 void SetShadowPropsCube(int resolution, int count)
@@ -6269,7 +8943,232 @@ void SetShadowPropsCube(int resolution, int count)
 		}
 	}
 
+	CreateShadowCache(shadowCache_Cube, SHADOWRES_CUBE, SHADOWCOUNT_CUBE, 6, "shadowCache_Cube");
+}
+
+// Renders the casters of a directional light cascade that intersect the frustum, into the render pass that was begun
+//	The frustum can be a part of the cascade camera, then only the casters inside it are gathered
+// The shadow of a caster can only be seen when the volume that its box sweeps along the light rays intersects the camera frustum:
+//	the volume is the convex hull of the box corners and of their swept ends, it is outside of a plane when all of those are
+//	The directional sweep length is the distance that covers the camera frustum from anywhere in the box
+struct ShadowReceiverVolume
+{
+	Frustum frustum;
+	XMFLOAT3 eye;
+	float reach = 0; // farthest frustum corner from the eye
+
+	ShadowReceiverVolume(const CameraComponent& camera) : frustum(camera.frustum), eye(camera.Eye)
+	{
+		const XMMATRIX inverseViewProjection = camera.GetInvViewProjection();
+		const XMVECTOR E = XMLoadFloat3(&eye);
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			const XMVECTOR ndc = XMVectorSet(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : 0.0f, 1);
+			reach = std::max(reach, XMVectorGetX(XMVector3Length(XMVector3TransformCoord(ndc, inverseViewProjection) - E)));
+		}
+	}
+
+	// Directional light, the direction is where the light rays go
+	bool IsShadowCulled(const AABB& aabb, const XMVECTOR& direction) const
+	{
+		const float length = wiMath::Distance(aabb.getCenter(), eye) + aabb.getRadius() + reach;
+		const XMVECTOR sweep = direction * length;
+		XMVECTOR points[16];
+		for (int i = 0; i < 8; ++i)
+		{
+			const XMFLOAT3 corner = aabb.corner(i);
+			points[i] = XMLoadFloat3(&corner);
+			points[8 + i] = points[i] + sweep;
+		}
+		return IsOutside(points);
+	}
+	// Spot light, the rays start from the light position and end at the range
+	bool IsShadowCulled(const AABB& aabb, const XMFLOAT3& position, float range) const
+	{
+		const XMVECTOR P = XMLoadFloat3(&position);
+		XMVECTOR points[16];
+		for (int i = 0; i < 8; ++i)
+		{
+			const XMFLOAT3 corner = aabb.corner(i);
+			points[i] = XMLoadFloat3(&corner);
+			points[8 + i] = P + XMVector3Normalize(points[i] - P) * range;
+		}
+		return IsOutside(points);
+	}
+
+	bool IsOutside(const XMVECTOR* points) const
+	{
+		for (int p = 0; p < 6; ++p)
+		{
+			const XMVECTOR plane = XMLoadFloat4(&frustum.planes[p]);
+			int i = 0;
+			while (i < 16 && XMVectorGetX(XMPlaneDotCoord(plane, points[i])) < 0)
+			{
+				i++;
+			}
+			if (i == 16)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+// receivers is set when the casters are also culled against the camera, direction is where the light rays go then
+static void DrawShadowCascade(const Visibility& vis, const Frustum& frustum, uint32_t cascade, std::vector<uint32_t>& shadow_mask, std::vector<uint32_t>& shadow_candidates, CommandList cmd, const ShadowReceiverVolume* receivers = nullptr, XMVECTOR direction = XMVectorZero())
+{
+	RenderQueue renderQueue;
+	bool transparentShadowsRequested = false;
+	if ( cascade < 3 ) // skip wicked engine objects in last 2 cascades
+	{
+		CullBoxes(*vis.scene, vis.scene->aabb_objects, frustum, shadow_mask, shadow_candidates);
+		for (uint32_t i : shadow_candidates)
+		{
+			const AABB& aabb = vis.scene->aabb_objects[i];
+			if ( cascade == 2 ) // skip small objects in third cascade
+			{
+				float sizeX = aabb._max.x - aabb._min.x;
+				float sizeY = aabb._max.y - aabb._min.y;
+				float sizeZ = aabb._max.z - aabb._min.z;
+				float areaXY = sizeX * sizeY;
+				float areaXZ = sizeX * sizeZ;
+				float areaYZ = sizeY * sizeZ;
+				if ( areaXY < 38000 && areaXZ < 38000 && areaYZ < 38000 ) continue; // about 5m x 5m
+			}
+			if (aabb.layerMask & vis.layerMask)
+			{
+				const ObjectComponent& object = vis.scene->objects[i];
+				if (object.IsRenderable() && !object.IsHLODCulled() && object.IsCastingShadow() && (cascade < (CASCADE_COUNT - object.cascadeMask)))
+				{
+					if (receivers != nullptr && receivers->IsShadowCulled(aabb, direction))
+					{
+						continue;
+					}
+
+					//Entity cullable_entity = vis.scene->aabb_objects.GetEntity(i);
+
+					RenderBatch* batch = (RenderBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(RenderBatch));
+					//size_t meshIndex = vis.scene->meshes.GetIndex(object.meshID);
+					//batch->Create(meshIndex, i, 0);
+					batch->Create(object.mesh_index, i, 0);
+					
+					renderQueue.add(batch);
+
+					if (object.GetRenderTypes() & RENDERTYPE_TRANSPARENT || object.GetRenderTypes() & RENDERTYPE_WATER)
+					{
+						transparentShadowsRequested = true;
+					}
+				}
+			}
+		}
+		//PE: Way faster shadow render, using special sorting to max batch and min. overdraw.
+		renderQueue.sort(RenderQueue::SORT_FRONT_TO_BACK);
+	}
+
+#ifdef GGREDUCED
+	if (!g_bNoTerrainRender)
+	{
+		char profileName[256];
+		sprintf_s(profileName, "Shadow Rendering - Terrain %d", cascade);
+		auto range2 = wiProfiler::BeginRangeGPU(profileName, cmd);
+		GGTerrain::GGTerrain_Draw_ShadowMap(&frustum, cascade, cmd);
+		wiProfiler::EndRange(range2);
+
+		//PE: Make more room. Trees dont use cascade 3-4
+		if (cascade < 3)
+		{
+			sprintf_s(profileName, "Shadow Rendering - Trees %d", cascade);
+			range2 = wiProfiler::BeginRangeGPU(profileName, cmd);
+			GGTrees::GGTrees_Draw_ShadowMap(&frustum, cascade, cmd);
+			wiProfiler::EndRange(range2);
+		}
+
+		//PE: Make more room. grass dont produce shadows.
+		//sprintf_s(profileName, "Shadow Rendering - Grass %d", cascade);
+		//range2 = wiProfiler::BeginRangeGPU(profileName, cmd);
+		//GGGrass::GGGrass_Draw_ShadowMap(&frustum, cascade, cmd);
+		//wiProfiler::EndRange(range2);
+	}
+#endif
+
+	if (!renderQueue.empty())
+	{
+		RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_OPAQUE, cmd);
+		if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
+		{
+			RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd);
+		}
+		GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * renderQueue.batchCount);
+	}
+}
+
+// Moves the previous content of the cascade with the camera, then renders the casters only into the strips that the movement exposed
+static void ScrollShadowCascade(const Visibility& vis, const ShadowCascade& state, uint32_t slice, uint32_t cascade, std::vector<uint32_t>& shadow_mask, std::vector<uint32_t>& shadow_candidates, CommandList cmd)
+{
+	device->EventBegin("ScrollShadowCascade", cmd);
+
+	// The slice can't be read while it is rendered to, so the previous content is copied out first:
+	device->RenderPassBegin(&renderpass_shadowScroll_2D, cmd);
+	CopyShadowDepth(shadowMapArray_2D, -1, slice, 1, 0, 0, 0, cmd);
+	device->RenderPassEnd(cmd);
+
+	device->RenderPassBegin(&renderpasses_shadow2D_load[slice], cmd);
+	CopyShadowDepth(shadowMapScroll_2D, -1, 0, 1, state.scrollX, state.scrollY, state.scrollDepth, cmd);
+
+	// The columns of the horizontal movement are exposed in full height, and the rows of the vertical movement next to them:
+	const int res = (int)SHADOWRES_2D;
+	Rect strips[2];
+	uint32_t stripCount = 0;
+	int left = 0;
+	int right = res;
+	if (state.scrollX > 0)
+	{
+		strips[stripCount++] = { 0, 0, state.scrollX, res };
+		left = state.scrollX;
+	}
+	else if (state.scrollX < 0)
+	{
+		strips[stripCount++] = { res + state.scrollX, 0, res, res };
+		right = res + state.scrollX;
+	}
+	if (state.scrollY > 0)
+	{
+		strips[stripCount++] = { left, 0, right, state.scrollY };
+	}
+	else if (state.scrollY < 0)
+	{
+		strips[stripCount++] = { left, res + state.scrollY, right, res };
+	}
+
+	const XMMATRIX VP = XMLoadFloat4x4(&state.VP);
+	for (uint32_t i = 0; i < stripCount; ++i)
+	{
+		const Rect& strip = strips[i];
+		device->BindScissorRects(1, &strip, cmd);
+
+		// The culling frustum is the part of the cascade camera that projects into the strip:
+		const float x0 = strip.left * 2.0f / res - 1;
+		const float x1 = strip.right * 2.0f / res - 1;
+		const float y0 = 1 - strip.bottom * 2.0f / res;
+		const float y1 = 1 - strip.top * 2.0f / res;
+		const XMMATRIX crop = XMMatrixScaling(2 / (x1 - x0), 2 / (y1 - y0), 1) * XMMatrixTranslation(-(x0 + x1) / (x1 - x0), -(y0 + y1) / (y1 - y0), 0);
+		Frustum frustum;
+		frustum.Create(XMMatrixMultiply(VP, crop));
+		DrawShadowCascade(vis, frustum, cascade, shadow_mask, shadow_candidates, cmd);
+	}
+
+	Rect rect;
+	rect.left = -INT_MAX;
+	rect.right = INT_MAX;
+	rect.top = -INT_MAX;
+	rect.bottom = INT_MAX;
+	device->BindScissorRects(1, &rect, cmd);
+
+	device->RenderPassEnd(cmd);
+	device->EventEnd(cmd);
 }
+
 void DrawShadowmaps(
 	const Visibility& vis,
 	CommandList cmd
@@ -6303,12 +9202,36 @@ void DrawShadowmaps(
 		cam_frustum.Transform(cam_frustum, vis.camera->GetInvView());
 		XMStoreFloat4(&cam_frustum.Orientation, XMQuaternionNormalize(XMLoadFloat4(&cam_frustum.Orientation)));
 
+		const ShadowReceiverVolume receivers(*vis.camera);
+
 		device->UnbindResources(TEXSLOT_SHADOWARRAY_2D, 2, cmd);
 		device->UnbindResources(TEXSLOT_SHADOWARRAY_SPOT_2D, 1, cmd);
 
 		uint32_t shadowCounter_2D = SHADOWRES_2D > 0 ? 0 : SHADOWCOUNT_2D;
 		uint32_t shadowCounter_Cube = SHADOWRES_CUBE > 0 ? 0 : SHADOWCOUNT_CUBE;
-		uint32_t shadowCounter_Spot_2D = SHADOWRES_SPOT_2D > 0 ? 0 : SHADOWCOUNT_SPOT_2D;
+
+		// The spot shadow atlas pages that hold tiles are cleared up front, the tiles of the lights are rendered into them after:
+		std::vector<bool> spot_pages(SHADOWCOUNT_SPOT_2D);
+		for (const auto& visibleLight : vis.visibleLights)
+		{
+			const LightComponent& light = vis.scene->lights[visibleLight.index];
+			if (light.GetType() == LightComponent::SPOT && light.shadow_page >= 0)
+			{
+				spot_pages[light.shadow_page] = true;
+			}
+		}
+		for (uint32_t i = 0; i < SHADOWCOUNT_SPOT_2D; ++i)
+		{
+			if (spot_pages[i])
+			{
+				device->RenderPassBegin(&renderpasses_spot_shadow2D[i], cmd);
+				device->RenderPassEnd(cmd);
+			}
+		}
+
+		std::vector<uint32_t> shadow_candidates; // object indices that pass the shadow camera culling, gathered with the scene BVH
+		std::vector<uint32_t> shadow_mask;
+		std::vector<uint32_t> shadow_static; // object indices of the cached casters of the light
 
 		for (const auto& visibleLight : vis.visibleLights)
 		{
@@ -6340,154 +9263,50 @@ void DrawShadowmaps(
 				uint32_t slice = shadowCounter_2D;
 				shadowCounter_2D += CASCADE_COUNT;
 
-				std::array<SHCAM, CASCADE_COUNT> shcams;
-				CreateDirLightShadowCams(light, *vis.camera, shcams);
+				// The cascade cameras and update modes were chosen in UpdatePerFrameData():
 				for (uint32_t cascade = 0; cascade < CASCADE_COUNT; ++cascade)
 				{
-					#ifdef GGREDUCED
-					#ifdef DELAYEDSHADOWS
-					if(bUpdateCascade[cascade])
-					#endif
-					{
-					#endif
-						RenderQueue renderQueue;
-						bool transparentShadowsRequested = false;
-						if ( cascade < 3 ) // skip wicked engine objects in last 2 cascades
-						{
-							for (size_t i = 0; i < vis.scene->aabb_objects.GetCount(); ++i)
-							{
-								const AABB& aabb = vis.scene->aabb_objects[i];
-								if ( cascade == 2 ) // skip small objects in third cascade
-								{
-									float sizeX = aabb._max.x - aabb._min.x;
-									float sizeY = aabb._max.y - aabb._min.y;
-									float sizeZ = aabb._max.z - aabb._min.z;
-									float areaXY = sizeX * sizeY;
-									float areaXZ = sizeX * sizeZ;
-									float areaYZ = sizeY * sizeZ;
-									if ( areaXY < 38000 && areaXZ < 38000 && areaYZ < 38000 ) continue; // about 5m x 5m
-								}
-								if ((aabb.layerMask & vis.layerMask) && shcams[cascade].frustum.CheckBoxFast(aabb))
-								{
-									const ObjectComponent& object = vis.scene->objects[i];
-									if (object.IsRenderable() && object.IsCastingShadow() && (cascade < (CASCADE_COUNT - object.cascadeMask)))
-									{
-										//Entity cullable_entity = vis.scene->aabb_objects.GetEntity(i);
-
-										RenderBatch* batch = (RenderBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(RenderBatch));
-										//size_t meshIndex = vis.scene->meshes.GetIndex(object.meshID);
-										//batch->Create(meshIndex, i, 0);
-										batch->Create(object.mesh_index, i, 0);
-										
-										renderQueue.add(batch);
-
-										if (object.GetRenderTypes() & RENDERTYPE_TRANSPARENT || object.GetRenderTypes() & RENDERTYPE_WATER)
-										{
-											transparentShadowsRequested = true;
-										}
-									}
-								}
-							}
-							//PE: Way faster shadow render, using special sorting to max batch and min. overdraw.
-							renderQueue.sort(RenderQueue::SORT_FRONT_TO_BACK);
-						}
-
-						#ifdef GGREDUCED
-						CameraCB cb;
-						XMStoreFloat4x4(&cb.g_xCamera_VP, shcams[cascade].VP);
-						device->UpdateBuffer(&constantBuffers[CBTYPE_CAMERA], &cb, cmd);
-
-						Viewport vp;
-						vp.TopLeftX = 0;
-						vp.TopLeftY = 0;
-						vp.Width = (float)SHADOWRES_2D;
-						vp.Height = (float)SHADOWRES_2D;
-						vp.MinDepth = 0.0f;
-						vp.MaxDepth = 1.0f;
-						device->BindViewports(1, &vp, cmd);
-
-						device->RenderPassBegin(&renderpasses_shadow2D[slice + cascade], cmd);
-
-						if (!g_bNoTerrainRender)
-						{
-							char profileName[256];
-							sprintf_s(profileName, "Shadow Rendering - Terrain %d", cascade);
-							auto range2 = wiProfiler::BeginRangeGPU(profileName, cmd);
-							GGTerrain::GGTerrain_Draw_ShadowMap(&shcams[cascade].frustum, cascade, cmd);
-							wiProfiler::EndRange(range2);
-
-							//PE: Make more room. Trees dont use cascade 3-4
-							if (cascade < 3)
-							{
-								sprintf_s(profileName, "Shadow Rendering - Trees %d", cascade);
-								range2 = wiProfiler::BeginRangeGPU(profileName, cmd);
-								GGTrees::GGTrees_Draw_ShadowMap(&shcams[cascade].frustum, cascade, cmd);
-								wiProfiler::EndRange(range2);
-							}
-
-							//PE: Make more room. grass dont produce shadows.
-							//sprintf_s(profileName, "Shadow Rendering - Grass %d", cascade);
-							//range2 = wiProfiler::BeginRangeGPU(profileName, cmd);
-							//GGGrass::GGGrass_Draw_ShadowMap(&shcams[cascade].frustum, cascade, cmd);
-							//wiProfiler::EndRange(range2);
-						}
-
-						if (!renderQueue.empty())
-						{
-							RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_OPAQUE, cmd);
-							if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
-							{
-								RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd);
-							}
-							GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * renderQueue.batchCount);
-						}
+					const ShadowCascade& state = shadowCascades[slice + cascade];
+					if (state.update == SHADOWCASCADE_UPDATE_KEEP)
+						continue;
 
-						device->RenderPassEnd(cmd);
-						#else
-						device->RenderPassBegin(&renderpasses_shadow2D[slice + cascade], cmd);
-						if (!renderQueue.empty())
-						{
-							CameraCB cb;
-							XMStoreFloat4x4(&cb.g_xCamera_VP, shcams[cascade].VP);
-							device->UpdateBuffer(&constantBuffers[CBTYPE_CAMERA], &cb, cmd);
-
-							Viewport vp;
-							vp.TopLeftX = 0;
-							vp.TopLeftY = 0;
-							vp.Width = (float)SHADOWRES_2D;
-							vp.Height = (float)SHADOWRES_2D;
-							vp.MinDepth = 0.0f;
-							vp.MaxDepth = 1.0f;
-							device->BindViewports(1, &vp, cmd);
+					CameraCB cb;
+					cb.g_xCamera_VP = state.VP;
+					device->UpdateBuffer(&constantBuffers[CBTYPE_CAMERA], &cb, cmd);
 
-							RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_OPAQUE, cmd);
-							if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
-							{
-								RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd);
-							}
+					Viewport vp;
+					vp.TopLeftX = 0;
+					vp.TopLeftY = 0;
+					vp.Width = (float)SHADOWRES_2D;
+					vp.Height = (float)SHADOWRES_2D;
+					vp.MinDepth = 0.0f;
+					vp.MaxDepth = 1.0f;
+					device->BindViewports(1, &vp, cmd);
 
-							GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * renderQueue.batchCount);
-						}
-						device->RenderPassEnd(cmd);
-						#endif
-					#ifdef GGREDUCED
+					if (state.update == SHADOWCASCADE_UPDATE_SCROLL)
+					{
+						ScrollShadowCascade(vis, state, slice + cascade, cascade, shadow_mask, shadow_candidates, cmd);
+						continue;
 					}
-					#endif
+
+					const XMVECTOR direction = XMVector3TransformNormal(XMVectorSet(0, -1, 0, 0), XMMatrixRotationQuaternion(XMLoadFloat4(&light.rotation)));
+					device->RenderPassBegin(&renderpasses_shadow2D[slice + cascade], cmd);
+					DrawShadowCascade(vis, state.frustum, cascade, shadow_mask, shadow_candidates, cmd, state.receivers_culled ? &receivers : nullptr, direction);
+					device->RenderPassEnd(cmd);
 				}
 			}
 			break;
 			case LightComponent::SPOT:
 			{
-				if (shadowCounter_Spot_2D >= SHADOWCOUNT_SPOT_2D)
-					break;
-				uint32_t slice = shadowCounter_Spot_2D;
-				shadowCounter_Spot_2D += 1;
-
 				if (light.history == 0 && bEnableSpotShadowCulling)
 				{
 					iCulledSpotShadows++;
 					break;
 				}
+				if (light.shadow_page < 0)
+					break;
+				const uint32_t slice = (uint32_t)light.shadow_page;
+				const wiRectPacker::rect_xywh& tile = light.shadow_rect;
 
 				SHCAM shcam;
 				CreateSpotLightShadowCam(light, shcam);
@@ -6497,16 +9316,32 @@ void DrawShadowmaps(
 				SPHERE boundingsphere = SPHERE(light.position, light.GetRange());
 				boundingsphere.radius *= 1.5f;
 
+				const bool cached = shadowCache_Spot_2D.texture.IsValid();
+				shadow_static.clear();
+
 				RenderQueue renderQueue;
 				bool transparentShadowsRequested = false;
-				for (size_t i = 0; i < vis.scene->aabb_objects.GetCount(); ++i)
+				CullBoxes(*vis.scene, vis.scene->aabb_objects, shcam.frustum, shadow_mask, shadow_candidates);
+				for (uint32_t i : shadow_candidates)
 				{
 					const AABB& aabb = vis.scene->aabb_objects[i];
-					if ((aabb.layerMask & vis.layerMask) && shcam.frustum.CheckBoxFast(aabb) && boundingsphere.intersects(aabb) )
+					if ((aabb.layerMask & vis.layerMask) && boundingsphere.intersects(aabb))
 					{
 						const ObjectComponent& object = vis.scene->objects[i];
-						if (object.IsRenderable() && object.IsCastingShadow())
+						if (object.IsRenderable() && !object.IsHLODCulled() && object.IsCastingShadow())
 						{
+							if (cached && IsStaticShadowCaster(object))
+							{
+								shadow_static.push_back(i);
+								continue;
+							}
+
+							// The cached casters are not culled against the camera, so that the cache doesn't change when only the camera moves:
+							if (shadowReceiverCulling && receivers.IsShadowCulled(aabb, light.position, light.GetRange()))
+							{
+								continue;
+							}
+
 							//Entity cullable_entity = vis.scene->aabb_objects.GetEntity(i);
 
 							RenderBatch* batch = (RenderBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(RenderBatch));
@@ -6522,11 +9357,20 @@ void DrawShadowmaps(
 						}
 					}
 				}
-				if (!renderQueue.empty())
+
+				// The static casters are gathered after the others, because the batches of a queue must be contiguous:
+				RenderQueue renderQueue_static;
+				size_t staticHash = 0;
+				for (uint32_t i : shadow_static)
 				{
-					//PE: Way faster shadow render, using special sorting to max batch and min. overdraw.
-					renderQueue.sort(RenderQueue::SORT_FRONT_TO_BACK);
+					RenderBatch* batch = (RenderBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(RenderBatch));
+					batch->Create(vis.scene->objects[i].mesh_index, i, 0);
+					renderQueue_static.add(batch);
+					wiHelper::hash_combine(staticHash, vis.scene->aabb_objects.GetEntity(i));
+				}
 
+				if (!renderQueue.empty() || !renderQueue_static.empty())
+				{
 					CameraCB cb;
 					XMStoreFloat4x4(&cb.g_xCamera_VP, shcam.VP);
 					device->UpdateBuffer(&constantBuffers[CBTYPE_CAMERA], &cb, cmd);
@@ -6534,21 +9378,56 @@ void DrawShadowmaps(
 					Viewport vp;
 					vp.TopLeftX = 0;
 					vp.TopLeftY = 0;
-					vp.Width = (float)SHADOWRES_SPOT_2D;
-					vp.Height = (float)SHADOWRES_SPOT_2D;
+					vp.Width = (float)tile.w;
+					vp.Height = (float)tile.h;
 					vp.MinDepth = 0.0f;
 					vp.MaxDepth = 1.0f;
+
+					uint32_t cacheSlot = 0;
+					if (!renderQueue_static.empty())
+					{
+						const float* VP = &cb.g_xCamera_VP._11;
+						for (int j = 0; j < 16; ++j)
+						{
+							wiHelper::hash_combine(staticHash, VP[j]);
+						}
+						wiHelper::hash_combine(staticHash, tile.w);
+						bool valid = false;
+						cacheSlot = shadowCache_Spot_2D.Acquire(vis.scene->lights.GetEntity(lightIndex), staticHash, device->GetFrameCount(), valid);
+						if (!valid)
+						{
+							// The cache slot is rendered at the tile size from its top left corner:
+							device->BindViewports(1, &vp, cmd);
+							renderQueue_static.sort(RenderQueue::SORT_FRONT_TO_BACK);
+							device->RenderPassBegin(&shadowCache_Spot_2D.renderpasses[cacheSlot], cmd);
+							RenderMeshes(vis, renderQueue_static, RENDERPASS_SHADOW, RENDERTYPE_OPAQUE, cmd);
+							device->RenderPassEnd(cmd);
+						}
+					}
+
+					vp.TopLeftX = (float)tile.x;
+					vp.TopLeftY = (float)tile.y;
 					device->BindViewports(1, &vp, cmd);
 
-					device->RenderPassBegin(&renderpasses_spot_shadow2D[slice], cmd);
-					RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_OPAQUE, cmd);
-					if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
+					//PE: Way faster shadow render, using special sorting to max batch and min. overdraw.
+					renderQueue.sort(RenderQueue::SORT_FRONT_TO_BACK);
+
+					device->RenderPassBegin(&renderpasses_spot_shadow2D_load[slice], cmd);
+					if (!renderQueue_static.empty())
+					{
+						CopyShadowCache(shadowCache_Spot_2D, cacheSlot, tile.x, tile.y, cmd);
+					}
+					if (!renderQueue.empty())
 					{
-						RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd);
+						RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_OPAQUE, cmd);
+						if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
+						{
+							RenderMeshes(vis, renderQueue, RENDERPASS_SHADOW, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd);
+						}
 					}
 					device->RenderPassEnd(cmd);
 
-					GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * renderQueue.batchCount);
+					GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * (renderQueue.batchCount + renderQueue_static.batchCount));
 					iRenderedSpotShadows++;
 				}
 
@@ -6589,16 +9468,29 @@ void DrawShadowmaps(
 
 				SPHERE boundingsphere = SPHERE(light.position, light.GetRange());
 
+				const bool cached = shadowCache_Cube.texture.IsValid();
+				shadow_static.clear();
+
 				RenderQueue renderQueue;
 				bool transparentShadowsRequested = false;
-				for (size_t i = 0; i < vis.scene->aabb_objects.GetCount(); ++i)
+				shadow_candidates.clear();
+				vis.scene->QueryBVH(vis.scene->aabb_objects, [&](const AABB& aabb) { return boundingsphere.intersects(aabb); }, [&](uint32_t index) {
+					shadow_candidates.push_back(index);
+				});
+				for (uint32_t i : shadow_candidates)
 				{
 					const AABB& aabb = vis.scene->aabb_objects[i];
-					if ((aabb.layerMask & vis.layerMask) && boundingsphere.intersects(aabb))
+					if (aabb.layerMask & vis.layerMask)
 					{
 						const ObjectComponent& object = vis.scene->objects[i];
-						if (object.IsRenderable() && object.IsCastingShadow())
+						if (object.IsRenderable() && !object.IsHLODCulled() && object.IsCastingShadow())
 						{
+							if (cached && IsStaticShadowCaster(object))
+							{
+								shadow_static.push_back(i);
+								continue;
+							}
+
 							//Entity cullable_entity = vis.scene->aabb_objects.GetEntity(i);
 
 							RenderBatch* batch = (RenderBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(RenderBatch));
@@ -6614,11 +9506,20 @@ void DrawShadowmaps(
 						}
 					}
 				}
-				if (!renderQueue.empty())
+
+				// The static casters are gathered after the others, because the batches of a queue must be contiguous:
+				RenderQueue renderQueue_static;
+				size_t staticHash = 0;
+				for (uint32_t i : shadow_static)
 				{
-					//PE: Way faster shadow render, using special sorting to max batch and min. overdraw.
-					renderQueue.sort(RenderQueue::SORT_FRONT_TO_BACK);
+					RenderBatch* batch = (RenderBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(RenderBatch));
+					batch->Create(vis.scene->objects[i].mesh_index, i, 0);
+					renderQueue_static.add(batch);
+					wiHelper::hash_combine(staticHash, vis.scene->aabb_objects.GetEntity(i));
+				}
 
+				if (!renderQueue.empty() || !renderQueue_static.empty())
+				{
 					MiscCB miscCb;
 					miscCb.g_xColor = float4(light.position.x, light.position.y, light.position.z, 0);
 					device->UpdateBuffer(&constantBuffers[CBTYPE_MISC], &miscCb, cmd);
@@ -6638,7 +9539,44 @@ void DrawShadowmaps(
 					Frustum frusta[arraysize(cameras)];
 					uint32_t frustum_count = 0;
 
+					Viewport vp;
+					vp.TopLeftX = 0;
+					vp.TopLeftY = 0;
+					vp.Width = (float)SHADOWRES_CUBE;
+					vp.Height = (float)SHADOWRES_CUBE;
+					vp.MinDepth = 0.0f;
+					vp.MaxDepth = 1.0f;
+					device->BindViewports(1, &vp, cmd);
+
 					CubemapRenderCB cb;
+					uint32_t cacheSlot = 0;
+					if (!renderQueue_static.empty())
+					{
+						wiHelper::hash_combine(staticHash, light.position.x);
+						wiHelper::hash_combine(staticHash, light.position.y);
+						wiHelper::hash_combine(staticHash, light.position.z);
+						wiHelper::hash_combine(staticHash, zFarP);
+						bool valid = false;
+						cacheSlot = shadowCache_Cube.Acquire(vis.scene->lights.GetEntity(lightIndex), staticHash, device->GetFrameCount(), valid);
+						if (!valid)
+						{
+							// The cache contains every face, because the camera can turn towards the others later:
+							for (uint32_t shcam = 0; shcam < arraysize(cameras); ++shcam)
+							{
+								XMStoreFloat4x4(&cb.xCubemapRenderCams[shcam].VP, cameras[shcam].VP);
+								cb.xCubemapRenderCams[shcam].properties = uint4(shcam, 0, 0, 0);
+								frusta[shcam] = cameras[shcam].frustum;
+							}
+							device->UpdateBuffer(&constantBuffers[CBTYPE_CUBEMAPRENDER], &cb, cmd);
+							device->BindConstantBuffer(VS, &constantBuffers[CBTYPE_CUBEMAPRENDER], CB_GETBINDSLOT(CubemapRenderCB), cmd);
+
+							renderQueue_static.sort(RenderQueue::SORT_FRONT_TO_BACK);
+							device->RenderPassBegin(&shadowCache_Cube.renderpasses[cacheSlot], cmd);
+							RenderMeshes(vis, renderQueue_static, RENDERPASS_SHADOWCUBE, RENDERTYPE_OPAQUE, cmd, false, frusta, arraysize(cameras));
+							device->RenderPassEnd(cmd);
+						}
+					}
+
 					for (uint32_t shcam = 0; shcam < arraysize(cameras); ++shcam)
 					{
 						if (cam_frustum.Intersects(cameras[shcam].boundingfrustum))
@@ -6652,24 +9590,25 @@ void DrawShadowmaps(
 					device->UpdateBuffer(&constantBuffers[CBTYPE_CUBEMAPRENDER], &cb, cmd);
 					device->BindConstantBuffer(VS, &constantBuffers[CBTYPE_CUBEMAPRENDER], CB_GETBINDSLOT(CubemapRenderCB), cmd);
 
-					Viewport vp;
-					vp.TopLeftX = 0;
-					vp.TopLeftY = 0;
-					vp.Width = (float)SHADOWRES_CUBE;
-					vp.Height = (float)SHADOWRES_CUBE;
-					vp.MinDepth = 0.0f;
-					vp.MaxDepth = 1.0f;
-					device->BindViewports(1, &vp, cmd);
+					//PE: Way faster shadow render, using special sorting to max batch and min. overdraw.
+					renderQueue.sort(RenderQueue::SORT_FRONT_TO_BACK);
 
 					device->RenderPassBegin(&renderpasses_shadowCube[slice], cmd);
-					RenderMeshes(vis, renderQueue, RENDERPASS_SHADOWCUBE, RENDERTYPE_OPAQUE, cmd, false, frusta, frustum_count);
-					if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
+					if (!renderQueue_static.empty())
+					{
+						CopyShadowCache(shadowCache_Cube, cacheSlot, 0, 0, cmd);
+					}
+					if (!renderQueue.empty())
 					{
-						RenderMeshes(vis, renderQueue, RENDERPASS_SHADOWCUBE, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd, false, frusta, frustum_count);
+						RenderMeshes(vis, renderQueue, RENDERPASS_SHADOWCUBE, RENDERTYPE_OPAQUE, cmd, false, frusta, frustum_count);
+						if (GetTransparentShadowsEnabled() && transparentShadowsRequested)
+						{
+							RenderMeshes(vis, renderQueue, RENDERPASS_SHADOWCUBE, RENDERTYPE_TRANSPARENT | RENDERTYPE_WATER, cmd, false, frusta, frustum_count);
+						}
 					}
 					device->RenderPassEnd(cmd);
 
-					GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * renderQueue.batchCount);
+					GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * (renderQueue.batchCount + renderQueue_static.batchCount));
 					iRenderedPointShadows++;
 				}
 
@@ -6685,11 +9624,129 @@ void DrawShadowmaps(
 	}
 }
 
-void DrawScene(
+// The render types that DrawScene() draws with the flags
+static uint32_t GetDrawSceneRenderTypes(uint32_t flags)
+{
+	const bool opaque = flags & RENDERTYPE_OPAQUE;
+	const bool transparent = flags & DRAWSCENE_TRANSPARENT;
+	const bool reflections = flags & DRAWSCENE_REFLECTIONS;
+
+	uint32_t renderTypeFlags = 0;
+	if (opaque)
+	{
+		renderTypeFlags |= RENDERTYPE_OPAQUE;
+	}
+	if (transparent)
+	{
+		renderTypeFlags |= RENDERTYPE_TRANSPARENT;
+		renderTypeFlags |= RENDERTYPE_WATER;
+	}
+	if (reflections)
+	{
+		renderTypeFlags |= RENDERTYPE_REFLECTIONS;
+	}
+	if (IsWireRender())
+	{
+		renderTypeFlags = RENDERTYPE_ALL;
+	}
+	return renderTypeFlags;
+}
+
+// Collects and sorts the visible objects that DrawScene() draws
+static void WriteDrawSceneQueue(
 	const Visibility& vis,
 	RENDERPASS renderPass,
+	uint32_t flags,
+	uint32_t renderTypeFlags,
+	RenderQueue& renderQueue,
 	CommandList cmd,
-	uint32_t flags
+	bool writeCameraDistance = true
+)
+{
+	const bool transparent = flags & DRAWSCENE_TRANSPARENT;
+//	const bool occlusion = flags & DRAWSCENE_OCCLUSIONCULLING;
+	//PE: https://github.com/turanszkij/WickedEngine/commit/54d11f1e9138813b7815e9d523f2e7b8fac523a2
+	const bool occlusion = (flags & DRAWSCENE_OCCLUSIONCULLING) && GetOcclusionCullingEnabled();
+
+	for (uint32_t instanceIndex : vis.visibleObjects)
+	{
+		ObjectComponent& object = (ObjectComponent&)vis.scene->objects[instanceIndex]; // GGREDUCED was const
+
+		if (occlusion && object.IsOccluded() && bEnableObjectCulling)
+			continue;
+
+		if (object.IsRenderable() && (object.GetRenderTypes() & renderTypeFlags))
+		{
+			float distance = wiMath::Distance(vis.camera->Eye, object.center); // GGREDUCED was const
+			if (object.IsImpostorPlacement() && distance > object.impostorSwapDistance + object.impostorFadeThresholdRadius)
+			{
+				continue;
+			}
+
+#ifdef GGREDUCED
+			if (renderPass == RENDERPASS_MAIN && writeCameraDistance)
+			{
+				object.SetCameraDistance(distance);
+			}
+			// LB: introduce a distance bias so that two transparent objects
+			// sharing the same space can set a priority of one over the other
+			distance = distance + object.GetRenderOrderBiasDistance();
+#endif
+
+			RenderBatch* batch = (RenderBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(RenderBatch));
+			//size_t meshIndex = vis.scene->meshes.GetIndex(object.meshID);
+			//batch->Create(meshIndex, instanceIndex, distance);
+
+			//PE: LOD objects that are in LOD mode need there own batches.
+			const MeshComponent& mesh = vis.scene->meshes[object.mesh_index];
+			const uint32_t material = mesh.subsets.empty() ? 0 : mesh.subsets[0].materialIndex;
+			batch->Create(object.mesh_index, instanceIndex, distance, object.IsRenderLOD(), object.activelod, material);
+			renderQueue.add(batch);
+		}
+	}
+	if (!renderQueue.empty())
+	{
+#ifdef GGREDUCED
+		//PE: renderQueue.sort is not using distance but meshIndex<<8 , dist&0xff, so order of transparent mesh'es was not correct.
+		//LB: I can still trick the order with 2 transparent puddles, move 2nd slightly higher and further away than the 1st and it renders the 2nd FIRST, even though it should be rendered LAST as it is still on top
+		//PE: It already sort distance from camera to center of the object, so we cant really improve this.
+		//PE: Its a issue in all engines that cant be fixed by code. We could add a sort distance bias so user decide, but thats it.
+		//PE: Translucency Sort Priority : https://docs.unrealengine.com/en-US/RenderingAndGraphics/Materials/HowTo/Transparency/index.html
+		//PE: https://www.khronos.org/opengl/wiki/Transparency_Sorting
+
+		//if (transparent)
+		//	renderQueue.sortdistance(RenderQueue::SORT_BACK_TO_FRONT);
+		//else
+		//	renderQueue.sort(RenderQueue::SORT_FRONT_TO_BACK);
+
+		//PE: https://github.com/turanszkij/WickedEngine/commit/f49ecdb60e40decb4eb559f986458f68a5c93cbf
+		//PE: Sorting only needed for transparent and prepass.
+		if (transparent)
+		{
+			renderQueue.sortdistance(RenderQueue::SORT_BACK_TO_FRONT);
+		}
+		else
+		{
+			renderQueue.sort(RenderQueue::SORT_FRONT_TO_BACK);
+		}
+		//else if (renderPass == RENDERPASS_PREPASS)
+		//{
+		//	renderQueue.sort(RenderQueue::SORT_FRONT_TO_BACK);
+		//}
+#else
+		renderQueue.sort(transparent ? RenderQueue::SORT_BACK_TO_FRONT : RenderQueue::SORT_FRONT_TO_BACK);
+#endif
+	}
+}
+
+// Only the first chunk draws the ocean, hair particles and impostors, the sorted render queue is divided between the chunks evenly
+static void DrawScene_Internal(
+	const Visibility& vis,
+	RENDERPASS renderPass,
+	CommandList cmd,
+	uint32_t flags,
+	uint32_t chunk,
+	uint32_t chunk_count
 )
 {
 #ifdef GGREDUCED
@@ -6697,15 +9754,10 @@ void DrawScene(
 	OPTICK_EVENT();
 #endif
 #endif
-	const bool opaque = flags & RENDERTYPE_OPAQUE;
 	const bool transparent = flags & DRAWSCENE_TRANSPARENT;
 	const bool tessellation = (flags & DRAWSCENE_TESSELLATION) && GetTessellationEnabled();
 	const bool hairparticle = flags & DRAWSCENE_HAIRPARTICLE;
-//	const bool occlusion = flags & DRAWSCENE_OCCLUSIONCULLING;
-	//PE: https://github.com/turanszkij/WickedEngine/commit/54d11f1e9138813b7815e9d523f2e7b8fac523a2
-	const bool occlusion = (flags & DRAWSCENE_OCCLUSIONCULLING) && GetOcclusionCullingEnabled();
 	const bool ocean = flags & DRAWSCENE_OCEAN;
-	const bool reflections = flags & DRAWSCENE_REFLECTIONS;
 
 	device->EventBegin("DrawScene", cmd);
 	device->BindShadingRate(SHADING_RATE_1X1, cmd);
@@ -6722,152 +9774,819 @@ void DrawScene(
 	device->BindResource(PS, &textures[TEXTYPE_2D_SKYATMOSPHERE_SKYLUMINANCELUT], TEXSLOT_SKYLUMINANCELUT, cmd);
 	device->BindResource(PS, GetVoxelRadianceSecondaryBounceEnabled() ? &textures[TEXTYPE_3D_VOXELRADIANCE_HELPER] : &textures[TEXTYPE_3D_VOXELRADIANCE], TEXSLOT_VOXELRADIANCE, cmd);
 
-	if (vis.scene->weather.skyMap != nullptr)
+	if (vis.scene->weather.skyMap != nullptr)
+	{
+		device->BindResource(PS, &vis.scene->weather.skyMap->texture, TEXSLOT_GLOBALENVMAP, cmd);
+	}
+
+	device->BindResource(PS, &vis.scene->lightmap, TEXSLOT_GLOBALLIGHTMAP, cmd);
+	if (vis.scene->decalAtlas.IsValid())
+	{
+		device->BindResource(PS, &vis.scene->decalAtlas, TEXSLOT_DECALATLAS, cmd);
+	}
+
+	if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_PIPELINE) || device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
+	{
+		device->BindResource(PS, &vis.scene->TLAS, TEXSLOT_ACCELERATION_STRUCTURE, cmd);
+		device->BindResource(CS, &vis.scene->TLAS, TEXSLOT_ACCELERATION_STRUCTURE, cmd);
+	}
+
+#ifdef GGREDUCED
+	if (!g_bNoTerrainRender)
+	{
+		if (ocean && vis.scene->weather.IsOceanEnabled() )
+		{
+			vis.scene->ocean.Render(*vis.camera, vis.scene->weather.oceanParameters, cmd);
+		}
+	}
+#else
+	if (ocean && vis.scene->weather.IsOceanEnabled())
+	{
+		vis.scene->ocean.Render(*vis.camera, vis.scene->weather.oceanParameters, cmd);
+	}
+#endif
+
+	if (hairparticle && chunk == 0)
+	{
+		if (!transparent)
+		{
+			for (uint32_t hairIndex : vis.visibleHairs)
+			{
+				const wiHairParticle& hair = vis.scene->hairs[hairIndex];
+				Entity entity = vis.scene->hairs.GetEntity(hairIndex);
+				const MaterialComponent& material = *vis.scene->materials.GetComponent(entity);
+
+				hair.Draw(*vis.camera, material, renderPass, cmd);
+			}
+		}
+	}
+
+	if (IsWireRender() && !transparent)
+		return;
+
+	if (chunk == 0)
+	{
+		RenderImpostors(vis, renderPass, cmd);
+	}
+
+	const uint32_t renderTypeFlags = GetDrawSceneRenderTypes(flags);
+
+	// Every chunk writes and sorts the same queue, so the chunks together draw every batch exactly once:
+	RenderQueue renderQueue;
+	WriteDrawSceneQueue(vis, renderPass, flags, renderTypeFlags, renderQueue, cmd, chunk == 0);
+	if (!renderQueue.empty())
+	{
+		const uint32_t batch_begin = uint32_t(uint64_t(renderQueue.batchCount) * chunk / chunk_count);
+		const uint32_t batch_end = uint32_t(uint64_t(renderQueue.batchCount) * (chunk + 1) / chunk_count);
+		RenderQueue chunkQueue;
+		chunkQueue.batchArray = renderQueue.batchArray + batch_begin;
+		chunkQueue.batchCount = batch_end - batch_begin;
+		if (!chunkQueue.empty())
+		{
+			RenderMeshes(vis, chunkQueue, renderPass, renderTypeFlags, cmd, tessellation);
+		}
+
+		GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * renderQueue.batchCount);
+	}
+
+	device->BindShadingRate(SHADING_RATE_1X1, cmd);
+	device->EventEnd(cmd);
+}
+
+void DrawScene(
+	const Visibility& vis,
+	RENDERPASS renderPass,
+	CommandList cmd,
+	uint32_t flags
+)
+{
+	DrawScene_Internal(vis, renderPass, cmd, flags, 0, 1);
+}
+
+void DrawScene_Chunk(
+	const Visibility& vis,
+	RENDERPASS renderPass,
+	CommandList cmd,
+	uint32_t flags,
+	uint32_t chunk,
+	uint32_t chunk_count
+)
+{
+	assert(chunk < chunk_count);
+	DrawScene_Internal(vis, renderPass, cmd, flags, chunk, chunk_count);
+}
+
+uint32_t GetDrawSceneChunkCount(const Visibility& vis, uint32_t flags)
+{
+	// The GPU culled batches are prepared for one command list, and the queue of few objects is not worth the state setup of more command lists:
+	if (GetGPUCullingEnabled() || IsWireRender() || (flags & DRAWSCENE_TRANSPARENT))
+	{
+		return 1;
+	}
+	const uint32_t objects_per_chunk = 256;
+	const uint32_t max_chunks = std::min(8u, std::max(1u, wiJobSystem::GetThreadCount()));
+	return std::max(1u, std::min(max_chunks, uint32_t(vis.visibleObjects.size()) / objects_per_chunk));
+}
+
+const Texture* GetGPUCullingHiZ(XMFLOAT4X4& VP, float& zNearP, float& zFarP)
+{
+	const uint64_t frame = device->GetFrameCount();
+	if (!gpuCullingHiZ.IsValid() || gpuCullingHiZCamera.frame > frame || gpuCullingHiZCamera.frame + 1 < frame)
+	{
+		return nullptr;
+	}
+	VP = gpuCullingHiZCamera.VP;
+	zNearP = gpuCullingHiZCamera.zNearP;
+	zFarP = gpuCullingHiZCamera.zFarP;
+	return &gpuCullingHiZ;
+}
+// Conservative Hi-Z: the mips of the lineardepth are point sampled, so a farthest depth chain is reduced from its top mip
+static void SinglePassDownsample(SHADERTYPE shadertype, const Texture& input, int input_subresource, uint32_t input_width, uint32_t input_height, const Texture& output, uint32_t output_mip, uint32_t mip_count, CommandList cmd);
+static uint32_t SinglePassDownsampleMipCount(uint32_t input_width, uint32_t input_height);
+static void GPUCulling_BuildHiZ(const CameraComponent& camera, const Texture& lineardepth, CommandList cmd)
+{
+	const TextureDesc& depth_desc = lineardepth.GetDesc();
+	const uint32_t width = std::max(1u, (depth_desc.Width + 1) / 2);
+	const uint32_t height = std::max(1u, (depth_desc.Height + 1) / 2);
+	if (!gpuCullingHiZ.IsValid() || gpuCullingHiZ.desc.Width != width || gpuCullingHiZ.desc.Height != height)
+	{
+		TextureDesc desc;
+		desc.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+		desc.Format = FORMAT_R32_FLOAT;
+		desc.Width = width;
+		desc.Height = height;
+		desc.MipLevels = 1;
+		while ((std::max(width, height) >> desc.MipLevels) > 0)
+		{
+			desc.MipLevels++;
+		}
+		desc.layout = IMAGE_LAYOUT_SHADER_RESOURCE_COMPUTE;
+		device->CreateTexture(&desc, nullptr, &gpuCullingHiZ);
+		device->SetName(&gpuCullingHiZ, "gpuCullingHiZ");
+
+		for (uint32_t i = 0; i < desc.MipLevels; ++i)
+		{
+			int subresource_index;
+			subresource_index = device->CreateSubresource(&gpuCullingHiZ, SRV, 0, 1, i, 1);
+			assert(subresource_index == i);
+			subresource_index = device->CreateSubresource(&gpuCullingHiZ, UAV, 0, 1, i, 1);
+			assert(subresource_index == i);
+		}
+	}
+
+	// Conservative Hi-Z: every texel is the farthest linear depth of its footprint, the lineardepth pyramid can't be used for this, because its mips are point sampled
+	//	The whole chain is reduced by the single pass downsampler, in one dispatch up to the 4K resolution
+	const TextureDesc& desc = gpuCullingHiZ.GetDesc();
+	uint32_t mip = 0;
+	while (mip < desc.MipLevels)
+	{
+		const uint32_t input_width = mip == 0 ? depth_desc.Width : std::max(1u, desc.Width >> (mip - 1));
+		const uint32_t input_height = mip == 0 ? depth_desc.Height : std::max(1u, desc.Height >> (mip - 1));
+		const uint32_t count = std::min(desc.MipLevels - mip, SinglePassDownsampleMipCount(input_width, input_height));
+		SinglePassDownsample(CSTYPE_SPD_MAX, mip == 0 ? lineardepth : gpuCullingHiZ, mip == 0 ? 0 : int(mip - 1), input_width, input_height, gpuCullingHiZ, mip, count, cmd);
+		mip += count;
+	}
+
+	gpuCullingHiZCamera.VP = camera.VP;
+	gpuCullingHiZCamera.zNearP = camera.zNearP;
+	gpuCullingHiZCamera.zFarP = camera.zFarP;
+	gpuCullingHiZCamera.frame = device->GetFrameCount();
+}
+void GPUCulling_Prepare(
+	const Visibility& vis,
+	const Texture* lineardepth,
+	uint32_t flags,
+	CommandList cmd
+)
+{
+	GPUCulling& culling = gpuCulling[cmd];
+	culling.vis = nullptr;
+
+	if (!GetGPUCullingEnabled() ||
+		!device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS) ||
+		instanceTableScene != vis.scene ||
+		!instanceTable.IsValid() ||
+		IsWireRender() ||
+		(flags & DRAWSCENE_TRANSPARENT))
+	{
+		return;
+	}
+
+	const uint32_t renderTypeFlags = GetDrawSceneRenderTypes(flags);
+
+	RenderQueue renderQueue;
+	WriteDrawSceneQueue(vis, RENDERPASS_MAIN, flags, renderTypeFlags, renderQueue, cmd);
+	if (renderQueue.empty())
+	{
+		return;
+	}
+
+	// Every object of the queue is referenced exactly once, because there is only the camera frustum:
+	const uint32_t referenceCount = renderQueue.batchCount;
+	culling.referenceData.resize(referenceCount * 2);
+	InstancedBatch* instancedBatchArray = nullptr;
+	const int instancedBatchCount = WriteInstancedBatches(vis, renderQueue, instanceTypes[RENDERPASS_MAIN], INSTANCETABLE_REFERENCE_STRIDE, true, false, RENDERPASS_MAIN, nullptr, 1, culling.referenceData.data(), 0, instancedBatchArray, cmd);
+	culling.batches.assign(instancedBatchArray, instancedBatchArray + instancedBatchCount);
+	GetRenderFrameAllocator(cmd).free(sizeof(InstancedBatch) * instancedBatchCount);
+	GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * renderQueue.batchCount);
+
+	if (instancedBatchCount > 65535)
+	{
+		// One thread group per batch, more can't be dispatched in one dimension
+		return;
+	}
+
+	device->EventBegin("GPUCulling_Prepare", cmd);
+	auto range = wiProfiler::BeginRangeGPU("GPU Culling", cmd);
+
+	// Static meshes with meshlets are culled per cluster, as long as their instances fit in the output index buffer:
+	const bool reflections = renderTypeFlags & RENDERTYPE_REFLECTIONS;
+	culling.meshletDraws.assign(instancedBatchCount, ~0u);
+	culling.meshletInputData.clear();
+	uint32_t meshletCandidateCount = 0;
+	uint32_t meshletIndexCount = 0;
+	for (int i = 0; i < instancedBatchCount && GetMeshletCullingEnabled(); ++i)
+	{
+		const InstancedBatch& instancedBatch = culling.batches[i];
+		const MeshComponent& mesh = vis.scene->meshes[instancedBatch.meshIndex];
+		if (mesh.meshlets.empty() ||
+			!mesh.meshletBuffer.IsValid() ||
+			mesh.IsSkinned() ||
+			!mesh.targets.empty() ||
+			mesh.IsTerrain() ||
+			mesh.GetTessellationFactor() > 0 ||
+			GetInstancedBatchLOD(mesh, instancedBatch, RENDERPASS_MAIN, reflections) != 0)
+		{
+			continue;
+		}
+		const uint32_t indexCount = mesh.subsets[0].indexCount;
+		if (meshletIndexCount + indexCount * (uint32_t)instancedBatch.instanceCount > MESHLETCULLING_MAX_INDICES)
+		{
+			continue;
+		}
+
+		culling.meshletDraws[i] = meshletCandidateCount;
+		const uint32_t firstReference = instancedBatch.dataOffset / INSTANCETABLE_REFERENCE_STRIDE;
+		for (int j = 0; j < instancedBatch.instanceCount; ++j)
+		{
+			const uint32_t reference = firstReference + (uint32_t)j;
+			const uint32_t objectIndex = culling.referenceData[reference * 2];
+			const ObjectComponent& object = vis.scene->objects[objectIndex];
+			const XMFLOAT4X4& worldMatrix = object.transform_index >= 0 ? vis.scene->transforms[object.transform_index].world : IDENTITYMATRIX;
+
+			culling.meshletInputData.resize(culling.meshletInputData.size() + MESHLETCULLING_CANDIDATE_STRIDE);
+			Instance& candidate = *(Instance*)(culling.meshletInputData.data() + meshletCandidateCount * MESHLETCULLING_CANDIDATE_STRIDE);
+			candidate.Create(worldMatrix);
+			candidate.userdata = XMUINT4(objectIndex, culling.referenceData[reference * 2 + 1], meshletIndexCount, reference);
+
+			meshletCandidateCount++;
+			meshletIndexCount += indexCount;
+		}
+	}
+	static_assert(sizeof(Instance) == MESHLETCULLING_CANDIDATE_STRIDE, "The meshlet culling candidate must match the Instance layout!");
+
+	// Culling input: header, the draw of every batch, then the candidate instances with their bounding boxes
+	const uint32_t candidatesOffset = 16 + instancedBatchCount * GPUCULLING_BATCH_STRIDE;
+	culling.inputData.resize(candidatesOffset + referenceCount * GPUCULLING_CANDIDATE_STRIDE);
+	uint32_t* header = (uint32_t*)culling.inputData.data();
+	header[0] = (uint32_t)instancedBatchCount;
+	header[1] = candidatesOffset;
+	header[2] = lineardepth != nullptr ? 1 : 0;
+	header[3] = 0;
+	for (int i = 0; i < instancedBatchCount; ++i)
+	{
+		const InstancedBatch& instancedBatch = culling.batches[i];
+		const MeshComponent& mesh = vis.scene->meshes[instancedBatch.meshIndex];
+		const uint32_t lod = GetInstancedBatchLOD(mesh, instancedBatch, RENDERPASS_MAIN, reflections);
+		uint32_t* batch = (uint32_t*)(culling.inputData.data() + 16 + i * GPUCULLING_BATCH_STRIDE);
+		batch[0] = instancedBatch.dataOffset / INSTANCETABLE_REFERENCE_STRIDE;
+		batch[1] = (uint32_t)instancedBatch.instanceCount;
+		batch[2] = lod < mesh.subsets.size() && culling.meshletDraws[i] == ~0u ? mesh.subsets[lod].indexCount : 0;
+		batch[3] = lod < mesh.subsets.size() ? mesh.subsets[lod].indexOffset : 0;
+	}
+	for (uint32_t i = 0; i < referenceCount; ++i)
+	{
+		const uint32_t objectIndex = culling.referenceData[i * 2];
+		const AABB& aabb = vis.scene->aabb_objects[objectIndex];
+		uint8_t* candidate = culling.inputData.data() + candidatesOffset + i * GPUCULLING_CANDIDATE_STRIDE;
+		std::memcpy(candidate, &aabb._min, sizeof(aabb._min));
+		std::memcpy(candidate + 12, &objectIndex, sizeof(objectIndex));
+		std::memcpy(candidate + 16, &aabb._max, sizeof(aabb._max));
+		std::memcpy(candidate + 28, &culling.referenceData[i * 2 + 1], sizeof(uint32_t));
+	}
+
+	if (!culling.input.IsValid() || culling.input.GetDesc().ByteWidth < culling.inputData.size())
+	{
+		GPUBufferDesc desc;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_SHADER_RESOURCE;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		desc.ByteWidth = uint32_t(culling.inputData.size() * 2);
+		device->CreateBuffer(&desc, nullptr, &culling.input);
+		device->SetName(&culling.input, "gpuCulling.input");
+	}
+	if (!culling.args.IsValid() || culling.args.GetDesc().ByteWidth < instancedBatchCount * GPUCULLING_ARGS_STRIDE)
+	{
+		GPUBufferDesc desc;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_UNORDERED_ACCESS;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS | RESOURCE_MISC_INDIRECT_ARGS;
+		desc.ByteWidth = uint32_t(instancedBatchCount * GPUCULLING_ARGS_STRIDE * 2);
+		device->CreateBuffer(&desc, nullptr, &culling.args);
+		device->SetName(&culling.args, "gpuCulling.args");
+	}
+	if (!culling.references.IsValid() || culling.references.GetDesc().ByteWidth < referenceCount * INSTANCETABLE_REFERENCE_STRIDE)
+	{
+		GPUBufferDesc desc;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		desc.ByteWidth = uint32_t(referenceCount * INSTANCETABLE_REFERENCE_STRIDE * 2);
+		device->CreateBuffer(&desc, nullptr, &culling.references);
+		device->SetName(&culling.references, "gpuCulling.references");
+	}
+
+	device->UpdateBuffer(&culling.input, culling.inputData.data(), cmd, (int)culling.inputData.size());
+
+	if (meshletCandidateCount > 0)
+	{
+		if (!culling.meshletInput.IsValid() || culling.meshletInput.GetDesc().ByteWidth < culling.meshletInputData.size())
+		{
+			GPUBufferDesc desc;
+			desc.Usage = USAGE_DEFAULT;
+			desc.BindFlags = BIND_SHADER_RESOURCE;
+			desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+			desc.ByteWidth = uint32_t(culling.meshletInputData.size() * 2);
+			device->CreateBuffer(&desc, nullptr, &culling.meshletInput);
+			device->SetName(&culling.meshletInput, "gpuCulling.meshletInput");
+		}
+		if (!culling.meshletArgs.IsValid() || culling.meshletArgs.GetDesc().ByteWidth < meshletCandidateCount * GPUCULLING_ARGS_STRIDE)
+		{
+			GPUBufferDesc desc;
+			desc.Usage = USAGE_DEFAULT;
+			desc.BindFlags = BIND_UNORDERED_ACCESS;
+			desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS | RESOURCE_MISC_INDIRECT_ARGS;
+			desc.ByteWidth = uint32_t(meshletCandidateCount * GPUCULLING_ARGS_STRIDE * 2);
+			device->CreateBuffer(&desc, nullptr, &culling.meshletArgs);
+			device->SetName(&culling.meshletArgs, "gpuCulling.meshletArgs");
+		}
+		if (!culling.meshletIndices.IsValid() || culling.meshletIndices.GetDesc().ByteWidth < meshletIndexCount * sizeof(uint32_t))
+		{
+			GPUBufferDesc desc;
+			desc.Usage = USAGE_DEFAULT;
+			desc.BindFlags = BIND_INDEX_BUFFER | BIND_UNORDERED_ACCESS;
+			desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+			desc.ByteWidth = uint32_t(std::min(meshletIndexCount * 2u, (uint32_t)MESHLETCULLING_MAX_INDICES) * sizeof(uint32_t));
+			device->CreateBuffer(&desc, nullptr, &culling.meshletIndices);
+			device->SetName(&culling.meshletIndices, "gpuCulling.meshletIndices");
+		}
+
+		device->UpdateBuffer(&culling.meshletInput, culling.meshletInputData.data(), cmd, (int)culling.meshletInputData.size());
+	}
+
+	BindCommonResources(cmd);
+
+	if (lineardepth != nullptr)
+	{
+		GPUCulling_BuildHiZ(*vis.camera, *lineardepth, cmd);
+	}
+
+	device->BindComputeShader(&shaders[CSTYPE_GPUCULLING], cmd);
+	device->BindResource(CS, &culling.input, GPUCULLINGSLOT_IN_INPUT, cmd);
+	device->BindResource(CS, lineardepth != nullptr ? &gpuCullingHiZ : wiTextureHelper::getWhite(), GPUCULLINGSLOT_IN_HIZ, cmd);
+	const GPUResource* uavs[] = {
+		&culling.args,
+		&culling.references,
+	};
+	device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+	{
+		GPUBarrier barriers[] = {
+			GPUBarrier::Buffer(&culling.args, BUFFER_STATE_INDIRECT_ARGUMENT, BUFFER_STATE_UNORDERED_ACCESS),
+			GPUBarrier::Buffer(&culling.references, BUFFER_STATE_SHADER_RESOURCE, BUFFER_STATE_UNORDERED_ACCESS),
+		};
+		device->Barrier(barriers, arraysize(barriers), cmd);
+	}
+
+	device->Dispatch((uint32_t)instancedBatchCount, 1, 1, cmd);
+
+	if (meshletCandidateCount > 0)
+	{
+		// The clusters of every instance are culled by one thread group, the mesh buffers are bound per batch:
+		device->EventBegin("Meshlet Culling", cmd);
+		device->BindComputeShader(&shaders[CSTYPE_MESHLETCULLING], cmd);
+		device->BindResource(CS, &culling.meshletInput, GPUCULLINGSLOT_IN_INPUT, cmd);
+		const GPUResource* meshlet_uavs[] = {
+			&culling.meshletArgs,
+			&culling.references,
+			&culling.meshletIndices,
+		};
+		device->BindUAVs(CS, meshlet_uavs, 0, arraysize(meshlet_uavs), cmd);
+
+		{
+			GPUBarrier barriers[] = {
+				GPUBarrier::Buffer(&culling.meshletArgs, BUFFER_STATE_INDIRECT_ARGUMENT, BUFFER_STATE_UNORDERED_ACCESS),
+				GPUBarrier::Buffer(&culling.meshletIndices, BUFFER_STATE_INDEX_BUFFER, BUFFER_STATE_UNORDERED_ACCESS),
+			};
+			device->Barrier(barriers, arraysize(barriers), cmd);
+		}
+
+		for (int i = 0; i < instancedBatchCount; ++i)
+		{
+			if (culling.meshletDraws[i] == ~0u)
+			{
+				continue;
+			}
+			const InstancedBatch& instancedBatch = culling.batches[i];
+			const MeshComponent& mesh = vis.scene->meshes[instancedBatch.meshIndex];
+			const MaterialComponent& material = vis.scene->materials[mesh.subsets[0].materialIndex];
+
+			MiscCB cb;
+			cb.g_xColor.x = (float)culling.meshletDraws[i];
+			cb.g_xColor.y = (float)mesh.meshlets.size();
+			cb.g_xColor.z = lineardepth != nullptr ? 1.0f : 0.0f;
+			cb.g_xColor.w = mesh.IsDoubleSided() || material.IsDoubleSided() ? 0.0f : 1.0f;
+			device->UpdateBuffer(&constantBuffers[CBTYPE_MISC], &cb, cmd);
+			device->BindConstantBuffer(CS, &constantBuffers[CBTYPE_MISC], CB_GETBINDSLOT(MiscCB), cmd);
+
+			device->BindResource(CS, &mesh.meshletBuffer, MESHLETCULLINGSLOT_IN_MESHLETS, cmd);
+			device->BindResource(CS, &mesh.indexBuffer, MESHLETCULLINGSLOT_IN_INDICES, cmd);
+
+			device->Dispatch((uint32_t)instancedBatch.instanceCount, 1, 1, cmd);
+		}
+
+		{
+			GPUBarrier barriers[] = {
+				GPUBarrier::Memory(),
+				GPUBarrier::Buffer(&culling.meshletArgs, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_INDIRECT_ARGUMENT),
+				GPUBarrier::Buffer(&culling.meshletIndices, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_INDEX_BUFFER),
+			};
+			device->Barrier(barriers, arraysize(barriers), cmd);
+		}
+		device->UnbindUAVs(0, arraysize(meshlet_uavs), cmd);
+		device->UnbindResources(MESHLETCULLINGSLOT_IN_MESHLETS, 2, cmd);
+		device->EventEnd(cmd);
+	}
+
+	{
+		GPUBarrier barriers[] = {
+			GPUBarrier::Memory(),
+			GPUBarrier::Buffer(&culling.args, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_INDIRECT_ARGUMENT),
+			GPUBarrier::Buffer(&culling.references, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE),
+		};
+		device->Barrier(barriers, arraysize(barriers), cmd);
+	}
+
+	device->UnbindUAVs(0, arraysize(uavs), cmd);
+	device->UnbindResources(GPUCULLINGSLOT_IN_INPUT, 2, cmd);
+
+	culling.vis = &vis;
+	culling.renderTypeFlags = renderTypeFlags;
+	culling.frame = device->GetFrameCount();
+
+	wiProfiler::EndRange(range);
+	device->EventEnd(cmd);
+}
+
+GPUBuffer gpuCullingBoxesInput[COMMANDLIST_COUNT];
+std::vector<uint8_t> gpuCullingBoxesData[COMMANDLIST_COUNT];
+void GPUCulling_Boxes(
+	const AABB* boxes,
+	uint32_t count,
+	const GPUBuffer& output,
+	CommandList cmd,
+	const uint32_t* outputIndices
+)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	device->EventBegin("GPUCulling_Boxes", cmd);
+
+	XMFLOAT4X4 VP = IDENTITYMATRIX;
+	float zNearP = 0;
+	float zFarP = 0;
+	const Texture* hiz = GetGPUCullingHiZ(VP, zNearP, zFarP);
+
+	std::vector<uint8_t>& data = gpuCullingBoxesData[cmd];
+	data.resize(GPUCULLING_BOXES_HEADER_SIZE + count * GPUCULLING_CANDIDATE_STRIDE);
+	uint32_t* header = (uint32_t*)data.data();
+	header[0] = count;
+	header[1] = hiz != nullptr ? 1 : 0;
+	header[2] = 0;
+	header[3] = 0;
+	const float zNearFar[] = { zNearP, zFarP, 0, 0 };
+	std::memcpy(data.data() + 16, &VP, sizeof(VP));
+	std::memcpy(data.data() + 80, zNearFar, sizeof(zNearFar));
+	const uint32_t zero = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const uint32_t index = outputIndices != nullptr ? outputIndices[i] : i;
+		uint8_t* candidate = data.data() + GPUCULLING_BOXES_HEADER_SIZE + i * GPUCULLING_CANDIDATE_STRIDE;
+		std::memcpy(candidate, &boxes[i]._min, sizeof(boxes[i]._min));
+		std::memcpy(candidate + 12, &index, sizeof(index));
+		std::memcpy(candidate + 16, &boxes[i]._max, sizeof(boxes[i]._max));
+		std::memcpy(candidate + 28, &zero, sizeof(zero));
+	}
+
+	GPUBuffer& input = gpuCullingBoxesInput[cmd];
+	if (!input.IsValid() || input.GetDesc().ByteWidth < data.size())
+	{
+		GPUBufferDesc desc;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_SHADER_RESOURCE;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		desc.ByteWidth = uint32_t(data.size() * 2);
+		device->CreateBuffer(&desc, nullptr, &input);
+		device->SetName(&input, "gpuCullingBoxes.input");
+	}
+	device->UpdateBuffer(&input, data.data(), cmd, (int)data.size());
+
+	device->BindComputeShader(&shaders[CSTYPE_GPUCULLING_BOXES], cmd);
+	device->BindResource(CS, &input, GPUCULLINGSLOT_IN_INPUT, cmd);
+	device->BindResource(CS, hiz != nullptr ? hiz : wiTextureHelper::getWhite(), GPUCULLINGSLOT_IN_HIZ, cmd);
+	const GPUResource* uavs[] = {
+		&output,
+	};
+	device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+	{
+		GPUBarrier barriers[] = {
+			GPUBarrier::Buffer(&output, BUFFER_STATE_SHADER_RESOURCE, BUFFER_STATE_UNORDERED_ACCESS),
+		};
+		device->Barrier(barriers, arraysize(barriers), cmd);
+	}
+
+	device->Dispatch((count + GPUCULLING_THREADCOUNT - 1) / GPUCULLING_THREADCOUNT, 1, 1, cmd);
+
+	{
+		GPUBarrier barriers[] = {
+			GPUBarrier::Memory(),
+			GPUBarrier::Buffer(&output, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE),
+		};
+		device->Barrier(barriers, arraysize(barriers), cmd);
+	}
+	device->UnbindUAVs(0, arraysize(uavs), cmd);
+
+	device->EventEnd(cmd);
+}
+
+GPUBuffer instanceCullingInput[COMMANDLIST_COUNT];
+std::vector<uint8_t> instanceCullingData[COMMANDLIST_COUNT];
+void InstanceCulling(
+	const AABB* instances,
+	uint32_t instanceCount,
+	const InstanceCullingLOD* lods,
+	uint32_t lodCount,
+	const InstanceCullingView* views,
+	uint32_t viewCount,
+	uint32_t occlusionView,
+	InstanceCullingResult& result,
+	CommandList cmd
+)
+{
+	assert(lodCount <= INSTANCECULLING_MAX_LODS);
+	assert(viewCount <= INSTANCECULLING_MAX_VIEWS);
+	lodCount = std::min(lodCount, (uint32_t)INSTANCECULLING_MAX_LODS);
+	viewCount = std::min(viewCount, (uint32_t)INSTANCECULLING_MAX_VIEWS);
+	result.instanceCount = instanceCount;
+	result.viewCount = viewCount;
+	result.lodCount = lodCount;
+	const uint32_t drawCount = viewCount * lodCount;
+	if (instanceCount == 0 || drawCount == 0)
+	{
+		return;
+	}
+
+	device->EventBegin("InstanceCulling", cmd);
+
+	XMFLOAT4X4 VP = IDENTITYMATRIX;
+	float zNearP = 0;
+	float zFarP = 0;
+	const Texture* hiz = GetGPUCullingHiZ(VP, zNearP, zFarP);
+	if (hiz == nullptr)
+	{
+		occlusionView = ~0u;
+	}
+
+	std::vector<uint8_t>& data = instanceCullingData[cmd];
+	data.resize(INSTANCECULLING_HEADER_SIZE + instanceCount * GPUCULLING_CANDIDATE_STRIDE);
+	std::memset(data.data(), 0, INSTANCECULLING_HEADER_SIZE);
+	const uint32_t header[] = { instanceCount, viewCount, lodCount, occlusionView };
+	const float zNearFar[] = { zNearP, zFarP, 0, 0 };
+	std::memcpy(data.data(), header, sizeof(header));
+	std::memcpy(data.data() + 16, &VP, sizeof(VP));
+	std::memcpy(data.data() + 80, zNearFar, sizeof(zNearFar));
+	for (uint32_t i = 0; i < lodCount; ++i)
+	{
+		uint8_t* lod = data.data() + INSTANCECULLING_LODS_OFFSET + i * 16;
+		std::memcpy(lod, &lods[i].distance, sizeof(float));
+		std::memcpy(lod + 4, &lods[i].indexCount, sizeof(uint32_t));
+		std::memcpy(lod + 8, &lods[i].indexOffset, sizeof(uint32_t));
+	}
+	for (uint32_t i = 0; i < viewCount; ++i)
+	{
+		uint8_t* view = data.data() + INSTANCECULLING_VIEWS_OFFSET + i * INSTANCECULLING_VIEW_STRIDE;
+		std::memcpy(view, views[i].frustum.planes, sizeof(views[i].frustum.planes));
+		std::memcpy(view + 96, &views[i].position, sizeof(views[i].position));
+	}
+	for (uint32_t i = 0; i < instanceCount; ++i)
+	{
+		uint8_t* candidate = data.data() + INSTANCECULLING_HEADER_SIZE + i * GPUCULLING_CANDIDATE_STRIDE;
+		std::memcpy(candidate, &instances[i]._min, sizeof(instances[i]._min));
+		std::memset(candidate + 12, 0, sizeof(uint32_t));
+		std::memcpy(candidate + 16, &instances[i]._max, sizeof(instances[i]._max));
+		std::memset(candidate + 28, 0, sizeof(uint32_t));
+	}
+
+	GPUBuffer& input = instanceCullingInput[cmd];
+	if (!input.IsValid() || input.GetDesc().ByteWidth < data.size())
+	{
+		GPUBufferDesc desc;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_SHADER_RESOURCE;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		desc.ByteWidth = uint32_t(data.size() * 2);
+		device->CreateBuffer(&desc, nullptr, &input);
+		device->SetName(&input, "instanceCulling.input");
+	}
+	device->UpdateBuffer(&input, data.data(), cmd, (int)data.size());
+
+	if (!result.args.IsValid() || result.args.GetDesc().ByteWidth < drawCount * GPUCULLING_ARGS_STRIDE)
+	{
+		GPUBufferDesc desc;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_UNORDERED_ACCESS;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS | RESOURCE_MISC_INDIRECT_ARGS;
+		desc.ByteWidth = INSTANCECULLING_MAX_VIEWS * INSTANCECULLING_MAX_LODS * GPUCULLING_ARGS_STRIDE;
+		device->CreateBuffer(&desc, nullptr, &result.args);
+		device->SetName(&result.args, "instanceCulling.args");
+	}
+	if (!result.visible.IsValid() || result.visible.GetDesc().ByteWidth < drawCount * instanceCount * sizeof(uint32_t))
+	{
+		GPUBufferDesc desc;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS | BIND_VERTEX_BUFFER;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		desc.ByteWidth = uint32_t(drawCount * instanceCount * sizeof(uint32_t) * 2);
+		device->CreateBuffer(&desc, nullptr, &result.visible);
+		device->SetName(&result.visible, "instanceCulling.visible");
+	}
+
+	device->BindComputeShader(&shaders[CSTYPE_INSTANCECULLING], cmd);
+	device->BindResource(CS, &input, GPUCULLINGSLOT_IN_INPUT, cmd);
+	device->BindResource(CS, hiz != nullptr ? hiz : wiTextureHelper::getWhite(), GPUCULLINGSLOT_IN_HIZ, cmd);
+	const GPUResource* uavs[] = {
+		&result.args,
+		&result.visible,
+	};
+	device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
 	{
-		device->BindResource(PS, &vis.scene->weather.skyMap->texture, TEXSLOT_GLOBALENVMAP, cmd);
+		GPUBarrier barriers[] = {
+			GPUBarrier::Buffer(&result.args, BUFFER_STATE_INDIRECT_ARGUMENT, BUFFER_STATE_UNORDERED_ACCESS),
+			GPUBarrier::Buffer(&result.visible, BUFFER_STATE_SHADER_RESOURCE, BUFFER_STATE_UNORDERED_ACCESS),
+		};
+		device->Barrier(barriers, arraysize(barriers), cmd);
 	}
 
-	device->BindResource(PS, &vis.scene->lightmap, TEXSLOT_GLOBALLIGHTMAP, cmd);
-	if (vis.scene->decalAtlas.IsValid())
+	// The args are reset by a first dispatch, because the culling threads of every view append to them:
+	MiscCB cb;
+	cb.g_xColor = XMFLOAT4(0, 0, 0, 0);
+	device->UpdateBuffer(&constantBuffers[CBTYPE_MISC], &cb, cmd);
+	device->BindConstantBuffer(CS, &constantBuffers[CBTYPE_MISC], CB_GETBINDSLOT(MiscCB), cmd);
+	device->Dispatch((drawCount + GPUCULLING_THREADCOUNT - 1) / GPUCULLING_THREADCOUNT, 1, 1, cmd);
+
 	{
-		device->BindResource(PS, &vis.scene->decalAtlas, TEXSLOT_DECALATLAS, cmd);
+		GPUBarrier barriers[] = {
+			GPUBarrier::Memory(),
+		};
+		device->Barrier(barriers, arraysize(barriers), cmd);
 	}
 
-	if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_PIPELINE) || device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
+	cb.g_xColor = XMFLOAT4(1, 0, 0, 0);
+	device->UpdateBuffer(&constantBuffers[CBTYPE_MISC], &cb, cmd);
+	device->Dispatch((instanceCount + GPUCULLING_THREADCOUNT - 1) / GPUCULLING_THREADCOUNT, 1, 1, cmd);
+
 	{
-		device->BindResource(PS, &vis.scene->TLAS, TEXSLOT_ACCELERATION_STRUCTURE, cmd);
-		device->BindResource(CS, &vis.scene->TLAS, TEXSLOT_ACCELERATION_STRUCTURE, cmd);
+		GPUBarrier barriers[] = {
+			GPUBarrier::Memory(),
+			GPUBarrier::Buffer(&result.args, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_INDIRECT_ARGUMENT),
+			GPUBarrier::Buffer(&result.visible, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE),
+		};
+		device->Barrier(barriers, arraysize(barriers), cmd);
 	}
+	device->UnbindUAVs(0, arraysize(uavs), cmd);
+	device->UnbindResources(GPUCULLINGSLOT_IN_INPUT, 2, cmd);
+
+	device->EventEnd(cmd);
+}
 
 #ifdef GGREDUCED
-	if (!g_bNoTerrainRender)
+GPUBuffer terrainChunkVisibility;
+void GPUCulling_TerrainChunks(const CameraComponent& camera, const Texture* lineardepth, CommandList cmd)
+{
+	if (!terrainChunkGPUCulling || !bEnableTerrainChunkCulling)
 	{
-		if (ocean && vis.scene->weather.IsOceanEnabled() )
-		{
-			vis.scene->ocean.Render(*vis.camera, vis.scene->weather.oceanParameters, cmd);
-		}
+		return;
 	}
-#else
-	if (ocean && vis.scene->weather.IsOceanEnabled())
+
+	if (!terrainChunkVisibility.IsValid())
 	{
-		vis.scene->ocean.Render(*vis.camera, vis.scene->weather.oceanParameters, cmd);
+		// Every chunk is visible until it is tested:
+		std::vector<uint32_t> visible(TERRAIN_CHUNK_LODS * TERRAIN_CHUNKS_PER_LOD, 1);
+		GPUBufferDesc desc;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		desc.ByteWidth = uint32_t(visible.size() * sizeof(uint32_t));
+		SubresourceData initdata;
+		initdata.pSysMem = visible.data();
+		device->CreateBuffer(&desc, &initdata, &terrainChunkVisibility);
+		device->SetName(&terrainChunkVisibility, "terrainChunkVisibility");
 	}
-#endif
 
-	if (hairparticle)
+	// The Hi-Z is built from the depth prepass of this frame when the GPU culling of the objects didn't build it already:
+	const uint64_t frame = device->GetFrameCount();
+	if (lineardepth != nullptr && gpuCullingHiZCamera.frame != frame)
 	{
-		if (!transparent)
+		device->EventBegin("GPUCulling_TerrainChunks Hi-Z", cmd);
+		GPUCulling_BuildHiZ(camera, *lineardepth, cmd);
+		device->EventEnd(cmd);
+	}
+
+	// Only the chunks that GGTerrain selected for drawing are tested, the others are not drawn anyway:
+	AABB boxes[TERRAIN_CHUNK_LODS * TERRAIN_CHUNKS_PER_LOD];
+	uint32_t indices[TERRAIN_CHUNK_LODS * TERRAIN_CHUNKS_PER_LOD];
+	uint32_t count = 0;
+	const uint32_t lodstart = GGTerrain::GetChunkLodStart();
+	for (uint32_t lod = lodstart; lod < TERRAIN_CHUNK_LODS; lod++)
+	{
+		for (uint32_t i = 0; i < TERRAIN_CHUNKS_PER_LOD; i++)
 		{
-			for (uint32_t hairIndex : vis.visibleHairs)
+			const TerrainChunkOcclusion* pTCO = GGTerrain::GetChunkVisibleMem(lod, i);
+			if (pTCO && pTCO->bChunkVisible)
 			{
-				const wiHairParticle& hair = vis.scene->hairs[hairIndex];
-				Entity entity = vis.scene->hairs.GetEntity(hairIndex);
-				const MaterialComponent& material = *vis.scene->materials.GetComponent(entity);
-
-				hair.Draw(*vis.camera, material, renderPass, cmd);
+				boxes[count] = pTCO->aabb;
+				indices[count] = lod * TERRAIN_CHUNKS_PER_LOD + i;
+				count++;
 			}
 		}
 	}
 
-	if (IsWireRender() && !transparent)
-		return;
-
-	RenderImpostors(vis, renderPass, cmd);
+	GPUCulling_Boxes(boxes, count, terrainChunkVisibility, cmd, indices);
+}
+const GPUBuffer* GetTerrainChunkVisibility()
+{
+	return terrainChunkGPUCulling && terrainChunkVisibility.IsValid() ? &terrainChunkVisibility : nullptr;
+}
 
-	uint32_t renderTypeFlags = 0;
-	if (opaque)
-	{
-		renderTypeFlags |= RENDERTYPE_OPAQUE;
-	}
-	if (transparent)
+void PrepareTreeCulling(const Visibility& vis, const CameraComponent* camera_reflection, CommandList cmd)
+{
+	// A frustum that contains nothing, for the views that are not drawn in this frame:
+	Frustum empty;
+	for (auto& plane : empty.planes)
 	{
-		renderTypeFlags |= RENDERTYPE_TRANSPARENT;
-		renderTypeFlags |= RENDERTYPE_WATER;
+		plane = XMFLOAT4(0, 0, 0, -1);
 	}
-	if (reflections)
+
+	InstanceCullingView views[TREECULLING_VIEW_COUNT];
+	for (auto& view : views)
 	{
-		renderTypeFlags |= RENDERTYPE_REFLECTIONS;
+		view.frustum = empty;
+		view.position = vis.camera->Eye;
 	}
-	if (IsWireRender())
+	views[TREECULLING_VIEW_MAIN].frustum = vis.camera->frustum;
+	if (camera_reflection != nullptr && vis.IsRequestedPlanarReflections())
 	{
-		renderTypeFlags = RENDERTYPE_ALL;
+		views[TREECULLING_VIEW_REFLECTION].frustum = camera_reflection->frustum;
+		views[TREECULLING_VIEW_REFLECTION].position = camera_reflection->Eye;
 	}
 
-	RenderQueue renderQueue;
-	for (uint32_t instanceIndex : vis.visibleObjects)
+	// The cascades of the first directional light that has shadow slices, as they will be drawn by DrawShadowmaps():
+	for (size_t slice = 0; slice + CASCADE_COUNT <= shadowCascades.size(); slice += CASCADE_COUNT)
 	{
-		ObjectComponent& object = (ObjectComponent&)vis.scene->objects[instanceIndex]; // GGREDUCED was const
-
-		if (occlusion && object.IsOccluded() && bEnableObjectCulling)
+		const LightComponent* light = vis.scene->lights.GetComponent(shadowCascades[slice].light);
+		if (light == nullptr || light->GetType() != LightComponent::DIRECTIONAL)
+		{
 			continue;
-
-		if (object.IsRenderable() && (object.GetRenderTypes() & renderTypeFlags))
+		}
+		for (uint32_t cascade = 0; cascade < 3 && cascade < CASCADE_COUNT; ++cascade)
 		{
-			float distance = wiMath::Distance(vis.camera->Eye, object.center); // GGREDUCED was const
-			if (object.IsImpostorPlacement() && distance > object.impostorSwapDistance + object.impostorFadeThresholdRadius)
-			{
-				continue;
-			}
-
-#ifdef GGREDUCED
-			if (renderPass == RENDERPASS_MAIN)
+			const ShadowCascade& state = shadowCascades[slice + cascade];
+			if (state.update != SHADOWCASCADE_UPDATE_KEEP)
 			{
-				object.SetCameraDistance(distance);
+				views[TREECULLING_VIEW_SHADOWCASCADE0 + cascade].frustum = state.frustum;
 			}
-			// LB: introduce a distance bias so that two transparent objects
-			// sharing the same space can set a priority of one over the other
-			distance = distance + object.GetRenderOrderBiasDistance();
-#endif
-
-			RenderBatch* batch = (RenderBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(RenderBatch));
-			//size_t meshIndex = vis.scene->meshes.GetIndex(object.meshID);
-			//batch->Create(meshIndex, instanceIndex, distance);
-
-			//PE: LOD objects that are in LOD mode need there own batches.
-			batch->Create(object.mesh_index, instanceIndex, distance, object.IsRenderLOD(),object.activelod);
-			renderQueue.add(batch);
-		}
-	}
-	if (!renderQueue.empty())
-	{
-#ifdef GGREDUCED
-		//PE: renderQueue.sort is not using distance but meshIndex<<8 , dist&0xff, so order of transparent mesh'es was not correct.
-		//LB: I can still trick the order with 2 transparent puddles, move 2nd slightly higher and further away than the 1st and it renders the 2nd FIRST, even though it should be rendered LAST as it is still on top
-		//PE: It already sort distance from camera to center of the object, so we cant really improve this.
-		//PE: Its a issue in all engines that cant be fixed by code. We could add a sort distance bias so user decide, but thats it.
-		//PE: Translucency Sort Priority : https://docs.unrealengine.com/en-US/RenderingAndGraphics/Materials/HowTo/Transparency/index.html
-		//PE: https://www.khronos.org/opengl/wiki/Transparency_Sorting
-
-		//if (transparent)
-		//	renderQueue.sortdistance(RenderQueue::SORT_BACK_TO_FRONT);
-		//else
-		//	renderQueue.sort(RenderQueue::SORT_FRONT_TO_BACK);
-
-		//PE: https://github.com/turanszkij/WickedEngine/commit/f49ecdb60e40decb4eb559f986458f68a5c93cbf
-		//PE: Sorting only needed for transparent and prepass.
-		if (transparent)
-		{
-			renderQueue.sortdistance(RenderQueue::SORT_BACK_TO_FRONT);
 		}
-		else
-		{
-			renderQueue.sort(RenderQueue::SORT_FRONT_TO_BACK);
-		}
-		//else if (renderPass == RENDERPASS_PREPASS)
-		//{
-		//	renderQueue.sort(RenderQueue::SORT_FRONT_TO_BACK);
-		//}
-#else
-		renderQueue.sort(transparent ? RenderQueue::SORT_BACK_TO_FRONT : RenderQueue::SORT_FRONT_TO_BACK);
-#endif
-		RenderMeshes(vis, renderQueue, renderPass, renderTypeFlags, cmd, tessellation);
-
-		GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * renderQueue.batchCount);
+		break;
 	}
 
-	device->BindShadingRate(SHADING_RATE_1X1, cmd);
-	device->EventEnd(cmd);
+	GGTrees::GGTrees_Cull(views, TREECULLING_VIEW_COUNT, TREECULLING_VIEW_MAIN, cmd);
 }
+#endif // GGREDUCED
 
 
 void DrawDebugWorld(
@@ -7750,7 +11469,7 @@ void DrawDebugWorld(
 
 
 		MiscCB sb;
-		XMStoreFloat4x4(&sb.g_xTransform, XMMatrixTranslationFromVector(XMLoadFloat3(&voxelSceneData.center)) * camera.GetViewProjection());
+		XMStoreFloat4x4(&sb.g_xTransform, camera.GetViewProjection());
 		sb.g_xColor = float4(1, 1, 1, 1);
 
 		device->UpdateBuffer(&constantBuffers[CBTYPE_MISC], &sb, cmd);
@@ -7758,7 +11477,7 @@ void DrawDebugWorld(
 		device->BindConstantBuffer(GS, &constantBuffers[CBTYPE_MISC], CB_GETBINDSLOT(MiscCB), cmd);
 		device->BindConstantBuffer(PS, &constantBuffers[CBTYPE_MISC], CB_GETBINDSLOT(MiscCB), cmd);
 
-		device->Draw(voxelSceneData.res * voxelSceneData.res * voxelSceneData.res, 0, cmd);
+		device->Draw(voxelSceneData.res * voxelSceneData.res * voxelSceneData.res * VOXEL_GI_CLIPMAP_COUNT, 0, cmd);
 
 		device->EventEnd(cmd);
 	}
@@ -7808,7 +11527,7 @@ void DrawDebugWorld(
 				device->BindVertexBuffers(vbs, 0, arraysize(vbs), strides, nullptr, cmd);
 				device->BindIndexBuffer(&mesh->indexBuffer, mesh->GetIndexFormat(), 0, cmd);
 
-				device->DrawIndexed((uint32_t)mesh->indices.size(), 0, 0, cmd);
+				device->DrawIndexed((uint32_t)mesh->GetIndexCount(), 0, 0, cmd);
 			}
 		}
 
@@ -7836,10 +11555,11 @@ void DrawDebugWorld(
 			if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS))
 			{
 				ObjectPushConstants push;
-				push.material = device->GetDescriptorIndex(&material.constantBuffer, SRV);
+				push.material = (int)scene.materials.GetIndex(subset.materialID);
 				push.mesh = device->GetDescriptorIndex(&mesh.descriptor, SRV);
 				push.instances = device->GetDescriptorIndex(mem.buffer, SRV);
 				push.instance_offset = mem.offset;
+				push.instance_table = -1;
 				device->PushConstants(&push, sizeof(push), cmd);
 			}
 			else
@@ -7977,12 +11697,74 @@ void DrawDebugWorld(
 }
 
 
+// The inputs of the atmospheric scattering LUTs, the LUTs are only rendered again when these change:
+struct AtmosphericScatteringInputs
+{
+	size_t atmosphere_hash = 0; // transmittance and multi-scattering
+	size_t sun_hash = 0; // sky luminance and sky view, with the atmosphere
+	XMFLOAT3 sunDirection = XMFLOAT3(0, 0, 0);
+	XMFLOAT3 cameraPosition = XMFLOAT3(0, 0, 0); // sky view
+};
+AtmosphericScatteringInputs atmosphericScatteringInputs; // of the current frame
+AtmosphericScatteringInputs atmosphericScatteringRendered; // of the current LUT contents
+bool atmosphericScatteringValid = false;
+bool atmosphericScatteringSkyViewValid = false;
+uint64_t atmosphericScatteringSkyViewFrame = 0;
+
+template<typename T>
+static void HashWords(size_t& hash, const T& value)
+{
+	static_assert(sizeof(T) % sizeof(uint32_t) == 0, "hashed by 32 bit words");
+	const uint32_t* words = (const uint32_t*)&value;
+	for (size_t i = 0; i < sizeof(T) / sizeof(uint32_t); ++i)
+	{
+		wiHelper::hash_combine(hash, words[i]);
+	}
+}
+void SetAtmosphericScatteringInputs(const FrameCB& frameCB, const XMFLOAT3& cameraPosition)
+{
+	AtmosphericScatteringInputs& inputs = atmosphericScatteringInputs;
+	inputs.atmosphere_hash = 0;
+	HashWords(inputs.atmosphere_hash, frameCB.g_xFrame_Atmosphere);
+	inputs.sun_hash = inputs.atmosphere_hash;
+	HashWords(inputs.sun_hash, frameCB.g_xFrame_SunColor);
+	HashWords(inputs.sun_hash, frameCB.g_xFrame_SunDirection);
+	HashWords(inputs.sun_hash, frameCB.g_xFrame_SunEnergy);
+	inputs.sunDirection = frameCB.g_xFrame_SunDirection;
+	inputs.cameraPosition = cameraPosition;
+}
+
+static void RenderSkyViewLUT(CommandList cmd);
 void RenderAtmosphericScatteringTextures(CommandList cmd)
 {
+	const AtmosphericScatteringInputs& inputs = atmosphericScatteringInputs;
+	AtmosphericScatteringInputs& rendered = atmosphericScatteringRendered;
+	const bool atmosphere_changed = !atmosphericScatteringValid || inputs.atmosphere_hash != rendered.atmosphere_hash;
+	const bool sun_changed = atmosphere_changed || inputs.sun_hash != rendered.sun_hash;
+
+	// A slowly moving sun only updates the sky view every few frames, unless it has turned noticeably (0.25 degrees) since the last update.
+	//	The camera is compared with a large distance, because the sky only changes with the altitude on the planet scale:
+	const uint64_t frame = device->GetFrameCount();
+	const float sun_turn = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&inputs.sunDirection), XMLoadFloat3(&rendered.sunDirection)));
+	const bool sun_moved_slowly = !atmosphere_changed && inputs.sun_hash != rendered.sun_hash && sun_turn > 0.99999f;
+	const bool skyview_changed =
+		!atmosphericScatteringSkyViewValid ||
+		(sun_changed && (!sun_moved_slowly || frame >= atmosphericScatteringSkyViewFrame + 8)) ||
+		wiMath::Distance(inputs.cameraPosition, rendered.cameraPosition) > 100.0f;
+	if (!sun_changed && !skyview_changed)
+	{
+		return;
+	}
+	if (sun_moved_slowly && !skyview_changed)
+	{
+		return; // the sky luminance waits for the sky view, so that both reflect the same sun
+	}
+
 	device->EventBegin("ComputeAtmosphericScatteringTextures", cmd);
 	auto range = wiProfiler::BeginRangeGPU("Atmospheric Scattering Textures", cmd);
 
 	// Transmittance Lut pass:
+	if (atmosphere_changed)
 	{
 		device->EventBegin("TransmittanceLut", cmd);
 		device->BindComputeShader(&shaders[CSTYPE_SKYATMOSPHERE_TRANSMITTANCELUT], cmd);
@@ -8023,6 +11805,7 @@ void RenderAtmosphericScatteringTextures(CommandList cmd)
 	}
 
 	// MultiScattered Luminance Lut pass:
+	if (atmosphere_changed)
 	{
 		device->EventBegin("MultiScatteredLuminanceLut", cmd);
 		device->BindComputeShader(&shaders[CSTYPE_SKYATMOSPHERE_MULTISCATTEREDLUMINANCELUT], cmd);
@@ -8061,6 +11844,7 @@ void RenderAtmosphericScatteringTextures(CommandList cmd)
 	}
 
 	// Environment Luminance Lut pass:
+	if (sun_changed)
 	{
 		device->EventBegin("EnvironmentLuminanceLut", cmd);
 		device->BindComputeShader(&shaders[CSTYPE_SKYATMOSPHERE_SKYLUMINANCELUT], cmd);
@@ -8099,11 +11883,27 @@ void RenderAtmosphericScatteringTextures(CommandList cmd)
 
 	device->EventEnd(cmd);
 
-	RefreshAtmosphericScatteringTextures(cmd);
+	if (skyview_changed)
+	{
+		RenderSkyViewLUT(cmd);
+		atmosphericScatteringSkyViewValid = true;
+		atmosphericScatteringSkyViewFrame = frame;
+		rendered.cameraPosition = inputs.cameraPosition;
+		rendered.sunDirection = inputs.sunDirection;
+	}
+	rendered.atmosphere_hash = inputs.atmosphere_hash;
+	rendered.sun_hash = inputs.sun_hash;
+	atmosphericScatteringValid = true;
 
 	wiProfiler::EndRange(range);
 }
 void RefreshAtmosphericScatteringTextures(CommandList cmd)
+{
+	// The sky view is rendered for the bound camera (eg. an environment probe), so it's rendered again for the main camera in the next frame:
+	RenderSkyViewLUT(cmd);
+	atmosphericScatteringSkyViewValid = false;
+}
+static void RenderSkyViewLUT(CommandList cmd)
 {
 	device->EventBegin("UpdateAtmosphericScatteringTextures", cmd);
 
@@ -8210,6 +12010,33 @@ void DrawSun(CommandList cmd)
 }
 
 
+// Environment probe refresh is split into steps that can be spread over multiple frames:
+//	rendering of the cube faces (a face is one step), the mip chain generation (one step), and the filtering of every mip level (one step per mip)
+//	The probe that was started first is finished first, the rest of the queue is ordered by the distance to the camera
+enum ENVPROBE_REFRESH_STEP
+{
+	ENVPROBE_REFRESH_STEP_FACE,
+	ENVPROBE_REFRESH_STEP_MIPCHAIN,
+	ENVPROBE_REFRESH_STEP_FILTER,
+	ENVPROBE_REFRESH_STEP_COUNT
+};
+struct EnvProbeRefreshJob
+{
+	Entity entity = INVALID_ENTITY;
+	const void* envmapArray = nullptr; // the array is recreated when the probe count or resolution changes
+	int textureIndex = -1;
+	uint32_t face = 0; // the next face to render, all faces are done at 6
+	bool mipchain = false;
+	uint32_t filter = 0; // the count of filtered mips, starting from the smallest one
+	float distance = 0;
+
+	inline bool IsStarted() const { return face > 0; }
+};
+std::vector<EnvProbeRefreshJob> envProbeRefreshQueue;
+uint32_t envProbeRefreshBudgetSteps = 0;
+float envProbeRefreshBudgetMilliseconds = 0;
+float envProbeRefreshStepCost[ENVPROBE_REFRESH_STEP_COUNT] = {}; // running average of the measured CPU time of a step
+EnvProbeRefreshStatistics envProbeRefreshStatistics;
 void RefreshEnvProbes(const Visibility& vis, CommandList cmd)
 {
 	if (!vis.scene->envmapArray.IsValid())
@@ -8228,7 +12055,10 @@ void RefreshEnvProbes(const Visibility& vis, CommandList cmd)
 	if (zNearP <= 0 || zFarP <= 0) return;
 #endif
 
-	auto render_probe = [&](const EnvironmentProbeComponent& probe, const AABB& probe_aabb) {
+	device->EventBegin("EnvironmentProbe Refresh", cmd);
+
+	// Renders the faces [firstFace, firstFace + faceCount) of the probe cubemap, the other faces are kept:
+	auto render_faces = [&](const EnvironmentProbeComponent& probe, const AABB& probe_aabb, uint32_t firstFace, uint32_t faceCount) {
 
 		const SHCAM cameras[] = {
 			SHCAM(probe.position, XMFLOAT4(0.5f, -0.5f, -0.5f, -0.5f), zNearP, zFarP, XM_PIDIV2), //+x
@@ -8238,14 +12068,16 @@ void RefreshEnvProbes(const Visibility& vis, CommandList cmd)
 			SHCAM(probe.position, XMFLOAT4(0.707f, 0, 0, -0.707f), zNearP, zFarP, XM_PIDIV2), //+z
 			SHCAM(probe.position, XMFLOAT4(0, 0.707f, 0.707f, 0), zNearP, zFarP, XM_PIDIV2), //-z
 		};
+		assert(firstFace + faceCount <= arraysize(cameras));
 		Frustum frusta[arraysize(cameras)];
 
 		CubemapRenderCB cb;
-		for (uint32_t i = 0; i < arraysize(cameras); ++i)
+		for (uint32_t i = 0; i < faceCount; ++i)
 		{
-			frusta[i] = cameras[i].frustum;
-			XMStoreFloat4x4(&cb.xCubemapRenderCams[i].VP, cameras[i].VP);
-			cb.xCubemapRenderCams[i].properties = uint4(i, 0, 0, 0);
+			const uint32_t face = firstFace + i;
+			frusta[i] = cameras[face].frustum;
+			XMStoreFloat4x4(&cb.xCubemapRenderCams[i].VP, cameras[face].VP);
+			cb.xCubemapRenderCams[i].properties = uint4(face, 0, 0, 0);
 		}
 
 		device->UpdateBuffer(&constantBuffers[CBTYPE_CUBEMAPRENDER], &cb, cmd);
@@ -8268,7 +12100,14 @@ void RefreshEnvProbes(const Visibility& vis, CommandList cmd)
 		device->BindResource(PS, &textures[TEXTYPE_2D_SKYATMOSPHERE_SKYLUMINANCELUT], TEXSLOT_SKYLUMINANCELUT, cmd);
 
 
-		device->RenderPassBegin(&vis.scene->renderpasses_envmap[probe.textureIndex], cmd);
+		if (faceCount == arraysize(cameras))
+		{
+			device->RenderPassBegin(&vis.scene->renderpasses_envmap[probe.textureIndex], cmd);
+		}
+		else
+		{
+			device->RenderPassBegin(&vis.scene->renderpasses_envmap_load[probe.textureIndex], cmd);
+		}
 
 		// Scene will only be rendered if this is a real probe entity:
 		if (probe_aabb.layerMask & vis.layerMask)
@@ -8306,7 +12145,7 @@ void RefreshEnvProbes(const Visibility& vis, CommandList cmd)
 				if ( apparentSize > fCullFromEnvMapObjectsAtDistanceThreshold && (aabb.layerMask & vis.layerMask) && (aabb.layerMask & probe_aabb.layerMask) && culler.intersects(aabb))
 				{
 					const ObjectComponent& object = vis.scene->objects[i];
-					if (object.IsRenderable())
+					if (object.IsRenderable() && !object.IsHLODCulled())
 					{
 						RenderBatch* batch = (RenderBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(RenderBatch));
 						//size_t meshIndex = vis.scene->meshes.GetIndex(object.meshID);
@@ -8320,12 +12159,12 @@ void RefreshEnvProbes(const Visibility& vis, CommandList cmd)
 			BindShadowmaps(PS, cmd);
 			device->BindResource(PS, &vis.scene->lightmap, TEXSLOT_GLOBALLIGHTMAP, cmd);
 
-			GGTerrain::GGTerrain_Draw_EnvProbe( &culler, frusta, arraysize(frusta), cmd );
-			GGTrees::GGTrees_Draw_EnvProbe( &culler, frusta, arraysize(frusta), cmd );
+			GGTerrain::GGTerrain_Draw_EnvProbe( &culler, frusta, faceCount, cmd );
+			GGTrees::GGTrees_Draw_EnvProbe( &culler, frusta, faceCount, cmd );
 
 			if (!renderQueue.empty())
 			{
-				RenderMeshes(vis, renderQueue, RENDERPASS_ENVMAPCAPTURE, RENDERTYPE_ALL, cmd, false, frusta, arraysize(frusta));
+				RenderMeshes(vis, renderQueue, RENDERPASS_ENVMAPCAPTURE, RENDERTYPE_ALL, cmd, false, frusta, faceCount);
 
 				GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * renderQueue.batchCount);
 			}
@@ -8343,117 +12182,293 @@ void RefreshEnvProbes(const Visibility& vis, CommandList cmd)
 				device->BindPipelineState(&PSO_sky[SKYRENDERING_ENVMAPCAPTURE_DYNAMIC], cmd);
 			}
 
-			device->DrawInstanced(240, 6, 0, 0, cmd); // 6 instances so it will be replicated for every cubemap face
+			device->DrawInstanced(240, faceCount, 0, 0, cmd); // an instance for every rendered cubemap face
 		}
 
 		device->RenderPassEnd(cmd);
+	};
 
+	auto generate_mipchain = [&](const EnvironmentProbeComponent& probe) {
 		MIPGEN_OPTIONS mipopt;
 		mipopt.arrayIndex = probe.textureIndex;
 		GenerateMipChain(vis.scene->envmapArray, MIPGENFILTER_LINEAR, cmd, mipopt);
+	};
 
-		// Filter the enviroment map mip chain according to BRDF:
-		//	A bit similar to MIP chain generation, but its input is the MIP-mapped texture,
-		//	and we generatethe filtered MIPs from bottom to top.
+	// Filter the enviroment map mip chain according to BRDF:
+	//	A bit similar to MIP chain generation, but its input is the MIP-mapped texture,
+	//	and we generatethe filtered MIPs from bottom to top.
+	//	A mip is filtered from the (not yet filtered) mip two levels above it, so they must be processed from the smallest mip
+	auto filter_mip = [&](const EnvironmentProbeComponent& probe, uint32_t i) {
 		device->EventBegin("FilterEnvMap", cmd);
 		{
-			TextureDesc desc = vis.scene->envmapArray.GetDesc();
+			const TextureDesc& desc = vis.scene->envmapArray.GetDesc();
 			int arrayIndex = probe.textureIndex;
 
 			device->BindComputeShader(&shaders[CSTYPE_FILTERENVMAP], cmd);
 
-			desc.Width = 1;
-			desc.Height = 1;
-			for (uint32_t i = desc.MipLevels - 1; i > 0; --i)
 			{
-				{
-					GPUBarrier barriers[] = {
-						GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_SHADER_RESOURCE, IMAGE_LAYOUT_UNORDERED_ACCESS, i, arrayIndex * 6 + 0),
-						GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_SHADER_RESOURCE, IMAGE_LAYOUT_UNORDERED_ACCESS, i, arrayIndex * 6 + 1),
-						GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_SHADER_RESOURCE, IMAGE_LAYOUT_UNORDERED_ACCESS, i, arrayIndex * 6 + 2),
-						GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_SHADER_RESOURCE, IMAGE_LAYOUT_UNORDERED_ACCESS, i, arrayIndex * 6 + 3),
-						GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_SHADER_RESOURCE, IMAGE_LAYOUT_UNORDERED_ACCESS, i, arrayIndex * 6 + 4),
-						GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_SHADER_RESOURCE, IMAGE_LAYOUT_UNORDERED_ACCESS, i, arrayIndex * 6 + 5),
-					};
-					device->Barrier(barriers, arraysize(barriers), cmd);
-				}
-
-				device->BindUAV(CS, &vis.scene->envmapArray, 0, cmd, i);
-				device->BindResource(CS, &vis.scene->envmapArray, TEXSLOT_ONDEMAND0, cmd, std::max(0, (int)i - 2));
+				GPUBarrier barriers[] = {
+					GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_SHADER_RESOURCE, IMAGE_LAYOUT_UNORDERED_ACCESS, i, arrayIndex * 6 + 0),
+					GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_SHADER_RESOURCE, IMAGE_LAYOUT_UNORDERED_ACCESS, i, arrayIndex * 6 + 1),
+					GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_SHADER_RESOURCE, IMAGE_LAYOUT_UNORDERED_ACCESS, i, arrayIndex * 6 + 2),
+					GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_SHADER_RESOURCE, IMAGE_LAYOUT_UNORDERED_ACCESS, i, arrayIndex * 6 + 3),
+					GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_SHADER_RESOURCE, IMAGE_LAYOUT_UNORDERED_ACCESS, i, arrayIndex * 6 + 4),
+					GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_SHADER_RESOURCE, IMAGE_LAYOUT_UNORDERED_ACCESS, i, arrayIndex * 6 + 5),
+				};
+				device->Barrier(barriers, arraysize(barriers), cmd);
+			}
 
-				FilterEnvmapCB cb;
-				cb.filterResolution.x = desc.Width;
-				cb.filterResolution.y = desc.Height;
-				cb.filterResolution_rcp.x = 1.0f / cb.filterResolution.x;
-				cb.filterResolution_rcp.y = 1.0f / cb.filterResolution.y;
-				cb.filterArrayIndex = arrayIndex;
-				cb.filterRoughness = (float)i / (float)desc.MipLevels;
-				cb.filterRayCount = 128;
-				device->UpdateBuffer(&constantBuffers[CBTYPE_FILTERENVMAP], &cb, cmd);
-				device->BindConstantBuffer(CS, &constantBuffers[CBTYPE_FILTERENVMAP], CB_GETBINDSLOT(FilterEnvmapCB), cmd);
+			device->BindUAV(CS, &vis.scene->envmapArray, 0, cmd, i);
+			device->BindResource(CS, &vis.scene->envmapArray, TEXSLOT_ONDEMAND0, cmd, std::max(0, (int)i - 2));
 
-				device->Dispatch(
-					std::max(1u, (uint32_t)ceilf((float)desc.Width / GENERATEMIPCHAIN_2D_BLOCK_SIZE)),
-					std::max(1u, (uint32_t)ceilf((float)desc.Height / GENERATEMIPCHAIN_2D_BLOCK_SIZE)),
-					6,
-					cmd);
+			FilterEnvmapCB cb;
+			cb.filterResolution.x = std::max(1u, desc.Width >> i);
+			cb.filterResolution.y = std::max(1u, desc.Height >> i);
+			cb.filterResolution_rcp.x = 1.0f / cb.filterResolution.x;
+			cb.filterResolution_rcp.y = 1.0f / cb.filterResolution.y;
+			cb.filterArrayIndex = arrayIndex;
+			cb.filterRoughness = (float)i / (float)desc.MipLevels;
+			cb.filterRayCount = 128;
+			device->UpdateBuffer(&constantBuffers[CBTYPE_FILTERENVMAP], &cb, cmd);
+			device->BindConstantBuffer(CS, &constantBuffers[CBTYPE_FILTERENVMAP], CB_GETBINDSLOT(FilterEnvmapCB), cmd);
 
-				{
-					GPUBarrier barriers[] = {
-						GPUBarrier::Memory(),
-						GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_UNORDERED_ACCESS, IMAGE_LAYOUT_SHADER_RESOURCE, i, arrayIndex * 6 + 0),
-						GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_UNORDERED_ACCESS, IMAGE_LAYOUT_SHADER_RESOURCE, i, arrayIndex * 6 + 1),
-						GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_UNORDERED_ACCESS, IMAGE_LAYOUT_SHADER_RESOURCE, i, arrayIndex * 6 + 2),
-						GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_UNORDERED_ACCESS, IMAGE_LAYOUT_SHADER_RESOURCE, i, arrayIndex * 6 + 3),
-						GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_UNORDERED_ACCESS, IMAGE_LAYOUT_SHADER_RESOURCE, i, arrayIndex * 6 + 4),
-						GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_UNORDERED_ACCESS, IMAGE_LAYOUT_SHADER_RESOURCE, i, arrayIndex * 6 + 5),
-					};
-					device->Barrier(barriers, arraysize(barriers), cmd);
-				}
+			device->Dispatch(
+				std::max(1u, (uint32_t)ceilf((float)cb.filterResolution.x / GENERATEMIPCHAIN_2D_BLOCK_SIZE)),
+				std::max(1u, (uint32_t)ceilf((float)cb.filterResolution.y / GENERATEMIPCHAIN_2D_BLOCK_SIZE)),
+				6,
+				cmd);
 
-				desc.Width *= 2;
-				desc.Height *= 2;
+			{
+				GPUBarrier barriers[] = {
+					GPUBarrier::Memory(),
+					GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_UNORDERED_ACCESS, IMAGE_LAYOUT_SHADER_RESOURCE, i, arrayIndex * 6 + 0),
+					GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_UNORDERED_ACCESS, IMAGE_LAYOUT_SHADER_RESOURCE, i, arrayIndex * 6 + 1),
+					GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_UNORDERED_ACCESS, IMAGE_LAYOUT_SHADER_RESOURCE, i, arrayIndex * 6 + 2),
+					GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_UNORDERED_ACCESS, IMAGE_LAYOUT_SHADER_RESOURCE, i, arrayIndex * 6 + 3),
+					GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_UNORDERED_ACCESS, IMAGE_LAYOUT_SHADER_RESOURCE, i, arrayIndex * 6 + 4),
+					GPUBarrier::Image(&vis.scene->envmapArray, IMAGE_LAYOUT_UNORDERED_ACCESS, IMAGE_LAYOUT_SHADER_RESOURCE, i, arrayIndex * 6 + 5),
+				};
+				device->Barrier(barriers, arraysize(barriers), cmd);
 			}
+
 			device->UnbindUAVs(0, 1, cmd);
 		}
 		device->EventEnd(cmd);
 	};
 
+	const uint32_t filterCount = vis.scene->envmapArray.desc.MipLevels - 1;
+
+	envProbeRefreshStatistics.steps = 0;
+	envProbeRefreshStatistics.completed = 0;
+	envProbeRefreshStatistics.milliseconds = 0;
+
 	if (vis.scene->probes.GetCount() == 0)
 	{
 		// In this case, there are no probes, so the sky will be rendered to first envmap:
+		envProbeRefreshQueue.clear();
+
 		EnvironmentProbeComponent probe;
 		probe.textureIndex = 0;
 		probe.position = vis.camera->Eye;
 
 		AABB probe_aabb;
 		probe_aabb.layerMask = 0;
-		render_probe(probe, probe_aabb);
+		render_faces(probe, probe_aabb, 0, 6);
+		generate_mipchain(probe);
+		for (uint32_t i = filterCount; i > 0; --i)
+		{
+			filter_mip(probe, i);
+		}
 	}
 	else
 	{
+		// Drop the jobs of probes that were removed or lost their texture:
+		envProbeRefreshQueue.erase(std::remove_if(envProbeRefreshQueue.begin(), envProbeRefreshQueue.end(), [&](const EnvProbeRefreshJob& job) {
+			const EnvironmentProbeComponent* probe = vis.scene->probes.GetComponent(job.entity);
+			return probe == nullptr || probe->textureIndex != job.textureIndex || vis.scene->envmapArray.internal_state.get() != job.envmapArray;
+		}), envProbeRefreshQueue.end());
+
+		// Queue the dirty probes, a probe that is already queued stays dirty and will be queued again after it was finished:
 		for (size_t i = 0; i < vis.scene->probes.GetCount(); ++i)
 		{
 			const EnvironmentProbeComponent& probe = vis.scene->probes[i];
 			const AABB& probe_aabb = vis.scene->aabb_probes[i];
 
-			if ((probe_aabb.layerMask & vis.layerMask) && probe.render_dirty && probe.textureIndex >= 0 && probe.textureIndex < vis.scene->envmapCount)
+			if ((probe_aabb.layerMask & vis.layerMask) && probe.render_dirty && probe.textureIndex >= 0 && probe.textureIndex < (int)vis.scene->envmapCount)
 			{
-				probe.render_dirty = false;
-				render_probe(probe, probe_aabb);
+				const Entity entity = vis.scene->probes.GetEntity(i);
+				bool queued = false;
+				for (const EnvProbeRefreshJob& job : envProbeRefreshQueue)
+				{
+					queued |= job.entity == entity;
+				}
+				if (!queued)
+				{
+					probe.render_dirty = false;
+					EnvProbeRefreshJob job;
+					job.entity = entity;
+					job.envmapArray = vis.scene->envmapArray.internal_state.get();
+					job.textureIndex = probe.textureIndex;
+					envProbeRefreshQueue.push_back(job);
+				}
+			}
 		}
-	}
+
+		for (EnvProbeRefreshJob& job : envProbeRefreshQueue)
+		{
+			const EnvironmentProbeComponent& probe = *vis.scene->probes.GetComponent(job.entity);
+			job.distance = wiMath::DistanceSquared(probe.position, vis.camera->Eye);
+		}
+		std::sort(envProbeRefreshQueue.begin(), envProbeRefreshQueue.end(), [](const EnvProbeRefreshJob& a, const EnvProbeRefreshJob& b) {
+			if (a.IsStarted() != b.IsStarted())
+			{
+				return a.IsStarted();
+			}
+			return a.distance < b.distance;
+		});
+
+		wiTimer timer;
+		uint32_t steps = 0;
+
+		// The budget is checked before every step with the average cost of that step, but at least one step is always taken to make progress:
+		auto allowed = [&](ENVPROBE_REFRESH_STEP step, uint32_t count) {
+			if (steps == 0 && count == 1)
+			{
+				return true;
+			}
+			if (envProbeRefreshBudgetSteps > 0 && steps + count > envProbeRefreshBudgetSteps)
+			{
+				return false;
+			}
+			if (envProbeRefreshBudgetMilliseconds > 0 && (float)timer.elapsed_milliseconds() + envProbeRefreshStepCost[step] * count > envProbeRefreshBudgetMilliseconds)
+			{
+				return false;
+			}
+			return true;
+		};
+		auto measure = [&](ENVPROBE_REFRESH_STEP step, uint32_t count, double start) {
+			const float cost = float(timer.elapsed_milliseconds() - start) / count;
+			float& average = envProbeRefreshStepCost[step];
+			average = average == 0 ? cost : wiMath::Lerp(average, cost, 0.1f);
+			steps += count;
+		};
+
+		size_t finished = 0;
+		for (EnvProbeRefreshJob& job : envProbeRefreshQueue)
+		{
+			const EnvironmentProbeComponent& probe = *vis.scene->probes.GetComponent(job.entity);
+			const AABB& probe_aabb = vis.scene->aabb_probes[vis.scene->probes.GetIndex(job.entity)];
+
+			// As many remaining faces are rendered together as the budget allows:
+			uint32_t faceCount = 6 - job.face;
+			while (faceCount > 0 && !allowed(ENVPROBE_REFRESH_STEP_FACE, faceCount))
+			{
+				faceCount--;
+			}
+			if (faceCount > 0)
+			{
+				const double start = timer.elapsed_milliseconds();
+				render_faces(probe, probe_aabb, job.face, faceCount);
+				job.face += faceCount;
+				measure(ENVPROBE_REFRESH_STEP_FACE, faceCount, start);
+			}
+			if (job.face < 6)
+			{
+				break;
+			}
+
+			if (!job.mipchain)
+			{
+				if (!allowed(ENVPROBE_REFRESH_STEP_MIPCHAIN, 1))
+				{
+					break;
+				}
+				const double start = timer.elapsed_milliseconds();
+				generate_mipchain(probe);
+				job.mipchain = true;
+				measure(ENVPROBE_REFRESH_STEP_MIPCHAIN, 1, start);
+			}
+
+			while (job.filter < filterCount && allowed(ENVPROBE_REFRESH_STEP_FILTER, 1))
+			{
+				const double start = timer.elapsed_milliseconds();
+				filter_mip(probe, filterCount - job.filter);
+				job.filter++;
+				measure(ENVPROBE_REFRESH_STEP_FILTER, 1, start);
+			}
+			if (job.filter < filterCount)
+			{
+				break;
+			}
+
+			finished++;
+		}
+
+		// The finished jobs are always at the front, because the queue is processed in order:
+		envProbeRefreshQueue.erase(envProbeRefreshQueue.begin(), envProbeRefreshQueue.begin() + finished);
+
+		envProbeRefreshStatistics.steps = steps;
+		envProbeRefreshStatistics.completed = (uint32_t)finished;
+		envProbeRefreshStatistics.milliseconds = (float)timer.elapsed_milliseconds();
 	}
 
+	envProbeRefreshStatistics.queued = (uint32_t)envProbeRefreshQueue.size();
+
 	//wiProfiler::EndRange(range);
 	device->EventEnd(cmd); // EnvironmentProbe Refresh
 }
 
+uint32_t impostorRefreshBudget = 8;
+void SetImpostorRefreshBudget(uint32_t count)
+{
+	impostorRefreshBudget = count;
+}
+uint32_t GetImpostorRefreshBudget()
+{
+	return impostorRefreshBudget;
+}
+// Direction of an octahedral grid cell, this must match impostor_decode() in impostorHF.hlsli
+static XMFLOAT3 ImpostorCaptureDirection(uint32_t x, uint32_t y)
+{
+	float px = ((float)x + 0.5f) / (float)impostorCaptureGrid * 2 - 1;
+	float pz = ((float)y + 0.5f) / (float)impostorCaptureGrid * 2 - 1;
+	float py = 1 - std::abs(px) - std::abs(pz);
+	if (py < 0)
+	{
+		const float nx = (1 - std::abs(pz)) * (px >= 0 ? 1 : -1);
+		const float nz = (1 - std::abs(px)) * (pz >= 0 ? 1 : -1);
+		px = nx;
+		pz = nz;
+	}
+	XMFLOAT3 dir;
+	XMStoreFloat3(&dir, XMVector3Normalize(XMVectorSet(px, py, pz, 0)));
+	return dir;
+}
 void RefreshImpostors(const Scene& scene, CommandList cmd)
 {
 	if (!scene.impostorArray.IsValid())
 		return;
 
+	// Impostors that have no captured views yet are refreshed first, because their instances are drawn as meshes until then:
+	std::vector<uint32_t> refresh;
+	for (uint32_t impostorIndex = 0; impostorIndex < scene.impostors.GetCount(); ++impostorIndex)
+	{
+		const ImpostorComponent& impostor = scene.impostors[impostorIndex];
+		if (impostor.render_dirty && impostor.textureIndex >= 0 && impostor.textureIndex * 3 + 2 < (int)scene.renderpasses_impostor.size())
+		{
+			refresh.push_back(impostorIndex);
+		}
+	}
+	if (refresh.empty())
+		return;
+	std::stable_partition(refresh.begin(), refresh.end(), [&](uint32_t impostorIndex) {
+		return !scene.impostors[impostorIndex].ready;
+	});
+	if (impostorRefreshBudget > 0 && refresh.size() > impostorRefreshBudget)
+	{
+		refresh.resize(impostorRefreshBudget);
+	}
+
 	device->EventBegin("Impostor Refresh", cmd);
 
 	BindCommonResources(cmd);
@@ -8470,18 +12485,13 @@ void RefreshImpostors(const Scene& scene, CommandList cmd)
 	buff->instancePrev.Create(IDENTITYMATRIX);
 	buff->instanceAtlas.Create(XMFLOAT4(1, 1, 0, 0));
 
-	for (uint32_t impostorIndex = 0; impostorIndex < scene.impostors.GetCount(); ++impostorIndex)
+	const uint32_t viewDim = scene.impostorTextureDim / impostorCaptureGrid;
+
+	for (uint32_t impostorIndex : refresh)
 	{
 		const ImpostorComponent& impostor = scene.impostors[impostorIndex];
-		if (!impostor.render_dirty)
-			continue;
-
-		int textureIndex = (int)(impostorIndex * impostorCaptureAngles * 3 + 3 * impostorCaptureAngles + impostorCaptureAngles);
-
-		if (textureIndex >= scene.renderpasses_impostor.size())
-			continue;
-
 		impostor.render_dirty = false;
+		impostor.ready = true;
 
 		Entity entity = scene.impostors.GetEntity(impostorIndex);
 		const MeshComponent& mesh = *scene.meshes.GetComponent(entity);
@@ -8497,6 +12507,7 @@ void RefreshImpostors(const Scene& scene, CommandList cmd)
 			push.mesh = device->GetDescriptorIndex(&mesh.descriptor, SRV);
 			push.instances = device->GetDescriptorIndex(mem.buffer, SRV);
 			push.instance_offset = mem.offset;
+			push.instance_table = -1;
 		}
 		else
 		{
@@ -8550,64 +12561,63 @@ void RefreshImpostors(const Scene& scene, CommandList cmd)
 				break;
 			}
 
-			for (size_t i = 0; i < impostorCaptureAngles; ++i)
-			{
-				CameraComponent impostorcamera;
-				impostorcamera.SetCustomProjectionEnabled(true);
-				TransformComponent camera_transform;
-
-				camera_transform.ClearTransform();
-				camera_transform.Translate(boundingsphere.center);
-
-				XMMATRIX P = XMMatrixOrthographicOffCenterLH(-boundingsphere.radius, boundingsphere.radius, -boundingsphere.radius, boundingsphere.radius, -boundingsphere.radius, boundingsphere.radius);
-				XMStoreFloat4x4(&impostorcamera.Projection, P);
-				XMVECTOR Q = XMQuaternionNormalize(XMQuaternionRotationAxis(XMVectorSet(0, 1, 0, 0), XM_2PI * (float)i / (float)impostorCaptureAngles));
-				XMStoreFloat4(&camera_transform.rotation_local, Q);
-
-				camera_transform.UpdateTransform();
-				impostorcamera.TransformCamera(camera_transform);
-				impostorcamera.UpdateCamera();
-
-				UpdateCameraCB(impostorcamera, impostorcamera, impostorcamera, cmd);
-
-
-				int textureIndex = (int)(impostorIndex * impostorCaptureAngles * 3 + prop * impostorCaptureAngles + i);
-				device->RenderPassBegin(&scene.renderpasses_impostor[textureIndex], cmd);
+			// Every view of the octahedral grid goes into its own viewport of the slice:
+			const int textureIndex = impostor.textureIndex * 3 + prop;
+			device->RenderPassBegin(&scene.renderpasses_impostor[textureIndex], cmd);
 
-				Viewport viewport;
-				viewport.Height = (float)scene.impostorTextureDim;
-				viewport.Width = (float)scene.impostorTextureDim;
-				device->BindViewports(1, &viewport, cmd);
-
-				for (auto& subset : mesh.subsets)
+			for (uint32_t y = 0; y < impostorCaptureGrid; ++y)
+			{
+				for (uint32_t x = 0; x < impostorCaptureGrid; ++x)
 				{
-					if (subset.indexCount == 0 || !subset.active)
+					const XMFLOAT3 dir = ImpostorCaptureDirection(x, y);
+
+					CameraComponent impostorcamera;
+					impostorcamera.SetCustomProjectionEnabled(true);
+					XMMATRIX P = XMMatrixOrthographicOffCenterLH(-boundingsphere.radius, boundingsphere.radius, -boundingsphere.radius, boundingsphere.radius, -boundingsphere.radius, boundingsphere.radius);
+					XMStoreFloat4x4(&impostorcamera.Projection, P);
+					impostorcamera.Eye = boundingsphere.center;
+					impostorcamera.At = XMFLOAT3(-dir.x, -dir.y, -dir.z);
+					impostorcamera.Up = std::abs(dir.y) > 0.99f ? XMFLOAT3(0, 0, 1) : XMFLOAT3(0, 1, 0); // must match impostor_capture_up()
+					impostorcamera.UpdateCamera();
+
+					UpdateCameraCB(impostorcamera, impostorcamera, impostorcamera, cmd);
+
+					Viewport viewport;
+					viewport.TopLeftX = (float)(x * viewDim);
+					viewport.TopLeftY = (float)(y * viewDim);
+					viewport.Height = (float)viewDim;
+					viewport.Width = (float)viewDim;
+					device->BindViewports(1, &viewport, cmd);
+
+					for (auto& subset : mesh.subsets)
 					{
-						continue;
-					}
-					const MaterialComponent& material = *scene.materials.GetComponent(subset.materialID);
+						if (subset.indexCount == 0 || !subset.active)
+						{
+							continue;
+						}
+						const MaterialComponent& material = *scene.materials.GetComponent(subset.materialID);
 
-					if (bindless)
-					{
-						push.material = device->GetDescriptorIndex(&material.constantBuffer, SRV);
-						device->PushConstants(&push, sizeof(push), cmd);
-					}
-					else
-					{
-					device->BindConstantBuffer(VS, &material.constantBuffer, CB_GETBINDSLOT(MaterialCB), cmd);
-					device->BindConstantBuffer(PS, &material.constantBuffer, CB_GETBINDSLOT(MaterialCB), cmd);
+						if (bindless)
+						{
+							push.material = (int)scene.materials.GetIndex(subset.materialID);
+							device->PushConstants(&push, sizeof(push), cmd);
+						}
+						else
+						{
+						device->BindConstantBuffer(VS, &material.constantBuffer, CB_GETBINDSLOT(MaterialCB), cmd);
+						device->BindConstantBuffer(PS, &material.constantBuffer, CB_GETBINDSLOT(MaterialCB), cmd);
 
-					const GPUResource* res[4];
-					material.WriteTextures(res, arraysize(res));
-					device->BindResources(PS, res, TEXSLOT_ONDEMAND0, arraysize(res), cmd);
-					}
+						const GPUResource* res[4];
+						material.WriteTextures(res, arraysize(res));
+						device->BindResources(PS, res, TEXSLOT_ONDEMAND0, arraysize(res), cmd);
+						}
 
-					device->DrawIndexedInstanced(subset.indexCount, 1, subset.indexOffset, 0, 0, cmd);
+						device->DrawIndexedInstanced(subset.indexCount, 1, subset.indexOffset, 0, 0, cmd);
+					}
 				}
-
-				device->RenderPassEnd(cmd);
-
 			}
+
+			device->RenderPassEnd(cmd);
 		}
 
 	}
@@ -8634,34 +12644,209 @@ void VoxelRadiance(const Visibility& vis, CommandList cmd)
 		device->CreateRenderPass(&renderpassdesc, &renderpass_voxelize);
 	}
 
-	Texture* result = &textures[TEXTYPE_3D_VOXELRADIANCE];
+	const Scene& scene = *vis.scene;
+	const int res = (int)voxelSceneData.res;
+
+	if (voxelSceneData.voxelized_voxelsize != voxelSceneData.voxelsize)
+	{
+		for (auto& clipmap : voxelSceneData.clipmaps)
+		{
+			clipmap.voxelized = false;
+		}
+		voxelSceneData.voxelized_voxelsize = voxelSceneData.voxelsize;
+	}
 
-	AABB bbox;
-	XMFLOAT3 extents = voxelSceneData.extents;
-	XMFLOAT3 center = voxelSceneData.center;
-	bbox.createFromHalfWidth(center, extents);
+	// The regions of the clipmaps that are voxelized in this frame, in world voxel coordinates of their clipmap:
+	struct Region
+	{
+		XMINT3 min;
+		XMINT3 max;
+		bool temporal_smoothing;
+		inline int64_t GetVolume() const { return int64_t(max.x - min.x) * int64_t(max.y - min.y) * int64_t(max.z - min.z); }
+	};
+	std::vector<Region> regions[VOXEL_GI_CLIPMAP_COUNT];
+	bool full[VOXEL_GI_CLIPMAP_COUNT] = {};
 
+	// One clipmap at a time is voxelized completely every refresh interval, to keep up with the changes that are not tracked (lights, materials):
+	uint32_t refresh = ~0u;
+	if (voxelSceneData.refreshInterval > 0 && device->GetFrameCount() % voxelSceneData.refreshInterval == 0)
+	{
+		refresh = voxelSceneData.refresh_clipmap;
+		voxelSceneData.refresh_clipmap = (refresh + 1) % VOXEL_GI_CLIPMAP_COUNT;
+	}
 
-	RenderQueue renderQueue;
-	for (size_t i = 0; i < vis.scene->aabb_objects.GetCount(); ++i)
+	for (uint32_t i = 0; i < VOXEL_GI_CLIPMAP_COUNT; ++i)
 	{
-		const AABB& aabb = vis.scene->aabb_objects[i];
-		if (bbox.intersects(aabb))
+		const auto& clipmap = voxelSceneData.clipmaps[i];
+		const XMINT3 min = clipmap.origin;
+		const XMINT3 max = XMINT3(min.x + res, min.y + res, min.z + res);
+		const XMINT3 offset = XMINT3(
+			clipmap.origin.x - clipmap.voxelized_origin.x,
+			clipmap.origin.y - clipmap.voxelized_origin.y,
+			clipmap.origin.z - clipmap.voxelized_origin.z
+		);
+
+		if (!clipmap.voxelized || i == refresh || std::abs(offset.x) >= res || std::abs(offset.y) >= res || std::abs(offset.z) >= res)
+		{
+			regions[i].push_back({ min, max, false });
+			full[i] = true;
+			continue;
+		}
+
+		// The toroidal storage keeps the voxels that remained inside after scrolling, only the slabs that became exposed are voxelized:
+		for (int axis = 0; axis < 3; ++axis)
 		{
-			const ObjectComponent& object = vis.scene->objects[i];
-			if (object.IsRenderable())
+			const int d = (&offset.x)[axis];
+			if (d == 0)
+				continue;
+			Region region = { min, max, false };
+			if (d > 0)
+			{
+				(&region.min.x)[axis] = (&max.x)[axis] - d;
+			}
+			else
 			{
-				RenderBatch* batch = (RenderBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(RenderBatch));
-				//size_t meshIndex = vis.scene->meshes.GetIndex(object.meshID);
-				//batch->Create(meshIndex, i, 0);
-				batch->Create(object.mesh_index, i, 0);
-				renderQueue.add(batch);
+				(&region.max.x)[axis] = (&min.x)[axis] - d;
 			}
+			regions[i].push_back(region);
 		}
 	}
 
-	if (!renderQueue.empty())
+	// Moving objects are voxelized again both where they are and where they were:
+	static constexpr size_t max_dynamic_regions = 8; // per clipmap, more are merged together
+	auto add_dynamic = [&](const AABB& aabb) {
+		for (uint32_t i = 0; i < VOXEL_GI_CLIPMAP_COUNT; ++i)
+		{
+			if (full[i])
+				continue;
+			const auto& clipmap = voxelSceneData.clipmaps[i];
+			const float size = voxelSceneData.GetVoxelSize(i);
+			Region region;
+			region.min = XMINT3(
+				std::max(clipmap.origin.x, (int)std::floor(std::max(-1e9f, aabb._min.x) / size)),
+				std::max(clipmap.origin.y, (int)std::floor(std::max(-1e9f, aabb._min.y) / size)),
+				std::max(clipmap.origin.z, (int)std::floor(std::max(-1e9f, aabb._min.z) / size))
+			);
+			region.max = XMINT3(
+				std::min(clipmap.origin.x + res, (int)std::floor(std::min(1e9f, aabb._max.x) / size) + 1),
+				std::min(clipmap.origin.y + res, (int)std::floor(std::min(1e9f, aabb._max.y) / size) + 1),
+				std::min(clipmap.origin.z + res, (int)std::floor(std::min(1e9f, aabb._max.z) / size) + 1)
+			);
+			region.temporal_smoothing = true;
+			if (region.min.x >= region.max.x || region.min.y >= region.max.y || region.min.z >= region.max.z)
+				continue;
+
+			size_t dynamic_count = 0;
+			size_t best = ~0ull;
+			int64_t best_growth = INT64_MAX;
+			for (size_t r = 0; r < regions[i].size(); ++r)
+			{
+				const Region& other = regions[i][r];
+				if (!other.temporal_smoothing)
+					continue;
+				dynamic_count++;
+				Region merged = other;
+				merged.min = XMINT3(std::min(merged.min.x, region.min.x), std::min(merged.min.y, region.min.y), std::min(merged.min.z, region.min.z));
+				merged.max = XMINT3(std::max(merged.max.x, region.max.x), std::max(merged.max.y, region.max.y), std::max(merged.max.z, region.max.z));
+				const int64_t growth = merged.GetVolume() - other.GetVolume();
+				if (growth < best_growth)
+				{
+					best_growth = growth;
+					best = r;
+				}
+			}
+			if (dynamic_count < max_dynamic_regions || best == ~0ull)
+			{
+				regions[i].push_back(region);
+			}
+			else
+			{
+				Region& merged = regions[i][best];
+				merged.min = XMINT3(std::min(merged.min.x, region.min.x), std::min(merged.min.y, region.min.y), std::min(merged.min.z, region.min.z));
+				merged.max = XMINT3(std::max(merged.max.x, region.max.x), std::max(merged.max.y, region.max.y), std::max(merged.max.z, region.max.z));
+			}
+		}
+	};
+	// The bounds are compared by object index, so removed and reordered objects are also found:
+	std::vector<AABB>& bounds = voxelSceneData.object_bounds;
+	const size_t objectCount = scene.aabb_objects.GetCount();
+	for (size_t i = 0; i < std::max(bounds.size(), objectCount); ++i)
+	{
+		const bool existed = i < bounds.size();
+		const bool exists = i < objectCount;
+		if (existed && exists)
+		{
+			const AABB& prev = bounds[i];
+			const AABB& curr = scene.aabb_objects[i];
+			if (std::memcmp(&prev._min, &curr._min, sizeof(XMFLOAT3)) == 0 && std::memcmp(&prev._max, &curr._max, sizeof(XMFLOAT3)) == 0)
+				continue;
+		}
+		if (existed)
+		{
+			add_dynamic(bounds[i]);
+		}
+		if (exists)
+		{
+			add_dynamic(scene.aabb_objects[i]);
+		}
+	}
+	bounds.resize(objectCount);
+	for (size_t i = 0; i < objectCount; ++i)
 	{
+		bounds[i] = scene.aabb_objects[i];
+	}
+
+	bool voxelized = false;
+	for (uint32_t i = 0; i < VOXEL_GI_CLIPMAP_COUNT; ++i)
+	{
+		voxelized |= !regions[i].empty();
+	}
+
+	if (voxelized)
+	{
+		auto bind_region = [&](uint32_t clipmap, const Region& region) {
+			VoxelizerCB cb;
+			cb.xVoxelizer_RegionMin = region.min;
+			cb.xVoxelizer_ClipMap = clipmap;
+			cb.xVoxelizer_RegionMax = region.max;
+			cb.xVoxelizer_TemporalSmoothing = region.temporal_smoothing ? 1 : 0;
+			device->UpdateBuffer(&constantBuffers[CBTYPE_VOXELIZER], &cb, cmd);
+			device->BindConstantBuffer(GS, &constantBuffers[CBTYPE_VOXELIZER], CB_GETBINDSLOT(VoxelizerCB), cmd);
+			device->BindConstantBuffer(PS, &constantBuffers[CBTYPE_VOXELIZER], CB_GETBINDSLOT(VoxelizerCB), cmd);
+			device->BindConstantBuffer(CS, &constantBuffers[CBTYPE_VOXELIZER], CB_GETBINDSLOT(VoxelizerCB), cmd);
+		};
+		auto dispatch_region = [&](const Region& region) {
+			device->Dispatch(
+				uint32_t(region.max.x - region.min.x + 3) / 4,
+				uint32_t(region.max.y - region.min.y + 3) / 4,
+				uint32_t(region.max.z - region.min.z + 3) / 4,
+				cmd
+			);
+		};
+
+		// Delete the packed voxel scene data of the regions:
+		device->EventBegin("Voxel Scene Clear", cmd);
+		device->BindUAV(CS, &resourceBuffers[RBTYPE_VOXELSCENE], 0, cmd);
+		device->BindComputeShader(GetShader(CSTYPE_VOXELCLIPMAPCLEAR), cmd);
+		for (uint32_t i = 0; i < VOXEL_GI_CLIPMAP_COUNT; ++i)
+		{
+			for (const Region& region : regions[i])
+			{
+				bind_region(i, region);
+				dispatch_region(region);
+			}
+		}
+		device->UnbindUAVs(0, 1, cmd);
+		device->EventEnd(cmd);
+
+		{
+			GPUBarrier barriers[] = {
+				GPUBarrier::Memory(),
+			};
+			device->Barrier(barriers, arraysize(barriers), cmd);
+		}
+
+		// Voxelize the objects that intersect the regions, the voxelizer only writes the voxels inside the bound region:
 		Viewport vp;
 		vp.Width = (float)voxelSceneData.res;
 		vp.Height = (float)voxelSceneData.res;
@@ -8674,10 +12859,35 @@ void VoxelRadiance(const Visibility& vis, CommandList cmd)
 		BindShadowmaps(PS, cmd);
 
 		device->RenderPassBegin(&renderpass_voxelize, cmd);
-		RenderMeshes(vis, renderQueue, RENDERPASS_VOXELIZE, RENDERTYPE_OPAQUE, cmd, false, nullptr, 1);
-		device->RenderPassEnd(cmd);
+		for (uint32_t i = 0; i < VOXEL_GI_CLIPMAP_COUNT; ++i)
+		{
+			const float size = voxelSceneData.GetVoxelSize(i);
+			for (const Region& region : regions[i])
+			{
+				AABB bbox;
+				bbox._min = XMFLOAT3(region.min.x * size, region.min.y * size, region.min.z * size);
+				bbox._max = XMFLOAT3(region.max.x * size, region.max.y * size, region.max.z * size);
 
-		GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * renderQueue.batchCount);
+				RenderQueue renderQueue;
+				scene.QueryBVH(scene.aabb_objects, [&](const AABB& aabb) { return bbox.intersects(aabb); }, [&](uint32_t index) {
+					const ObjectComponent& object = scene.objects[index];
+					if (object.IsRenderable() && !object.IsHLODCulled())
+					{
+						RenderBatch* batch = (RenderBatch*)GetRenderFrameAllocator(cmd).allocate(sizeof(RenderBatch));
+						batch->Create(object.mesh_index, index, 0);
+						renderQueue.add(batch);
+					}
+				});
+
+				if (!renderQueue.empty())
+				{
+					bind_region(i, region);
+					RenderMeshes(vis, renderQueue, RENDERPASS_VOXELIZE, RENDERTYPE_OPAQUE, cmd, false, nullptr, 1);
+					GetRenderFrameAllocator(cmd).free(sizeof(RenderBatch) * renderQueue.batchCount);
+				}
+			}
+		}
+		device->RenderPassEnd(cmd);
 
 		{
 			GPUBarrier barriers[] = {
@@ -8686,56 +12896,65 @@ void VoxelRadiance(const Visibility& vis, CommandList cmd)
 			device->Barrier(barriers, arraysize(barriers), cmd);
 		}
 
-		// Copy the packed voxel scene data to a 3D texture, then delete the voxel scene emission data. The cone tracing will operate on the 3D texture
-		device->EventBegin("Voxel Scene Copy - Clear", cmd);
-		device->BindUAV(CS, &resourceBuffers[RBTYPE_VOXELSCENE], 0, cmd);
-		device->BindUAV(CS, &textures[TEXTYPE_3D_VOXELRADIANCE], 1, cmd);
+		// Copy the packed voxel scene data of the regions to the 3D texture, the cone tracing will operate on the 3D texture
+		//	The regions that blend with the previous content are copied after the others, so they blend with the current content where they overlap
+		device->EventBegin("Voxel Scene Copy", cmd);
+		device->BindResource(CS, &resourceBuffers[RBTYPE_VOXELSCENE], 0, cmd);
+		device->BindUAV(CS, &textures[TEXTYPE_3D_VOXELRADIANCE], 0, cmd);
 
 		static bool smooth_copy = true;
-		if (smooth_copy)
-		{
-			device->BindComputeShader(&shaders[CSTYPE_VOXELSCENECOPYCLEAR_TEMPORALSMOOTHING], cmd);
-		}
-		else
+		for (int pass = 0; pass < 2; ++pass)
 		{
-			device->BindComputeShader(&shaders[CSTYPE_VOXELSCENECOPYCLEAR], cmd);
-		}
-		device->Dispatch((uint32_t)(voxelSceneData.res * voxelSceneData.res * voxelSceneData.res / 256), 1, 1, cmd);
-		device->EventEnd(cmd);
+			const bool temporal_smoothing = pass > 0;
+			device->BindComputeShader(GetShader(smooth_copy && temporal_smoothing ? CSTYPE_VOXELSCENECOPYCLEAR_TEMPORALSMOOTHING : CSTYPE_VOXELSCENECOPYCLEAR), cmd);
+			for (uint32_t i = 0; i < VOXEL_GI_CLIPMAP_COUNT; ++i)
+			{
+				for (const Region& region : regions[i])
+				{
+					if (region.temporal_smoothing == temporal_smoothing)
+					{
+						bind_region(i, region);
+						dispatch_region(region);
+					}
+				}
+			}
 
-		{
 			GPUBarrier barriers[] = {
 				GPUBarrier::Memory(),
 			};
 			device->Barrier(barriers, arraysize(barriers), cmd);
 		}
+		device->UnbindResources(0, 1, cmd);
+		device->UnbindUAVs(0, 1, cmd);
+		device->EventEnd(cmd);
+
+		for (uint32_t i = 0; i < VOXEL_GI_CLIPMAP_COUNT; ++i)
+		{
+			auto& clipmap = voxelSceneData.clipmaps[i];
+			clipmap.voxelized_origin = clipmap.origin;
+			clipmap.voxelized = true;
+		}
+	}
 
+	// The secondary bounce and the mip levels depend on every clipmap, but they only change when something was voxelized:
+	Texture* result = &textures[TEXTYPE_3D_VOXELRADIANCE];
+	if (voxelSceneData.secondaryBounceEnabled)
+	{
+		result = &textures[TEXTYPE_3D_VOXELRADIANCE_HELPER];
+	}
+	if (voxelized || voxelSceneData.secondaryBounceEnabled != voxelSceneData.secondaryBounceValid)
+	{
 		if (voxelSceneData.secondaryBounceEnabled)
 		{
 			device->EventBegin("Voxel Radiance Secondary Bounce", cmd);
-			device->UnbindUAVs(1, 1, cmd);
 			// Pre-integrate the voxel texture by creating blurred mip levels:
 			GenerateMipChain(textures[TEXTYPE_3D_VOXELRADIANCE], MIPGENFILTER_LINEAR, cmd);
 
 			device->BindResource(CS, &textures[TEXTYPE_3D_VOXELRADIANCE], 0, cmd);
 			device->BindResource(CS, &resourceBuffers[RBTYPE_VOXELSCENE], 1, cmd);
 			device->BindUAV(CS, &textures[TEXTYPE_3D_VOXELRADIANCE_HELPER], 0, cmd);
-			device->BindComputeShader(&shaders[CSTYPE_VOXELRADIANCESECONDARYBOUNCE], cmd);
-			device->Dispatch(voxelSceneData.res / 8, voxelSceneData.res / 8, voxelSceneData.res / 8, cmd);
-			device->EventEnd(cmd);
-
-			{
-				GPUBarrier barriers[] = {
-					GPUBarrier::Memory(),
-				};
-				device->Barrier(barriers, arraysize(barriers), cmd);
-			}
-
-			device->EventBegin("Voxel Scene Clear Normals", cmd);
-			device->UnbindResources(1, 1, cmd);
-			device->BindUAV(CS, &resourceBuffers[RBTYPE_VOXELSCENE], 0, cmd);
-			device->BindComputeShader(&shaders[CSTYPE_VOXELCLEARONLYNORMAL], cmd);
-			device->Dispatch((uint32_t)(voxelSceneData.res * voxelSceneData.res * voxelSceneData.res / 256), 1, 1, cmd);
+			device->BindComputeShader(GetShader(CSTYPE_VOXELRADIANCESECONDARYBOUNCE), cmd);
+			device->Dispatch(voxelSceneData.res / 8, voxelSceneData.res / 8, voxelSceneData.res * VOXEL_GI_CLIPMAP_COUNT / 8, cmd);
 			device->EventEnd(cmd);
 
 			{
@@ -8745,11 +12964,10 @@ void VoxelRadiance(const Visibility& vis, CommandList cmd)
 				device->Barrier(barriers, arraysize(barriers), cmd);
 			}
 
-			result = &textures[TEXTYPE_3D_VOXELRADIANCE_HELPER];
+			device->UnbindResources(0, 2, cmd);
+			device->UnbindUAVs(0, 1, cmd);
 		}
-
-		device->UnbindUAVs(0, 2, cmd);
-
+		voxelSceneData.secondaryBounceValid = voxelSceneData.secondaryBounceEnabled;
 
 		// Pre-integrate the voxel texture by creating blurred mip levels:
 		{
@@ -8765,6 +12983,7 @@ void VoxelRadiance(const Visibility& vis, CommandList cmd)
 void CreateTiledLightResources(TiledLightResources& res, XMUINT2 resolution)
 {
 	const XMUINT3 tileCount = wiRenderer::GetEntityCullingTileCount(resolution);
+	res.tileCount = tileCount;
 
 	{
 		GPUBufferDesc bd;
@@ -8781,16 +13000,24 @@ void CreateTiledLightResources(TiledLightResources& res, XMUINT2 resolution)
 	{
 		GPUBufferDesc bd;
 		bd.StructureByteStride = sizeof(uint);
-		bd.ByteWidth = tileCount.x * tileCount.y * bd.StructureByteStride * SHADER_ENTITY_TILE_BUCKET_COUNT;
+		bd.ByteWidth = tileCount.x * tileCount.y * tileCount.z * bd.StructureByteStride * SHADER_ENTITY_TILE_BUCKET_COUNT;
 		bd.Usage = USAGE_DEFAULT;
 		bd.BindFlags = BIND_UNORDERED_ACCESS | BIND_SHADER_RESOURCE;
 		bd.CPUAccessFlags = 0;
 		bd.MiscFlags = RESOURCE_MISC_BUFFER_STRUCTURED;
 		device->CreateBuffer(&bd, nullptr, &res.entityTiles_Opaque);
-		device->CreateBuffer(&bd, nullptr, &res.entityTiles_Transparent);
-
 		device->SetName(&res.entityTiles_Opaque, "entityTiles_Opaque");
-		device->SetName(&res.entityTiles_Transparent, "entityTiles_Transparent");
+
+		if (tileCount.z > 1)
+		{
+			// The clusters are shared by the opaque and transparent passes:
+			res.entityTiles_Transparent = {};
+		}
+		else
+		{
+			device->CreateBuffer(&bd, nullptr, &res.entityTiles_Transparent);
+			device->SetName(&res.entityTiles_Transparent, "entityTiles_Transparent");
+		}
 	}
 }
 void ComputeTiledLightCulling(
@@ -8800,7 +13027,7 @@ void ComputeTiledLightCulling(
 	CommandList cmd
 )
 {
-	const XMUINT3 tileCount = GetEntityCullingTileCount(XMUINT2(depthbuffer.desc.Width, depthbuffer.desc.Height));
+	const XMUINT3 tileCount = res.tileCount;
 
 	BindCommonResources(cmd);
 
@@ -8835,6 +13062,44 @@ void ComputeTiledLightCulling(
 		device->EventEnd(cmd);
 	}
 
+	// Perform the culling into depth slices, without depth bounds
+	if (tileCount.z > 1)
+	{
+		device->EventBegin("Entity Culling - Clustered", cmd);
+
+		device->BindResource(CS, &res.tileFrustums, TEXSLOT_ONDEMAND0, cmd);
+		device->BindComputeShader(&shaders[CSTYPE_LIGHTCLUSTERCULLING], cmd);
+
+		const GPUResource* uavs[] = {
+			&res.entityTiles_Opaque,
+		};
+		device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+
+		{
+			GPUBarrier barriers[] = {
+				GPUBarrier::Memory(&res.tileFrustums),
+				GPUBarrier::Buffer(&res.tileFrustums, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE),
+				GPUBarrier::Buffer(&res.entityTiles_Opaque, BUFFER_STATE_SHADER_RESOURCE, BUFFER_STATE_UNORDERED_ACCESS),
+			};
+			device->Barrier(barriers, arraysize(barriers), cmd);
+		}
+
+		device->Dispatch(tileCount.x, tileCount.y, tileCount.z, cmd);
+
+		{
+			GPUBarrier barriers[] = {
+				GPUBarrier::Memory(&res.entityTiles_Opaque),
+				GPUBarrier::Buffer(&res.entityTiles_Opaque, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE),
+			};
+			device->Barrier(barriers, arraysize(barriers), cmd);
+		}
+
+		device->UnbindUAVs(0, arraysize(uavs), cmd);
+
+		device->EventEnd(cmd);
+		return;
+	}
+
 	// Perform the culling
 	{
 		device->EventBegin("Entity Culling", cmd);
@@ -8908,15 +13173,130 @@ void DownsampleDepthBuffer(const wiGraphics::Texture& src, wiGraphics::CommandLi
 {
 	device->EventBegin("DownsampleDepthBuffer", cmd);
 
-	device->BindPipelineState(&PSO_downsampledepthbuffer, cmd);
+	device->BindPipelineState(&PSO_downsampledepthbuffer, cmd);
+
+	device->BindResource(PS, &src, TEXSLOT_ONDEMAND0, cmd);
+
+	device->Draw(3, 0, cmd);
+
+	device->UnbindResources(TEXSLOT_ONDEMAND0, 1, cmd);
+
+	device->EventEnd(cmd);
+}
+
+GPUBuffer spdCounter[COMMANDLIST_COUNT];
+GPUBuffer spdIntermediate[COMMANDLIST_COUNT];
+GPUBuffer spdEdges[COMMANDLIST_COUNT];
+// Generates the mips [output_mip, output_mip + mip_count) of output from a subresource of input in one dispatch (see spdCS_float4.hlsl)
+//	The input has to be twice the size of the first output mip (rounded up), the output mips are in output.desc.layout before and after
+static void SinglePassDownsample(SHADERTYPE shadertype, const Texture& input, int input_subresource, uint32_t input_width, uint32_t input_height, const Texture& output, uint32_t output_mip, uint32_t mip_count, CommandList cmd)
+{
+	const uint32_t groupsX = (input_width + 63) / 64;
+	const uint32_t groupsY = (input_height + 63) / 64;
+	assert(mip_count > 0 && mip_count <= SPD_MAX_MIPS);
+	assert(mip_count <= 6 || (groupsX <= SPD_INTERMEDIATE_SIZE && groupsY <= SPD_INTERMEDIATE_SIZE));
+	assert(shadertype != CSTYPE_SPD_MAX || output.desc.Width < SPD_EDGE_STRIDE && output.desc.Height < SPD_EDGE_STRIDE);
+
+	// The buffers are per command list, so that the dispatches of different command lists can overlap:
+	if (!spdCounter[cmd].IsValid())
+	{
+		GPUBufferDesc desc;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		desc.ByteWidth = sizeof(uint32_t);
+		const uint32_t zero = 0; // the last group resets it for the next dispatch
+		SubresourceData data;
+		data.pSysMem = &zero;
+		device->CreateBuffer(&desc, &data, &spdCounter[cmd]);
+		device->SetName(&spdCounter[cmd], "spdCounter");
+
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = sizeof(XMFLOAT4);
+		desc.ByteWidth = desc.StructureByteStride * SPD_INTERMEDIATE_SIZE * SPD_INTERMEDIATE_SIZE;
+		device->CreateBuffer(&desc, nullptr, &spdIntermediate[cmd]);
+		device->SetName(&spdIntermediate[cmd], "spdIntermediate");
+	}
+	if (shadertype == CSTYPE_SPD_MAX && !spdEdges[cmd].IsValid())
+	{
+		GPUBufferDesc desc;
+		desc.Usage = USAGE_DEFAULT;
+		desc.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+		desc.MiscFlags = RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = sizeof(float);
+		desc.ByteWidth = desc.StructureByteStride * SPD_EDGE_STRIDE * SPD_MAX_MIPS * 2;
+		device->CreateBuffer(&desc, nullptr, &spdEdges[cmd]);
+		device->SetName(&spdEdges[cmd], "spdEdges");
+	}
+
+	device->BindComputeShader(&shaders[shadertype], cmd);
+
+	SPDCB cb;
+	cb.spdInputResolution.x = input_width;
+	cb.spdInputResolution.y = input_height;
+	cb.spdMipCount = mip_count;
+	cb.spdGroupCount = groupsX * groupsY;
+	cb.spdGroupResolution.x = groupsX;
+	cb.spdGroupResolution.y = groupsY;
+	device->UpdateBuffer(&constantBuffers[CBTYPE_SPD], &cb, cmd);
+	device->BindConstantBuffer(CS, &constantBuffers[CBTYPE_SPD], CB_GETBINDSLOT(SPDCB), cmd);
+
+	device->BindResource(CS, &input, TEXSLOT_ONDEMAND0, cmd, input_subresource);
+	for (uint32_t i = 0; i < mip_count; ++i)
+	{
+		device->BindUAV(CS, &output, i, cmd, int(output_mip + i));
+	}
+	device->BindUAV(CS, &spdCounter[cmd], SPD_SLOT_COUNTER, cmd);
+	device->BindUAV(CS, &spdIntermediate[cmd], SPD_SLOT_INTERMEDIATE, cmd);
+	if (shadertype == CSTYPE_SPD_MAX)
+	{
+		device->BindUAV(CS, &spdEdges[cmd], SPD_SLOT_EDGES, cmd);
+	}
+
+	{
+		GPUBarrier barriers[SPD_MAX_MIPS + 3];
+		uint32_t barrierCount = 0;
+		for (uint32_t i = 0; i < mip_count; ++i)
+		{
+			barriers[barrierCount++] = GPUBarrier::Image(&output, output.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS, int(output_mip + i));
+		}
+		barriers[barrierCount++] = GPUBarrier::Buffer(&spdCounter[cmd], BUFFER_STATE_SHADER_RESOURCE, BUFFER_STATE_UNORDERED_ACCESS);
+		barriers[barrierCount++] = GPUBarrier::Buffer(&spdIntermediate[cmd], BUFFER_STATE_SHADER_RESOURCE, BUFFER_STATE_UNORDERED_ACCESS);
+		if (shadertype == CSTYPE_SPD_MAX)
+		{
+			barriers[barrierCount++] = GPUBarrier::Buffer(&spdEdges[cmd], BUFFER_STATE_SHADER_RESOURCE, BUFFER_STATE_UNORDERED_ACCESS);
+		}
+		device->Barrier(barriers, barrierCount, cmd);
+	}
 
-	device->BindResource(PS, &src, TEXSLOT_ONDEMAND0, cmd);
+	device->Dispatch(groupsX, groupsY, 1, cmd);
 
-	device->Draw(3, 0, cmd);
+	{
+		GPUBarrier barriers[SPD_MAX_MIPS + 4];
+		uint32_t barrierCount = 0;
+		barriers[barrierCount++] = GPUBarrier::Memory();
+		for (uint32_t i = 0; i < mip_count; ++i)
+		{
+			barriers[barrierCount++] = GPUBarrier::Image(&output, IMAGE_LAYOUT_UNORDERED_ACCESS, output.desc.layout, int(output_mip + i));
+		}
+		barriers[barrierCount++] = GPUBarrier::Buffer(&spdCounter[cmd], BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE);
+		barriers[barrierCount++] = GPUBarrier::Buffer(&spdIntermediate[cmd], BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE);
+		if (shadertype == CSTYPE_SPD_MAX)
+		{
+			barriers[barrierCount++] = GPUBarrier::Buffer(&spdEdges[cmd], BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE);
+		}
+		device->Barrier(barriers, barrierCount, cmd);
+	}
 
+	device->UnbindUAVs(0, SPD_SLOT_EDGES + 1, cmd);
 	device->UnbindResources(TEXSLOT_ONDEMAND0, 1, cmd);
-
-	device->EventEnd(cmd);
+}
+// The mips that one dispatch can generate from an input of this size
+static uint32_t SinglePassDownsampleMipCount(uint32_t input_width, uint32_t input_height)
+{
+	// The group results are reduced to more mips by the last group only if they fit into its intermediate tile:
+	const uint32_t groups = std::max((input_width + 63) / 64, (input_height + 63) / 64);
+	return groups <= SPD_INTERMEDIATE_SIZE ? SPD_MAX_MIPS : 6;
 }
 
 void GenerateMipChain(const Texture& texture, MIPGENFILTER filter, CommandList cmd, const MIPGEN_OPTIONS& options)
@@ -9097,6 +13477,22 @@ void GenerateMipChain(const Texture& texture, MIPGENFILTER filter, CommandList c
 				break;
 			}
 
+			if (filter == MIPGENFILTER_LINEAR && !options.preserve_coverage)
+			{
+				// The box filtered chain is generated by the single pass downsampler, by one dispatch for up to 12 mips:
+				uint32_t mip = 0;
+				while (mip < desc.MipLevels - 1)
+				{
+					const uint32_t width = std::max(1u, desc.Width >> mip);
+					const uint32_t height = std::max(1u, desc.Height >> mip);
+					const uint32_t count = std::min(desc.MipLevels - 1 - mip, SinglePassDownsampleMipCount(width, height));
+					SinglePassDownsample(hdr ? CSTYPE_SPD_FLOAT4 : CSTYPE_SPD_UNORM4, texture, (int)mip, width, height, texture, mip + 1, count, cmd);
+					mip += count;
+				}
+				device->EventEnd(cmd);
+				return;
+			}
+
 			for (uint32_t i = 0; i < desc.MipLevels - 1; ++i)
 			{
 				{
@@ -9297,6 +13693,41 @@ void RayTraceScene(
 	const Texture* output_normal
 )
 {
+	// The whole output is traced with the same sample:
+	const TextureDesc& desc = output.GetDesc();
+	const XMFLOAT4& halton = wiMath::GetHaltonSequence(accumulation_sample);
+	std::vector<RaytracingTile> tiles;
+	for (uint32_t y = 0; y < desc.Height; y += RAYTRACING_TILE_SIZE)
+	{
+		for (uint32_t x = 0; x < desc.Width; x += RAYTRACING_TILE_SIZE)
+		{
+			RaytracingTile tile = {};
+			tile.offset = XMUINT2(x, y);
+			tile.sampleIndex = (uint32_t)accumulation_sample;
+			tile.accumulationFactor = 1.0f / ((float)accumulation_sample + 1.0f);
+			tile.pixelOffset = XMFLOAT2(halton.x, halton.y);
+			tiles.push_back(tile);
+		}
+	}
+	RayTraceScene(scene, output, tiles.data(), (uint32_t)tiles.size(), cmd, output_albedo, output_normal);
+}
+void RayTraceScene(
+	const Scene& scene,
+	const Texture& output,
+	const RaytracingTile* tiles,
+	uint32_t tileCount,
+	CommandList cmd,
+	const Texture* output_albedo,
+	const Texture* output_normal,
+	const Texture* output_moment,
+	const GPUBuffer* output_tileerrors
+)
+{
+	if (tileCount == 0)
+	{
+		return;
+	}
+
 	// Set up tracing resources:
 	if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
 	{
@@ -9327,20 +13758,33 @@ void RayTraceScene(
 		device->BindResource(CS, &textures[TEXTYPE_2D_SKYATMOSPHERE_MULTISCATTEREDLUMINANCELUT], TEXSLOT_MULTISCATTERINGLUT, cmd);
 	}
 
-	const XMFLOAT4& halton = wiMath::GetHaltonSequence(accumulation_sample);
-	RaytracingCB cb;
-	cb.xTracePixelOffset = XMFLOAT2(halton.x, halton.y);
-	cb.xTraceAccumulationFactor = 1.0f / ((float)accumulation_sample + 1.0f);
+	RaytracingCB cb = {};
 	cb.xTraceResolution.x = desc.Width;
 	cb.xTraceResolution.y = desc.Height;
 	cb.xTraceResolution_rcp.x = 1.0f / cb.xTraceResolution.x;
 	cb.xTraceResolution_rcp.y = 1.0f / cb.xTraceResolution.y;
 	cb.xTraceUserData.x = raytraceBounceCount;
-	cb.xTraceSampleIndex = (uint32_t)accumulation_sample;
 		device->UpdateBuffer(&constantBuffers[CBTYPE_RAYTRACE], &cb, cmd);
 		device->BindConstantBuffer(CS, &constantBuffers[CBTYPE_RAYTRACE], CB_GETBINDSLOT(RaytracingCB), cmd);
 
-	device->BindComputeShader(&shaders[CSTYPE_RAYTRACE], cmd);
+	// The tile buffer is shared, it only grows:
+	raytraceTileLock.lock();
+	if (raytraceTileBuffer.GetDesc().ByteWidth < sizeof(RaytracingTile) * tileCount)
+	{
+		GPUBufferDesc bd;
+		bd.Usage = USAGE_DEFAULT;
+		bd.BindFlags = BIND_SHADER_RESOURCE;
+		bd.MiscFlags = RESOURCE_MISC_BUFFER_STRUCTURED;
+		bd.StructureByteStride = sizeof(RaytracingTile);
+		bd.ByteWidth = bd.StructureByteStride * std::max(256u, tileCount);
+		device->CreateBuffer(&bd, nullptr, &raytraceTileBuffer);
+		device->SetName(&raytraceTileBuffer, "raytraceTileBuffer");
+	}
+	raytraceTileLock.unlock();
+	device->UpdateBuffer(&raytraceTileBuffer, tiles, cmd, int(sizeof(RaytracingTile) * tileCount));
+	device->BindResource(CS, &raytraceTileBuffer, TEXSLOT_ONDEMAND6, cmd);
+
+	device->BindComputeShader(GetShader(CSTYPE_RAYTRACE), cmd);
 
 			const GPUResource* uavs[] = {
 		&output,
@@ -9362,11 +13806,19 @@ void RayTraceScene(
 		{
 		device->BindUAV(CS, output_normal, 2, cmd);
 			}
+	if (output_moment != nullptr)
+	{
+		device->BindUAV(CS, output_moment, 3, cmd);
+	}
+	if (output_tileerrors != nullptr)
+	{
+		device->BindUAV(CS, output_tileerrors, 4, cmd);
+	}
 
 	device->Dispatch(
-		(desc.Width + RAYTRACING_LAUNCH_BLOCKSIZE - 1) / RAYTRACING_LAUNCH_BLOCKSIZE,
-		(desc.Height + RAYTRACING_LAUNCH_BLOCKSIZE - 1) / RAYTRACING_LAUNCH_BLOCKSIZE,
-		1,
+		RAYTRACING_TILE_SIZE / RAYTRACING_LAUNCH_BLOCKSIZE,
+		RAYTRACING_TILE_SIZE / RAYTRACING_LAUNCH_BLOCKSIZE,
+		tileCount,
 		cmd);
 
 				{
@@ -9377,7 +13829,7 @@ void RayTraceScene(
 				device->Barrier(barriers, arraysize(barriers), cmd);
 				}
 
-	device->UnbindUAVs(0, 3, cmd);
+	device->UnbindUAVs(0, 5, cmd);
 
 	wiProfiler::EndRange(range);
 	device->EventEnd(cmd); // RayTraceScene
@@ -9410,6 +13862,19 @@ void RefreshDecalAtlas(const Scene& scene, CommandList cmd)
 		}
 		scene.decal_repack_needed = false;
 	}
+	else
+	{
+		// Only the textures that were inserted into the free space are copied:
+		for (auto& texture : scene.decal_copies_pending)
+		{
+			const rect_xywh& rect = scene.packedDecals.at(texture);
+			for (uint32_t mip = 0; mip < std::min(scene.decalAtlas.GetDesc().MipLevels, texture->texture.desc.MipLevels); ++mip)
+			{
+				CopyTexture2D(scene.decalAtlas, mip, (rect.x >> mip) + Scene::atlasClampBorder, (rect.y >> mip) + Scene::atlasClampBorder, texture->texture, mip, cmd, BORDEREXPAND_CLAMP);
+			}
+		}
+	}
+	scene.decal_copies_pending.clear();
 }
 
 void RenderObjectLightMap(const Scene& scene, const ObjectComponent& object, CommandList cmd)
@@ -9417,7 +13882,7 @@ void RenderObjectLightMap(const Scene& scene, const ObjectComponent& object, Com
 	device->EventBegin("RenderObjectLightMap", cmd);
 
 	const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
-	assert(!mesh.vertex_atlas.empty());
+	assert(!mesh.vertex_atlas.empty() || !mesh.cooked.atlas.empty());
 	assert(mesh.vertexBuffer_ATL.IsValid());
 
 	const TextureDesc& desc = object.lightmap.GetDesc();
@@ -9488,52 +13953,150 @@ void RenderObjectLightMap(const Scene& scene, const ObjectComponent& object, Com
 		device->BindResource(PS, &textures[TEXTYPE_2D_SKYATMOSPHERE_MULTISCATTEREDLUMINANCELUT], TEXSLOT_MULTISCATTERINGLUT, cmd);
 	}
 
-	device->DrawIndexedInstanced((uint32_t)mesh.indices.size(), 1, 0, 0, 0, cmd);
+	device->DrawIndexedInstanced((uint32_t)mesh.GetIndexCount(), 1, 0, 0, 0, cmd);
 	object.lightmapIterationCount++;
 
 	device->RenderPassEnd(cmd);
 
 	device->EventEnd(cmd);
 }
+uint32_t lightmapBakeBudgetSamples = 0;
+float lightmapBakeBudgetMilliseconds = 0;
+uint32_t lightmapBakeTargetSamples = 0;
+float lightmapBakeSampleCost = 0; // running average of the measured GPU time of a sample
+uint32_t lightmapBakeSamplesMeasured = 0; // sample count of the frame that the "Lightmap Processing" range is measured for
+uint32_t lightmapBakeCursor = 0; // the object that receives the next sample in the round-robin order
+LightmapBakeStatistics lightmapBakeStatistics;
 void RefreshLightmapAtlas(const Scene& scene, CommandList cmd)
 {
-	if (scene.lightmap_refresh_needed.load() || scene.lightmap_repack_needed.load())
+	lightmapBakeStatistics = {};
+	if (!scene.lightmap_refresh_needed.load() && !scene.lightmap_repack_needed.load())
+	{
+		return;
+	}
+
+	// Objects that are baking:
+	std::vector<uint32_t> baking;
+	for (uint32_t i = 0; i < scene.objects.GetCount(); ++i)
+	{
+		const ObjectComponent& object = scene.objects[i];
+		if (object.lightmap.IsValid() && object.IsLightmapRenderRequested() &&
+			(lightmapBakeTargetSamples == 0 || object.lightmapIterationCount < lightmapBakeTargetSamples))
+		{
+			baking.push_back(i);
+		}
+	}
+	lightmapBakeStatistics.baking = (uint32_t)baking.size();
+
+	if (baking.empty() && !scene.lightmap_repack_needed.load() && scene.lightmap_copies_pending.empty())
+	{
+		scene.lightmap_refresh_needed.store(false);
+		return;
+	}
+
+	// The GPU range is measured a few frames later, so the cost of a sample is only updated when a new measurement arrived:
+	const float measured = wiProfiler::GetRangeTime("Lightmap Processing");
+	if (measured > 0 && lightmapBakeSamplesMeasured > 0)
 	{
-		auto range = wiProfiler::BeginRangeGPU("Lightmap Processing", cmd);
+		const float cost = measured / lightmapBakeSamplesMeasured;
+		lightmapBakeSampleCost = lightmapBakeSampleCost > 0 ? wiMath::Lerp(lightmapBakeSampleCost, cost, 0.1f) : cost;
+	}
+
+	uint32_t samples = (uint32_t)baking.size();
+	if (lightmapBakeBudgetSamples > 0 || lightmapBakeBudgetMilliseconds > 0)
+	{
+		samples = lightmapBakeBudgetSamples > 0 ? lightmapBakeBudgetSamples : ~0u;
+		if (lightmapBakeBudgetMilliseconds > 0 && lightmapBakeSampleCost > 0)
+		{
+			samples = std::min(samples, (uint32_t)(lightmapBakeBudgetMilliseconds / lightmapBakeSampleCost));
+		}
+		else if (lightmapBakeBudgetSamples == 0)
+		{
+			samples = (uint32_t)baking.size(); // no measurement yet
+		}
+		samples = std::max(1u, samples);
+		if (lightmapBakeTargetSamples > 0)
+		{
+			// It's not worth to take more samples than what the baking objects are missing:
+			uint32_t missing = 0;
+			for (uint32_t i : baking)
+			{
+				missing += lightmapBakeTargetSamples - scene.objects[i].lightmapIterationCount;
+			}
+			samples = std::min(samples, missing);
+		}
+	}
 
+	auto range = wiProfiler::BeginRangeGPU("Lightmap Processing", cmd);
+
+	if (!baking.empty())
+	{
 		if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
 		{
 			device->BindResource(PS, &scene.TLAS, TEXSLOT_ACCELERATION_STRUCTURE, cmd);
 		}
 		else
-			{
+		{
 			scene.BVH.Bind(PS, cmd);
-			}
+		}
+	}
 
-		// Render lightmaps for each object:
-		for (uint32_t i = 0; i < scene.objects.GetCount(); ++i)
+	// Render lightmap samples for the baking objects in round-robin order:
+	std::vector<bool> sampled(scene.objects.GetCount(), false);
+	bool finished = false;
+	uint32_t remaining = (uint32_t)baking.size();
+	for (uint32_t sample = 0; sample < samples && remaining > 0;)
+	{
+		lightmapBakeCursor %= (uint32_t)baking.size();
+		const uint32_t i = baking[lightmapBakeCursor++];
+		const ObjectComponent& object = scene.objects[i];
+		if (lightmapBakeTargetSamples > 0 && object.lightmapIterationCount >= lightmapBakeTargetSamples)
 		{
-			const ObjectComponent& object = scene.objects[i];
-			if (!object.lightmap.IsValid())
-				continue;
-
-			if (object.IsLightmapRenderRequested())
-			{
-				RenderObjectLightMap(scene, object, cmd);
-			}
+			continue;
+		}
+		RenderObjectLightMap(scene, object, cmd);
+		sampled[i] = true;
+		sample++;
+		lightmapBakeStatistics.samples++;
+		if (lightmapBakeTargetSamples > 0 && object.lightmapIterationCount >= lightmapBakeTargetSamples)
+		{
+			finished = true;
+			remaining--;
+		}
+	}
+	lightmapBakeSamplesMeasured = lightmapBakeStatistics.samples;
+	lightmapBakeStatistics.milliseconds = lightmapBakeStatistics.samples * lightmapBakeSampleCost;
 
-			if (object.IsLightmapRenderRequested() || scene.lightmap_repack_needed)
+	// Copy the objects' lightmaps into the scene's lightmap atlas:
+	for (uint32_t i = 0; i < scene.objects.GetCount(); ++i)
+	{
+		const ObjectComponent& object = scene.objects[i];
+		if (object.lightmap.IsValid() && (sampled[i] || scene.lightmap_repack_needed ||
+			std::find(scene.lightmap_copies_pending.begin(), scene.lightmap_copies_pending.end(), &object.lightmap_rect) != scene.lightmap_copies_pending.end()))
 		{
-				// copy object' lightmap into scene's lightmap atlas
-				CopyTexture2D(scene.lightmap, -1, object.lightmap_rect.x + Scene::atlasClampBorder, object.lightmap_rect.y + Scene::atlasClampBorder, object.lightmap, 0, cmd);
-					}
-				}
+			CopyTexture2D(scene.lightmap, -1, object.lightmap_rect.x + Scene::atlasClampBorder, object.lightmap_rect.y + Scene::atlasClampBorder, object.lightmap, 0, cmd);
+		}
+	}
 
-		scene.lightmap_repack_needed.store(false);
-		scene.lightmap_refresh_needed.store(false);
-		wiProfiler::EndRange(range);
+	if (finished)
+	{
+		scene.lightmap_bake_finished.store(true);
 	}
+	scene.lightmap_repack_needed.store(false);
+	scene.lightmap_copies_pending.clear();
+	scene.lightmap_refresh_needed.store(false);
+	wiProfiler::EndRange(range);
+}
+void SetLightmapBakeBudget(uint32_t samples, float milliseconds)
+{
+	lightmapBakeBudgetSamples = samples;
+	lightmapBakeBudgetMilliseconds = milliseconds;
 }
+uint32_t GetLightmapBakeBudgetSamples() { return lightmapBakeBudgetSamples; }
+float GetLightmapBakeBudgetMilliseconds() { return lightmapBakeBudgetMilliseconds; }
+void SetLightmapBakeTargetSamples(uint32_t samples) { lightmapBakeTargetSamples = samples; }
+uint32_t GetLightmapBakeTargetSamples() { return lightmapBakeTargetSamples; }
+const LightmapBakeStatistics& GetLightmapBakeStatistics() { return lightmapBakeStatistics; }
 
 void BindCommonResources(CommandList cmd)
 {
@@ -9701,8 +14264,13 @@ void ComputeShadingRateClassification(
 	const Texture gbuffer[GBUFFER_COUNT],
 	const Texture& lineardepth,
 	const Texture& output,
+	const Texture& output_transparent,
 	const Texture& debugUAV,
-	CommandList cmd
+	const CameraComponent& camera,
+	CommandList cmd,
+	const Texture* previous_color,
+	float dof_coc_scale,
+	float dof_max_coc
 )
 {
 	device->EventBegin("ComputeShadingRateClassification", cmd);
@@ -9728,6 +14296,10 @@ void ComputeShadingRateClassification(
 
 	device->BindResource(CS, &gbuffer[GBUFFER_VELOCITY], TEXSLOT_GBUFFER2, cmd);
 	device->BindResource(CS, &lineardepth, TEXSLOT_LINEARDEPTH, cmd);
+	if (previous_color != nullptr)
+	{
+		device->BindResource(CS, previous_color, TEXSLOT_ONDEMAND0, cmd);
+	}
 
 	const TextureDesc& desc = output.GetDesc();
 
@@ -9740,17 +14312,29 @@ void ComputeShadingRateClassification(
 	device->WriteShadingRateValue(SHADING_RATE_2X4, &cb.SHADING_RATE_2X4);
 	device->WriteShadingRateValue(SHADING_RATE_4X2, &cb.SHADING_RATE_4X2);
 	device->WriteShadingRateValue(SHADING_RATE_4X4, &cb.SHADING_RATE_4X4);
+	device->WriteShadingRateValue(GetVariableRateShadingPolicy(VARIABLE_RATE_SHADING_PASS_OPAQUE), &cb.xShadingRateCoarsestOpaque);
+	device->WriteShadingRateValue(GetVariableRateShadingPolicy(VARIABLE_RATE_SHADING_PASS_TRANSPARENT), &cb.xShadingRateCoarsestTransparent);
+	if (dof_coc_scale > 0 && camera.aperture_size > 0)
+	{
+		// Same circle of confusion as in the depth of field, see get_coc():
+		cb.xShadingRateCoCScale = dof_coc_scale * camera.aperture_size;
+		cb.xShadingRateMaxCoC = dof_max_coc;
+		cb.xShadingRateFocus = camera.focal_length / camera.zFarP;
+	}
+	if (previous_color != nullptr)
+	{
+		cb.xShadingRateOptions |= SHADINGRATE_OPTION_LUMINANCE;
+	}
 	device->UpdateBuffer(&constantBuffers[CBTYPE_SHADINGRATECLASSIFICATION], &cb, cmd);
 	device->BindConstantBuffer(CS, &constantBuffers[CBTYPE_SHADINGRATECLASSIFICATION], CB_GETBINDSLOT(PostProcessCB), cmd);
 
-	const GPUResource* uavs[] = {
-		&output,
-	};
-	device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
+	device->BindUAV(CS, &output, 0, cmd);
+	device->BindUAV(CS, &output_transparent, 2, cmd);
 
 	{
 		GPUBarrier barriers[] = {
 			GPUBarrier::Image(&output, output.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+			GPUBarrier::Image(&output_transparent, output_transparent.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
 		};
 		device->Barrier(barriers, arraysize(barriers), cmd);
 	}
@@ -9762,6 +14346,7 @@ void ComputeShadingRateClassification(
 		GPUBarrier barriers[] = {
 			GPUBarrier::Memory(),
 			GPUBarrier::Image(&output, IMAGE_LAYOUT_UNORDERED_ACCESS, output.desc.layout),
+			GPUBarrier::Image(&output_transparent, IMAGE_LAYOUT_UNORDERED_ACCESS, output_transparent.desc.layout),
 		};
 		device->Barrier(barriers, arraysize(barriers), cmd);
 	}
@@ -9776,7 +14361,8 @@ void ComputeShadingRateClassification(
 		}
 	}
 
-	device->UnbindUAVs(0, arraysize(uavs), cmd);
+	device->UnbindUAVs(0, 3, cmd);
+	device->UnbindResources(TEXSLOT_ONDEMAND0, 1, cmd);
 
 	wiProfiler::EndRange(range);
 	device->EventEnd(cmd);
@@ -10742,7 +15328,7 @@ void Postprocess_MSAO(
 	wiProfiler::EndRange(prof_range);
 	device->EventEnd(cmd);
 }
-void CreateRTAOResources(RTAOResources& res, XMUINT2 resolution)
+void CreateRTDenoiserResources(RTDenoiserResources& res, XMUINT2 resolution)
 {
 	TextureDesc desc;
 	desc.Width = resolution.x / 2;
@@ -10752,7 +15338,22 @@ void CreateRTAOResources(RTAOResources& res, XMUINT2 resolution)
 
 	desc.Format = FORMAT_R11G11B10_FLOAT;
 	device->CreateTexture(&desc, nullptr, &res.normals);
-	device->SetName(&res.normals, "rtao_normals");
+	device->SetName(&res.normals, "rtdenoiser_normals");
+
+	desc.Format = FORMAT_R16G16_FLOAT;
+	for (int i = 0; i < arraysize(res.reprojection); ++i)
+	{
+		device->CreateTexture(&desc, nullptr, &res.reprojection[i]);
+		device->SetName(&res.reprojection[i], "rtdenoiser_reprojection");
+	}
+}
+void CreateRTAOResources(RTAOResources& res, XMUINT2 resolution)
+{
+	TextureDesc desc;
+	desc.Width = resolution.x / 2;
+	desc.Height = resolution.y / 2;
+	desc.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+	desc.layout = IMAGE_LAYOUT_SHADER_RESOURCE_COMPUTE;
 
 	GPUBufferDesc bd;
 	bd.StructureByteStride = sizeof(uint);
@@ -10767,10 +15368,8 @@ void CreateRTAOResources(RTAOResources& res, XMUINT2 resolution)
 	device->SetName(&res.metadata, "rtshadow_metadata");
 
 	desc.Format = FORMAT_R16G16_FLOAT;
-	device->CreateTexture(&desc, nullptr, &res.scratch[0]);
-	device->SetName(&res.scratch[0], "rtshadow_scratch[0]");
-	device->CreateTexture(&desc, nullptr, &res.scratch[1]);
-	device->SetName(&res.scratch[1], "rtshadow_scratch[1]");
+	device->CreateTexture(&desc, nullptr, &res.history);
+	device->SetName(&res.history, "rtao_history");
 
 	desc.Format = FORMAT_R11G11B10_FLOAT;
 	device->CreateTexture(&desc, nullptr, &res.moments[0]);
@@ -10780,6 +15379,7 @@ void CreateRTAOResources(RTAOResources& res, XMUINT2 resolution)
 }
 void Postprocess_RTAO(
 	const RTAOResources& res,
+	const RTDenoiserResources& denoiser,
 	const Scene& scene,
 	const Texture& depthbuffer,
 	const Texture& lineardepth,
@@ -10808,7 +15408,7 @@ void Postprocess_RTAO(
 
 	const TextureDesc& desc = output.GetDesc();
 
-	device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_RTAO], cmd);
+	device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_RTAO), cmd);
 
 	device->BindResource(CS, &scene.TLAS, TEXSLOT_ACCELERATION_STRUCTURE, cmd);
 	device->BindResource(CS, &depthbuffer, TEXSLOT_DEPTH, cmd);
@@ -10820,7 +15420,7 @@ void Postprocess_RTAO(
 
 	const GPUResource* uavs[] = {
 		&output,
-		&res.normals,
+		&denoiser.normals,
 		&res.tiles
 	};
 	device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
@@ -10839,7 +15439,7 @@ void Postprocess_RTAO(
 	{
 		GPUBarrier barriers[] = {
 			GPUBarrier::Image(&output, output.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
-			GPUBarrier::Image(&res.normals, res.normals.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+			GPUBarrier::Image(&denoiser.normals, denoiser.normals.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
 			GPUBarrier::Buffer(&res.tiles, BUFFER_STATE_SHADER_RESOURCE_COMPUTE, BUFFER_STATE_UNORDERED_ACCESS),
 		};
 		device->Barrier(barriers, arraysize(barriers), cmd);
@@ -10855,7 +15455,7 @@ void Postprocess_RTAO(
 	{
 		GPUBarrier barriers[] = {
 			GPUBarrier::Memory(),
-			GPUBarrier::Image(&res.normals, IMAGE_LAYOUT_UNORDERED_ACCESS, res.normals.desc.layout),
+			GPUBarrier::Image(&denoiser.normals, IMAGE_LAYOUT_UNORDERED_ACCESS, denoiser.normals.desc.layout),
 			GPUBarrier::Buffer(&res.tiles, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE_COMPUTE),
 		};
 		device->Barrier(barriers, arraysize(barriers), cmd);
@@ -10872,17 +15472,17 @@ void Postprocess_RTAO(
 	// Denoise - Tile Classification:
 	{
 		device->EventBegin("Denoise - Tile Classification", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_RTAO_DENOISE_TILECLASSIFICATION], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_RTAO_DENOISE_TILECLASSIFICATION), cmd);
 
 		device->BindResource(CS, &depthbuffer, TEXSLOT_DEPTH, cmd);
-		device->BindResource(CS, &res.normals, TEXSLOT_ONDEMAND0, cmd);
+		device->BindResource(CS, &denoiser.normals, TEXSLOT_ONDEMAND0, cmd);
 		device->BindResource(CS, &res.tiles, TEXSLOT_ONDEMAND1, cmd);
 		device->BindResource(CS, &res.moments[temporal_history], TEXSLOT_ONDEMAND2, cmd);
-		device->BindResource(CS, &res.scratch[1], TEXSLOT_ONDEMAND3, cmd);
+		device->BindResource(CS, &res.history, TEXSLOT_ONDEMAND3, cmd);
 		device->BindResource(CS, &depth_history, TEXSLOT_ONDEMAND4, cmd);
 
 		const GPUResource* uavs[] = {
-			&res.scratch[0],
+			&denoiser.reprojection[0],
 			&res.moments[temporal_output],
 			&res.metadata
 		};
@@ -10890,7 +15490,7 @@ void Postprocess_RTAO(
 
 		{
 			GPUBarrier barriers[] = {
-				GPUBarrier::Image(&res.scratch[0], res.scratch[0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+				GPUBarrier::Image(&denoiser.reprojection[0], denoiser.reprojection[0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
 				GPUBarrier::Image(&res.moments[temporal_output], res.moments[temporal_output].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
 				GPUBarrier::Buffer(&res.metadata, BUFFER_STATE_SHADER_RESOURCE_COMPUTE, BUFFER_STATE_UNORDERED_ACCESS)
 			};
@@ -10907,7 +15507,7 @@ void Postprocess_RTAO(
 		{
 			GPUBarrier barriers[] = {
 				GPUBarrier::Memory(),
-				GPUBarrier::Image(&res.scratch[0], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[0].desc.layout),
+				GPUBarrier::Image(&denoiser.reprojection[0], IMAGE_LAYOUT_UNORDERED_ACCESS, denoiser.reprojection[0].desc.layout),
 				GPUBarrier::Image(&res.moments[temporal_output], IMAGE_LAYOUT_UNORDERED_ACCESS, res.moments[temporal_output].desc.layout),
 				GPUBarrier::Buffer(&res.metadata, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE_COMPUTE)
 			};
@@ -10920,23 +15520,23 @@ void Postprocess_RTAO(
 	// Denoise - Spatial filtering:
 	{
 		device->EventBegin("Denoise - Filter", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_RTAO_DENOISE_FILTER], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_RTAO_DENOISE_FILTER), cmd);
 
 		device->BindResource(CS, &depthbuffer, TEXSLOT_DEPTH, cmd);
-		device->BindResource(CS, &res.normals, TEXSLOT_ONDEMAND0, cmd);
+		device->BindResource(CS, &denoiser.normals, TEXSLOT_ONDEMAND0, cmd);
 		device->BindResource(CS, &res.metadata, TEXSLOT_ONDEMAND1, cmd);
 
 		// pass0:
 		{
-			device->BindResource(CS, &res.scratch[0], TEXSLOT_ONDEMAND2, cmd);
+			device->BindResource(CS, &denoiser.reprojection[0], TEXSLOT_ONDEMAND2, cmd);
 			const GPUResource* uavs[] = {
-				&res.scratch[1],
+				&res.history,
 				&output
 			};
 			device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
 			{
 				GPUBarrier barriers[] = {
-					GPUBarrier::Image(&res.scratch[1], res.scratch[1].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+					GPUBarrier::Image(&res.history, res.history.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
 				};
 				device->Barrier(barriers, arraysize(barriers), cmd);
 			}
@@ -10956,17 +15556,17 @@ void Postprocess_RTAO(
 
 		// pass1:
 			{
-			device->BindResource(CS, &res.scratch[1], TEXSLOT_ONDEMAND2, cmd);
+			device->BindResource(CS, &res.history, TEXSLOT_ONDEMAND2, cmd);
 			const GPUResource* uavs[] = {
-				&res.scratch[0],
+				&denoiser.reprojection[0],
 				&output
 			};
 			device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
 			{
 				GPUBarrier barriers[] = {
 					GPUBarrier::Memory(),
-					GPUBarrier::Image(&res.scratch[1], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[1].desc.layout),
-					GPUBarrier::Image(&res.scratch[0], res.scratch[0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+					GPUBarrier::Image(&res.history, IMAGE_LAYOUT_UNORDERED_ACCESS, res.history.desc.layout),
+					GPUBarrier::Image(&denoiser.reprojection[0], denoiser.reprojection[0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
 				};
 				device->Barrier(barriers, arraysize(barriers), cmd);
 			}
@@ -10986,17 +15586,17 @@ void Postprocess_RTAO(
 
 		// pass2:
 			{
-			device->BindResource(CS, &res.scratch[0], TEXSLOT_ONDEMAND2, cmd);
+			device->BindResource(CS, &denoiser.reprojection[0], TEXSLOT_ONDEMAND2, cmd);
 			const GPUResource* uavs[] = {
-				&res.scratch[1],
+				&res.history,
 				&output
 			};
 			device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
 			{
 				GPUBarrier barriers[] = {
 					GPUBarrier::Memory(),
-					GPUBarrier::Image(&res.scratch[0], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[0].desc.layout),
-					GPUBarrier::Image(&res.scratch[1], res.scratch[0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+					GPUBarrier::Image(&denoiser.reprojection[0], IMAGE_LAYOUT_UNORDERED_ACCESS, denoiser.reprojection[0].desc.layout),
+					GPUBarrier::Image(&res.history, denoiser.reprojection[0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
 				};
 				device->Barrier(barriers, arraysize(barriers), cmd);
 			}
@@ -11017,7 +15617,7 @@ void Postprocess_RTAO(
 			{
 				GPUBarrier barriers[] = {
 					GPUBarrier::Memory(),
-				GPUBarrier::Image(&res.scratch[1], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[1].desc.layout),
+				GPUBarrier::Image(&res.history, IMAGE_LAYOUT_UNORDERED_ACCESS, res.history.desc.layout),
 				GPUBarrier::Image(&output, IMAGE_LAYOUT_UNORDERED_ACCESS, output.desc.layout),
 				};
 				device->Barrier(barriers, arraysize(barriers), cmd);
@@ -11175,7 +15775,7 @@ void Postprocess_RTReflection(
 	// Temporal pass:
 	{
 		device->EventBegin("Temporal pass", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_SSR_TEMPORAL], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_SSR_TEMPORAL), cmd);
 
 		device->BindResource(CS, &depthbuffer, TEXSLOT_DEPTH, cmd);
 		device->BindResource(CS, &output, TEXSLOT_ONDEMAND0, cmd);
@@ -11217,7 +15817,7 @@ void Postprocess_RTReflection(
 	// Median blur pass:
 	{
 		device->EventBegin("Median blur pass", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_SSR_MEDIAN], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_SSR_MEDIAN), cmd);
 
 		device->BindResource(CS, &depthbuffer, TEXSLOT_DEPTH, cmd);
 		device->BindResource(CS, &res.temporal[temporal_output], TEXSLOT_ONDEMAND0, cmd);
@@ -11313,7 +15913,7 @@ void Postprocess_SSR(
 	// Raytrace pass:
 	{
 		device->EventBegin("Stochastic Raytrace pass", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_SSR_RAYTRACE], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_SSR_RAYTRACE), cmd);
 
 		device->BindResource(CS, &input, TEXSLOT_ONDEMAND0, cmd);
 
@@ -11352,7 +15952,7 @@ void Postprocess_SSR(
 	// Resolve pass:
 	{
 		device->EventBegin("Resolve pass", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_SSR_RESOLVE], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_SSR_RESOLVE), cmd);
 
 		device->BindResource(CS, &res.texture_raytrace, TEXSLOT_ONDEMAND0, cmd);
 		device->BindResource(CS, &input, TEXSLOT_ONDEMAND1, cmd);
@@ -11395,7 +15995,7 @@ void Postprocess_SSR(
 	// Temporal pass:
 	{
 		device->EventBegin("Temporal pass", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_SSR_TEMPORAL], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_SSR_TEMPORAL), cmd);
 
 		device->BindResource(CS, &output, TEXSLOT_ONDEMAND0, cmd);
 		device->BindResource(CS, &res.texture_temporal[temporal_history], TEXSLOT_ONDEMAND1, cmd);
@@ -11436,7 +16036,7 @@ void Postprocess_SSR(
 	// Median blur pass:
 	{
 		device->EventBegin("Median blur pass", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_SSR_MEDIAN], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_SSR_MEDIAN), cmd);
 
 		device->BindResource(CS, &res.texture_temporal[temporal_output], TEXSLOT_ONDEMAND0, cmd);
 
@@ -11490,10 +16090,6 @@ void CreateRTShadowResources(RTShadowResources& res, XMUINT2 resolution)
 	device->CreateTexture(&desc, nullptr, &res.temporal[1]);
 	device->SetName(&res.temporal[1], "rtshadow_temporal[1]");
 
-	desc.Format = FORMAT_R11G11B10_FLOAT;
-	device->CreateTexture(&desc, nullptr, &res.normals);
-	device->SetName(&res.normals, "rtshadow_normals");
-
 	GPUBufferDesc bd;
 	bd.StructureByteStride = sizeof(uint4);
 	bd.ByteWidth = bd.StructureByteStride *
@@ -11509,10 +16105,8 @@ void CreateRTShadowResources(RTShadowResources& res, XMUINT2 resolution)
 	for (int i = 0; i < 4; ++i)
 	{
 		desc.Format = FORMAT_R16G16_FLOAT;
-		device->CreateTexture(&desc, nullptr, &res.scratch[i][0]);
-		device->SetName(&res.scratch[i][0], "rtshadow_scratch[i][0]");
-		device->CreateTexture(&desc, nullptr, &res.scratch[i][1]);
-		device->SetName(&res.scratch[i][1], "rtshadow_scratch[i][1]");
+		device->CreateTexture(&desc, nullptr, &res.history[i]);
+		device->SetName(&res.history[i], "rtshadow_history[i]");
 
 		desc.Format = FORMAT_R11G11B10_FLOAT;
 		device->CreateTexture(&desc, nullptr, &res.moments[i][0]);
@@ -11527,6 +16121,7 @@ void CreateRTShadowResources(RTShadowResources& res, XMUINT2 resolution)
 }
 void Postprocess_RTShadow(
 	const RTShadowResources& res,
+	const RTDenoiserResources& denoiser,
 	const Scene& scene,
 	const Texture& depthbuffer,
 	const Texture& lineardepth,
@@ -11565,7 +16160,7 @@ void Postprocess_RTShadow(
 	device->UpdateBuffer(&constantBuffers[CBTYPE_POSTPROCESS], &cb, cmd);
 	device->BindConstantBuffer(CS, &constantBuffers[CBTYPE_POSTPROCESS], CB_GETBINDSLOT(PostProcessCB), cmd);
 
-	device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_RTSHADOW], cmd);
+	device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_RTSHADOW), cmd);
 
 	device->BindResource(CS, &depthbuffer, TEXSLOT_DEPTH, cmd);
 	device->BindResource(CS, &lineardepth, TEXSLOT_LINEARDEPTH, cmd);
@@ -11578,7 +16173,7 @@ void Postprocess_RTShadow(
 
 	const GPUResource* uavs[] = {
 		&res.temp,
-		&res.normals,
+		&denoiser.normals,
 		&res.tiles
 	};
 	device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
@@ -11586,7 +16181,7 @@ void Postprocess_RTShadow(
 	{
 		GPUBarrier barriers[] = {
 			GPUBarrier::Image(&res.temp, res.temp.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
-			GPUBarrier::Image(&res.normals, res.normals.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+			GPUBarrier::Image(&denoiser.normals, denoiser.normals.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
 			GPUBarrier::Buffer(&res.tiles, BUFFER_STATE_SHADER_RESOURCE_COMPUTE, BUFFER_STATE_UNORDERED_ACCESS),
 		};
 		device->Barrier(barriers, arraysize(barriers), cmd);
@@ -11602,7 +16197,7 @@ void Postprocess_RTShadow(
 	{
 		GPUBarrier barriers[] = {
 			GPUBarrier::Memory(),
-			GPUBarrier::Image(&res.normals, IMAGE_LAYOUT_UNORDERED_ACCESS, res.normals.desc.layout),
+			GPUBarrier::Image(&denoiser.normals, IMAGE_LAYOUT_UNORDERED_ACCESS, denoiser.normals.desc.layout),
 			GPUBarrier::Buffer(&res.tiles, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE_COMPUTE),
 		};
 		device->Barrier(barriers, arraysize(barriers), cmd);
@@ -11617,27 +16212,27 @@ void Postprocess_RTShadow(
 	// Denoise - Tile Classification:
 	{
 		device->EventBegin("Denoise - Tile Classification", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_RTSHADOW_DENOISE_TILECLASSIFICATION], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_RTSHADOW_DENOISE_TILECLASSIFICATION), cmd);
 
 		device->BindResource(CS, &depthbuffer, TEXSLOT_DEPTH, cmd);
-		device->BindResource(CS, &res.normals, TEXSLOT_ONDEMAND0, cmd);
+		device->BindResource(CS, &denoiser.normals, TEXSLOT_ONDEMAND0, cmd);
 		device->BindResource(CS, &depth_history, TEXSLOT_ONDEMAND1, cmd);
 		device->BindResource(CS, &res.tiles, TEXSLOT_ONDEMAND2, cmd);
 		device->BindResource(CS, &res.moments[0][temporal_history], TEXSLOT_ONDEMAND3, cmd);
 		device->BindResource(CS, &res.moments[1][temporal_history], TEXSLOT_ONDEMAND4, cmd);
 		device->BindResource(CS, &res.moments[2][temporal_history], TEXSLOT_ONDEMAND5, cmd);
 		device->BindResource(CS, &res.moments[3][temporal_history], TEXSLOT_ONDEMAND6, cmd);
-		device->BindResource(CS, &res.scratch[0][1], TEXSLOT_ONDEMAND7, cmd);
-		device->BindResource(CS, &res.scratch[1][1], TEXSLOT_ONDEMAND8, cmd);
-		device->BindResource(CS, &res.scratch[2][1], TEXSLOT_ONDEMAND9, cmd);
-		device->BindResource(CS, &res.scratch[3][1], TEXSLOT_ONDEMAND10, cmd);
+		device->BindResource(CS, &res.history[0], TEXSLOT_ONDEMAND7, cmd);
+		device->BindResource(CS, &res.history[1], TEXSLOT_ONDEMAND8, cmd);
+		device->BindResource(CS, &res.history[2], TEXSLOT_ONDEMAND9, cmd);
+		device->BindResource(CS, &res.history[3], TEXSLOT_ONDEMAND10, cmd);
 
 		const GPUResource* uavs[] = {
 			&res.metadata,
-			&res.scratch[0][0],
-			&res.scratch[1][0],
-			&res.scratch[2][0],
-			&res.scratch[3][0],
+			&denoiser.reprojection[0],
+			&denoiser.reprojection[1],
+			&denoiser.reprojection[2],
+			&denoiser.reprojection[3],
 			&res.moments[0][temporal_output],
 			&res.moments[1][temporal_output],
 			&res.moments[2][temporal_output],
@@ -11648,10 +16243,10 @@ void Postprocess_RTShadow(
 	{
 			GPUBarrier barriers[] = {
 				GPUBarrier::Buffer(&res.metadata, BUFFER_STATE_SHADER_RESOURCE_COMPUTE, BUFFER_STATE_UNORDERED_ACCESS),
-				GPUBarrier::Image(&res.scratch[0][0], res.scratch[0][0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
-				GPUBarrier::Image(&res.scratch[1][0], res.scratch[1][0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
-				GPUBarrier::Image(&res.scratch[2][0], res.scratch[2][0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
-				GPUBarrier::Image(&res.scratch[3][0], res.scratch[3][0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+				GPUBarrier::Image(&denoiser.reprojection[0], denoiser.reprojection[0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+				GPUBarrier::Image(&denoiser.reprojection[1], denoiser.reprojection[1].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+				GPUBarrier::Image(&denoiser.reprojection[2], denoiser.reprojection[2].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+				GPUBarrier::Image(&denoiser.reprojection[3], denoiser.reprojection[3].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
 				GPUBarrier::Image(&res.moments[0][temporal_output], res.moments[0][temporal_output].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
 				GPUBarrier::Image(&res.moments[1][temporal_output], res.moments[1][temporal_output].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
 				GPUBarrier::Image(&res.moments[2][temporal_output], res.moments[2][temporal_output].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
@@ -11671,10 +16266,10 @@ void Postprocess_RTShadow(
 			GPUBarrier barriers[] = {
 				GPUBarrier::Memory(),
 				GPUBarrier::Buffer(&res.metadata, BUFFER_STATE_UNORDERED_ACCESS, BUFFER_STATE_SHADER_RESOURCE_COMPUTE),
-				GPUBarrier::Image(&res.scratch[0][0], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[0][0].desc.layout),
-				GPUBarrier::Image(&res.scratch[1][0], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[1][0].desc.layout),
-				GPUBarrier::Image(&res.scratch[2][0], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[2][0].desc.layout),
-				GPUBarrier::Image(&res.scratch[3][0], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[3][0].desc.layout),
+				GPUBarrier::Image(&denoiser.reprojection[0], IMAGE_LAYOUT_UNORDERED_ACCESS, denoiser.reprojection[0].desc.layout),
+				GPUBarrier::Image(&denoiser.reprojection[1], IMAGE_LAYOUT_UNORDERED_ACCESS, denoiser.reprojection[1].desc.layout),
+				GPUBarrier::Image(&denoiser.reprojection[2], IMAGE_LAYOUT_UNORDERED_ACCESS, denoiser.reprojection[2].desc.layout),
+				GPUBarrier::Image(&denoiser.reprojection[3], IMAGE_LAYOUT_UNORDERED_ACCESS, denoiser.reprojection[3].desc.layout),
 				GPUBarrier::Image(&res.moments[0][temporal_output], IMAGE_LAYOUT_UNORDERED_ACCESS, res.moments[0][temporal_output].desc.layout),
 				GPUBarrier::Image(&res.moments[1][temporal_output], IMAGE_LAYOUT_UNORDERED_ACCESS, res.moments[1][temporal_output].desc.layout),
 				GPUBarrier::Image(&res.moments[2][temporal_output], IMAGE_LAYOUT_UNORDERED_ACCESS, res.moments[2][temporal_output].desc.layout),
@@ -11690,32 +16285,32 @@ void Postprocess_RTShadow(
 	// Denoise - Spatial filtering:
 	{
 		device->EventBegin("Denoise - Filter", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_RTSHADOW_DENOISE_FILTER], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_RTSHADOW_DENOISE_FILTER), cmd);
 
 		device->BindResource(CS, &depthbuffer, TEXSLOT_DEPTH, cmd);
-		device->BindResource(CS, &res.normals, TEXSLOT_ONDEMAND0, cmd);
+		device->BindResource(CS, &denoiser.normals, TEXSLOT_ONDEMAND0, cmd);
 		device->BindResource(CS, &res.metadata, TEXSLOT_ONDEMAND1, cmd);
 
 		// pass0:
 	{
-			device->BindResource(CS, &res.scratch[0][0], TEXSLOT_ONDEMAND2, cmd);
-			device->BindResource(CS, &res.scratch[1][0], TEXSLOT_ONDEMAND3, cmd);
-			device->BindResource(CS, &res.scratch[2][0], TEXSLOT_ONDEMAND4, cmd);
-			device->BindResource(CS, &res.scratch[3][0], TEXSLOT_ONDEMAND5, cmd);
+			device->BindResource(CS, &denoiser.reprojection[0], TEXSLOT_ONDEMAND2, cmd);
+			device->BindResource(CS, &denoiser.reprojection[1], TEXSLOT_ONDEMAND3, cmd);
+			device->BindResource(CS, &denoiser.reprojection[2], TEXSLOT_ONDEMAND4, cmd);
+			device->BindResource(CS, &denoiser.reprojection[3], TEXSLOT_ONDEMAND5, cmd);
 			const GPUResource* uavs[] = {
-				&res.scratch[0][1],
-				&res.scratch[1][1],
-				&res.scratch[2][1],
-				&res.scratch[3][1],
+				&res.history[0],
+				&res.history[1],
+				&res.history[2],
+				&res.history[3],
 				&res.denoised
 			};
 			device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
 			{
 				GPUBarrier barriers[] = {
-					GPUBarrier::Image(&res.scratch[0][1], res.scratch[0][1].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
-					GPUBarrier::Image(&res.scratch[1][1], res.scratch[1][1].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
-					GPUBarrier::Image(&res.scratch[2][1], res.scratch[2][1].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
-					GPUBarrier::Image(&res.scratch[3][1], res.scratch[3][1].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+					GPUBarrier::Image(&res.history[0], res.history[0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+					GPUBarrier::Image(&res.history[1], res.history[1].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+					GPUBarrier::Image(&res.history[2], res.history[2].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+					GPUBarrier::Image(&res.history[3], res.history[3].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
 					GPUBarrier::Image(&res.denoised, res.denoised.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
 				};
 				device->Barrier(barriers, arraysize(barriers), cmd);
@@ -11736,29 +16331,29 @@ void Postprocess_RTShadow(
 
 		// pass1:
 		{
-			device->BindResource(CS, &res.scratch[0][1], TEXSLOT_ONDEMAND2, cmd);
-			device->BindResource(CS, &res.scratch[1][1], TEXSLOT_ONDEMAND3, cmd);
-			device->BindResource(CS, &res.scratch[2][1], TEXSLOT_ONDEMAND4, cmd);
-			device->BindResource(CS, &res.scratch[3][1], TEXSLOT_ONDEMAND5, cmd);
+			device->BindResource(CS, &res.history[0], TEXSLOT_ONDEMAND2, cmd);
+			device->BindResource(CS, &res.history[1], TEXSLOT_ONDEMAND3, cmd);
+			device->BindResource(CS, &res.history[2], TEXSLOT_ONDEMAND4, cmd);
+			device->BindResource(CS, &res.history[3], TEXSLOT_ONDEMAND5, cmd);
 			const GPUResource* uavs[] = {
-				&res.scratch[0][0],
-				&res.scratch[1][0],
-				&res.scratch[2][0],
-				&res.scratch[3][0],
+				&denoiser.reprojection[0],
+				&denoiser.reprojection[1],
+				&denoiser.reprojection[2],
+				&denoiser.reprojection[3],
 				&res.denoised
 			};
 			device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
 			{
 				GPUBarrier barriers[] = {
 					GPUBarrier::Memory(),
-					GPUBarrier::Image(&res.scratch[0][1], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[0][1].desc.layout),
-					GPUBarrier::Image(&res.scratch[1][1], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[1][1].desc.layout),
-					GPUBarrier::Image(&res.scratch[2][1], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[2][1].desc.layout),
-					GPUBarrier::Image(&res.scratch[3][1], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[3][1].desc.layout),
-					GPUBarrier::Image(&res.scratch[0][0], res.scratch[0][0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
-					GPUBarrier::Image(&res.scratch[1][0], res.scratch[1][0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
-					GPUBarrier::Image(&res.scratch[2][0], res.scratch[2][0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
-					GPUBarrier::Image(&res.scratch[3][0], res.scratch[3][0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+					GPUBarrier::Image(&res.history[0], IMAGE_LAYOUT_UNORDERED_ACCESS, res.history[0].desc.layout),
+					GPUBarrier::Image(&res.history[1], IMAGE_LAYOUT_UNORDERED_ACCESS, res.history[1].desc.layout),
+					GPUBarrier::Image(&res.history[2], IMAGE_LAYOUT_UNORDERED_ACCESS, res.history[2].desc.layout),
+					GPUBarrier::Image(&res.history[3], IMAGE_LAYOUT_UNORDERED_ACCESS, res.history[3].desc.layout),
+					GPUBarrier::Image(&denoiser.reprojection[0], denoiser.reprojection[0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+					GPUBarrier::Image(&denoiser.reprojection[1], denoiser.reprojection[1].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+					GPUBarrier::Image(&denoiser.reprojection[2], denoiser.reprojection[2].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+					GPUBarrier::Image(&denoiser.reprojection[3], denoiser.reprojection[3].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
 				};
 				device->Barrier(barriers, arraysize(barriers), cmd);
 			}
@@ -11778,29 +16373,29 @@ void Postprocess_RTShadow(
 
 		// pass2:
 	{
-			device->BindResource(CS, &res.scratch[0][0], TEXSLOT_ONDEMAND2, cmd);
-			device->BindResource(CS, &res.scratch[1][0], TEXSLOT_ONDEMAND3, cmd);
-			device->BindResource(CS, &res.scratch[2][0], TEXSLOT_ONDEMAND4, cmd);
-			device->BindResource(CS, &res.scratch[3][0], TEXSLOT_ONDEMAND5, cmd);
+			device->BindResource(CS, &denoiser.reprojection[0], TEXSLOT_ONDEMAND2, cmd);
+			device->BindResource(CS, &denoiser.reprojection[1], TEXSLOT_ONDEMAND3, cmd);
+			device->BindResource(CS, &denoiser.reprojection[2], TEXSLOT_ONDEMAND4, cmd);
+			device->BindResource(CS, &denoiser.reprojection[3], TEXSLOT_ONDEMAND5, cmd);
 			const GPUResource* uavs[] = {
-				&res.scratch[0][1],
-				&res.scratch[1][1],
-				&res.scratch[2][1],
-				&res.scratch[3][1],
+				&res.history[0],
+				&res.history[1],
+				&res.history[2],
+				&res.history[3],
 				&res.denoised
 			};
 			device->BindUAVs(CS, uavs, 0, arraysize(uavs), cmd);
 			{
 		GPUBarrier barriers[] = {
 					GPUBarrier::Memory(),
-					GPUBarrier::Image(&res.scratch[0][0], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[0][0].desc.layout),
-					GPUBarrier::Image(&res.scratch[1][0], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[1][0].desc.layout),
-					GPUBarrier::Image(&res.scratch[2][0], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[2][0].desc.layout),
-					GPUBarrier::Image(&res.scratch[3][0], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[3][0].desc.layout),
-					GPUBarrier::Image(&res.scratch[0][1], res.scratch[0][0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
-					GPUBarrier::Image(&res.scratch[1][1], res.scratch[1][0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
-					GPUBarrier::Image(&res.scratch[2][1], res.scratch[2][0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
-					GPUBarrier::Image(&res.scratch[3][1], res.scratch[3][0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+					GPUBarrier::Image(&denoiser.reprojection[0], IMAGE_LAYOUT_UNORDERED_ACCESS, denoiser.reprojection[0].desc.layout),
+					GPUBarrier::Image(&denoiser.reprojection[1], IMAGE_LAYOUT_UNORDERED_ACCESS, denoiser.reprojection[1].desc.layout),
+					GPUBarrier::Image(&denoiser.reprojection[2], IMAGE_LAYOUT_UNORDERED_ACCESS, denoiser.reprojection[2].desc.layout),
+					GPUBarrier::Image(&denoiser.reprojection[3], IMAGE_LAYOUT_UNORDERED_ACCESS, denoiser.reprojection[3].desc.layout),
+					GPUBarrier::Image(&res.history[0], denoiser.reprojection[0].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+					GPUBarrier::Image(&res.history[1], denoiser.reprojection[1].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+					GPUBarrier::Image(&res.history[2], denoiser.reprojection[2].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+					GPUBarrier::Image(&res.history[3], denoiser.reprojection[3].desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
 		};
 		device->Barrier(barriers, arraysize(barriers), cmd);
 	}
@@ -11821,10 +16416,10 @@ void Postprocess_RTShadow(
 	{
 		GPUBarrier barriers[] = {
 			GPUBarrier::Memory(),
-				GPUBarrier::Image(&res.scratch[0][1], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[0][1].desc.layout),
-				GPUBarrier::Image(&res.scratch[1][1], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[1][1].desc.layout),
-				GPUBarrier::Image(&res.scratch[2][1], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[2][1].desc.layout),
-				GPUBarrier::Image(&res.scratch[3][1], IMAGE_LAYOUT_UNORDERED_ACCESS, res.scratch[3][1].desc.layout),
+				GPUBarrier::Image(&res.history[0], IMAGE_LAYOUT_UNORDERED_ACCESS, res.history[0].desc.layout),
+				GPUBarrier::Image(&res.history[1], IMAGE_LAYOUT_UNORDERED_ACCESS, res.history[1].desc.layout),
+				GPUBarrier::Image(&res.history[2], IMAGE_LAYOUT_UNORDERED_ACCESS, res.history[2].desc.layout),
+				GPUBarrier::Image(&res.history[3], IMAGE_LAYOUT_UNORDERED_ACCESS, res.history[3].desc.layout),
 				GPUBarrier::Image(&res.denoised, IMAGE_LAYOUT_UNORDERED_ACCESS, res.denoised.desc.layout),
 		};
 		device->Barrier(barriers, arraysize(barriers), cmd);
@@ -11838,7 +16433,7 @@ void Postprocess_RTShadow(
 	// Temporal pass:
 	{
 		device->EventBegin("Temporal Denoise", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_RTSHADOW_DENOISE_TEMPORAL], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_RTSHADOW_DENOISE_TEMPORAL), cmd);
 
 		device->BindResource(CS, &depthbuffer, TEXSLOT_DEPTH, cmd);
 		device->BindResource(CS, &res.temp, TEXSLOT_ONDEMAND0, cmd);
@@ -11962,7 +16557,7 @@ void Postprocess_LightShafts(
 	device->EventBegin("Postprocess_LightShafts", cmd);
 	auto range = wiProfiler::BeginRangeGPU("LightShafts", cmd);
 
-	device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_LIGHTSHAFTS], cmd);
+	device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_LIGHTSHAFTS), cmd);
 
 	device->BindResource(CS, &input, TEXSLOT_ONDEMAND0, cmd);
 
@@ -12092,7 +16687,7 @@ void Postprocess_DepthOfField(
 	// Compute tile max COC (horizontal):
 	{
 		device->EventBegin("TileMax - Horizontal", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_TILEMAXCOC_HORIZONTAL], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_DEPTHOFFIELD_TILEMAXCOC_HORIZONTAL), cmd);
 
 		const GPUResource* uavs[] = {
 			&res.texture_tilemax_horizontal,
@@ -12131,7 +16726,7 @@ void Postprocess_DepthOfField(
 	// Compute tile max COC (vertical):
 	{
 		device->EventBegin("TileMax - Vertical", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_TILEMAXCOC_VERTICAL], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_DEPTHOFFIELD_TILEMAXCOC_VERTICAL), cmd);
 
 		const GPUResource* resarray[] = {
 			&res.texture_tilemax_horizontal,
@@ -12176,7 +16771,7 @@ void Postprocess_DepthOfField(
 	// Compute max COC for each tiles' neighborhood
 	{
 		device->EventBegin("NeighborhoodMax", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_NEIGHBORHOODMAXCOC], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_DEPTHOFFIELD_NEIGHBORHOODMAXCOC), cmd);
 
 		const GPUResource* resarray[] = {
 			&res.texture_tilemax,
@@ -12222,7 +16817,7 @@ void Postprocess_DepthOfField(
 	// Kick indirect tile jobs:
 	{
 		device->EventBegin("Kickjobs", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_KICKJOBS], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_DEPTHOFFIELD_KICKJOBS), cmd);
 
 		device->BindResource(CS, &res.texture_tilemax, TEXSLOT_ONDEMAND0, cmd);
 
@@ -12282,15 +16877,15 @@ void Postprocess_DepthOfField(
 		}
 
 		device->BindResource(CS, &res.buffer_tiles_earlyexit, TEXSLOT_ONDEMAND2, cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_PREPASS_EARLYEXIT], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_DEPTHOFFIELD_PREPASS_EARLYEXIT), cmd);
 		device->DispatchIndirect(&res.buffer_tile_statistics, INDIRECT_OFFSET_EARLYEXIT, cmd);
 
 		device->BindResource(CS, &res.buffer_tiles_cheap, TEXSLOT_ONDEMAND2, cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_PREPASS], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_DEPTHOFFIELD_PREPASS), cmd);
 		device->DispatchIndirect(&res.buffer_tile_statistics, INDIRECT_OFFSET_CHEAP, cmd);
 
 		device->BindResource(CS, &res.buffer_tiles_expensive, TEXSLOT_ONDEMAND2, cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_PREPASS], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_DEPTHOFFIELD_PREPASS), cmd);
 		device->DispatchIndirect(&res.buffer_tile_statistics, INDIRECT_OFFSET_EXPENSIVE, cmd);
 
 		{
@@ -12334,13 +16929,13 @@ void Postprocess_DepthOfField(
 			device->Barrier(barriers, arraysize(barriers), cmd);
 		}
 
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_MAIN_EARLYEXIT], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_DEPTHOFFIELD_MAIN_EARLYEXIT), cmd);
 		device->DispatchIndirect(&res.buffer_tile_statistics, INDIRECT_OFFSET_EARLYEXIT, cmd);
 
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_MAIN_CHEAP], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_DEPTHOFFIELD_MAIN_CHEAP), cmd);
 		device->DispatchIndirect(&res.buffer_tile_statistics, INDIRECT_OFFSET_CHEAP, cmd);
 
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_MAIN], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_DEPTHOFFIELD_MAIN), cmd);
 		device->DispatchIndirect(&res.buffer_tile_statistics, INDIRECT_OFFSET_EXPENSIVE, cmd);
 
 		{
@@ -12359,7 +16954,7 @@ void Postprocess_DepthOfField(
 	// Post filter:
 	{
 		device->EventBegin("Post filter", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_POSTFILTER], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_DEPTHOFFIELD_POSTFILTER), cmd);
 
 		const GPUResource* resarray[] = {
 			&res.texture_main,
@@ -12412,7 +17007,7 @@ void Postprocess_DepthOfField(
 	// Upsample pass:
 	{
 		device->EventBegin("Upsample pass", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_DEPTHOFFIELD_UPSAMPLE], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_DEPTHOFFIELD_UPSAMPLE), cmd);
 
 		const GPUResource* resarray[] = {
 			&input,
@@ -12552,7 +17147,7 @@ void Postprocess_MotionBlur(
 	// Compute tile max velocities (horizontal):
 	{
 		device->EventBegin("TileMax - Horizontal", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_MOTIONBLUR_TILEMAXVELOCITY_HORIZONTAL], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_MOTIONBLUR_TILEMAXVELOCITY_HORIZONTAL), cmd);
 
 		const GPUResource* uavs[] = {
 			&res.texture_tilemax_horizontal,
@@ -12591,7 +17186,7 @@ void Postprocess_MotionBlur(
 	// Compute tile max velocities (vertical):
 	{
 		device->EventBegin("TileMax - Vertical", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_MOTIONBLUR_TILEMAXVELOCITY_VERTICAL], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_MOTIONBLUR_TILEMAXVELOCITY_VERTICAL), cmd);
 
 		device->BindResource(CS, &res.texture_tilemax_horizontal, TEXSLOT_ONDEMAND0, cmd);
 
@@ -12632,7 +17227,7 @@ void Postprocess_MotionBlur(
 	// Compute max velocities for each tiles' neighborhood
 	{
 		device->EventBegin("NeighborhoodMax", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_MOTIONBLUR_NEIGHBORHOODMAXVELOCITY], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_MOTIONBLUR_NEIGHBORHOODMAXVELOCITY), cmd);
 
 		const GPUResource* resarray[] = {
 			&res.texture_tilemax,
@@ -12678,7 +17273,7 @@ void Postprocess_MotionBlur(
 	// Kick indirect tile jobs:
 	{
 		device->EventBegin("Kickjobs", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_MOTIONBLUR_KICKJOBS], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_MOTIONBLUR_KICKJOBS), cmd);
 
 		device->BindResource(CS, &res.texture_tilemax, TEXSLOT_ONDEMAND0, cmd);
 
@@ -12730,13 +17325,13 @@ void Postprocess_MotionBlur(
 			device->Barrier(barriers, arraysize(barriers), cmd);
 		}
 
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_MOTIONBLUR_EARLYEXIT], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_MOTIONBLUR_EARLYEXIT), cmd);
 		device->DispatchIndirect(&res.buffer_tile_statistics, INDIRECT_OFFSET_EARLYEXIT, cmd);
 
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_MOTIONBLUR_CHEAP], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_MOTIONBLUR_CHEAP), cmd);
 		device->DispatchIndirect(&res.buffer_tile_statistics, INDIRECT_OFFSET_CHEAP, cmd);
 
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_MOTIONBLUR], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_MOTIONBLUR), cmd);
 		device->DispatchIndirect(&res.buffer_tile_statistics, INDIRECT_OFFSET_EXPENSIVE, cmd);
 
 		{
@@ -12808,7 +17403,7 @@ void Postprocess_Bloom(
 		device->UpdateBuffer(&constantBuffers[CBTYPE_POSTPROCESS], &cb, cmd);
 		device->BindConstantBuffer(CS, &constantBuffers[CBTYPE_POSTPROCESS], CB_GETBINDSLOT(PostProcessCB), cmd);
 
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_BLOOMSEPARATE], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_BLOOMSEPARATE), cmd);
 
 		device->BindResource(CS, &input, TEXSLOT_ONDEMAND0, cmd);
 
@@ -12865,7 +17460,7 @@ void Postprocess_Bloom(
 		device->UpdateBuffer(&constantBuffers[CBTYPE_POSTPROCESS], &cb, cmd);
 		device->BindConstantBuffer(CS, &constantBuffers[CBTYPE_POSTPROCESS], CB_GETBINDSLOT(PostProcessCB), cmd);
 
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_BLOOMCOMBINE], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_BLOOMCOMBINE), cmd);
 
 		device->BindResource(CS, &input, TEXSLOT_ONDEMAND0, cmd);
 		device->BindResource(CS, &res.texture_bloom, TEXSLOT_ONDEMAND1, cmd);
@@ -12904,10 +17499,126 @@ void Postprocess_Bloom(
 	wiProfiler::EndRange(range);
 	device->EventEnd(cmd);
 }
-void CreateVolumetricCloudResources(VolumetricCloudResources& res, XMUINT2 resolution)
+void DeclareTransientTexture(TransientTextureResources& res, Texture& texture, uint32_t first_pass, uint32_t last_pass)
+{
+	assert(first_pass <= last_pass);
+	TransientTextureResources::Entry entry;
+	entry.texture = &texture;
+	entry.first_pass = first_pass;
+	entry.last_pass = last_pass;
+	res.entries.push_back(entry);
+}
+void CreateTransientTextureResources(TransientTextureResources& res)
+{
+	res.memory = GPUBuffer();
+	res.memory_saved = 0;
+	if (!device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RESOURCE_ALIASING))
+	{
+		return;
+	}
+
+	const uint64_t alignment = 64 * 1024;
+	std::vector<TransientTextureResources::Entry*> sorted;
+	for (auto& entry : res.entries)
+	{
+		const TextureDesc& desc = entry.texture->GetDesc();
+		entry.aliased = false;
+		entry.size = 0;
+		if (!entry.texture->IsValid() || (desc.BindFlags & (BIND_RENDER_TARGET | BIND_DEPTH_STENCIL)) || desc.Usage == USAGE_STAGING)
+		{
+			continue;
+		}
+		entry.size = device->GetTextureMemorySize(&desc);
+		if (entry.size > 0)
+		{
+			sorted.push_back(&entry);
+		}
+	}
+
+	// The largest textures are placed first, each at the lowest offset that doesn't overlap with a placed texture of an overlapping pass range:
+	std::sort(sorted.begin(), sorted.end(), [](const TransientTextureResources::Entry* a, const TransientTextureResources::Entry* b) {
+		return a->size > b->size;
+	});
+	uint64_t memory_size = 0;
+	uint64_t total_size = 0;
+	for (size_t i = 0; i < sorted.size(); ++i)
+	{
+		TransientTextureResources::Entry& entry = *sorted[i];
+		uint64_t offset = 0;
+		bool moved = true;
+		while (moved)
+		{
+			moved = false;
+			for (size_t j = 0; j < i; ++j)
+			{
+				const TransientTextureResources::Entry& placed = *sorted[j];
+				const bool passes_overlap = entry.first_pass <= placed.last_pass && placed.first_pass <= entry.last_pass;
+				if (passes_overlap && offset < placed.offset + placed.size && placed.offset < offset + entry.size)
+				{
+					offset = (uint64_t)Align((size_t)(placed.offset + placed.size), (size_t)alignment);
+					moved = true;
+				}
+			}
+		}
+		entry.offset = offset;
+		memory_size = std::max(memory_size, offset + entry.size);
+		total_size += entry.size;
+	}
+	if (sorted.empty() || memory_size >= total_size || memory_size > UINT32_MAX - alignment)
+	{
+		return;
+	}
+
+	GPUBufferDesc bufferdesc;
+	bufferdesc.ByteWidth = (uint32_t)Align((size_t)memory_size, (size_t)alignment);
+	bufferdesc.MiscFlags = RESOURCE_MISC_ALIASING_TEXTURE_NON_RT_DS;
+	if (!device->CreateBuffer(&bufferdesc, nullptr, &res.memory))
+	{
+		res.memory = GPUBuffer();
+		return;
+	}
+	device->SetName(&res.memory, "TransientTextureResources::memory");
+
+	for (auto entry : sorted)
+	{
+		const TextureDesc desc = entry->texture->GetDesc();
+		Texture texture;
+		if (device->CreateTexture(&desc, nullptr, &texture, &res.memory, entry->offset))
+		{
+			*entry->texture = texture;
+			entry->aliased = true;
+			res.memory_saved += entry->size;
+		}
+	}
+	res.memory_saved = res.memory_saved > bufferdesc.ByteWidth ? res.memory_saved - bufferdesc.ByteWidth : 0;
+}
+void BeginTransientPass(const TransientTextureResources& res, uint32_t pass, CommandList cmd)
+{
+	GPUBarrier barriers[16];
+	uint32_t barrier_count = 0;
+	for (auto& entry : res.entries)
+	{
+		if (entry.aliased && entry.first_pass == pass)
+		{
+			barriers[barrier_count++] = GPUBarrier::Aliasing(nullptr, entry.texture);
+			if (barrier_count == arraysize(barriers))
+			{
+				device->Barrier(barriers, barrier_count, cmd);
+				barrier_count = 0;
+			}
+		}
+	}
+	if (barrier_count > 0)
+	{
+		device->Barrier(barriers, barrier_count, cmd);
+	}
+}
+void CreateVolumetricCloudResources(VolumetricCloudResources& res, XMUINT2 resolution, uint32_t blocksize)
 {
-	XMUINT2 renderResolution = XMUINT2(resolution.x / 4, resolution.y / 4);
+	assert(blocksize == 2 || blocksize == 4);
+	res.blocksize = blocksize;
 	XMUINT2 reprojectionResolution = XMUINT2(resolution.x / 2, resolution.y / 2);
+	XMUINT2 renderResolution = XMUINT2((reprojectionResolution.x + blocksize - 1) / blocksize, (reprojectionResolution.y + blocksize - 1) / blocksize);
 	XMUINT2 maskResolution = XMUINT2(resolution.x / 4, resolution.y / 4); // Needs to be half of final cloud output
 
 	TextureDesc desc;
@@ -12950,7 +17661,8 @@ void CreateVolumetricCloudResources(VolumetricCloudResources& res, XMUINT2 resol
 void Postprocess_VolumetricClouds(
 	const VolumetricCloudResources& res,
 	const Texture& depthbuffer,
-	CommandList cmd
+	CommandList cmd,
+	bool history_reset
 )
 {
 	device->EventBegin("Postprocess_VolumetricClouds", cmd);
@@ -12968,13 +17680,17 @@ void Postprocess_VolumetricClouds(
 	cb.xPPParams0.y = (float)res.texture_reproject[0].GetDesc().Height;
 	cb.xPPParams0.z = 1.0f / cb.xPPParams0.x;
 	cb.xPPParams0.w = 1.0f / cb.xPPParams0.y;
+	cb.volumetricclouds_blocksize = (float)res.blocksize;
+	cb.volumetricclouds_historyreset = history_reset ? 1.0f : 0.0f;
+	cb.xPPParams1.z = 0;
+	cb.xPPParams1.w = 0;
 	device->UpdateBuffer(&constantBuffers[CBTYPE_POSTPROCESS], &cb, cmd);
 	device->BindConstantBuffer(CS, &constantBuffers[CBTYPE_POSTPROCESS], CB_GETBINDSLOT(PostProcessCB), cmd);
 
 	// Cloud pass:
 	{
 		device->EventBegin("Volumetric Cloud Rendering", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_RENDER], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_RENDER), cmd);
 
 		device->BindResource(CS, &depthbuffer, TEXSLOT_DEPTH, cmd);
 		device->BindResource(CS, &texture_shapeNoise, TEXSLOT_ONDEMAND1, cmd);
@@ -13032,7 +17748,7 @@ void Postprocess_VolumetricClouds(
 	// Reprojection pass:
 	{
 		device->EventBegin("Volumetric Cloud Reproject", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_REPROJECT], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_REPROJECT), cmd);
 
 		device->BindResource(CS, &depthbuffer, TEXSLOT_DEPTH, cmd);
 		device->BindResource(CS, &res.texture_cloudRender, TEXSLOT_ONDEMAND0, cmd);
@@ -13077,7 +17793,7 @@ void Postprocess_VolumetricClouds(
 	// Temporal pass:
 		{
 		device->EventBegin("Volumetric Cloud Temporal", cmd);
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_TEMPORAL], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_VOLUMETRICCLOUDS_TEMPORAL), cmd);
 
 		device->BindResource(CS, &depthbuffer, TEXSLOT_DEPTH, cmd);
 		device->BindResource(CS, &res.texture_reproject[temporal_output], TEXSLOT_ONDEMAND0, cmd);
@@ -13351,7 +18067,12 @@ void Postprocess_TemporalAA(
 	device->EventBegin("Postprocess_TemporalAA", cmd);
 	auto range = wiProfiler::BeginRangeGPU("Temporal AA Resolve", cmd);
 
-	device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_TEMPORALAA], cmd);
+	const TextureDesc& desc = output.GetDesc();
+	const TextureDesc& input_desc = input_current.GetDesc();
+
+	// The output (and history) larger than the current frame is temporal upscaling:
+	const bool upsample = desc.Width != input_desc.Width || desc.Height != input_desc.Height;
+	device->BindComputeShader(&shaders[upsample ? CSTYPE_POSTPROCESS_TEMPORALAA_UPSAMPLE : CSTYPE_POSTPROCESS_TEMPORALAA], cmd);
 
 	device->BindResource(CS, &input_current, TEXSLOT_ONDEMAND0, cmd);
 	device->BindResource(CS, &input_history, TEXSLOT_ONDEMAND1, cmd);
@@ -13359,13 +18080,15 @@ void Postprocess_TemporalAA(
 	device->BindResource(CS, &lineardepth, TEXSLOT_LINEARDEPTH, cmd);
 	device->BindResource(CS, &gbuffer[GBUFFER_VELOCITY], TEXSLOT_GBUFFER2, cmd);
 
-	const TextureDesc& desc = output.GetDesc();
-
 	PostProcessCB cb;
 	cb.xPPResolution.x = desc.Width;
 	cb.xPPResolution.y = desc.Height;
 	cb.xPPResolution_rcp.x = 1.0f / cb.xPPResolution.x;
 	cb.xPPResolution_rcp.y = 1.0f / cb.xPPResolution.y;
+	cb.xPPParams0.x = (float)input_desc.Width;
+	cb.xPPParams0.y = (float)input_desc.Height;
+	cb.xPPParams0.z = 1.0f / cb.xPPParams0.x;
+	cb.xPPParams0.w = 1.0f / cb.xPPParams0.y;
 	device->UpdateBuffer(&constantBuffers[CBTYPE_POSTPROCESS], &cb, cmd);
 	device->BindConstantBuffer(CS, &constantBuffers[CBTYPE_POSTPROCESS], CB_GETBINDSLOT(PostProcessCB), cmd);
 
@@ -13401,11 +18124,25 @@ void Postprocess_TemporalAA(
 	wiProfiler::EndRange(range);
 	device->EventEnd(cmd);
 }
-void Postprocess_DepthPyramid(
+void Postprocess_DepthPyramid_Prepare(
 	const Texture& depthbuffer,
 	const Texture& lineardepth,
 	CommandList cmd
 )
+{
+	GPUBarrier barriers[] = {
+		GPUBarrier::Image(&lineardepth, lineardepth.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS),
+		GPUBarrier::Image(&depthbuffer, depthbuffer.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS, 1),
+		GPUBarrier::Image(&depthbuffer, depthbuffer.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS, 2),
+	};
+	device->BarrierBegin(barriers, arraysize(barriers), cmd);
+}
+void Postprocess_DepthPyramid(
+	const Texture& depthbuffer,
+	const Texture& lineardepth,
+	CommandList cmd,
+	bool prepared
+)
 {
 	device->EventBegin("Postprocess_DepthPyramid", cmd);
 	auto range = wiProfiler::BeginRangeGPU("Depth Pyramid", cmd);
@@ -13444,7 +18181,14 @@ void Postprocess_DepthPyramid(
 			GPUBarrier::Image(&depthbuffer, depthbuffer.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS, 1),
 			GPUBarrier::Image(&depthbuffer, depthbuffer.desc.layout, IMAGE_LAYOUT_UNORDERED_ACCESS, 2),
 		};
-		device->Barrier(barriers, arraysize(barriers), cmd);
+		if (prepared)
+		{
+			device->BarrierEnd(barriers, arraysize(barriers), cmd);
+		}
+		else
+		{
+			device->Barrier(barriers, arraysize(barriers), cmd);
+		}
 	}
 
 	device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_LINEARDEPTH], cmd);
@@ -13534,12 +18278,28 @@ void Postprocess_Tonemap(
 	const Texture* texture_colorgradinglut,
 	const Texture* texture_distortion,
 	const Texture* texture_luminance,
-	float eyeadaptionkey
+	float eyeadaptionkey,
+	float sharpen,
+	float chromatic_aberration
 )
 {
 	device->EventBegin("Postprocess_Tonemap", cmd);
 
-	device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_TONEMAP], cmd);
+	// The sharpen and chromatic aberration filters are compiled into permutations of the tonemap shader, so they don't cost a full screen pass each:
+	SHADERTYPE shadertype = CSTYPE_POSTPROCESS_TONEMAP;
+	if (sharpen > 0 && chromatic_aberration > 0)
+	{
+		shadertype = CSTYPE_POSTPROCESS_TONEMAP_SHARPEN_CHROMATIC_ABERRATION;
+	}
+	else if (sharpen > 0)
+	{
+		shadertype = CSTYPE_POSTPROCESS_TONEMAP_SHARPEN;
+	}
+	else if (chromatic_aberration > 0)
+	{
+		shadertype = CSTYPE_POSTPROCESS_TONEMAP_CHROMATIC_ABERRATION;
+	}
+	device->BindComputeShader(GetShader(shadertype), cmd);
 
 	const TextureDesc& desc = output.GetDesc();
 
@@ -13554,6 +18314,8 @@ void Postprocess_Tonemap(
 	cb.tonemap_eyeadaption = texture_luminance == nullptr ? 0.0f : 1.0f;
 	cb.tonemap_distortion = texture_distortion == nullptr ? 0.0f : 1.0f;
 	cb.tonemap_eyeadaptionkey = eyeadaptionkey;
+	cb.tonemap_sharpen = sharpen;
+	cb.tonemap_chromatic_aberration = chromatic_aberration;
 
 	assert(texture_colorgradinglut == nullptr || texture_colorgradinglut->desc.type == TextureDesc::TEXTURE_3D); // This must be a 3D lut
 
@@ -13569,6 +18331,8 @@ void Postprocess_Tonemap(
 		push.texture_input_distortion = device->GetDescriptorIndex(texture_distortion, SRV);
 		push.texture_colorgrade_lookuptable = device->GetDescriptorIndex(texture_colorgradinglut, SRV);
 		push.texture_output = device->GetDescriptorIndex(&output, UAV);
+		push.sharpen = cb.tonemap_sharpen;
+		push.chromatic_aberration = cb.tonemap_chromatic_aberration;
 		device->PushConstants(&push, sizeof(push), cmd);
 	}
 	else
@@ -13643,7 +18407,7 @@ void Postprocess_FSR(
 
 	// Upscaling:
 	{
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_FSR_UPSCALING], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_FSR_UPSCALING), cmd);
 
 		FsrEasuCon(
 			cb.const0,
@@ -13696,7 +18460,7 @@ void Postprocess_FSR(
 
 	// Sharpen:
 	{
-		device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_FSR_SHARPEN], cmd);
+		device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_FSR_SHARPEN), cmd);
 
 		FsrRcasCon(cb.const0, sharpness);
 		device->UpdateBuffer(&constantBuffers[CBTYPE_POSTPROCESS_FSR], &cb, cmd);
@@ -13741,7 +18505,7 @@ void Postprocess_Chromatic_Aberration(
 {
 	device->EventBegin("Postprocess_Chromatic_Aberration", cmd);
 
-	device->BindComputeShader(&shaders[CSTYPE_POSTPROCESS_CHROMATIC_ABERRATION], cmd);
+	device->BindComputeShader(GetShader(CSTYPE_POSTPROCESS_CHROMATIC_ABERRATION), cmd);
 
 	device->BindResource(CS, &input, TEXSLOT_ONDEMAND0, cmd);
 
@@ -14080,6 +18844,38 @@ void AddDeferredMIPGen(std::shared_ptr<wiResource> resource, bool preserve_cover
 
 int GetShadowRes2D() { return SHADOWRES_2D; }
 int GetShadowResCube() { return SHADOWRES_CUBE; }
+void SetShadowCachingEnabled(bool enabled)
+{
+	if (shadowCaching != enabled)
+	{
+		shadowCaching = enabled;
+		CreateShadowCache(shadowCache_Spot_2D, SHADOWRES_SPOT_2D, SHADOWCOUNT_SPOT_2D, 1, "shadowCache_Spot_2D");
+		CreateShadowCache(shadowCache_Cube, SHADOWRES_CUBE, SHADOWCOUNT_CUBE, 6, "shadowCache_Cube");
+	}
+}
+bool GetShadowCachingEnabled() { return shadowCaching; }
+void SetShadowCascadeUpdateInterval(uint32_t cascade, uint32_t frames)
+{
+	assert(cascade < CASCADE_COUNT);
+	shadowCascadeUpdateInterval[cascade] = frames;
+}
+uint32_t GetShadowCascadeUpdateInterval(uint32_t cascade)
+{
+	assert(cascade < CASCADE_COUNT);
+	return shadowCascadeUpdateInterval[cascade];
+}
+void SetShadowCascadeScrollingEnabled(bool enabled) { shadowCascadeScrolling = enabled; }
+bool GetShadowCascadeScrollingEnabled() { return shadowCascadeScrolling; }
+void SetShadowReceiverCullingEnabled(bool enabled) { shadowReceiverCulling = enabled; }
+bool GetShadowReceiverCullingEnabled() { return shadowReceiverCulling; }
+void SetEnvProbeRefreshBudget(uint32_t steps, float milliseconds)
+{
+	envProbeRefreshBudgetSteps = steps;
+	envProbeRefreshBudgetMilliseconds = milliseconds;
+}
+uint32_t GetEnvProbeRefreshBudgetSteps() { return envProbeRefreshBudgetSteps; }
+float GetEnvProbeRefreshBudgetMilliseconds() { return envProbeRefreshBudgetMilliseconds; }
+const EnvProbeRefreshStatistics& GetEnvProbeRefreshStatistics() { return envProbeRefreshStatistics; }
 void SetTransparentShadowsEnabled(float value) { TRANSPARENTSHADOWSENABLED = value; }
 float GetTransparentShadowsEnabled()
 {
@@ -14111,19 +18907,58 @@ bool GetToDrawVoxelHelper() { return voxelHelper; }
 void SetToDrawVoxelHelper(bool value) { voxelHelper = value; }
 void SetDebugLightCulling(bool enabled) { debugLightCulling = enabled; }
 bool GetDebugLightCulling() { return debugLightCulling; }
+void SetDebugOverdraw(bool enabled) { debugOverdraw = enabled; }
+bool GetDebugOverdraw() { return debugOverdraw; }
+bool IsOverdrawRender(CommandList cmd) { return overdrawRender[cmd]; }
 void SetAdvancedLightCulling(bool enabled) { advancedLightCulling = enabled; }
 bool GetAdvancedLightCulling() { return advancedLightCulling; }
+void SetClusteredLightCulling(bool enabled) { clusteredLightCulling = enabled; }
+bool GetClusteredLightCulling() { return clusteredLightCulling; }
 void SetVariableRateShadingClassification(bool enabled) { variableRateShadingClassification = enabled; }
 bool GetVariableRateShadingClassification() { return variableRateShadingClassification; }
 void SetVariableRateShadingClassificationDebug(bool enabled) { variableRateShadingClassificationDebug = enabled; }
 bool GetVariableRateShadingClassificationDebug() { return variableRateShadingClassificationDebug; }
+void SetVariableRateShadingPolicy(VARIABLE_RATE_SHADING_PASS pass, SHADING_RATE rate) { variableRateShadingPolicy[pass] = rate; }
+SHADING_RATE GetVariableRateShadingPolicy(VARIABLE_RATE_SHADING_PASS pass) { return variableRateShadingPolicy[pass]; }
 void SetOcclusionCullingEnabled(bool value)
 {
 	occlusionCulling = value;
 }
 bool GetOcclusionCullingEnabled() { return occlusionCulling; }
+void SetOcclusionCullingHiZEnabled(bool enabled) { occlusionCullingHiZ = enabled; }
+bool GetOcclusionCullingHiZEnabled() { return occlusionCullingHiZ; }
 void SetLDSSkinningEnabled(bool enabled) { ldsSkinningEnabled = enabled; }
 bool GetLDSSkinningEnabled() { return ldsSkinningEnabled; }
+void SetSkinningCullingEnabled(bool enabled) { skinningCullingEnabled = enabled; }
+bool GetSkinningCullingEnabled() { return skinningCullingEnabled; }
+void SetGPUBoneTransformsEnabled(bool enabled) { gpuBoneTransformsEnabled = enabled; }
+bool GetGPUBoneTransformsEnabled() { return gpuBoneTransformsEnabled; }
+void SetGPUCullingEnabled(bool enabled) { gpuCullingEnabled = enabled; }
+#ifdef GGREDUCED
+void SetTerrainChunkGPUCullingEnabled(bool enabled)
+{
+	if (enabled && !terrainChunkGPUCulling)
+	{
+		// The occlusion history is not updated any more, so it is reset to visible:
+		for (uint32_t lod = 0; lod < TERRAIN_CHUNK_LODS; lod++)
+		{
+			for (uint32_t i = 0; i < TERRAIN_CHUNKS_PER_LOD; i++)
+			{
+				TerrainChunkOcclusion* pTCO = GGTerrain::GetChunkVisibleMem(lod, i);
+				if (pTCO)
+				{
+					pTCO->history = 1;
+				}
+			}
+		}
+	}
+	terrainChunkGPUCulling = enabled;
+}
+bool GetTerrainChunkGPUCullingEnabled() { return terrainChunkGPUCulling; }
+#endif // GGREDUCED
+bool GetGPUCullingEnabled() { return gpuCullingEnabled; }
+void SetMeshletCullingEnabled(bool enabled) { meshletCullingEnabled = enabled; }
+bool GetMeshletCullingEnabled() { return meshletCullingEnabled; }
 void SetTemporalAAEnabled(bool enabled) { temporalAA = enabled; }
 bool GetTemporalAAEnabled() { return temporalAA; }
 void SetTemporalAADebugEnabled(bool enabled) { temporalAADEBUG = enabled; }
@@ -14132,6 +18967,14 @@ void SetFreezeCullingCameraEnabled(bool enabled) { freezeCullingCamera = enabled
 bool GetFreezeCullingCameraEnabled() { return freezeCullingCamera; }
 void SetVoxelRadianceEnabled(bool enabled)
 {
+	if (enabled && !voxelSceneData.enabled)
+	{
+		// The clipmaps were not kept up to date while disabled:
+		for (auto& clipmap : voxelSceneData.clipmaps)
+		{
+			clipmap.voxelized = false;
+		}
+	}
 	voxelSceneData.enabled = enabled;
 	if (!textures[TEXTYPE_3D_VOXELRADIANCE].IsValid())
 	{
@@ -14139,8 +18982,8 @@ void SetVoxelRadianceEnabled(bool enabled)
 		desc.type = TextureDesc::TEXTURE_3D;
 		desc.Width = voxelSceneData.res;
 		desc.Height = voxelSceneData.res;
-		desc.Depth = voxelSceneData.res;
-		desc.MipLevels = 0;
+		desc.Depth = voxelSceneData.res * VOXEL_GI_CLIPMAP_COUNT; // the clipmaps are stacked along Z
+		desc.MipLevels = voxelSceneData.mips;
 		desc.Format = FORMAT_R16G16B16A16_FLOAT;
 		desc.BindFlags = BIND_UNORDERED_ACCESS | BIND_SHADER_RESOURCE;
 		desc.Usage = USAGE_DEFAULT;
@@ -14176,7 +19019,7 @@ void SetVoxelRadianceEnabled(bool enabled)
 	{
 		GPUBufferDesc desc;
 		desc.StructureByteStride = sizeof(uint32_t) * 2;
-		desc.ByteWidth = desc.StructureByteStride * voxelSceneData.res * voxelSceneData.res * voxelSceneData.res;
+		desc.ByteWidth = desc.StructureByteStride * voxelSceneData.res * voxelSceneData.res * voxelSceneData.res * VOXEL_GI_CLIPMAP_COUNT;
 		desc.BindFlags = BIND_UNORDERED_ACCESS | BIND_SHADER_RESOURCE;
 		desc.CPUAccessFlags = 0;
 		desc.MiscFlags = RESOURCE_MISC_BUFFER_STRUCTURED;
@@ -14186,6 +19029,8 @@ void SetVoxelRadianceEnabled(bool enabled)
 	}
 }
 bool GetVoxelRadianceEnabled() { return voxelSceneData.enabled; }
+void SetVoxelRadianceRefreshInterval(uint32_t frames) { voxelSceneData.refreshInterval = frames; }
+uint32_t GetVoxelRadianceRefreshInterval() { return voxelSceneData.refreshInterval; }
 void SetVoxelRadianceSecondaryBounceEnabled(bool enabled) { voxelSceneData.secondaryBounceEnabled = enabled; }
 bool GetVoxelRadianceSecondaryBounceEnabled() { return voxelSceneData.secondaryBounceEnabled; }
 void SetVoxelRadianceReflectionsEnabled(bool enabled) { voxelSceneData.reflectionsEnabled = enabled; }
@@ -12,6 +12,7 @@
 
 struct RAY;
 struct wiResource;
+struct RaytracingTile;
 
 namespace wiRenderer
 {
@@ -22,12 +23,19 @@ namespace wiRenderer
 		return (userStencilRef << 4) | static_cast<uint8_t>(engineStencilRef);
 	}
 
+	// Clustered entity culling divides the culling tiles into depth slices, instead of using the depth bounds from the depth buffer
+	//	The same clusters are used by opaque and transparent passes, and the tiled light resources must be recreated after changing this (RenderPath3D does it)
+	//	The light culling debug heatmap is not available with clustered culling
+	void SetClusteredLightCulling(bool enabled);
+	bool GetClusteredLightCulling();
+
+	// The z component is the count of depth slices, which is 1 for tiled culling
 	inline XMUINT3 GetEntityCullingTileCount(XMUINT2 internalResolution)
 	{
 		return XMUINT3(
 			(internalResolution.x + TILED_CULLING_BLOCKSIZE - 1) / TILED_CULLING_BLOCKSIZE,
 			(internalResolution.y + TILED_CULLING_BLOCKSIZE - 1) / TILED_CULLING_BLOCKSIZE,
-			1
+			GetClusteredLightCulling() ? CLUSTERED_CULLING_SLICES : 1
 		);
 	}
 
@@ -44,6 +52,11 @@ namespace wiRenderer
 
 
 	void Initialize();
+	// The stages of Initialize(), so that they can run as separate tasks (see wiInitializer)
+	//	The states must be created first, because the pipeline states of the shaders (and of other systems) refer to them
+	void InitializeStates();
+	void InitializeShaders();
+	void InitializeShadowMaps();
 
 	// Clears the scene and the associated renderer resources
 	void ClearWorld(wiScene::Scene& scene);
@@ -55,24 +68,53 @@ namespace wiRenderer
 
 	// Returns the shader binary directory
 	const std::string& GetShaderPath();
-	// Sets the shader binary directory
+	// Sets the shader binary directory, and mounts its shader bundle if there is one (see MountShaderBundle())
 	void SetShaderPath(const std::string& path);
+	// Mounts the shader bundle of the shader binary directory if it exists, then the shaders are loaded from it instead of the separate files
+	//	The bundle is a wiPackage next to the directory with the same name and .wipak extension (for example shaders/spirv.wipak for shaders/spirv/)
+	//	It can be generated by OfflineShaderCompiler.exe using the shaderbundle argument. Returns true if the bundle was mounted
+	bool MountShaderBundle();
 	// Returns the shader source directory
 	const std::string& GetShaderSourcePath();
 	// Sets the shader source directory
 	void SetShaderSourcePath(const std::string& path);
-	// Reload shaders
+	// Reload shaders and recreate the pipeline states at a thread safe point (SYSTEM_EVENT_RELOAD_SHADERS)
+	//	The shaders whose binary didn't change since they were created are kept, so only the pipelines that use a changed shader are compiled again
 	void ReloadShaders();
+	// Compile the outdated shaders that were loaded by LoadShader() (see wiShaderCompiler::CheckRegisteredShadersOutdated()), without creating them
+	//	It can be called from a background thread before ReloadShaders(), so the reloading doesn't need to wait for the compiler. Returns the count of compiled shaders
+	uint32_t CompileOutdatedShaders();
+	// Compiles the pipelines of a prewarm list (saved by GraphicsDevice::SavePipelinePrewarmList()) in the background with the job system
+	//	This is meant to be started at level load, after the shaders and pipeline states were created. The list entries whose pipeline state doesn't exist are skipped
+	//	The draws during prewarming are not blocked, the compiled pipelines are picked up after the next SubmitCommandLists()
+	void PrewarmPipelines(const std::string& filename, wiJobSystem::context& ctx);
 	// Returns how many shaders are embedded (if wiShaderDump.h is used)
 	//	wiShaderDump.h can be generated by OfflineShaderCompiler.exe using shaderdump argument
 	size_t GetShaderDumpCount();
 
+	// Counters of the LoadShader() calls, which can be used to show the loading progress while the shaders are loaded by the initialization jobs
+	struct ShaderLoadingStatistics
+	{
+		uint32_t loaded = 0;
+		uint32_t failed = 0;
+	};
+	ShaderLoadingStatistics GetShaderLoadingStatistics();
+
 	bool LoadShader(
 		wiGraphics::SHADERSTAGE stage,
 		wiGraphics::Shader& shader,
 		const std::string& filename,
-		wiGraphics::SHADERMODEL minshadermodel = wiGraphics::SHADERMODEL_5_0
+		wiGraphics::SHADERMODEL minshadermodel = wiGraphics::SHADERMODEL_5_0,
+		const std::vector<std::string>& permutation_defines = {} // compile a permutation of the shader source with these defines (see wiShaderCompiler::GetPermutationFileName())
 	);
+	// The shaders of the optional features (SHADERGROUP) are only registered by LoadShaders(), and created when GetShader() first returns them
+	//	Called by GetShader(), but it can be used to create the shader at a known place. Returns false if it failed to load
+	bool LoadShaderOnDemand(SHADERTYPE id);
+	// Start creating the registered shaders of a group with background priority jobs, so they are created before they are first used
+	//	Every group is only prefetched once after LoadShaders(), so this can be called every frame for the enabled features
+	void PrefetchShaders(SHADERGROUP group);
+	// Count of the registered shaders that are not created yet
+	uint32_t GetOnDemandShaderPendingCount();
 
 
 	struct Visibility
@@ -99,9 +141,14 @@ namespace wiRenderer
 		// wiRenderer::UpdateVisibility() fills these:
 		Frustum frustum;
 		std::vector<uint32_t> visibleObjects;
+		std::vector<uint32_t> objectFrustumResults; // visibility bitmasks of the BVH frustum culling (see wiBVH::CullFrustum())
+		std::vector<uint32_t> lightFrustumResults;
+		std::vector<float> lightDistances; // distance of every light from the camera, for the shadow priority sorting
+		std::vector<uint32_t> decalFrustumResults;
 		std::vector<uint32_t> visibleDecals;
 		std::vector<uint32_t> visibleEnvProbes;
 		std::vector<uint32_t> visibleEmitters;
+		std::vector<uint32_t> simulatedEmitters; // the visible emitters and the off screen ones that are not throttled
 		std::vector<uint32_t> visibleHairs;
 
 		struct VisibleLight
@@ -123,6 +170,7 @@ namespace wiRenderer
 		float closestRefPlane = FLT_MAX;
 		XMFLOAT4 reflectionPlane = XMFLOAT4(0, 1, 0, 0);
 		std::atomic_bool volumetriclight_request{ false };
+		wiOcean::Coverage oceanCoverage;
 
 		void Clear()
 		{
@@ -131,6 +179,7 @@ namespace wiRenderer
 			visibleDecals.clear();
 			visibleEnvProbes.clear();
 			visibleEmitters.clear();
+			simulatedEmitters.clear();
 			visibleHairs.clear();
 
 			object_counter.store(0);
@@ -140,6 +189,7 @@ namespace wiRenderer
 			closestRefPlane = FLT_MAX;
 			planar_reflection_visible = false;
 			volumetriclight_request.store(false);
+			oceanCoverage = {};
 		}
 
 		bool IsRequestedPlanarReflections() const
@@ -154,6 +204,10 @@ namespace wiRenderer
 
 	// Performs frustum culling.
 	void UpdateVisibility(Visibility& vis, float maxApparentSize = 0);
+	// Performs frustum culling once for several cameras (split-screen, or the eyes of stereo rendering)
+	//	shared: filled by the user like for UpdateVisibility(), without the camera. It is culled with the union of the view frusta, and is for the work that the views share: UpdatePerFrameData(), UpdateRenderData() and the shadow maps
+	//	views: the user fills the camera of every view, the rest is filled from the shared results, so that DrawScene() and the like can be called with them
+	void UpdateVisibility_Views(Visibility& shared, Visibility* views, uint32_t view_count, float maxApparentSize = 0);
 	// Prepares the scene for rendering
 	void UpdatePerFrameData(
 		wiScene::Scene& scene,
@@ -169,8 +223,24 @@ namespace wiRenderer
 		const FrameCB& frameCB,
 		wiGraphics::CommandList cmd
 	);
+	// Updates the GPU simulations that are only needed by the later passes of the frame (emitted particles, ocean)
+	//	This doesn't depend on the depth prepass, so it can be executed on an async compute command list after UpdateRenderData()
+	void UpdateRenderDataAsync(
+		const Visibility& vis,
+		wiGraphics::CommandList cmd
+	);
 
-	void UpdateRaytracingAccelerationStructures(const wiScene::Scene& scene, wiGraphics::CommandList cmd);
+	// Build the BLASes of the changed meshes and the TLAS of the scene
+	//	With a camera, the BLAS rebuilds and refits are prioritized by distance and limited by the build budget, the rest are deferred to the next frames
+	//	Without a camera, every BLAS is brought up to date (for example for path tracing)
+	void UpdateRaytracingAccelerationStructures(const wiScene::Scene& scene, wiGraphics::CommandList cmd, const wiScene::CameraComponent* camera = nullptr);
+	// The count of primitives whose BLAS can be rebuilt or refitted in a frame by UpdateRaytracingAccelerationStructures() (0 means no limit)
+	//	The closest deferred BLAS is always built, so a mesh with more primitives than the budget is not starved
+	void SetRaytracingBLASBuildBudget(uint32_t triangles);
+	uint32_t GetRaytracingBLASBuildBudget();
+	// The static BLASes are compacted after their first build, which usually saves about half of their memory
+	void SetRaytracingBLASCompactionEnabled(bool value);
+	bool GetRaytracingBLASCompactionEnabled();
 
 	// Binds all common constant buffers and samplers that may be used in all shaders
 	void BindCommonResources(wiGraphics::CommandList cmd);
@@ -203,11 +273,26 @@ namespace wiRenderer
 		wiGraphics::CommandList cmd,
 		uint32_t flags = DRAWSCENE_OPAQUE
 	);
+	// Draw one part of the scene, so that the draws can be recorded into chunk_count command lists concurrently
+	//	The chunks together draw the same as DrawScene(), every chunk must be drawn with the same vis, renderPass and flags
+	void DrawScene_Chunk(
+		const Visibility& vis,
+		RENDERPASS renderPass,
+		wiGraphics::CommandList cmd,
+		uint32_t flags,
+		uint32_t chunk,
+		uint32_t chunk_count
+	);
+	// The number of DrawScene_Chunk() command lists that are worth recording for the visible objects, 1 if the scene should be drawn with DrawScene()
+	uint32_t GetDrawSceneChunkCount(const Visibility& vis, uint32_t flags);
 
 	// Render mip levels for textures that reqested it:
 	void ProcessDeferredMipGenRequests(wiGraphics::CommandList cmd);
 
+	// The sun, atmosphere and camera of the atmospheric scattering textures, UpdateRenderData() sets them from the frame
+	void SetAtmosphericScatteringInputs(const FrameCB& frameCB, const XMFLOAT3& cameraPosition);
 	// Compute essential atmospheric scattering textures for skybox, fog and clouds
+	//	Only the textures whose inputs changed since the last call are rendered (see SetAtmosphericScatteringInputs())
 	void RenderAtmosphericScatteringTextures(wiGraphics::CommandList cmd);
 	// Update atmospheric scattering primarily for environment probes.
 	void RefreshAtmosphericScatteringTextures(wiGraphics::CommandList cmd);
@@ -236,6 +321,16 @@ namespace wiRenderer
 		bool distortion, 
 		wiGraphics::CommandList cmd
 	);
+	// Draw the overdraw visualizer: the rasterized layers of the objects, impostors, hair and emitted particles are counted
+	//	into the render target of renderpass (single channel float, cleared to zero), then written into output as a heatmap
+	//	Nothing is depth tested, so it shows everything that costs fill rate, and maxOverdraw layers are shown as red
+	void DrawOverdraw(
+		const Visibility& vis,
+		const wiGraphics::RenderPass& renderpass,
+		const wiGraphics::Texture& output,
+		wiGraphics::CommandList cmd,
+		float maxOverdraw = 8
+	);
 	// Draw simple light visualizer geometries
 	void DrawLightVisualizers(
 		const Visibility& vis,
@@ -257,12 +352,33 @@ namespace wiRenderer
 	// Call once per frame to re-render out of date environment probes
 	void RefreshEnvProbes(const Visibility& vis, wiGraphics::CommandList cmd);
 	// Call once per frame to re-render out of date impostors
+	//	Impostors that just got an atlas slot are captured first, and at most the refresh budget of impostors are captured in a frame
 	void RefreshImpostors(const wiScene::Scene& scene, wiGraphics::CommandList cmd);
+	// The count of impostors that are captured in a frame (0 means no limit)
+	void SetImpostorRefreshBudget(uint32_t count);
+	uint32_t GetImpostorRefreshBudget();
 	// Call once per frame to repack out of date decals in the atlas
 	void RefreshDecalAtlas(const wiScene::Scene& scene, wiGraphics::CommandList cmd);
-	// Call once per frame to repack out of date lightmaps in the atlas
+	// Call once per frame to progress lightmap baking and repack out of date lightmaps in the atlas
+	//	The samples of a frame are distributed round-robin between the objects that are baking
 	void RefreshLightmapAtlas(const wiScene::Scene& scene, wiGraphics::CommandList cmd);
-	// Voxelize the scene into a voxel grid 3D texture
+	// The budget of lightmap baking in a frame is the count of samples and the milliseconds of GPU time (0 means no limit)
+	//	When both are 0, every baking object receives one sample per frame, otherwise at least one sample is always taken
+	//	The GPU time of a sample is estimated from the previously measured frames
+	void SetLightmapBakeBudget(uint32_t samples, float milliseconds);
+	uint32_t GetLightmapBakeBudgetSamples();
+	float GetLightmapBakeBudgetMilliseconds();
+	// Objects stop baking when they reached the target count of samples, then their lightmaps are denoised and saved (0 means baking until stopped)
+	void SetLightmapBakeTargetSamples(uint32_t samples);
+	uint32_t GetLightmapBakeTargetSamples();
+	struct LightmapBakeStatistics
+	{
+		uint32_t baking = 0; // objects that are baking
+		uint32_t samples = 0; // samples taken in the last frame
+		float milliseconds = 0; // estimated GPU time of the samples in the last frame
+	};
+	const LightmapBakeStatistics& GetLightmapBakeStatistics();
+	// Voxelize the scene into the cascaded voxel clipmaps around the camera (only the regions that scrolled in or contain moving objects)
 	void VoxelRadiance(const Visibility& vis, wiGraphics::CommandList cmd);
 	// Run a compute shader that will resolve a MSAA depth buffer to a single-sample texture
 	void ResolveMSAADepthBuffer(const wiGraphics::Texture& dst, const wiGraphics::Texture& src, wiGraphics::CommandList cmd);
@@ -270,9 +386,12 @@ namespace wiRenderer
 
 	struct TiledLightResources
 	{
+		XMUINT3 tileCount = {}; // the resources are created for this, z is the count of depth slices with clustered culling
 		wiGraphics::GPUBuffer tileFrustums; // entity culling frustums
-		wiGraphics::GPUBuffer entityTiles_Opaque; // culled entity indices (for opaque pass)
-		wiGraphics::GPUBuffer entityTiles_Transparent; // culled entity indices (for transparent pass)
+		wiGraphics::GPUBuffer entityTiles_Opaque; // culled entity indices (for opaque pass, or for every pass with clustered culling)
+		wiGraphics::GPUBuffer entityTiles_Transparent; // culled entity indices (for transparent pass, not created with clustered culling)
+
+		inline const wiGraphics::GPUBuffer& GetEntityTiles_Transparent() const { return entityTiles_Transparent.IsValid() ? entityTiles_Transparent : entityTiles_Opaque; }
 	};
 	void CreateTiledLightResources(TiledLightResources& res, XMUINT2 resolution);
 	// Compute light grid tiles
@@ -297,12 +416,20 @@ namespace wiRenderer
 		float adaption_rate = 1
 	);
 
+	// The shading rate of a tile is the coarsest that its velocity, depth of field blur (dof_coc_scale > 0) and luminance variance (previous_color != nullptr) allow
+	//	output is used by the opaque passes, output_transparent by the transparent passes, they are limited by the VARIABLE_RATE_SHADING_PASS policies
+	//	previous_color is the scene color of the previous frame, it is sampled at the reprojected position of the pixels
 	void ComputeShadingRateClassification(
 		const wiGraphics::Texture gbuffer[GBUFFER_COUNT],
 		const wiGraphics::Texture& lineardepth,
 		const wiGraphics::Texture& output,
+		const wiGraphics::Texture& output_transparent,
 		const wiGraphics::Texture& debugUAV,
-		wiGraphics::CommandList cmd
+		const wiScene::CameraComponent& camera,
+		wiGraphics::CommandList cmd,
+		const wiGraphics::Texture* previous_color = nullptr,
+		float dof_coc_scale = 0,
+		float dof_max_coc = 18
 	);
 
 	void Postprocess_Blur_Gaussian(
@@ -379,19 +506,27 @@ namespace wiRenderer
 		wiGraphics::CommandList cmd,
 		float power = 2.0f
 		);
-	struct RTAOResources
+	// Half resolution workspace of the ray traced AO and shadow denoisers
+	//	It only holds the textures that don't need to persist between frames, so the effects that are denoised one after the other can share it
+	//	The temporal history stays in the resources of the effects
+	struct RTDenoiserResources
 	{
 		wiGraphics::Texture normals;
-
+		wiGraphics::Texture reprojection[4];
+	};
+	void CreateRTDenoiserResources(RTDenoiserResources& res, XMUINT2 resolution);
+	struct RTAOResources
+	{
 		mutable int frame = 0;
 		wiGraphics::GPUBuffer tiles;
 		wiGraphics::GPUBuffer metadata;
-		wiGraphics::Texture scratch[2];
+		wiGraphics::Texture history;
 		wiGraphics::Texture moments[2];
 	};
 	void CreateRTAOResources(RTAOResources& res, XMUINT2 resolution);
 	void Postprocess_RTAO(
 		const RTAOResources& res,
+		const RTDenoiserResources& denoiser,
 		const wiScene::Scene& scene,
 		const wiGraphics::Texture& depthbuffer,
 		const wiGraphics::Texture& lineardepth,
@@ -439,18 +574,18 @@ namespace wiRenderer
 	{
 		wiGraphics::Texture temp;
 		wiGraphics::Texture temporal[2];
-		wiGraphics::Texture normals;
 
 		mutable int frame = 0;
 		wiGraphics::GPUBuffer tiles;
 		wiGraphics::GPUBuffer metadata;
-		wiGraphics::Texture scratch[4][2];
+		wiGraphics::Texture history[4];
 		wiGraphics::Texture moments[4][2];
 		wiGraphics::Texture denoised;
 	};
 	void CreateRTShadowResources(RTShadowResources& res, XMUINT2 resolution);
 	void Postprocess_RTShadow(
 		const RTShadowResources& res,
+		const RTDenoiserResources& denoiser,
 		const wiScene::Scene& scene,
 		const wiGraphics::Texture& depthbuffer,
 		const wiGraphics::Texture& lineardepth,
@@ -552,6 +687,29 @@ namespace wiRenderer
 		float threshold = 1.0f,
 		float strength = 1.0f
 	);
+	// Textures that are only used within a range of passes of the frame, textures of passes that don't overlap are placed into the same memory
+	//	This only works for textures with shader resource and unordered access binding, whose contents are not kept from earlier passes or frames
+	struct TransientTextureResources
+	{
+		struct Entry
+		{
+			wiGraphics::Texture* texture = nullptr;
+			uint32_t first_pass = 0;
+			uint32_t last_pass = 0;
+			uint64_t size = 0;
+			uint64_t offset = 0;
+			bool aliased = false;
+		};
+		std::vector<Entry> entries;
+		wiGraphics::GPUBuffer memory;
+		uint64_t memory_saved = 0; // bytes that the textures would have needed without aliasing
+	};
+	// Declare an already created texture to be only used between first_pass and last_pass (inclusive)
+	void DeclareTransientTexture(TransientTextureResources& res, wiGraphics::Texture& texture, uint32_t first_pass, uint32_t last_pass);
+	// Place all declared textures into shared memory, the textures are recreated so their views are the default ones
+	void CreateTransientTextureResources(TransientTextureResources& res);
+	// The textures of the pass can be used after this, their contents are undefined until they are written
+	void BeginTransientPass(const TransientTextureResources& res, uint32_t pass, wiGraphics::CommandList cmd);
 	struct VolumetricCloudResources
 	{
 		wiGraphics::Texture texture_cloudRender;
@@ -560,12 +718,17 @@ namespace wiRenderer
 		wiGraphics::Texture texture_reproject_depth[2];
 		wiGraphics::Texture texture_temporal[2];
 		wiGraphics::Texture texture_cloudMask;
+		uint32_t blocksize = 2;
 	};
-	void CreateVolumetricCloudResources(VolumetricCloudResources& res, XMUINT2 resolution);
+	// The clouds are raymarched for one pixel of every blocksize x blocksize block of the reprojection per frame, the rest is reprojected from the previous frames
+	//	blocksize 2 updates the blocks in a checkerboard order, blocksize 4 in Bayer order (1/16 of the pixels per frame)
+	void CreateVolumetricCloudResources(VolumetricCloudResources& res, XMUINT2 resolution, uint32_t blocksize = 2);
+	// history_reset: the reprojection history is discarded, for camera cuts
 	void Postprocess_VolumetricClouds(
 		const VolumetricCloudResources& res,
 		const wiGraphics::Texture& depthbuffer,
-		wiGraphics::CommandList cmd
+		wiGraphics::CommandList cmd,
+		bool history_reset = false
 	);
 	#ifdef GGREDUCED
 	void Postprocess_Rain(
@@ -599,6 +762,7 @@ namespace wiRenderer
 		const wiGraphics::Texture& output,
 		wiGraphics::CommandList cmd
 	);
+	// When the output (and the history) is larger than input_current, the current frame is upscaled into it (temporal upscaling)
 	void Postprocess_TemporalAA(
 		const wiGraphics::Texture& input_current,
 		const wiGraphics::Texture& input_history,
@@ -609,6 +773,14 @@ namespace wiRenderer
 		wiGraphics::CommandList cmd
 	);
 	void Postprocess_DepthPyramid(
+		const wiGraphics::Texture& depthbuffer,
+		const wiGraphics::Texture& lineardepth,
+		wiGraphics::CommandList cmd,
+		bool prepared = false
+	);
+	// Begins the transitions of the depth pyramid outputs (split barriers), so they can overlap with the work before Postprocess_DepthPyramid(..., prepared = true) in the same command list
+	//	The top mip of depthbuffer can still be written in between
+	void Postprocess_DepthPyramid_Prepare(
 		const wiGraphics::Texture& depthbuffer,
 		const wiGraphics::Texture& lineardepth,
 		wiGraphics::CommandList cmd
@@ -628,7 +800,9 @@ namespace wiRenderer
 		const wiGraphics::Texture* texture_colorgradinglut = nullptr,
 		const wiGraphics::Texture* texture_distortion = nullptr,
 		const wiGraphics::Texture* texture_luminance = nullptr,
-		float eyeadaptionkey = 0.115f
+		float eyeadaptionkey = 0.115f,
+		float sharpen = 0, // if greater than 0, the sharpen filter is applied in the same pass
+		float chromatic_aberration = 0 // if greater than 0, the chromatic aberration is applied in the same pass
 	);
 	void Postprocess_FSR(
 		const wiGraphics::Texture& input,
@@ -671,11 +845,95 @@ namespace wiRenderer
 		const wiGraphics::Texture* output_albedo = nullptr,
 		const wiGraphics::Texture* output_normal = nullptr
 	);
+	// Render the scene with ray tracing in tiles of RAYTRACING_TILE_SIZE pixels, every tile is accumulated with its own sample index
+	//	output_moment (optional): R32_FLOAT accumulation of the squared luminance, it is needed for the error estimate
+	//	output_tileerrors (optional): structured buffer of uints, the estimated relative errors of the pixels of a tile are added to its errorIndex,
+	//		in RAYTRACING_TILE_ERROR_SCALE fixed point, it must be cleared before
+	void RayTraceScene(
+		const wiScene::Scene& scene,
+		const wiGraphics::Texture& output,
+		const RaytracingTile* tiles,
+		uint32_t tileCount,
+		wiGraphics::CommandList cmd,
+		const wiGraphics::Texture* output_albedo = nullptr,
+		const wiGraphics::Texture* output_normal = nullptr,
+		const wiGraphics::Texture* output_moment = nullptr,
+		const wiGraphics::GPUBuffer* output_tileerrors = nullptr
+	);
 	// Render the scene BVH with ray tracing to the screen
 	void RayTraceSceneBVH(const wiScene::Scene& scene, wiGraphics::CommandList cmd);
 
 	// Render occluders against a depth buffer
 	void OcclusionCulling_Render(const wiScene::CameraComponent& camera_previous, const Visibility& vis, wiGraphics::CommandList cmd);
+	// Reduces the lineardepth of the camera (output of Postprocess_DepthPyramid) to the Hi-Z occlusion culling grid and copies it for CPU readback
+	void OcclusionCulling_HiZReadback(const wiScene::CameraComponent& camera, const wiGraphics::Texture& lineardepth, wiGraphics::CommandList cmd);
+	// Culls the instances of the next DrawScene(vis, RENDERPASS_MAIN, cmd, flags) on the GPU, must be called outside of a render pass
+	//	lineardepth: the depth prepass of the same camera (output of Postprocess_DepthPyramid) for occlusion culling, or nullptr for frustum culling only
+	void GPUCulling_Prepare(const Visibility& vis, const wiGraphics::Texture* lineardepth, uint32_t flags, wiGraphics::CommandList cmd);
+	// Returns the Hi-Z of the last GPUCulling_Prepare() with lineardepth if it was built in this or the previous frame, otherwise nullptr
+	//	VP, zNearP, zFarP: of the camera that rendered the depth, for occlusion culling with it in other shaders (layout: IMAGE_LAYOUT_SHADER_RESOURCE_COMPUTE)
+	const wiGraphics::Texture* GetGPUCullingHiZ(XMFLOAT4X4& VP, float& zNearP, float& zFarP);
+	// Tests boxes for occlusion against the Hi-Z of GetGPUCullingHiZ() on the GPU, for the systems that draw their own geometry indirectly. Must be called outside of a render pass
+	//	output: raw buffer with BIND_UNORDERED_ACCESS, a uint is written for every box at its output index (or at its index if outputIndices is nullptr): 1 if it can be visible, 0 if it is occluded
+	//	The output is in BUFFER_STATE_SHADER_RESOURCE before and after. Every box is visible if there is no Hi-Z, the frustum culling is up to the caller
+	void GPUCulling_Boxes(const AABB* boxes, uint32_t count, const wiGraphics::GPUBuffer& output, wiGraphics::CommandList cmd, const uint32_t* outputIndices = nullptr);
+
+	// A LOD of the instances of InstanceCulling(), it is selected for the instances that are nearer than distance to the view and not nearer than the distance of the previous LOD
+	//	The last LOD can be an impostor, the LODs only differ in their index ranges for the culling, the drawing system decides what it binds for them
+	struct InstanceCullingLOD
+	{
+		uint32_t indexCount = 0;
+		uint32_t indexOffset = 0;
+		float distance = FLT_MAX;
+	};
+	struct InstanceCullingView
+	{
+		Frustum frustum;
+		XMFLOAT3 position = XMFLOAT3(0, 0, 0); // the LOD distances are measured from here (eg. the main camera for the shadow cascades, so that the shadows match the drawn LODs)
+	};
+	// The indirect draws of InstanceCulling(), draw [view * lodCount + lod] is DrawIndexedInstancedIndirect(&args, draw * GPUCULLING_ARGS_STRIDE)
+	struct InstanceCullingResult
+	{
+		wiGraphics::GPUBuffer args;		// IndirectDrawArgsIndexedInstanced for every draw (BUFFER_STATE_INDIRECT_ARGUMENT)
+		wiGraphics::GPUBuffer visible;	// uint instance indices, those of a draw start at its instance start, so it can be bound as a per instance vertex buffer (BUFFER_STATE_SHADER_RESOURCE)
+		uint32_t instanceCount = 0;
+		uint32_t viewCount = 0;
+		uint32_t lodCount = 0;
+	};
+	// Culls the instances against every view and selects their LOD on the GPU with one dispatch, for the systems that draw many copies of a few meshes in several passes. Must be called outside of a render pass
+	//	occlusionView: the view that is also tested against the Hi-Z of GetGPUCullingHiZ(), or ~0u. The buffers of the result are created or grown when needed
+	void InstanceCulling(
+		const AABB* instances,
+		uint32_t instanceCount,
+		const InstanceCullingLOD* lods,
+		uint32_t lodCount,
+		const InstanceCullingView* views,
+		uint32_t viewCount,
+		uint32_t occlusionView,
+		InstanceCullingResult& result,
+		wiGraphics::CommandList cmd
+	);
+#ifdef GGREDUCED
+	// Tests the terrain chunks that GGTerrain selected for drawing against the Hi-Z of the depth prepass of this frame (it is built from lineardepth if GPUCulling_Prepare() didn't do it)
+	//	Only with SetTerrainChunkGPUCullingEnabled(true). The result is for the draws of this camera only, not for the shadow maps
+	void GPUCulling_TerrainChunks(const wiScene::CameraComponent& camera, const wiGraphics::Texture* lineardepth, wiGraphics::CommandList cmd);
+	// Returns the visibility of the terrain chunks of GPUCulling_TerrainChunks(), a uint for every chunk at [lod * 64 + chunk], or nullptr if the terrain GPU culling is disabled
+	const wiGraphics::GPUBuffer* GetTerrainChunkVisibility();
+
+	// The views of PrepareTreeCulling(), the shadow cascades are those of the first directional light (the trees are not drawn into the farther cascades)
+	enum TREECULLING_VIEW
+	{
+		TREECULLING_VIEW_MAIN,
+		TREECULLING_VIEW_REFLECTION,
+		TREECULLING_VIEW_SHADOWCASCADE0,
+		TREECULLING_VIEW_SHADOWCASCADE1,
+		TREECULLING_VIEW_SHADOWCASCADE2,
+		TREECULLING_VIEW_COUNT
+	};
+	// Gives the views of the frame to GGTrees, so that it can cull its trees once with InstanceCulling() for the main, reflection and shadow passes. Must be called after UpdatePerFrameData(), outside of a render pass
+	//	The views that are not drawn in this frame have a frustum that contains nothing. The main camera is tested against the Hi-Z of the previous frame
+	void PrepareTreeCulling(const Visibility& vis, const wiScene::CameraComponent* camera_reflection, wiGraphics::CommandList cmd);
+#endif // GGREDUCED
 
 
 	enum MIPGENFILTER
@@ -715,6 +973,7 @@ namespace wiRenderer
 
 	// Set any param to -1 if don't want to modify
 	void SetShadowProps2D(int resolution, int count);
+	// Spotlight shadows are packed into an atlas of count pages at this resolution, each light gets a tile sized by its screen coverage
 	void SetShadowPropsSpot2D(int resolution, int count);
 	// Set any param to -1 if don't want to modify
 	void SetShadowPropsCube(int resolution, int count);
@@ -723,6 +982,34 @@ namespace wiRenderer
 	int GetShadowRes2D();
 	// Returns the resolution that is used for all pointlight and area light shadow maps
 	int GetShadowResCube();
+	// Shadow casters that stood still for a while are rendered once per spot and point light into a cache, and only the moving casters are rendered every frame
+	//	The cache of a light is rendered again when the light or its static casters change (requires render target array index output from vertex shaders)
+	void SetShadowCachingEnabled(bool enabled);
+	bool GetShadowCachingEnabled();
+	// A directional light shadow cascade is fully rendered only every frames count (0 and 1 both mean every frame)
+	//	With scrolling, the cascade follows the camera by whole texels in between, and only the strips exposed by the movement are rendered
+	void SetShadowCascadeUpdateInterval(uint32_t cascade, uint32_t frames);
+	uint32_t GetShadowCascadeUpdateInterval(uint32_t cascade);
+	void SetShadowCascadeScrollingEnabled(bool enabled);
+	bool GetShadowCascadeScrollingEnabled();
+	// Shadow casters are also culled against the main camera: a caster is left out when the volume that its bounds sweep along the light rays misses the camera frustum
+	//	It is used for the spot lights (except for their cached static casters) and for the cascades that are rendered in every frame (interval 0 or 1)
+	void SetShadowReceiverCullingEnabled(bool enabled);
+	bool GetShadowReceiverCullingEnabled();
+	// Environment probe refreshes are spread over multiple frames, so that only steps (a cube face, the mip chain or one filtered mip) within the budget are done in a frame
+	//	The budget is the count of steps and the milliseconds for recording them (0 means no limit), at least one step is always done
+	//	Probes closer to the camera are refreshed first, but an already started probe is finished before the next one
+	void SetEnvProbeRefreshBudget(uint32_t steps, float milliseconds);
+	uint32_t GetEnvProbeRefreshBudgetSteps();
+	float GetEnvProbeRefreshBudgetMilliseconds();
+	struct EnvProbeRefreshStatistics
+	{
+		uint32_t queued = 0; // probes that are waiting to be refreshed or not finished yet
+		uint32_t steps = 0; // steps done in the last frame
+		uint32_t completed = 0; // probes that were finished in the last frame
+		float milliseconds = 0; // time spent with recording the steps in the last frame
+	};
+	const EnvProbeRefreshStatistics& GetEnvProbeRefreshStatistics();
 
 
 
@@ -750,16 +1037,58 @@ namespace wiRenderer
 	void SetToDrawVoxelHelper(bool value);
 	void SetDebugLightCulling(bool enabled);
 	bool GetDebugLightCulling();
+	// Overdraw visualizer: the rasterized layers of every pixel are shown as a heatmap, see DrawOverdraw()
+	void SetDebugOverdraw(bool enabled);
+	bool GetDebugOverdraw();
+	// Returns true while DrawOverdraw() is drawing into the command list, the particle systems select their overdraw pipeline states with it
+	bool IsOverdrawRender(wiGraphics::CommandList cmd);
 	void SetAdvancedLightCulling(bool enabled);
 	bool GetAdvancedLightCulling();
 	void SetVariableRateShadingClassification(bool enabled);
 	bool GetVariableRateShadingClassification();
 	void SetVariableRateShadingClassificationDebug(bool enabled);
 	bool GetVariableRateShadingClassificationDebug();
+	enum VARIABLE_RATE_SHADING_PASS
+	{
+		VARIABLE_RATE_SHADING_PASS_OPAQUE,
+		VARIABLE_RATE_SHADING_PASS_TRANSPARENT,
+		VARIABLE_RATE_SHADING_PASS_PARTICLES,
+		VARIABLE_RATE_SHADING_PASS_COUNT
+	};
+	// The coarsest shading rate that the classification selects for the opaque and transparent passes
+	//	The particles are not classified, their policy is the rate that they are drawn with (combined with the material shading rate) while the classification is enabled
+	void SetVariableRateShadingPolicy(VARIABLE_RATE_SHADING_PASS pass, wiGraphics::SHADING_RATE rate);
+	wiGraphics::SHADING_RATE GetVariableRateShadingPolicy(VARIABLE_RATE_SHADING_PASS pass);
 	void SetOcclusionCullingEnabled(bool enabled);
 	bool GetOcclusionCullingEnabled();
+	// Occlusion culling tests the bounds of objects, terrain chunks and shadow lights against the reprojected Hi-Z of an earlier frame instead of occlusion queries
+	//	It requires OcclusionCulling_HiZReadback() to be called after the depth pyramid of the main camera
+	void SetOcclusionCullingHiZEnabled(bool enabled);
+	bool GetOcclusionCullingHiZEnabled();
 	void SetLDSSkinningEnabled(bool enabled);
 	bool GetLDSSkinningEnabled();
+	// The skinning and morph targets of meshes are only computed if they were drawn by any pass in the last frames, or they are visible in the main camera now
+	//	Meshes that are sampled by emitters and hair particles are always computed, and with hardware raytracing every mesh is computed for the acceleration structures
+	void SetSkinningCullingEnabled(bool enabled);
+	bool GetSkinningCullingEnabled();
+	// Armatures upload compact local bone transforms and the skinning matrices are computed by a compute shader
+	//	The armatures with more than BONETRANSFORMS_COMPUTE_THREADCOUNT bones, spring bones or non-uniform scaling use the CPU path
+	void SetGPUBoneTransformsEnabled(bool enabled);
+	bool GetGPUBoneTransformsEnabled();
+	// The opaque main camera pass is culled against the frustum and a Hi-Z pyramid on the GPU, and drawn with indirect draws (bindless only)
+	//	It requires GPUCulling_Prepare() to be called before the render pass, otherwise the pass is drawn as usual
+	void SetGPUCullingEnabled(bool enabled);
+	bool GetGPUCullingEnabled();
+#ifdef GGREDUCED
+	// The terrain chunks are tested against the Hi-Z on the GPU by GPUCulling_TerrainChunks(), instead of occlusion queries or the CPU Hi-Z readback
+	//	The occlusion history of the chunks is not updated then, the terrain draws use GetTerrainChunkVisibility() for their indirect draws instead
+	void SetTerrainChunkGPUCullingEnabled(bool enabled);
+	bool GetTerrainChunkGPUCullingEnabled();
+#endif // GGREDUCED
+	// With GPU culling, the static meshes that have meshlets are also culled per cluster (frustum, backface cone and Hi-Z)
+	//	The indices of the visible clusters are compacted by a compute shader, and every instance is drawn from them with its own indirect draw
+	void SetMeshletCullingEnabled(bool enabled);
+	bool GetMeshletCullingEnabled();
 	void SetTemporalAAEnabled(bool enabled);
 	bool GetTemporalAAEnabled();
 	void SetTemporalAADebugEnabled(bool enabled);
@@ -768,6 +1097,9 @@ namespace wiRenderer
 	bool GetFreezeCullingCameraEnabled();
 	void SetVoxelRadianceEnabled(bool enabled);
 	bool GetVoxelRadianceEnabled();
+	// One clipmap is voxelized completely every interval frames, to pick up light and material changes (0: never)
+	void SetVoxelRadianceRefreshInterval(uint32_t frames);
+	uint32_t GetVoxelRadianceRefreshInterval();
 	void SetVoxelRadianceSecondaryBounceEnabled(bool enabled);
 	bool GetVoxelRadianceSecondaryBounceEnabled();
 	void SetVoxelRadianceReflectionsEnabled(bool enabled);
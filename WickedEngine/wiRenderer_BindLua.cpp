@@ -141,6 +141,19 @@ namespace wiRenderer_BindLua
 		}
 		return 0;
 	}
+	int SetDebugOverdraw(lua_State* L)
+	{
+		int argc = wiLua::SGetArgCount(L);
+		if (argc > 0)
+		{
+			wiRenderer::SetDebugOverdraw(wiLua::SGetBool(L, 1));
+		}
+		else
+		{
+			wiLua::SError(L, "SetDebugOverdraw(bool enabled) not enough arguments!");
+		}
+		return 0;
+	}
 	int SetOcclusionCullingEnabled(lua_State* L)
 	{
 		int argc = wiLua::SGetArgCount(L);
@@ -375,6 +388,7 @@ namespace wiRenderer_BindLua
 			wiLua::RegisterFunc("SetVSyncEnabled", SetVSyncEnabled);
 			wiLua::RegisterFunc("SetResolution", SetResolution);
 			wiLua::RegisterFunc("SetDebugLightCulling", SetDebugLightCulling);
+			wiLua::RegisterFunc("SetDebugOverdraw", SetDebugOverdraw);
 			wiLua::RegisterFunc("SetOcclusionCullingEnabled", SetOcclusionCullingEnabled);
 
 			wiLua::RegisterFunc("DrawLine", DrawLine);
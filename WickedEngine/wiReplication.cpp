@@ -0,0 +1,549 @@
+#include "wiReplication.h"
+#include "wiScene.h"
+
+#include <cstring>
+#include <cmath>
+
+using namespace wiECS;
+
+namespace wiReplication
+{
+	static const uint32_t PACKET_MAGIC = 0x50524977; // "wIRP"
+	enum PACKET_TYPE : uint8_t
+	{
+		PACKET_SNAPSHOT,
+		PACKET_ACK,
+	};
+	struct PacketHeader
+	{
+		uint32_t magic = PACKET_MAGIC;
+		uint32_t snapshot = 0;
+		uint16_t fragment_index = 0;
+		uint16_t fragment_count = 0;
+		PACKET_TYPE type = PACKET_SNAPSHOT;
+		uint8_t padding[3] = {};
+	};
+	static_assert(sizeof(PacketHeader) == 16, "the packet header is sent as it is");
+	static const size_t FRAGMENT_SIZE = wiNetwork::MAX_PACKET_SIZE - sizeof(PacketHeader);
+	static const size_t MAX_FRAGMENTS = 1024; // ~1.4 MB, the biggest snapshot that is sent and reassembled
+
+	inline bool operator==(const wiNetwork::Connection& a, const wiNetwork::Connection& b)
+	{
+		return a.ipaddress == b.ipaddress && a.port == b.port;
+	}
+
+
+	void BitWriter::Write(uint32_t value, uint32_t bits)
+	{
+		assert(bits <= 32);
+		if (bits < 32)
+		{
+			value &= (1u << bits) - 1;
+		}
+		scratch |= uint64_t(value) << scratch_bits;
+		scratch_bits += bits;
+		while (scratch_bits >= 8)
+		{
+			data.push_back(uint8_t(scratch & 0xFF));
+			scratch >>= 8;
+			scratch_bits -= 8;
+		}
+	}
+	void BitWriter::WriteVarint(uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			Write((value & 0x7F) | 0x80, 8);
+			value >>= 7;
+		}
+		Write(value, 8);
+	}
+	void BitWriter::WriteFloat(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		Write(bits, 32);
+	}
+	void BitWriter::WriteQuantized(float value, float min, float max, uint32_t bits)
+	{
+		assert(bits > 0 && bits < 32);
+		const uint32_t steps = (1u << bits) - 1;
+		const float normalized = wiMath::Clamp((value - min) / (max - min), 0, 1);
+		Write(uint32_t(normalized * steps + 0.5f), bits);
+	}
+	void BitWriter::WriteQuaternion(const XMFLOAT4& value)
+	{
+		// The largest component is left out, the others are in the [-1/sqrt(2), 1/sqrt(2)] range:
+		const float components[] = { value.x, value.y, value.z, value.w };
+		uint32_t largest = 0;
+		for (uint32_t i = 1; i < 4; ++i)
+		{
+			if (std::abs(components[i]) > std::abs(components[largest]))
+			{
+				largest = i;
+			}
+		}
+		// q and -q are the same rotation, the left out component is made positive:
+		const float sign = components[largest] < 0 ? -1.0f : 1.0f;
+		Write(largest, 2);
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			if (i != largest)
+			{
+				WriteQuantized(components[i] * sign, -0.70710678f, 0.70710678f, 10);
+			}
+		}
+	}
+	const std::vector<uint8_t>& BitWriter::Finish()
+	{
+		if (scratch_bits > 0)
+		{
+			Write(0, 8 - scratch_bits);
+		}
+		return data;
+	}
+	void BitWriter::Clear()
+	{
+		data.clear();
+		scratch = 0;
+		scratch_bits = 0;
+	}
+
+	uint32_t BitReader::Read(uint32_t bits)
+	{
+		assert(bits <= 32);
+		if (position + bits > size * 8)
+		{
+			valid = false;
+			position = size * 8;
+			return 0;
+		}
+		uint32_t value = 0;
+		uint32_t written = 0;
+		while (written < bits)
+		{
+			const size_t byte = position / 8;
+			const uint32_t offset = uint32_t(position % 8);
+			const uint32_t count = std::min(8 - offset, bits - written);
+			const uint32_t chunk = (uint32_t(data[byte]) >> offset) & ((1u << count) - 1);
+			value |= chunk << written;
+			written += count;
+			position += count;
+		}
+		return value;
+	}
+	uint32_t BitReader::ReadVarint()
+	{
+		uint32_t value = 0;
+		for (uint32_t shift = 0; shift < 35 && valid; shift += 7)
+		{
+			const uint32_t byte = Read(8);
+			value |= (byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				return value;
+			}
+		}
+		valid = false;
+		return 0;
+	}
+	float BitReader::ReadFloat()
+	{
+		const uint32_t bits = Read(32);
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+	float BitReader::ReadQuantized(float min, float max, uint32_t bits)
+	{
+		assert(bits > 0 && bits < 32);
+		const uint32_t steps = (1u << bits) - 1;
+		return min + (max - min) * float(Read(bits)) / float(steps);
+	}
+	XMFLOAT4 BitReader::ReadQuaternion()
+	{
+		const uint32_t largest = Read(2);
+		float components[4];
+		float sum = 0;
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			if (i != largest)
+			{
+				components[i] = ReadQuantized(-0.70710678f, 0.70710678f, 10);
+				sum += components[i] * components[i];
+			}
+		}
+		components[largest] = std::sqrt(std::max(0.0f, 1 - sum));
+		return XMFLOAT4(components[0], components[1], components[2], components[3]);
+	}
+
+
+	void SerializeTransform(const wiScene::TransformComponent& transform, BitWriter& writer)
+	{
+		writer.WriteSignedVarint(int32_t(std::round(transform.translation_local.x * 1000)));
+		writer.WriteSignedVarint(int32_t(std::round(transform.translation_local.y * 1000)));
+		writer.WriteSignedVarint(int32_t(std::round(transform.translation_local.z * 1000)));
+		writer.WriteQuaternion(transform.rotation_local);
+		const bool unit_scale = transform.scale_local.x == 1 && transform.scale_local.y == 1 && transform.scale_local.z == 1;
+		writer.WriteBool(unit_scale);
+		if (!unit_scale)
+		{
+			writer.WriteFloat(transform.scale_local.x);
+			writer.WriteFloat(transform.scale_local.y);
+			writer.WriteFloat(transform.scale_local.z);
+		}
+	}
+	void DeserializeTransform(wiScene::TransformComponent& transform, BitReader& reader)
+	{
+		transform.translation_local.x = float(reader.ReadSignedVarint()) / 1000.0f;
+		transform.translation_local.y = float(reader.ReadSignedVarint()) / 1000.0f;
+		transform.translation_local.z = float(reader.ReadSignedVarint()) / 1000.0f;
+		transform.rotation_local = reader.ReadQuaternion();
+		if (reader.ReadBool())
+		{
+			transform.scale_local = XMFLOAT3(1, 1, 1);
+		}
+		else
+		{
+			transform.scale_local.x = reader.ReadFloat();
+			transform.scale_local.y = reader.ReadFloat();
+			transform.scale_local.z = reader.ReadFloat();
+		}
+		transform.SetDirty();
+	}
+
+
+	uint32_t Server::AddClient(const wiNetwork::Connection& connection)
+	{
+		for (size_t i = 0; i < clients.size(); ++i)
+		{
+			if (clients[i].connection == connection)
+			{
+				return (uint32_t)i;
+			}
+		}
+		ClientState client;
+		client.connection = connection;
+		clients.push_back(client);
+		return uint32_t(clients.size() - 1);
+	}
+	void Server::RemoveClient(const wiNetwork::Connection& connection)
+	{
+		for (size_t i = 0; i < clients.size(); ++i)
+		{
+			if (clients[i].connection == connection)
+			{
+				clients.erase(clients.begin() + i);
+				return;
+			}
+		}
+	}
+
+	const Server::Snapshot* Server::FindSnapshot(uint32_t id) const
+	{
+		const Snapshot& snapshot = history[id % HISTORY];
+		return id != 0 && snapshot.id == id ? &snapshot : nullptr;
+	}
+
+	void Server::Update(const wiNetwork::Socket* sock)
+	{
+		// The changes until now belong to this snapshot, later changes are stamped with a newer version:
+		const uint32_t snapshot_id = next_snapshot++;
+		Snapshot& snapshot = history[snapshot_id % HISTORY];
+		snapshot.id = snapshot_id;
+		snapshot.versions.resize(channels.size());
+		snapshot.structure_versions.resize(channels.size());
+		for (size_t i = 0; i < channels.size(); ++i)
+		{
+			snapshot.versions[i] = channels[i]->AdvanceVersion();
+			snapshot.structure_versions[i] = channels[i]->GetStructureVersion();
+		}
+
+		// The clients that acknowledged the same snapshot get the same delta, it is only encoded once:
+		payloads.clear();
+		for (ClientState& client : clients)
+		{
+			const Snapshot* baseline = FindSnapshot(client.acked);
+			const uint32_t baseline_id = baseline == nullptr ? 0 : baseline->id;
+			if (payloads.count(baseline_id) > 0)
+			{
+				continue;
+			}
+			writer.Clear();
+			writer.Write(baseline_id, 32);
+			for (size_t i = 0; i < channels.size(); ++i)
+			{
+				const bool structure_changed = baseline == nullptr || baseline->structure_versions[i] != snapshot.structure_versions[i];
+				writer.WriteBool(structure_changed);
+				if (structure_changed)
+				{
+					channels[i]->WriteEntities(writer);
+				}
+				channels[i]->WriteChanged(baseline == nullptr ? 0 : baseline->versions[i], writer);
+			}
+			payloads[baseline_id] = writer.Finish();
+		}
+
+		// Every payload is split into fragments that fit into a packet:
+		fragments.clear();
+		messages.clear();
+		std::unordered_map<uint32_t, std::pair<size_t, size_t>> ranges; // baseline -> fragment [offset, count]
+		for (auto& x : payloads)
+		{
+			const std::vector<uint8_t>& payload = x.second;
+			const size_t count = std::max(size_t(1), (payload.size() + FRAGMENT_SIZE - 1) / FRAGMENT_SIZE);
+			if (count > MAX_FRAGMENTS)
+			{
+				assert(0); // snapshot is too big
+				continue;
+			}
+			ranges[x.first] = std::make_pair(fragments.size(), count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				PacketHeader header;
+				header.snapshot = snapshot_id;
+				header.fragment_index = uint16_t(i);
+				header.fragment_count = uint16_t(count);
+				header.type = PACKET_SNAPSHOT;
+				const size_t offset = i * FRAGMENT_SIZE;
+				const size_t size = std::min(FRAGMENT_SIZE, payload.size() - std::min(offset, payload.size()));
+				fragments.emplace_back(sizeof(header) + size);
+				memcpy(fragments.back().data(), &header, sizeof(header));
+				if (size > 0)
+				{
+					memcpy(fragments.back().data() + sizeof(header), payload.data() + offset, size);
+				}
+			}
+		}
+
+		last_sent_bytes = 0;
+		for (ClientState& client : clients)
+		{
+			const Snapshot* baseline = FindSnapshot(client.acked);
+			auto it = ranges.find(baseline == nullptr ? 0 : baseline->id);
+			if (it == ranges.end())
+				continue;
+			for (size_t i = 0; i < it->second.second; ++i)
+			{
+				const std::vector<uint8_t>& fragment = fragments[it->second.first + i];
+				wiNetwork::Message message;
+				message.connection = client.connection;
+				message.data = fragment.data();
+				message.dataSize = fragment.size();
+				messages.push_back(message);
+				last_sent_bytes += fragment.size();
+			}
+		}
+		wiNetwork::SendBatch(sock, messages.data(), (uint32_t)messages.size());
+	}
+
+	bool Server::ReceivePacket(const wiNetwork::Connection& sender, const void* data, size_t size)
+	{
+		PacketHeader header;
+		if (size < sizeof(header))
+			return false;
+		memcpy(&header, data, sizeof(header));
+		if (header.magic != PACKET_MAGIC || header.type != PACKET_ACK)
+			return false;
+
+		for (ClientState& client : clients)
+		{
+			if (client.connection == sender)
+			{
+				// Acknowledgements can arrive out of order, only the newest is a baseline:
+				if (header.snapshot > client.acked && header.snapshot < next_snapshot)
+				{
+					client.acked = header.snapshot;
+				}
+				break;
+			}
+		}
+		return true;
+	}
+
+
+	Entity Client::GetLocalEntity(Entity server_entity) const
+	{
+		auto it = entities.find(server_entity);
+		return it == entities.end() ? INVALID_ENTITY : it->second;
+	}
+	Entity Client::MapEntity(Entity server_entity)
+	{
+		auto it = entities.find(server_entity);
+		if (it != entities.end())
+		{
+			return it->second;
+		}
+		const Entity local_entity = CreateEntity();
+		entities[server_entity] = local_entity;
+		if (on_entity_created)
+		{
+			on_entity_created(local_entity);
+		}
+		return local_entity;
+	}
+
+	bool Client::ReceivePacket(const wiNetwork::Socket* sock, const wiNetwork::Connection& sender, const void* data, size_t size)
+	{
+		PacketHeader header;
+		if (size < sizeof(header))
+			return false;
+		memcpy(&header, data, sizeof(header));
+		if (header.magic != PACKET_MAGIC || header.type != PACKET_SNAPSHOT)
+			return false;
+		if (!(sender == server))
+			return true; // not from the server that is replicated
+		if (header.snapshot <= last_applied || header.fragment_count == 0 || header.fragment_count > MAX_FRAGMENTS || header.fragment_index >= header.fragment_count)
+			return true; // older than the state, or broken
+
+		// Find the reassembly of the snapshot, or replace the oldest one:
+		Assembly* assembly = nullptr;
+		for (Assembly& x : assemblies)
+		{
+			if (x.id == header.snapshot)
+			{
+				assembly = &x;
+				break;
+			}
+			if (assembly == nullptr || x.id < assembly->id)
+			{
+				assembly = &x;
+			}
+		}
+		if (assembly->id != header.snapshot)
+		{
+			assembly->id = header.snapshot;
+			assembly->fragment_count = header.fragment_count;
+			assembly->received_count = 0;
+			assembly->size = 0;
+			assembly->received.assign(header.fragment_count, false);
+			assembly->data.resize(size_t(header.fragment_count) * FRAGMENT_SIZE);
+		}
+		if (assembly->fragment_count != header.fragment_count || assembly->received[header.fragment_index])
+			return true;
+
+		const size_t fragment_size = std::min(FRAGMENT_SIZE, size - sizeof(header));
+		memcpy(assembly->data.data() + size_t(header.fragment_index) * FRAGMENT_SIZE, (const uint8_t*)data + sizeof(header), fragment_size);
+		assembly->received[header.fragment_index] = true;
+		assembly->received_count++;
+		if (header.fragment_index == header.fragment_count - 1)
+		{
+			assembly->size = size_t(header.fragment_index) * FRAGMENT_SIZE + fragment_size;
+		}
+		if (assembly->received_count < assembly->fragment_count)
+			return true;
+
+		const uint32_t snapshot_id = assembly->id;
+		const bool applied = Apply(assembly->data.data(), assembly->size);
+		assembly->id = 0;
+		if (!applied)
+			return true;
+		last_applied = snapshot_id;
+
+		PacketHeader ack;
+		ack.snapshot = snapshot_id;
+		ack.type = PACKET_ACK;
+		wiNetwork::Send(sock, &sender, &ack, sizeof(ack));
+		return true;
+	}
+
+	bool Client::Validate(const uint8_t* data, size_t size)
+	{
+		// Reads the whole payload without applying it, so that a broken snapshot doesn't leave the managers partially updated:
+		BitReader reader(data, size);
+		reader.Read(32); // baseline
+		for (size_t channel = 0; channel < channels.size() && reader.IsValid(); ++channel)
+		{
+			ClientChannel& target = *channels[channel];
+			if (reader.ReadBool())
+			{
+				const uint32_t count = reader.ReadVarint();
+				for (uint32_t i = 0; i < count && reader.IsValid(); ++i)
+				{
+					reader.ReadVarint();
+				}
+			}
+
+			const uint32_t count = reader.ReadVarint();
+			for (uint32_t i = 0; i < count && reader.IsValid(); ++i)
+			{
+				reader.Read(32); // server entity
+				target.Skip(reader);
+			}
+		}
+		return reader.IsValid();
+	}
+
+	bool Client::Apply(const uint8_t* data, size_t size)
+	{
+		BitReader reader(data, size);
+		const uint32_t baseline = reader.Read(32);
+		if (baseline != 0 && baseline > last_applied)
+		{
+			// The delta is to a baseline that this client doesn't have:
+			return false;
+		}
+		if (!Validate(data, size))
+		{
+			return false;
+		}
+
+		bool removed = false;
+		std::vector<Entity> list;
+		for (size_t channel = 0; channel < channels.size() && reader.IsValid(); ++channel)
+		{
+			ClientChannel& target = *channels[channel];
+			if (reader.ReadBool())
+			{
+				// The entity list is sent when components were added or removed, the components of the entities that are not in it are removed:
+				const uint32_t count = reader.ReadVarint();
+				list.clear();
+				Entity entity = 0;
+				for (uint32_t i = 0; i < count && reader.IsValid(); ++i)
+				{
+					entity += reader.ReadVarint();
+					list.push_back(entity); // sorted
+				}
+				for (auto& x : entities)
+				{
+					if (target.Contains(x.second) && !std::binary_search(list.begin(), list.end(), x.first))
+					{
+						target.Remove(x.second);
+						removed = true;
+					}
+				}
+			}
+
+			const uint32_t count = reader.ReadVarint();
+			for (uint32_t i = 0; i < count && reader.IsValid(); ++i)
+			{
+				const Entity server_entity = reader.Read(32);
+				target.Read(MapEntity(server_entity), reader);
+			}
+		}
+
+		if (removed)
+		{
+			// The entities that are not in any of the managers are forgotten:
+			for (auto it = entities.begin(); it != entities.end();)
+			{
+				bool contained = false;
+				for (auto& x : channels)
+				{
+					contained |= x->Contains(it->second);
+				}
+				if (contained)
+				{
+					++it;
+					continue;
+				}
+				if (on_entity_removed)
+				{
+					on_entity_removed(it->second);
+				}
+				it = entities.erase(it);
+			}
+		}
+		return reader.IsValid();
+	}
+}
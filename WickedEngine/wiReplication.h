@@ -0,0 +1,262 @@
+#pragma once
+#include "CommonInclude.h"
+#include "wiECS.h"
+#include "wiNetwork.h"
+
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <memory>
+
+namespace wiScene
+{
+	struct TransformComponent;
+}
+
+// ECS state replication over wiNetwork
+//	The server sends snapshots of the registered component managers to its clients. A snapshot only contains the components
+//	that changed (reported with ComponentManager::MarkChanged()) since the last snapshot that the client acknowledged,
+//	and the entity list of a manager only if components were added or removed since then
+//	Snapshots are fragmented into UDP packets, every client reassembles and applies them, then acknowledges them to the server
+namespace wiReplication
+{
+	// Packs values with an exact count of bits
+	class BitWriter
+	{
+	public:
+		void Write(uint32_t value, uint32_t bits);
+		inline void WriteBool(bool value) { Write(value ? 1 : 0, 1); }
+		// 7 bits at a time, small values take less space
+		void WriteVarint(uint32_t value);
+		// Signed varint, small negative values take less space too
+		inline void WriteSignedVarint(int32_t value) { WriteVarint(uint32_t((value << 1) ^ (value >> 31))); }
+		void WriteFloat(float value);
+		// Linear quantization of a value in the [min, max] range
+		void WriteQuantized(float value, float min, float max, uint32_t bits);
+		// Unit quaternion in 32 bits (the three smallest components with 10 bits each)
+		void WriteQuaternion(const XMFLOAT4& value);
+
+		// Pads the last byte, and returns the written bytes
+		const std::vector<uint8_t>& Finish();
+		void Clear();
+
+	private:
+		std::vector<uint8_t> data;
+		uint64_t scratch = 0;
+		uint32_t scratch_bits = 0;
+	};
+	// Reads the values that a BitWriter packed, reading past the end returns zeroes and makes the reader invalid
+	class BitReader
+	{
+	public:
+		BitReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+		uint32_t Read(uint32_t bits);
+		inline bool ReadBool() { return Read(1) != 0; }
+		uint32_t ReadVarint();
+		inline int32_t ReadSignedVarint() { const uint32_t value = ReadVarint(); return int32_t(value >> 1) ^ -int32_t(value & 1); }
+		float ReadFloat();
+		float ReadQuantized(float min, float max, uint32_t bits);
+		XMFLOAT4 ReadQuaternion();
+
+		inline bool IsValid() const { return valid; }
+
+	private:
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+		size_t position = 0; // in bits
+		bool valid = true;
+	};
+
+	// Serializers of the transform component: millimeter precision translation, 32 bit rotation, and the scale only if it's not 1
+	void SerializeTransform(const wiScene::TransformComponent& transform, BitWriter& writer);
+	void DeserializeTransform(wiScene::TransformComponent& transform, BitReader& reader); // the transform is made dirty
+
+	// Type erased access to the registered component managers
+	struct ServerChannel
+	{
+		virtual ~ServerChannel() = default;
+		virtual uint64_t AdvanceVersion() = 0;
+		virtual uint64_t GetStructureVersion() const = 0;
+		virtual void WriteEntities(BitWriter& writer) const = 0;
+		virtual void WriteChanged(uint64_t since, BitWriter& writer) const = 0;
+	};
+	struct ClientChannel
+	{
+		virtual ~ClientChannel() = default;
+		virtual bool Contains(wiECS::Entity entity) const = 0;
+		virtual void Remove(wiECS::Entity entity) = 0;
+		virtual void Read(wiECS::Entity entity, BitReader& reader) = 0;
+		// Reads a component into scratch memory, to validate a snapshot before it is applied
+		virtual void Skip(BitReader& reader) = 0;
+	};
+
+	class Server
+	{
+	public:
+		// Replicate a component manager. The managers must be registered in the same order on the server and on the clients
+		//	serialize	:	writes a component, the client reads it with the matching deserialize function
+		template<typename T>
+		void Register(wiECS::ComponentManager<T>& manager, std::function<void(const T&, BitWriter&)> serialize);
+
+		// The clients are identified by their connection. Returns the client index
+		uint32_t AddClient(const wiNetwork::Connection& connection);
+		void RemoveClient(const wiNetwork::Connection& connection);
+		inline size_t GetClientCount() const { return clients.size(); }
+
+		// Takes a snapshot and sends it to every client, as a delta to the last snapshot that the client acknowledged
+		//	It must not be called while the component managers are updated (for example, call it after the scene update)
+		void Update(const wiNetwork::Socket* sock);
+
+		// Handles a packet that the server socket received. Returns false if it is not a replication packet
+		bool ReceivePacket(const wiNetwork::Connection& sender, const void* data, size_t size);
+
+		// Count of bytes sent by the last Update()
+		inline size_t GetLastSentBytes() const { return last_sent_bytes; }
+
+	private:
+		static constexpr uint32_t HISTORY = 64; // the snapshots that can be baselines for the deltas
+		struct Snapshot
+		{
+			uint32_t id = 0;
+			std::vector<uint64_t> versions;
+			std::vector<uint64_t> structure_versions;
+		};
+		struct ClientState
+		{
+			wiNetwork::Connection connection;
+			uint32_t acked = 0; // 0: nothing acknowledged, the client gets full snapshots
+		};
+		std::vector<std::unique_ptr<ServerChannel>> channels;
+		std::vector<ClientState> clients;
+		Snapshot history[HISTORY];
+		uint32_t next_snapshot = 1;
+		size_t last_sent_bytes = 0;
+
+		// scratch memory:
+		BitWriter writer;
+		std::unordered_map<uint32_t, std::vector<uint8_t>> payloads;
+		std::vector<std::vector<uint8_t>> fragments;
+		std::vector<wiNetwork::Message> messages;
+
+		const Snapshot* FindSnapshot(uint32_t id) const;
+	};
+
+	class Client
+	{
+	public:
+		// Receive the components of a manager that the server replicates. The managers must be registered in the same order on the server and on the clients
+		//	deserialize	:	reads a component that the server wrote with the matching serialize function
+		template<typename T>
+		void Register(wiECS::ComponentManager<T>& manager, std::function<void(T&, BitReader&)> deserialize);
+
+		// The connection of the server that is replicated, the packets of other senders are dropped
+		inline void SetServer(const wiNetwork::Connection& connection) { server = connection; }
+
+		// Handles a packet that the client socket received from the server. Complete snapshots are applied and acknowledged with the socket
+		//	Returns false if it is not a replication packet
+		bool ReceivePacket(const wiNetwork::Socket* sock, const wiNetwork::Connection& sender, const void* data, size_t size);
+
+		// The server entities are replicated as local entities, these are called when a local entity is created, and when it is no longer in any of the managers
+		std::function<void(wiECS::Entity local_entity)> on_entity_created;
+		std::function<void(wiECS::Entity local_entity)> on_entity_removed;
+
+		wiECS::Entity GetLocalEntity(wiECS::Entity server_entity) const;
+		inline uint32_t GetLastSnapshot() const { return last_applied; }
+
+	private:
+		struct Assembly
+		{
+			uint32_t id = 0;
+			uint32_t fragment_count = 0;
+			uint32_t received_count = 0;
+			size_t size = 0;
+			std::vector<bool> received;
+			std::vector<uint8_t> data;
+		};
+		static constexpr uint32_t ASSEMBLIES = 4; // snapshots that can be reassembled at the same time
+		std::vector<std::unique_ptr<ClientChannel>> channels;
+		std::unordered_map<wiECS::Entity, wiECS::Entity> entities; // server entity -> local entity
+		Assembly assemblies[ASSEMBLIES];
+		uint32_t last_applied = 0;
+		wiNetwork::Connection server;
+
+		wiECS::Entity MapEntity(wiECS::Entity server_entity);
+		bool Validate(const uint8_t* data, size_t size);
+		bool Apply(const uint8_t* data, size_t size);
+	};
+
+
+
+	template<typename T>
+	void Server::Register(wiECS::ComponentManager<T>& manager, std::function<void(const T&, BitWriter&)> serialize)
+	{
+		struct Channel : public ServerChannel
+		{
+			wiECS::ComponentManager<T>& manager;
+			std::function<void(const T&, BitWriter&)> serialize;
+			Channel(wiECS::ComponentManager<T>& manager, std::function<void(const T&, BitWriter&)> serialize) : manager(manager), serialize(std::move(serialize)) {}
+
+			uint64_t AdvanceVersion() override { return manager.AdvanceVersion(); }
+			uint64_t GetStructureVersion() const override { return manager.GetStructureVersion(); }
+			void WriteEntities(BitWriter& writer) const override
+			{
+				// Sorted, so that only the differences are written:
+				std::vector<wiECS::Entity> sorted(manager.GetCount());
+				for (size_t i = 0; i < sorted.size(); ++i)
+				{
+					sorted[i] = manager.GetEntity(i);
+				}
+				std::sort(sorted.begin(), sorted.end());
+				writer.WriteVarint((uint32_t)sorted.size());
+				wiECS::Entity prev = 0;
+				for (wiECS::Entity entity : sorted)
+				{
+					writer.WriteVarint(entity - prev);
+					prev = entity;
+				}
+			}
+			void WriteChanged(uint64_t since, BitWriter& writer) const override
+			{
+				uint32_t count = 0;
+				manager.ForEachChanged(since, [&](size_t index) { count++; });
+				writer.WriteVarint(count);
+				manager.ForEachChanged(since, [&](size_t index) {
+					writer.Write(manager.GetEntity(index), 32);
+					serialize(manager[index], writer);
+				});
+			}
+		};
+		channels.push_back(std::make_unique<Channel>(manager, std::move(serialize)));
+	}
+
+	template<typename T>
+	void Client::Register(wiECS::ComponentManager<T>& manager, std::function<void(T&, BitReader&)> deserialize)
+	{
+		struct Channel : public ClientChannel
+		{
+			wiECS::ComponentManager<T>& manager;
+			std::function<void(T&, BitReader&)> deserialize;
+			Channel(wiECS::ComponentManager<T>& manager, std::function<void(T&, BitReader&)> deserialize) : manager(manager), deserialize(std::move(deserialize)) {}
+
+			bool Contains(wiECS::Entity entity) const override { return manager.Contains(entity); }
+			void Remove(wiECS::Entity entity) override { manager.Remove(entity); }
+			void Read(wiECS::Entity entity, BitReader& reader) override
+			{
+				T* component = manager.GetComponent(entity);
+				if (component == nullptr)
+				{
+					component = &manager.Create(entity);
+				}
+				deserialize(*component, reader);
+				manager.MarkChanged(entity);
+			}
+			void Skip(BitReader& reader) override
+			{
+				deserialize(scratch, reader);
+			}
+			T scratch;
+		};
+		channels.push_back(std::make_unique<Channel>(manager, std::move(deserialize)));
+	}
+}
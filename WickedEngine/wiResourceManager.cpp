@@ -2,11 +2,15 @@
 #include "wiRenderer.h"
 #include "wiHelper.h"
 #include "wiTextureHelper.h"
+#include "wiTextureCompressor.h"
+#include "wiProfiler.h"
 
 #include "Utility/stb_image.h"
 #include "Utility/tinyddsloader.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstdio>
 
 using namespace wiGraphics;
 
@@ -16,6 +20,40 @@ namespace wiResourceManager
 	std::unordered_map<std::string, std::weak_ptr<wiResource>> resources;
 	MODE mode = MODE_DISCARD_FILEDATA_AFTER_LOAD;
 
+	// Resource contents that are replaced by ApplyPendingChanges(), because rendering might be using the resources while they are prepared:
+	struct PendingChange
+	{
+		std::shared_ptr<wiResource> resource;
+		std::shared_ptr<wiResource> loaded; // the result of an asynchronous load, nullptr if the load failed or this is a residency change
+		Texture texture; // the texture without its top mip, if this is a residency change, or the texture with the streamed mips
+		bool residency = false;
+		bool streaming = false; // the texture is invalid if streaming failed
+		uint32_t streaming_mip_offset = 0;
+	};
+	std::mutex pending_locker;
+	std::vector<PendingChange> pending_changes;
+	wiJobSystem::context async_ctx;
+
+	bool streaming_enabled = true;
+	uint32_t streaming_initial_resolution = 256;
+
+	// Resources by the hash of their file contents and import flags, if content deduplication is enabled:
+	bool content_deduplication_enabled = false;
+	std::unordered_map<uint64_t, std::weak_ptr<wiResource>> content_resources;
+
+	// Every resource that was created while the retain policy was enabled is referenced here, and freed when it was released for long enough:
+	struct RetainedResource
+	{
+		std::shared_ptr<wiResource> resource;
+		uint64_t released_frame = 0; // frame + 1 when it was found unreferenced outside of the manager, 0 while it is used
+	};
+	std::vector<RetainedResource> retained_resources;
+	uint32_t retain_frames = 0;
+	uint64_t retain_bytes = 0;
+
+	bool block_compression_enabled = true;
+	std::string texture_cache_directory;
+
 	void SetMode(MODE param)
 	{
 		mode = param;
@@ -43,35 +81,132 @@ namespace wiResourceManager
 	int GetErrorCode(void) { return g_iErrorCode; }
 #endif
 
-	std::shared_ptr<wiResource> Load(const std::string& name, uint32_t flags, const uint8_t* filedata, size_t filesize)
+	void SetContentDeduplicationEnabled(bool value)
 	{
-		if (mode == MODE_DISCARD_FILEDATA_AFTER_LOAD)
+		content_deduplication_enabled = value;
+	}
+	bool IsContentDeduplicationEnabled()
+	{
+		return content_deduplication_enabled;
+	}
+	void SetRetainPolicy(uint32_t frames, uint64_t bytes)
+	{
+		locker.lock();
+		retain_frames = frames;
+		retain_bytes = bytes;
+		if (retain_frames == 0)
 		{
-			flags &= ~IMPORT_RETAIN_FILEDATA;
+			retained_resources.clear();
 		}
+		locker.unlock();
+	}
+	uint32_t GetRetainFrames()
+	{
+		return retain_frames;
+	}
+	uint64_t GetRetainBytes()
+	{
+		return retain_bytes;
+	}
 
-		locker.lock();
-		std::weak_ptr<wiResource>& weak_resource = resources[name];
-		std::shared_ptr<wiResource> resource = weak_resource.lock();
+	void SetBlockCompressionEnabled(bool value)
+	{
+		block_compression_enabled = value;
+	}
+	bool IsBlockCompressionEnabled()
+	{
+		return block_compression_enabled;
+	}
+	void SetTextureCacheDirectory(const std::string& directory)
+	{
+		texture_cache_directory = directory;
+		if (!texture_cache_directory.empty() && texture_cache_directory.back() != '/' && texture_cache_directory.back() != '\\')
+		{
+			texture_cache_directory += "/";
+		}
+	}
+	const std::string& GetTextureCacheDirectory()
+	{
+		return texture_cache_directory;
+	}
+
+	// Converts the image file data to block compressed DDS file data if it was requested with IMPORT_BLOCK_COMPRESS
+	//	The result is read from the texture cache if it was converted before
+	static bool ConvertToDDS(const uint8_t* filedata, size_t filesize, uint32_t flags, std::vector<uint8_t>& converted)
+	{
+		if (!block_compression_enabled || (flags & IMPORT_BLOCK_COMPRESS) == 0 || (flags & IMPORT_COLORGRADINGLUT))
+		{
+			return false;
+		}
 
-		if (resource == nullptr)
+		std::string cachefile;
+		if (!texture_cache_directory.empty())
 		{
-			resource = std::make_shared<wiResource>();
-			resources[name] = resource;
-			locker.unlock();
+			// The cache is keyed by the hash of the file contents and the flags that change the conversion:
+			const uint64_t hash = wiHelper::HashData(filedata, filesize, flags & IMPORT_NORMALMAP);
+
+			char filename[32];
+			snprintf(filename, arraysize(filename), "%016llx.dds", (unsigned long long)hash);
+			cachefile = texture_cache_directory + filename;
+			if (wiHelper::FileExists(cachefile) && wiHelper::FileRead(cachefile, converted))
+			{
+				return true;
+			}
+		}
+
+		int width, height, bpp;
+		unsigned char* rgba = stbi_load_from_memory(filedata, (int)filesize, &width, &height, &bpp, 4);
+		if (rgba == nullptr)
+		{
+			return false;
+		}
+
+		FORMAT format = FORMAT_BC1_UNORM;
+		if (flags & IMPORT_NORMALMAP)
+		{
+			format = FORMAT_BC5_UNORM;
 		}
 		else
 		{
-			locker.unlock();
-			return resource;
+			for (int i = 0; i < width * height; ++i)
+			{
+				if (rgba[i * 4 + 3] < 255)
+				{
+					format = FORMAT_BC3_UNORM;
+					break;
+				}
+			}
+		}
+
+		// Block compressed textures must be made of whole blocks, other images stay uncompressed:
+		const bool success = wiTextureCompressor::CreateDDS((const uint32_t*)rgba, (uint32_t)width, (uint32_t)height, format, (flags & IMPORT_NORMALMAP) != 0, converted);
+		stbi_image_free(rgba);
+		if (!success)
+		{
+			converted.clear();
+			return false;
+		}
+
+		if (!cachefile.empty())
+		{
+			wiHelper::FileWriteAtomic(cachefile, converted.data(), converted.size());
 		}
+		return true;
+	}
+
+	// Loads the file data into the resource, without registering it
+	//	If the file data is not given, it is read from the file, unless the resource already holds it
+	//	mip_offset : count of top mips that are left out of streamed DDS textures, ~0u selects the mips up to the initial streaming resolution
+	static bool LoadResource(wiResource* resource, const std::string& name, uint32_t flags, const uint8_t* filedata, size_t filesize, uint32_t mip_offset = ~0u)
+	{
+		// Streamed mips are loaded again later, so the file data must be available from the file or the retained file data:
+		const bool streamable = (flags & IMPORT_STREAMING) && streaming_enabled && (filedata == nullptr || filesize == 0 || (flags & IMPORT_RETAIN_FILEDATA));
 
 		if (filedata == nullptr || filesize == 0)
 		{
-			if (!wiHelper::FileRead(name, resource->filedata))
+			if (resource->filedata.empty() && !wiHelper::FileRead(name, resource->filedata))
 			{
-				resource.reset();
-				return nullptr;
+				return false;
 			}
 			filedata = resource->filedata.data();
 			filesize = resource->filedata.size();
@@ -89,7 +224,7 @@ namespace wiResourceManager
 			}
 			else
 			{
-				return nullptr;
+				return false;
 			}
 		}
 
@@ -100,12 +235,15 @@ namespace wiResourceManager
 		case wiResource::IMAGE:
 		{
 			GraphicsDevice* device = wiRenderer::GetDevice();
-			if (!ext.compare(std::string("DDS")))
+
+			// Other image formats are loaded like DDS files when they were converted to block compression:
+			std::vector<uint8_t> converted;
+			if (!ext.compare(std::string("DDS")) || ConvertToDDS(filedata, filesize, flags, converted))
 			{
 				// Load dds
 
 				tinyddsloader::DDSFile dds;
-				auto result = dds.Load(filedata, filesize);
+				auto result = converted.empty() ? dds.Load(filedata, filesize) : dds.Load(std::move(converted));
 
 				if (result == tinyddsloader::Result::Success)
 				{
@@ -139,7 +277,7 @@ namespace wiResourceManager
 					if (ddsFormat == tinyddsloader::DDSFile::DXGIFormat::Unknown)
 					{
 						// should replace tinyDDS with DirectXTex loadder from old graphics engine!
-						return nullptr;
+						return false;
 					}
 #endif
 
@@ -213,8 +351,7 @@ namespace wiResourceManager
 					case tinyddsloader::DDSFile::DXGIFormat::R8G8B8_UNorm:
 						// DDS format is an old one, and not supported by tinyDDS!
 						g_iErrorCode = 1;
-						resource.reset();
-						return nullptr;
+						return false;
 						break;
 #endif
 
@@ -223,20 +360,6 @@ namespace wiResourceManager
 						break;
 					}
 
-					std::vector<SubresourceData> InitData;
-					for (uint32_t arrayIndex = 0; arrayIndex < desc.ArraySize; ++arrayIndex)
-					{
-						for (uint32_t mip = 0; mip < desc.MipLevels; ++mip)
-						{
-							auto imageData = dds.GetImageData(mip, arrayIndex);
-							SubresourceData subresourceData;
-							subresourceData.pSysMem = imageData->m_mem;
-							subresourceData.SysMemPitch = imageData->m_memPitch;
-							subresourceData.SysMemSlicePitch = imageData->m_memSlicePitch;
-							InitData.push_back(subresourceData);
-						}
-					}
-
 					auto dim = dds.GetTextureDimension();
 					switch (dim)
 					{
@@ -260,6 +383,51 @@ namespace wiResourceManager
 						break;
 					}
 
+					// Streamed textures leave out their top mips:
+					const bool streaming = streamable && desc.type == TextureDesc::TEXTURE_2D && desc.ArraySize == 1 && desc.MipLevels > 1 && (desc.MiscFlags & RESOURCE_MISC_TEXTURECUBE) == 0;
+					const bool initial = mip_offset == ~0u;
+					if (streaming)
+					{
+						if (initial)
+						{
+							mip_offset = 0;
+							while (mip_offset + 1 < desc.MipLevels && std::max(desc.Width, desc.Height) >> mip_offset > streaming_initial_resolution)
+							{
+								mip_offset++;
+							}
+						}
+						mip_offset = std::min(mip_offset, desc.MipLevels - 1);
+						if (device->IsFormatBlockCompressed(desc.Format))
+						{
+							// The top mip of block compressed textures must be made of whole blocks:
+							while (mip_offset > 0 && ((desc.Width >> mip_offset) % 4 != 0 || (desc.Height >> mip_offset) % 4 != 0))
+							{
+								mip_offset--;
+							}
+						}
+						desc.Width = std::max(1u, desc.Width >> mip_offset);
+						desc.Height = std::max(1u, desc.Height >> mip_offset);
+						desc.MipLevels -= mip_offset;
+					}
+					else
+					{
+						mip_offset = 0;
+					}
+
+					std::vector<SubresourceData> InitData;
+					for (uint32_t arrayIndex = 0; arrayIndex < desc.ArraySize; ++arrayIndex)
+					{
+						for (uint32_t mip = 0; mip < desc.MipLevels; ++mip)
+						{
+							auto imageData = dds.GetImageData(mip + mip_offset, arrayIndex);
+							SubresourceData subresourceData;
+							subresourceData.pSysMem = imageData->m_mem;
+							subresourceData.SysMemPitch = imageData->m_memPitch;
+							subresourceData.SysMemSlicePitch = imageData->m_memSlicePitch;
+							InitData.push_back(subresourceData);
+						}
+					}
+
 					if (device->IsFormatBlockCompressed(desc.Format))
 					{
 						desc.Width = std::max(4u, desc.Width);
@@ -268,6 +436,16 @@ namespace wiResourceManager
 
 					success = device->CreateTexture(&desc, InitData.data(), &resource->texture);
 					device->SetName(&resource->texture, name.c_str());
+
+					if (success && streaming)
+					{
+						resource->streaming_name = name;
+						resource->streaming_mip_offset = mip_offset;
+						if (initial)
+						{
+							resource->streaming_mip_offset_max = mip_offset;
+						}
+					}
 				}
 				else
 				{
@@ -395,15 +573,330 @@ namespace wiResourceManager
 				resource->filedata.shrink_to_fit();
 			}
 
-			if (type == wiResource::IMAGE && resource->texture.desc.MipLevels > 1 && resource->texture.desc.BindFlags & BIND_UNORDERED_ACCESS)
+			return true;
+		}
+
+		return false;
+	}
+
+	// Generates the mips of textures that don't have them in the file data
+	static void RequestMIPGen(const std::shared_ptr<wiResource>& resource)
+	{
+		if (resource->type == wiResource::IMAGE && resource->texture.desc.MipLevels > 1 && resource->texture.desc.BindFlags & BIND_UNORDERED_ACCESS)
+		{
+			wiRenderer::AddDeferredMIPGen(resource, true);
+		}
+	}
+
+	// Key of the content deduplication, 0 if there is no file data
+	static uint64_t ComputeContentHash(const uint8_t* filedata, size_t filesize, uint32_t flags)
+	{
+		if (filedata == nullptr || filesize == 0)
+		{
+			return 0;
+		}
+		const uint64_t hash = wiHelper::HashData(filedata, filesize, flags);
+		return hash == 0 ? 1 : hash;
+	}
+
+	// Registers the new resource by name and content hash (if not 0)
+	//	Returns the resource that is already registered with the same name or content instead, or nullptr if the new one was registered
+	static std::shared_ptr<wiResource> Register(const std::string& name, uint64_t content_hash, const std::shared_ptr<wiResource>& resource)
+	{
+		locker.lock();
+		std::weak_ptr<wiResource>& weak_resource = resources[name];
+		std::shared_ptr<wiResource> existing = weak_resource.lock();
+		if (existing == nullptr && content_hash != 0)
+		{
+			auto it = content_resources.find(content_hash);
+			if (it != content_resources.end())
 			{
-				wiRenderer::AddDeferredMIPGen(resource, true);
+				existing = it->second.lock();
 			}
+		}
+		if (existing != nullptr)
+		{
+			weak_resource = existing;
+			locker.unlock();
+			return existing;
+		}
 
+		weak_resource = resource;
+		if (content_hash != 0)
+		{
+			content_resources[content_hash] = resource;
+		}
+		if (retain_frames > 0)
+		{
+			RetainedResource retained;
+			retained.resource = resource;
+			retained_resources.push_back(retained);
+		}
+		locker.unlock();
+		return nullptr;
+	}
+
+	std::shared_ptr<wiResource> Load(const std::string& name, uint32_t flags, const uint8_t* filedata, size_t filesize)
+	{
+		if (mode == MODE_DISCARD_FILEDATA_AFTER_LOAD)
+		{
+			flags &= ~IMPORT_RETAIN_FILEDATA;
+		}
+
+		locker.lock();
+		std::shared_ptr<wiResource> resource = resources[name].lock();
+		locker.unlock();
+		if (resource != nullptr)
+		{
 			return resource;
 		}
 
-		return nullptr;
+		resource = std::make_shared<wiResource>();
+		uint64_t content_hash = 0;
+		if (content_deduplication_enabled)
+		{
+			// The file is read before registering, so that its contents can be looked up:
+			const uint8_t* data = filedata;
+			size_t size = filesize;
+			if ((data == nullptr || size == 0) && wiHelper::FileRead(name, resource->filedata))
+			{
+				data = resource->filedata.data();
+				size = resource->filedata.size();
+			}
+			content_hash = ComputeContentHash(data, size, flags);
+		}
+
+		std::shared_ptr<wiResource> existing = Register(name, content_hash, resource);
+		if (existing != nullptr)
+		{
+			return existing;
+		}
+
+		wiProfiler::MarkEvent("Resource Load");
+		if (!LoadResource(resource.get(), name, flags, filedata, filesize))
+		{
+			return nullptr;
+		}
+		RequestMIPGen(resource);
+		return resource;
+	}
+
+	LoadHandle LoadAsync(const std::string& name, uint32_t flags, const uint8_t* filedata, size_t filesize, const Texture* placeholder)
+	{
+		if (mode == MODE_DISCARD_FILEDATA_AFTER_LOAD)
+		{
+			flags &= ~IMPORT_RETAIN_FILEDATA;
+		}
+
+		LoadHandle handle;
+
+		locker.lock();
+		handle.resource = resources[name].lock();
+		locker.unlock();
+
+		bool created = false;
+		if (handle.resource == nullptr)
+		{
+			auto resource = std::make_shared<wiResource>();
+			// The file is read by the job, so the contents can only be looked up when they are given:
+			const uint64_t content_hash = content_deduplication_enabled ? ComputeContentHash(filedata, filesize, flags) : 0;
+			std::shared_ptr<wiResource> existing = Register(name, content_hash, resource);
+			created = existing == nullptr;
+			handle.resource = created ? resource : existing;
+		}
+		if (!created)
+		{
+			std::promise<bool> promise;
+			promise.set_value(true);
+			handle.future = promise.get_future().share();
+			return handle;
+		}
+
+		if (placeholder != nullptr)
+		{
+			handle.resource->texture = *placeholder;
+		}
+
+		// The decoding works on a separate resource, the registered one is only changed in ApplyPendingChanges():
+		auto loaded = std::make_shared<wiResource>();
+		if (filedata != nullptr && filesize > 0)
+		{
+			loaded->filedata.resize(filesize);
+			std::memcpy(loaded->filedata.data(), filedata, filesize);
+		}
+
+		auto promise = std::make_shared<std::promise<bool>>();
+		handle.future = promise->get_future().share();
+
+		std::shared_ptr<wiResource> resource = handle.resource;
+		async_ctx.priority = wiJobSystem::Priority::Background;
+		async_ctx.name = "wiResourceManager::LoadAsync";
+		wiJobSystem::Execute(async_ctx, [resource, loaded, promise, name, flags](wiJobArgs args) {
+			const bool success = LoadResource(loaded.get(), name, flags, nullptr, 0);
+
+			PendingChange change;
+			change.resource = resource;
+			if (success)
+			{
+				change.loaded = loaded;
+			}
+			pending_locker.lock();
+			pending_changes.push_back(change);
+			pending_locker.unlock();
+
+			promise->set_value(success);
+		});
+
+		return handle;
+	}
+
+	void WaitAsyncLoads()
+	{
+		wiJobSystem::Wait(async_ctx);
+	}
+
+	// Approximate memory size of the resource
+	static uint64_t ComputeResourceSize(const wiResource& resource)
+	{
+		uint64_t size = resource.filedata.size();
+		if (resource.texture.IsValid())
+		{
+			GraphicsDevice* device = wiRenderer::GetDevice();
+			const TextureDesc& desc = resource.texture.GetDesc();
+			uint64_t texels = uint64_t(desc.Width) * uint64_t(desc.Height) * uint64_t(desc.Depth) * uint64_t(desc.ArraySize);
+			if (device->IsFormatBlockCompressed(desc.Format))
+			{
+				texels /= 16;
+			}
+			const uint64_t top = texels * device->GetFormatStride(desc.Format);
+			size += desc.MipLevels > 1 ? top * 4 / 3 : top; // the mip chain adds about a third
+		}
+		return size;
+	}
+
+	// Frees the retained resources that are not referenced outside of the manager for longer than the retain policy allows
+	static void UpdateRetainedResources()
+	{
+		const uint64_t frame = wiRenderer::GetDevice()->GetFrameCount() + 1;
+		bool freed = false;
+		locker.lock();
+		std::vector<RetainedResource*> released;
+		uint64_t released_size = 0;
+		for (auto& retained : retained_resources)
+		{
+			if (retained.resource.use_count() > 1)
+			{
+				retained.released_frame = 0;
+				continue;
+			}
+			if (retained.released_frame == 0)
+			{
+				retained.released_frame = frame;
+			}
+			if (frame - retained.released_frame >= retain_frames)
+			{
+				retained.resource.reset();
+				freed = true;
+			}
+			else
+			{
+				released.push_back(&retained);
+				released_size += ComputeResourceSize(*retained.resource);
+			}
+		}
+		if (retain_bytes > 0 && released_size > retain_bytes)
+		{
+			// Over the memory limit, the earliest released are freed first:
+			std::sort(released.begin(), released.end(), [](const RetainedResource* a, const RetainedResource* b) {
+				return a->released_frame < b->released_frame;
+			});
+			for (RetainedResource* retained : released)
+			{
+				if (released_size <= retain_bytes)
+				{
+					break;
+				}
+				released_size -= std::min(released_size, ComputeResourceSize(*retained->resource));
+				retained->resource.reset();
+				freed = true;
+			}
+		}
+		if (freed)
+		{
+			retained_resources.erase(std::remove_if(retained_resources.begin(), retained_resources.end(), [](const RetainedResource& retained) {
+				return retained.resource == nullptr;
+			}), retained_resources.end());
+			for (auto it = content_resources.begin(); it != content_resources.end();)
+			{
+				it = it->second.expired() ? content_resources.erase(it) : std::next(it);
+			}
+		}
+		locker.unlock();
+	}
+
+	bool ApplyPendingChanges()
+	{
+		if (!retained_resources.empty())
+		{
+			UpdateRetainedResources();
+		}
+
+		std::vector<PendingChange> changes;
+		pending_locker.lock();
+		changes.swap(pending_changes);
+		pending_locker.unlock();
+
+		bool textures_changed = false;
+		for (auto& change : changes)
+		{
+			wiResource& resource = *change.resource;
+			if (change.residency)
+			{
+				// The old texture is destroyed by the device when the GPU is finished with it:
+				resource.texture = change.texture;
+				textures_changed = true;
+			}
+			else if (change.streaming)
+			{
+				resource.streaming_busy = false;
+				if (change.texture.IsValid())
+				{
+					resource.texture = change.texture;
+					resource.streaming_mip_offset = change.streaming_mip_offset;
+					if (resource.residency_low)
+					{
+						wiRenderer::GetDevice()->SetResidencyPriority(&resource.texture, GraphicsDevice::RESIDENCY_PRIORITY_LOW);
+					}
+					textures_changed = true;
+				}
+				else
+				{
+					// The mips can't be loaded again, the texture stays as it is:
+					resource.streaming_name.clear();
+				}
+			}
+			else if (change.loaded != nullptr)
+			{
+				wiResource& loaded = *change.loaded;
+				resource.texture = loaded.texture;
+				resource.sound = loaded.sound;
+				resource.type = loaded.type;
+				resource.flags = loaded.flags;
+				resource.filedata = std::move(loaded.filedata);
+				resource.streaming_name = loaded.streaming_name;
+				resource.streaming_mip_offset = loaded.streaming_mip_offset;
+				resource.streaming_mip_offset_max = loaded.streaming_mip_offset_max;
+				RequestMIPGen(change.resource);
+				textures_changed = textures_changed || resource.type == wiResource::IMAGE;
+			}
+			else if (resource.type == wiResource::EMPTY && resource.texture.IsValid())
+			{
+				// Failed asynchronous load, the placeholder is removed:
+				resource.texture = {};
+				textures_changed = true;
+			}
+		}
+		return textures_changed;
 	}
 
 #ifdef GGREDUCED
@@ -414,8 +907,14 @@ namespace wiResourceManager
 		locker.lock();
 		std::weak_ptr<wiResource>& weak_resource = resources[name];
 		std::shared_ptr<wiResource> resource = weak_resource.lock();
-		locker.unlock();
 		resources.erase(name);
+		if (resource != nullptr)
+		{
+			retained_resources.erase(std::remove_if(retained_resources.begin(), retained_resources.end(), [&](const RetainedResource& retained) {
+				return retained.resource == resource;
+			}), retained_resources.end());
+		}
+		locker.unlock();
 		resource.reset();
 	}
 	
@@ -460,11 +959,28 @@ namespace wiResourceManager
 		locker.unlock();
 		return result;
 	}
+	size_t GetRetainedFileDataSize()
+	{
+		size_t size = 0;
+		locker.lock();
+		for (auto& x : resources)
+		{
+			auto resource = x.second.lock();
+			if (resource != nullptr)
+			{
+				size += resource->filedata.capacity();
+			}
+		}
+		locker.unlock();
+		return size;
+	}
 
 	void Clear()
 	{
 		locker.lock();
 		resources.clear();
+		content_resources.clear();
+		retained_resources.clear();
 		locker.unlock();
 	}
 
@@ -476,11 +992,13 @@ namespace wiResourceManager
 			size_t serializable_count = 0;
 			archive >> serializable_count;
 
+			// The file data is used from the archive memory without copying, which stays valid until the loading jobs are finished:
 			struct TempResource
 			{
 				std::string name;
 				uint32_t flags = 0;
-				std::vector<uint8_t> filedata;
+				const uint8_t* filedata = nullptr;
+				size_t filesize = 0;
 			};
 			std::vector<TempResource> temp_resources;
 			temp_resources.resize(serializable_count);
@@ -493,14 +1011,15 @@ namespace wiResourceManager
 
 				archive >> resource.name;
 				archive >> resource.flags;
-				archive >> resource.filedata;
+				archive >> resource.filesize; // same layout as a serialized std::vector<uint8_t>
+				resource.filedata = archive.ReadData(resource.filesize);
 
 				resource.name = archive.GetSourceDirectory() + resource.name;
 
 				// "Loading" the resource can happen asynchronously to serialization of file data, to improve performance
 				wiJobSystem::Execute(ctx, [i, &temp_resources, &seri_locker, &seri](wiJobArgs args) {
 					auto& tmp_resource = temp_resources[i];
-					auto res = Load(tmp_resource.name, tmp_resource.flags, tmp_resource.filedata.data(), tmp_resource.filedata.size());
+					auto res = Load(tmp_resource.name, tmp_resource.flags, tmp_resource.filedata, tmp_resource.filesize);
 					seri_locker.lock();
 					seri.resources.push_back(res);
 					seri_locker.unlock();
@@ -553,4 +1072,344 @@ namespace wiResourceManager
 	}
 	}
 
+
+	bool residency_enabled = true;
+	uint64_t residency_budget = 0;
+	uint64_t residency_frame = 0;
+	ResidencyStatistics residency_statistics;
+	static constexpr uint64_t RESIDENCY_UNUSED_FRAMES = 300; // textures that weren't used for this many frames get low residency priority
+	static constexpr uint32_t RESIDENCY_MIN_RESOLUTION = 256; // mips are not dropped below this resolution
+	static constexpr uint32_t RESIDENCY_EVICTIONS_PER_FRAME = 8; // textures that can lose a mip in one frame, each of them is recreated
+	static constexpr uint32_t STREAMING_JOBS_PER_FRAME = 4; // textures that can start streaming in one frame
+	static constexpr float STREAMING_BUDGET_MARGIN = 0.9f; // mips are only streamed in below this portion of the budget, so they are not streamed out right away
+
+	void SetResidencyEnabled(bool value)
+	{
+		residency_enabled = value;
+	}
+	bool IsResidencyEnabled()
+	{
+		return residency_enabled;
+	}
+	void SetResidencyBudget(uint64_t bytes)
+	{
+		residency_budget = bytes;
+	}
+	uint64_t GetResidencyBudget()
+	{
+		return residency_budget;
+	}
+	void TouchResource(wiResource& resource, float resolution)
+	{
+		const uint64_t frame = wiRenderer::GetDevice()->GetFrameCount() + 1;
+		if (resource.last_used_frame != frame)
+		{
+			resource.streaming_request = 0;
+		}
+		resource.last_used_frame = frame;
+		resource.streaming_request = std::max(resource.streaming_request, resolution);
+	}
+
+	void SetStreamingEnabled(bool value)
+	{
+		streaming_enabled = value;
+	}
+	bool IsStreamingEnabled()
+	{
+		return streaming_enabled;
+	}
+	void SetStreamingInitialResolution(uint32_t value)
+	{
+		streaming_initial_resolution = std::max(1u, value);
+	}
+	uint32_t GetStreamingInitialResolution()
+	{
+		return streaming_initial_resolution;
+	}
+
+	// Approximate size of the top mip:
+	static uint64_t ComputeTopMipSize(const TextureDesc& desc)
+	{
+		GraphicsDevice* device = wiRenderer::GetDevice();
+		const uint64_t stride = device->GetFormatStride(desc.Format);
+		if (device->IsFormatBlockCompressed(desc.Format))
+		{
+			return uint64_t((desc.Width + 3) / 4) * uint64_t((desc.Height + 3) / 4) * stride;
+		}
+		return uint64_t(desc.Width) * uint64_t(desc.Height) * stride;
+	}
+
+	// Creates a texture with the same contents without the top mip, which replaces the resource texture in ApplyPendingChanges()
+	//	Returns the approximate freed size or 0 if it can't be done
+	static uint64_t DropTopMip(const std::shared_ptr<wiResource>& resource_ptr, CommandList cmd)
+	{
+#ifdef GGREDUCED
+		GraphicsDevice* device = wiRenderer::GetDevice();
+		const wiResource& resource = *resource_ptr;
+		const TextureDesc& desc = resource.texture.GetDesc();
+		if (resource.IsStreaming() || desc.type != TextureDesc::TEXTURE_2D || desc.ArraySize != 1 || desc.SampleCount > 1 || desc.MipLevels < 2 ||
+			(desc.MiscFlags & RESOURCE_MISC_TEXTURECUBE) || std::min(desc.Width, desc.Height) / 2 < RESIDENCY_MIN_RESOLUTION)
+		{
+			return 0;
+		}
+
+		TextureDesc newdesc = desc;
+		newdesc.Width /= 2;
+		newdesc.Height /= 2;
+		newdesc.MipLevels -= 1;
+		newdesc.Usage = USAGE_DEFAULT; // immutable textures would need initial data
+		if (device->IsFormatBlockCompressed(desc.Format) && (newdesc.Width % 4 != 0 || newdesc.Height % 4 != 0))
+		{
+			return 0;
+		}
+
+		Texture texture;
+		if (!device->CreateTexture(&newdesc, nullptr, &texture))
+		{
+			return 0;
+		}
+		device->SetName(&texture, "wiResourceManager::residency");
+
+		{
+			GPUBarrier barriers[] = {
+				GPUBarrier::Image(&resource.texture, desc.layout, IMAGE_LAYOUT_COPY_SRC),
+				GPUBarrier::Image(&texture, newdesc.layout, IMAGE_LAYOUT_COPY_DST),
+			};
+			device->Barrier(barriers, arraysize(barriers), cmd);
+		}
+		for (uint32_t mip = 0; mip < newdesc.MipLevels; ++mip)
+		{
+			device->CopyTexture2D_Region(&texture, mip, 0, 0, &resource.texture, mip + 1, cmd);
+		}
+		{
+			GPUBarrier barriers[] = {
+				GPUBarrier::Image(&resource.texture, IMAGE_LAYOUT_COPY_SRC, desc.layout),
+				GPUBarrier::Image(&texture, IMAGE_LAYOUT_COPY_DST, newdesc.layout),
+			};
+			device->Barrier(barriers, arraysize(barriers), cmd);
+		}
+
+		if (resource.residency_low)
+		{
+			device->SetResidencyPriority(&texture, GraphicsDevice::RESIDENCY_PRIORITY_LOW);
+		}
+
+		PendingChange change;
+		change.resource = resource_ptr;
+		change.texture = texture;
+		change.residency = true;
+		pending_locker.lock();
+		pending_changes.push_back(change);
+		pending_locker.unlock();
+
+		return ComputeTopMipSize(desc);
+#else
+		return 0; // CopyTexture2D_Region() is not available
+#endif
+	}
+
+	// The streaming mip offset whose resolution still covers the requested resolution of the texture
+	static uint32_t ComputeStreamingMipOffset(const wiResource& resource, uint64_t frame)
+	{
+		const float request = resource.last_used_frame == frame ? resource.streaming_request : 0;
+		const TextureDesc& desc = resource.texture.GetDesc();
+		const uint32_t resolution = std::max(desc.Width, desc.Height) << resource.streaming_mip_offset;
+		uint32_t mip_offset = 0;
+		while (mip_offset < resource.streaming_mip_offset_max && float(resolution >> (mip_offset + 1)) >= request)
+		{
+			mip_offset++;
+		}
+		return mip_offset;
+	}
+
+	// Approximate size of the streamed texture with the mip offset, including its mip chain
+	static uint64_t ComputeStreamingSize(const wiResource& resource, uint32_t mip_offset)
+	{
+		TextureDesc desc = resource.texture.GetDesc();
+		desc.Width = std::max(1u, (desc.Width << resource.streaming_mip_offset) >> mip_offset);
+		desc.Height = std::max(1u, (desc.Height << resource.streaming_mip_offset) >> mip_offset);
+		return ComputeTopMipSize(desc) * 4 / 3;
+	}
+
+	// Loads the texture with a different mip offset from the file data on a background thread, which replaces the resource texture in ApplyPendingChanges()
+	static void StreamMips(const std::shared_ptr<wiResource>& resource, uint32_t mip_offset)
+	{
+		resource->streaming_busy = true;
+
+		const std::string name = resource->streaming_name;
+		const uint32_t flags = resource->flags & ~IMPORT_RETAIN_FILEDATA;
+		async_ctx.priority = wiJobSystem::Priority::Background;
+		async_ctx.name = "wiResourceManager::StreamMips";
+		wiJobSystem::Execute(async_ctx, [resource, mip_offset, name, flags](wiJobArgs args) {
+			// The retained file data is not modified while the resource is streaming:
+			wiResource loaded;
+			const bool success = LoadResource(&loaded, name, flags, resource->filedata.data(), resource->filedata.size(), mip_offset);
+
+			PendingChange change;
+			change.resource = resource;
+			change.streaming = true;
+			if (success && loaded.IsStreaming())
+			{
+				change.texture = loaded.texture;
+				change.streaming_mip_offset = loaded.streaming_mip_offset;
+			}
+			pending_locker.lock();
+			pending_changes.push_back(change);
+			pending_locker.unlock();
+		});
+	}
+
+	void UpdateResidency(CommandList cmd)
+	{
+		GraphicsDevice* device = wiRenderer::GetDevice();
+		const uint64_t frame = device->GetFrameCount() + 1;
+		if ((!residency_enabled && !streaming_enabled) || residency_frame == frame)
+		{
+			return;
+		}
+		residency_frame = frame;
+
+		std::vector<std::shared_ptr<wiResource>> tracked;
+		locker.lock();
+		for (auto& it : resources)
+		{
+			std::shared_ptr<wiResource> resource = it.second.lock();
+			if (resource != nullptr && resource->type == wiResource::IMAGE && resource->last_used_frame > 0 && resource->texture.IsValid())
+			{
+				tracked.push_back(resource);
+			}
+		}
+		locker.unlock();
+
+		residency_statistics.trackedTextures = (uint32_t)tracked.size();
+		residency_statistics.lowPriorityTextures = 0;
+		residency_statistics.streamingTextures = 0;
+		for (auto& resource : tracked)
+		{
+			if (resource->IsStreaming())
+			{
+				residency_statistics.streamingTextures++;
+			}
+			if (!residency_enabled)
+			{
+				continue;
+			}
+			const bool unused = frame - resource->last_used_frame > RESIDENCY_UNUSED_FRAMES;
+			if (unused != resource->residency_low)
+			{
+				resource->residency_low = unused;
+				device->SetResidencyPriority(&resource->texture, unused ? GraphicsDevice::RESIDENCY_PRIORITY_LOW : GraphicsDevice::RESIDENCY_PRIORITY_NORMAL);
+			}
+			if (resource->residency_low)
+			{
+				residency_statistics.lowPriorityTextures++;
+			}
+		}
+
+		const GraphicsDevice::MemoryBudget memory = device->GetMemoryBudget(GraphicsDevice::MEMORY_HEAP_DEVICE);
+		const uint64_t budget = residency_budget > 0 ? residency_budget : memory.budget;
+		residency_statistics.usage = memory.usage;
+		residency_statistics.budget = budget;
+
+		if (budget == 0 || memory.usage <= budget)
+		{
+			if (!streaming_enabled)
+			{
+				return;
+			}
+
+			// Stream in the textures that need more detail, the ones that miss the most mips first:
+			std::vector<std::pair<std::shared_ptr<wiResource>, uint32_t>> requests;
+			for (auto& resource : tracked)
+			{
+				if (resource->IsStreaming() && !resource->streaming_busy)
+				{
+					const uint32_t mip_offset = ComputeStreamingMipOffset(*resource, frame);
+					if (mip_offset < resource->streaming_mip_offset)
+					{
+						requests.push_back(std::make_pair(resource, mip_offset));
+					}
+				}
+			}
+			std::sort(requests.begin(), requests.end(), [](const std::pair<std::shared_ptr<wiResource>, uint32_t>& a, const std::pair<std::shared_ptr<wiResource>, uint32_t>& b) {
+				return a.first->streaming_mip_offset - a.second > b.first->streaming_mip_offset - b.second;
+			});
+
+			uint64_t usage = memory.usage;
+			uint32_t jobs = 0;
+			for (auto& request : requests)
+			{
+				if (jobs >= STREAMING_JOBS_PER_FRAME)
+				{
+					break;
+				}
+				const wiResource& resource = *request.first;
+				const uint64_t size = ComputeStreamingSize(resource, request.second) - ComputeStreamingSize(resource, resource.streaming_mip_offset);
+				if (budget > 0 && float(usage + size) > float(budget) * STREAMING_BUDGET_MARGIN)
+				{
+					continue;
+				}
+				usage += size;
+				residency_statistics.streamedInMips += resource.streaming_mip_offset - request.second;
+				residency_statistics.streamedInBytes += size;
+				StreamMips(request.first, request.second);
+				jobs++;
+			}
+			return;
+		}
+
+		// Least recently used first:
+		std::sort(tracked.begin(), tracked.end(), [](const std::shared_ptr<wiResource>& a, const std::shared_ptr<wiResource>& b) {
+			return a->last_used_frame < b->last_used_frame;
+		});
+
+		uint64_t excess = memory.usage - budget;
+		uint32_t evictions = 0;
+		for (auto& resource : tracked)
+		{
+			if (evictions >= RESIDENCY_EVICTIONS_PER_FRAME)
+			{
+				break;
+			}
+			uint64_t size = 0;
+			if (resource->IsStreaming())
+			{
+				// Streamed textures go back to the mips that they need, or lose one more mip:
+				if (streaming_enabled && !resource->streaming_busy)
+				{
+					const uint32_t mip_offset = std::min(resource->streaming_mip_offset_max, std::max(ComputeStreamingMipOffset(*resource, frame), resource->streaming_mip_offset + 1));
+					if (mip_offset > resource->streaming_mip_offset)
+					{
+						size = ComputeStreamingSize(*resource, resource->streaming_mip_offset) - ComputeStreamingSize(*resource, mip_offset);
+						residency_statistics.streamedOutMips += mip_offset - resource->streaming_mip_offset;
+						StreamMips(resource, mip_offset);
+					}
+				}
+			}
+			else if (residency_enabled)
+			{
+				size = DropTopMip(resource, cmd);
+				if (size > 0)
+				{
+					residency_statistics.evictedMips++;
+					residency_statistics.evictedBytes += size;
+				}
+			}
+			if (size > 0)
+			{
+				evictions++;
+				if (size >= excess)
+				{
+					break;
+				}
+				excess -= size;
+			}
+		}
+	}
+
+	ResidencyStatistics GetResidencyStatistics()
+	{
+		return residency_statistics;
+	}
+
 }
@@ -5,6 +5,7 @@
 #include "wiArchive.h"
 #include "wiJobSystem.h"
 
+#include <future>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -23,6 +24,17 @@ struct wiResource
 
 	uint32_t flags = 0;
 	std::vector<uint8_t> filedata;
+
+	uint64_t last_used_frame = 0; // the last frame when the texture was used by a visible material, 0 if residency is not tracked for it
+	bool residency_low = false; // the texture was given low residency priority because it wasn't used for a while
+
+	// Texture streaming state, for DDS textures that were loaded with IMPORT_STREAMING:
+	std::string streaming_name; // file that the mips are streamed from if the file data is not retained, empty if the texture is not streamed
+	uint32_t streaming_mip_offset = 0; // count of top mips that are not resident
+	uint32_t streaming_mip_offset_max = 0; // the mip offset of the initially loaded tail mips
+	float streaming_request = 0; // largest texture resolution that was requested in the current frame
+	bool streaming_busy = false; // mips are being streamed in or out
+	inline bool IsStreaming() const { return !streaming_name.empty(); }
 };
 
 namespace wiResourceManager
@@ -42,6 +54,9 @@ namespace wiResourceManager
 		EMPTY = 0,
 		IMPORT_COLORGRADINGLUT = 1 << 0, // image import will convert resource to 3D color grading LUT
 		IMPORT_RETAIN_FILEDATA = 1 << 1, // file data will be kept for later reuse. This is necessary for keeping the resource serializable
+		IMPORT_STREAMING = 1 << 2, // DDS textures will only load their tail mips, and the higher mips are streamed in when they are requested by TouchResource()
+		IMPORT_BLOCK_COMPRESS = 1 << 3, // other image formats will be converted to block compressed DDS with mips (BC3 with alpha, BC1 without), and kept in the texture cache
+		IMPORT_NORMALMAP = 1 << 4, // the image is a normal map, block compression uses BC5 (red and green channels only)
 	};
 
 #ifdef GGREDUCED
@@ -61,13 +76,62 @@ namespace wiResourceManager
 		const uint8_t* filedata = nullptr,
 		size_t filesize = 0
 	);
+
+	// Handle of an asynchronous load
+	struct LoadHandle
+	{
+		std::shared_ptr<wiResource> resource; // can be used immediately, the contents are replaced by ApplyPendingChanges() after the load finished
+		std::shared_future<bool> future; // the result of loading the file, becomes ready before the contents are applied to the resource
+
+		inline bool IsValid() const { return resource != nullptr; }
+		inline bool IsFinished() const { return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+	};
+	// Load a resource on a background worker thread, parameters are the same as Load()
+	//	placeholder : texture of the resource until the load is finished (optional). Without placeholder the texture is invalid, which makes its material slot unused meanwhile
+	//	The file data is copied, so it doesn't have to be kept alive by the caller
+	//	If the resource is already loaded or loading, the existing resource is returned
+	LoadHandle LoadAsync(
+		const std::string& name,
+		uint32_t flags = EMPTY,
+		const uint8_t* filedata = nullptr,
+		size_t filesize = 0,
+		const wiGraphics::Texture* placeholder = nullptr
+	);
+	// Wait until every asynchronous load is finished (their contents still need to be applied)
+	void WaitAsyncLoads();
+	// Replace the contents of resources that finished asynchronous loading or lost mips to residency eviction, and free the released resources that are not retained anymore
+	//	Must be called from the main thread before rendering, when no rendering work refers to the resources
+	//	Returns true if the texture of any resource was replaced, so descriptors that refer to them must be updated
+	bool ApplyPendingChanges();
+
 #ifdef GGREDUCED
 	// Free a previously loaded resource
 	void FreeResource(const std::string& name);
 	std::shared_ptr<wiResource> GetResource( const std::string& name, int create=0, int* pFound=0 );
 #endif
+	// Resources with the same file contents and flags are shared, even if they are loaded with different names (eg. different relative paths to the same file, or embedded into more scenes)
+	//	The file is read and hashed before registering the name. LoadAsync() can only do it when the file data is given, because it reads the file on a background thread
+	void SetContentDeduplicationEnabled(bool value);
+	bool IsContentDeduplicationEnabled();
+	// Resources that were created while the retain policy is enabled are kept alive after the last reference is released,
+	//	so that they are shared again if they are loaded meanwhile (for example by the next level). They are freed by ApplyPendingChanges()
+	//	frames : count of frames that a released resource is kept alive, 0 disables the retain policy (default), which frees the retained resources
+	//	bytes : approximate memory limit of the released resources that are kept alive, the earliest released are freed first above it, 0 means no limit
+	void SetRetainPolicy(uint32_t frames, uint64_t bytes = 0);
+	uint32_t GetRetainFrames();
+	uint64_t GetRetainBytes();
+	// Block compression of images that are imported with IMPORT_BLOCK_COMPRESS
+	void SetBlockCompressionEnabled(bool value);
+	bool IsBlockCompressionEnabled();
+	// Directory of the converted DDS files, which are reused while the source file contents and the import flags are the same
+	//	Empty by default, which means that the images are converted at every load
+	void SetTextureCacheDirectory(const std::string& directory);
+	const std::string& GetTextureCacheDirectory();
+
 	// Check if a resource is currently loaded
 	bool Contains(const std::string& name);
+	// Returns the bytes of file data that the loaded resources retain (see IMPORT_RETAIN_FILEDATA)
+	size_t GetRetainedFileDataSize();
 	// Invalidate all resources
 	void Clear();
 
@@ -78,4 +142,42 @@ namespace wiResourceManager
 	// Serializes all resources that are compatible
 	//	Compatible resources are those whose file data is kept around using the IMPORT_RETAIN_FILEDATA flag when loading.
 	void Serialize(wiArchive& archive, ResourceSerializer& seri);
+
+	// Texture residency:
+	//	Only textures that are marked used with TouchResource() are tracked. Textures that weren't used for a while get low residency priority,
+	//	and when the video memory usage is over the budget, the least recently used textures lose their highest mip (this is not reverted later)
+	void SetResidencyEnabled(bool value);
+	bool IsResidencyEnabled();
+	// The budget of video memory usage in bytes, 0 means that the budget reported by the OS is used
+	void SetResidencyBudget(uint64_t bytes);
+	uint64_t GetResidencyBudget();
+	// Mark the texture of the resource used in the current frame
+	//	resolution : the texture resolution that is needed for the current frame, which decides the streamed mips (optional)
+	void TouchResource(wiResource& resource, float resolution = 0);
+	// Update the residency priorities, stream mips in and out and evict mips if the video memory is over budget, at most once per frame
+	//	The textures that were streamed or lost mips are applied to the resources by the next ApplyPendingChanges()
+	void UpdateResidency(wiGraphics::CommandList cmd);
+
+	// Texture streaming:
+	//	Textures loaded with IMPORT_STREAMING start with their mips up to the initial resolution, the higher mips are loaded on background threads
+	//	when the requested resolution needs them and the video memory is under budget, and they are unloaded again when the budget is exceeded
+	void SetStreamingEnabled(bool value);
+	bool IsStreamingEnabled();
+	// The resolution up to which the tail mips are loaded, before anything is requested
+	void SetStreamingInitialResolution(uint32_t value);
+	uint32_t GetStreamingInitialResolution();
+	struct ResidencyStatistics
+	{
+		uint64_t usage = 0; // video memory usage in the last update
+		uint64_t budget = 0; // budget used in the last update
+		uint32_t trackedTextures = 0; // count of textures that are tracked for residency
+		uint32_t lowPriorityTextures = 0; // count of tracked textures with low residency priority
+		uint32_t evictedMips = 0; // count of mips that were dropped in total
+		uint64_t evictedBytes = 0; // approximate size of the dropped mips in total
+		uint32_t streamingTextures = 0; // count of tracked textures that are streamed
+		uint32_t streamedInMips = 0; // count of mips that were streamed in in total
+		uint64_t streamedInBytes = 0; // approximate size of the streamed in mips in total
+		uint32_t streamedOutMips = 0; // count of mips that were streamed out in total
+	};
+	ResidencyStatistics GetResidencyStatistics();
 };
@@ -10,9 +10,13 @@
 #include "wiHelper.h"
 #include "wiRenderer.h"
 #include "wiBackLog.h"
+#include "wiAllocators.h"
+#include "wiTimer.h"
 
 #include <functional>
+#include <cstring>
 #include <unordered_map>
+#include <unordered_set>
 
 #ifdef GGREDUCED
 #ifdef OPTICK_ENABLE
@@ -426,17 +430,44 @@ namespace wiScene
 		}
 		return RENDERTYPE_TRANSPARENT;
 	}
+	uint32_t MaterialComponent::GetShaderPermutation() const
+	{
+		uint32_t permutation = 0;
+		if (normalMapStrength > 0 && textures[NORMALMAP].GetUVSet() >= 0)
+		{
+			permutation |= OBJECTSHADER_PERMUTATION_NORMALMAP;
+		}
+		if (textures[SURFACEMAP].GetUVSet() >= 0 || textures[SPECULARMAP].GetUVSet() >= 0)
+		{
+			permutation |= OBJECTSHADER_PERMUTATION_SURFACEMAP;
+		}
+		if (GetEmissiveStrength() > 0 && textures[EMISSIVEMAP].GetUVSet() >= 0)
+		{
+			permutation |= OBJECTSHADER_PERMUTATION_EMISSIVEMAP;
+		}
+		if (IsOcclusionEnabled_Secondary() && textures[OCCLUSIONMAP].GetUVSet() >= 0)
+		{
+			permutation |= OBJECTSHADER_PERMUTATION_OCCLUSIONMAP;
+		}
+		return permutation;
+	}
 	void MaterialComponent::CreateRenderData() 
 	{
-		for (auto& x : textures)
+		for (int slot = 0; slot < TEXTURESLOT_COUNT; ++slot)
 		{
+			auto& x = textures[slot];
 #ifdef GGREDUCED
 			if (!x.name.empty() && !x.resource)
 #else
 			if (!x.name.empty())
 #endif
 			{
-				x.resource = wiResourceManager::Load(x.name, wiResourceManager::IMPORT_RETAIN_FILEDATA);
+				uint32_t flags = wiResourceManager::IMPORT_RETAIN_FILEDATA | wiResourceManager::IMPORT_STREAMING | wiResourceManager::IMPORT_BLOCK_COMPRESS;
+				if (slot == NORMALMAP || slot == CLEARCOATNORMALMAP)
+				{
+					flags |= wiResourceManager::IMPORT_NORMALMAP;
+				}
+				x.resource = wiResourceManager::Load(x.name, flags);
 			}
 		}
 
@@ -463,10 +494,20 @@ namespace wiScene
 		return wiRenderer::CombineStencilrefs(engineStencilRef, userStencilRef);
 	}
 
-	void MeshComponent::CreateRenderData()
+	void MeshComponent::CreateRenderData(wiAllocators::LinearAllocator* scratch)
 	{
+		if (IsCPUDataReleased())
+		{
+			// The GPU buffers are kept, there is nothing to recreate them from
+			wiBackLog::post("MeshComponent::CreateRenderData: the CPU data of the mesh was released, the render data is not recreated");
+			return;
+		}
+
 		GraphicsDevice* device = wiRenderer::GetDevice();
 
+		bvh.Clear();
+		deform_valid = false;
+
 		// Create index buffer GPU data:
 		{
 			GPUBufferDesc bd;
@@ -500,8 +541,8 @@ namespace wiScene
 				bd.Format = FORMAT_R16_UINT;
 				bd.ByteWidth = uint32_t(sizeof(uint16_t) * indices.size());
 
-				std::vector<uint16_t> gpuIndexData(indices.size());
-				std::copy(indices.begin(), indices.end(), gpuIndexData.begin());
+				wiAllocators::ScratchArray<uint16_t> gpuIndexData(indices.size(), scratch);
+				std::copy(indices.begin(), indices.end(), gpuIndexData.data());
 				initData.pSysMem = gpuIndexData.data();
 
 				device->CreateBuffer(&bd, &initData, &indexBuffer);
@@ -509,35 +550,128 @@ namespace wiScene
 			}
 		}
 
+		meshletBuffer = {};
+		if (!meshlets.empty())
+		{
+			GPUBufferDesc bd;
+			bd.Usage = USAGE_IMMUTABLE;
+			bd.BindFlags = BIND_SHADER_RESOURCE;
+			bd.MiscFlags = RESOURCE_MISC_BUFFER_STRUCTURED;
+			bd.StructureByteStride = sizeof(ShaderMeshlet);
+			bd.ByteWidth = uint32_t(bd.StructureByteStride * meshlets.size());
+
+			SubresourceData initData;
+			initData.pSysMem = meshlets.data();
+			device->CreateBuffer(&bd, &initData, &meshletBuffer);
+			device->SetName(&meshletBuffer, "meshletBuffer");
+		}
+
+		// The UV density is the square root of the ratio of the summed UV and surface areas (cooked meshes store it, because they don't have the UVs on the CPU):
+		uv_density = IsCooked() ? cooked.uv_density : 0;
+		if (!IsCooked() && vertex_uvset_0.size() == vertex_positions.size())
+		{
+			double area_uv = 0;
+			double area_pos = 0;
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				const uint32_t i0 = indices[i + 0];
+				const uint32_t i1 = indices[i + 1];
+				const uint32_t i2 = indices[i + 2];
+				const XMVECTOR p0 = XMLoadFloat3(&vertex_positions[i0]);
+				const XMVECTOR p1 = XMLoadFloat3(&vertex_positions[i1]);
+				const XMVECTOR p2 = XMLoadFloat3(&vertex_positions[i2]);
+				area_pos += XMVectorGetX(XMVector3Length(XMVector3Cross(p1 - p0, p2 - p0)));
+				const XMFLOAT2& t0 = vertex_uvset_0[i0];
+				const XMFLOAT2& t1 = vertex_uvset_0[i1];
+				const XMFLOAT2& t2 = vertex_uvset_0[i2];
+				area_uv += std::abs((t1.x - t0.x) * (t2.y - t0.y) - (t2.x - t0.x) * (t1.y - t0.y));
+			}
+			if (area_pos > 0)
+			{
+				uv_density = (float)std::sqrt(area_uv / area_pos);
+			}
+		}
+
 
 		XMFLOAT3 _min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
 		XMFLOAT3 _max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
 
 		// vertexBuffer - POSITION + NORMAL + WIND:
 		{
-		    if (!targets.empty())
-		    {
-				vertex_positions_morphed.resize(vertex_positions.size());
-				dirty_morph = true;
-		    }
-
-			std::vector<Vertex_POS> vertices(vertex_positions.size());
+			wiAllocators::ScratchArray<Vertex_POS> vertices(vertex_positions.size(), scratch);
 			for (size_t i = 0; i < vertices.size(); ++i)
 			{
 				const XMFLOAT3& pos = vertex_positions[i];
-			    XMFLOAT3 nor = vertex_normals.empty() ? XMFLOAT3(1, 1, 1) : vertex_normals[i];
-			    XMStoreFloat3(&nor, XMVector3Normalize(XMLoadFloat3(&nor)));
-				const uint8_t wind = vertex_windweights.empty() ? 0xFF : vertex_windweights[i];
-				vertices[i].FromFULL(pos, nor, wind);
+				if (IsCooked())
+				{
+					vertices[i].pos = pos;
+					vertices[i].normal_wind = cooked.normal_wind[i];
+				}
+				else
+				{
+					XMFLOAT3 nor = vertex_normals.empty() ? XMFLOAT3(1, 1, 1) : vertex_normals[i];
+					XMStoreFloat3(&nor, XMVector3Normalize(XMLoadFloat3(&nor)));
+					const uint8_t wind = vertex_windweights.empty() ? 0xFF : vertex_windweights[i];
+					vertices[i].FromFULL(pos, nor, wind);
+				}
 
 				_min = wiMath::Min(_min, pos);
 				_max = wiMath::Max(_max, pos);
 			}
 
+			// Collect the nonzero morph target offsets per vertex, vertices without any offset never change:
+			morph_vertices.clear();
+			morph_deltas.clear();
+			if (!targets.empty())
+			{
+				vertex_positions_morphed.assign(vertices.data(), vertices.data() + vertices.size());
+				dirty_morph = true;
+
+				XMFLOAT3 static_min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+				XMFLOAT3 static_max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+				for (size_t i = 0; i < vertex_positions.size(); ++i)
+				{
+					ShaderMorphVertex vertex = {};
+					vertex.position = vertex_positions[i];
+					vertex.vertex = (uint32_t)i;
+					vertex.normal = vertex_normals.empty() ? XMFLOAT3(1, 1, 1) : vertex_normals[i];
+					vertex.wind = vertex_windweights.empty() ? 0xFF : vertex_windweights[i];
+					vertex.deltaOffset = (uint32_t)morph_deltas.size();
+					for (size_t t = 0; t < targets.size(); ++t)
+					{
+						const MeshMorphTarget& target = targets[t];
+						ShaderMorphDelta delta = {};
+						delta.position = target.vertex_positions.empty() ? XMFLOAT3(0, 0, 0) : target.vertex_positions[i];
+						delta.normal = target.vertex_normals.empty() ? XMFLOAT3(0, 0, 0) : target.vertex_normals[i];
+						delta.target = (uint32_t)t;
+						if (delta.position.x != 0 || delta.position.y != 0 || delta.position.z != 0 ||
+							delta.normal.x != 0 || delta.normal.y != 0 || delta.normal.z != 0)
+						{
+							morph_deltas.push_back(delta);
+						}
+					}
+					vertex.deltaCount = (uint32_t)morph_deltas.size() - vertex.deltaOffset;
+					if (vertex.deltaCount > 0)
+					{
+						morph_vertices.push_back(vertex);
+					}
+					else
+					{
+						static_min = wiMath::Min(static_min, vertex_positions[i]);
+						static_max = wiMath::Max(static_max, vertex_positions[i]);
+					}
+				}
+				morph_static_aabb = AABB(static_min, static_max);
+			}
+
 			GPUBufferDesc bd;
 			bd.Usage = USAGE_DEFAULT;
 			bd.CPUAccessFlags = 0;
 			bd.BindFlags = BIND_VERTEX_BUFFER | BIND_SHADER_RESOURCE;
+			if (!morph_vertices.empty())
+			{
+				bd.BindFlags |= BIND_UNORDERED_ACCESS;
+			}
 			bd.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
 			if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_PIPELINE) || device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
 			{
@@ -549,12 +683,40 @@ namespace wiScene
 			InitData.pSysMem = vertices.data();
 			device->CreateBuffer(&bd, &InitData, &vertexBuffer_POS);
 			device->SetName(&vertexBuffer_POS, "vertexBuffer_POS");
+
+			morphVertexBuffer = {};
+			morphDeltaBuffer = {};
+			morphWeightBuffer = {};
+			if (!morph_vertices.empty())
+			{
+				bd = GPUBufferDesc();
+				bd.Usage = USAGE_DEFAULT;
+				bd.BindFlags = BIND_SHADER_RESOURCE;
+				bd.MiscFlags = RESOURCE_MISC_BUFFER_STRUCTURED;
+
+				bd.StructureByteStride = sizeof(ShaderMorphVertex);
+				bd.ByteWidth = uint32_t(bd.StructureByteStride * morph_vertices.size());
+				InitData.pSysMem = morph_vertices.data();
+				device->CreateBuffer(&bd, &InitData, &morphVertexBuffer);
+				device->SetName(&morphVertexBuffer, "morphVertexBuffer");
+
+				bd.StructureByteStride = sizeof(ShaderMorphDelta);
+				bd.ByteWidth = uint32_t(bd.StructureByteStride * morph_deltas.size());
+				InitData.pSysMem = morph_deltas.data();
+				device->CreateBuffer(&bd, &InitData, &morphDeltaBuffer);
+				device->SetName(&morphDeltaBuffer, "morphDeltaBuffer");
+
+				bd.StructureByteStride = sizeof(float);
+				bd.ByteWidth = uint32_t(bd.StructureByteStride * targets.size());
+				device->CreateBuffer(&bd, nullptr, &morphWeightBuffer);
+				device->SetName(&morphWeightBuffer, "morphWeightBuffer");
+			}
 		}
 
 		// vertexBuffer - TANGENTS
-		if(!vertex_uvset_0.empty())
+		if (!vertex_uvset_0.empty() || !cooked.tangents.empty())
 		{
-			if (vertex_tangents.empty())
+			if (vertex_tangents.empty() && !IsCooked())
 			{
 				// Generate tangents if not found:
 				vertex_tangents.resize(vertex_positions.size());
@@ -626,7 +788,7 @@ namespace wiScene
 
 			}
 
-			std::vector<Vertex_TAN> vertices(vertex_tangents.size());
+			wiAllocators::ScratchArray<Vertex_TAN> vertices(vertex_tangents.size(), scratch);
 			for (size_t i = 0; i < vertex_tangents.size(); ++i)
 			{
 				vertices[i].FromFULL(vertex_tangents[i]);
@@ -638,10 +800,10 @@ namespace wiScene
 			bd.BindFlags = BIND_VERTEX_BUFFER | BIND_SHADER_RESOURCE;
 			bd.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
 			bd.StructureByteStride = sizeof(Vertex_TAN);
-			bd.ByteWidth = (uint32_t)(bd.StructureByteStride * vertices.size());
+			bd.ByteWidth = (uint32_t)(bd.StructureByteStride * (IsCooked() ? cooked.tangents.size() : vertices.size()));
 
 			SubresourceData InitData;
-			InitData.pSysMem = vertices.data();
+			InitData.pSysMem = IsCooked() ? (const void*)cooked.tangents.data() : (const void*)vertices.data();
 			device->CreateBuffer(&bd, &InitData, &vertexBuffer_TAN);
 			device->SetName(&vertexBuffer_TAN, "vertexBuffer_TAN");
 		}
@@ -651,7 +813,7 @@ namespace wiScene
 		// skinning buffers:
 		if (!vertex_boneindices.empty())
 		{
-			std::vector<Vertex_BON> vertices(vertex_boneindices.size());
+			wiAllocators::ScratchArray<Vertex_BON> vertices(vertex_boneindices.size(), scratch);
 			for (size_t i = 0; i < vertices.size(); ++i)
 			{
 				XMFLOAT4& wei = vertex_boneweights[i];
@@ -683,9 +845,9 @@ namespace wiScene
 			bd.CPUAccessFlags = 0;
 			bd.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
 
-			if (!vertex_tangents.empty())
+			if (!vertex_tangents.empty() || !cooked.tangents.empty())
 			{
-				bd.ByteWidth = (uint32_t)(sizeof(Vertex_TAN) * vertex_tangents.size());
+				bd.ByteWidth = (uint32_t)(sizeof(Vertex_TAN) * vertex_positions.size());
 				device->CreateBuffer(&bd, nullptr, &streamoutBuffer_TAN);
 				device->SetName(&streamoutBuffer_TAN, "streamoutBuffer_TAN");
 			}
@@ -700,9 +862,9 @@ namespace wiScene
 		}
 
 		// vertexBuffer - UV SET 0
-		if(!vertex_uvset_0.empty())
+		if (!vertex_uvset_0.empty() || !cooked.uvset_0.empty())
 		{
-			std::vector<Vertex_TEX> vertices(vertex_uvset_0.size());
+			wiAllocators::ScratchArray<Vertex_TEX> vertices(vertex_uvset_0.size(), scratch);
 			for (size_t i = 0; i < vertices.size(); ++i)
 			{
 				vertices[i].FromFULL(vertex_uvset_0[i]);
@@ -714,18 +876,18 @@ namespace wiScene
 			bd.BindFlags = BIND_VERTEX_BUFFER | BIND_SHADER_RESOURCE;
 			bd.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
 			bd.StructureByteStride = sizeof(Vertex_TEX);
-			bd.ByteWidth = (uint32_t)(bd.StructureByteStride * vertices.size());
+			bd.ByteWidth = (uint32_t)(bd.StructureByteStride * (IsCooked() ? cooked.uvset_0.size() : vertices.size()));
 
 			SubresourceData InitData;
-			InitData.pSysMem = vertices.data();
+			InitData.pSysMem = IsCooked() ? (const void*)cooked.uvset_0.data() : (const void*)vertices.data();
 			device->CreateBuffer(&bd, &InitData, &vertexBuffer_UV0);
 			device->SetName(&vertexBuffer_UV0, "vertexBuffer_UV0");
 		}
 
 		// vertexBuffer - UV SET 1
-		if (!vertex_uvset_1.empty())
+		if (!vertex_uvset_1.empty() || !cooked.uvset_1.empty())
 		{
-			std::vector<Vertex_TEX> vertices(vertex_uvset_1.size());
+			wiAllocators::ScratchArray<Vertex_TEX> vertices(vertex_uvset_1.size(), scratch);
 			for (size_t i = 0; i < vertices.size(); ++i)
 			{
 				vertices[i].FromFULL(vertex_uvset_1[i]);
@@ -737,10 +899,10 @@ namespace wiScene
 			bd.BindFlags = BIND_VERTEX_BUFFER | BIND_SHADER_RESOURCE;
 			bd.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
 			bd.StructureByteStride = sizeof(Vertex_TEX);
-			bd.ByteWidth = (uint32_t)(bd.StructureByteStride * vertices.size());
+			bd.ByteWidth = (uint32_t)(bd.StructureByteStride * (IsCooked() ? cooked.uvset_1.size() : vertices.size()));
 
 			SubresourceData InitData;
-			InitData.pSysMem = vertices.data();
+			InitData.pSysMem = IsCooked() ? (const void*)cooked.uvset_1.data() : (const void*)vertices.data();
 			device->CreateBuffer(&bd, &InitData, &vertexBuffer_UV1);
 			device->SetName(&vertexBuffer_UV1, "vertexBuffer_UV1");
 		}
@@ -763,9 +925,9 @@ namespace wiScene
 		}
 
 		// vertexBuffer - ATLAS
-		if (!vertex_atlas.empty())
+		if (!vertex_atlas.empty() || !cooked.atlas.empty())
 		{
-			std::vector<Vertex_TEX> vertices(vertex_atlas.size());
+			wiAllocators::ScratchArray<Vertex_TEX> vertices(vertex_atlas.size(), scratch);
 			for (size_t i = 0; i < vertices.size(); ++i)
 			{
 				vertices[i].FromFULL(vertex_atlas[i]);
@@ -777,10 +939,10 @@ namespace wiScene
 			bd.BindFlags = BIND_VERTEX_BUFFER | BIND_SHADER_RESOURCE;
 			bd.MiscFlags = RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
 			bd.StructureByteStride = sizeof(Vertex_TEX);
-			bd.ByteWidth = (uint32_t)(bd.StructureByteStride * vertices.size());
+			bd.ByteWidth = (uint32_t)(bd.StructureByteStride * (IsCooked() ? cooked.atlas.size() : vertices.size()));
 
 			SubresourceData InitData;
-			InitData.pSysMem = vertices.data();
+			InitData.pSysMem = IsCooked() ? (const void*)cooked.atlas.data() : (const void*)vertices.data();
 			device->CreateBuffer(&bd, &InitData, &vertexBuffer_ATL);
 			device->SetName(&vertexBuffer_ATL, "vertexBuffer_ATL");
 		}
@@ -822,6 +984,9 @@ namespace wiScene
 		if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_PIPELINE) || device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
 		{
 			BLAS_state = BLAS_STATE_NEEDS_REBUILD;
+			BLAS_built = false;
+			BLAS_compacted = false;
+			BLAS_build_delay = 0;
 
 			RaytracingAccelerationStructureDesc desc;
 			desc.type = RaytracingAccelerationStructureDesc::BOTTOMLEVEL;
@@ -834,6 +999,7 @@ namespace wiScene
 			else
 			{
 				desc._flags |= RaytracingAccelerationStructureDesc::FLAG_PREFER_FAST_TRACE;
+				desc._flags |= RaytracingAccelerationStructureDesc::FLAG_ALLOW_COMPACTION; // static BLAS is compacted after the first build
 			}
 
 			for (auto& subset : subsets)
@@ -907,6 +1073,8 @@ namespace wiScene
 	}
 	void MeshComponent::ComputeNormals(COMPUTE_NORMALS compute)
 	{
+		Uncook();
+
 		// Start recalculating normals:
 
 		if(compute != COMPUTE_NORMALS_SMOOTH_FAST)
@@ -1234,6 +1402,7 @@ namespace wiScene
 	}
 	void MeshComponent::FlipNormals()
 	{
+		Uncook();
 		for (auto& normal : vertex_normals)
 		{
 			normal.x *= -1;
@@ -1270,6 +1439,183 @@ namespace wiScene
 
 		CreateRenderData();
 	}
+	void MeshComponent::Cook()
+	{
+		if (IsCooked() || !targets.empty() || vertex_positions.empty())
+		{
+			return;
+		}
+		if (!vertex_uvset_0.empty() && vertex_tangents.size() != vertex_positions.size())
+		{
+			vertex_tangents.clear();
+			CreateRenderData(); // generates the tangents
+		}
+		static_assert(sizeof(Vertex_TAN) == sizeof(uint32_t) && sizeof(Vertex_TEX) == sizeof(uint32_t), "the cooked streams are stored as 32 bit values");
+
+		cooked = CookedStreams();
+		cooked.normal_wind.resize(vertex_positions.size());
+		for (size_t i = 0; i < vertex_positions.size(); ++i)
+		{
+			XMFLOAT3 nor = vertex_normals.empty() ? XMFLOAT3(1, 1, 1) : vertex_normals[i];
+			XMStoreFloat3(&nor, XMVector3Normalize(XMLoadFloat3(&nor)));
+			Vertex_POS vertex;
+			vertex.FromFULL(vertex_positions[i], nor, vertex_windweights.empty() ? 0xFF : vertex_windweights[i]);
+			cooked.normal_wind[i] = vertex.normal_wind;
+		}
+		cooked.tangents.resize(vertex_tangents.size());
+		for (size_t i = 0; i < vertex_tangents.size(); ++i)
+		{
+			Vertex_TAN vertex;
+			vertex.FromFULL(vertex_tangents[i]);
+			cooked.tangents[i] = vertex.tangent;
+		}
+		auto cook_uvs = [](const std::vector<XMFLOAT2>& uvs, std::vector<uint32_t>& stream) {
+			stream.resize(uvs.size());
+			for (size_t i = 0; i < uvs.size(); ++i)
+			{
+				Vertex_TEX vertex;
+				vertex.FromFULL(uvs[i]);
+				std::memcpy(&stream[i], &vertex, sizeof(vertex));
+			}
+		};
+		cook_uvs(vertex_uvset_0, cooked.uvset_0);
+		cook_uvs(vertex_uvset_1, cooked.uvset_1);
+		cook_uvs(vertex_atlas, cooked.atlas);
+		cooked.uv_density = uv_density;
+
+		std::vector<XMFLOAT3>().swap(vertex_normals);
+		std::vector<uint8_t>().swap(vertex_windweights);
+		std::vector<XMFLOAT4>().swap(vertex_tangents);
+		std::vector<XMFLOAT2>().swap(vertex_uvset_0);
+		std::vector<XMFLOAT2>().swap(vertex_uvset_1);
+		std::vector<XMFLOAT2>().swap(vertex_atlas);
+		_flags |= COOKED;
+	}
+	void MeshComponent::Uncook()
+	{
+		if (!IsCooked())
+		{
+			return;
+		}
+
+		vertex_normals.resize(cooked.normal_wind.size());
+		vertex_windweights.resize(cooked.normal_wind.size());
+		for (size_t i = 0; i < cooked.normal_wind.size(); ++i)
+		{
+			Vertex_POS vertex;
+			vertex.normal_wind = cooked.normal_wind[i];
+			vertex_normals[i] = vertex.GetNor_FULL();
+			vertex_windweights[i] = vertex.GetWind();
+		}
+		vertex_tangents.resize(cooked.tangents.size());
+		for (size_t i = 0; i < cooked.tangents.size(); ++i)
+		{
+			const uint32_t tangent = cooked.tangents[i];
+			vertex_tangents[i].x = (float)((tangent >> 0) & 0xFF) / 255.0f * 2.0f - 1.0f;
+			vertex_tangents[i].y = (float)((tangent >> 8) & 0xFF) / 255.0f * 2.0f - 1.0f;
+			vertex_tangents[i].z = (float)((tangent >> 16) & 0xFF) / 255.0f * 2.0f - 1.0f;
+			vertex_tangents[i].w = ((tangent >> 24) & 0xFF) >= 128 ? 1.0f : -1.0f;
+		}
+		auto uncook_uvs = [](const std::vector<uint32_t>& stream, std::vector<XMFLOAT2>& uvs) {
+			uvs.resize(stream.size());
+			for (size_t i = 0; i < stream.size(); ++i)
+			{
+				Vertex_TEX vertex;
+				std::memcpy(&vertex, &stream[i], sizeof(vertex));
+				uvs[i] = XMFLOAT2(XMConvertHalfToFloat(vertex.tex.x), XMConvertHalfToFloat(vertex.tex.y));
+			}
+		};
+		uncook_uvs(cooked.uvset_0, vertex_uvset_0);
+		uncook_uvs(cooked.uvset_1, vertex_uvset_1);
+		uncook_uvs(cooked.atlas, vertex_atlas);
+
+		cooked = CookedStreams();
+		_flags &= ~COOKED;
+	}
+	void MeshComponent::ReleaseCPUData(bool keep_geometry)
+	{
+		if (IsCPUDataReleased())
+		{
+			return;
+		}
+		released_vertex_count = (uint32_t)vertex_positions.size();
+		released_index_count = (uint32_t)indices.size();
+		cpu_data_released = true;
+
+		std::vector<XMFLOAT3>().swap(vertex_normals);
+		std::vector<XMFLOAT4>().swap(vertex_tangents);
+		std::vector<XMFLOAT2>().swap(vertex_uvset_0);
+		std::vector<XMFLOAT2>().swap(vertex_uvset_1);
+		std::vector<XMFLOAT2>().swap(vertex_atlas);
+		std::vector<uint32_t>().swap(vertex_colors);
+		std::vector<uint8_t>().swap(vertex_windweights);
+		std::vector<uint8_t>().swap(vertex_subsets);
+		std::vector<MeshMorphTarget>().swap(targets); // the morphing uses morph_vertices and morph_deltas
+		cooked = CookedStreams();
+		if (!keep_geometry)
+		{
+			std::vector<XMFLOAT3>().swap(vertex_positions);
+			std::vector<uint32_t>().swap(indices);
+			std::vector<XMUINT4>().swap(vertex_boneindices);
+			std::vector<XMFLOAT4>().swap(vertex_boneweights);
+			bvh.Clear();
+		}
+	}
+	size_t MeshComponent::GetCPUDataSize() const
+	{
+		size_t size = 0;
+		size += vertex_positions.capacity() * sizeof(XMFLOAT3);
+		size += vertex_normals.capacity() * sizeof(XMFLOAT3);
+		size += vertex_tangents.capacity() * sizeof(XMFLOAT4);
+		size += vertex_uvset_0.capacity() * sizeof(XMFLOAT2);
+		size += vertex_uvset_1.capacity() * sizeof(XMFLOAT2);
+		size += vertex_boneindices.capacity() * sizeof(XMUINT4);
+		size += vertex_boneweights.capacity() * sizeof(XMFLOAT4);
+		size += vertex_atlas.capacity() * sizeof(XMFLOAT2);
+		size += vertex_colors.capacity() * sizeof(uint32_t);
+		size += vertex_windweights.capacity() * sizeof(uint8_t);
+		size += vertex_subsets.capacity() * sizeof(uint8_t);
+		size += indices.capacity() * sizeof(uint32_t);
+		size += subsets.capacity() * sizeof(MeshSubset);
+		size += meshlets.capacity() * sizeof(ShaderMeshlet);
+		for (auto& x : targets)
+		{
+			size += sizeof(MeshMorphTarget) + x.vertex_positions.capacity() * sizeof(XMFLOAT3) + x.vertex_normals.capacity() * sizeof(XMFLOAT3);
+		}
+		size += (cooked.normal_wind.capacity() + cooked.tangents.capacity() + cooked.uvset_0.capacity() + cooked.uvset_1.capacity() + cooked.atlas.capacity()) * sizeof(uint32_t);
+		size += vertex_positions_morphed.capacity() * sizeof(Vertex_POS);
+		size += morph_vertices.capacity() * sizeof(ShaderMorphVertex);
+		size += morph_deltas.capacity() * sizeof(ShaderMorphDelta);
+		size += bvh.GetMemorySize();
+		return size;
+	}
+	void MeshComponent::BuildBVH()
+	{
+		const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+		std::vector<AABB> triangle_aabbs(triangleCount);
+		for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+		{
+			const XMVECTOR p0 = XMLoadFloat3(&vertex_positions[indices[triangle * 3 + 0]]);
+			const XMVECTOR p1 = XMLoadFloat3(&vertex_positions[indices[triangle * 3 + 1]]);
+			const XMVECTOR p2 = XMLoadFloat3(&vertex_positions[indices[triangle * 3 + 2]]);
+			XMStoreFloat3(&triangle_aabbs[triangle]._min, XMVectorMin(p0, XMVectorMin(p1, p2)));
+			XMStoreFloat3(&triangle_aabbs[triangle]._max, XMVectorMax(p0, XMVectorMax(p1, p2)));
+		}
+		bvh.Build(triangle_aabbs.data(), triangleCount);
+	}
+	const wiBVH* MeshComponent::GetBVH() const
+	{
+		if (IsSkinned() || !vertex_positions_morphed.empty() || indices.size() < 3)
+		{
+			return nullptr;
+		}
+		if (bvh.IsEmpty() || bvh.GetItemCount() != (uint32_t)(indices.size() / 3))
+		{
+			bvh_requested = true;
+			return nullptr;
+		}
+		return &bvh;
+	}
 	SPHERE MeshComponent::GetBoundingSphere() const
 	{
 		XMFLOAT3 halfwidth = aabb.getHalfWidth();
@@ -1353,6 +1699,69 @@ namespace wiScene
 				lightmapTextureData = std::move(texturedata_dst);
 			}
 			lightmap_rect = {}; // repack into global atlas
+#else
+			if (success && lightmapTextureData.size() == (size_t)lightmapWidth * (size_t)lightmapHeight * sizeof(XMFLOAT4))
+			{
+				// Without Open Image Denoise, an edge-aware bilateral filter removes the remaining noise of the samples:
+				//	Texels that weren't covered in the atlas (zero alpha) are not taken into account
+				std::vector<uint8_t> texturedata_dst(lightmapTextureData.size());
+				const XMFLOAT4* src = (const XMFLOAT4*)lightmapTextureData.data();
+				XMFLOAT4* dst = (XMFLOAT4*)texturedata_dst.data();
+				const int width = (int)lightmapWidth;
+				const int height = (int)lightmapHeight;
+
+				wiJobSystem::context ctx;
+				wiJobSystem::Dispatch(ctx, (uint32_t)height, 8, [&](wiJobArgs args) {
+					const int y = (int)args.jobIndex;
+					for (int x = 0; x < width; ++x)
+					{
+						const XMFLOAT4& center = src[x + y * width];
+						XMFLOAT4& result = dst[x + y * width];
+						result = center;
+						if (center.w <= 0)
+							continue;
+
+						const float center_luminance = std::max(0.0f, center.x * 0.2126f + center.y * 0.7152f + center.z * 0.0722f);
+						const float range_sigma = std::max(0.001f, center_luminance * 0.25f);
+						XMFLOAT3 sum = XMFLOAT3(0, 0, 0);
+						float weight_sum = 0;
+						for (int j = -2; j <= 2; ++j)
+						{
+							for (int i = -2; i <= 2; ++i)
+							{
+								const int sx = x + i;
+								const int sy = y + j;
+								if (sx < 0 || sy < 0 || sx >= width || sy >= height)
+									continue;
+								const XMFLOAT4& sample = src[sx + sy * width];
+								if (sample.w <= 0)
+									continue;
+								const float luminance = std::max(0.0f, sample.x * 0.2126f + sample.y * 0.7152f + sample.z * 0.0722f);
+								const float range = (luminance - center_luminance) / range_sigma;
+								const float weight = std::exp(-(float)(i * i + j * j) / 4.5f - range * range * 0.5f);
+								sum.x += sample.x * weight;
+								sum.y += sample.y * weight;
+								sum.z += sample.z * weight;
+								weight_sum += weight;
+							}
+						}
+						result.x = sum.x / weight_sum;
+						result.y = sum.y / weight_sum;
+						result.z = sum.z / weight_sum;
+					}
+				});
+				wiJobSystem::Wait(ctx);
+
+				GraphicsDevice* device = wiRenderer::GetDevice();
+
+				SubresourceData initdata;
+				initdata.pSysMem = texturedata_dst.data();
+				initdata.SysMemPitch = uint32_t(sizeof(XMFLOAT4) * width);
+				device->CreateTexture(&lightmap.desc, &initdata, &lightmap);
+
+				lightmapTextureData = std::move(texturedata_dst);
+			}
+			lightmap_rect = {}; // repack into global atlas
 #endif // OPEN_IMAGE_DENOISE
 
 		}
@@ -1384,7 +1793,31 @@ namespace wiScene
 		bd.MiscFlags = RESOURCE_MISC_BUFFER_STRUCTURED;
 		bd.StructureByteStride = sizeof(ArmatureComponent::ShaderBoneType);
 
+		if (wiRenderer::GetGPUBoneTransformsEnabled())
+		{
+			// The skinning matrices will be written by the bone transforms compute shader:
+			bd.Usage = USAGE_DEFAULT;
+			bd.CPUAccessFlags = 0;
+			bd.BindFlags |= BIND_UNORDERED_ACCESS;
+		}
+
 		device->CreateBuffer(&bd, nullptr, &boneBuffer);
+
+		if (wiRenderer::GetGPUBoneTransformsEnabled())
+		{
+			bd.Usage = USAGE_DEFAULT;
+			bd.CPUAccessFlags = 0;
+			bd.BindFlags = BIND_SHADER_RESOURCE;
+
+			bd.ByteWidth = sizeof(ShaderBoneTransform) * (uint32_t)boneCollection.size();
+			bd.StructureByteStride = sizeof(ShaderBoneTransform);
+			device->CreateBuffer(&bd, nullptr, &boneTransformBuffer);
+
+			bd.ByteWidth = sizeof(ShaderBoneStatic) * (uint32_t)boneCollection.size();
+			bd.StructureByteStride = sizeof(ShaderBoneStatic);
+			device->CreateBuffer(&bd, nullptr, &boneStaticBuffer);
+			boneStatics_dirty = true;
+		}
 	}
 
 	void SoftBodyPhysicsComponent::CreateFromMesh(const MeshComponent& mesh)
@@ -1440,6 +1873,131 @@ namespace wiScene
 			std::fill(weights.begin(), weights.end(), 1.0f);
 		}
 	}
+	void SoftBodyPhysicsComponent::CreateGPUSimulationData(const MeshComponent& mesh)
+	{
+		const uint32_t particleCount = (uint32_t)physicsToGraphicsVertexMapping.size();
+		const uint32_t vertexCount = (uint32_t)graphicsToPhysicsVertexMapping.size();
+		if (particleCount == 0 || vertexCount != vertex_positions_simulation.size() || weights.size() != particleCount)
+		{
+			return;
+		}
+
+		// The distance constraints are the edges of the triangles between the physics vertices, the rings are the triangles around them:
+		std::vector<std::vector<uint32_t>> neighbors(particleCount);
+		std::vector<std::vector<XMUINT2>> rings(particleCount);
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			const uint32_t p[] = {
+				graphicsToPhysicsVertexMapping[mesh.indices[i + 0]],
+				graphicsToPhysicsVertexMapping[mesh.indices[i + 1]],
+				graphicsToPhysicsVertexMapping[mesh.indices[i + 2]],
+			};
+			if (p[0] == p[1] || p[1] == p[2] || p[2] == p[0])
+			{
+				continue;
+			}
+			for (int j = 0; j < 3; ++j)
+			{
+				const uint32_t a = p[j];
+				const uint32_t b = p[(j + 1) % 3];
+				const uint32_t c = p[(j + 2) % 3];
+				rings[a].push_back(XMUINT2(b, c));
+				neighbors[a].push_back(b);
+				neighbors[a].push_back(c);
+			}
+		}
+
+		// The rest positions are the world space vertices that the physics representation was created from:
+		auto RestPosition = [&](uint32_t particle) {
+			return XMLoadFloat3(&vertex_positions_simulation[physicsToGraphicsVertexMapping[particle]].pos);
+		};
+
+		// The winding of the mesh is not assumed, the rings are flipped if their normals mostly face away from the vertex normals:
+		float facing = 0;
+		for (uint32_t i = 0; i < particleCount; ++i)
+		{
+			const XMVECTOR P = RestPosition(i);
+			XMVECTOR N = XMVectorZero();
+			for (const XMUINT2& ring : rings[i])
+			{
+				N += XMVector3Cross(RestPosition(ring.x) - P, RestPosition(ring.y) - P);
+			}
+			facing += XMVectorGetX(XMVector3Dot(N, vertex_positions_simulation[physicsToGraphicsVertexMapping[i]].LoadNOR()));
+		}
+
+		std::vector<ShaderClothParticle> particles(particleCount);
+		std::vector<XMFLOAT4> positions(particleCount);
+		std::vector<XMUINT2> constraints;
+		std::vector<XMUINT2> ringdata;
+		for (uint32_t i = 0; i < particleCount; ++i)
+		{
+			std::vector<uint32_t>& neighbor = neighbors[i];
+			std::sort(neighbor.begin(), neighbor.end());
+			neighbor.erase(std::unique(neighbor.begin(), neighbor.end()), neighbor.end());
+
+			// The physics engine uses the weights as the masses of the nodes too, so the zero weights are the animated particles:
+			ShaderClothParticle& particle = particles[i];
+			particle = {};
+			XMStoreFloat3(&particle.previous, RestPosition(i));
+			particle.inverseMass = weights[i] > 0 ? 1.0f / weights[i] : 0;
+			particle.vertex = physicsToGraphicsVertexMapping[i];
+			particle.constraintOffset = (uint32_t)constraints.size();
+			particle.constraintCount = (uint32_t)neighbor.size();
+			particle.ringOffset = (uint32_t)ringdata.size();
+			particle.ringCount = (uint32_t)rings[i].size();
+			positions[i] = XMFLOAT4(particle.previous.x, particle.previous.y, particle.previous.z, particle.inverseMass);
+
+			for (uint32_t j : neighbor)
+			{
+				const float restLength = XMVectorGetX(XMVector3Length(RestPosition(j) - RestPosition(i)));
+				constraints.push_back(XMUINT2(j, *(const uint32_t*)&restLength));
+			}
+			for (const XMUINT2& ring : rings[i])
+			{
+				ringdata.push_back(facing < 0 ? XMUINT2(ring.y, ring.x) : ring);
+			}
+		}
+		if (constraints.empty())
+		{
+			return;
+		}
+
+		GraphicsDevice* device = wiRenderer::GetDevice();
+
+		GPUBufferDesc bd;
+		bd.Usage = USAGE_DEFAULT;
+		bd.BindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+		bd.MiscFlags = RESOURCE_MISC_BUFFER_STRUCTURED;
+		SubresourceData data;
+
+		bd.StructureByteStride = sizeof(ShaderClothParticle);
+		bd.ByteWidth = bd.StructureByteStride * particleCount;
+		data.pSysMem = particles.data();
+		device->CreateBuffer(&bd, &data, &clothParticleBuffer);
+
+		bd.StructureByteStride = sizeof(XMFLOAT4);
+		bd.ByteWidth = bd.StructureByteStride * particleCount;
+		data.pSysMem = positions.data();
+		device->CreateBuffer(&bd, &data, &clothPositionBuffer[0]);
+		device->CreateBuffer(&bd, &data, &clothPositionBuffer[1]);
+
+		bd.BindFlags = BIND_SHADER_RESOURCE;
+		bd.StructureByteStride = sizeof(XMUINT2);
+		bd.ByteWidth = bd.StructureByteStride * (uint32_t)constraints.size();
+		data.pSysMem = constraints.data();
+		device->CreateBuffer(&bd, &data, &clothConstraintBuffer);
+
+		bd.ByteWidth = bd.StructureByteStride * (uint32_t)ringdata.size();
+		data.pSysMem = ringdata.data();
+		device->CreateBuffer(&bd, &data, &clothRingBuffer);
+
+		bd.StructureByteStride = sizeof(uint32_t);
+		bd.ByteWidth = bd.StructureByteStride * vertexCount;
+		data.pSysMem = graphicsToPhysicsVertexMapping.data();
+		device->CreateBuffer(&bd, &data, &clothMappingBuffer);
+
+		cloth_reset = true;
+	}
 	
 	void CameraComponent::CreatePerspective(float newWidth, float newHeight, float newNear, float newFar, float newFOV)
 	{
@@ -1574,25 +2132,131 @@ namespace wiScene
 	{
 		this->dt = dt;
 		wiJobSystem::context ctx;
-		RunPreviousFrameTransformUpdateSystem(ctx);
 		//RunAnimationUpdateSystem(ctx);
 		RunTransformUpdateSystem(ctx);
 		wiJobSystem::Wait(ctx); // dependencies
 	}
 
+	void Scene::BuildUpdateGraph(wiJobSystem::TaskGraph& graph, uint32_t parts)
+	{
+		// The systems are built into a task graph once, every system starts as soon as the systems it depends on are finished:
+		using Node = wiJobSystem::TaskGraph::Node;
+		// The systems that are not part of this graph are added as empty nodes, so the dependencies are the same in every graph:
+		auto system = [&](void (Scene::*func)(wiJobSystem::context&), uint32_t part) {
+			if ((parts & part) == 0)
+			{
+				return graph.AddNode([](wiJobSystem::context& ctx) {});
+			}
+			return graph.AddNode([this, func](wiJobSystem::context& ctx) { (this->*func)(ctx); });
+		};
+		auto depends = [&](Node node, std::initializer_list<Node> predecessors) {
+			for (Node predecessor : predecessors)
+			{
+				graph.AddDependency(predecessor, node);
+			}
+		};
+
+		const Node animation_lod_system = system(&Scene::RunAnimationLODSystem, UPDATE_SIMULATION);
+		const Node animation_system = system(&Scene::RunAnimationUpdateSystem, UPDATE_SIMULATION);
+		const Node transform_system = system(&Scene::RunTransformUpdateSystem, UPDATE_SIMULATION);
+		const Node hierarchy_system = system(&Scene::RunHierarchyUpdateSystem, UPDATE_SIMULATION);
+		const Node mesh_system = system(&Scene::RunMeshUpdateSystem, UPDATE_SIMULATION);
+		const Node material_system = system(&Scene::RunMaterialUpdateSystem, UPDATE_SIMULATION);
+		const Node weather_system = system(&Scene::RunWeatherUpdateSystem, UPDATE_SIMULATION | UPDATE_PRESENTATION);
+		const Node spring_system = system(&Scene::RunSpringUpdateSystem, UPDATE_SIMULATION);
+		const Node ik_system = system(&Scene::RunInverseKinematicsUpdateSystem, UPDATE_SIMULATION);
+		const Node armature_system = system(&Scene::RunArmatureUpdateSystem, UPDATE_SIMULATION | UPDATE_PRESENTATION);
+		const Node impostor_system = system(&Scene::RunImpostorUpdateSystem, UPDATE_PRESENTATION);
+		const Node object_system = system(&Scene::RunObjectUpdateSystem, UPDATE_PRESENTATION);
+		const Node hlod_system = system(&Scene::RunHLODUpdateSystem, UPDATE_PRESENTATION);
+		const Node camera_system = system(&Scene::RunCameraUpdateSystem, UPDATE_PRESENTATION);
+		const Node decal_system = system(&Scene::RunDecalUpdateSystem, UPDATE_PRESENTATION);
+		const Node probe_system = system(&Scene::RunProbeUpdateSystem, UPDATE_PRESENTATION);
+		const Node force_system = system(&Scene::RunForceUpdateSystem, UPDATE_PRESENTATION);
+		const Node light_system = system(&Scene::RunLightUpdateSystem, UPDATE_PRESENTATION);
+		const Node particle_system = system(&Scene::RunParticleUpdateSystem, UPDATE_SIMULATION);
+		const Node sound_system = system(&Scene::RunSoundUpdateSystem, UPDATE_PRESENTATION);
+
+		// the level of detail decides which armatures are animated, from the previous frame's object state:
+		depends(animation_system, { animation_lod_system });
+
+		// animations write the local transforms:
+		depends(transform_system, { animation_system });
+		depends(hierarchy_system, { transform_system });
+		depends(mesh_system, { transform_system });
+		depends(material_system, { transform_system });
+		depends(spring_system, { hierarchy_system, weather_system });
+		depends(ik_system, { spring_system });
+		depends(armature_system, { ik_system });
+		depends(impostor_system, { transform_system });
+
+		// From here, the world transforms are final (except physics):
+		Node transforms_final = ik_system;
+#ifndef GGREDUCED
+		if (parts & UPDATE_SIMULATION)
+		{
+			const Node physics_system = graph.AddNode([this](wiJobSystem::context& ctx) {
+				wiPhysicsEngine::RunPhysicsUpdateSystem(ctx, *this, this->dt); // this syncs dependencies internally
+			});
+			depends(physics_system, { ik_system });
+			transforms_final = physics_system;
+		}
+#endif
+
+		depends(object_system, { transforms_final, armature_system, mesh_system, material_system, impostor_system });
+		depends(hlod_system, { object_system });
+		depends(camera_system, { transforms_final });
+		depends(decal_system, { transforms_final, material_system });
+		depends(probe_system, { transforms_final });
+		depends(force_system, { transforms_final });
+		depends(light_system, { transforms_final, weather_system });
+		depends(particle_system, { transforms_final, armature_system, mesh_system });
+		depends(sound_system, { transforms_final });
+	}
+
 	void Scene::Update(float dt)
 	{
 		this->dt = dt;
 
+		ApplyDeferred();
+
+		// The names that were modified directly and reported with MarkChanged() are also indexed once per frame, if the name lookup is used:
+		if (name_lookup_structure != ~0ull)
+		{
+			name_lookup_locker.lock();
+			UpdateNameLookup(true);
+			name_lookup_locker.unlock();
+		}
+
+		// Objects that reached the target sample count stop baking, their lightmaps are denoised and kept on the CPU:
+		if (lightmap_bake_finished.exchange(false))
+		{
+			const uint32_t target = wiRenderer::GetLightmapBakeTargetSamples();
+			for (size_t i = 0; i < objects.GetCount(); ++i)
+			{
+				ObjectComponent& object = objects[i];
+				if (target > 0 && object.IsLightmapRenderRequested() && object.lightmapIterationCount >= target)
+				{
+					object.SetLightmapRenderRequest(false);
+					object.SaveLightmap();
+				}
+			}
+		}
+
 		GraphicsDevice* device = wiRenderer::GetDevice();
 
 		if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_PIPELINE) || device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
 		{
-			TLAS_instances.resize(objects.GetCount() * device->GetTopLevelAccelerationStructureInstanceSize());
+			const size_t size = objects.GetCount() * device->GetTopLevelAccelerationStructureInstanceSize();
+			if (TLAS_instances.size() != size)
+			{
+				TLAS_instances.resize(size);
+				TLAS_instances_changed.store(true);
+			}
 		}
 
-		// Occlusion culling read:
-		if(!wiRenderer::GetFreezeCullingCameraEnabled())
+		// Occlusion culling read (the Hi-Z mode updates the history in wiRenderer::UpdatePerFrameData() instead):
+		if(!wiRenderer::GetFreezeCullingCameraEnabled() && !wiRenderer::GetOcclusionCullingHiZEnabled())
 		{
 			if (!queryHeap[0].IsValid())
 			{
@@ -1627,7 +2291,7 @@ namespace wiScene
 #ifdef GGREDUCED
 			TerrainChunkOcclusion* pTCO;
 			uint32_t lodstart = GGTerrain::GetChunkLodStart();
-			if (bEnableTerrainChunkCulling)
+			if (bEnableTerrainChunkCulling && !wiRenderer::GetTerrainChunkGPUCullingEnabled())
 			{
 				for (int lod = lodstart; lod < 9; lod++)
 				{
@@ -1687,54 +2351,45 @@ namespace wiScene
 #endif
 		}
 
-		wiJobSystem::context ctx;
-
-		RunPreviousFrameTransformUpdateSystem(ctx);
-
-		RunAnimationUpdateSystem(ctx);
-
-		RunTransformUpdateSystem(ctx);
-
-		wiJobSystem::Wait(ctx); // dependencies
-
-#ifdef MTHREAD_HIERARCHY
-		RunHierarchyUpdateSystem(ctx);
-		RunMeshUpdateSystem(ctx);
-		RunMaterialUpdateSystem(ctx);
-		wiJobSystem::Wait(ctx); // dependencies
-#else
-		RunHierarchyUpdateSystem(ctx);
-#endif
-
-		RunSpringUpdateSystem(ctx);
-		RunInverseKinematicsUpdateSystem(ctx);
-		RunArmatureUpdateSystem(ctx);
-
-#ifndef MTHREAD_HIERARCHY
-		RunMeshUpdateSystem(ctx);
-
-		RunMaterialUpdateSystem(ctx);
-#endif
+		if (update_graph.IsEmpty())
+		{
+			BuildUpdateGraph(update_graph, UPDATE_SIMULATION | UPDATE_PRESENTATION);
+		}
 
-		RunImpostorUpdateSystem(ctx);
-		RunWeatherUpdateSystem(ctx);
+		if (fixed_update.enabled)
+		{
+			if (fixed_update_graph.IsEmpty())
+			{
+				BuildUpdateGraph(fixed_update_graph, UPDATE_SIMULATION);
+				BuildUpdateGraph(interpolation_graph, UPDATE_PRESENTATION);
+			}
 
-#ifndef GGREDUCED
-		wiPhysicsEngine::RunPhysicsUpdateSystem(ctx, *this, dt); // this syncs dependencies internally
-#endif
+			for (uint32_t step = 0; step < fixed_update.steps; ++step)
+			{
+				wiJobSystem::context ctx;
+				ctx.name = "Scene::Update (fixed step)";
+				wiJobSystem::Run(fixed_update_graph, ctx);
+				wiJobSystem::Wait(ctx); // dependencies
+				StoreSimulatedTransforms();
+			}
 
-		wiJobSystem::Wait(ctx); // dependencies
+			// The rendering sees the simulated time of this frame:
+			this->dt = dt * fixed_update.steps;
 
-		RunObjectUpdateSystem(ctx);
-		RunCameraUpdateSystem(ctx);
-		RunDecalUpdateSystem(ctx);
-		RunProbeUpdateSystem(ctx);
-		RunForceUpdateSystem(ctx);
-		RunLightUpdateSystem(ctx);
-		RunParticleUpdateSystem(ctx);
-		RunSoundUpdateSystem(ctx);
+			InterpolateTransforms(fixed_update.alpha);
 
-		wiJobSystem::Wait(ctx); // dependencies
+			wiJobSystem::context ctx;
+			ctx.name = "Scene::Update (interpolation)";
+			wiJobSystem::Run(interpolation_graph, ctx);
+			wiJobSystem::Wait(ctx); // dependencies
+		}
+		else
+		{
+			wiJobSystem::context ctx;
+			ctx.name = "Scene::Update";
+			wiJobSystem::Run(update_graph, ctx);
+			wiJobSystem::Wait(ctx); // dependencies
+		}
 
 		// Merge parallel bounds computation (depends on object update system):
 		bounds = AABB();
@@ -1743,6 +2398,8 @@ namespace wiScene
 			bounds = AABB::Merge(bounds, group_bound);
 		}
 
+		UpdateBVHs();
+
 		if (device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_PIPELINE) || device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_RAYTRACING_INLINE))
 		{
 			// Recreate top level acceleration structure if the object count changed:
@@ -1760,6 +2417,7 @@ namespace wiScene
 				device->SetName(&desc.toplevel.instanceBuffer, "TLAS.instanceBuffer");
 				success = device->CreateRaytracingAccelerationStructure(&desc, &TLAS);
 				assert(success);
+				TLAS_instances_changed.store(true);
 				device->SetName(&TLAS, "TLAS");
 			}
 		}
@@ -1768,16 +2426,65 @@ namespace wiScene
 		{
 			SetAccelerationStructureUpdateRequested(true);
 	}
-		if (lightmap_repack_needed.load())
+		const bool lightmap_insert = lightmap_insert_needed.exchange(false);
+		if (lightmap_insert && !lightmap_repack_needed.load() && lightmap.IsValid() && lightmapAtlasSpace.width > 0)
 		{
-			std::vector<wiRectPacker::bin> bins;
-			if (wiRectPacker::pack(lightmap_rects.data(), (int)lightmap_rect_allocator.load(), 16384, bins))
+			// The new lightmaps are inserted into the free space of the atlas and only they are copied, the others are not moved
+			//	The objects don't report when they are removed or their lightmap is released, so the placed rects that they don't have anymore are given back first:
+			for (auto it = lightmap_placed.begin(); it != lightmap_placed.end();)
 			{
-				assert(bins.size() == 1 && "The regions won't fit into the texture!");
-
-				TextureDesc desc;
-				desc.Width = (uint32_t)bins[0].size.w;
-				desc.Height = (uint32_t)bins[0].size.h;
+				const ObjectComponent* object = objects.GetComponent(it->first);
+				const wiRectPacker::rect_xywh& rect = it->second;
+				if (object == nullptr || object->lightmap_rect.x != rect.x || object->lightmap_rect.y != rect.y || object->lightmap_rect.w != rect.w || object->lightmap_rect.h != rect.h)
+				{
+					lightmapAtlasSpace.remove(rect);
+					it = lightmap_placed.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+			const uint32_t count = lightmap_rect_allocator.load();
+			for (uint32_t i = 0; i < count && !lightmap_repack_needed.load(); ++i)
+			{
+				if (lightmap_rects[i]->x < 0)
+				{
+					if (lightmapAtlasSpace.insert(*lightmap_rects[i]))
+					{
+						lightmap_placed[lightmap_rect_entities[i]] = *lightmap_rects[i];
+						lightmap_copies_pending.push_back(lightmap_rects[i]);
+					}
+					else
+					{
+						lightmap_repack_needed.store(true);
+					}
+				}
+			}
+			if (lightmap_repack_needed.load())
+			{
+				lightmap_copies_pending.clear(); // everything will be copied
+			}
+			else
+			{
+				lightmap_refresh_needed.store(true);
+			}
+		}
+		else if (lightmap_insert)
+		{
+			lightmap_repack_needed.store(true);
+		}
+		if (lightmap_repack_needed.load())
+		{
+			std::vector<wiRectPacker::bin> bins;
+			if (wiRectPacker::pack(lightmap_rects.data(), (int)lightmap_rect_allocator.load(), 16384, bins))
+			{
+				assert(bins.size() == 1 && "The regions won't fit into the texture!");
+
+				// The atlas is rounded up to power of two size like the decal atlas, the extra space is used for incremental insertions:
+				TextureDesc desc;
+				desc.Width = wiMath::GetNextPowerOfTwo((uint32_t)bins[0].size.w);
+				desc.Height = wiMath::GetNextPowerOfTwo((uint32_t)bins[0].size.h);
 				desc.MipLevels = 1;
 				desc.ArraySize = 1;
 				desc.Format = FORMAT_R11G11B10_FLOAT;
@@ -1789,9 +2496,20 @@ namespace wiScene
 
 				device->CreateTexture(&desc, nullptr, &lightmap);
 				device->SetName(&lightmap, "Scene::lightmap");
+
+				lightmapAtlasSpace.reset((int)desc.Width, (int)desc.Height);
+				lightmap_placed.clear();
+				for (uint32_t i = 0; i < lightmap_rect_allocator.load(); ++i)
+				{
+					lightmapAtlasSpace.occupy(*lightmap_rects[i]);
+					lightmap_placed[lightmap_rect_entities[i]] = *lightmap_rects[i];
+				}
+				lightmap_copies_pending.clear(); // everything will be copied
 			}
 			else
 			{
+				lightmapAtlasSpace.reset(0, 0);
+				lightmap_placed.clear();
 				wiBackLog::post("Global Lightmap atlas packing failed!");
 			}
 		}
@@ -1822,9 +2540,10 @@ namespace wiScene
 			{
 				assert(bins.size() == 1 && "The regions won't fit into the texture!");
 
+				// The atlas is rounded up to power of two size, the extra space is used for incremental insertions:
 				TextureDesc desc;
-				desc.Width = (uint32_t)bins[0].size.w;
-				desc.Height = (uint32_t)bins[0].size.h;
+				desc.Width = wiMath::GetNextPowerOfTwo((uint32_t)bins[0].size.w);
+				desc.Height = wiMath::GetNextPowerOfTwo((uint32_t)bins[0].size.h);
 				desc.MipLevels = 0;
 				desc.ArraySize = 1;
 				desc.Format = FORMAT_R8G8B8A8_UNORM;
@@ -1843,6 +2562,13 @@ namespace wiScene
 					subresource_index = device->CreateSubresource(&decalAtlas, UAV, 0, 1, i, 1);
 					assert(subresource_index == i);
 				}
+
+				decalAtlasSpace.reset((int)desc.Width, (int)desc.Height);
+				for (auto& it : packedDecals)
+				{
+					decalAtlasSpace.occupy(it.second);
+				}
+				decal_copies_pending.clear(); // everything will be copied
 			}
 			else
 			{
@@ -1868,6 +2594,37 @@ namespace wiScene
 	}
 	void Scene::Clear()
 	{
+		// Give back every entity of the scene to be recycled (entities found in multiple managers are only destroyed once):
+		auto destroy_entities = [](const auto& manager) {
+			for (size_t i = 0; i < manager.GetCount(); ++i)
+			{
+				DestroyEntity(manager.GetEntity(i));
+			}
+		};
+		destroy_entities(names);
+		destroy_entities(layers);
+		destroy_entities(transforms);
+		destroy_entities(hierarchy);
+		destroy_entities(materials);
+		destroy_entities(meshes);
+		destroy_entities(objects);
+		destroy_entities(rigidbodies);
+		destroy_entities(armatures);
+		destroy_entities(lights);
+		destroy_entities(cameras);
+		destroy_entities(probes);
+		destroy_entities(forces);
+		destroy_entities(decals);
+		destroy_entities(animations);
+		destroy_entities(animation_datas);
+		destroy_entities(emitters);
+		destroy_entities(hairs);
+		destroy_entities(weathers);
+		destroy_entities(sounds);
+		destroy_entities(inverse_kinematics);
+		destroy_entities(springs);
+		destroy_entities(hlods);
+
 		names.Clear();
 		layers.Clear();
 		transforms.Clear();
@@ -1876,6 +2633,7 @@ namespace wiScene
 		materials.Clear();
 		meshes.Clear();
 		impostors.Clear();
+		hlods.Clear();
 		objects.Clear();
 		aabb_objects.Clear();
 		rigidbodies.Clear();
@@ -1900,10 +2658,103 @@ namespace wiScene
 		inverse_kinematics.Clear();
 		springs.Clear();
 
+		name_lookup.clear();
+		name_lookup_sorted.clear();
+		name_lookup_sorted_valid = false;
+		name_lookup_structure = ~0ull;
+
 		TLAS = RaytracingAccelerationStructure();
 		BVH.Clear();
 		packedDecals.clear();
+		decalAtlasSpace.reset(0, 0);
+		lightmapAtlasSpace.reset(0, 0);
+		lightmap_placed.clear();
+		lightmap_copies_pending.clear();
+		decal_copies_pending.clear();
 		waterRipples.clear();
+
+		// Don't keep the high-water mark of the previous contents:
+		Compact();
+		parallel_bounds.shrink_to_fit();
+		lightmap_rects.shrink_to_fit();
+		lightmap_rect_entities.shrink_to_fit();
+		object_bvh = wiBVH();
+		light_bvh = wiBVH();
+		decal_bvh = wiBVH();
+		probe_bvh = wiBVH();
+		TLAS_instances.shrink_to_fit();
+	}
+	void Scene::Compact()
+	{
+		names.Compact();
+		layers.Compact();
+		transforms.Compact();
+		prev_transforms.Compact();
+		hierarchy.Compact();
+		materials.Compact();
+		meshes.Compact();
+		impostors.Compact();
+		hlods.Compact();
+		objects.Compact();
+		aabb_objects.Compact();
+		rigidbodies.Compact();
+#ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
+		softbodies.Compact();
+#endif
+		armatures.Compact();
+		lights.Compact();
+		aabb_lights.Compact();
+		cameras.Compact();
+		probes.Compact();
+		aabb_probes.Compact();
+		forces.Compact();
+		decals.Compact();
+		aabb_decals.Compact();
+		animations.Compact();
+		animation_datas.Compact();
+		emitters.Compact();
+		hairs.Compact();
+		weathers.Compact();
+		sounds.Compact();
+		inverse_kinematics.Compact();
+		springs.Compact();
+	}
+	wiECS::MemoryUsage Scene::GetMemoryUsage() const
+	{
+		wiECS::MemoryUsage usage;
+		usage += names.GetMemoryUsage();
+		usage += layers.GetMemoryUsage();
+		usage += transforms.GetMemoryUsage();
+		usage += prev_transforms.GetMemoryUsage();
+		usage += hierarchy.GetMemoryUsage();
+		usage += materials.GetMemoryUsage();
+		usage += meshes.GetMemoryUsage();
+		usage += impostors.GetMemoryUsage();
+		usage += hlods.GetMemoryUsage();
+		usage += objects.GetMemoryUsage();
+		usage += aabb_objects.GetMemoryUsage();
+		usage += rigidbodies.GetMemoryUsage();
+#ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
+		usage += softbodies.GetMemoryUsage();
+#endif
+		usage += armatures.GetMemoryUsage();
+		usage += lights.GetMemoryUsage();
+		usage += aabb_lights.GetMemoryUsage();
+		usage += cameras.GetMemoryUsage();
+		usage += probes.GetMemoryUsage();
+		usage += aabb_probes.GetMemoryUsage();
+		usage += forces.GetMemoryUsage();
+		usage += decals.GetMemoryUsage();
+		usage += aabb_decals.GetMemoryUsage();
+		usage += animations.GetMemoryUsage();
+		usage += animation_datas.GetMemoryUsage();
+		usage += emitters.GetMemoryUsage();
+		usage += hairs.GetMemoryUsage();
+		usage += weathers.GetMemoryUsage();
+		usage += sounds.GetMemoryUsage();
+		usage += inverse_kinematics.GetMemoryUsage();
+		usage += springs.GetMemoryUsage();
+		return usage;
 	}
 	void Scene::Merge(Scene& other)
 	{
@@ -1915,6 +2766,7 @@ namespace wiScene
 		materials.Merge(other.materials);
 		meshes.Merge(other.meshes);
 		impostors.Merge(other.impostors);
+		hlods.Merge(other.hlods);
 		objects.Merge(other.objects);
 		aabb_objects.Merge(other.aabb_objects);
 		rigidbodies.Merge(other.rigidbodies);
@@ -1941,6 +2793,318 @@ namespace wiScene
 
 		bounds = AABB::Merge(bounds, other.bounds);
 	}
+	bool Scene::MergeIncremental(Scene& other, size_t max_entities, float max_milliseconds)
+	{
+		if (other.merge_progress == 0 && other.merge_order.empty())
+		{
+			// Every entity is merged once, so the order is made of the entities of all managers without duplicates:
+			std::unordered_set<Entity> unique;
+			auto collect = [&](const auto& manager) {
+				for (size_t i = 0; i < manager.GetCount(); ++i)
+				{
+					Entity entity = manager.GetEntity(i);
+					if (unique.insert(entity).second)
+					{
+						other.merge_order.push_back(entity);
+					}
+				}
+			};
+			collect(other.names);
+			collect(other.layers);
+			collect(other.transforms);
+			collect(other.hierarchy);
+			collect(other.materials);
+			collect(other.meshes);
+			collect(other.objects);
+			collect(other.rigidbodies);
+#ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
+			collect(other.softbodies);
+#endif
+			collect(other.armatures);
+			collect(other.lights);
+			collect(other.cameras);
+			collect(other.probes);
+			collect(other.forces);
+			collect(other.decals);
+			collect(other.animations);
+			collect(other.animation_datas);
+			collect(other.emitters);
+			collect(other.hairs);
+			collect(other.weathers);
+			collect(other.sounds);
+			collect(other.inverse_kinematics);
+			collect(other.springs);
+			collect(other.hlods);
+
+			// The armature update needs the bones, the objects need the meshes and armatures, and the hierarchy update is faster if the parents are there:
+			auto rank = [&](Entity entity) {
+				uint32_t depth = 0;
+				const HierarchyComponent* parent = other.hierarchy.GetComponent(entity);
+				while (parent != nullptr && depth < 0xFF)
+				{
+					depth++;
+					parent = other.hierarchy.GetComponent(parent->parentID);
+				}
+				const bool rendered = other.objects.Contains(entity) || other.lights.Contains(entity) || other.decals.Contains(entity) ||
+					other.probes.Contains(entity) || other.emitters.Contains(entity) || other.hairs.Contains(entity) ||
+					other.forces.Contains(entity) || other.cameras.Contains(entity) || other.sounds.Contains(entity) ||
+					other.weathers.Contains(entity) || other.animations.Contains(entity);
+				uint32_t group = 4;
+				if (other.armatures.Contains(entity))
+				{
+					group = 2;
+				}
+				else if (other.meshes.Contains(entity))
+				{
+					group = 3;
+				}
+				else if (!rendered)
+				{
+					group = other.transforms.Contains(entity) ? 1 : 0;
+				}
+				return (group << 8) | depth;
+			};
+			std::vector<std::pair<uint32_t, Entity>> ranked;
+			ranked.reserve(other.merge_order.size());
+			for (Entity entity : other.merge_order)
+			{
+				ranked.push_back(std::make_pair(rank(entity), entity));
+			}
+			std::stable_sort(ranked.begin(), ranked.end(), [](const std::pair<uint32_t, Entity>& a, const std::pair<uint32_t, Entity>& b) {
+				return a.first < b.first;
+			});
+			for (size_t i = 0; i < ranked.size(); ++i)
+			{
+				other.merge_order[i] = ranked[i].second;
+			}
+		}
+
+		wiTimer timer;
+		static constexpr size_t batch_size = 64; // the time is checked after every batch
+		size_t remaining = max_entities;
+		while (other.merge_progress < other.merge_order.size() && remaining > 0)
+		{
+			const Entity* batch = other.merge_order.data() + other.merge_progress;
+			const size_t count = std::min(std::min(remaining, batch_size), other.merge_order.size() - other.merge_progress);
+
+			// The managers that are parallel arrays (objects and aabb_objects, etc.) receive the same entities in the same order, so they stay aligned:
+			names.MergeMany(other.names, batch, count);
+			layers.MergeMany(other.layers, batch, count);
+			transforms.MergeMany(other.transforms, batch, count);
+			prev_transforms.MergeMany(other.prev_transforms, batch, count);
+			hierarchy.MergeMany(other.hierarchy, batch, count);
+			materials.MergeMany(other.materials, batch, count);
+			meshes.MergeMany(other.meshes, batch, count);
+			impostors.MergeMany(other.impostors, batch, count);
+			hlods.MergeMany(other.hlods, batch, count);
+			objects.MergeMany(other.objects, batch, count);
+			aabb_objects.MergeMany(other.aabb_objects, batch, count);
+			rigidbodies.MergeMany(other.rigidbodies, batch, count);
+#ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
+			softbodies.MergeMany(other.softbodies, batch, count);
+#endif
+			armatures.MergeMany(other.armatures, batch, count);
+			lights.MergeMany(other.lights, batch, count);
+			aabb_lights.MergeMany(other.aabb_lights, batch, count);
+			cameras.MergeMany(other.cameras, batch, count);
+			probes.MergeMany(other.probes, batch, count);
+			aabb_probes.MergeMany(other.aabb_probes, batch, count);
+			forces.MergeMany(other.forces, batch, count);
+			decals.MergeMany(other.decals, batch, count);
+			aabb_decals.MergeMany(other.aabb_decals, batch, count);
+			animations.MergeMany(other.animations, batch, count);
+			animation_datas.MergeMany(other.animation_datas, batch, count);
+			emitters.MergeMany(other.emitters, batch, count);
+			hairs.MergeMany(other.hairs, batch, count);
+			weathers.MergeMany(other.weathers, batch, count);
+			sounds.MergeMany(other.sounds, batch, count);
+			inverse_kinematics.MergeMany(other.inverse_kinematics, batch, count);
+			springs.MergeMany(other.springs, batch, count);
+
+			other.merge_progress += count;
+			remaining -= count;
+			if (max_milliseconds > 0 && timer.elapsed_milliseconds() >= max_milliseconds)
+			{
+				break;
+			}
+		}
+
+		if (other.merge_progress < other.merge_order.size())
+		{
+			return false;
+		}
+
+		// The entities belong to this scene now, so the other's managers are cleared without destroying them (what Scene::Clear() would do):
+		other.names.Clear();
+		other.layers.Clear();
+		other.transforms.Clear();
+		other.prev_transforms.Clear();
+		other.hierarchy.Clear();
+		other.materials.Clear();
+		other.meshes.Clear();
+		other.impostors.Clear();
+		other.hlods.Clear();
+		other.objects.Clear();
+		other.aabb_objects.Clear();
+		other.rigidbodies.Clear();
+#ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
+		other.softbodies.Clear();
+#endif
+		other.armatures.Clear();
+		other.lights.Clear();
+		other.aabb_lights.Clear();
+		other.cameras.Clear();
+		other.probes.Clear();
+		other.aabb_probes.Clear();
+		other.forces.Clear();
+		other.decals.Clear();
+		other.aabb_decals.Clear();
+		other.animations.Clear();
+		other.animation_datas.Clear();
+		other.emitters.Clear();
+		other.hairs.Clear();
+		other.weathers.Clear();
+		other.sounds.Clear();
+		other.inverse_kinematics.Clear();
+		other.springs.Clear();
+		other.merge_order.clear();
+		other.merge_order.shrink_to_fit();
+		other.merge_progress = 0;
+
+		bounds = AABB::Merge(bounds, other.bounds);
+		return true;
+	}
+	const wiBVH* Scene::GetBVH(const ComponentManager<AABB>& aabbs) const
+	{
+		const wiBVH* bvh = nullptr;
+		uint64_t version = ~0ull;
+		if (&aabbs == &aabb_objects)
+		{
+			bvh = &object_bvh;
+			version = object_bvh_version;
+		}
+		else if (&aabbs == &aabb_lights)
+		{
+			bvh = &light_bvh;
+			version = light_bvh_version;
+		}
+		else if (&aabbs == &aabb_decals)
+		{
+			bvh = &decal_bvh;
+			version = decal_bvh_version;
+		}
+		else if (&aabbs == &aabb_probes)
+		{
+			bvh = &probe_bvh;
+			version = probe_bvh_version;
+		}
+		if (bvh == nullptr || version != aabbs.GetStructureVersion() || bvh->GetItemCount() != (uint32_t)aabbs.GetCount())
+		{
+			return nullptr;
+		}
+		return bvh;
+	}
+	void Scene::UpdateFixed(float step_dt, uint32_t steps, float alpha)
+	{
+		fixed_update.enabled = true;
+		fixed_update.steps = steps;
+		fixed_update.alpha = wiMath::Clamp(alpha, 0, 1);
+		Update(step_dt);
+		fixed_update.enabled = false;
+	}
+	void Scene::StoreSimulatedTransforms()
+	{
+		const size_t count = transforms.GetCount();
+		if (interpolation.version != transforms.GetStructureVersion() || interpolation.current.size() != count)
+		{
+			// Transforms were added or removed, the interpolation restarts from the current state:
+			interpolation.current.resize(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				interpolation.current[i] = transforms[i].world;
+			}
+			interpolation.previous = interpolation.current;
+			interpolation.version = transforms.GetStructureVersion();
+			return;
+		}
+		interpolation.previous.swap(interpolation.current);
+		for (size_t i = 0; i < count; ++i)
+		{
+			interpolation.current[i] = transforms[i].world;
+		}
+	}
+	void Scene::InterpolateTransforms(float alpha)
+	{
+		if (interpolation.version != transforms.GetStructureVersion() || interpolation.current.size() != transforms.GetCount())
+		{
+			StoreSimulatedTransforms();
+		}
+		const uint32_t count = (uint32_t)transforms.GetCount();
+
+		// The previous frame matrices (for the motion vectors) are kept by the objects from the last object update, so they are the rendered ones, not the previous step:
+		wiJobSystem::context ctx;
+		static wiJobSystem::GrainSize grain_interpolate;
+		wiJobSystem::ParallelFor(ctx, count, grain_interpolate, [&](uint32_t index) {
+			const XMFLOAT4X4& previous = interpolation.previous[index];
+			const XMFLOAT4X4& current = interpolation.current[index];
+			XMFLOAT4X4& world = transforms[index].world;
+			if (alpha >= 1 || std::memcmp(&previous, &current, sizeof(XMFLOAT4X4)) == 0)
+			{
+				world = current;
+			}
+			else
+			{
+				XMVECTOR S0, R0, T0, S1, R1, T1;
+				if (XMMatrixDecompose(&S0, &R0, &T0, XMLoadFloat4x4(&previous)) && XMMatrixDecompose(&S1, &R1, &T1, XMLoadFloat4x4(&current)))
+				{
+					const XMVECTOR S = XMVectorLerp(S0, S1, alpha);
+					const XMVECTOR R = XMQuaternionSlerp(R0, R1, alpha);
+					const XMVECTOR T = XMVectorLerp(T0, T1, alpha);
+					XMStoreFloat4x4(&world, XMMatrixScalingFromVector(S) * XMMatrixRotationQuaternion(R) * XMMatrixTranslationFromVector(T));
+				}
+				else
+				{
+					world = current; // degenerate matrix (eg. zero scale)
+				}
+			}
+		});
+		wiJobSystem::Wait(ctx);
+	}
+
+	void Scene::UpdateBVHs()
+	{
+		// The trees are only rebuilt when components were added or removed, or the moving boxes degraded them, otherwise the bounds are refitted:
+		//	moved is false if it is known that none of the boxes changed since the last update, then even the refit is skipped
+		auto update = [](wiBVH& bvh, uint64_t& version, const ComponentManager<AABB>& aabbs, bool moved) {
+			const uint32_t count = (uint32_t)aabbs.GetCount();
+			if (count == 0)
+			{
+				bvh.Clear();
+			}
+			else if (version != aabbs.GetStructureVersion() || bvh.GetItemCount() != count)
+			{
+				bvh.Build(&aabbs[0], count);
+			}
+			else if (moved && !bvh.Refit(&aabbs[0]))
+			{
+				bvh.Build(&aabbs[0], count);
+			}
+			version = aabbs.GetStructureVersion();
+		};
+
+		// Object boxes are reported as changed by RunObjectUpdateSystem when they are recomputed:
+		bool objects_moved = false;
+		const uint64_t object_changes = aabb_objects.AdvanceVersion();
+		aabb_objects.ForEachChanged(object_bvh_changes, [&](size_t index) { objects_moved = true; });
+		object_bvh_changes = object_changes;
+
+		wiJobSystem::context ctx;
+		wiJobSystem::Execute(ctx, [&](wiJobArgs args) { update(object_bvh, object_bvh_version, aabb_objects, objects_moved); });
+		wiJobSystem::Execute(ctx, [&](wiJobArgs args) { update(light_bvh, light_bvh_version, aabb_lights, true); });
+		wiJobSystem::Execute(ctx, [&](wiJobArgs args) { update(decal_bvh, decal_bvh_version, aabb_decals, true); });
+		wiJobSystem::Execute(ctx, [&](wiJobArgs args) { update(probe_bvh, probe_bvh_version, aabb_probes, true); });
+		wiJobSystem::Wait(ctx);
+	}
 
 	void Scene::Entity_Remove(Entity entity)
 	{
@@ -1953,6 +3117,7 @@ namespace wiScene
 		materials.Remove(entity);
 		meshes.Remove(entity);
 		impostors.Remove(entity);
+		hlods.Remove(entity);
 		objects.Remove(entity);
 		aabb_objects.Remove(entity);
 		rigidbodies.Remove(entity);
@@ -1976,77 +3141,506 @@ namespace wiScene
 		sounds.Remove(entity);
 		inverse_kinematics.Remove(entity);
 		springs.Remove(entity);
+
+		DestroyEntity(entity); // the index can be recycled once the entity is not referenced by the scene anymore
 	}
-	Entity Scene::Entity_FindByName(const std::string& name)
+	void Scene::Entity_RemoveMany(const Entity* entities, size_t count)
 	{
-		for (size_t i = 0; i < names.GetCount(); ++i)
+		if (count == 0)
+		{
+			return;
+		}
+
+		// Same as Component_Detach(), but the hierarchy is compacted only once below:
+		for (size_t i = 0; i < count; ++i)
 		{
-			if (names[i] == name)
+			if (hierarchy.Contains(entities[i]))
 			{
-				return names.GetEntity(i);
+				TransformComponent* transform = transforms.GetComponent(entities[i]);
+				if (transform != nullptr)
+				{
+					transform->ApplyTransform();
+				}
+
+				LayerComponent* layer = layers.GetComponent(entities[i]);
+				if (layer != nullptr)
+				{
+					layer->propagationMask = ~0;
+				}
 			}
 		}
-		return INVALID_ENTITY;
+		hierarchy.RemoveMany(entities, count);
+
+		names.RemoveMany(entities, count);
+		layers.RemoveMany(entities, count);
+		transforms.RemoveMany(entities, count);
+		prev_transforms.RemoveMany(entities, count);
+		materials.RemoveMany(entities, count);
+		meshes.RemoveMany(entities, count);
+		impostors.RemoveMany(entities, count);
+		hlods.RemoveMany(entities, count);
+		objects.RemoveMany(entities, count);
+		aabb_objects.RemoveMany(entities, count);
+		rigidbodies.RemoveMany(entities, count);
+#ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
+		softbodies.RemoveMany(entities, count);
+#endif
+		armatures.RemoveMany(entities, count);
+		lights.RemoveMany(entities, count);
+		aabb_lights.RemoveMany(entities, count);
+		cameras.RemoveMany(entities, count);
+		probes.RemoveMany(entities, count);
+		aabb_probes.RemoveMany(entities, count);
+		forces.RemoveMany(entities, count);
+		decals.RemoveMany(entities, count);
+		aabb_decals.RemoveMany(entities, count);
+		animations.RemoveMany(entities, count);
+		animation_datas.RemoveMany(entities, count);
+		emitters.RemoveMany(entities, count);
+		hairs.RemoveMany(entities, count);
+		weathers.RemoveMany(entities, count);
+		sounds.RemoveMany(entities, count);
+		inverse_kinematics.RemoveMany(entities, count);
+		springs.RemoveMany(entities, count);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			DestroyEntity(entities[i]);
+		}
 	}
-	Entity Scene::Entity_Duplicate(Entity entity)
+	void Scene::Entity_RemoveDeferred(Entity entity)
 	{
-		wiArchive archive;
+		deferred_locker.lock();
+		deferred_removes.push_back(entity);
+		deferred_locker.unlock();
+	}
+	void Scene::AddDeferredCommand(std::function<void(Scene&)> command)
+	{
+		deferred_locker.lock();
+		deferred_commands.push_back(std::move(command));
+		deferred_locker.unlock();
+	}
+	void Scene::ApplyDeferred()
+	{
+		deferred_locker.lock();
+		std::vector<Entity> removes = std::move(deferred_removes);
+		std::vector<std::function<void(Scene&)>> commands = std::move(deferred_commands);
+		deferred_removes.clear();
+		deferred_commands.clear();
+		deferred_locker.unlock();
 
-		// First write the root entity to staging area:
-		archive.SetReadModeAndResetPos(false);
-		Entity_Serialize(archive, entity);
+		Entity_RemoveMany(removes.data(), removes.size());
 
-		// Then deserialize root:
-		archive.SetReadModeAndResetPos(true);
-		Entity root = Entity_Serialize(archive);
+		for (auto& command : commands)
+		{
+			command(*this);
+		}
+	}
+	void Scene::CheckpointLightmaps()
+	{
+		for (size_t i = 0; i < objects.GetCount(); ++i)
+		{
+			ObjectComponent& object = objects[i];
+			if (object.IsLightmapRenderRequested() && object.lightmap.IsValid() && object.lightmapIterationCount > 0)
+			{
+				bool success = wiHelper::saveTextureToMemory(object.lightmap, object.lightmapTextureData);
+				assert(success);
+			}
+		}
+	}
+	uint64_t Scene::ComputeLightmapBakeSignature(const ObjectComponent& object) const
+	{
+		size_t hash = 0;
+		auto combine = [&](const void* data, size_t size) {
+			const uint32_t* words = (const uint32_t*)data;
+			for (size_t i = 0; i < size / sizeof(uint32_t); ++i)
+			{
+				wiHelper::hash_combine(hash, words[i]);
+			}
+		};
 
-		return root;
+		if (object.transform_index >= 0 && object.transform_index < (int)transforms.GetCount())
+		{
+			combine(&transforms[object.transform_index].world, sizeof(XMFLOAT4X4));
+		}
+		const MeshComponent* mesh = meshes.GetComponent(object.meshID);
+		if (mesh != nullptr)
+		{
+			combine(mesh->vertex_positions.data(), mesh->vertex_positions.size() * sizeof(XMFLOAT3));
+			combine(mesh->vertex_atlas.data(), mesh->vertex_atlas.size() * sizeof(XMFLOAT2));
+			combine(mesh->cooked.atlas.data(), mesh->cooked.atlas.size() * sizeof(uint32_t));
+			combine(mesh->indices.data(), mesh->indices.size() * sizeof(uint32_t));
+		}
+		return (uint64_t)hash;
 	}
-	Entity Scene::Entity_CreateMaterial(
-		const std::string& name
-	)
+	uint32_t Scene::RequestLightmapBake(bool only_changed)
 	{
-		Entity entity = CreateEntity();
+		uint32_t count = 0;
+		for (size_t i = 0; i < objects.GetCount(); ++i)
+		{
+			ObjectComponent& object = objects[i];
+			if (object.lightmapWidth == 0 || object.lightmapHeight == 0)
+				continue;
+			const MeshComponent* mesh = meshes.GetComponent(object.meshID);
+			if (mesh == nullptr || (mesh->vertex_atlas.empty() && mesh->cooked.atlas.empty()))
+				continue;
+			if (only_changed && !object.IsLightmapRenderRequested() && object.lightmapBakeSignature == ComputeLightmapBakeSignature(object))
+				continue;
 
-		names.Create(entity) = name;
+			const uint32_t width = object.lightmapWidth;
+			const uint32_t height = object.lightmapHeight;
+			object.ClearLightmap();
+			object.lightmapWidth = width;
+			object.lightmapHeight = height;
+			object.SetLightmapRenderRequest(true);
+			count++;
+		}
+		if (count > 0)
+		{
+			SetAccelerationStructureUpdateRequested(true);
+		}
+		return count;
+	}
+	void Scene::UpdateNameLookup(bool changes)
+	{
+		// The queries also refresh for the reported changes, so that a rename is found in the same frame:
+		if (!changes && names.GetStructureVersion() == name_lookup_structure && !names.IsAnyChanged(name_lookup_version))
+		{
+			return;
+		}
 
-		materials.Create(entity);
+		if (name_lookup_structure == ~0ull || name_lookup.size() > names.GetCount() * 2 + 1024)
+		{
+			// Full rebuild, this also purges the entries of the removed and renamed entities:
+			name_lookup.clear();
+			name_lookup.reserve(names.GetCount());
+			for (size_t i = 0; i < names.GetCount(); ++i)
+			{
+				name_lookup.emplace(names[i].name, names.GetEntity(i));
+			}
+		}
+		else
+		{
+			// The created, moved (by removals) and reported names are added, unless the entity is already indexed by its current name:
+			names.ForEachChanged(name_lookup_version, [&](size_t index) {
+				const std::string& name = names[index].name;
+				const Entity entity = names.GetEntity(index);
+				auto range = name_lookup.equal_range(name);
+				for (auto it = range.first; it != range.second; ++it)
+				{
+					if (it->second == entity)
+					{
+						return;
+					}
+				}
+				name_lookup.emplace(name, entity);
+			});
+		}
+		name_lookup_version = names.AdvanceVersion();
+		name_lookup_structure = names.GetStructureVersion();
+		name_lookup_sorted_valid = false;
+	}
+	Entity Scene::Entity_FindByName(const std::string& name)
+	{
+		name_lookup_locker.lock();
+		UpdateNameLookup(false);
+
+		// Of the entities with the same name the one with the first component is returned, like the linear search did:
+		Entity entity = INVALID_ENTITY;
+		size_t first = ~0ull;
+		auto range = name_lookup.equal_range(name);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			const size_t index = names.GetIndex(it->second);
+			if (index < first && names[index] == name)
+			{
+				entity = it->second;
+				first = index;
+			}
+		}
 
+		name_lookup_locker.unlock();
 		return entity;
 	}
-	Entity Scene::Entity_CreateObject(
-		const std::string& name
-	)
+	void Scene::Entity_FindAllByName(const std::string& name, std::vector<Entity>& entities)
 	{
-		Entity entity = CreateEntity();
-
-		names.Create(entity) = name;
-
-		layers.Create(entity);
-
-		transforms.Create(entity);
-
-		prev_transforms.Create(entity);
-
-		aabb_objects.Create(entity);
+		name_lookup_locker.lock();
+		UpdateNameLookup(false);
 
-		objects.Create(entity);
+		auto range = name_lookup.equal_range(name);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			const NameComponent* component = names.GetComponent(it->second);
+			if (component != nullptr && *component == name)
+			{
+				entities.push_back(it->second);
+			}
+		}
 
-		return entity;
+		name_lookup_locker.unlock();
 	}
-	Entity Scene::Entity_CreateMesh(
-		const std::string& name
-	)
+	void Scene::Entity_FindAllByPrefix(const std::string& prefix, std::vector<Entity>& entities)
 	{
-		Entity entity = CreateEntity();
+		name_lookup_locker.lock();
+		UpdateNameLookup(false);
 
-		names.Create(entity) = name;
+		if (!name_lookup_sorted_valid)
+		{
+			name_lookup_sorted.clear();
+			name_lookup_sorted.reserve(name_lookup.size());
+			for (auto& entry : name_lookup)
+			{
+				name_lookup_sorted.push_back(&entry);
+			}
+			std::sort(name_lookup_sorted.begin(), name_lookup_sorted.end(), [](const auto* a, const auto* b) {
+				return a->first < b->first;
+			});
+			name_lookup_sorted_valid = true;
+		}
 
-		meshes.Create(entity);
+		auto it = std::lower_bound(name_lookup_sorted.begin(), name_lookup_sorted.end(), prefix, [](const auto* entry, const std::string& value) {
+			return entry->first < value;
+		});
+		for (; it != name_lookup_sorted.end() && (*it)->first.compare(0, prefix.size(), prefix) == 0; ++it)
+		{
+			const NameComponent* component = names.GetComponent((*it)->second);
+			if (component != nullptr && *component == (*it)->first)
+			{
+				entities.push_back((*it)->second);
+			}
+		}
 
-		return entity;
+		name_lookup_locker.unlock();
 	}
-	Entity Scene::Entity_CreateLight(
+	void Scene::Entity_SetName(Entity entity, const std::string& name)
+	{
+		name_lookup_locker.lock();
+
+		NameComponent* component = names.GetComponent(entity);
+		if (component == nullptr)
+		{
+			component = &names.Create(entity);
+		}
+		else
+		{
+			auto range = name_lookup.equal_range(component->name);
+			for (auto it = range.first; it != range.second; ++it)
+			{
+				if (it->second == entity)
+				{
+					name_lookup.erase(it);
+					break;
+				}
+			}
+		}
+		*component = name;
+		names.MarkChanged(entity);
+		if (name_lookup_structure != ~0ull)
+		{
+			name_lookup.emplace(name, entity);
+		}
+		name_lookup_sorted_valid = false;
+
+		name_lookup_locker.unlock();
+	}
+	Entity Scene::Entity_Duplicate(Entity entity)
+	{
+		Entity root = INVALID_ENTITY;
+		Entity_DuplicateMany(entity, &root, 1);
+		return root;
+	}
+	void Scene::Entity_DuplicateMany(Entity entity, Entity* duplicates, size_t count)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		// Gather the entity and all of its descendants, parents always before their children:
+		std::vector<Entity> sources;
+		sources.push_back(entity);
+		{
+			std::unordered_map<Entity, std::vector<Entity>> children;
+			for (size_t i = 0; i < hierarchy.GetCount(); ++i)
+			{
+				children[hierarchy[i].parentID].push_back(hierarchy.GetEntity(i));
+			}
+			for (size_t i = 0; i < sources.size(); ++i)
+			{
+				auto it = children.find(sources[i]);
+				if (it != children.end())
+				{
+					sources.insert(sources.end(), it->second.begin(), it->second.end());
+				}
+			}
+		}
+
+		// New entities: clones[source * count + duplicate]
+		std::vector<Entity> clones(sources.size() * count);
+		std::unordered_map<Entity, size_t> source_indices;
+		for (size_t i = 0; i < sources.size(); ++i)
+		{
+			source_indices[sources[i]] = i;
+			for (size_t j = 0; j < count; ++j)
+			{
+				clones[i * count + j] = CreateEntity();
+			}
+		}
+
+		// Plain copy for components that don't own unique runtime resources, the reset function can fix up the copies:
+		auto copy = [&](auto& manager, auto reset) {
+			for (size_t i = 0; i < sources.size(); ++i)
+			{
+				const size_t source_index = manager.GetIndex(sources[i]);
+				if (source_index == wiECS::EntityLookup::INVALID_INDEX)
+				{
+					continue;
+				}
+				const size_t first = manager.CreateMany(&clones[i * count], count);
+				for (size_t j = 0; j < count; ++j)
+				{
+					manager[first + j] = manager[source_index];
+					reset(manager[first + j], j);
+				}
+			}
+		};
+		auto no_reset = [](auto&, size_t) {};
+
+		// Serialization round-trip for components that create their resources while they are read:
+		auto serialize = [&](auto& manager) {
+			for (size_t i = 0; i < sources.size(); ++i)
+			{
+				auto* source = manager.GetComponent(sources[i]);
+				if (source == nullptr)
+				{
+					continue;
+				}
+				EntitySerializer seri;
+				seri.allow_remap = false;
+				wiArchive archive;
+				source->Serialize(archive, seri);
+				for (size_t j = 0; j < count; ++j)
+				{
+					archive.SetReadModeAndResetPos(true);
+					manager.Create(clones[i * count + j]).Serialize(archive, seri);
+				}
+			}
+		};
+
+		copy(names, no_reset);
+		copy(layers, no_reset);
+		copy(transforms, [](TransformComponent& transform, size_t) { transform.SetDirty(); });
+		copy(prev_transforms, no_reset);
+		copy(hierarchy, [&](HierarchyComponent& hier, size_t j) {
+			// children inside the duplicated tree are attached to the corresponding duplicate parent:
+			auto it = source_indices.find(hier.parentID);
+			if (it != source_indices.end())
+			{
+				hier.parentID = clones[it->second * count + j];
+			}
+		});
+		copy(materials, [](MaterialComponent& material, size_t) {
+			material.CreateRenderData(); // own constant buffer
+			material.SetDirty();
+		});
+		copy(meshes, [](MeshComponent& mesh, size_t) {
+			// own GPU buffers (skinning streamout can't be shared), but the copied vertex data can keep the triangle BVH:
+			wiBVH bvh = std::move(mesh.bvh);
+			mesh.CreateRenderData();
+			mesh.bvh = std::move(bvh);
+		});
+		copy(impostors, [](ImpostorComponent& impostor, size_t) {
+			impostor.textureIndex = -1; // takes its own atlas slot
+			impostor.ready = false;
+			impostor.SetDirty();
+		});
+		copy(objects, [](ObjectComponent& object, size_t) {
+			object.occlusionHistory = ~0u;
+			for (int& query : object.occlusionQueries)
+			{
+				query = -1;
+			}
+		});
+		copy(aabb_objects, no_reset);
+		copy(rigidbodies, [](RigidBodyPhysicsComponent& rigidbody, size_t) { rigidbody.physicsobject = nullptr; });
+#ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
+		copy(softbodies, [](SoftBodyPhysicsComponent& softbody, size_t) {
+			softbody.physicsobject = nullptr;
+			softbody.clothParticleBuffer = GPUBuffer(); // the GPU simulation state is created again for the copy
+		});
+#endif
+		copy(armatures, [](ArmatureComponent& armature, size_t) { armature.CreateRenderData(); });
+		copy(lights, no_reset);
+		copy(aabb_lights, no_reset);
+		copy(cameras, no_reset);
+		copy(probes, [](EnvironmentProbeComponent& probe, size_t) {
+			probe.textureIndex = -1; // takes its own envmap slot
+			probe.SetDirty();
+		});
+		copy(aabb_probes, no_reset);
+		copy(forces, no_reset);
+		copy(decals, no_reset);
+		copy(aabb_decals, no_reset);
+		copy(animations, no_reset);
+		copy(animation_datas, no_reset);
+		serialize(emitters);
+		serialize(hairs);
+		copy(weathers, no_reset);
+		serialize(sounds);
+		copy(inverse_kinematics, no_reset);
+		copy(springs, no_reset);
+		// hlods are not duplicated, a cell would refer to the children of the source and the copies would be culled together
+
+		for (size_t j = 0; j < count; ++j)
+		{
+			duplicates[j] = clones[j];
+		}
+	}
+	Entity Scene::Entity_CreateMaterial(
+		const std::string& name
+	)
+	{
+		Entity entity = CreateEntity();
+
+		names.Create(entity) = name;
+
+		materials.Create(entity);
+
+		return entity;
+	}
+	Entity Scene::Entity_CreateObject(
+		const std::string& name
+	)
+	{
+		Entity entity = CreateEntity();
+
+		names.Create(entity) = name;
+
+		layers.Create(entity);
+
+		transforms.Create(entity);
+
+		prev_transforms.Create(entity);
+
+		aabb_objects.Create(entity);
+
+		objects.Create(entity);
+
+		return entity;
+	}
+	Entity Scene::Entity_CreateMesh(
+		const std::string& name
+	)
+	{
+		Entity entity = CreateEntity();
+
+		names.Create(entity) = name;
+
+		meshes.Create(entity);
+
+		return entity;
+	}
+	Entity Scene::Entity_CreateLight(
 		const std::string& name,
 		const XMFLOAT3& position,
 		const XMFLOAT3& color,
@@ -2386,24 +3980,113 @@ namespace wiScene
 
 	const uint32_t small_subtask_groupsize = 64;
 
-	void Scene::RunPreviousFrameTransformUpdateSystem(wiJobSystem::context& ctx)
+	void Scene::RunAnimationLODSystem(wiJobSystem::context& ctx)
 	{
-#ifdef GGREDUCED
-#ifdef OPTICK_ENABLE
-		OPTICK_EVENT();
-#endif
-#endif
-		wiJobSystem::Dispatch(ctx, (uint32_t)prev_transforms.GetCount(), small_subtask_groupsize, [&](wiJobArgs args)
+		// The bones are mapped to their armatures, so that animations can find the armature that they drive:
+		if (animation_lod_bones_version != armatures.GetStructureVersion())
 		{
-			PreviousFrameTransformComponent& prev_transform = prev_transforms[args.jobIndex];
-			Entity entity = prev_transforms.GetEntity(args.jobIndex);
-			const TransformComponent& transform = *transforms.GetComponent(entity);
+			animation_lod_bones.clear();
+			for (size_t i = 0; i < armatures.GetCount(); ++i)
+			{
+				for (Entity bone : armatures[i].boneCollection)
+				{
+					animation_lod_bones.set(bone, i);
+				}
+			}
+			animation_lod_bones_version = armatures.GetStructureVersion();
+		}
 
-			prev_transform.world_prev = transform.world;
-		});
+		for (size_t i = 0; i < armatures.GetCount(); ++i)
+		{
+			ArmatureComponent& armature = armatures[i];
+			armature.lod_screen_size = -1; // no skinned object found yet
+			armature.lod_culled = true;
+		}
+
+		// The visibility and bounds of the previous frame are used, the object update system didn't run yet:
+		const CameraComponent& camera = GetCamera();
+		const float tanHalfFov = std::tan(camera.fov * 0.5f);
+		const XMVECTOR eye = camera.GetEye();
+		for (size_t i = 0; i < objects.GetCount(); ++i)
+		{
+			const ObjectComponent& object = objects[i];
+			if (object.mesh_index >= meshes.GetCount() || meshes.GetEntity(object.mesh_index) != object.meshID)
+			{
+				continue;
+			}
+			const MeshComponent& mesh = meshes[object.mesh_index];
+			if (!mesh.IsSkinned())
+			{
+				continue;
+			}
+			const size_t armature_index = armatures.GetIndex(mesh.armatureID);
+			if (armature_index == wiECS::EntityLookup::INVALID_INDEX)
+			{
+				continue;
+			}
+			ArmatureComponent& armature = armatures[armature_index];
+
+			const AABB& aabb = aabb_objects[i];
+			const XMFLOAT3 center = aabb.getCenter();
+			const float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&center) - eye));
+			const float size = aabb.getRadius() / std::max(0.001f, distance * tanHalfFov);
+			armature.lod_screen_size = std::max(armature.lod_screen_size, size);
+			armature.lod_culled &= object.IsCulled();
+		}
+
+		for (size_t i = 0; i < armatures.GetCount(); ++i)
+		{
+			ArmatureComponent& armature = armatures[i];
+			if (!animation_lod.enabled || armature.lod_screen_size < 0)
+			{
+				// Not rendered by any object, or level of detail is disabled:
+				armature.lod_interval = 1;
+				armature.lod_phase = 0;
+				armature.lod_update = true;
+				armature.lod_culled = false;
+				armature.lod_reduced_bones = false;
+				continue;
+			}
+			if (armature.lod_culled)
+			{
+				armature.lod_update = false;
+				continue;
+			}
+
+			uint32_t interval = 1;
+			if (armature.lod_screen_size < animation_lod.full_rate_size)
+			{
+				interval = (uint32_t)std::ceil(animation_lod.full_rate_size / std::max(0.0001f, armature.lod_screen_size));
+				interval = std::max(1u, std::min(animation_lod.max_interval, interval));
+			}
+			armature.lod_interval = interval;
+			armature.lod_reduced_bones = armature.lod_screen_size < animation_lod.bone_reduction_size;
+			armature.lod_phase++;
+			armature.lod_update = armature.lod_phase >= interval;
+			if (armature.lod_update)
+			{
+				armature.lod_phase = 0;
+			}
+		}
 	}
 	void Scene::RunAnimationUpdateSystem(wiJobSystem::context& ctx)
 	{
+		// Scratch memory for the channel evaluation, shared by all animations:
+		struct ChannelSample
+		{
+			XMFLOAT4 value; // sampled translation, rotation or scale
+			uint32_t keyLeft;
+			uint32_t keyRight;
+			float t;
+			bool valid;
+		};
+		std::vector<ChannelSample> samples;
+		std::vector<XMFLOAT4> slerp_a;
+		std::vector<XMFLOAT4> slerp_b;
+		std::vector<float> slerp_t;
+		std::vector<XMFLOAT4> slerp_result;
+		std::vector<uint32_t> slerp_dest;
+
 #ifdef GGREDUCED
 #ifdef OPTICK_ENABLE
 OPTICK_EVENT();
@@ -2486,40 +4169,113 @@ OPTICK_EVENT();
 				}
 
 				animation.updateonce = false;
+#endif
+
+				// Animations of armatures that don't compute their bones in this frame because of level of detail are not sampled:
+				//	The armature index is only trusted while the bindings are up to date
+				const bool bindings_valid = animation.bindings_version == transforms.GetStructureVersion() + animation_datas.GetStructureVersion() + armatures.GetStructureVersion();
+				const ArmatureComponent* lod_armature = bindings_valid && animation.armature_index < armatures.GetCount() ? &armatures[animation.armature_index] : nullptr;
+				const bool lod_skip = lod_armature != nullptr && !lod_armature->lod_update;
+				const bool lod_reduced_bones = lod_armature != nullptr && lod_armature->lod_reduced_bones;
 
-				if (!bCulled)
+#ifdef GGREDUCED
+				if (!bCulled && !lod_skip)
+#else
+				if (!lod_skip)
 #endif
 				{
-					for (const AnimationComponent::AnimationChannel& channel : animation.channels)
+					// The channels are resolved to component indices only when the referenced component managers changed structure:
+					if (animation.bindings.size() != animation.channels.size() || animation.bindings_version != transforms.GetStructureVersion() + animation_datas.GetStructureVersion() + armatures.GetStructureVersion())
+					{
+						for (const AnimationComponent::AnimationChannel& channel : animation.channels)
+						{
+							assert(channel.samplerIndex < (int)animation.samplers.size());
+
+							AnimationComponent::AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
+							if (sampler.data == INVALID_ENTITY)
+							{
+								// backwards-compatibility mode
+								sampler.data = CreateEntity();
+								animation_datas.Create(sampler.data) = sampler.backwards_compatibility_data;
+								sampler.backwards_compatibility_data.keyframe_times.clear();
+								sampler.backwards_compatibility_data.keyframe_data.clear();
+							}
+						}
+
+						animation.bindings.resize(animation.channels.size());
+						animation.armature_index = ~0u;
+						for (size_t j = 0; j < animation.channels.size(); ++j)
+						{
+							const AnimationComponent::AnimationChannel& channel = animation.channels[j];
+							AnimationComponent::ChannelBinding& binding = animation.bindings[j];
+							binding.data_index = (uint32_t)animation_datas.GetIndex(animation.samplers[channel.samplerIndex].data);
+							binding.target_index = channel.path == AnimationComponent::AnimationChannel::Path::WEIGHTS ? ~0u : (uint32_t)transforms.GetIndex(channel.target);
+							binding.cursor = 0;
+
+							// The bone depth is the number of parents that are bones of the same armature:
+							binding.bone_depth = 0;
+							const size_t armature_index = animation_lod_bones.find(channel.target);
+							if (armature_index != wiECS::EntityLookup::INVALID_INDEX)
+							{
+								animation.armature_index = (uint32_t)armature_index;
+								const HierarchyComponent* parent = hierarchy.GetComponent(channel.target);
+								while (parent != nullptr && animation_lod_bones.find(parent->parentID) == armature_index && binding.bone_depth < 64)
+								{
+									binding.bone_depth++;
+									parent = hierarchy.GetComponent(parent->parentID);
+								}
+							}
+						}
+						animation.bindings_version = transforms.GetStructureVersion() + animation_datas.GetStructureVersion() + armatures.GetStructureVersion();
+					}
+
+					// Sample the keyframes of every channel, the linear rotation keys are interpolated together afterwards:
+					samples.resize(animation.channels.size());
+					slerp_a.clear();
+					slerp_b.clear();
+					slerp_t.clear();
+					slerp_dest.clear();
+					for (size_t j = 0; j < animation.channels.size(); ++j)
 					{
-						assert(channel.samplerIndex < (int)animation.samplers.size());
+						const AnimationComponent::AnimationChannel& channel = animation.channels[j];
+						const AnimationComponent::AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
+						AnimationComponent::ChannelBinding& binding = animation.bindings[j];
+						ChannelSample& sample = samples[j];
+						sample.valid = false;
 
-						AnimationComponent::AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
-						if (sampler.data == INVALID_ENTITY)
+						if (binding.data_index >= animation_datas.GetCount())
 						{
-							// backwards-compatibility mode
-							sampler.data = CreateEntity();
-							animation_datas.Create(sampler.data) = sampler.backwards_compatibility_data;
-							sampler.backwards_compatibility_data.keyframe_times.clear();
-							sampler.backwards_compatibility_data.keyframe_data.clear();
+							continue;
 						}
-				                //const AnimationDataComponent* animationdata = animation_datas.GetComponent(sampler.data);
-				                AnimationDataComponent* animationdata = animation_datas.GetComponent(sampler.data);
-						if (animationdata == nullptr)
+						if (lod_reduced_bones && binding.bone_depth > animation_lod.bone_reduction_depth)
 						{
+							// the deepest bones keep their last pose
 							continue;
 						}
+						const AnimationDataComponent& animationdata = animation_datas[binding.data_index];
+						if (animationdata.keyframe_times.empty())
+						{
+							continue;
+						}
+						if (channel.path != AnimationComponent::AnimationChannel::Path::WEIGHTS)
+						{
+							assert(binding.target_index < transforms.GetCount());
+							if (binding.target_index >= transforms.GetCount())
+								continue;
+						}
 
 						int keyLeft = 0;
 						int keyRight = 0;
-				                if(bResetKeys)
-					            animationdata->prevKeyRight = 0;
+#ifdef GGREDUCED
+						if (bResetKeys)
+							binding.cursor = 0;
+#endif
 
-						if (animationdata->keyframe_times.back() < animation.timer)
+						if (animationdata.keyframe_times.back() < animation.timer)
 						{
 							// Rightmost keyframe is already outside animation, so just snap to last keyframe:
-							keyLeft = keyRight = (int)animationdata->keyframe_times.size() - 1;
-					                animationdata->prevKeyRight = 0;
+							keyLeft = keyRight = (int)animationdata.keyframe_times.size() - 1;
+							binding.cursor = 0;
 						}
 						else
 						{
@@ -2532,18 +4288,20 @@ OPTICK_EVENT();
 								if (animation.timer > animation.end) fAnimTimeEnd = animation.end;
 							}
 #endif
-					                 keyRight = animationdata->prevKeyRight;
-					                 if (animationdata->keyframe_times[keyRight] >= fAnimTimeEnd)
-						               keyRight = 0;
-
-							// Search for the right keyframe (greater/equal to anim time):
-							while (animationdata->keyframe_times[keyRight++] < fAnimTimeEnd) {}
-							keyRight--;
+							// Search for the right keyframe (greater/equal to anim time), from the last left keyframe unless the time went backwards:
+							keyRight = (int)binding.cursor;
+							if (keyRight >= (int)animationdata.keyframe_times.size() || (keyRight > 0 && animationdata.keyframe_times[keyRight - 1] >= fAnimTimeEnd))
+							{
+								keyRight = 0;
+							}
+							while (animationdata.keyframe_times[keyRight] < fAnimTimeEnd)
+							{
+								keyRight++;
+							}
 
 							// Left keyframe is just near right:
 							keyLeft = std::max(0, keyRight - 1);
-					animationdata->prevKeyRight = keyLeft;
-
+							binding.cursor = (uint32_t)keyLeft;
 						}
 
 #ifdef GGREDUCED
@@ -2560,32 +4318,21 @@ OPTICK_EVENT();
 						}
 #endif
 
-						float left = animationdata->keyframe_times[keyLeft];
-
-						TransformComponent transform;
-
-						TransformComponent* target_transform = nullptr;
-						MeshComponent* target_mesh = nullptr;
-
-						if (channel.path == AnimationComponent::AnimationChannel::Path::WEIGHTS)
+						sample.valid = true;
+						sample.keyLeft = keyLeft;
+						sample.keyRight = keyRight;
+						sample.t = 0;
+						if (keyLeft != keyRight && (sampler.mode == AnimationComponent::AnimationSampler::Mode::LINEAR || sampler.mode == AnimationComponent::AnimationSampler::Mode::CUBICSPLINE))
 						{
-							ObjectComponent* object = objects.GetComponent(channel.target);
-							assert(object != nullptr);
-							if (object == nullptr)
-								continue;
-							target_mesh = meshes.GetComponent(object->meshID);
-							assert(target_mesh != nullptr);
-							if (target_mesh == nullptr)
-								continue;
-							animation.morph_weights_temp.resize(target_mesh->targets.size());
+							const float left = animationdata.keyframe_times[keyLeft];
+							const float right = animationdata.keyframe_times[keyRight];
+							sample.t = (animation.timer - left) / (right - left);
 						}
-						else
+
+						if (channel.path == AnimationComponent::AnimationChannel::Path::WEIGHTS)
 						{
-							target_transform = transforms.GetComponent(channel.target);
-							assert(target_transform != nullptr);
-							if (target_transform == nullptr)
-								continue;
-							transform = *target_transform;
+							// morph target weights are sampled together with blending, because they need the target mesh
+							continue;
 						}
 
 						switch (sampler.mode)
@@ -2598,30 +4345,17 @@ OPTICK_EVENT();
 							{
 							default:
 							case AnimationComponent::AnimationChannel::Path::TRANSLATION:
-							{
-								assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
-								transform.translation_local = ((const XMFLOAT3*)animationdata->keyframe_data.data())[keyLeft];
-							}
-							break;
-							case AnimationComponent::AnimationChannel::Path::ROTATION:
-							{
-								assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 4);
-								transform.rotation_local = ((const XMFLOAT4*)animationdata->keyframe_data.data())[keyLeft];
-							}
-							break;
 							case AnimationComponent::AnimationChannel::Path::SCALE:
 							{
-								assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
-								transform.scale_local = ((const XMFLOAT3*)animationdata->keyframe_data.data())[keyLeft];
+								assert(animationdata.keyframe_data.size() == animationdata.keyframe_times.size() * 3);
+								const XMFLOAT3* data = (const XMFLOAT3*)animationdata.keyframe_data.data();
+								XMStoreFloat4(&sample.value, XMLoadFloat3(&data[keyLeft]));
 							}
 							break;
-							case AnimationComponent::AnimationChannel::Path::WEIGHTS:
+							case AnimationComponent::AnimationChannel::Path::ROTATION:
 							{
-								assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * animation.morph_weights_temp.size());
-								for (size_t j = 0; j < animation.morph_weights_temp.size(); ++j)
-								{
-									animation.morph_weights_temp[j] = animationdata->keyframe_data[keyLeft * animation.morph_weights_temp.size() + j];
-								}
+								assert(animationdata.keyframe_data.size() == animationdata.keyframe_times.size() * 4);
+								sample.value = ((const XMFLOAT4*)animationdata.keyframe_data.data())[keyLeft];
 							}
 							break;
 							}
@@ -2630,62 +4364,27 @@ OPTICK_EVENT();
 						case AnimationComponent::AnimationSampler::Mode::LINEAR:
 						{
 							// Linear interpolation method:
-							float t;
-							if (keyLeft == keyRight)
-							{
-								t = 0;
-							}
-							else
-							{
-								// animation playing normally
-								float right = animationdata->keyframe_times[keyRight];
-								t = (animation.timer - left) / (right - left);
-							}
-
 							switch (channel.path)
 							{
 							default:
 							case AnimationComponent::AnimationChannel::Path::TRANSLATION:
-							{
-								assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
-								const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
-								XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft]);
-								XMVECTOR vRight = XMLoadFloat3(&data[keyRight]);
-								XMVECTOR vAnim = XMVectorLerp(vLeft, vRight, t);
-								XMStoreFloat3(&transform.translation_local, vAnim);
-							}
-							break;
-							case AnimationComponent::AnimationChannel::Path::ROTATION:
-							{
-								assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 4);
-								const XMFLOAT4* data = (const XMFLOAT4*)animationdata->keyframe_data.data();
-								XMVECTOR vLeft = XMLoadFloat4(&data[keyLeft]);
-								XMVECTOR vRight = XMLoadFloat4(&data[keyRight]);
-								XMVECTOR vAnim = XMQuaternionSlerp(vLeft, vRight, t);
-								vAnim = XMQuaternionNormalize(vAnim);
-								XMStoreFloat4(&transform.rotation_local, vAnim);
-							}
-							break;
 							case AnimationComponent::AnimationChannel::Path::SCALE:
 							{
-								assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3);
-								const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
+								assert(animationdata.keyframe_data.size() == animationdata.keyframe_times.size() * 3);
+								const XMFLOAT3* data = (const XMFLOAT3*)animationdata.keyframe_data.data();
 								XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft]);
 								XMVECTOR vRight = XMLoadFloat3(&data[keyRight]);
-								XMVECTOR vAnim = XMVectorLerp(vLeft, vRight, t);
-								XMStoreFloat3(&transform.scale_local, vAnim);
+								XMStoreFloat4(&sample.value, XMVectorLerp(vLeft, vRight, sample.t));
 							}
 							break;
-							case AnimationComponent::AnimationChannel::Path::WEIGHTS:
+							case AnimationComponent::AnimationChannel::Path::ROTATION:
 							{
-								assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * animation.morph_weights_temp.size());
-								for (size_t j = 0; j < animation.morph_weights_temp.size(); ++j)
-								{
-									float vLeft = animationdata->keyframe_data[keyLeft * animation.morph_weights_temp.size() + j];
-									float vRight = animationdata->keyframe_data[keyLeft * animation.morph_weights_temp.size() + j];
-									float vAnim = wiMath::Lerp(vLeft, vRight, t);
-									animation.morph_weights_temp[j] = vAnim;
-								}
+								assert(animationdata.keyframe_data.size() == animationdata.keyframe_times.size() * 4);
+								const XMFLOAT4* data = (const XMFLOAT4*)animationdata.keyframe_data.data();
+								slerp_a.push_back(data[keyLeft]);
+								slerp_b.push_back(data[keyRight]);
+								slerp_t.push_back(sample.t);
+								slerp_dest.push_back((uint32_t)j);
 							}
 							break;
 							}
@@ -2694,17 +4393,7 @@ OPTICK_EVENT();
 						case AnimationComponent::AnimationSampler::Mode::CUBICSPLINE:
 						{
 							// Cubic Spline interpolation method:
-							float t;
-							if (keyLeft == keyRight)
-							{
-								t = 0;
-							}
-							else
-							{
-								float right = animationdata->keyframe_times[keyRight];
-								t = (animation.timer - left) / (right - left);
-							}
-
+							const float t = sample.t;
 							const float t2 = t * t;
 							const float t3 = t2 * t;
 
@@ -2712,179 +4401,216 @@ OPTICK_EVENT();
 							{
 							default:
 							case AnimationComponent::AnimationChannel::Path::TRANSLATION:
+							case AnimationComponent::AnimationChannel::Path::SCALE:
 							{
-								assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3 * 3);
-								const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
+								assert(animationdata.keyframe_data.size() == animationdata.keyframe_times.size() * 3 * 3);
+								const XMFLOAT3* data = (const XMFLOAT3*)animationdata.keyframe_data.data();
 								XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft * 3 + 1]);
 								XMVECTOR vLeftTanOut = dt * XMLoadFloat3(&data[keyLeft * 3 + 2]);
 								XMVECTOR vRightTanIn = dt * XMLoadFloat3(&data[keyRight * 3 + 0]);
 								XMVECTOR vRight = XMLoadFloat3(&data[keyRight * 3 + 1]);
 								XMVECTOR vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
-								XMStoreFloat3(&transform.translation_local, vAnim);
+								XMStoreFloat4(&sample.value, vAnim);
 							}
 							break;
 							case AnimationComponent::AnimationChannel::Path::ROTATION:
 							{
-								assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 4 * 3);
-								const XMFLOAT4* data = (const XMFLOAT4*)animationdata->keyframe_data.data();
+								assert(animationdata.keyframe_data.size() == animationdata.keyframe_times.size() * 4 * 3);
+								const XMFLOAT4* data = (const XMFLOAT4*)animationdata.keyframe_data.data();
 								XMVECTOR vLeft = XMLoadFloat4(&data[keyLeft * 3 + 1]);
 								XMVECTOR vLeftTanOut = dt * XMLoadFloat4(&data[keyLeft * 3 + 2]);
 								XMVECTOR vRightTanIn = dt * XMLoadFloat4(&data[keyRight * 3 + 0]);
 								XMVECTOR vRight = XMLoadFloat4(&data[keyRight * 3 + 1]);
 								XMVECTOR vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
 								vAnim = XMQuaternionNormalize(vAnim);
-								XMStoreFloat4(&transform.rotation_local, vAnim);
-							}
-							break;
-							case AnimationComponent::AnimationChannel::Path::SCALE:
-							{
-								assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * 3 * 3);
-								const XMFLOAT3* data = (const XMFLOAT3*)animationdata->keyframe_data.data();
-								XMVECTOR vLeft = XMLoadFloat3(&data[keyLeft * 3 + 1]);
-								XMVECTOR vLeftTanOut = dt * XMLoadFloat3(&data[keyLeft * 3 + 2]);
-								XMVECTOR vRightTanIn = dt * XMLoadFloat3(&data[keyRight * 3 + 0]);
-								XMVECTOR vRight = XMLoadFloat3(&data[keyRight * 3 + 1]);
-								XMVECTOR vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
-								XMStoreFloat3(&transform.scale_local, vAnim);
-							}
-							break;
-							case AnimationComponent::AnimationChannel::Path::WEIGHTS:
-							{
-								assert(animationdata->keyframe_data.size() == animationdata->keyframe_times.size() * animation.morph_weights_temp.size() * 3);
-								for (size_t j = 0; j < animation.morph_weights_temp.size(); ++j)
-								{
-									float vLeft = animationdata->keyframe_data[(keyLeft * animation.morph_weights_temp.size() + j) * 3 + 1];
-									float vLeftTanOut = animationdata->keyframe_data[(keyLeft * animation.morph_weights_temp.size() + j) * 3 + 2];
-									float vRightTanIn = animationdata->keyframe_data[(keyLeft * animation.morph_weights_temp.size() + j) * 3 + 0];
-									float vRight = animationdata->keyframe_data[(keyLeft * animation.morph_weights_temp.size() + j) * 3 + 1];
-									float vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
-									animation.morph_weights_temp[j] = vAnim;
-								}
+								XMStoreFloat4(&sample.value, vAnim);
 							}
 							break;
 							}
 						}
 						break;
 						}
+					}
+
+					slerp_result.resize(slerp_a.size());
+					wiMath::SlerpMany(slerp_a.data(), slerp_b.data(), slerp_t.data(), slerp_result.data(), slerp_a.size(), true);
+					for (size_t j = 0; j < slerp_dest.size(); ++j)
+					{
+						samples[slerp_dest[j]].value = slerp_result[j];
+					}
 
-						if (target_transform != nullptr)
+					// Blend the samples into the targets by the animation amount, the rotations are blended together afterwards:
+					//	Every channel only modifies the path that it animates
+					slerp_a.clear();
+					slerp_b.clear();
+					slerp_t.clear();
+					slerp_dest.clear();
+					for (size_t j = 0; j < animation.channels.size(); ++j)
+					{
+						const ChannelSample& sample = samples[j];
+						if (!sample.valid)
 						{
-							target_transform->SetDirty();
+							continue;
+						}
+						const AnimationComponent::AnimationChannel& channel = animation.channels[j];
+						const AnimationComponent::ChannelBinding& binding = animation.bindings[j];
 
-#ifdef GGREDUCED
-							// additional functionality to impose other animation frames to the current frame
-							float fAmountCurveProportionalToSpeed = 0.0002f;
-							if (animation.speed < 0.5f) fAmountCurveProportionalToSpeed = 0.0001f;
-							if (animation.speed > 1.5f) fAmountCurveProportionalToSpeed = 0.0005f;
-							animation.amount = wiMath::Lerp(animation.amount, 1, fAmountCurveProportionalToSpeed);
-							float t = animation.amount;
-							// and adjust the rotation of frames for post-animation features such as head turning
-							if (channel.iUsePreFrame == 1)
+						if (channel.path == AnimationComponent::AnimationChannel::Path::WEIGHTS)
+						{
+							ObjectComponent* object = objects.GetComponent(channel.target);
+							assert(object != nullptr);
+							if (object == nullptr)
+								continue;
+							MeshComponent* target_mesh = meshes.GetComponent(object->meshID);
+							assert(target_mesh != nullptr);
+							if (target_mesh == nullptr)
+								continue;
+							animation.morph_weights_temp.resize(target_mesh->targets.size());
+
+							const AnimationDataComponent& animationdata = animation_datas[binding.data_index];
+							const size_t keyLeft = sample.keyLeft;
+							switch (animation.samplers[channel.samplerIndex].mode)
 							{
-								// merge preframe with current frame
-								switch (channel.path)
-								{
-								case AnimationComponent::AnimationChannel::Path::TRANSLATION:
-								{
-									XMVECTOR preframeT = channel.vPreFrameTranslation;
-									XMVECTOR currentT = XMLoadFloat3(&transform.translation_local);
-									XMVECTOR resultT = XMVectorAdd(preframeT, currentT); //?hmm
-									XMStoreFloat3(&transform.translation_local, resultT);
-									break;
-								}
-								case AnimationComponent::AnimationChannel::Path::ROTATION:
-								{
-									XMVECTOR preframeR = channel.qPreFrameRotation;
-									XMVECTOR currentR = XMLoadFloat4(&transform.rotation_local);
-									XMVECTOR resultR = XMQuaternionMultiply(preframeR, currentR);
-									XMStoreFloat4(&transform.rotation_local, resultR);
-									break;
-								}
-								case AnimationComponent::AnimationChannel::Path::SCALE:
+							default:
+							case AnimationComponent::AnimationSampler::Mode::STEP:
+							{
+								assert(animationdata.keyframe_data.size() == animationdata.keyframe_times.size() * animation.morph_weights_temp.size());
+								for (size_t k = 0; k < animation.morph_weights_temp.size(); ++k)
 								{
-									XMVECTOR preframeS = channel.vPreFrameScale;
-									XMVECTOR currentS = XMLoadFloat3(&transform.scale_local);
-									XMVECTOR resultS = XMVectorMultiply(preframeS, currentS);
-									XMStoreFloat3(&transform.scale_local, resultS);
-									break;
-								}
+									animation.morph_weights_temp[k] = animationdata.keyframe_data[keyLeft * animation.morph_weights_temp.size() + k];
 								}
 							}
-							if (channel.iUsePreFrame == 2)
+							break;
+							case AnimationComponent::AnimationSampler::Mode::LINEAR:
 							{
-								// entirely replace frame with preframe
-								switch (channel.path)
-								{
-								case AnimationComponent::AnimationChannel::Path::TRANSLATION:
+								assert(animationdata.keyframe_data.size() == animationdata.keyframe_times.size() * animation.morph_weights_temp.size());
+								for (size_t k = 0; k < animation.morph_weights_temp.size(); ++k)
 								{
-									XMVECTOR preframeT = channel.vPreFrameTranslation;
-									XMStoreFloat3(&transform.translation_local, preframeT);
-									break;
-								}
-								case AnimationComponent::AnimationChannel::Path::ROTATION:
-								{
-									XMVECTOR preframeR = channel.qPreFrameRotation;
-									XMStoreFloat4(&transform.rotation_local, preframeR);
-									break;
+									float vLeft = animationdata.keyframe_data[keyLeft * animation.morph_weights_temp.size() + k];
+									float vRight = animationdata.keyframe_data[keyLeft * animation.morph_weights_temp.size() + k];
+									float vAnim = wiMath::Lerp(vLeft, vRight, sample.t);
+									animation.morph_weights_temp[k] = vAnim;
 								}
-								case AnimationComponent::AnimationChannel::Path::SCALE:
-								{
-									XMVECTOR preframeS = channel.vPreFrameScale;
-									XMStoreFloat3(&transform.scale_local, preframeS);
-									break;
-								}
-								}
-
-								// use fSmoothAmount to introduce this frame smoothly into current frame
-								t = channel.fSmoothAmount;
 							}
-							if (channel.iUsePreFrame == 3)
+							break;
+							case AnimationComponent::AnimationSampler::Mode::CUBICSPLINE:
 							{
-								if (channel.path == AnimationComponent::AnimationChannel::Path::TRANSLATION)
+								const float t = sample.t;
+								const float t2 = t * t;
+								const float t3 = t2 * t;
+								assert(animationdata.keyframe_data.size() == animationdata.keyframe_times.size() * animation.morph_weights_temp.size() * 3);
+								for (size_t k = 0; k < animation.morph_weights_temp.size(); ++k)
 								{
-									float fRetainYPos = transform.translation_local.y;
-									XMVECTOR preframeT = channel.vPreFrameTranslation;
-									XMStoreFloat3(&transform.translation_local, preframeT);
-									transform.translation_local.y = fRetainYPos;
-								}
-								if (channel.path == AnimationComponent::AnimationChannel::Path::ROTATION)
-								{
-									XMVECTOR preframeT = channel.qPreFrameRotation;
-									XMStoreFloat4(&transform.rotation_local, preframeT);
+									float vLeft = animationdata.keyframe_data[(keyLeft * animation.morph_weights_temp.size() + k) * 3 + 1];
+									float vLeftTanOut = animationdata.keyframe_data[(keyLeft * animation.morph_weights_temp.size() + k) * 3 + 2];
+									float vRightTanIn = animationdata.keyframe_data[(keyLeft * animation.morph_weights_temp.size() + k) * 3 + 0];
+									float vRight = animationdata.keyframe_data[(keyLeft * animation.morph_weights_temp.size() + k) * 3 + 1];
+									float vAnim = (2 * t3 - 3 * t2 + 1) * vLeft + (t3 - 2 * t2 + t) * vLeftTanOut + (-2 * t3 + 3 * t2) * vRight + (t3 - t2) * vRightTanIn;
+									animation.morph_weights_temp[k] = vAnim;
 								}
 							}
-#else
-							const float t = animation.amount;
-#endif
-							const XMVECTOR aS = XMLoadFloat3(&target_transform->scale_local);
-							const XMVECTOR aR = XMLoadFloat4(&target_transform->rotation_local);
-							const XMVECTOR aT = XMLoadFloat3(&target_transform->translation_local);
+							break;
+							}
 
-							const XMVECTOR bS = XMLoadFloat3(&transform.scale_local);
-							const XMVECTOR bR = XMLoadFloat4(&transform.rotation_local);
-							const XMVECTOR bT = XMLoadFloat3(&transform.translation_local);
+							const float t = animation.amount;
 
-							const XMVECTOR S = XMVectorLerp(aS, bS, t);
-							const XMVECTOR R = XMQuaternionSlerp(aR, bR, t);
-							const XMVECTOR T = XMVectorLerp(aT, bT, t);
+							for (size_t k = 0; k < target_mesh->targets.size(); ++k)
+							{
+								target_mesh->targets[k].weight = wiMath::Lerp(target_mesh->targets[k].weight, animation.morph_weights_temp[k], t);
+							}
 
-							XMStoreFloat3(&target_transform->scale_local, S);
-							XMStoreFloat4(&target_transform->rotation_local, R);
-							XMStoreFloat3(&target_transform->translation_local, T);
+							target_mesh->dirty_morph = true;
+							continue;
 						}
 
-						if (target_mesh != nullptr)
+						TransformComponent& target_transform = transforms[binding.target_index];
+						target_transform.SetDirty();
+
+						XMVECTOR value = XMLoadFloat4(&sample.value);
+
+#ifdef GGREDUCED
+						// additional functionality to impose other animation frames to the current frame
+						float fAmountCurveProportionalToSpeed = 0.0002f;
+						if (animation.speed < 0.5f) fAmountCurveProportionalToSpeed = 0.0001f;
+						if (animation.speed > 1.5f) fAmountCurveProportionalToSpeed = 0.0005f;
+						animation.amount = wiMath::Lerp(animation.amount, 1, fAmountCurveProportionalToSpeed);
+						float t = animation.amount;
+						// and adjust the rotation of frames for post-animation features such as head turning
+						if (channel.iUsePreFrame == 1)
 						{
-							const float t = animation.amount;
+							// merge preframe with current frame
+							switch (channel.path)
+							{
+							case AnimationComponent::AnimationChannel::Path::TRANSLATION:
+								value = XMVectorAdd(channel.vPreFrameTranslation, value); //?hmm
+								break;
+							case AnimationComponent::AnimationChannel::Path::ROTATION:
+								value = XMQuaternionMultiply(channel.qPreFrameRotation, value);
+								break;
+							case AnimationComponent::AnimationChannel::Path::SCALE:
+								value = XMVectorMultiply(channel.vPreFrameScale, value);
+								break;
+							}
+						}
+						if (channel.iUsePreFrame == 2)
+						{
+							// entirely replace frame with preframe
+							switch (channel.path)
+							{
+							case AnimationComponent::AnimationChannel::Path::TRANSLATION:
+								value = channel.vPreFrameTranslation;
+								break;
+							case AnimationComponent::AnimationChannel::Path::ROTATION:
+								value = channel.qPreFrameRotation;
+								break;
+							case AnimationComponent::AnimationChannel::Path::SCALE:
+								value = channel.vPreFrameScale;
+								break;
+							}
 
-							for (size_t j = 0; j < target_mesh->targets.size(); ++j)
+							// use fSmoothAmount to introduce this frame smoothly into current frame
+							t = channel.fSmoothAmount;
+						}
+						if (channel.iUsePreFrame == 3)
+						{
+							if (channel.path == AnimationComponent::AnimationChannel::Path::TRANSLATION)
 							{
-								target_mesh->targets[j].weight = wiMath::Lerp(target_mesh->targets[j].weight, animation.morph_weights_temp[j], t);
+								// retain the animated Y position
+								value = XMVectorSelect(channel.vPreFrameTranslation, value, XMVectorSelectControl(0, 1, 0, 0));
 							}
+							if (channel.path == AnimationComponent::AnimationChannel::Path::ROTATION)
+							{
+								value = channel.qPreFrameRotation;
+							}
+						}
+#else
+						const float t = animation.amount;
+#endif
 
-							target_mesh->dirty_morph = true;
+						switch (channel.path)
+						{
+						default:
+						case AnimationComponent::AnimationChannel::Path::TRANSLATION:
+							XMStoreFloat3(&target_transform.translation_local, XMVectorLerp(XMLoadFloat3(&target_transform.translation_local), value, t));
+							break;
+						case AnimationComponent::AnimationChannel::Path::SCALE:
+							XMStoreFloat3(&target_transform.scale_local, XMVectorLerp(XMLoadFloat3(&target_transform.scale_local), value, t));
+							break;
+						case AnimationComponent::AnimationChannel::Path::ROTATION:
+							slerp_a.push_back(target_transform.rotation_local);
+							slerp_b.emplace_back();
+							XMStoreFloat4(&slerp_b.back(), value);
+							slerp_t.push_back(t);
+							slerp_dest.push_back(binding.target_index);
+							break;
 						}
+					}
 
+					slerp_result.resize(slerp_a.size());
+					wiMath::SlerpMany(slerp_a.data(), slerp_b.data(), slerp_t.data(), slerp_result.data(), slerp_a.size());
+					for (size_t j = 0; j < slerp_dest.size(); ++j)
+					{
+						transforms[slerp_dest[j]].rotation_local = slerp_result[j];
 					}
 				}
 				if (animation.IsPlaying())
@@ -2931,13 +4657,74 @@ OPTICK_EVENT();
 		OPTICK_EVENT();
 #endif
 #endif
-		wiJobSystem::Dispatch(ctx, (uint32_t)transforms.GetCount(), small_subtask_groupsize, [&](wiJobArgs args) {
+		static wiJobSystem::GrainSize grain;
+		wiJobSystem::ParallelFor(ctx, (uint32_t)transforms.GetCount(), grain, [&](uint32_t index) {
 
-			TransformComponent& transform = transforms[args.jobIndex];
+			TransformComponent& transform = transforms[index];
+			if (transform.IsDirty())
+			{
+				// Changed transforms are stamped for the incremental systems (for example wiReplication):
+				transforms.MarkChanged((size_t)index);
+			}
 			transform.UpdateTransform();
 		});
 	}
 #ifdef MTHREAD_HIERARCHY
+	void Scene::UpdateHierarchyOrder()
+	{
+		if (hierarchy_order_version == hierarchy.GetStructureVersion())
+		{
+			return;
+		}
+		hierarchy_order_version = hierarchy.GetStructureVersion();
+
+		// Compute the depth of every node, parents that are not in the hierarchy are roots on depth -1:
+		const uint32_t count = (uint32_t)hierarchy.GetCount();
+		const uint32_t UNKNOWN_DEPTH = ~0u;
+		std::vector<uint32_t> depths(count, UNKNOWN_DEPTH);
+		std::vector<uint32_t> chain;
+		uint32_t depthCount = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			// Walk up until a node with known depth or a root is found, then assign the depths downwards:
+			chain.clear();
+			uint32_t node = i;
+			uint32_t depth = 0;
+			while (node != UNKNOWN_DEPTH && depths[node] == UNKNOWN_DEPTH && chain.size() <= count)
+			{
+				chain.push_back(node);
+				const size_t parent = hierarchy.GetIndex(hierarchy[node].parentID);
+				node = parent == wiECS::EntityLookup::INVALID_INDEX ? UNKNOWN_DEPTH : (uint32_t)parent;
+			}
+			assert(chain.size() <= count); // cycle in the hierarchy!
+			if (node != UNKNOWN_DEPTH)
+			{
+				depth = depths[node] + 1;
+			}
+			for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+			{
+				depths[*it] = depth++;
+			}
+			depthCount = std::max(depthCount, depth);
+		}
+
+		// Counting sort of the nodes by depth, every level keeps the component order:
+		hierarchy_levels.assign(depthCount + 1, 0);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			hierarchy_levels[depths[i] + 1]++;
+		}
+		for (uint32_t level = 0; level < depthCount; ++level)
+		{
+			hierarchy_levels[level + 1] += hierarchy_levels[level];
+		}
+		hierarchy_order.resize(count);
+		std::vector<uint32_t> offsets(hierarchy_levels.begin(), hierarchy_levels.end() - 1);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			hierarchy_order[offsets[depths[i]]++] = i;
+		}
+	}
 	void Scene::RunHierarchyUpdateSystem(wiJobSystem::context& ctx)
 	{
 #ifdef GGREDUCED
@@ -2945,59 +4732,48 @@ OPTICK_EVENT();
 		OPTICK_EVENT();
 #endif
 #endif
-		wiJobSystem::Dispatch(ctx, (uint32_t)hierarchy.GetCount(), small_subtask_groupsize, [&](wiJobArgs args) {
-
-			HierarchyComponent& hier = hierarchy[args.jobIndex];
-			Entity entity = hierarchy.GetEntity(args.jobIndex);
-
-			TransformComponent* transform_child = transforms.GetComponent(entity);
-			XMMATRIX worldmatrix;
-			if (transform_child != nullptr)
-			{
-				worldmatrix = transform_child->GetLocalMatrix();
-			}
+		// The nodes are processed level by level in depth order, so every parent is final before its children,
+		//	and each node needs only its parent's world matrix instead of the whole parent chain
+		UpdateHierarchyOrder();
 
-			LayerComponent* layer_child = layers.GetComponent(entity);
-			if (layer_child != nullptr)
-			{
-				layer_child->propagationMask = ~0u; // clear propagation mask to full
-			}
+		static wiJobSystem::GrainSize grain;
+		for (size_t level = 0; level + 1 < hierarchy_levels.size(); ++level)
+		{
+			const uint32_t levelStart = hierarchy_levels[level];
+			const uint32_t levelCount = hierarchy_levels[level + 1] - levelStart;
 
-			if (transform_child == nullptr && layer_child == nullptr)
-				return;
+			wiJobSystem::context level_ctx;
+			level_ctx.name = ctx.name;
+			wiJobSystem::ParallelFor(level_ctx, levelCount, grain, [&](uint32_t orderIndex) {
 
-			Entity parentID = hier.parentID;
-			while (parentID != INVALID_ENTITY)
-			{
-				TransformComponent* transform_parent = transforms.GetComponent(parentID);
-				if (transform_child != nullptr && transform_parent != nullptr)
-				{
-					worldmatrix *= transform_parent->GetLocalMatrix();
-				}
+				const uint32_t index = hierarchy_order[levelStart + orderIndex];
+				const HierarchyComponent& hier = hierarchy[index];
+				Entity entity = hierarchy.GetEntity(index);
 
-				LayerComponent* layer_parent = layers.GetComponent(parentID);
-				if (layer_child != nullptr && layer_parent != nullptr)
+				TransformComponent* transform_child = transforms.GetComponent(entity);
+				if (transform_child != nullptr)
 				{
-					layer_child->propagationMask &= layer_parent->layerMask;
+					const TransformComponent* transform_parent = transforms.GetComponent(hier.parentID);
+					if (transform_parent != nullptr)
+					{
+						transform_child->UpdateTransform_Parented(*transform_parent);
+					}
+					else
+					{
+						XMStoreFloat4x4(&transform_child->world, transform_child->GetLocalMatrix());
+					}
 				}
 
-				const HierarchyComponent* hier_recursive = hierarchy.GetComponent(parentID);
-				if (hier_recursive != nullptr)
-				{
-					parentID = hier_recursive->parentID;
-				}
-				else
+				LayerComponent* layer_child = layers.GetComponent(entity);
+				if (layer_child != nullptr)
 				{
-					parentID = INVALID_ENTITY;
+					const LayerComponent* layer_parent = layers.GetComponent(hier.parentID);
+					layer_child->propagationMask = layer_parent == nullptr ? ~0u : layer_parent->GetLayerMask();
 				}
-			}
 
-			if (transform_child != nullptr)
-			{
-				XMStoreFloat4x4(&transform_child->world, worldmatrix);
-			}
-
-		});
+			});
+			wiJobSystem::Wait(level_ctx); // the next level depends on this one
+		}
 	}
 #endif
 #ifndef MTHREAD_HIERARCHY
@@ -3029,6 +4805,100 @@ OPTICK_EVENT();
 	}
 #endif
 
+	// Puts the components into groups by their hierarchy root, a component is also grouped together with the entity returned by link(component)
+	//	The groups are only rebuilt if the structure or the links changed
+	template<typename T, typename Link>
+	static void UpdateSolverBatches(Scene::SolverBatches& batches, const ComponentManager<T>& components, const ComponentManager<HierarchyComponent>& hierarchy, Link link)
+	{
+		const uint32_t count = (uint32_t)components.GetCount();
+		bool changed = batches.version != components.GetStructureVersion() + hierarchy.GetStructureVersion() || batches.links.size() != count;
+		for (uint32_t i = 0; i < count && !changed; ++i)
+		{
+			changed = batches.links[i] != link(components[i]);
+		}
+		if (!changed)
+		{
+			return;
+		}
+		batches.version = components.GetStructureVersion() + hierarchy.GetStructureVersion();
+		batches.links.resize(count);
+
+		auto find_root = [&](Entity entity) {
+			for (size_t depth = 0; depth <= hierarchy.GetCount(); ++depth) // bounded in case of cycles
+			{
+				const HierarchyComponent* hier = hierarchy.GetComponent(entity);
+				if (hier == nullptr || hier->parentID == INVALID_ENTITY)
+				{
+					break;
+				}
+				entity = hier->parentID;
+			}
+			return entity;
+		};
+
+		// Groups are merged with union-find when a link connects two hierarchies:
+		wiECS::EntityLookup root_groups;
+		std::vector<uint32_t> group_parents;
+		auto get_group = [&](Entity root) {
+			size_t group = root_groups.find(root);
+			if (group == wiECS::EntityLookup::INVALID_INDEX)
+			{
+				group = group_parents.size();
+				group_parents.push_back((uint32_t)group);
+				root_groups.set(root, group);
+			}
+			return (uint32_t)group;
+		};
+		auto find_group = [&](uint32_t group) {
+			while (group_parents[group] != group)
+			{
+				group_parents[group] = group_parents[group_parents[group]];
+				group = group_parents[group];
+			}
+			return group;
+		};
+
+		std::vector<uint32_t> groups(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			groups[i] = get_group(find_root(components.GetEntity(i)));
+			batches.links[i] = link(components[i]);
+			if (batches.links[i] != INVALID_ENTITY)
+			{
+				const uint32_t a = find_group(groups[i]);
+				const uint32_t b = find_group(get_group(find_root(batches.links[i])));
+				group_parents[std::max(a, b)] = std::min(a, b);
+			}
+		}
+
+		// Counting sort of the components by their compacted group:
+		std::vector<uint32_t> compact(group_parents.size(), ~0u);
+		uint32_t groupCount = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint32_t& group = compact[find_group(groups[i])];
+			if (group == ~0u)
+			{
+				group = groupCount++;
+			}
+			groups[i] = group;
+		}
+		batches.offsets.assign(groupCount + 1, 0);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			batches.offsets[groups[i] + 1]++;
+		}
+		for (uint32_t group = 0; group < groupCount; ++group)
+		{
+			batches.offsets[group + 1] += batches.offsets[group];
+		}
+		batches.order.resize(count);
+		std::vector<uint32_t> offsets(batches.offsets.begin(), batches.offsets.end() - 1);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			batches.order[offsets[groups[i]]++] = i;
+		}
+	}
 	void Scene::RunSpringUpdateSystem(wiJobSystem::context& ctx)
 	{
 #ifdef GGREDUCED
@@ -3041,86 +4911,93 @@ OPTICK_EVENT();
 		const XMVECTOR windDir = XMLoadFloat3(&weather.windDirection);
 		const XMVECTOR gravity = XMVectorSet(0, -9.8f, 0, 0);
 
-		for (size_t i = 0; i < springs.GetCount(); ++i)
-		{
-			SpringComponent& spring = springs[i];
-			if (spring.IsDisabled())
-			{
-				continue;
-			}
-			Entity entity = springs.GetEntity(i);
-			TransformComponent* transform = transforms.GetComponent(entity);
-			if (transform == nullptr)
-			{
-				assert(0);
-				continue;
-			}
+		UpdateSolverBatches(spring_batches, springs, hierarchy, [](const SpringComponent&) { return INVALID_ENTITY; });
 
-			if (spring.IsResetting())
-			{
-				spring.Reset(false);
-				spring.center_of_mass = transform->GetPosition();
-				spring.velocity = XMFLOAT3(0, 0, 0);
-			}
+		// Springs of different hierarchies are independent, inside a hierarchy they are resolved in component order:
+		wiJobSystem::Dispatch(ctx, (uint32_t)spring_batches.offsets.size() - 1, 1, [&](wiJobArgs args) {
 
-			const HierarchyComponent* hier = hierarchy.GetComponent(entity);
-			TransformComponent* parent_transform = hier == nullptr ? nullptr : transforms.GetComponent(hier->parentID);
-			if (parent_transform != nullptr)
+			for (uint32_t batchIndex = spring_batches.offsets[args.jobIndex]; batchIndex < spring_batches.offsets[args.jobIndex + 1]; ++batchIndex)
 			{
-				// Spring hierarchy resolve depends on spring component order!
-				//	It works best when parent spring is located before child spring!
-				//	It will work the other way, but results will be less convincing
-				transform->UpdateTransform_Parented(*parent_transform);
-			}
+				const size_t i = spring_batches.order[batchIndex];
+				SpringComponent& spring = springs[i];
+				if (spring.IsDisabled())
+				{
+					continue;
+				}
+				Entity entity = springs.GetEntity(i);
+				TransformComponent* transform = transforms.GetComponent(entity);
+				if (transform == nullptr)
+				{
+					assert(0);
+					continue;
+				}
 
-			const XMVECTOR position_current = transform->GetPositionV();
-			XMVECTOR position_prev = XMLoadFloat3(&spring.center_of_mass);
-			XMVECTOR force = (position_current - position_prev) * spring.stiffness;
+				if (spring.IsResetting())
+				{
+					spring.Reset(false);
+					spring.center_of_mass = transform->GetPosition();
+					spring.velocity = XMFLOAT3(0, 0, 0);
+				}
+
+				const HierarchyComponent* hier = hierarchy.GetComponent(entity);
+				TransformComponent* parent_transform = hier == nullptr ? nullptr : transforms.GetComponent(hier->parentID);
+				if (parent_transform != nullptr)
+				{
+					// Spring hierarchy resolve depends on spring component order!
+					//	It works best when parent spring is located before child spring!
+					//	It will work the other way, but results will be less convincing
+					transform->UpdateTransform_Parented(*parent_transform);
+				}
 
-			if (spring.wind_affection > 0)
-			{
-				force += std::sin(time * weather.windSpeed + XMVectorGetX(XMVector3Dot(position_current, windDir))) * windDir * spring.wind_affection;
-			}
-			if (spring.IsGravityEnabled())
-			{
-				force += gravity;
-			}
+				const XMVECTOR position_current = transform->GetPositionV();
+				XMVECTOR position_prev = XMLoadFloat3(&spring.center_of_mass);
+				XMVECTOR force = (position_current - position_prev) * spring.stiffness;
 
-			XMVECTOR velocity = XMLoadFloat3(&spring.velocity);
-			velocity += force * dt;
-			XMVECTOR position_target = position_prev + velocity * dt;
+				if (spring.wind_affection > 0)
+				{
+					force += std::sin(time * weather.windSpeed + XMVectorGetX(XMVector3Dot(position_current, windDir))) * windDir * spring.wind_affection;
+				}
+				if (spring.IsGravityEnabled())
+				{
+					force += gravity;
+				}
 
-			if (parent_transform != nullptr)
-			{
-				const XMVECTOR position_parent = parent_transform->GetPositionV();
-				const XMVECTOR parent_to_child = position_current - position_parent;
-				const XMVECTOR parent_to_target = position_target - position_parent;
+				XMVECTOR velocity = XMLoadFloat3(&spring.velocity);
+				velocity += force * dt;
+				XMVECTOR position_target = position_prev + velocity * dt;
 
-				if (!spring.IsStretchEnabled())
+				if (parent_transform != nullptr)
 				{
-					// Limit offset to keep distance from parent:
-					const XMVECTOR len = XMVector3Length(parent_to_child);
-					position_target = position_parent + XMVector3Normalize(parent_to_target) * len;
+					const XMVECTOR position_parent = parent_transform->GetPositionV();
+					const XMVECTOR parent_to_child = position_current - position_parent;
+					const XMVECTOR parent_to_target = position_target - position_parent;
+
+					if (!spring.IsStretchEnabled())
+					{
+						// Limit offset to keep distance from parent:
+						const XMVECTOR len = XMVector3Length(parent_to_child);
+						position_target = position_parent + XMVector3Normalize(parent_to_target) * len;
+					}
+
+					// Parent rotation to point to new child position:
+					const XMVECTOR dir_parent_to_child = XMVector3Normalize(parent_to_child);
+					const XMVECTOR dir_parent_to_target = XMVector3Normalize(parent_to_target);
+					const XMVECTOR axis = XMVector3Normalize(XMVector3Cross(dir_parent_to_child, dir_parent_to_target));
+					const float angle = XMScalarACos(XMVectorGetX(XMVector3Dot(dir_parent_to_child, dir_parent_to_target))); // don't use std::acos!
+					const XMVECTOR Q = XMQuaternionNormalize(XMQuaternionRotationNormal(axis, angle));
+					TransformComponent saved_parent = *parent_transform;
+					saved_parent.ApplyTransform();
+					saved_parent.Rotate(Q);
+					saved_parent.UpdateTransform();
+					std::swap(saved_parent.world, parent_transform->world); // only store temporary result, not modifying actual local space!
 				}
 
-				// Parent rotation to point to new child position:
-				const XMVECTOR dir_parent_to_child = XMVector3Normalize(parent_to_child);
-				const XMVECTOR dir_parent_to_target = XMVector3Normalize(parent_to_target);
-				const XMVECTOR axis = XMVector3Normalize(XMVector3Cross(dir_parent_to_child, dir_parent_to_target));
-				const float angle = XMScalarACos(XMVectorGetX(XMVector3Dot(dir_parent_to_child, dir_parent_to_target))); // don't use std::acos!
-				const XMVECTOR Q = XMQuaternionNormalize(XMQuaternionRotationNormal(axis, angle));
-				TransformComponent saved_parent = *parent_transform;
-				saved_parent.ApplyTransform();
-				saved_parent.Rotate(Q);
-				saved_parent.UpdateTransform();
-				std::swap(saved_parent.world, parent_transform->world); // only store temporary result, not modifying actual local space!
+				XMStoreFloat3(&spring.center_of_mass, position_target);
+				velocity *= spring.damping;
+				XMStoreFloat3(&spring.velocity, velocity);
+				*((XMFLOAT3*)&transform->world._41) = spring.center_of_mass;
 			}
-
-			XMStoreFloat3(&spring.center_of_mass, position_target);
-			velocity *= spring.damping;
-			XMStoreFloat3(&spring.velocity, velocity);
-			*((XMFLOAT3*)&transform->world._41) = spring.center_of_mass;
-		}
+		});
 	}
 	void Scene::RunInverseKinematicsUpdateSystem(wiJobSystem::context& ctx)
 	{
@@ -3129,83 +5006,93 @@ OPTICK_EVENT();
 		OPTICK_EVENT();
 #endif
 #endif
-		bool recompute_hierarchy = false;
-		for (size_t i = 0; i < inverse_kinematics.GetCount(); ++i)
-		{
-			const InverseKinematicsComponent& ik = inverse_kinematics[i];
-			if (ik.IsDisabled())
-			{
-				continue;
-			}
-			Entity entity = inverse_kinematics.GetEntity(i);
-			TransformComponent* transform = transforms.GetComponent(entity);
-			TransformComponent* target = transforms.GetComponent(ik.target);
-			const HierarchyComponent* hier = hierarchy.GetComponent(entity);
-			if (transform == nullptr || target == nullptr || hier == nullptr)
-			{
-				continue;
-			}
+		UpdateSolverBatches(ik_batches, inverse_kinematics, hierarchy, [](const InverseKinematicsComponent& ik) { return ik.target; });
+
+		// IK chains of different hierarchies are independent (the target's hierarchy is in the same group), they are solved in parallel:
+		std::atomic<bool> recompute_hierarchy{ false };
+		wiJobSystem::context ik_ctx;
+		ik_ctx.name = ctx.name;
+		wiJobSystem::Dispatch(ik_ctx, (uint32_t)ik_batches.offsets.size() - 1, 1, [&](wiJobArgs args) {
 
-			const XMVECTOR target_pos = target->GetPositionV();
-			for (uint32_t iteration = 0; iteration < ik.iteration_count; ++iteration)
+			for (uint32_t batchIndex = ik_batches.offsets[args.jobIndex]; batchIndex < ik_batches.offsets[args.jobIndex + 1]; ++batchIndex)
 			{
-				TransformComponent* stack[32] = {};
-				Entity parent_entity = hier->parentID;
-				TransformComponent* child_transform = transform;
-				for (uint32_t chain = 0; chain < std::min(ik.chain_length, (uint32_t)arraysize(stack)); ++chain)
+				const size_t i = ik_batches.order[batchIndex];
+				const InverseKinematicsComponent& ik = inverse_kinematics[i];
+				if (ik.IsDisabled())
 				{
-					recompute_hierarchy = true; // any IK will trigger a full transform hierarchy recompute step at the end(**)
-
-					// stack stores all traversed chain links so far:
-					stack[chain] = child_transform;
-
-					// Compute required parent rotation that moves ik transform closer to target transform:
-					TransformComponent* parent_transform = transforms.GetComponent(parent_entity);
-					const XMVECTOR parent_pos = parent_transform->GetPositionV();
-					const XMVECTOR dir_parent_to_ik = XMVector3Normalize(transform->GetPositionV() - parent_pos);
-					const XMVECTOR dir_parent_to_target = XMVector3Normalize(target_pos - parent_pos);
-					const XMVECTOR axis = XMVector3Normalize(XMVector3Cross(dir_parent_to_ik, dir_parent_to_target));
-					const float angle = XMScalarACos(XMVectorGetX(XMVector3Dot(dir_parent_to_ik, dir_parent_to_target)));
-					const XMVECTOR Q = XMQuaternionNormalize(XMQuaternionRotationNormal(axis, angle));
+					continue;
+				}
+				Entity entity = inverse_kinematics.GetEntity(i);
+				TransformComponent* transform = transforms.GetComponent(entity);
+				TransformComponent* target = transforms.GetComponent(ik.target);
+				const HierarchyComponent* hier = hierarchy.GetComponent(entity);
+				if (transform == nullptr || target == nullptr || hier == nullptr)
+				{
+					continue;
+				}
 
-					// parent to world space:
-					parent_transform->ApplyTransform();
-					// rotate parent:
-					parent_transform->Rotate(Q);
-					parent_transform->UpdateTransform();
-					// parent back to local space (if parent has parent):
-					const HierarchyComponent* hier_parent = hierarchy.GetComponent(parent_entity);
-					if (hier_parent != nullptr)
+				const XMVECTOR target_pos = target->GetPositionV();
+				for (uint32_t iteration = 0; iteration < ik.iteration_count; ++iteration)
+				{
+					TransformComponent* stack[32] = {};
+					Entity parent_entity = hier->parentID;
+					TransformComponent* child_transform = transform;
+					for (uint32_t chain = 0; chain < std::min(ik.chain_length, (uint32_t)arraysize(stack)); ++chain)
 					{
-						Entity parent_of_parent_entity = hier_parent->parentID;
-						const TransformComponent* transform_parent_of_parent = transforms.GetComponent(parent_of_parent_entity);
-						XMMATRIX parent_of_parent_inverse = XMMatrixInverse(nullptr, XMLoadFloat4x4(&transform_parent_of_parent->world));
-						parent_transform->MatrixTransform(parent_of_parent_inverse);
-						// Do not call UpdateTransform() here, to keep parent world matrix in world space!
-					}
+						recompute_hierarchy = true; // any IK will trigger a full transform hierarchy recompute step at the end(**)
+
+						// stack stores all traversed chain links so far:
+						stack[chain] = child_transform;
+
+						// Compute required parent rotation that moves ik transform closer to target transform:
+						TransformComponent* parent_transform = transforms.GetComponent(parent_entity);
+						const XMVECTOR parent_pos = parent_transform->GetPositionV();
+						const XMVECTOR dir_parent_to_ik = XMVector3Normalize(transform->GetPositionV() - parent_pos);
+						const XMVECTOR dir_parent_to_target = XMVector3Normalize(target_pos - parent_pos);
+						const XMVECTOR axis = XMVector3Normalize(XMVector3Cross(dir_parent_to_ik, dir_parent_to_target));
+						const float angle = XMScalarACos(XMVectorGetX(XMVector3Dot(dir_parent_to_ik, dir_parent_to_target)));
+						const XMVECTOR Q = XMQuaternionNormalize(XMQuaternionRotationNormal(axis, angle));
+
+						// parent to world space:
+						parent_transform->ApplyTransform();
+						// rotate parent:
+						parent_transform->Rotate(Q);
+						parent_transform->UpdateTransform();
+						// parent back to local space (if parent has parent):
+						const HierarchyComponent* hier_parent = hierarchy.GetComponent(parent_entity);
+						if (hier_parent != nullptr)
+						{
+							Entity parent_of_parent_entity = hier_parent->parentID;
+							const TransformComponent* transform_parent_of_parent = transforms.GetComponent(parent_of_parent_entity);
+							XMMATRIX parent_of_parent_inverse = XMMatrixInverse(nullptr, XMLoadFloat4x4(&transform_parent_of_parent->world));
+							parent_transform->MatrixTransform(parent_of_parent_inverse);
+							// Do not call UpdateTransform() here, to keep parent world matrix in world space!
+						}
 
-					// update chain from parent to children:
-					const TransformComponent* recurse_parent = parent_transform;
-					for (int recurse_chain = (int)chain; recurse_chain >= 0; --recurse_chain)
-					{
-						stack[recurse_chain]->UpdateTransform_Parented(*recurse_parent);
-						recurse_parent = stack[recurse_chain];
-					}
+						// update chain from parent to children:
+						const TransformComponent* recurse_parent = parent_transform;
+						for (int recurse_chain = (int)chain; recurse_chain >= 0; --recurse_chain)
+						{
+							stack[recurse_chain]->UpdateTransform_Parented(*recurse_parent);
+							recurse_parent = stack[recurse_chain];
+						}
 
-					if (hier_parent == nullptr)
-					{
-						// chain root reached, exit
-						break;
-					}
+						if (hier_parent == nullptr)
+						{
+							// chain root reached, exit
+							break;
+						}
 
-					// move up in the chain by one:
-					child_transform = parent_transform;
-					parent_entity = hier_parent->parentID;
-					assert(chain < (uint32_t)arraysize(stack) - 1); // if this is encountered, just extend stack array size
+						// move up in the chain by one:
+						child_transform = parent_transform;
+						parent_entity = hier_parent->parentID;
+						assert(chain < (uint32_t)arraysize(stack) - 1); // if this is encountered, just extend stack array size
 
+					}
 				}
 			}
-		}
+		});
+		wiJobSystem::Wait(ik_ctx);
 
 		if (recompute_hierarchy)
 		{
@@ -3251,38 +5138,182 @@ OPTICK_EVENT();
 			//	But this will correct them too.
 			XMMATRIX R = XMMatrixInverse(nullptr, XMLoadFloat4x4(&transform.world));
 
+			armature.gpu_bone_transforms = false;
+
+			if (armature.boneData.size() == armature.boneCollection.size() && !armature.lod_update)
+			{
+				// Between two computed poses the bones are interpolated, culled armatures keep their last pose:
+				if (!armature.lod_culled && armature.boneData_prev.size() == armature.boneData.size() && armature.boneData_next.size() == armature.boneData.size())
+				{
+					const float t = float(armature.lod_phase) / float(armature.lod_interval);
+					for (size_t i = 0; i < armature.boneData.size(); ++i)
+					{
+						const ArmatureComponent::ShaderBoneType& a = armature.boneData_prev[i];
+						const ArmatureComponent::ShaderBoneType& b = armature.boneData_next[i];
+						ArmatureComponent::ShaderBoneType& result = armature.boneData[i];
+						XMStoreFloat4(&result.pose0, XMVectorLerp(XMLoadFloat4(&a.pose0), XMLoadFloat4(&b.pose0), t));
+						XMStoreFloat4(&result.pose1, XMVectorLerp(XMLoadFloat4(&a.pose1), XMLoadFloat4(&b.pose1), t));
+						XMStoreFloat4(&result.pose2, XMVectorLerp(XMLoadFloat4(&a.pose2), XMLoadFloat4(&b.pose2), t));
+					}
+				}
+				return;
+			}
+
 			if (armature.boneData.size() != armature.boneCollection.size())
 			{
 				armature.boneData.resize(armature.boneCollection.size());
 			}
 
+			// The render data is recreated if the GPU bone transforms were switched since it was created:
+			const bool gpu_enabled = wiRenderer::GetGPUBoneTransformsEnabled();
+			if (!armature.boneBuffer.IsValid() || ((armature.boneBuffer.GetDesc().BindFlags & BIND_UNORDERED_ACCESS) != 0) != gpu_enabled)
+			{
+				armature.CreateRenderData();
+			}
+
+			// The GPU path is only used when the bones are computed in every frame, because interpolation needs the matrices on the CPU:
+			bool gpu_bone_transforms =
+				gpu_enabled &&
+				armature.lod_interval == 1 &&
+				!armature.boneCollection.empty() &&
+				armature.boneCollection.size() <= BONETRANSFORMS_COMPUTE_THREADCOUNT &&
+				armature.boneTransformBuffer.IsValid();
+
+			if (gpu_bone_transforms && (armature.boneStatics_version != hierarchy.GetStructureVersion() || armature.boneStatics.size() != armature.boneCollection.size()))
+			{
+				// The parents are searched inside the armature, bones with a parent outside of it are roots:
+				const size_t boneCount = armature.boneCollection.size();
+				wiECS::EntityLookup bone_indices;
+				for (size_t i = 0; i < boneCount; ++i)
+				{
+					bone_indices.set(armature.boneCollection[i], i);
+				}
+				armature.boneStatics.resize(boneCount);
+				for (size_t i = 0; i < boneCount; ++i)
+				{
+					ArmatureComponent::ShaderBoneType inverseBind;
+					inverseBind.Store(XMLoadFloat4x4(&armature.inverseBindMatrices[i]));
+					ShaderBoneStatic& info = armature.boneStatics[i];
+					info.inverseBind0 = inverseBind.pose0;
+					info.inverseBind1 = inverseBind.pose1;
+					info.inverseBind2 = inverseBind.pose2;
+					const HierarchyComponent* parent = hierarchy.GetComponent(armature.boneCollection[i]);
+					const size_t parent_index = parent == nullptr ? wiECS::EntityLookup::INVALID_INDEX : bone_indices.find(parent->parentID);
+					info.parent = parent_index == wiECS::EntityLookup::INVALID_INDEX ? ~0u : (uint32_t)parent_index;
+				}
+				uint32_t levels = 0;
+				for (size_t i = 0; i < boneCount; ++i)
+				{
+					ShaderBoneStatic& info = armature.boneStatics[i];
+					info.depth = 0;
+					for (uint32_t parent = info.parent; parent != ~0u && info.depth < boneCount; parent = armature.boneStatics[parent].parent)
+					{
+						info.depth++;
+					}
+					levels = std::max(levels, info.depth + 1);
+				}
+				for (ShaderBoneStatic& info : armature.boneStatics)
+				{
+					info.levels = levels;
+					info.padding = 0;
+				}
+				armature.boneStatics_version = hierarchy.GetStructureVersion();
+				armature.boneStatics_dirty = true;
+			}
+
 			XMFLOAT3 _min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
 			XMFLOAT3 _max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
 
-			int boneIndex = 0;
-			for (Entity boneEntity : armature.boneCollection)
+			armature.boneTransforms.resize(gpu_bone_transforms ? armature.boneCollection.size() : 0);
+			for (size_t i = 0; i < armature.boneCollection.size(); ++i)
 			{
+				const Entity boneEntity = armature.boneCollection[i];
 				const TransformComponent& bone = *transforms.GetComponent(boneEntity);
 
-				XMMATRIX B = XMLoadFloat4x4(&armature.inverseBindMatrices[boneIndex]);
-				XMMATRIX W = XMLoadFloat4x4(&bone.world);
-				XMMATRIX M = B * W * R;
-
-				armature.boneData[boneIndex++].Store(M);
-
 				const float bone_radius = 1;
 				XMFLOAT3 bonepos = bone.GetPosition();
 				AABB boneAABB;
 				boneAABB.createFromHalfWidth(bonepos, XMFLOAT3(bone_radius, bone_radius, bone_radius));
 				_min = wiMath::Min(_min, boneAABB._min);
 				_max = wiMath::Max(_max, boneAABB._max);
+
+				if (gpu_bone_transforms)
+				{
+					// Spring bones only modify the world matrix, so their local transform can't be used:
+					if (springs.Contains(boneEntity))
+					{
+						gpu_bone_transforms = false;
+						continue;
+					}
+
+					XMVECTOR S, Q, T;
+					if (armature.boneStatics[i].parent == ~0u)
+					{
+						// Root bones are relative to the armature:
+						XMMatrixDecompose(&S, &Q, &T, XMLoadFloat4x4(&bone.world) * R);
+					}
+					else
+					{
+						S = XMLoadFloat3(&bone.scale_local);
+						Q = XMLoadFloat4(&bone.rotation_local);
+						T = XMLoadFloat3(&bone.translation_local);
+					}
+
+					XMFLOAT3 scale;
+					XMStoreFloat3(&scale, S);
+					const float tolerance = 0.001f * std::abs(scale.x);
+					if (std::abs(scale.x - scale.y) > tolerance || std::abs(scale.x - scale.z) > tolerance)
+					{
+						// Non-uniform scaling is not supported by the compact format:
+						gpu_bone_transforms = false;
+						continue;
+					}
+
+					XMFLOAT4 rotation;
+					XMStoreFloat4(&rotation, XMQuaternionNormalize(Q));
+					ShaderBoneTransform& packed = armature.boneTransforms[i];
+					packed.rotation.x = uint32_t(XMConvertFloatToHalf(rotation.x)) | (uint32_t(XMConvertFloatToHalf(rotation.y)) << 16u);
+					packed.rotation.y = uint32_t(XMConvertFloatToHalf(rotation.z)) | (uint32_t(XMConvertFloatToHalf(rotation.w)) << 16u);
+					XMStoreFloat3(&packed.translation, T);
+					packed.scale = scale.x;
+				}
 			}
 
 			armature.aabb = AABB(_min, _max);
+			armature.gpu_bone_transforms = gpu_bone_transforms;
 
-			if (!armature.boneBuffer.IsValid())
+			if (!gpu_bone_transforms)
 			{
-				armature.CreateRenderData();
+				for (size_t i = 0; i < armature.boneCollection.size(); ++i)
+				{
+					const TransformComponent& bone = *transforms.GetComponent(armature.boneCollection[i]);
+
+					XMMATRIX B = XMLoadFloat4x4(&armature.inverseBindMatrices[i]);
+					XMMATRIX W = XMLoadFloat4x4(&bone.world);
+					XMMATRIX M = B * W * R;
+
+					armature.boneData[i].Store(M);
+				}
+			}
+
+			if (armature.lod_interval > 1)
+			{
+				// The displayed pose is one interval behind the computed one, so that the frames in between can be interpolated:
+				if (armature.boneData_next.size() == armature.boneData.size())
+				{
+					armature.boneData_prev = armature.boneData_next;
+				}
+				else
+				{
+					armature.boneData_prev = armature.boneData;
+				}
+				armature.boneData_next = armature.boneData;
+				armature.boneData = armature.boneData_prev;
+			}
+			else if (!armature.boneData_next.empty())
+			{
+				armature.boneData_prev.clear();
+				armature.boneData_next.clear();
 			}
 		});
 	}
@@ -3293,12 +5324,55 @@ OPTICK_EVENT();
 		OPTICK_EVENT();
 #endif
 #endif
-		wiJobSystem::Dispatch(ctx, (uint32_t)meshes.GetCount(), small_subtask_groupsize, [&](wiJobArgs args) {
+		// The meshes that release their CPU side data keep the geometry if the physics or hair particles use it:
+		auto release_cpu_data = [this](const MeshComponent& mesh) {
+			return !mesh.IsCPUDataReleased() && (mesh.IsReleaseCPUData() || (flags & RELEASE_MESH_CPU_DATA)) && mesh.vertexBuffer_POS.IsValid();
+		};
+		std::unordered_set<Entity> geometry_used;
+		for (size_t i = 0; i < meshes.GetCount(); ++i)
+		{
+			if (release_cpu_data(meshes[i]))
+			{
+				for (size_t j = 0; j < rigidbodies.GetCount(); ++j)
+				{
+					const ObjectComponent* object = objects.GetComponent(rigidbodies.GetEntity(j));
+					if (object != nullptr)
+					{
+						geometry_used.insert(object->meshID);
+					}
+				}
+#ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
+				for (size_t j = 0; j < softbodies.GetCount(); ++j)
+				{
+					geometry_used.insert(softbodies.GetEntity(j));
+				}
+#endif
+				for (size_t j = 0; j < hairs.GetCount(); ++j)
+				{
+					geometry_used.insert(hairs[j].meshID);
+				}
+				break;
+			}
+		}
 
-			Entity entity = meshes.GetEntity(args.jobIndex);
-			MeshComponent& mesh = meshes[args.jobIndex];
+		static wiJobSystem::GrainSize grain;
+		wiJobSystem::ParallelFor(ctx, (uint32_t)meshes.GetCount(), grain, [&](uint32_t mesh_index) {
+
+			Entity entity = meshes.GetEntity(mesh_index);
+			MeshComponent& mesh = meshes[mesh_index];
 			GraphicsDevice* device = wiRenderer::GetDevice();
 
+			if (release_cpu_data(mesh))
+			{
+				mesh.ReleaseCPUData((flags & KEEP_MESH_GEOMETRY) || geometry_used.count(entity) > 0);
+			}
+
+			if (mesh.bvh_requested)
+			{
+				mesh.bvh_requested = false;
+				mesh.BuildBVH();
+			}
+
 			if (mesh.IsSkinned() && armatures.Contains(mesh.armatureID))
 			{
 #ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
@@ -3370,10 +5444,10 @@ OPTICK_EVENT();
 						{
 				if (mesh.terrain_material1 != INVALID_ENTITY)
 				{
-					const MaterialComponent* mat = materials.GetComponent(mesh.terrain_material1);
-					if (mat != nullptr)
+					const size_t material_index = materials.GetIndex(mesh.terrain_material1);
+					if (material_index != wiECS::EntityLookup::INVALID_INDEX)
 					{
-						int index = device->GetDescriptorIndex(&mat->constantBuffer, SRV);
+						int index = (int)material_index;
 						if (mesh.terrain_material1_index != index)
 						{
 							mesh.dirty_bindless = true;
@@ -3383,10 +5457,10 @@ OPTICK_EVENT();
 				}
 				if (mesh.terrain_material2 != INVALID_ENTITY)
 						{
-					const MaterialComponent* mat = materials.GetComponent(mesh.terrain_material2);
-					if (mat != nullptr)
+					const size_t material_index = materials.GetIndex(mesh.terrain_material2);
+					if (material_index != wiECS::EntityLookup::INVALID_INDEX)
 					{
-						int index = device->GetDescriptorIndex(&mat->constantBuffer, SRV);
+						int index = (int)material_index;
 						if (mesh.terrain_material2_index != index)
 						{
 							mesh.dirty_bindless = true;
@@ -3396,10 +5470,10 @@ OPTICK_EVENT();
 				}
 				if (mesh.terrain_material3 != INVALID_ENTITY)
 				{
-					const MaterialComponent* mat = materials.GetComponent(mesh.terrain_material3);
-					if (mat != nullptr)
+					const size_t material_index = materials.GetIndex(mesh.terrain_material3);
+					if (material_index != wiECS::EntityLookup::INVALID_INDEX)
 					{
-						int index = device->GetDescriptorIndex(&mat->constantBuffer, SRV);
+						int index = (int)material_index;
 						if (mesh.terrain_material3_index != index)
 						{
 							mesh.dirty_bindless = true;
@@ -3412,31 +5486,29 @@ OPTICK_EVENT();
 			// Update morph targets if needed:
 			if (mesh.dirty_morph && !mesh.targets.empty())
 			{
-			    XMFLOAT3 _min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
-			    XMFLOAT3 _max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+				// Only the vertices that are moved by a morph target are recomputed, the others keep their base attributes:
+			    XMFLOAT3 _min = mesh.morph_static_aabb._min;
+			    XMFLOAT3 _max = mesh.morph_static_aabb._max;
 
-			    for (size_t i = 0; i < mesh.vertex_positions.size(); ++i)
+				for (const ShaderMorphVertex& vertex : mesh.morph_vertices)
 			    {
-					XMFLOAT3 pos = mesh.vertex_positions[i];
-					XMFLOAT3 nor = mesh.vertex_normals.empty() ? XMFLOAT3(1, 1, 1) : mesh.vertex_normals[i];
-					const uint8_t wind = mesh.vertex_windweights.empty() ? 0xFF : mesh.vertex_windweights[i];
+					XMFLOAT3 pos = vertex.position;
+					XMFLOAT3 nor = vertex.normal;
 
-					for (const MeshComponent::MeshMorphTarget& target : mesh.targets)
+					for (uint32_t j = vertex.deltaOffset; j < vertex.deltaOffset + vertex.deltaCount; ++j)
 					{
-						pos.x += target.weight * target.vertex_positions[i].x;
-						pos.y += target.weight * target.vertex_positions[i].y;
-						pos.z += target.weight * target.vertex_positions[i].z;
-
-						if (!target.vertex_normals.empty())
-						{
-							nor.x += target.weight * target.vertex_normals[i].x;
-							nor.y += target.weight * target.vertex_normals[i].y;
-							nor.z += target.weight * target.vertex_normals[i].z;
-						}
+						const ShaderMorphDelta& delta = mesh.morph_deltas[j];
+						const float weight = mesh.targets[delta.target].weight;
+						pos.x += weight * delta.position.x;
+						pos.y += weight * delta.position.y;
+						pos.z += weight * delta.position.z;
+						nor.x += weight * delta.normal.x;
+						nor.y += weight * delta.normal.y;
+						nor.z += weight * delta.normal.z;
 					}
 
 					XMStoreFloat3(&nor, XMVector3Normalize(XMLoadFloat3(&nor)));
-					mesh.vertex_positions_morphed[i].FromFULL(pos, nor, wind);
+					mesh.vertex_positions_morphed[vertex.vertex].FromFULL(pos, nor, (uint8_t)vertex.wind);
 
 					_min = wiMath::Min(_min, pos);
 					_max = wiMath::Max(_max, pos);
@@ -3454,10 +5526,11 @@ OPTICK_EVENT();
 		OPTICK_EVENT();
 #endif
 #endif
-		wiJobSystem::Dispatch(ctx, (uint32_t)materials.GetCount(), small_subtask_groupsize, [&](wiJobArgs args) {
+		static wiJobSystem::GrainSize grain;
+		wiJobSystem::ParallelFor(ctx, (uint32_t)materials.GetCount(), grain, [&](uint32_t index) {
 
-			MaterialComponent& material = materials[args.jobIndex];
-			Entity entity = materials.GetEntity(args.jobIndex);
+			MaterialComponent& material = materials[index];
+			Entity entity = materials.GetEntity(index);
 			const LayerComponent* layer = layers.GetComponent(entity);
 			if (layer != nullptr)
 			{
@@ -3467,6 +5540,7 @@ OPTICK_EVENT();
 			if (!material.constantBuffer.IsValid())
 			{
 				material.CreateRenderData();
+				material.dirty_buffer = true; // new entry of the material table
 			}
 
 			material.texAnimElapsedTime += dt * material.texAnimFrameRate;
@@ -3493,6 +5567,10 @@ OPTICK_EVENT();
 
 		});
 	}
+	void Scene::SetImpostorCapacity(uint32_t count)
+	{
+		impostorNewCapacity = std::min(std::max(1u, count), impostorCapacityMax);
+	}
 	void Scene::RunImpostorUpdateSystem(wiJobSystem::context& ctx)
 	{
 #ifdef GGREDUCED
@@ -3500,8 +5578,20 @@ OPTICK_EVENT();
 		OPTICK_EVENT();
 #endif
 #endif
-		if (impostors.GetCount() > 0 && !impostorArray.IsValid())
+		if (impostors.GetCount() > 0 && (!impostorArray.IsValid() || impostorNewCapacity != impostorCapacity))
 		{
+			impostorCapacity = impostorNewCapacity;
+
+			// The contents are lost, so every impostor takes a new slot and is captured again:
+			impostorSlots.clear();
+			impostorSlots.resize(impostorCapacity, INVALID_ENTITY);
+			for (size_t i = 0; i < impostors.GetCount(); ++i)
+			{
+				ImpostorComponent& impostor = impostors[i];
+				impostor.textureIndex = -1;
+				impostor.ready = false;
+			}
+
 			GraphicsDevice* device = wiRenderer::GetDevice();
 
 			TextureDesc desc;
@@ -3516,13 +5606,14 @@ OPTICK_EVENT();
 			device->SetName(&impostorDepthStencil, "impostorDepthStencil");
 
 			desc.BindFlags = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
-			desc.ArraySize = maxImpostorCount * impostorCaptureAngles * 3;
+			desc.ArraySize = impostorCapacity * 3;
 			desc.Format = FORMAT_R8G8B8A8_UNORM;
 			desc.layout = IMAGE_LAYOUT_SHADER_RESOURCE;
 
 			device->CreateTexture(&desc, nullptr, &impostorArray);
 			device->SetName(&impostorArray, "impostorArray");
 
+			renderpasses_impostor.clear();
 			renderpasses_impostor.resize(desc.ArraySize);
 
 			for (uint32_t i = 0; i < desc.ArraySize; ++i)
@@ -3552,17 +5643,81 @@ OPTICK_EVENT();
 			}
 		}
 
-		wiJobSystem::Dispatch(ctx, (uint32_t)impostors.GetCount(), 1, [&](wiJobArgs args) {
-
-			ImpostorComponent& impostor = impostors[args.jobIndex];
-			impostor.aabb = AABB();
-			impostor.instanceMatrices.clear();
+		// Reconstruct the atlas slot ownership, slots of removed impostors become free, and impostors that were merged from an other scene lose their slot:
+		impostorUpdateCounter++;
+		std::fill(impostorSlots.begin(), impostorSlots.end(), INVALID_ENTITY);
+		for (size_t i = 0; i < impostors.GetCount(); ++i)
+		{
+			ImpostorComponent& impostor = impostors[i];
+			if (impostor.textureIndex >= 0 && impostor.textureIndex < (int)impostorSlots.size() && impostorSlots[impostor.textureIndex] == INVALID_ENTITY)
+			{
+				impostorSlots[impostor.textureIndex] = impostors.GetEntity(i);
+			}
+			else
+			{
+				impostor.textureIndex = -1;
+				impostor.ready = false;
+			}
 
 			if (impostor.IsDirty())
 			{
 				impostor.SetDirty(false);
 				impostor.render_dirty = true;
 			}
+			if (impostor.requested)
+			{
+				impostor.lastUsed = impostorUpdateCounter;
+			}
+		}
+
+		// Requested impostors without slot take a free slot, or the slot of the least recently used impostor that was not requested now:
+		for (size_t i = 0; i < impostors.GetCount(); ++i)
+		{
+			ImpostorComponent& impostor = impostors[i];
+			if (!impostor.requested || impostor.textureIndex >= 0)
+			{
+				continue;
+			}
+
+			int slot = -1;
+			uint64_t oldest = impostorUpdateCounter;
+			for (int j = 0; j < (int)impostorSlots.size(); ++j)
+			{
+				if (impostorSlots[j] == INVALID_ENTITY)
+				{
+					slot = j;
+					break;
+				}
+				const ImpostorComponent* owner = impostors.GetComponent(impostorSlots[j]);
+				if (owner->lastUsed < oldest)
+				{
+					oldest = owner->lastUsed;
+					slot = j;
+				}
+			}
+			if (slot < 0)
+			{
+				break; // every slot is used by requested impostors
+			}
+
+			if (impostorSlots[slot] != INVALID_ENTITY)
+			{
+				ImpostorComponent* evicted = impostors.GetComponent(impostorSlots[slot]);
+				evicted->textureIndex = -1;
+				evicted->ready = false;
+			}
+			impostorSlots[slot] = impostors.GetEntity(i);
+			impostor.textureIndex = slot;
+			impostor.ready = false;
+			impostor.render_dirty = true;
+		}
+
+		wiJobSystem::Dispatch(ctx, (uint32_t)impostors.GetCount(), 1, [&](wiJobArgs args) {
+
+			ImpostorComponent& impostor = impostors[args.jobIndex];
+			impostor.aabb = AABB();
+			impostor.instanceMatrices.clear();
+			impostor.requested = false;
 		});
 	}
 	void Scene::RunObjectUpdateSystem(wiJobSystem::context& ctx)
@@ -3575,15 +5730,26 @@ OPTICK_EVENT();
 		assert(objects.GetCount() == aabb_objects.GetCount());
 
 		lightmap_rects.resize(objects.GetCount());
+		lightmap_rect_entities.resize(objects.GetCount());
 		lightmap_rect_allocator.store(0);
 
 		parallel_bounds.clear();
 		parallel_bounds.resize((size_t)wiJobSystem::DispatchGroupCount((uint32_t)objects.GetCount(), small_subtask_groupsize));
+
+		// Objects that were reported changed (objects.MarkChanged()) since the last update are always recomputed:
+		const uint64_t objects_since = object_update_version;
+		object_update_version = objects.AdvanceVersion();
 		
-		wiJobSystem::Dispatch(ctx, (uint32_t)objects.GetCount(), small_subtask_groupsize, [&](wiJobArgs args) {
+		// Camera for the mesh LOD selection and texture streaming:
+		const float lod_tanHalfFov = std::tan(GetCamera().fov * 0.5f);
+		const XMFLOAT3 lod_eye = GetCamera().Eye;
+		const float streaming_halfHeight = std::max(1.0f, GetCamera().height * 0.5f);
+
+		wiJobSystem::Dispatch(ctx, (uint32_t)objects.GetCount(), small_subtask_groupsize, [&, objects_since, lod_tanHalfFov, lod_eye, streaming_halfHeight](wiJobArgs args) {
 
 			ObjectComponent& object = objects[args.jobIndex];
 			AABB& aabb = aabb_objects[args.jobIndex];
+			object.hlod_culled = false; // set again by RunHLODUpdateSystem() for the objects of the cells
 
 #ifdef GGREDUCED
 			//PE: LOD
@@ -3597,7 +5763,7 @@ OPTICK_EVENT();
 			//}
 #endif
 			// Update occlusion culling status:
-			if (!wiRenderer::GetFreezeCullingCameraEnabled())
+			if (!wiRenderer::GetFreezeCullingCameraEnabled() && !wiRenderer::GetOcclusionCullingHiZEnabled())
 			{
 #ifdef GGREDUCED
 				if (bEnableObjectCulling)
@@ -3625,8 +5791,10 @@ OPTICK_EVENT();
 #endif
 			}
 
+			const AABB prev_aabb = aabb;
 			aabb = AABB();
 			object.rendertypeMask = 0;
+			object.texture_resolution = 0;
 			object.SetDynamic(false);
 			object.SetImpostorPlacement(false);
 			object.SetRequestPlanarReflection(false);
@@ -3649,16 +5817,40 @@ OPTICK_EVENT();
 
 					MeshComponent* mesh = &meshes[object.mesh_index]; //PE: NEWLOD
 					XMMATRIX W = XMLoadFloat4x4(&transform.world);
-					aabb = mesh->aabb.transform(W);
 
-					// This is instance bounding box matrix:
-					XMFLOAT4X4 meshMatrix;
-					XMStoreFloat4x4(&meshMatrix, mesh->aabb.getAsBoxMatrix() * W);
-
-					// We need sometimes the center of the instance bounding box, not the transform position (which can be outside the bounding box)
-					object.center = *((XMFLOAT3*)&meshMatrix._41);
+					// Static objects keep their cached bounds while the world matrix and the mesh are the same
+					//	The world matrix is compared instead of relying on transform change reports, because hierarchy, IK, springs and physics write it directly
+					const bool dynamic = mesh->IsSkinned() || mesh->IsDynamic();
+					if (!dynamic &&
+						!objects.IsChanged(args.jobIndex, objects_since) &&
+						object.cached_mesh_index == object.mesh_index &&
+						std::memcmp(&object.cached_mesh_aabb, &mesh->aabb, sizeof(AABB)) == 0 &&
+						std::memcmp(&object.cached_world, &transform.world, sizeof(XMFLOAT4X4)) == 0)
+					{
+						aabb = object.cached_aabb;
+						object.cached_frames = std::min(object.cached_frames + 1, ~0u - 1);
+					}
+					else
+					{
+						aabb = mesh->aabb.transform(W);
+
+						// This is instance bounding box matrix:
+						XMFLOAT4X4 meshMatrix;
+						XMStoreFloat4x4(&meshMatrix, mesh->aabb.getAsBoxMatrix() * W);
+
+						// We need sometimes the center of the instance bounding box, not the transform position (which can be outside the bounding box)
+						object.center = *((XMFLOAT3*)&meshMatrix._41);
+
+						// The matrix of the previous update is kept for the motion vectors, cached_world is always the last world matrix after this:
+						object.cached_world_prev = object.cached_mesh_index == ~0u ? transform.world : object.cached_world;
+						object.cached_aabb = aabb;
+						object.cached_mesh_aabb = mesh->aabb;
+						object.cached_world = transform.world;
+						object.cached_mesh_index = object.mesh_index;
+						object.cached_frames = 0;
+					}
 
-					if (mesh->IsSkinned() || mesh->IsDynamic())
+					if (dynamic)
 					{
 						object.SetDynamic(true);
 						const ArmatureComponent* armature = armatures.GetComponent(mesh->armatureID);
@@ -3668,6 +5860,14 @@ OPTICK_EVENT();
 						}
 					}
 
+					// The needed texture resolution is the count of pixels that one UV unit covers on the screen at the nearest point of the bounds:
+					if (mesh->uv_density > 0)
+					{
+						const float scale = std::sqrt(std::max(XMVectorGetX(XMVector3LengthSq(W.r[0])), std::max(XMVectorGetX(XMVector3LengthSq(W.r[1])), XMVectorGetX(XMVector3LengthSq(W.r[2])))));
+						const float distance = std::max(0.1f, wiMath::Distance(aabb.getCenter(), lod_eye) - aabb.getRadius());
+						object.texture_resolution = streaming_halfHeight * scale / (distance * lod_tanHalfFov * mesh->uv_density);
+					}
+
 					//PE: NEWLOD select lod object.
 					if (mesh->lodlevels > 0)
 					{
@@ -3675,7 +5875,29 @@ OPTICK_EVENT();
 						float length_between_lod = 200.0f * fLODMultiplier;
 						float dist = object.GetCameraDistance();
 						int active_lod = object.forcelod;
-						if (object.forcelod == 0)
+						if (object.forcelod == 0 && mesh_lod.enabled && mesh->subsets.size() > 1 && mesh->subsets[1].lod_error > 0)
+						{
+							// Generated LOD levels are selected by their projected error:
+							const float scale = std::sqrt(std::max(XMVectorGetX(XMVector3LengthSq(W.r[0])), std::max(XMVectorGetX(XMVector3LengthSq(W.r[1])), XMVectorGetX(XMVector3LengthSq(W.r[2])))));
+							const float distance = wiMath::Distance(aabb.getCenter(), lod_eye);
+							const float error_to_screen = scale / std::max(0.001f, distance * lod_tanHalfFov);
+							const uint32_t lod_count = std::min((uint32_t)mesh->subsets.size(), mesh->lodlevels + 1);
+							active_lod = 0;
+							for (uint32_t lod = 1; lod < lod_count; ++lod)
+							{
+								float threshold = mesh_lod.max_screen_error;
+								if (lod > object.activelod)
+								{
+									threshold *= mesh_lod.hysteresis;
+								}
+								if (mesh->subsets[lod].lod_error * error_to_screen >= threshold)
+								{
+									break;
+								}
+								active_lod = (int)lod;
+							}
+						}
+						else if (object.forcelod == 0)
 						{
 							if (mesh->subsets.size() > 1 && mesh->lodlevels >= 1 && dist > (length_between_lod * 2))
 								active_lod = 1;
@@ -3723,7 +5945,13 @@ OPTICK_EVENT();
 					}
 
 					ImpostorComponent* impostor = impostors.GetComponent(object.meshID);
-					if (impostor != nullptr)
+					if (impostor != nullptr && wiMath::Distance(lod_eye, aabb.getCenter()) > impostor->swapInDistance - aabb.getRadius())
+					{
+						locker.lock();
+						impostor->requested = true;
+						locker.unlock();
+					}
+					if (impostor != nullptr && impostor->ready)
 					{
 						object.SetImpostorPlacement(true);
 						object.impostorSwapDistance = impostor->swapInDistance;
@@ -3760,8 +5988,41 @@ OPTICK_EVENT();
 							softbody->CreateFromMesh(*mesh);
 						}
 
-						// simulation aabb will be used for soft bodies
-						aabb = softbody->aabb;
+						if (softbody->IsGPUSimulation())
+						{
+							if (!softbody->clothParticleBuffer.IsValid())
+							{
+								softbody->CreateGPUSimulationData(*mesh);
+							}
+
+							// The physics engine creates the deformed vertex buffers for the soft bodies that it simulates, these are written by compute shaders:
+							if ((!mesh->vertexBuffer_PRE.IsValid() || (mesh->streamoutBuffer_POS.desc.BindFlags & BIND_UNORDERED_ACCESS) == 0) && mesh->vertexBuffer_POS.IsValid())
+							{
+								GraphicsDevice* device = wiRenderer::GetDevice();
+								GPUBufferDesc desc = mesh->vertexBuffer_POS.desc;
+								desc.BindFlags |= BIND_UNORDERED_ACCESS;
+								device->CreateBuffer(&desc, nullptr, &mesh->streamoutBuffer_POS);
+								device->CreateBuffer(&desc, nullptr, &mesh->vertexBuffer_PRE);
+								if (mesh->vertexBuffer_TAN.IsValid())
+								{
+									desc = mesh->vertexBuffer_TAN.desc;
+									desc.BindFlags |= BIND_UNORDERED_ACCESS;
+									device->CreateBuffer(&desc, nullptr, &mesh->streamoutBuffer_TAN);
+								}
+								mesh->dirty_bindless = true;
+							}
+							mesh->SetDynamic(true);
+
+							// The simulated vertices stay on the GPU, the animated bounds are enlarged by the size of the cloth, which is the farthest that it can swing away:
+							const float size = softbody->aabb.getRadius() * 2;
+							const XMFLOAT3 halfwidth = aabb.getHalfWidth();
+							aabb.createFromHalfWidth(aabb.getCenter(), XMFLOAT3(halfwidth.x + size, halfwidth.y + size, halfwidth.z + size));
+						}
+						else
+						{
+							// simulation aabb will be used for soft bodies
+							aabb = softbody->aabb;
+						}
 
 						// soft bodies have no transform, their vertices are simulated in world space
 						object.transform_index = -1;
@@ -3790,8 +6051,17 @@ OPTICK_EVENT();
 							instance.Flags = RaytracingAccelerationStructureDesc::TopLevel::Instance::FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE;
 						}
 
-						void* dest = (void*)((size_t)TLAS_instances.data() + (size_t)args.jobIndex * device->GetTopLevelAccelerationStructureInstanceSize());
-						device->WriteTopLevelAccelerationStructureInstance(&instance, dest);
+						// Only the changed instances are written, so the TLAS doesn't need to be rebuilt for a static scene:
+						const size_t instance_size = device->GetTopLevelAccelerationStructureInstanceSize();
+						uint8_t instance_data[128];
+						assert(instance_size <= sizeof(instance_data));
+						device->WriteTopLevelAccelerationStructureInstance(&instance, instance_data);
+						void* dest = (void*)((size_t)TLAS_instances.data() + (size_t)args.jobIndex * instance_size);
+						if (std::memcmp(dest, instance_data, instance_size) != 0)
+						{
+							std::memcpy(dest, instance_data, instance_size);
+							TLAS_instances_changed.store(true);
+						}
 					}
 
 					// lightmap things:
@@ -3815,9 +6085,20 @@ OPTICK_EVENT();
 								//	But the global atlas will have less precision for good bandwidth for sampling
 								desc.Format = FORMAT_R32G32B32A32_FLOAT;
 
+								// An unfinished bake that was checkpointed into lightmapTextureData continues accumulating from the stored samples:
+								const bool resume = object.lightmapIterationCount > 0 && object.lightmapTextureData.size() == (size_t)desc.Width * (size_t)desc.Height * sizeof(XMFLOAT4);
+								SubresourceData initdata;
+								initdata.pSysMem = object.lightmapTextureData.data();
+								initdata.SysMemPitch = desc.Width * sizeof(XMFLOAT4);
+
 								GraphicsDevice* device = wiRenderer::GetDevice();
-								device->CreateTexture(&desc, nullptr, &object.lightmap);
+								device->CreateTexture(&desc, resume ? &initdata : nullptr, &object.lightmap);
 								device->SetName(&object.lightmap, "object.lightmap");
+								if (!resume)
+								{
+									object.lightmapIterationCount = 0;
+									object.lightmapBakeSignature = ComputeLightmapBakeSignature(object);
+								}
 
 								RenderPassDesc renderpassdesc;
 
@@ -3841,13 +6122,21 @@ OPTICK_EVENT();
 						{
 							if (object.lightmap_rect.w == 0)
 							{
-								// we need to pack this lightmap texture into the atlas
-								object.lightmap_rect = wiRectPacker::rect_xywh(0, 0, object.lightmap.GetDesc().Width + atlasClampBorder * 2, object.lightmap.GetDesc().Height + atlasClampBorder * 2);
-								lightmap_repack_needed.store(true); // will need to repack all in this case!
+								// we need to pack this lightmap texture into the atlas, it is placed after the object update (negative position until then)
+								object.lightmap_rect = wiRectPacker::rect_xywh(-1, -1, object.lightmap.GetDesc().Width + atlasClampBorder * 2, object.lightmap.GetDesc().Height + atlasClampBorder * 2);
+								lightmap_insert_needed.store(true);
+							}
+							else if (object.lightmap_rect.x >= 0 && lightmapAtlasSpace.width > 0 && lightmap_placed.count(entity) == 0)
+							{
+								// the rect is not in the atlas space (for example it was copied with a duplicated object), so it gets its own place:
+								object.lightmap_rect.x = -1;
+								object.lightmap_rect.y = -1;
+								lightmap_insert_needed.store(true);
 							}
 							// lightmap rects' state is always updated, in case one needs repacking
 							uint32_t alloc = lightmap_rect_allocator.fetch_add(1);
 							lightmap_rects[alloc] = &object.lightmap_rect;
+							lightmap_rect_entities[alloc] = entity;
 						}
 					}
 				}
@@ -3874,18 +6163,80 @@ OPTICK_EVENT();
 				}
 				if (args.isLastJobInGroup)
 				{
-					parallel_bounds[args.groupID] = *shared_bounds;
+					parallel_bounds[args.groupID] = *shared_bounds;
+				}
+			}
+
+			// Bounds that differ from the last frame are reported, so the object BVH can skip refitting for a static scene:
+			if (std::memcmp(&aabb._min, &prev_aabb._min, sizeof(XMFLOAT3)) != 0 || std::memcmp(&aabb._max, &prev_aabb._max, sizeof(XMFLOAT3)) != 0)
+			{
+				aabb_objects.MarkChanged(args.jobIndex);
+			}
+
+		}, sizeof(AABB));
+	}
+	void Scene::RunHLODUpdateSystem(wiJobSystem::context& ctx)
+	{
+#ifdef GGREDUCED
+#ifdef OPTICK_ENABLE
+		OPTICK_EVENT();
+#endif
+#endif
+		// The cells are swapped by the distance of their bounds from the main camera, so a cell switches as a whole without gaps between the proxy and the children:
+		const XMVECTOR eye = XMLoadFloat3(&GetCamera().Eye);
+
+		wiJobSystem::Dispatch(ctx, (uint32_t)hlods.GetCount(), 16, [&, eye](wiJobArgs args) {
+
+			HierarchicalLODComponent& hlod = hlods[args.jobIndex];
+			hlod.aabb = AABB();
+			for (Entity child : hlod.children)
+			{
+				const size_t index = objects.GetIndex(child);
+				if (index != wiECS::EntityLookup::INVALID_INDEX)
+				{
+					hlod.aabb = AABB::Merge(hlod.aabb, aabb_objects[index]);
+				}
+			}
+
+			const size_t proxy_index = objects.GetIndex(hlod.proxyID);
+			if (proxy_index == wiECS::EntityLookup::INVALID_INDEX)
+			{
+				hlod.active = false;
+				return;
+			}
+
+			// A cell without the children objects only draws its proxy:
+			if (hlod.aabb._min.x <= hlod.aabb._max.x)
+			{
+				const XMVECTOR nearest = XMVectorClamp(eye, XMLoadFloat3(&hlod.aabb._min), XMLoadFloat3(&hlod.aabb._max));
+				hlod.active = XMVectorGetX(XMVector3Length(eye - nearest)) > hlod.swapDistance;
+			}
+			else
+			{
+				hlod.active = true;
+			}
+
+			objects[proxy_index].hlod_culled = !hlod.active;
+			if (hlod.active)
+			{
+				for (Entity child : hlod.children)
+				{
+					ObjectComponent* object = objects.GetComponent(child);
+					if (object != nullptr)
+					{
+						object->hlod_culled = true;
+					}
 				}
 			}
-
-		}, sizeof(AABB));
+		});
 	}
 	void Scene::RunCameraUpdateSystem(wiJobSystem::context& ctx)
 	{
-		wiJobSystem::Dispatch(ctx, (uint32_t)cameras.GetCount(), small_subtask_groupsize, [&](wiJobArgs args) {
+		static wiJobSystem::GrainSize grain;
+		wiJobSystem::ParallelFor(ctx, (uint32_t)cameras.GetCount(), grain, [&](uint32_t index) {
 
-			CameraComponent& camera = cameras[args.jobIndex];
-			Entity entity = cameras.GetEntity(args.jobIndex);
+			CameraComponent& camera = cameras[index];
+			Entity entity = cameras.GetEntity(index);
 			const TransformComponent* transform = transforms.GetComponent(entity);
 			if (transform != nullptr)
 			{
@@ -3903,6 +6254,9 @@ OPTICK_EVENT();
 #endif
 		assert(decals.GetCount() == aabb_decals.GetCount());
 
+		const bool bindless = wiRenderer::GetDevice()->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS);
+		std::unordered_set<const wiResource*> usedDecalTextures;
+
 		for (size_t i = 0; i < decals.GetCount(); ++i)
 		{
 			DecalComponent& decal = decals[i];
@@ -3943,18 +6297,46 @@ OPTICK_EVENT();
 			decal.normal = material.textures[MaterialComponent::NORMALMAP].resource;
 
 			// atlas part is not thread safe:
-			if (decal.texture != nullptr && decal.texture->texture.IsValid())
+			if (!bindless && decal.texture != nullptr && decal.texture->texture.IsValid())
 			{
 				if (packedDecals.find(decal.texture) == packedDecals.end())
 				{
-					// we need to pack this decal texture into the atlas
+					// we need to pack this decal texture into the atlas, if there is room then only this will be copied:
 					wiRectPacker::rect_xywh newRect = wiRectPacker::rect_xywh(0, 0, decal.texture->texture.desc.Width + atlasClampBorder * 2, decal.texture->texture.desc.Height + atlasClampBorder * 2);
+					if (!decal_repack_needed && decalAtlas.IsValid() && decalAtlasSpace.insert(newRect))
+					{
+						decal_copies_pending.push_back(decal.texture);
+					}
+					else
+					{
+						decal_repack_needed = true;
+					}
 					packedDecals[decal.texture] = newRect;
-					decal_repack_needed = true;
-	}
+				}
+				usedDecalTextures.insert(decal.texture.get());
+			}
+		}
+
+		// Textures that are not used by decals anymore give back their atlas space:
+		for (auto it = packedDecals.begin(); it != packedDecals.end();)
+		{
+			if (usedDecalTextures.count(it->first.get()) == 0)
+			{
+				decalAtlasSpace.remove(it->second);
+				decal_copies_pending.erase(std::remove(decal_copies_pending.begin(), decal_copies_pending.end(), it->first), decal_copies_pending.end());
+				it = packedDecals.erase(it);
+			}
+			else
+			{
+				++it;
 			}
 		}
 	}
+	void Scene::SetEnvProbeArray(uint32_t count, uint32_t resolution)
+	{
+		envmapNewCount = std::min(std::max(1u, count), envmapCountMax);
+		envmapNewRes = wiMath::GetNextPowerOfTwo(std::max(1u, resolution));
+	}
 	void Scene::RunProbeUpdateSystem(wiJobSystem::context& ctx)
 	{
 #ifdef GGREDUCED
@@ -3964,14 +6346,19 @@ OPTICK_EVENT();
 #endif
 		assert(probes.GetCount() == aabb_probes.GetCount());
 
-#ifdef GGREDUCED
-		if (!envmapArray.IsValid() || envmapNewRes != envmapRes) // even when zero probes, this will be created, since sometimes only the sky will be rendered into it
+		if (!envmapArray.IsValid() || envmapNewCount != envmapCount || envmapNewRes != envmapRes) // even when zero probes, this will be created, since sometimes only the sky will be rendered into it
 		{
+			envmapCount = envmapNewCount;
 			envmapRes = envmapNewRes;
-#else
-		if (!envmapArray.IsValid()) // even when zero probes, this will be created, since sometimes only the sky will be rendered into it
-		{
-#endif
+
+			// The contents are lost, so every probe takes a new slot and is rendered again:
+			for (size_t i = 0; i < probes.GetCount(); ++i)
+			{
+				EnvironmentProbeComponent& probe = probes[i];
+				probe.textureIndex = -1;
+				probe.SetDirty();
+			}
+
 			GraphicsDevice* device = wiRenderer::GetDevice();
 
 			TextureDesc desc;
@@ -3995,7 +6382,11 @@ OPTICK_EVENT();
 			desc.Format = FORMAT_R11G11B10_FLOAT;
 			desc.Height = envmapRes;
 			desc.Width = envmapRes;
-			desc.MipLevels = envmapMIPs;
+			desc.MipLevels = 1;
+			while (desc.MipLevels < envmapMIPs && (envmapRes >> desc.MipLevels) > 0)
+			{
+				desc.MipLevels++;
+			}
 			desc.MiscFlags = RESOURCE_MISC_TEXTURECUBE;
 			desc.Usage = USAGE_DEFAULT;
 			desc.layout = IMAGE_LAYOUT_SHADER_RESOURCE;
@@ -4004,6 +6395,7 @@ OPTICK_EVENT();
 			device->SetName(&envmapArray, "envmapArray");
 
 			renderpasses_envmap.resize(envmapCount);
+			renderpasses_envmap_load.resize(envmapCount);
 
 			for (uint32_t i = 0; i < envmapCount; ++i)
 			{
@@ -4028,6 +6420,9 @@ OPTICK_EVENT();
 				);
 
 				device->CreateRenderPass(&renderpassdesc, &renderpasses_envmap[subresource_index]);
+
+				renderpassdesc.attachments[0].loadop = RenderPassAttachment::LOADOP_LOAD;
+				device->CreateRenderPass(&renderpassdesc, &renderpasses_envmap_load[subresource_index]);
 			}
 			for (uint32_t i = 0; i < envmapArray.desc.MipLevels; ++i)
 			{
@@ -4048,11 +6443,11 @@ OPTICK_EVENT();
 		}
 
 		// reconstruct envmap array status:
-		bool envmapTaken[envmapCount] = {};
+		bool envmapTaken[envmapCountMax] = {};
 		for (size_t i = 0; i < probes.GetCount(); ++i)
 		{
 			EnvironmentProbeComponent& probe = probes[i];
-			if (probe.textureIndex >= 0 && probe.textureIndex < envmapCount)
+			if (probe.textureIndex >= 0 && probe.textureIndex < (int)envmapCount)
 			{
 				envmapTaken[probe.textureIndex] = true;
 			}
@@ -4062,11 +6457,9 @@ OPTICK_EVENT();
 			}
 		}
 
-		for (size_t probeIndex = 0; probeIndex < probes.GetCount(); ++probeIndex)
-		{
-			EnvironmentProbeComponent& probe = probes[probeIndex];
-			Entity entity = probes.GetEntity(probeIndex);
-			const TransformComponent& transform = *transforms.GetComponent(entity);
+		view_probes.Each([&](size_t probeIndex, EnvironmentProbeComponent& probe, const TransformComponent* transform_probe, const LayerComponent* layer) {
+
+			const TransformComponent& transform = *transform_probe;
 
 			probe.position = transform.GetPosition();
 
@@ -4083,11 +6476,10 @@ OPTICK_EVENT();
 			aabb.createFromHalfWidth(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1));
 			aabb = aabb.transform(transform.world);
 
-			const LayerComponent* layer = layers.GetComponent(entity);
 			if (layer == nullptr)
 			{
 				aabb.layerMask = ~0;
-	}
+			}
 			else
 			{
 				aabb.layerMask = layer->GetLayerMask();
@@ -4103,7 +6495,7 @@ OPTICK_EVENT();
 			{
 				// need to take a free envmap texture slot:
 				bool found = false;
-				for (int i = 0; i < arraysize(envmapTaken); ++i)
+				for (int i = 0; i < (int)envmapCount; ++i)
 				{
 					if (envmapTaken[i] == false)
 					{
@@ -4114,14 +6506,15 @@ OPTICK_EVENT();
 					}
 				}
 			}
-		}
+		});
 	}
 	void Scene::RunForceUpdateSystem(wiJobSystem::context& ctx)
 	{
-		wiJobSystem::Dispatch(ctx, (uint32_t)forces.GetCount(), small_subtask_groupsize, [&](wiJobArgs args) {
+		static wiJobSystem::GrainSize grain;
+		wiJobSystem::ParallelFor(ctx, (uint32_t)forces.GetCount(), grain, [&](uint32_t index) {
 
-			ForceFieldComponent& force = forces[args.jobIndex];
-			Entity entity = forces.GetEntity(args.jobIndex);
+			ForceFieldComponent& force = forces[index];
+			Entity entity = forces.GetEntity(index);
 			const TransformComponent& transform = *transforms.GetComponent(entity);
 
 			XMMATRIX W = XMLoadFloat4x4(&transform.world);
@@ -4145,16 +6538,15 @@ OPTICK_EVENT();
 		assert(lights.GetCount() == aabb_lights.GetCount());
 		iLightcounter++;
 
-		wiJobSystem::Dispatch(ctx, (uint32_t)lights.GetCount(), small_subtask_groupsize, [&](wiJobArgs args) {
+		view_lights.ParallelEach(ctx, small_subtask_groupsize, [&](size_t lightIndex, LightComponent& light, const TransformComponent* transform_light, const LayerComponent* layer) {
 
-			LightComponent& light = lights[args.jobIndex];
 			//light.bNotRenderedInThisframe = false;
 			//if (light.type == LightComponent::POINT)
 			//{
 			//	bool shadow = light.IsCastingShadow() && !light.IsStatic();
 			//	if (shadow)
 			//	{
-			//		if ((iLightcounter + args.jobIndex) % 10 != 0)
+			//		if ((iLightcounter + lightIndex) % 10 != 0)
 			//		{
 			//			light.bNotRenderedInThisframe = true;
 			//			//return;
@@ -4162,11 +6554,9 @@ OPTICK_EVENT();
 			//	}
 			//}
 
-			Entity entity = lights.GetEntity(args.jobIndex);
-			const TransformComponent& transform = *transforms.GetComponent(entity);
-			AABB& aabb = aabb_lights[args.jobIndex];
+			const TransformComponent& transform = *transform_light;
+			AABB& aabb = aabb_lights[lightIndex];
 
-			const LayerComponent* layer = layers.GetComponent(entity);
 			if (layer == nullptr)
 			{
 				aabb.layerMask = ~0;
@@ -4193,9 +6583,9 @@ OPTICK_EVENT();
 			case LightComponent::DIRECTIONAL:
 				aabb.createFromHalfWidth(XMFLOAT3(0, 0, 0), XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX));
 				locker.lock();
-				if (args.jobIndex < weather.most_important_light_index)
+				if (lightIndex < weather.most_important_light_index)
 				{
-					weather.most_important_light_index = args.jobIndex;
+					weather.most_important_light_index = (uint32_t)lightIndex;
 					weather.sunColor = light.color;
 					weather.sunDirection = light.direction;
 					weather.sunEnergy = light.energy;
@@ -4219,19 +6609,14 @@ OPTICK_EVENT();
 		OPTICK_EVENT();
 #endif
 #endif
-		wiJobSystem::Dispatch(ctx, (uint32_t)emitters.GetCount(), small_subtask_groupsize, [&](wiJobArgs args) {
+		view_emitters.ParallelEach(ctx, small_subtask_groupsize, [&](size_t, wiEmittedParticle& emitter, const TransformComponent* transform, const LayerComponent* layer) {
 
-			wiEmittedParticle& emitter = emitters[args.jobIndex];
-			Entity entity = emitters.GetEntity(args.jobIndex);
-
-			const LayerComponent* layer = layers.GetComponent(entity);
 			if (layer != nullptr)
 			{
 				emitter.layerMask = layer->GetLayerMask();
 			}
 
-			const TransformComponent& transform = *transforms.GetComponent(entity);
-			emitter.UpdateCPU(transform, dt);
+			emitter.UpdateCPU(*transform, meshes.GetComponent(emitter.meshID), dt);
 		});
 
 		wiJobSystem::Dispatch(ctx, (uint32_t)hairs.GetCount(), small_subtask_groupsize, [&](wiJobArgs args) {
@@ -4285,6 +6670,11 @@ OPTICK_EVENT();
 		instance3D.listenerUp = camera.Up;
 		instance3D.listenerFront = camera.At;
 
+		// The 3D sounds are updated in one batch, which is calculated in parallel:
+		std::vector<wiAudio::SoundInstance*> instances;
+		std::vector<wiAudio::SoundInstance3D> instances3D;
+		instances.reserve(sounds.GetCount());
+		instances3D.reserve(sounds.GetCount());
 		for (size_t i = 0; i < sounds.GetCount(); ++i)
 		{
 			SoundComponent& sound = sounds[i];
@@ -4296,9 +6686,17 @@ OPTICK_EVENT();
 				if (transform != nullptr)
 				{
 					instance3D.emitterPos = transform->GetPosition();
-					wiAudio::Update3D(&sound.soundinstance, instance3D);
+					instances.push_back(&sound.soundinstance);
+					instances3D.push_back(instance3D);
 				}
 			}
+		}
+		wiAudio::Update3D(instances.data(), instances3D.data(), (uint32_t)instances.size());
+
+		for (size_t i = 0; i < sounds.GetCount(); ++i)
+		{
+			SoundComponent& sound = sounds[i];
+
 			if (sound.IsPlaying())
 			{
 				wiAudio::Play(&sound.soundinstance);
@@ -4432,217 +6830,184 @@ OPTICK_EVENT();
 		return INVALID_ENTITY;
 	}
 
-	PickResult Pick(const RAY& ray, uint32_t renderTypeMask, uint32_t layerMask, const Scene& scene)
+	// Gathers the index offsets (relative to the subset, in increasing order) of the subset's triangles whose bounds can pass overlaps(const AABB&)
+	//	Without a triangle BVH every triangle of the subset is gathered
+	template<typename Overlaps>
+	static void GatherSubsetTriangles(const MeshComponent::MeshSubset& subset, const wiBVH* bvh, Overlaps overlaps, std::vector<uint32_t>& offsets)
 	{
-		PickResult result;
-
-		if (scene.objects.GetCount() > 0)
+		offsets.clear();
+		if (bvh == nullptr)
 		{
-			const XMVECTOR rayOrigin = XMLoadFloat3(&ray.origin);
-			const XMVECTOR rayDirection = XMVector3Normalize(XMLoadFloat3(&ray.direction));
-
-			/* Attempted to sort to speed things up
-//#ifdef GGREDUCED
-			// ray pick check is slow, checks ALL scene objects with no consideration of nearness to ray start
-			struct sNearItem
+			for (uint32_t i = 0; i < subset.indexCount; i += 3)
 			{
-				int iIndex;
-				float fDistance;
-			};
-			std::vector<sNearItem> nearestFirstList;
-			nearestFirstList.clear();
-			XMVECTOR origRayDir = XMLoadFloat3(&ray.direction);
-			XMVECTOR vRayLength = XMVector3Length(origRayDir);
-			for (size_t i = 0; i < scene.aabb_objects.GetCount(); ++i)
-			{
-				const AABB& aabb = scene.aabb_objects[i];
-				if (ray.intersects(aabb))
-				{
-					// add AABB if within distance of ray length
-					const XMVECTOR aabbCenter = XMLoadFloat3(&aabb.getCenter());
-					const XMVECTOR distVector = aabbCenter - rayOrigin;
-					XMVECTOR vDistance = XMVector3Length(distVector);
-					if (*vDistance.m128_f32 < *vRayLength.m128_f32)
-					{
-						sNearItem item;
-						item.iIndex = i;
-						item.fDistance = *vDistance.m128_f32;
-						nearestFirstList.push_back(item);
-					}
-				}
+				offsets.push_back(i);
 			}
-			// bubble sort all AABB boxes the ray slices through within the range of the ray
-			for (size_t j = 0; j < nearestFirstList.size(); ++j)
+			return;
+		}
+		const uint32_t firstTriangle = subset.indexOffset / 3;
+		const uint32_t lastTriangle = firstTriangle + subset.indexCount / 3;
+		bvh->Intersects(overlaps, [&](uint32_t triangle) {
+			if (triangle >= firstTriangle && triangle < lastTriangle)
 			{
-				for (size_t k = 0; k < nearestFirstList.size(); ++k)
-				{
-					if (nearestFirstList[j].iIndex != nearestFirstList[k].iIndex )
-					{
-						if (nearestFirstList[j].fDistance > nearestFirstList[k].fDistance)
-						{
-							sNearItem storej = nearestFirstList[j];
-							nearestFirstList[j] = nearestFirstList[k];
-							nearestFirstList[k] = storej;
-						}
-					}
-				}
+				offsets.push_back(triangle * 3 - subset.indexOffset);
 			}
-//#else
-*/
-			for (size_t i = 0; i < scene.aabb_objects.GetCount(); ++i)
-			{
-//#endif
-/*
-//#ifdef GGREDUCED
-			for (size_t j = 0; j < nearestFirstList.size(); ++j)
-			{
-				int i = nearestFirstList[j].iIndex;
-				const AABB& aabb = scene.aabb_objects[i];
-//#else
-*/
-				const AABB& aabb = scene.aabb_objects[i];
-				if (!ray.intersects(aabb))
-				{
-					continue;
-				}
-//#endif
+		});
+		std::sort(offsets.begin(), offsets.end());
+	}
 
-				const ObjectComponent& object = scene.objects[i];
-				if (object.meshID == INVALID_ENTITY)
-				{
-					continue;
-				}
-				if (!(renderTypeMask & object.GetRenderTypes()))
-				{
-					continue;
-				}
+	// Ray test against the triangles of one object, the result is updated if a closer hit was found
+	//	skinned_positions	:	skinned vertex positions of the object's mesh if it is skinned (optional, otherwise the vertices are skinned here)
+	static void PickObject(const RAY& ray, size_t objectIndex, uint32_t renderTypeMask, uint32_t layerMask, const Scene& scene, const XMFLOAT3* skinned_positions, PickResult& result)
+	{
+		const XMVECTOR rayOrigin = XMLoadFloat3(&ray.origin);
+		const XMVECTOR rayDirection = XMVector3Normalize(XMLoadFloat3(&ray.direction));
+
+		const ObjectComponent& object = scene.objects[objectIndex];
+		if (object.meshID == INVALID_ENTITY)
+		{
+			return;
+		}
+		if (!(renderTypeMask & object.GetRenderTypes()))
+		{
+			return;
+		}
 
 #ifdef GGREDUCED
-				if (!object.IsRenderable())
-				{
-					//PE: Do not Pick from hidden objects.
-					continue;
-				}
+		if (!object.IsRenderable())
+		{
+			//PE: Do not Pick from hidden objects.
+			return;
+		}
 #endif
-				Entity entity = scene.aabb_objects.GetEntity(i);
-				const LayerComponent* layer = scene.layers.GetComponent(entity);
-				if (layer != nullptr && !(layer->GetLayerMask() & layerMask))
-				{
-					continue;
-				}
+		Entity entity = scene.aabb_objects.GetEntity(objectIndex);
+		const LayerComponent* layer = scene.layers.GetComponent(entity);
+		if (layer != nullptr && !(layer->GetLayerMask() & layerMask))
+		{
+			return;
+		}
 
-				const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
+		const MeshComponent& mesh = *scene.meshes.GetComponent(object.meshID);
 #ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
-				const SoftBodyPhysicsComponent* softbody = scene.softbodies.GetComponent(object.meshID);
-				const bool softbody_active = softbody != nullptr && !softbody->vertex_positions_simulation.empty();
+		const SoftBodyPhysicsComponent* softbody = scene.softbodies.GetComponent(object.meshID);
+		const bool softbody_active = softbody != nullptr && !softbody->vertex_positions_simulation.empty();
 #else
-				const bool softbody_active = false;
+		const bool softbody_active = false;
 #endif
 
-				const XMMATRIX objectMat = object.transform_index >= 0 ? XMLoadFloat4x4(&scene.transforms[object.transform_index].world) : XMMatrixIdentity();
-				const XMMATRIX objectMat_Inverse = XMMatrixInverse(nullptr, objectMat);
+		const XMMATRIX objectMat = object.transform_index >= 0 ? XMLoadFloat4x4(&scene.transforms[object.transform_index].world) : XMMatrixIdentity();
+		const XMMATRIX objectMat_Inverse = XMMatrixInverse(nullptr, objectMat);
 
-				const XMVECTOR rayOrigin_local = XMVector3Transform(rayOrigin, objectMat_Inverse);
-				const XMVECTOR rayDirection_local = XMVector3Normalize(XMVector3TransformNormal(rayDirection, objectMat_Inverse));
+		const XMVECTOR rayOrigin_local = XMVector3Transform(rayOrigin, objectMat_Inverse);
+		const XMVECTOR rayDirection_local = XMVector3Normalize(XMVector3TransformNormal(rayDirection, objectMat_Inverse));
 
-				const ArmatureComponent* armature = mesh.IsSkinned() ? scene.armatures.GetComponent(mesh.armatureID) : nullptr;
+		const ArmatureComponent* armature = mesh.IsSkinned() ? scene.armatures.GetComponent(mesh.armatureID) : nullptr;
 
-				int subsetCounter = 0;
-				int count = 0;
-				int target_lod = 0;
+		const wiBVH* bvh = mesh.GetBVH();
+		const RAY ray_local = RAY(rayOrigin_local, rayDirection_local);
+		std::vector<uint32_t> triangles;
 
-				if (bRaycastLowestLOD)
-					target_lod = mesh.lodlevels;
+		int subsetCounter = 0;
+		int count = 0;
+		int target_lod = 0;
 
-				for (auto& subset : mesh.subsets)
-				{
-					if (count++ != target_lod) //PE: Always uselowest lod.
-						continue;
+		if (bRaycastLowestLOD)
+			target_lod = mesh.lodlevels;
 
-					//if (!subset.active)
-					//	continue;
+		for (auto& subset : mesh.subsets)
+		{
+			if (count++ != target_lod) //PE: Always uselowest lod.
+				continue;
 
-					for (size_t i = 0; i < subset.indexCount; i += 3)
-					{
-						const uint32_t i0 = mesh.indices[subset.indexOffset + i + 0];
-						const uint32_t i1 = mesh.indices[subset.indexOffset + i + 1];
-						const uint32_t i2 = mesh.indices[subset.indexOffset + i + 2];
+			//if (!subset.active)
+			//	continue;
 
-						XMVECTOR p0;
-						XMVECTOR p1;
-						XMVECTOR p2;
+			GatherSubsetTriangles(subset, bvh, [&](const AABB& aabb) { return ray_local.intersects(aabb); }, triangles);
+			for (size_t i : triangles)
+			{
+				const uint32_t i0 = mesh.indices[subset.indexOffset + i + 0];
+				const uint32_t i1 = mesh.indices[subset.indexOffset + i + 1];
+				const uint32_t i2 = mesh.indices[subset.indexOffset + i + 2];
 
-						//if (softbody_active)
-						//{
-						//	p0 = softbody->vertex_positions_simulation[i0].LoadPOS();
-						//	p1 = softbody->vertex_positions_simulation[i1].LoadPOS();
-						//	p2 = softbody->vertex_positions_simulation[i2].LoadPOS();
-						//}
-						//else
+				XMVECTOR p0;
+				XMVECTOR p1;
+				XMVECTOR p2;
+
+				//if (softbody_active)
+				//{
+				//	p0 = softbody->vertex_positions_simulation[i0].LoadPOS();
+				//	p1 = softbody->vertex_positions_simulation[i1].LoadPOS();
+				//	p2 = softbody->vertex_positions_simulation[i2].LoadPOS();
+				//}
+				//else
+				{
+					if (armature == nullptr)
+					{
+						if (mesh.vertex_positions_morphed.empty())
+					    {
+							p0 = XMLoadFloat3(&mesh.vertex_positions[i0]);
+							p1 = XMLoadFloat3(&mesh.vertex_positions[i1]);
+							p2 = XMLoadFloat3(&mesh.vertex_positions[i2]);
+						}
+						else
 						{
-							if (armature == nullptr)
-							{
-								if (mesh.vertex_positions_morphed.empty())
-							    {
-									p0 = XMLoadFloat3(&mesh.vertex_positions[i0]);
-									p1 = XMLoadFloat3(&mesh.vertex_positions[i1]);
-									p2 = XMLoadFloat3(&mesh.vertex_positions[i2]);
-								}
-								else
-								{
-								    p0 = mesh.vertex_positions_morphed[i0].LoadPOS();
-								    p1 = mesh.vertex_positions_morphed[i1].LoadPOS();
-								    p2 = mesh.vertex_positions_morphed[i2].LoadPOS();
-								}
-							}
-							else
-							{
-								p0 = SkinVertex(mesh, *armature, i0);
-								p1 = SkinVertex(mesh, *armature, i1);
-								p2 = SkinVertex(mesh, *armature, i2);
-							}
+						    p0 = mesh.vertex_positions_morphed[i0].LoadPOS();
+						    p1 = mesh.vertex_positions_morphed[i1].LoadPOS();
+						    p2 = mesh.vertex_positions_morphed[i2].LoadPOS();
 						}
+					}
+					else if (skinned_positions != nullptr)
+					{
+						p0 = XMLoadFloat3(&skinned_positions[i0]);
+						p1 = XMLoadFloat3(&skinned_positions[i1]);
+						p2 = XMLoadFloat3(&skinned_positions[i2]);
+					}
+					else
+					{
+						p0 = SkinVertex(mesh, *armature, i0);
+						p1 = SkinVertex(mesh, *armature, i1);
+						p2 = SkinVertex(mesh, *armature, i2);
+					}
+				}
 
-						float distance;
-						XMFLOAT2 bary;
-						if (wiMath::RayTriangleIntersects(rayOrigin_local, rayDirection_local, p0, p1, p2, distance, bary))
-						{
-							const XMVECTOR pos = XMVector3Transform(XMVectorAdd(rayOrigin_local, rayDirection_local*distance), objectMat);
-							distance = wiMath::Distance(pos, rayOrigin);
+				float distance;
+				XMFLOAT2 bary;
+				if (wiMath::RayTriangleIntersects(rayOrigin_local, rayDirection_local, p0, p1, p2, distance, bary))
+				{
+					const XMVECTOR pos = XMVector3Transform(XMVectorAdd(rayOrigin_local, rayDirection_local*distance), objectMat);
+					distance = wiMath::Distance(pos, rayOrigin);
 
-							if (distance < result.distance)
-							{
-								const XMVECTOR nor = XMVector3Normalize(XMVector3TransformNormal(XMVector3Cross(XMVectorSubtract(p2, p1), XMVectorSubtract(p1, p0)), objectMat));
-
-								#ifdef GGREDUCED
-								// ignore world normals facing away, means ceilings no longer interfere with ray cast
-								// LB: OR the object is double sided and can be seen from behind, thus pickable
-								if (XMVectorGetX(XMVector3Dot(nor, rayDirection)) <= 0.0f || mesh.IsDoubleSided() == true)
-								{ 
-								#endif
-
-								result.entity = entity;
-								XMStoreFloat3(&result.position, pos);
-								XMStoreFloat3(&result.normal, nor);
-								result.distance = distance;
-								result.subsetIndex = subsetCounter;
-								result.vertexID0 = (int)i0;
-								result.vertexID1 = (int)i1;
-								result.vertexID2 = (int)i2;
-								result.bary = bary;
-
-								#ifdef GGREDUCED
-								}
-								#endif
-							}
+					if (distance < result.distance)
+					{
+						const XMVECTOR nor = XMVector3Normalize(XMVector3TransformNormal(XMVector3Cross(XMVectorSubtract(p2, p1), XMVectorSubtract(p1, p0)), objectMat));
+
+						#ifdef GGREDUCED
+						// ignore world normals facing away, means ceilings no longer interfere with ray cast
+						// LB: OR the object is double sided and can be seen from behind, thus pickable
+						if (XMVectorGetX(XMVector3Dot(nor, rayDirection)) <= 0.0f || mesh.IsDoubleSided() == true)
+						{ 
+						#endif
+
+						result.entity = entity;
+						XMStoreFloat3(&result.position, pos);
+						XMStoreFloat3(&result.normal, nor);
+						result.distance = distance;
+						result.subsetIndex = subsetCounter;
+						result.vertexID0 = (int)i0;
+						result.vertexID1 = (int)i1;
+						result.vertexID2 = (int)i2;
+						result.bary = bary;
+
+						#ifdef GGREDUCED
 						}
+						#endif
 					}
-					subsetCounter++;
 				}
-
 			}
+			subsetCounter++;
 		}
-
+	}
+	static void PickOrientation(const RAY& ray, PickResult& result)
+	{
 		// Construct a matrix that will orient to position (P) according to surface normal (N):
 		XMVECTOR N = XMLoadFloat3(&result.normal);
 		XMVECTOR P = XMLoadFloat3(&result.position);
@@ -4651,9 +7016,150 @@ OPTICK_EVENT();
 		XMVECTOR B = XMVector3Normalize(XMVector3Cross(T, N));
 		XMMATRIX M = { T, N, B, P };
 		XMStoreFloat4x4(&result.orientation, M);
+	}
+
+	PickResult Pick(const RAY& ray, uint32_t renderTypeMask, uint32_t layerMask, const Scene& scene)
+	{
+		PickResult result;
+
+		if (scene.objects.GetCount() > 0)
+		{
+			// Only the objects whose bounds are hit by the ray are visited, with the help of the scene BVH:
+			std::vector<uint32_t> candidates;
+			scene.QueryBVH(scene.aabb_objects, [&](const AABB& aabb) { return ray.intersects(aabb); }, [&](uint32_t index) {
+				candidates.push_back(index);
+			});
+			for (uint32_t i : candidates)
+			{
+				PickObject(ray, i, renderTypeMask, layerMask, scene, nullptr, result);
+			}
+		}
+
+		PickOrientation(ray, result);
 
 		return result;
 	}
+	void PickBatch(const RAY* rays, size_t count, PickResult* results, uint32_t renderTypeMask, uint32_t layerMask, const Scene& scene)
+	{
+		static constexpr uint32_t packetSize = 8;
+		const uint32_t packetCount = (uint32_t)((count + packetSize - 1) / packetSize);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			results[i] = PickResult();
+		}
+
+		// The objects that are reached by the rays of each packet, with the mask of those rays:
+		struct Candidate
+		{
+			uint32_t objectIndex;
+			uint32_t rayMask;
+		};
+		std::vector<std::vector<Candidate>> packet_candidates(packetCount);
+
+		wiJobSystem::context ctx;
+		if (scene.objects.GetCount() > 0)
+		{
+			const wiBVH* bvh = scene.GetBVH(scene.aabb_objects);
+			wiJobSystem::Dispatch(ctx, packetCount, 1, [&](wiJobArgs args) {
+				const size_t first = args.jobIndex * packetSize;
+				const uint32_t rayCount = (uint32_t)std::min(size_t(packetSize), count - first);
+				std::vector<Candidate>& candidates = packet_candidates[args.jobIndex];
+
+				auto overlaps = [&](const AABB& aabb, uint32_t rayMask) {
+					uint32_t hits = 0;
+					for (uint32_t r = 0; r < rayCount; ++r)
+					{
+						if (((rayMask >> r) & 1) && rays[first + r].intersects(aabb))
+						{
+							hits |= 1u << r;
+						}
+					}
+					return hits;
+				};
+
+				const uint32_t allRays = (1u << rayCount) - 1;
+				if (bvh != nullptr)
+				{
+					bvh->IntersectsPacket(allRays, overlaps, [&](uint32_t index, uint32_t rayMask) {
+						rayMask = overlaps(scene.aabb_objects[index], rayMask);
+						if (rayMask != 0)
+						{
+							candidates.push_back({ index, rayMask });
+						}
+					});
+				}
+				else
+				{
+					for (uint32_t index = 0; index < (uint32_t)scene.aabb_objects.GetCount(); ++index)
+					{
+						const uint32_t rayMask = overlaps(scene.aabb_objects[index], allRays);
+						if (rayMask != 0)
+						{
+							candidates.push_back({ index, rayMask });
+						}
+					}
+				}
+			});
+			wiJobSystem::Wait(ctx);
+		}
+
+		// Skinned meshes that are reached by any ray are skinned once for the whole batch instead of per triangle test:
+		std::vector<std::vector<XMFLOAT3>> skinned_positions(scene.meshes.GetCount());
+		std::vector<size_t> skinned_meshes;
+		for (const auto& candidates : packet_candidates)
+		{
+			for (const Candidate& candidate : candidates)
+			{
+				const ObjectComponent& object = scene.objects[candidate.objectIndex];
+				const size_t meshIndex = scene.meshes.GetIndex(object.meshID);
+				if (meshIndex == ~0ull || !skinned_positions[meshIndex].empty())
+				{
+					continue;
+				}
+				const MeshComponent& mesh = scene.meshes[meshIndex];
+				if (mesh.IsSkinned() && scene.armatures.Contains(mesh.armatureID) && !mesh.vertex_positions.empty())
+				{
+					skinned_positions[meshIndex].resize(mesh.vertex_positions.size());
+					skinned_meshes.push_back(meshIndex);
+				}
+			}
+		}
+		wiJobSystem::Dispatch(ctx, (uint32_t)skinned_meshes.size(), 1, [&](wiJobArgs args) {
+			const size_t meshIndex = skinned_meshes[args.jobIndex];
+			const MeshComponent& mesh = scene.meshes[meshIndex];
+			const ArmatureComponent& armature = *scene.armatures.GetComponent(mesh.armatureID);
+			std::vector<XMFLOAT3>& positions = skinned_positions[meshIndex];
+			for (size_t i = 0; i < positions.size(); ++i)
+			{
+				XMStoreFloat3(&positions[i], SkinVertex(mesh, armature, (uint32_t)i));
+			}
+		});
+		wiJobSystem::Wait(ctx);
+
+		wiJobSystem::Dispatch(ctx, packetCount, 1, [&](wiJobArgs args) {
+			const size_t first = args.jobIndex * packetSize;
+			const uint32_t rayCount = (uint32_t)std::min(size_t(packetSize), count - first);
+			for (const Candidate& candidate : packet_candidates[args.jobIndex])
+			{
+				const ObjectComponent& object = scene.objects[candidate.objectIndex];
+				const size_t meshIndex = scene.meshes.GetIndex(object.meshID);
+				const XMFLOAT3* positions = meshIndex != ~0ull && !skinned_positions[meshIndex].empty() ? skinned_positions[meshIndex].data() : nullptr;
+				for (uint32_t r = 0; r < rayCount; ++r)
+				{
+					if ((candidate.rayMask >> r) & 1)
+					{
+						PickObject(rays[first + r], candidate.objectIndex, renderTypeMask, layerMask, scene, positions, results[first + r]);
+					}
+				}
+			}
+			for (uint32_t r = 0; r < rayCount; ++r)
+			{
+				PickOrientation(rays[first + r], results[first + r]);
+			}
+		});
+		wiJobSystem::Wait(ctx);
+	}
 
 	SceneIntersectSphereResult SceneIntersectSphere(const SPHERE& sphere, uint32_t renderTypeMask, uint32_t layerMask, const Scene& scene)
 	{
@@ -4665,14 +7171,12 @@ OPTICK_EVENT();
 		if (scene.objects.GetCount() > 0)
 		{
 
-			for (size_t i = 0; i < scene.aabb_objects.GetCount(); ++i)
+			std::vector<uint32_t> candidates;
+			scene.QueryBVH(scene.aabb_objects, [&](const AABB& aabb) { return sphere.intersects(aabb); }, [&](uint32_t index) {
+				candidates.push_back(index);
+			});
+			for (uint32_t i : candidates)
 			{
-				const AABB& aabb = scene.aabb_objects[i];
-				if (!sphere.intersects(aabb))
-				{
-					continue;
-				}
-
 				const ObjectComponent& object = scene.objects[i];
 				if (object.meshID == INVALID_ENTITY)
 				{
@@ -4702,6 +7206,13 @@ OPTICK_EVENT();
 
 				const ArmatureComponent* armature = mesh.IsSkinned() ? scene.armatures.GetComponent(mesh.armatureID) : nullptr;
 
+				// The triangle BVH is in mesh space, so it's queried with the bounds of the sphere transformed there:
+				AABB sphere_aabb;
+				sphere_aabb.createFromHalfWidth(sphere.center, XMFLOAT3(sphere.radius, sphere.radius, sphere.radius));
+				const AABB query_aabb = sphere_aabb.transform(XMMatrixInverse(nullptr, objectMat));
+				const wiBVH* bvh = mesh.GetBVH();
+				std::vector<uint32_t> triangles;
+
 				int subsetCounter = 0;
 				int count = 0;
 				int target_lod = 0;
@@ -4717,7 +7228,8 @@ OPTICK_EVENT();
 					//if (!subset.active)
 					//	continue;
 
-					for (size_t i = 0; i < subset.indexCount; i += 3)
+					GatherSubsetTriangles(subset, bvh, [&](const AABB& aabb) { return query_aabb.intersects(aabb) != AABB::OUTSIDE; }, triangles);
+					for (size_t i : triangles)
 					{
 						const uint32_t i0 = mesh.indices[subset.indexOffset + i + 0];
 						const uint32_t i1 = mesh.indices[subset.indexOffset + i + 1];
@@ -4887,14 +7399,12 @@ OPTICK_EVENT();
 		if (scene.objects.GetCount() > 0)
 		{
 
-			for (size_t i = 0; i < scene.aabb_objects.GetCount(); ++i)
+			std::vector<uint32_t> candidates;
+			scene.QueryBVH(scene.aabb_objects, [&](const AABB& aabb) { return capsule_aabb.intersects(aabb) != AABB::INTERSECTION_TYPE::OUTSIDE; }, [&](uint32_t index) {
+				candidates.push_back(index);
+			});
+			for (uint32_t i : candidates)
 			{
-				const AABB& aabb = scene.aabb_objects[i];
-				if (capsule_aabb.intersects(aabb) == AABB::INTERSECTION_TYPE::OUTSIDE)
-				{
-					continue;
-				}
-
 				const ObjectComponent& object = scene.objects[i];
 				if (object.meshID == INVALID_ENTITY)
 				{
@@ -4924,6 +7434,11 @@ OPTICK_EVENT();
 
 				const ArmatureComponent* armature = mesh.IsSkinned() ? scene.armatures.GetComponent(mesh.armatureID) : nullptr;
 
+				// The triangle BVH is in mesh space, so it's queried with the bounds of the capsule transformed there:
+				const AABB query_aabb = capsule_aabb.transform(XMMatrixInverse(nullptr, objectMat));
+				const wiBVH* bvh = mesh.GetBVH();
+				std::vector<uint32_t> triangles;
+
 				int subsetCounter = 0;
 				int count = 0;
 
@@ -4940,7 +7455,8 @@ OPTICK_EVENT();
 					//if (!subset.active)
 					//	continue;
 
-					for (size_t i = 0; i < subset.indexCount; i += 3)
+					GatherSubsetTriangles(subset, bvh, [&](const AABB& aabb) { return query_aabb.intersects(aabb) != AABB::OUTSIDE; }, triangles);
+					for (size_t i : triangles)
 					{
 						const uint32_t i0 = mesh.indices[subset.indexOffset + i + 0];
 						const uint32_t i1 = mesh.indices[subset.indexOffset + i + 1];
@@ -5,11 +5,13 @@
 #include "wiEmittedParticle.h"
 #include "wiHairParticle.h"
 #include "shaders/ShaderInterop_Renderer.h"
+#include "shaders/ShaderInterop_Skinning.h"
 #include "wiJobSystem.h"
 #include "wiAudio.h"
 #include "wiResourceManager.h"
 #include "wiSpinLock.h"
 #include "wiGPUBVH.h"
+#include "wiBVH.h"
 #include "wiOcean.h"
 #include "wiSprite.h"
 
@@ -19,6 +21,8 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <unordered_map>
+#include <atomic>
 
 class wiArchive;
 
@@ -101,11 +105,9 @@ namespace wiScene
 		void Serialize(wiArchive& archive, wiECS::EntitySerializer& seri);
 	};
 
+	// Marks the entities that have motion vectors, the previous frame matrix is kept by the object (ObjectComponent::GetWorldMatrixPrev())
 	struct PreviousFrameTransformComponent
 	{
-		// Non-serialized attributes:
-		XMFLOAT4X4 world_prev;
-
 		void Serialize(wiArchive& archive, wiECS::EntitySerializer& seri);
 	};
 
@@ -228,6 +230,7 @@ namespace wiScene
 		wiGraphics::GPUBuffer constantBuffer;
 		uint32_t layerMask = ~0u;
 		mutable bool dirty_buffer = false;
+		mutable bool dirty_constantbuffer = false; // the material table has the changes, but the constant buffer was not updated yet
 
 		// User stencil value can be in range [0, 15]
 		inline void SetUserStencilRef(uint8_t value)
@@ -312,6 +315,10 @@ namespace wiScene
 		// Returns the bitwise OR of all the RENDERTYPE flags applicable to this material
 		uint32_t GetRenderTypes() const;
 
+		// Returns the OBJECTSHADER_PERMUTATION flags of the features that this material uses, the GPU textures must be loaded
+		//	The renderer draws it with the specialized permutation of the object shader that only contains these features
+		uint32_t GetShaderPermutation() const;
+
 		// Create constant buffer and texture resources for GPU
 		void CreateRenderData();
 
@@ -329,6 +336,8 @@ namespace wiScene
 			TERRAIN = 1 << 3,
 			_DEPRECATED_DIRTY_MORPH = 1 << 4,
 			_DEPRECATED_DIRTY_BINDLESS = 1 << 5,
+			COOKED = 1 << 6,
+			RELEASE_CPU_DATA = 1 << 7,
 		};
 		uint32_t _flags = RENDERABLE;
 
@@ -350,13 +359,15 @@ namespace wiScene
 			uint32_t indexOffset = 0;
 			uint32_t indexCount = 0;
 
+			float lod_error = 0; // object space simplification error of a generated LOD level, 0 for authored levels
+
 			// Non-serialized attributes:
 			uint32_t materialIndex = 0;
 			bool active = true;
 		};
 		std::vector<MeshSubset> subsets;
 
-		uint32_t lodlevels = 0;
+		uint32_t lodlevels = 0; // the subsets are the LOD levels, lodlevels is the index of the coarsest one
 		bool activelodlevels = true;
 
 		float tessellationFactor = 0.0f;
@@ -380,8 +391,25 @@ namespace wiScene
 		};
 		std::vector<MeshMorphTarget> targets;
 
+		// Clusters of the first subset (the most detailed LOD level) for the GPU meshlet culling, the indices of the subset are ordered cluster by cluster
+		//	They are built when the model is imported, static meshes without skinning or morph targets can use them
+		std::vector<ShaderMeshlet> meshlets;
+
+		// The vertex attributes of a cooked mesh in the packed formats of the GPU vertex buffers (see Cook()), which are uploaded without conversion
+		//	They replace vertex_normals, vertex_windweights, vertex_tangents, vertex_uvset_0, vertex_uvset_1 and vertex_atlas, which are empty while the mesh is cooked
+		struct CookedStreams
+		{
+			std::vector<uint32_t> normal_wind; // Vertex_POS::normal_wind
+			std::vector<uint32_t> tangents; // Vertex_TAN
+			std::vector<uint32_t> uvset_0; // Vertex_TEX
+			std::vector<uint32_t> uvset_1; // Vertex_TEX
+			std::vector<uint32_t> atlas; // Vertex_TEX
+			float uv_density = 0;
+		} cooked;
+
 		// Non-serialized attributes:
 		AABB aabb;
+		float uv_density = 0; // average UV set 0 distance per unit of object space distance, computed by CreateRenderData()
 		wiGraphics::GPUBuffer indexBuffer;
 		wiGraphics::GPUBuffer vertexBuffer_POS;
 		wiGraphics::GPUBuffer vertexBuffer_TAN;
@@ -397,8 +425,9 @@ namespace wiScene
 		std::vector<uint8_t> vertex_subsets;
 		wiGraphics::GPUBuffer descriptor;
 		wiGraphics::GPUBuffer subsetBuffer;
+		wiGraphics::GPUBuffer meshletBuffer;
 
-		wiGraphics::RaytracingAccelerationStructure BLAS;
+		mutable wiGraphics::RaytracingAccelerationStructure BLAS; // can be swapped to its compacted copy by wiRenderer::UpdateRaytracingAccelerationStructures()
 		enum BLAS_STATE
 		{
 			BLAS_STATE_NEEDS_REBUILD,
@@ -406,6 +435,9 @@ namespace wiScene
 			BLAS_STATE_COMPLETE,
 		};
 		mutable BLAS_STATE BLAS_state = BLAS_STATE_NEEDS_REBUILD;
+		mutable bool BLAS_built = false; // until the first build, the BLAS is built regardless of the build budget, because it is already referenced by the TLAS
+		mutable bool BLAS_compacted = false; // the compacted BLAS can't be built again, so it is recreated for the next rebuild
+		mutable uint32_t BLAS_build_delay = 0; // frames that the rebuild was deferred by the build budget
 
 		// Only valid for 1 frame material component indices:
 		int terrain_material1_index = -1;
@@ -414,25 +446,71 @@ namespace wiScene
 
 		mutable bool dirty_morph = false;
 		mutable bool dirty_bindless = true;
+		// The skinning and morphing of meshes that are not drawn is skipped (wiRenderer::SetSkinningCullingEnabled()):
+		//	The passes are recorded in parallel, so the drawn frame is atomic (relaxed, every pass writes the same frame), and copied like a plain value
+		struct DrawnFrame
+		{
+			std::atomic<uint64_t> value{ 0 };
+			DrawnFrame() = default;
+			DrawnFrame(const DrawnFrame& other) : value(other.value.load(std::memory_order_relaxed)) {}
+			DrawnFrame& operator=(const DrawnFrame& other) { value.store(other.value.load(std::memory_order_relaxed), std::memory_order_relaxed); return *this; }
+		};
+		mutable DrawnFrame deform_drawn_frame; // the last frame that any pass drew the mesh (or it was visible in the main camera)
+		mutable bool deform_valid = false; // the deformed vertex buffers were written since the render data was created
+
+		// Triangle BVH for the CPU queries, item i is the triangle starting at indices[i * 3]
+		//	It is built by Scene::Update() after a query requested it, and cleared by CreateRenderData() because the vertex data could have changed
+		wiBVH bvh;
+		mutable bool bvh_requested = false;
+
+		// The CPU side vertex data was released by ReleaseCPUData(), the counts are kept for the GPU buffers:
+		bool cpu_data_released = false;
+		uint32_t released_vertex_count = 0;
+		uint32_t released_index_count = 0;
 
 		inline void SetRenderable(bool value) { if (value) { _flags |= RENDERABLE; } else { _flags &= ~RENDERABLE; } }
 		inline void SetDoubleSided(bool value) { if (value) { _flags |= DOUBLE_SIDED; } else { _flags &= ~DOUBLE_SIDED; } }
 		inline void SetDynamic(bool value) { if (value) { _flags |= DYNAMIC; } else { _flags &= ~DYNAMIC; } }
 		inline void SetTerrain(bool value) { if (value) { _flags |= TERRAIN; } else { _flags &= ~TERRAIN; } }
+		// The CPU side vertex data will be released after the render data is created (see ReleaseCPUData()), by the next Scene::Update()
+		inline void SetReleaseCPUData(bool value) { if (value) { _flags |= RELEASE_CPU_DATA; } else { _flags &= ~RELEASE_CPU_DATA; } }
 		
 		inline bool IsRenderable() const { return _flags & RENDERABLE; }
 		inline bool IsDoubleSided() const { return _flags & DOUBLE_SIDED; }
 		inline bool IsDynamic() const { return _flags & DYNAMIC; }
 		inline bool IsTerrain() const { return _flags & TERRAIN; }
+		inline bool IsCooked() const { return _flags & COOKED; }
+		inline bool IsReleaseCPUData() const { return _flags & RELEASE_CPU_DATA; }
+		inline bool IsCPUDataReleased() const { return cpu_data_released; }
 
 		inline float GetTessellationFactor() const { return tessellationFactor; }
-		inline wiGraphics::INDEXBUFFER_FORMAT GetIndexFormat() const { return vertex_positions.size() > 65535 ? wiGraphics::INDEXFORMAT_32BIT : wiGraphics::INDEXFORMAT_16BIT; }
+		inline size_t GetVertexCount() const { return cpu_data_released ? released_vertex_count : vertex_positions.size(); }
+		inline size_t GetIndexCount() const { return cpu_data_released ? released_index_count : indices.size(); }
+		inline wiGraphics::INDEXBUFFER_FORMAT GetIndexFormat() const { return GetVertexCount() > 65535 ? wiGraphics::INDEXFORMAT_32BIT : wiGraphics::INDEXFORMAT_16BIT; }
 		inline size_t GetIndexStride() const { return GetIndexFormat() == wiGraphics::INDEXFORMAT_32BIT ? sizeof(uint32_t) : sizeof(uint16_t); }
 		inline bool IsSkinned() const { return armatureID != wiECS::INVALID_ENTITY; }
 
 		// Recreates GPU resources for index/vertex buffers
-		void CreateRenderData();
+		//	scratch	: optional allocator for the temporary upload data (eg. wiJobArgs::scratch when called from a job)
+		void CreateRenderData(wiAllocators::LinearAllocator* scratch = nullptr);
+		// Replace the CPU side vertex attributes (except positions, colors and skinning) with the packed GPU streams, which take less memory and are loaded faster
+		//	Missing tangents are generated first. Meshes with morph targets are not cooked, because they need the full normals
+		//	The cooked streams are stored in the scene file instead of the attributes. The editing functions (like ComputeNormals()) uncook the mesh first
+		void Cook();
+		// Restore the CPU side vertex attributes from the cooked streams, in the precision of the GPU formats (8 bit normals and tangents, half precision UVs)
+		void Uncook();
+		// Free the CPU side vertex data after the render data was created, the GPU buffers stay valid
+		//	keep_geometry : keep the positions, indices and skinning data, which are used by picking, physics and hair particles
+		//	The mesh can't be edited, saved or its render data recreated after this, the data is available again by loading the scene again
+		void ReleaseCPUData(bool keep_geometry);
+		// Returns the bytes of the CPU side vertex, index, morph and BVH data
+		size_t GetCPUDataSize() const;
 		void WriteShaderMesh(ShaderMesh* dest) const;
+		// Creates the triangle BVH from vertex_positions and indices
+		void BuildBVH();
+		// Returns the triangle BVH if it can be used for the CPU queries, otherwise nullptr
+		//	Skinned and morphed meshes don't use the BVH, for other meshes a missing BVH is requested to be built by the next Scene::Update()
+		const wiBVH* GetBVH() const;
 
 		enum COMPUTE_NORMALS
 		{
@@ -588,6 +666,15 @@ namespace wiScene
 		// Non serialized attributes:
 		std::vector<Vertex_POS> vertex_positions_morphed;
 
+		// Sparse morph targets, built by CreateRenderData(): only the vertices that are moved by any target are recomputed
+		//	Every morph vertex refers to its deltas in morph_deltas, the GPU copy is applied by a compute shader so only the weights are uploaded
+		std::vector<ShaderMorphVertex> morph_vertices;
+		std::vector<ShaderMorphDelta> morph_deltas;
+		AABB morph_static_aabb; // bounds of the vertices that no morph target moves
+		wiGraphics::GPUBuffer morphVertexBuffer;
+		wiGraphics::GPUBuffer morphDeltaBuffer;
+		wiGraphics::GPUBuffer morphWeightBuffer;
+
 	};
 
 	struct ImpostorComponent
@@ -607,6 +694,10 @@ namespace wiScene
 		float fadeThresholdRadius;
 		std::vector<XMFLOAT4X4> instanceMatrices;
 		mutable bool render_dirty = false;
+		int textureIndex = -1; // slot in the impostor atlas, -1 if not resident
+		mutable bool ready = false; // the slot was captured, so instances can be drawn as impostors, otherwise they are drawn as meshes
+		bool requested = false; // some instance was beyond the swap distance in the last update
+		uint64_t lastUsed = 0; // the last impostor update that requested it, for the least recently used eviction
 
 		inline void SetDirty(bool value = true) { if (value) { _flags |= DIRTY; } else { _flags &= ~DIRTY; } }
 		inline bool IsDirty() const { return _flags & DIRTY; }
@@ -614,6 +705,28 @@ namespace wiScene
 		void Serialize(wiArchive& archive, wiECS::EntitySerializer& seri);
 	};
 
+	// A cell of static objects that is replaced by a single simplified proxy object far away from the camera
+	//	The proxy is an ordinary object (with its own mesh and materials) that is only drawn while the cell is beyond swapDistance, the children only while it is not
+	//	The cells are generated offline, a child object should only belong to one cell
+	struct HierarchicalLODComponent
+	{
+		enum FLAGS
+		{
+			EMPTY = 0,
+		};
+		uint32_t _flags = EMPTY;
+
+		float swapDistance = 200.0f; // distance from the camera to the bounds of the cell
+		wiECS::Entity proxyID = wiECS::INVALID_ENTITY; // object entity
+		std::vector<wiECS::Entity> children; // object entities
+
+		// Non-serialized attributes:
+		AABB aabb; // bounds of the children
+		bool active = false; // the proxy is drawn instead of the children
+
+		void Serialize(wiArchive& archive, wiECS::EntitySerializer& seri);
+	};
+
 	struct ObjectComponent
 	{
 		enum FLAGS
@@ -640,6 +753,10 @@ namespace wiScene
 		uint32_t lightmapWidth = 0;
 		uint32_t lightmapHeight = 0;
 		std::vector<uint8_t> lightmapTextureData;
+		// While baking, lightmapTextureData can hold the accumulated samples of an unfinished bake, that lightmapIterationCount is the count of
+		mutable uint32_t lightmapIterationCount = 0;
+		// Fingerprint of the placement and geometry that the lightmap was baked with (Scene::ComputeLightmapBakeSignature())
+		uint64_t lightmapBakeSignature = 0;
 
 		uint8_t userStencilRef = 0;
 
@@ -648,16 +765,26 @@ namespace wiScene
 		wiGraphics::Texture lightmap;
 		wiGraphics::RenderPass renderpass_lightmap_clear;
 		wiGraphics::RenderPass renderpass_lightmap_accumulate;
-		mutable uint32_t lightmapIterationCount = 0;
 		wiRectPacker::rect_xywh lightmap_rect = {};
 
 		XMFLOAT3 center = XMFLOAT3(0, 0, 0);
 		float impostorFadeThresholdRadius;
 		float impostorSwapDistance;
+		bool hlod_culled = false; // replaced by the proxy of its HLOD cell, or it is a proxy that is not used (RunHLODUpdateSystem())
 
 		// these will only be valid for a single frame:
 		uint32_t mesh_index = ~0u;
 		XMFLOAT4X4 worldMatrix = IDENTITYMATRIX;
+		float texture_resolution = 0; // texture resolution that the object needs from the main camera with its UV density, for the texture streaming
+
+		// The inputs that the world bounds were last computed from, static objects keep their bounds while these don't change:
+		AABB cached_aabb;
+		AABB cached_mesh_aabb;
+		XMFLOAT4X4 cached_world = {};
+		uint32_t cached_mesh_index = ~0u;
+		XMFLOAT4X4 cached_world_prev = IDENTITYMATRIX; // cached_world before its last change
+		// The number of consecutive updates that kept the cached bounds, the cached shadow maps only contain objects that stood still for a while:
+		uint32_t cached_frames = 0;
 
 		int transform_index = -1;
 		int prev_transform_index = -1;
@@ -704,8 +831,11 @@ namespace wiScene
 		inline bool IsImpostorPlacement() const { return _flags & IMPOSTOR_PLACEMENT; }
 		inline bool IsRequestPlanarReflection() const { return _flags & REQUEST_PLANAR_REFLECTION; }
 		inline bool IsLightmapRenderRequested() const { return _flags & LIGHTMAP_RENDER_REQUEST; }
+		inline bool IsHLODCulled() const { return hlod_culled; }
 
 		inline float GetTransparency() const { return 1 - color.w; }
+		// The world matrix of the previous update, for the motion vectors. The cached matrices are double buffered, so this needs no copy while the object doesn't move:
+		inline const XMFLOAT4X4& GetWorldMatrixPrev() const { return cached_frames == 0 ? cached_world_prev : cached_world; }
 		inline uint32_t GetRenderTypes() const { return rendertypeMask; }
 
 		//PE: LOD GGREDUCED
@@ -800,12 +930,14 @@ namespace wiScene
 			SAFE_TO_REGISTER = 1 << 0,
 			DISABLE_DEACTIVATION = 1 << 1,
 			FORCE_RESET = 1 << 2,
+			GPU_SIMULATION = 1 << 3,
 		};
 		uint32_t _flags = DISABLE_DEACTIVATION;
 
 		float mass = 1.0f;
 		float friction = 0.5f;
 		float restitution = 0.0f;
+		float colliderRadius = 0.1f; // radius of the capsules between the bones of the armature in the GPU simulation (0: no colliders)
 		std::vector<uint32_t> physicsToGraphicsVertexMapping; // maps graphics vertex index to physics vertex index of the same position
 		std::vector<uint32_t> graphicsToPhysicsVertexMapping; // maps a physics vertex index to first graphics vertex index of the same position
 		std::vector<float> weights; // weight per physics vertex controlling the mass. (0: disable weight (no physics, only animation), 1: default weight)
@@ -818,12 +950,26 @@ namespace wiScene
 		std::vector<MeshComponent::Vertex_TAN> vertex_tangents_simulation;
 		AABB aabb;
 
+		// GPU simulation state, the simulated vertices are written into the streamout buffers of the mesh:
+		wiGraphics::GPUBuffer clothParticleBuffer; // ShaderClothParticle per physics vertex
+		wiGraphics::GPUBuffer clothPositionBuffer[2]; // the solver iterations read one and write the other
+		wiGraphics::GPUBuffer clothConstraintBuffer;
+		wiGraphics::GPUBuffer clothRingBuffer;
+		wiGraphics::GPUBuffer clothMappingBuffer;
+		mutable bool cloth_reset = true; // the particles are placed to the animated vertices on the next simulation
+
 		inline void SetDisableDeactivation(bool value) { if (value) { _flags |= DISABLE_DEACTIVATION; } else { _flags &= ~DISABLE_DEACTIVATION; } }
+		// The cloth is simulated by position based dynamics on the GPU instead of the physics engine
+		//	The vertices never come back to the CPU, so the simulation aabb is only an estimate and the physics engine doesn't see the cloth
+		inline void SetGPUSimulation(bool value) { if (value) { _flags |= GPU_SIMULATION; } else { _flags &= ~GPU_SIMULATION; } _flags |= FORCE_RESET; }
 
 		inline bool IsDisableDeactivation() const { return _flags & DISABLE_DEACTIVATION; }
+		inline bool IsGPUSimulation() const { return _flags & GPU_SIMULATION; }
 
 		// Create physics represenation of graphics mesh
 		void CreateFromMesh(const MeshComponent& mesh);
+		// Create the buffers of the GPU simulation, the physics representation must exist
+		void CreateGPUSimulationData(const MeshComponent& mesh);
 
 		void Serialize(wiArchive& archive, wiECS::EntitySerializer& seri);
 	};
@@ -869,6 +1015,26 @@ namespace wiScene
 		std::vector<ShaderBoneType> boneData;
 		wiGraphics::GPUBuffer boneBuffer;
 
+		// Animation level of detail, decided by Scene::RunAnimationLODSystem() every frame:
+		uint32_t lod_interval = 1; // the bones are computed every lod_interval frames, and interpolated in between
+		uint32_t lod_phase = 0; // frames since the bones were last computed
+		float lod_screen_size = 0; // largest projected radius of the skinned objects in the previous frame, relative to half of the screen height
+		bool lod_update = true; // the bones are computed (and the animations are sampled) in this frame
+		bool lod_culled = false; // none of the skinned objects were visible in the previous frame, so the bones are not updated at all
+		bool lod_reduced_bones = false; // the deepest bones are not animated
+		std::vector<ShaderBoneType> boneData_prev; // the last two computed poses that are interpolated between, when lod_interval > 1
+		std::vector<ShaderBoneType> boneData_next;
+
+		// GPU bone transforms (see wiRenderer::SetGPUBoneTransformsEnabled()):
+		//	The compact local bone transforms are uploaded instead of boneData, and the skinning matrices are computed into boneBuffer by a compute shader
+		std::vector<ShaderBoneTransform> boneTransforms;
+		std::vector<ShaderBoneStatic> boneStatics;
+		wiGraphics::GPUBuffer boneTransformBuffer;
+		wiGraphics::GPUBuffer boneStaticBuffer;
+		uint64_t boneStatics_version = ~0ull; // hierarchy structure version that boneStatics were built for
+		mutable bool boneStatics_dirty = false; // boneStatics need to be uploaded
+		bool gpu_bone_transforms = false; // the skinning matrices are computed on the GPU in this frame
+
 		void CreateRenderData();
 
 		void Serialize(wiArchive& archive, wiECS::EntitySerializer& seri);
@@ -918,6 +1084,8 @@ namespace wiScene
 		uint32_t history = 1;
 		bool bNotRenderedInThisframe = false;
 		bool bPrev_In_Frustom = true;
+		int shadow_page = -1; // array slice of the spot shadow atlas, -1 when the light got no shadow tile this frame
+		wiRectPacker::rect_xywh shadow_rect = {}; // tile of the spot shadow atlas page in texels
 
 		std::vector<std::shared_ptr<wiResource>> lensFlareRimTextures;
 
@@ -1076,7 +1244,6 @@ namespace wiScene
 
 		std::vector<float> keyframe_times;
 		std::vector<float> keyframe_data;
-		uint32_t prevKeyRight = 0;
 		void Serialize(wiArchive& archive, wiECS::EntitySerializer& seri);
 	};
 
@@ -1162,6 +1329,18 @@ namespace wiScene
 		// Non-serialzied attributes:
 		std::vector<float> morph_weights_temp;
 
+		// The channels resolved to component indices, these are rebuilt when the transforms, animation datas or armatures are added or removed
+		struct ChannelBinding
+		{
+			uint32_t data_index = ~0u; // index into animation_datas
+			uint32_t target_index = ~0u; // index into transforms (not used for morph target weights)
+			uint32_t cursor = 0; // left keyframe of the last update, the keyframe search continues from here
+			uint32_t bone_depth = 0; // number of parent bones of the target, for animation level of detail
+		};
+		std::vector<ChannelBinding> bindings;
+		uint64_t bindings_version = ~0ull;
+		uint32_t armature_index = ~0u; // the armature whose bones are animated, its level of detail applies to the animation
+
 		inline bool IsPlaying() const { return _flags & PLAYING; }
 		inline bool IsLooped() const { return _flags & LOOPED; }
 		inline float GetLength() const { return end - start; }
@@ -1337,6 +1516,7 @@ namespace wiScene
 		wiECS::ComponentManager<MaterialComponent> materials;
 		wiECS::ComponentManager<MeshComponent> meshes;
 		wiECS::ComponentManager<ImpostorComponent> impostors;
+		wiECS::ComponentManager<HierarchicalLODComponent> hlods;
 		wiECS::ComponentManager<ObjectComponent> objects;
 		wiECS::ComponentManager<AABB> aabb_objects;
 		wiECS::ComponentManager<RigidBodyPhysicsComponent> rigidbodies;
@@ -1361,21 +1541,116 @@ namespace wiScene
 		wiECS::ComponentManager<InverseKinematicsComponent> inverse_kinematics;
 		wiECS::ComponentManager<SpringComponent> springs;
 
+		// Cached joins of the components that the update systems read together:
+		wiECS::View<LightComponent, TransformComponent, LayerComponent> view_lights{ lights, transforms, layers };
+		wiECS::View<EnvironmentProbeComponent, TransformComponent, LayerComponent> view_probes{ probes, transforms, layers };
+		wiECS::View<wiEmittedParticle, TransformComponent, LayerComponent> view_emitters{ emitters, transforms, layers };
+
 		// Non-serialized attributes:
 		float dt = 0;
 		enum FLAGS
 		{
 			EMPTY = 0,
+			RELEASE_MESH_CPU_DATA = 1 << 0, // every mesh releases its CPU side data after the render data is created, as if they had MeshComponent::RELEASE_CPU_DATA
+			KEEP_MESH_GEOMETRY = 1 << 1, // the meshes that release their CPU side data keep the geometry for picking (the ones used by physics and hair particles always keep it)
 		};
 		uint32_t flags = EMPTY;
 
 
 		wiSpinLock locker;
+		wiSpinLock deferred_locker;
+
+		// Name -> entity hash index of the name queries (Entity_FindByName() and the others), refreshed from the change tracking of the names manager
+		//	Entries are not removed together with the names, they are validated against the NameComponent when found, and purged by a rebuild when too many are stale
+		std::unordered_multimap<std::string, wiECS::Entity> name_lookup;
+		std::vector<const std::pair<const std::string, wiECS::Entity>*> name_lookup_sorted; // name_lookup in the order of names for the prefix queries, built when needed
+		bool name_lookup_sorted_valid = false;
+		uint64_t name_lookup_structure = ~0ull; // names structure version that name_lookup was refreshed for, ~0 if it was not built yet
+		uint64_t name_lookup_version = 0; // names change version that name_lookup was refreshed for
+		wiSpinLock name_lookup_locker;
+		void UpdateNameLookup(bool changes); // name_lookup_locker must be locked
+		std::vector<wiECS::Entity> deferred_removes;
+		std::vector<std::function<void(Scene&)>> deferred_commands;
+		std::vector<wiECS::Entity> merge_order; // entities in the order they are merged by MergeIncremental() into an other scene
+		size_t merge_progress = 0;
+		wiJobSystem::TaskGraph update_graph; // the update systems with their dependencies, built on first Update()
+		wiJobSystem::TaskGraph fixed_update_graph; // the simulation systems of update_graph, run for every step of UpdateFixed()
+		wiJobSystem::TaskGraph interpolation_graph; // the systems of update_graph that derive the render data from the world transforms, run once by UpdateFixed()
+		enum UPDATE_PART
+		{
+			UPDATE_SIMULATION = 1 << 0, // systems that advance by the timestep (animation, physics, particles) and compute the world transforms
+			UPDATE_PRESENTATION = 1 << 1, // systems that read the world transforms (objects, lights, cameras, ...)
+		};
+		void BuildUpdateGraph(wiJobSystem::TaskGraph& graph, uint32_t parts);
+		struct FixedUpdate
+		{
+			bool enabled = false;
+			uint32_t steps = 0;
+			float alpha = 1;
+		} fixed_update;
+		// World matrices of the transforms (by transform index) for the interpolation of UpdateFixed():
+		struct TransformInterpolation
+		{
+			std::vector<XMFLOAT4X4> previous; // result of the step before the last one
+			std::vector<XMFLOAT4X4> current; // result of the last step
+			uint64_t version = ~0ull; // transforms structure version that the arrays were made for
+		} interpolation;
+		void StoreSimulatedTransforms();
+		void InterpolateTransforms(float alpha);
 		AABB bounds;
 		std::vector<AABB> parallel_bounds;
+		std::vector<uint32_t> hierarchy_order; // hierarchy component indices sorted by depth (parents before children)
+		std::vector<uint32_t> hierarchy_levels; // offsets of the depth levels in hierarchy_order, with the total count at the end
+		uint64_t hierarchy_order_version = ~0ull; // hierarchy structure version that hierarchy_order was built for
+		// Components grouped by the root of their transform hierarchy, different groups don't depend on each other and are solved in parallel
+		struct SolverBatches
+		{
+			std::vector<uint32_t> order; // component indices sorted by group, keeping the component order inside a group
+			std::vector<uint32_t> offsets; // offsets of the groups in order, with the total count at the end
+			std::vector<wiECS::Entity> links; // entities that the components depend on outside of their own hierarchy (IK targets)
+			uint64_t version = ~0ull; // summed structure versions that the batches were built for
+		};
+		SolverBatches spring_batches;
+		SolverBatches ik_batches;
+		wiBVH object_bvh; // CPU bounding volume hierarchy over aabb_objects for culling and scene queries, refitted at the end of Update()
+		wiBVH light_bvh;
+		wiBVH decal_bvh;
+		wiBVH probe_bvh;
+		uint64_t object_bvh_version = ~0ull; // aabb manager structure versions that the BVHs were built for
+		uint64_t light_bvh_version = ~0ull;
+		uint64_t decal_bvh_version = ~0ull;
+		uint64_t probe_bvh_version = ~0ull;
+		uint64_t object_update_version = 0; // objects change version that RunObjectUpdateSystem has processed
+
+		// Animation level of detail, applied by RunAnimationLODSystem() from the previous frame's visibility and bounds of the skinned objects:
+		//	Armatures that are small on screen compute their bones less frequently and interpolate in between, the smallest ones also stop animating their deepest bones
+		//	The armatures whose objects were all culled are not updated at all
+		struct AnimationLODSettings
+		{
+			bool enabled = true;
+			float full_rate_size = 0.15f; // armatures with larger projected radius (relative to half screen height) are updated every frame
+			uint32_t max_interval = 4; // the smallest armatures are updated every max_interval frames
+			float bone_reduction_size = 0.03f; // under this projected radius the bones deeper than bone_reduction_depth are not animated
+			uint32_t bone_reduction_depth = 4;
+		} animation_lod;
+		wiECS::EntityLookup animation_lod_bones; // bone entity -> armature index
+
+		// Mesh level of detail for meshes with generated LOD levels, applied by RunObjectUpdateSystem():
+		//	The coarsest level is selected whose error projects smaller than max_screen_error (relative to half of the screen height)
+		//	Switching to a coarser level needs the error to be under max_screen_error * hysteresis, so objects don't keep switching around the threshold
+		//	Meshes with authored LOD levels (without lod_error) keep using the distance based selection
+		struct MeshLODSettings
+		{
+			bool enabled = true;
+			float max_screen_error = 0.002f; // about one pixel at 1080p
+			float hysteresis = 0.75f;
+		} mesh_lod;
+		uint64_t animation_lod_bones_version = ~0ull; // armatures structure version that animation_lod_bones was built for
+		uint64_t object_bvh_changes = 0; // aabb_objects change version that object_bvh was refitted for
 		WeatherComponent weather;
 		wiGraphics::RaytracingAccelerationStructure TLAS;
 		std::vector<uint8_t> TLAS_instances;
+		mutable std::atomic_bool TLAS_instances_changed{ true }; // the TLAS is only uploaded and built again when an instance or a BLAS changed
 		wiGPUBVH BVH; // this is for non-hardware accelerated raytracing
 		mutable bool acceleration_structure_update_requested = false;
 		void SetAccelerationStructureUpdateRequested(bool value = true) { acceleration_structure_update_requested = value; }
@@ -1389,32 +1664,44 @@ namespace wiScene
 		std::atomic<uint32_t> queryAllocator{ 0 };
 
 		// Environment probe cubemap array state:
-		static constexpr uint32_t envmapCount = 16;
-#ifdef GGREDUCED
+		//	The probe count and the cubemap resolution are applied with SetEnvProbeArray() at the next update, which recreates the array and renders every probe again
+		static constexpr uint32_t envmapCountMax = 64;
+		uint32_t envmapCount = 16;
 		uint32_t envmapRes = 128;
+		uint32_t envmapNewCount = 16;
 		uint32_t envmapNewRes = 128;
-#else
-		static constexpr uint32_t envmapRes = 128;
-#endif
-		static constexpr uint32_t envmapMIPs = 8;
+		static constexpr uint32_t envmapMIPs = 8; // smaller resolutions have fewer mips, so that the smallest one is 1x1
 		wiGraphics::Texture envrenderingDepthBuffer;
 		wiGraphics::Texture envmapArray;
 		std::vector<wiGraphics::RenderPass> renderpasses_envmap;
+		std::vector<wiGraphics::RenderPass> renderpasses_envmap_load; // keeps the faces that are not rendered
 
+		// count is clamped to [1, envmapCountMax], resolution is rounded up to a power of two
+		void SetEnvProbeArray(uint32_t count, uint32_t resolution);
 #ifdef GGREDUCED
 		void SetEnvProbeResolution (uint32_t iSize)
 		{
-			// Wicked Not Entirely Support Changing This (For Now)!
-			envmapNewRes = iSize;
+			SetEnvProbeArray(envmapNewCount, iSize);
 		}
 #endif
 
-		// Impostor texture array state:
-		static constexpr uint32_t maxImpostorCount = 8;
-		static constexpr uint32_t impostorTextureDim = 128;
+		// Impostor atlas state:
+		//	Every impostor that is seen from beyond its swap distance takes a slot of the atlas, that is three slices (albedo, normal, surface) of the texture array
+		//	A slice holds the views from the impostorCaptureGrid x impostorCaptureGrid octahedral directions
+		//	When there is no free slot, the least recently used impostor is evicted, and its instances are drawn as meshes until it gets a slot again
+		//	The slot count is applied with SetImpostorCapacity() at the next update, which recreates the atlas and captures every impostor again
+		static constexpr uint32_t impostorCapacityMax = 512;
+		static constexpr uint32_t impostorTextureDim = 512;
+		uint32_t impostorCapacity = 32;
+		uint32_t impostorNewCapacity = 32;
+		uint64_t impostorUpdateCounter = 0;
 		wiGraphics::Texture impostorDepthStencil;
 		wiGraphics::Texture impostorArray;
 		std::vector<wiGraphics::RenderPass> renderpasses_impostor;
+		std::vector<wiECS::Entity> impostorSlots; // the owner of every atlas slot, INVALID_ENTITY if free
+
+		// count is clamped to [1, impostorCapacityMax]
+		void SetImpostorCapacity(uint32_t count);
 
 		// Atlas packing border size in pixels:
 		static constexpr int atlasClampBorder = 1;
@@ -1422,14 +1709,37 @@ namespace wiScene
 		// Lightmap atlas state:
 		wiGraphics::Texture lightmap;
 		std::vector<wiRectPacker::rect_xywh*> lightmap_rects;
+		std::vector<wiECS::Entity> lightmap_rect_entities; // the object of every item in lightmap_rects
 		std::atomic<uint32_t> lightmap_rect_allocator{ 0 };
+		//	A new lightmap is inserted into the free space of the atlas and only it is copied, the atlas is repacked and fully copied only when it doesn't fit
+		//	The rects of removed objects and released lightmaps are given back to the atlas space before inserting
 		mutable std::atomic_bool lightmap_repack_needed{ false };
+		std::atomic_bool lightmap_insert_needed{ false };
+		wiRectPacker::free_rects lightmapAtlasSpace;
+		std::unordered_map<wiECS::Entity, wiRectPacker::rect_xywh> lightmap_placed; // the rects in lightmapAtlasSpace by object
+		mutable std::vector<const wiRectPacker::rect_xywh*> lightmap_copies_pending; // inserted rects that are not copied into the atlas yet
 		mutable std::atomic_bool lightmap_refresh_needed{ false };
+		mutable std::atomic_bool lightmap_bake_finished{ false }; // some objects reached the target sample count (wiRenderer::SetLightmapBakeTargetSamples())
+		// Downloads the accumulated samples of the unfinished lightmap bakes, so that they are serialized and baking can resume after loading
+		//	This is done automatically when the scene is serialized
+		void CheckpointLightmaps();
+		// Fingerprint of what the lightmap of an object is baked from: its transform, and the positions, atlas coordinates and indices of its mesh
+		uint64_t ComputeLightmapBakeSignature(const ObjectComponent& object) const;
+		// Starts a new bake for the objects that already have a lightmap resolution (from a previous bake)
+		//	If only_changed is true, only the objects whose bake signature differs from the one they were baked with are baked again
+		//	Changes of the surroundings, which also affect the lighting of an object, are not detected
+		//	Returns the count of objects that started baking
+		uint32_t RequestLightmapBake(bool only_changed);
 
 		// Decal atlas state:
+		//	A new decal texture is inserted into the free space of the atlas and only it is copied, the atlas is repacked and fully copied only when it doesn't fit
+		//	Textures that are no longer used by any decal give back their space
+		//	With bindless descriptors, decals sample their textures directly and there is no atlas
 		wiGraphics::Texture decalAtlas;
 		mutable bool decal_repack_needed{ false };
 		std::unordered_map<std::shared_ptr<wiResource>, wiRectPacker::rect_xywh> packedDecals;
+		wiRectPacker::free_rects decalAtlasSpace;
+		mutable std::vector<std::shared_ptr<wiResource>> decal_copies_pending; // inserted textures that are not copied into the atlas yet
 
 		// Ocean GPU state:
 		wiOcean ocean;
@@ -1442,19 +1752,78 @@ namespace wiScene
 		// Update all components by a given timestep (in seconds):
 		//	This is an expensive function, prefer to call it only once per frame!
 		void Update(float dt);
+		// Update with a fixed timestep simulation (see MainComponent::setSimulationRate()):
+		//	The simulation systems (animation, physics, particles, ...) run steps times with step_dt, then the world transforms are interpolated by alpha between the last two steps for rendering
+		//	steps can be 0, then only the interpolation advances. The systems that read the world transforms (objects, lights, ...) run once, after the interpolation
+		void UpdateFixed(float step_dt, uint32_t steps, float alpha);
 		void UpdateSceneTransform(float dt);
-		// Remove everything from the scene that it owns:
+		// Remove everything from the scene that it owns (and release the memory of the component managers):
 		void Clear();
+		// Release the memory that the component managers have reserved, but don't use:
+		void Compact();
+		// Retrieve the memory of all component managers (the components' own allocations are not included):
+		wiECS::MemoryUsage GetMemoryUsage() const;
 		// Merge an other scene into this.
 		//	The contents of the other scene will be lost (and moved to this)!
 		void Merge(Scene& other);
+		// Merge an other scene into this over multiple calls, to spread the cost over frames. Returns true when everything is merged
+		//	Every call merges at most max_entities entities, and stops after max_milliseconds if it is greater than 0
+		//	The entities are merged in dependency order (materials, transforms and bones, armatures, meshes, then the rest, parents before children),
+		//	so the merged part is consistent after every call. The other scene must not be modified until it is done, then it will be cleared
+		bool MergeIncremental(Scene& other, size_t max_entities, float max_milliseconds = 0);
+
+		// Returns the BVH over aabbs (one of aabb_objects, aabb_lights, aabb_decals or aabb_probes) if it is up to date with it, otherwise nullptr
+		const wiBVH* GetBVH(const wiECS::ComponentManager<AABB>& aabbs) const;
+		// Calls func(index) for every box of aabbs that passes overlaps(const AABB&), the BVH is traversed if it can be used, otherwise all boxes are tested
+		template<typename Overlaps, typename F>
+		void QueryBVH(const wiECS::ComponentManager<AABB>& aabbs, Overlaps overlaps, F func) const
+		{
+			const wiBVH* bvh = GetBVH(aabbs);
+			if (bvh != nullptr)
+			{
+				bvh->Intersects(overlaps, [&](uint32_t index) {
+					if (overlaps(aabbs[index]))
+					{
+						func(index);
+					}
+				});
+				return;
+			}
+			for (uint32_t index = 0; index < (uint32_t)aabbs.GetCount(); ++index)
+			{
+				if (overlaps(aabbs[index]))
+				{
+					func(index);
+				}
+			}
+		}
 
 		// Removes a specific entity from the scene (if it exists):
 		void Entity_Remove(wiECS::Entity entity);
+		// Removes multiple entities from the scene, with only one compaction for each component manager:
+		void Entity_RemoveMany(const wiECS::Entity* entities, size_t count);
+		// Deferred structural changes: these are safe to call from multiple threads (for example from within the update systems)
+		//	and they are applied at the beginning of the next Update(), or by calling ApplyDeferred()
+		//	Removals are applied in bulk first, then the commands in the order they were added
+		void Entity_RemoveDeferred(wiECS::Entity entity);
+		void AddDeferredCommand(std::function<void(Scene&)> command);
+		void ApplyDeferred();
 		// Finds the first entity by the name (if it exists, otherwise returns INVALID_ENTITY):
+		//	The names are looked up in a hash index that follows the created and removed names, and the names that were set by Entity_SetName(),
+		//	the NameComponents that are modified directly should be reported with names.MarkChanged(), they are indexed again by the next query
 		wiECS::Entity Entity_FindByName(const std::string& name);
+		// Appends every entity with the name to entities:
+		void Entity_FindAllByName(const std::string& name, std::vector<wiECS::Entity>& entities);
+		// Appends every entity whose name starts with the prefix (for example a tag like "enemy_") to entities, in the order of their names:
+		void Entity_FindAllByPrefix(const std::string& prefix, std::vector<wiECS::Entity>& entities);
+		// Sets the name of an entity, creates the NameComponent if it doesn't exist yet:
+		void Entity_SetName(wiECS::Entity entity, const std::string& name);
 		// Duplicates all of an entity's components and creates a new entity with them (recursively keeps hierarchy):
 		wiECS::Entity Entity_Duplicate(wiECS::Entity entity);
+		// Creates count duplicates of an entity at once (recursively keeps hierarchy), the new root entities are written to duplicates:
+		//	Components are copied directly instead of going through serialization, and every component manager grows only once
+		//	Entity references inside components are kept (so duplicated objects share the same mesh), only the hierarchy is remapped
+		void Entity_DuplicateMany(wiECS::Entity entity, wiECS::Entity* duplicates, size_t count);
 		// Serializes entity and all of its components to archive:
 		//	Returns either the new entity that was read, or the original entity that was written
 		//	This serialization is recursive and serializes entity hierarchy as well
@@ -1518,10 +1887,12 @@ namespace wiScene
 
 		void Serialize(wiArchive& archive);
 
-		void RunPreviousFrameTransformUpdateSystem(wiJobSystem::context& ctx);
+		void RunAnimationLODSystem(wiJobSystem::context& ctx);
 		void RunAnimationUpdateSystem(wiJobSystem::context& ctx);
 		void RunTransformUpdateSystem(wiJobSystem::context& ctx);
 		void RunHierarchyUpdateSystem(wiJobSystem::context& ctx);
+		void UpdateHierarchyOrder();
+		void UpdateBVHs();
 		void RunSpringUpdateSystem(wiJobSystem::context& ctx);
 		void RunInverseKinematicsUpdateSystem(wiJobSystem::context& ctx);
 		void RunArmatureUpdateSystem(wiJobSystem::context& ctx);
@@ -1529,6 +1900,7 @@ namespace wiScene
 		void RunMaterialUpdateSystem(wiJobSystem::context& ctx);
 		void RunImpostorUpdateSystem(wiJobSystem::context& ctx);
 		void RunObjectUpdateSystem(wiJobSystem::context& ctx);
+		void RunHLODUpdateSystem(wiJobSystem::context& ctx);
 		void RunCameraUpdateSystem(wiJobSystem::context& ctx);
 		void RunDecalUpdateSystem(wiJobSystem::context& ctx);
 		void RunProbeUpdateSystem(wiJobSystem::context& ctx);
@@ -1599,6 +1971,10 @@ namespace wiScene
 	//	layerMask		:	filter based on layer
 	//	scene			:	the scene that will be traced against the ray
 	PickResult Pick(const RAY& ray, uint32_t renderTypeMask = RENDERTYPE_OPAQUE, uint32_t layerMask = ~0, const Scene& scene = GetScene());
+	// Performs Pick() for count rays, results[i] receives the result of rays[i]
+	//	The rays are traversed through the scene BVH in packets of 8 consecutive rays (so coherent rays should be next to each other), on multiple threads
+	//	Skinned meshes are skinned only once for the whole batch
+	void PickBatch(const RAY* rays, size_t count, PickResult* results, uint32_t renderTypeMask = RENDERTYPE_OPAQUE, uint32_t layerMask = ~0, const Scene& scene = GetScene());
 
 	struct SceneIntersectSphereResult
 	{
@@ -0,0 +1,457 @@
+#include "wiSceneStreaming.h"
+#include "wiArchive.h"
+#include "wiHelper.h"
+#include "wiBackLog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace wiECS;
+
+namespace wiScene
+{
+	// Calls func(a.manager, b.manager) for every component manager of the scenes, in the same order as Scene::Merge()
+	template<typename F>
+	static void ForEachComponentManager(Scene& a, Scene& b, F func)
+	{
+		func(a.names, b.names);
+		func(a.layers, b.layers);
+		func(a.transforms, b.transforms);
+		func(a.prev_transforms, b.prev_transforms);
+		func(a.hierarchy, b.hierarchy);
+		func(a.materials, b.materials);
+		func(a.meshes, b.meshes);
+		func(a.impostors, b.impostors);
+		func(a.objects, b.objects);
+		func(a.aabb_objects, b.aabb_objects);
+		func(a.rigidbodies, b.rigidbodies);
+#ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
+		func(a.softbodies, b.softbodies);
+#endif
+		func(a.armatures, b.armatures);
+		func(a.lights, b.lights);
+		func(a.aabb_lights, b.aabb_lights);
+		func(a.cameras, b.cameras);
+		func(a.probes, b.probes);
+		func(a.aabb_probes, b.aabb_probes);
+		func(a.forces, b.forces);
+		func(a.decals, b.decals);
+		func(a.aabb_decals, b.aabb_decals);
+		func(a.animations, b.animations);
+		func(a.animation_datas, b.animation_datas);
+		func(a.emitters, b.emitters);
+		func(a.hairs, b.hairs);
+		func(a.weathers, b.weathers);
+		func(a.sounds, b.sounds);
+		func(a.inverse_kinematics, b.inverse_kinematics);
+		func(a.springs, b.springs);
+	}
+
+	// Every entity that has any component in the scene, each only once
+	static std::vector<Entity> CollectEntities(Scene& scene)
+	{
+		std::vector<Entity> entities;
+		ForEachComponentManager(scene, scene, [&](auto& manager, auto&) {
+			for (size_t i = 0; i < manager.GetCount(); ++i)
+			{
+				entities.push_back(manager.GetEntity(i));
+			}
+		});
+		std::sort(entities.begin(), entities.end());
+		entities.erase(std::unique(entities.begin(), entities.end()), entities.end());
+		return entities;
+	}
+
+	// Writes the components of the entities into a scene file
+	static bool WritePart(Scene& scene, const std::unordered_set<Entity>& entities, const std::string& fileName)
+	{
+		Scene part;
+		ForEachComponentManager(part, scene, [&](auto& dst, auto& src) {
+			for (size_t i = 0; i < src.GetCount(); ++i)
+			{
+				const Entity entity = src.GetEntity(i);
+				if (entities.count(entity) > 0)
+				{
+					dst.Create(entity) = src[i];
+				}
+			}
+		});
+
+		wiArchive archive(fileName, false);
+		if (!archive.IsOpen())
+		{
+			return false;
+		}
+		part.Serialize(archive);
+		return true;
+	}
+
+	static float DistanceToBox(const AABB& box, const XMFLOAT3& position)
+	{
+		const XMVECTOR P = XMLoadFloat3(&position);
+		const XMVECTOR nearest = XMVectorClamp(P, XMLoadFloat3(&box._min), XMLoadFloat3(&box._max));
+		return XMVectorGetX(XMVector3Length(P - nearest));
+	}
+
+	bool StreamingWorld::Build(Scene& scene, const std::string& fileName, float cell_size)
+	{
+		assert(cell_size > 0);
+
+		std::unordered_map<Entity, std::vector<Entity>> children;
+		for (size_t i = 0; i < scene.hierarchy.GetCount(); ++i)
+		{
+			children[scene.hierarchy[i].parentID].push_back(scene.hierarchy.GetEntity(i));
+		}
+
+		// Every hierarchy root with a transform is put into the cell that contains the center of its hierarchy's bounds:
+		struct CellBuild
+		{
+			AABB bounds;
+			std::unordered_set<Entity> entities;
+		};
+		std::map<std::tuple<int, int, int>, CellBuild> cellbuilds;
+		std::vector<Entity> subtree;
+		for (size_t i = 0; i < scene.transforms.GetCount(); ++i)
+		{
+			const Entity root = scene.transforms.GetEntity(i);
+			if (scene.hierarchy.Contains(root))
+			{
+				continue;
+			}
+
+			subtree.clear();
+			subtree.push_back(root);
+			AABB bounds;
+			bool global = false;
+			for (size_t j = 0; j < subtree.size(); ++j)
+			{
+				const Entity entity = subtree[j];
+				auto it = children.find(entity);
+				if (it != children.end())
+				{
+					subtree.insert(subtree.end(), it->second.begin(), it->second.end());
+				}
+
+				const LightComponent* light = scene.lights.GetComponent(entity);
+				if (light != nullptr && light->GetType() == LightComponent::DIRECTIONAL)
+				{
+					global = true;
+				}
+				for (const ComponentManager<AABB>* aabbs : { &scene.aabb_objects, &scene.aabb_decals, &scene.aabb_probes })
+				{
+					const AABB* aabb = aabbs->GetComponent(entity);
+					if (aabb != nullptr)
+					{
+						bounds = AABB::Merge(bounds, *aabb);
+					}
+				}
+				const TransformComponent* transform = scene.transforms.GetComponent(entity);
+				if (transform != nullptr)
+				{
+					const XMFLOAT3 position = transform->GetPosition();
+					bounds = AABB::Merge(bounds, AABB(position, position));
+				}
+			}
+			if (global)
+			{
+				continue;
+			}
+
+			const XMFLOAT3 center = bounds.getCenter();
+			const auto key = std::make_tuple((int)std::floor(center.x / cell_size), (int)std::floor(center.y / cell_size), (int)std::floor(center.z / cell_size));
+			CellBuild& cellbuild = cellbuilds[key];
+			cellbuild.bounds = AABB::Merge(cellbuild.bounds, bounds);
+			cellbuild.entities.insert(subtree.begin(), subtree.end());
+		}
+
+		// The entities that the cell contents refer to are added to the cells (these can be in more cells):
+		for (auto& it : cellbuilds)
+		{
+			std::unordered_set<Entity>& entities = it.second.entities;
+			std::vector<Entity> stack(entities.begin(), entities.end());
+			auto add = [&](Entity entity) {
+				if (entity != INVALID_ENTITY && entities.insert(entity).second)
+				{
+					stack.push_back(entity);
+				}
+			};
+			while (!stack.empty())
+			{
+				const Entity entity = stack.back();
+				stack.pop_back();
+
+				if (const ObjectComponent* object = scene.objects.GetComponent(entity))
+				{
+					add(object->meshID);
+				}
+				if (const MeshComponent* mesh = scene.meshes.GetComponent(entity))
+				{
+					for (auto& subset : mesh->subsets)
+					{
+						add(subset.materialID);
+					}
+					add(mesh->armatureID);
+				}
+				if (const ArmatureComponent* armature = scene.armatures.GetComponent(entity))
+				{
+					for (Entity bone : armature->boneCollection)
+					{
+						add(bone);
+					}
+				}
+				if (const wiEmittedParticle* emitter = scene.emitters.GetComponent(entity))
+				{
+					add(emitter->meshID);
+				}
+				if (const wiHairParticle* hair = scene.hairs.GetComponent(entity))
+				{
+					add(hair->meshID);
+				}
+				if (const InverseKinematicsComponent* ik = scene.inverse_kinematics.GetComponent(entity))
+				{
+					add(ik->target);
+				}
+			}
+
+			// Animations go into the cells of their targets:
+			for (size_t i = 0; i < scene.animations.GetCount(); ++i)
+			{
+				const AnimationComponent& animation = scene.animations[i];
+				const bool targeted = std::any_of(animation.channels.begin(), animation.channels.end(), [&](const AnimationComponent::AnimationChannel& channel) {
+					return entities.count(channel.target) > 0;
+				});
+				if (targeted)
+				{
+					entities.insert(scene.animations.GetEntity(i));
+					for (auto& sampler : animation.samplers)
+					{
+						if (sampler.data != INVALID_ENTITY)
+						{
+							entities.insert(sampler.data);
+						}
+					}
+				}
+			}
+		}
+
+		// Everything that is not in any cell is global:
+		std::unordered_set<Entity> global_entities;
+		for (Entity entity : CollectEntities(scene))
+		{
+			const bool in_cell = std::any_of(cellbuilds.begin(), cellbuilds.end(), [&](auto& it) {
+				return it.second.entities.count(entity) > 0;
+			});
+			if (!in_cell)
+			{
+				global_entities.insert(entity);
+			}
+		}
+
+		// The cells refer to the texture files, embedding them would write every retained resource into every cell:
+		const wiResourceManager::MODE mode = wiResourceManager::GetMode();
+		wiResourceManager::SetMode(wiResourceManager::MODE_ALLOW_RETAIN_FILEDATA_BUT_DISABLE_EMBEDDING);
+
+		const std::string directory = wiHelper::GetDirectoryFromPath(fileName);
+		std::string basename = wiHelper::GetFileNameFromPath(fileName);
+		basename = basename.substr(0, basename.rfind('.')) + "_";
+		bool success = true;
+
+		const std::string global_name = basename + "global.wiscene";
+		success = success && WritePart(scene, global_entities, directory + global_name);
+
+		std::vector<std::string> cell_names;
+		for (auto& it : cellbuilds)
+		{
+			const std::string cell_name = basename + "cell_" + std::to_string(std::get<0>(it.first)) + "_" + std::to_string(std::get<1>(it.first)) + "_" + std::to_string(std::get<2>(it.first)) + ".wiscene";
+			success = success && WritePart(scene, it.second.entities, directory + cell_name);
+			cell_names.push_back(cell_name);
+		}
+
+		wiResourceManager::SetMode(mode);
+
+		if (success)
+		{
+			wiArchive archive(fileName, false);
+			if (!archive.IsOpen())
+			{
+				return false;
+			}
+			archive << cell_size;
+			archive << global_name;
+			archive << cellbuilds.size();
+			size_t i = 0;
+			for (auto& it : cellbuilds)
+			{
+				archive << it.second.bounds._min;
+				archive << it.second.bounds._max;
+				archive << cell_names[i++];
+			}
+			wiBackLog::post(("StreamingWorld::Build wrote " + std::to_string(cellbuilds.size()) + " cells: " + fileName).c_str());
+		}
+		return success;
+	}
+
+	StreamingWorld::~StreamingWorld()
+	{
+		wiJobSystem::Wait(ctx);
+	}
+
+	bool StreamingWorld::Open(Scene& scene, const std::string& fileName)
+	{
+		Close(scene);
+
+		wiArchive archive(fileName);
+		if (!archive.IsOpen())
+		{
+			return false;
+		}
+		const std::string directory = archive.GetSourceDirectory();
+		float cell_size;
+		std::string global_name;
+		size_t cell_count;
+		archive >> cell_size;
+		archive >> global_name;
+		archive >> cell_count;
+		for (size_t i = 0; i < cell_count; ++i)
+		{
+			auto cell = std::make_unique<Cell>();
+			archive >> cell->bounds._min;
+			archive >> cell->bounds._max;
+			archive >> cell->fileName;
+			cell->fileName = directory + cell->fileName;
+			cells.push_back(std::move(cell));
+		}
+
+		Scene global;
+		wiArchive global_archive(directory + global_name);
+		if (global_archive.IsOpen())
+		{
+			global.Serialize(global_archive);
+		}
+		global_entities = CollectEntities(global);
+		scene.Merge(global);
+		return true;
+	}
+
+	void StreamingWorld::Close(Scene& scene)
+	{
+		wiJobSystem::Wait(ctx);
+		for (auto& cell : cells)
+		{
+			scene.Entity_RemoveMany(cell->entities.data(), cell->entities.size());
+		}
+		cells.clear();
+		scene.Entity_RemoveMany(global_entities.data(), global_entities.size());
+		global_entities.clear();
+	}
+
+	void StreamingWorld::Update(Scene& scene, const XMFLOAT3& position)
+	{
+		assert(unload_radius >= load_radius);
+
+		bool merged = false;
+		bool unloaded = false;
+		uint32_t loading = 0;
+		std::vector<std::pair<float, Cell*>> requests;
+		for (auto& cell_ptr : cells)
+		{
+			Cell& cell = *cell_ptr;
+			const float distance = DistanceToBox(cell.bounds, position);
+			switch (cell.state)
+			{
+			case Cell::LOADING:
+				if (!cell.ready.load())
+				{
+					loading++;
+				}
+				else if (distance > unload_radius && cell.loaded->merge_progress == 0)
+				{
+					// It went out of range while it was loading, so it is not merged:
+					cell.loaded->Entity_RemoveMany(cell.entities.data(), cell.entities.size());
+					cell.loaded.reset();
+					cell.entities.clear();
+					cell.state = Cell::UNLOADED;
+				}
+				else if (!merged)
+				{
+					// The merge is spread over frames, the cell stays in the loading state until it is finished:
+					if (scene.MergeIncremental(*cell.loaded, merge_entities_per_frame, merge_milliseconds_per_frame))
+					{
+						cell.loaded.reset();
+						cell.state = Cell::RESIDENT;
+					}
+					else
+					{
+						loading++;
+					}
+					merged = true;
+				}
+				else
+				{
+					loading++;
+				}
+				break;
+			case Cell::RESIDENT:
+				if (distance > unload_radius && !unloaded)
+				{
+					scene.Entity_RemoveMany(cell.entities.data(), cell.entities.size());
+					cell.entities.clear();
+					cell.state = Cell::UNLOADED;
+					unloaded = true;
+				}
+				break;
+			case Cell::UNLOADED:
+				if (distance <= load_radius)
+				{
+					requests.push_back(std::make_pair(distance, &cell));
+				}
+				break;
+			}
+		}
+
+		// The nearest cells start loading first:
+		std::sort(requests.begin(), requests.end(), [](const std::pair<float, Cell*>& a, const std::pair<float, Cell*>& b) {
+			return a.first < b.first;
+		});
+		ctx.priority = wiJobSystem::Priority::Background;
+		ctx.name = "StreamingWorld::Update";
+		for (auto& request : requests)
+		{
+			if (loading >= max_concurrent_loads)
+			{
+				break;
+			}
+			Cell* cell = request.second;
+			cell->state = Cell::LOADING;
+			cell->ready.store(false);
+			loading++;
+			wiJobSystem::Execute(ctx, [cell](wiJobArgs args) {
+				auto part = std::make_unique<Scene>();
+				wiArchive archive(cell->fileName);
+				if (archive.IsOpen())
+				{
+					part->Serialize(archive);
+				}
+				cell->entities = CollectEntities(*part);
+				cell->loaded = std::move(part);
+				cell->ready.store(true);
+			});
+		}
+	}
+
+	StreamingWorld::Statistics StreamingWorld::GetStatistics() const
+	{
+		Statistics statistics;
+		statistics.cells = (uint32_t)cells.size();
+		for (auto& cell : cells)
+		{
+			statistics.loading += cell->state == Cell::LOADING ? 1 : 0;
+			statistics.resident += cell->state == Cell::RESIDENT ? 1 : 0;
+		}
+		return statistics;
+	}
+}
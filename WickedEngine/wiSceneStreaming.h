@@ -0,0 +1,69 @@
+#pragma once
+#include "CommonInclude.h"
+#include "wiScene.h"
+#include "wiJobSystem.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wiScene
+{
+	// World that is split into spatial cells, which are loaded in the background when the camera approaches them and unloaded when it moves away
+	//	The world file is an index of the cell files, and a global part (for example the weather) that is always loaded
+	//	Every cell is a self-contained scene file that contains the hierarchies whose roots are inside it, and the meshes, materials and animations that they use
+	//	(shared meshes and materials are stored in every cell that uses them). Textures are referenced by file name, they are loaded by the cell's loading job
+	class StreamingWorld
+	{
+	public:
+		// Split the scene into cells of cell_size and write the world file and the cell files next to it
+		//	The scene must be updated, because the cells are chosen by the world space bounds of the hierarchies. Directional lights are global
+		static bool Build(Scene& scene, const std::string& fileName, float cell_size);
+
+		~StreamingWorld();
+
+		// Open the world file and merge its global part into the scene. The cells are streamed into the same scene by Update()
+		bool Open(Scene& scene, const std::string& fileName);
+		// Remove everything of the world from the scene (after waiting for the loading jobs)
+		void Close(Scene& scene);
+		bool IsOpen() const { return !cells.empty() || !global_entities.empty(); }
+
+		// Stream the cells around the position, call it once per frame from the main thread before updating the scene
+		//	At most one loaded cell is merging and one is unloaded per frame, and the merge is limited by the merge budget, so the cost of the structural changes is spread over frames
+		void Update(Scene& scene, const XMFLOAT3& position);
+
+		float load_radius = 200; // cells whose bounds are closer than this to the position are loaded
+		float unload_radius = 300; // cells whose bounds are further than this from the position are unloaded, must be larger than load_radius
+		uint32_t max_concurrent_loads = 2;
+		size_t merge_entities_per_frame = 1024; // count of entities that are merged into the scene per frame
+		float merge_milliseconds_per_frame = 2; // merging is stopped after this much time in a frame, 0 means no time limit
+
+		struct Statistics
+		{
+			uint32_t cells = 0;
+			uint32_t loading = 0; // count of cells that are being loaded, merged, or waiting to be merged
+			uint32_t resident = 0; // count of cells that are merged into the scene
+		};
+		Statistics GetStatistics() const;
+
+	private:
+		struct Cell
+		{
+			AABB bounds;
+			std::string fileName;
+			enum STATE
+			{
+				UNLOADED,
+				LOADING,
+				RESIDENT,
+			} state = UNLOADED;
+			std::unique_ptr<Scene> loaded; // the result of the loading job, until it is merged
+			std::atomic_bool ready{ false }; // the loading job is finished
+			std::vector<wiECS::Entity> entities; // the entities of the cell in the scene, that are removed when unloading
+		};
+		std::vector<std::unique_ptr<Cell>> cells;
+		std::vector<wiECS::Entity> global_entities;
+		wiJobSystem::context ctx;
+	};
+}
@@ -303,6 +303,8 @@ Luna<Scene_BindLua>::FunctionType Scene_BindLua::methods[] = {
 	lunamethod(Scene_BindLua, Clear),
 	lunamethod(Scene_BindLua, Merge),
 	lunamethod(Scene_BindLua, Entity_FindByName),
+	lunamethod(Scene_BindLua, Entity_FindAllByName),
+	lunamethod(Scene_BindLua, Entity_FindAllByPrefix),
 	lunamethod(Scene_BindLua, Entity_Remove),
 	lunamethod(Scene_BindLua, Entity_Duplicate),
 	lunamethod(Scene_BindLua, Component_CreateName),
@@ -349,6 +351,14 @@ Luna<Scene_BindLua>::FunctionType Scene_BindLua::methods[] = {
 	lunamethod(Scene_BindLua, Entity_GetInverseKinematicsArray),
 	lunamethod(Scene_BindLua, Entity_GetSpringArray),
 
+	lunamethod(Scene_BindLua, Entity_GetPositionArray),
+	lunamethod(Scene_BindLua, Entity_GetRotationArray),
+	lunamethod(Scene_BindLua, Entity_GetScaleArray),
+	lunamethod(Scene_BindLua, Entity_SetTranslationArray),
+	lunamethod(Scene_BindLua, Entity_SetRotationArray),
+	lunamethod(Scene_BindLua, Entity_SetScaleArray),
+	lunamethod(Scene_BindLua, Entity_TranslateArray),
+
 	lunamethod(Scene_BindLua, Component_Attach),
 	lunamethod(Scene_BindLua, Component_Detach),
 	lunamethod(Scene_BindLua, Component_DetachChildren),
@@ -418,6 +428,56 @@ int Scene_BindLua::Entity_FindByName(lua_State* L)
 	}
 	return 0;
 }
+int Scene_BindLua::Entity_FindAllByName(lua_State* L)
+{
+	int argc = wiLua::SGetArgCount(L);
+	if (argc > 0)
+	{
+		std::string name = wiLua::SGetString(L, 1);
+
+		std::vector<Entity> entities;
+		scene->Entity_FindAllByName(name, entities);
+
+		lua_createtable(L, (int)entities.size(), 0);
+		int newTable = lua_gettop(L);
+		for (size_t i = 0; i < entities.size(); ++i)
+		{
+			wiLua::SSetLongLong(L, entities[i]);
+			lua_rawseti(L, newTable, lua_Integer(i + 1));
+		}
+		return 1;
+	}
+	else
+	{
+		wiLua::SError(L, "Scene::Entity_FindAllByName(string name) not enough arguments!");
+	}
+	return 0;
+}
+int Scene_BindLua::Entity_FindAllByPrefix(lua_State* L)
+{
+	int argc = wiLua::SGetArgCount(L);
+	if (argc > 0)
+	{
+		std::string prefix = wiLua::SGetString(L, 1);
+
+		std::vector<Entity> entities;
+		scene->Entity_FindAllByPrefix(prefix, entities);
+
+		lua_createtable(L, (int)entities.size(), 0);
+		int newTable = lua_gettop(L);
+		for (size_t i = 0; i < entities.size(); ++i)
+		{
+			wiLua::SSetLongLong(L, entities[i]);
+			lua_rawseti(L, newTable, lua_Integer(i + 1));
+		}
+		return 1;
+	}
+	else
+	{
+		wiLua::SError(L, "Scene::Entity_FindAllByPrefix(string prefix) not enough arguments!");
+	}
+	return 0;
+}
 int Scene_BindLua::Entity_Remove(lua_State* L)
 {
 	int argc = wiLua::SGetArgCount(L);
@@ -1063,6 +1123,134 @@ int Scene_BindLua::Entity_GetSpringArray(lua_State* L)
 	return 1;
 }
 
+// Bulk transform access: the entities are given in a Lua array, and the values are in a flat number array (N numbers per entity)
+//	The result array can be passed in to be reused, so that updating many entities every frame doesn't allocate
+template<int N, typename F>
+int GetTransformValueArray(lua_State* L, Scene& scene, const char* signature, F get)
+{
+	if (wiLua::SGetArgCount(L) < 1 || !lua_istable(L, 1))
+	{
+		wiLua::SError(L, signature);
+		return 0;
+	}
+	const lua_Integer count = (lua_Integer)lua_rawlen(L, 1);
+	if (lua_gettop(L) >= 2 && lua_istable(L, 2))
+	{
+		lua_pushvalue(L, 2);
+	}
+	else
+	{
+		lua_createtable(L, int(count * N), 0);
+	}
+	const int result = lua_gettop(L);
+	float values[N];
+	for (lua_Integer i = 0; i < count; ++i)
+	{
+		lua_rawgeti(L, 1, i + 1);
+		const Entity entity = (Entity)lua_tointeger(L, -1);
+		lua_pop(L, 1);
+		const TransformComponent* transform = scene.transforms.GetComponent(entity);
+		if (transform != nullptr)
+		{
+			get(*transform, values);
+		}
+		else
+		{
+			std::fill(values, values + N, 0.0f);
+		}
+		for (int j = 0; j < N; ++j)
+		{
+			lua_pushnumber(L, values[j]);
+			lua_rawseti(L, result, i * N + j + 1);
+		}
+	}
+	return 1;
+}
+template<int N, typename F>
+int SetTransformValueArray(lua_State* L, Scene& scene, const char* signature, F set)
+{
+	if (wiLua::SGetArgCount(L) < 2 || !lua_istable(L, 1) || !lua_istable(L, 2))
+	{
+		wiLua::SError(L, signature);
+		return 0;
+	}
+	const lua_Integer count = std::min((lua_Integer)lua_rawlen(L, 1), (lua_Integer)lua_rawlen(L, 2) / N);
+	float values[N];
+	for (lua_Integer i = 0; i < count; ++i)
+	{
+		lua_rawgeti(L, 1, i + 1);
+		const Entity entity = (Entity)lua_tointeger(L, -1);
+		lua_pop(L, 1);
+		TransformComponent* transform = scene.transforms.GetComponent(entity);
+		if (transform == nullptr)
+		{
+			continue;
+		}
+		for (int j = 0; j < N; ++j)
+		{
+			lua_rawgeti(L, 2, i * N + j + 1);
+			values[j] = (float)lua_tonumber(L, -1);
+			lua_pop(L, 1);
+		}
+		set(*transform, values);
+		transform->SetDirty();
+	}
+	return 0;
+}
+
+int Scene_BindLua::Entity_GetPositionArray(lua_State* L)
+{
+	return GetTransformValueArray<3>(L, *scene, "Scene::Entity_GetPositionArray(Entity[] entities, opt float[] result) not enough arguments!", [](const TransformComponent& transform, float* values) {
+		const XMFLOAT3 position = transform.GetPosition();
+		values[0] = position.x;
+		values[1] = position.y;
+		values[2] = position.z;
+	});
+}
+int Scene_BindLua::Entity_GetRotationArray(lua_State* L)
+{
+	return GetTransformValueArray<4>(L, *scene, "Scene::Entity_GetRotationArray(Entity[] entities, opt float[] result) not enough arguments!", [](const TransformComponent& transform, float* values) {
+		const XMFLOAT4 rotation = transform.GetRotation();
+		values[0] = rotation.x;
+		values[1] = rotation.y;
+		values[2] = rotation.z;
+		values[3] = rotation.w;
+	});
+}
+int Scene_BindLua::Entity_GetScaleArray(lua_State* L)
+{
+	return GetTransformValueArray<3>(L, *scene, "Scene::Entity_GetScaleArray(Entity[] entities, opt float[] result) not enough arguments!", [](const TransformComponent& transform, float* values) {
+		const XMFLOAT3 scale = transform.GetScale();
+		values[0] = scale.x;
+		values[1] = scale.y;
+		values[2] = scale.z;
+	});
+}
+int Scene_BindLua::Entity_SetTranslationArray(lua_State* L)
+{
+	return SetTransformValueArray<3>(L, *scene, "Scene::Entity_SetTranslationArray(Entity[] entities, float[] translations) not enough arguments!", [](TransformComponent& transform, const float* values) {
+		transform.translation_local = XMFLOAT3(values[0], values[1], values[2]);
+	});
+}
+int Scene_BindLua::Entity_SetRotationArray(lua_State* L)
+{
+	return SetTransformValueArray<4>(L, *scene, "Scene::Entity_SetRotationArray(Entity[] entities, float[] rotations) not enough arguments!", [](TransformComponent& transform, const float* values) {
+		transform.rotation_local = XMFLOAT4(values[0], values[1], values[2], values[3]);
+	});
+}
+int Scene_BindLua::Entity_SetScaleArray(lua_State* L)
+{
+	return SetTransformValueArray<3>(L, *scene, "Scene::Entity_SetScaleArray(Entity[] entities, float[] scales) not enough arguments!", [](TransformComponent& transform, const float* values) {
+		transform.scale_local = XMFLOAT3(values[0], values[1], values[2]);
+	});
+}
+int Scene_BindLua::Entity_TranslateArray(lua_State* L)
+{
+	return SetTransformValueArray<3>(L, *scene, "Scene::Entity_TranslateArray(Entity[] entities, float[] translations) not enough arguments!", [](TransformComponent& transform, const float* values) {
+		transform.Translate(XMFLOAT3(values[0], values[1], values[2]));
+	});
+}
+
 int Scene_BindLua::Component_Attach(lua_State* L)
 {
 	int argc = wiLua::SGetArgCount(L);
@@ -1146,6 +1334,13 @@ int NameComponent_BindLua::SetName(lua_State* L)
 	{
 		std::string name = wiLua::SGetString(L, 1);
 		*component = name;
+
+		// The components of the global scene are reported, so that the name lookup finds them by the new name:
+		auto& names = wiScene::GetScene().names;
+		if (names.GetCount() > 0 && component >= &names[0] && component <= &names[names.GetCount() - 1])
+		{
+			names.MarkChanged(size_t(component - &names[0]));
+		}
 	}
 	else
 	{
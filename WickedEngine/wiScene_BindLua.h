@@ -29,6 +29,8 @@ namespace wiScene_BindLua
 		int Merge(lua_State* L);
 
 		int Entity_FindByName(lua_State* L);
+		int Entity_FindAllByName(lua_State* L);
+		int Entity_FindAllByPrefix(lua_State* L);
 		int Entity_Remove(lua_State* L);
 		int Entity_Duplicate(lua_State* L);
 
@@ -76,6 +78,14 @@ namespace wiScene_BindLua
 		int Entity_GetInverseKinematicsArray(lua_State* L);
 		int Entity_GetSpringArray(lua_State* L);
 
+		int Entity_GetPositionArray(lua_State* L);
+		int Entity_GetRotationArray(lua_State* L);
+		int Entity_GetScaleArray(lua_State* L);
+		int Entity_SetTranslationArray(lua_State* L);
+		int Entity_SetRotationArray(lua_State* L);
+		int Entity_SetScaleArray(lua_State* L);
+		int Entity_TranslateArray(lua_State* L);
+
 		int Component_Attach(lua_State* L);
 		int Component_Detach(lua_State* L);
 		int Component_DetachChildren(lua_State* L);
@@ -405,12 +405,68 @@ namespace wiScene
 			    }
 			}
 
+			if (archive.GetVersion() >= 74)
+			{
+				bool has_bvh;
+				archive >> has_bvh;
+				if (has_bvh)
+				{
+					bvh.Serialize(archive);
+				}
+			}
+
+			if (archive.GetVersion() >= 75)
+			{
+				archive >> lodlevels;
+				for (auto& subset : subsets)
+				{
+					archive >> subset.lod_error;
+				}
+			}
+
+			if (archive.GetVersion() >= 76)
+			{
+				size_t meshletCount;
+				archive >> meshletCount;
+				meshlets.resize(meshletCount);
+				for (auto& meshlet : meshlets)
+				{
+					archive >> meshlet.center;
+					archive >> meshlet.radius;
+					archive >> meshlet.cone_axis;
+					archive >> meshlet.cone_cutoff;
+					archive >> meshlet.indexOffset;
+					archive >> meshlet.indexCount;
+				}
+			}
+
+			if (archive.GetVersion() >= 80 && IsCooked())
+			{
+				archive >> cooked.normal_wind;
+				archive >> cooked.tangents;
+				archive >> cooked.uvset_0;
+				archive >> cooked.uvset_1;
+				archive >> cooked.atlas;
+				archive >> cooked.uv_density;
+			}
+			else
+			{
+				_flags &= ~COOKED;
+			}
+
 			wiJobSystem::Execute(seri.ctx, [&](wiJobArgs args) {
-				CreateRenderData();
+				// The loaded triangle BVH is valid for the loaded vertex data, so it is kept:
+				wiBVH loaded_bvh = std::move(bvh);
+				CreateRenderData(args.scratch);
+				bvh = std::move(loaded_bvh);
 			});
 		}
 		else
 		{
+			if (IsCPUDataReleased())
+			{
+				wiBackLog::post("MeshComponent::Serialize: the CPU data of the mesh was released, it is saved without the released vertex data");
+			}
 			archive << _flags;
 			archive << vertex_positions;
 			archive << vertex_normals;
@@ -465,6 +521,49 @@ namespace wiScene
 			    }
 			}
 
+			if (archive.GetVersion() >= 74)
+			{
+				const bool has_bvh = !bvh.IsEmpty();
+				archive << has_bvh;
+				if (has_bvh)
+				{
+					bvh.Serialize(archive);
+				}
+			}
+
+			if (archive.GetVersion() >= 75)
+			{
+				archive << lodlevels;
+				for (auto& subset : subsets)
+				{
+					archive << subset.lod_error;
+				}
+			}
+
+			if (archive.GetVersion() >= 76)
+			{
+				archive << meshlets.size();
+				for (auto& meshlet : meshlets)
+				{
+					archive << meshlet.center;
+					archive << meshlet.radius;
+					archive << meshlet.cone_axis;
+					archive << meshlet.cone_cutoff;
+					archive << meshlet.indexOffset;
+					archive << meshlet.indexCount;
+				}
+			}
+
+			if (archive.GetVersion() >= 80 && IsCooked())
+			{
+				archive << cooked.normal_wind;
+				archive << cooked.tangents;
+				archive << cooked.uvset_0;
+				archive << cooked.uvset_1;
+				archive << cooked.atlas;
+				archive << cooked.uv_density;
+			}
+
 		}
 	}
 	void ImpostorComponent::Serialize(wiArchive& archive, EntitySerializer& seri)
@@ -482,6 +581,35 @@ namespace wiScene
 			archive << swapInDistance;
 		}
 	}
+	void HierarchicalLODComponent::Serialize(wiArchive& archive, EntitySerializer& seri)
+	{
+		if (archive.IsReadMode())
+		{
+			archive >> _flags;
+			archive >> swapDistance;
+			SerializeEntity(archive, proxyID, seri);
+
+			size_t childCount;
+			archive >> childCount;
+			children.resize(childCount);
+			for (size_t i = 0; i < childCount; ++i)
+			{
+				SerializeEntity(archive, children[i], seri);
+			}
+		}
+		else
+		{
+			archive << _flags;
+			archive << swapDistance;
+			SerializeEntity(archive, proxyID, seri);
+
+			archive << children.size();
+			for (size_t i = 0; i < children.size(); ++i)
+			{
+				SerializeEntity(archive, children[i], seri);
+			}
+		}
+	}
 	void ObjectComponent::Serialize(wiArchive& archive, EntitySerializer& seri)
 	{
 		if (archive.IsReadMode())
@@ -506,6 +634,11 @@ namespace wiScene
 			{
 				archive >> emissiveColor;
 			}
+			if (archive.GetVersion() >= 77)
+			{
+				archive >> lightmapIterationCount;
+				archive >> lightmapBakeSignature;
+			}
 		}
 		else
 		{
@@ -529,6 +662,11 @@ namespace wiScene
 			{
 				archive << emissiveColor;
 			}
+			if (archive.GetVersion() >= 77)
+			{
+				archive << lightmapIterationCount;
+				archive << lightmapBakeSignature;
+			}
 		}
 	}
 	void RigidBodyPhysicsComponent::Serialize(wiArchive& archive, EntitySerializer& seri)
@@ -613,6 +751,11 @@ namespace wiScene
 				friction = 0.5f;
 			}
 
+			if (archive.GetVersion() >= 85)
+			{
+				archive >> colliderRadius;
+			}
+
 			_flags &= ~SAFE_TO_REGISTER;
 		}
 		else
@@ -628,6 +771,11 @@ namespace wiScene
 			{
 				archive << restitution;
 			}
+
+			if (archive.GetVersion() >= 85)
+			{
+				archive << colliderRadius;
+			}
 		}
 	}
 #endif
@@ -1296,6 +1444,8 @@ namespace wiScene
 		{
 			uint32_t reserved = 0;
 			archive << reserved;
+
+			CheckpointLightmaps();
 		}
 
 		// Keeping this alive to keep serialized resources alive until entity serialization ends:
@@ -1308,48 +1458,126 @@ namespace wiScene
 		// With this we will ensure that serialized entities are unique and persistent across the scene:
 		EntitySerializer seri;
 
-		names.Serialize(archive, seri);
-		layers.Serialize(archive, seri);
-		transforms.Serialize(archive, seri);
-		prev_transforms.Serialize(archive, seri);
-		hierarchy.Serialize(archive, seri);
-		materials.Serialize(archive, seri);
-		meshes.Serialize(archive, seri);
-		impostors.Serialize(archive, seri);
-		objects.Serialize(archive, seri);
-		aabb_objects.Serialize(archive, seri);
-		rigidbodies.Serialize(archive, seri);
+		// The component managers in the order of the archive, the ones that are missing from older versions are left out:
+		std::vector<std::function<void(wiArchive&)>> managers;
+		auto add = [&](auto& manager) {
+			managers.push_back([&manager, &seri](wiArchive& block) {
+				manager.Serialize(block, seri);
+			});
+		};
+		add(names);
+		add(layers);
+		add(transforms);
+		add(prev_transforms);
+		add(hierarchy);
+		add(materials);
+		add(meshes);
+		add(impostors);
+		add(objects);
+		add(aabb_objects);
+		add(rigidbodies);
 #ifndef GGREDUCED //PE: Remove all physics checks, we dont use it.
-		softbodies.Serialize(archive, seri);
+		add(softbodies);
 #endif
-		armatures.Serialize(archive, seri);
-		lights.Serialize(archive, seri);
-		aabb_lights.Serialize(archive, seri);
-		cameras.Serialize(archive, seri);
-		probes.Serialize(archive, seri);
-		aabb_probes.Serialize(archive, seri);
-		forces.Serialize(archive, seri);
-		decals.Serialize(archive, seri);
-		aabb_decals.Serialize(archive, seri);
-		animations.Serialize(archive, seri);
-		emitters.Serialize(archive, seri);
-		hairs.Serialize(archive, seri);
-		weathers.Serialize(archive, seri);
+		add(armatures);
+		add(lights);
+		add(aabb_lights);
+		add(cameras);
+		add(probes);
+		add(aabb_probes);
+		add(forces);
+		add(decals);
+		add(aabb_decals);
+		add(animations);
+		add(emitters);
+		add(hairs);
+		add(weathers);
 		if (archive.GetVersion() >= 30)
 		{
-			sounds.Serialize(archive, seri);
+			add(sounds);
 		}
 		if (archive.GetVersion() >= 37)
 		{
-			inverse_kinematics.Serialize(archive, seri);
+			add(inverse_kinematics);
 		}
 		if (archive.GetVersion() >= 38)
 		{
-			springs.Serialize(archive, seri);
+			add(springs);
 		}
 		if (archive.GetVersion() >= 46)
 		{
-			animation_datas.Serialize(archive, seri);
+			add(animation_datas);
+		}
+		if (archive.GetVersion() >= 84)
+		{
+			add(hlods);
+		}
+
+		if (archive.GetVersion() >= 79)
+		{
+			// Every component manager is an embedded archive, their sizes are in a table before them, so they are read and written in parallel
+			//	The entity remapping is shared by the managers (and locked), they only refer to each other through the remapped entities
+			wiJobSystem::context ctx;
+			if (archive.IsReadMode())
+			{
+				uint64_t count;
+				archive >> count;
+				if (count != managers.size())
+				{
+					wiBackLog::post("Scene::Serialize: the component managers of the archive don't match, it was written by a different build configuration");
+					count = std::min(count, (uint64_t)managers.size());
+				}
+				std::vector<uint64_t> sizes((size_t)count);
+				for (uint64_t& size : sizes)
+				{
+					archive >> size;
+				}
+				std::vector<std::unique_ptr<wiArchive>> blocks;
+				for (uint64_t size : sizes)
+				{
+					const uint8_t* data = archive.ReadData((size_t)size);
+					blocks.emplace_back(new wiArchive(data, (size_t)size));
+					blocks.back()->SetSourceDirectory(archive.GetSourceDirectory());
+				}
+
+				wiJobSystem::Dispatch(ctx, (uint32_t)blocks.size(), 1, [&](wiJobArgs args) {
+					managers[args.jobIndex](*blocks[args.jobIndex]);
+				});
+				wiJobSystem::Wait(ctx);
+
+				// The subtasks of the components can still refer to their archive:
+				for (auto& block : blocks)
+				{
+					seri.chunk_archives.push_back(std::move(block));
+				}
+			}
+			else
+			{
+				std::vector<wiArchive> blocks(managers.size());
+				wiJobSystem::Dispatch(ctx, (uint32_t)blocks.size(), 1, [&](wiJobArgs args) {
+					wiArchive& block = blocks[args.jobIndex];
+					block.SetSourceDirectory(archive.GetSourceDirectory());
+					managers[args.jobIndex](block);
+				});
+				wiJobSystem::Wait(ctx);
+
+				archive << (uint64_t)blocks.size();
+				for (const wiArchive& block : blocks)
+				{
+					archive << (uint64_t)block.GetSize();
+				}
+				for (const wiArchive& block : blocks)
+				{
+					archive.WriteData(block.GetData(), block.GetSize());
+				}
+			}
+		}
+		else
+		{
+			for (auto& manager : managers)
+			{
+				manager(archive);
+			}
 		}
 
 		std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
@@ -1638,6 +1866,16 @@ namespace wiScene
 					component.Serialize(archive, seri);
 				}
 			}
+			if (archive.GetVersion() >= 84)
+			{
+				bool component_exists;
+				archive >> component_exists;
+				if (component_exists)
+				{
+					auto& component = hlods.Create(entity);
+					component.Serialize(archive, seri);
+				}
+			}
 
 			if (archive.GetVersion() >= 72)
 			{
@@ -2015,6 +2253,19 @@ namespace wiScene
 					archive << false;
 				}
 			}
+			if (archive.GetVersion() >= 84)
+			{
+				auto component = hlods.GetComponent(entity);
+				if (component != nullptr)
+				{
+					archive << true;
+					component->Serialize(archive, seri);
+				}
+				else
+				{
+					archive << false;
+				}
+			}
 
 			if (archive.GetVersion() >= 72)
 			{
@@ -5,6 +5,7 @@
 #include "wiArchive.h"
 
 #include <mutex>
+#include <unordered_map>
 #include <unordered_set>
 #include <filesystem>
 
@@ -464,11 +465,24 @@ namespace wiShaderCompiler
 			return;
 		}
 
-		D3D_SHADER_MACRO defines[] = {
-			"HLSL5", "1",
-			"DISABLE_WAVE_INTRINSICS", "1",
-			NULL, NULL,
+		// The input defines are NAME or NAME=VALUE:
+		std::vector<std::string> define_strings;
+		define_strings.reserve(input.defines.size() * 2);
+		for (auto& x : input.defines)
+		{
+			const size_t idx = x.find('=');
+			define_strings.push_back(x.substr(0, idx));
+			define_strings.push_back(idx == std::string::npos ? "1" : x.substr(idx + 1));
+		}
+		std::vector<D3D_SHADER_MACRO> defines = {
+			{ "HLSL5", "1" },
+			{ "DISABLE_WAVE_INTRINSICS", "1" },
 		};
+		for (size_t i = 0; i < define_strings.size(); i += 2)
+		{
+			defines.push_back({ define_strings[i].c_str(), define_strings[i + 1].c_str() });
+		}
+		defines.push_back({ NULL, NULL });
 
 		const char* target = nullptr;
 		switch (input.stage)
@@ -546,7 +560,7 @@ namespace wiShaderCompiler
 			shadersourcedata.data(),
 			shadersourcedata.size(),
 			input.shadersourcefilename.c_str(),
-			defines,
+			defines.data(),
 			&includehandler, //D3D_COMPILE_STANDARD_FILE_INCLUDE,
 			input.entrypoint.c_str(),
 			target,
@@ -637,6 +651,73 @@ namespace wiShaderCompiler
 	}
 
 	static const char* shadermetaextension = "wishadermeta";
+
+#ifdef SHADERCOMPILER_ENABLED
+	// The content hashes of the source files are remembered until the files are modified, because the common headers are included by every shader
+	struct SourceFileHash
+	{
+		std::filesystem::file_time_type time;
+		uint64_t hash = 0;
+	};
+	std::mutex sourcehash_locker;
+	std::unordered_map<std::string, SourceFileHash> sourcehashes;
+#endif // SHADERCOMPILER_ENABLED
+
+	uint64_t ComputeSourceHash(const std::vector<std::string>& dependencies)
+	{
+		uint64_t result = 0;
+#ifdef SHADERCOMPILER_ENABLED
+		for (auto& x : dependencies)
+		{
+			std::error_code ec;
+			const auto tim = std::filesystem::last_write_time(x, ec);
+			if (ec)
+			{
+				return 0; // missing dependency
+			}
+
+			uint64_t hash = 0;
+			bool found = false;
+			sourcehash_locker.lock();
+			auto it = sourcehashes.find(x);
+			if (it != sourcehashes.end() && it->second.time == tim)
+			{
+				hash = it->second.hash;
+				found = true;
+			}
+			sourcehash_locker.unlock();
+
+			if (!found)
+			{
+				std::vector<uint8_t> data;
+				if (!wiHelper::FileRead(x, data))
+				{
+					return 0;
+				}
+				// FNV-1a
+				hash = 0xcbf29ce484222325ull;
+				for (uint8_t c : data)
+				{
+					hash ^= c;
+					hash *= 0x100000001b3ull;
+				}
+				sourcehash_locker.lock();
+				sourcehashes[x] = { tim, hash };
+				sourcehash_locker.unlock();
+			}
+
+			size_t seed = (size_t)result;
+			wiHelper::hash_combine(seed, hash);
+			result = (uint64_t)seed;
+		}
+		if (result == 0)
+		{
+			result = 1; // 0 is reserved for invalid
+		}
+#endif // SHADERCOMPILER_ENABLED
+		return result;
+	}
+
 	bool SaveShaderAndMetadata(const std::string& shaderfilename, const CompilerOutput& output)
 	{
 #ifdef SHADERCOMPILER_ENABLED
@@ -645,6 +726,7 @@ namespace wiShaderCompiler
 		wiArchive dependencyLibrary(wiHelper::ReplaceExtension(shaderfilename, shadermetaextension), false);
 		if (dependencyLibrary.IsOpen())
 		{
+			const uint64_t sourcehash = ComputeSourceHash(output.dependencies);
 			std::string rootdir = dependencyLibrary.GetSourceDirectory();
 			std::vector<std::string> dependencies = output.dependencies;
 			for (auto& x : dependencies)
@@ -652,6 +734,7 @@ namespace wiShaderCompiler
 				wiHelper::MakePathRelative(rootdir, x);
 			}
 			dependencyLibrary << dependencies;
+			dependencyLibrary << sourcehash;
 		}
 
 		if (wiHelper::FileWrite(shaderfilename, output.shaderdata, output.shadersize))
@@ -662,6 +745,38 @@ namespace wiShaderCompiler
 
 		return false;
 	}
+	bool LoadShaderMetadata(const std::string& shaderfilename, std::vector<std::string>& dependencies, uint64_t& sourcehash)
+	{
+		dependencies.clear();
+		sourcehash = 0;
+#ifdef SHADERCOMPILER_ENABLED
+		std::string dependencylibrarypath = wiHelper::ReplaceExtension(shaderfilename, shadermetaextension);
+		if (!wiHelper::FileExists(dependencylibrarypath))
+		{
+			return false;
+		}
+		wiArchive dependencyLibrary(dependencylibrarypath);
+		if (!dependencyLibrary.IsOpen())
+		{
+			return false;
+		}
+		std::string rootdir = dependencyLibrary.GetSourceDirectory();
+		dependencyLibrary >> dependencies;
+		for (auto& x : dependencies)
+		{
+			x = rootdir + x;
+			wiHelper::MakePathAbsolute(x);
+			x = std::filesystem::path(x).lexically_normal().string(); // comparable between metadata files in different directories
+		}
+		if (dependencyLibrary.GetVersion() >= 81)
+		{
+			dependencyLibrary >> sourcehash;
+		}
+		return true;
+#else
+		return false;
+#endif // SHADERCOMPILER_ENABLED
+	}
 	bool IsShaderOutdated(const std::string& shaderfilename)
 	{
 #ifdef SHADERCOMPILER_ENABLED
@@ -671,39 +786,66 @@ namespace wiShaderCompiler
 		{
 			return true; // no shader file = outdated shader, apps can attempt to rebuild it
 		}
-		std::string dependencylibrarypath = wiHelper::ReplaceExtension(shaderfilename, shadermetaextension);
-		if (!wiHelper::FileExists(dependencylibrarypath))
+
+		std::vector<std::string> dependencies;
+		uint64_t sourcehash = 0;
+		if (!LoadShaderMetadata(shaderfilename, dependencies, sourcehash))
 		{
 			return false; // no metadata file = no dependency, up to date (for example packaged builds)
 		}
 
 		const auto tim = std::filesystem::last_write_time(filepath);
 
-		wiArchive dependencyLibrary(dependencylibrarypath);
-		if (dependencyLibrary.IsOpen())
+		bool outdated = false;
+		for (auto& x : dependencies)
 		{
-			std::string rootdir = dependencyLibrary.GetSourceDirectory();
-			std::vector<std::string> dependencies;
-			dependencyLibrary >> dependencies;
-
-			for (auto& x : dependencies)
+			if (wiHelper::FileExists(x))
 			{
-				std::string dependencypath = rootdir + x;
-				wiHelper::MakePathAbsolute(dependencypath);
-				if (wiHelper::FileExists(dependencypath))
-				{
-					const auto dep_tim = std::filesystem::last_write_time(dependencypath);
+				const auto dep_tim = std::filesystem::last_write_time(x);
 
-					if (tim < dep_tim)
-					{
-						return true;
-					}
+				if (tim < dep_tim)
+				{
+					outdated = true;
+					break;
 				}
 			}
 		}
-#endif // SHADERCOMPILER_ENABLED
 
+		if (outdated && sourcehash != 0 && sourcehash == ComputeSourceHash(dependencies))
+		{
+			// The sources were touched, but their content is the same that the shader was compiled from
+			//	The timestamp of the shader is refreshed, so the sources are not hashed again until they are modified
+			std::error_code ec;
+			std::filesystem::last_write_time(filepath, std::filesystem::file_time_type::clock::now(), ec);
+			return false;
+		}
+		return outdated;
+#else
 		return false;
+#endif // SHADERCOMPILER_ENABLED
+	}
+
+	std::string GetPermutationFileName(const std::string& shaderfilename, const std::vector<std::string>& defines)
+	{
+		if (defines.empty())
+		{
+			return shaderfilename;
+		}
+		const size_t idx = shaderfilename.rfind('.');
+		std::string result = shaderfilename.substr(0, idx);
+		for (auto& x : defines)
+		{
+			result += "_";
+			for (char c : x)
+			{
+				result += (c == '=' || c == ' ') ? '_' : c;
+			}
+		}
+		if (idx != std::string::npos)
+		{
+			result += shaderfilename.substr(idx);
+		}
+		return result;
 	}
 
 	std::mutex locker;
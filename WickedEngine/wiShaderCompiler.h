@@ -39,9 +39,19 @@ namespace wiShaderCompiler
 	};
 	void Compile(const CompilerInput& input, CompilerOutput& output);
 
+	// The metadata file next to the shader binary stores the dependencies (the shader source and its includes) and the content hash of them
 	bool SaveShaderAndMetadata(const std::string& shaderfilename, const CompilerOutput& output);
+	// Read the metadata of a shader binary, the dependencies are returned as absolute paths. The hash is 0 if the metadata is older than the content hashes
+	bool LoadShaderMetadata(const std::string& shaderfilename, std::vector<std::string>& dependencies, uint64_t& sourcehash);
+	// Content hash of the source files, or 0 if one of them is missing
+	uint64_t ComputeSourceHash(const std::vector<std::string>& dependencies);
+	// A shader is outdated if one of its dependencies is newer than it, and their content is different from what the shader was compiled from
 	bool IsShaderOutdated(const std::string& shaderfilename);
 
+	// The binary file name of a shader that is compiled with extra defines, so the permutations of the same source don't overwrite each other
+	//	For example objectPS.cso with OBJECTSHADER_PERMUTATION=5 is objectPS_OBJECTSHADER_PERMUTATION_5.cso
+	std::string GetPermutationFileName(const std::string& shaderfilename, const std::vector<std::string>& defines);
+
 	void RegisterShader(const std::string& shaderfilename);
 	bool CheckRegisteredShadersOutdated();
 }
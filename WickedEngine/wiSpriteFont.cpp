@@ -18,7 +18,7 @@ void wiSpriteFont::Draw(CommandList cmd) const
 {
 	if (IsHidden())
 		return;
-	wiFont::Draw(text, params, cmd);
+	wiFont::Draw(cache, text, params, cmd);
 }
 
 float wiSpriteFont::textWidth() const
@@ -13,6 +13,7 @@ private:
 		DISABLE_UPDATE = 1 << 1,
 	};
 	uint32_t _flags = EMPTY;
+	mutable wiFont::TextCache cache;
 public:
 	std::wstring text;
 	wiFontParams params;
@@ -7,4 +7,6 @@ namespace wiStartupArguments
 	void Parse(const wchar_t* args);
     void Parse(int argc, char *argv[]);
 	bool HasArgument(const std::string& value);
+	// Returns the value of an argument that was given in the name=value form, or an empty string if it was not given
+	std::string GetArgumentValue(const std::string& name);
 }
@@ -0,0 +1,459 @@
+#include "wiTextureCompressor.h"
+#include "wiJobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+using namespace wiGraphics;
+
+namespace wiTextureCompressor
+{
+	// Layout of the DDS file headers:
+	struct DDS_PIXELFORMAT
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourCC;
+		uint32_t RGBBitCount;
+		uint32_t RBitMask;
+		uint32_t GBitMask;
+		uint32_t BBitMask;
+		uint32_t ABitMask;
+	};
+	struct DDS_HEADER
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t pitchOrLinearSize;
+		uint32_t depth;
+		uint32_t mipMapCount;
+		uint32_t reserved1[11];
+		DDS_PIXELFORMAT ddspf;
+		uint32_t caps;
+		uint32_t caps2;
+		uint32_t caps3;
+		uint32_t caps4;
+		uint32_t reserved2;
+	};
+	struct DDS_HEADER_DXT10
+	{
+		uint32_t dxgiFormat;
+		uint32_t resourceDimension;
+		uint32_t miscFlag;
+		uint32_t arraySize;
+		uint32_t miscFlags2;
+	};
+	static_assert(sizeof(DDS_HEADER) == 124, "DDS_HEADER size mismatch");
+	static_assert(sizeof(DDS_HEADER_DXT10) == 20, "DDS_HEADER_DXT10 size mismatch");
+
+	static uint32_t GetBlockSize(FORMAT format)
+	{
+		switch (format)
+		{
+		case FORMAT_BC1_UNORM:
+		case FORMAT_BC4_UNORM:
+			return 8;
+		case FORMAT_BC3_UNORM:
+		case FORMAT_BC5_UNORM:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
+	static uint32_t GetDXGIFormat(FORMAT format)
+	{
+		switch (format)
+		{
+		case FORMAT_BC1_UNORM:
+			return 71;
+		case FORMAT_BC3_UNORM:
+			return 77;
+		case FORMAT_BC4_UNORM:
+			return 80;
+		case FORMAT_BC5_UNORM:
+			return 83;
+		default:
+			return 0;
+		}
+	}
+
+	bool IsFormatSupported(FORMAT format)
+	{
+		return GetBlockSize(format) > 0;
+	}
+
+	size_t GetCompressedSize(uint32_t width, uint32_t height, FORMAT format)
+	{
+		return size_t(std::max(1u, (width + 3) / 4)) * size_t(std::max(1u, (height + 3) / 4)) * GetBlockSize(format);
+	}
+
+	// The 4x4 pixels of a block, in rows:
+	struct Block
+	{
+		uint8_t pixels[16][4];
+	};
+
+	static inline uint16_t Pack565(const float color[3])
+	{
+		const uint32_t r = (uint32_t)std::round(std::min(std::max(color[0] / 255.0f, 0.0f), 1.0f) * 31);
+		const uint32_t g = (uint32_t)std::round(std::min(std::max(color[1] / 255.0f, 0.0f), 1.0f) * 63);
+		const uint32_t b = (uint32_t)std::round(std::min(std::max(color[2] / 255.0f, 0.0f), 1.0f) * 31);
+		return uint16_t((r << 11) | (g << 5) | b);
+	}
+	static inline void Unpack565(uint16_t value, int color[3])
+	{
+		const int r = (value >> 11) & 31;
+		const int g = (value >> 5) & 63;
+		const int b = value & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// BC1 color block: the endpoints are the extremes of the colors along their principal axis, inset a bit to reduce the error of the extremes
+	static void EncodeColorBlock(const Block& block, uint8_t* dest)
+	{
+		float mean[3] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			mean[0] += block.pixels[i][0];
+			mean[1] += block.pixels[i][1];
+			mean[2] += block.pixels[i][2];
+		}
+		mean[0] /= 16;
+		mean[1] /= 16;
+		mean[2] /= 16;
+
+		// Covariance matrix (xx, xy, xz, yy, yz, zz):
+		float cov[6] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			const float r = block.pixels[i][0] - mean[0];
+			const float g = block.pixels[i][1] - mean[1];
+			const float b = block.pixels[i][2] - mean[2];
+			cov[0] += r * r;
+			cov[1] += r * g;
+			cov[2] += r * b;
+			cov[3] += g * g;
+			cov[4] += g * b;
+			cov[5] += b * b;
+		}
+
+		// The principal axis is found by power iteration:
+		float axis[3] = { 1, 1, 1 };
+		for (int iteration = 0; iteration < 8; ++iteration)
+		{
+			const float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+			const float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+			const float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+			const float m = std::max(std::abs(x), std::max(std::abs(y), std::abs(z)));
+			if (m <= 0)
+			{
+				break;
+			}
+			axis[0] = x / m;
+			axis[1] = y / m;
+			axis[2] = z / m;
+		}
+		const float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		axis[0] /= length;
+		axis[1] /= length;
+		axis[2] /= length;
+
+		float tmin = FLT_MAX;
+		float tmax = -FLT_MAX;
+		for (int i = 0; i < 16; ++i)
+		{
+			const float t =
+				(block.pixels[i][0] - mean[0]) * axis[0] +
+				(block.pixels[i][1] - mean[1]) * axis[1] +
+				(block.pixels[i][2] - mean[2]) * axis[2];
+			tmin = std::min(tmin, t);
+			tmax = std::max(tmax, t);
+		}
+		const float inset = (tmax - tmin) / 16;
+		tmin += inset;
+		tmax -= inset;
+
+		const float endpoint0[3] = { mean[0] + axis[0] * tmax, mean[1] + axis[1] * tmax, mean[2] + axis[2] * tmax };
+		const float endpoint1[3] = { mean[0] + axis[0] * tmin, mean[1] + axis[1] * tmin, mean[2] + axis[2] * tmin };
+		uint16_t color0 = Pack565(endpoint0);
+		uint16_t color1 = Pack565(endpoint1);
+		if (color0 < color1)
+		{
+			std::swap(color0, color1);
+		}
+
+		// With color0 > color1 the block is in four color mode, with equal colors every pixel refers to color0:
+		uint32_t indices = 0;
+		if (color0 != color1)
+		{
+			int palette[4][3];
+			Unpack565(color0, palette[0]);
+			Unpack565(color1, palette[1]);
+			for (int c = 0; c < 3; ++c)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			for (int i = 0; i < 16; ++i)
+			{
+				int best = 0;
+				int best_distance = INT_MAX;
+				for (int p = 0; p < 4; ++p)
+				{
+					const int r = block.pixels[i][0] - palette[p][0];
+					const int g = block.pixels[i][1] - palette[p][1];
+					const int b = block.pixels[i][2] - palette[p][2];
+					const int distance = r * r + g * g + b * b;
+					if (distance < best_distance)
+					{
+						best_distance = distance;
+						best = p;
+					}
+				}
+				indices |= uint32_t(best) << (i * 2);
+			}
+		}
+
+		dest[0] = uint8_t(color0 & 0xFF);
+		dest[1] = uint8_t(color0 >> 8);
+		dest[2] = uint8_t(color1 & 0xFF);
+		dest[3] = uint8_t(color1 >> 8);
+		dest[4] = uint8_t(indices & 0xFF);
+		dest[5] = uint8_t((indices >> 8) & 0xFF);
+		dest[6] = uint8_t((indices >> 16) & 0xFF);
+		dest[7] = uint8_t(indices >> 24);
+	}
+
+	// BC4 block of one channel: the endpoints are the extremes of the channel in eight value mode
+	static void EncodeChannelBlock(const Block& block, int channel, uint8_t* dest)
+	{
+		int lo = 255;
+		int hi = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			lo = std::min(lo, (int)block.pixels[i][channel]);
+			hi = std::max(hi, (int)block.pixels[i][channel]);
+		}
+
+		uint64_t indices = 0;
+		if (hi > lo)
+		{
+			int palette[8];
+			palette[0] = hi;
+			palette[1] = lo;
+			for (int p = 2; p < 8; ++p)
+			{
+				palette[p] = ((8 - p) * hi + (p - 1) * lo) / 7;
+			}
+			for (int i = 0; i < 16; ++i)
+			{
+				int best = 0;
+				int best_distance = INT_MAX;
+				for (int p = 0; p < 8; ++p)
+				{
+					const int distance = std::abs(block.pixels[i][channel] - palette[p]);
+					if (distance < best_distance)
+					{
+						best_distance = distance;
+						best = p;
+					}
+				}
+				indices |= uint64_t(best) << (i * 3);
+			}
+		}
+
+		dest[0] = uint8_t(hi);
+		dest[1] = uint8_t(lo);
+		for (int b = 0; b < 6; ++b)
+		{
+			dest[2 + b] = uint8_t((indices >> (b * 8)) & 0xFF);
+		}
+	}
+
+	void CompressBlocks(const uint32_t* rgba, uint32_t width, uint32_t height, FORMAT format, uint8_t* dest)
+	{
+		const uint32_t block_size = GetBlockSize(format);
+		assert(block_size > 0); // format is not supported
+		if (block_size == 0 || width == 0 || height == 0)
+		{
+			return;
+		}
+		const uint32_t blocks_x = std::max(1u, (width + 3) / 4);
+		const uint32_t blocks_y = std::max(1u, (height + 3) / 4);
+
+		wiJobSystem::context ctx;
+		wiJobSystem::Dispatch(ctx, blocks_y, 1, [&](wiJobArgs args) {
+			const uint32_t by = args.jobIndex;
+			Block block;
+			for (uint32_t bx = 0; bx < blocks_x; ++bx)
+			{
+				for (uint32_t y = 0; y < 4; ++y)
+				{
+					const uint32_t py = std::min(by * 4 + y, height - 1);
+					for (uint32_t x = 0; x < 4; ++x)
+					{
+						const uint32_t px = std::min(bx * 4 + x, width - 1);
+						const uint32_t color = rgba[py * width + px];
+						uint8_t* pixel = block.pixels[y * 4 + x];
+						pixel[0] = uint8_t(color & 0xFF);
+						pixel[1] = uint8_t((color >> 8) & 0xFF);
+						pixel[2] = uint8_t((color >> 16) & 0xFF);
+						pixel[3] = uint8_t(color >> 24);
+					}
+				}
+
+				uint8_t* block_dest = dest + (size_t(by) * blocks_x + bx) * block_size;
+				switch (format)
+				{
+				case FORMAT_BC1_UNORM:
+					EncodeColorBlock(block, block_dest);
+					break;
+				case FORMAT_BC3_UNORM:
+					EncodeChannelBlock(block, 3, block_dest);
+					EncodeColorBlock(block, block_dest + 8);
+					break;
+				case FORMAT_BC4_UNORM:
+					EncodeChannelBlock(block, 0, block_dest);
+					break;
+				case FORMAT_BC5_UNORM:
+					EncodeChannelBlock(block, 0, block_dest);
+					EncodeChannelBlock(block, 1, block_dest + 8);
+					break;
+				default:
+					break;
+				}
+			}
+		});
+		wiJobSystem::Wait(ctx);
+	}
+
+	// Box filtered half resolution image, the rows are filtered in parallel by the job system
+	static void Downsample(const std::vector<uint32_t>& src, uint32_t width, uint32_t height, bool normalize, std::vector<uint32_t>& dest)
+	{
+		const uint32_t dest_width = std::max(1u, width / 2);
+		const uint32_t dest_height = std::max(1u, height / 2);
+		dest.resize(size_t(dest_width) * size_t(dest_height));
+
+		wiJobSystem::context ctx;
+		wiJobSystem::Dispatch(ctx, dest_height, 1, [&](wiJobArgs args) {
+			const uint32_t y = args.jobIndex;
+			for (uint32_t x = 0; x < dest_width; ++x)
+			{
+				float sum[4] = {};
+				for (uint32_t sy = 0; sy < 2; ++sy)
+				{
+					for (uint32_t sx = 0; sx < 2; ++sx)
+					{
+						const uint32_t px = std::min(x * 2 + sx, width - 1);
+						const uint32_t py = std::min(y * 2 + sy, height - 1);
+						const uint32_t color = src[py * width + px];
+						sum[0] += float(color & 0xFF);
+						sum[1] += float((color >> 8) & 0xFF);
+						sum[2] += float((color >> 16) & 0xFF);
+						sum[3] += float(color >> 24);
+					}
+				}
+				for (int c = 0; c < 4; ++c)
+				{
+					sum[c] *= 0.25f;
+				}
+
+				if (normalize)
+				{
+					float n[3] = { sum[0] / 255.0f * 2 - 1, sum[1] / 255.0f * 2 - 1, sum[2] / 255.0f * 2 - 1 };
+					const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					if (length > 0)
+					{
+						for (int c = 0; c < 3; ++c)
+						{
+							sum[c] = (n[c] / length * 0.5f + 0.5f) * 255.0f;
+						}
+					}
+				}
+
+				uint32_t color = 0;
+				for (int c = 0; c < 4; ++c)
+				{
+					color |= uint32_t(std::min(std::max(std::round(sum[c]), 0.0f), 255.0f)) << (c * 8);
+				}
+				dest[y * dest_width + x] = color;
+			}
+		});
+		wiJobSystem::Wait(ctx);
+	}
+
+	bool CreateDDS(const uint32_t* rgba, uint32_t width, uint32_t height, FORMAT format, bool normalize_mips, std::vector<uint8_t>& filedata)
+	{
+		if (!IsFormatSupported(format) || width == 0 || height == 0 || width % 4 != 0 || height % 4 != 0)
+		{
+			return false;
+		}
+
+		uint32_t mips = 1;
+		while ((std::max(width, height) >> mips) > 0)
+		{
+			mips++;
+		}
+
+		size_t size = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+		for (uint32_t mip = 0; mip < mips; ++mip)
+		{
+			size += GetCompressedSize(std::max(1u, width >> mip), std::max(1u, height >> mip), format);
+		}
+		filedata.resize(size);
+
+		DDS_HEADER header = {};
+		header.size = sizeof(DDS_HEADER);
+		header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT | LINEARSIZE
+		header.height = height;
+		header.width = width;
+		header.pitchOrLinearSize = (uint32_t)GetCompressedSize(width, height, format);
+		header.depth = 1;
+		header.mipMapCount = mips;
+		header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+		header.ddspf.flags = 0x4; // FOURCC
+		header.ddspf.fourCC = uint32_t('D') | (uint32_t('X') << 8) | (uint32_t('1') << 16) | (uint32_t('0') << 24);
+		header.caps = 0x1000 | 0x400000 | 0x8; // TEXTURE | MIPMAP | COMPLEX
+
+		DDS_HEADER_DXT10 header10 = {};
+		header10.dxgiFormat = GetDXGIFormat(format);
+		header10.resourceDimension = 3; // TEXTURE2D
+		header10.arraySize = 1;
+
+		uint8_t* dest = filedata.data();
+		std::memcpy(dest, "DDS ", sizeof(uint32_t));
+		dest += sizeof(uint32_t);
+		std::memcpy(dest, &header, sizeof(header));
+		dest += sizeof(header);
+		std::memcpy(dest, &header10, sizeof(header10));
+		dest += sizeof(header10);
+
+		std::vector<uint32_t> image(rgba, rgba + size_t(width) * size_t(height));
+		std::vector<uint32_t> next;
+		uint32_t mip_width = width;
+		uint32_t mip_height = height;
+		for (uint32_t mip = 0; mip < mips; ++mip)
+		{
+			CompressBlocks(image.data(), mip_width, mip_height, format, dest);
+			dest += GetCompressedSize(mip_width, mip_height, format);
+
+			if (mip + 1 < mips)
+			{
+				Downsample(image, mip_width, mip_height, normalize_mips, next);
+				image.swap(next);
+				mip_width = std::max(1u, mip_width / 2);
+				mip_height = std::max(1u, mip_height / 2);
+			}
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "CommonInclude.h"
+#include "wiGraphics.h"
+
+#include <vector>
+
+// CPU block compression of RGBA8 images
+//	Supported formats: FORMAT_BC1_UNORM (rgb), FORMAT_BC3_UNORM (rgba), FORMAT_BC4_UNORM (r), FORMAT_BC5_UNORM (rg)
+namespace wiTextureCompressor
+{
+	// Returns true if the format can be compressed to
+	bool IsFormatSupported(wiGraphics::FORMAT format);
+	// Size of the compressed image in bytes
+	size_t GetCompressedSize(uint32_t width, uint32_t height, wiGraphics::FORMAT format);
+	// Compress an RGBA8 image into rows of blocks, the image is extended with its edge pixels to whole blocks
+	//	The block rows are compressed in parallel by the job system
+	//	dest must have room for GetCompressedSize() bytes
+	void CompressBlocks(const uint32_t* rgba, uint32_t width, uint32_t height, wiGraphics::FORMAT format, uint8_t* dest);
+	// Create the data of a DDS file with the full mip chain of the RGBA8 image, compressed to the format
+	//	The mips are downsampled with a box filter, normalize_mips renormalizes them as normal vectors (for normal maps)
+	//	Returns false if the format is not supported or the width or height is not a multiple of 4
+	bool CreateDDS(const uint32_t* rgba, uint32_t width, uint32_t height, wiGraphics::FORMAT format, bool normalize_mips, std::vector<uint8_t>& filedata);
+};
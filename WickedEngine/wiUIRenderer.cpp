@@ -0,0 +1,264 @@
+#include "wiUIRenderer.h"
+#include "wiRenderer.h"
+#include "wiTextureHelper.h"
+#include "wiBackLog.h"
+#include "wiEvent.h"
+#include "shaders/ResourceMapping.h"
+#include "shaders/ShaderInterop_UI.h"
+
+#include <atomic>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+using namespace wiGraphics;
+
+namespace wiUIRenderer
+{
+	GPUBuffer constantBuffer;
+	InputLayout inputLayout;
+	Shader vertexShader;
+	Shader pixelShader;
+	BlendState blendState;
+	RasterizerState rasterizerState;
+	DepthStencilState depthStencilState;
+	Sampler sampler;
+	PipelineState PSO;
+	std::atomic_bool initialized{ false };
+
+	DrawData frameData;
+	std::atomic_bool frameDataValid{ false };
+
+	void DrawData::Clear(size_t listCount)
+	{
+		lists.resize(listCount);
+		for (auto& x : lists)
+		{
+			x.vertices.clear();
+			x.indices.clear();
+			x.commands.clear();
+		}
+	}
+
+	void LoadShaders()
+	{
+		inputLayout.elements =
+		{
+			{ "POSITION", 0, FORMAT_R32G32_FLOAT, 0, InputLayout::APPEND_ALIGNED_ELEMENT, INPUT_PER_VERTEX_DATA },
+			{ "TEXCOORD", 0, FORMAT_R32G32_FLOAT, 0, InputLayout::APPEND_ALIGNED_ELEMENT, INPUT_PER_VERTEX_DATA },
+			{ "COLOR", 0, FORMAT_R8G8B8A8_UNORM, 0, InputLayout::APPEND_ALIGNED_ELEMENT, INPUT_PER_VERTEX_DATA },
+		};
+		wiRenderer::LoadShader(VS, vertexShader, "uiVS.cso");
+
+		pixelShader.auto_samplers.clear();
+		pixelShader.auto_samplers.emplace_back();
+		pixelShader.auto_samplers.back().sampler = sampler;
+		pixelShader.auto_samplers.back().slot = SSLOT_ONDEMAND0;
+		wiRenderer::LoadShader(PS, pixelShader, "uiPS.cso");
+
+		PipelineStateDesc desc;
+		desc.vs = &vertexShader;
+		desc.ps = &pixelShader;
+		desc.il = &inputLayout;
+		desc.bs = &blendState;
+		desc.dss = &depthStencilState;
+		desc.rs = &rasterizerState;
+		desc.pt = TRIANGLELIST;
+		wiRenderer::GetDevice()->CreatePipelineState(&desc, &PSO);
+	}
+
+	void Initialize()
+	{
+		if (initialized)
+		{
+			return;
+		}
+
+		GraphicsDevice* device = wiRenderer::GetDevice();
+
+		GPUBufferDesc bd;
+		bd.Usage = USAGE_DYNAMIC;
+		bd.ByteWidth = sizeof(UICB);
+		bd.BindFlags = BIND_CONSTANT_BUFFER;
+		bd.CPUAccessFlags = CPU_ACCESS_WRITE;
+		device->CreateBuffer(&bd, nullptr, &constantBuffer);
+
+		rasterizerState.FillMode = FILL_SOLID;
+		rasterizerState.CullMode = CULL_NONE;
+		rasterizerState.DepthClipEnable = false;
+
+		// The color is blended over, the alpha accumulates coverage, so the result is premultiplied if the target was cleared to zero:
+		blendState.RenderTarget[0].BlendEnable = true;
+		blendState.RenderTarget[0].SrcBlend = BLEND_SRC_ALPHA;
+		blendState.RenderTarget[0].DestBlend = BLEND_INV_SRC_ALPHA;
+		blendState.RenderTarget[0].BlendOp = BLEND_OP_ADD;
+		blendState.RenderTarget[0].SrcBlendAlpha = BLEND_ONE;
+		blendState.RenderTarget[0].DestBlendAlpha = BLEND_INV_SRC_ALPHA;
+		blendState.RenderTarget[0].BlendOpAlpha = BLEND_OP_ADD;
+		blendState.RenderTarget[0].RenderTargetWriteMask = COLOR_WRITE_ENABLE_ALL;
+		blendState.IndependentBlendEnable = false;
+
+		depthStencilState.DepthEnable = false;
+		depthStencilState.StencilEnable = false;
+
+		SamplerDesc samplerDesc;
+		samplerDesc.Filter = FILTER_MIN_MAG_MIP_LINEAR;
+		samplerDesc.AddressU = TEXTURE_ADDRESS_WRAP;
+		samplerDesc.AddressV = TEXTURE_ADDRESS_WRAP;
+		samplerDesc.AddressW = TEXTURE_ADDRESS_WRAP;
+		samplerDesc.MaxAnisotropy = 0;
+		samplerDesc.ComparisonFunc = COMPARISON_NEVER;
+		samplerDesc.MinLOD = 0;
+		samplerDesc.MaxLOD = FLT_MAX;
+		device->CreateSampler(&samplerDesc, &sampler);
+
+		static wiEvent::Handle handle = wiEvent::Subscribe(SYSTEM_EVENT_RELOAD_SHADERS, [](uint64_t userdata) { LoadShaders(); });
+		LoadShaders();
+
+		wiBackLog::post("wiUIRenderer Initialized");
+		initialized.store(true);
+	}
+
+	void SetDrawData(DrawData& data)
+	{
+		std::swap(frameData, data);
+		frameDataValid.store(true);
+	}
+	bool HasDrawData()
+	{
+		return frameDataValid.load();
+	}
+
+	void Draw(CommandList cmd)
+	{
+		if (frameDataValid.exchange(false))
+		{
+			Draw(frameData, cmd);
+		}
+	}
+
+	void Draw(const DrawData& data, CommandList cmd)
+	{
+		Initialize();
+
+		const float width = data.displaySize.x * data.framebufferScale.x;
+		const float height = data.displaySize.y * data.framebufferScale.y;
+		if (width <= 0 || height <= 0)
+		{
+			return;
+		}
+
+		size_t vertexCount = 0;
+		size_t indexCount = 0;
+		for (auto& list : data.lists)
+		{
+			vertexCount += list.vertices.size();
+			indexCount += list.indices.size();
+		}
+		if (vertexCount == 0 || indexCount == 0)
+		{
+			return;
+		}
+
+		GraphicsDevice* device = wiRenderer::GetDevice();
+
+		// Every list is uploaded with one allocation for the vertices and one for the indices:
+		GraphicsDevice::GPUAllocation vertexMem = device->AllocateGPU(sizeof(Vertex) * vertexCount, cmd);
+		GraphicsDevice::GPUAllocation indexMem = device->AllocateGPU(sizeof(Index) * indexCount, cmd);
+		if (!vertexMem.IsValid() || !indexMem.IsValid())
+		{
+			return;
+		}
+		Vertex* vertices = (Vertex*)vertexMem.data;
+		Index* indices = (Index*)indexMem.data;
+		for (auto& list : data.lists)
+		{
+			std::memcpy(vertices, list.vertices.data(), sizeof(Vertex) * list.vertices.size());
+			std::memcpy(indices, list.indices.data(), sizeof(Index) * list.indices.size());
+			vertices += list.vertices.size();
+			indices += list.indices.size();
+		}
+
+		device->EventBegin("UI", cmd);
+
+		Viewport vp;
+		vp.Width = width;
+		vp.Height = height;
+		device->BindViewports(1, &vp, cmd);
+
+		device->BindPipelineState(&PSO, cmd);
+
+		const GPUBuffer* vbs[] = { vertexMem.buffer };
+		const uint32_t strides[] = { sizeof(Vertex) };
+		const uint32_t offsets[] = { vertexMem.offset };
+		device->BindVertexBuffers(vbs, 0, arraysize(vbs), strides, offsets, cmd);
+		device->BindIndexBuffer(indexMem.buffer, sizeof(Index) == 2 ? INDEXFORMAT_16BIT : INDEXFORMAT_32BIT, indexMem.offset, cmd);
+
+		const bool bindless = device->CheckCapability(GRAPHICSDEVICE_CAPABILITY_BINDLESS_DESCRIPTORS);
+
+		UICB cb = {};
+		XMStoreFloat4x4(&cb.g_xUI_Transform, XMMatrixOrthographicOffCenterLH(
+			data.displayPos.x, data.displayPos.x + data.displaySize.x,
+			data.displayPos.y + data.displaySize.y, data.displayPos.y,
+			0, 1
+		));
+		cb.g_xUI_TextureIndex = -1;
+		device->BindConstantBuffer(VS, &constantBuffer, CB_GETBINDSLOT(UICB), cmd);
+		device->BindConstantBuffer(PS, &constantBuffer, CB_GETBINDSLOT(UICB), cmd);
+
+		const Texture* boundTexture = nullptr;
+		bool first = true;
+
+		uint32_t vertexBase = 0;
+		uint32_t indexBase = 0;
+		for (auto& list : data.lists)
+		{
+			for (auto& command : list.commands)
+			{
+				Rect scissor;
+				scissor.left = std::max(0, int32_t((command.clipRect.x - data.displayPos.x) * data.framebufferScale.x));
+				scissor.top = std::max(0, int32_t((command.clipRect.y - data.displayPos.y) * data.framebufferScale.y));
+				scissor.right = std::min(int32_t(width), int32_t((command.clipRect.z - data.displayPos.x) * data.framebufferScale.x));
+				scissor.bottom = std::min(int32_t(height), int32_t((command.clipRect.w - data.displayPos.y) * data.framebufferScale.y));
+				if (command.indexCount == 0 || scissor.right <= scissor.left || scissor.bottom <= scissor.top)
+				{
+					continue;
+				}
+				device->BindScissorRects(1, &scissor, cmd);
+
+				const Texture* texture = command.texture == nullptr ? wiTextureHelper::getWhite() : command.texture;
+				if (first || texture != boundTexture)
+				{
+					if (bindless)
+					{
+						cb.g_xUI_TextureIndex = device->GetDescriptorIndex(texture, SRV);
+						device->UpdateBuffer(&constantBuffer, &cb, cmd);
+					}
+					else
+					{
+						if (first)
+						{
+							device->UpdateBuffer(&constantBuffer, &cb, cmd);
+						}
+						device->BindResource(PS, texture, TEXSLOT_ONDEMAND0, cmd);
+					}
+					boundTexture = texture;
+					first = false;
+				}
+
+				device->DrawIndexed(command.indexCount, indexBase + command.indexOffset, vertexBase + command.vertexOffset, cmd);
+			}
+			vertexBase += (uint32_t)list.vertices.size();
+			indexBase += (uint32_t)list.indices.size();
+		}
+
+		Rect rect;
+		rect.left = -INT_MAX;
+		rect.right = INT_MAX;
+		rect.top = -INT_MAX;
+		rect.bottom = INT_MAX;
+		device->BindScissorRects(1, &rect, cmd);
+
+		device->EventEnd(cmd);
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "CommonInclude.h"
+#include "wiGraphicsDevice.h"
+
+#include <vector>
+
+// Renderer of immediate mode UI draw data (for example Dear ImGui) with the engine graphics device
+//	The draw data is recorded into a CommandList like any other engine rendering, the vertices and indices are uploaded with the frame GPU allocator
+//	The layout of the draw data matches ImDrawData, so an ImGui frame can be converted with a memcpy of every draw list:
+//		Vertex		:	ImDrawVert (pos, uv, col) with the default ImGui configuration
+//		Index		:	ImDrawIdx (16 bit)
+//		DrawCommand	:	ImDrawCmd, with the texture as an engine texture (nullptr is a white texture)
+namespace wiUIRenderer
+{
+	struct Vertex
+	{
+		XMFLOAT2 pos;
+		XMFLOAT2 uv;
+		uint32_t color; // R8G8B8A8
+	};
+	typedef uint16_t Index;
+
+	struct DrawCommand
+	{
+		XMFLOAT4 clipRect; // left, top, right, bottom in display coordinates
+		const wiGraphics::Texture* texture = nullptr;
+		uint32_t indexCount = 0;
+		uint32_t indexOffset = 0; // first index in the draw list
+		uint32_t vertexOffset = 0; // added to the indices, so a draw list can have more than 65536 vertices
+	};
+	struct DrawList
+	{
+		std::vector<Vertex> vertices;
+		std::vector<Index> indices;
+		std::vector<DrawCommand> commands;
+	};
+	struct DrawData
+	{
+		XMFLOAT2 displayPos = XMFLOAT2(0, 0); // top left of the display, it is at the top left of the render target
+		XMFLOAT2 displaySize = XMFLOAT2(0, 0);
+		XMFLOAT2 framebufferScale = XMFLOAT2(1, 1); // render target pixels per display unit
+		std::vector<DrawList> lists; // drawn in order
+
+		// The lists are resized, but their memory is kept, so filling it every frame doesn't allocate
+		void Clear(size_t listCount = 0);
+	};
+
+	void Initialize();
+
+	// Set the draw data of the frame, it is drawn by the next RenderPath2D::Render() or Draw(cmd)
+	//	The contents are swapped, so the caller gets back the buffers of an earlier frame to fill next time
+	//	Call it on the main thread, before the rendering of the frame
+	void SetDrawData(DrawData& data);
+	// Returns true if there is draw data that was not drawn yet
+	bool HasDrawData();
+
+	// Record the draw data that was set with SetDrawData() into the current render pass of the CommandList
+	//	The draw data is consumed. It can be called from a worker thread while other CommandLists are recorded
+	void Draw(wiGraphics::CommandList cmd);
+	// Record the draw data into the current render pass of the CommandList. The render target is the whole display
+	void Draw(const DrawData& data, wiGraphics::CommandList cmd);
+}
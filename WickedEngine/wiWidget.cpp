@@ -16,6 +16,22 @@ using namespace wiScene;
 
 
 static wiGraphics::PipelineState PSO_colored;
+static wiGraphics::Rect scissorLimits[COMMANDLIST_COUNT];
+static bool scissorLimited[COMMANDLIST_COUNT] = {};
+
+// While the draws are recorded (wiImage::GetRecord()), the custom draws of the widgets are only hashed, and they can cover the whole scissor rect
+static bool RecordCustomDraw(const void* data, size_t size, CommandList cmd)
+{
+	wiImage::DrawRecord* record = wiImage::GetRecord(cmd);
+	if (record == nullptr)
+	{
+		return false;
+	}
+	record->Hash(data, size);
+	record->Hash(&record->clip, sizeof(record->clip));
+	record->AddBounds(-FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX);
+	return true;
+}
 
 wiWidget::wiWidget()
 {
@@ -313,6 +329,15 @@ void wiWidget::ApplyScissor(const wiCanvas& canvas, const Rect rect, CommandList
 		}
 	}
 
+	if (scissorLimited[cmd])
+	{
+		const Rect& limit = scissorLimits[cmd];
+		scissor.bottom = std::min(scissor.bottom, limit.bottom);
+		scissor.top = std::max(scissor.top, limit.top);
+		scissor.left = std::max(scissor.left, limit.left);
+		scissor.right = std::min(scissor.right, limit.right);
+	}
+
 	if (scissor.left > scissor.right)
 	{
 		scissor.left = scissor.right;
@@ -322,14 +347,30 @@ void wiWidget::ApplyScissor(const wiCanvas& canvas, const Rect rect, CommandList
 		scissor.top = scissor.bottom;
 	}
 
+	wiImage::DrawRecord* record = wiImage::GetRecord(cmd);
+	if (record != nullptr)
+	{
+		record->clip = scissor;
+		return;
+	}
+
 	GraphicsDevice* device = wiRenderer::GetDevice();
 	float scale = canvas.GetDPIScaling();
 	scissor.bottom = int32_t((float)scissor.bottom * scale);
 	scissor.top = int32_t((float)scissor.top * scale);
 	scissor.left = int32_t((float)scissor.left * scale);
 	scissor.right = int32_t((float)scissor.right * scale);
+	wiImage::FlushBatch(cmd); // the batched images are drawn with the previous scissor
 	device->BindScissorRects(1, &scissor, cmd);
 }
+void wiWidget::SetScissorLimit(const Rect* rect, CommandList cmd)
+{
+	scissorLimited[cmd] = rect != nullptr;
+	if (rect != nullptr)
+	{
+		scissorLimits[cmd] = *rect;
+	}
+}
 Hitbox2D wiWidget::GetPointerHitbox() const
 {
 	XMFLOAT4 pointer = wiInput::GetPointer();
@@ -1317,8 +1358,6 @@ void wiComboBox::Render(const wiCanvas& canvas, CommandList cmd) const
 
 	// control-arrow-triangle
 	{
-		device->BindPipelineState(&PSO_colored, cmd);
-
 		MiscCB cb;
 		cb.g_xColor = sprites[ACTIVE].params.color;
 		XMStoreFloat4x4(&cb.g_xTransform, XMMatrixScaling(scale.y * 0.25f, scale.y * 0.25f, 1) *
@@ -1326,17 +1365,22 @@ void wiComboBox::Render(const wiCanvas& canvas, CommandList cmd) const
 			XMMatrixTranslation(translation.x + scale.x + 1 + scale.y * 0.5f, translation.y + scale.y * 0.5f, 0) *
 			Projection
 		);
-		device->UpdateBuffer(wiRenderer::GetConstantBuffer(CBTYPE_MISC), &cb, cmd);
-		device->BindConstantBuffer(VS, wiRenderer::GetConstantBuffer(CBTYPE_MISC), CBSLOT_RENDERER_MISC, cmd);
-		const GPUBuffer* vbs[] = {
-			&vb_triangle,
-		};
-		const uint32_t strides[] = {
-			sizeof(Vertex),
-		};
-		device->BindVertexBuffers(vbs, 0, arraysize(vbs), strides, nullptr, cmd);
+		if (!RecordCustomDraw(&cb, sizeof(cb), cmd))
+		{
+			wiImage::FlushBatch(cmd);
+			device->BindPipelineState(&PSO_colored, cmd);
+			device->UpdateBuffer(wiRenderer::GetConstantBuffer(CBTYPE_MISC), &cb, cmd);
+			device->BindConstantBuffer(VS, wiRenderer::GetConstantBuffer(CBTYPE_MISC), CBSLOT_RENDERER_MISC, cmd);
+			const GPUBuffer* vbs[] = {
+				&vb_triangle,
+			};
+			const uint32_t strides[] = {
+				sizeof(Vertex),
+			};
+			device->BindVertexBuffers(vbs, 0, arraysize(vbs), strides, nullptr, cmd);
 
-		device->Draw(3, 0, cmd);
+			device->Draw(3, 0, cmd);
+		}
 	}
 
 	ApplyScissor(canvas, scissorRect, cmd);
@@ -2442,11 +2486,18 @@ void wiColorPicker::Render(const wiCanvas& canvas, CommandList cmd) const
 
 	const XMMATRIX Projection = canvas.GetProjection();
 
+	ApplyScissor(canvas, scissorRect, cmd);
+
+	const float custom_draw_state[] = { hue, saturation, luminance, IsEnabled() ? 1.0f : 0.0f, translation.x, translation.y, scale.x, scale.y, canvas.GetLogicalWidth(), canvas.GetLogicalHeight() };
+	if (RecordCustomDraw(custom_draw_state, sizeof(custom_draw_state), cmd))
+	{
+		return;
+	}
+
+	wiImage::FlushBatch(cmd);
 	device->BindConstantBuffer(VS, wiRenderer::GetConstantBuffer(CBTYPE_MISC), CBSLOT_RENDERER_MISC, cmd);
 	device->BindPipelineState(&PSO_colored, cmd);
 
-	ApplyScissor(canvas, scissorRect, cmd);
-
 	float sca = std::min(scale.x / cp_width, scale.y / cp_height);
 
 	XMMATRIX W =
@@ -2981,8 +3032,6 @@ void wiTreeList::Render(const wiCanvas& canvas, CommandList cmd) const
 
 		// opened flag triangle:
 		{
-			device->BindPipelineState(&PSO_colored, cmd);
-
 			MiscCB cb;
 			cb.g_xColor = opener_highlight == i ? wiColor::White().toFloat4() : sprites[FOCUS].params.color;
 			XMStoreFloat4x4(&cb.g_xTransform, XMMatrixScaling(item_height() * 0.3f, item_height() * 0.3f, 1) *
@@ -2990,17 +3039,22 @@ void wiTreeList::Render(const wiCanvas& canvas, CommandList cmd) const
 				XMMatrixTranslation(open_box.pos.x + open_box.siz.x * 0.5f, open_box.pos.y + open_box.siz.y * 0.25f, 0) *
 				Projection
 			);
-			device->UpdateBuffer(wiRenderer::GetConstantBuffer(CBTYPE_MISC), &cb, cmd);
-			device->BindConstantBuffer(VS, wiRenderer::GetConstantBuffer(CBTYPE_MISC), CBSLOT_RENDERER_MISC, cmd);
-			const GPUBuffer* vbs[] = {
-				&vb_triangle,
-			};
-			const uint32_t strides[] = {
-				sizeof(Vertex),
-			};
-			device->BindVertexBuffers(vbs, 0, arraysize(vbs), strides, nullptr, cmd);
-
-			device->Draw(3, 0, cmd);
+			if (!RecordCustomDraw(&cb, sizeof(cb), cmd))
+			{
+				wiImage::FlushBatch(cmd);
+				device->BindPipelineState(&PSO_colored, cmd);
+				device->UpdateBuffer(wiRenderer::GetConstantBuffer(CBTYPE_MISC), &cb, cmd);
+				device->BindConstantBuffer(VS, wiRenderer::GetConstantBuffer(CBTYPE_MISC), CBSLOT_RENDERER_MISC, cmd);
+				const GPUBuffer* vbs[] = {
+					&vb_triangle,
+				};
+				const uint32_t strides[] = {
+					sizeof(Vertex),
+				};
+				device->BindVertexBuffers(vbs, 0, arraysize(vbs), strides, nullptr, cmd);
+
+				device->Draw(3, 0, cmd);
+			}
 		}
 
 		// Item name text:
@@ -90,6 +90,9 @@ public:
 	void Deactivate();
 
 	void ApplyScissor(const wiCanvas& canvas, const wiGraphics::Rect rect, wiGraphics::CommandList cmd, bool constrain_to_parent = true) const;
+	// Limit the scissor rects of the widgets that are rendered on a CommandList (logical canvas units), nullptr: no limit
+	//	wiGUI uses it to render only the dirty region of its layer
+	static void SetScissorLimit(const wiGraphics::Rect* rect, wiGraphics::CommandList cmd);
 	Hitbox2D GetPointerHitbox() const;
 
 	static void Initialize();
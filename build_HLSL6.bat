@@ -60,6 +60,11 @@ cd ..
 ..\shadercompilers\dxc emittedparticle_emitCS_FROMMESH.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/emittedparticle_emitCS_FROMMESH.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc emittedparticle_emitCS_volume.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/emittedparticle_emitCS_volume.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc emittedparticle_finishUpdateCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/emittedparticle_finishUpdateCS.cso  2>>../build_HLSL6_errors.log 
+..\shadercompilers\dxc emittedparticle_poolResetCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/emittedparticle_poolResetCS.cso  2>>../build_HLSL6_errors.log 
+..\shadercompilers\dxc emittedparticle_poolKickoffCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/emittedparticle_poolKickoffCS.cso  2>>../build_HLSL6_errors.log 
+..\shadercompilers\dxc emittedparticle_poolEmitCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/emittedparticle_poolEmitCS.cso  2>>../build_HLSL6_errors.log 
+..\shadercompilers\dxc emittedparticle_poolSimulateCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/emittedparticle_poolSimulateCS.cso  2>>../build_HLSL6_errors.log 
+..\shadercompilers\dxc emittedparticle_poolFinishCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/emittedparticle_poolFinishCS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc emittedparticle_sphpartitionoffsetsCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/emittedparticle_sphpartitionoffsetsCS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc emittedparticle_sphpartitionoffsetsresetCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/emittedparticle_sphpartitionoffsetsresetCS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc envMapPS_terrain.hlsl -T ps_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/envMapPS_terrain.cso  2>>../build_HLSL6_errors.log 
@@ -83,6 +88,10 @@ cd ..
 ..\shadercompilers\dxc gpusortlib_sortCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/gpusortlib_sortCS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc gpusortlib_sortInnerCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/gpusortlib_sortInnerCS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc gpusortlib_sortStepCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/gpusortlib_sortStepCS.cso  2>>../build_HLSL6_errors.log 
+..\shadercompilers\dxc gpusortlib_radixKickoffCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/gpusortlib_radixKickoffCS.cso  2>>../build_HLSL6_errors.log 
+..\shadercompilers\dxc gpusortlib_radixCountCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/gpusortlib_radixCountCS.cso  2>>../build_HLSL6_errors.log 
+..\shadercompilers\dxc gpusortlib_radixScanCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/gpusortlib_radixScanCS.cso  2>>../build_HLSL6_errors.log 
+..\shadercompilers\dxc gpusortlib_radixScatterCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/gpusortlib_radixScatterCS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc emittedparticle_sphpartitionCS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/emittedparticle_sphpartitionCS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc environmentalLightPS.hlsl -T ps_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/environmentalLightPS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc envMapPS.hlsl -T ps_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/envMapPS.cso  2>>../build_HLSL6_errors.log 
@@ -93,7 +102,9 @@ cd ..
 ..\shadercompilers\dxc fft_512x512_c2c_CS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/fft_512x512_c2c_CS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc fft_512x512_c2c_v2_CS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/fft_512x512_c2c_v2_CS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc fontPS.hlsl -T ps_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/fontPS.cso  2>>../build_HLSL6_errors.log 
+..\shadercompilers\dxc uiPS.hlsl -T ps_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/uiPS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc fontVS.hlsl -T vs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/fontVS.cso  2>>../build_HLSL6_errors.log 
+..\shadercompilers\dxc uiVS.hlsl -T vs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/uiVS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc forceFieldVisualizerPS.hlsl -T ps_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/forceFieldVisualizerPS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc forceFieldPlaneVisualizerVS.hlsl -T vs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/forceFieldPlaneVisualizerVS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc forceFieldPointVisualizerVS.hlsl -T vs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/forceFieldPointVisualizerVS.cso  2>>../build_HLSL6_errors.log 
@@ -146,9 +157,11 @@ cd ..
 ..\shadercompilers\dxc hairparticleVS.hlsl -T vs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/hairparticleVS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc blur_gaussian_float4CS.hlsl -T cs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/blur_gaussian_float4CS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc imagePS.hlsl -T ps_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/imagePS.cso  2>>../build_HLSL6_errors.log 
+..\shadercompilers\dxc imagePS_batched.hlsl -T ps_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/imagePS_batched.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc imagePS_separatenormalmap.hlsl -T ps_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/imagePS_separatenormalmap.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc imagePS_masked.hlsl -T ps_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/imagePS_masked.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc imageVS.hlsl -T vs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/imageVS.cso  2>>../build_HLSL6_errors.log 
+..\shadercompilers\dxc imageVS_batched.hlsl -T vs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/imageVS_batched.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc lensFlareGS.hlsl -T gs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/lensFlareGS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc lensFlarePS.hlsl -T ps_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/lensFlarePS.cso  2>>../build_HLSL6_errors.log 
 ..\shadercompilers\dxc lensFlareVS.hlsl -T vs_6_1  -D SHADER_MODEL_6  -flegacy-macro-expansion -Fo shaders/hlsl6/lensFlareVS.cso  2>>../build_HLSL6_errors.log 
@@ -60,6 +60,11 @@ cd ..
 ..\shadercompilers\dxc emittedparticle_emitCS_FROMMESH.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/emittedparticle_emitCS_FROMMESH.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc emittedparticle_emitCS_volume.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/emittedparticle_emitCS_volume.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc emittedparticle_finishUpdateCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/emittedparticle_finishUpdateCS.cso  2>>../build_SPIRV_errors.log 
+..\shadercompilers\dxc emittedparticle_poolResetCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/emittedparticle_poolResetCS.cso  2>>../build_SPIRV_errors.log 
+..\shadercompilers\dxc emittedparticle_poolKickoffCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/emittedparticle_poolKickoffCS.cso  2>>../build_SPIRV_errors.log 
+..\shadercompilers\dxc emittedparticle_poolEmitCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/emittedparticle_poolEmitCS.cso  2>>../build_SPIRV_errors.log 
+..\shadercompilers\dxc emittedparticle_poolSimulateCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/emittedparticle_poolSimulateCS.cso  2>>../build_SPIRV_errors.log 
+..\shadercompilers\dxc emittedparticle_poolFinishCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/emittedparticle_poolFinishCS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc emittedparticle_sphpartitionoffsetsCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/emittedparticle_sphpartitionoffsetsCS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc emittedparticle_sphpartitionoffsetsresetCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/emittedparticle_sphpartitionoffsetsresetCS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc envMapPS_terrain.hlsl -T ps_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_PS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/envMapPS_terrain.cso  2>>../build_SPIRV_errors.log 
@@ -83,6 +88,10 @@ cd ..
 ..\shadercompilers\dxc gpusortlib_sortCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/gpusortlib_sortCS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc gpusortlib_sortInnerCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/gpusortlib_sortInnerCS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc gpusortlib_sortStepCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/gpusortlib_sortStepCS.cso  2>>../build_SPIRV_errors.log 
+..\shadercompilers\dxc gpusortlib_radixKickoffCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/gpusortlib_radixKickoffCS.cso  2>>../build_SPIRV_errors.log 
+..\shadercompilers\dxc gpusortlib_radixCountCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/gpusortlib_radixCountCS.cso  2>>../build_SPIRV_errors.log 
+..\shadercompilers\dxc gpusortlib_radixScanCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/gpusortlib_radixScanCS.cso  2>>../build_SPIRV_errors.log 
+..\shadercompilers\dxc gpusortlib_radixScatterCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/gpusortlib_radixScatterCS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc emittedparticle_sphpartitionCS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/emittedparticle_sphpartitionCS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc environmentalLightPS.hlsl -T ps_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_PS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/environmentalLightPS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc envMapPS.hlsl -T ps_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_PS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/envMapPS.cso  2>>../build_SPIRV_errors.log 
@@ -93,7 +102,9 @@ cd ..
 ..\shadercompilers\dxc fft_512x512_c2c_CS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/fft_512x512_c2c_CS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc fft_512x512_c2c_v2_CS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/fft_512x512_c2c_v2_CS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc fontPS.hlsl -T ps_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_PS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/fontPS.cso  2>>../build_SPIRV_errors.log 
+..\shadercompilers\dxc uiPS.hlsl -T ps_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_PS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/uiPS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc fontVS.hlsl -T vs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_VS -fvk-invert-y -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/fontVS.cso  2>>../build_SPIRV_errors.log 
+..\shadercompilers\dxc uiVS.hlsl -T vs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_VS -fvk-invert-y -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/uiVS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc forceFieldVisualizerPS.hlsl -T ps_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_PS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/forceFieldVisualizerPS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc forceFieldPlaneVisualizerVS.hlsl -T vs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_VS -fvk-invert-y -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/forceFieldPlaneVisualizerVS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc forceFieldPointVisualizerVS.hlsl -T vs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_VS -fvk-invert-y -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/forceFieldPointVisualizerVS.cso  2>>../build_SPIRV_errors.log 
@@ -146,9 +157,11 @@ cd ..
 ..\shadercompilers\dxc hairparticleVS.hlsl -T vs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_VS -fvk-invert-y -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/hairparticleVS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc blur_gaussian_float4CS.hlsl -T cs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_CS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/blur_gaussian_float4CS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc imagePS.hlsl -T ps_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_PS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/imagePS.cso  2>>../build_SPIRV_errors.log 
+..\shadercompilers\dxc imagePS_batched.hlsl -T ps_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_PS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/imagePS_batched.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc imagePS_separatenormalmap.hlsl -T ps_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_PS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/imagePS_separatenormalmap.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc imagePS_masked.hlsl -T ps_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_PS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/imagePS_masked.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc imageVS.hlsl -T vs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_VS -fvk-invert-y -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/imageVS.cso  2>>../build_SPIRV_errors.log 
+..\shadercompilers\dxc imageVS_batched.hlsl -T vs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_VS -fvk-invert-y -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/imageVS_batched.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc lensFlareGS.hlsl -T gs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_GS -fvk-invert-y -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/lensFlareGS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc lensFlarePS.hlsl -T ps_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_PS -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/lensFlarePS.cso  2>>../build_SPIRV_errors.log 
 ..\shadercompilers\dxc lensFlareVS.hlsl -T vs_6_0 -D SHADERCOMPILER_SPIRV -D SPIRV_SHADERTYPE_VS -fvk-invert-y -spirv -fvk-use-dx-layout -flegacy-macro-expansion -Fo shaders/spirv/lensFlareVS.cso  2>>../build_SPIRV_errors.log 